@@ -75,6 +75,8 @@ flags = [
 '-I',
 '/plugins/logging',
 '-I',
+'/plugins/manual_control',
+'-I',
 '/plugins/mission',
 '-I',
 '/plugins/offboard',
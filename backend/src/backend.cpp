@@ -1,6 +1,8 @@
 #include "backend.h"
 
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "connection_initiator.h"
 #include "dronecore.h"
@@ -15,18 +17,44 @@ public:
     Impl() {}
     ~Impl() {}
 
+    // Doesn't wait for a system, the server can be started right away and
+    // serves calls for systems as they are discovered.
     void connect(const int mavlink_listen_port)
     {
-        _connection_initiator.start(_dc, 14540);
-        _connection_initiator.wait();
+        _mavlink_listen_port = mavlink_listen_port;
+        _connection_initiator.start(_dc, mavlink_listen_port, [this](uint64_t /* uuid */) {
+            std::lock_guard<std::mutex> lock(_server_mutex);
+            _system_discovered = true;
+            if (_server != nullptr) {
+                _server->set_system_discovered(true);
+            }
+        });
     }
 
-    void startGRPCServer()
+    void startGRPCServer(const std::string &address)
     {
-        _server = std::unique_ptr<GRPCServer>(new GRPCServer(_dc));
+        {
+            std::lock_guard<std::mutex> lock(_server_mutex);
+            _server = std::unique_ptr<GRPCServer>(new GRPCServer(_dc, address));
+            _server->set_system_discovered(_system_discovered);
+        }
+        if (_mavlink_listen_port > 0) {
+            _server->add_link(std::string("udp://") + DroneCore::DEFAULT_UDP_BIND_IP + ":"
+                              + std::to_string(_mavlink_listen_port));
+        }
         _server->run();
     }
 
+    std::shared_ptr<grpc::Channel> in_process_channel()
+    {
+        return _server->in_process_channel();
+    }
+
+    bool startMulticast(const std::string &group_address, int port, float rate_hz)
+    {
+        return _server->start_multicast(group_address, port, rate_hz);
+    }
+
     void wait()
     {
         _server->wait();
@@ -35,15 +63,21 @@ public:
 private:
     DroneCore _dc;
     ConnectionInitiator<dronecore::DroneCore> _connection_initiator;
+    // Set from the discovery callback, which can come before the server exists.
+    std::mutex _server_mutex {};
     std::unique_ptr<GRPCServer> _server;
+    bool _system_discovered {false};
+    int _mavlink_listen_port {0};
 };
 
 DroneCoreBackend::DroneCoreBackend() : _impl(new Impl()) {}
 DroneCoreBackend::~DroneCoreBackend() = default;
 
-void DroneCoreBackend::startGRPCServer() { _impl->startGRPCServer(); }
+void DroneCoreBackend::startGRPCServer(const std::string &address) { _impl->startGRPCServer(address); }
 void DroneCoreBackend::connect(const int mavlink_listen_port) { return _impl->connect(mavlink_listen_port); }
 void DroneCoreBackend::wait() { _impl->wait(); }
+bool DroneCoreBackend::startMulticast(const std::string &group_address, int port, float rate_hz) { return _impl->startMulticast(group_address, port, rate_hz); }
+std::shared_ptr<grpc::Channel> DroneCoreBackend::in_process_channel() { return _impl->in_process_channel(); }
 
 } // namespace backend
 } // namespace dronecore
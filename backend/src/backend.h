@@ -1,6 +1,11 @@
 #pragma once
 
 #include <memory>
+#include <string>
+
+namespace grpc {
+class Channel;
+} // namespace grpc
 
 namespace dronecore {
 namespace backend {
@@ -13,10 +18,19 @@ public:
     DroneCoreBackend(DroneCoreBackend &&) = delete;
     DroneCoreBackend &operator=(DroneCoreBackend &&) = delete;
 
-    void startGRPCServer();
+    // See GRPCServer for the address, an empty one only allows in-process clients.
+    void startGRPCServer(const std::string &address = "0.0.0.0:50051");
+    // Doesn't wait for a system to be discovered, see GRPCServer::SYSTEM_HEALTH_SERVICE.
     void connect(const int mavlink_listen_port = 14540);
     void wait();
 
+    // Telemetry batches to a multicast group, see GRPCServer::start_multicast().
+    // Only valid after startGRPCServer().
+    bool startMulticast(const std::string &group_address, int port, float rate_hz);
+
+    // For clients in this process, only valid after startGRPCServer().
+    std::shared_ptr<grpc::Channel> in_process_channel();
+
 private:
     class Impl;
     std::unique_ptr<Impl> _impl;
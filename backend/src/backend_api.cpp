@@ -1,12 +1,40 @@
 #include "backend_api.h"
 
+#include <cstdlib>
+#include <string>
+
 #include "backend.h"
 
 void runBackend(const int mavlink_listen_port, void (*onServerStarted)(void *), void *context)
+{
+    runBackendAt("0.0.0.0:50051", mavlink_listen_port, onServerStarted, context);
+}
+
+void runBackendAt(const char *grpc_address, const int mavlink_listen_port,
+                  void (*onServerStarted)(void *), void *context)
+{
+    runBackendWithMulticast(grpc_address, mavlink_listen_port, nullptr, 0.0f, onServerStarted,
+                            context);
+}
+
+void runBackendWithMulticast(const char *grpc_address, const int mavlink_listen_port,
+                             const char *multicast_address, const float multicast_rate_hz,
+                             void (*onServerStarted)(void *), void *context)
 {
     dronecore::backend::DroneCoreBackend backend;
     backend.connect(mavlink_listen_port);
-    backend.startGRPCServer();
+    backend.startGRPCServer(grpc_address != nullptr ? grpc_address : "");
+
+    if (multicast_address != nullptr) {
+        // The port comes last, after the group.
+        const std::string address(multicast_address);
+        const auto colon = address.rfind(':');
+        if (colon != std::string::npos) {
+            backend.startMulticast(address.substr(0, colon),
+                                   std::atoi(address.substr(colon + 1).c_str()),
+                                   multicast_rate_hz);
+        }
+    }
 
     if (onServerStarted != nullptr) {
         onServerStarted(context);
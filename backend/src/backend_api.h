@@ -7,6 +7,21 @@ extern "C" {
 __attribute__((visibility("default"))) void runBackend(int mavlink_listen_port,
                                                        void (*onServerStarted)(void *), void *context);
 
+// Like runBackend, with the address the server listens on, e.g. "unix:/tmp/dronecore.sock".
+__attribute__((visibility("default"))) void runBackendAt(const char *grpc_address,
+                                                         int mavlink_listen_port,
+                                                         void (*onServerStarted)(void *),
+                                                         void *context);
+
+// Like runBackendAt, also sending telemetry batches to a multicast group, e.g.
+// "239.255.0.1:14560". Nothing is multicast if the address is null.
+__attribute__((visibility("default"))) void runBackendWithMulticast(const char *grpc_address,
+                                                                    int mavlink_listen_port,
+                                                                    const char *multicast_address,
+                                                                    float multicast_rate_hz,
+                                                                    void (*onServerStarted)(void *),
+                                                                    void *context);
+
 #ifdef __cplusplus
 }
 #endif
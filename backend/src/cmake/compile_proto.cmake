@@ -5,24 +5,40 @@ if(NOT EXISTS ${PROTOC_BINARY} OR NOT EXISTS ${GRPC_CPP_PLUGIN_BINARY})
     message(FATAL_ERROR "Could not find 'protoc' or 'grpc_cpp_plugin' in the 'default' build folder. Please build for your host first (`make BUILD_DRONECORESERVER=YES default`).")
 endif()
 
+# Protos which are not in DroneCore-Proto (yet) are in the backend.
+set(BACKEND_PROTO_DIR ${CMAKE_CURRENT_SOURCE_DIR}/proto)
+
+function(find_proto COMPONENT_NAME PROTO_FILE)
+    set(FILE_NAME ${COMPONENT_NAME}/${COMPONENT_NAME}.proto)
+    if(EXISTS ${BACKEND_PROTO_DIR}/${FILE_NAME})
+        set(${PROTO_FILE} ${BACKEND_PROTO_DIR}/${FILE_NAME} PARENT_SCOPE)
+    else()
+        set(${PROTO_FILE} ${PROTO_DIR}/${FILE_NAME} PARENT_SCOPE)
+    endif()
+endfunction()
+
 function(compile_proto_pb COMPONENT_NAME PB_COMPILED_SOURCE)
+    find_proto(${COMPONENT_NAME} PROTO_FILE)
     add_custom_command(OUTPUT ${COMPONENT_NAME}/${COMPONENT_NAME}.pb.cc
         COMMAND ${PROTOC_BINARY}
             -I ${PROTO_DIR}
+            -I ${BACKEND_PROTO_DIR}
             --cpp_out=.
-            ${PROTO_DIR}/${COMPONENT_NAME}/${COMPONENT_NAME}.proto
+            ${PROTO_FILE}
     )
 
     set(PB_COMPILED_SOURCE ${COMPONENT_NAME}/${COMPONENT_NAME}.pb.cc PARENT_SCOPE)
 endfunction()
 
 function(compile_proto_grpc COMPONENT_NAME GRPC_COMPILED_SOURCES)
+    find_proto(${COMPONENT_NAME} PROTO_FILE)
     add_custom_command(OUTPUT ${COMPONENT_NAME}/${COMPONENT_NAME}.grpc.pb.cc
         COMMAND ${PROTOC_BINARY}
             -I ${PROTO_DIR}
+            -I ${BACKEND_PROTO_DIR}
             --grpc_out=.
             --plugin=protoc-gen-grpc=${GRPC_CPP_PLUGIN_BINARY}
-            ${PROTO_DIR}/${COMPONENT_NAME}/${COMPONENT_NAME}.proto
+            ${PROTO_FILE}
     )
 
     set(GRPC_COMPILED_SOURCE ${COMPONENT_NAME}/${COMPONENT_NAME}.grpc.pb.cc PARENT_SCOPE)
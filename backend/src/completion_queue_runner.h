@@ -0,0 +1,57 @@
+#pragma once
+
+#include <grpc++/grpc++.h>
+#include <thread>
+#include <vector>
+
+namespace dronecore {
+namespace backend {
+
+// What is put on a completion queue as tag.
+class CompletionTag
+{
+public:
+    virtual ~CompletionTag() = default;
+    virtual void complete(bool ok) = 0;
+};
+
+// Polls a completion queue from a few threads and completes its tags, which
+// are all CompletionTags. The threads exit once the queue is shut down and
+// drained, so shut down the server first, then the queue, then join().
+class CompletionQueueRunner
+{
+public:
+    static constexpr unsigned DEFAULT_NUM_THREADS = 2;
+
+    ~CompletionQueueRunner() { join(); }
+
+    void start(grpc::ServerCompletionQueue &cq, unsigned num_threads = DEFAULT_NUM_THREADS)
+    {
+        for (unsigned i = 0; i < num_threads; ++i) {
+            _threads.push_back(std::thread(&CompletionQueueRunner::run, &cq));
+        }
+    }
+
+    void join()
+    {
+        for (auto &thread : _threads) {
+            thread.join();
+        }
+        _threads.clear();
+    }
+
+private:
+    static void run(grpc::ServerCompletionQueue *cq)
+    {
+        void *tag;
+        bool ok;
+        while (cq->Next(&tag, &ok)) {
+            static_cast<CompletionTag *>(tag)->complete(ok);
+        }
+    }
+
+    std::vector<std::thread> _threads {};
+};
+
+} // namespace backend
+} // namespace dronecore
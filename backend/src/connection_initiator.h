@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include <future>
 
 #include "connection_result.h"
@@ -12,14 +13,19 @@ template <typename DroneCore>
 class ConnectionInitiator
 {
 public:
+    typedef std::function<void(uint64_t uuid)> discover_callback_t;
+
     ConnectionInitiator() {}
     ~ConnectionInitiator() {}
 
-    bool start(DroneCore &dc, const int port)
+    // Doesn't wait for a system, the callback is called once for the first one
+    // discovered (optional).
+    bool start(DroneCore &dc, const int port, discover_callback_t discover_callback = nullptr)
     {
         init_mutex();
         init_timeout_logging(dc);
 
+        _discover_callback = discover_callback;
         _discovery_future = wrapped_register_on_discover(dc);
 
         if (!add_udp_connection(dc, port)) {
@@ -69,6 +75,9 @@ private:
             std::call_once(_discovery_flag, [this, uuid]() {
                 LogInfo() << "System discovered [UUID: " << uuid << "]";
                 _discovery_promise->set_value(uuid);
+                if (_discover_callback) {
+                    _discover_callback(uuid);
+                }
             });
         });
 
@@ -78,6 +87,7 @@ private:
     std::once_flag _discovery_flag;
     std::shared_ptr<std::promise<uint64_t>> _discovery_promise;
     std::future<uint64_t> _discovery_future;
+    discover_callback_t _discover_callback {};
 };
 
 } // backend
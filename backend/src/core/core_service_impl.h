@@ -1,46 +1,30 @@
-#include <future>
 #include <string>
 
 #include "core/core.grpc.pb.h"
 #include "dronecore.h"
+#include "stream_publisher.h"
+#include "stream_router.h"
 
 namespace dronecore {
 namespace backend {
 
+// The two streams are served by the StreamRouter, ListRunningPlugins stays synchronous.
 template <typename DroneCore = DroneCore>
-class CoreServiceImpl final: public dronecore::rpc::core::CoreService::Service
+class CoreServiceImpl final: public
+    dronecore::rpc::core::CoreService::WithGenericMethod_SubscribeDiscover <
+    dronecore::rpc::core::CoreService::WithGenericMethod_SubscribeTimeout <
+    dronecore::rpc::core::CoreService::Service >>
 {
 public:
     CoreServiceImpl(DroneCore &dc)
-        : _dc(dc),
-          _stop_promise(std::promise<void>()),
-          _stop_future(_stop_promise.get_future()) {}
+        : _dc(dc) {}
 
-    grpc::Status SubscribeDiscover(grpc::ServerContext * /* context */,
-                                   const rpc::core::SubscribeDiscoverRequest * /* request */,
-                                   grpc::ServerWriter<rpc::core::DiscoverResponse> *writer) override
+    // Needs to be called before the router is started.
+    void start(StreamRouter &router)
     {
-        _dc.register_on_discover([&writer](const uint64_t uuid) {
-            dronecore::rpc::core::DiscoverResponse rpc_discover_response;
-            rpc_discover_response.set_uuid(uuid);
-            writer->Write(rpc_discover_response);
-        });
-
-        _stop_future.wait();
-        return grpc::Status::OK;
-    }
-
-    grpc::Status SubscribeTimeout(grpc::ServerContext * /* context */,
-                                  const rpc::core::SubscribeTimeoutRequest * /* request */,
-                                  grpc::ServerWriter<rpc::core::TimeoutResponse> *writer) override
-    {
-        _dc.register_on_timeout([&writer](const uint64_t /* uuid */) {
-            dronecore::rpc::core::TimeoutResponse rpc_timeout_response;
-            writer->Write(rpc_timeout_response);
-        });
-
-        _stop_future.wait();
-        return grpc::Status::OK;
+        const std::string service = "/dronecore.rpc.core.CoreService/";
+        router.add(service + "SubscribeDiscover", _discover);
+        router.add(service + "SubscribeTimeout", _timeout);
     }
 
     // For now, the running plugins are hardcoded and we assume they are always started by the backend.
@@ -62,13 +46,37 @@ public:
 
     void stop()
     {
-        _stop_promise.set_value();
+        _discover.stop();
+        _timeout.stop();
     }
 
 private:
+    void subscribeDiscover()
+    {
+        _dc.register_on_discover([this](const uint64_t uuid) {
+            dronecore::rpc::core::DiscoverResponse rpc_discover_response;
+            rpc_discover_response.set_uuid(uuid);
+            _discover.publish(rpc_discover_response);
+        });
+    }
+
+    void subscribeTimeout()
+    {
+        _dc.register_on_timeout([this](const uint64_t /* uuid */) {
+            dronecore::rpc::core::TimeoutResponse rpc_timeout_response;
+            _timeout.publish(rpc_timeout_response);
+        });
+    }
+
     DroneCore &_dc;
-    std::promise<void> _stop_promise;
-    std::future<void> _stop_future;
+
+    // Clients subscribing late still get the systems discovered before.
+    StreamPublisher<rpc::core::DiscoverResponse> _discover {
+        [this]() { subscribeDiscover(); }, Delivery::EveryWithHistory
+    };
+    StreamPublisher<rpc::core::TimeoutResponse> _timeout {
+        [this]() { subscribeTimeout(); }
+    };
 };
 
 } // namespace backend
@@ -1,6 +1,16 @@
 #include "backend_api.h"
 
+#include <cstdlib>
+
+// Usage: backend_bin [grpc_address] [mavlink_listen_port] [multicast_address] [multicast_rate_hz]
+// e.g. backend_bin unix:/tmp/dronecore.sock 14540 239.255.0.1:14560 10
 int main(int argc, char **argv)
 {
-    runBackend(14540, nullptr, nullptr);
+    const char *grpc_address = (argc > 1) ? argv[1] : "0.0.0.0:50051";
+    const int mavlink_listen_port = (argc > 2) ? std::atoi(argv[2]) : 14540;
+    const char *multicast_address = (argc > 3) ? argv[3] : nullptr;
+    const float multicast_rate_hz = (argc > 4) ? static_cast<float>(std::atof(argv[4])) : 10.0f;
+
+    runBackendWithMulticast(grpc_address, mavlink_listen_port, multicast_address,
+                            multicast_rate_hz, nullptr, nullptr);
 }
@@ -1,27 +1,87 @@
 #include "grpc_server.h"
 
+#include <chrono>
+#include <grpc++/health_check_service_interface.h>
 #include <grpc++/server_builder.h>
 #include <grpc++/security/server_credentials.h>
+#include <grpc++/support/channel_arguments.h>
 
 #include "log.h"
 
 namespace dronecore {
 namespace backend {
 
+constexpr const char *GRPCServer::DEFAULT_ADDRESS;
+constexpr const char *GRPCServer::SYSTEM_HEALTH_SERVICE;
+constexpr std::chrono::milliseconds GRPCServer::SHUTDOWN_TIMEOUT;
+
+GRPCServer::~GRPCServer()
+{
+    if (_server == nullptr) {
+        return;
+    }
+
+    // Ends the streams first, the server only shuts down once all calls are done.
+    _core.stop();
+    _telemetry_service.stop();
+    _telemetry_batch_service.stop();
+    // Setpoint streams only end when the client closes them, so they are
+    // cancelled after a while.
+    _server->Shutdown(std::chrono::system_clock::now() + SHUTDOWN_TIMEOUT);
+    _cq->Shutdown();
+    _runner.join();
+}
+
 void GRPCServer::run()
 {
+    // grpc.health.v1.Health, the server itself is serving once started.
+    grpc::EnableDefaultHealthCheckService(true);
+
     grpc::ServerBuilder builder;
     setup_port(builder);
 
     builder.RegisterService(&_core);
     builder.RegisterService(&_action_service);
     builder.RegisterService(&_mission_service);
-    builder.RegisterService(&_telemetry_service);
+    builder.RegisterService(&_mission_packed_service);
+    builder.RegisterService(&_offboard_service);
+    builder.RegisterService(&_message_stats_service);
+    builder.RegisterService(&_metrics_service);
+    builder.RegisterAsyncGenericService(&_router.service());
 
+    _cq = builder.AddCompletionQueue();
     _server = builder.BuildAndStart();
+
+    // The streams are served asynchronously, from the threads of the runner.
+    _core.start(_router);
+    _telemetry_service.start(_router);
+    _telemetry_batch_service.start(_router);
+    _router.start(_cq.get());
+    _runner.start(*_cq);
+
+    {
+        std::lock_guard<std::mutex> lock(_health_mutex);
+        auto health = _server->GetHealthCheckService();
+        if (health != nullptr) {
+            health->SetServingStatus(SYSTEM_HEALTH_SERVICE, _system_discovered);
+        }
+    }
     LogInfo() << "Server started";
 }
 
+void GRPCServer::set_system_discovered(bool discovered)
+{
+    std::lock_guard<std::mutex> lock(_health_mutex);
+    _system_discovered = discovered;
+    if (_server == nullptr) {
+        return;
+    }
+    auto health = _server->GetHealthCheckService();
+    if (health != nullptr) {
+        health->SetServingStatus(SYSTEM_HEALTH_SERVICE, discovered);
+    }
+}
+
 void GRPCServer::wait()
 {
     if (_server != nullptr) {
@@ -31,11 +91,39 @@ void GRPCServer::wait()
     }
 }
 
+bool GRPCServer::start_multicast(const std::string &group_address, int port, float rate_hz)
+{
+    if (!_multicast_sender.open(group_address, port)) {
+        return false;
+    }
+
+    _telemetry_batch_service.add_multicast([this](uint64_t uuid, const std::string & serialized) {
+        _multicast_sender.send(uuid, serialized);
+    }, rate_hz);
+    return true;
+}
+
+std::shared_ptr<grpc::Channel> GRPCServer::in_process_channel()
+{
+    if (_server == nullptr) {
+        LogWarn() << "Calling 'in_process_channel()' on a non-existing server. Did you call 'run()' before?";
+        return nullptr;
+    }
+
+    grpc::ChannelArguments channel_args;
+    return _server->InProcessChannel(channel_args);
+}
+
 void GRPCServer::setup_port(grpc::ServerBuilder &builder)
 {
-    std::string server_address("0.0.0.0:50051");
-    builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
-    LogInfo() << "Server set to listen on " << server_address;
+    if (_address.empty()) {
+        LogInfo() << "Server only reachable in-process";
+        return;
+    }
+
+    // Also takes "unix:<path>", which is faster for clients on the same device.
+    builder.AddListeningPort(_address, grpc::InsecureServerCredentials());
+    LogInfo() << "Server set to listen on " << _address;
 }
 
 } // namespace backend
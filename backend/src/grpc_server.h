@@ -1,14 +1,27 @@
 #pragma once
 
+#include <chrono>
 #include <grpc++/server.h>
 #include <memory>
+#include <mutex>
+#include <string>
 
 #include "action/action.h"
 #include "action/action_service_impl.h"
+#include "completion_queue_runner.h"
 #include "core/core_service_impl.h"
 #include "dronecore.h"
+#include "message_stats/message_stats_service_impl.h"
+#include "metrics.h"
+#include "metrics/metrics_service_impl.h"
 #include "mission/mission.h"
+#include "mission/mission_packed_service_impl.h"
 #include "mission/mission_service_impl.h"
+#include "multicast_sender.h"
+#include "offboard/offboard.h"
+#include "offboard/offboard_service_impl.h"
+#include "stream_router.h"
+#include "telemetry/telemetry_batch_service_impl.h"
 #include "telemetry/telemetry_service_impl.h"
 
 namespace dronecore {
@@ -17,36 +30,76 @@ namespace backend {
 class GRPCServer
 {
 public:
-    GRPCServer(DroneCore &dc)
+    // Clients connect to the address, e.g. "0.0.0.0:50051" or "unix:/tmp/dronecore.sock".
+    // With an empty address there is only the in-process channel.
+    GRPCServer(DroneCore &dc, const std::string &address = DEFAULT_ADDRESS)
         : _dc(dc),
+          _address(address),
           _core(_dc),
-          _action(_dc.system()),
-          _action_service(_action),
-          _mission(_dc.system()),
-          _mission_service(_mission),
-          _telemetry(_dc.system()),
-          _telemetry_service(_telemetry)
-    {
-        assert(_dc.system_uuids().size() >= 1);
-    }
+          _action_service(_dc),
+          _mission_service(_dc),
+          _mission_packed_service(_dc),
+          _offboard_service(_dc),
+          _telemetry_service(_dc),
+          _telemetry_batch_service(_dc),
+          _message_stats_service(_dc),
+          _metrics_service(_dc, _router, &SyncCallMetrics::install()) {}
+
+    ~GRPCServer();
+
+    static constexpr const char *DEFAULT_ADDRESS = "0.0.0.0:50051";
 
     void run();
     void wait();
 
+    // Services are served right away and calls for a system not discovered yet
+    // fail, this only sets the health of SYSTEM_HEALTH_SERVICE for clients to
+    // check or watch. Can be called before run().
+    void set_system_discovered(bool discovered);
+
+    static constexpr const char *SYSTEM_HEALTH_SERVICE = "dronecore.system";
+
+    // Adds the traffic counters of a MAVLink connection to the metrics, see
+    // MetricsServiceImpl::add_link().
+    void add_link(const std::string &connection_url) { _metrics_service.add_link(connection_url); }
+
+    // Also sends batches of all telemetry of every system to a multicast group,
+    // see TelemetryBatchServiceImpl::add_multicast().
+    bool start_multicast(const std::string &group_address, int port, float rate_hz);
+
+    // For clients in this process, without any socket or framing in between.
+    // Only valid after run().
+    std::shared_ptr<grpc::Channel> in_process_channel();
+
 private:
     void setup_port(grpc::ServerBuilder &builder);
 
+    static constexpr std::chrono::milliseconds SHUTDOWN_TIMEOUT {500};
+
     DroneCore &_dc;
+    const std::string _address;
+
+    // Used by the telemetry batch service, so it needs to outlive it.
+    MulticastSender _multicast_sender {};
 
     CoreServiceImpl<> _core;
-    Action _action;
+    // The plugins are created for each system that calls are for.
     ActionServiceImpl<> _action_service;
-    Mission _mission;
     MissionServiceImpl<> _mission_service;
-    Telemetry _telemetry;
+    MissionPackedServiceImpl<> _mission_packed_service;
+    OffboardServiceImpl<> _offboard_service;
     TelemetryServiceImpl<> _telemetry_service;
+    TelemetryBatchServiceImpl<> _telemetry_batch_service;
+    MessageStatsServiceImpl<> _message_stats_service;
+    MetricsServiceImpl<> _metrics_service;
 
+    StreamRouter _router;
     std::unique_ptr<grpc::Server> _server;
+    std::unique_ptr<grpc::ServerCompletionQueue> _cq;
+    CompletionQueueRunner _runner;
+
+    std::mutex _health_mutex {};
+    bool _system_discovered {false};
 };
 
 } // namespace backend
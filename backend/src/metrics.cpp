@@ -0,0 +1,113 @@
+#include "metrics.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+
+namespace dronecore {
+namespace backend {
+
+constexpr size_t LatencyHistogram::NUM_BUCKETS;
+const std::array<uint64_t, LatencyHistogram::NUM_BUCKETS> LatencyHistogram::BUCKET_BOUNDS_US = {{
+        100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000,
+        250000, 500000, 1000000, 2500000, 5000000
+    }
+};
+
+// Exact, unlike streaming a double.
+static std::string seconds_str(uint64_t us)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%" PRIu64 ".%06" PRIu64, us / 1000000, us % 1000000);
+    return buffer;
+}
+
+void LatencyHistogram::observe(std::chrono::steady_clock::duration duration)
+{
+    const auto duration_us = static_cast<uint64_t>(
+                                 std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+
+    size_t i = 0;
+    while (i < NUM_BUCKETS && duration_us > BUCKET_BOUNDS_US[i]) {
+        ++i;
+    }
+    _buckets[i].fetch_add(1, std::memory_order_relaxed);
+    _sum_us.fetch_add(duration_us, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::write(std::ostream &out, const std::string &name,
+                             const std::string &labels) const
+{
+    const std::string separator = labels.empty() ? "" : ",";
+
+    // The buckets are cumulative in the text format.
+    uint64_t count = 0;
+    for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+        count += _buckets[i].load(std::memory_order_relaxed);
+        out << name << "_bucket{" << labels << separator << "le=\""
+            << seconds_str(BUCKET_BOUNDS_US[i]) << "\"} " << count << "\n";
+    }
+    count += _buckets[NUM_BUCKETS].load(std::memory_order_relaxed);
+    out << name << "_bucket{" << labels << separator << "le=\"+Inf\"} " << count << "\n";
+
+    const std::string braced_labels = labels.empty() ? "" : "{" + labels + "}";
+    out << name << "_sum" << braced_labels << " "
+        << seconds_str(_sum_us.load(std::memory_order_relaxed)) << "\n";
+    out << name << "_count" << braced_labels << " " << count << "\n";
+}
+
+SyncCallMetrics &SyncCallMetrics::install()
+{
+    static SyncCallMetrics *metrics = nullptr;
+    static std::once_flag installed;
+    std::call_once(installed, []() {
+        // gRPC takes ownership, and keeps it until the process exits.
+        metrics = new SyncCallMetrics();
+        grpc::Server::SetGlobalCallbacks(metrics);
+    });
+    return *metrics;
+}
+
+// Both are called on the thread handling the call.
+static thread_local std::chrono::steady_clock::time_point call_start;
+
+void SyncCallMetrics::PreSynchronousRequest(grpc::ServerContext * /* context */)
+{
+    _in_flight.fetch_add(1, std::memory_order_relaxed);
+    call_start = std::chrono::steady_clock::now();
+}
+
+void SyncCallMetrics::PostSynchronousRequest(grpc::ServerContext * /* context */)
+{
+    _latency.observe(std::chrono::steady_clock::now() - call_start);
+    _in_flight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void SyncCallMetrics::write(std::ostream &out) const
+{
+    static const std::string IN_FLIGHT = "dronecore_backend_sync_calls_in_flight";
+    write_metric_type(out, IN_FLIGHT, "gauge");
+    write_metric_sample(out, IN_FLIGHT, "", _in_flight.load(std::memory_order_relaxed));
+
+    static const std::string DURATION = "dronecore_backend_sync_call_duration_seconds";
+    write_metric_type(out, DURATION, "histogram");
+    _latency.write(out, DURATION, "");
+}
+
+void write_metric_type(std::ostream &out, const std::string &name, const char *type)
+{
+    out << "# TYPE " << name << " " << type << "\n";
+}
+
+void write_metric_sample(std::ostream &out, const std::string &name,
+                         const std::string &labels, int64_t value)
+{
+    out << name;
+    if (!labels.empty()) {
+        out << "{" << labels << "}";
+    }
+    out << " " << value << "\n";
+}
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <grpc++/grpc++.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace dronecore {
+namespace backend {
+
+// The metrics of the backend are only relaxed atomic updates where they are
+// counted, and are put together and formatted when scraped, in the Prometheus
+// text format.
+
+// Durations in fixed buckets.
+class LatencyHistogram
+{
+public:
+    static constexpr size_t NUM_BUCKETS = 15;
+    static const std::array<uint64_t, NUM_BUCKETS> BUCKET_BOUNDS_US;
+
+    void observe(std::chrono::steady_clock::duration duration);
+
+    // Writes the buckets, sum and count of a metric declared by the caller.
+    // The labels are either empty or like `method="/a.B/C"`.
+    void write(std::ostream &out, const std::string &name, const std::string &labels) const;
+
+private:
+    // The last one is for everything above the bounds.
+    std::array<std::atomic<uint64_t>, NUM_BUCKETS + 1> _buckets {};
+    std::atomic<uint64_t> _sum_us {0};
+};
+
+// Of one server streaming method, see StreamRouter.
+struct StreamMetrics {
+    std::atomic<uint64_t> started {0};
+    std::atomic<uint64_t> ended {0};
+    std::atomic<uint64_t> written {0};
+    std::atomic<uint64_t> dropped {0};
+    // Responses queued to be written, over all streams.
+    std::atomic<int64_t> queued {0};
+};
+
+// Counts and times the calls handled by the synchronous services of all
+// servers. gRPC only allows to install this once, before the first server of
+// the process is created.
+class SyncCallMetrics : public grpc::Server::GlobalCallbacks
+{
+public:
+    static SyncCallMetrics &install();
+
+    void PreSynchronousRequest(grpc::ServerContext *context) override;
+    void PostSynchronousRequest(grpc::ServerContext *context) override;
+
+    void write(std::ostream &out) const;
+
+private:
+    std::atomic<int64_t> _in_flight {0};
+    LatencyHistogram _latency {};
+};
+
+// The type line comes once before all samples of a metric.
+void write_metric_type(std::ostream &out, const std::string &name, const char *type);
+void write_metric_sample(std::ostream &out, const std::string &name,
+                         const std::string &labels, int64_t value);
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,108 @@
+#include "multicast_sender.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cstring>
+
+#include "log.h"
+
+namespace dronecore {
+namespace backend {
+
+constexpr uint32_t MulticastSender::MAGIC;
+constexpr size_t MulticastSender::HEADER_SIZE;
+constexpr size_t MulticastSender::MAX_PAYLOAD_SIZE;
+
+MulticastSender::~MulticastSender()
+{
+    close();
+}
+
+bool MulticastSender::open(const std::string &group_address, int port, int ttl)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_socket_fd >= 0) {
+        LogErr() << "Multicast already open";
+        return false;
+    }
+
+    in_addr group;
+    if (inet_pton(AF_INET, group_address.c_str(), &group) != 1 ||
+        !IN_MULTICAST(ntohl(group.s_addr)) || port <= 0 || port > 65535) {
+        LogErr() << "Not a multicast group: " << group_address << ":" << port;
+        return false;
+    }
+
+    const int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        LogErr() << "socket error: " << strerror(errno);
+        return false;
+    }
+
+    const unsigned char multicast_ttl = static_cast<unsigned char>(ttl);
+    if (setsockopt(socket_fd, IPPROTO_IP, IP_MULTICAST_TTL, &multicast_ttl,
+                   sizeof(multicast_ttl)) != 0) {
+        LogErr() << "IP_MULTICAST_TTL error: " << strerror(errno);
+        ::close(socket_fd);
+        return false;
+    }
+
+    _socket_fd = socket_fd;
+    _group_ip = group.s_addr;
+    _port = htons(static_cast<uint16_t>(port));
+    LogInfo() << "Publishing telemetry to multicast " << group_address << ":" << port;
+    return true;
+}
+
+void MulticastSender::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_socket_fd >= 0) {
+        ::close(_socket_fd);
+        _socket_fd = -1;
+    }
+}
+
+bool MulticastSender::send(uint64_t uuid, const std::string &payload)
+{
+    if (payload.size() > MAX_PAYLOAD_SIZE) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_socket_fd < 0) {
+        return false;
+    }
+
+    frame(_sequence++, uuid, payload, _datagram);
+
+    sockaddr_in dest_addr {};
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_addr.s_addr = _group_ip;
+    dest_addr.sin_port = _port;
+
+    const auto sent = sendto(_socket_fd, _datagram.data(), _datagram.size(), 0,
+                             reinterpret_cast<const sockaddr *>(&dest_addr), sizeof(dest_addr));
+    return sent == static_cast<ssize_t>(_datagram.size());
+}
+
+void MulticastSender::frame(uint32_t sequence, uint64_t uuid, const std::string &payload,
+                            std::string &datagram)
+{
+    datagram.resize(HEADER_SIZE);
+    auto put = [&datagram](size_t offset, uint64_t value, unsigned num_bytes) {
+        for (unsigned i = 0; i < num_bytes; ++i) {
+            datagram[offset + i] = static_cast<char>((value >> (8 * (num_bytes - 1 - i))) & 0xff);
+        }
+    };
+    put(0, MAGIC, 4);
+    put(4, sequence, 4);
+    put(8, uuid, 8);
+    datagram.append(payload);
+}
+
+} // namespace backend
+} // namespace dronecore
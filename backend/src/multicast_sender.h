@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace dronecore {
+namespace backend {
+
+// Sends datagrams to a UDP multicast group, so that any number of receivers on
+// the network get them for the cost of one send.
+//
+// Each datagram starts with a header in network byte order, then the payload:
+// - magic "DCTB" (4 bytes)
+// - sequence number (uint32), one more for every datagram, for receivers to
+//   tell what they missed
+// - UUID of the system the payload is about (uint64)
+class MulticastSender
+{
+public:
+    static constexpr uint32_t MAGIC = 0x44435442;
+    static constexpr size_t HEADER_SIZE = 16;
+    // Datagrams above this would be fragmented on an ethernet.
+    static constexpr size_t MAX_PAYLOAD_SIZE = 1500 - 28 - HEADER_SIZE;
+
+    MulticastSender() = default;
+    ~MulticastSender();
+
+    // The group is like "239.255.0.1", the TTL is how many routers datagrams
+    // cross, 1 stays in the local network.
+    bool open(const std::string &group_address, int port, int ttl = 1);
+    void close();
+
+    // Returns false if not open, too big or the socket failed.
+    bool send(uint64_t uuid, const std::string &payload);
+
+    static void frame(uint32_t sequence, uint64_t uuid, const std::string &payload,
+                      std::string &datagram);
+
+    // Non-copyable
+    MulticastSender(const MulticastSender &) = delete;
+    const MulticastSender &operator=(const MulticastSender &) = delete;
+
+private:
+    std::mutex _mutex {};
+    int _socket_fd {-1};
+    // Both in network byte order.
+    uint32_t _group_ip {0};
+    uint16_t _port {0};
+
+    uint32_t _sequence {0};
+    // Kept to not allocate for every datagram.
+    std::string _datagram {};
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <grpc++/grpc++.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "dronecore.h"
+
+namespace dronecore {
+namespace backend {
+
+// Client metadata with the UUID of the system a call is for, in decimal.
+// Calls without it are for the first discovered system.
+static constexpr const char *UUID_METADATA_KEY = "dronecore-uuid";
+
+// Returns false if the call does not ask for a system, or not a valid UUID.
+inline bool get_requested_uuid(const grpc::ServerContext *context, uint64_t &uuid)
+{
+    if (context == nullptr) {
+        return false;
+    }
+
+    const auto &metadata = context->client_metadata();
+    const auto it = metadata.find(UUID_METADATA_KEY);
+    if (it == metadata.end()) {
+        return false;
+    }
+
+    const std::string value(it->second.data(), it->second.size());
+    char *end = nullptr;
+    uuid = std::strtoull(value.c_str(), &end, 10);
+    return !value.empty() && *end == '\0';
+}
+
+// The instances of one plugin, created for a system the first time a call is
+// for it, and kept for as long as the backend runs.
+template <typename Plugin, typename DroneCore = DroneCore>
+class PluginInstances
+{
+public:
+    // One instance per system of dc.
+    explicit PluginInstances(DroneCore &dc)
+        : _dc(&dc) {}
+
+    // The same instance for all calls, whichever system they ask for.
+    explicit PluginInstances(Plugin &plugin)
+        : _single(&plugin) {}
+
+    // Returns nullptr if the system asked for is not discovered (yet).
+    Plugin *get(const grpc::ServerContext *context)
+    {
+        if (_single != nullptr) {
+            return _single;
+        }
+
+        uint64_t uuid;
+        if (!get_requested_uuid(context, uuid)) {
+            const auto uuids = _dc->system_uuids();
+            if (uuids.empty()) {
+                return nullptr;
+            }
+            uuid = uuids.front();
+        }
+        return get(uuid);
+    }
+
+    // The systems discovered, or only 0 for the single instance.
+    std::vector<uint64_t> uuids() const
+    {
+        if (_single != nullptr) {
+            return std::vector<uint64_t> {0};
+        }
+        return _dc->system_uuids();
+    }
+
+    Plugin *get(uint64_t uuid)
+    {
+        if (_single != nullptr) {
+            return _single;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _instances.find(uuid);
+        if (it != _instances.end()) {
+            return it->second.get();
+        }
+
+        const auto uuids = _dc->system_uuids();
+        if (std::find(uuids.begin(), uuids.end(), uuid) == uuids.end()) {
+            return nullptr;
+        }
+
+        auto plugin = new Plugin(_dc->system(uuid));
+        _instances[uuid] = std::unique_ptr<Plugin>(plugin);
+        return plugin;
+    }
+
+    // Non-copyable
+    PluginInstances(const PluginInstances &) = delete;
+    const PluginInstances &operator=(const PluginInstances &) = delete;
+
+private:
+    DroneCore *_dc {nullptr};
+    Plugin *_single {nullptr};
+
+    std::mutex _mutex {};
+    std::map<uint64_t, std::unique_ptr<Plugin>> _instances {};
+};
+
+// What a call for a system which is not there gets.
+inline grpc::Status system_not_found_status()
+{
+    return grpc::Status(grpc::StatusCode::NOT_FOUND, "No such system");
+}
+
+} // namespace backend
+} // namespace dronecore
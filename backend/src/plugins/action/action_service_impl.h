@@ -1,5 +1,6 @@
 #include "action/action.h"
 #include "action/action.grpc.pb.h"
+#include "plugin_instances.h"
 
 namespace dronecore {
 namespace backend {
@@ -9,13 +10,22 @@ class ActionServiceImpl final : public rpc::action::ActionService::Service
 {
 public:
     ActionServiceImpl(Action &action)
-        : _action(action) {}
+        : _actions(action) {}
 
-    grpc::Status Arm(grpc::ServerContext * /* context */,
+    // Calls are for the system in their metadata, see UUID_METADATA_KEY.
+    ActionServiceImpl(DroneCore &dc)
+        : _actions(dc) {}
+
+    grpc::Status Arm(grpc::ServerContext *context,
                      const rpc::action::ArmRequest * /* request */,
                      rpc::action::ArmResponse *response) override
     {
-        auto action_result = _action.arm();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->arm();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -29,18 +39,21 @@ public:
     {
         auto rpc_result = static_cast<rpc::action::ActionResult::Result>(action_result);
 
-        auto *rpc_action_result = new rpc::action::ActionResult();
+        auto *rpc_action_result = response->mutable_action_result();
         rpc_action_result->set_result(rpc_result);
         rpc_action_result->set_result_str(action_result_str(action_result));
-
-        response->set_allocated_action_result(rpc_action_result);
     }
 
-    grpc::Status Disarm(grpc::ServerContext * /* context */,
+    grpc::Status Disarm(grpc::ServerContext *context,
                         const rpc::action::DisarmRequest * /* request */,
                         rpc::action::DisarmResponse *response) override
     {
-        auto action_result = _action.disarm();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->disarm();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -49,11 +62,16 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status Takeoff(grpc::ServerContext * /* context */,
+    grpc::Status Takeoff(grpc::ServerContext *context,
                          const rpc::action::TakeoffRequest * /* request */,
                          rpc::action::TakeoffResponse *response) override
     {
-        auto action_result = _action.takeoff();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->takeoff();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -62,11 +80,16 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status Land(grpc::ServerContext * /* context */,
+    grpc::Status Land(grpc::ServerContext *context,
                       const rpc::action::LandRequest * /* request */,
                       rpc::action::LandResponse *response) override
     {
-        auto action_result = _action.land();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->land();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -75,11 +98,16 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status Kill(grpc::ServerContext * /* context */,
+    grpc::Status Kill(grpc::ServerContext *context,
                       const rpc::action::KillRequest * /* request */,
                       rpc::action::KillResponse *response) override
     {
-        auto action_result = _action.kill();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->kill();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -88,11 +116,16 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status ReturnToLaunch(grpc::ServerContext * /* context */,
+    grpc::Status ReturnToLaunch(grpc::ServerContext *context,
                                 const rpc::action::ReturnToLaunchRequest * /* request */,
                                 rpc::action::ReturnToLaunchResponse *response) override
     {
-        auto action_result = _action.return_to_launch();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->return_to_launch();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -101,11 +134,16 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status TransitionToFixedWings(grpc::ServerContext * /* context */,
+    grpc::Status TransitionToFixedWings(grpc::ServerContext *context,
                                         const rpc::action::TransitionToFixedWingsRequest * /* request */,
                                         rpc::action::TransitionToFixedWingsResponse *response) override
     {
-        auto action_result = _action.transition_to_fixedwing();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->transition_to_fixedwing();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -114,11 +152,16 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status TransitionToMulticopter(grpc::ServerContext * /* context */,
+    grpc::Status TransitionToMulticopter(grpc::ServerContext *context,
                                          const rpc::action::TransitionToMulticopterRequest * /* request */,
                                          rpc::action::TransitionToMulticopterResponse *response) override
     {
-        auto action_result = _action.transition_to_multicopter();
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto action_result = action->transition_to_multicopter();
 
         if (response != nullptr) {
             fillResponseWithResult(response, action_result);
@@ -127,56 +170,76 @@ public:
         return grpc::Status::OK;
     }
 
-    grpc::Status GetTakeoffAltitude(grpc::ServerContext * /* context */,
+    grpc::Status GetTakeoffAltitude(grpc::ServerContext *context,
                                     const rpc::action::GetTakeoffAltitudeRequest * /* request */,
                                     rpc::action::GetTakeoffAltitudeResponse *response) override
     {
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
         if (response != nullptr) {
-            auto takeoff_altitude = _action.get_takeoff_altitude_m();
+            auto takeoff_altitude = action->get_takeoff_altitude_m();
             response->set_altitude_m(takeoff_altitude);
         }
 
         return grpc::Status::OK;
     }
 
-    grpc::Status SetTakeoffAltitude(grpc::ServerContext * /* context */,
+    grpc::Status SetTakeoffAltitude(grpc::ServerContext *context,
                                     const rpc::action::SetTakeoffAltitudeRequest *request,
                                     rpc::action::SetTakeoffAltitudeResponse * /* response */) override
     {
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
         if (request != nullptr) {
             const auto requested_altitude = request->altitude_m();
-            _action.set_takeoff_altitude(requested_altitude);
+            action->set_takeoff_altitude(requested_altitude);
         }
 
         return grpc::Status::OK;
     }
 
-    grpc::Status GetMaximumSpeed(grpc::ServerContext * /* context */,
+    grpc::Status GetMaximumSpeed(grpc::ServerContext *context,
                                  const rpc::action::GetMaximumSpeedRequest * /* request */,
                                  rpc::action::GetMaximumSpeedResponse *response) override
     {
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
         if (response != nullptr) {
-            auto max_speed = _action.get_max_speed_m_s();
+            auto max_speed = action->get_max_speed_m_s();
             response->set_speed_m_s(max_speed);
         }
 
         return grpc::Status::OK;
     }
 
-    grpc::Status SetMaximumSpeed(grpc::ServerContext * /* context */,
+    grpc::Status SetMaximumSpeed(grpc::ServerContext *context,
                                  const rpc::action::SetMaximumSpeedRequest *request,
                                  rpc::action::SetMaximumSpeedResponse * /* response */) override
     {
+        auto action = _actions.get(context);
+        if (action == nullptr) {
+            return system_not_found_status();
+        }
+
         if (request != nullptr) {
             const auto requested_speed = request->speed_m_s();
-            _action.set_max_speed(requested_speed);
+            action->set_max_speed(requested_speed);
         }
 
         return grpc::Status::OK;
     }
 
 private:
-    Action &_action;
+    PluginInstances<Action> _actions;
 };
 
 } // namespace backend
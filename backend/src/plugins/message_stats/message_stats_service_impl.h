@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "dronecore.h"
+#include "message_stats/message_stats.grpc.pb.h"
+#include "plugin_instances.h"
+#include "system.h"
+
+namespace dronecore {
+namespace backend {
+
+// Calls are for the system in their metadata, see UUID_METADATA_KEY.
+template <typename DroneCore = DroneCore>
+class MessageStatsServiceImpl final : public rpc::message_stats::MessageStatsService::Service
+{
+public:
+    MessageStatsServiceImpl(DroneCore &dc)
+        : _dc(dc) {}
+
+    grpc::Status GetMessageStats(grpc::ServerContext *context,
+                                 const rpc::message_stats::GetMessageStatsRequest * /* request */,
+                                 rpc::message_stats::GetMessageStatsResponse *response) override
+    {
+        System *system = get_system(context);
+        if (system == nullptr) {
+            return system_not_found_status();
+        }
+
+        if (response != nullptr) {
+            fillRPCMessageStats(system->get_message_stats(), system->get_num_messages_lost(),
+                                response);
+        }
+
+        return grpc::Status::OK;
+    }
+
+    grpc::Status ResetMessageStats(grpc::ServerContext *context,
+                                   const rpc::message_stats::ResetMessageStatsRequest * /* request */,
+                                   rpc::message_stats::ResetMessageStatsResponse * /* response */) override
+    {
+        System *system = get_system(context);
+        if (system == nullptr) {
+            return system_not_found_status();
+        }
+
+        system->reset_message_stats();
+        return grpc::Status::OK;
+    }
+
+    static void fillRPCMessageStats(const std::vector<System::MessageStats> &message_stats,
+                                    uint64_t num_messages_lost,
+                                    rpc::message_stats::GetMessageStatsResponse *response)
+    {
+        response->mutable_message_stats()->Reserve(static_cast<int>(message_stats.size()));
+        for (const auto &stats : message_stats) {
+            auto rpc_stats = response->add_message_stats();
+            rpc_stats->set_message_id(stats.message_id);
+            rpc_stats->set_count(stats.count);
+            rpc_stats->set_bytes(stats.bytes);
+            rpc_stats->set_average_interval_s(stats.average_interval_s);
+            rpc_stats->set_max_gap_s(stats.max_gap_s);
+        }
+        response->set_num_messages_lost(num_messages_lost);
+    }
+
+private:
+    // Returns nullptr if the system asked for is not discovered (yet).
+    System *get_system(const grpc::ServerContext *context)
+    {
+        const auto uuids = _dc.system_uuids();
+
+        uint64_t uuid;
+        if (!get_requested_uuid(context, uuid)) {
+            if (uuids.empty()) {
+                return nullptr;
+            }
+            uuid = uuids.front();
+        }
+
+        if (std::find(uuids.begin(), uuids.end(), uuid) == uuids.end()) {
+            return nullptr;
+        }
+        return &_dc.system(uuid);
+    }
+
+    DroneCore &_dc;
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,128 @@
+#include <cstdint>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dronecore.h"
+#include "metrics.h"
+#include "metrics/metrics.grpc.pb.h"
+#include "stream_router.h"
+
+namespace dronecore {
+namespace backend {
+
+// Puts together the metrics of the backend and the traffic counters of the
+// MAVLink links, only when scraped.
+template <typename DroneCore = DroneCore>
+class MetricsServiceImpl final : public rpc::metrics::MetricsService::Service
+{
+public:
+    // Without sync_calls, e.g. when the callbacks of gRPC could not be installed,
+    // the synchronous calls are not in the metrics.
+    MetricsServiceImpl(DroneCore &dc, const StreamRouter &router,
+                       const SyncCallMetrics *sync_calls = nullptr)
+        : _dc(dc),
+          _router(router),
+          _sync_calls(sync_calls) {}
+
+    // A connection as used for add_any_connection(), e.g. "udp://0.0.0.0:14540".
+    void add_link(const std::string &connection_url)
+    {
+        std::lock_guard<std::mutex> lock(_links_mutex);
+        _links.push_back(connection_url);
+    }
+
+    grpc::Status GetMetrics(grpc::ServerContext * /* context */,
+                            const rpc::metrics::GetMetricsRequest * /* request */,
+                            rpc::metrics::GetMetricsResponse *response) override
+    {
+        if (response != nullptr) {
+            response->set_text(metrics_text());
+        }
+
+        return grpc::Status::OK;
+    }
+
+    std::string metrics_text() const
+    {
+        std::ostringstream out;
+
+        if (_sync_calls != nullptr) {
+            _sync_calls->write(out);
+        }
+        _router.write_metrics(out);
+        writeLinkMetrics(out);
+
+        return out.str();
+    }
+
+private:
+    typedef typename DroneCore::LinkStats LinkStats;
+    typedef std::vector<std::pair<std::string, LinkStats>> link_stats_t;
+
+    void writeLinkMetrics(std::ostream &out) const
+    {
+        link_stats_t link_stats;
+        {
+            std::lock_guard<std::mutex> lock(_links_mutex);
+            for (const auto &url : _links) {
+                LinkStats stats {};
+                if (_dc.get_link_stats(url, stats)) {
+                    link_stats.push_back(std::make_pair(url, stats));
+                }
+            }
+        }
+
+        writeLinkMetric(out, link_stats, "dronecore_link_bytes_received_total",
+                        &LinkStats::bytes_received);
+        writeLinkMetric(out, link_stats, "dronecore_link_bytes_sent_total",
+                        &LinkStats::bytes_sent);
+        writeLinkMetric(out, link_stats, "dronecore_link_frames_parsed_total",
+                        &LinkStats::frames_parsed);
+        writeLinkMetric(out, link_stats, "dronecore_link_crc_errors_total",
+                        &LinkStats::crc_errors);
+        writeLinkMetric(out, link_stats, "dronecore_link_parse_errors_total",
+                        &LinkStats::parse_errors);
+        writeLinkMetric(out, link_stats, "dronecore_link_sequence_gaps_total",
+                        &LinkStats::sequence_gaps);
+        writeLinkMetric(out, link_stats, "dronecore_link_spin_time_microseconds_total",
+                        &LinkStats::spin_time_us);
+        writeLinkMetric(out, link_stats, "dronecore_link_park_time_microseconds_total",
+                        &LinkStats::park_time_us);
+        writeLinkMetric(out, link_stats, "dronecore_link_tx_queued",
+                        &LinkStats::tx_queued, "gauge");
+        writeLinkMetric(out, link_stats, "dronecore_link_tx_dropped_total",
+                        &LinkStats::tx_dropped);
+        writeLinkMetric(out, link_stats, "dronecore_link_control_frames_sent_total",
+                        &LinkStats::control_frames_sent);
+        writeLinkMetric(out, link_stats, "dronecore_link_bulk_frames_sent_total",
+                        &LinkStats::bulk_frames_sent);
+    }
+
+    static void writeLinkMetric(std::ostream &out, const link_stats_t &link_stats,
+                                const std::string &name, uint64_t LinkStats::*field,
+                                const char *type = "counter")
+    {
+        if (link_stats.empty()) {
+            return;
+        }
+
+        write_metric_type(out, name, type);
+        for (const auto &link : link_stats) {
+            write_metric_sample(out, name, "link=\"" + link.first + "\"",
+                                static_cast<int64_t>(link.second.*field));
+        }
+    }
+
+    DroneCore &_dc;
+    const StreamRouter &_router;
+    const SyncCallMetrics *const _sync_calls;
+
+    mutable std::mutex _links_mutex {};
+    std::vector<std::string> _links {};
+};
+
+} // namespace backend
+} // namespace dronecore
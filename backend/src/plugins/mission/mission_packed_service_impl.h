@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "mission/mission.h"
+#include "mission/mission_item.h"
+#include "mission/mission_service_impl.h"
+#include "mission_packed/mission_packed.grpc.pb.h"
+#include "plugin_instances.h"
+
+namespace dronecore {
+namespace backend {
+
+template <typename Mission = Mission>
+class MissionPackedServiceImpl final : public rpc::mission_packed::MissionPackedService::Service
+{
+public:
+    static constexpr unsigned DEFAULT_ITEMS_PER_CHUNK = 1000;
+    // Keeps a chunk well below the default message size limit of gRPC.
+    static constexpr unsigned MAX_ITEMS_PER_CHUNK = 10000;
+
+    MissionPackedServiceImpl(Mission &mission)
+        : _missions(mission) {}
+
+    // Calls are for the system in their metadata, see UUID_METADATA_KEY.
+    MissionPackedServiceImpl(DroneCore &dc)
+        : _missions(dc) {}
+
+    grpc::Status UploadMissionPacked(grpc::ServerContext *context,
+                                     grpc::ServerReader<rpc::mission_packed::PackedMissionItems> *reader,
+                                     rpc::mission_packed::UploadMissionPackedResponse *response) override
+    {
+        auto mission = _missions.get(context);
+        if (mission == nullptr) {
+            return system_not_found_status();
+        }
+
+        std::vector<std::shared_ptr<MissionItem>> mission_items;
+        rpc::mission_packed::PackedMissionItems chunk;
+        while (reader->Read(&chunk)) {
+            if (!appendMissionItems(chunk, mission_items)) {
+                return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT,
+                                    "Columns of a chunk differ in length");
+            }
+        }
+
+        std::promise<void> result_promise;
+        const auto result_future = result_promise.get_future();
+
+        mission->upload_mission_async(mission_items, [response,
+              &result_promise](const dronecore::Mission::Result result) {
+            if (response != nullptr) {
+                MissionServiceImpl<Mission>::fillRPCMissionResult(response->mutable_mission_result(),
+                                                                  result);
+            }
+
+            result_promise.set_value();
+        });
+
+        result_future.wait();
+        return grpc::Status::OK;
+    }
+
+    grpc::Status DownloadMissionPacked(grpc::ServerContext *context,
+                                       const rpc::mission_packed::DownloadMissionPackedRequest *request,
+                                       grpc::ServerWriter<rpc::mission_packed::DownloadMissionPackedResponse> *writer)
+    override
+    {
+        auto mission = _missions.get(context);
+        if (mission == nullptr) {
+            return system_not_found_status();
+        }
+
+        std::promise<void> result_promise;
+        const auto result_future = result_promise.get_future();
+
+        auto result = dronecore::Mission::Result::UNKNOWN;
+        std::vector<std::shared_ptr<MissionItem>> mission_items;
+        mission->download_mission_async([&result, &mission_items, &result_promise](
+                                            dronecore::Mission::Result callback_result,
+        std::vector<std::shared_ptr<MissionItem>> callback_mission_items) {
+            result = callback_result;
+            mission_items = std::move(callback_mission_items);
+            result_promise.set_value();
+        });
+
+        result_future.wait();
+
+        unsigned items_per_chunk = DEFAULT_ITEMS_PER_CHUNK;
+        if (request != nullptr && request->max_items_per_chunk() > 0) {
+            items_per_chunk = std::min(request->max_items_per_chunk(), MAX_ITEMS_PER_CHUNK);
+        }
+
+        // Reused for all chunks, the columns keep their capacity when cleared.
+        rpc::mission_packed::DownloadMissionPackedResponse response;
+        MissionServiceImpl<Mission>::fillRPCMissionResult(response.mutable_mission_result(), result);
+
+        size_t begin = 0;
+        do {
+            const size_t end = std::min(begin + items_per_chunk, mission_items.size());
+            fillPackedMissionItems(mission_items, begin, end, response.mutable_mission_items());
+            if (!writer->Write(response)) {
+                break;
+            }
+            begin = end;
+        } while (begin < mission_items.size());
+
+        return grpc::Status::OK;
+    }
+
+    // Returns false if the columns are not all of the same length.
+    static bool appendMissionItems(const rpc::mission_packed::PackedMissionItems &chunk,
+                                   std::vector<std::shared_ptr<MissionItem>> &mission_items)
+    {
+        const int size = chunk.latitude_deg_size();
+        if (chunk.longitude_deg_size() != size
+            || !isColumnOfSize(chunk.relative_altitude_m_size(), size)
+            || !isColumnOfSize(chunk.speed_m_s_size(), size)
+            || !isColumnOfSize(chunk.is_fly_through_size(), size)
+            || !isColumnOfSize(chunk.gimbal_pitch_deg_size(), size)
+            || !isColumnOfSize(chunk.gimbal_yaw_deg_size(), size)
+            || !isColumnOfSize(chunk.camera_action_size(), size)) {
+            return false;
+        }
+
+        mission_items.reserve(mission_items.size() + size);
+        for (int i = 0; i < size; ++i) {
+            auto mission_item = std::make_shared<MissionItem>();
+            mission_item->set_position(chunk.latitude_deg(i), chunk.longitude_deg(i));
+            if (chunk.relative_altitude_m_size() > 0) {
+                mission_item->set_relative_altitude(chunk.relative_altitude_m(i));
+            }
+            if (chunk.speed_m_s_size() > 0) {
+                mission_item->set_speed(chunk.speed_m_s(i));
+            }
+            if (chunk.is_fly_through_size() > 0) {
+                mission_item->set_fly_through(chunk.is_fly_through(i));
+            }
+            if (chunk.gimbal_pitch_deg_size() > 0 || chunk.gimbal_yaw_deg_size() > 0) {
+                mission_item->set_gimbal_pitch_and_yaw(
+                    chunk.gimbal_pitch_deg_size() > 0 ? chunk.gimbal_pitch_deg(i) : NAN,
+                    chunk.gimbal_yaw_deg_size() > 0 ? chunk.gimbal_yaw_deg(i) : NAN);
+            }
+            if (chunk.camera_action_size() > 0) {
+                mission_item->set_camera_action(MissionServiceImpl<Mission>::translateRPCCameraAction(
+                                                    chunk.camera_action(i)));
+            }
+            mission_items.push_back(mission_item);
+        }
+
+        return true;
+    }
+
+    static void fillPackedMissionItems(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+                                       size_t begin, size_t end,
+                                       rpc::mission_packed::PackedMissionItems *packed_items)
+    {
+        packed_items->Clear();
+
+        const int size = static_cast<int>(end - begin);
+        packed_items->mutable_latitude_deg()->Reserve(size);
+        packed_items->mutable_longitude_deg()->Reserve(size);
+        packed_items->mutable_relative_altitude_m()->Reserve(size);
+        packed_items->mutable_speed_m_s()->Reserve(size);
+        packed_items->mutable_is_fly_through()->Reserve(size);
+        packed_items->mutable_gimbal_pitch_deg()->Reserve(size);
+        packed_items->mutable_gimbal_yaw_deg()->Reserve(size);
+        packed_items->mutable_camera_action()->Reserve(size);
+
+        for (size_t i = begin; i < end; ++i) {
+            const auto &mission_item = *mission_items[i];
+            packed_items->add_latitude_deg(mission_item.get_latitude_deg());
+            packed_items->add_longitude_deg(mission_item.get_longitude_deg());
+            packed_items->add_relative_altitude_m(mission_item.get_relative_altitude_m());
+            packed_items->add_speed_m_s(mission_item.get_speed_m_s());
+            packed_items->add_is_fly_through(mission_item.get_fly_through());
+            packed_items->add_gimbal_pitch_deg(mission_item.get_gimbal_pitch_deg());
+            packed_items->add_gimbal_yaw_deg(mission_item.get_gimbal_yaw_deg());
+            packed_items->add_camera_action(MissionServiceImpl<Mission>::translateCameraAction(
+                                                mission_item.get_camera_action()));
+        }
+    }
+
+private:
+    static bool isColumnOfSize(int column_size, int size)
+    {
+        return column_size == 0 || column_size == size;
+    }
+
+    PluginInstances<Mission> _missions;
+};
+
+template <typename Mission>
+constexpr unsigned MissionPackedServiceImpl<Mission>::DEFAULT_ITEMS_PER_CHUNK;
+template <typename Mission>
+constexpr unsigned MissionPackedServiceImpl<Mission>::MAX_ITEMS_PER_CHUNK;
+
+} // namespace backend
+} // namespace dronecore
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <future>
 
 #include <memory>
@@ -6,6 +8,7 @@
 #include "mission/mission.h"
 #include "mission/mission.grpc.pb.h"
 #include "mission/mission_item.h"
+#include "plugin_instances.h"
 
 namespace dronecore {
 namespace backend {
@@ -15,34 +18,47 @@ class MissionServiceImpl final : public dronecore::rpc::mission::MissionService:
 {
 public:
     MissionServiceImpl(Mission &mission)
-        : _mission(mission) {}
+        : _missions(mission) {}
+
+    // Calls are for the system in their metadata, see UUID_METADATA_KEY.
+    MissionServiceImpl(DroneCore &dc)
+        : _missions(dc) {}
 
-    grpc::Status UploadMission(grpc::ServerContext * /* context */,
+    grpc::Status UploadMission(grpc::ServerContext *context,
                                const rpc::mission::UploadMissionRequest *request,
                                rpc::mission::UploadMissionResponse *response) override
     {
+        auto mission = _missions.get(context);
+        if (mission == nullptr) {
+            return system_not_found_status();
+        }
+
         std::promise<void> result_promise;
         const auto result_future = result_promise.get_future();
 
         const auto mission_items = extractMissionItems(request);
-        uploadMissionItems(mission_items, response, result_promise);
+        uploadMissionItems(*mission, mission_items, response, result_promise);
 
         result_future.wait();
         return grpc::Status::OK;
     }
 
-    grpc::Status StartMission(grpc::ServerContext * /* context */,
+    grpc::Status StartMission(grpc::ServerContext *context,
                               const rpc::mission::StartMissionRequest * /* request */,
                               rpc::mission::StartMissionResponse *response) override
     {
+        auto mission = _missions.get(context);
+        if (mission == nullptr) {
+            return system_not_found_status();
+        }
+
         std::promise<void> result_promise;
         const auto result_future = result_promise.get_future();
 
-        _mission.start_mission_async([this, response,
+        mission->start_mission_async([response,
               &result_promise](const dronecore::Mission::Result result) {
             if (response != nullptr) {
-                auto rpc_mission_result = generateRPCMissionResult(result);
-                response->set_allocated_mission_result(rpc_mission_result);
+                fillRPCMissionResult(response->mutable_mission_result(), result);
             }
 
             result_promise.set_value();
@@ -52,6 +68,55 @@ public:
         return grpc::Status::OK;
     }
 
+    static MissionItem::CameraAction
+    translateRPCCameraAction(const rpc::mission::MissionItem::CameraAction rpc_camera_action)
+    {
+        switch (rpc_camera_action) {
+            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_TAKE_PHOTO:
+                return MissionItem::CameraAction::TAKE_PHOTO;
+            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_START_PHOTO_INTERVAL:
+                return MissionItem::CameraAction::START_PHOTO_INTERVAL;
+            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_STOP_PHOTO_INTERVAL:
+                return MissionItem::CameraAction::STOP_PHOTO_INTERVAL;
+            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_START_VIDEO:
+                return MissionItem::CameraAction::START_VIDEO;
+            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_STOP_VIDEO:
+                return MissionItem::CameraAction::STOP_VIDEO;
+            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_NONE:
+            default:
+                return MissionItem::CameraAction::NONE;
+        }
+    }
+
+    static rpc::mission::MissionItem::CameraAction
+    translateCameraAction(const MissionItem::CameraAction camera_action)
+    {
+        switch (camera_action) {
+            case MissionItem::CameraAction::TAKE_PHOTO:
+                return rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_TAKE_PHOTO;
+            case MissionItem::CameraAction::START_PHOTO_INTERVAL:
+                return rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_START_PHOTO_INTERVAL;
+            case MissionItem::CameraAction::STOP_PHOTO_INTERVAL:
+                return rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_STOP_PHOTO_INTERVAL;
+            case MissionItem::CameraAction::START_VIDEO:
+                return rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_START_VIDEO;
+            case MissionItem::CameraAction::STOP_VIDEO:
+                return rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_STOP_VIDEO;
+            case MissionItem::CameraAction::NONE:
+            default:
+                return rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_NONE;
+        }
+    }
+
+    static void fillRPCMissionResult(rpc::mission::MissionResult *rpc_mission_result,
+                                     const dronecore::Mission::Result result)
+    {
+        auto rpc_result = static_cast<rpc::mission::MissionResult::Result>(result);
+
+        rpc_mission_result->set_result(rpc_result);
+        rpc_mission_result->set_result_str(dronecore::Mission::result_str(result));
+    }
+
 private:
     std::vector<std::shared_ptr<MissionItem>> extractMissionItems(const
                                                                   rpc::mission::UploadMissionRequest *request) const
@@ -59,7 +124,8 @@ private:
         std::vector<std::shared_ptr<MissionItem>> mission_items;
 
         if (request != nullptr) {
-            for (auto rpc_mission_item : request->mission().mission_item()) {
+            mission_items.reserve(request->mission().mission_item_size());
+            for (const auto &rpc_mission_item : request->mission().mission_item()) {
                 mission_items.push_back(translateRPCMissionItem(rpc_mission_item));
             }
         }
@@ -82,53 +148,22 @@ private:
         return mission_item;
     }
 
-    MissionItem::CameraAction
-    translateRPCCameraAction(const rpc::mission::MissionItem::CameraAction rpc_camera_action) const
-    {
-        switch (rpc_camera_action) {
-            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_TAKE_PHOTO:
-                return MissionItem::CameraAction::TAKE_PHOTO;
-            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_START_PHOTO_INTERVAL:
-                return MissionItem::CameraAction::START_PHOTO_INTERVAL;
-            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_STOP_PHOTO_INTERVAL:
-                return MissionItem::CameraAction::STOP_PHOTO_INTERVAL;
-            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_START_VIDEO:
-                return MissionItem::CameraAction::START_VIDEO;
-            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_STOP_VIDEO:
-                return MissionItem::CameraAction::STOP_VIDEO;
-            case rpc::mission::MissionItem::CameraAction::MissionItem_CameraAction_NONE:
-            default:
-                return MissionItem::CameraAction::NONE;
-        }
-    }
-
-    void uploadMissionItems(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+    void uploadMissionItems(Mission &mission,
+                            const std::vector<std::shared_ptr<MissionItem>> &mission_items,
                             rpc::mission::UploadMissionResponse *response,
                             std::promise<void> &result_promise) const
     {
-        _mission.upload_mission_async(mission_items, [this, response,
+        mission.upload_mission_async(mission_items, [response,
               &result_promise](const dronecore::Mission::Result result) {
             if (response != nullptr) {
-                auto rpc_mission_result = generateRPCMissionResult(result);
-                response->set_allocated_mission_result(rpc_mission_result);
+                fillRPCMissionResult(response->mutable_mission_result(), result);
             }
 
             result_promise.set_value();
         });
     }
 
-    rpc::mission::MissionResult *generateRPCMissionResult(const dronecore::Mission::Result result) const
-    {
-        auto rpc_result = static_cast<rpc::mission::MissionResult::Result>(result);
-
-        auto rpc_mission_result = new rpc::mission::MissionResult();
-        rpc_mission_result->set_result(rpc_result);
-        rpc_mission_result->set_result_str(dronecore::Mission::result_str(result));
-
-        return rpc_mission_result;
-    }
-
-    Mission &_mission;
+    PluginInstances<Mission> _missions;
 };
 
 } // namespace backend
@@ -0,0 +1,136 @@
+#include <chrono>
+#include <cstdint>
+
+#include "offboard/offboard.h"
+#include "offboard/offboard.grpc.pb.h"
+#include "plugin_instances.h"
+
+namespace dronecore {
+namespace backend {
+
+template <typename Offboard = Offboard>
+class OffboardServiceImpl final : public rpc::offboard::OffboardService::Service
+{
+public:
+    OffboardServiceImpl(Offboard &offboard)
+        : _offboards(offboard) {}
+
+    // Calls are for the system in their metadata, see UUID_METADATA_KEY.
+    OffboardServiceImpl(DroneCore &dc)
+        : _offboards(dc) {}
+
+    grpc::Status Start(grpc::ServerContext *context,
+                       const rpc::offboard::StartRequest * /* request */,
+                       rpc::offboard::StartResponse *response) override
+    {
+        auto offboard = _offboards.get(context);
+        if (offboard == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto offboard_result = offboard->start();
+
+        if (response != nullptr) {
+            fillResponseWithResult(response, offboard_result);
+        }
+
+        return grpc::Status::OK;
+    }
+
+    grpc::Status Stop(grpc::ServerContext *context,
+                      const rpc::offboard::StopRequest * /* request */,
+                      rpc::offboard::StopResponse *response) override
+    {
+        auto offboard = _offboards.get(context);
+        if (offboard == nullptr) {
+            return system_not_found_status();
+        }
+
+        auto offboard_result = offboard->stop();
+
+        if (response != nullptr) {
+            fillResponseWithResult(response, offboard_result);
+        }
+
+        return grpc::Status::OK;
+    }
+
+    grpc::Status StreamSetpoints(grpc::ServerContext *context,
+                                 grpc::ServerReaderWriter<rpc::offboard::SetpointAck,
+                                 rpc::offboard::Setpoint> *stream) override
+    {
+        auto offboard = _offboards.get(context);
+        if (offboard == nullptr) {
+            return system_not_found_status();
+        }
+
+        // Reused for the whole stream, not to allocate for every setpoint.
+        rpc::offboard::Setpoint setpoint;
+        rpc::offboard::SetpointAck ack;
+
+        while (stream->Read(&setpoint)) {
+            ack.set_server_receive_time_us(now_us());
+            ack.set_applied(applySetpoint(*offboard, setpoint));
+            ack.set_server_applied_time_us(now_us());
+            ack.set_seq(setpoint.seq());
+            ack.set_client_time_us(setpoint.client_time_us());
+
+            if (!stream->Write(ack)) {
+                break;
+            }
+        }
+
+        return grpc::Status::OK;
+    }
+
+    static bool applySetpoint(Offboard &offboard, const rpc::offboard::Setpoint &setpoint)
+    {
+        switch (setpoint.setpoint_case()) {
+            case rpc::offboard::Setpoint::kVelocityNedYaw: {
+                const auto &rpc_velocity = setpoint.velocity_ned_yaw();
+                dronecore::Offboard::VelocityNEDYaw velocity;
+                velocity.north_m_s = rpc_velocity.vel_north_m_s();
+                velocity.east_m_s = rpc_velocity.vel_east_m_s();
+                velocity.down_m_s = rpc_velocity.vel_down_m_s();
+                velocity.yaw_deg = rpc_velocity.yaw_deg();
+                offboard.set_velocity_ned(velocity);
+                return true;
+            }
+            case rpc::offboard::Setpoint::kVelocityBodyYawspeed: {
+                const auto &rpc_velocity = setpoint.velocity_body_yawspeed();
+                dronecore::Offboard::VelocityBodyYawspeed velocity;
+                velocity.forward_m_s = rpc_velocity.vel_forward_m_s();
+                velocity.right_m_s = rpc_velocity.vel_right_m_s();
+                velocity.down_m_s = rpc_velocity.vel_down_m_s();
+                velocity.yawspeed_deg_s = rpc_velocity.yawspeed_deg_s();
+                offboard.set_velocity_body(velocity);
+                return true;
+            }
+            default:
+                return false;
+        }
+    }
+
+    template <typename ResponseType>
+    void fillResponseWithResult(ResponseType *response,
+                                dronecore::Offboard::Result offboard_result) const
+    {
+        auto rpc_result = static_cast<rpc::offboard::OffboardResult::Result>(offboard_result);
+
+        auto *rpc_offboard_result = response->mutable_offboard_result();
+        rpc_offboard_result->set_result(rpc_result);
+        rpc_offboard_result->set_result_str(dronecore::Offboard::result_str(offboard_result));
+    }
+
+private:
+    static uint64_t now_us()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    PluginInstances<Offboard> _offboards;
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+
+#include "plugin_instances.h"
+#include "stream_publisher.h"
+#include "stream_router.h"
+#include "telemetry/telemetry.h"
+#include "telemetry/telemetry_service_impl.h"
+#include "telemetry_batch/telemetry_batch.pb.h"
+#include "thread_setup.h"
+
+namespace dronecore {
+namespace backend {
+
+// Sends the telemetry fields a client asks for in one message per tick, all
+// taken from the same Telemetry::Snapshot. Clients asking for the same fields
+// at the same rate from the same system share a publisher, so each batch is
+// built and serialized once. Like the telemetry service, it is only served by
+// the StreamRouter.
+//
+// Batches of all fields can also be passed on serialized, e.g. to a
+// MulticastSender, for any number of consumers at no extra cost. Clients
+// streaming all fields at that rate share those batches.
+template <typename Telemetry = Telemetry>
+class TelemetryBatchServiceImpl final
+{
+public:
+    static constexpr unsigned MAX_RATE_HZ = 50;
+
+    typedef std::function<void(uint64_t uuid, const std::string &serialized)> multicast_t;
+
+    TelemetryBatchServiceImpl(Telemetry &telemetry)
+        : _telemetries(telemetry) {}
+
+    // Batches are for the system in the call metadata, see UUID_METADATA_KEY.
+    TelemetryBatchServiceImpl(DroneCore &dc)
+        : _telemetries(dc) {}
+
+    ~TelemetryBatchServiceImpl()
+    {
+        stop();
+        if (_thread != nullptr) {
+            _thread->join();
+            delete _thread;
+        }
+    }
+
+    // Needs to be called before the router is started.
+    void start(StreamRouter &router)
+    {
+        router.add("/dronecore.rpc.telemetry_batch.TelemetryBatchService/SubscribeTelemetryBatch",
+                   [this](const grpc::ServerContext &context, const grpc::ByteBuffer &request) {
+            return find_publisher(context, request);
+        });
+    }
+
+    // Every system discovered gets a batch of all fields at the rate, passed to
+    // multicast from the thread of the service.
+    void add_multicast(multicast_t multicast, float rate_hz)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _multicast = multicast;
+        _multicast_rate_hz = limit_rate(rate_hz);
+        if (_thread == nullptr) {
+            _thread = new std::thread(&TelemetryBatchServiceImpl::run, this);
+        }
+        _condition_var.notify_all();
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopped = true;
+        for (auto &batch : _batches) {
+            batch.second->publisher.stop();
+        }
+        _condition_var.notify_all();
+    }
+
+private:
+    typedef rpc::telemetry_batch::SubscribeTelemetryBatchRequest Request;
+    typedef rpc::telemetry_batch::TelemetryBatchResponse Response;
+
+    struct Batch {
+        Batch(Telemetry &system_telemetry, uint32_t batch_fields, unsigned batch_rate_hz)
+            : telemetry(system_telemetry), fields(batch_fields), rate_hz(batch_rate_hz) {}
+
+        Telemetry &telemetry;
+        const uint32_t fields;
+        const unsigned rate_hz;
+
+        // Nothing to subscribe, the batches are built by the thread.
+        StreamPublisher<Response> publisher {nullptr, Delivery::Latest};
+        Response response {};
+        std::chrono::steady_clock::time_point next_tick {};
+
+        // Passed to the multicast as well.
+        bool multicast {false};
+        uint64_t uuid {0};
+        std::string serialized {};
+    };
+
+    typedef std::tuple<Telemetry *, uint32_t, unsigned> key_t;
+
+    // Returns nullptr for a system which is not there, or an invalid request.
+    StreamPublisherBase *find_publisher(const grpc::ServerContext &context,
+                                        const grpc::ByteBuffer &serialized_request)
+    {
+        auto telemetry = _telemetries.get(&context);
+        if (telemetry == nullptr) {
+            return nullptr;
+        }
+
+        // Deserializing takes the buffer, copying it only references the bytes.
+        grpc::ByteBuffer buffer(serialized_request);
+        Request request;
+        if (!grpc::SerializationTraits<Request>::Deserialize(&buffer, &request).ok()) {
+            return nullptr;
+        }
+
+        uint32_t fields = 0;
+        for (const auto field : request.fields()) {
+            // Newer clients may ask for fields unknown here.
+            if (field >= 0 && field < 32) {
+                fields |= field_bit(static_cast<Request::Field>(field));
+            }
+        }
+        if (fields == 0) {
+            fields = ~0u;
+        }
+
+        const unsigned rate_hz = limit_rate(request.rate_hz());
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        Batch &batch = get_batch(*telemetry, fields, rate_hz);
+
+        if (_thread == nullptr) {
+            _thread = new std::thread(&TelemetryBatchServiceImpl::run, this);
+        }
+        _condition_var.notify_all();
+
+        return &batch.publisher;
+    }
+
+    // Needs to be called with _mutex locked.
+    Batch &get_batch(Telemetry &telemetry, uint32_t fields, unsigned rate_hz)
+    {
+        auto &batch = _batches[key_t(&telemetry, fields, rate_hz)];
+        if (!batch) {
+            batch.reset(new Batch(telemetry, fields, rate_hz));
+            if (_stopped) {
+                batch->publisher.stop();
+            }
+        }
+        return *batch;
+    }
+
+    // Needs to be called with _mutex locked.
+    void add_multicast_batches()
+    {
+        for (const uint64_t uuid : _telemetries.uuids()) {
+            auto telemetry = _telemetries.get(uuid);
+            if (telemetry == nullptr) {
+                continue;
+            }
+            Batch &batch = get_batch(*telemetry, ~0u, _multicast_rate_hz);
+            batch.multicast = true;
+            batch.uuid = uuid;
+        }
+    }
+
+    static unsigned limit_rate(float rate_hz)
+    {
+        return static_cast<unsigned>(std::min(std::max(std::lround(rate_hz), 1L),
+                                              static_cast<long>(MAX_RATE_HZ)));
+    }
+
+    static uint32_t field_bit(Request::Field field)
+    {
+        return 1u << static_cast<unsigned>(field);
+    }
+
+    void run()
+    {
+        setup_thread(ThreadRole::Background, "telem_batch");
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::chrono::steady_clock::time_point next_discovery {};
+        while (!_stopped) {
+            const auto now = std::chrono::steady_clock::now();
+            auto next_tick = now + std::chrono::seconds(1);
+
+            // Systems discovered since are multicast as well.
+            if (_multicast && next_discovery <= now) {
+                add_multicast_batches();
+                next_discovery = now + std::chrono::seconds(1);
+            }
+
+            for (auto &it : _batches) {
+                Batch &batch = *it.second;
+                if (batch.next_tick <= now) {
+                    // Nobody might be left on the stream, nothing to build then.
+                    if (batch.multicast || batch.publisher.num_streams() > 0) {
+                        build_and_publish(batch);
+                    }
+                    batch.next_tick = now + std::chrono::microseconds(1000000 / batch.rate_hz);
+                }
+                next_tick = std::min(next_tick, batch.next_tick);
+            }
+
+            _condition_var.wait_until(lock, next_tick);
+        }
+    }
+
+    void build_and_publish(Batch &batch)
+    {
+        const auto snapshot = batch.telemetry.snapshot();
+        auto &response = batch.response;
+        const uint32_t fields = batch.fields;
+
+        if (fields & field_bit(Request::POSITION)) {
+            auto rpc_position = response.mutable_position();
+            rpc_position->set_latitude_deg(snapshot.position.latitude_deg);
+            rpc_position->set_longitude_deg(snapshot.position.longitude_deg);
+            rpc_position->set_relative_altitude_m(snapshot.position.relative_altitude_m);
+            rpc_position->set_absolute_altitude_m(snapshot.position.absolute_altitude_m);
+        }
+        if (fields & field_bit(Request::GROUND_SPEED_NED)) {
+            auto rpc_ground_speed = response.mutable_ground_speed_ned();
+            rpc_ground_speed->set_velocity_north_m_s(snapshot.ground_speed_ned.velocity_north_m_s);
+            rpc_ground_speed->set_velocity_east_m_s(snapshot.ground_speed_ned.velocity_east_m_s);
+            rpc_ground_speed->set_velocity_down_m_s(snapshot.ground_speed_ned.velocity_down_m_s);
+        }
+        if (fields & field_bit(Request::HOME)) {
+            auto rpc_home = response.mutable_home();
+            rpc_home->set_latitude_deg(snapshot.home_position.latitude_deg);
+            rpc_home->set_longitude_deg(snapshot.home_position.longitude_deg);
+            rpc_home->set_relative_altitude_m(snapshot.home_position.relative_altitude_m);
+            rpc_home->set_absolute_altitude_m(snapshot.home_position.absolute_altitude_m);
+        }
+        if (fields & field_bit(Request::IN_AIR)) {
+            response.set_is_in_air(snapshot.in_air);
+        }
+        if (fields & field_bit(Request::ARMED)) {
+            response.set_is_armed(snapshot.armed);
+        }
+        if (fields & field_bit(Request::FLIGHT_MODE)) {
+            response.set_flight_mode(
+                TelemetryServiceImpl<Telemetry>::translateFlightMode(snapshot.flight_mode));
+        }
+        if (fields & field_bit(Request::ATTITUDE_QUATERNION)) {
+            auto rpc_quaternion = response.mutable_attitude_quaternion();
+            rpc_quaternion->set_w(snapshot.attitude_quaternion.w);
+            rpc_quaternion->set_x(snapshot.attitude_quaternion.x);
+            rpc_quaternion->set_y(snapshot.attitude_quaternion.y);
+            rpc_quaternion->set_z(snapshot.attitude_quaternion.z);
+        }
+        if (fields & field_bit(Request::CAMERA_ATTITUDE_EULER)) {
+            auto rpc_euler_angle = response.mutable_camera_attitude_euler();
+            rpc_euler_angle->set_roll_deg(snapshot.camera_attitude_euler_angle.roll_deg);
+            rpc_euler_angle->set_pitch_deg(snapshot.camera_attitude_euler_angle.pitch_deg);
+            rpc_euler_angle->set_yaw_deg(snapshot.camera_attitude_euler_angle.yaw_deg);
+        }
+        if (fields & field_bit(Request::GPS_INFO)) {
+            auto rpc_gps_info = response.mutable_gps_info();
+            rpc_gps_info->set_num_satellites(snapshot.gps_info.num_satellites);
+            rpc_gps_info->set_fix_type(
+                TelemetryServiceImpl<Telemetry>::translateGPSFixType(snapshot.gps_info.fix_type));
+        }
+        if (fields & field_bit(Request::BATTERY)) {
+            auto rpc_battery = response.mutable_battery();
+            rpc_battery->set_voltage_v(snapshot.battery.voltage_v);
+            rpc_battery->set_remaining_percent(snapshot.battery.remaining_percent);
+        }
+        if (fields & field_bit(Request::HEALTH)) {
+            auto rpc_health = response.mutable_health();
+            rpc_health->set_is_gyrometer_calibration_ok(snapshot.health.gyrometer_calibration_ok);
+            rpc_health->set_is_accelerometer_calibration_ok(snapshot.health.accelerometer_calibration_ok);
+            rpc_health->set_is_magnetometer_calibration_ok(snapshot.health.magnetometer_calibration_ok);
+            rpc_health->set_is_level_calibration_ok(snapshot.health.level_calibration_ok);
+            rpc_health->set_is_local_position_ok(snapshot.health.local_position_ok);
+            rpc_health->set_is_global_position_ok(snapshot.health.global_position_ok);
+            rpc_health->set_is_home_position_ok(snapshot.health.home_position_ok);
+        }
+        if (fields & field_bit(Request::RC_STATUS)) {
+            auto rpc_rc_status = response.mutable_rc_status();
+            rpc_rc_status->set_was_available_once(snapshot.rc_status.available_once);
+            rpc_rc_status->set_is_available(snapshot.rc_status.available);
+            rpc_rc_status->set_signal_strength_percent(snapshot.rc_status.signal_strength_percent);
+        }
+
+        if (!batch.multicast) {
+            batch.publisher.publish(response);
+            return;
+        }
+
+        // Serialized once, for the multicast and the streams.
+        response.SerializeToString(&batch.serialized);
+        _multicast(batch.uuid, batch.serialized);
+        if (batch.publisher.num_streams() > 0) {
+            grpc::Slice slice(batch.serialized);
+            batch.publisher.publish_serialized(grpc::ByteBuffer(&slice, 1));
+        }
+    }
+
+    PluginInstances<Telemetry> _telemetries;
+
+    std::mutex _mutex {};
+    std::condition_variable _condition_var {};
+    std::map<key_t, std::unique_ptr<Batch>> _batches {};
+    multicast_t _multicast {nullptr};
+    unsigned _multicast_rate_hz {0};
+    bool _stopped {false};
+    std::thread *_thread {nullptr};
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -1,46 +1,130 @@
-#include <future>
+#pragma once
 
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "plugin_instances.h"
+#include "stream_publisher.h"
+#include "stream_router.h"
 #include "telemetry/telemetry.h"
 #include "telemetry/telemetry.grpc.pb.h"
 
 namespace dronecore {
 namespace backend {
 
+// All methods are streams, so the whole service is served by the StreamRouter,
+// and not registered as a service itself.
 template <typename Telemetry = Telemetry>
-class TelemetryServiceImpl final : public dronecore::rpc::telemetry::TelemetryService::Service
+class TelemetryServiceImpl final
 {
 public:
     TelemetryServiceImpl(Telemetry &telemetry)
-        : _telemetry(telemetry),
-          _stop_promise(std::promise<void>()),
-          _stop_future(_stop_promise.get_future()) {}
+        : _telemetries(telemetry) {}
+
+    // Streams are for the system in the call metadata, see UUID_METADATA_KEY.
+    TelemetryServiceImpl(DroneCore &dc)
+        : _telemetries(dc) {}
+
+    // Needs to be called before the router is started.
+    void start(StreamRouter &router)
+    {
+        const std::string service = "/dronecore.rpc.telemetry.TelemetryService/";
+        add(router, service + "SubscribePosition", &SystemStreams::position);
+        add(router, service + "SubscribeHealth", &SystemStreams::health);
+        add(router, service + "SubscribeHome", &SystemStreams::home);
+        add(router, service + "SubscribeInAir", &SystemStreams::in_air);
+        add(router, service + "SubscribeArmed", &SystemStreams::armed);
+        add(router, service + "SubscribeGPSInfo", &SystemStreams::gps_info);
+        add(router, service + "SubscribeBattery", &SystemStreams::battery);
+        add(router, service + "SubscribeFlightMode", &SystemStreams::flight_mode);
+        add(router, service + "SubscribeAttitudeQuaternion", &SystemStreams::attitude_quaternion);
+        add(router, service + "SubscribeAttitudeEuler", &SystemStreams::attitude_euler);
+        add(router, service + "SubscribeCameraAttitudeQuaternion", &SystemStreams::camera_attitude_quaternion);
+        add(router, service + "SubscribeCameraAttitudeEuler", &SystemStreams::camera_attitude_euler);
+        add(router, service + "SubscribeGroundSpeedNED", &SystemStreams::ground_speed_ned);
+        add(router, service + "SubscribeRCStatus", &SystemStreams::rc_status);
+    }
+
+    void stop()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopped = true;
+        for (auto &system_streams : _streams) {
+            system_streams.second->stop();
+        }
+    }
+
+    static dronecore::rpc::telemetry::FixType translateGPSFixType(const int fix_type)
+    {
+        switch (fix_type) {
+            default:
+            case 0:
+                return dronecore::rpc::telemetry::FixType::NO_GPS;
+            case 1:
+                return dronecore::rpc::telemetry::FixType::NO_FIX;
+            case 2:
+                return dronecore::rpc::telemetry::FixType::FIX_2D;
+            case 3:
+                return dronecore::rpc::telemetry::FixType::FIX_3D;
+            case 4:
+                return dronecore::rpc::telemetry::FixType::FIX_DGPS;
+            case 5:
+                return dronecore::rpc::telemetry::FixType::RTK_FLOAT;
+            case 6:
+                return dronecore::rpc::telemetry::FixType::RTK_FIXED;
+        }
+    }
+
+    static rpc::telemetry::FlightMode
+    translateFlightMode(const dronecore::Telemetry::FlightMode flight_mode)
+    {
+        switch (flight_mode) {
+            default:
+            case dronecore::Telemetry::FlightMode::UNKNOWN:
+                return rpc::telemetry::FlightMode::UNKNOWN;
+            case dronecore::Telemetry::FlightMode::READY:
+                return rpc::telemetry::FlightMode::READY;
+            case dronecore::Telemetry::FlightMode::TAKEOFF:
+                return rpc::telemetry::FlightMode::TAKEOFF;
+            case dronecore::Telemetry::FlightMode::HOLD:
+                return rpc::telemetry::FlightMode::HOLD;
+            case dronecore::Telemetry::FlightMode::MISSION:
+                return rpc::telemetry::FlightMode::MISSION;
+            case dronecore::Telemetry::FlightMode::RETURN_TO_LAUNCH:
+                return rpc::telemetry::FlightMode::RETURN_TO_LAUNCH;
+            case dronecore::Telemetry::FlightMode::LAND:
+                return rpc::telemetry::FlightMode::LAND;
+            case dronecore::Telemetry::FlightMode::OFFBOARD:
+                return rpc::telemetry::FlightMode::OFFBOARD;
+            case dronecore::Telemetry::FlightMode::FOLLOW_ME:
+                return rpc::telemetry::FlightMode::FOLLOW_ME;
+        }
+    }
+
+private:
+    struct SystemStreams;
 
-    grpc::Status SubscribePosition(grpc::ServerContext * /* context */,
-                                   const dronecore::rpc::telemetry::SubscribePositionRequest * /* request */,
-                                   grpc::ServerWriter<rpc::telemetry::PositionResponse> *writer) override
+    void subscribePosition(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.position_async([&writer](dronecore::Telemetry::Position position) {
-            auto rpc_position = new dronecore::rpc::telemetry::Position();
+        telemetry.position_async([&streams](dronecore::Telemetry::Position position) {
+            auto rpc_position = streams.position_response.mutable_position();
             rpc_position->set_latitude_deg(position.latitude_deg);
             rpc_position->set_longitude_deg(position.longitude_deg);
             rpc_position->set_relative_altitude_m(position.relative_altitude_m);
             rpc_position->set_absolute_altitude_m(position.absolute_altitude_m);
 
-            dronecore::rpc::telemetry::PositionResponse rpc_position_response;
-            rpc_position_response.set_allocated_position(rpc_position);
-            writer->Write(rpc_position_response);
+            streams.position.publish(streams.position_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeHealth(grpc::ServerContext * /* context */,
-                                 const dronecore::rpc::telemetry::SubscribeHealthRequest * /* request */,
-                                 grpc::ServerWriter<rpc::telemetry::HealthResponse> *writer) override
+    void subscribeHealth(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.health_async([&writer](dronecore::Telemetry::Health health) {
-            auto rpc_health = new dronecore::rpc::telemetry::Health();
+        telemetry.health_async([&streams](dronecore::Telemetry::Health health) {
+            auto rpc_health = streams.health_response.mutable_health();
             rpc_health->set_is_gyrometer_calibration_ok(health.gyrometer_calibration_ok);
             rpc_health->set_is_accelerometer_calibration_ok(health.accelerometer_calibration_ok);
             rpc_health->set_is_magnetometer_calibration_ok(health.magnetometer_calibration_ok);
@@ -49,288 +133,293 @@ public:
             rpc_health->set_is_global_position_ok(health.global_position_ok);
             rpc_health->set_is_home_position_ok(health.home_position_ok);
 
-            dronecore::rpc::telemetry::HealthResponse rpc_health_response;
-            rpc_health_response.set_allocated_health(rpc_health);
-            writer->Write(rpc_health_response);
+            streams.health.publish(streams.health_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeHome(grpc::ServerContext * /* context */,
-                               const dronecore::rpc::telemetry::SubscribeHomeRequest * /* request */,
-                               grpc::ServerWriter<rpc::telemetry::HomeResponse> *writer) override
+    void subscribeHome(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.home_position_async([&writer](dronecore::Telemetry::Position position) {
-            auto rpc_position = new dronecore::rpc::telemetry::Position();
+        telemetry.home_position_async([&streams](dronecore::Telemetry::Position position) {
+            auto rpc_position = streams.home_response.mutable_home();
             rpc_position->set_latitude_deg(position.latitude_deg);
             rpc_position->set_longitude_deg(position.longitude_deg);
             rpc_position->set_relative_altitude_m(position.relative_altitude_m);
             rpc_position->set_absolute_altitude_m(position.absolute_altitude_m);
 
-            dronecore::rpc::telemetry::HomeResponse rpc_home_response;
-            rpc_home_response.set_allocated_home(rpc_position);
-            writer->Write(rpc_home_response);
+            streams.home.publish(streams.home_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeInAir(grpc::ServerContext * /* context */,
-                                const dronecore::rpc::telemetry::SubscribeInAirRequest * /* request */,
-                                grpc::ServerWriter<rpc::telemetry::InAirResponse> *writer) override
+    void subscribeInAir(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.in_air_async([&writer](bool is_in_air) {
-            dronecore::rpc::telemetry::InAirResponse rpc_in_air_response;
-            rpc_in_air_response.set_is_in_air(is_in_air);
-            writer->Write(rpc_in_air_response);
+        telemetry.in_air_async([&streams](bool is_in_air) {
+            streams.in_air_response.set_is_in_air(is_in_air);
+            streams.in_air.publish(streams.in_air_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeArmed(grpc::ServerContext * /* context */,
-                                const dronecore::rpc::telemetry::SubscribeArmedRequest * /* request */,
-                                grpc::ServerWriter<rpc::telemetry::ArmedResponse> *writer) override
+    void subscribeArmed(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.armed_async([&writer](bool is_armed) {
-            dronecore::rpc::telemetry::ArmedResponse rpc_armed_response;
-            rpc_armed_response.set_is_armed(is_armed);
-            writer->Write(rpc_armed_response);
+        telemetry.armed_async([&streams](bool is_armed) {
+            streams.armed_response.set_is_armed(is_armed);
+            streams.armed.publish(streams.armed_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeGPSInfo(grpc::ServerContext * /* context */,
-                                  const dronecore::rpc::telemetry::SubscribeGPSInfoRequest * /* request */,
-                                  grpc::ServerWriter<rpc::telemetry::GPSInfoResponse> *writer) override
+    void subscribeGPSInfo(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.gps_info_async([this, &writer](dronecore::Telemetry::GPSInfo gps_info) {
-            auto rpc_gps_info = new dronecore::rpc::telemetry::GPSInfo();
+        telemetry.gps_info_async([&streams](dronecore::Telemetry::GPSInfo gps_info) {
+            auto rpc_gps_info = streams.gps_info_response.mutable_gps_info();
             rpc_gps_info->set_num_satellites(gps_info.num_satellites);
             rpc_gps_info->set_fix_type(translateGPSFixType(gps_info.fix_type));
 
-            dronecore::rpc::telemetry::GPSInfoResponse rpc_gps_info_response;
-            rpc_gps_info_response.set_allocated_gps_info(rpc_gps_info);
-            writer->Write(rpc_gps_info_response);
+            streams.gps_info.publish(streams.gps_info_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    dronecore::rpc::telemetry::FixType translateGPSFixType(const int fix_type) const
+    void subscribeBattery(Telemetry &telemetry, SystemStreams &streams)
     {
-        switch (fix_type) {
-            default:
-            case 0:
-                return dronecore::rpc::telemetry::FixType::NO_GPS;
-            case 1:
-                return dronecore::rpc::telemetry::FixType::NO_FIX;
-            case 2:
-                return dronecore::rpc::telemetry::FixType::FIX_2D;
-            case 3:
-                return dronecore::rpc::telemetry::FixType::FIX_3D;
-            case 4:
-                return dronecore::rpc::telemetry::FixType::FIX_DGPS;
-            case 5:
-                return dronecore::rpc::telemetry::FixType::RTK_FLOAT;
-            case 6:
-                return dronecore::rpc::telemetry::FixType::RTK_FIXED;
-        }
-    }
-
-    grpc::Status SubscribeBattery(grpc::ServerContext * /* context */,
-                                  const dronecore::rpc::telemetry::SubscribeBatteryRequest * /* request */,
-                                  grpc::ServerWriter<rpc::telemetry::BatteryResponse> *writer) override
-    {
-        _telemetry.battery_async([&writer](dronecore::Telemetry::Battery battery) {
-            auto rpc_battery = new dronecore::rpc::telemetry::Battery();
+        telemetry.battery_async([&streams](dronecore::Telemetry::Battery battery) {
+            auto rpc_battery = streams.battery_response.mutable_battery();
             rpc_battery->set_voltage_v(battery.voltage_v);
             rpc_battery->set_remaining_percent(battery.remaining_percent);
 
-            dronecore::rpc::telemetry::BatteryResponse rpc_battery_response;
-            rpc_battery_response.set_allocated_battery(rpc_battery);
-            writer->Write(rpc_battery_response);
+            streams.battery.publish(streams.battery_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeFlightMode(grpc::ServerContext * /* context */,
-                                     const dronecore::rpc::telemetry::SubscribeFlightModeRequest * /* request */,
-                                     grpc::ServerWriter<rpc::telemetry::FlightModeResponse> *writer) override
+    void subscribeFlightMode(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.flight_mode_async([this, &writer](dronecore::Telemetry::FlightMode flight_mode) {
+        telemetry.flight_mode_async([&streams](dronecore::Telemetry::FlightMode flight_mode) {
             auto rpc_flight_mode = translateFlightMode(flight_mode);
 
-            dronecore::rpc::telemetry::FlightModeResponse rpc_flight_mode_response;
-            rpc_flight_mode_response.set_flight_mode(rpc_flight_mode);
-            writer->Write(rpc_flight_mode_response);
+            streams.flight_mode_response.set_flight_mode(rpc_flight_mode);
+            streams.flight_mode.publish(streams.flight_mode_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
-    }
-
-    rpc::telemetry::FlightMode
-    translateFlightMode(const dronecore::Telemetry::FlightMode flight_mode) const
-    {
-        switch (flight_mode) {
-            default:
-            case dronecore::Telemetry::FlightMode::UNKNOWN:
-                return rpc::telemetry::FlightMode::UNKNOWN;
-            case dronecore::Telemetry::FlightMode::READY:
-                return rpc::telemetry::FlightMode::READY;
-            case dronecore::Telemetry::FlightMode::TAKEOFF:
-                return rpc::telemetry::FlightMode::TAKEOFF;
-            case dronecore::Telemetry::FlightMode::HOLD:
-                return rpc::telemetry::FlightMode::HOLD;
-            case dronecore::Telemetry::FlightMode::MISSION:
-                return rpc::telemetry::FlightMode::MISSION;
-            case dronecore::Telemetry::FlightMode::RETURN_TO_LAUNCH:
-                return rpc::telemetry::FlightMode::RETURN_TO_LAUNCH;
-            case dronecore::Telemetry::FlightMode::LAND:
-                return rpc::telemetry::FlightMode::LAND;
-            case dronecore::Telemetry::FlightMode::OFFBOARD:
-                return rpc::telemetry::FlightMode::OFFBOARD;
-            case dronecore::Telemetry::FlightMode::FOLLOW_ME:
-                return rpc::telemetry::FlightMode::FOLLOW_ME;
-        }
     }
 
-    grpc::Status SubscribeAttitudeQuaternion(grpc::ServerContext * /* context */,
-                                             const dronecore::rpc::telemetry::SubscribeAttitudeQuaternionRequest * /* request */,
-                                             grpc::ServerWriter<rpc::telemetry::AttitudeQuaternionResponse> *writer) override
+    void subscribeAttitudeQuaternion(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.attitude_quaternion_async([&writer](dronecore::Telemetry::Quaternion quaternion) {
-            auto rpc_quaternion = new dronecore::rpc::telemetry::Quaternion();
+        telemetry.attitude_quaternion_async([&streams](dronecore::Telemetry::Quaternion quaternion) {
+            auto rpc_quaternion = streams.attitude_quaternion_response.mutable_attitude_quaternion();
             rpc_quaternion->set_w(quaternion.w);
             rpc_quaternion->set_x(quaternion.x);
             rpc_quaternion->set_y(quaternion.y);
             rpc_quaternion->set_z(quaternion.z);
 
-            dronecore::rpc::telemetry::AttitudeQuaternionResponse rpc_quaternion_response;
-            rpc_quaternion_response.set_allocated_attitude_quaternion(rpc_quaternion);
-            writer->Write(rpc_quaternion_response);
+            streams.attitude_quaternion.publish(streams.attitude_quaternion_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeAttitudeEuler(grpc::ServerContext * /* context */,
-                                        const dronecore::rpc::telemetry::SubscribeAttitudeEulerRequest * /* request */,
-                                        grpc::ServerWriter<rpc::telemetry::AttitudeEulerResponse> *writer) override
+    void subscribeAttitudeEuler(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.attitude_euler_angle_async([&writer](dronecore::Telemetry::EulerAngle euler_angle) {
-            auto rpc_euler_angle = new dronecore::rpc::telemetry::EulerAngle();
+        telemetry.attitude_euler_angle_async([&streams](dronecore::Telemetry::EulerAngle euler_angle) {
+            auto rpc_euler_angle = streams.attitude_euler_response.mutable_attitude_euler();
             rpc_euler_angle->set_roll_deg(euler_angle.roll_deg);
             rpc_euler_angle->set_pitch_deg(euler_angle.pitch_deg);
             rpc_euler_angle->set_yaw_deg(euler_angle.yaw_deg);
 
-            dronecore::rpc::telemetry::AttitudeEulerResponse rpc_euler_response;
-            rpc_euler_response.set_allocated_attitude_euler(rpc_euler_angle);
-            writer->Write(rpc_euler_response);
+            streams.attitude_euler.publish(streams.attitude_euler_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeCameraAttitudeQuaternion(grpc::ServerContext * /* context */,
-                                                   const dronecore::rpc::telemetry::SubscribeCameraAttitudeQuaternionRequest * /* request */,
-                                                   grpc::ServerWriter<rpc::telemetry::CameraAttitudeQuaternionResponse> *writer) override
+    void subscribeCameraAttitudeQuaternion(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.camera_attitude_quaternion_async([&writer](dronecore::Telemetry::Quaternion quaternion) {
-            auto rpc_quaternion = new dronecore::rpc::telemetry::Quaternion();
+        telemetry.camera_attitude_quaternion_async([&streams](dronecore::Telemetry::Quaternion quaternion) {
+            auto rpc_quaternion = streams.camera_attitude_quaternion_response.mutable_attitude_quaternion();
             rpc_quaternion->set_w(quaternion.w);
             rpc_quaternion->set_x(quaternion.x);
             rpc_quaternion->set_y(quaternion.y);
             rpc_quaternion->set_z(quaternion.z);
 
-            dronecore::rpc::telemetry::CameraAttitudeQuaternionResponse rpc_quaternion_response;
-            rpc_quaternion_response.set_allocated_attitude_quaternion(rpc_quaternion);
-            writer->Write(rpc_quaternion_response);
+            streams.camera_attitude_quaternion.publish(streams.camera_attitude_quaternion_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeCameraAttitudeEuler(grpc::ServerContext * /* context */,
-                                              const dronecore::rpc::telemetry::SubscribeCameraAttitudeEulerRequest * /* request */,
-                                              grpc::ServerWriter<rpc::telemetry::CameraAttitudeEulerResponse> *writer) override
+    void subscribeCameraAttitudeEuler(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.camera_attitude_euler_angle_async([&writer](dronecore::Telemetry::EulerAngle
+        telemetry.camera_attitude_euler_angle_async([&streams](dronecore::Telemetry::EulerAngle
         euler_angle) {
-            auto rpc_euler_angle = new dronecore::rpc::telemetry::EulerAngle();
+            auto rpc_euler_angle = streams.camera_attitude_euler_response.mutable_attitude_euler();
             rpc_euler_angle->set_roll_deg(euler_angle.roll_deg);
             rpc_euler_angle->set_pitch_deg(euler_angle.pitch_deg);
             rpc_euler_angle->set_yaw_deg(euler_angle.yaw_deg);
 
-            dronecore::rpc::telemetry::CameraAttitudeEulerResponse rpc_euler_response;
-            rpc_euler_response.set_allocated_attitude_euler(rpc_euler_angle);
-            writer->Write(rpc_euler_response);
+            streams.camera_attitude_euler.publish(streams.camera_attitude_euler_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeGroundSpeedNED(grpc::ServerContext * /* context */,
-                                         const dronecore::rpc::telemetry::SubscribeGroundSpeedNEDRequest * /* request */,
-                                         grpc::ServerWriter<rpc::telemetry::GroundSpeedNEDResponse> *writer) override
+    void subscribeGroundSpeedNED(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.ground_speed_ned_async([&writer](dronecore::Telemetry::GroundSpeedNED ground_speed) {
-            auto rpc_ground_speed = new dronecore::rpc::telemetry::SpeedNED();
+        telemetry.ground_speed_ned_async([&streams](dronecore::Telemetry::GroundSpeedNED ground_speed) {
+            auto rpc_ground_speed = streams.ground_speed_ned_response.mutable_ground_speed_ned();
             rpc_ground_speed->set_velocity_north_m_s(ground_speed.velocity_north_m_s);
             rpc_ground_speed->set_velocity_east_m_s(ground_speed.velocity_east_m_s);
             rpc_ground_speed->set_velocity_down_m_s(ground_speed.velocity_down_m_s);
 
-            dronecore::rpc::telemetry::GroundSpeedNEDResponse rpc_ground_speed_response;
-            rpc_ground_speed_response.set_allocated_ground_speed_ned(rpc_ground_speed);
-            writer->Write(rpc_ground_speed_response);
+            streams.ground_speed_ned.publish(streams.ground_speed_ned_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    grpc::Status SubscribeRCStatus(grpc::ServerContext * /* context */,
-                                   const dronecore::rpc::telemetry::SubscribeRCStatusRequest * /* request */,
-                                   grpc::ServerWriter<rpc::telemetry::RCStatusResponse> *writer) override
+    void subscribeRCStatus(Telemetry &telemetry, SystemStreams &streams)
     {
-        _telemetry.rc_status_async([&writer](dronecore::Telemetry::RCStatus rc_status) {
-            auto rpc_rc_status = new dronecore::rpc::telemetry::RCStatus();
+        telemetry.rc_status_async([&streams](dronecore::Telemetry::RCStatus rc_status) {
+            auto rpc_rc_status = streams.rc_status_response.mutable_rc_status();
             rpc_rc_status->set_was_available_once(rc_status.available_once);
             rpc_rc_status->set_is_available(rc_status.available);
             rpc_rc_status->set_signal_strength_percent(rc_status.signal_strength_percent);
 
-            dronecore::rpc::telemetry::RCStatusResponse rpc_rc_status_response;
-            rpc_rc_status_response.set_allocated_rc_status(rpc_rc_status);
-            writer->Write(rpc_rc_status_response);
+            streams.rc_status.publish(streams.rc_status_response);
         });
 
-        _stop_future.wait();
-        return grpc::Status::OK;
     }
 
-    void stop()
+    // The streams of one system, all subscribed to its Telemetry once, for any
+    // number of clients.
+    struct SystemStreams {
+        SystemStreams(TelemetryServiceImpl &parent, Telemetry &system_telemetry)
+            : service(parent), telemetry(system_telemetry) {}
+
+        void stop()
+        {
+            position.stop();
+            health.stop();
+            home.stop();
+            in_air.stop();
+            armed.stop();
+            gps_info.stop();
+            battery.stop();
+            flight_mode.stop();
+            attitude_quaternion.stop();
+            attitude_euler.stop();
+            camera_attitude_quaternion.stop();
+            camera_attitude_euler.stop();
+            ground_speed_ned.stop();
+            rc_status.stop();
+        }
+
+        TelemetryServiceImpl &service;
+        Telemetry &telemetry;
+
+        // Samples are all queued, but where only the current state matters a
+        // slow client just gets the latest one.
+        StreamPublisher<rpc::telemetry::PositionResponse> position {
+            [this]() { service.subscribePosition(telemetry, *this); }
+        };
+        StreamPublisher<rpc::telemetry::HealthResponse> health {
+            [this]() { service.subscribeHealth(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::HomeResponse> home {
+            [this]() { service.subscribeHome(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::InAirResponse> in_air {
+            [this]() { service.subscribeInAir(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::ArmedResponse> armed {
+            [this]() { service.subscribeArmed(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::GPSInfoResponse> gps_info {
+            [this]() { service.subscribeGPSInfo(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::BatteryResponse> battery {
+            [this]() { service.subscribeBattery(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::FlightModeResponse> flight_mode {
+            [this]() { service.subscribeFlightMode(telemetry, *this); },
+            Delivery::Latest
+        };
+        StreamPublisher<rpc::telemetry::AttitudeQuaternionResponse> attitude_quaternion {
+            [this]() { service.subscribeAttitudeQuaternion(telemetry, *this); }
+        };
+        StreamPublisher<rpc::telemetry::AttitudeEulerResponse> attitude_euler {
+            [this]() { service.subscribeAttitudeEuler(telemetry, *this); }
+        };
+        StreamPublisher<rpc::telemetry::CameraAttitudeQuaternionResponse> camera_attitude_quaternion {
+            [this]() { service.subscribeCameraAttitudeQuaternion(telemetry, *this); }
+        };
+        StreamPublisher<rpc::telemetry::CameraAttitudeEulerResponse> camera_attitude_euler {
+            [this]() { service.subscribeCameraAttitudeEuler(telemetry, *this); }
+        };
+        StreamPublisher<rpc::telemetry::GroundSpeedNEDResponse> ground_speed_ned {
+            [this]() { service.subscribeGroundSpeedNED(telemetry, *this); }
+        };
+        StreamPublisher<rpc::telemetry::RCStatusResponse> rc_status {
+            [this]() { service.subscribeRCStatus(telemetry, *this); },
+            Delivery::Latest
+        };
+
+        // Reused for every sample, the callbacks of a stream are never called
+        // in parallel.
+        rpc::telemetry::PositionResponse position_response {};
+        rpc::telemetry::HealthResponse health_response {};
+        rpc::telemetry::HomeResponse home_response {};
+        rpc::telemetry::InAirResponse in_air_response {};
+        rpc::telemetry::ArmedResponse armed_response {};
+        rpc::telemetry::GPSInfoResponse gps_info_response {};
+        rpc::telemetry::BatteryResponse battery_response {};
+        rpc::telemetry::FlightModeResponse flight_mode_response {};
+        rpc::telemetry::AttitudeQuaternionResponse attitude_quaternion_response {};
+        rpc::telemetry::AttitudeEulerResponse attitude_euler_response {};
+        rpc::telemetry::CameraAttitudeQuaternionResponse camera_attitude_quaternion_response {};
+        rpc::telemetry::CameraAttitudeEulerResponse camera_attitude_euler_response {};
+        rpc::telemetry::GroundSpeedNEDResponse ground_speed_ned_response {};
+        rpc::telemetry::RCStatusResponse rc_status_response {};
+    };
+
+    template <typename Response>
+    void add(StreamRouter &router, const std::string &method,
+             StreamPublisher<Response> SystemStreams::*publisher)
     {
-        _stop_promise.set_value();
+        router.add(method, [this, publisher](const grpc::ServerContext &context,
+                                             const grpc::ByteBuffer & /* request */)
+        -> StreamPublisherBase * {
+            auto system_streams = find_streams(context);
+            return (system_streams != nullptr) ? &(system_streams->*publisher) : nullptr;
+        });
     }
 
-private:
-    Telemetry &_telemetry;
-    std::promise<void> _stop_promise;
-    std::future<void> _stop_future;
+    // Returns nullptr if the system asked for is not there.
+    SystemStreams *find_streams(const grpc::ServerContext &context)
+    {
+        auto telemetry = _telemetries.get(&context);
+        if (telemetry == nullptr) {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &system_streams = _streams[telemetry];
+        if (!system_streams) {
+            system_streams.reset(new SystemStreams(*this, *telemetry));
+            if (_stopped) {
+                system_streams->stop();
+            }
+        }
+        return system_streams.get();
+    }
+
+    PluginInstances<Telemetry> _telemetries;
+
+    std::mutex _mutex {};
+    std::map<Telemetry *, std::unique_ptr<SystemStreams>> _streams {};
+    bool _stopped {false};
 };
 
 } // namespace backend
@@ -0,0 +1,72 @@
+#include "stream_publisher.h"
+
+#include "stream_router.h"
+
+namespace dronecore {
+namespace backend {
+
+constexpr size_t StreamPublisherBase::MAX_QUEUED_RESPONSES;
+
+void StreamPublisherBase::publish_serialized(const grpc::ByteBuffer &buffer)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_delivery == Delivery::EveryWithHistory) {
+        _published.push_back(buffer);
+    }
+    for (auto stream : _streams) {
+        stream->push(buffer);
+    }
+}
+
+void StreamPublisherBase::stop()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopped = true;
+    for (auto stream : _streams) {
+        stream->finish();
+    }
+}
+
+size_t StreamPublisherBase::num_streams() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _streams.size();
+}
+
+bool StreamPublisherBase::add(ServerStream &stream)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!stream.open()) {
+        // Already done, so it would never be removed again.
+        return false;
+    }
+
+    _streams.insert(&stream);
+    for (const auto &buffer : _published) {
+        stream.push(buffer);
+    }
+    if (_stopped) {
+        stream.finish();
+    }
+
+    const bool first = !_subscribed;
+    _subscribed = true;
+    return first;
+}
+
+void StreamPublisherBase::remove(ServerStream &stream)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _streams.erase(&stream);
+    stream.close();
+}
+
+void StreamPublisherBase::subscribe()
+{
+    if (_subscribe) {
+        _subscribe();
+    }
+}
+
+} // namespace backend
+} // namespace dronecore
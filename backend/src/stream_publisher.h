@@ -0,0 +1,104 @@
+#pragma once
+
+#include <grpc++/grpc++.h>
+#include <grpc++/impl/codegen/proto_utils.h>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <vector>
+
+namespace dronecore {
+namespace backend {
+
+class ServerStream;
+
+// Trailing metadata with the number of responses a stream dropped.
+static constexpr const char *DROPPED_METADATA_KEY = "dronecore-dropped-responses";
+
+// How a stream queues what it can't write yet.
+enum class Delivery {
+    // Every response, a client which can't keep up loses the oldest ones.
+    Every,
+    // Only the latest response is kept, for streams of a state.
+    Latest,
+    // Like Every, and a new stream first gets everything published before it
+    // started, e.g. all systems discovered so far.
+    EveryWithHistory
+};
+
+// Sends the responses of one server streaming method to every client which
+// subscribed to it, see StreamRouter for how the streams come in. A response
+// is serialized once, and the same bytes are queued to all streams.
+//
+// Each stream only has one write on the completion queue at a time, so writes
+// follow the flow control of the client, and the rest is queued according to
+// Delivery. How many responses a client did not get is sent in the trailing
+// metadata, see DROPPED_METADATA_KEY.
+//
+// The DroneCore callback feeding publish() is registered once, when the first
+// client subscribes, and shared by all streams.
+class StreamPublisherBase
+{
+public:
+    typedef std::function<void()> subscribe_t;
+
+    static constexpr size_t MAX_QUEUED_RESPONSES = 100;
+
+    StreamPublisherBase(subscribe_t subscribe, Delivery delivery)
+        : _subscribe(subscribe),
+          _delivery(delivery) {}
+
+    Delivery delivery() const { return _delivery; }
+
+    // The number of clients streaming, e.g. to skip building unused responses.
+    size_t num_streams() const;
+
+    // Ends all streams once what is queued is written. Streams started later
+    // are ended straight away.
+    void stop();
+
+    // A response serialized already, e.g. because it is also sent elsewhere.
+    void publish_serialized(const grpc::ByteBuffer &buffer);
+
+    // Non-copyable
+    StreamPublisherBase(const StreamPublisherBase &) = delete;
+    const StreamPublisherBase &operator=(const StreamPublisherBase &) = delete;
+
+private:
+    friend class ServerStream;
+
+    // Returns true for the first stream ever, which has to subscribe().
+    bool add(ServerStream &stream);
+    void remove(ServerStream &stream);
+    void subscribe();
+
+    const subscribe_t _subscribe;
+    const Delivery _delivery;
+
+    // Locked before the mutex of any stream.
+    mutable std::mutex _mutex {};
+    std::set<ServerStream *> _streams {};
+    std::vector<grpc::ByteBuffer> _published {};
+    bool _subscribed {false};
+    bool _stopped {false};
+};
+
+template <typename Response>
+class StreamPublisher : public StreamPublisherBase
+{
+public:
+    StreamPublisher(subscribe_t subscribe, Delivery delivery = Delivery::Every)
+        : StreamPublisherBase(subscribe, delivery) {}
+
+    void publish(const Response &response)
+    {
+        grpc::ByteBuffer buffer;
+        bool own_buffer;
+        grpc::SerializationTraits<Response>::Serialize(response, &buffer, &own_buffer);
+        publish_serialized(buffer);
+    }
+};
+
+} // namespace backend
+} // namespace dronecore
@@ -0,0 +1,295 @@
+#include "stream_router.h"
+
+namespace dronecore {
+namespace backend {
+
+void StreamRouter::add(const std::string &method, StreamPublisherBase &publisher)
+{
+    StreamPublisherBase *publisher_ptr = &publisher;
+    add(method, [publisher_ptr](const grpc::ServerContext &, const grpc::ByteBuffer &) {
+        return publisher_ptr;
+    });
+}
+
+void StreamRouter::add(const std::string &method, resolve_t resolve)
+{
+    auto &entry = _methods[method];
+    entry.resolve = resolve;
+    if (entry.metrics == nullptr) {
+        entry.metrics = std::unique_ptr<StreamMetrics>(new StreamMetrics());
+    }
+}
+
+void StreamRouter::start(grpc::ServerCompletionQueue *cq)
+{
+    _cq = cq;
+    new ServerStream(*this);
+}
+
+static int64_t load(const std::atomic<uint64_t> &counter)
+{
+    return static_cast<int64_t>(counter.load(std::memory_order_relaxed));
+}
+
+void StreamRouter::write_metrics(std::ostream &out) const
+{
+    write_metric(out, "dronecore_backend_streams_started_total", "counter",
+    [](const StreamMetrics &metrics) { return load(metrics.started); });
+    write_metric(out, "dronecore_backend_streams_ended_total", "counter",
+    [](const StreamMetrics &metrics) { return load(metrics.ended); });
+    write_metric(out, "dronecore_backend_stream_responses_written_total", "counter",
+    [](const StreamMetrics &metrics) { return load(metrics.written); });
+    write_metric(out, "dronecore_backend_stream_responses_dropped_total", "counter",
+    [](const StreamMetrics &metrics) { return load(metrics.dropped); });
+    write_metric(out, "dronecore_backend_stream_responses_queued", "gauge",
+    [](const StreamMetrics &metrics) { return metrics.queued.load(std::memory_order_relaxed); });
+}
+
+void StreamRouter::write_metric(std::ostream &out, const std::string &name, const char *type,
+                                std::function<int64_t(const StreamMetrics &)> value) const
+{
+    write_metric_type(out, name, type);
+    for (const auto &method : _methods) {
+        write_metric_sample(out, name, "method=\"" + method.first + "\"",
+                            value(*method.second.metrics));
+    }
+}
+
+StreamPublisherBase *StreamRouter::find(const grpc::GenericServerContext &context,
+                                        const grpc::ByteBuffer &request,
+                                        grpc::Status &status,
+                                        StreamMetrics *&metrics) const
+{
+    const auto it = _methods.find(context.method());
+    if (it == _methods.end()) {
+        status = grpc::Status(grpc::StatusCode::UNIMPLEMENTED, "");
+        return nullptr;
+    }
+
+    auto publisher = it->second.resolve(context, request);
+    if (publisher == nullptr) {
+        status = grpc::Status(grpc::StatusCode::NOT_FOUND, "");
+    } else {
+        metrics = it->second.metrics.get();
+    }
+    return publisher;
+}
+
+ServerStream::ServerStream(StreamRouter &router)
+    : _router(router),
+      _stream(&_context),
+      _request_tag(*this, &ServerStream::on_request),
+      _read_tag(*this, &ServerStream::on_read),
+      _write_tag(*this, &ServerStream::on_write),
+      _finish_tag(*this, &ServerStream::on_finish),
+      _done_tag(*this, &ServerStream::on_done)
+{
+    _context.AsyncNotifyWhenDone(&_done_tag);
+    _router._service.RequestCall(&_context, &_stream, _router._cq, _router._cq, &_request_tag);
+}
+
+ServerStream::~ServerStream()
+{
+    if (_metrics != nullptr) {
+        _metrics->ended.fetch_add(1, std::memory_order_relaxed);
+        _metrics->queued.fetch_sub(static_cast<int64_t>(_queue.size()), std::memory_order_relaxed);
+    }
+}
+
+void ServerStream::push(const grpc::ByteBuffer &buffer)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_finish_requested || _broken) {
+        return;
+    }
+
+    // The front is being written if a write is in flight.
+    const size_t max_queued = (_publisher->delivery() == Delivery::Latest) ?
+                              (_write_in_flight ? 2 : 1) :
+                              StreamPublisherBase::MAX_QUEUED_RESPONSES;
+    if (_queue.size() >= max_queued) {
+        _queue.erase(_queue.begin() + (_write_in_flight ? 1 : 0));
+        ++_num_dropped;
+        _metrics->dropped.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        _metrics->queued.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Copying a ByteBuffer only references the serialized bytes.
+    _queue.push_back(buffer);
+    if (!_write_in_flight) {
+        start_write();
+    }
+}
+
+void ServerStream::finish()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _finish_requested = true;
+    if (!_write_in_flight && !_finish_in_flight && !_broken) {
+        start_finish(grpc::Status::OK);
+    }
+}
+
+bool ServerStream::open()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return !_closed;
+}
+
+void ServerStream::close()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+}
+
+void ServerStream::on_request(bool ok)
+{
+    if (!ok) {
+        // Shutting down before a client came, so the done tag won't come either.
+        delete this;
+        return;
+    }
+
+    new ServerStream(_router);
+
+    // Which publisher can depend on the request.
+    std::lock_guard<std::mutex> lock(_mutex);
+    _read_in_flight = true;
+    _stream.Read(&_request, &_read_tag);
+}
+
+void ServerStream::on_read(bool ok)
+{
+    grpc::Status status;
+    StreamPublisherBase *publisher = nullptr;
+    StreamMetrics *metrics = nullptr;
+    if (ok) {
+        publisher = _router.find(_context, _request, status, metrics);
+    }
+
+    if (metrics != nullptr) {
+        metrics->started.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _publisher = publisher;
+        _metrics = metrics;
+    }
+
+    const bool first = (publisher != nullptr) && publisher->add(*this);
+
+    bool should_delete;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _read_in_flight = false;
+        if (publisher == nullptr && !_finish_requested) {
+            // Without a request there is nothing to stream either.
+            _finish_requested = true;
+            start_finish(ok ? status : grpc::Status::OK);
+        }
+        should_delete = can_delete();
+    }
+
+    // Another thread may have deleted this stream by now, unless it is up to us.
+    if (first) {
+        publisher->subscribe();
+    }
+
+    if (should_delete) {
+        delete this;
+    }
+}
+
+void ServerStream::on_write(bool ok)
+{
+    bool should_delete;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _write_in_flight = false;
+        _queue.pop_front();
+        _metrics->queued.fetch_sub(1, std::memory_order_relaxed);
+
+        if (!ok) {
+            // The client is gone.
+            _broken = true;
+            _metrics->queued.fetch_sub(static_cast<int64_t>(_queue.size()),
+                                       std::memory_order_relaxed);
+            _queue.clear();
+        } else {
+            _metrics->written.fetch_add(1, std::memory_order_relaxed);
+            if (!_queue.empty()) {
+                start_write();
+            } else if (_finish_requested) {
+                start_finish(grpc::Status::OK);
+            }
+        }
+        should_delete = can_delete();
+    }
+
+    if (should_delete) {
+        delete this;
+    }
+}
+
+void ServerStream::on_finish(bool /* ok */)
+{
+    bool should_delete;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _finish_in_flight = false;
+        should_delete = can_delete();
+    }
+
+    if (should_delete) {
+        delete this;
+    }
+}
+
+void ServerStream::on_done(bool /* ok */)
+{
+    // First, so that it is not added anymore, then nothing is pushed anymore.
+    StreamPublisherBase *publisher;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _closed = true;
+        publisher = _publisher;
+    }
+    if (publisher != nullptr) {
+        publisher->remove(*this);
+    }
+
+    bool should_delete;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done = true;
+        _broken = _broken || _context.IsCancelled();
+        should_delete = can_delete();
+    }
+
+    if (should_delete) {
+        delete this;
+    }
+}
+
+void ServerStream::start_write()
+{
+    _write_in_flight = true;
+    _stream.Write(_queue.front(), &_write_tag);
+}
+
+void ServerStream::start_finish(const grpc::Status &status)
+{
+    _context.AddTrailingMetadata(DROPPED_METADATA_KEY, std::to_string(_num_dropped));
+    _finish_in_flight = true;
+    _stream.Finish(status, &_finish_tag);
+}
+
+bool ServerStream::can_delete() const
+{
+    return _done && !_read_in_flight && !_write_in_flight && !_finish_in_flight;
+}
+
+} // namespace backend
+} // namespace dronecore
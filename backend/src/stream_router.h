@@ -0,0 +1,141 @@
+#pragma once
+
+#include <grpc++/generic/async_generic_service.h>
+#include <grpc++/grpc++.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "completion_queue_runner.h"
+#include "metrics.h"
+#include "stream_publisher.h"
+
+namespace dronecore {
+namespace backend {
+
+// Accepts the calls of all server streaming methods through the generic async
+// service, and hands each one to the publisher of its method. The generic API
+// is what lets the publishers write the same serialized bytes to every stream.
+//
+// The service has to be registered with RegisterAsyncGenericService, and the
+// streaming methods must either be in no registered service, or be marked with
+// WithGenericMethod_<method>.
+class StreamRouter
+{
+public:
+    // Gives the publisher for a call, or nullptr if what the call asks for,
+    // e.g. a system, is not there.
+    typedef std::function<StreamPublisherBase *(const grpc::ServerContext &context,
+                                                const grpc::ByteBuffer &request)> resolve_t;
+
+    grpc::AsyncGenericService &service() { return _service; }
+
+    // The method is the full name, e.g. "/package.Service/Method". All methods
+    // have to be added before start().
+    void add(const std::string &method, StreamPublisherBase &publisher);
+    void add(const std::string &method, resolve_t resolve);
+
+    // Starts accepting calls on the queue.
+    void start(grpc::ServerCompletionQueue *cq);
+
+    // The counters of every method, see StreamMetrics.
+    void write_metrics(std::ostream &out) const;
+
+private:
+    friend class ServerStream;
+
+    struct Method {
+        resolve_t resolve;
+        std::unique_ptr<StreamMetrics> metrics;
+    };
+
+    void write_metric(std::ostream &out, const std::string &name, const char *type,
+                      std::function<int64_t(const StreamMetrics &)> value) const;
+
+    StreamPublisherBase *find(const grpc::GenericServerContext &context,
+                              const grpc::ByteBuffer &request,
+                              grpc::Status &status,
+                              StreamMetrics *&metrics) const;
+
+    grpc::AsyncGenericService _service {};
+    grpc::ServerCompletionQueue *_cq {nullptr};
+    // Not changed anymore once started, so read without a lock.
+    std::map<std::string, Method> _methods {};
+};
+
+// One call to a streaming method. Deletes itself once the call is done and
+// nothing is left on the queue.
+class ServerStream
+{
+public:
+    explicit ServerStream(StreamRouter &router);
+    ~ServerStream();
+
+    // Called with the publisher locked.
+    void push(const grpc::ByteBuffer &buffer);
+    void finish();
+    bool open();
+    void close();
+
+    // Non-copyable
+    ServerStream(const ServerStream &) = delete;
+    const ServerStream &operator=(const ServerStream &) = delete;
+
+private:
+    class Tag : public CompletionTag
+    {
+    public:
+        Tag(ServerStream &stream, void (ServerStream::*handler)(bool))
+            : _stream(stream), _handler(handler) {}
+
+        void complete(bool ok) override { (_stream.*_handler)(ok); }
+
+    private:
+        ServerStream &_stream;
+        void (ServerStream::*_handler)(bool);
+    };
+
+    void on_request(bool ok);
+    void on_read(bool ok);
+    void on_write(bool ok);
+    void on_finish(bool ok);
+    void on_done(bool ok);
+
+    // Called with the stream locked.
+    void start_write();
+    void start_finish(const grpc::Status &status);
+    bool can_delete() const;
+
+    StreamRouter &_router;
+    StreamPublisherBase *_publisher {nullptr};
+    // Set together with the publisher.
+    StreamMetrics *_metrics {nullptr};
+
+    grpc::GenericServerContext _context {};
+    grpc::GenericServerAsyncReaderWriter _stream;
+    grpc::ByteBuffer _request {};
+
+    Tag _request_tag;
+    Tag _read_tag;
+    Tag _write_tag;
+    Tag _finish_tag;
+    Tag _done_tag;
+
+    std::mutex _mutex {};
+    std::deque<grpc::ByteBuffer> _queue {};
+    bool _read_in_flight {false};
+    bool _write_in_flight {false};
+    bool _finish_in_flight {false};
+    bool _finish_requested {false};
+    bool _broken {false};
+    bool _closed {false};
+    bool _done {false};
+    unsigned _num_dropped {0};
+};
+
+} // namespace backend
+} // namespace dronecore
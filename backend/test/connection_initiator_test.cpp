@@ -1,4 +1,5 @@
 #include <future>
+#include <vector>
 #include <gmock/gmock.h>
 
 #include "connection_initiator.h"
@@ -72,6 +73,26 @@ TEST(ConnectionInitiator, connectionDetectedIfDiscoverCallbackCalledBeforeWait)
     initiator.wait();
 }
 
+TEST(ConnectionInitiator, callsDiscoverCallbackOnceForFirstSystem)
+{
+    ConnectionInitiator initiator;
+    MockDroneCore dc;
+    event_callback_t discover_callback;
+    EXPECT_CALL(dc, register_on_discover(_))
+    .WillOnce(SaveCallback(&discover_callback));
+
+    std::vector<uint64_t> discovered_uuids;
+    initiator.start(dc, ARBITRARY_PORT, [&discovered_uuids](uint64_t uuid) {
+        discovered_uuids.push_back(uuid);
+    });
+    EXPECT_TRUE(discovered_uuids.empty());
+
+    discover_callback(ARBITRARY_UUID);
+    discover_callback(ARBITRARY_UUID + 1);
+    ASSERT_EQ(discovered_uuids.size(), 1u);
+    EXPECT_EQ(discovered_uuids[0], static_cast<uint64_t>(ARBITRARY_UUID));
+}
+
 TEST(ConnectionInitiator, doesNotCrashIfDiscoverCallbackCalledMoreThanOnce)
 {
     ConnectionInitiator initiator;
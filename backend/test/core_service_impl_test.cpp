@@ -6,6 +6,8 @@
 #include <memory>
 #include <vector>
 
+#include "completion_queue_runner.h"
+#include "stream_router.h"
 #include "core/core_service_impl.h"
 #include "core/mocks/dronecore_mock.h"
 
@@ -37,7 +39,12 @@ protected:
 
         grpc::ServerBuilder builder;
         builder.RegisterService(_core_service.get());
+        builder.RegisterAsyncGenericService(&_router.service());
+        _cq = builder.AddCompletionQueue();
         _server = builder.BuildAndStart();
+        _core_service->start(_router);
+        _router.start(_cq.get());
+        _runner.start(*_cq);
 
         grpc::ChannelArguments channel_args;
         auto channel = _server->InProcessChannel(channel_args);
@@ -47,6 +54,8 @@ protected:
     virtual void TearDown()
     {
         _server->Shutdown();
+        _cq->Shutdown();
+        _runner.join();
     }
 
     void checkPluginIsRunning(const std::string plugin_name);
@@ -55,7 +64,10 @@ protected:
 
     std::unique_ptr<CoreServiceImpl> _core_service;
     std::unique_ptr<MockDroneCore> _dc;
+    dronecore::backend::StreamRouter _router;
     std::unique_ptr<grpc::Server> _server;
+    std::unique_ptr<grpc::ServerCompletionQueue> _cq;
+    dronecore::backend::CompletionQueueRunner _runner;
     std::unique_ptr<CoreService::Stub> _stub;
 };
 
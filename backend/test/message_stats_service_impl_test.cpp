@@ -0,0 +1,62 @@
+#include <gmock/gmock.h>
+#include <vector>
+
+#include "core/mocks/dronecore_mock.h"
+#include "message_stats/message_stats_service_impl.h"
+
+namespace {
+
+namespace dc = dronecore;
+namespace rpc = dronecore::rpc::message_stats;
+
+using testing::NiceMock;
+using testing::Return;
+
+using MockDroneCore = NiceMock<dc::testing::MockDroneCore>;
+using MessageStatsServiceImpl = dc::backend::MessageStatsServiceImpl<MockDroneCore>;
+
+TEST(MessageStatsServiceImpl, translatesStats)
+{
+    dc::System::MessageStats heartbeat {};
+    heartbeat.message_id = 0;
+    heartbeat.count = 10;
+    heartbeat.bytes = 210;
+    heartbeat.average_interval_s = 1.0;
+    heartbeat.max_gap_s = 1.5;
+
+    dc::System::MessageStats attitude {};
+    attitude.message_id = 30;
+    attitude.count = 500;
+    attitude.bytes = 20000;
+    attitude.average_interval_s = 0.02;
+    attitude.max_gap_s = 0.1;
+
+    rpc::GetMessageStatsResponse response;
+    MessageStatsServiceImpl::fillRPCMessageStats({heartbeat, attitude}, 3, &response);
+
+    ASSERT_EQ(response.message_stats_size(), 2);
+    EXPECT_EQ(response.message_stats(0).message_id(), 0u);
+    EXPECT_EQ(response.message_stats(0).count(), 10u);
+    EXPECT_EQ(response.message_stats(0).bytes(), 210u);
+    EXPECT_DOUBLE_EQ(response.message_stats(0).average_interval_s(), 1.0);
+    EXPECT_DOUBLE_EQ(response.message_stats(0).max_gap_s(), 1.5);
+    EXPECT_EQ(response.message_stats(1).message_id(), 30u);
+    EXPECT_EQ(response.message_stats(1).count(), 500u);
+    EXPECT_EQ(response.num_messages_lost(), 3u);
+}
+
+TEST(MessageStatsServiceImpl, failsWithoutSystem)
+{
+    MockDroneCore dc;
+    MessageStatsServiceImpl service(dc);
+    EXPECT_CALL(dc, system_uuids()).WillRepeatedly(Return(std::vector<uint64_t> {}));
+
+    rpc::GetMessageStatsRequest request;
+    rpc::GetMessageStatsResponse response;
+    const auto status = service.GetMessageStats(nullptr, &request, &response);
+
+    EXPECT_EQ(status.error_code(), grpc::StatusCode::NOT_FOUND);
+    EXPECT_EQ(response.message_stats_size(), 0);
+}
+
+} // namespace
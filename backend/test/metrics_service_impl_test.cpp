@@ -0,0 +1,159 @@
+#include <chrono>
+#include <future>
+#include <gmock/gmock.h>
+#include <grpc++/grpc++.h>
+#include <grpc++/server.h>
+#include <grpc++/server_builder.h>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "completion_queue_runner.h"
+#include "core/core_service_impl.h"
+#include "core/mocks/dronecore_mock.h"
+#include "metrics.h"
+#include "metrics/metrics_service_impl.h"
+#include "stream_router.h"
+
+namespace {
+
+using testing::_;
+using testing::DoAll;
+using testing::HasSubstr;
+using testing::NiceMock;
+using testing::Return;
+using testing::SetArgReferee;
+
+using MockDroneCore = NiceMock<dronecore::testing::MockDroneCore>;
+using CoreServiceImpl = dronecore::backend::CoreServiceImpl<MockDroneCore>;
+using MetricsServiceImpl = dronecore::backend::MetricsServiceImpl<MockDroneCore>;
+using CoreService = dronecore::rpc::core::CoreService;
+using LatencyHistogram = dronecore::backend::LatencyHistogram;
+
+static constexpr auto DISCOVER_METHOD = "/dronecore.rpc.core.CoreService/SubscribeDiscover";
+static constexpr auto LINK_URL = "udp://0.0.0.0:14540";
+
+class MetricsServiceImplTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        _core_service = std::unique_ptr<CoreServiceImpl>(new CoreServiceImpl(_dc));
+        _metrics_service = std::unique_ptr<MetricsServiceImpl>(new MetricsServiceImpl(_dc, _router));
+
+        grpc::ServerBuilder builder;
+        builder.RegisterService(_core_service.get());
+        builder.RegisterAsyncGenericService(&_router.service());
+        _cq = builder.AddCompletionQueue();
+        _server = builder.BuildAndStart();
+        _core_service->start(_router);
+        _router.start(_cq.get());
+        _runner.start(*_cq);
+
+        grpc::ChannelArguments channel_args;
+        auto channel = _server->InProcessChannel(channel_args);
+        _stub = CoreService::NewStub(channel);
+    }
+
+    virtual void TearDown()
+    {
+        _core_service->stop();
+        _server->Shutdown();
+        _cq->Shutdown();
+        _runner.join();
+    }
+
+    std::string getMetrics() const
+    {
+        dronecore::rpc::metrics::GetMetricsResponse response;
+        _metrics_service->GetMetrics(nullptr, nullptr, &response);
+        return response.text();
+    }
+
+    MockDroneCore _dc;
+    std::unique_ptr<CoreServiceImpl> _core_service;
+    std::unique_ptr<MetricsServiceImpl> _metrics_service;
+    dronecore::backend::StreamRouter _router;
+    std::unique_ptr<grpc::Server> _server;
+    std::unique_ptr<grpc::ServerCompletionQueue> _cq;
+    dronecore::backend::CompletionQueueRunner _runner;
+    std::unique_ptr<CoreService::Stub> _stub;
+};
+
+TEST(LatencyHistogram, writesCumulativeBuckets)
+{
+    LatencyHistogram histogram;
+    histogram.observe(std::chrono::microseconds(50));
+    histogram.observe(std::chrono::microseconds(200));
+    histogram.observe(std::chrono::seconds(10));
+
+    std::ostringstream out;
+    histogram.write(out, "latency_seconds", "method=\"/a.B/C\"");
+    const auto text = out.str();
+
+    EXPECT_THAT(text, HasSubstr("latency_seconds_bucket{method=\"/a.B/C\",le=\"0.000100\"} 1\n"));
+    EXPECT_THAT(text, HasSubstr("latency_seconds_bucket{method=\"/a.B/C\",le=\"0.000250\"} 2\n"));
+    EXPECT_THAT(text, HasSubstr("latency_seconds_bucket{method=\"/a.B/C\",le=\"5.000000\"} 2\n"));
+    EXPECT_THAT(text, HasSubstr("latency_seconds_bucket{method=\"/a.B/C\",le=\"+Inf\"} 3\n"));
+    EXPECT_THAT(text, HasSubstr("latency_seconds_sum{method=\"/a.B/C\"} 10.000250\n"));
+    EXPECT_THAT(text, HasSubstr("latency_seconds_count{method=\"/a.B/C\"} 3\n"));
+}
+
+TEST_F(MetricsServiceImplTest, hasEveryStreamingMethod)
+{
+    const auto text = getMetrics();
+
+    EXPECT_THAT(text, HasSubstr("# TYPE dronecore_backend_streams_started_total counter\n"));
+    EXPECT_THAT(text, HasSubstr(std::string("dronecore_backend_streams_started_total{method=\"")
+                                + DISCOVER_METHOD + "\"} 0\n"));
+}
+
+TEST_F(MetricsServiceImplTest, countsStartedStreams)
+{
+    std::promise<void> subscribed_promise;
+    auto subscribed_future = subscribed_promise.get_future();
+    EXPECT_CALL(_dc, register_on_discover(_))
+    .WillOnce(testing::InvokeWithoutArgs([&subscribed_promise]() {
+        subscribed_promise.set_value();
+    }));
+
+    grpc::ClientContext context;
+    dronecore::rpc::core::SubscribeDiscoverRequest request;
+    auto reader = _stub->SubscribeDiscover(&context, request);
+    subscribed_future.wait();
+
+    EXPECT_THAT(getMetrics(), HasSubstr(std::string("dronecore_backend_streams_started_total{method=\"")
+                                        + DISCOVER_METHOD + "\"} 1\n"));
+
+    context.TryCancel();
+    reader->Finish();
+}
+
+TEST_F(MetricsServiceImplTest, hasTrafficOfLinks)
+{
+    dronecore::DroneCore::LinkStats stats {};
+    stats.bytes_received = 1234;
+    stats.sequence_gaps = 5;
+    EXPECT_CALL(_dc, get_link_stats(std::string(LINK_URL), _))
+    .WillRepeatedly(DoAll(SetArgReferee<1>(stats), Return(true)));
+
+    _metrics_service->add_link(LINK_URL);
+    const auto text = getMetrics();
+
+    EXPECT_THAT(text, HasSubstr(std::string("dronecore_link_bytes_received_total{link=\"")
+                                + LINK_URL + "\"} 1234\n"));
+    EXPECT_THAT(text, HasSubstr(std::string("dronecore_link_sequence_gaps_total{link=\"")
+                                + LINK_URL + "\"} 5\n"));
+}
+
+TEST_F(MetricsServiceImplTest, leavesOutUnknownLinks)
+{
+    ON_CALL(_dc, get_link_stats(_, _))
+    .WillByDefault(Return(false));
+
+    _metrics_service->add_link(LINK_URL);
+
+    EXPECT_THAT(getMetrics(), testing::Not(HasSubstr("dronecore_link_")));
+}
+
+} // namespace
@@ -0,0 +1,123 @@
+#include <cmath>
+#include <gmock/gmock.h>
+#include <memory>
+#include <vector>
+
+#include "mission/mission_item.h"
+#include "mission/mission_packed_service_impl.h"
+#include "mission/mocks/mission_mock.h"
+
+namespace {
+
+namespace dc = dronecore;
+namespace rpc = dronecore::rpc::mission_packed;
+
+using testing::NiceMock;
+
+using MockMission = NiceMock<dc::testing::MockMission>;
+using MissionPackedServiceImpl = dc::backend::MissionPackedServiceImpl<MockMission>;
+
+using CameraAction = dc::MissionItem::CameraAction;
+using RPCCameraAction = dc::rpc::mission::MissionItem::CameraAction;
+
+static constexpr int NUM_ITEMS = 3;
+
+rpc::PackedMissionItems createPackedMissionItems()
+{
+    rpc::PackedMissionItems packed_items;
+    for (int i = 0; i < NUM_ITEMS; ++i) {
+        packed_items.add_latitude_deg(47.3977419 + 0.001 * i);
+        packed_items.add_longitude_deg(8.5455938 - 0.001 * i);
+        packed_items.add_relative_altitude_m(10.0f + i);
+        packed_items.add_speed_m_s(5.0f);
+        packed_items.add_is_fly_through(i % 2 == 0);
+        packed_items.add_gimbal_pitch_deg(-90.0f);
+        packed_items.add_gimbal_yaw_deg(static_cast<float>(i));
+        packed_items.add_camera_action(dc::rpc::mission::MissionItem::TAKE_PHOTO);
+    }
+    return packed_items;
+}
+
+TEST(MissionPackedServiceImpl, unpacksAllColumns)
+{
+    std::vector<std::shared_ptr<dc::MissionItem>> mission_items;
+
+    ASSERT_TRUE(MissionPackedServiceImpl::appendMissionItems(createPackedMissionItems(),
+                                                             mission_items));
+
+    ASSERT_EQ(mission_items.size(), static_cast<size_t>(NUM_ITEMS));
+    EXPECT_DOUBLE_EQ(mission_items[1]->get_latitude_deg(), 47.3977419 + 0.001);
+    EXPECT_DOUBLE_EQ(mission_items[1]->get_longitude_deg(), 8.5455938 - 0.001);
+    EXPECT_EQ(mission_items[1]->get_relative_altitude_m(), 11.0f);
+    EXPECT_EQ(mission_items[1]->get_speed_m_s(), 5.0f);
+    EXPECT_FALSE(mission_items[1]->get_fly_through());
+    EXPECT_EQ(mission_items[1]->get_gimbal_pitch_deg(), -90.0f);
+    EXPECT_EQ(mission_items[1]->get_gimbal_yaw_deg(), 1.0f);
+    EXPECT_EQ(mission_items[1]->get_camera_action(), CameraAction::TAKE_PHOTO);
+}
+
+TEST(MissionPackedServiceImpl, appendsChunks)
+{
+    std::vector<std::shared_ptr<dc::MissionItem>> mission_items;
+
+    ASSERT_TRUE(MissionPackedServiceImpl::appendMissionItems(createPackedMissionItems(),
+                                                             mission_items));
+    ASSERT_TRUE(MissionPackedServiceImpl::appendMissionItems(createPackedMissionItems(),
+                                                             mission_items));
+
+    EXPECT_EQ(mission_items.size(), static_cast<size_t>(2 * NUM_ITEMS));
+}
+
+TEST(MissionPackedServiceImpl, leavesEmptyColumnsAtTheirDefaults)
+{
+    rpc::PackedMissionItems packed_items;
+    packed_items.add_latitude_deg(47.3977419);
+    packed_items.add_longitude_deg(8.5455938);
+    std::vector<std::shared_ptr<dc::MissionItem>> mission_items;
+
+    ASSERT_TRUE(MissionPackedServiceImpl::appendMissionItems(packed_items, mission_items));
+
+    ASSERT_EQ(mission_items.size(), 1u);
+    EXPECT_TRUE(std::isnan(mission_items[0]->get_relative_altitude_m()));
+    EXPECT_TRUE(std::isnan(mission_items[0]->get_speed_m_s()));
+    EXPECT_EQ(mission_items[0]->get_camera_action(), CameraAction::NONE);
+}
+
+TEST(MissionPackedServiceImpl, rejectsColumnsOfDifferentLength)
+{
+    auto packed_items = createPackedMissionItems();
+    packed_items.add_speed_m_s(1.0f);
+    std::vector<std::shared_ptr<dc::MissionItem>> mission_items;
+
+    EXPECT_FALSE(MissionPackedServiceImpl::appendMissionItems(packed_items, mission_items));
+    EXPECT_TRUE(mission_items.empty());
+}
+
+TEST(MissionPackedServiceImpl, packsWhatItUnpacked)
+{
+    const auto packed_items = createPackedMissionItems();
+    std::vector<std::shared_ptr<dc::MissionItem>> mission_items;
+    ASSERT_TRUE(MissionPackedServiceImpl::appendMissionItems(packed_items, mission_items));
+
+    rpc::PackedMissionItems repacked_items;
+    MissionPackedServiceImpl::fillPackedMissionItems(mission_items, 0, mission_items.size(),
+                                                     &repacked_items);
+
+    EXPECT_EQ(repacked_items.SerializeAsString(), packed_items.SerializeAsString());
+}
+
+TEST(MissionPackedServiceImpl, packsRangeOfItems)
+{
+    std::vector<std::shared_ptr<dc::MissionItem>> mission_items;
+    ASSERT_TRUE(MissionPackedServiceImpl::appendMissionItems(createPackedMissionItems(),
+                                                             mission_items));
+
+    rpc::PackedMissionItems packed_items;
+    MissionPackedServiceImpl::fillPackedMissionItems(mission_items, 1, 3, &packed_items);
+
+    ASSERT_EQ(packed_items.latitude_deg_size(), 2);
+    EXPECT_EQ(packed_items.relative_altitude_m(0), 11.0f);
+    EXPECT_EQ(packed_items.camera_action(1), RPCCameraAction::MissionItem_CameraAction_TAKE_PHOTO);
+}
+
+} // namespace
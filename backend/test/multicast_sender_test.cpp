@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "multicast_sender.h"
+
+namespace {
+
+using MulticastSender = dronecore::backend::MulticastSender;
+
+TEST(MulticastSender, framesHeaderInNetworkOrder)
+{
+    std::string datagram;
+    MulticastSender::frame(0x01020304, 0x1122334455667788ull, "abc", datagram);
+
+    ASSERT_EQ(MulticastSender::HEADER_SIZE + 3, datagram.size());
+    EXPECT_EQ("DCTB", datagram.substr(0, 4));
+    EXPECT_EQ(std::string("\x01\x02\x03\x04"), datagram.substr(4, 4));
+    EXPECT_EQ(std::string("\x11\x22\x33\x44\x55\x66\x77\x88"), datagram.substr(8, 8));
+    EXPECT_EQ("abc", datagram.substr(16));
+
+    // The buffer is reused.
+    MulticastSender::frame(5, 0, "", datagram);
+    EXPECT_EQ(MulticastSender::HEADER_SIZE, datagram.size());
+}
+
+TEST(MulticastSender, onlyOpensMulticastGroups)
+{
+    MulticastSender sender;
+    EXPECT_FALSE(sender.open("192.168.1.10", 14560));
+    EXPECT_FALSE(sender.open("239.255.0.1", 0));
+    EXPECT_FALSE(sender.send(1, "abc"));
+
+    ASSERT_TRUE(sender.open("239.255.0.1", 14560));
+    EXPECT_FALSE(sender.open("239.255.0.1", 14560));
+    EXPECT_FALSE(sender.send(1, std::string(MulticastSender::MAX_PAYLOAD_SIZE + 1, 'x')));
+}
+
+} // namespace
@@ -0,0 +1,166 @@
+#include <gmock/gmock.h>
+#include <grpc++/grpc++.h>
+#include <grpc++/server.h>
+#include <grpc++/server_builder.h>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "offboard/mocks/offboard_mock.h"
+#include "offboard/offboard_service_impl.h"
+
+namespace {
+
+using testing::_;
+using testing::NiceMock;
+using testing::Return;
+using testing::SaveArg;
+
+using MockOffboard = NiceMock<dronecore::testing::MockOffboard>;
+using OffboardServiceImpl = dronecore::backend::OffboardServiceImpl<MockOffboard>;
+using OffboardService = dronecore::rpc::offboard::OffboardService;
+
+using OffboardResult = dronecore::rpc::offboard::OffboardResult;
+using InputPair = std::pair<std::string, dronecore::Offboard::Result>;
+
+std::vector<InputPair> generateInputPairs();
+
+class OffboardServiceImplTest : public ::testing::TestWithParam<InputPair> {};
+
+TEST_P(OffboardServiceImplTest, startResultIsTranslatedCorrectly)
+{
+    MockOffboard offboard;
+    ON_CALL(offboard, start())
+    .WillByDefault(Return(GetParam().second));
+    OffboardServiceImpl offboardService(offboard);
+    dronecore::rpc::offboard::StartResponse response;
+
+    offboardService.Start(nullptr, nullptr, &response);
+
+    EXPECT_EQ(OffboardResult::Result_Name(response.offboard_result().result()),
+              GetParam().first);
+}
+
+TEST_P(OffboardServiceImplTest, stopResultIsTranslatedCorrectly)
+{
+    MockOffboard offboard;
+    ON_CALL(offboard, stop())
+    .WillByDefault(Return(GetParam().second));
+    OffboardServiceImpl offboardService(offboard);
+    dronecore::rpc::offboard::StopResponse response;
+
+    offboardService.Stop(nullptr, nullptr, &response);
+
+    EXPECT_EQ(OffboardResult::Result_Name(response.offboard_result().result()),
+              GetParam().first);
+}
+
+INSTANTIATE_TEST_CASE_P(OffboardResultCorrespondences,
+                        OffboardServiceImplTest,
+                        ::testing::ValuesIn(generateInputPairs()));
+
+class OffboardServiceImplStreamTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        _service = std::unique_ptr<OffboardServiceImpl>(new OffboardServiceImpl(_offboard));
+
+        grpc::ServerBuilder builder;
+        builder.RegisterService(_service.get());
+        _server = builder.BuildAndStart();
+
+        grpc::ChannelArguments channel_args;
+        auto channel = _server->InProcessChannel(channel_args);
+        _stub = OffboardService::NewStub(channel);
+    }
+
+    virtual void TearDown()
+    {
+        _server->Shutdown();
+    }
+
+    MockOffboard _offboard;
+    std::unique_ptr<OffboardServiceImpl> _service;
+    std::unique_ptr<grpc::Server> _server;
+    std::unique_ptr<OffboardService::Stub> _stub;
+};
+
+TEST_F(OffboardServiceImplStreamTest, appliesAndAcknowledgesEverySetpoint)
+{
+    dronecore::Offboard::VelocityNEDYaw velocity_ned {};
+    dronecore::Offboard::VelocityBodyYawspeed velocity_body {};
+    EXPECT_CALL(_offboard, set_velocity_ned(_))
+    .WillOnce(SaveArg<0>(&velocity_ned));
+    EXPECT_CALL(_offboard, set_velocity_body(_))
+    .WillOnce(SaveArg<0>(&velocity_body));
+
+    grpc::ClientContext context;
+    auto stream = _stub->StreamSetpoints(&context);
+
+    dronecore::rpc::offboard::Setpoint setpoint;
+    setpoint.set_seq(1);
+    setpoint.set_client_time_us(1000);
+    setpoint.mutable_velocity_ned_yaw()->set_vel_north_m_s(1.5f);
+    setpoint.mutable_velocity_ned_yaw()->set_yaw_deg(90.0f);
+    ASSERT_TRUE(stream->Write(setpoint));
+
+    dronecore::rpc::offboard::SetpointAck ack;
+    ASSERT_TRUE(stream->Read(&ack));
+    EXPECT_EQ(ack.seq(), 1u);
+    EXPECT_EQ(ack.client_time_us(), 1000u);
+    EXPECT_TRUE(ack.applied());
+    EXPECT_LE(ack.server_receive_time_us(), ack.server_applied_time_us());
+
+    setpoint.set_seq(2);
+    setpoint.set_client_time_us(2000);
+    setpoint.mutable_velocity_body_yawspeed()->set_vel_forward_m_s(2.5f);
+    setpoint.mutable_velocity_body_yawspeed()->set_yawspeed_deg_s(-10.0f);
+    ASSERT_TRUE(stream->Write(setpoint));
+    ASSERT_TRUE(stream->Read(&ack));
+    EXPECT_EQ(ack.seq(), 2u);
+    EXPECT_EQ(ack.client_time_us(), 2000u);
+    EXPECT_TRUE(ack.applied());
+
+    // A setpoint without any value is acknowledged but not applied.
+    setpoint.Clear();
+    setpoint.set_seq(3);
+    ASSERT_TRUE(stream->Write(setpoint));
+    ASSERT_TRUE(stream->Read(&ack));
+    EXPECT_EQ(ack.seq(), 3u);
+    EXPECT_FALSE(ack.applied());
+
+    stream->WritesDone();
+    EXPECT_FALSE(stream->Read(&ack));
+    EXPECT_TRUE(stream->Finish().ok());
+
+    EXPECT_EQ(velocity_ned.north_m_s, 1.5f);
+    EXPECT_EQ(velocity_ned.yaw_deg, 90.0f);
+    EXPECT_EQ(velocity_body.forward_m_s, 2.5f);
+    EXPECT_EQ(velocity_body.yawspeed_deg_s, -10.0f);
+}
+
+std::vector<InputPair> generateInputPairs()
+{
+    std::vector<InputPair> input_pairs;
+    input_pairs.push_back(std::make_pair("SUCCESS", dronecore::Offboard::Result::SUCCESS));
+    input_pairs.push_back(std::make_pair("NO_SYSTEM", dronecore::Offboard::Result::NO_SYSTEM));
+    input_pairs.push_back(std::make_pair("CONNECTION_ERROR",
+                                         dronecore::Offboard::Result::CONNECTION_ERROR));
+    input_pairs.push_back(std::make_pair("BUSY", dronecore::Offboard::Result::BUSY));
+    input_pairs.push_back(std::make_pair("COMMAND_DENIED",
+                                         dronecore::Offboard::Result::COMMAND_DENIED));
+    input_pairs.push_back(std::make_pair("TIMEOUT", dronecore::Offboard::Result::TIMEOUT));
+    input_pairs.push_back(std::make_pair("NO_SETPOINT_SET",
+                                         dronecore::Offboard::Result::NO_SETPOINT_SET));
+    input_pairs.push_back(std::make_pair("TRAJECTORY_INVALID",
+                                         dronecore::Offboard::Result::TRAJECTORY_INVALID));
+    input_pairs.push_back(std::make_pair("TRAJECTORY_BUFFER_FULL",
+                                         dronecore::Offboard::Result::TRAJECTORY_BUFFER_FULL));
+    input_pairs.push_back(std::make_pair("UNKNOWN", dronecore::Offboard::Result::UNKNOWN));
+
+    return input_pairs;
+}
+
+} // namespace
@@ -0,0 +1,149 @@
+#include <gmock/gmock.h>
+#include <grpc++/test/server_context_test_spouse.h>
+#include <cstdint>
+#include <vector>
+
+#include "plugin_instances.h"
+
+namespace {
+
+namespace dc = dronecore;
+
+using testing::NiceMock;
+using testing::Return;
+using testing::ReturnRef;
+
+struct FakeSystem {};
+
+class MockDroneCore
+{
+public:
+    MOCK_CONST_METHOD0(system_uuids, std::vector<uint64_t>());
+    MOCK_CONST_METHOD1(system, FakeSystem & (uint64_t uuid));
+};
+
+struct FakePlugin {
+    explicit FakePlugin(FakeSystem &fake_system)
+        : system(&fake_system) {}
+
+    FakeSystem *system;
+};
+
+using PluginInstances = dc::backend::PluginInstances<FakePlugin, NiceMock<MockDroneCore>>;
+
+TEST(PluginInstances, getRequestedUuidFromMetadata)
+{
+    grpc::ServerContext context;
+    grpc::testing::ServerContextTestSpouse spouse(&context);
+    spouse.AddClientMetadata(dc::backend::UUID_METADATA_KEY, "12345678901234");
+
+    uint64_t uuid = 0;
+    EXPECT_TRUE(dc::backend::get_requested_uuid(&context, uuid));
+    EXPECT_EQ(uuid, 12345678901234u);
+}
+
+TEST(PluginInstances, getRequestedUuidWithoutMetadata)
+{
+    grpc::ServerContext context;
+
+    uint64_t uuid = 0;
+    EXPECT_FALSE(dc::backend::get_requested_uuid(nullptr, uuid));
+    EXPECT_FALSE(dc::backend::get_requested_uuid(&context, uuid));
+}
+
+TEST(PluginInstances, getRequestedUuidRejectsGarbage)
+{
+    grpc::ServerContext context;
+    grpc::testing::ServerContextTestSpouse spouse(&context);
+    spouse.AddClientMetadata(dc::backend::UUID_METADATA_KEY, "42abc");
+
+    uint64_t uuid = 0;
+    EXPECT_FALSE(dc::backend::get_requested_uuid(&context, uuid));
+}
+
+TEST(PluginInstances, routesByUuidMetadata)
+{
+    NiceMock<MockDroneCore> drone_core;
+    FakeSystem system_42;
+    FakeSystem system_43;
+    ON_CALL(drone_core, system_uuids()).WillByDefault(Return(std::vector<uint64_t> {42, 43}));
+    EXPECT_CALL(drone_core, system(42)).WillOnce(ReturnRef(system_42));
+    EXPECT_CALL(drone_core, system(43)).WillOnce(ReturnRef(system_43));
+    PluginInstances instances(drone_core);
+
+    grpc::ServerContext context_43;
+    grpc::testing::ServerContextTestSpouse spouse_43(&context_43);
+    spouse_43.AddClientMetadata(dc::backend::UUID_METADATA_KEY, "43");
+    grpc::ServerContext context_42;
+    grpc::testing::ServerContextTestSpouse spouse_42(&context_42);
+    spouse_42.AddClientMetadata(dc::backend::UUID_METADATA_KEY, "42");
+
+    auto plugin_43 = instances.get(&context_43);
+    auto plugin_42 = instances.get(&context_42);
+    ASSERT_NE(plugin_43, nullptr);
+    ASSERT_NE(plugin_42, nullptr);
+    EXPECT_EQ(plugin_43->system, &system_43);
+    EXPECT_EQ(plugin_42->system, &system_42);
+
+    // Created once, then the same instance for every call.
+    EXPECT_EQ(instances.get(&context_43), plugin_43);
+    EXPECT_EQ(instances.get(43), plugin_43);
+}
+
+TEST(PluginInstances, unknownUuidIsNotFound)
+{
+    NiceMock<MockDroneCore> drone_core;
+    ON_CALL(drone_core, system_uuids()).WillByDefault(Return(std::vector<uint64_t> {42}));
+    EXPECT_CALL(drone_core, system(testing::_)).Times(0);
+    PluginInstances instances(drone_core);
+
+    grpc::ServerContext context;
+    grpc::testing::ServerContextTestSpouse spouse(&context);
+    spouse.AddClientMetadata(dc::backend::UUID_METADATA_KEY, "44");
+
+    EXPECT_EQ(instances.get(&context), nullptr);
+    EXPECT_EQ(dc::backend::system_not_found_status().error_code(),
+              grpc::StatusCode::NOT_FOUND);
+}
+
+TEST(PluginInstances, defaultsToFirstSystem)
+{
+    NiceMock<MockDroneCore> drone_core;
+    FakeSystem system_42;
+    ON_CALL(drone_core, system_uuids()).WillByDefault(Return(std::vector<uint64_t> {42, 43}));
+    EXPECT_CALL(drone_core, system(42)).WillOnce(ReturnRef(system_42));
+    PluginInstances instances(drone_core);
+
+    grpc::ServerContext context;
+
+    auto plugin = instances.get(&context);
+    ASSERT_NE(plugin, nullptr);
+    EXPECT_EQ(plugin->system, &system_42);
+    EXPECT_EQ(instances.get(nullptr), plugin);
+}
+
+TEST(PluginInstances, noSystemWithoutMetadata)
+{
+    NiceMock<MockDroneCore> drone_core;
+    ON_CALL(drone_core, system_uuids()).WillByDefault(Return(std::vector<uint64_t> {}));
+    PluginInstances instances(drone_core);
+
+    EXPECT_EQ(instances.get(nullptr), nullptr);
+}
+
+TEST(PluginInstances, singleInstanceForAllSystems)
+{
+    FakeSystem system;
+    FakePlugin plugin(system);
+    PluginInstances instances(plugin);
+
+    grpc::ServerContext context;
+    grpc::testing::ServerContextTestSpouse spouse(&context);
+    spouse.AddClientMetadata(dc::backend::UUID_METADATA_KEY, "44");
+
+    EXPECT_EQ(instances.get(&context), &plugin);
+    EXPECT_EQ(instances.get(nullptr), &plugin);
+    EXPECT_EQ(instances.uuids(), std::vector<uint64_t> {0});
+}
+
+} // namespace
@@ -0,0 +1,182 @@
+#include <gmock/gmock.h>
+#include <grpc++/grpc++.h>
+#include <grpc++/server.h>
+#include <grpc++/server_builder.h>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "completion_queue_runner.h"
+#include "stream_router.h"
+#include "telemetry/mocks/telemetry_mock.h"
+#include "telemetry/telemetry_batch_service_impl.h"
+#include "telemetry_batch/telemetry_batch.grpc.pb.h"
+
+namespace {
+
+using testing::NiceMock;
+using testing::Return;
+
+using MockTelemetry = NiceMock<dronecore::testing::MockTelemetry>;
+using TelemetryBatchServiceImpl = dronecore::backend::TelemetryBatchServiceImpl<MockTelemetry>;
+using TelemetryBatchService = dronecore::rpc::telemetry_batch::TelemetryBatchService;
+using SubscribeTelemetryBatchRequest =
+    dronecore::rpc::telemetry_batch::SubscribeTelemetryBatchRequest;
+using TelemetryBatchResponse = dronecore::rpc::telemetry_batch::TelemetryBatchResponse;
+
+class TelemetryBatchServiceImplTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        _telemetry = std::unique_ptr<MockTelemetry>(new MockTelemetry());
+        _service = std::unique_ptr<TelemetryBatchServiceImpl>(new TelemetryBatchServiceImpl(
+                                                                  *_telemetry));
+
+        grpc::ServerBuilder builder;
+        builder.RegisterAsyncGenericService(&_router.service());
+        _cq = builder.AddCompletionQueue();
+        _server = builder.BuildAndStart();
+        _service->start(_router);
+        _router.start(_cq.get());
+        _runner.start(*_cq);
+
+        grpc::ChannelArguments channel_args;
+        auto channel = _server->InProcessChannel(channel_args);
+        _stub = TelemetryBatchService::NewStub(channel);
+    }
+
+    virtual void TearDown()
+    {
+        _service->stop();
+        _server->Shutdown();
+        _cq->Shutdown();
+        _runner.join();
+    }
+
+    dronecore::Telemetry::Snapshot createSnapshot() const;
+
+    std::unique_ptr<MockTelemetry> _telemetry;
+    std::unique_ptr<TelemetryBatchServiceImpl> _service;
+    dronecore::backend::StreamRouter _router;
+    std::unique_ptr<grpc::Server> _server;
+    std::unique_ptr<grpc::ServerCompletionQueue> _cq;
+    dronecore::backend::CompletionQueueRunner _runner;
+    std::unique_ptr<TelemetryBatchService::Stub> _stub;
+};
+
+dronecore::Telemetry::Snapshot TelemetryBatchServiceImplTest::createSnapshot() const
+{
+    dronecore::Telemetry::Snapshot snapshot {};
+    snapshot.position.latitude_deg = 47.3977419;
+    snapshot.position.longitude_deg = 8.5455938;
+    snapshot.position.absolute_altitude_m = 488.0f;
+    snapshot.position.relative_altitude_m = 10.0f;
+    snapshot.battery.voltage_v = 12.1f;
+    snapshot.battery.remaining_percent = 0.8f;
+    snapshot.gps_info.num_satellites = 10;
+    snapshot.gps_info.fix_type = 3;
+    return snapshot;
+}
+
+TEST_F(TelemetryBatchServiceImplTest, sendsOnlyRequestedFieldsOfSnapshot)
+{
+    const auto snapshot = createSnapshot();
+    ON_CALL(*_telemetry, snapshot())
+    .WillByDefault(Return(snapshot));
+
+    grpc::ClientContext context;
+    SubscribeTelemetryBatchRequest request;
+    request.add_fields(SubscribeTelemetryBatchRequest::POSITION);
+    request.add_fields(SubscribeTelemetryBatchRequest::BATTERY);
+    request.set_rate_hz(50.0f);
+    auto response_reader = _stub->SubscribeTelemetryBatch(&context, request);
+
+    TelemetryBatchResponse response;
+    ASSERT_TRUE(response_reader->Read(&response));
+
+    EXPECT_TRUE(response.has_position());
+    EXPECT_EQ(snapshot.position.latitude_deg, response.position().latitude_deg());
+    EXPECT_EQ(snapshot.position.longitude_deg, response.position().longitude_deg());
+    EXPECT_EQ(snapshot.position.absolute_altitude_m, response.position().absolute_altitude_m());
+    EXPECT_EQ(snapshot.position.relative_altitude_m, response.position().relative_altitude_m());
+    EXPECT_TRUE(response.has_battery());
+    EXPECT_EQ(snapshot.battery.voltage_v, response.battery().voltage_v());
+    EXPECT_EQ(snapshot.battery.remaining_percent, response.battery().remaining_percent());
+    EXPECT_FALSE(response.has_gps_info());
+    EXPECT_FALSE(response.has_attitude_quaternion());
+
+    _service->stop();
+    while (response_reader->Read(&response)) {}
+    EXPECT_TRUE(response_reader->Finish().ok());
+}
+
+TEST_F(TelemetryBatchServiceImplTest, sendsAllFieldsIfNoneRequested)
+{
+    const auto snapshot = createSnapshot();
+    ON_CALL(*_telemetry, snapshot())
+    .WillByDefault(Return(snapshot));
+
+    grpc::ClientContext context;
+    SubscribeTelemetryBatchRequest request;
+    auto response_reader = _stub->SubscribeTelemetryBatch(&context, request);
+
+    TelemetryBatchResponse response;
+    ASSERT_TRUE(response_reader->Read(&response));
+
+    EXPECT_TRUE(response.has_position());
+    EXPECT_TRUE(response.has_battery());
+    EXPECT_TRUE(response.has_gps_info());
+    EXPECT_EQ(snapshot.gps_info.num_satellites, response.gps_info().num_satellites());
+    EXPECT_TRUE(response.has_rc_status());
+
+    _service->stop();
+    while (response_reader->Read(&response)) {}
+    response_reader->Finish();
+}
+
+TEST_F(TelemetryBatchServiceImplTest, multicastsAllFieldsSerializedOnce)
+{
+    const auto snapshot = createSnapshot();
+    ON_CALL(*_telemetry, snapshot())
+    .WillByDefault(Return(snapshot));
+
+    std::mutex mutex;
+    std::condition_variable condition_var;
+    std::vector<std::string> multicast;
+    _service->add_multicast([&](uint64_t /* uuid */, const std::string & serialized) {
+        std::lock_guard<std::mutex> lock(mutex);
+        multicast.push_back(serialized);
+        condition_var.notify_all();
+    }, 50.0f);
+
+    // A stream of all fields at the same rate gets the same batches.
+    grpc::ClientContext context;
+    SubscribeTelemetryBatchRequest request;
+    request.set_rate_hz(50.0f);
+    auto response_reader = _stub->SubscribeTelemetryBatch(&context, request);
+
+    TelemetryBatchResponse response;
+    ASSERT_TRUE(response_reader->Read(&response));
+    EXPECT_TRUE(response.has_gps_info());
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(condition_var.wait_for(lock, std::chrono::seconds(1), [&]() {
+            return !multicast.empty();
+        }));
+        TelemetryBatchResponse multicast_response;
+        ASSERT_TRUE(multicast_response.ParseFromString(multicast.front()));
+        EXPECT_EQ(snapshot.position.latitude_deg, multicast_response.position().latitude_deg());
+        EXPECT_EQ(snapshot.battery.voltage_v, multicast_response.battery().voltage_v());
+    }
+
+    _service->stop();
+    while (response_reader->Read(&response)) {}
+    response_reader->Finish();
+}
+
+} // namespace
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <future>
 #include <gmock/gmock.h>
 #include <grpc++/grpc++.h>
@@ -5,8 +6,11 @@
 #include <grpc++/server_builder.h>
 #include <memory>
 #include <random>
+#include <string>
 #include <vector>
 
+#include "completion_queue_runner.h"
+#include "stream_router.h"
 #include "telemetry/mocks/telemetry_mock.h"
 #include "telemetry/telemetry_service_impl.h"
 
@@ -41,6 +45,22 @@ using GroundSpeedNED = dronecore::Telemetry::GroundSpeedNED;
 
 using RCStatus = dronecore::Telemetry::RCStatus;
 
+// The state streams may skip what was overwritten before it got sent, so the
+// client gets the last state sent, with some of those before it.
+template <typename T>
+void expectLatestOf(const std::vector<T> &sent, const std::vector<T> &received)
+{
+    ASSERT_FALSE(received.empty());
+    EXPECT_EQ(sent.back(), received.back());
+
+    auto sent_it = sent.begin();
+    for (const auto &state : received) {
+        sent_it = std::find(sent_it, sent.end(), state);
+        ASSERT_NE(sent.end(), sent_it);
+        ++sent_it;
+    }
+}
+
 class TelemetryServiceImplTest : public ::testing::Test
 {
 protected:
@@ -50,8 +70,12 @@ protected:
         _telemetry_service = std::unique_ptr<TelemetryServiceImpl>(new TelemetryServiceImpl(*_telemetry));
 
         grpc::ServerBuilder builder;
-        builder.RegisterService(_telemetry_service.get());
+        builder.RegisterAsyncGenericService(&_router.service());
+        _cq = builder.AddCompletionQueue();
         _server = builder.BuildAndStart();
+        _telemetry_service->start(_router);
+        _router.start(_cq.get());
+        _runner.start(*_cq);
 
         grpc::ChannelArguments channel_args;
         auto channel = _server->InProcessChannel(channel_args);
@@ -63,6 +87,8 @@ protected:
     virtual void TearDown()
     {
         _server->Shutdown();
+        _cq->Shutdown();
+        _runner.join();
     }
 
     std::future<void> subscribePositionAsync(std::vector<Position> &positions);
@@ -124,7 +150,10 @@ protected:
                             const float signal_strength_percent) const;
     std::future<void> subscribeRCStatusAsync(std::vector<RCStatus> &rc_status_events) const;
 
+    dronecore::backend::StreamRouter _router;
     std::unique_ptr<grpc::Server> _server;
+    std::unique_ptr<grpc::ServerCompletionQueue> _cq;
+    dronecore::backend::CompletionQueueRunner _runner;
     std::unique_ptr<TelemetryService::Stub> _stub;
     std::unique_ptr<MockTelemetry> _telemetry;
     std::unique_ptr<TelemetryServiceImpl> _telemetry_service;
@@ -185,6 +214,21 @@ std::future<void> TelemetryServiceImplTest::subscribePositionAsync(std::vector<P
     });
 }
 
+TEST_F(TelemetryServiceImplTest, registersToTelemetryPositionAsyncOnceForAllSubscribers)
+{
+    EXPECT_CALL(*_telemetry, position_async(_))
+    .Times(1);
+
+    std::vector<Position> positions;
+    std::vector<Position> other_positions;
+    auto position_stream_future = subscribePositionAsync(positions);
+    auto other_position_stream_future = subscribePositionAsync(other_positions);
+
+    _telemetry_service->stop();
+    position_stream_future.wait();
+    other_position_stream_future.wait();
+}
+
 TEST_F(TelemetryServiceImplTest, doesNotSendPositionIfCallbackNotCalled)
 {
     std::vector<Position> positions;
@@ -333,10 +377,7 @@ void TelemetryServiceImplTest::checkSendsHealths(const std::vector<Health> &heal
     _telemetry_service->stop();
     health_stream_future.wait();
 
-    ASSERT_EQ(healths.size(), received_healths.size());
-    for (size_t i = 0; i < healths.size(); i++) {
-        EXPECT_EQ(healths.at(i), received_healths.at(i));
-    }
+    expectLatestOf(healths, received_healths);
 }
 
 Health TelemetryServiceImplTest::createRandomHealth()
@@ -439,10 +480,7 @@ const
     _telemetry_service->stop();
     home_stream_future.wait();
 
-    ASSERT_EQ(home_positions.size(), received_home_positions.size());
-    for (size_t i = 0; i < home_positions.size(); i++) {
-        EXPECT_EQ(home_positions.at(i), received_home_positions.at(i));
-    }
+    expectLatestOf(home_positions, received_home_positions);
 }
 
 TEST_F(TelemetryServiceImplTest, sendsMultipleHomePositions)
@@ -521,10 +559,7 @@ void TelemetryServiceImplTest::checkSendsInAirEvents(const std::vector<bool> &in
     _telemetry_service->stop();
     in_air_stream_future.wait();
 
-    ASSERT_EQ(in_air_events.size(), received_in_air_events.size());
-    for (size_t i = 0; i < in_air_events.size(); i++) {
-        EXPECT_EQ(in_air_events.at(i), received_in_air_events.at(i));
-    }
+    expectLatestOf(in_air_events, received_in_air_events);
 }
 
 TEST_F(TelemetryServiceImplTest, sendsMultipleInAirEvents)
@@ -538,6 +573,45 @@ TEST_F(TelemetryServiceImplTest, sendsMultipleInAirEvents)
     checkSendsInAirEvents(in_air_events);
 }
 
+TEST_F(TelemetryServiceImplTest, reportsDroppedInAirEvents)
+{
+    std::promise<void> subscription_promise;
+    auto subscription_future = subscription_promise.get_future();
+    dronecore::Telemetry::in_air_callback_t in_air_callback;
+    EXPECT_CALL(*_telemetry, in_air_async(_))
+    .WillOnce(SaveCallback(&in_air_callback, &subscription_promise));
+
+    const int num_sent = 1000;
+    int num_received = 0;
+    std::string num_dropped;
+    auto in_air_stream_future = std::async(std::launch::async, [&]() {
+        grpc::ClientContext context;
+        dronecore::rpc::telemetry::SubscribeInAirRequest request;
+        auto response_reader = _stub->SubscribeInAir(&context, request);
+
+        dronecore::rpc::telemetry::InAirResponse response;
+        while (response_reader->Read(&response)) {
+            num_received++;
+        }
+        response_reader->Finish();
+
+        const auto metadata = context.GetServerTrailingMetadata();
+        const auto it = metadata.find(dronecore::backend::DROPPED_METADATA_KEY);
+        if (it != metadata.end()) {
+            num_dropped = std::string(it->second.data(), it->second.size());
+        }
+    });
+
+    subscription_future.wait();
+    for (int i = 0; i < num_sent; i++) {
+        in_air_callback(i % 2 == 0);
+    }
+    _telemetry_service->stop();
+    in_air_stream_future.wait();
+
+    EXPECT_EQ(std::to_string(num_sent - num_received), num_dropped);
+}
+
 TEST_F(TelemetryServiceImplTest, registersToTelemetryArmedAsync)
 {
     EXPECT_CALL(*_telemetry, armed_async(_))
@@ -604,10 +678,7 @@ void TelemetryServiceImplTest::checkSendsArmedEvents(const std::vector<bool> &ar
     _telemetry_service->stop();
     armed_stream_future.wait();
 
-    ASSERT_EQ(armed_events.size(), received_armed_events.size());
-    for (size_t i = 0; i < armed_events.size(); i++) {
-        EXPECT_EQ(armed_events.at(i), received_armed_events.at(i));
-    }
+    expectLatestOf(armed_events, received_armed_events);
 }
 
 TEST_F(TelemetryServiceImplTest, sendsMultipleArmedEvents)
@@ -714,10 +785,7 @@ const
     _telemetry_service->stop();
     gps_info_stream_future.wait();
 
-    ASSERT_EQ(gps_info_events.size(), received_gps_info_events.size());
-    for (size_t i = 0; i < gps_info_events.size(); i++) {
-        EXPECT_EQ(gps_info_events.at(i), received_gps_info_events.at(i));
-    }
+    expectLatestOf(gps_info_events, received_gps_info_events);
 }
 
 GPSInfo TelemetryServiceImplTest::createGPSInfo(const int num_satellites, const int fix_type) const
@@ -826,10 +894,7 @@ const
     _telemetry_service->stop();
     battery_stream_future.wait();
 
-    ASSERT_EQ(battery_events.size(), received_battery_events.size());
-    for (size_t i = 0; i < battery_events.size(); i++) {
-        EXPECT_EQ(battery_events.at(i), received_battery_events.at(i));
-    }
+    expectLatestOf(battery_events, received_battery_events);
 }
 
 TEST_F(TelemetryServiceImplTest, sendsMultipleBatteryEvents)
@@ -938,10 +1003,7 @@ void TelemetryServiceImplTest::checkSendsFlightModeEvents(const std::vector<Flig
     _telemetry_service->stop();
     flight_mode_stream_future.wait();
 
-    ASSERT_EQ(flight_mode_events.size(), received_flight_mode_events.size());
-    for (size_t i = 0; i < flight_mode_events.size(); i++) {
-        EXPECT_EQ(flight_mode_events.at(i), received_flight_mode_events.at(i));
-    }
+    expectLatestOf(flight_mode_events, received_flight_mode_events);
 }
 
 TEST_F(TelemetryServiceImplTest, sendsMultipleFlightModeEvents)
@@ -1528,10 +1590,7 @@ void TelemetryServiceImplTest::checkSendsRCStatusEvents(const std::vector<RCStat
     _telemetry_service->stop();
     rc_status_stream_future.wait();
 
-    ASSERT_EQ(rc_status_events.size(), received_rc_status_events.size());
-    for (size_t i = 0; i < rc_status_events.size(); i++) {
-        EXPECT_EQ(rc_status_events.at(i), received_rc_status_events.at(i));
-    }
+    expectLatestOf(rc_status_events, received_rc_status_events);
 }
 
 TEST_F(TelemetryServiceImplTest, sendsMultipleRCStatusEvents)
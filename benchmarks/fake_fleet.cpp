@@ -0,0 +1,171 @@
+#include "fake_fleet.h"
+#include <chrono>
+
+#include <arpa/inet.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace dronecore {
+
+constexpr unsigned FakeFleet::NUM_THREADS;
+
+static uint64_t steady_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+FakeFleet::FakeFleet(const Config &config) :
+    _config(config)
+{}
+
+FakeFleet::~FakeFleet()
+{
+    stop();
+}
+
+bool FakeFleet::start()
+{
+    if (_config.num_vehicles == 0 ||
+        _config.first_system_id + _config.num_vehicles - 1 > UINT8_MAX) {
+        return false;
+    }
+
+    _receiver.reset(new MAVLinkReceiver());
+
+    _dronecore_addr.sin_family = AF_INET;
+    _dronecore_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    _dronecore_addr.sin_port = htons(uint16_t(_config.dronecore_port));
+
+    for (unsigned i = 0; i < _config.num_vehicles; ++i) {
+        const int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (socket_fd < 0) {
+            stop();
+            return false;
+        }
+        _socket_fds.push_back(socket_fd);
+
+        struct sockaddr_in local_addr {};
+        local_addr.sin_family = AF_INET;
+        local_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        local_addr.sin_port = 0;
+        if (bind(socket_fd, reinterpret_cast<struct sockaddr *>(&local_addr),
+                 sizeof(local_addr)) != 0) {
+            stop();
+            return false;
+        }
+
+        _vehicles.emplace_back(new FakeVehicle(
+                                   uint8_t(_config.first_system_id + i), _config.num_params,
+        [this, i](const mavlink_message_t &message) { send(i, message); }));
+    }
+
+    _should_exit = false;
+    _receive_thread = std::thread(&FakeFleet::receive_thread, this);
+    _send_thread = std::thread(&FakeFleet::send_thread, this);
+    return true;
+}
+
+void FakeFleet::stop()
+{
+    _should_exit = true;
+    if (_receive_thread.joinable()) {
+        _receive_thread.join();
+    }
+    if (_send_thread.joinable()) {
+        _send_thread.join();
+    }
+
+    for (int socket_fd : _socket_fds) {
+        close(socket_fd);
+    }
+    _socket_fds.clear();
+    _vehicles.clear();
+
+    _receiver.reset();
+}
+
+void FakeFleet::send(unsigned index, const mavlink_message_t &message)
+{
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+
+    // Every datagram goes out whole, also when sent from several threads.
+    sendto(_socket_fds[index], buffer, len, 0,
+           reinterpret_cast<const struct sockaddr *>(&_dronecore_addr),
+           sizeof(_dronecore_addr));
+    ++_num_messages_sent;
+}
+
+void FakeFleet::receive_thread()
+{
+    std::vector<struct pollfd> poll_fds(_socket_fds.size());
+    for (size_t i = 0; i < _socket_fds.size(); ++i) {
+        poll_fds[i].fd = _socket_fds[i];
+        poll_fds[i].events = POLLIN;
+    }
+
+    char buffer[2048];
+    while (!_should_exit) {
+        // With a timeout to notice when to exit.
+        if (poll(poll_fds.data(), poll_fds.size(), 100) <= 0) {
+            continue;
+        }
+
+        for (size_t i = 0; i < poll_fds.size(); ++i) {
+            if (!(poll_fds[i].revents & POLLIN)) {
+                continue;
+            }
+
+            ssize_t recv_len;
+            while ((recv_len = recv(poll_fds[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+                // Datagrams hold whole messages, so one parser does for all sockets.
+                _receiver->set_new_datagram(buffer, unsigned(recv_len));
+                while (_receiver->parse_message()) {
+                    _vehicles[i]->handle_message(_receiver->get_last_message());
+                }
+            }
+        }
+    }
+}
+
+void FakeFleet::send_thread()
+{
+    const uint64_t heartbeat_interval_us = 1000000;
+    const uint64_t telemetry_interval_us = (_config.telemetry_rate_hz > 0.0f) ?
+                                           uint64_t(1e6 / double(_config.telemetry_rate_hz)) : 0;
+
+    // Spread out over the interval instead of all vehicles sending at once.
+    const uint64_t start_us = steady_us();
+    std::vector<uint64_t> next_heartbeat_us(_vehicles.size());
+    std::vector<uint64_t> next_telemetry_us(_vehicles.size());
+    for (size_t i = 0; i < _vehicles.size(); ++i) {
+        next_heartbeat_us[i] = start_us + heartbeat_interval_us * i / _vehicles.size();
+        next_telemetry_us[i] = start_us + telemetry_interval_us * i / _vehicles.size();
+    }
+
+    while (!_should_exit) {
+        const uint64_t now_us = steady_us();
+
+        for (size_t i = 0; i < _vehicles.size(); ++i) {
+            if (now_us >= next_heartbeat_us[i]) {
+                _vehicles[i]->send_heartbeat();
+                next_heartbeat_us[i] += heartbeat_interval_us;
+            }
+
+            if (telemetry_interval_us > 0 && now_us >= next_telemetry_us[i]) {
+                _vehicles[i]->send_telemetry(now_us);
+                next_telemetry_us[i] += telemetry_interval_us;
+                // Skip what we could not keep up with instead of bursting.
+                if (next_telemetry_us[i] < now_us) {
+                    next_telemetry_us[i] = now_us + telemetry_interval_us;
+                }
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+} // namespace dronecore
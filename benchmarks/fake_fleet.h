@@ -0,0 +1,70 @@
+#pragma once
+
+#include "fake_vehicle.h"
+#include "mavlink_receiver.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+
+namespace dronecore {
+
+// A number of fake vehicles talking to DroneCore over UDP on localhost, each
+// from its own socket like separate SITL instances would. All of them are run
+// on two threads, so the fleet barely shows up next to DroneCore when it is
+// profiled in the same process.
+class FakeFleet
+{
+public:
+    struct Config {
+        int dronecore_port = 14540;
+        unsigned num_vehicles = 1;
+        // The vehicles get consecutive system IDs from here on.
+        uint8_t first_system_id = 1;
+        unsigned num_params = 0;
+        // Rate of attitude, position and IMU, 0 for none.
+        float telemetry_rate_hz = 0.0f;
+    };
+
+    // Threads used by the fleet, to tell them apart from DroneCore's.
+    static constexpr unsigned NUM_THREADS = 2;
+
+    explicit FakeFleet(const Config &config);
+    ~FakeFleet();
+
+    bool start();
+    void stop();
+
+    unsigned size() const { return unsigned(_vehicles.size()); }
+    FakeVehicle &vehicle(unsigned index) { return *_vehicles[index]; }
+
+    uint64_t get_num_messages_sent() const { return _num_messages_sent; }
+
+    // Non-copyable
+    FakeFleet(const FakeFleet &) = delete;
+    const FakeFleet &operator=(const FakeFleet &) = delete;
+
+private:
+    void send(unsigned index, const mavlink_message_t &message);
+    void receive_thread();
+    void send_thread();
+
+    const Config _config;
+    struct sockaddr_in _dronecore_addr {};
+
+    std::vector<int> _socket_fds {};
+    std::vector<std::unique_ptr<FakeVehicle>> _vehicles {};
+
+    std::unique_ptr<MAVLinkReceiver> _receiver {};
+
+    std::atomic<bool> _should_exit {false};
+    std::thread _receive_thread {};
+    std::thread _send_thread {};
+
+    std::atomic<uint64_t> _num_messages_sent {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,272 @@
+#include "fake_vehicle.h"
+#include <cstdio>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr uint8_t FakeVehicle::COMPONENT_ID;
+
+static constexpr uint64_t UID_BASE = 0xbe7c400;
+
+// There are only a few MAVLink channels but hundreds of vehicles, so they all
+// encode on one and swap their own sequence number in. DroneCore in the same
+// process sends on channel 0.
+static std::mutex encode_mutex;
+
+static uint8_t encode_channel()
+{
+    return MAVLINK_COMM_1;
+}
+
+FakeVehicle::FakeVehicle(uint8_t system_id, unsigned num_params, send_t send) :
+    _system_id(system_id),
+    _num_params(num_params),
+    _send(send)
+{}
+
+uint64_t FakeVehicle::get_uid() const
+{
+    return UID_BASE + _system_id;
+}
+
+template<typename Encode>
+void FakeVehicle::send(Encode encode)
+{
+    mavlink_message_t message;
+    {
+        std::lock_guard<std::mutex> lock(encode_mutex);
+        const uint8_t channel = encode_channel();
+        mavlink_status_t *status = mavlink_get_channel_status(channel);
+        status->current_tx_seq = _tx_seq;
+        encode(channel, &message);
+        _tx_seq = status->current_tx_seq;
+    }
+    _send(message);
+}
+
+void FakeVehicle::handle_message(const mavlink_message_t &message)
+{
+    switch (message.msgid) {
+        case MAVLINK_MSG_ID_COMMAND_LONG:
+            handle_command_long(message);
+            break;
+        case MAVLINK_MSG_ID_PARAM_REQUEST_LIST: {
+            mavlink_param_request_list_t request;
+            mavlink_msg_param_request_list_decode(&message, &request);
+            if (request.target_system == _system_id) {
+                for (unsigned i = 0; i < _num_params; ++i) {
+                    send_param(i);
+                }
+            }
+            break;
+        }
+        case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+            handle_param_request_read(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+            handle_mission_count(message);
+            break;
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+            handle_mission_item_int(message);
+            break;
+        case MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED: {
+            std::lock_guard<std::mutex> lock(_callback_mutex);
+            if (_setpoint_callback) {
+                _setpoint_callback(message);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void FakeVehicle::send_heartbeat()
+{
+    mavlink_heartbeat_t heartbeat {};
+    heartbeat.type = MAV_TYPE_QUADROTOR;
+    heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+    heartbeat.system_status = MAV_STATE_STANDBY;
+    send([&](uint8_t channel, mavlink_message_t *message) {
+        mavlink_msg_heartbeat_encode_chan(_system_id, COMPONENT_ID, channel, message, &heartbeat);
+    });
+}
+
+void FakeVehicle::send_imu(uint64_t time_usec)
+{
+    mavlink_highres_imu_t highres_imu {};
+    highres_imu.time_usec = time_usec;
+    highres_imu.zacc = -9.81f;
+    send([&](uint8_t channel, mavlink_message_t *message) {
+        mavlink_msg_highres_imu_encode_chan(_system_id, COMPONENT_ID, channel, message,
+                                            &highres_imu);
+    });
+}
+
+void FakeVehicle::send_telemetry(uint64_t time_usec)
+{
+    const uint32_t time_boot_ms = uint32_t(time_usec / 1000);
+
+    mavlink_attitude_t attitude {};
+    attitude.time_boot_ms = time_boot_ms;
+    attitude.rollspeed = 0.5f;
+    send([&](uint8_t channel, mavlink_message_t *message) {
+        mavlink_msg_attitude_encode_chan(_system_id, COMPONENT_ID, channel, message, &attitude);
+    });
+
+    // Spread over a few hundred metres so that they are told apart.
+    mavlink_global_position_int_t global_position_int {};
+    global_position_int.time_boot_ms = time_boot_ms;
+    global_position_int.lat = 473977000 + int32_t(_system_id) * 100;
+    global_position_int.lon = 85456000;
+    global_position_int.alt = 500000;
+    global_position_int.relative_alt = 10000;
+    send([&](uint8_t channel, mavlink_message_t *message) {
+        mavlink_msg_global_position_int_encode_chan(_system_id, COMPONENT_ID, channel, message,
+                                                    &global_position_int);
+    });
+
+    send_imu(time_usec);
+}
+
+void FakeVehicle::set_setpoint_callback(setpoint_callback_t callback)
+{
+    std::lock_guard<std::mutex> lock(_callback_mutex);
+    _setpoint_callback = callback;
+}
+
+std::string FakeVehicle::param_name(unsigned index)
+{
+    char name[17] {};
+    std::snprintf(name, sizeof(name), "BENCH_%05u", index);
+    return name;
+}
+
+void FakeVehicle::handle_command_long(const mavlink_message_t &message)
+{
+    mavlink_command_long_t command_long;
+    mavlink_msg_command_long_decode(&message, &command_long);
+    if (command_long.target_system != _system_id) {
+        return;
+    }
+
+    mavlink_command_ack_t command_ack {};
+    command_ack.command = command_long.command;
+    command_ack.result = MAV_RESULT_ACCEPTED;
+    send([&](uint8_t channel, mavlink_message_t *ack) {
+        mavlink_msg_command_ack_encode_chan(_system_id, COMPONENT_ID, channel, ack, &command_ack);
+    });
+
+    if (command_long.command == MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES) {
+        mavlink_autopilot_version_t autopilot_version {};
+        autopilot_version.capabilities = MAV_PROTOCOL_CAPABILITY_MISSION_INT;
+        autopilot_version.uid = get_uid();
+        send([&](uint8_t channel, mavlink_message_t *version) {
+            mavlink_msg_autopilot_version_encode_chan(_system_id, COMPONENT_ID, channel, version,
+                                                      &autopilot_version);
+        });
+    }
+}
+
+void FakeVehicle::send_param(unsigned index)
+{
+    mavlink_param_value_t param_value {};
+    const std::string name = param_name(index);
+    std::memcpy(param_value.param_id, name.c_str(), name.size());
+    param_value.param_value = float(index);
+    param_value.param_type = MAV_PARAM_TYPE_REAL32;
+    param_value.param_count = uint16_t(_num_params);
+    param_value.param_index = uint16_t(index);
+    send([&](uint8_t channel, mavlink_message_t *message) {
+        mavlink_msg_param_value_encode_chan(_system_id, COMPONENT_ID, channel, message,
+                                            &param_value);
+    });
+}
+
+void FakeVehicle::handle_param_request_read(const mavlink_message_t &message)
+{
+    mavlink_param_request_read_t request;
+    mavlink_msg_param_request_read_decode(&message, &request);
+    if (request.target_system != _system_id) {
+        return;
+    }
+    ++_num_param_reads;
+
+    if (request.param_index >= 0) {
+        if (unsigned(request.param_index) < _num_params) {
+            send_param(unsigned(request.param_index));
+        }
+        return;
+    }
+
+    char name[17] {};
+    std::memcpy(name, request.param_id, sizeof(request.param_id));
+    unsigned index = 0;
+    if (std::sscanf(name, "BENCH_%05u", &index) == 1 && index < _num_params) {
+        send_param(index);
+        return;
+    }
+
+    // Params asked for by plugins, e.g. calibration IDs, just exist.
+    mavlink_param_value_t param_value {};
+    std::memcpy(param_value.param_id, request.param_id, sizeof(param_value.param_id));
+    param_value.param_type = MAV_PARAM_TYPE_INT32;
+    param_value.param_count = uint16_t(_num_params);
+    param_value.param_index = UINT16_MAX;
+    send([&](uint8_t channel, mavlink_message_t *answer) {
+        mavlink_msg_param_value_encode_chan(_system_id, COMPONENT_ID, channel, answer,
+                                            &param_value);
+    });
+}
+
+void FakeVehicle::send_mission_request_int(uint16_t seq)
+{
+    mavlink_mission_request_int_t request {};
+    request.seq = seq;
+    request.target_system = _mission_gcs_system_id;
+    request.target_component = _mission_gcs_component_id;
+    request.mission_type = MAV_MISSION_TYPE_MISSION;
+    send([&](uint8_t channel, mavlink_message_t *message) {
+        mavlink_msg_mission_request_int_encode_chan(_system_id, COMPONENT_ID, channel, message,
+                                                    &request);
+    });
+}
+
+void FakeVehicle::handle_mission_count(const mavlink_message_t &message)
+{
+    mavlink_mission_count_t mission_count;
+    mavlink_msg_mission_count_decode(&message, &mission_count);
+    if (mission_count.target_system != _system_id) {
+        return;
+    }
+
+    _mission_count = mission_count.count;
+    _mission_gcs_system_id = message.sysid;
+    _mission_gcs_component_id = message.compid;
+    send_mission_request_int(0);
+}
+
+void FakeVehicle::handle_mission_item_int(const mavlink_message_t &message)
+{
+    mavlink_mission_item_int_t mission_item_int;
+    mavlink_msg_mission_item_int_decode(&message, &mission_item_int);
+    if (mission_item_int.target_system != _system_id) {
+        return;
+    }
+
+    if (mission_item_int.seq + 1u < _mission_count) {
+        send_mission_request_int(uint16_t(mission_item_int.seq + 1));
+        return;
+    }
+
+    mavlink_mission_ack_t mission_ack {};
+    mission_ack.target_system = _mission_gcs_system_id;
+    mission_ack.target_component = _mission_gcs_component_id;
+    mission_ack.type = MAV_MISSION_ACCEPTED;
+    mission_ack.mission_type = MAV_MISSION_TYPE_MISSION;
+    send([&](uint8_t channel, mavlink_message_t *ack) {
+        mavlink_msg_mission_ack_encode_chan(_system_id, COMPONENT_ID, channel, ack, &mission_ack);
+    });
+}
+
+} // namespace dronecore
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace dronecore {
+
+// Just enough of an autopilot to be discovered and to answer commands, params
+// and mission uploads immediately, without any sockets or threads of its own.
+// Whoever owns it feeds it the messages for it and sends what it hands out.
+class FakeVehicle
+{
+public:
+    typedef std::function<void(const mavlink_message_t &)> send_t;
+    typedef std::function<void(const mavlink_message_t &)> setpoint_callback_t;
+
+    static constexpr uint8_t COMPONENT_ID = MAV_COMP_ID_AUTOPILOT1;
+
+    FakeVehicle(uint8_t system_id, unsigned num_params, send_t send);
+
+    uint8_t get_system_id() const { return _system_id; }
+    uint64_t get_uid() const;
+
+    void handle_message(const mavlink_message_t &message);
+
+    void send_heartbeat();
+    // HIGHRES_IMU with time_usec set as given.
+    void send_imu(uint64_t time_usec);
+    // Attitude, position and IMU as a flying vehicle streams them.
+    void send_telemetry(uint64_t time_usec);
+
+    // Called for SET_POSITION_TARGET_LOCAL_NED, on the thread feeding messages.
+    void set_setpoint_callback(setpoint_callback_t callback);
+
+    unsigned get_num_param_reads() const { return _num_param_reads; }
+
+    static std::string param_name(unsigned index);
+
+    // Non-copyable
+    FakeVehicle(const FakeVehicle &) = delete;
+    const FakeVehicle &operator=(const FakeVehicle &) = delete;
+
+private:
+    template<typename Encode>
+    void send(Encode encode);
+
+    void handle_command_long(const mavlink_message_t &message);
+    void send_param(unsigned index);
+    void handle_param_request_read(const mavlink_message_t &message);
+    void send_mission_request_int(uint16_t seq);
+    void handle_mission_count(const mavlink_message_t &message);
+    void handle_mission_item_int(const mavlink_message_t &message);
+
+    const uint8_t _system_id;
+    const unsigned _num_params;
+    const send_t _send;
+
+    // Each vehicle counts its own sequence, see send().
+    uint8_t _tx_seq {0};
+
+    std::mutex _callback_mutex {};
+    setpoint_callback_t _setpoint_callback {};
+
+    std::atomic<unsigned> _num_param_reads {0};
+
+    // Only used on the thread feeding messages.
+    uint16_t _mission_count {0};
+    uint8_t _mission_gcs_system_id {0};
+    uint8_t _mission_gcs_component_id {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,212 @@
+// Drives a fleet of fake vehicles into one DroneCore instance, to see how it
+// scales with the number of systems: time until all are discovered, threads
+// and memory per system, and how much of the telemetry still gets through.
+//
+// Not run as test, run it on an otherwise idle machine:
+//
+//     build/default/benchmarks/fleet_benchmark [num_vehicles] [telemetry_rate_hz]
+//                                              [duration_s] [udp_port]
+//
+// With --generator-only as first argument, only the fleet is run, e.g. to
+// have it talk to the backend or any other process using DroneCore on that
+// port. A duration of 0 then runs it until it is killed.
+
+#include "dronecore.h"
+#include "fake_fleet.h"
+#include "plugins/telemetry/telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace dronecore;
+
+static constexpr int DEFAULT_UDP_PORT = 14590;
+static constexpr unsigned DEFAULT_NUM_VEHICLES = 100;
+static constexpr float DEFAULT_TELEMETRY_RATE_HZ = 10.0f;
+static constexpr unsigned DEFAULT_DURATION_S = 10;
+
+struct ProcessUsage {
+    unsigned num_threads;
+    size_t resident_bytes;
+    double cpu_s;
+};
+
+static ProcessUsage get_process_usage()
+{
+    ProcessUsage usage {};
+
+    DIR *dir = opendir("/proc/self/task");
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] != '.') {
+                ++usage.num_threads;
+            }
+        }
+        closedir(dir);
+    }
+
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long size_pages = 0;
+        unsigned long resident_pages = 0;
+        if (std::fscanf(statm, "%lu %lu", &size_pages, &resident_pages) == 2) {
+            usage.resident_bytes = resident_pages * size_t(sysconf(_SC_PAGESIZE));
+        }
+        std::fclose(statm);
+    }
+
+    struct rusage rusage {};
+    getrusage(RUSAGE_SELF, &rusage);
+    usage.cpu_s = double(rusage.ru_utime.tv_sec + rusage.ru_stime.tv_sec) +
+                  double(rusage.ru_utime.tv_usec + rusage.ru_stime.tv_usec) * 1e-6;
+    return usage;
+}
+
+static void print_usage(const char *name, const ProcessUsage &usage, unsigned num_fleet_threads)
+{
+    std::printf("  %-28s %4u threads  %8.1f MiB resident\n", name,
+                usage.num_threads - num_fleet_threads,
+                double(usage.resident_bytes) / (1024.0 * 1024.0));
+}
+
+static int run_generator_only(const FakeFleet::Config &config, unsigned duration_s)
+{
+    FakeFleet fleet(config);
+    if (!fleet.start()) {
+        std::printf("Could not start fleet\n");
+        return 1;
+    }
+
+    std::printf("Fleet of %u vehicles sending to UDP port %d\n",
+                config.num_vehicles, config.dronecore_port);
+
+    for (unsigned i = 0; duration_s == 0 || i < duration_s; ++i) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    std::printf("Sent %llu messages\n",
+                static_cast<unsigned long long>(fleet.get_num_messages_sent()));
+    return 0;
+}
+
+int main(int argc, const char *argv[])
+{
+    bool generator_only = false;
+    if (argc > 1 && std::strcmp(argv[1], "--generator-only") == 0) {
+        generator_only = true;
+        --argc;
+        ++argv;
+    }
+
+    FakeFleet::Config config;
+    config.num_vehicles = (argc > 1) ? unsigned(std::atoi(argv[1])) : DEFAULT_NUM_VEHICLES;
+    config.telemetry_rate_hz = (argc > 2) ? float(std::atof(argv[2])) : DEFAULT_TELEMETRY_RATE_HZ;
+    const unsigned duration_s = (argc > 3) ? unsigned(std::atoi(argv[3])) : DEFAULT_DURATION_S;
+    config.dronecore_port = (argc > 4) ? std::atoi(argv[4]) : DEFAULT_UDP_PORT;
+
+    if (generator_only) {
+        return run_generator_only(config, duration_s);
+    }
+
+    const ProcessUsage usage_start = get_process_usage();
+
+    DroneCore dc;
+    if (dc.add_udp_connection("127.0.0.1", config.dronecore_port) != ConnectionResult::SUCCESS) {
+        std::printf("Could not listen on UDP port %d\n", config.dronecore_port);
+        return 1;
+    }
+    const ProcessUsage usage_connected = get_process_usage();
+
+    std::atomic<unsigned> num_discovered {0};
+    dc.register_on_discover([&num_discovered](uint64_t) { ++num_discovered; });
+
+    FakeFleet fleet(config);
+    const auto start_time = std::chrono::steady_clock::now();
+    if (!fleet.start()) {
+        std::printf("Could not start fleet of %u vehicles\n", config.num_vehicles);
+        return 1;
+    }
+
+    // The heartbeats are spread over a second, then each vehicle needs a few
+    // round trips until the UUID is known.
+    for (int i = 0; i < 300 && num_discovered < config.num_vehicles; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    const double discover_s = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() - start_time).count();
+    const ProcessUsage usage_discovered = get_process_usage();
+
+    // Every vehicle has a telemetry plugin, as a ground station would have.
+    const std::vector<uint64_t> uuids = dc.system_uuids();
+    std::vector<std::unique_ptr<Telemetry>> telemetries;
+    std::unique_ptr<std::atomic<unsigned>[]> num_positions(
+        new std::atomic<unsigned>[uuids.size()]);
+    for (size_t i = 0; i < uuids.size(); ++i) {
+        num_positions[i] = 0;
+        telemetries.emplace_back(new Telemetry(dc.system(uuids[i])));
+        std::atomic<unsigned> *counter = &num_positions[i];
+        telemetries.back()->subscribe_position([counter](Telemetry::Position) { ++*counter; });
+    }
+    // Let the plugins finish what they do when enabled.
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    const ProcessUsage usage_plugins = get_process_usage();
+
+    for (size_t i = 0; i < uuids.size(); ++i) {
+        num_positions[i] = 0;
+    }
+    const uint64_t num_sent_before = fleet.get_num_messages_sent();
+    std::this_thread::sleep_for(std::chrono::seconds(duration_s));
+    const uint64_t num_sent = fleet.get_num_messages_sent() - num_sent_before;
+    const ProcessUsage usage_end = get_process_usage();
+
+    unsigned total_positions = 0;
+    unsigned min_positions = uuids.empty() ? 0 : num_positions[0].load();
+    for (size_t i = 0; i < uuids.size(); ++i) {
+        total_positions += num_positions[i];
+        min_positions = std::min(min_positions, num_positions[i].load());
+    }
+
+    fleet.stop();
+
+    std::printf("DroneCore with %u fake vehicles, telemetry at %.1f Hz\n",
+                config.num_vehicles, double(config.telemetry_rate_hz));
+    std::printf("  %-28s %u of %u in %.2f s\n", "discovered", num_discovered.load(),
+                config.num_vehicles, discover_s);
+
+    print_usage("at start", usage_start, 0);
+    print_usage("connection added", usage_connected, 0);
+    print_usage("all discovered", usage_discovered, FakeFleet::NUM_THREADS);
+    print_usage("telemetry plugins added", usage_plugins, FakeFleet::NUM_THREADS);
+
+    if (!uuids.empty()) {
+        const double num_systems = double(uuids.size());
+        std::printf("  %-28s %8.1f KiB resident, %.2f threads\n", "per system",
+                    double(usage_plugins.resident_bytes - usage_connected.resident_bytes) /
+                    1024.0 / num_systems,
+                    double(int(usage_plugins.num_threads - FakeFleet::NUM_THREADS) -
+                           int(usage_connected.num_threads)) / num_systems);
+    }
+
+    const double expected_positions = double(config.telemetry_rate_hz) * double(duration_s) *
+                                      double(uuids.size());
+    std::printf("  %-28s %u of %.0f, fewest for one system %u\n", "positions received",
+                total_positions, expected_positions, min_positions);
+    std::printf("  %-28s %10.0f messages/s\n", "sent by fleet",
+                duration_s > 0 ? double(num_sent) / double(duration_s) : 0.0);
+    std::printf("  %-28s %10.1f %% of a core, including the fleet\n", "CPU",
+                duration_s > 0 ? 100.0 * (usage_end.cpu_s - usage_plugins.cpu_s) /
+                double(duration_s) : 0.0);
+    return 0;
+}
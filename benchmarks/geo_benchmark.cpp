@@ -0,0 +1,139 @@
+// Times the batch geo conversions against calling the single ones in a loop,
+// for a fleet's worth of positions up to a large point cloud.
+//
+// Not run as test, run it on an otherwise idle machine:
+//
+//     build/default/benchmarks/geo_benchmark [num_positions] [num_rounds]
+//
+// Whether the batch versions are faster depends on the compiler having vector
+// versions of sin, cos and atan2 (e.g. glibc's libmvec with -ffast-math).
+
+#include "geo.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace dronecore;
+
+static constexpr unsigned DEFAULT_NUM_POSITIONS = 100000;
+static constexpr unsigned DEFAULT_NUM_ROUNDS = 20;
+
+static double time_ns_per_position(const std::function<void()> &run, unsigned num_positions,
+                                   unsigned num_rounds)
+{
+    // Once to warm up caches.
+    run();
+
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < num_rounds; ++i) {
+        run();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return double(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+           (double(num_positions) * double(num_rounds));
+}
+
+static void print_result(const char *name, double single_ns, double batch_ns)
+{
+    printf("%-24s single %7.1f ns  batch %7.1f ns  speedup %.2fx\n",
+           name, single_ns, batch_ns, single_ns / batch_ns);
+}
+
+int main(int argc, char **argv)
+{
+    const unsigned num_positions = (argc > 1) ? unsigned(atoi(argv[1])) : DEFAULT_NUM_POSITIONS;
+    const unsigned num_rounds = (argc > 2) ? unsigned(atoi(argv[2])) : DEFAULT_NUM_ROUNDS;
+    if (num_positions == 0 || num_rounds == 0) {
+        fprintf(stderr, "Usage: %s [num_positions] [num_rounds]\n", argv[0]);
+        return 1;
+    }
+
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> offset_deg(-0.05, 0.05);
+    std::uniform_real_distribution<double> altitude_m(400.0, 600.0);
+
+    std::vector<double> latitude(num_positions), longitude(num_positions),
+        altitude(num_positions);
+    for (unsigned i = 0; i < num_positions; ++i) {
+        latitude[i] = 47.3977 + offset_deg(random);
+        longitude[i] = 8.5456 + offset_deg(random);
+        altitude[i] = altitude_m(random);
+    }
+
+    std::vector<double> a(num_positions), b(num_positions), c(num_positions);
+    const EnuFrame frame(47.3977, 8.5456, 488.0);
+
+    printf("%u positions, %u rounds\n", num_positions, num_rounds);
+
+    print_result("geodetic to ECEF",
+    time_ns_per_position([&]() {
+        for (unsigned i = 0; i < num_positions; ++i) {
+            to_ecef_from_geodetic(latitude[i], longitude[i], altitude[i], a[i], b[i], c[i]);
+        }
+    }, num_positions, num_rounds),
+    time_ns_per_position([&]() {
+        to_ecef_from_geodetic(latitude.data(), longitude.data(), altitude.data(),
+                              num_positions, a.data(), b.data(), c.data());
+    }, num_positions, num_rounds));
+
+    // Converts back the ECEF positions of above.
+    std::vector<double> x(a), y(b), z(c);
+    print_result("ECEF to geodetic",
+    time_ns_per_position([&]() {
+        for (unsigned i = 0; i < num_positions; ++i) {
+            to_geodetic_from_ecef(x[i], y[i], z[i], a[i], b[i], c[i]);
+        }
+    }, num_positions, num_rounds),
+    time_ns_per_position([&]() {
+        to_geodetic_from_ecef(x.data(), y.data(), z.data(), num_positions,
+                              a.data(), b.data(), c.data());
+    }, num_positions, num_rounds));
+
+    print_result("geodetic to ENU",
+    time_ns_per_position([&]() {
+        for (unsigned i = 0; i < num_positions; ++i) {
+            frame.to_enu(latitude[i], longitude[i], altitude[i], a[i], b[i], c[i]);
+        }
+    }, num_positions, num_rounds),
+    time_ns_per_position([&]() {
+        frame.to_enu(latitude.data(), longitude.data(), altitude.data(), num_positions,
+                     a.data(), b.data(), c.data());
+    }, num_positions, num_rounds));
+
+    print_result("haversine distance",
+    time_ns_per_position([&]() {
+        for (unsigned i = 0; i < num_positions; ++i) {
+            a[i] = haversine_distance_m(47.3977, 8.5456, latitude[i], longitude[i]);
+        }
+    }, num_positions, num_rounds),
+    time_ns_per_position([&]() {
+        haversine_distances_m(47.3977, 8.5456, latitude.data(), longitude.data(),
+                              num_positions, a.data());
+    }, num_positions, num_rounds));
+
+    print_result("initial bearing",
+    time_ns_per_position([&]() {
+        for (unsigned i = 0; i < num_positions; ++i) {
+            a[i] = initial_bearing_deg(47.3977, 8.5456, latitude[i], longitude[i]);
+        }
+    }, num_positions, num_rounds),
+    time_ns_per_position([&]() {
+        initial_bearings_deg(47.3977, 8.5456, latitude.data(), longitude.data(),
+                             num_positions, a.data());
+    }, num_positions, num_rounds));
+
+    // No batch version, for comparison with haversine only.
+    const double vincenty_ns = time_ns_per_position([&]() {
+        for (unsigned i = 0; i < num_positions; ++i) {
+            a[i] = vincenty_distance_m(47.3977, 8.5456, latitude[i], longitude[i]);
+        }
+    }, num_positions, num_rounds);
+    printf("%-24s single %7.1f ns\n", "vincenty distance", vincenty_ns);
+
+    return 0;
+}
@@ -0,0 +1,313 @@
+// Measures latency and throughput of DroneCore end to end, over UDP on
+// localhost against a fake autopilot which answers right away:
+//
+// - telemetry: HIGHRES_IMU datagram sent until the subscriber is called
+// - offboard: set_velocity_ned() until the setpoint arrives at the autopilot
+// - command: COMMAND_LONG round trip until the ACK is handed back
+// - params: download of all params with PARAM_REQUEST_LIST
+// - mission: upload of 1k and 10k items
+//
+// Not run as test, run it on an otherwise idle machine:
+//
+//     build/default/benchmarks/latency_benchmark [udp_port]
+
+#include "dronecore.h"
+#include "fake_fleet.h"
+#include "mavlink_system.h"
+#include "plugin_impl_base.h"
+#include "system.h"
+#include "plugins/mission/mission.h"
+#include "plugins/offboard/offboard.h"
+#include "plugins/telemetry/telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+static constexpr int DEFAULT_UDP_PORT = 14590;
+
+static uint64_t now_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Prints the percentiles of latencies in microseconds.
+static void print_latencies(const char *name, std::vector<uint64_t> latencies_us,
+                            size_t num_sent)
+{
+    if (latencies_us.empty()) {
+        std::printf("  %-28s nothing received of %zu\n", name, num_sent);
+        return;
+    }
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    auto percentile = [&latencies_us](double p) {
+        const size_t index = std::min(latencies_us.size() - 1,
+                                      size_t(p * double(latencies_us.size())));
+        return latencies_us[index];
+    };
+
+    std::printf("  %-28s p50 %8llu us  p99 %8llu us  p999 %8llu us  max %8llu us  (%zu/%zu)\n",
+                name,
+                static_cast<unsigned long long>(percentile(0.5)),
+                static_cast<unsigned long long>(percentile(0.99)),
+                static_cast<unsigned long long>(percentile(0.999)),
+                static_cast<unsigned long long>(latencies_us.back()),
+                latencies_us.size(), num_sent);
+}
+
+static void print_throughput(const char *name, size_t num, double duration_s, const char *unit)
+{
+    std::printf("  %-28s %10.0f %s/s  (%zu in %.3f s)\n", name,
+                duration_s > 0.0 ? double(num) / duration_s : 0.0, unit, num, duration_s);
+}
+
+// Gets to the internals like a plugin does, to send commands and params directly.
+class MAVLinkAccess : public PluginImplBase
+{
+public:
+    explicit MAVLinkAccess(System &system) : PluginImplBase(system) {}
+
+    void init() override {}
+    void deinit() override {}
+    void enable() override {}
+    void disable() override {}
+
+    MAVLinkSystem &mavlink_system() { return *_parent; }
+};
+
+static void benchmark_telemetry(FakeVehicle &autopilot, Telemetry &telemetry)
+{
+    static constexpr size_t NUM_LATENCY_MESSAGES = 10000;
+    static constexpr size_t NUM_THROUGHPUT_MESSAGES = 100000;
+
+    std::mutex mutex;
+    std::vector<uint64_t> latencies_us;
+    latencies_us.reserve(NUM_LATENCY_MESSAGES);
+    std::atomic<size_t> num_received {0};
+    std::atomic<bool> record {true};
+
+    const Telemetry::subscription_handle_t handle = telemetry.subscribe_imu(
+    [&](Telemetry::IMU imu) {
+        const uint64_t received_us = now_us();
+        ++num_received;
+        if (record) {
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies_us.push_back(received_us - imu.timestamp_us);
+        }
+    });
+
+    // Paced at 1 kHz, which is what a fast IMU stream has.
+    for (size_t i = 0; i < NUM_LATENCY_MESSAGES; ++i) {
+        autopilot.send_imu(now_us());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    record = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        print_latencies("telemetry dispatch (1 kHz)", latencies_us, NUM_LATENCY_MESSAGES);
+    }
+
+    // As fast as we can send, whatever doesn't fit in the socket buffer is lost.
+    num_received = 0;
+    const uint64_t start_us = now_us();
+    for (size_t i = 0; i < NUM_THROUGHPUT_MESSAGES; ++i) {
+        autopilot.send_imu(now_us());
+    }
+    size_t last_num_received = 0;
+    uint64_t last_change_us = now_us();
+    while (now_us() - last_change_us < 200000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (num_received != last_num_received) {
+            last_num_received = num_received;
+            last_change_us = now_us();
+        }
+    }
+    print_throughput("telemetry dispatch (max)", last_num_received,
+                     double(last_change_us - start_us) * 1e-6, "messages");
+
+    telemetry.unsubscribe(handle);
+}
+
+static void benchmark_offboard(FakeVehicle &autopilot, Offboard &offboard)
+{
+    static constexpr size_t NUM_SETPOINTS = 10000;
+
+    std::mutex mutex;
+    std::vector<uint64_t> sent_us(NUM_SETPOINTS, 0);
+    std::vector<bool> have_received(NUM_SETPOINTS, false);
+    std::vector<uint64_t> latencies_us;
+    latencies_us.reserve(NUM_SETPOINTS);
+
+    autopilot.set_setpoint_callback([&](const mavlink_message_t &message) {
+        const uint64_t received_us = now_us();
+        mavlink_set_position_target_local_ned_t setpoint;
+        mavlink_msg_set_position_target_local_ned_decode(&message, &setpoint);
+
+        // The index is sent as velocity, also resends only count once.
+        const size_t index = size_t(setpoint.vx);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (index < NUM_SETPOINTS && sent_us[index] != 0 && !have_received[index]) {
+            have_received[index] = true;
+            latencies_us.push_back(received_us - sent_us[index]);
+        }
+    });
+
+    for (size_t i = 0; i < NUM_SETPOINTS; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sent_us[i] = now_us();
+        }
+        offboard.set_velocity_ned({float(i), 0.0f, 0.0f, 0.0f});
+        // Setpoints usually come at 50 to 100 Hz, here faster to get samples.
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    autopilot.set_setpoint_callback(nullptr);
+    print_latencies("set_velocity_ned to wire", latencies_us, NUM_SETPOINTS);
+}
+
+static void benchmark_commands(MAVLinkSystem &mavlink_system)
+{
+    static constexpr size_t NUM_COMMANDS = 2000;
+
+    std::vector<uint64_t> latencies_us;
+    latencies_us.reserve(NUM_COMMANDS);
+
+    const uint64_t start_us = now_us();
+    for (size_t i = 0; i < NUM_COMMANDS; ++i) {
+        MAVLinkCommands::CommandLong command {};
+        command.command = MAV_CMD_COMPONENT_ARM_DISARM;
+        command.params.param1 = 0.0f;
+        command.target_component_id = FakeVehicle::COMPONENT_ID;
+
+        const uint64_t sent_us = now_us();
+        if (mavlink_system.send_command(command) == MAVLinkCommands::Result::SUCCESS) {
+            latencies_us.push_back(now_us() - sent_us);
+        }
+    }
+    const double duration_s = double(now_us() - start_us) * 1e-6;
+
+    print_latencies("command round trip", latencies_us, NUM_COMMANDS);
+    print_throughput("commands (one at a time)", latencies_us.size(), duration_s, "commands");
+}
+
+static void benchmark_params(FakeVehicle &autopilot, MAVLinkSystem &mavlink_system,
+                             unsigned num_params)
+{
+    auto prom = std::make_shared<std::promise<bool>>();
+    auto fut = prom->get_future();
+
+    const uint64_t start_us = now_us();
+    const unsigned num_reads_before = autopilot.get_num_param_reads();
+
+    // The get waits for the download and is then answered from the cache.
+    mavlink_system.request_all_params_async();
+    mavlink_system.get_param_float_async(
+        FakeVehicle::param_name(num_params - 1),
+    [prom](bool success, float) {
+        prom->set_value(success);
+    });
+
+    if (fut.wait_for(std::chrono::seconds(30)) != std::future_status::ready || !fut.get()) {
+        std::printf("  %-28s failed\n", "param download");
+        return;
+    }
+    const double duration_s = double(now_us() - start_us) * 1e-6;
+
+    print_throughput("param download", num_params, duration_s, "params");
+    std::printf("  %-28s %10u\n", "params read again",
+                autopilot.get_num_param_reads() - num_reads_before);
+}
+
+static void benchmark_mission(Mission &mission, size_t num_items)
+{
+    std::vector<std::shared_ptr<MissionItem>> items;
+    for (size_t i = 0; i < num_items; ++i) {
+        auto item = std::make_shared<MissionItem>();
+        item->set_position(47.39 + double(i) * 1e-5, 8.54);
+        item->set_relative_altitude(10.0f);
+        items.push_back(item);
+    }
+
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto fut = prom->get_future();
+
+    const uint64_t start_us = now_us();
+    mission.upload_mission_async(items, [prom](Mission::Result result) {
+        prom->set_value(result);
+    });
+
+    if (fut.wait_for(std::chrono::seconds(120)) != std::future_status::ready ||
+        fut.get() != Mission::Result::SUCCESS) {
+        std::printf("  mission upload (%zu items) failed\n", num_items);
+        return;
+    }
+    const double duration_s = double(now_us() - start_us) * 1e-6;
+
+    const std::string name = "mission upload (" + std::to_string(num_items) + ")";
+    print_throughput(name.c_str(), num_items, duration_s, "items");
+}
+
+int main(int argc, const char *argv[])
+{
+    const int port = (argc > 1) ? std::atoi(argv[1]) : DEFAULT_UDP_PORT;
+    static constexpr unsigned NUM_PARAMS = 1000;
+
+    DroneCore dc;
+    if (dc.add_udp_connection("127.0.0.1", port) != ConnectionResult::SUCCESS) {
+        std::printf("Could not listen on UDP port %d\n", port);
+        return 1;
+    }
+
+    FakeFleet::Config config;
+    config.dronecore_port = port;
+    config.num_params = NUM_PARAMS;
+    FakeFleet fleet(config);
+    if (!fleet.start()) {
+        std::printf("Could not start fake autopilot\n");
+        return 1;
+    }
+
+    for (int i = 0; i < 100 && !dc.is_connected(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (!dc.is_connected()) {
+        std::printf("Fake autopilot was not discovered\n");
+        return 1;
+    }
+
+    System &system = dc.system();
+    Telemetry telemetry(system);
+    Offboard offboard(system);
+    Mission mission(system);
+    MAVLinkAccess mavlink_access(system);
+
+    // Let the plugins finish what they do when enabled.
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    std::printf("DroneCore end to end, UDP on localhost\n");
+    FakeVehicle &autopilot = fleet.vehicle(0);
+    benchmark_telemetry(autopilot, telemetry);
+    benchmark_offboard(autopilot, offboard);
+    benchmark_commands(mavlink_access.mavlink_system());
+    benchmark_params(autopilot, mavlink_access.mavlink_system(), NUM_PARAMS);
+    benchmark_mission(mission, 1000);
+    benchmark_mission(mission, 10000);
+
+    fleet.stop();
+    return 0;
+}
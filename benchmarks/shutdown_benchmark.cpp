@@ -0,0 +1,132 @@
+// Measures how long destroying DroneCore takes, e.g. for a service restart:
+// a number of UDP connections, each with fake vehicles discovered on it and a
+// telemetry plugin per vehicle, then the time until the destructor returns.
+//
+// Not run as test, run it on an otherwise idle machine:
+//
+//     build/default/benchmarks/shutdown_benchmark [num_connections]
+//                                                 [vehicles_per_connection] [num_rounds]
+//                                                 [first_udp_port]
+
+#include "dronecore.h"
+#include "fake_fleet.h"
+#include "plugins/telemetry/telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+static constexpr int DEFAULT_FIRST_UDP_PORT = 14600;
+static constexpr unsigned DEFAULT_NUM_CONNECTIONS = 8;
+static constexpr unsigned DEFAULT_VEHICLES_PER_CONNECTION = 4;
+static constexpr unsigned DEFAULT_NUM_ROUNDS = 5;
+
+struct Round {
+    double discover_s;
+    double shutdown_s;
+};
+
+static bool run_round(unsigned num_connections, unsigned vehicles_per_connection,
+                      int first_port, Round &round)
+{
+    std::unique_ptr<DroneCore> dc(new DroneCore());
+    std::atomic<unsigned> num_discovered {0};
+    dc->register_on_discover([&num_discovered](uint64_t) { ++num_discovered; });
+
+    std::vector<std::unique_ptr<FakeFleet>> fleets;
+    const auto start_time = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < num_connections; ++i) {
+        const int port = first_port + int(i);
+        if (dc->add_udp_connection("127.0.0.1", port) != ConnectionResult::SUCCESS) {
+            std::printf("Could not listen on UDP port %d\n", port);
+            return false;
+        }
+
+        FakeFleet::Config config;
+        config.dronecore_port = port;
+        config.num_vehicles = vehicles_per_connection;
+        config.first_system_id = uint8_t(1 + i * vehicles_per_connection);
+        config.telemetry_rate_hz = 10.0f;
+        fleets.emplace_back(new FakeFleet(config));
+        if (!fleets.back()->start()) {
+            std::printf("Could not start fleet on UDP port %d\n", port);
+            return false;
+        }
+    }
+
+    const unsigned num_vehicles = num_connections * vehicles_per_connection;
+    for (int i = 0; i < 300 && num_discovered < num_vehicles; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    round.discover_s = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start_time).count();
+
+    // Plugins are destroyed before DroneCore, as an application would do.
+    {
+        std::vector<std::unique_ptr<Telemetry>> telemetries;
+        for (uint64_t uuid : dc->system_uuids()) {
+            telemetries.emplace_back(new Telemetry(dc->system(uuid)));
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    // The fleets keep sending meanwhile, like vehicles would.
+    const auto shutdown_start = std::chrono::steady_clock::now();
+    dc.reset();
+    round.shutdown_s = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - shutdown_start).count();
+
+    for (auto &fleet : fleets) {
+        fleet->stop();
+    }
+    return true;
+}
+
+int main(int argc, const char *argv[])
+{
+    const unsigned num_connections = (argc > 1) ? unsigned(std::atoi(argv[1])) :
+                                     DEFAULT_NUM_CONNECTIONS;
+    const unsigned vehicles_per_connection = (argc > 2) ? unsigned(std::atoi(argv[2])) :
+                                             DEFAULT_VEHICLES_PER_CONNECTION;
+    const unsigned num_rounds = (argc > 3) ? unsigned(std::atoi(argv[3])) : DEFAULT_NUM_ROUNDS;
+    const int first_port = (argc > 4) ? std::atoi(argv[4]) : DEFAULT_FIRST_UDP_PORT;
+
+    if (num_connections == 0 || num_rounds == 0 ||
+        num_connections * vehicles_per_connection > 250) {
+        std::fprintf(stderr, "Usage: %s [num_connections] [vehicles_per_connection] "
+                     "[num_rounds] [first_udp_port]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<Round> rounds;
+    for (unsigned i = 0; i < num_rounds; ++i) {
+        Round round {};
+        if (!run_round(num_connections, vehicles_per_connection, first_port, round)) {
+            return 1;
+        }
+        rounds.push_back(round);
+    }
+
+    std::printf("DroneCore with %u UDP connections, %u vehicles each\n",
+                num_connections, vehicles_per_connection);
+    for (size_t i = 0; i < rounds.size(); ++i) {
+        std::printf("  round %-3zu discovered in %7.3f s, shut down in %8.2f ms\n", i + 1,
+                    rounds[i].discover_s, rounds[i].shutdown_s * 1e3);
+    }
+
+    std::vector<double> shutdown_s;
+    for (const auto &round : rounds) {
+        shutdown_s.push_back(round.shutdown_s);
+    }
+    std::sort(shutdown_s.begin(), shutdown_s.end());
+    std::printf("  %-28s %8.2f ms median, %8.2f ms max\n", "shutdown",
+                shutdown_s[shutdown_s.size() / 2] * 1e3, shutdown_s.back() * 1e3);
+    return 0;
+}
@@ -0,0 +1,315 @@
+// Runs DroneCore against a fleet of fake vehicles for hours, to find what only
+// shows up in the field after a long time: callbacks or memory piling up,
+// threads which are never joined, dispatch getting slower and slower.
+//
+// Every vehicle streams telemetry to a telemetry plugin and once a second one
+// of them gets a command and a subscription added and removed, as a ground
+// station would do. At every sample the resident memory, threads, queue depths
+// and the p99 latency of the IMU callbacks are printed. At the end the last
+// tenth of the run is compared to the tenth after the first one, which is left
+// for warming up, and it fails if anything grew by more than:
+//
+// - threads: any thread
+// - resident memory: 16 MiB and 20 %
+// - queued callbacks or messages: 100 on average
+// - p99 callback latency: 1 ms and twice as much
+//
+// It also fails if less than half of the telemetry got through at the end.
+//
+// Not run as test, it takes hours by default:
+//
+//     build/default/benchmarks/soak_test [duration_h] [num_vehicles] [telemetry_rate_hz]
+//                                        [sample_interval_s] [udp_port]
+//
+// The duration can be a fraction, e.g. 0.05 for 3 minutes to try it out.
+
+#include "dronecore.h"
+#include "fake_fleet.h"
+#include "plugins/telemetry/telemetry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+using namespace dronecore;
+
+static constexpr int DEFAULT_UDP_PORT = 14610;
+static constexpr double DEFAULT_DURATION_H = 4.0;
+static constexpr unsigned DEFAULT_NUM_VEHICLES = 20;
+static constexpr float DEFAULT_TELEMETRY_RATE_HZ = 10.0f;
+static constexpr unsigned DEFAULT_SAMPLE_INTERVAL_S = 60;
+
+static constexpr unsigned MAX_THREAD_GROWTH = 0;
+static constexpr double MAX_RESIDENT_GROWTH_BYTES = 16.0 * 1024.0 * 1024.0;
+static constexpr double MAX_RESIDENT_GROWTH_RATIO = 1.2;
+static constexpr double MAX_QUEUE_GROWTH = 100.0;
+static constexpr double MAX_LATENCY_GROWTH_US = 1000.0;
+static constexpr double MAX_LATENCY_GROWTH_RATIO = 2.0;
+static constexpr double MIN_TELEMETRY_RATIO = 0.5;
+
+struct Sample {
+    double elapsed_s;
+    unsigned num_threads;
+    size_t resident_bytes;
+    DroneCore::QueueDepths queue_depths;
+    uint64_t p99_latency_us;
+    size_t num_imu_received;
+};
+
+static uint64_t now_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static unsigned get_num_threads()
+{
+    unsigned num_threads = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (dir) {
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            if (entry->d_name[0] != '.') {
+                ++num_threads;
+            }
+        }
+        closedir(dir);
+    }
+    return num_threads;
+}
+
+static size_t get_resident_bytes()
+{
+    size_t resident_bytes = 0;
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm) {
+        unsigned long size_pages = 0;
+        unsigned long resident_pages = 0;
+        if (std::fscanf(statm, "%lu %lu", &size_pages, &resident_pages) == 2) {
+            resident_bytes = resident_pages * size_t(sysconf(_SC_PAGESIZE));
+        }
+        std::fclose(statm);
+    }
+    return resident_bytes;
+}
+
+static uint64_t get_p99(std::vector<uint64_t> &latencies_us)
+{
+    if (latencies_us.empty()) {
+        return 0;
+    }
+    const size_t index = std::min(latencies_us.size() - 1,
+                                  size_t(0.99 * double(latencies_us.size())));
+    std::nth_element(latencies_us.begin(), latencies_us.begin() + long(index),
+                     latencies_us.end());
+    return latencies_us[index];
+}
+
+// Average of a field over samples [begin, end).
+template<typename Get>
+static double average(const std::vector<Sample> &samples, size_t begin, size_t end, Get get)
+{
+    double sum = 0.0;
+    for (size_t i = begin; i < end; ++i) {
+        sum += double(get(samples[i]));
+    }
+    return sum / double(end - begin);
+}
+
+static void print_sample(const Sample &sample)
+{
+    std::printf("  %8.0f s %4u threads %8.1f MiB  queued %5llu callbacks %5llu dispatch "
+                "%5llu ingest  p99 %8llu us  %zu IMU\n",
+                sample.elapsed_s, sample.num_threads,
+                double(sample.resident_bytes) / (1024.0 * 1024.0),
+                static_cast<unsigned long long>(sample.queue_depths.callbacks),
+                static_cast<unsigned long long>(sample.queue_depths.dispatch),
+                static_cast<unsigned long long>(sample.queue_depths.ingest),
+                static_cast<unsigned long long>(sample.p99_latency_us),
+                sample.num_imu_received);
+    std::fflush(stdout);
+}
+
+// Prints the comparison and returns false if it grew too much.
+static bool check(const char *name, double baseline, double end, double max_growth,
+                  double max_ratio)
+{
+    const bool ok = end <= baseline + max_growth || end <= baseline * max_ratio;
+    std::printf("  %-28s %12.1f -> %12.1f  %s\n", name, baseline, end, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool evaluate(const std::vector<Sample> &samples, double expected_imu_per_sample)
+{
+    const size_t window = std::max<size_t>(1, samples.size() / 10);
+    const size_t baseline_begin = window;
+    const size_t baseline_end = 2 * window;
+    const size_t end_begin = samples.size() - window;
+
+    auto compare = [&](const char *name, double max_growth, double max_ratio,
+    double (*get)(const Sample &)) {
+        return check(name, average(samples, baseline_begin, baseline_end, get),
+                     average(samples, end_begin, samples.size(), get), max_growth, max_ratio);
+    };
+
+    std::printf("Averages of samples %zu to %zu compared to the last %zu:\n",
+                baseline_begin + 1, baseline_end, window);
+    bool ok = true;
+    ok &= compare("threads", double(MAX_THREAD_GROWTH), 1.0, [](const Sample &sample) {
+        return double(sample.num_threads);
+    });
+    ok &= compare("resident MiB", MAX_RESIDENT_GROWTH_BYTES / (1024.0 * 1024.0),
+    MAX_RESIDENT_GROWTH_RATIO, [](const Sample &sample) {
+        return double(sample.resident_bytes) / (1024.0 * 1024.0);
+    });
+    ok &= compare("queued callbacks", MAX_QUEUE_GROWTH, 1.0, [](const Sample &sample) {
+        return double(sample.queue_depths.callbacks);
+    });
+    ok &= compare("queued dispatch", MAX_QUEUE_GROWTH, 1.0, [](const Sample &sample) {
+        return double(sample.queue_depths.dispatch);
+    });
+    ok &= compare("queued ingest", MAX_QUEUE_GROWTH, 1.0, [](const Sample &sample) {
+        return double(sample.queue_depths.ingest);
+    });
+    ok &= compare("p99 callback latency us", MAX_LATENCY_GROWTH_US, MAX_LATENCY_GROWTH_RATIO,
+    [](const Sample &sample) {
+        return double(sample.p99_latency_us);
+    });
+
+    const double imu_received = average(samples, end_begin, samples.size(),
+    [](const Sample &sample) {
+        return double(sample.num_imu_received);
+    });
+    const bool telemetry_ok = imu_received >= MIN_TELEMETRY_RATIO * expected_imu_per_sample;
+    std::printf("  %-28s %12.1f of %9.1f  %s\n", "IMU received per sample", imu_received,
+                expected_imu_per_sample, telemetry_ok ? "ok" : "FAILED");
+    return ok && telemetry_ok;
+}
+
+int main(int argc, const char *argv[])
+{
+    const double duration_h = (argc > 1) ? std::atof(argv[1]) : DEFAULT_DURATION_H;
+    FakeFleet::Config config;
+    config.num_vehicles = (argc > 2) ? unsigned(std::atoi(argv[2])) : DEFAULT_NUM_VEHICLES;
+    config.telemetry_rate_hz = (argc > 3) ? float(std::atof(argv[3])) : DEFAULT_TELEMETRY_RATE_HZ;
+    const unsigned sample_interval_s = (argc > 4) ? unsigned(std::atoi(argv[4])) :
+                                       DEFAULT_SAMPLE_INTERVAL_S;
+    config.dronecore_port = (argc > 5) ? std::atoi(argv[5]) : DEFAULT_UDP_PORT;
+
+    const double duration_s = duration_h * 3600.0;
+    if (config.num_vehicles == 0 || config.num_vehicles > 250 ||
+        !(config.telemetry_rate_hz > 0.0f) || sample_interval_s == 0 ||
+        duration_s < 3.0 * double(sample_interval_s)) {
+        std::fprintf(stderr, "Usage: %s [duration_h] [num_vehicles] [telemetry_rate_hz] "
+                     "[sample_interval_s] [udp_port]\n"
+                     "The duration needs to be at least 3 sample intervals.\n", argv[0]);
+        return 1;
+    }
+
+    DroneCore dc;
+    if (dc.add_udp_connection("127.0.0.1", config.dronecore_port) != ConnectionResult::SUCCESS) {
+        std::printf("Could not listen on UDP port %d\n", config.dronecore_port);
+        return 1;
+    }
+
+    std::atomic<unsigned> num_discovered {0};
+    dc.register_on_discover([&num_discovered](uint64_t) { ++num_discovered; });
+
+    FakeFleet fleet(config);
+    if (!fleet.start()) {
+        std::printf("Could not start fleet of %u vehicles\n", config.num_vehicles);
+        return 1;
+    }
+    for (int i = 0; i < 300 && num_discovered < config.num_vehicles; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    if (num_discovered < config.num_vehicles) {
+        std::printf("Only %u of %u vehicles discovered\n", num_discovered.load(),
+                    config.num_vehicles);
+        return 1;
+    }
+
+    // Declared before the plugins, their callbacks may still come in until they are gone.
+    std::atomic<unsigned> num_commands_failed {0};
+
+    // The fake vehicles stamp the IMU with the time they send it.
+    std::mutex mutex;
+    std::vector<uint64_t> latencies_us;
+    std::vector<std::unique_ptr<Telemetry>> telemetries;
+    for (uint64_t uuid : dc.system_uuids()) {
+        telemetries.emplace_back(new Telemetry(dc.system(uuid)));
+        telemetries.back()->subscribe_imu([&mutex, &latencies_us](Telemetry::IMU imu) {
+            const uint64_t received_us = now_us();
+            std::lock_guard<std::mutex> lock(mutex);
+            latencies_us.push_back(received_us - imu.timestamp_us);
+        });
+    }
+
+    std::printf("DroneCore with %u fake vehicles, telemetry at %.1f Hz, for %.2f h\n",
+                config.num_vehicles, double(config.telemetry_rate_hz), duration_h);
+
+    std::vector<Sample> samples;
+    std::vector<uint64_t> sample_latencies_us;
+    const auto start_time = std::chrono::steady_clock::now();
+    auto next_sample_time = start_time + std::chrono::seconds(sample_interval_s);
+    const auto end_time = start_time + std::chrono::duration_cast<std::chrono::seconds>(
+                              std::chrono::duration<double>(duration_s));
+
+    for (unsigned tick = 0; std::chrono::steady_clock::now() < end_time; ++tick) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        Telemetry &telemetry = *telemetries[tick % telemetries.size()];
+        telemetry.set_rate_position_async(double(config.telemetry_rate_hz),
+        [&num_commands_failed](Telemetry::Result result) {
+            if (result != Telemetry::Result::SUCCESS) {
+                ++num_commands_failed;
+            }
+        });
+        telemetry.unsubscribe(telemetry.subscribe_position([](Telemetry::Position) {}));
+
+        if (std::chrono::steady_clock::now() < next_sample_time) {
+            continue;
+        }
+        next_sample_time += std::chrono::seconds(sample_interval_s);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            sample_latencies_us.swap(latencies_us);
+            latencies_us.clear();
+        }
+
+        Sample sample {};
+        sample.elapsed_s = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start_time).count();
+        sample.num_threads = get_num_threads() - FakeFleet::NUM_THREADS;
+        sample.resident_bytes = get_resident_bytes();
+        sample.queue_depths = dc.get_queue_depths();
+        sample.num_imu_received = sample_latencies_us.size();
+        sample.p99_latency_us = get_p99(sample_latencies_us);
+        samples.push_back(sample);
+        print_sample(sample);
+    }
+
+    fleet.stop();
+
+    if (samples.size() < 3) {
+        std::printf("Only %zu samples, not enough to compare\n", samples.size());
+        return 1;
+    }
+
+    const double expected_imu_per_sample = double(config.telemetry_rate_hz) *
+                                           double(sample_interval_s) *
+                                           double(config.num_vehicles);
+    const bool ok = evaluate(samples, expected_imu_per_sample);
+    std::printf("  %-28s %u\n", "commands failed", num_commands_failed.load());
+    return ok ? 0 : 1;
+}
@@ -8,17 +8,56 @@ add_executable(unit_tests_runner
 
 target_compile_definitions(unit_tests_runner PRIVATE FAKE_TIME=1)
 
+# The coroutine support is for applications on C++20, so is its test.
+include(CheckCXXCompilerFlag)
+check_cxx_compiler_flag(-std=c++20 COMPILER_SUPPORTS_CXX20)
+if (COMPILER_SUPPORTS_CXX20)
+    set_source_files_properties(${CMAKE_SOURCE_DIR}/core/awaitable_test.cpp
+        PROPERTIES COMPILE_FLAGS -std=c++20
+    )
+endif()
+
 set_target_properties(unit_tests_runner
     PROPERTIES COMPILE_FLAGS ${warnings}
 )
 
+# The HTTP loader is tested against the curl mock.
+set_source_files_properties(${CMAKE_SOURCE_DIR}/plugins/camera/http_loader_test.cpp
+    PROPERTIES COMPILE_DEFINITIONS TESTING
+)
+
 target_link_libraries(unit_tests_runner
     dronecore
+    dronecore_logging
     dronecore_mission
+    dronecore_offboard
     dronecore_camera
+    dronecore_telemetry
+    dronecore_follow_me
     gtest
     gtest_main
     gmock
 )
 
 add_test(unit_tests unit_tests_runner)
+
+# Checks that hot paths don't allocate, see core/allocation_counter.h.
+add_executable(alloc_tests_runner
+    ${ALLOC_TEST_SOURCES}
+)
+
+target_compile_definitions(alloc_tests_runner PRIVATE FAKE_TIME=1)
+
+set_target_properties(alloc_tests_runner
+    PROPERTIES COMPILE_FLAGS ${warnings}
+)
+
+target_link_libraries(alloc_tests_runner
+    dronecore
+    dronecore_telemetry
+    gtest
+    gtest_main
+    gmock
+)
+
+add_test(alloc_tests alloc_tests_runner)
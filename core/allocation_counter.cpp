@@ -0,0 +1,62 @@
+#include "allocation_counter.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local bool counting = false;
+thread_local unsigned num_allocations = 0;
+thread_local size_t num_bytes = 0;
+
+} // namespace
+
+// The array and nothrow versions go through these by default.
+void *operator new(size_t size)
+{
+    if (counting) {
+        ++num_allocations;
+        num_bytes += size;
+    }
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        // Built without exceptions, so there is no bad_alloc to throw.
+        abort();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace dronecore {
+
+AllocationCounter::AllocationCounter()
+{
+    num_allocations = 0;
+    num_bytes = 0;
+    counting = true;
+}
+
+AllocationCounter::~AllocationCounter()
+{
+    counting = false;
+}
+
+unsigned AllocationCounter::get() const
+{
+    return num_allocations;
+}
+
+size_t AllocationCounter::get_bytes() const
+{
+    return num_bytes;
+}
+
+} // namespace dronecore
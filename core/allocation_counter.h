@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+
+namespace dronecore {
+
+// Counts the heap allocations of the current thread while in scope, for tests
+// checking that hot paths don't allocate in steady state. This only works in
+// a binary linking allocation_counter.cpp, which replaces the global operator
+// new, so these tests are built as a separate runner.
+class AllocationCounter
+{
+public:
+    AllocationCounter();
+    ~AllocationCounter();
+
+    unsigned get() const;
+    // Requested, not what the allocator actually uses.
+    size_t get_bytes() const;
+
+    // Non-copyable
+    AllocationCounter(const AllocationCounter &) = delete;
+    const AllocationCounter &operator=(const AllocationCounter &) = delete;
+};
+
+} // namespace dronecore
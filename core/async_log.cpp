@@ -0,0 +1,231 @@
+#include "async_log.h"
+#include "log.h"
+#include "thread_setup.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr size_t AsyncLog::RING_SIZE;
+constexpr size_t AsyncLog::MAX_MESSAGE_LEN;
+constexpr uint32_t AsyncLog::MAX_LINES_PER_SITE_PER_S;
+constexpr size_t AsyncLog::NUM_SITES;
+constexpr size_t AsyncLog::MAX_SITE_PROBES;
+
+AsyncLog &AsyncLog::instance()
+{
+    // Deliberately leaked, see header.
+    static AsyncLog *async_log = new AsyncLog();
+    return *async_log;
+}
+
+AsyncLog::AsyncLog() :
+    _slots(new Slot[RING_SIZE]),
+    _sites(new Site[NUM_SITES])
+{
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < NUM_SITES; ++i) {
+        _sites[i].key.store(0, std::memory_order_relaxed);
+        _sites[i].period_s.store(0, std::memory_order_relaxed);
+        _sites[i].num_lines.store(0, std::memory_order_relaxed);
+        _sites[i].num_suppressed.store(0, std::memory_order_relaxed);
+    }
+}
+
+void AsyncLog::enable(const log_sink_t &sink)
+{
+    std::lock_guard<std::mutex> lock(_enable_mutex);
+    stop_writer();
+
+    _sink = sink;
+    _should_exit = false;
+    _writer_thread = new std::thread(writer_thread, this);
+    _enabled = true;
+}
+
+void AsyncLog::disable()
+{
+    std::lock_guard<std::mutex> lock(_enable_mutex);
+    _enabled = false;
+    stop_writer();
+}
+
+void AsyncLog::stop_writer()
+{
+    if (_writer_thread == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_wake_mutex);
+        _should_exit = true;
+    }
+    _wake_cv.notify_all();
+    _writer_thread->join();
+    delete _writer_thread;
+    _writer_thread = nullptr;
+
+    // Lines pushed while the writer was exiting.
+    write_queued();
+}
+
+bool AsyncLog::allow(const char *filename, int line, uint32_t &num_suppressed)
+{
+    num_suppressed = 0;
+
+    const uint64_t key = (uint64_t(reinterpret_cast<uintptr_t>(filename)) << 16) ^
+                         uint64_t(line);
+    const size_t hash = size_t((key * 0x9E3779B97F4A7C15ull) >> 32);
+
+    Site *site = nullptr;
+    for (size_t probe = 0; probe < MAX_SITE_PROBES; ++probe) {
+        Site &candidate = _sites[(hash + probe) & (NUM_SITES - 1)];
+        uint64_t candidate_key = candidate.key.load(std::memory_order_acquire);
+        if (candidate_key == 0 &&
+            candidate.key.compare_exchange_strong(candidate_key, key)) {
+            site = &candidate;
+            break;
+        }
+        if (candidate_key == key) {
+            site = &candidate;
+            break;
+        }
+    }
+
+    if (site == nullptr) {
+        // Too many call sites to keep track of, let it through.
+        return true;
+    }
+
+    const uint32_t now_s = uint32_t(std::chrono::duration_cast<std::chrono::seconds>(
+                                        std::chrono::steady_clock::now().time_since_epoch()).count());
+
+    uint32_t period_s = site->period_s.load(std::memory_order_relaxed);
+    if (period_s != now_s && site->period_s.compare_exchange_strong(period_s, now_s)) {
+        num_suppressed = site->num_suppressed.exchange(0);
+        site->num_lines.store(0);
+    }
+
+    if (site->num_lines.fetch_add(1) < MAX_LINES_PER_SITE_PER_S) {
+        return true;
+    }
+    site->num_suppressed.fetch_add(1);
+    return false;
+}
+
+void AsyncLog::push(LogLevel level, const std::string &message,
+                    const char *filename, int line, uint32_t num_suppressed)
+{
+    // Bounded multi-producer queue with a sequence number per slot, a slot is
+    // free to write when its sequence equals the position.
+    size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    while (true) {
+        slot = &_slots[pos & (RING_SIZE - 1)];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+        if (diff == 0) {
+            if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full, the writer can't keep up.
+            _num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = _enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    Record &record = slot->record;
+    record.level = level;
+    record.time = time(nullptr);
+    record.filename = filename;
+    record.line = line;
+    record.num_suppressed = num_suppressed;
+    if (message.size() > MAX_MESSAGE_LEN) {
+        record.len = MAX_MESSAGE_LEN;
+        memcpy(record.message, message.c_str(), MAX_MESSAGE_LEN - 3);
+        memcpy(record.message + MAX_MESSAGE_LEN - 3, "...", 3);
+    } else {
+        record.len = message.size();
+        memcpy(record.message, message.c_str(), message.size());
+    }
+    record.message[record.len] = '\0';
+
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool AsyncLog::pop(Record &record)
+{
+    Slot &slot = _slots[_dequeue_pos & (RING_SIZE - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != _dequeue_pos + 1) {
+        return false;
+    }
+    record = slot.record;
+    slot.sequence.store(_dequeue_pos + RING_SIZE, std::memory_order_release);
+    ++_dequeue_pos;
+    return true;
+}
+
+void AsyncLog::write_queued()
+{
+    Record record;
+    while (pop(record)) {
+        write(record);
+    }
+
+    const uint32_t num_dropped = _num_dropped.exchange(0);
+    if (num_dropped > 0) {
+        record.level = LogLevel::Warn;
+        record.time = time(nullptr);
+        record.filename = __FILENAME__;
+        record.line = __LINE__;
+        record.num_suppressed = 0;
+        record.len = size_t(snprintf(record.message, sizeof(record.message),
+                                     "Dropped %u log lines, logging too fast", num_dropped));
+        write(record);
+    }
+}
+
+void AsyncLog::write(const Record &record)
+{
+    const char *message = record.message;
+
+    std::string message_with_suppressed;
+    if (record.num_suppressed > 0) {
+        message_with_suppressed = std::string(record.message, record.len) +
+                                  " (" + std::to_string(record.num_suppressed) +
+                                  " similar lines suppressed)";
+        message = message_with_suppressed.c_str();
+    }
+
+    if (_sink) {
+        _sink(record.level, message, record.filename, record.line);
+    } else {
+        write_log_line(record.level, record.time, message, record.filename, record.line);
+    }
+}
+
+void AsyncLog::writer_thread(AsyncLog *self)
+{
+    setup_thread(ThreadRole::Background, "log");
+
+    while (true) {
+        self->write_queued();
+
+        // Logging threads don't notify so that they never block, so poll.
+        std::unique_lock<std::mutex> lock(self->_wake_mutex);
+        if (self->_wake_cv.wait_for(lock, std::chrono::milliseconds(10),
+        [self]() { return self->_should_exit.load(); })) {
+            break;
+        }
+    }
+    self->write_queued();
+}
+
+} // namespace dronecore
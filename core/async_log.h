@@ -0,0 +1,110 @@
+#pragma once
+
+#include "log_sink.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace dronecore {
+
+// Moves writing log lines off the threads logging them. Lines are copied into a
+// preallocated ring without taking a lock and written by a background thread,
+// either to the console or to a user sink. If the ring is full, lines are
+// dropped and counted instead of blocking the caller.
+//
+// Every call site (file and line) may log MAX_LINES_PER_SITE_PER_S lines per
+// second, the rest is suppressed and reported with the next line which gets
+// through, so a flood from e.g. a misbehaving link can't hog the writer.
+//
+// There is one instance per process which is never destroyed, so threads still
+// logging at exit can't use it after destruction. Call disable() before exit to
+// make sure all queued lines are written.
+class AsyncLog
+{
+public:
+    static constexpr size_t RING_SIZE = 1024; // Needs to be a power of 2.
+    static constexpr size_t MAX_MESSAGE_LEN = 255;
+    static constexpr uint32_t MAX_LINES_PER_SITE_PER_S = 20;
+
+    static AsyncLog &instance();
+
+    // Without a sink, lines are written to the console like synchronous logging.
+    // Calling it again replaces the sink.
+    void enable(const log_sink_t &sink);
+    // Writes what is queued and stops the writer thread.
+    void disable();
+
+    bool is_enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    // Returns false if the call site is over its rate, num_suppressed is set to
+    // the lines suppressed in the previous period once a new period starts.
+    bool allow(const char *filename, int line, uint32_t &num_suppressed);
+
+    // Never blocks. filename needs to be a string literal.
+    void push(LogLevel level, const std::string &message,
+              const char *filename, int line, uint32_t num_suppressed);
+
+    // Non-copyable
+    AsyncLog(const AsyncLog &) = delete;
+    const AsyncLog &operator=(const AsyncLog &) = delete;
+
+private:
+    AsyncLog();
+
+    struct Record {
+        LogLevel level;
+        time_t time;
+        const char *filename;
+        int line;
+        uint32_t num_suppressed;
+        size_t len;
+        char message[MAX_MESSAGE_LEN + 1];
+    };
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    struct Site {
+        std::atomic<uint64_t> key;
+        std::atomic<uint32_t> period_s;
+        std::atomic<uint32_t> num_lines;
+        std::atomic<uint32_t> num_suppressed;
+    };
+
+    static constexpr size_t NUM_SITES = 256; // Needs to be a power of 2.
+    static constexpr size_t MAX_SITE_PROBES = 8;
+
+    void stop_writer();
+    // Only called by the writer, or once it's stopped.
+    bool pop(Record &record);
+    void write_queued();
+    void write(const Record &record);
+
+    static void writer_thread(AsyncLog *self);
+
+    std::unique_ptr<Slot[]> _slots;
+    std::atomic<size_t> _enqueue_pos {0};
+    size_t _dequeue_pos {0};
+    std::atomic<uint32_t> _num_dropped {0};
+
+    std::unique_ptr<Site[]> _sites;
+
+    std::atomic<bool> _enabled {false};
+    std::mutex _enable_mutex {};
+    log_sink_t _sink {nullptr};
+
+    std::thread *_writer_thread {nullptr};
+    std::atomic<bool> _should_exit {false};
+    std::mutex _wake_mutex {};
+    std::condition_variable _wake_cv {};
+};
+
+} // namespace dronecore
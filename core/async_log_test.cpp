@@ -0,0 +1,105 @@
+#include "async_log.h"
+#include "log.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+struct Line {
+    LogLevel level;
+    std::string message;
+    std::string filename;
+};
+
+class LogCapture
+{
+public:
+    void enable()
+    {
+        AsyncLog::instance().enable([this](LogLevel level, const char *message,
+        const char *filename, int) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _lines.push_back(Line {level, message, filename});
+        });
+    }
+
+    std::vector<Line> disable()
+    {
+        AsyncLog::instance().disable();
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _lines;
+    }
+
+private:
+    std::mutex _mutex {};
+    std::vector<Line> _lines {};
+};
+
+void log_flood_line(int i)
+{
+    LogWarn() << "flood " << i;
+}
+
+} // namespace
+
+TEST(AsyncLog, SinkReceivesLines)
+{
+    LogCapture capture;
+    capture.enable();
+    EXPECT_TRUE(AsyncLog::instance().is_enabled());
+
+    LogInfo() << "hello " << 42;
+    LogErr() << "bad";
+
+    const std::vector<Line> lines = capture.disable();
+    EXPECT_FALSE(AsyncLog::instance().is_enabled());
+
+    ASSERT_EQ(lines.size(), 2);
+    EXPECT_EQ(lines[0].level, LogLevel::Info);
+    EXPECT_EQ(lines[0].message, "hello 42");
+    EXPECT_EQ(lines[0].filename, "async_log_test.cpp");
+    EXPECT_EQ(lines[1].level, LogLevel::Err);
+    EXPECT_EQ(lines[1].message, "bad");
+}
+
+TEST(AsyncLog, RateLimitsCallSite)
+{
+    LogCapture capture;
+    capture.enable();
+
+    for (int i = 0; i < 100; ++i) {
+        log_flood_line(i);
+    }
+
+    // The next period reports what was suppressed.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    log_flood_line(100);
+
+    const std::vector<Line> lines = capture.disable();
+
+    // A new period could have started during the loop.
+    ASSERT_GE(lines.size(), AsyncLog::MAX_LINES_PER_SITE_PER_S + 1);
+    EXPECT_LE(lines.size(), 2 * AsyncLog::MAX_LINES_PER_SITE_PER_S + 1);
+    EXPECT_EQ(lines[0].message, "flood 0");
+    EXPECT_NE(lines.back().message.find("flood 100 ("), std::string::npos);
+    EXPECT_NE(lines.back().message.find("similar lines suppressed)"), std::string::npos);
+}
+
+TEST(AsyncLog, TruncatesLongLines)
+{
+    LogCapture capture;
+    capture.enable();
+
+    LogInfo() << std::string(1000, 'x');
+
+    const std::vector<Line> lines = capture.disable();
+    ASSERT_EQ(lines.size(), 1);
+    EXPECT_EQ(lines[0].message.size(), AsyncLog::MAX_MESSAGE_LEN);
+    EXPECT_EQ(lines[0].message.substr(AsyncLog::MAX_MESSAGE_LEN - 3), "...");
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+// Only available to applications built with C++20, the library itself doesn't
+// need it.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace dronecore {
+
+namespace detail {
+
+template <typename... Results>
+struct CallbackValue {
+    typedef std::tuple<std::decay_t<Results>...> type;
+};
+
+template <typename Result>
+struct CallbackValue<Result> {
+    typedef std::decay_t<Result> type;
+};
+
+template <>
+struct CallbackValue<> {
+    typedef void type;
+};
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation {};
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+            // Carry on with whoever awaited the task, on this thread.
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            if (continuation) {
+                return continuation;
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    // The library is built without exceptions, so there is no one to pass them to.
+    void unhandled_exception() noexcept { std::terminate(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value {};
+
+    void return_value(T result) { value.emplace(std::move(result)); }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    void return_void() {}
+};
+
+} // namespace detail
+
+/**
+ * @brief Awaits a function taking a callback which is called exactly once.
+ *
+ * The coroutine is resumed on the thread calling the callback, which is one of
+ * the threads of %DroneCore running callbacks. The same rules apply as for
+ * callbacks then: don't block in there, co_await instead.
+ *
+ * The result is the argument of the callback, several are returned as a tuple.
+ */
+template <typename Initiator, typename... Results>
+class CallbackAwaiter
+{
+public:
+    typedef typename detail::CallbackValue<Results...>::type value_type;
+
+    explicit CallbackAwaiter(Initiator initiator) : _initiator(std::move(initiator)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+        _handle = handle;
+        _initiator([this](Results... results) {
+            if constexpr (!std::is_void_v<value_type>) {
+                _value.emplace(std::forward<Results>(results)...);
+            }
+            // Whoever comes second carries on, the callback could have been
+            // called before the coroutine is suspended.
+            if (_done.exchange(true, std::memory_order_acq_rel)) {
+                _handle.resume();
+            }
+        });
+        return !_done.exchange(true, std::memory_order_acq_rel);
+    }
+
+    value_type await_resume()
+    {
+        if constexpr (!std::is_void_v<value_type>) {
+            return std::move(*_value);
+        }
+    }
+
+    // Non-copyable
+    CallbackAwaiter(const CallbackAwaiter &) = delete;
+    const CallbackAwaiter &operator=(const CallbackAwaiter &) = delete;
+
+private:
+    typedef std::conditional_t<std::is_void_v<value_type>, std::tuple<>, value_type> stored_t;
+
+    Initiator _initiator;
+    std::coroutine_handle<> _handle {};
+    std::optional<stored_t> _value {};
+    std::atomic<bool> _done {false};
+};
+
+/**
+ * @brief Awaits an `*_async` function given to the initiator.
+ *
+ * The initiator is called with the callback to pass on, e.g.
+ * `co_await async_call<Action::Result>([&](auto callback) { action.arm_async(callback); });`
+ */
+template <typename... Results, typename Initiator>
+CallbackAwaiter<Initiator, Results...> async_call(Initiator initiator)
+{
+    return CallbackAwaiter<Initiator, Results...>(std::move(initiator));
+}
+
+namespace detail {
+
+// Results of the callback from its std::function type.
+template <typename Callback>
+struct CallbackTraits;
+
+template <typename... Results>
+struct CallbackTraits<std::function<void(Results...)>> {
+    template <typename Initiator>
+    static CallbackAwaiter<Initiator, Results...> make_awaiter(Initiator initiator)
+    {
+        return CallbackAwaiter<Initiator, Results...>(std::move(initiator));
+    }
+};
+
+} // namespace detail
+
+/**
+ * @brief Awaits an `*_async` function of a plugin, its callback being the last argument.
+ *
+ * E.g. `Action::Result result = co_await async_call(action, &Action::takeoff_async);`
+ * or `co_await async_call(camera, &Camera::start_photo_interval_async, 2.0f);`.
+ * The arguments are copied, they need to stay valid until the call is awaited.
+ */
+template <typename Plugin, typename... Params, typename... Args>
+auto async_call(Plugin &plugin, void (Plugin::*function)(Params...), Args &&... args)
+{
+    typedef std::decay_t<std::tuple_element_t<sizeof...(Params) - 1, std::tuple<Params...>>>
+    callback_t;
+
+    return detail::CallbackTraits<callback_t>::make_awaiter(
+    [&plugin, function, ... args = std::forward<Args>(args)](callback_t callback) {
+        (plugin.*function)(args..., std::move(callback));
+    });
+}
+
+/**
+ * @brief Coroutine returning a `T`, which starts once it is awaited or spawned.
+ *
+ * Chains of operations can be written as one coroutine instead of nested callbacks:
+ *
+ *     Task<Action::Result> arm_and_takeoff(Action &action)
+ *     {
+ *         Action::Result result = co_await async_call(action, &Action::arm_async);
+ *         if (result != Action::Result::SUCCESS) {
+ *             co_return result;
+ *         }
+ *         co_return co_await async_call(action, &Action::takeoff_async);
+ *     }
+ *
+ * Waiting doesn't take up a thread, so many of them can be running at once.
+ *
+ * @note GCC 12 destroys a temporary task too early when it is awaited within a
+ * condition, e.g. `if (co_await task() == ...)`, await it into a variable first.
+ */
+template <typename T = void>
+class Task
+{
+public:
+    struct promise_type : detail::TaskPromise<T> {
+        Task get_return_object()
+        {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    Task(Task &&other) noexcept : _handle(std::exchange(other._handle, nullptr)) {}
+
+    Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(other._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task()
+    {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) noexcept
+    {
+        _handle.promise().continuation = continuation;
+        return _handle;
+    }
+
+    T await_resume()
+    {
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*_handle.promise().value);
+        }
+    }
+
+    // Non-copyable
+    Task(const Task &) = delete;
+    const Task &operator=(const Task &) = delete;
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+    std::coroutine_handle<promise_type> _handle;
+};
+
+namespace detail {
+
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+} // namespace detail
+
+/**
+ * @brief Starts a task from code which isn't a coroutine, without waiting for it.
+ *
+ * It runs on the calling thread up to its first wait and is cleaned up once it
+ * is done. The result is dropped, the task needs to pass it on itself.
+ */
+template <typename T>
+detail::Detached spawn(Task<T> task)
+{
+    co_await task;
+}
+
+} // namespace dronecore
+
+#endif
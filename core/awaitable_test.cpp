@@ -0,0 +1,155 @@
+#include "awaitable.h"
+#include <gtest/gtest.h>
+
+// Built as C++20 when the compiler supports it, see CMakeLists.txt.
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include "callback_executor.h"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+// Shaped like a plugin, calling back on the threads of an executor.
+class FakePlugin
+{
+public:
+    enum class Result { SUCCESS, BUSY };
+    typedef std::function<void(Result)> result_callback_t;
+    typedef std::function<void(Result, const std::string &)> name_callback_t;
+
+    explicit FakePlugin(CallbackExecutor &executor) : _executor(executor) {}
+
+    void do_async(int value, const result_callback_t &callback)
+    {
+        _executor.submit([value, callback]() {
+            callback(value >= 0 ? Result::SUCCESS : Result::BUSY);
+        });
+    }
+
+    void get_name_async(name_callback_t callback)
+    {
+        _executor.submit([callback]() { callback(Result::SUCCESS, "fake"); });
+    }
+
+    // Some calls fail right away, before returning.
+    void fail_async(result_callback_t callback) { callback(Result::BUSY); }
+
+private:
+    CallbackExecutor &_executor;
+};
+
+Task<FakePlugin::Result> do_twice(FakePlugin &plugin, int first, int second)
+{
+    FakePlugin::Result result = co_await async_call(plugin, &FakePlugin::do_async, first);
+    if (result != FakePlugin::Result::SUCCESS) {
+        co_return result;
+    }
+    co_return co_await async_call(plugin, &FakePlugin::do_async, second);
+}
+
+// Coroutines get their state as arguments, the captures of a lambda would
+// be gone once it is suspended.
+Task<> chain(FakePlugin &plugin, FakePlugin::Result (&results)[2],
+             std::atomic<unsigned> &num_done)
+{
+    results[0] = co_await do_twice(plugin, 1, 2);
+    results[1] = co_await do_twice(plugin, -1, 2);
+    ++num_done;
+}
+
+Task<> get_name(FakePlugin &plugin, std::string &name, std::atomic<unsigned> &num_done)
+{
+    auto result = co_await async_call(plugin, &FakePlugin::get_name_async);
+    EXPECT_EQ(std::get<0>(result), FakePlugin::Result::SUCCESS);
+    name = std::get<1>(result);
+    ++num_done;
+}
+
+Task<> fail(FakePlugin &plugin, bool &done)
+{
+    FakePlugin::Result result = co_await async_call<FakePlugin::Result>(
+    [&plugin](FakePlugin::result_callback_t callback) {
+        plugin.fail_async(callback);
+    });
+    EXPECT_EQ(result, FakePlugin::Result::BUSY);
+    done = true;
+}
+
+Task<> workflow(FakePlugin &plugin, std::atomic<unsigned> &num_succeeded)
+{
+    FakePlugin::Result result = co_await do_twice(plugin, 1, 2);
+    if (result == FakePlugin::Result::SUCCESS) {
+        ++num_succeeded;
+    }
+}
+
+bool wait_for(const std::atomic<unsigned> &counter, unsigned expected)
+{
+    for (int i = 0; i < 500 && counter != expected; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return counter == expected;
+}
+
+} // namespace
+
+TEST(Awaitable, ChainsCalls)
+{
+    CallbackExecutor executor;
+    FakePlugin plugin(executor);
+    std::atomic<unsigned> num_done {0};
+    FakePlugin::Result results[2] {};
+
+    spawn(chain(plugin, results, num_done));
+
+    ASSERT_TRUE(wait_for(num_done, 1));
+    EXPECT_EQ(results[0], FakePlugin::Result::SUCCESS);
+    EXPECT_EQ(results[1], FakePlugin::Result::BUSY);
+}
+
+TEST(Awaitable, ReturnsSeveralResultsAsTuple)
+{
+    CallbackExecutor executor;
+    FakePlugin plugin(executor);
+    std::atomic<unsigned> num_done {0};
+    std::string name;
+
+    spawn(get_name(plugin, name, num_done));
+
+    ASSERT_TRUE(wait_for(num_done, 1));
+    EXPECT_EQ(name, "fake");
+}
+
+TEST(Awaitable, CallbackBeforeSuspending)
+{
+    CallbackExecutor executor;
+    FakePlugin plugin(executor);
+    bool done = false;
+
+    spawn(fail(plugin, done));
+
+    // Never suspended, so it is already done on this thread.
+    EXPECT_TRUE(done);
+}
+
+TEST(Awaitable, ManyWorkflowsOnFewThreads)
+{
+    constexpr unsigned num_workflows = 2000;
+
+    CallbackExecutor executor(2, 2 * num_workflows);
+    FakePlugin plugin(executor);
+    std::atomic<unsigned> num_succeeded {0};
+
+    for (unsigned i = 0; i < num_workflows; ++i) {
+        spawn(workflow(plugin, num_succeeded));
+    }
+
+    EXPECT_TRUE(wait_for(num_succeeded, num_workflows));
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "call_every_handler.h"
+#include "trace.h"
 
 namespace dronecore {
 
@@ -13,16 +14,17 @@ CallEveryHandler::~CallEveryHandler()
 
 void CallEveryHandler::add(std::function<void()> callback, float interval_s, void **cookie)
 {
-    auto new_entry = std::make_shared<Entry>();
-    new_entry->callback = callback;
-    new_entry->last_time = _time.steady_time();
-    new_entry->interval_s = interval_s;
-
-    void *new_cookie = static_cast<void *>(new_entry.get());
+    void *new_cookie = nullptr;
 
     {
         std::lock_guard<std::mutex> lock(_entries_mutex);
-        _entries.insert(std::pair<void *, std::shared_ptr<Entry>>(new_cookie, new_entry));
+        TimerWheel::Entry *new_entry = _entries.allocate();
+        new_entry->callback = callback;
+        new_entry->reference_time = _time.steady_time();
+        new_entry->duration_s = double(interval_s);
+        schedule_next(new_entry);
+
+        new_cookie = _entries.cookie(new_entry);
     }
 
     if (cookie != nullptr) {
@@ -34,9 +36,10 @@ void CallEveryHandler::change(float interval_s, const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_entries_mutex);
 
-    auto it = _entries.find(const_cast<void *>(cookie));
-    if (it != _entries.end()) {
-        it->second->interval_s = interval_s;
+    TimerWheel::Entry *entry = _entries.lookup(cookie);
+    if (entry != nullptr) {
+        entry->duration_s = double(interval_s);
+        schedule_next(entry);
     }
 }
 
@@ -44,9 +47,10 @@ void CallEveryHandler::reset(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_entries_mutex);
 
-    auto it = _entries.find(const_cast<void *>(cookie));
-    if (it != _entries.end()) {
-        it->second->last_time = _time.steady_time();
+    TimerWheel::Entry *entry = _entries.lookup(cookie);
+    if (entry != nullptr) {
+        entry->reference_time = _time.steady_time();
+        schedule_next(entry);
     }
 }
 
@@ -54,43 +58,78 @@ void CallEveryHandler::remove(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_entries_mutex);
 
-    auto it = _entries.find(const_cast<void *>(cookie));
-    if (it != _entries.end()) {
-        _entries.erase(const_cast<void *>(cookie));
-        _iterator_invalidated = true;
+    TimerWheel::Entry *entry = _entries.lookup(cookie);
+    if (entry == nullptr) {
+        return;
+    }
+
+    if (entry == _running) {
+        // Called from its own callback, which is still running.
+        _entries.unschedule(entry);
+        _release_running = true;
+    } else {
+        _entries.release(entry);
     }
 }
 
 void CallEveryHandler::run_once()
 {
-    _entries_mutex.lock();
-
-    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
-
-        if (_time.elapsed_since_s(it->second->last_time) > double(it->second->interval_s)) {
-
-            _time.shift_steady_time_by(it->second->last_time, double(it->second->interval_s));
+    DRONECORE_TRACE_SCOPE("call every");
+    {
+        std::lock_guard<std::mutex> lock(_entries_mutex);
 
-            if (it->second->callback) {
+        _due.clear();
+        _due_calls.clear();
+        _entries.collect_due(_time.steady_time(), _due);
+        for (auto entry : _due) {
+            // Already schedule the next call, in case we're lagging behind
+            // this is still in the past and we get called again next time.
+            _time.shift_steady_time_by(entry->reference_time, entry->duration_s);
+            schedule_next(entry);
+            _due_calls.push_back(_entries.cookie(entry));
+        }
+    }
 
-                // Get a copy for the callback because we unlock.
-                std::function<void()> callback = it->second->callback;
+    for (auto due_cookie : _due_calls) {
+        TimerWheel::Entry *entry = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(_entries_mutex);
 
-                // Unlock while we callback because it might in turn want to add timeouts.
-                _entries_mutex.unlock();
-                callback();
-                _entries_mutex.lock();
+            // A previous callback might have removed this one.
+            entry = _entries.lookup(due_cookie);
+            if (entry == nullptr || !entry->callback) {
+                continue;
             }
+            _running = entry;
         }
 
-        // We leave the loop.
-        // FIXME: there should be a nicer way to do this.
-        if (_iterator_invalidated) {
-            _iterator_invalidated = false;
-            break;
+        // Unlock while we callback because it might in turn want to add timeouts.
+        // The entry stays valid, and only add() sets callbacks, on other entries.
+        entry->callback();
+
+        {
+            std::lock_guard<std::mutex> lock(_entries_mutex);
+            _running = nullptr;
+            if (_release_running) {
+                _release_running = false;
+                _entries.release(entry);
+            }
         }
     }
-    _entries_mutex.unlock();
+}
+
+double CallEveryHandler::time_until_next_s(double max_s)
+{
+    std::lock_guard<std::mutex> lock(_entries_mutex);
+
+    return _entries.time_until_next_s(_time.steady_time(), max_s);
+}
+
+void CallEveryHandler::schedule_next(TimerWheel::Entry *entry)
+{
+    dl_time_t next_time = entry->reference_time;
+    _time.shift_steady_time_by(next_time, entry->duration_s);
+    _entries.schedule(entry, next_time);
 }
 
 } // namespace dronecore
@@ -3,8 +3,9 @@
 #include <mutex>
 #include <memory>
 #include <functional>
-#include <map>
+#include <vector>
 #include "global_include.h"
+#include "timer_wheel.h"
 
 namespace dronecore {
 
@@ -25,18 +26,24 @@ public:
     void reset(const void *cookie);
     void remove(const void *cookie);
 
+    // Not thread-safe against itself, only one thread is expected to run the calls.
     void run_once();
 
-private:
-    struct Entry {
-        std::function<void()> callback;
-        dl_time_t last_time;
-        float interval_s;
-    };
+    // Seconds until the next call is due, or max_s if there is none earlier.
+    double time_until_next_s(double max_s);
 
-    std::map<void *, std::shared_ptr<Entry>> _entries {};
+private:
+    void schedule_next(TimerWheel::Entry *entry);
+
+    TimerWheel _entries {};
+    std::vector<TimerWheel::Entry *> _due {};
+    // Cookies of the due entries, kept to not allocate on every run.
+    std::vector<void *> _due_calls {};
+    // The callback is called in place, so an entry removed from its own call
+    // is only released afterwards.
+    TimerWheel::Entry *_running {nullptr};
+    bool _release_running {false};
     std::mutex _entries_mutex {};
-    bool _iterator_invalidated {false};
 
     Time &_time;
 };
@@ -0,0 +1,61 @@
+#include "allocation_counter.h"
+#include "call_every_handler.h"
+#include <gtest/gtest.h>
+#include <functional>
+
+using namespace dronecore;
+
+namespace {
+
+struct Counter {
+    void increment(int by) { value += by; }
+    int value {0};
+};
+
+} // namespace
+
+TEST(CallEveryHandlerAllocations, RunOnce)
+{
+    FakeTime time {};
+    CallEveryHandler ceh(time);
+
+    // Too big to be stored in a std::function without allocating, so a copy
+    // per call would show.
+    Counter counter;
+    ceh.add(std::bind(&Counter::increment, &counter, 1), 0.1f, nullptr);
+    ceh.add(std::bind(&Counter::increment, &counter, 1), 0.1f, nullptr);
+
+    // Once to size the lists of due entries.
+    time.sleep_for(std::chrono::milliseconds(100));
+    ceh.run_once();
+    EXPECT_EQ(counter.value, 2);
+
+    {
+        AllocationCounter allocations;
+        for (int i = 0; i < 100; ++i) {
+            time.sleep_for(std::chrono::milliseconds(100));
+            ceh.run_once();
+        }
+        EXPECT_EQ(allocations.get(), 0u);
+    }
+    EXPECT_EQ(counter.value, 202);
+}
+
+TEST(CallEveryHandlerAllocations, RemoveFromOwnCallback)
+{
+    FakeTime time {};
+    CallEveryHandler ceh(time);
+
+    int num_called = 0;
+    void *cookie = nullptr;
+    ceh.add([&]() {
+        ++num_called;
+        ceh.remove(cookie);
+    }, 0.1f, &cookie);
+
+    for (int i = 0; i < 5; ++i) {
+        time.sleep_for(std::chrono::milliseconds(100));
+        ceh.run_once();
+    }
+    EXPECT_EQ(num_called, 1);
+}
@@ -130,3 +130,27 @@ TEST(CallEveryHandler, Reset)
     }
     EXPECT_EQ(num_called, 1);
 }
+
+TEST(CallEveryHandler, TimeUntilNext)
+{
+    Time time {};
+    CallEveryHandler ceh(time);
+
+    EXPECT_DOUBLE_EQ(ceh.time_until_next_s(1.0), 1.0);
+
+    void *cookie = nullptr;
+    ceh.add([]() {}, 0.5f, &cookie);
+
+    EXPECT_NEAR(ceh.time_until_next_s(1.0), 0.5, 0.01);
+
+    time.sleep_for(std::chrono::milliseconds(200));
+    EXPECT_NEAR(ceh.time_until_next_s(1.0), 0.3, 0.01);
+
+    time.sleep_for(std::chrono::milliseconds(400));
+    EXPECT_DOUBLE_EQ(ceh.time_until_next_s(1.0), 0.0);
+
+    ceh.run_once();
+    EXPECT_NEAR(ceh.time_until_next_s(1.0), 0.4, 0.01);
+
+    ceh.remove(cookie);
+}
@@ -0,0 +1,262 @@
+#include "callback_executor.h"
+#include "log.h"
+#include "thread_setup.h"
+#include "trace.h"
+
+namespace dronecore {
+
+namespace {
+
+// Owner of the callback run by this thread, if any.
+thread_local const void *running_owner = nullptr;
+
+} // namespace
+
+CallbackExecutor::CallbackExecutor(unsigned num_threads, size_t max_queued) :
+    _max_queued(max_queued)
+{
+    if (num_threads == 0) {
+        num_threads = 1;
+    }
+    for (unsigned i = 0; i < num_threads; ++i) {
+        _threads.push_back(std::thread(worker_thread, this));
+    }
+}
+
+CallbackExecutor::~CallbackExecutor()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        if (_num_queued > 0) {
+            LogWarn() << "Discarding " << _num_queued << " queued callbacks";
+        }
+    }
+    _condition_var.notify_all();
+
+    for (auto &thread : _threads) {
+        thread.join();
+    }
+}
+
+bool CallbackExecutor::submit(const std::function<void()> &func,
+                              const void *ordering_key,
+                              Policy policy,
+                              const void *owner)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_batch_interval.count() > 0) {
+            const auto now = std::chrono::steady_clock::now();
+            if (_num_queued == 0) {
+                _batch_due = now + _batch_interval;
+            } else if (now < _batch_due) {
+                // Goes with the batch already waiting, no need to wake anyone.
+                return push(func, ordering_key, policy, owner);
+            }
+        }
+        if (!push(func, ordering_key, policy, owner)) {
+            return false;
+        }
+    }
+    _condition_var.notify_one();
+    return true;
+}
+
+bool CallbackExecutor::push(const std::function<void()> &func,
+                            const void *ordering_key,
+                            Policy policy,
+                            const void *owner)
+{
+    if (ordering_key == nullptr) {
+        return push_unordered(func, policy, owner);
+    }
+
+    Strand &strand = _strands[ordering_key];
+
+    if (policy == Policy::COALESCE && !strand.funcs.empty()) {
+        // Whatever is still waiting is outdated by this one.
+        _num_dropped += strand.funcs.size();
+        _num_queued -= strand.funcs.size();
+        strand.funcs.clear();
+    }
+
+    if (_num_queued >= _max_queued) {
+        ++_num_dropped;
+        return false;
+    }
+
+    strand.funcs.push_back(Queued {func, owner});
+    ++_num_queued;
+
+    if (!strand.running && !strand.ready) {
+        strand.ready = true;
+        _ready_keys.push_back(ordering_key);
+    }
+    return true;
+}
+
+bool CallbackExecutor::push_unordered(const std::function<void()> &func, Policy policy,
+                                      const void *owner)
+{
+    if (policy == Policy::COALESCE && !_unordered.empty()) {
+        // Their entries in _ready_keys are skipped once the queue is empty.
+        _num_dropped += _unordered.size();
+        _num_queued -= _unordered.size();
+        _unordered.clear();
+    }
+
+    if (_num_queued >= _max_queued) {
+        ++_num_dropped;
+        return false;
+    }
+
+    _unordered.push_back(Queued {func, owner});
+    ++_num_queued;
+    _ready_keys.push_back(nullptr);
+    return true;
+}
+
+void CallbackExecutor::set_batch_interval(double interval_s)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _batch_interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(interval_s > 0.0 ? interval_s : 0.0));
+        // Whatever is held back is run, the next batch starts with the next callback.
+        _batch_due = std::chrono::steady_clock::now();
+    }
+    _condition_var.notify_all();
+}
+
+void CallbackExecutor::cancel(const void *owner)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    const auto is_owned = [owner](const Queued & queued) {
+        return queued.owner == owner;
+    };
+    for (auto &strand : _strands) {
+        auto &funcs = strand.second.funcs;
+        const size_t num_before = funcs.size();
+        funcs.erase(std::remove_if(funcs.begin(), funcs.end(), is_owned), funcs.end());
+        _num_queued -= num_before - funcs.size();
+    }
+    const size_t num_unordered_before = _unordered.size();
+    _unordered.erase(std::remove_if(_unordered.begin(), _unordered.end(), is_owned),
+                     _unordered.end());
+    _num_queued -= num_unordered_before - _unordered.size();
+
+    const size_t num_own = (running_owner == owner) ? 1 : 0;
+    _finished_var.wait(lock, [this, owner, num_own]() {
+        return size_t(std::count(_running_owners.begin(), _running_owners.end(), owner)) <=
+               num_own;
+    });
+}
+
+size_t CallbackExecutor::num_queued() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _num_queued;
+}
+
+uint64_t CallbackExecutor::num_dropped() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _num_dropped;
+}
+
+void CallbackExecutor::worker_thread(CallbackExecutor *self)
+{
+    setup_thread(ThreadRole::Callback, "callback");
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+
+    while (true) {
+        while (self->_ready_keys.empty() && !self->_should_exit) {
+            self->_condition_var.wait(lock);
+            self->_num_wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (self->_should_exit) {
+            break;
+        }
+        if (self->_batch_interval.count() > 0 &&
+            std::chrono::steady_clock::now() < self->_batch_due) {
+            self->_condition_var.wait_until(lock, self->_batch_due);
+            self->_num_wakeups.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const void *key = self->_ready_keys.front();
+        self->_ready_keys.pop_front();
+
+        if (key == nullptr) {
+            self->run_unordered(lock);
+            continue;
+        }
+
+        Strand &strand = self->_strands[key];
+        strand.ready = false;
+        if (strand.funcs.empty()) {
+            // Everything got coalesced away.
+            self->_strands.erase(key);
+            continue;
+        }
+
+        const Queued queued = strand.funcs.front();
+        strand.funcs.pop_front();
+        --self->_num_queued;
+        strand.running = true;
+        self->run(queued, lock);
+
+        // Strands are only accessed with the lock held and never erased
+        // while running, so the reference is still valid.
+        strand.running = false;
+        if (!strand.funcs.empty()) {
+            // Keep the order within this key by only ever letting one thread run it.
+            strand.ready = true;
+            self->_ready_keys.push_back(key);
+            // This thread goes on with it, another one is only needed for other keys.
+            if (self->_ready_keys.size() > 1) {
+                self->_condition_var.notify_one();
+            }
+        } else {
+            self->_strands.erase(key);
+        }
+    }
+}
+
+void CallbackExecutor::run_unordered(std::unique_lock<std::mutex> &lock)
+{
+    if (_unordered.empty()) {
+        // Coalesced or cancelled.
+        return;
+    }
+
+    const Queued queued = _unordered.front();
+    _unordered.pop_front();
+    --_num_queued;
+    run(queued, lock);
+}
+
+void CallbackExecutor::run(const Queued &queued, std::unique_lock<std::mutex> &lock)
+{
+    _running_owners.push_back(queued.owner);
+
+    // Don't hold the lock while calling, the callback might submit again.
+    lock.unlock();
+    running_owner = queued.owner;
+    {
+        DRONECORE_TRACE_SCOPE("user callback");
+        queued.func();
+    }
+    running_owner = nullptr;
+    lock.lock();
+
+    _running_owners.erase(std::find(_running_owners.begin(), _running_owners.end(),
+                                    queued.owner));
+    _finished_var.notify_all();
+}
+
+} // namespace dronecore
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace dronecore {
+
+// Fixed number of threads running (user) callbacks.
+//
+// Callbacks submitted with the same ordering key are run one after the other
+// in the order they were submitted, callbacks with different keys can run in
+// parallel. Callbacks without a key are not ordered at all and go to whichever
+// thread is free. The number of queued callbacks is bounded, callbacks which don't
+// fit anymore are dropped.
+class CallbackExecutor
+{
+public:
+    enum class Policy {
+        QUEUE,   // Run every callback.
+        COALESCE // Replace callbacks of this key which are still waiting, only the latest matters.
+    };
+
+    static constexpr unsigned DEFAULT_NUM_THREADS = 2;
+    static constexpr size_t DEFAULT_MAX_QUEUED = 1000;
+
+    explicit CallbackExecutor(unsigned num_threads = DEFAULT_NUM_THREADS,
+                              size_t max_queued = DEFAULT_MAX_QUEUED);
+    ~CallbackExecutor();
+
+    // Returns false if the callback was dropped because the queue is full.
+    bool submit(const std::function<void()> &func,
+                const void *ordering_key = nullptr,
+                Policy policy = Policy::QUEUE,
+                const void *owner = nullptr);
+
+    // Drops the queued callbacks of the owner and waits for its running ones, so
+    // an executor can be shared by objects which go away before it. Callbacks
+    // cancelling their own owner don't wait for themselves.
+    void cancel(const void *owner);
+
+    // Callbacks are held back until this long after the first one queued, then
+    // all of them run together, so the threads wake up once per batch instead
+    // of once per callback. 0 runs them right away (default).
+    void set_batch_interval(double interval_s);
+
+    size_t num_queued() const;
+    uint64_t num_dropped() const;
+    // How often the threads woke up, together.
+    uint64_t num_wakeups() const { return _num_wakeups.load(std::memory_order_relaxed); }
+
+    // Non-copyable
+    CallbackExecutor(const CallbackExecutor &) = delete;
+    const CallbackExecutor &operator=(const CallbackExecutor &) = delete;
+
+private:
+    static void worker_thread(CallbackExecutor *self);
+    // Queues the callback, needs to be called with _mutex locked.
+    bool push(const std::function<void()> &func, const void *ordering_key, Policy policy,
+              const void *owner);
+    bool push_unordered(const std::function<void()> &func, Policy policy, const void *owner);
+
+    struct Queued {
+        std::function<void()> func;
+        const void *owner;
+    };
+
+    // Need to be called with the lock held, which is released while calling.
+    void run_unordered(std::unique_lock<std::mutex> &lock);
+    void run(const Queued &queued, std::unique_lock<std::mutex> &lock);
+
+    struct Strand {
+        std::deque<Queued> funcs {};
+        bool running {false};
+        bool ready {false}; // Key is in _ready_keys.
+    };
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _condition_var {};
+    std::condition_variable _finished_var {};
+    // Owners of the callbacks running, once for each.
+    std::vector<const void *> _running_owners {};
+
+    std::map<const void *, Strand> _strands {};
+    // Callbacks without an ordering key.
+    std::deque<Queued> _unordered {};
+    // Keys of strands which have callbacks queued and are not currently running,
+    // and nullptr for each callback in _unordered.
+    std::deque<const void *> _ready_keys {};
+
+    const size_t _max_queued;
+    size_t _num_queued {0};
+    uint64_t _num_dropped {0};
+    bool _should_exit {false};
+
+    std::chrono::steady_clock::duration _batch_interval {0};
+    // When the callbacks queued so far are run, if batching.
+    std::chrono::steady_clock::time_point _batch_due {};
+    std::atomic<uint64_t> _num_wakeups {0};
+
+    std::vector<std::thread> _threads {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,234 @@
+#include "callback_executor.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+static void wait_until(const std::function<bool()> &condition)
+{
+    for (int i = 0; i < 200 && !condition(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+}
+
+TEST(CallbackExecutor, RunsCallbacks)
+{
+    CallbackExecutor executor;
+
+    std::atomic<int> num_called {0};
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_TRUE(executor.submit([&num_called]() { ++num_called; }));
+    }
+
+    wait_until([&]() { return num_called == 100; });
+    EXPECT_EQ(num_called, 100);
+}
+
+TEST(CallbackExecutor, KeepsOrderPerKey)
+{
+    CallbackExecutor executor(4);
+
+    int key1 = 0;
+    int key2 = 0;
+
+    std::mutex mutex;
+    std::vector<int> order1;
+    std::vector<int> order2;
+    std::atomic<int> num_called {0};
+
+    for (int i = 0; i < 50; ++i) {
+        executor.submit([&, i]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order1.push_back(i);
+            ++num_called;
+        }, &key1);
+        executor.submit([&, i]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            order2.push_back(i);
+            ++num_called;
+        }, &key2);
+    }
+
+    wait_until([&]() { return num_called == 100; });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(order1.size(), 50);
+    ASSERT_EQ(order2.size(), 50);
+    for (int i = 0; i < 50; ++i) {
+        EXPECT_EQ(order1[i], i);
+        EXPECT_EQ(order2[i], i);
+    }
+}
+
+TEST(CallbackExecutor, RunsCallbacksWithoutKeyInParallel)
+{
+    CallbackExecutor executor(2);
+
+    std::atomic<int> num_started {0};
+    std::atomic<int> num_met {0};
+
+    for (int i = 0; i < 2; ++i) {
+        executor.submit([&]() {
+            ++num_started;
+            // Only returns early if the other one runs at the same time.
+            wait_until([&]() { return num_started == 2; });
+            if (num_started == 2) {
+                ++num_met;
+            }
+        });
+    }
+
+    wait_until([&]() { return num_met == 2; });
+    EXPECT_EQ(num_met, 2);
+}
+
+TEST(CallbackExecutor, DropsWhenFull)
+{
+    CallbackExecutor executor(1, 2);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool release = false;
+    std::atomic<bool> blocking {false};
+    std::atomic<int> num_called {0};
+
+    // Block the only thread.
+    executor.submit([&]() {
+        blocking = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return release; });
+    });
+    wait_until([&]() { return blocking.load(); });
+
+    EXPECT_TRUE(executor.submit([&]() { ++num_called; }));
+    EXPECT_TRUE(executor.submit([&]() { ++num_called; }));
+    EXPECT_FALSE(executor.submit([&]() { ++num_called; }));
+    EXPECT_EQ(executor.num_dropped(), 1);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+    }
+    cv.notify_all();
+
+    wait_until([&]() { return num_called == 2; });
+    EXPECT_EQ(num_called, 2);
+}
+
+TEST(CallbackExecutor, Coalesce)
+{
+    CallbackExecutor executor(1);
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool release = false;
+    std::atomic<bool> blocking {false};
+
+    int key = 0;
+    executor.submit([&]() {
+        blocking = true;
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return release; });
+    }, &key);
+    wait_until([&]() { return blocking.load(); });
+
+    std::atomic<int> last_value {0};
+    std::atomic<int> num_called {0};
+    for (int i = 1; i <= 10; ++i) {
+        executor.submit([&, i]() {
+            last_value = i;
+            ++num_called;
+        }, &key, CallbackExecutor::Policy::COALESCE);
+    }
+    EXPECT_EQ(executor.num_queued(), 1);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        release = true;
+    }
+    cv.notify_all();
+
+    wait_until([&]() { return num_called == 1; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(num_called, 1);
+    EXPECT_EQ(last_value, 10);
+}
+
+TEST(CallbackExecutor, CancelDropsQueuedAndWaitsForRunning)
+{
+    CallbackExecutor executor(1);
+
+    int owner1 = 0;
+    int owner2 = 0;
+    std::atomic<bool> running {false};
+    std::atomic<bool> finished {false};
+    std::atomic<int> num_called {0};
+
+    executor.submit([&running, &finished]() {
+        running = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        finished = true;
+    }, nullptr, CallbackExecutor::Policy::QUEUE, &owner1);
+    for (int i = 0; i < 10; ++i) {
+        executor.submit([&num_called]() { ++num_called; },
+                        nullptr, CallbackExecutor::Policy::QUEUE, (i % 2) ? &owner1 : &owner2);
+    }
+
+    wait_until([&]() { return running.load(); });
+    executor.cancel(&owner1);
+    EXPECT_TRUE(finished);
+
+    // Only those of the other owner are left.
+    wait_until([&]() { return num_called == 5; });
+    EXPECT_EQ(num_called, 5);
+    EXPECT_EQ(executor.num_queued(), 0u);
+}
+
+TEST(CallbackExecutor, CallbackCanCancelItsOwner)
+{
+    CallbackExecutor executor(1);
+
+    int owner = 0;
+    std::atomic<bool> cancelled {false};
+    executor.submit([&executor, &owner, &cancelled]() {
+        executor.cancel(&owner);
+        cancelled = true;
+    }, nullptr, CallbackExecutor::Policy::QUEUE, &owner);
+
+    wait_until([&]() { return cancelled.load(); });
+    EXPECT_TRUE(cancelled);
+}
+
+TEST(CallbackExecutor, BatchesCallbacks)
+{
+    CallbackExecutor executor;
+    executor.set_batch_interval(0.1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const uint64_t num_wakeups_before = executor.num_wakeups();
+
+    std::atomic<int> num_called {0};
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(executor.submit([&num_called]() { ++num_called; }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    // Held back until 100 ms after the first one.
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(num_called, 0);
+
+    wait_until([&]() { return num_called == 10; });
+    EXPECT_EQ(num_called, 10);
+    // Once when the first one is queued, once when the batch is due.
+    EXPECT_LE(executor.num_wakeups() - num_wakeups_before, 3u);
+
+    // Back to running right away.
+    executor.set_batch_interval(0.0);
+    EXPECT_TRUE(executor.submit([&num_called]() { ++num_called; }));
+    wait_until([&]() { return num_called == 11; });
+    EXPECT_EQ(num_called, 11);
+}
@@ -13,6 +13,7 @@ void CliArg::reset()
     _path.clear();
     _baudrate = 0;
     _port = 0;
+    _socket_options = SocketOptions {};
 }
 
 bool CliArg::parse(const std::string &uri)
@@ -24,6 +25,11 @@ bool CliArg::parse(const std::string &uri)
         return false;
     }
 
+    if ((_protocol == Protocol::UDP || _protocol == Protocol::TCP) &&
+        !find_socket_options(rest)) {
+        return false;
+    }
+
     if (!find_path(rest)) {
         return false;
     }
@@ -32,6 +38,8 @@ bool CliArg::parse(const std::string &uri)
         if (!find_baudrate(rest)) {
             return false;
         }
+    } else if (_protocol == Protocol::UNIX || _protocol == Protocol::FILE) {
+        // The whole rest is the path.
     } else {
         if (!find_port(rest)) {
             return false;
@@ -46,6 +54,8 @@ bool CliArg::find_protocol(std::string &rest)
     const std::string udp = "udp";
     const std::string tcp = "tcp";
     const std::string serial = "serial";
+    const std::string unix_socket = "unix";
+    const std::string file = "file";
     const std::string delimiter = "://";
 
     if (rest.find(udp + delimiter) == 0) {
@@ -60,6 +70,14 @@ bool CliArg::find_protocol(std::string &rest)
         _protocol = Protocol::SERIAL;
         rest.erase(0, serial.length() + delimiter.length());
         return true;
+    } else if (rest.find(unix_socket + delimiter) == 0) {
+        _protocol = Protocol::UNIX;
+        rest.erase(0, unix_socket.length() + delimiter.length());
+        return true;
+    } else if (rest.find(file + delimiter) == 0) {
+        _protocol = Protocol::FILE;
+        rest.erase(0, file.length() + delimiter.length());
+        return true;
     } else {
         LogWarn() << "Unknown protocol";
         return false;
@@ -72,12 +90,29 @@ bool CliArg::find_path(std::string &rest)
         if (_protocol == Protocol::UDP || _protocol == Protocol::TCP) {
             // We have to use the default path
             return true;
+        } else if (_protocol == Protocol::UNIX) {
+            LogWarn() << "Path for unix socket required.";
+            return false;
+        } else if (_protocol == Protocol::FILE) {
+            LogWarn() << "Path for log file required.";
+            return false;
         } else {
             LogWarn() << "Path for serial device required.";
             return false;
         }
     }
 
+    if (_protocol == Protocol::UNIX || _protocol == Protocol::FILE) {
+        // Paths can contain ':', so there is nothing to split off.
+        if (rest.find("/") != 0) {
+            LogWarn() << "Path needs to be absolute";
+            return false;
+        }
+        _path = rest;
+        rest = "";
+        return true;
+    }
+
     const std::string delimiter = ":";
     size_t pos = rest.find(delimiter);
     if (pos != rest.npos) {
@@ -141,6 +176,44 @@ bool CliArg::find_port(std::string &rest)
     return true;
 }
 
+bool CliArg::find_socket_options(std::string &rest)
+{
+    const size_t query_pos = rest.find('?');
+    if (query_pos == rest.npos) {
+        return true;
+    }
+    std::string query = rest.substr(query_pos + 1);
+    rest.erase(query_pos);
+
+    while (!query.empty()) {
+        const size_t end = query.find('&');
+        const std::string option = query.substr(0, end);
+        query.erase(0, (end == query.npos) ? query.npos : end + 1);
+
+        const size_t equals = option.find('=');
+        const std::string key = option.substr(0, equals);
+        const std::string value = (equals == option.npos) ? "" : option.substr(equals + 1);
+        if (value.empty() || value.length() > 9 ||
+            value.find_first_not_of("0123456789") != value.npos) {
+            LogWarn() << "Socket option needs a number: " << option;
+            return false;
+        }
+
+        const int number = std::stoi(value);
+        if (key == "qos") {
+            _socket_options.qos = (number != 0);
+        } else if (key == "sndbuf") {
+            _socket_options.send_buffer_size = number;
+        } else if (key == "rcvbuf") {
+            _socket_options.receive_buffer_size = number;
+        } else {
+            LogWarn() << "Unknown socket option: " << key;
+            return false;
+        }
+    }
+    return true;
+}
+
 bool CliArg::find_baudrate(std::string &rest)
 {
     if (rest.length() == 0) {
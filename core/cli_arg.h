@@ -11,7 +11,20 @@ public:
         NONE,
         UDP,
         TCP,
-        SERIAL
+        SERIAL,
+        UNIX,
+        FILE
+    };
+
+    // Of UDP and TCP connections, appended to the URL as a query,
+    // e.g. "udp://:14540?qos=1&sndbuf=262144&rcvbuf=262144".
+    struct SocketOptions {
+        // Marks control traffic with a high priority DSCP and bulk traffic with
+        // a low one, see Connection::get_tos().
+        bool qos {false};
+        // Socket buffer sizes in bytes, 0 keeps the system default.
+        int send_buffer_size {0};
+        int receive_buffer_size {0};
     };
 
     bool parse(const std::string &uri);
@@ -36,17 +49,24 @@ public:
         return _path;
     }
 
+    const SocketOptions &get_socket_options() const
+    {
+        return _socket_options;
+    }
+
 private:
     void reset();
     bool find_protocol(std::string &rest);
     bool find_path(std::string &rest);
     bool find_port(std::string &rest);
     bool find_baudrate(std::string &rest);
+    bool find_socket_options(std::string &rest);
 
     Protocol _protocol {Protocol::NONE};
     std::string _path {};
     int _port {0};
     int _baudrate {0};
+    SocketOptions _socket_options {};
 };
 
 } // namespace dronecore
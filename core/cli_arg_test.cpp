@@ -61,6 +61,34 @@ TEST(CliArg, UDPConnections)
     EXPECT_FALSE(ca.parse("udp://0.0.0.0:-5"));
 }
 
+TEST(CliArg, SocketOptions)
+{
+    CliArg ca;
+    EXPECT_TRUE(ca.parse("udp://:14540?qos=1&sndbuf=262144"));
+    EXPECT_EQ(ca.get_protocol(), CliArg::Protocol::UDP);
+    EXPECT_STREQ(ca.get_path().c_str(), "");
+    EXPECT_EQ(14540, ca.get_port());
+    EXPECT_TRUE(ca.get_socket_options().qos);
+    EXPECT_EQ(262144, ca.get_socket_options().send_buffer_size);
+    EXPECT_EQ(0, ca.get_socket_options().receive_buffer_size);
+
+    EXPECT_TRUE(ca.parse("tcp://192.168.1.12?rcvbuf=65536&qos=0"));
+    EXPECT_STREQ(ca.get_path().c_str(), "192.168.1.12");
+    EXPECT_EQ(0, ca.get_port());
+    EXPECT_FALSE(ca.get_socket_options().qos);
+    EXPECT_EQ(65536, ca.get_socket_options().receive_buffer_size);
+
+    // Options of a previous URL don't stick.
+    EXPECT_TRUE(ca.parse("udp://:14540"));
+    EXPECT_FALSE(ca.get_socket_options().qos);
+    EXPECT_EQ(0, ca.get_socket_options().send_buffer_size);
+
+    EXPECT_FALSE(ca.parse("udp://:14540?dscp=46"));
+    EXPECT_FALSE(ca.parse("udp://:14540?qos"));
+    EXPECT_FALSE(ca.parse("udp://:14540?sndbuf=-1"));
+    EXPECT_FALSE(ca.parse("tcp://:5760?sndbuf=99999999999"));
+}
+
 TEST(CliArg, TCPConnections)
 {
     CliArg ca;
@@ -155,3 +183,41 @@ TEST(CliArg, SerialConnections)
     EXPECT_FALSE(ca.parse("serial://COM3:-1"));
 }
 
+
+TEST(CliArg, UnixConnections)
+{
+    CliArg ca;
+    EXPECT_EQ(ca.get_protocol(), CliArg::Protocol::NONE);
+
+    EXPECT_TRUE(ca.parse("unix:///tmp/mavlink.sock"));
+    EXPECT_EQ(ca.get_protocol(), CliArg::Protocol::UNIX);
+    EXPECT_STREQ(ca.get_path().c_str(), "/tmp/mavlink.sock");
+    EXPECT_EQ(0, ca.get_port());
+
+    EXPECT_TRUE(ca.parse("unix:///run/px4:0/mavlink"));
+    EXPECT_EQ(ca.get_protocol(), CliArg::Protocol::UNIX);
+    EXPECT_STREQ(ca.get_path().c_str(), "/run/px4:0/mavlink");
+
+    // All the wrong combinations.
+    EXPECT_FALSE(ca.parse("unix://"));
+    EXPECT_FALSE(ca.parse("unix://tmp/mavlink.sock"));
+    EXPECT_FALSE(ca.parse("unix:/tmp/mavlink.sock"));
+    EXPECT_FALSE(ca.parse("uni:///tmp/mavlink.sock"));
+}
+
+TEST(CliArg, FileConnections)
+{
+    CliArg ca;
+
+    EXPECT_TRUE(ca.parse("file:///var/log/flight.tlog"));
+    EXPECT_EQ(ca.get_protocol(), CliArg::Protocol::FILE);
+    EXPECT_STREQ(ca.get_path().c_str(), "/var/log/flight.tlog");
+
+    EXPECT_TRUE(ca.parse("file:///logs/2018-01-01 12:00:00.tlog"));
+    EXPECT_STREQ(ca.get_path().c_str(), "/logs/2018-01-01 12:00:00.tlog");
+
+    // All the wrong combinations.
+    EXPECT_FALSE(ca.parse("file://"));
+    EXPECT_FALSE(ca.parse("file://flight.tlog"));
+    EXPECT_FALSE(ca.parse("fil:///var/log/flight.tlog"));
+}
@@ -0,0 +1,64 @@
+#include "allocation_counter.h"
+#include "dronecore_impl.h"
+#include "mavlink_system.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+constexpr unsigned NUM_COMMANDS = 16;
+
+// Like the message rates set when a system connects.
+void queue_commands(MAVLinkSystem &system, std::atomic<unsigned> &num_done)
+{
+    for (unsigned i = 0; i < NUM_COMMANDS; ++i) {
+        MAVLinkCommands::CommandLong command {};
+        command.command = MAV_CMD_SET_MESSAGE_INTERVAL;
+        command.params.param1 = float(i);
+        command.params.param2 = 1e5f;
+        command.target_component_id = uint8_t(MAV_COMP_ID_AUTOPILOT1 + i);
+        system.send_command_async(command, [&num_done](MAVLinkCommands::Result, float) {
+            ++num_done;
+        });
+    }
+}
+
+void ack_commands(MAVLinkSystem &system)
+{
+    // Give the system thread the time to send them.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    for (unsigned i = 0; i < NUM_COMMANDS; ++i) {
+        mavlink_message_t message;
+        mavlink_msg_command_ack_pack(1, uint8_t(MAV_COMP_ID_AUTOPILOT1 + i), &message,
+                                     MAV_CMD_SET_MESSAGE_INTERVAL, MAV_RESULT_ACCEPTED,
+                                     0, 0, GCSClient::system_id, GCSClient::component_id);
+        system.process_mavlink_message(message);
+    }
+}
+
+} // namespace
+
+TEST(CommandPathAllocations, QueueAndAck)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+    std::atomic<unsigned> num_done {0};
+
+    // Once to fill the pool and size the queues.
+    queue_commands(system, num_done);
+    ack_commands(system);
+    ASSERT_EQ(num_done, NUM_COMMANDS);
+
+    {
+        AllocationCounter counter;
+        queue_commands(system, num_done);
+        ack_commands(system);
+        EXPECT_EQ(counter.get(), 0u);
+    }
+    EXPECT_EQ(num_done, 2 * NUM_COMMANDS);
+}
@@ -0,0 +1,75 @@
+#include "completion.h"
+
+#if defined(LINUX)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <climits>
+#endif
+
+namespace dronecore {
+
+#if defined(LINUX)
+
+namespace {
+
+// The futex word is the whole std::atomic, which is what it holds on Linux.
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Unexpected atomic layout");
+
+void futex_wait(std::atomic<uint32_t> &word, uint32_t expected)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected,
+            nullptr, nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t> &word)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT_MAX,
+            nullptr, nullptr, 0);
+}
+
+} // namespace
+
+void CompletionSignal::signal()
+{
+    // Only from here on can the waiter return, so the wake call just uses
+    // the address and doesn't access the memory anymore.
+    if (_state.exchange(SIGNALLED, std::memory_order_acq_rel) == WAITING) {
+        futex_wake(_state);
+    }
+}
+
+void CompletionSignal::wait()
+{
+    uint32_t state = PENDING;
+    if (_state.compare_exchange_strong(state, WAITING, std::memory_order_acquire)) {
+        state = WAITING;
+    }
+    // It has to be checked again after every wake, they can be spurious.
+    while (state != SIGNALLED) {
+        futex_wait(_state, WAITING);
+        state = _state.load(std::memory_order_acquire);
+    }
+}
+
+#else
+
+void CompletionSignal::signal()
+{
+    // Notified with the lock held, otherwise the waiter could already be gone.
+    std::lock_guard<std::mutex> lock(_mutex);
+    _state.store(SIGNALLED, std::memory_order_release);
+    _cv.notify_one();
+}
+
+void CompletionSignal::wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (_state.load(std::memory_order_acquire) != SIGNALLED) {
+        _cv.wait(lock);
+    }
+}
+
+#endif
+
+} // namespace dronecore
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#if !defined(LINUX)
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace dronecore {
+
+// The signalling of Completion, without the value.
+class CompletionSignal
+{
+public:
+    CompletionSignal() = default;
+    ~CompletionSignal() = default;
+
+    void signal();
+    void wait();
+    bool is_signalled() const { return _state.load(std::memory_order_acquire) == SIGNALLED; }
+
+    // Non-copyable
+    CompletionSignal(const CompletionSignal &) = delete;
+    const CompletionSignal &operator=(const CompletionSignal &) = delete;
+
+private:
+    enum : uint32_t { PENDING = 0, WAITING = 1, SIGNALLED = 2 };
+
+    // A futex on Linux, the waiter only needs to go to sleep if the result
+    // isn't there yet.
+    std::atomic<uint32_t> _state {PENDING};
+
+#if !defined(LINUX)
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+#endif
+};
+
+// One-shot result handed from a callback to the thread blocking on it, for
+// the sync wrappers around the async calls. Unlike a promise and future it
+// lives on the stack of the waiting thread, nothing is allocated.
+//
+// The callback needs to call complete() exactly once and must not touch the
+// Completion anymore afterwards, the waiter can be gone right away.
+template <typename T>
+class Completion
+{
+public:
+    Completion() = default;
+    ~Completion() = default;
+
+    void complete(T value)
+    {
+        _value = std::move(value);
+        _signal.signal();
+    }
+
+    T wait()
+    {
+        _signal.wait();
+        return std::move(_value);
+    }
+
+    // Non-copyable
+    Completion(const Completion &) = delete;
+    const Completion &operator=(const Completion &) = delete;
+
+private:
+    T _value {};
+    CompletionSignal _signal {};
+};
+
+} // namespace dronecore
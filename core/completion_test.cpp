@@ -0,0 +1,37 @@
+#include "completion.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(Completion, CompletedBeforeWaiting)
+{
+    Completion<int> completion;
+    completion.complete(42);
+    EXPECT_EQ(completion.wait(), 42);
+}
+
+TEST(Completion, WaitsForOtherThread)
+{
+    Completion<int> completion;
+
+    std::thread thread([&completion]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        completion.complete(7);
+    });
+
+    EXPECT_EQ(completion.wait(), 7);
+    thread.join();
+}
+
+TEST(Completion, ManyInARow)
+{
+    // Like a script doing one sync call after another.
+    for (int i = 0; i < 1000; ++i) {
+        Completion<int> completion;
+        std::thread thread([&completion, i]() { completion.complete(i); });
+        EXPECT_EQ(completion.wait(), i);
+        thread.join();
+    }
+}
@@ -1,13 +1,16 @@
 #include "connection.h"
 #include "dronecore_impl.h"
-#include "mavlink_channels.h"
 #include "global_include.h"
+#include "log.h"
+#include <algorithm>
 
 namespace dronecore {
 
 Connection::Connection(DroneCoreImpl &parent) :
     _parent(parent),
-    _mavlink_receiver() {}
+    _mavlink_receiver(),
+    _time(parent.get_replay_clock()),
+    _dispatch_queue() {}
 
 Connection::~Connection()
 {
@@ -15,31 +18,305 @@ Connection::~Connection()
     stop_mavlink_receiver();
 }
 
-bool Connection::start_mavlink_receiver()
+void Connection::start_mavlink_receiver(unsigned num_receivers)
 {
-    uint8_t channel;
-    if (!MAVLinkChannels::Instance().checkout_free_channel(channel)) {
-        return false;
+    const bool shared_counters = (num_receivers > 1);
+    _mavlink_receiver.reset(new MAVLinkReceiver(_link_counters, shared_counters));
+    _mavlink_receiver->set_filter(&_message_id_filter);
+
+    _extra_mavlink_receivers.clear();
+    for (unsigned i = 1; i < num_receivers; ++i) {
+        _extra_mavlink_receivers.emplace_back(new MAVLinkReceiver(_link_counters,
+                                                                  shared_counters));
+        _extra_mavlink_receivers.back()->set_filter(&_message_id_filter);
     }
 
-    _mavlink_receiver.reset(new MAVLinkReceiver(channel));
-    return true;
+    if (_dispatch_queue_capacity > 0) {
+        _dispatch_queue.reset(new MAVLinkDispatchQueue(
+                                  [this](const mavlink_message_t &message,
+        const dl_time_t &receive_time) {
+            _parent.receive_message(message, *this, receive_time);
+        }, _dispatch_queue_capacity, _dispatch_queue_drop_policy));
+        _dispatch_memory_account = _parent.get_memory_budget().get_account("dispatch");
+        _dispatch_memory_account->charge(_dispatch_queue->get_memory_bytes());
+        _dispatch_queue->start();
+    }
 }
 
 void Connection::stop_mavlink_receiver()
 {
-    if (_mavlink_receiver) {
+    if (_dispatch_queue) {
+        // The receive thread is already stopped, so nothing gets pushed anymore.
+        _dispatch_queue->stop();
+        const auto stats = _dispatch_queue->get_stats();
+        if (stats.dropped > 0) {
+            LogWarn() << "Dispatch queue dropped " << stats.dropped << " messages";
+        }
+        _dispatch_memory_account->release(_dispatch_queue->get_memory_bytes());
+        _dispatch_queue.reset();
+    }
+
+    _mavlink_receiver.reset();
+    _extra_mavlink_receivers.clear();
+}
+
+MAVLinkReceiver &Connection::get_mavlink_receiver(unsigned index)
+{
+    return (index == 0) ? *_mavlink_receiver : *_extra_mavlink_receivers[index - 1];
+}
+
+bool Connection::send_messages(const std::vector<mavlink_message_t> &messages)
+{
+    for (const auto &message : messages) {
+        if (!send_message(message)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Connection::set_dispatch_queue(size_t capacity,
+                                    MAVLinkDispatchQueue::DropPolicy drop_policy)
+{
+    _dispatch_queue_capacity = capacity;
+    _dispatch_queue_drop_policy = drop_policy;
+}
+
+MAVLinkDispatchQueue::Stats Connection::get_dispatch_queue_stats() const
+{
+    if (!_dispatch_queue) {
+        return MAVLinkDispatchQueue::Stats {0, 0, 0, 0};
+    }
+    return _dispatch_queue->get_stats();
+}
+
+size_t Connection::get_dispatch_queue_size() const
+{
+    if (!_dispatch_queue) {
+        return 0;
+    }
+    return _dispatch_queue->size();
+}
+
+uint8_t Connection::get_target_system_id(const mavlink_message_t &message)
+{
+    const mavlink_msg_entry_t *entry = mavlink_get_msg_entry(message.msgid);
+    if (entry == nullptr || (entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM) == 0) {
+        return 0;
+    }
+
+    // MAVLink 2 truncates trailing zeros, so a target outside the payload is 0.
+    if (entry->target_system_ofs >= message.len) {
+        return 0;
+    }
+
+    return uint8_t(_MAV_PAYLOAD(&message)[entry->target_system_ofs]);
+}
+
+void Connection::set_send_batching(size_t max_len, double max_delay_s)
+{
+    _send_batch_max_len = max_len;
+    _send_batch_max_delay_s = max_delay_s;
+}
+
+bool Connection::write_message(const mavlink_message_t &message)
+{
+    if (_send_batcher) {
+        return _send_batcher->push(message);
+    }
+
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+    return write_buffer(buffer, buffer_len);
+}
+
+void Connection::start_send_batcher(SendBatcher::write_t write)
+{
+    if (_send_batch_max_len == 0) {
+        return;
+    }
+    _send_batcher.reset(new SendBatcher(write, _send_batch_max_len, _send_batch_max_delay_s));
+    _send_batcher->start();
+}
+
+void Connection::stop_send_batcher()
+{
+    if (_send_batcher) {
+        // Sends what is still pending.
+        _send_batcher->stop();
+        _send_batcher.reset();
+    }
+}
+
+void Connection::start_tx_scheduler(TxScheduler::send_t send)
+{
+    if (_tx_budget_bytes_per_s <= 0.0) {
+        return;
+    }
+    _tx_scheduler.reset(new TxScheduler(send, _tx_budget_bytes_per_s));
+    _tx_scheduler->start();
+}
+
+void Connection::stop_tx_scheduler()
+{
+    if (_tx_scheduler) {
+        // Sends what is still queued.
+        _tx_scheduler->stop();
+        _tx_scheduler.reset();
+    }
+}
+
+void Connection::add_forwarding(Connection &to,
+                                const std::vector<uint8_t> &system_ids,
+                                const std::vector<uint32_t> &message_ids)
+{
+    std::lock_guard<std::mutex> lock(_forwarding_mutex);
+
+    auto new_table = std::make_shared<forwarding_table_t>(*std::atomic_load(&_forwarding_table));
+    new_table->push_back(ForwardingRoute {&to, system_ids, message_ids,
+                                          std::make_shared<ForwardingCounters>()});
+
+    std::atomic_store(&_forwarding_table,
+                      std::shared_ptr<const forwarding_table_t>(new_table));
+    _has_forwarding = true;
+}
+
+bool Connection::get_forwarding_stats(const Connection &to,
+                                      DroneCore::ForwardingStats &stats) const
+{
+    auto table = std::atomic_load(&_forwarding_table);
+
+    bool found = false;
+    stats = DroneCore::ForwardingStats {0, 0, 0};
+    for (const auto &route : *table) {
+        if (route.to == &to) {
+            stats.forwarded += route.counters->forwarded;
+            stats.filtered += route.counters->filtered;
+            stats.failed += route.counters->failed;
+            found = true;
+        }
+    }
+    return found;
+}
+
+int Connection::get_tos(TxScheduler::Priority priority)
+{
+    // DSCP is the upper six bits.
+    return (priority == TxScheduler::Priority::CONTROL) ? (46 << 2) : (8 << 2);
+}
+
+void Connection::count_frame_sent(const mavlink_message_t &message)
+{
+    auto &counter = (TxScheduler::get_priority(message.msgid) == TxScheduler::Priority::CONTROL) ?
+                    _control_frames_sent : _bulk_frames_sent;
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+DroneCore::LinkStats Connection::get_link_stats() const
+{
+    const auto received = _link_counters.get();
+
+    DroneCore::LinkStats stats;
+    stats.bytes_received = received.bytes_received;
+    stats.bytes_sent = _bytes_sent.load(std::memory_order_relaxed);
+    stats.frames_parsed = received.frames_parsed;
+    stats.crc_errors = received.crc_errors;
+    stats.parse_errors = received.parse_errors;
+    stats.sequence_gaps = received.sequence_gaps;
+    stats.frames_filtered = received.frames_filtered;
+    stats.spin_time_us = _spin_time_us.load(std::memory_order_relaxed);
+    stats.park_time_us = _park_time_us.load(std::memory_order_relaxed);
+    stats.spin_receives = _spin_receives.load(std::memory_order_relaxed);
+    stats.park_receives = _park_receives.load(std::memory_order_relaxed);
+    const TxQueue::Stats tx_queue_stats = get_tx_queue_stats();
+    stats.tx_queued = tx_queue_stats.queued;
+    stats.tx_dropped = tx_queue_stats.dropped;
+    stats.control_frames_sent = _control_frames_sent.load(std::memory_order_relaxed);
+    stats.bulk_frames_sent = _bulk_frames_sent.load(std::memory_order_relaxed);
+    return stats;
+}
 
-        uint8_t used_channel = _mavlink_receiver->get_channel();
-        // Destroy receiver before giving the channel back.
-        _mavlink_receiver.reset();
-        MAVLinkChannels::Instance().checkin_used_channel(used_channel);
+void Connection::count_receive_wait(bool spinning, std::chrono::steady_clock::duration time,
+                                    bool received)
+{
+    // Several receive threads can count at once.
+    const uint64_t time_us = uint64_t(
+                                 std::chrono::duration_cast<std::chrono::microseconds>(time).count());
+    (spinning ? _spin_time_us : _park_time_us).fetch_add(time_us, std::memory_order_relaxed);
+    if (received) {
+        (spinning ? _spin_receives : _park_receives).fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void Connection::clear_forwarding()
+{
+    std::lock_guard<std::mutex> lock(_forwarding_mutex);
+
+    _has_forwarding = false;
+    std::atomic_store(&_forwarding_table, std::make_shared<const forwarding_table_t>());
+}
+
+void Connection::forward(MAVLinkReceiver &receiver, const mavlink_message_t &message)
+{
+    auto table = std::atomic_load(&_forwarding_table);
+
+    const uint8_t *frame = nullptr;
+    size_t frame_len = 0;
+
+    for (const auto &route : *table) {
+        if ((!route.system_ids.empty() &&
+             std::find(route.system_ids.begin(), route.system_ids.end(), message.sysid) ==
+             route.system_ids.end()) ||
+            (!route.message_ids.empty() &&
+             std::find(route.message_ids.begin(), route.message_ids.end(), message.msgid) ==
+             route.message_ids.end())) {
+            ++route.counters->filtered;
+            continue;
+        }
+
+        if (frame == nullptr) {
+            // The bytes as they came in, no need to serialize again.
+            frame = receiver.get_last_frame(frame_len);
+        }
+
+        if (route.to->write_buffer(frame, frame_len)) {
+            ++route.counters->forwarded;
+        } else {
+            ++route.counters->failed;
+        }
     }
 }
 
 void Connection::receive_message(const mavlink_message_t &message)
 {
-    _parent.receive_message(message);
+    receive_message(message, _time.steady_time());
+}
+
+void Connection::receive_message(const mavlink_message_t &message, const dl_time_t &receive_time)
+{
+    receive_message(*_mavlink_receiver, message, receive_time);
+}
+
+void Connection::receive_message(MAVLinkReceiver &receiver, const mavlink_message_t &message,
+                                 const dl_time_t &receive_time)
+{
+    TlogRecorder &recorder = _parent.get_recorder();
+    if (recorder.is_recording()) {
+        // The bytes as they came in.
+        size_t frame_len = 0;
+        const uint8_t *frame = receiver.get_last_frame(frame_len);
+        recorder.record(frame, frame_len);
+    }
+
+    if (_has_forwarding) {
+        forward(receiver, message);
+    }
+
+    if (_dispatch_queue) {
+        _dispatch_queue->push(message, receive_time);
+    } else {
+        _parent.receive_message(message, *this, receive_time);
+    }
 }
 
 } // namespace dronecore
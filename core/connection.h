@@ -1,8 +1,20 @@
 #pragma once
 
+#include "cli_arg.h"
 #include "dronecore.h"
 #include "mavlink_receiver.h"
+#include "message_id_filter.h"
+#include "mavlink_dispatch_queue.h"
+#include "memory_budget.h"
+#include "send_batcher.h"
+#include "tx_scheduler.h"
+#include "tx_queue.h"
+#include "event_loop.h"
 #include <memory>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 namespace dronecore {
 
@@ -16,20 +28,174 @@ public:
 
     virtual ConnectionResult start() = 0;
     virtual ConnectionResult stop() = 0;
+    // Wakes up the receive thread to return, without waiting for it. Sending
+    // still works until stop(), which then only needs to join. This way many
+    // connections can be stopped at once instead of one after the other.
+    virtual void request_stop() {}
     virtual bool is_ok() const = 0;
 
     virtual bool send_message(const mavlink_message_t &message) = 0;
 
+    // Connections which can send several messages at once (e.g. UDP using
+    // sendmmsg) override this, by default it just sends one after the other.
+    virtual bool send_messages(const std::vector<mavlink_message_t> &messages);
+
+    // Received messages are queued and handed on by a separate dispatch thread
+    // so that the receive thread doesn't wait on plugin or user callbacks.
+    // Needs to be set before start(), a capacity of 0 dispatches inline (default).
+    void set_dispatch_queue(size_t capacity,
+                            MAVLinkDispatchQueue::DropPolicy drop_policy =
+                                MAVLinkDispatchQueue::DropPolicy::DROP_OLDEST);
+
+    // Only valid if a dispatch queue is used.
+    MAVLinkDispatchQueue::Stats get_dispatch_queue_stats() const;
+    // Messages waiting in the dispatch queue, 0 without one.
+    size_t get_dispatch_queue_size() const;
+
+    // Connections which support it register their fd with this event loop
+    // instead of spawning their own receive thread. Needs to be set before start().
+    void set_event_loop(std::shared_ptr<EventLoop> event_loop) { _event_loop = event_loop; }
+
+    // Outgoing messages are packed together into writes of up to max_len bytes,
+    // delayed by at most max_delay_s. Commands and setpoints are sent right away.
+    // Needs to be set before start(), a max_len of 0 disables batching (default).
+    void set_send_batching(size_t max_len,
+                           double max_delay_s = SendBatcher::DEFAULT_MAX_DELAY_S);
+
+    // Keeps outgoing traffic within bytes_per_s, control messages go first and
+    // bulk messages (missions, params) use what is left of the budget.
+    // Needs to be set before start(), 0 means unlimited.
+    void set_tx_budget(double bytes_per_s) { _tx_budget_bytes_per_s = bytes_per_s; }
+
+    // DSCP marking and socket buffer sizes, for connections over sockets which
+    // support them (UDP, TCP). Needs to be set before start().
+    void set_socket_options(const CliArg::SocketOptions &options) { _socket_options = options; }
+
+    // IP_TOS byte with QoS: control traffic is expedited forwarding (DSCP 46),
+    // which WMM puts in the video access category, bulk traffic is CS1 (DSCP 8),
+    // the background category.
+    static int get_tos(TxScheduler::Priority priority);
+
+    // Messages received on this connection are also written unchanged to the
+    // other connection if they match the filter. Empty filters match everything.
+    void add_forwarding(Connection &to,
+                        const std::vector<uint8_t> &system_ids,
+                        const std::vector<uint32_t> &message_ids);
+    bool get_forwarding_stats(const Connection &to, DroneCore::ForwardingStats &stats) const;
+    void clear_forwarding();
+
+    // Always counted, can be read from any thread without locking.
+    DroneCore::LinkStats get_link_stats() const;
+
+    // Connections which write from a transmit queue of their own report it here.
+    virtual TxQueue::Stats get_tx_queue_stats() const { return TxQueue::Stats {0, 0}; }
+
+    // Unwanted messages are dropped by the receiver right after parsing, they
+    // are not handled, forwarded or recorded. Can be changed at any time.
+    void set_message_id_filter(MessageIdFilter::Mode mode,
+                               const std::vector<uint32_t> &message_ids)
+    {
+        _message_id_filter.set(mode, message_ids);
+    }
+
+    // Returns 0 for broadcasts and messages without target_system field.
+    static uint8_t get_target_system_id(const mavlink_message_t &message);
+
     // Non-copyable
     Connection(const Connection &) = delete;
     const Connection &operator=(const Connection &) = delete;
 
 protected:
-    bool start_mavlink_receiver();
+    // Writes already serialized frames to the link.
+    virtual bool write_buffer(const uint8_t *buffer, size_t buffer_len) = 0;
+    // Hands the message to the send batcher if there is one, otherwise
+    // serializes it and writes it right away.
+    bool write_message(const mavlink_message_t &message);
+
+    // Links read by several threads at once get a receiver for each of them,
+    // they all count towards the same link stats.
+    void start_mavlink_receiver(unsigned num_receivers = 1);
     void stop_mavlink_receiver();
+    // The first one is _mavlink_receiver.
+    MAVLinkReceiver &get_mavlink_receiver(unsigned index);
+    // For links which can't tell when it arrived, it gets stamped now.
     void receive_message(const mavlink_message_t &message);
+    void receive_message(const mavlink_message_t &message, const dl_time_t &receive_time);
+    // For messages parsed by a receiver other than _mavlink_receiver.
+    void receive_message(MAVLinkReceiver &receiver, const mavlink_message_t &message,
+                         const dl_time_t &receive_time);
+    void start_send_batcher(SendBatcher::write_t write);
+    void stop_send_batcher();
+    void start_tx_scheduler(TxScheduler::send_t send);
+    void stop_tx_scheduler();
+    // Needs to be called by the connections for everything written to the link.
+    void count_bytes_sent(size_t len) { _bytes_sent.fetch_add(len, std::memory_order_relaxed); }
+    // For connections with socket options, for every message handed to the link.
+    void count_frame_sent(const mavlink_message_t &message);
+    // For connections which poll before blocking, after each wait for data.
+    void count_receive_wait(bool spinning, std::chrono::steady_clock::duration time,
+                            bool received);
     DroneCoreImpl &_parent;
     std::unique_ptr<MAVLinkReceiver> _mavlink_receiver;
+    std::vector<std::unique_ptr<MAVLinkReceiver>> _extra_mavlink_receivers {};
+    std::shared_ptr<EventLoop> _event_loop {};
+    // Only set while running and batching is enabled.
+    std::unique_ptr<SendBatcher> _send_batcher {};
+    // Only set while running and a budget is set.
+    std::unique_ptr<TxScheduler> _tx_scheduler {};
+    // Receive times are on this clock, it follows replayed logs.
+    Time _time;
+    CliArg::SocketOptions _socket_options {};
+
+private:
+    size_t _dispatch_queue_capacity {0};
+    MAVLinkDispatchQueue::DropPolicy _dispatch_queue_drop_policy {
+        MAVLinkDispatchQueue::DropPolicy::DROP_OLDEST
+    };
+    std::unique_ptr<MAVLinkDispatchQueue> _dispatch_queue;
+    std::shared_ptr<MemoryAccount> _dispatch_memory_account {};
+
+    size_t _send_batch_max_len {0};
+    double _send_batch_max_delay_s {SendBatcher::DEFAULT_MAX_DELAY_S};
+
+    double _tx_budget_bytes_per_s {0.0};
+
+    // Kept here so they survive restarts of the receiver.
+    MAVLinkReceiver::Counters _link_counters {};
+    MessageIdFilter _message_id_filter {};
+    // Unlike the receive side there can be several writers.
+    std::atomic<uint64_t> _bytes_sent {0};
+    std::atomic<uint64_t> _control_frames_sent {0};
+    std::atomic<uint64_t> _bulk_frames_sent {0};
+    std::atomic<uint64_t> _spin_time_us {0};
+    std::atomic<uint64_t> _park_time_us {0};
+    std::atomic<uint64_t> _spin_receives {0};
+    std::atomic<uint64_t> _park_receives {0};
+
+    void forward(MAVLinkReceiver &receiver, const mavlink_message_t &message);
+
+    struct ForwardingCounters {
+        std::atomic<uint64_t> forwarded {0};
+        std::atomic<uint64_t> filtered {0};
+        std::atomic<uint64_t> failed {0};
+    };
+
+    struct ForwardingRoute {
+        Connection *to;
+        std::vector<uint8_t> system_ids;
+        std::vector<uint32_t> message_ids;
+        // Shared by all snapshots of the table.
+        std::shared_ptr<ForwardingCounters> counters;
+    };
+
+    // Same as for the mavlink handlers, the table is an immutable snapshot
+    // which is replaced atomically, the mutex only serializes writers.
+    typedef std::vector<ForwardingRoute> forwarding_table_t;
+    mutable std::mutex _forwarding_mutex {};
+    std::shared_ptr<const forwarding_table_t> _forwarding_table {
+        std::make_shared<const forwarding_table_t>()
+    };
+    std::atomic<bool> _has_forwarding {false};
 
     //void received_mavlink_message(mavlink_message_t &);
 };
@@ -1,7 +1,11 @@
 #include "dronecore.h"
 
+#include "async_log.h"
 #include "dronecore_impl.h"
 #include "global_include.h"
+#include "thread_setup.h"
+#include "trace.h"
+#include "virtual_clock.h"
 
 namespace dronecore {
 
@@ -14,11 +18,236 @@ DroneCore::~DroneCore()
 {
 }
 
+bool DroneCore::enable_event_loop()
+{
+    return _impl->enable_event_loop();
+}
+
+bool DroneCore::enable_sharded_ingest(unsigned num_workers)
+{
+    return _impl->enable_sharded_ingest(num_workers);
+}
+
+void DroneCore::enable_dispatch_queues(size_t capacity)
+{
+    _impl->enable_dispatch_queues(capacity);
+}
+
+bool DroneCore::enable_udp_receive_sockets(unsigned num_sockets)
+{
+    return _impl->enable_udp_receive_sockets(num_sockets);
+}
+
+bool DroneCore::enable_udp_busy_poll(double max_spin_s)
+{
+    return _impl->enable_udp_busy_poll(max_spin_s);
+}
+
+bool DroneCore::enable_power_saving(double timer_slack_s, double callback_interval_s)
+{
+    return _impl->enable_power_saving(timer_slack_s, callback_interval_s);
+}
+
+DroneCore::WakeupStats DroneCore::get_wakeup_stats() const
+{
+    return _impl->get_wakeup_stats();
+}
+
+DroneCore::QueueDepths DroneCore::get_queue_depths() const
+{
+    return _impl->get_queue_depths();
+}
+
+void DroneCore::set_param_cache_dir(const std::string &dir)
+{
+    _impl->set_param_cache_dir(dir);
+}
+
+void DroneCore::set_terrain_dir(const std::string &dir)
+{
+    _impl->set_terrain_dir(dir);
+}
+
+void DroneCore::set_link_timeout(double timeout_s)
+{
+    _impl->set_link_timeout(timeout_s);
+}
+
+void DroneCore::enable_async_logging(const log_sink_t &sink)
+{
+    AsyncLog::instance().enable(sink);
+}
+
+void DroneCore::disable_async_logging()
+{
+    AsyncLog::instance().disable();
+}
+
+bool DroneCore::start_tracing()
+{
+#if DRONECORE_TRACING == 1
+    Trace::instance().start();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void DroneCore::stop_tracing()
+{
+    Trace::instance().stop();
+}
+
+bool DroneCore::write_trace(const std::string &path)
+{
+    return Trace::instance().write_chrome_trace(path);
+}
+
+void DroneCore::set_thread_config(ThreadRole role, const ThreadConfig &config)
+{
+    dronecore::set_thread_config(role, config);
+}
+
+bool DroneCore::enable_virtual_time(double settle_s)
+{
+    return VirtualClock::enable(settle_s);
+}
+
+void DroneCore::disable_virtual_time()
+{
+    VirtualClock::disable();
+}
+
 ConnectionResult DroneCore::add_any_connection(const std::string &connection_url)
 {
     return _impl->add_any_connection(connection_url);
 }
 
+ConnectionResult DroneCore::add_forwarding(const std::string &from_url,
+                                           const std::string &to_url,
+                                           const std::vector<uint8_t> &system_ids,
+                                           const std::vector<uint32_t> &message_ids)
+{
+    return _impl->add_forwarding(from_url, to_url, system_ids, message_ids);
+}
+
+bool DroneCore::get_forwarding_stats(const std::string &from_url,
+                                     const std::string &to_url,
+                                     ForwardingStats &stats) const
+{
+    return _impl->get_forwarding_stats(from_url, to_url, stats);
+}
+
+bool DroneCore::get_link_stats(const std::string &connection_url, LinkStats &stats) const
+{
+    return _impl->get_link_stats(connection_url, stats);
+}
+
+void DroneCore::enable_handler_profiling(double budget_s, slow_handler_callback_t callback)
+{
+    _impl->enable_handler_profiling(budget_s, callback);
+}
+
+void DroneCore::disable_handler_profiling()
+{
+    _impl->disable_handler_profiling();
+}
+
+std::vector<DroneCore::HandlerTiming> DroneCore::get_handler_timings() const
+{
+    return _impl->get_handler_timings();
+}
+
+void DroneCore::set_memory_cap(const std::string &name, uint64_t cap_bytes)
+{
+    _impl->get_memory_budget().set_cap(name, cap_bytes);
+}
+
+void DroneCore::set_total_memory_cap(uint64_t cap_bytes)
+{
+    _impl->get_memory_budget().set_total_cap(cap_bytes);
+}
+
+std::vector<DroneCore::MemoryUsage> DroneCore::get_memory_usage() const
+{
+    return _impl->get_memory_usage();
+}
+
+void DroneCore::get_fleet_state(FleetState &state) const
+{
+    _impl->get_fleet_state(state);
+}
+
+void DroneCore::subscribe_fleet(FleetStream stream, double rate_hz, fleet_callback_t callback)
+{
+    _impl->subscribe_fleet(stream, rate_hz, callback);
+}
+
+bool DroneCore::publish_shared_state(const std::string &name)
+{
+    return _impl->get_shared_state_feed().start(name);
+}
+
+void DroneCore::stop_publishing_shared_state()
+{
+    _impl->get_shared_state_feed().stop();
+}
+
+bool DroneCore::start_telemetry_relay(const std::string &host, int port, float rate_hz,
+                                      float keyframe_interval_s)
+{
+    return _impl->get_telemetry_relay_feed().start(host, port, rate_hz, keyframe_interval_s);
+}
+
+void DroneCore::stop_telemetry_relay()
+{
+    _impl->get_telemetry_relay_feed().stop();
+}
+
+DroneCore::TelemetryRelayStats DroneCore::get_telemetry_relay_stats() const
+{
+    return _impl->get_telemetry_relay_feed().get_stats();
+}
+
+std::vector<uint8_t> DroneCore::systems_with_battery_below(float remaining_percent) const
+{
+    return _impl->systems_with_battery_below(remaining_percent);
+}
+
+std::vector<uint8_t> DroneCore::systems_within(double latitude_deg, double longitude_deg,
+                                               double radius_m) const
+{
+    return _impl->systems_within(latitude_deg, longitude_deg, radius_m);
+}
+
+std::vector<uint8_t> DroneCore::nearest_systems(double latitude_deg, double longitude_deg,
+                                                unsigned k) const
+{
+    return _impl->nearest_systems(latitude_deg, longitude_deg, k);
+}
+
+void DroneCore::subscribe_proximity(double distance_m, proximity_callback_t callback)
+{
+    _impl->subscribe_proximity(distance_m, callback);
+}
+
+ConnectionResult DroneCore::set_message_filter(const std::string &connection_url,
+                                              MessageFilter filter,
+                                              const std::vector<uint32_t> &message_ids)
+{
+    return _impl->set_message_filter(connection_url, filter, message_ids);
+}
+
+bool DroneCore::start_recording(const std::string &path)
+{
+    return _impl->start_recording(path);
+}
+
+void DroneCore::stop_recording()
+{
+    _impl->stop_recording();
+}
+
 ConnectionResult DroneCore::add_udp_connection(int local_port)
 {
     return DroneCore::add_udp_connection(DEFAULT_UDP_BIND_IP, local_port);
@@ -47,6 +276,11 @@ std::vector<uint64_t> DroneCore::system_uuids() const
     return _impl->get_system_uuids();
 }
 
+void DroneCore::system_uuids(std::vector<uint64_t> &uuids) const
+{
+    _impl->get_system_uuids(uuids);
+}
+
 System &DroneCore::system() const
 {
     return _impl->get_system();
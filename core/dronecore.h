@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
 #include <functional>
 
 #include "connection_result.h"
+#include "log_sink.h"
+#include "thread_config.h"
 
 namespace dronecore {
 
@@ -28,6 +31,7 @@ public:
     static constexpr auto DEFAULT_TCP_REMOTE_IP = "127.0.0.1";
     static constexpr int DEFAULT_TCP_REMOTE_PORT = 5760;
     static constexpr int DEFAULT_SERIAL_BAUDRATE = 57600;
+    static constexpr double DEFAULT_LINK_TIMEOUT_S = 3.0;
 
     /**
      * @brief Constructor.
@@ -41,23 +45,735 @@ public:
      */
     ~DroneCore();
 
+    /**
+     * @brief Use a single event loop thread for receiving on connections.
+     *
+     * By default every connection uses its own receive thread. With the event loop
+     * enabled, connections added afterwards share one thread instead, which helps
+     * when connecting to many systems. Currently only UDP connections on Linux
+     * make use of it.
+     *
+     * @return `true` if the event loop is supported and running.
+     */
+    bool enable_event_loop();
+
+    /**
+     * @brief Process incoming messages on several worker threads.
+     *
+     * By default all messages from all connections are handled one after the
+     * other. With sharded ingest, messages are assigned to a worker based on their
+     * system ID, so several vehicles can be served in parallel while the messages
+     * of one vehicle still arrive in order. This is useful when connecting to many
+     * vehicles at once.
+     *
+     * This needs to be called before any connection is added.
+     *
+     * @param num_workers Number of worker threads (at least 1).
+     * @return `true` if sharded ingest was enabled.
+     */
+    bool enable_sharded_ingest(unsigned num_workers);
+
+    /**
+     * @brief Handle received messages on a thread per connection.
+     *
+     * By default messages are handled on the thread receiving them, so a slow callback
+     * holds up reading from the link. With dispatch queues, each connection added
+     * afterwards queues the messages it receives for a thread of its own.
+     *
+     * Control messages such as heartbeats and acks are never dropped, if their queue is
+     * full receiving waits. Bulk messages (parameters, logs, file transfer) are dropped
+     * once their queue is full, the oldest first. Not needed with sharded ingest, whose
+     * workers already take the messages off the receiving thread.
+     *
+     * This needs to be called before connections are added.
+     *
+     * @param capacity Messages queued per connection for each of control and bulk,
+     *                 0 disables the queues (default).
+     */
+    void enable_dispatch_queues(size_t capacity);
+
+    /**
+     * @brief Receive each UDP connection on several sockets and threads.
+     *
+     * By default one thread reads all datagrams arriving on a UDP port. With several
+     * sockets bound to the same port, the kernel spreads the remotes over them by their
+     * address, so a high packet rate from many vehicles is read on several cores while
+     * all datagrams of one vehicle stay in order. Only supported on Linux, and not
+     * together with the event loop, which reads all connections on one thread.
+     *
+     * This needs to be called before UDP connections are added.
+     *
+     * @param num_sockets Number of sockets per UDP connection (at least 1).
+     * @return `true` if several sockets are supported.
+     */
+    bool enable_udp_receive_sockets(unsigned num_sockets);
+
+    /**
+     * @brief Poll UDP sockets for data instead of blocking right away.
+     *
+     * A blocking read needs the receive thread to be woken up for every datagram,
+     * which adds tens of microseconds. In busy poll mode the thread keeps polling for
+     * up to `max_spin_s` after each read and only then blocks, and the socket asks the
+     * driver to poll the device (SO_BUSY_POLL) meanwhile. This costs a CPU core per
+     * receive thread while traffic is flowing, so it is meant for dedicated cores. The
+     * time spent polling and blocked is counted in the `LinkStats`.
+     *
+     * Only supported on Linux, and not together with the event loop. This needs to be
+     * called before UDP connections are added.
+     *
+     * @param max_spin_s Longest time to poll before blocking, 0 disables it (default).
+     * @return `true` if busy polling is supported.
+     */
+    bool enable_udp_busy_poll(double max_spin_s);
+
+    /**
+     * @brief Wake up the CPU less often, to save battery e.g. on phones.
+     *
+     * The periodic work of all systems (heartbeats, timeouts, retries) is allowed to
+     * run up to `timer_slack_s` late, so timers of different systems due around the
+     * same time are handled on one wakeup. Callbacks are held back for up to
+     * `callback_interval_s` and then delivered together. New commands are still sent
+     * right away. The event loop is enabled as well where supported, see
+     * `enable_event_loop()`. Use `get_wakeup_stats()` to check the effect.
+     *
+     * @param timer_slack_s How late timers may run in seconds, e.g. 0.05.
+     * @param callback_interval_s How long callbacks may be held back in seconds, e.g. 0.1.
+     * @return `true` if the values are valid, 0 for both goes back to the default.
+     */
+    bool enable_power_saving(double timer_slack_s, double callback_interval_s);
+
+    /**
+     * @brief How often the threads of DroneCore were woken up since it was created.
+     */
+    struct WakeupStats {
+        uint64_t system_wakeups; /**< @brief Of the thread running the periodic work. */
+        uint64_t callback_wakeups; /**< @brief Of the threads running callbacks. */
+        /** @brief Of the event loop thread, 0 without the event loop. */
+        uint64_t event_loop_wakeups;
+        double elapsed_s; /**< @brief Time since DroneCore was created. */
+        double wakeups_per_second; /**< @brief All wakeups together, per second. */
+    };
+
+    /**
+     * @brief Get how often the threads were woken up.
+     *
+     * Receive threads of connections not using the event loop are not counted, they
+     * wake up for every datagram.
+     *
+     * @return The counters so far.
+     */
+    WakeupStats get_wakeup_stats() const;
+
+    /**
+     * @brief Work waiting to be done by the threads of DroneCore.
+     */
+    struct QueueDepths {
+        uint64_t callbacks; /**< @brief User callbacks waiting to be called. */
+        /** @brief Received messages waiting in the dispatch queues of the connections. */
+        uint64_t dispatch;
+        /** @brief Received messages waiting for the workers, see `enable_sharded_ingest()`. */
+        uint64_t ingest;
+    };
+
+    /**
+     * @brief Get how much work is queued right now.
+     *
+     * Queues which keep growing mean that callbacks or handlers can't keep up with
+     * the messages received, e.g. for a soak test or a health check.
+     *
+     * @return The queue depths at this moment.
+     */
+    QueueDepths get_queue_depths() const;
+
+    /**
+     * @brief Keep a snapshot of the params of each vehicle on disk.
+     *
+     * On connection all params of a vehicle are downloaded at once and saved in
+     * this directory, one file per vehicle UUID. When the same vehicle connects
+     * again, the params are loaded from disk instead, provided the param hash
+     * reported by the autopilot still matches. This saves re-reading the params
+     * over the link on every connect. The hash check is supported by PX4.
+     *
+     * The UUID last seen for each system ID is kept there as well, so a known
+     * vehicle is discovered on its first heartbeat, before its UUID is confirmed.
+     *
+     * This needs to be called before any connection is added.
+     *
+     * @param dir Existing directory to store the snapshots in (empty to disable).
+     */
+    void set_param_cache_dir(const std::string &dir);
+
+    /**
+     * @brief Answer the terrain requests of vehicles from SRTM tiles.
+     *
+     * Autopilots following the terrain without a map of their own (e.g. ArduPilot
+     * with TERRAIN_ENABLE) ask the ground station for it with TERRAIN_REQUEST.
+     * These are answered with TERRAIN_DATA interpolated from the tiles (.hgt
+     * files, e.g. N47E008.hgt) in the directory, one tile per degree. Parts of a
+     * request without tiles are not answered.
+     *
+     * @param dir Directory with the tiles (empty to stop answering).
+     */
+    void set_terrain_dir(const std::string &dir);
+
+    /**
+     * @brief Set after how long without messages a vehicle is considered lost.
+     *
+     * Any message from a vehicle keeps it connected, not only heartbeats. With
+     * telemetry streaming at a high rate, a timeout well below the heartbeat
+     * interval notices a lost link quickly, e.g. to fail over to another one.
+     * Vehicles which only send heartbeats need a timeout above 1 s though.
+     *
+     * The callback set by `register_on_timeout` is called once this expires.
+     *
+     * @param timeout_s Timeout in seconds (default DEFAULT_LINK_TIMEOUT_S).
+     */
+    void set_link_timeout(double timeout_s);
+
+    /**
+     * @brief Write log output from a background thread.
+     *
+     * By default every line is written to the console by the thread logging it,
+     * which includes the threads receiving and handling messages. With async
+     * logging, lines are queued without blocking and written by a separate thread,
+     * and each source location can log at most 20 lines per second, the rest is
+     * suppressed. Lines are dropped if they come in faster than they are written.
+     *
+     * Logging is global, so this affects all instances of DroneCore.
+     *
+     * @param sink Callback to receive the lines instead of the console (optional).
+     *             It is called on the background thread.
+     */
+    static void enable_async_logging(const log_sink_t &sink = nullptr);
+
+    /**
+     * @brief Write what is queued and go back to writing log lines synchronously.
+     */
+    static void disable_async_logging();
+
+    /**
+     * @brief Record the timeline of receiving, handling and sending messages.
+     *
+     * Records spans of receiving datagrams, parsing, routing and dispatching messages,
+     * timers and user callbacks, and of each command from sending until it is acked or
+     * times out, on all threads. Each thread keeps its latest spans in a ring of
+     * its own, so recording doesn't block and costs little. The trace points are only
+     * compiled in with `-DDRONECORE_TRACING=1`, otherwise there is nothing to record.
+     *
+     * Tracing is global, so this affects all instances of DroneCore.
+     *
+     * @return `true` if the trace points are compiled in.
+     */
+    static bool start_tracing();
+
+    /**
+     * @brief Stop recording, what was recorded can still be written.
+     */
+    static void stop_tracing();
+
+    /**
+     * @brief Write what was recorded since tracing was started.
+     *
+     * The trace is written as Chrome trace JSON, which can be opened by
+     * chrome://tracing or https://ui.perfetto.dev. This can be called while tracing.
+     *
+     * @param path Path of the file to write, it is overwritten.
+     * @return `true` if the file was written.
+     */
+    static bool write_trace(const std::string &path);
+
+    /**
+     * @brief Set how the threads started by DroneCore for a role are run.
+     *
+     * All threads are named after their role, e.g. `dc-udp_recv` or `dc-system`.
+     * With this, they can be pinned to CPUs and run with realtime priority, e.g.
+     * to keep the I/O threads on cores of their own on a companion computer.
+     *
+     * The configuration is global and applies to threads started after the call,
+     * so it is best called before any DroneCore instance is created.
+     *
+     * @param role The threads to configure.
+     * @param config CPUs and priority for these threads.
+     */
+    static void set_thread_config(ThreadRole role, const ThreadConfig &config);
+
+    /**
+     * @brief Run all timers on a virtual clock which skips ahead, for simulations.
+     *
+     * Meant for integration and load tests against simulated peers, e.g. mission, param
+     * or camera scenarios which would otherwise take minutes of real time waiting for
+     * heartbeats, retries and timeouts. While enabled, the time of all timeouts, periodic
+     * calls and plugin state machines is virtual: it stands still as long as there is work,
+     * and once nothing happened for `settle_s` of real time it jumps right to the next
+     * timer due. Received messages are stamped with the virtual time as well.
+     *
+     * The peers need to answer within `settle_s`, otherwise the clock may move on before
+     * their reply arrives. The clock is global, so it is best enabled before any DroneCore
+     * instance is created and kept until they are all destroyed. It can't be used while
+     * replaying a log file with `file://`.
+     *
+     * @param settle_s Real time without any work after which the clock skips ahead.
+     * @return `true` if enabled, `false` if already enabled or `settle_s` isn't positive.
+     */
+    static bool enable_virtual_time(double settle_s = 0.001);
+
+    /**
+     * @brief Goes back to the real clock.
+     */
+    static void disable_virtual_time();
+
     /**
      * @brief Adds Connection via URL
      *
-     * Supports connection: Serial, TCP or UDP.
+     * Supports connection: Serial, TCP, UDP, Unix domain socket or log file replay.
      * Connection URL format should be:
      * - UDP - udp://[Bind_host][:Bind_port]
      * - TCP - tcp://[Remote_host][:Remote_port]
      * - Serial - serial://Dev_Node[:Baudrate]
+     * - Unix - unix://Socket_path (SOCK_SEQPACKET, Linux only)
+     * - File - file://Log_path (replays a .tlog as fast as possible, Linux only)
      *
      * Default URL : udp://0.0.0.0:14540.
      * - Default Bind host IP is any local interface (0.0.0.0)
      *
+     * UDP and TCP URLs take socket options as a query, e.g.
+     * `udp://:14540?qos=1&sndbuf=262144&rcvbuf=262144`:
+     * - qos=1 marks control traffic (commands, setpoints) with DSCP 46 and
+     *   bulk traffic (missions, params) with DSCP 8, for WMM on Wi-Fi links
+     * - sndbuf, rcvbuf set the socket buffer sizes in bytes
+     *
      * @param connection_url connection URL string.
      * @return The result of adding the connection.
      */
     ConnectionResult add_any_connection(const std::string &connection_url);
 
+    /**
+     * @brief Counters of a forwarding route between two connections.
+     */
+    struct ForwardingStats {
+        uint64_t forwarded; /**< @brief Messages written to the other connection. */
+        uint64_t filtered; /**< @brief Messages which didn't match the filter. */
+        uint64_t failed; /**< @brief Messages which could not be written. */
+    };
+
+    /**
+     * @brief Forwards MAVLink messages from one connection to another.
+     *
+     * This allows to use DroneCore as a MAVLink router, e.g. to pass on the traffic of a
+     * vehicle connected via serial to a ground station on UDP. Messages are forwarded as
+     * they were received, and are still handled by DroneCore as well. For both directions
+     * two forwardings need to be added.
+     *
+     * Both connections need to be added first, they are identified by the same URL as used
+     * for add_any_connection(), e.g. `serial:///dev/ttyUSB0:57600` or `udp://:14550`.
+     *
+     * @param from_url URL of the connection to forward from.
+     * @param to_url URL of the connection to forward to.
+     * @param system_ids Only forward messages from these system IDs (empty for all).
+     * @param message_ids Only forward these message IDs (empty for all).
+     * @return The result of adding the forwarding.
+     */
+    ConnectionResult add_forwarding(const std::string &from_url,
+                                    const std::string &to_url,
+                                    const std::vector<uint8_t> &system_ids = {},
+                                    const std::vector<uint32_t> &message_ids = {});
+
+    /**
+     * @brief Get the counters of a forwarding added with add_forwarding().
+     *
+     * @param from_url URL of the connection forwarded from.
+     * @param to_url URL of the connection forwarded to.
+     * @param stats The counters if the forwarding was found.
+     * @return `true` if a forwarding between the connections exists.
+     */
+    bool get_forwarding_stats(const std::string &from_url,
+                              const std::string &to_url,
+                              ForwardingStats &stats) const;
+
+    /**
+     * @brief Traffic counters of a connection, counted since it was added.
+     */
+    struct LinkStats {
+        uint64_t bytes_received; /**< @brief Bytes read from the link. */
+        uint64_t bytes_sent; /**< @brief Bytes written to the link. */
+        uint64_t frames_parsed; /**< @brief MAVLink frames received. */
+        uint64_t crc_errors; /**< @brief Frames dropped because of a wrong checksum. */
+        uint64_t parse_errors; /**< @brief Frames or bytes dropped by the parser, including CRC errors. */
+        uint64_t sequence_gaps; /**< @brief Frames lost according to their sequence numbers. */
+        uint64_t frames_filtered; /**< @brief Frames dropped by the message filter. */
+        /** @brief Time spent polling for data without blocking, see `enable_udp_busy_poll()`. */
+        uint64_t spin_time_us;
+        /** @brief Time spent blocked waiting for data when polling gave up. */
+        uint64_t park_time_us;
+        uint64_t spin_receives; /**< @brief Reads with data while polling. */
+        uint64_t park_receives; /**< @brief Reads with data after blocking. */
+        /** @brief Frames waiting to be written, on serial links which write from a queue. */
+        uint64_t tx_queued;
+        uint64_t tx_dropped; /**< @brief Frames dropped because the transmit queue was full. */
+        /**
+         * @brief Commands, setpoints and other control frames sent, on UDP and TCP links.
+         *
+         * With `qos=1` in the URL of the connection these are marked with DSCP 46.
+         */
+        uint64_t control_frames_sent;
+        /** @brief Mission, parameter and file transfer frames sent, DSCP 8 with `qos=1`. */
+        uint64_t bulk_frames_sent;
+    };
+
+    /**
+     * @brief Get the traffic counters of a connection.
+     *
+     * The counters are always kept and reading them doesn't interfere with the
+     * connection, so this can be polled e.g. for a link quality indicator.
+     *
+     * @param connection_url URL of the connection as used for add_any_connection().
+     * @param stats The counters if the connection was found.
+     * @return `true` if the connection exists.
+     */
+    bool get_link_stats(const std::string &connection_url, LinkStats &stats) const;
+
+    /**
+     * @brief Message ID of the timings of the user callbacks of a system.
+     */
+    static constexpr uint32_t USER_CALLBACKS = UINT32_MAX;
+
+    /**
+     * @brief How long the handlers registered by one plugin for one message took.
+     */
+    struct HandlerTiming {
+        uint8_t system_id; /**< @brief System whose messages were handled. */
+        std::string handler; /**< @brief Plugin or part of DroneCore, empty if unknown. */
+        /** @brief Message handled, or `USER_CALLBACKS` for the callbacks of the system. */
+        uint32_t message_id;
+        uint64_t count; /**< @brief Calls timed. */
+        uint64_t total_ns; /**< @brief Time of all calls together in nanoseconds. */
+        uint64_t max_ns; /**< @brief Longest call in nanoseconds. */
+        uint64_t over_budget; /**< @brief Calls which took longer than the budget. */
+        /**
+         * @brief Calls by duration: below 1 us, below 2 us, and so on doubling, the
+         * last one counts all longer calls.
+         */
+        std::vector<uint64_t> histogram;
+    };
+
+    /**
+     * @brief Callback type for handlers or callbacks which took longer than the budget.
+     *
+     * @param timing Timings of the handler so far, including this call.
+     * @param duration_s How long this call took in seconds.
+     */
+    typedef std::function<void(const HandlerTiming &timing, double duration_s)>
+    slow_handler_callback_t;
+
+    /**
+     * @brief Time the message handlers and user callbacks.
+     *
+     * All handlers of a system run on the same thread, so a handler which takes long holds
+     * up the telemetry of the whole system. With profiling, each handler call is timed and
+     * counted per plugin and message, and calls taking longer than the budget are reported.
+     * This adds two clock reads to every call, without profiling it only costs a check.
+     * Calls over the budget are logged as warnings and passed to the callback, both
+     * from the callback thread.
+     *
+     * @param budget_s Calls longer than this are reported, 0 to only count them.
+     * @param callback Called for every call over the budget (optional).
+     */
+    void enable_handler_profiling(double budget_s, slow_handler_callback_t callback = nullptr);
+
+    /**
+     * @brief Stop timing handlers, the timings so far are kept.
+     */
+    void disable_handler_profiling();
+
+    /**
+     * @brief Get the timings counted since profiling was first enabled (synchronous).
+     *
+     * @return One entry per system, plugin and message, in no particular order.
+     */
+    std::vector<HandlerTiming> get_handler_timings() const;
+
+    /**
+     * @brief Memory held by one part of DroneCore.
+     *
+     * Accounts are named after what they count: `terrain` for the terrain tiles,
+     * `dispatch` and `ingest` for the queues of received messages, and
+     * `system <ID>/params` for the params cache of a system.
+     */
+    struct MemoryUsage {
+        std::string name; /**< @brief Name of the account. */
+        uint64_t bytes; /**< @brief Bytes held now. */
+        uint64_t peak_bytes; /**< @brief Most bytes held at once. */
+        uint64_t cap_bytes; /**< @brief Cap set with set_memory_cap(), 0 without. */
+        uint64_t num_refused; /**< @brief Times more memory was refused because of a cap. */
+    };
+
+    /**
+     * @brief Cap the memory of an account.
+     *
+     * What can be given up stays within the cap: the terrain tiles used least
+     * recently are unloaded to make room, and tiles which still don't fit are
+     * treated as missing. Other accounts are only counted, a cap on them limits
+     * what the capped ones can take within the total cap.
+     *
+     * The cap can be set before the account is used.
+     *
+     * @param name Name of the account, see MemoryUsage.
+     * @param cap_bytes Cap in bytes, 0 for none.
+     */
+    void set_memory_cap(const std::string &name, uint64_t cap_bytes);
+
+    /**
+     * @brief Cap the memory of all accounts together.
+     *
+     * @param cap_bytes Cap in bytes, 0 for none.
+     */
+    void set_total_memory_cap(uint64_t cap_bytes);
+
+    /**
+     * @brief Get the memory held by each part of DroneCore (synchronous).
+     *
+     * @return One entry per account, sorted by name.
+     */
+    std::vector<MemoryUsage> get_memory_usage() const;
+
+    /**
+     * @brief The latest state of all systems, one column per field.
+     *
+     * Row `i` of every column belongs to the system with the ID `system_ids[i]`, sorted
+     * by system ID. Fields not received yet are NAN, or 0 for the modes.
+     */
+    struct FleetState {
+        std::vector<uint8_t> system_ids {}; /**< @brief System ID of each row. */
+        std::vector<double> latitude_deg {}; /**< @brief Latitude in degrees. */
+        std::vector<double> longitude_deg {}; /**< @brief Longitude in degrees. */
+        std::vector<float> absolute_altitude_m {}; /**< @brief Altitude above mean sea level. */
+        std::vector<float> relative_altitude_m {}; /**< @brief Altitude above takeoff. */
+        std::vector<float> roll_deg {}; /**< @brief Roll angle in degrees. */
+        std::vector<float> pitch_deg {}; /**< @brief Pitch angle in degrees. */
+        std::vector<float> yaw_deg {}; /**< @brief Yaw angle in degrees. */
+        std::vector<float> battery_voltage_v {}; /**< @brief Battery voltage in volts. */
+        /** @brief Battery remaining (range: 0.0 to 1.0). */
+        std::vector<float> battery_remaining_percent {};
+        std::vector<uint8_t> base_mode {}; /**< @brief MAV_MODE_FLAG bits of the heartbeat. */
+        std::vector<uint32_t> custom_mode {}; /**< @brief Autopilot specific flight mode. */
+    };
+
+    /**
+     * @brief Copies the state of all systems at once (synchronous).
+     *
+     * The state is kept for every system from the messages as they are received, without
+     * any plugin. Getting it doesn't block receiving, which makes this suitable for polling
+     * a whole fleet e.g. for a dashboard, instead of asking the plugins of each system.
+     *
+     * @param state The columns, reused to avoid allocating if the same is passed again.
+     */
+    void get_fleet_state(FleetState &state) const;
+
+    /**
+     * @brief Streams of the fleet state which can be subscribed to.
+     */
+    enum class FleetStream {
+        POSITION, /**< @brief Positions, from GLOBAL_POSITION_INT. */
+        ATTITUDE, /**< @brief Attitudes, from ATTITUDE. */
+        BATTERY, /**< @brief Battery states, from SYS_STATUS. */
+        MODE /**< @brief Flight modes, from HEARTBEAT. */
+    };
+
+    /**
+     * @brief Callback type for fleet-wide subscriptions.
+     *
+     * @param uuids UUID of each row of the samples, 0 for systems not discovered yet.
+     * @param samples The latest state of the systems which sent the stream.
+     */
+    typedef std::function<void(const std::vector<uint64_t> &uuids,
+                               const FleetState &samples)> fleet_callback_t;
+
+    /**
+     * @brief Subscribe to a stream of all systems with one callback.
+     *
+     * Instead of a callback per system and message, the callback is called once per
+     * period with the systems whose stream was received since the last call, and only
+     * with the latest sample of each. The first call has every system received so far,
+     * no call is made while nothing is received. Like get_fleet_state() this needs no
+     * plugin, and the samples are given as columns.
+     *
+     * @note Only one callback can be registered per stream. Subscribing again replaces the
+     * callback and rate, pass `nullptr` to stop.
+     *
+     * @param stream The stream to subscribe to.
+     * @param rate_hz How often the callback is called at most.
+     * @param callback Callback to register.
+     */
+    void subscribe_fleet(FleetStream stream, double rate_hz, fleet_callback_t callback);
+
+    /**
+     * @brief Publishes the state of all systems into shared memory.
+     *
+     * The same state as get_fleet_state() is written into a POSIX shared memory segment
+     * as it is received, so that other processes on the same computer, e.g. for vision or
+     * logging, can read it at the full rate without gRPC. They read it with
+     * SharedStateReader, or map it themselves, see SharedStateRow for the layout.
+     * Readers never block receiving.
+     *
+     * @param name Name of the segment, e.g. "/dronecore_state". A segment of the same
+     * name left over from before is replaced.
+     * @return true if publishing, false if already publishing or on Windows.
+     */
+    bool publish_shared_state(const std::string &name);
+
+    /**
+     * @brief Stops publishing and removes the segment.
+     *
+     * Readers which have it open keep the last state.
+     */
+    void stop_publishing_shared_state();
+
+    /**
+     * @brief Sends the state of all systems to a remote address over UDP.
+     *
+     * Made for relaying from field stations over metered uplinks such as LTE: at each
+     * period only the fields which changed since the last datagram are sent, XORed
+     * with their previous value and compressed with zlib. Every keyframe_interval_s
+     * the full state is sent, so that receivers which start late or lose a datagram
+     * catch up. The receiver decodes the datagrams with TelemetryRelayDecoder.
+     *
+     * @param host IPv4 address of the receiver.
+     * @param port UDP port of the receiver.
+     * @param rate_hz How often the state is sent.
+     * @param keyframe_interval_s How often the full state is sent.
+     * @return true if relaying, false if already relaying, on invalid arguments or on
+     * Windows.
+     */
+    bool start_telemetry_relay(const std::string &host, int port, float rate_hz = 1.0f,
+                               float keyframe_interval_s = 10.0f);
+
+    /**
+     * @brief Stops relaying.
+     */
+    void stop_telemetry_relay();
+
+    /**
+     * @brief Counters of the telemetry relay.
+     */
+    struct TelemetryRelayStats {
+        uint64_t datagrams_sent; /**< @brief Datagrams sent, including keyframes. */
+        uint64_t keyframes_sent; /**< @brief Keyframes sent. */
+        /** @brief Bytes the state would have taken in full and uncompressed each time. */
+        uint64_t raw_bytes;
+        uint64_t bytes_sent; /**< @brief Bytes actually sent, without UDP/IP headers. */
+    };
+
+    /**
+     * @brief Returns the counters of the telemetry relay (synchronous).
+     *
+     * The counters are kept across restarts of the relay.
+     *
+     * @return The counters.
+     */
+    TelemetryRelayStats get_telemetry_relay_stats() const;
+
+    /**
+     * @brief Finds the systems whose battery is below a level (synchronous).
+     *
+     * @param remaining_percent Battery level (range: 0.0 to 1.0).
+     * @return System IDs in ascending order, systems without a battery level are left out.
+     */
+    std::vector<uint8_t> systems_with_battery_below(float remaining_percent) const;
+
+    /**
+     * @brief Finds the systems within a horizontal distance of a position (synchronous).
+     *
+     * Systems are indexed by their latest position as it is received, so this doesn't
+     * compare against every system. Altitudes are not taken into account.
+     *
+     * @param latitude_deg Latitude of the position in degrees.
+     * @param longitude_deg Longitude of the position in degrees.
+     * @param radius_m Horizontal distance in meters.
+     * @return System IDs, closest first.
+     */
+    std::vector<uint8_t> systems_within(double latitude_deg, double longitude_deg,
+                                        double radius_m) const;
+
+    /**
+     * @brief Finds the systems closest to a position (synchronous).
+     *
+     * @param latitude_deg Latitude of the position in degrees.
+     * @param longitude_deg Longitude of the position in degrees.
+     * @param k Maximum number of systems to return.
+     * @return Up to `k` system IDs, closest first.
+     */
+    std::vector<uint8_t> nearest_systems(double latitude_deg, double longitude_deg,
+                                         unsigned k) const;
+
+    /**
+     * @brief Callback type for systems coming close to each other.
+     *
+     * @param system_id ID of the system which moved.
+     * @param other_system_id ID of the system it came close to.
+     * @param distance_m Horizontal distance between the two in meters.
+     */
+    typedef std::function<void(uint8_t system_id, uint8_t other_system_id,
+                               double distance_m)> proximity_callback_t;
+
+    /**
+     * @brief Subscribe to pairs of systems coming closer than a distance.
+     *
+     * A pair is reported once when it comes closer, and again only after it has been apart
+     * in between. Only the systems around the one which moved are checked on each position
+     * received, so this scales to large fleets.
+     *
+     * @note Only one callback can be registered at a time. Subscribing again replaces the
+     * callback and distance, pass `nullptr` to stop.
+     *
+     * @param distance_m Horizontal distance in meters.
+     * @param callback Callback to register.
+     */
+    void subscribe_proximity(double distance_m, proximity_callback_t callback);
+
+    /**
+     * @brief Which messages of a connection are let through.
+     */
+    enum class MessageFilter {
+        NONE, /**< @brief All messages (default). */
+        ALLOW, /**< @brief Only the listed messages. */
+        DENY /**< @brief All but the listed messages. */
+    };
+
+    /**
+     * @brief Drop unwanted messages of a connection as soon as they are received.
+     *
+     * This is cheaper than ignoring them later, e.g. for debug or ESC messages sent at a
+     * high rate. Dropped messages are neither handled nor forwarded nor recorded, they only
+     * appear in the link stats. Heartbeats always pass, otherwise no vehicle would be
+     * discovered. Note that plugins need their messages, so allow lists should include them.
+     *
+     * @param connection_url URL of the connection as used for add_any_connection().
+     * @param filter Whether the message IDs are allowed or denied.
+     * @param message_ids MAVLink message IDs (below 65536).
+     * @return The result of setting the filter.
+     */
+    ConnectionResult set_message_filter(const std::string &connection_url,
+                                        MessageFilter filter,
+                                        const std::vector<uint32_t> &message_ids = {});
+
+    /**
+     * @brief Records all MAVLink traffic to a telemetry log (.tlog).
+     *
+     * Every frame received on any connection and every frame sent is written with its
+     * time in the format used by QGroundControl, so the log can be analyzed after the flight
+     * or replayed with a `file://` connection. The file is written from a background
+     * thread in large blocks, the connections never wait for it.
+     *
+     * @param path File path of the log, it is overwritten if it exists.
+     * @return `true` if the file could be opened.
+     */
+    bool start_recording(const std::string &path);
+
+    /**
+     * @brief Stops recording and writes what is left of the log.
+     */
+    void stop_recording();
+
     /**
      * @brief Adds a UDP connection to the specified port number.
      *
@@ -120,6 +836,17 @@ public:
      */
     std::vector<uint64_t> system_uuids() const;
 
+    /**
+     * @brief Get the UUIDs of all systems, into a vector which is reused.
+     *
+     * Like system_uuids(), but without allocating if the same vector is passed again,
+     * e.g. when polling a fleet every tick. Neither this nor system(uuid) waits for the
+     * messages being received.
+     *
+     * @param uuids The UUIDs of all systems that have been discovered.
+     */
+    void system_uuids(std::vector<uint64_t> &uuids) const;
+
     /**
      * @brief Get the first discovered system.
      *
@@ -1,5 +1,8 @@
 #include "dronecore_impl.h"
 
+#include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <mutex>
 
 #include "connection.h"
@@ -9,7 +12,10 @@
 #include "system.h"
 #include "mavlink_system.h"
 #include "serial_connection.h"
+#include "unix_connection.h"
+#include "file_connection.h"
 #include "cli_arg.h"
+#include "trace.h"
 
 namespace dronecore {
 
@@ -20,25 +26,75 @@ DroneCoreImpl::DroneCoreImpl() :
     _systems(),
     _on_discover_callback(nullptr),
     _on_timeout_callback(nullptr)
-{}
+{
+    for (auto &route : _routes) {
+        for (auto &components : route.components) {
+            components = 0;
+        }
+    }
+
+    _system_scheduler.add(this, [this]() { return send_heartbeat(); });
+}
 
 DroneCoreImpl::~DroneCoreImpl()
 {
-    {
-        std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-        _should_exit = true;
-
-        _systems.clear();
+    _system_scheduler.remove(this);
+    for (auto &subscription : _fleet_subscriptions) {
+        _system_scheduler.remove(&subscription);
     }
+    _callback_executor.cancel(&_fleet_subscriptions);
+
+    // Reporting looks up the systems, which are about to go.
+    _handler_profiler.disable();
+    _callback_executor.cancel(&_handler_profiler);
+
+    _should_exit = true;
 
+    // Stop the connections first, so no more messages get routed to the
+    // systems while they are being destroyed.
     {
         std::lock_guard<std::mutex> lock(_connections_mutex);
+        for (auto &route : _routes) {
+            route.links.clear();
+            route.connection = nullptr;
+        }
+
+        // Connections forward to each other, so they all need to be stopped
+        // before the first one is destroyed.
+        for (auto &connection : _connections) {
+            connection->clear_forwarding();
+        }
+        // All receive threads are woken up at once, so stopping them takes
+        // as long as the slowest one, not all of them together.
+        for (auto &connection : _connections) {
+            connection->request_stop();
+        }
+        for (auto &connection : _connections) {
+            connection->stop();
+        }
+        _connections_by_url.clear();
         _connections.clear();
     }
+
+    stop_ingest_shards();
+
+    {
+        std::lock_guard<std::mutex> lock(_systems_mutex);
+
+        for (auto &route : _routes) {
+            route.system = nullptr;
+        }
+        _systems.clear();
+        publish_system_directory();
+    }
 }
 
-void DroneCoreImpl::receive_message(const mavlink_message_t &message)
+void DroneCoreImpl::receive_message(const mavlink_message_t &message,
+                                    Connection &connection,
+                                    const dl_time_t &receive_time)
 {
+    DRONECORE_TRACE_SCOPE("route");
+
     // Don't ever create a system with sysid 0.
     if (message.sysid == 0) {
         return;
@@ -52,90 +108,794 @@ void DroneCoreImpl::receive_message(const mavlink_message_t &message)
         return;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    if (_should_exit) {
+        return;
+    }
+
+    // With several links to a system, what arrived on another one already is
+    // dropped, and replies go on the best link. Only write if it changed.
+    Route &route = _routes[message.sysid];
+    if (!route.links.add(&connection, message.compid, message.seq, message.msgid,
+                         message.checksum, receive_time)) {
+        return;
+    }
+    Connection *best_connection = static_cast<Connection *>(route.links.get_best_link());
+    if (route.connection.load() != best_connection) {
+        route.connection = best_connection;
+    }
 
-    // Change system id of null system
-    if (_systems.find(0) != _systems.end()) {
-        auto null_system = _systems[0];
-        _systems.erase(0);
-        null_system->set_system_id(message.sysid);
-        _systems.insert(system_entry_t(message.sysid, null_system));
+    if (!_ingest_shards.empty()) {
+        _ingest_shards[message.sysid % _ingest_shards.size()]->push(message, receive_time);
+        return;
     }
 
-    if (!does_system_exist(message.sysid)) {
-        make_system_with_component(message.sysid, message.compid);
-    } else {
-        _systems.at(message.sysid)->add_new_component(message.compid);
+    route_message(message, receive_time);
+}
+
+void DroneCoreImpl::route_message(const mavlink_message_t &message,
+                                  const dl_time_t &receive_time)
+{
+    update_fleet_state(message);
+
+    // Fast path: we know this system and component already.
+    Route &route = _routes[message.sysid];
+    System *system = route.system.load();
+    if (system != nullptr &&
+        (route.components[message.compid / 32].load() & (1u << (message.compid % 32))) != 0) {
+        system->process_mavlink_message(message, receive_time);
+        return;
     }
 
-    if (_should_exit) {
-        // Don't try to call at() if systems have already been destroyed
-        // in descructor.
+    {
+        std::lock_guard<std::mutex> lock(_systems_mutex);
+
+        if (_should_exit) {
+            // Don't try to call at() if systems have already been destroyed
+            // in descructor.
+            return;
+        }
+
+        // Change system id of null system
+        if (_systems.find(0) != _systems.end()) {
+            auto null_system = _systems[0];
+            _systems.erase(0);
+            _routes[0].system = nullptr;
+            null_system->set_system_id(message.sysid);
+            _systems.insert(system_entry_t(message.sysid, null_system));
+            publish_system_directory();
+        }
+
+        if (!does_system_exist(message.sysid)) {
+            make_system_with_component(message.sysid, message.compid);
+        } else {
+            _systems.at(message.sysid)->add_new_component(message.compid);
+        }
+
+        update_route(message.sysid, message.compid);
+        system = route.system.load();
+    }
+
+    if (system != nullptr) {
+        system->process_mavlink_message(message, receive_time);
+    }
+}
+
+void DroneCoreImpl::update_fleet_state(const mavlink_message_t &message)
+{
+    switch (message.msgid) {
+        case MAVLINK_MSG_ID_HEARTBEAT: {
+                mavlink_heartbeat_t heartbeat;
+                mavlink_msg_heartbeat_decode(&message, &heartbeat);
+                // Cameras, gimbals and the like send heartbeats as well.
+                if (heartbeat.autopilot != MAV_AUTOPILOT_INVALID) {
+                    _fleet_state.set_mode(message.sysid, heartbeat.base_mode,
+                                          heartbeat.custom_mode);
+                    _shared_state_feed.set_mode(message.sysid, heartbeat.base_mode,
+                                                heartbeat.custom_mode);
+                }
+                break;
+            }
+        case MAVLINK_MSG_ID_GLOBAL_POSITION_INT: {
+                mavlink_global_position_int_t position;
+                mavlink_msg_global_position_int_decode(&message, &position);
+                _fleet_state.set_position(message.sysid, position.lat, position.lon,
+                                          position.alt * 1e-3f, position.relative_alt * 1e-3f);
+                _shared_state_feed.set_position(message.sysid, position.lat, position.lon,
+                                                position.alt * 1e-3f,
+                                                position.relative_alt * 1e-3f);
+                update_spatial_index(message.sysid, position.lat * 1e-7, position.lon * 1e-7);
+                break;
+            }
+        case MAVLINK_MSG_ID_ATTITUDE: {
+                mavlink_attitude_t attitude;
+                mavlink_msg_attitude_decode(&message, &attitude);
+                _fleet_state.set_attitude(message.sysid, to_deg_from_rad(attitude.roll),
+                                          to_deg_from_rad(attitude.pitch),
+                                          to_deg_from_rad(attitude.yaw));
+                _shared_state_feed.set_attitude(message.sysid, to_deg_from_rad(attitude.roll),
+                                                to_deg_from_rad(attitude.pitch),
+                                                to_deg_from_rad(attitude.yaw));
+                break;
+            }
+        case MAVLINK_MSG_ID_SYS_STATUS: {
+                mavlink_sys_status_t sys_status;
+                mavlink_msg_sys_status_decode(&message, &sys_status);
+                // -1 if the autopilot doesn't estimate it.
+                const float remaining = (sys_status.battery_remaining < 0) ? NAN :
+                                        sys_status.battery_remaining * 1e-2f;
+                _fleet_state.set_battery(message.sysid, sys_status.voltage_battery * 1e-3f,
+                                         remaining);
+                _shared_state_feed.set_battery(message.sysid,
+                                               sys_status.voltage_battery * 1e-3f, remaining);
+                break;
+            }
+        default:
+            break;
+    }
+}
+
+void DroneCoreImpl::update_spatial_index(uint8_t system_id, double latitude_deg,
+                                         double longitude_deg)
+{
+    // Reused, the receive thread doesn't need to allocate for every position.
+    static thread_local std::vector<SpatialIndex::ProximityAlert> alerts;
+    alerts.clear();
+    _spatial_index.update(system_id, latitude_deg, longitude_deg, alerts);
+    if (alerts.empty()) {
         return;
     }
 
-    if (message.sysid != 1) {
-        LogDebug() << "sysid: " << int(message.sysid);
+    DroneCore::proximity_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_proximity_mutex);
+        callback = _proximity_callback;
+    }
+    if (!callback) {
+        return;
+    }
+
+    for (const auto &alert : alerts) {
+        _callback_executor.submit([callback, alert]() {
+            callback(alert.system_id, alert.other_system_id, alert.distance_m);
+        }, &_spatial_index, CallbackExecutor::Policy::QUEUE, &_spatial_index);
+    }
+}
+
+std::vector<uint8_t> DroneCoreImpl::systems_within(double latitude_deg, double longitude_deg,
+                                                   double radius_m) const
+{
+    std::vector<uint8_t> system_ids;
+    _spatial_index.find_within(latitude_deg, longitude_deg, radius_m, system_ids);
+    return system_ids;
+}
+
+std::vector<uint8_t> DroneCoreImpl::nearest_systems(double latitude_deg, double longitude_deg,
+                                                    unsigned k) const
+{
+    std::vector<uint8_t> system_ids;
+    _spatial_index.find_nearest(latitude_deg, longitude_deg, k, system_ids);
+    return system_ids;
+}
+
+void DroneCoreImpl::subscribe_proximity(double distance_m,
+                                        DroneCore::proximity_callback_t callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_proximity_mutex);
+        _proximity_callback = callback;
     }
+    _spatial_index.set_proximity_distance(callback ? distance_m : 0.0);
+}
+
+void DroneCoreImpl::enable_handler_profiling(double budget_s,
+                                             DroneCore::slow_handler_callback_t callback)
+{
+    _handler_profiler.enable(budget_s, [this, callback](const HandlerProfiler::Key & key,
+    uint64_t duration_ns) {
+        report_slow_handler(key, duration_ns, callback);
+    });
+}
 
-    if (_systems.find(message.sysid) != _systems.end()) {
-        _systems.at(message.sysid)->process_mavlink_message(message);
+void DroneCoreImpl::disable_handler_profiling()
+{
+    _handler_profiler.disable();
+}
+
+std::vector<DroneCore::HandlerTiming> DroneCoreImpl::get_handler_timings() const
+{
+    std::vector<HandlerProfiler::Timing> timings;
+    _handler_profiler.get_timings(timings);
+
+    std::vector<DroneCore::HandlerTiming> handler_timings(timings.size());
+    for (size_t i = 0; i < timings.size(); ++i) {
+        make_handler_timing(timings[i], handler_timings[i]);
     }
+    return handler_timings;
+}
+
+void DroneCoreImpl::report_slow_handler(const HandlerProfiler::Key &key, uint64_t duration_ns,
+                                        DroneCore::slow_handler_callback_t callback)
+{
+    // Called right after the slow handler, the lookup of names is left to the
+    // callback thread.
+    _callback_executor.submit([this, key, duration_ns, callback]() {
+        std::vector<HandlerProfiler::Timing> timings;
+        _handler_profiler.get_timings(timings);
+        for (const auto &timing : timings) {
+            if (timing.key.system == key.system && timing.key.cookie == key.cookie &&
+                timing.key.message_id == key.message_id) {
+                DroneCore::HandlerTiming handler_timing;
+                make_handler_timing(timing, handler_timing);
+                LogWarn() << "Handler " << handler_timing.handler << " of system "
+                          << int(handler_timing.system_id) << " for message "
+                          << handler_timing.message_id << " took " << duration_ns / 1000 << " us";
+                if (callback) {
+                    callback(handler_timing, double(duration_ns) * 1e-9);
+                }
+                return;
+            }
+        }
+    }, &_handler_profiler, CallbackExecutor::Policy::QUEUE, &_handler_profiler);
+}
+
+void DroneCoreImpl::make_handler_timing(const HandlerProfiler::Timing &timing,
+                                        DroneCore::HandlerTiming &handler_timing) const
+{
+    static_assert(DroneCore::USER_CALLBACKS == HandlerProfiler::USER_CALLBACKS,
+                  "message IDs of the user callbacks differ");
+
+    std::shared_ptr<MAVLinkSystem> mavlink_system;
+    {
+        std::lock_guard<std::mutex> lock(_systems_mutex);
+        for (const auto &system : _systems) {
+            if (system.second->mavlink_system().get() == timing.key.system) {
+                mavlink_system = system.second->mavlink_system();
+                break;
+            }
+        }
+    }
+
+    handler_timing.system_id = mavlink_system ? mavlink_system->get_system_id() : 0;
+    handler_timing.handler = mavlink_system ?
+                             mavlink_system->get_handler_name(timing.key.cookie) : "";
+    handler_timing.message_id = timing.key.message_id;
+    handler_timing.count = timing.count;
+    handler_timing.total_ns = timing.total_ns;
+    handler_timing.max_ns = timing.max_ns;
+    handler_timing.over_budget = timing.over_budget;
+    handler_timing.histogram.assign(timing.histogram,
+                                    timing.histogram + HandlerProfiler::NUM_BUCKETS);
+}
+
+void DroneCoreImpl::get_fleet_state(DroneCore::FleetState &state) const
+{
+    _fleet_state.get(state);
+}
+
+void DroneCoreImpl::subscribe_fleet(DroneCore::FleetStream stream, double rate_hz,
+                                    DroneCore::fleet_callback_t callback)
+{
+    const unsigned index = unsigned(stream);
+    FleetSubscription &subscription = _fleet_subscriptions[index];
+
+    if (!callback || !(rate_hz > 0.0)) {
+        _system_scheduler.remove(&subscription);
+        std::lock_guard<std::mutex> lock(_fleet_subscriptions_mutex);
+        subscription.callback = nullptr;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_fleet_subscriptions_mutex);
+        // A new subscriber gets every system first, one replacing it carries on.
+        if (!subscription.callback) {
+            subscription.counters.assign(FleetState::MAX_SYSTEMS, 0);
+        }
+        subscription.callback = callback;
+        subscription.interval_s = 1.0 / rate_hz;
+    }
+    _system_scheduler.add(&subscription, [this, index]() {
+        return run_fleet_subscription(index);
+    });
+}
+
+double DroneCoreImpl::run_fleet_subscription(unsigned index)
+{
+    struct Batch {
+        std::vector<uint64_t> uuids;
+        DroneCore::FleetState samples;
+    };
+    auto batch = std::make_shared<Batch>();
+
+    FleetSubscription &subscription = _fleet_subscriptions[index];
+    DroneCore::fleet_callback_t callback;
+    double interval_s;
+    {
+        std::lock_guard<std::mutex> lock(_fleet_subscriptions_mutex);
+        callback = subscription.callback;
+        interval_s = subscription.interval_s;
+        _fleet_state.get_updated(static_cast<DroneCore::FleetStream>(index),
+                                 subscription.counters, batch->samples);
+    }
+
+    if (!callback || batch->samples.system_ids.empty()) {
+        return interval_s;
+    }
+
+    batch->uuids.reserve(batch->samples.system_ids.size());
+    for (uint8_t system_id : batch->samples.system_ids) {
+        // Systems are only ever destroyed with DroneCore, after this is removed.
+        System *system = _routes[system_id].system.load();
+        batch->uuids.push_back(system != nullptr ? system->get_uuid() : 0);
+    }
+
+    // In order, a slow callback delays the next batch rather than overlapping it.
+    _callback_executor.submit([callback, batch]() {
+        callback(batch->uuids, batch->samples);
+    }, &subscription, CallbackExecutor::Policy::QUEUE, &_fleet_subscriptions);
+    return interval_s;
+}
+
+std::vector<uint8_t> DroneCoreImpl::systems_with_battery_below(float remaining_percent) const
+{
+    std::vector<uint8_t> system_ids;
+    _fleet_state.find_battery_below(remaining_percent, system_ids);
+    return system_ids;
+}
+
+void DroneCoreImpl::update_route(uint8_t system_id, uint8_t component_id)
+{
+    auto it = _systems.find(system_id);
+    if (it == _systems.end()) {
+        return;
+    }
+
+    Route &route = _routes[system_id];
+    route.components[component_id / 32] |= (1u << (component_id % 32));
+    route.system = it->second.get();
 }
 
 bool DroneCoreImpl::send_message(const mavlink_message_t &message)
 {
+    record_sent(message);
+
+    const uint8_t target_system_id = Connection::get_target_system_id(message);
+
     std::lock_guard<std::mutex> lock(_connections_mutex);
 
+    // Connections are only removed in the destructor after clearing the
+    // routes, so the pointer is still valid here.
+    if (target_system_id != 0) {
+        Connection *connection = _routes[target_system_id].connection.load();
+        if (connection != nullptr) {
+            return connection->send_message(message);
+        }
+    }
+
+    // Broadcast, or we don't know where the target is yet, so send it on all links.
+    bool success = true;
     for (auto it = _connections.begin(); it != _connections.end(); ++it) {
         if (!(**it).send_message(message)) {
             LogErr() << "send fail";
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+double DroneCoreImpl::send_heartbeat()
+{
+    mavlink_message_t message;
+    // GCSClient is not autopilot!; hence MAV_AUTOPILOT_INVALID.
+    mavlink_msg_heartbeat_pack(GCSClient::system_id,
+                               GCSClient::component_id,
+                               &message,
+                               MAV_TYPE_GCS,
+                               MAV_AUTOPILOT_INVALID,
+                               0, 0, 0);
+    // Not addressed to a system, so it goes out on every link.
+    send_message(message);
+    return HEARTBEAT_SEND_INTERVAL_S;
+}
+
+bool DroneCoreImpl::send_messages(const std::vector<mavlink_message_t> &messages)
+{
+    for (const auto &message : messages) {
+        record_sent(message);
+    }
+
+    std::lock_guard<std::mutex> lock(_connections_mutex);
+
+    // Grouped by connection, so that each one gets all its messages at once.
+    std::vector<std::vector<mavlink_message_t>> groups(_connections.size());
+    for (auto &group : groups) {
+        group.reserve(messages.size());
+    }
+
+    for (const auto &message : messages) {
+        const uint8_t target_system_id = Connection::get_target_system_id(message);
+        Connection *connection = (target_system_id != 0) ?
+                                 _routes[target_system_id].connection.load() : nullptr;
+
+        for (size_t i = 0; i < _connections.size(); ++i) {
+            // Broadcast, or we don't know where the target is yet, so it goes on all links.
+            if (connection == nullptr || connection == _connections[i].get()) {
+                groups[i].push_back(message);
+            }
+        }
+    }
+
+    bool success = true;
+    for (size_t i = 0; i < _connections.size(); ++i) {
+        if (!groups[i].empty() && !_connections[i]->send_messages(groups[i])) {
+            LogErr() << "send fail";
+            success = false;
+        }
+    }
+    return success;
+}
+
+bool DroneCoreImpl::enable_event_loop()
+{
+    if (_event_loop) {
+        return true;
+    }
+
+    auto event_loop = std::make_shared<EventLoop>();
+    if (!event_loop->start()) {
+        LogWarn() << "Event loop not supported, using a thread per connection";
+        return false;
+    }
+    _event_loop = event_loop;
+    return true;
+}
+
+bool DroneCoreImpl::enable_power_saving(double timer_slack_s, double callback_interval_s)
+{
+    if (!(timer_slack_s >= 0.0) || !(callback_interval_s >= 0.0)) {
+        return false;
+    }
+
+    _system_scheduler.set_timer_slack(timer_slack_s);
+    _callback_executor.set_batch_interval(callback_interval_s);
+    if (timer_slack_s > 0.0 || callback_interval_s > 0.0) {
+        // Falls back to a thread per connection if not supported.
+        enable_event_loop();
+    }
+    return true;
+}
+
+DroneCore::WakeupStats DroneCoreImpl::get_wakeup_stats() const
+{
+    DroneCore::WakeupStats stats {};
+    stats.system_wakeups = _system_scheduler.num_wakeups();
+    stats.callback_wakeups = _callback_executor.num_wakeups();
+    std::shared_ptr<EventLoop> event_loop = _event_loop;
+    if (event_loop) {
+        stats.event_loop_wakeups = event_loop->num_wakeups();
+    }
+    stats.elapsed_s = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - _created_time).count();
+    if (stats.elapsed_s > 0.0) {
+        stats.wakeups_per_second = double(stats.system_wakeups + stats.callback_wakeups +
+                                          stats.event_loop_wakeups) / stats.elapsed_s;
+    }
+    return stats;
+}
+
+DroneCore::QueueDepths DroneCoreImpl::get_queue_depths()
+{
+    DroneCore::QueueDepths depths {};
+    depths.callbacks = _callback_executor.num_queued();
+    {
+        std::lock_guard<std::mutex> lock(_connections_mutex);
+        for (const auto &connection : _connections) {
+            depths.dispatch += connection->get_dispatch_queue_size();
+        }
+    }
+    // The shards are only added before any connection and removed on destruction.
+    for (const auto &shard : _ingest_shards) {
+        depths.ingest += shard->size();
+    }
+    return depths;
+}
+
+bool DroneCoreImpl::enable_udp_receive_sockets(unsigned num_sockets)
+{
+#if defined(LINUX)
+    if (num_sockets == 0) {
+        return false;
+    }
+    _udp_receive_sockets = num_sockets;
+    return true;
+#else
+    UNUSED(num_sockets);
+    LogWarn() << "Several UDP receive sockets not supported";
+    return false;
+#endif
+}
+
+bool DroneCoreImpl::enable_udp_busy_poll(double max_spin_s)
+{
+#if defined(LINUX)
+    if (!(max_spin_s >= 0.0)) {
+        return false;
+    }
+    _udp_busy_poll_s = max_spin_s;
+    return true;
+#else
+    UNUSED(max_spin_s);
+    LogWarn() << "UDP busy polling not supported";
+    return false;
+#endif
+}
+
+bool DroneCoreImpl::enable_sharded_ingest(unsigned num_workers)
+{
+    if (num_workers == 0) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_connections_mutex);
+        if (!_connections.empty()) {
+            LogErr() << "Sharded ingest needs to be enabled before adding connections";
             return false;
         }
     }
 
+    if (!_ingest_shards.empty()) {
+        return _ingest_shards.size() == num_workers;
+    }
+
+    for (unsigned i = 0; i < num_workers; ++i) {
+        std::unique_ptr<MAVLinkDispatchQueue> shard(
+        new MAVLinkDispatchQueue([this](const mavlink_message_t &message,
+        const dl_time_t &receive_time) {
+            route_message(message, receive_time);
+        }, INGEST_QUEUE_CAPACITY));
+        _memory_budget.get_account("ingest")->charge(shard->get_memory_bytes());
+        shard->start();
+        _ingest_shards.push_back(std::move(shard));
+    }
     return true;
 }
 
-ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection_url)
+void DroneCoreImpl::set_param_cache_dir(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lock(_param_cache_dir_mutex);
+    _param_cache_dir = dir;
+}
+
+std::string DroneCoreImpl::get_param_cache_dir()
+{
+    std::lock_guard<std::mutex> lock(_param_cache_dir_mutex);
+    return _param_cache_dir;
+}
+
+std::vector<DroneCore::MemoryUsage> DroneCoreImpl::get_memory_usage() const
+{
+    std::vector<MemoryAccount::Usage> usage;
+    _memory_budget.get_usage(usage);
+
+    std::vector<DroneCore::MemoryUsage> memory_usage(usage.size());
+    for (size_t i = 0; i < usage.size(); ++i) {
+        memory_usage[i].name = usage[i].name;
+        memory_usage[i].bytes = usage[i].bytes;
+        memory_usage[i].peak_bytes = usage[i].peak_bytes;
+        memory_usage[i].cap_bytes = usage[i].cap_bytes;
+        memory_usage[i].num_refused = usage[i].num_refused;
+    }
+    return memory_usage;
+}
+
+void DroneCoreImpl::set_terrain_dir(const std::string &dir)
+{
+    std::shared_ptr<TerrainCache> terrain {};
+    if (!dir.empty()) {
+        terrain = std::make_shared<TerrainCache>(dir, TerrainCache::DEFAULT_MAX_TILES,
+                                                 _memory_budget.get_account("terrain"));
+    }
+
+    std::lock_guard<std::mutex> lock(_terrain_mutex);
+    // Requests still being answered keep the old one until they are done.
+    _terrain = terrain;
+}
+
+std::shared_ptr<TerrainCache> DroneCoreImpl::get_terrain()
+{
+    std::lock_guard<std::mutex> lock(_terrain_mutex);
+    return _terrain;
+}
+
+void DroneCoreImpl::set_link_timeout(double timeout_s)
+{
+    _link_timeout_s = timeout_s;
+
+    // The systems might have to check earlier than they planned to.
+    std::lock_guard<std::mutex> lock(_systems_mutex);
+    for (auto &system : _systems) {
+        _system_scheduler.wake(system.second->mavlink_system().get());
+    }
+}
+
+bool DroneCoreImpl::get_cached_uuid(uint8_t system_id, uint64_t &uuid)
+{
+    std::lock_guard<std::mutex> lock(_param_cache_dir_mutex);
+    load_uuid_cache();
+
+    auto it = _uuid_cache.find(system_id);
+    if (it == _uuid_cache.end()) {
+        return false;
+    }
+    uuid = it->second;
+    return true;
+}
+
+void DroneCoreImpl::cache_uuid(uint8_t system_id, uint64_t uuid)
+{
+    std::lock_guard<std::mutex> lock(_param_cache_dir_mutex);
+    load_uuid_cache();
+
+    auto it = _uuid_cache.find(system_id);
+    if (it != _uuid_cache.end() && it->second == uuid) {
+        return;
+    }
+    _uuid_cache[system_id] = uuid;
+    save_uuid_cache();
+}
+
+// One line per system with system ID and UUID.
+void DroneCoreImpl::load_uuid_cache()
+{
+    if (_uuid_cache_loaded || _param_cache_dir.empty()) {
+        return;
+    }
+    _uuid_cache_loaded = true;
+
+    std::ifstream file(_param_cache_dir + "/uuids.txt");
+    unsigned system_id;
+    uint64_t uuid;
+    while (file >> system_id >> uuid) {
+        if (system_id > 0 && system_id < 256) {
+            _uuid_cache[uint8_t(system_id)] = uuid;
+        }
+    }
+}
+
+void DroneCoreImpl::save_uuid_cache()
+{
+    if (_param_cache_dir.empty()) {
+        return;
+    }
+
+    // Write to a temporary file first, so a crash can't leave half a cache.
+    const std::string path = _param_cache_dir + "/uuids.txt";
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        for (const auto &entry : _uuid_cache) {
+            file << unsigned(entry.first) << ' ' << entry.second << '\n';
+        }
+        if (!file.good()) {
+            LogWarn() << "Could not write UUID cache " << path;
+            return;
+        }
+    }
+    std::rename(tmp_path.c_str(), path.c_str());
+}
+
+void DroneCoreImpl::stop_ingest_shards()
+{
+    // The connections are gone already, so nothing gets pushed anymore.
+    uint64_t dropped = 0;
+    for (auto &shard : _ingest_shards) {
+        shard->request_stop();
+    }
+    for (auto &shard : _ingest_shards) {
+        shard->stop();
+        dropped += shard->get_stats().dropped;
+        _memory_budget.get_account("ingest")->release(shard->get_memory_bytes());
+    }
+    if (dropped > 0) {
+        LogWarn() << "Ingest workers dropped " << dropped << " messages";
+    }
+    _ingest_shards.clear();
+}
+
+bool DroneCoreImpl::resolve_connection_url(const std::string &connection_url,
+                                           CliArg::Protocol &protocol,
+                                           std::string &path,
+                                           int &number,
+                                           CliArg::SocketOptions *options)
 {
     CliArg cli_arg;
     if (!cli_arg.parse(connection_url)) {
-        return ConnectionResult::CONNECTION_URL_INVALID;
+        return false;
     }
 
-    switch (cli_arg.get_protocol()) {
-        case CliArg::Protocol::UDP: {
-                std::string path = DroneCore::DEFAULT_UDP_BIND_IP;
-                int port = DroneCore::DEFAULT_UDP_PORT;
-                if (!cli_arg.get_path().empty()) {
-                    path = cli_arg.get_path();
-                }
-                if (cli_arg.get_port()) {
-                    port = cli_arg.get_port();
-                }
-                return add_udp_connection(path, port);
-            }
+    protocol = cli_arg.get_protocol();
+    path = cli_arg.get_path();
+    if (options != nullptr) {
+        *options = cli_arg.get_socket_options();
+    }
 
-        case CliArg::Protocol::TCP: {
-                std::string path = DroneCore::DEFAULT_TCP_REMOTE_IP;
-                int port = DroneCore::DEFAULT_TCP_REMOTE_PORT;
-                if (!cli_arg.get_path().empty()) {
-                    path = cli_arg.get_path();
-                }
-                if (cli_arg.get_port()) {
-                    port = cli_arg.get_port();
-                }
-                return add_tcp_connection(path, port);
+    switch (protocol) {
+        case CliArg::Protocol::UDP:
+            if (path.empty()) {
+                path = DroneCore::DEFAULT_UDP_BIND_IP;
             }
+            number = cli_arg.get_port() ? cli_arg.get_port() : DroneCore::DEFAULT_UDP_PORT;
+            return true;
 
-        case CliArg::Protocol::SERIAL: {
-                int baudrate = DroneCore::DEFAULT_SERIAL_BAUDRATE;
-                if (cli_arg.get_baudrate()) {
-                    baudrate = cli_arg.get_baudrate();
-                }
-                return add_serial_connection(cli_arg.get_path(), baudrate);
+        case CliArg::Protocol::TCP:
+            if (path.empty()) {
+                path = DroneCore::DEFAULT_TCP_REMOTE_IP;
             }
+            number = cli_arg.get_port() ? cli_arg.get_port() : DroneCore::DEFAULT_TCP_REMOTE_PORT;
+            return true;
+
+        case CliArg::Protocol::SERIAL:
+            number = cli_arg.get_baudrate() ? cli_arg.get_baudrate() :
+                     DroneCore::DEFAULT_SERIAL_BAUDRATE;
+            return true;
+
+        case CliArg::Protocol::UNIX:
+        case CliArg::Protocol::FILE:
+            number = 0;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+std::string DroneCoreImpl::make_connection_url(CliArg::Protocol protocol,
+                                               const std::string &path,
+                                               int number)
+{
+    switch (protocol) {
+        case CliArg::Protocol::UDP:
+            return "udp://" + path + ":" + std::to_string(number);
+        case CliArg::Protocol::TCP:
+            return "tcp://" + path + ":" + std::to_string(number);
+        case CliArg::Protocol::SERIAL:
+            return "serial://" + path + ":" + std::to_string(number);
+        case CliArg::Protocol::UNIX:
+            return "unix://" + path;
+        case CliArg::Protocol::FILE:
+            return "file://" + path;
+        default:
+            return "";
+    }
+}
+
+ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection_url)
+{
+    CliArg::Protocol protocol;
+    std::string path;
+    int number;
+    CliArg::SocketOptions options;
+    if (!resolve_connection_url(connection_url, protocol, path, number, &options)) {
+        return ConnectionResult::CONNECTION_URL_INVALID;
+    }
+
+    switch (protocol) {
+        case CliArg::Protocol::UDP:
+            return add_udp_connection(path, number, options);
+
+        case CliArg::Protocol::TCP:
+            return add_tcp_connection(path, number, options);
+
+        case CliArg::Protocol::SERIAL:
+            return add_serial_connection(path, number);
+
+        case CliArg::Protocol::UNIX:
+            return add_unix_connection(path);
+
+        case CliArg::Protocol::FILE:
+            return add_file_connection(path);
 
         default:
             return ConnectionResult::CONNECTION_ERROR;
@@ -143,66 +903,215 @@ ConnectionResult DroneCoreImpl::add_any_connection(const std::string &connection
 }
 
 ConnectionResult DroneCoreImpl::add_udp_connection(const std::string &local_ip,
-                                                   const int local_port)
+                                                   const int local_port,
+                                                   const CliArg::SocketOptions &options)
 {
     auto new_conn = std::make_shared<UdpConnection>(*this, local_ip, local_port);
+    new_conn->set_socket_options(options);
+    new_conn->set_event_loop(_event_loop);
+    new_conn->set_num_sockets(_udp_receive_sockets);
+    new_conn->set_busy_poll(_udp_busy_poll_s);
 
-    ConnectionResult ret = new_conn->start();
-    if (ret == ConnectionResult::SUCCESS) {
-        add_connection(new_conn);
-    }
-    return ret;
+    return add_connection(make_connection_url(CliArg::Protocol::UDP, local_ip, local_port),
+                          new_conn);
 }
 
 ConnectionResult DroneCoreImpl::add_tcp_connection(const std::string &remote_ip,
-                                                   int remote_port)
+                                                   int remote_port,
+                                                   const CliArg::SocketOptions &options)
 {
     auto new_conn = std::make_shared<TcpConnection>(*this, remote_ip, remote_port);
+    new_conn->set_socket_options(options);
+    new_conn->set_socket_buffer_sizes(options.send_buffer_size, options.receive_buffer_size);
 
-    ConnectionResult ret = new_conn->start();
-    if (ret == ConnectionResult::SUCCESS) {
-        add_connection(new_conn);
-    }
-    return ret;
+    return add_connection(make_connection_url(CliArg::Protocol::TCP, remote_ip, remote_port),
+                          new_conn);
 }
 
 ConnectionResult DroneCoreImpl::add_serial_connection(const std::string &dev_path,
                                                       int baudrate)
 {
     auto new_conn = std::make_shared<SerialConnection>(*this, dev_path, baudrate);
+    return add_connection(make_connection_url(CliArg::Protocol::SERIAL, dev_path, baudrate),
+                          new_conn);
+}
 
-    ConnectionResult ret = new_conn->start();
-    if (ret == ConnectionResult::SUCCESS) {
-        add_connection(new_conn);
-    }
-    return ret;
+ConnectionResult DroneCoreImpl::add_unix_connection(const std::string &path)
+{
+    auto new_conn = std::make_shared<UnixConnection>(*this, path);
+    return add_connection(make_connection_url(CliArg::Protocol::UNIX, path, 0), new_conn);
 }
 
-void DroneCoreImpl::add_connection(std::shared_ptr<Connection> new_connection)
+ConnectionResult DroneCoreImpl::add_file_connection(const std::string &path)
 {
+    auto new_conn = std::make_shared<FileConnection>(*this, path);
+
+    return add_connection(make_connection_url(CliArg::Protocol::FILE, path, 0), new_conn);
+}
+
+ConnectionResult DroneCoreImpl::add_connection(const std::string &connection_url,
+                                               std::shared_ptr<Connection> new_connection)
+{
+    // The ingest workers already decouple receiving from dispatching.
+    if (_ingest_shards.empty()) {
+        new_connection->set_dispatch_queue(_dispatch_queue_capacity);
+    }
+
+    ConnectionResult ret = new_connection->start();
+    if (ret != ConnectionResult::SUCCESS) {
+        return ret;
+    }
+
     std::lock_guard<std::mutex> lock(_connections_mutex);
     _connections.push_back(new_connection);
+    _connections_by_url[connection_url] = new_connection;
+    return ConnectionResult::SUCCESS;
 }
 
-std::vector<uint64_t> DroneCoreImpl::get_system_uuids() const
+Connection *DroneCoreImpl::find_connection(const std::string &connection_url)
 {
-    std::vector<uint64_t> uuids = {};
+    CliArg::Protocol protocol;
+    std::string path;
+    int number;
+    if (!resolve_connection_url(connection_url, protocol, path, number)) {
+        return nullptr;
+    }
 
-    for (auto it = _systems.begin(); it != _systems.end(); ++it) {
-        auto mavlink_system = it->second->_mavlink_system;
-        uint64_t uuid = mavlink_system->get_uuid();
-        if (uuid != 0) {
-            uuids.push_back(uuid);
-        }
+    auto it = _connections_by_url.find(make_connection_url(protocol, path, number));
+    if (it == _connections_by_url.end()) {
+        return nullptr;
+    }
+    return it->second.get();
+}
+
+ConnectionResult DroneCoreImpl::add_forwarding(const std::string &from_url,
+                                               const std::string &to_url,
+                                               const std::vector<uint8_t> &system_ids,
+                                               const std::vector<uint32_t> &message_ids)
+{
+    std::lock_guard<std::mutex> lock(_connections_mutex);
+
+    Connection *from = find_connection(from_url);
+    Connection *to = find_connection(to_url);
+    if (from == nullptr || to == nullptr || from == to) {
+        LogErr() << "Can't forward from " << from_url << " to " << to_url;
+        return ConnectionResult::CONNECTION_URL_INVALID;
     }
 
-    return uuids;
+    from->add_forwarding(*to, system_ids, message_ids);
+    return ConnectionResult::SUCCESS;
+}
+
+bool DroneCoreImpl::get_forwarding_stats(const std::string &from_url,
+                                         const std::string &to_url,
+                                         DroneCore::ForwardingStats &stats)
+{
+    std::lock_guard<std::mutex> lock(_connections_mutex);
+
+    Connection *from = find_connection(from_url);
+    Connection *to = find_connection(to_url);
+    if (from == nullptr || to == nullptr) {
+        return false;
+    }
+
+    return from->get_forwarding_stats(*to, stats);
+}
+
+bool DroneCoreImpl::get_link_stats(const std::string &connection_url,
+                                   DroneCore::LinkStats &stats)
+{
+    std::lock_guard<std::mutex> lock(_connections_mutex);
+
+    Connection *connection = find_connection(connection_url);
+    if (connection == nullptr) {
+        return false;
+    }
+
+    stats = connection->get_link_stats();
+    return true;
+}
+
+ConnectionResult DroneCoreImpl::set_message_filter(const std::string &connection_url,
+                                                  DroneCore::MessageFilter filter,
+                                                  const std::vector<uint32_t> &message_ids)
+{
+    std::lock_guard<std::mutex> lock(_connections_mutex);
+
+    Connection *connection = find_connection(connection_url);
+    if (connection == nullptr) {
+        LogErr() << "No connection " << connection_url << " to filter";
+        return ConnectionResult::CONNECTION_URL_INVALID;
+    }
+
+    MessageIdFilter::Mode mode = MessageIdFilter::Mode::NONE;
+    switch (filter) {
+        case DroneCore::MessageFilter::ALLOW:
+            mode = MessageIdFilter::Mode::ALLOW;
+            break;
+        case DroneCore::MessageFilter::DENY:
+            mode = MessageIdFilter::Mode::DENY;
+            break;
+        case DroneCore::MessageFilter::NONE:
+            break;
+    }
+    connection->set_message_id_filter(mode, message_ids);
+    return ConnectionResult::SUCCESS;
+}
+
+bool DroneCoreImpl::start_recording(const std::string &path)
+{
+    if (!_recorder.start(path)) {
+        LogErr() << "Could not open " << path << " for recording";
+        return false;
+    }
+    return true;
+}
+
+void DroneCoreImpl::stop_recording()
+{
+    _recorder.stop();
+
+    const auto stats = _recorder.get_stats();
+    if (stats.write_failed || stats.frames_dropped > 0) {
+        LogWarn() << "Recording incomplete, " << stats.frames_dropped << " frames dropped"
+                  << (stats.write_failed ? ", writing failed" : "");
+    }
+}
+
+void DroneCoreImpl::record_sent(const mavlink_message_t &message)
+{
+    if (!_recorder.is_recording()) {
+        return;
+    }
+
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+    _recorder.record(frame, frame_len);
+}
+
+std::vector<uint64_t> DroneCoreImpl::get_system_uuids() const
+{
+    return std::atomic_load(&_system_directory)->uuids();
+}
+
+void DroneCoreImpl::get_system_uuids(std::vector<uint64_t> &uuids) const
+{
+    const auto directory = std::atomic_load(&_system_directory);
+    uuids.assign(directory->uuids().begin(), directory->uuids().end());
 }
 
 System &DroneCoreImpl::get_system()
 {
     {
-        std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+        // The usual case, without waiting for messages being routed.
+        const auto directory = std::atomic_load(&_system_directory);
+        if (directory->size() == 1) {
+            return *directory->system(0);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_systems_mutex);
         // In get_system withoiut uuid, we expect to have only
         // one system conneted.
         if (_systems.size() == 1) {
@@ -231,9 +1140,14 @@ System &DroneCoreImpl::get_system()
 
 System &DroneCoreImpl::get_system(const uint64_t uuid)
 {
+    System *found = std::atomic_load(&_system_directory)->find(uuid);
+    if (found != nullptr) {
+        return *found;
+    }
+
     {
-        std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-        // TODO: make a cache map for this.
+        std::lock_guard<std::mutex> lock(_systems_mutex);
+        // Only the null system for UUID 0 can be found here.
         for (auto system : _systems) {
             if (system.second->get_uuid() == uuid) {
                 return *system.second;
@@ -245,39 +1159,52 @@ System &DroneCoreImpl::get_system(const uint64_t uuid)
     // TODO: this is an error condition that we ought to handle properly.
     LogErr() << "system with UUID: " << uuid << " not found";
 
+    std::lock_guard<std::mutex> lock(_systems_mutex);
+
     // Create a dummy
     uint8_t system_id = 0, comp_id = 0;
-    make_system_with_component(system_id, comp_id);
+    if (!does_system_exist(system_id)) {
+        make_system_with_component(system_id, comp_id);
+    }
 
     return *_systems[system_id];
 }
 
 bool DroneCoreImpl::is_connected() const
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-
-    if (_systems.size() == 1) {
-        return _systems.begin()->second->is_connected();
+    const auto directory = std::atomic_load(&_system_directory);
+    if (directory->size() == 1) {
+        return directory->system(0)->is_connected();
     }
     return false;
 }
 
 bool DroneCoreImpl::is_connected(const uint64_t uuid) const
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    const System *system = std::atomic_load(&_system_directory)->find(uuid);
+    return system != nullptr && system->is_connected();
+}
 
-    for (auto it = _systems.begin(); it != _systems.end(); ++it) {
-        if (it->second->get_uuid() == uuid) {
-            return it->second->is_connected();
-        }
+void DroneCoreImpl::update_system_directory()
+{
+    std::lock_guard<std::mutex> lock(_systems_mutex);
+    publish_system_directory();
+}
+
+void DroneCoreImpl::publish_system_directory()
+{
+    std::vector<SystemDirectory::Entry> entries;
+    entries.reserve(_systems.size());
+    for (const auto &system : _systems) {
+        entries.push_back(SystemDirectory::Entry {system.second->get_uuid(), system.second.get()});
     }
-    return false;
+    std::atomic_store(&_system_directory,
+                      std::shared_ptr<const SystemDirectory>(
+                          std::make_shared<SystemDirectory>(entries)));
 }
 
 void DroneCoreImpl::make_system_with_component(uint8_t system_id, uint8_t comp_id)
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-
     if (_should_exit) {
         // When the system got destroyed in the destructor, we have to give up.
         return;
@@ -289,12 +1216,11 @@ void DroneCoreImpl::make_system_with_component(uint8_t system_id, uint8_t comp_i
     auto new_system = std::make_shared<System>(*this, system_id, comp_id);
 
     _systems.insert(system_entry_t(system_id, new_system));
+    publish_system_directory();
 }
 
 bool DroneCoreImpl::does_system_exist(uint8_t system_id)
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
-
     if (!_should_exit) {
         return (_systems.find(system_id) != _systems.end());
     }
@@ -319,15 +1245,23 @@ void DroneCoreImpl::notify_on_timeout(const uint64_t uuid)
 
 void DroneCoreImpl::register_on_discover(const DroneCore::event_callback_t callback)
 {
-    std::lock_guard<std::recursive_mutex> lock(_systems_mutex);
+    std::vector<uint64_t> uuids {};
+    {
+        std::lock_guard<std::mutex> lock(_systems_mutex);
 
-    if (callback) {
         for (auto const &connected_system : _systems) {
-            callback(connected_system.second->get_uuid());
+            uuids.push_back(connected_system.second->get_uuid());
         }
+
+        _on_discover_callback = callback;
     }
 
-    _on_discover_callback = callback;
+    // Don't call back with the lock held, the callback is likely to call get_system().
+    if (callback) {
+        for (auto uuid : uuids) {
+            callback(uuid);
+        }
+    }
 }
 
 void DroneCoreImpl::register_on_timeout(const DroneCore::event_callback_t callback)
@@ -1,13 +1,30 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 #include <atomic>
+#include <chrono>
 
 #include "connection.h"
+#include "event_loop.h"
+#include "mavlink_dispatch_queue.h"
+#include "system_directory.h"
 #include "dronecore.h"
 #include "system.h"
+#include "cli_arg.h"
+#include "tlog_recorder.h"
+#include "link_selector.h"
+#include "system_scheduler.h"
+#include "callback_executor.h"
+#include "handler_profiler.h"
+#include "memory_budget.h"
+#include "fleet_state.h"
+#include "shared_state_feed.h"
+#include "telemetry_relay_feed.h"
+#include "spatial_index.h"
+#include "terrain_cache.h"
 #include "mavlink_include.h"
 
 namespace dronecore {
@@ -18,26 +35,107 @@ public:
     DroneCoreImpl();
     ~DroneCoreImpl();
 
-    void receive_message(const mavlink_message_t &message);
+    void receive_message(const mavlink_message_t &message, Connection &connection,
+                         const dl_time_t &receive_time);
     bool send_message(const mavlink_message_t &message);
+    // Each message goes where send_message() would send it, but all messages for
+    // a connection are handed to it at once.
+    bool send_messages(const std::vector<mavlink_message_t> &messages);
+
+    bool enable_event_loop();
+    bool enable_sharded_ingest(unsigned num_workers);
+    void enable_dispatch_queues(size_t capacity) { _dispatch_queue_capacity = capacity; }
+    bool enable_udp_receive_sockets(unsigned num_sockets);
+    bool enable_udp_busy_poll(double max_spin_s);
+    bool enable_power_saving(double timer_slack_s, double callback_interval_s);
+    DroneCore::WakeupStats get_wakeup_stats() const;
+    DroneCore::QueueDepths get_queue_depths();
+
+    void set_param_cache_dir(const std::string &dir);
+    std::string get_param_cache_dir();
+
+    // The UUID a system ID had last time, also from earlier sessions if there is
+    // a param cache dir. Then a known vehicle is discovered on its first heartbeat.
+    bool get_cached_uuid(uint8_t system_id, uint64_t &uuid);
+    void cache_uuid(uint8_t system_id, uint64_t uuid);
+
+    void set_link_timeout(double timeout_s);
+    double get_link_timeout_s() const { return _link_timeout_s; }
+
+    MemoryBudget &get_memory_budget() { return _memory_budget; }
+    std::vector<DroneCore::MemoryUsage> get_memory_usage() const;
+
+    void set_terrain_dir(const std::string &dir);
+    // nullptr if no terrain is set.
+    std::shared_ptr<TerrainCache> get_terrain();
+
+    static constexpr size_t INGEST_QUEUE_CAPACITY = 1024;
+    // Our heartbeat goes out once per link, however many systems there are.
+    static constexpr double HEARTBEAT_SEND_INTERVAL_S = 1.0;
 
     ConnectionResult add_any_connection(const std::string &connection_url);
     ConnectionResult add_link_connection(const std::string &protocol,
                                          const std::string &ip,
                                          int port);
     ConnectionResult add_udp_connection(const std::string &local_ip,
-                                        int local_port_number);
+                                        int local_port_number,
+                                        const CliArg::SocketOptions &options = {});
     ConnectionResult add_tcp_connection(const std::string &remote_ip,
-                                        int remote_port);
+                                        int remote_port,
+                                        const CliArg::SocketOptions &options = {});
     ConnectionResult add_serial_connection(const std::string &dev_path,
                                            int baudrate);
+    ConnectionResult add_unix_connection(const std::string &path);
+    ConnectionResult add_file_connection(const std::string &path);
+
+    ConnectionResult add_forwarding(const std::string &from_url,
+                                    const std::string &to_url,
+                                    const std::vector<uint8_t> &system_ids,
+                                    const std::vector<uint32_t> &message_ids);
+    bool get_forwarding_stats(const std::string &from_url,
+                              const std::string &to_url,
+                              DroneCore::ForwardingStats &stats);
+    bool get_link_stats(const std::string &connection_url, DroneCore::LinkStats &stats);
+
+    void get_fleet_state(DroneCore::FleetState &state) const;
+    void subscribe_fleet(DroneCore::FleetStream stream, double rate_hz,
+                         DroneCore::fleet_callback_t callback);
+    SharedStateFeed &get_shared_state_feed() { return _shared_state_feed; }
+    TelemetryRelayFeed &get_telemetry_relay_feed() { return _telemetry_relay_feed; }
+    std::vector<uint8_t> systems_with_battery_below(float remaining_percent) const;
+    std::vector<uint8_t> systems_within(double latitude_deg, double longitude_deg,
+                                        double radius_m) const;
+    std::vector<uint8_t> nearest_systems(double latitude_deg, double longitude_deg,
+                                         unsigned k) const;
+    void subscribe_proximity(double distance_m, DroneCore::proximity_callback_t callback);
+    void enable_handler_profiling(double budget_s, DroneCore::slow_handler_callback_t callback);
+    void disable_handler_profiling();
+    std::vector<DroneCore::HandlerTiming> get_handler_timings() const;
+    ConnectionResult set_message_filter(const std::string &connection_url,
+                                        DroneCore::MessageFilter filter,
+                                        const std::vector<uint32_t> &message_ids);
+
+    bool start_recording(const std::string &path);
+    void stop_recording();
+    // Connections record what they receive, if recording.
+    TlogRecorder &get_recorder() { return _recorder; }
+    // Set while replaying a log, the connections and systems tell the time with it.
+    ReplayClock &get_replay_clock() { return _replay_clock; }
+
+    // Shared by all systems, so a system doesn't need threads of its own.
+    SystemScheduler &get_system_scheduler() { return _system_scheduler; }
+    CallbackExecutor &get_callback_executor() { return _callback_executor; }
+    HandlerProfiler &get_handler_profiler() { return _handler_profiler; }
 
     std::vector<uint64_t> get_system_uuids() const;
+    void get_system_uuids(std::vector<uint64_t> &uuids) const;
     System &get_system();
     System &get_system(uint64_t uuid);
 
     bool is_connected() const;
     bool is_connected(uint64_t uuid) const;
+    // For when the UUID of a system changed.
+    void update_system_directory();
 
     void register_on_discover(DroneCore::event_callback_t callback);
     void register_on_timeout(DroneCore::event_callback_t callback);
@@ -46,22 +144,133 @@ public:
     void notify_on_timeout(uint64_t uuid);
 
 private:
-    void add_connection(std::shared_ptr<Connection>);
+    void route_message(const mavlink_message_t &message, const dl_time_t &receive_time);
+    void update_fleet_state(const mavlink_message_t &message);
+    // Returns the seconds until it is due again.
+    double run_fleet_subscription(unsigned index);
+    void update_spatial_index(uint8_t system_id, double latitude_deg, double longitude_deg);
+    void report_slow_handler(const HandlerProfiler::Key &key, uint64_t duration_ns,
+                             DroneCore::slow_handler_callback_t callback);
+    void make_handler_timing(const HandlerProfiler::Timing &timing,
+                             DroneCore::HandlerTiming &handler_timing) const;
+    // Applies what all connections share, starts it and keeps it if that worked.
+    ConnectionResult add_connection(const std::string &connection_url,
+                                    std::shared_ptr<Connection> new_connection);
+    // Need to be called with _connections_mutex locked.
+    Connection *find_connection(const std::string &connection_url);
+
+    // Fills in the defaults, so the same connection always ends up with the same URL.
+    static bool resolve_connection_url(const std::string &connection_url,
+                                       CliArg::Protocol &protocol,
+                                       std::string &path,
+                                       int &number,
+                                       CliArg::SocketOptions *options = nullptr);
+    static std::string make_connection_url(CliArg::Protocol protocol,
+                                           const std::string &path,
+                                           int number);
+    void stop_ingest_shards();
+    // Returns the seconds until it is due again.
+    double send_heartbeat();
+    void record_sent(const mavlink_message_t &message);
+    // Need to be called with _systems_mutex locked.
     void make_system_with_component(uint8_t system_id, uint8_t component_id);
     bool does_system_exist(uint8_t system_id);
+    void publish_system_directory();
+    void update_route(uint8_t system_id, uint8_t component_id);
+    // Need to be called with _param_cache_dir_mutex locked.
+    void load_uuid_cache();
+    void save_uuid_cache();
 
     using system_entry_t = std::pair<uint8_t, std::shared_ptr<System>>;
 
+    // Before anything which tells the time with it.
+    ReplayClock _replay_clock {};
+    // First, so it is destroyed after everything which might still record.
+    TlogRecorder _recorder {};
+    // Before the systems, which use them until they are destroyed.
+    SystemScheduler _system_scheduler {};
+    CallbackExecutor _callback_executor {};
+    // The counters are pointed to by the handlers of the systems.
+    HandlerProfiler _handler_profiler {};
+    // The accounts handed out keep counting if they outlive it.
+    MemoryBudget _memory_budget {};
+
+    std::shared_ptr<EventLoop> _event_loop {};
+
+    const std::chrono::steady_clock::time_point _created_time {
+        std::chrono::steady_clock::now()
+    };
+
+    // Messages are hashed by sysid onto these workers, so all messages of one
+    // system are handled by the same thread and stay in order. This is only
+    // set up before any connection exists, so it can be read without locking.
+    std::vector<std::unique_ptr<MAVLinkDispatchQueue>> _ingest_shards {};
+
+    // Sockets opened by UDP connections added afterwards.
+    std::atomic<size_t> _dispatch_queue_capacity {0};
+    std::atomic<unsigned> _udp_receive_sockets {1};
+    std::atomic<double> _udp_busy_poll_s {0.0};
+
     std::mutex _connections_mutex;
     std::vector<std::shared_ptr<Connection>> _connections;
+    // Connections by their URL with all defaults filled in.
+    std::map<std::string, std::shared_ptr<Connection>> _connections_by_url;
 
-    mutable std::recursive_mutex _systems_mutex;
+    mutable std::mutex _systems_mutex;
     std::map<uint8_t, std::shared_ptr<System>> _systems;
+    // Rebuilt from _systems with _systems_mutex locked, read with std::atomic_load.
+    std::shared_ptr<const SystemDirectory> _system_directory {
+        std::make_shared<const SystemDirectory>()
+    };
+
+    // Routing table indexed by sysid which can be used without locking.
+    // Systems are only ever added (or moved away from sysid 0), so once a system
+    // and its component are known, incoming messages skip the lock.
+    struct Route {
+        std::atomic<System *> system {nullptr};
+        // Bitmask of the component IDs which we have seen already.
+        std::atomic<uint32_t> components[256 / 32];
+        // Connection with the lowest latency and loss to this system, targeted
+        // messages only go there.
+        std::atomic<Connection *> connection {nullptr};
+        LinkSelector links {};
+    };
+    Route _routes[256];
+
+    FleetState _fleet_state {};
+    SpatialIndex _spatial_index {};
+    SharedStateFeed _shared_state_feed {};
+    // Reads _fleet_state from its thread, so it has to go first.
+    TelemetryRelayFeed _telemetry_relay_feed {
+        [this](DroneCore::FleetState &state) { _fleet_state.get(state); }
+    };
+    // One per stream, scheduled by their address.
+    struct FleetSubscription {
+        DroneCore::fleet_callback_t callback {nullptr};
+        double interval_s {0.0};
+        // Counters of the fleet state when the callback was last called.
+        std::vector<uint32_t> counters {};
+    };
+    std::mutex _fleet_subscriptions_mutex {};
+    FleetSubscription _fleet_subscriptions[FleetState::NUM_STREAMS];
+    std::mutex _proximity_mutex {};
+    DroneCore::proximity_callback_t _proximity_callback {nullptr};
 
     DroneCore::event_callback_t _on_discover_callback;
     DroneCore::event_callback_t _on_timeout_callback;
 
     std::atomic<bool> _should_exit = {false};
+
+    std::atomic<double> _link_timeout_s {DroneCore::DEFAULT_LINK_TIMEOUT_S};
+
+    std::mutex _param_cache_dir_mutex {};
+    std::string _param_cache_dir {};
+    // Also protected by _param_cache_dir_mutex, it is stored in there.
+    std::map<uint8_t, uint64_t> _uuid_cache {};
+    bool _uuid_cache_loaded {false};
+
+    std::mutex _terrain_mutex {};
+    std::shared_ptr<TerrainCache> _terrain {};
 };
 
 } // namespace dronecore
@@ -0,0 +1,188 @@
+#include "event_loop.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_setup.h"
+
+#if defined(LINUX)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#endif
+
+namespace dronecore {
+
+EventLoop::EventLoop() {}
+
+EventLoop::~EventLoop()
+{
+    stop();
+}
+
+bool EventLoop::start()
+{
+#if defined(LINUX)
+    if (_loop_thread != nullptr) {
+        return true;
+    }
+
+    _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (_epoll_fd < 0) {
+        LogErr() << "epoll_create1 error: " << strerror(errno);
+        return false;
+    }
+
+    _wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (_wakeup_fd < 0) {
+        LogErr() << "eventfd error: " << strerror(errno);
+        close(_epoll_fd);
+        _epoll_fd = -1;
+        return false;
+    }
+
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = _wakeup_fd;
+    epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &event);
+
+    _should_exit = false;
+    _loop_thread = new std::thread(loop_thread, this);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void EventLoop::stop()
+{
+    if (_loop_thread == nullptr) {
+        return;
+    }
+
+    _should_exit = true;
+    wake_up();
+
+    _loop_thread->join();
+    delete _loop_thread;
+    _loop_thread = nullptr;
+
+#if defined(LINUX)
+    close(_wakeup_fd);
+    _wakeup_fd = -1;
+    close(_epoll_fd);
+    _epoll_fd = -1;
+#endif
+}
+
+bool EventLoop::add_fd(int fd, fd_callback_t callback)
+{
+#if defined(LINUX)
+    if (_loop_thread == nullptr) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        _callbacks[fd] = std::make_shared<fd_callback_t>(callback);
+    }
+
+    struct epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+        LogErr() << "epoll_ctl error: " << strerror(errno);
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        _callbacks.erase(fd);
+        return false;
+    }
+    return true;
+#else
+    UNUSED(fd);
+    UNUSED(callback);
+    return false;
+#endif
+}
+
+void EventLoop::remove_fd(int fd)
+{
+#if defined(LINUX)
+    {
+        std::lock_guard<std::mutex> lock(_callbacks_mutex);
+        if (_callbacks.erase(fd) == 0) {
+            return;
+        }
+    }
+
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+    if (_loop_thread != nullptr && std::this_thread::get_id() != _loop_thread->get_id()) {
+        // Wait for a callback which might currently be running.
+        std::lock_guard<std::mutex> lock(_dispatch_mutex);
+    }
+#else
+    UNUSED(fd);
+#endif
+}
+
+void EventLoop::wake_up()
+{
+#if defined(LINUX)
+    uint64_t one = 1;
+    if (write(_wakeup_fd, &one, sizeof(one)) < 0) {
+        LogErr() << "eventfd write error: " << strerror(errno);
+    }
+#endif
+}
+
+void EventLoop::loop_thread(EventLoop *self)
+{
+    setup_thread(ThreadRole::System, "event_loop");
+
+#if defined(LINUX)
+    static constexpr int MAX_EVENTS = 32;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!self->_should_exit) {
+        int num_events = epoll_wait(self->_epoll_fd, events, MAX_EVENTS, -1);
+        self->_num_wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        if (num_events < 0) {
+            if (errno != EINTR) {
+                LogErr() << "epoll_wait error: " << strerror(errno);
+            }
+            continue;
+        }
+
+        std::lock_guard<std::mutex> dispatch_lock(self->_dispatch_mutex);
+
+        for (int i = 0; i < num_events; ++i) {
+            const int fd = events[i].data.fd;
+
+            if (fd == self->_wakeup_fd) {
+                uint64_t value;
+                if (read(self->_wakeup_fd, &value, sizeof(value)) < 0) {
+                    // Nothing to do, we just needed to wake up.
+                }
+                continue;
+            }
+
+            std::shared_ptr<fd_callback_t> callback;
+            {
+                std::lock_guard<std::mutex> lock(self->_callbacks_mutex);
+                auto it = self->_callbacks.find(fd);
+                if (it != self->_callbacks.end()) {
+                    callback = it->second;
+                }
+            }
+            if (callback) {
+                (*callback)();
+            }
+        }
+    }
+#else
+    UNUSED(self);
+#endif
+}
+
+} // namespace dronecore
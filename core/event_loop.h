@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+namespace dronecore {
+
+// Single thread multiplexing the file descriptors of several connections
+// so that not every connection needs its own receive thread.
+// This is currently only implemented using epoll on Linux, on other
+// platforms start() fails and connections use their own threads instead.
+class EventLoop
+{
+public:
+    EventLoop();
+    ~EventLoop();
+
+    typedef std::function<void()> fd_callback_t;
+
+    bool start();
+    void stop();
+
+    // The callback is called from the event loop thread whenever there is
+    // data to read. It must not block, so the fd should be read non-blocking.
+    bool add_fd(int fd, fd_callback_t callback);
+
+    // After this returns, the callback of this fd is not running anymore
+    // (unless called from within a callback).
+    void remove_fd(int fd);
+
+    bool is_running() const { return _loop_thread != nullptr; }
+
+    // How often the thread woke up, for data or to be stopped.
+    uint64_t num_wakeups() const { return _num_wakeups.load(std::memory_order_relaxed); }
+
+    // Non-copyable
+    EventLoop(const EventLoop &) = delete;
+    const EventLoop &operator=(const EventLoop &) = delete;
+
+private:
+    static void loop_thread(EventLoop *self);
+    void wake_up();
+
+    int _epoll_fd {-1};
+    int _wakeup_fd {-1};
+
+    std::mutex _callbacks_mutex {};
+    std::map<int, std::shared_ptr<fd_callback_t>> _callbacks {};
+
+    // Held while callbacks are running so that remove_fd can wait for them.
+    std::mutex _dispatch_mutex {};
+
+    std::thread *_loop_thread {nullptr};
+    std::atomic<bool> _should_exit {false};
+    std::atomic<uint64_t> _num_wakeups {0};
+};
+
+} // namespace dronecore
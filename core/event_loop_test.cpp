@@ -0,0 +1,57 @@
+#include "event_loop.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#if defined(LINUX)
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+using namespace dronecore;
+
+#if defined(LINUX)
+TEST(EventLoop, CallsBackOnReadableFd)
+{
+    EventLoop event_loop;
+    ASSERT_TRUE(event_loop.start());
+
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+
+    std::atomic<int> bytes_read {0};
+    EXPECT_TRUE(event_loop.add_fd(fds[0], [&]() {
+        char buffer[16];
+        ssize_t ret = read(fds[0], buffer, sizeof(buffer));
+        if (ret > 0) {
+            bytes_read += int(ret);
+        }
+    }));
+
+    EXPECT_EQ(write(fds[1], "hello", 5), 5);
+
+    for (int i = 0; i < 100 && bytes_read < 5; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(bytes_read, 5);
+
+    event_loop.remove_fd(fds[0]);
+
+    // Not called anymore after removing.
+    EXPECT_EQ(write(fds[1], "again", 5), 5);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(bytes_read, 5);
+
+    event_loop.stop();
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif
+
+TEST(EventLoop, AddFdFailsWhenNotStarted)
+{
+    EventLoop event_loop;
+    EXPECT_FALSE(event_loop.add_fd(0, []() {}));
+}
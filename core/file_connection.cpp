@@ -0,0 +1,208 @@
+#include "file_connection.h"
+#include "dronecore_impl.h"
+#include "tlog_reader.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_setup.h"
+#include "virtual_clock.h"
+
+#if defined(LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h> // for close()
+#endif
+
+#include <cstring>
+
+#define GET_ERROR(_x) strerror(_x)
+
+namespace dronecore {
+
+FileConnection::FileConnection(DroneCoreImpl &parent, const std::string &path) :
+    Connection(parent),
+    _path(path) {}
+
+FileConnection::~FileConnection()
+{
+    // If no one explicitly called stop before, we should at least do it.
+    stop();
+}
+
+bool FileConnection::is_ok() const
+{
+    return _is_ok;
+}
+
+ConnectionResult FileConnection::start()
+{
+#if defined(LINUX)
+    // A replay runs as fast as the messages are handled, queueing them
+    // would only drop some.
+    set_dispatch_queue(0);
+    start_mavlink_receiver();
+
+    ConnectionResult ret = map_file();
+    if (ret != ConnectionResult::SUCCESS) {
+        return ret;
+    }
+
+    // Both would set the clock.
+    if (!VirtualClock::begin_replay()) {
+        unmap_file();
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+
+    _is_ok = true;
+    _replay_thread = new std::thread(replay, this);
+
+    return ConnectionResult::SUCCESS;
+#else
+    LogErr() << "Log replay is only supported on Linux";
+    return ConnectionResult::NOT_IMPLEMENTED;
+#endif
+}
+
+ConnectionResult FileConnection::map_file()
+{
+#if defined(LINUX)
+    _fd = open(_path.c_str(), O_RDONLY);
+    if (_fd < 0) {
+        LogErr() << "open error: " << GET_ERROR(errno);
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+
+    struct stat file_stat {};
+    if (fstat(_fd, &file_stat) < 0 || file_stat.st_size <= 0) {
+        LogErr() << "Log is empty or can't be read: " << _path;
+        unmap_file();
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+    _len = size_t(file_stat.st_size);
+
+    // Private and writable because the parser takes a non-const buffer,
+    // pages are only copied if it ever writes to them.
+    void *data = mmap(nullptr, _len, PROT_READ | PROT_WRITE, MAP_PRIVATE, _fd, 0);
+    if (data == MAP_FAILED) {
+        LogErr() << "mmap error: " << GET_ERROR(errno);
+        unmap_file();
+        return ConnectionResult::CONNECTION_ERROR;
+    }
+    _data = static_cast<uint8_t *>(data);
+
+    // The log is read once from start to end.
+    madvise(_data, _len, MADV_SEQUENTIAL);
+
+    return ConnectionResult::SUCCESS;
+#else
+    return ConnectionResult::NOT_IMPLEMENTED;
+#endif
+}
+
+void FileConnection::unmap_file()
+{
+#if defined(LINUX)
+    if (_data != nullptr) {
+        munmap(_data, _len);
+        _data = nullptr;
+    }
+    _len = 0;
+
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+#endif
+}
+
+void FileConnection::request_stop()
+{
+    // The replay checks this between frames.
+    _should_exit = true;
+}
+
+ConnectionResult FileConnection::stop()
+{
+    _should_exit = true;
+
+    if (_replay_thread) {
+        _replay_thread->join();
+        delete _replay_thread;
+        _replay_thread = nullptr;
+
+        VirtualClock::end_replay();
+    }
+
+    unmap_file();
+    _is_ok = false;
+
+    stop_mavlink_receiver();
+
+    return ConnectionResult::SUCCESS;
+}
+
+bool FileConnection::send_message(const mavlink_message_t &message)
+{
+    // Nobody is listening.
+    UNUSED(message);
+    return true;
+}
+
+bool FileConnection::write_buffer(const uint8_t *buffer, size_t buffer_len)
+{
+    UNUSED(buffer);
+    UNUSED(buffer_len);
+    return true;
+}
+
+void FileConnection::replay(FileConnection *parent)
+{
+    setup_thread(ThreadRole::Io, "file_replay");
+
+    TlogReader reader(parent->_data, parent->_len);
+
+    // The log time starts at the current time, so it carries on from there
+    // and never goes backwards for anyone who already looked at the clock.
+    ReplayClock &clock = parent->_parent.get_replay_clock();
+    const dl_time_t start_time = clock.now();
+    bool has_first_time = false;
+    uint64_t first_time_us = 0;
+    uint64_t last_time_us = 0;
+
+    uint64_t time_us;
+    const uint8_t *frame;
+    size_t frame_len;
+    while (!parent->_should_exit && reader.next(time_us, frame, frame_len)) {
+        if (!has_first_time) {
+            first_time_us = time_us;
+            last_time_us = time_us;
+            has_first_time = true;
+        }
+        // Logs of several links merged together can be slightly out of order.
+        if (time_us > last_time_us) {
+            last_time_us = time_us;
+        }
+        clock.set(start_time + std::chrono::microseconds(last_time_us - first_time_us));
+
+        char *datagram = reinterpret_cast<char *>(parent->_data + (frame - parent->_data));
+        parent->_mavlink_receiver->set_new_datagram(datagram, unsigned(frame_len));
+
+        while (parent->_mavlink_receiver->parse_message()) {
+            parent->receive_message(parent->_mavlink_receiver->get_last_message());
+        }
+    }
+
+    // Time goes on from the end of the log.
+    clock.clear();
+
+    if (!parent->_should_exit) {
+        LogInfo() << "Replay of " << parent->_path << " finished";
+        if (reader.num_bytes_skipped() > 0) {
+            LogWarn() << "Skipped " << reader.num_bytes_skipped() << " bytes not making up frames";
+        }
+        parent->_is_finished = true;
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include "connection.h"
+
+namespace dronecore {
+
+// Replays a telemetry log (.tlog) as fast as it can be processed, e.g. to
+// run analytics on recorded flights. The file is memory-mapped and every
+// frame is parsed right from the mapping.
+//
+// While replaying, the clock of the parent (see ReplayClock) follows the
+// timestamps of the log, so receive times, timeouts and rates of its systems
+// line up with the recording. Other DroneCore instances are not affected. What is sent is dropped. Only available
+// on Linux.
+class FileConnection : public Connection
+{
+public:
+    explicit FileConnection(DroneCoreImpl &parent, const std::string &path);
+    ~FileConnection();
+    bool is_ok() const;
+    ConnectionResult start();
+    ConnectionResult stop();
+    void request_stop() override;
+
+    bool send_message(const mavlink_message_t &message);
+
+    // True once the whole log is replayed.
+    bool is_finished() const { return _is_finished; }
+
+    // Non-copyable
+    FileConnection(const FileConnection &) = delete;
+    const FileConnection &operator=(const FileConnection &) = delete;
+
+private:
+    ConnectionResult map_file();
+    void unmap_file();
+    bool write_buffer(const uint8_t *buffer, size_t buffer_len);
+    static void replay(FileConnection *parent);
+
+    std::string _path;
+
+    int _fd {-1};
+    uint8_t *_data {nullptr};
+    size_t _len {0};
+
+    std::thread *_replay_thread {nullptr};
+    std::atomic_bool _should_exit {false};
+    std::atomic_bool _is_ok {false};
+    std::atomic_bool _is_finished {false};
+};
+
+} // namespace dronecore
@@ -0,0 +1,160 @@
+#include "file_reassembler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#if !defined(WINDOWS)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace dronecore {
+
+FileReassembler::FileReassembler() {}
+
+FileReassembler::~FileReassembler()
+{
+    close();
+}
+
+bool FileReassembler::open(const std::string &path, uint32_t size)
+{
+    close();
+
+    _size = size;
+    _received_bytes = 0;
+    _ranges.clear();
+    _write_failed = false;
+
+#if defined(WINDOWS)
+    _file = std::fopen(path.c_str(), "wb");
+    if (_file == nullptr) {
+        return false;
+    }
+    if (size > 0 && (std::fseek(_file, static_cast<long>(size - 1), SEEK_SET) != 0 ||
+                     std::fputc(0, _file) == EOF)) {
+        std::fclose(_file);
+        _file = nullptr;
+        return false;
+    }
+#else
+    _fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0) {
+        return false;
+    }
+
+    bool sized = false;
+#if defined(LINUX)
+    // Reserving the blocks on the disk means writing to the mapping can't fail later.
+    sized = (size == 0 || posix_fallocate(_fd, 0, size) == 0);
+#endif
+    if (!sized) {
+        sized = (ftruncate(_fd, static_cast<off_t>(size)) == 0);
+    }
+
+    if (sized && size > 0) {
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        _mapping = (mapping == MAP_FAILED) ? nullptr : static_cast<uint8_t *>(mapping);
+    }
+
+    if (!sized || (size > 0 && _mapping == nullptr)) {
+        ::close(_fd);
+        _fd = -1;
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool FileReassembler::close()
+{
+#if defined(WINDOWS)
+    if (_file != nullptr) {
+        if (std::fclose(_file) != 0) {
+            _write_failed = true;
+        }
+        _file = nullptr;
+    }
+#else
+    if (_mapping != nullptr) {
+        munmap(_mapping, _size);
+        _mapping = nullptr;
+    }
+    if (_fd >= 0) {
+        if (::close(_fd) != 0) {
+            _write_failed = true;
+        }
+        _fd = -1;
+    }
+#endif
+    return !_write_failed;
+}
+
+bool FileReassembler::is_open() const
+{
+#if defined(WINDOWS)
+    return _file != nullptr;
+#else
+    return _fd >= 0;
+#endif
+}
+
+uint32_t FileReassembler::add(uint32_t offset, const uint8_t *data, uint32_t len)
+{
+    if (!is_open() || offset >= _size) {
+        return 0;
+    }
+    const uint32_t end = offset + std::min(len, _size - offset);
+
+    // Merges all ranges overlapping or touching the new one into it.
+    auto it = _ranges.upper_bound(offset);
+    if (it != _ranges.begin() && std::prev(it)->second >= offset) {
+        --it;
+    }
+
+    uint32_t merged_begin = offset;
+    uint32_t merged_end = end;
+    uint32_t already_received = 0;
+    while (it != _ranges.end() && it->first <= end) {
+        const uint32_t overlap_begin = std::max(it->first, offset);
+        const uint32_t overlap_end = std::min(it->second, end);
+        if (overlap_end > overlap_begin) {
+            already_received += overlap_end - overlap_begin;
+        }
+        merged_begin = std::min(merged_begin, it->first);
+        merged_end = std::max(merged_end, it->second);
+        it = _ranges.erase(it);
+    }
+    _ranges[merged_begin] = merged_end;
+
+    const uint32_t added = (end - offset) - already_received;
+    if (added > 0) {
+        write(offset, data, end - offset);
+        _received_bytes += added;
+    }
+    return added;
+}
+
+uint32_t FileReassembler::first_missing() const
+{
+    if (_ranges.empty() || _ranges.begin()->first > 0) {
+        return 0;
+    }
+    return _ranges.begin()->second;
+}
+
+void FileReassembler::write(uint32_t offset, const uint8_t *data, uint32_t len)
+{
+#if defined(WINDOWS)
+    if (std::fseek(_file, static_cast<long>(offset), SEEK_SET) != 0 ||
+        std::fwrite(data, 1, len, _file) != len) {
+        _write_failed = true;
+    }
+#else
+    std::memcpy(_mapping + offset, data, len);
+#endif
+}
+
+} // namespace dronecore
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace dronecore {
+
+// Puts a file together from pieces which arrive in any order, possibly more
+// than once. The file is created at its full size and, where possible, mapped
+// into memory, so each piece is copied straight to its place. Which bytes
+// arrived is kept as a set of disjoint ranges.
+class FileReassembler
+{
+public:
+    FileReassembler();
+    ~FileReassembler();
+
+    // Replaces the file if it exists.
+    bool open(const std::string &path, uint32_t size);
+    // Returns false if writing the file failed.
+    bool close();
+
+    // Returns the number of bytes which were still missing, data past the end is ignored.
+    uint32_t add(uint32_t offset, const uint8_t *data, uint32_t len);
+
+    // The offset of the first byte still missing, the size if the file is complete.
+    uint32_t first_missing() const;
+
+    bool is_complete() const { return _received_bytes == _size; }
+    uint32_t size() const { return _size; }
+    uint32_t received_bytes() const { return _received_bytes; }
+
+    // Non-copyable
+    FileReassembler(const FileReassembler &) = delete;
+    const FileReassembler &operator=(const FileReassembler &) = delete;
+
+private:
+    bool is_open() const;
+    void write(uint32_t offset, const uint8_t *data, uint32_t len);
+
+    uint32_t _size {0};
+    uint32_t _received_bytes {0};
+    // Begin to end of each range received, ranges touching each other are merged.
+    std::map<uint32_t, uint32_t> _ranges {};
+    bool _write_failed {false};
+
+#if defined(WINDOWS)
+    std::FILE *_file {nullptr};
+#else
+    int _fd {-1};
+    uint8_t *_mapping {nullptr};
+#endif
+};
+
+} // namespace dronecore
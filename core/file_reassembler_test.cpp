@@ -0,0 +1,99 @@
+#include "file_reassembler.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+static const std::string PATH = "file_reassembler_test.bin";
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+class FileReassemblerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (uint32_t i = 0; i < SIZE; ++i) {
+            _data.push_back(static_cast<uint8_t>(i * 31));
+        }
+        ASSERT_TRUE(_file.open(PATH, SIZE));
+    }
+
+    void TearDown() override
+    {
+        _file.close();
+        std::remove(PATH.c_str());
+    }
+
+    uint32_t add(uint32_t offset, uint32_t len)
+    {
+        return _file.add(offset, _data.data() + offset, len);
+    }
+
+    static constexpr uint32_t SIZE = 1000;
+
+    std::vector<uint8_t> _data {};
+    FileReassembler _file {};
+};
+
+constexpr uint32_t FileReassemblerTest::SIZE;
+
+TEST_F(FileReassemblerTest, AssemblesPiecesOutOfOrder)
+{
+    EXPECT_EQ(add(500, 239), 239u);
+    EXPECT_EQ(add(0, 239), 239u);
+    EXPECT_EQ(_file.first_missing(), 239u);
+    EXPECT_EQ(add(739, 261), 261u);
+    EXPECT_EQ(add(239, 261), 261u);
+
+    EXPECT_TRUE(_file.is_complete());
+    EXPECT_EQ(_file.first_missing(), SIZE);
+    EXPECT_TRUE(_file.close());
+    EXPECT_EQ(read_file(PATH), _data);
+}
+
+TEST_F(FileReassemblerTest, CountsOverlapsOnce)
+{
+    EXPECT_EQ(add(100, 100), 100u);
+    EXPECT_EQ(add(300, 100), 100u);
+    // Covers both and the hole in between.
+    EXPECT_EQ(add(150, 200), 100u);
+    EXPECT_EQ(add(100, 300), 0u);
+    EXPECT_EQ(_file.received_bytes(), 300u);
+    EXPECT_EQ(_file.first_missing(), 0u);
+}
+
+TEST_F(FileReassemblerTest, IgnoresDataPastEnd)
+{
+    EXPECT_EQ(add(900, 100), 100u);
+    EXPECT_EQ(_file.add(SIZE, _data.data(), 10), 0u);
+    // Clipped to the size.
+    EXPECT_EQ(_file.add(950, _data.data() + 950, 200), 0u);
+    EXPECT_EQ(_file.received_bytes(), 100u);
+}
+
+TEST(FileReassembler, CreatesEmptyFile)
+{
+    FileReassembler file;
+    ASSERT_TRUE(file.open(PATH, 0));
+    EXPECT_TRUE(file.is_complete());
+    EXPECT_TRUE(file.close());
+    EXPECT_TRUE(read_file(PATH).empty());
+    std::remove(PATH.c_str());
+}
+
+TEST(FileReassembler, FailsForInvalidPath)
+{
+    FileReassembler file;
+    EXPECT_FALSE(file.open("/nonexistent/directory/file.bin", 100));
+    EXPECT_EQ(file.add(0, nullptr, 0), 0u);
+}
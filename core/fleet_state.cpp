@@ -0,0 +1,215 @@
+#include "fleet_state.h"
+#include <cmath>
+
+namespace dronecore {
+
+constexpr unsigned FleetState::MAX_SYSTEMS;
+constexpr unsigned FleetState::NUM_STREAMS;
+
+static_assert(unsigned(DroneCore::FleetStream::MODE) + 1 == FleetState::NUM_STREAMS,
+              "a stream is not counted");
+
+namespace {
+
+void clear(DroneCore::FleetState &state)
+{
+    state.system_ids.clear();
+    state.latitude_deg.clear();
+    state.longitude_deg.clear();
+    state.absolute_altitude_m.clear();
+    state.relative_altitude_m.clear();
+    state.roll_deg.clear();
+    state.pitch_deg.clear();
+    state.yaw_deg.clear();
+    state.battery_voltage_v.clear();
+    state.battery_remaining_percent.clear();
+    state.base_mode.clear();
+    state.custom_mode.clear();
+}
+
+} // namespace
+
+FleetState::FleetState()
+{
+    for (unsigned i = 0; i < MAX_SYSTEMS; ++i) {
+        _seq[i] = 0;
+        _has_position[i] = false;
+        _latitude_e7[i] = 0;
+        _longitude_e7[i] = 0;
+        _absolute_altitude_m[i] = NAN;
+        _relative_altitude_m[i] = NAN;
+        _roll_deg[i] = NAN;
+        _pitch_deg[i] = NAN;
+        _yaw_deg[i] = NAN;
+        _battery_voltage_v[i] = NAN;
+        _battery_remaining_percent[i] = NAN;
+        _base_mode[i] = 0;
+        _custom_mode[i] = 0;
+    }
+    for (auto &present : _present) {
+        present = 0;
+    }
+    for (auto &updates : _updates) {
+        for (auto &count : updates) {
+            count = 0;
+        }
+    }
+}
+
+void FleetState::begin_write(uint8_t system_id)
+{
+    // The same system can arrive on several links at once, writers take turns.
+    std::atomic<uint32_t> &seq = _seq[system_id];
+    uint32_t current = seq.load(std::memory_order_relaxed);
+    while ((current & 1) != 0 ||
+           !seq.compare_exchange_weak(current, current + 1, std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+        current = seq.load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void FleetState::end_write(uint8_t system_id, DroneCore::FleetStream stream)
+{
+    _present[system_id / 64].fetch_or(uint64_t(1) << (system_id % 64),
+                                      std::memory_order_relaxed);
+    _updates[unsigned(stream)][system_id].fetch_add(1, std::memory_order_relaxed);
+    _seq[system_id].fetch_add(1, std::memory_order_release);
+}
+
+void FleetState::set_position(uint8_t system_id, int32_t latitude_e7, int32_t longitude_e7,
+                              float absolute_altitude_m, float relative_altitude_m)
+{
+    begin_write(system_id);
+    _has_position[system_id].store(true, std::memory_order_relaxed);
+    _latitude_e7[system_id].store(latitude_e7, std::memory_order_relaxed);
+    _longitude_e7[system_id].store(longitude_e7, std::memory_order_relaxed);
+    _absolute_altitude_m[system_id].store(absolute_altitude_m, std::memory_order_relaxed);
+    _relative_altitude_m[system_id].store(relative_altitude_m, std::memory_order_relaxed);
+    end_write(system_id, DroneCore::FleetStream::POSITION);
+}
+
+void FleetState::set_attitude(uint8_t system_id, float roll_deg, float pitch_deg,
+                              float yaw_deg)
+{
+    begin_write(system_id);
+    _roll_deg[system_id].store(roll_deg, std::memory_order_relaxed);
+    _pitch_deg[system_id].store(pitch_deg, std::memory_order_relaxed);
+    _yaw_deg[system_id].store(yaw_deg, std::memory_order_relaxed);
+    end_write(system_id, DroneCore::FleetStream::ATTITUDE);
+}
+
+void FleetState::set_battery(uint8_t system_id, float voltage_v, float remaining_percent)
+{
+    begin_write(system_id);
+    _battery_voltage_v[system_id].store(voltage_v, std::memory_order_relaxed);
+    _battery_remaining_percent[system_id].store(remaining_percent, std::memory_order_relaxed);
+    end_write(system_id, DroneCore::FleetStream::BATTERY);
+}
+
+void FleetState::set_mode(uint8_t system_id, uint8_t base_mode, uint32_t custom_mode)
+{
+    begin_write(system_id);
+    _base_mode[system_id].store(base_mode, std::memory_order_relaxed);
+    _custom_mode[system_id].store(custom_mode, std::memory_order_relaxed);
+    end_write(system_id, DroneCore::FleetStream::MODE);
+}
+
+bool FleetState::is_present(unsigned system_id) const
+{
+    return (_present[system_id / 64].load(std::memory_order_relaxed) &
+            (uint64_t(1) << (system_id % 64))) != 0;
+}
+
+void FleetState::read_row(unsigned system_id, Row &row) const
+{
+    const std::atomic<uint32_t> &seq = _seq[system_id];
+    uint32_t before;
+    uint32_t after;
+    do {
+        before = seq.load(std::memory_order_acquire);
+        row.has_position = _has_position[system_id].load(std::memory_order_relaxed);
+        row.latitude_e7 = _latitude_e7[system_id].load(std::memory_order_relaxed);
+        row.longitude_e7 = _longitude_e7[system_id].load(std::memory_order_relaxed);
+        row.absolute_altitude_m = _absolute_altitude_m[system_id].load(std::memory_order_relaxed);
+        row.relative_altitude_m = _relative_altitude_m[system_id].load(std::memory_order_relaxed);
+        row.roll_deg = _roll_deg[system_id].load(std::memory_order_relaxed);
+        row.pitch_deg = _pitch_deg[system_id].load(std::memory_order_relaxed);
+        row.yaw_deg = _yaw_deg[system_id].load(std::memory_order_relaxed);
+        row.battery_voltage_v = _battery_voltage_v[system_id].load(std::memory_order_relaxed);
+        row.battery_remaining_percent =
+            _battery_remaining_percent[system_id].load(std::memory_order_relaxed);
+        row.base_mode = _base_mode[system_id].load(std::memory_order_relaxed);
+        row.custom_mode = _custom_mode[system_id].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = seq.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+}
+
+void FleetState::get(DroneCore::FleetState &state) const
+{
+    clear(state);
+
+    for (unsigned system_id = 0; system_id < MAX_SYSTEMS; ++system_id) {
+        if (is_present(system_id)) {
+            append_row(system_id, state);
+        }
+    }
+}
+
+void FleetState::get_updated(DroneCore::FleetStream stream, std::vector<uint32_t> &counters,
+                             DroneCore::FleetState &state) const
+{
+    clear(state);
+    counters.resize(MAX_SYSTEMS, 0);
+
+    // Set again while being read, it is read again next time.
+    const std::atomic<uint32_t> *updates = _updates[unsigned(stream)];
+    for (unsigned system_id = 0; system_id < MAX_SYSTEMS; ++system_id) {
+        const uint32_t count = updates[system_id].load(std::memory_order_relaxed);
+        if (count != counters[system_id]) {
+            counters[system_id] = count;
+            append_row(system_id, state);
+        }
+    }
+}
+
+void FleetState::append_row(unsigned system_id, DroneCore::FleetState &state) const
+{
+    Row row;
+    read_row(system_id, row);
+
+    state.system_ids.push_back(uint8_t(system_id));
+    state.latitude_deg.push_back(row.has_position ? double(row.latitude_e7) * 1e-7 :
+                                 double(NAN));
+    state.longitude_deg.push_back(row.has_position ? double(row.longitude_e7) * 1e-7 :
+                                  double(NAN));
+    state.absolute_altitude_m.push_back(row.absolute_altitude_m);
+    state.relative_altitude_m.push_back(row.relative_altitude_m);
+    state.roll_deg.push_back(row.roll_deg);
+    state.pitch_deg.push_back(row.pitch_deg);
+    state.yaw_deg.push_back(row.yaw_deg);
+    state.battery_voltage_v.push_back(row.battery_voltage_v);
+    state.battery_remaining_percent.push_back(row.battery_remaining_percent);
+    state.base_mode.push_back(row.base_mode);
+    state.custom_mode.push_back(row.custom_mode);
+}
+
+void FleetState::find_battery_below(float remaining_percent,
+                                    std::vector<uint8_t> &system_ids) const
+{
+    system_ids.clear();
+
+    // One field on its own needs no consistent row, so this only goes
+    // through the one column.
+    for (unsigned system_id = 0; system_id < MAX_SYSTEMS; ++system_id) {
+        // NAN, i.e. unknown, never compares below.
+        const float remaining = _battery_remaining_percent[system_id].load(
+                                    std::memory_order_relaxed);
+        if (remaining < remaining_percent) {
+            system_ids.push_back(uint8_t(system_id));
+        }
+    }
+}
+
+} // namespace dronecore
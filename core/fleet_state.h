@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "dronecore.h"
+
+namespace dronecore {
+
+// The latest state of every system ID, kept as columns of one field each so
+// that a whole fleet can be copied or scanned without going through the
+// systems and their plugins.
+//
+// Setters are called on the receive path, readers don't block them: each row
+// has a sequence number which is odd while it is written, readers copy the row
+// again if it changed meanwhile.
+class FleetState
+{
+public:
+    FleetState();
+    ~FleetState() = default;
+
+    void set_position(uint8_t system_id, int32_t latitude_e7, int32_t longitude_e7,
+                      float absolute_altitude_m, float relative_altitude_m);
+    void set_attitude(uint8_t system_id, float roll_deg, float pitch_deg, float yaw_deg);
+    void set_battery(uint8_t system_id, float voltage_v, float remaining_percent);
+    void set_mode(uint8_t system_id, uint8_t base_mode, uint32_t custom_mode);
+
+    void get(DroneCore::FleetState &state) const;
+
+    // Rows of the systems whose stream was set since the counters were taken,
+    // the counters (one per system ID, 0 to begin with) are updated.
+    void get_updated(DroneCore::FleetStream stream, std::vector<uint32_t> &counters,
+                     DroneCore::FleetState &state) const;
+
+    // Ascending system IDs with a battery level below the given one.
+    void find_battery_below(float remaining_percent, std::vector<uint8_t> &system_ids) const;
+
+    static constexpr unsigned MAX_SYSTEMS = 256;
+    static constexpr unsigned NUM_STREAMS = 4;
+
+    // Non-copyable
+    FleetState(const FleetState &) = delete;
+    const FleetState &operator=(const FleetState &) = delete;
+
+private:
+    // A consistent copy of one row.
+    struct Row {
+        bool has_position;
+        int32_t latitude_e7;
+        int32_t longitude_e7;
+        float absolute_altitude_m;
+        float relative_altitude_m;
+        float roll_deg;
+        float pitch_deg;
+        float yaw_deg;
+        float battery_voltage_v;
+        float battery_remaining_percent;
+        uint8_t base_mode;
+        uint32_t custom_mode;
+    };
+
+    void begin_write(uint8_t system_id);
+    void end_write(uint8_t system_id, DroneCore::FleetStream stream);
+    void read_row(unsigned system_id, Row &row) const;
+    void append_row(unsigned system_id, DroneCore::FleetState &state) const;
+    bool is_present(unsigned system_id) const;
+
+    std::atomic<uint32_t> _seq[MAX_SYSTEMS];
+    // Bit per system ID which has been set at all.
+    std::atomic<uint64_t> _present[MAX_SYSTEMS / 64];
+    // Times each stream of each system ID has been set.
+    std::atomic<uint32_t> _updates[NUM_STREAMS][MAX_SYSTEMS];
+
+    // Latitude and longitude are kept as received, a NAN doesn't fit in there.
+    std::atomic<bool> _has_position[MAX_SYSTEMS];
+    std::atomic<int32_t> _latitude_e7[MAX_SYSTEMS];
+    std::atomic<int32_t> _longitude_e7[MAX_SYSTEMS];
+    std::atomic<float> _absolute_altitude_m[MAX_SYSTEMS];
+    std::atomic<float> _relative_altitude_m[MAX_SYSTEMS];
+    std::atomic<float> _roll_deg[MAX_SYSTEMS];
+    std::atomic<float> _pitch_deg[MAX_SYSTEMS];
+    std::atomic<float> _yaw_deg[MAX_SYSTEMS];
+    std::atomic<float> _battery_voltage_v[MAX_SYSTEMS];
+    std::atomic<float> _battery_remaining_percent[MAX_SYSTEMS];
+    std::atomic<uint8_t> _base_mode[MAX_SYSTEMS];
+    std::atomic<uint32_t> _custom_mode[MAX_SYSTEMS];
+};
+
+} // namespace dronecore
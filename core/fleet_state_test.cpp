@@ -0,0 +1,109 @@
+#include "fleet_state.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(FleetState, OnlySystemsSeen)
+{
+    FleetState fleet_state;
+    DroneCore::FleetState state;
+
+    fleet_state.get(state);
+    EXPECT_EQ(state.system_ids.size(), 0u);
+
+    fleet_state.set_position(7, 473977418, 85455939, 488.0f, 10.0f);
+    fleet_state.set_battery(3, 12.3f, 0.5f);
+    fleet_state.get(state);
+
+    ASSERT_EQ(state.system_ids.size(), 2u);
+    EXPECT_EQ(state.system_ids[0], 3);
+    EXPECT_EQ(state.system_ids[1], 7);
+    EXPECT_TRUE(std::isnan(state.latitude_deg[0]));
+    EXPECT_FLOAT_EQ(state.battery_remaining_percent[0], 0.5f);
+    EXPECT_NEAR(state.latitude_deg[1], 47.3977418, 1e-9);
+    EXPECT_NEAR(state.longitude_deg[1], 8.5455939, 1e-9);
+    EXPECT_FLOAT_EQ(state.relative_altitude_m[1], 10.0f);
+    EXPECT_TRUE(std::isnan(state.battery_remaining_percent[1]));
+    EXPECT_EQ(state.custom_mode[1], 0u);
+}
+
+TEST(FleetState, FindsLowBattery)
+{
+    FleetState fleet_state;
+    for (unsigned i = 1; i <= 200; ++i) {
+        fleet_state.set_battery(uint8_t(i), 12.0f, float(i % 100) / 100.0f);
+    }
+    // No battery level known.
+    fleet_state.set_mode(250, 0, 0);
+
+    std::vector<uint8_t> system_ids;
+    fleet_state.find_battery_below(0.195f, system_ids);
+
+    // 1 to 19, 100 to 119 and 200.
+    ASSERT_EQ(system_ids.size(), 40u);
+    EXPECT_EQ(system_ids.front(), 1);
+    EXPECT_EQ(system_ids[19], 100);
+    EXPECT_EQ(system_ids.back(), 200);
+}
+
+TEST(FleetState, OnlySystemsUpdated)
+{
+    FleetState fleet_state;
+    std::vector<uint32_t> counters;
+    DroneCore::FleetState state;
+
+    fleet_state.set_position(7, 473977418, 85455939, 488.0f, 10.0f);
+    fleet_state.set_position(7, 473977419, 85455939, 489.0f, 11.0f);
+    fleet_state.set_position(3, 0, 0, 0.0f, 0.0f);
+    fleet_state.set_battery(5, 12.3f, 0.5f);
+
+    // Everything so far, and only the latest of each.
+    fleet_state.get_updated(DroneCore::FleetStream::POSITION, counters, state);
+    ASSERT_EQ(state.system_ids.size(), 2u);
+    EXPECT_EQ(state.system_ids[0], 3);
+    EXPECT_EQ(state.system_ids[1], 7);
+    EXPECT_FLOAT_EQ(state.absolute_altitude_m[1], 489.0f);
+
+    fleet_state.get_updated(DroneCore::FleetStream::POSITION, counters, state);
+    EXPECT_EQ(state.system_ids.size(), 0u);
+
+    // Other streams don't count.
+    fleet_state.set_battery(7, 12.0f, 0.4f);
+    fleet_state.set_position(3, 1, 1, 0.0f, 0.0f);
+    fleet_state.get_updated(DroneCore::FleetStream::POSITION, counters, state);
+    ASSERT_EQ(state.system_ids.size(), 1u);
+    EXPECT_EQ(state.system_ids[0], 3);
+
+    std::vector<uint32_t> battery_counters;
+    fleet_state.get_updated(DroneCore::FleetStream::BATTERY, battery_counters, state);
+    ASSERT_EQ(state.system_ids.size(), 2u);
+    EXPECT_EQ(state.system_ids[0], 5);
+    EXPECT_FLOAT_EQ(state.battery_remaining_percent[1], 0.4f);
+}
+
+TEST(FleetState, RowsStayConsistent)
+{
+    FleetState fleet_state;
+    std::atomic<bool> should_exit {false};
+
+    // Latitude and longitude are always written as the same value.
+    std::thread writer([&]() {
+        for (int32_t i = 0; !should_exit; ++i) {
+            fleet_state.set_position(1, i, i, 0.0f, float(i % 1000));
+        }
+    });
+
+    DroneCore::FleetState state;
+    for (int i = 0; i < 10000; ++i) {
+        fleet_state.get(state);
+        if (state.system_ids.size() == 1) {
+            ASSERT_EQ(state.latitude_deg[0], state.longitude_deg[0]);
+        }
+    }
+
+    should_exit = true;
+    writer.join();
+}
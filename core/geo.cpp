@@ -0,0 +1,315 @@
+#include "geo.h"
+#include "global_include.h"
+#include <cmath>
+
+namespace dronecore {
+
+static constexpr double DEG_TO_RAD = M_PI / 180.0;
+static constexpr double RAD_TO_DEG = 180.0 / M_PI;
+
+static constexpr double WGS84_SEMI_MINOR_AXIS_M = WGS84_SEMI_MAJOR_AXIS_M *
+                                                  (1.0 - WGS84_FLATTENING);
+// First and second eccentricity squared.
+static constexpr double WGS84_E2 = WGS84_FLATTENING * (2.0 - WGS84_FLATTENING);
+static constexpr double WGS84_EP2 = WGS84_E2 / (1.0 - WGS84_E2);
+
+// Vincenty converges within a few iterations unless nearly antipodal.
+static constexpr unsigned VINCENTY_MAX_ITERATIONS = 200;
+static constexpr double VINCENTY_TOLERANCE = 1e-12;
+
+// The single and batch versions share these, inlined into the batch loops so
+// that they stay vectorizable.
+
+static inline void ecef_from_geodetic(double latitude_deg, double longitude_deg,
+                                      double altitude_m,
+                                      double &x_m, double &y_m, double &z_m)
+{
+    const double sin_latitude = std::sin(latitude_deg * DEG_TO_RAD);
+    const double cos_latitude = std::cos(latitude_deg * DEG_TO_RAD);
+    const double sin_longitude = std::sin(longitude_deg * DEG_TO_RAD);
+    const double cos_longitude = std::cos(longitude_deg * DEG_TO_RAD);
+
+    // Radius of curvature in the prime vertical.
+    const double n_m = WGS84_SEMI_MAJOR_AXIS_M /
+                       std::sqrt(1.0 - WGS84_E2 * sin_latitude * sin_latitude);
+
+    x_m = (n_m + altitude_m) * cos_latitude * cos_longitude;
+    y_m = (n_m + altitude_m) * cos_latitude * sin_longitude;
+    z_m = (n_m * (1.0 - WGS84_E2) + altitude_m) * sin_latitude;
+}
+
+static inline void geodetic_from_ecef(double x_m, double y_m, double z_m,
+                                      double &latitude_deg, double &longitude_deg,
+                                      double &altitude_m)
+{
+    const double p_m = std::sqrt(x_m * x_m + y_m * y_m);
+    const double theta = std::atan2(z_m * WGS84_SEMI_MAJOR_AXIS_M,
+                                    p_m * WGS84_SEMI_MINOR_AXIS_M);
+    const double sin_theta = std::sin(theta);
+    const double cos_theta = std::cos(theta);
+
+    const double latitude = std::atan2(
+                                z_m + WGS84_EP2 * WGS84_SEMI_MINOR_AXIS_M *
+                                sin_theta * sin_theta * sin_theta,
+                                p_m - WGS84_E2 * WGS84_SEMI_MAJOR_AXIS_M *
+                                cos_theta * cos_theta * cos_theta);
+    const double sin_latitude = std::sin(latitude);
+    const double cos_latitude = std::cos(latitude);
+
+    latitude_deg = latitude * RAD_TO_DEG;
+    longitude_deg = std::atan2(y_m, x_m) * RAD_TO_DEG;
+    // Unlike p / cos(latitude) - N, this also works at the poles.
+    altitude_m = p_m * cos_latitude + z_m * sin_latitude -
+                 WGS84_SEMI_MAJOR_AXIS_M *
+                 std::sqrt(1.0 - WGS84_E2 * sin_latitude * sin_latitude);
+}
+
+static inline double haversine(double latitude_1_deg, double longitude_1_deg,
+                               double latitude_2_deg, double longitude_2_deg)
+{
+    const double sin_d_latitude_2 = std::sin((latitude_2_deg - latitude_1_deg) *
+                                             (DEG_TO_RAD / 2.0));
+    const double sin_d_longitude_2 = std::sin((longitude_2_deg - longitude_1_deg) *
+                                              (DEG_TO_RAD / 2.0));
+    const double a = sin_d_latitude_2 * sin_d_latitude_2 +
+                     std::cos(latitude_1_deg * DEG_TO_RAD) *
+                     std::cos(latitude_2_deg * DEG_TO_RAD) *
+                     sin_d_longitude_2 * sin_d_longitude_2;
+    // atan2 instead of asin, which would need a to be clamped to 1.
+    return 2.0 * EARTH_RADIUS_M * std::atan2(std::sqrt(a), std::sqrt(1.0 - a));
+}
+
+static inline double bearing(double latitude_1_deg, double longitude_1_deg,
+                             double latitude_2_deg, double longitude_2_deg)
+{
+    const double latitude_1 = latitude_1_deg * DEG_TO_RAD;
+    const double latitude_2 = latitude_2_deg * DEG_TO_RAD;
+    const double d_longitude = (longitude_2_deg - longitude_1_deg) * DEG_TO_RAD;
+
+    const double bearing_deg = std::atan2(
+                                   std::sin(d_longitude) * std::cos(latitude_2),
+                                   std::cos(latitude_1) * std::sin(latitude_2) -
+                                   std::sin(latitude_1) * std::cos(latitude_2) *
+                                   std::cos(d_longitude)) * RAD_TO_DEG;
+    return std::fmod(bearing_deg + 360.0, 360.0);
+}
+
+void to_ecef_from_geodetic(double latitude_deg, double longitude_deg, double altitude_m,
+                           double &x_m, double &y_m, double &z_m)
+{
+    ecef_from_geodetic(latitude_deg, longitude_deg, altitude_m, x_m, y_m, z_m);
+}
+
+void to_ecef_from_geodetic(const double *latitude_deg, const double *longitude_deg,
+                           const double *altitude_m, size_t count,
+                           double *x_m, double *y_m, double *z_m)
+{
+    for (size_t i = 0; i < count; ++i) {
+        ecef_from_geodetic(latitude_deg[i], longitude_deg[i], altitude_m[i],
+                           x_m[i], y_m[i], z_m[i]);
+    }
+}
+
+void to_geodetic_from_ecef(double x_m, double y_m, double z_m,
+                           double &latitude_deg, double &longitude_deg, double &altitude_m)
+{
+    geodetic_from_ecef(x_m, y_m, z_m, latitude_deg, longitude_deg, altitude_m);
+}
+
+void to_geodetic_from_ecef(const double *x_m, const double *y_m, const double *z_m,
+                           size_t count,
+                           double *latitude_deg, double *longitude_deg, double *altitude_m)
+{
+    for (size_t i = 0; i < count; ++i) {
+        geodetic_from_ecef(x_m[i], y_m[i], z_m[i],
+                           latitude_deg[i], longitude_deg[i], altitude_m[i]);
+    }
+}
+
+EnuFrame::EnuFrame(double latitude_origin_deg, double longitude_origin_deg,
+                   double altitude_origin_m) :
+    _sin_latitude(std::sin(to_rad_from_deg(latitude_origin_deg))),
+    _cos_latitude(std::cos(to_rad_from_deg(latitude_origin_deg))),
+    _sin_longitude(std::sin(to_rad_from_deg(longitude_origin_deg))),
+    _cos_longitude(std::cos(to_rad_from_deg(longitude_origin_deg)))
+{
+    ecef_from_geodetic(latitude_origin_deg, longitude_origin_deg, altitude_origin_m,
+                       _x_origin_m, _y_origin_m, _z_origin_m);
+}
+
+void EnuFrame::to_enu(double latitude_deg, double longitude_deg, double altitude_m,
+                      double &east_m, double &north_m, double &up_m) const
+{
+    to_enu(&latitude_deg, &longitude_deg, &altitude_m, 1, &east_m, &north_m, &up_m);
+}
+
+void EnuFrame::to_enu(const double *latitude_deg, const double *longitude_deg,
+                      const double *altitude_m, size_t count,
+                      double *east_m, double *north_m, double *up_m) const
+{
+    for (size_t i = 0; i < count; ++i) {
+        double x_m, y_m, z_m;
+        ecef_from_geodetic(latitude_deg[i], longitude_deg[i], altitude_m[i], x_m, y_m, z_m);
+        const double dx_m = x_m - _x_origin_m;
+        const double dy_m = y_m - _y_origin_m;
+        const double dz_m = z_m - _z_origin_m;
+
+        east_m[i] = -_sin_longitude * dx_m + _cos_longitude * dy_m;
+        north_m[i] = -_sin_latitude * _cos_longitude * dx_m -
+                     _sin_latitude * _sin_longitude * dy_m + _cos_latitude * dz_m;
+        up_m[i] = _cos_latitude * _cos_longitude * dx_m +
+                  _cos_latitude * _sin_longitude * dy_m + _sin_latitude * dz_m;
+    }
+}
+
+void EnuFrame::to_geodetic(double east_m, double north_m, double up_m,
+                           double &latitude_deg, double &longitude_deg, double &altitude_m) const
+{
+    to_geodetic(&east_m, &north_m, &up_m, 1, &latitude_deg, &longitude_deg, &altitude_m);
+}
+
+void EnuFrame::to_geodetic(const double *east_m, const double *north_m, const double *up_m,
+                           size_t count,
+                           double *latitude_deg, double *longitude_deg, double *altitude_m) const
+{
+    for (size_t i = 0; i < count; ++i) {
+        // The rotation transposed.
+        const double x_m = _x_origin_m - _sin_longitude * east_m[i] -
+                           _sin_latitude * _cos_longitude * north_m[i] +
+                           _cos_latitude * _cos_longitude * up_m[i];
+        const double y_m = _y_origin_m + _cos_longitude * east_m[i] -
+                           _sin_latitude * _sin_longitude * north_m[i] +
+                           _cos_latitude * _sin_longitude * up_m[i];
+        const double z_m = _z_origin_m + _cos_latitude * north_m[i] + _sin_latitude * up_m[i];
+
+        geodetic_from_ecef(x_m, y_m, z_m, latitude_deg[i], longitude_deg[i], altitude_m[i]);
+    }
+}
+
+FlatProjection::FlatProjection(double latitude_origin_deg, double longitude_origin_deg) :
+    _latitude_origin_deg(latitude_origin_deg),
+    _longitude_origin_deg(longitude_origin_deg),
+    _cos_latitude_origin(std::cos(to_rad_from_deg(latitude_origin_deg)))
+{
+}
+
+void FlatProjection::to_local(double latitude_deg, double longitude_deg,
+                              double &north_m, double &east_m) const
+{
+    double d_longitude_deg = longitude_deg - _longitude_origin_deg;
+    if (d_longitude_deg > 180.0) {
+        d_longitude_deg -= 360.0;
+    } else if (d_longitude_deg < -180.0) {
+        d_longitude_deg += 360.0;
+    }
+
+    north_m = to_rad_from_deg(latitude_deg - _latitude_origin_deg) * EARTH_RADIUS_M;
+    east_m = to_rad_from_deg(d_longitude_deg) * EARTH_RADIUS_M * _cos_latitude_origin;
+}
+
+void FlatProjection::to_global(double north_m, double east_m,
+                               double &latitude_deg, double &longitude_deg) const
+{
+    latitude_deg = _latitude_origin_deg + to_deg_from_rad(north_m / EARTH_RADIUS_M);
+    longitude_deg = _longitude_origin_deg +
+                    to_deg_from_rad(east_m / (EARTH_RADIUS_M * _cos_latitude_origin));
+    if (longitude_deg > 180.0) {
+        longitude_deg -= 360.0;
+    } else if (longitude_deg < -180.0) {
+        longitude_deg += 360.0;
+    }
+}
+
+double haversine_distance_m(double latitude_1_deg, double longitude_1_deg,
+                            double latitude_2_deg, double longitude_2_deg)
+{
+    return haversine(latitude_1_deg, longitude_1_deg, latitude_2_deg, longitude_2_deg);
+}
+
+void haversine_distances_m(double latitude_deg, double longitude_deg,
+                           const double *latitudes_deg, const double *longitudes_deg,
+                           size_t count, double *distances_m)
+{
+    for (size_t i = 0; i < count; ++i) {
+        distances_m[i] = haversine(latitude_deg, longitude_deg,
+                                   latitudes_deg[i], longitudes_deg[i]);
+    }
+}
+
+double vincenty_distance_m(double latitude_1_deg, double longitude_1_deg,
+                           double latitude_2_deg, double longitude_2_deg)
+{
+    // Reduced latitudes.
+    const double u_1 = std::atan((1.0 - WGS84_FLATTENING) *
+                                 std::tan(to_rad_from_deg(latitude_1_deg)));
+    const double u_2 = std::atan((1.0 - WGS84_FLATTENING) *
+                                 std::tan(to_rad_from_deg(latitude_2_deg)));
+    const double sin_u_1 = std::sin(u_1);
+    const double cos_u_1 = std::cos(u_1);
+    const double sin_u_2 = std::sin(u_2);
+    const double cos_u_2 = std::cos(u_2);
+    const double l = to_rad_from_deg(longitude_2_deg - longitude_1_deg);
+
+    double lambda = l;
+    for (unsigned i = 0; i < VINCENTY_MAX_ITERATIONS; ++i) {
+        const double sin_lambda = std::sin(lambda);
+        const double cos_lambda = std::cos(lambda);
+        const double sin_sigma = std::sqrt(
+                                     (cos_u_2 * sin_lambda) * (cos_u_2 * sin_lambda) +
+                                     (cos_u_1 * sin_u_2 - sin_u_1 * cos_u_2 * cos_lambda) *
+                                     (cos_u_1 * sin_u_2 - sin_u_1 * cos_u_2 * cos_lambda));
+        if (sin_sigma == 0.0) {
+            // Same position.
+            return 0.0;
+        }
+        const double cos_sigma = sin_u_1 * sin_u_2 + cos_u_1 * cos_u_2 * cos_lambda;
+        const double sigma = std::atan2(sin_sigma, cos_sigma);
+        const double sin_alpha = cos_u_1 * cos_u_2 * sin_lambda / sin_sigma;
+        const double cos2_alpha = 1.0 - sin_alpha * sin_alpha;
+        // On the equator cos2_alpha is 0, and so is this term.
+        const double cos_2_sigma_m = (cos2_alpha != 0.0) ?
+                                     cos_sigma - 2.0 * sin_u_1 * sin_u_2 / cos2_alpha : 0.0;
+        const double c = WGS84_FLATTENING / 16.0 * cos2_alpha *
+                         (4.0 + WGS84_FLATTENING * (4.0 - 3.0 * cos2_alpha));
+
+        const double previous_lambda = lambda;
+        lambda = l + (1.0 - c) * WGS84_FLATTENING * sin_alpha *
+                 (sigma + c * sin_sigma *
+                  (cos_2_sigma_m + c * cos_sigma *
+                   (-1.0 + 2.0 * cos_2_sigma_m * cos_2_sigma_m)));
+
+        if (std::fabs(lambda - previous_lambda) < VINCENTY_TOLERANCE) {
+            const double u2 = cos2_alpha * WGS84_EP2;
+            const double a = 1.0 + u2 / 16384.0 *
+                             (4096.0 + u2 * (-768.0 + u2 * (320.0 - 175.0 * u2)));
+            const double b = u2 / 1024.0 * (256.0 + u2 * (-128.0 + u2 * (74.0 - 47.0 * u2)));
+            const double d_sigma = b * sin_sigma *
+                                   (cos_2_sigma_m + b / 4.0 *
+                                    (cos_sigma * (-1.0 + 2.0 * cos_2_sigma_m * cos_2_sigma_m) -
+                                     b / 6.0 * cos_2_sigma_m *
+                                     (-3.0 + 4.0 * sin_sigma * sin_sigma) *
+                                     (-3.0 + 4.0 * cos_2_sigma_m * cos_2_sigma_m)));
+            return WGS84_SEMI_MINOR_AXIS_M * a * (sigma - d_sigma);
+        }
+    }
+
+    return double(NAN);
+}
+
+double initial_bearing_deg(double latitude_1_deg, double longitude_1_deg,
+                           double latitude_2_deg, double longitude_2_deg)
+{
+    return bearing(latitude_1_deg, longitude_1_deg, latitude_2_deg, longitude_2_deg);
+}
+
+void initial_bearings_deg(double latitude_deg, double longitude_deg,
+                          const double *latitudes_deg, const double *longitudes_deg,
+                          size_t count, double *bearings_deg)
+{
+    for (size_t i = 0; i < count; ++i) {
+        bearings_deg[i] = bearing(latitude_deg, longitude_deg,
+                                  latitudes_deg[i], longitudes_deg[i]);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+
+namespace dronecore {
+
+// Conversions between geodetic positions (latitude, longitude, altitude above
+// the WGS84 ellipsoid) and metric frames, and distances between positions.
+//
+// The batch versions take positions stored field by field (struct of arrays)
+// and give the same results as the single ones. Their loops don't branch per
+// position, so the compiler can vectorize them where it has vector versions
+// of the math functions.
+
+constexpr double WGS84_SEMI_MAJOR_AXIS_M = 6378137.0;
+constexpr double WGS84_FLATTENING = 1.0 / 298.257223563;
+// Mean earth radius, for the spherical approximations.
+constexpr double EARTH_RADIUS_M = 6371000.0;
+
+// Earth-centered, earth-fixed.
+void to_ecef_from_geodetic(double latitude_deg, double longitude_deg, double altitude_m,
+                           double &x_m, double &y_m, double &z_m);
+void to_ecef_from_geodetic(const double *latitude_deg, const double *longitude_deg,
+                           const double *altitude_m, size_t count,
+                           double *x_m, double *y_m, double *z_m);
+
+// Bowring's method without iterating, below a millimeter up to tens of kilometers
+// above the ellipsoid.
+void to_geodetic_from_ecef(double x_m, double y_m, double z_m,
+                           double &latitude_deg, double &longitude_deg, double &altitude_m);
+void to_geodetic_from_ecef(const double *x_m, const double *y_m, const double *z_m,
+                           size_t count,
+                           double *latitude_deg, double *longitude_deg, double *altitude_m);
+
+// East, north, up around an origin, exact on the ellipsoid.
+class EnuFrame
+{
+public:
+    EnuFrame() = default;
+    EnuFrame(double latitude_origin_deg, double longitude_origin_deg, double altitude_origin_m);
+
+    void to_enu(double latitude_deg, double longitude_deg, double altitude_m,
+                double &east_m, double &north_m, double &up_m) const;
+    void to_enu(const double *latitude_deg, const double *longitude_deg,
+                const double *altitude_m, size_t count,
+                double *east_m, double *north_m, double *up_m) const;
+
+    void to_geodetic(double east_m, double north_m, double up_m,
+                     double &latitude_deg, double &longitude_deg, double &altitude_m) const;
+    void to_geodetic(const double *east_m, const double *north_m, const double *up_m,
+                     size_t count,
+                     double *latitude_deg, double *longitude_deg, double *altitude_m) const;
+
+private:
+    double _sin_latitude {0.0};
+    double _cos_latitude {1.0};
+    double _sin_longitude {0.0};
+    double _cos_longitude {0.0};
+    double _x_origin_m {WGS84_SEMI_MAJOR_AXIS_M};
+    double _y_origin_m {0.0};
+    double _z_origin_m {0.0};
+};
+
+// Equirectangular north and east around an origin on a sphere: cheap, and good
+// enough within a few kilometers, e.g. for a survey area or a target moving.
+class FlatProjection
+{
+public:
+    FlatProjection() = default;
+    FlatProjection(double latitude_origin_deg, double longitude_origin_deg);
+
+    // Longitudes are taken the short way around, across the antimeridian.
+    void to_local(double latitude_deg, double longitude_deg,
+                  double &north_m, double &east_m) const;
+    void to_global(double north_m, double east_m,
+                   double &latitude_deg, double &longitude_deg) const;
+
+private:
+    double _latitude_origin_deg {0.0};
+    double _longitude_origin_deg {0.0};
+    double _cos_latitude_origin {1.0};
+};
+
+// Great circle distance on the mean sphere, within about 0.5 % of the ellipsoid.
+double haversine_distance_m(double latitude_1_deg, double longitude_1_deg,
+                            double latitude_2_deg, double longitude_2_deg);
+// From one position to each of many.
+void haversine_distances_m(double latitude_deg, double longitude_deg,
+                           const double *latitudes_deg, const double *longitudes_deg,
+                           size_t count, double *distances_m);
+
+// Distance on the ellipsoid, to below a millimeter. Iterates, so there is no
+// batch version. NAN for nearly antipodal positions where it doesn't converge.
+double vincenty_distance_m(double latitude_1_deg, double longitude_1_deg,
+                           double latitude_2_deg, double longitude_2_deg);
+
+// Initial bearing of the great circle from the first to the second position,
+// clockwise from north (range: 0 to 360).
+double initial_bearing_deg(double latitude_1_deg, double longitude_1_deg,
+                           double latitude_2_deg, double longitude_2_deg);
+// From one position to each of many.
+void initial_bearings_deg(double latitude_deg, double longitude_deg,
+                          const double *latitudes_deg, const double *longitudes_deg,
+                          size_t count, double *bearings_deg);
+
+} // namespace dronecore
@@ -0,0 +1,147 @@
+#include "geo.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(Geo, EcefOfKnownPositions)
+{
+    double x_m, y_m, z_m;
+    to_ecef_from_geodetic(0.0, 0.0, 0.0, x_m, y_m, z_m);
+    EXPECT_NEAR(x_m, WGS84_SEMI_MAJOR_AXIS_M, 1e-6);
+    EXPECT_NEAR(y_m, 0.0, 1e-6);
+    EXPECT_NEAR(z_m, 0.0, 1e-6);
+
+    to_ecef_from_geodetic(90.0, 0.0, 100.0, x_m, y_m, z_m);
+    EXPECT_NEAR(x_m, 0.0, 1e-6);
+    EXPECT_NEAR(z_m, 6356752.314245 + 100.0, 1e-5);
+}
+
+TEST(Geo, EcefRoundTrip)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> latitude_deg(-90.0, 90.0);
+    std::uniform_real_distribution<double> longitude_deg(-180.0, 180.0);
+    std::uniform_real_distribution<double> altitude_m(-500.0, 20000.0);
+
+    for (unsigned i = 0; i < 1000; ++i) {
+        const double latitude = latitude_deg(random);
+        const double longitude = longitude_deg(random);
+        const double altitude = altitude_m(random);
+
+        double x_m, y_m, z_m;
+        to_ecef_from_geodetic(latitude, longitude, altitude, x_m, y_m, z_m);
+        double latitude_back, longitude_back, altitude_back;
+        to_geodetic_from_ecef(x_m, y_m, z_m, latitude_back, longitude_back, altitude_back);
+
+        EXPECT_NEAR(latitude_back, latitude, 1e-8);
+        EXPECT_NEAR(longitude_back, longitude, 1e-8);
+        EXPECT_NEAR(altitude_back, altitude, 1e-3);
+    }
+}
+
+TEST(Geo, BatchSameAsSingle)
+{
+    std::mt19937 random(2);
+    std::uniform_real_distribution<double> offset_deg(-0.1, 0.1);
+    std::uniform_real_distribution<double> altitude_m(0.0, 500.0);
+
+    const size_t count = 37;
+    std::vector<double> latitude(count), longitude(count), altitude(count);
+    for (size_t i = 0; i < count; ++i) {
+        latitude[i] = 47.3977 + offset_deg(random);
+        longitude[i] = 8.5456 + offset_deg(random);
+        altitude[i] = altitude_m(random);
+    }
+
+    const EnuFrame frame(47.3977, 8.5456, 488.0);
+    std::vector<double> east(count), north(count), up(count);
+    frame.to_enu(latitude.data(), longitude.data(), altitude.data(), count,
+                 east.data(), north.data(), up.data());
+    std::vector<double> distances(count), bearings(count);
+    haversine_distances_m(47.3977, 8.5456, latitude.data(), longitude.data(), count,
+                          distances.data());
+    initial_bearings_deg(47.3977, 8.5456, latitude.data(), longitude.data(), count,
+                         bearings.data());
+
+    for (size_t i = 0; i < count; ++i) {
+        double east_m, north_m, up_m;
+        frame.to_enu(latitude[i], longitude[i], altitude[i], east_m, north_m, up_m);
+        EXPECT_DOUBLE_EQ(east[i], east_m);
+        EXPECT_DOUBLE_EQ(north[i], north_m);
+        EXPECT_DOUBLE_EQ(up[i], up_m);
+        EXPECT_DOUBLE_EQ(distances[i],
+                         haversine_distance_m(47.3977, 8.5456, latitude[i], longitude[i]));
+        EXPECT_DOUBLE_EQ(bearings[i],
+                         initial_bearing_deg(47.3977, 8.5456, latitude[i], longitude[i]));
+    }
+}
+
+TEST(Geo, EnuAxesAndRoundTrip)
+{
+    const EnuFrame frame(47.3977, 8.5456, 488.0);
+
+    double east_m, north_m, up_m;
+    frame.to_enu(47.3977, 8.5456, 588.0, east_m, north_m, up_m);
+    EXPECT_NEAR(east_m, 0.0, 1e-6);
+    EXPECT_NEAR(north_m, 0.0, 1e-6);
+    EXPECT_NEAR(up_m, 100.0, 1e-6);
+
+    frame.to_enu(47.4077, 8.5456, 488.0, east_m, north_m, up_m);
+    EXPECT_NEAR(east_m, 0.0, 1e-6);
+    EXPECT_NEAR(north_m, 1111.9, 1.0);
+    // The earth curving away below.
+    EXPECT_LT(up_m, 0.0);
+
+    double latitude_deg, longitude_deg, altitude_m;
+    frame.to_geodetic(120.0, -340.0, 25.0, latitude_deg, longitude_deg, altitude_m);
+    frame.to_enu(latitude_deg, longitude_deg, altitude_m, east_m, north_m, up_m);
+    EXPECT_NEAR(east_m, 120.0, 1e-6);
+    EXPECT_NEAR(north_m, -340.0, 1e-6);
+    EXPECT_NEAR(up_m, 25.0, 1e-6);
+}
+
+TEST(Geo, FlatProjectionAcrossAntimeridian)
+{
+    const FlatProjection projection(-16.5, 179.999);
+
+    double north_m, east_m;
+    projection.to_local(-16.5, -179.999, north_m, east_m);
+    EXPECT_NEAR(north_m, 0.0, 1e-9);
+    EXPECT_NEAR(east_m, 213.2, 0.1);
+
+    double latitude_deg, longitude_deg;
+    projection.to_global(north_m, east_m, latitude_deg, longitude_deg);
+    EXPECT_NEAR(latitude_deg, -16.5, 1e-9);
+    EXPECT_NEAR(longitude_deg, -179.999, 1e-9);
+}
+
+TEST(Geo, Distances)
+{
+    // One degree along the equator and a meridian.
+    EXPECT_NEAR(haversine_distance_m(0.0, 0.0, 0.0, 1.0), 111194.9, 0.1);
+    EXPECT_NEAR(haversine_distance_m(0.0, 0.0, 1.0, 0.0), 111194.9, 0.1);
+    EXPECT_DOUBLE_EQ(haversine_distance_m(47.3977, 8.5456, 47.3977, 8.5456), 0.0);
+
+    // Flinders Peak to Buninyong, the example of Vincenty's paper.
+    const double latitude_1_deg = -(37.0 + 57.0 / 60.0 + 3.72030 / 3600.0);
+    const double longitude_1_deg = 144.0 + 25.0 / 60.0 + 29.52440 / 3600.0;
+    const double latitude_2_deg = -(37.0 + 39.0 / 60.0 + 10.15610 / 3600.0);
+    const double longitude_2_deg = 143.0 + 55.0 / 60.0 + 35.38390 / 3600.0;
+    EXPECT_NEAR(vincenty_distance_m(latitude_1_deg, longitude_1_deg,
+                                    latitude_2_deg, longitude_2_deg), 54972.271, 1e-3);
+    EXPECT_DOUBLE_EQ(vincenty_distance_m(10.0, 20.0, 10.0, 20.0), 0.0);
+    EXPECT_NEAR(vincenty_distance_m(0.0, 0.0, 0.0, 1.0), 111319.491, 1e-3);
+
+    EXPECT_TRUE(std::isnan(vincenty_distance_m(0.0, 0.0, 0.5, 179.7)));
+}
+
+TEST(Geo, Bearings)
+{
+    EXPECT_NEAR(initial_bearing_deg(0.0, 0.0, 1.0, 0.0), 0.0, 1e-9);
+    EXPECT_NEAR(initial_bearing_deg(0.0, 0.0, 0.0, 1.0), 90.0, 1e-9);
+    EXPECT_NEAR(initial_bearing_deg(0.0, 0.0, -1.0, 0.0), 180.0, 1e-9);
+    EXPECT_NEAR(initial_bearing_deg(0.0, 0.0, 0.0, -1.0), 270.0, 1e-9);
+}
@@ -1,4 +1,5 @@
 #include "global_include.h"
+#include "virtual_clock.h"
 
 #include <cfloat>
 #include <cstdint>
@@ -8,14 +9,63 @@ namespace dronecore {
 
 using std::chrono::steady_clock;
 
+// 0 means not set, the steady clock never starts at 0.
+static std::atomic<dl_time_t::rep> virtual_time_ticks {0};
+
+void ReplayClock::set(dl_time_t time)
+{
+    _ticks.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void ReplayClock::clear()
+{
+    const dl_time_t::rep ticks = _ticks.load(std::memory_order_relaxed);
+    if (ticks == 0) {
+        return;
+    }
+    // A log replays faster than real time, so it usually ended up ahead.
+    const dl_time_t::rep ahead = ticks - steady_clock::now().time_since_epoch().count();
+    if (ahead > _offset.load(std::memory_order_relaxed)) {
+        _offset.store(ahead, std::memory_order_relaxed);
+    }
+    _ticks.store(0, std::memory_order_relaxed);
+}
+
+dl_time_t ReplayClock::now() const
+{
+    const dl_time_t::rep ticks = _ticks.load(std::memory_order_relaxed);
+    if (ticks != 0) {
+        return dl_time_t(dl_time_t::duration(ticks));
+    }
+    return steady_clock::now() + dl_time_t::duration(_offset.load(std::memory_order_relaxed));
+}
+
 Time::Time() {}
+Time::Time(const ReplayClock &clock) : _clock(&clock) {}
 Time::~Time() {}
 
 dl_time_t Time::steady_time()
 {
+    const dl_time_t::rep ticks = virtual_time_ticks.load(std::memory_order_relaxed);
+    if (ticks != 0) {
+        return dl_time_t(dl_time_t::duration(ticks));
+    }
+    if (_clock != nullptr) {
+        return _clock->now();
+    }
     return steady_clock::now();
 }
 
+void Time::set_virtual_time(dl_time_t time)
+{
+    virtual_time_ticks.store(time.time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void Time::clear_virtual_time()
+{
+    virtual_time_ticks.store(0, std::memory_order_relaxed);
+}
+
 double Time::elapsed_s()
 {
     auto now = steady_time().time_since_epoch();
@@ -45,32 +95,42 @@ void Time::shift_steady_time_by(dl_time_t &time, double offset_s)
 
 void Time::sleep_for(std::chrono::hours h)
 {
-    std::this_thread::sleep_for(h);
+    sleep(h);
 }
 
 void Time::sleep_for(std::chrono::minutes m)
 {
-    std::this_thread::sleep_for(m);
+    sleep(m);
 }
 
 void Time::sleep_for(std::chrono::seconds s)
 {
-    std::this_thread::sleep_for(s);
+    sleep(s);
 }
 
 void Time::sleep_for(std::chrono::milliseconds ms)
 {
-    std::this_thread::sleep_for(ms);
+    sleep(ms);
 }
 
 void Time::sleep_for(std::chrono::microseconds us)
 {
-    std::this_thread::sleep_for(us);
+    sleep(us);
 }
 
 void Time::sleep_for(std::chrono::nanoseconds ns)
 {
-    std::this_thread::sleep_for(ns);
+    sleep(ns);
+}
+
+void Time::sleep(std::chrono::nanoseconds duration)
+{
+    if (VirtualClock::is_enabled()) {
+        VirtualClock::sleep_until(steady_time() +
+                                  std::chrono::duration_cast<dl_time_t::duration>(duration));
+        return;
+    }
+    std::this_thread::sleep_for(duration);
 }
 
 
@@ -2,6 +2,7 @@
 
 #define UNUSED(x) (void)(x)
 
+#include <atomic>
 #include <chrono>
 #include <thread>
 
@@ -33,10 +34,37 @@ namespace dronecore {
 
 typedef std::chrono::time_point<std::chrono::steady_clock> dl_time_t;
 
+// Steady time which is set from outside, e.g. to follow the timestamps of a
+// replayed log. Each DroneCore instance has its own, for the Time instances of
+// its connections, systems and plugins. It never goes backwards: once cleared
+// it carries on from the last time set, at the pace of the steady clock.
+class ReplayClock
+{
+public:
+    ReplayClock() = default;
+    ~ReplayClock() = default;
+
+    void set(dl_time_t time);
+    void clear();
+    dl_time_t now() const;
+
+    // Non-copyable
+    ReplayClock(const ReplayClock &) = delete;
+    const ReplayClock &operator=(const ReplayClock &) = delete;
+
+private:
+    // 0 means not set, the steady clock never starts at 0.
+    std::atomic<dl_time_t::rep> _ticks {0};
+    // Ahead of the steady clock by this much once cleared.
+    std::atomic<dl_time_t::rep> _offset {0};
+};
+
 class Time
 {
 public:
     Time();
+    // Follows the clock, and the VirtualClock while that is enabled.
+    explicit Time(const ReplayClock &clock);
     virtual ~Time();
 
     virtual dl_time_t steady_time();
@@ -51,6 +79,17 @@ public:
     virtual void sleep_for(std::chrono::milliseconds ms);
     virtual void sleep_for(std::chrono::microseconds us);
     virtual void sleep_for(std::chrono::nanoseconds ns);
+
+    // While set, steady_time() of all instances returns this instead of their
+    // clock, for the VirtualClock. Sleeping is not affected.
+    static void set_virtual_time(dl_time_t time);
+    static void clear_virtual_time();
+
+private:
+    // On the VirtualClock while that is enabled.
+    void sleep(std::chrono::nanoseconds duration);
+
+    const ReplayClock *_clock {nullptr};
 };
 
 class FakeTime : public Time
@@ -92,3 +92,39 @@ TEST(GlobalInclude, FloatComparisons)
     EXPECT_FALSE(are_equal(1e20, 1e-20));
     EXPECT_FALSE(are_equal(1e20f, 1e-20f));
 }
+
+// The virtual time is only followed by the real clock, not by FakeTime.
+#undef Time
+
+TEST(GlobalInclude, VirtualTime)
+{
+    Time time {};
+    const dl_time_t virtual_time = time.steady_time() + std::chrono::hours(1);
+
+    Time::set_virtual_time(virtual_time);
+    EXPECT_EQ(time.steady_time(), virtual_time);
+    EXPECT_EQ(Time().steady_time(), virtual_time);
+
+    Time::clear_virtual_time();
+    EXPECT_LT(time.steady_time(), virtual_time);
+}
+
+TEST(GlobalInclude, ReplayClockPerInstance)
+{
+    ReplayClock clock;
+    Time replayed(clock);
+    Time other {};
+    const dl_time_t start = other.steady_time();
+    const dl_time_t replay_time = start + std::chrono::hours(1);
+
+    clock.set(replay_time);
+    EXPECT_EQ(replayed.steady_time(), replay_time);
+    EXPECT_LT(other.steady_time(), replay_time);
+
+    // Goes on from the end of the replay instead of back to the steady clock.
+    clock.clear();
+    const dl_time_t after = replayed.steady_time();
+    EXPECT_GE(after, replay_time);
+    EXPECT_LT(after, replay_time + std::chrono::minutes(1));
+    EXPECT_LT(other.steady_time(), replay_time);
+}
@@ -0,0 +1,115 @@
+#include "handler_profiler.h"
+#include <tuple>
+
+namespace dronecore {
+
+constexpr unsigned HandlerProfiler::NUM_BUCKETS;
+constexpr uint32_t HandlerProfiler::USER_CALLBACKS;
+
+bool HandlerProfiler::Key::operator<(const Key &other) const
+{
+    return std::tie(system, cookie, message_id) <
+           std::tie(other.system, other.cookie, other.message_id);
+}
+
+void HandlerProfiler::enable(double budget_s, slow_handler_callback_t slow_handler_callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (slow_handler_callback) {
+            _slow_handler_callback = std::make_shared<const slow_handler_callback_t>(
+                                         std::move(slow_handler_callback));
+        } else {
+            _slow_handler_callback.reset();
+        }
+    }
+    _budget_ns.store(budget_s > 0.0 ? uint64_t(budget_s * 1e9) : 0, std::memory_order_relaxed);
+    _enabled.store(true, std::memory_order_relaxed);
+}
+
+void HandlerProfiler::disable()
+{
+    _enabled.store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _slow_handler_callback.reset();
+}
+
+void HandlerProfiler::get_timings(std::vector<Timing> &timings) const
+{
+    timings.clear();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &it : _stats) {
+        const Stats &stats = *it.second;
+        Timing timing {};
+        timing.key = it.first;
+        timing.count = stats.count.load(std::memory_order_relaxed);
+        timing.total_ns = stats.total_ns.load(std::memory_order_relaxed);
+        timing.max_ns = stats.max_ns.load(std::memory_order_relaxed);
+        timing.over_budget = stats.over_budget.load(std::memory_order_relaxed);
+        for (unsigned i = 0; i < NUM_BUCKETS; ++i) {
+            timing.histogram[i] = stats.histogram[i].load(std::memory_order_relaxed);
+        }
+        timings.push_back(timing);
+    }
+}
+
+void HandlerProfiler::record(const Slot &slot, const Key &key,
+                             std::chrono::steady_clock::duration duration)
+{
+    const uint64_t duration_ns = uint64_t(
+                                     std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+
+    Stats &stats = get_stats(slot, key);
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.total_ns.fetch_add(duration_ns, std::memory_order_relaxed);
+    stats.histogram[bucket_of(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max_ns = stats.max_ns.load(std::memory_order_relaxed);
+    while (duration_ns > max_ns &&
+           !stats.max_ns.compare_exchange_weak(max_ns, duration_ns, std::memory_order_relaxed)) {}
+
+    const uint64_t budget_ns = _budget_ns.load(std::memory_order_relaxed);
+    if (budget_ns == 0 || duration_ns <= budget_ns) {
+        return;
+    }
+    stats.over_budget.fetch_add(1, std::memory_order_relaxed);
+
+    std::shared_ptr<const slow_handler_callback_t> callback;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        callback = _slow_handler_callback;
+    }
+    if (callback) {
+        (*callback)(key, duration_ns);
+    }
+}
+
+HandlerProfiler::Stats &HandlerProfiler::get_stats(const Slot &slot, const Key &key)
+{
+    void *stats = slot._stats.load(std::memory_order_acquire);
+    if (stats != nullptr) {
+        return *static_cast<Stats *>(stats);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::unique_ptr<Stats> &entry = _stats[key];
+    if (!entry) {
+        entry.reset(new Stats());
+    }
+    slot._stats.store(entry.get(), std::memory_order_release);
+    return *entry;
+}
+
+unsigned HandlerProfiler::bucket_of(uint64_t duration_ns)
+{
+    const uint64_t duration_us = duration_ns / 1000;
+    if (duration_us == 0) {
+        return 0;
+    }
+    // Bucket i holds [2^(i-1), 2^i) us.
+    const unsigned bucket = 64 - unsigned(__builtin_clzll(duration_us));
+    return bucket < NUM_BUCKETS ? bucket : NUM_BUCKETS - 1;
+}
+
+} // namespace dronecore
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// Execution times of message handlers and user callbacks, counted into a
+// histogram per handler while enabled. Calls over the budget are reported,
+// e.g. to find the handler which makes telemetry lag.
+//
+// Disabled, running a handler only checks a flag. Enabled, the clock is read
+// twice and a few counters are added to. The counters of a handler are looked
+// up once and then kept in a Slot next to the handler.
+class HandlerProfiler
+{
+public:
+    static constexpr unsigned NUM_BUCKETS = 16;
+    // Message ID under which the user callbacks of a system are counted.
+    static constexpr uint32_t USER_CALLBACKS = UINT32_MAX;
+
+    struct Key {
+        const void *system;
+        // Whoever registered the handler, nullptr for the user callbacks.
+        const void *cookie;
+        uint32_t message_id;
+
+        bool operator<(const Key &other) const;
+    };
+
+    struct Timing {
+        Key key;
+        uint64_t count;
+        uint64_t total_ns;
+        uint64_t max_ns;
+        uint64_t over_budget;
+        // Calls below 1 us, below 2 us, and so on doubling, the last one counts
+        // everything longer.
+        uint64_t histogram[NUM_BUCKETS];
+    };
+
+    typedef std::function<void(const Key &key, uint64_t duration_ns)> slow_handler_callback_t;
+
+    // Kept next to a handler, copies share the counters.
+    class Slot
+    {
+    public:
+        Slot() = default;
+        Slot(const Slot &other) : _stats(other._stats.load(std::memory_order_relaxed)) {}
+        Slot &operator=(const Slot &other)
+        {
+            _stats.store(other._stats.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+
+    private:
+        friend class HandlerProfiler;
+        mutable std::atomic<void *> _stats {nullptr};
+    };
+
+    HandlerProfiler() = default;
+    ~HandlerProfiler() = default;
+
+    // The callback is called on the thread of the handler, right after it.
+    void enable(double budget_s, slow_handler_callback_t slow_handler_callback);
+    void disable();
+    bool is_enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    template <typename F>
+    void run(const Slot &slot, const Key &key, F &&func)
+    {
+        if (!is_enabled()) {
+            func();
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        func();
+        record(slot, key, std::chrono::steady_clock::now() - start);
+    }
+
+    void get_timings(std::vector<Timing> &timings) const;
+
+    // Non-copyable
+    HandlerProfiler(const HandlerProfiler &) = delete;
+    const HandlerProfiler &operator=(const HandlerProfiler &) = delete;
+
+private:
+    struct Stats {
+        std::atomic<uint64_t> count {0};
+        std::atomic<uint64_t> total_ns {0};
+        std::atomic<uint64_t> max_ns {0};
+        std::atomic<uint64_t> over_budget {0};
+        std::atomic<uint64_t> histogram[NUM_BUCKETS] {};
+    };
+
+    void record(const Slot &slot, const Key &key, std::chrono::steady_clock::duration duration);
+    Stats &get_stats(const Slot &slot, const Key &key);
+    static unsigned bucket_of(uint64_t duration_ns);
+
+    std::atomic<bool> _enabled {false};
+    std::atomic<uint64_t> _budget_ns {0};
+
+    mutable std::mutex _mutex {};
+    // Never removed, the slots point to them.
+    std::map<Key, std::unique_ptr<Stats>> _stats {};
+    std::shared_ptr<const slow_handler_callback_t> _slow_handler_callback {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,122 @@
+#include "handler_profiler.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace dronecore;
+
+static const HandlerProfiler::Timing *find_timing(const std::vector<HandlerProfiler::Timing> &timings,
+                                                  const void *cookie, uint32_t message_id)
+{
+    for (const auto &timing : timings) {
+        if (timing.key.cookie == cookie && timing.key.message_id == message_id) {
+            return &timing;
+        }
+    }
+    return nullptr;
+}
+
+TEST(HandlerProfiler, NothingCountedWhenDisabled)
+{
+    HandlerProfiler profiler;
+    HandlerProfiler::Slot slot;
+    int calls = 0;
+
+    profiler.run(slot, {nullptr, &calls, 0}, [&calls]() { ++calls; });
+    EXPECT_EQ(calls, 1);
+
+    std::vector<HandlerProfiler::Timing> timings;
+    profiler.get_timings(timings);
+    EXPECT_TRUE(timings.empty());
+}
+
+TEST(HandlerProfiler, CopiedSlotsShareCounters)
+{
+    HandlerProfiler profiler;
+    profiler.enable(0.0, nullptr);
+
+    int cookie = 0;
+    HandlerProfiler::Slot slot;
+    HandlerProfiler::Slot copy = slot;
+    profiler.run(slot, {nullptr, &cookie, 1}, []() {});
+    HandlerProfiler::Slot later_copy = slot;
+    profiler.run(later_copy, {nullptr, &cookie, 1}, []() {});
+    // Copied before the first call, so looked up by key instead.
+    profiler.run(copy, {nullptr, &cookie, 1}, []() {});
+
+    std::vector<HandlerProfiler::Timing> timings;
+    profiler.get_timings(timings);
+    ASSERT_EQ(timings.size(), 1u);
+    EXPECT_EQ(timings[0].count, 3u);
+    EXPECT_EQ(timings[0].over_budget, 0u);
+}
+
+TEST(HandlerProfiler, HistogramBuckets)
+{
+    HandlerProfiler profiler;
+    profiler.enable(0.0, nullptr);
+
+    int cookie = 0;
+    HandlerProfiler::Slot fast_slot;
+    HandlerProfiler::Slot slow_slot;
+    profiler.run(fast_slot, {nullptr, &cookie, 1}, []() {});
+    profiler.run(slow_slot, {nullptr, &cookie, 2}, []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(3));
+    });
+
+    std::vector<HandlerProfiler::Timing> timings;
+    profiler.get_timings(timings);
+
+    const HandlerProfiler::Timing *slow = find_timing(timings, &cookie, 2);
+    ASSERT_NE(slow, nullptr);
+    EXPECT_EQ(slow->count, 1u);
+    EXPECT_GE(slow->max_ns, 3000000u);
+    EXPECT_EQ(slow->max_ns, slow->total_ns);
+    // 3 ms is in [2048, 4096) us or later if the sleep took longer.
+    uint64_t below_2048_us = 0;
+    for (unsigned i = 0; i < 12; ++i) {
+        below_2048_us += slow->histogram[i];
+    }
+    EXPECT_EQ(below_2048_us, 0u);
+
+    const HandlerProfiler::Timing *fast = find_timing(timings, &cookie, 1);
+    ASSERT_NE(fast, nullptr);
+    uint64_t sum = 0;
+    for (unsigned i = 0; i < HandlerProfiler::NUM_BUCKETS; ++i) {
+        sum += fast->histogram[i];
+    }
+    EXPECT_EQ(sum, 1u);
+}
+
+TEST(HandlerProfiler, ReportsOverBudget)
+{
+    HandlerProfiler profiler;
+
+    std::vector<HandlerProfiler::Key> reported;
+    profiler.enable(0.001, [&reported](const HandlerProfiler::Key &key, uint64_t duration_ns) {
+        EXPECT_GT(duration_ns, 1000000u);
+        reported.push_back(key);
+    });
+
+    int cookie = 0;
+    HandlerProfiler::Slot slot;
+    profiler.run(slot, {nullptr, &cookie, 7}, []() {});
+    profiler.run(slot, {nullptr, &cookie, 7}, []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+
+    ASSERT_EQ(reported.size(), 1u);
+    EXPECT_EQ(reported[0].cookie, &cookie);
+    EXPECT_EQ(reported[0].message_id, 7u);
+
+    std::vector<HandlerProfiler::Timing> timings;
+    profiler.get_timings(timings);
+    ASSERT_EQ(timings.size(), 1u);
+    EXPECT_EQ(timings[0].count, 2u);
+    EXPECT_EQ(timings[0].over_budget, 1u);
+
+    profiler.disable();
+    profiler.run(slot, {nullptr, &cookie, 7}, []() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    });
+    EXPECT_EQ(reported.size(), 1u);
+}
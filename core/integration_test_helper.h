@@ -12,9 +12,10 @@ protected:
     virtual void SetUp()
     {
 #ifndef WINDOWS
+        using namespace dronecore;
         const int ret = system("./start_px4_sitl.sh");
         if (ret != 0) {
-            dronecore::LogErr() << "./start_px4_sitl.sh failed, giving up.";
+            LogErr() << "./start_px4_sitl.sh failed, giving up.";
             abort();
         }
         // We need to wait a bit until it's up and running.
@@ -24,11 +25,12 @@ protected:
     virtual void TearDown()
     {
 #ifndef WINDOWS
+        using namespace dronecore;
         // Don't rush this either.
         std::this_thread::sleep_for(std::chrono::seconds(1));
         const int ret = system("./stop_px4_sitl.sh");
         if (ret != 0) {
-            dronecore::LogErr() << "./stop_px4_sitl.sh failed, giving up.";
+            LogErr() << "./stop_px4_sitl.sh failed, giving up.";
             abort();
         }
 #endif
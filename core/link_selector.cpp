@@ -0,0 +1,196 @@
+#include "link_selector.h"
+#include "log.h"
+
+namespace dronecore {
+
+constexpr unsigned LinkSelector::MAX_LINKS;
+constexpr unsigned LinkSelector::SEQ_WINDOW;
+constexpr double LinkSelector::LINK_STALE_S;
+constexpr double LinkSelector::LOSS_PENALTY_S;
+constexpr double LinkSelector::SWITCH_MARGIN_S;
+constexpr double LinkSelector::GAIN;
+
+bool LinkSelector::add(void *link, uint8_t component_id, uint8_t seq, uint32_t message_id,
+                       uint16_t checksum, const dl_time_t &time)
+{
+    // The common case, there is only one link anyway.
+    if (!_multi_link.load(std::memory_order_acquire) &&
+        _best_link.load(std::memory_order_relaxed) == link) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_multi_link) {
+        void *only_link = _best_link.load(std::memory_order_relaxed);
+        if (only_link == nullptr || only_link == link) {
+            _best_link.store(link, std::memory_order_release);
+            return true;
+        }
+        // Tracking starts with the second link, duplicates before that are missed.
+        _links[0] = Link {only_link, time, 0.0, 0.0};
+        _num_links = 1;
+        _multi_link = true;
+    }
+
+    const unsigned index = find_or_add_link(link, time);
+    _links[index].last_time = time;
+
+    auto &component = _components[component_id];
+    if (!component) {
+        component.reset(new Component {});
+    }
+
+    update_loss(*component, index, seq);
+
+    const uint32_t time_us = static_cast<uint32_t>(
+                                 std::chrono::duration_cast<std::chrono::microseconds>(
+                                     time.time_since_epoch()).count());
+    const bool is_new = update_seen(*component, index, seq, message_id, checksum, time_us);
+
+    select(time);
+    return is_new;
+}
+
+void LinkSelector::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _best_link = nullptr;
+    _multi_link = false;
+    _num_links = 0;
+    _components.clear();
+}
+
+unsigned LinkSelector::find_or_add_link(void *link, const dl_time_t &time)
+{
+    for (unsigned i = 0; i < _num_links; ++i) {
+        if (_links[i].link == link) {
+            return i;
+        }
+    }
+
+    unsigned index = _num_links;
+    if (_num_links < MAX_LINKS) {
+        ++_num_links;
+    } else {
+        index = 0;
+        for (unsigned i = 1; i < _num_links; ++i) {
+            if (_links[i].last_time < _links[index].last_time) {
+                index = i;
+            }
+        }
+        // What we know about the replaced one doesn't apply to the new one.
+        for (auto &component : _components) {
+            component.second->has_last_seq[index] = false;
+            for (auto &first_link : component.second->first_link) {
+                if (first_link == index + 1) {
+                    first_link = 0;
+                }
+            }
+        }
+    }
+
+    // New links start as good as the others, they have to prove worse.
+    _links[index] = Link {link, time, 0.0, 0.0};
+    return index;
+}
+
+void LinkSelector::update_loss(Component &component, unsigned index, uint8_t seq)
+{
+    Link &link = _links[index];
+
+    if (component.has_last_seq[index]) {
+        const uint8_t gap = uint8_t(seq - component.last_seq[index] - 1);
+        // Bigger jumps are rather reordering or a restart than loss.
+        if (gap < SEQ_WINDOW) {
+            for (unsigned i = 0; i < gap; ++i) {
+                link.loss += GAIN * (1.0 - link.loss);
+            }
+        }
+    }
+    link.loss -= GAIN * link.loss;
+
+    component.last_seq[index] = seq;
+    component.has_last_seq[index] = true;
+}
+
+bool LinkSelector::update_seen(Component &component, unsigned index, uint8_t seq,
+                               uint32_t message_id, uint16_t checksum, uint32_t time_us)
+{
+    const uint8_t link_id = uint8_t(index + 1);
+
+    if (component.has_seq && uint8_t(component.newest_seq - seq) < SEQ_WINDOW) {
+        // At or behind the newest, it might have been here already.
+        const uint8_t first_link = component.first_link[seq];
+        if (first_link != 0 && first_link != link_id &&
+            component.first_message_id[seq] == message_id &&
+            component.first_checksum[seq] == checksum) {
+            add_latency(index, double(time_us - component.first_time_us[seq]) * 1e-6);
+            return false;
+        }
+        // Repeated on the same link it is rather a restart of the sender, and a
+        // different message is from the sequence of another link.
+    } else {
+        // Ahead, so everything which is skipped over gets out of the window.
+        uint8_t s = component.has_seq ? uint8_t(component.newest_seq + 1) : seq;
+        while (s != seq) {
+            component.first_link[s] = 0;
+            ++s;
+        }
+        component.newest_seq = seq;
+        component.has_seq = true;
+    }
+
+    component.first_link[seq] = link_id;
+    component.first_time_us[seq] = time_us;
+    component.first_message_id[seq] = message_id;
+    component.first_checksum[seq] = checksum;
+    add_latency(index, 0.0);
+    return true;
+}
+
+void LinkSelector::add_latency(unsigned index, double latency_s)
+{
+    _links[index].latency_s += GAIN * (latency_s - _links[index].latency_s);
+}
+
+void LinkSelector::select(const dl_time_t &time)
+{
+    void *current = _best_link.load(std::memory_order_relaxed);
+
+    unsigned best = MAX_LINKS;
+    double best_score = 0.0;
+    double current_score = 0.0;
+    bool current_usable = false;
+
+    for (unsigned i = 0; i < _num_links; ++i) {
+        const double silent_s = std::chrono::duration<double>(time - _links[i].last_time).count();
+        if (silent_s > LINK_STALE_S) {
+            continue;
+        }
+
+        const double score = _links[i].latency_s + _links[i].loss * LOSS_PENALTY_S;
+        if (_links[i].link == current) {
+            current_usable = true;
+            current_score = score;
+        }
+        if (best == MAX_LINKS || score < best_score) {
+            best = i;
+            best_score = score;
+        }
+    }
+
+    if (best == MAX_LINKS || _links[best].link == current) {
+        return;
+    }
+    if (current_usable && current_score - best_score < SWITCH_MARGIN_S) {
+        return;
+    }
+
+    LogInfo() << "Switching link, latency " << _links[best].latency_s * 1e3
+              << " ms, loss " << _links[best].loss * 100.0 << " %";
+    _best_link.store(_links[best].link, std::memory_order_release);
+}
+
+} // namespace dronecore
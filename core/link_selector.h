@@ -0,0 +1,95 @@
+#pragma once
+
+#include "global_include.h"
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace dronecore {
+
+// Picks the link to send to one system on, when it can be heard on several
+// (e.g. LTE and a radio). Messages which arrive on more than one link are
+// recognized by their component ID, sequence number, message ID and checksum,
+// so they are only processed once. Autopilots count the sequence separately for
+// each of their links, so a matching sequence number alone doesn't make a
+// duplicate. Of the links which delivered something lately the one with
+// the lowest latency and loss is used, latency being how much later a link
+// delivers the same message than the fastest.
+//
+// As long as only one link was seen, nothing is tracked.
+class LinkSelector
+{
+public:
+    LinkSelector() = default;
+    ~LinkSelector() = default;
+
+    // Returns false if the message arrived on another link already.
+    bool add(void *link, uint8_t component_id, uint8_t seq, uint32_t message_id,
+             uint16_t checksum, const dl_time_t &time);
+
+    // nullptr until anything was received, lock-free.
+    void *get_best_link() const { return _best_link.load(std::memory_order_acquire); }
+
+    // Forgets everything, e.g. when the links go away.
+    void clear();
+
+    // More links of one system are rare, the stalest is replaced then.
+    static constexpr unsigned MAX_LINKS = 4;
+    // So many sequence numbers back duplicates are still recognized.
+    static constexpr unsigned SEQ_WINDOW = 128;
+    // A link which didn't deliver anything within a heartbeat interval is not used.
+    static constexpr double LINK_STALE_S = 1.0;
+    // How much latency losing every message is worth.
+    static constexpr double LOSS_PENALTY_S = 1.0;
+    // Only switch for a clearly better link, not back and forth on jitter.
+    static constexpr double SWITCH_MARGIN_S = 0.01;
+    // Weight of a new sample in the moving averages.
+    static constexpr double GAIN = 0.05;
+
+    // Non-copyable
+    LinkSelector(const LinkSelector &) = delete;
+    const LinkSelector &operator=(const LinkSelector &) = delete;
+
+private:
+    struct Link {
+        void *link;
+        dl_time_t last_time;
+        double latency_s;
+        double loss;
+    };
+
+    struct Component {
+        uint8_t newest_seq;
+        bool has_seq;
+        // Link index + 1 of the first arrival, 0 if not seen.
+        uint8_t first_link[256];
+        // Steady time of the first arrival in us, wrapping is fine for differences.
+        uint32_t first_time_us[256];
+        // What arrived first, another message with the same sequence number isn't
+        // a duplicate.
+        uint32_t first_message_id[256];
+        uint16_t first_checksum[256];
+        uint8_t last_seq[MAX_LINKS];
+        bool has_last_seq[MAX_LINKS];
+    };
+
+    unsigned find_or_add_link(void *link, const dl_time_t &time);
+    void update_loss(Component &component, unsigned index, uint8_t seq);
+    bool update_seen(Component &component, unsigned index, uint8_t seq, uint32_t message_id,
+                     uint16_t checksum, uint32_t time_us);
+    void add_latency(unsigned index, double latency_s);
+    void select(const dl_time_t &time);
+
+    std::atomic<void *> _best_link {nullptr};
+    // Set once a second link shows up, only then messages are tracked.
+    std::atomic<bool> _multi_link {false};
+
+    std::mutex _mutex {};
+    Link _links[MAX_LINKS] {};
+    unsigned _num_links {0};
+    std::map<uint8_t, std::unique_ptr<Component>> _components {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,145 @@
+#include "link_selector.h"
+#include "mavlink_include.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+namespace {
+
+int lte;
+int radio;
+
+dl_time_t at_ms(int ms)
+{
+    return dl_time_t() + std::chrono::milliseconds(ms);
+}
+
+} // namespace
+
+TEST(LinkSelector, SingleLink)
+{
+    LinkSelector selector;
+    EXPECT_EQ(selector.get_best_link(), nullptr);
+
+    for (unsigned i = 0; i < 300; ++i) {
+        // Sequence numbers wrap and repeat, with one link nothing is a duplicate.
+        EXPECT_TRUE(selector.add(&lte, 1, uint8_t(i), 0, 0, at_ms(int(i))));
+    }
+    EXPECT_EQ(selector.get_best_link(), &lte);
+}
+
+TEST(LinkSelector, DropsDuplicates)
+{
+    LinkSelector selector;
+
+    for (unsigned i = 0; i < 300; ++i) {
+        const uint8_t seq = uint8_t(i);
+        EXPECT_TRUE(selector.add(&lte, 1, seq, 0, 0, at_ms(int(i) * 10)));
+        EXPECT_TRUE(selector.add(&lte, 2, seq, 0, 0, at_ms(int(i) * 10)));
+        // Only tracked once the second link is there.
+        if (i == 0) {
+            EXPECT_TRUE(selector.add(&radio, 1, seq, 0, 0, at_ms(5)));
+        } else {
+            EXPECT_FALSE(selector.add(&radio, 1, seq, 0, 0, at_ms(int(i) * 10 + 5)));
+        }
+    }
+
+    // Out of order, but not seen yet.
+    EXPECT_TRUE(selector.add(&radio, 3, 7, 0, 0, at_ms(3000)));
+    EXPECT_TRUE(selector.add(&radio, 3, 5, 0, 0, at_ms(3001)));
+    EXPECT_FALSE(selector.add(&lte, 3, 5, 0, 0, at_ms(3002)));
+}
+
+TEST(LinkSelector, KeepsIndependentSequences)
+{
+    LinkSelector selector;
+
+    // Each link has a sequence of its own, the numbers match now and then but the
+    // messages don't.
+    int time_ms = 0;
+    for (unsigned i = 0; i < 300; ++i) {
+        time_ms += 10;
+        EXPECT_TRUE(selector.add(&lte, 1, uint8_t(i), MAVLINK_MSG_ID_ATTITUDE,
+                                 uint16_t(1000 + i), at_ms(time_ms)));
+        EXPECT_TRUE(selector.add(&radio, 1, uint8_t(i), MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
+                                 uint16_t(2000 + i), at_ms(time_ms + 1)));
+        EXPECT_TRUE(selector.add(&radio, 1, uint8_t(i + 40), MAVLINK_MSG_ID_ATTITUDE,
+                                 uint16_t(3000 + i), at_ms(time_ms + 2)));
+    }
+
+    // The same message on both still is a duplicate.
+    EXPECT_TRUE(selector.add(&lte, 1, 44, MAVLINK_MSG_ID_ATTITUDE, 77, at_ms(time_ms + 10)));
+    EXPECT_FALSE(selector.add(&radio, 1, 44, MAVLINK_MSG_ID_ATTITUDE, 77, at_ms(time_ms + 11)));
+}
+
+TEST(LinkSelector, PrefersLowerLatency)
+{
+    LinkSelector selector;
+
+    // The radio is first and gets used, but LTE turns out faster.
+    EXPECT_TRUE(selector.add(&radio, 1, 0, 0, 0, at_ms(0)));
+    EXPECT_EQ(selector.get_best_link(), &radio);
+
+    int time_ms = 0;
+    for (unsigned i = 1; i < 200; ++i) {
+        const uint8_t seq = uint8_t(i);
+        time_ms += 20;
+        EXPECT_TRUE(selector.add(&lte, 1, seq, 0, 0, at_ms(time_ms)));
+        EXPECT_FALSE(selector.add(&radio, 1, seq, 0, 0, at_ms(time_ms + 50)));
+    }
+    EXPECT_EQ(selector.get_best_link(), &lte);
+}
+
+TEST(LinkSelector, PrefersLessLoss)
+{
+    LinkSelector selector;
+
+    int time_ms = 0;
+    for (unsigned i = 0; i < 200; ++i) {
+        const uint8_t seq = uint8_t(i);
+        time_ms += 20;
+        // Both equally fast, but LTE loses every other message.
+        const bool from_radio = selector.add(&radio, 1, seq, 0, 0, at_ms(time_ms));
+        if (i % 2 == 0) {
+            const bool from_lte = selector.add(&lte, 1, seq, 0, 0, at_ms(time_ms));
+            if (i > 0) {
+                EXPECT_NE(from_radio, from_lte);
+            }
+        }
+    }
+    EXPECT_EQ(selector.get_best_link(), &radio);
+}
+
+TEST(LinkSelector, FailsOverWithinHeartbeatInterval)
+{
+    LinkSelector selector;
+
+    int time_ms = 0;
+    for (unsigned i = 0; i < 100; ++i) {
+        time_ms += 20;
+        selector.add(&lte, 1, uint8_t(i), 0, 0, at_ms(time_ms));
+        selector.add(&radio, 1, uint8_t(i), 0, 0, at_ms(time_ms + 100));
+    }
+    ASSERT_EQ(selector.get_best_link(), &lte);
+
+    // LTE goes silent, only the radio delivers.
+    for (unsigned i = 100; i < 200; ++i) {
+        time_ms += 20;
+        selector.add(&radio, 1, uint8_t(i), 0, 0, at_ms(time_ms));
+        if (time_ms - 2000 > 1000 * LinkSelector::LINK_STALE_S + 20 + 100) {
+            EXPECT_EQ(selector.get_best_link(), &radio);
+        }
+    }
+    EXPECT_EQ(selector.get_best_link(), &radio);
+}
+
+TEST(LinkSelector, Clear)
+{
+    LinkSelector selector;
+    selector.add(&lte, 1, 0, 0, 0, at_ms(0));
+    selector.add(&radio, 1, 0, 0, 0, at_ms(1));
+    selector.clear();
+    EXPECT_EQ(selector.get_best_link(), nullptr);
+    EXPECT_TRUE(selector.add(&radio, 1, 0, 0, 0, at_ms(2)));
+    EXPECT_EQ(selector.get_best_link(), &radio);
+}
@@ -1,4 +1,5 @@
 #include "log.h"
+#include "async_log.h"
 
 #if defined(WINDOWS)
 #include "Windows.h"
@@ -68,4 +69,100 @@ void set_color(Color color)
 #endif
 }
 
+LogDetailed::LogDetailed(const char *filename, int filenumber) : _s(),
+    _caller_filename(filename),
+    _caller_filenumber(filenumber)
+{
+    AsyncLog &async_log = AsyncLog::instance();
+    if (async_log.is_enabled()) {
+        _async = true;
+        _suppressed = !async_log.allow(filename, filenumber, _num_suppressed);
+    }
+}
+
+LogDetailed::~LogDetailed()
+{
+    if (_suppressed) {
+        return;
+    }
+
+    if (_async) {
+        AsyncLog::instance().push(_log_level, _s.str(), _caller_filename, _caller_filenumber,
+                                  _num_suppressed);
+    } else {
+        write_log_line(_log_level, time(nullptr), _s.str().c_str(),
+                       _caller_filename, _caller_filenumber);
+    }
+}
+
+void write_log_line(LogLevel level, time_t timestamp, const char *message,
+                    const char *filename, int line)
+{
+#if ANDROID
+    switch (level) {
+        case LogLevel::Debug:
+            __android_log_print(ANDROID_LOG_DEBUG, "DroneCore", "%s", message);
+            break;
+        case LogLevel::Info:
+            __android_log_print(ANDROID_LOG_INFO, "DroneCore", "%s", message);
+            break;
+        case LogLevel::Warn:
+            __android_log_print(ANDROID_LOG_WARN, "DroneCore", "%s", message);
+            break;
+        case LogLevel::Err:
+            __android_log_print(ANDROID_LOG_ERROR, "DroneCore", "%s", message);
+            break;
+    }
+    // Unused:
+    (void)timestamp;
+    (void)filename;
+    (void)line;
+#else
+
+    switch (level) {
+        case LogLevel::Debug:
+            set_color(Color::GREEN);
+            break;
+        case LogLevel::Info:
+            set_color(Color::BLUE);
+            break;
+        case LogLevel::Warn:
+            set_color(Color::YELLOW);
+            break;
+        case LogLevel::Err:
+            set_color(Color::RED);
+            break;
+    }
+
+    // Time output taken from:
+    // https://stackoverflow.com/questions/16357999#answer-16358264
+    struct tm *timeinfo = localtime(&timestamp);
+    char time_buffer[10] {}; // We need 8 characters + \0
+    strftime(time_buffer, sizeof(time_buffer), "%I:%M:%S", timeinfo);
+    std::cout << "[" << time_buffer;
+
+    switch (level) {
+        case LogLevel::Debug:
+            std::cout << "|Debug] ";
+            break;
+        case LogLevel::Info:
+            std::cout << "|Info ] ";
+            break;
+        case LogLevel::Warn:
+            std::cout << "|Warn ] ";
+            break;
+        case LogLevel::Err:
+            std::cout << "|Error] ";
+            break;
+    }
+
+    set_color(Color::RESET);
+
+    std::cout << message;
+    std::cout << " (" << filename << ":" << line << ")";
+
+    std::cout << std::endl;
+#endif
+}
+
 } // namespace dronecore
@@ -1,12 +1,14 @@
 #pragma once
 
+#include "log_sink.h"
+#include <cstdint>
+#include <ctime>
 #include <sstream>
 
 #if ANDROID
 #include <android/log.h>
 #else
 #include <iostream>
-#include <ctime>
 #endif
 
 #ifndef WINDOWS
@@ -16,29 +18,33 @@
 #define __FILENAME__  __FILE__
 #endif
 
-// For release builds, don't show debug printfs, and just discard it into the NullStream.
-class NullStream
-{
-public:
-    template<typename TPrintable>
-    NullStream &operator<<(TPrintable const &)
-    {
-        /* no-op */
-        static NullStream nothing;
-        return nothing;
-    }
-};
+// Lines below DRONECORE_LOG_LEVEL are compiled out, e.g. with
+// -DDRONECORE_LOG_LEVEL=2 only warnings and errors are left. By default, debug
+// output is only kept in debug builds.
+#define DRONECORE_LOG_LEVEL_DEBUG 0
+#define DRONECORE_LOG_LEVEL_INFO 1
+#define DRONECORE_LOG_LEVEL_WARN 2
+#define DRONECORE_LOG_LEVEL_ERR 3
+#define DRONECORE_LOG_LEVEL_NONE 4
 
+#ifndef DRONECORE_LOG_LEVEL
 #if DEBUG
-#define LogDebug() LogDebugDetailed(__FILENAME__, __LINE__)
+#define DRONECORE_LOG_LEVEL DRONECORE_LOG_LEVEL_DEBUG
 #else
-#define LogDebug() NullStream()
+#define DRONECORE_LOG_LEVEL DRONECORE_LOG_LEVEL_INFO
+#endif
 #endif
 
+// The conditional makes the compiler drop the whole line below the level,
+// including the evaluation of what is streamed into it. LogVoidify binds weaker
+// than <<, so it's applied to the finished line.
+#define DRONECORE_LOG_IF_ENABLED(level) \
+    !(DRONECORE_LOG_LEVEL <= DRONECORE_LOG_LEVEL_##level) ? static_cast<void>(0) : LogVoidify() &
 
-#define LogInfo() LogInfoDetailed(__FILENAME__, __LINE__)
-#define LogWarn() LogWarnDetailed(__FILENAME__, __LINE__)
-#define LogErr() LogErrDetailed(__FILENAME__, __LINE__)
+#define LogDebug() DRONECORE_LOG_IF_ENABLED(DEBUG) LogDebugDetailed(__FILENAME__, __LINE__)
+#define LogInfo() DRONECORE_LOG_IF_ENABLED(INFO) LogInfoDetailed(__FILENAME__, __LINE__)
+#define LogWarn() DRONECORE_LOG_IF_ENABLED(WARN) LogWarnDetailed(__FILENAME__, __LINE__)
+#define LogErr() DRONECORE_LOG_IF_ENABLED(ERR) LogErrDetailed(__FILENAME__, __LINE__)
 
 
 namespace dronecore {
@@ -55,103 +61,47 @@ enum class Color {
 void set_color(Color color);
 
 
+// Writes one line to the console (or the Android log) with timestamp and location.
+void write_log_line(LogLevel level, time_t timestamp, const char *message,
+                    const char *filename, int line);
+
+
 class LogDetailed
 {
 public:
-    LogDetailed(const char *filename, int filenumber) : _s(),
-        _caller_filename(filename),
-        _caller_filenumber(filenumber)
-    {}
+    LogDetailed(const char *filename, int filenumber);
 
     template <typename T>
     LogDetailed &operator << (const T &x)
     {
-        _s << x;
+        // Don't even format what is rate-limited.
+        if (!_suppressed) {
+            _s << x;
+        }
         return *this;
     }
 
-    virtual ~LogDetailed()
-    {
-#if ANDROID
-        switch (_log_level) {
-            case LogLevel::Debug:
-                __android_log_print(ANDROID_LOG_DEBUG, "DroneCore", "%s", _s.str().c_str());
-                break;
-            case LogLevel::Info:
-                __android_log_print(ANDROID_LOG_INFO, "DroneCore", "%s", _s.str().c_str());
-                break;
-            case LogLevel::Warn:
-                __android_log_print(ANDROID_LOG_WARN, "DroneCore", "%s", _s.str().c_str());
-                break;
-            case LogLevel::Err:
-                __android_log_print(ANDROID_LOG_ERROR, "DroneCore", "%s", _s.str().c_str());
-                break;
-        }
-        // Unused:
-        (void)_caller_filename;
-        (void)_caller_filenumber;
-#else
-
-        switch (_log_level) {
-            case LogLevel::Debug:
-                set_color(Color::GREEN);
-                break;
-            case LogLevel::Info:
-                set_color(Color::BLUE);
-                break;
-            case LogLevel::Warn:
-                set_color(Color::YELLOW);
-                break;
-            case LogLevel::Err:
-                set_color(Color::RED);
-                break;
-        }
-
-        // Time output taken from:
-        // https://stackoverflow.com/questions/16357999#answer-16358264
-        time_t rawtime;
-        time(&rawtime);
-        struct tm *timeinfo = localtime(&rawtime);
-        char time_buffer[10] {}; // We need 8 characters + \0
-        strftime(time_buffer, sizeof(time_buffer), "%I:%M:%S", timeinfo);
-        std::cout << "[" << time_buffer;
-
-        switch (_log_level) {
-            case LogLevel::Debug:
-                std::cout << "|Debug] ";
-                break;
-            case LogLevel::Info:
-                std::cout << "|Info ] ";
-                break;
-            case LogLevel::Warn:
-                std::cout << "|Warn ] ";
-                break;
-            case LogLevel::Err:
-                std::cout << "|Error] ";
-                break;
-        }
-
-        set_color(Color::RESET);
-
-        std::cout << _s.str();
-        std::cout << " (" << _caller_filename << ":" << _caller_filenumber << ")";
-
-        std::cout << std::endl;
-#endif
-    }
+    virtual ~LogDetailed();
 
 protected:
-    enum LogLevel {
-        Debug,
-        Info,
-        Warn,
-        Err
-    } _log_level;
+    LogLevel _log_level {LogLevel::Info};
 
 private:
     std::stringstream _s;
     const char *_caller_filename;
     int _caller_filenumber;
+
+    // Set when async logging is enabled.
+    bool _async {false};
+    bool _suppressed {false};
+    uint32_t _num_suppressed {0};
+};
+
+// Turns a log line into void for DRONECORE_LOG_IF_ENABLED.
+class LogVoidify
+{
+public:
+    void operator&(const LogDetailed &) {}
 };
 
 class LogDebugDetailed : public LogDetailed
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <functional>
+
+namespace dronecore {
+
+/**
+ * @brief Severity of a log line.
+ */
+enum class LogLevel {
+    Debug, /**< @brief Debug output, only in debug builds. */
+    Info, /**< @brief Information. */
+    Warn, /**< @brief Warning. */
+    Err /**< @brief Error. */
+};
+
+/**
+ * @brief Callback type to receive log lines, see DroneCore::enable_async_logging().
+ *
+ * @param level Severity of the line.
+ * @param message The text logged, without timestamp or location.
+ * @param filename Source file which logged the line.
+ * @param line Line number in the source file.
+ */
+typedef std::function<void(LogLevel level, const char *message,
+                           const char *filename, int line)> log_sink_t;
+
+} // namespace dronecore
@@ -1,21 +1,21 @@
 #include "mavlink_commands.h"
 #include "mavlink_system.h"
-#include <future>
+#include "completion.h"
+#include "trace.h"
+#include <cstdint>
 #include <memory>
+#include <algorithm>
+#include <utility>
 
 namespace dronecore {
 
-// TODO: Currently the mavlink command handling is made in a way to only
-//       process one command at any time. Therefore, the work state is global
-//       for this whole class.
-//       The limitation is made because:
-//       - We are not sure what exactly will happen if the commands are sent in parallel
-//         and what kind of edge cases we might run into.
-//       - The timeout handler only supports the (void *)this cookie and therefore only
-//         really supports one timeout per object. We could use (void *)this of the work
-//         item but it also seems a bit dodgy.
-//       - The queue used does not support going through and checking each and every
-//         item yet.
+// Commands to different components, or different commands to the same component,
+// are in flight at the same time, each with its own timeout and retries. Only
+// the same command to the same component waits for the previous one, because
+// the acks could not be told apart otherwise.
+
+constexpr unsigned MAVLinkCommands::MAX_POOLED_WORK;
+constexpr double MAVLinkCommands::DEFAULT_IN_PROGRESS_TIMEOUT_S;
 
 MAVLinkCommands::MAVLinkCommands(MAVLinkSystem &parent) :
     _parent(parent)
@@ -29,76 +29,58 @@ MAVLinkCommands::MAVLinkCommands(MAVLinkSystem &parent) :
 MAVLinkCommands::~MAVLinkCommands()
 {
     _parent.unregister_all_mavlink_message_handlers(this);
+
+    std::lock_guard<std::mutex> lock(_work_mutex);
+    for (Work *work : _in_flight) {
+        _parent.unregister_timeout_handler(work->timeout_cookie);
+        delete work;
+    }
+    for (Work *work : _work_queue) {
+        delete work;
+    }
+    for (Work *list : {_work_inbox.load(), _pool}) {
+        while (list != nullptr) {
+            Work *next = list->next;
+            delete list;
+            list = next;
+        }
+    }
 }
 
 MAVLinkCommands::Result
 MAVLinkCommands::send_command(const MAVLinkCommands::CommandInt &command)
 {
-    struct PromiseResult {
-        Result result;
-        float progress;
-    };
-
-    // We wrap the async call with a promise and future.
-    std::shared_ptr<std::promise<PromiseResult>> prom =
-                                                  std::make_shared<std::promise<PromiseResult>>();
+    // We wrap the async call and block until the final result is in.
+    Completion<Result> completion;
 
     queue_command_async(command,
-    [prom](Result result, float progress) {
-        PromiseResult promise_result {};
-        promise_result.result = result;
-        promise_result.progress = progress;
-        prom->set_value(promise_result);
+    [&completion](Result result, float progress) {
+        if (result == Result::IN_PROGRESS) {
+            LogInfo() << "In progress: " << progress;
+            return;
+        }
+        completion.complete(result);
     });
 
-    std::future<PromiseResult> res = prom->get_future();
-    while (true) {
-        // Block now to wait for result.
-        res.wait();
-
-        PromiseResult promise_result = res.get();
-
-        if (promise_result.result == Result::IN_PROGRESS) {
-            LogInfo() << "In progress: " << promise_result.progress;
-            continue;
-        }
-        return promise_result.result;
-    }
+    return completion.wait();
 }
 
 MAVLinkCommands::Result
 MAVLinkCommands::send_command(const MAVLinkCommands::CommandLong &command)
 {
-    struct PromiseResult {
-        Result result;
-        float progress;
-    };
-
-    // We wrap the async call with a promise and future.
-    std::shared_ptr<std::promise<PromiseResult>> prom =
-                                                  std::make_shared<std::promise<PromiseResult>>();
+    // We wrap the async call and block until the final result is in.
+    Completion<Result> completion;
 
     queue_command_async(command,
-    [prom](Result result, float progress) {
-        PromiseResult promise_result {};
-        promise_result.result = result;
-        promise_result.progress = progress;
-        prom->set_value(promise_result);
+    [&completion](Result result, float progress) {
+        if (result == Result::IN_PROGRESS) {
+            LogInfo() << "In progress: " << progress;
+            return;
+        }
+        completion.complete(result);
     });
 
-    std::future<PromiseResult> res = prom->get_future();
-    while (true) {
-        // Block now to wait for result.
-        res.wait();
-
-        PromiseResult promise_result = res.get();
-
-        if (promise_result.result == Result::IN_PROGRESS) {
-            LogInfo() << "In progress: " << promise_result.progress;
-            continue;
-        }
-        return promise_result.result;
-    }
+    return completion.wait();
 }
 
 void
@@ -108,10 +90,10 @@ MAVLinkCommands::queue_command_async(const CommandInt &command,
     // LogDebug() << "Command " << (int)(command.command) << " to send to "
     //  << (int)(command.target_system_id)<< ", " << (int)(command.target_component_id;
 
-    Work new_work {};
+    Work *new_work = get_work();
     mavlink_msg_command_int_pack(GCSClient::system_id,
                                  GCSClient::component_id,
-                                 &new_work.mavlink_message,
+                                 &new_work->mavlink_message,
                                  command.target_system_id,
                                  command.target_component_id,
                                  command.frame,
@@ -126,9 +108,10 @@ MAVLinkCommands::queue_command_async(const CommandInt &command,
                                  command.params.y,
                                  command.params.z);
 
-    new_work.callback = callback;
-    new_work.mavlink_command = command.command;
-    _work_queue.push_back(new_work);
+    new_work->callback = std::move(callback);
+    new_work->mavlink_command = command.command;
+    new_work->target_component_id = command.target_component_id;
+    queue_work(new_work);
 }
 
 void
@@ -138,10 +121,44 @@ MAVLinkCommands::queue_command_async(const CommandLong &command,
     // LogDebug() << "Command " << (int)(command.command) << " to send to "
     //  << (int)(command.target_system_id)<< ", " << (int)(command.target_component_id;
 
-    Work new_work {};
+    Work *new_work = get_work();
+    pack_command(command, new_work->mavlink_message);
+
+    new_work->callback = std::move(callback);
+    new_work->mavlink_command = command.command;
+    new_work->target_component_id = command.target_component_id;
+    queue_work(new_work);
+}
+
+void
+MAVLinkCommands::queue_command_batch_async(const std::vector<CommandLong> &commands,
+                                           command_result_callback_t callback)
+{
+    if (commands.empty()) {
+        if (callback) {
+            callback(Result::SUCCESS, 1.0f);
+        }
+        return;
+    }
+
+    Work *new_work = get_work();
+    new_work->batch.resize(commands.size());
+    for (size_t i = 0; i < commands.size(); ++i) {
+        pack_command(commands[i], new_work->batch[i]);
+    }
+
+    new_work->acks_to_wait_for = unsigned(commands.size());
+    new_work->callback = std::move(callback);
+    new_work->mavlink_command = commands.front().command;
+    new_work->target_component_id = commands.front().target_component_id;
+    queue_work(new_work);
+}
+
+void MAVLinkCommands::pack_command(const CommandLong &command, mavlink_message_t &message)
+{
     mavlink_msg_command_long_pack(GCSClient::system_id,
                                   GCSClient::component_id,
-                                  &new_work.mavlink_message,
+                                  &message,
                                   command.target_system_id,
                                   command.target_component_id,
                                   command.command,
@@ -153,200 +170,304 @@ MAVLinkCommands::queue_command_async(const CommandLong &command,
                                   command.params.param5,
                                   command.params.param6,
                                   command.params.param7);
+}
 
-    new_work.callback = callback;
-    new_work.mavlink_command = command.command;
-    _work_queue.push_back(new_work);
+MAVLinkCommands::Work *MAVLinkCommands::get_work()
+{
+    {
+        std::lock_guard<std::mutex> lock(_pool_mutex);
+        if (_pool != nullptr) {
+            Work *work = _pool;
+            _pool = work->next;
+            --_pool_size;
+            *work = Work {};
+            return work;
+        }
+    }
+    return new Work {};
 }
 
-void MAVLinkCommands::receive_command_ack(mavlink_message_t message)
+void MAVLinkCommands::release_work(Work *work)
 {
-    // If nothing is in the queue, we ignore the message all together.
-    if (_work_queue.size() == 0) {
-        return;
+    // Whatever the callback holds on to shouldn't wait for the next command.
+    work->callback = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(_pool_mutex);
+        if (_pool_size < MAX_POOLED_WORK) {
+            work->next = _pool;
+            _pool = work;
+            ++_pool_size;
+            return;
+        }
     }
+    delete work;
+}
 
-    Work &work = _work_queue.front();
+void MAVLinkCommands::queue_work(Work *work)
+{
+    work->next = _work_inbox.load(std::memory_order_relaxed);
+    while (!_work_inbox.compare_exchange_weak(work->next, work,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed)) {}
+    _parent.wake_system_thread();
+}
 
+bool MAVLinkCommands::send_work(const Work &work)
+{
+    if (!work.batch.empty()) {
+        return _parent.send_messages(work.batch);
+    }
+    return _parent.send_message(work.mavlink_message);
+}
+
+void MAVLinkCommands::receive_command_ack(const mavlink_message_t &message)
+{
     mavlink_command_ack_t command_ack;
     mavlink_msg_command_ack_decode(&message, &command_ack);
 
     // LogDebug() << "We got an ack: " << command_ack.command;
 
-    if (work.mavlink_command != command_ack.command) {
-        // If the command does not match with our current command, ignore it.
-        LogWarn() << "Command ack not matching our current command: " << work.mavlink_command;
-        return;
-    }
+    command_result_callback_t callback {};
+    Result result = Result::UNKNOWN_ERROR;
+    float progress = NAN;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight_for_ack(command_ack.command, message.compid);
+        if (it == _in_flight.end()) {
+            // If the command does not match with any of our commands, ignore it.
+            LogWarn() << "Command ack not matching any command sent: " << command_ack.command;
+            return;
+        }
+        Work *work = *it;
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
-    switch (command_ack.result) {
-        case MAV_RESULT_ACCEPTED:
-            _state = State::DONE;
-            if (work.callback) {
-                work.callback(Result::SUCCESS, 1.0f);
-            }
-            break;
+        if (work->can_sample_rtt) {
+            _parent.get_rtt_estimator().add_sample(
+                _parent.get_time().elapsed_since_s(work->sent_time));
+            work->can_sample_rtt = false;
+        }
 
-        case MAV_RESULT_DENIED:
-            LogWarn() << "command denied (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+        switch (command_ack.result) {
+            case MAV_RESULT_ACCEPTED:
+                result = Result::SUCCESS;
+                progress = 1.0f;
+                break;
 
-        case MAV_RESULT_UNSUPPORTED:
-            LogWarn() << "command unsupported (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+            case MAV_RESULT_DENIED:
+                LogWarn() << "command denied (" << work->mavlink_command << ").";
+                result = Result::COMMAND_DENIED;
+                break;
 
-        case MAV_RESULT_TEMPORARILY_REJECTED:
-            LogWarn() << "command temporarily rejected (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+            case MAV_RESULT_UNSUPPORTED:
+                LogWarn() << "command unsupported (" << work->mavlink_command << ").";
+                result = Result::COMMAND_DENIED;
+                break;
 
-        case MAV_RESULT_FAILED:
-            LogWarn() << "command failed (" << work.mavlink_command << ").";
-            _state = State::FAILED;
-            if (work.callback) {
-                work.callback(Result::COMMAND_DENIED, NAN);
-            }
-            break;
+            case MAV_RESULT_TEMPORARILY_REJECTED:
+                LogWarn() << "command temporarily rejected (" << work->mavlink_command << ").";
+                result = Result::COMMAND_DENIED;
+                break;
+
+            case MAV_RESULT_FAILED:
+                LogWarn() << "command failed (" << work->mavlink_command << ").";
+                result = Result::COMMAND_DENIED;
+                break;
+
+            case MAV_RESULT_IN_PROGRESS:
+                if (static_cast<int>(command_ack.progress) != 255) {
+                    LogInfo() << "progress: " << static_cast<int>(command_ack.progress)
+                              << " % (" << work->mavlink_command << ").";
+                }
+                // FIXME: We can only call callbacks with promises once, so let's not do it
+                //        on IN_PROGRESS.
+                //if (work->callback) {
+                //    work->callback(Result::IN_PROGRESS, command_ack.progress / 100.0f);
+                //}
+                work->in_progress = true;
+                // The command has arrived, so the RTT based timeout and the
+                // retries left don't tell how long it may take. Wait for the next
+                // update instead.
+                _parent.unregister_timeout_handler(work->timeout_cookie);
+                register_timeout(*work, _in_progress_timeout_s.load(std::memory_order_relaxed));
+                return;
+
+            default:
+                LogWarn() << "unknown command result (" << work->mavlink_command << ").";
+                break;
+        }
 
-        case MAV_RESULT_IN_PROGRESS:
-            if (static_cast<int>(command_ack.progress) != 255) {
-                LogInfo() << "progress: " << static_cast<int>(command_ack.progress)
-                          << " % (" << work.mavlink_command << ").";
+        if (work->acks_to_wait_for > 1) {
+            // A batch is only done with its last ack.
+            --work->acks_to_wait_for;
+            if (result != Result::SUCCESS && work->batch_result == Result::SUCCESS) {
+                work->batch_result = result;
             }
-            // FIXME: We can only call callbacks with promises once, so let's not do it
-            //        on IN_PROGRESS.
-            //if (work.callback) {
-            //    work.callback(Result::IN_PROGRESS, command_ack.progress / 100.0f);
-            //}
-            _state = State::IN_PROGRESS;
-            // If we get a progress update, we can raise the timeout
-            // to something higher because we know the initial command
-            // has arrived. A possible timeout for this case is the initial
-            // timeout * the possible retries because this should match the
-            // case where there is no progress update and we keep trying.
-            _parent.unregister_timeout_handler(_timeout_cookie);
-            _parent.register_timeout_handler(
-                std::bind(&MAVLinkCommands::receive_timeout, this),
-                work.retries_to_do * work.timeout_s, &_timeout_cookie);
-            break;
-    }
-}
+            return;
+        }
+        if (work->batch_result != Result::SUCCESS) {
+            result = work->batch_result;
+            progress = NAN;
+        }
 
-void MAVLinkCommands::receive_timeout()
-{
-    // If nothing is in the queue, we ignore the timeout.
-    if (_work_queue.size() == 0) {
-        return;
+        _parent.unregister_timeout_handler(work->timeout_cookie);
+        callback = std::move(work->callback);
+        _in_flight.erase(it);
+        DRONECORE_TRACE_ASYNC_END("command", uint64_t(reinterpret_cast<uintptr_t>(work)));
+        release_work(work);
     }
 
-    Work &work = _work_queue.front();
+    // The callback might queue the next command, so we can't hold the lock.
+    if (callback) {
+        callback(result, progress);
+    }
 
-    std::lock_guard<std::mutex> lock(_state_mutex);
+    // Let the system thread send the next command in the queue.
+    _parent.wake_system_thread();
+}
 
-    if (_state == State::WAITING) {
+void MAVLinkCommands::receive_timeout(uint16_t mavlink_command, uint8_t target_component_id)
+{
+    command_result_callback_t callback {};
+    Result result = Result::TIMEOUT;
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        auto it = find_in_flight(mavlink_command, target_component_id);
+        if (it == _in_flight.end()) {
+            return;
+        }
+        Work *work = *it;
+        // The timeout is gone once it fired.
+        work->timeout_cookie = nullptr;
 
-        if (work.retries_to_do > 0) {
+        if (!work->in_progress && work->retries_to_do > 0) {
 
-            LogInfo() << "sending again, retries to do: " << work.retries_to_do
-                      << "  (" << work.mavlink_command << ").";
+            LogInfo() << "sending again, retries to do: " << work->retries_to_do
+                      << "  (" << work->mavlink_command << ").";
             // We're not sure the command arrived, let's retransmit.
-            if (!_parent.send_message(work.mavlink_message)) {
-                LogErr() << "connection send error in retransmit (" << work.mavlink_command << ").";
-                if (work.callback) {
-                    work.callback(Result::CONNECTION_ERROR, NAN);
-                }
-                _state = State::FAILED;
-            } else {
-                --work.retries_to_do;
-                _parent.register_timeout_handler(
-                    std::bind(&MAVLinkCommands::receive_timeout, this),
-                    work.timeout_s, &_timeout_cookie);
+            // For a batch, all of it, as it's unknown which acks are missing.
+            if (send_work(*work)) {
+                --work->retries_to_do;
+                work->can_sample_rtt = false;
+                // Back off in case the link is just slower than estimated.
+                work->timeout_s = std::min(work->timeout_s * 2.0, RttEstimator::MAX_TIMEOUT_S);
+                register_timeout(*work, work->timeout_s);
+                return;
             }
 
-        } else  {
-            // We have tried retransmitting, giving up now.
-            LogErr() << "Retrying failed (" << work.mavlink_command << ")";
+            LogErr() << "connection send error in retransmit (" << work->mavlink_command << ").";
+            result = Result::CONNECTION_ERROR;
 
-            if (work.callback) {
-                if (_state == State::WAITING) {
-                    work.callback(Result::TIMEOUT, NAN);
-                }
-            }
-            _state = State::FAILED;
+        } else {
+            // We have tried retransmitting, giving up now.
+            LogErr() << "Retrying failed (" << work->mavlink_command << ")";
         }
+
+        callback = std::move(work->callback);
+        _in_flight.erase(it);
+        DRONECORE_TRACE_ASYNC_END("command", uint64_t(reinterpret_cast<uintptr_t>(work)));
+        release_work(work);
+    }
+
+    if (callback) {
+        callback(result, NAN);
     }
+
+    _parent.wake_system_thread();
+}
+
+void MAVLinkCommands::set_in_progress_timeout_s(double timeout_s)
+{
+    _in_progress_timeout_s.store(timeout_s, std::memory_order_relaxed);
 }
 
 void MAVLinkCommands::do_work()
 {
-    std::lock_guard<std::mutex> lock(_state_mutex);
-
-    // Clean up first
-    switch (_state) {
-        case State::NONE:
-        // FALLTHROUGH
-        case State::WAITING:
-        // FALLTHROUGH
-        case State::IN_PROGRESS:
-            break;
-        case State::DONE:
-        // FALLTHROUGH
-        case State::FAILED:
-            _parent.unregister_timeout_handler(_timeout_cookie);
-            _work_queue.pop_front();
-            _state = State::NONE;
-            break;
+    std::vector<command_result_callback_t> failed_callbacks {};
+    {
+        std::lock_guard<std::mutex> lock(_work_mutex);
+
+        // The inbox has the newest first.
+        const size_t num_queued = _work_queue.size();
+        for (Work *work = _work_inbox.exchange(nullptr, std::memory_order_acquire);
+             work != nullptr; work = work->next) {
+            _work_queue.push_back(work);
+        }
+        std::reverse(_work_queue.begin() + num_queued, _work_queue.end());
+
+        size_t num_waiting = 0;
+        for (size_t i = 0; i < _work_queue.size(); ++i) {
+            Work *work = _work_queue[i];
+
+            if (find_in_flight(work->mavlink_command, work->target_component_id) !=
+                _in_flight.end()) {
+                // Wait until the previous one is done.
+                _work_queue[num_waiting++] = work;
+                continue;
+            }
+
+            // LogDebug() << "sending it the first time (" << work->mavlink_command << ")";
+            if (!send_work(*work)) {
+                LogErr() << "connection send error (" << work->mavlink_command << ")";
+                failed_callbacks.push_back(std::move(work->callback));
+                release_work(work);
+                continue;
+            }
+
+            // Pooled work is only reused once done, so it identifies the command meanwhile.
+            DRONECORE_TRACE_ASYNC_BEGIN("command", uint64_t(reinterpret_cast<uintptr_t>(work)));
+            work->sent_time = _parent.get_time().steady_time();
+            work->timeout_s = _parent.get_rtt_estimator().get_timeout_s();
+            _in_flight.push_back(work);
+            register_timeout(*work, work->timeout_s);
+        }
+        _work_queue.resize(num_waiting);
     }
 
-    // Check if there is work to do.
-    if (_work_queue.size() == 0) {
-        // Nothing to do.
-        return;
+    for (auto &callback : failed_callbacks) {
+        if (callback) {
+            callback(Result::CONNECTION_ERROR, NAN);
+        }
     }
+}
 
-    // If so, let's get the latest.
-    Work &work = _work_queue.front();
-
-    // If the work state is none, we can start the next command.
-    switch (_state) {
-        case State::NONE:
-            // LogDebug() << "sending it the first time (" << work.mavlink_command << ")";
-            if (!_parent.send_message(work.mavlink_message)) {
-                LogErr() << "connection send error (" << work.mavlink_command << ")";
-                if (work.callback) {
-                    work.callback(Result::CONNECTION_ERROR, NAN);
-                }
-                _state = State::FAILED;
-                break;
-            } else {
-                _state = State::WAITING;
-                _parent.register_timeout_handler(
-                    std::bind(&MAVLinkCommands::receive_timeout, this),
-                    work.timeout_s, &_timeout_cookie);
-            }
-            break;
-        case State::WAITING:
-        case State::IN_PROGRESS:
-            // LogWarn() << "wait until we can deal with this";
-            break;
-        case State::DONE:
-        // FALLTHROUGH
-        case State::FAILED:
-            break;
+std::vector<MAVLinkCommands::Work *>::iterator
+MAVLinkCommands::find_in_flight(uint16_t mavlink_command, uint8_t target_component_id)
+{
+    return std::find_if(_in_flight.begin(), _in_flight.end(),
+    [mavlink_command, target_component_id](const Work * work) {
+        return work->mavlink_command == mavlink_command &&
+               work->target_component_id == target_component_id;
+    });
+}
+
+std::vector<MAVLinkCommands::Work *>::iterator
+MAVLinkCommands::find_in_flight_for_ack(uint16_t mavlink_command, uint8_t from_component_id)
+{
+    auto work = find_in_flight(mavlink_command, from_component_id);
+    if (work != _in_flight.end()) {
+        return work;
     }
+
+    // Broadcast commands are acked by whichever component takes them. Acks for a
+    // command to another component are not ours to take, that one is in flight too.
+    return std::find_if(_in_flight.begin(), _in_flight.end(),
+    [mavlink_command](const Work * in_flight) {
+        return in_flight->mavlink_command == mavlink_command &&
+               in_flight->target_component_id == 0;
+    });
 }
 
+void MAVLinkCommands::register_timeout(Work &work, double timeout_s)
+{
+    // Small enough to be stored in the std::function without allocating.
+    const uint16_t mavlink_command = work.mavlink_command;
+    const uint8_t target_component_id = work.target_component_id;
+    _parent.register_timeout_handler(
+    [this, mavlink_command, target_component_id]() {
+        receive_timeout(mavlink_command, target_component_id);
+    }, timeout_s, &work.timeout_cookie);
+}
 
 } // namespace dronecore
@@ -1,11 +1,14 @@
 #pragma once
 
 #include "mavlink_include.h"
-#include "locked_queue.h"
+#include "global_include.h"
+#include "rtt_estimator.h"
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <functional>
 #include <mutex>
+#include <vector>
 
 namespace dronecore {
 
@@ -99,8 +102,21 @@ public:
     void queue_command_async(const CommandLong &command,
                              command_result_callback_t callback);
 
+    // Sends all commands at once instead of waiting for the ack of each, and
+    // calls back when all of them are acked or one failed. As the acks can't be
+    // told apart, they need to be the same command to the same component and
+    // idempotent, like MAV_CMD_SET_MESSAGE_INTERVAL.
+    void queue_command_batch_async(const std::vector<CommandLong> &commands,
+                                   command_result_callback_t callback);
+
     void do_work();
 
+    // How long to wait for the next progress update, or the final ack, of a
+    // command in progress. Restarted with every update, the command is not
+    // resent meanwhile as it has evidently arrived.
+    static constexpr double DEFAULT_IN_PROGRESS_TIMEOUT_S = 3.0;
+    void set_in_progress_timeout_s(double timeout_s);
+
     static const int DEFAULT_COMPONENT_ID_AUTOPILOT = MAV_COMP_ID_AUTOPILOT1;
 
     // Non-copyable
@@ -108,30 +124,66 @@ public:
     const MAVLinkCommands &operator=(const MAVLinkCommands &) = delete;
 
 private:
-    enum class State {
-        NONE,
-        WAITING,
-        IN_PROGRESS,
-        DONE,
-        FAILED
-    } _state = State::NONE;
-    std::mutex _state_mutex {};
-
     struct Work {
         int retries_to_do = 3;
-        double timeout_s = 0.5;
+        // Derived from the RTT estimate when the command is sent.
+        double timeout_s = RttEstimator::DEFAULT_TIMEOUT_S;
         uint16_t mavlink_command = 0;
+        uint8_t target_component_id = 0;
         mavlink_message_t mavlink_message {};
+        // Only for a batch, sent instead of mavlink_message.
+        std::vector<mavlink_message_t> batch {};
+        unsigned acks_to_wait_for = 1;
+        // The first failure in a batch.
+        Result batch_result = Result::SUCCESS;
         command_result_callback_t callback {};
+        bool in_progress = false;
+        void *timeout_cookie = nullptr;
+        dl_time_t sent_time {};
+        // Only the first ack of a command which wasn't resent is a valid RTT sample.
+        bool can_sample_rtt = true;
+        // Links the work in the inbox and in the pool.
+        Work *next = nullptr;
     };
 
-    void receive_command_ack(mavlink_message_t message);
-    void receive_timeout();
+    Work *get_work();
+    void release_work(Work *work);
+    void queue_work(Work *work);
+    bool send_work(const Work &work);
+
+    static void pack_command(const CommandLong &command, mavlink_message_t &message);
+
+    void receive_command_ack(const mavlink_message_t &message);
+    void receive_timeout(uint16_t mavlink_command, uint8_t target_component_id);
+
+    // Need to be called with _work_mutex locked.
+    std::vector<Work *>::iterator find_in_flight(uint16_t mavlink_command,
+                                                 uint8_t target_component_id);
+    std::vector<Work *>::iterator find_in_flight_for_ack(uint16_t mavlink_command,
+                                                         uint8_t from_component_id);
+    void register_timeout(Work &work, double timeout_s);
 
     MAVLinkSystem &_parent;
-    LockedQueue<Work> _work_queue {};
 
-    void *_timeout_cookie = nullptr;
+    // Queued commands are pushed here from any thread without locking, newest
+    // first, and all taken at once by do_work().
+    std::atomic<Work *> _work_inbox {nullptr};
+
+    // Finished work is kept for the next commands, so that bursts of commands
+    // (e.g. setting the message rates on connect) don't allocate.
+    static constexpr unsigned MAX_POOLED_WORK = 32;
+
+    std::atomic<double> _in_progress_timeout_s {DEFAULT_IN_PROGRESS_TIMEOUT_S};
+    std::mutex _pool_mutex {};
+    Work *_pool {nullptr};
+    unsigned _pool_size {0};
+
+    std::mutex _work_mutex {};
+    // Commands not sent yet, in the order they were queued.
+    std::vector<Work *> _work_queue {};
+    // Commands sent and waiting for their ack. As in the MAVLink command
+    // protocol, there is at most one per command and target component.
+    std::vector<Work *> _in_flight {};
 };
 
 } // namespace dronecore
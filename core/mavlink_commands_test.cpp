@@ -0,0 +1,246 @@
+#include "dronecore_impl.h"
+#include "mavlink_commands.h"
+#include "mavlink_system.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+
+using namespace dronecore;
+
+namespace {
+
+void send_ack(MAVLinkSystem &system, MAV_RESULT result, uint8_t progress)
+{
+    mavlink_message_t message;
+    mavlink_msg_command_ack_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                                 MAV_CMD_PREFLIGHT_CALIBRATION, uint8_t(result), progress, 0,
+                                 GCSClient::system_id, GCSClient::component_id);
+    system.process_mavlink_message(message);
+}
+
+std::future<MAVLinkCommands::Result> send_calibration(MAVLinkSystem &system)
+{
+    auto prom = std::make_shared<std::promise<MAVLinkCommands::Result>>();
+    auto fut = prom->get_future();
+
+    MAVLinkCommands::CommandLong command {};
+    command.command = MAV_CMD_PREFLIGHT_CALIBRATION;
+    command.target_component_id = MAV_COMP_ID_AUTOPILOT1;
+    system.send_command_async(command, [prom](MAVLinkCommands::Result result, float) {
+        prom->set_value(result);
+    });
+    return fut;
+}
+
+void send_ack_from(MAVLinkSystem &system, uint8_t component_id, MAV_RESULT result)
+{
+    mavlink_message_t message;
+    mavlink_msg_command_ack_pack(1, component_id, &message,
+                                 MAV_CMD_PREFLIGHT_CALIBRATION, uint8_t(result), 0, 0,
+                                 GCSClient::system_id, GCSClient::component_id);
+    system.process_mavlink_message(message);
+}
+
+std::future<MAVLinkCommands::Result> send_calibration_to(MAVLinkSystem &system,
+                                                         uint8_t component_id)
+{
+    auto prom = std::make_shared<std::promise<MAVLinkCommands::Result>>();
+    auto fut = prom->get_future();
+
+    MAVLinkCommands::CommandLong command {};
+    command.command = MAV_CMD_PREFLIGHT_CALIBRATION;
+    command.target_component_id = component_id;
+    system.send_command_async(command, [prom](MAVLinkCommands::Result result, float) {
+        prom->set_value(result);
+    });
+    return fut;
+}
+
+// A batch of SET_MESSAGE_INTERVAL commands, one per rate.
+std::future<MAVLinkCommands::Result> set_msg_rates(MAVLinkSystem &system, unsigned num_rates)
+{
+    auto prom = std::make_shared<std::promise<MAVLinkCommands::Result>>();
+    auto fut = prom->get_future();
+
+    MAVLinkSystem::msg_rates_t rates_hz;
+    for (unsigned i = 0; i < num_rates; ++i) {
+        rates_hz.push_back(std::make_pair(uint16_t(MAVLINK_MSG_ID_ATTITUDE + i), 10.0));
+    }
+    system.set_msg_rates_async(rates_hz, [prom](MAVLinkCommands::Result result, float) {
+        prom->set_value(result);
+    });
+    return fut;
+}
+
+void send_msg_rate_ack(MAVLinkSystem &system, uint8_t result)
+{
+    mavlink_message_t message;
+    mavlink_msg_command_ack_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                                 MAV_CMD_SET_MESSAGE_INTERVAL, result, 0, 0,
+                                 GCSClient::system_id, GCSClient::component_id);
+    system.process_mavlink_message(message);
+}
+
+} // namespace
+
+TEST(MAVLinkCommands, InProgressWaitsForUpdates)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+    system.set_command_in_progress_timeout_s(0.3);
+
+    auto fut = send_calibration(system);
+    // Give the system thread the time to send it.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Takes much longer than the timeout and all retries, but keeps reporting.
+    for (uint8_t progress = 0; progress < 100; progress += 10) {
+        send_ack(system, MAV_RESULT_IN_PROGRESS, progress);
+        std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    }
+    EXPECT_EQ(fut.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    send_ack(system, MAV_RESULT_ACCEPTED, 100);
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::SUCCESS);
+}
+
+TEST(MAVLinkCommands, InProgressTimesOutWithoutUpdates)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+    system.set_command_in_progress_timeout_s(0.3);
+
+    auto fut = send_calibration(system);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    send_ack(system, MAV_RESULT_IN_PROGRESS, 10);
+    const auto last_update = std::chrono::steady_clock::now();
+
+    // Not resent meanwhile, so it doesn't wait for the retries either.
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::TIMEOUT);
+    EXPECT_GE(std::chrono::steady_clock::now() - last_update, std::chrono::milliseconds(250));
+}
+
+TEST(MAVLinkCommands, AcksGoToCommandOfSameComponent)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    // The same command to two components is in flight twice at once.
+    auto to_autopilot = send_calibration_to(system, MAV_COMP_ID_AUTOPILOT1);
+    auto to_camera = send_calibration_to(system, MAV_COMP_ID_CAMERA);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    send_ack_from(system, MAV_COMP_ID_CAMERA, MAV_RESULT_DENIED);
+    ASSERT_EQ(to_camera.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(to_camera.get(), MAVLinkCommands::Result::COMMAND_DENIED);
+    EXPECT_EQ(to_autopilot.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    send_ack_from(system, MAV_COMP_ID_AUTOPILOT1, MAV_RESULT_ACCEPTED);
+    ASSERT_EQ(to_autopilot.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(to_autopilot.get(), MAVLinkCommands::Result::SUCCESS);
+}
+
+TEST(MAVLinkCommands, IgnoresAckFromOtherComponent)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    auto fut = send_calibration_to(system, MAV_COMP_ID_AUTOPILOT1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Only a command to all components takes the ack of any of them.
+    send_ack_from(system, MAV_COMP_ID_CAMERA, MAV_RESULT_DENIED);
+    EXPECT_EQ(fut.wait_for(std::chrono::milliseconds(100)), std::future_status::timeout);
+
+    send_ack_from(system, MAV_COMP_ID_AUTOPILOT1, MAV_RESULT_ACCEPTED);
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::SUCCESS);
+}
+
+TEST(MAVLinkCommands, BroadcastTakesAckFromAnyComponent)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    auto fut = send_calibration_to(system, MAV_COMP_ID_ALL);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    send_ack_from(system, MAV_COMP_ID_AUTOPILOT1, MAV_RESULT_ACCEPTED);
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::SUCCESS);
+}
+
+TEST(MAVLinkCommands, BatchDoneWithLastAck)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    auto fut = set_msg_rates(system, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    send_msg_rate_ack(system, MAV_RESULT_ACCEPTED);
+    send_msg_rate_ack(system, MAV_RESULT_ACCEPTED);
+    EXPECT_EQ(fut.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    send_msg_rate_ack(system, MAV_RESULT_ACCEPTED);
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::SUCCESS);
+}
+
+TEST(MAVLinkCommands, BatchReportsFirstFailure)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    auto fut = set_msg_rates(system, 3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    send_msg_rate_ack(system, MAV_RESULT_ACCEPTED);
+    // Not a MAV_RESULT we know.
+    send_msg_rate_ack(system, 42);
+    // Still waits for the rest after a failure.
+    EXPECT_EQ(fut.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    send_msg_rate_ack(system, MAV_RESULT_DENIED);
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::UNKNOWN_ERROR);
+}
+
+TEST(MAVLinkCommands, BatchResentOnTimeout)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    auto fut = set_msg_rates(system, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    send_msg_rate_ack(system, MAV_RESULT_ACCEPTED);
+
+    // The other ack got lost. All of the batch is sent again after the timeout,
+    // the acks counted so far still count.
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    EXPECT_EQ(fut.wait_for(std::chrono::seconds(0)), std::future_status::timeout);
+
+    send_msg_rate_ack(system, MAV_RESULT_ACCEPTED);
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(1)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::SUCCESS);
+}
+
+TEST(MAVLinkCommands, BatchReportsFailedResend)
+{
+    DroneCoreImpl dc;
+    MAVLinkSystem system(dc, 1, MAV_COMP_ID_AUTOPILOT1);
+
+    auto fut = set_msg_rates(system, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    // Without acks it is resent after the timeout, which fails now.
+    system.lock_communication();
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), MAVLinkCommands::Result::CONNECTION_ERROR);
+    system.unlock_communication();
+}
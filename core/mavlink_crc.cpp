@@ -0,0 +1,51 @@
+#include "mavlink_crc.h"
+
+namespace dronecore {
+
+constexpr uint16_t MAVLinkCrc::INITIAL;
+
+uint16_t MAVLinkCrc::_tables[8][256];
+MAVLinkCrc::TableInit MAVLinkCrc::_table_init;
+
+MAVLinkCrc::TableInit::TableInit()
+{
+    for (unsigned i = 0; i < 256; ++i) {
+        uint16_t crc = uint16_t(i);
+        for (unsigned bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? uint16_t((crc >> 1) ^ 0x8408) : uint16_t(crc >> 1);
+        }
+        _tables[0][i] = crc;
+    }
+
+    // What a byte does to the CRC when followed by k zero bytes.
+    for (unsigned k = 1; k < 8; ++k) {
+        for (unsigned i = 0; i < 256; ++i) {
+            const uint16_t previous = _tables[k - 1][i];
+            _tables[k][i] = uint16_t((previous >> 8) ^ _tables[0][previous & 0xFF]);
+        }
+    }
+}
+
+uint16_t MAVLinkCrc::accumulate(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while (len >= 8) {
+        // The CRC goes into the first two bytes, then each byte is looked up by
+        // how many bytes still follow it.
+        const unsigned b0 = (data[0] ^ crc) & 0xFF;
+        const unsigned b1 = (data[1] ^ (crc >> 8)) & 0xFF;
+        crc = uint16_t(_tables[7][b0] ^ _tables[6][b1] ^
+                       _tables[5][data[2]] ^ _tables[4][data[3]] ^
+                       _tables[3][data[4]] ^ _tables[2][data[5]] ^
+                       _tables[1][data[6]] ^ _tables[0][data[7]]);
+        data += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = accumulate(crc, *data);
+        ++data;
+        --len;
+    }
+    return crc;
+}
+
+} // namespace dronecore
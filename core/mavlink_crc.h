@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dronecore {
+
+// The MAVLink checksum (CRC-16/MCRF4XX, i.e. X.25 reflected, started with
+// 0xFFFF and not inverted at the end) with lookup tables instead of the bit
+// shuffling per byte of the mavlink headers. Long buffers are done 8 bytes
+// at a time (slicing-by-8), that's what frames on the receive path go through.
+class MAVLinkCrc
+{
+public:
+    static constexpr uint16_t INITIAL = 0xFFFF;
+
+    static uint16_t calculate(const uint8_t *data, size_t len)
+    {
+        return accumulate(INITIAL, data, len);
+    }
+    static uint16_t accumulate(uint16_t crc, const uint8_t *data, size_t len);
+
+    static uint16_t accumulate(uint16_t crc, uint8_t byte)
+    {
+        return uint16_t((crc >> 8) ^ _tables[0][(crc ^ byte) & 0xFF]);
+    }
+
+private:
+    // Filled in during static initialization, before anything is sent or received.
+    static uint16_t _tables[8][256];
+
+    struct TableInit {
+        TableInit();
+    };
+    static TableInit _table_init;
+};
+
+} // namespace dronecore
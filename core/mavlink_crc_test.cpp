@@ -0,0 +1,49 @@
+#include "mavlink_crc.h"
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+// As in checksum.h of the mavlink headers.
+uint16_t reference_crc(const uint8_t *data, size_t len)
+{
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t tmp = uint8_t(data[i] ^ uint8_t(crc & 0xFF));
+        tmp = uint8_t(tmp ^ (tmp << 4));
+        crc = uint16_t((crc >> 8) ^ (tmp << 8) ^ (tmp << 3) ^ (tmp >> 4));
+    }
+    return crc;
+}
+
+} // namespace
+
+TEST(MAVLinkCrc, KnownValue)
+{
+    // The check value of CRC-16/MCRF4XX.
+    const char *check = "123456789";
+    EXPECT_EQ(MAVLinkCrc::calculate(reinterpret_cast<const uint8_t *>(check), 9), 0x6F91);
+}
+
+TEST(MAVLinkCrc, SameAsMAVLink)
+{
+    std::srand(42);
+    std::vector<uint8_t> data(300);
+    for (auto &byte : data) {
+        byte = uint8_t(std::rand());
+    }
+
+    // All lengths, so every tail after the 8 byte blocks is covered.
+    for (size_t len = 0; len <= data.size(); ++len) {
+        ASSERT_EQ(MAVLinkCrc::calculate(data.data(), len), reference_crc(data.data(), len));
+    }
+
+    uint16_t crc = MAVLinkCrc::INITIAL;
+    for (auto byte : data) {
+        crc = MAVLinkCrc::accumulate(crc, byte);
+    }
+    EXPECT_EQ(crc, reference_crc(data.data(), data.size()));
+}
@@ -0,0 +1,197 @@
+#include "mavlink_dispatch_queue.h"
+#include "thread_setup.h"
+#include <utility>
+
+namespace dronecore {
+
+constexpr unsigned MAVLinkDispatchQueue::NUM_PRIORITIES;
+
+MAVLinkDispatchQueue::MAVLinkDispatchQueue(message_handler_t handler,
+                                           size_t capacity,
+                                           DropPolicy drop_policy) :
+    _handler(handler),
+    _drop_policy(drop_policy)
+{
+    for (auto &ring : _rings) {
+        ring.entries.resize(capacity > 0 ? capacity : 1);
+    }
+    // Enough blocks to fill the rings, so none are allocated while running.
+    MAVLinkMessagePool::instance().reserve(NUM_PRIORITIES * _rings[0].entries.size());
+}
+
+MAVLinkDispatchQueue::~MAVLinkDispatchQueue()
+{
+    stop();
+    MAVLinkMessagePool::instance().unreserve(NUM_PRIORITIES * _rings[0].entries.size());
+}
+
+void MAVLinkDispatchQueue::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_dispatch_thread != nullptr) {
+        return;
+    }
+    _should_exit = false;
+    _dispatch_thread = new std::thread(dispatch_thread, this);
+}
+
+void MAVLinkDispatchQueue::request_stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+    }
+    _condition_var.notify_all();
+    _space_condition_var.notify_all();
+}
+
+void MAVLinkDispatchQueue::stop()
+{
+    std::thread *thread_to_join = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        thread_to_join = _dispatch_thread;
+        _dispatch_thread = nullptr;
+    }
+    _condition_var.notify_all();
+    _space_condition_var.notify_all();
+
+    if (thread_to_join != nullptr) {
+        thread_to_join->join();
+        delete thread_to_join;
+    }
+}
+
+bool MAVLinkDispatchQueue::push(const mavlink_message_t &message, const dl_time_t &receive_time)
+{
+    // Copied outside of the lock.
+    MAVLinkMessagePool::Handle handle = MAVLinkMessagePool::instance().acquire(message);
+    if (!handle) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_stats.dropped;
+        return false;
+    }
+    return push(std::move(handle), receive_time);
+}
+
+bool MAVLinkDispatchQueue::push(MAVLinkMessagePool::Handle message,
+                                const dl_time_t &receive_time)
+{
+    // Classified as it arrives, a full bulk ring never drops control messages.
+    const Priority priority = get_priority(message->msgid);
+    Ring &ring = _rings[static_cast<unsigned>(priority)];
+
+    bool dropped = false;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if (priority == Priority::CONTROL) {
+            // Losing an ack would fail a command or transfer, better hold up receiving.
+            while (ring.count == ring.entries.size() &&
+                   _dispatch_thread != nullptr && !_should_exit) {
+                _space_condition_var.wait(lock);
+            }
+        }
+
+        if (ring.count == ring.entries.size()) {
+            ++_stats.dropped;
+            dropped = true;
+            if (_drop_policy == DropPolicy::DROP_NEWEST) {
+                return false;
+            }
+            // Make room by giving up on the oldest one.
+            ring.head = (ring.head + 1) % ring.entries.size();
+            --ring.count;
+            --_count;
+        }
+
+        // An overwritten one goes back to the pool here.
+        Entry &entry = ring.entries[(ring.head + ring.count) % ring.entries.size()];
+        entry.message = std::move(message);
+        entry.receive_time = receive_time;
+        ++ring.count;
+        ++_count;
+        ++_stats.enqueued;
+        if (_count > _stats.high_watermark) {
+            _stats.high_watermark = _count;
+        }
+    }
+    _condition_var.notify_one();
+
+    return !dropped;
+}
+
+size_t MAVLinkDispatchQueue::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _count;
+}
+
+size_t MAVLinkDispatchQueue::get_memory_bytes() const
+{
+    // The ring sizes never change, no need to lock.
+    return NUM_PRIORITIES * _rings[0].entries.size() * (sizeof(Entry) + sizeof(mavlink_message_t));
+}
+
+MAVLinkDispatchQueue::Stats MAVLinkDispatchQueue::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+MAVLinkDispatchQueue::Priority MAVLinkDispatchQueue::get_priority(uint32_t msgid)
+{
+    switch (msgid) {
+        case MAVLINK_MSG_ID_PARAM_VALUE:
+        case MAVLINK_MSG_ID_PARAM_EXT_VALUE:
+        case MAVLINK_MSG_ID_LOG_ENTRY:
+        case MAVLINK_MSG_ID_LOG_DATA:
+        case MAVLINK_MSG_ID_LOGGING_DATA:
+        case MAVLINK_MSG_ID_LOGGING_DATA_ACKED:
+        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+        case MAVLINK_MSG_ID_ENCAPSULATED_DATA:
+            return Priority::BULK;
+        default:
+            return Priority::CONTROL;
+    }
+}
+
+void MAVLinkDispatchQueue::dispatch_thread(MAVLinkDispatchQueue *self)
+{
+    setup_thread(ThreadRole::System, "dispatch");
+
+    Entry entry;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(self->_mutex);
+            while (self->_count == 0 && !self->_should_exit) {
+                self->_condition_var.wait(lock);
+            }
+            if (self->_should_exit) {
+                break;
+            }
+
+            // Control messages first, bulk once there are none waiting.
+            Ring *ring = &self->_rings[0];
+            while (ring->count == 0) {
+                ++ring;
+            }
+            entry = std::move(ring->entries[ring->head]);
+            ring->head = (ring->head + 1) % ring->entries.size();
+            --ring->count;
+            --self->_count;
+            ++self->_stats.dispatched;
+        }
+        self->_space_condition_var.notify_one();
+
+        // The lock is released here so the I/O thread can keep pushing.
+        if (self->_handler) {
+            self->_handler(*entry.message, entry.receive_time);
+        }
+        entry.message.reset();
+    }
+}
+
+} // namespace dronecore
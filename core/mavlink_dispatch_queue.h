@@ -0,0 +1,113 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include "global_include.h"
+#include "mavlink_message_pool.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace dronecore {
+
+// Bounded ring of received messages which are handed to the handler on a
+// separate dispatch thread. This way a slow (user) callback can never block
+// the I/O thread reading from the socket or serial port. The time a message
+// was received travels with it, so the wait in the ring doesn't count.
+// The messages are kept in the message pool, the ring only holds handles.
+//
+// Control messages (heartbeats, acks) have a ring of their own which is served
+// first, so they don't wait behind a burst of bulk messages (params, logs,
+// file transfer) and time out. The order is kept within each class only.
+// Control messages are never dropped: if their ring is full, push() waits for
+// the dispatch thread, as handling them right away would. The drop policy only
+// applies to bulk messages.
+class MAVLinkDispatchQueue
+{
+public:
+    enum class Priority {
+        CONTROL,
+        BULK
+    };
+
+    // What to do when the bulk ring is full.
+    enum class DropPolicy {
+        DROP_NEWEST, // Discard the message which was just received.
+        DROP_OLDEST  // Overwrite the oldest message not yet dispatched.
+    };
+
+    struct Stats {
+        uint64_t enqueued;
+        uint64_t dispatched;
+        uint64_t dropped;
+        size_t high_watermark;
+    };
+
+    typedef std::function<void(const mavlink_message_t &, const dl_time_t &)>
+    message_handler_t;
+
+    // The capacity is per priority.
+    MAVLinkDispatchQueue(message_handler_t handler,
+                         size_t capacity,
+                         DropPolicy drop_policy = DropPolicy::DROP_OLDEST);
+    ~MAVLinkDispatchQueue();
+
+    void start();
+    void stop();
+    // Lets the dispatch thread return without waiting for it, stop() then joins.
+    void request_stop();
+
+    // Only waits for the handler if the control ring is full, returns false if a
+    // message had to be dropped. Without a running dispatch thread nothing is waited for.
+    bool push(const mavlink_message_t &message, const dl_time_t &receive_time);
+    // For a message which is in the pool already, it is not copied again.
+    bool push(MAVLinkMessagePool::Handle message, const dl_time_t &receive_time);
+
+    // Messages waiting in both rings.
+    size_t size() const;
+    // The rings and the pool blocks reserved for them.
+    size_t get_memory_bytes() const;
+    Stats get_stats() const;
+
+    static Priority get_priority(uint32_t msgid);
+
+    // Non-copyable
+    MAVLinkDispatchQueue(const MAVLinkDispatchQueue &) = delete;
+    const MAVLinkDispatchQueue &operator=(const MAVLinkDispatchQueue &) = delete;
+
+private:
+    static void dispatch_thread(MAVLinkDispatchQueue *self);
+
+    struct Entry {
+        MAVLinkMessagePool::Handle message;
+        dl_time_t receive_time;
+    };
+
+    struct Ring {
+        std::vector<Entry> entries {};
+        size_t head {0};
+        size_t count {0};
+    };
+
+    static constexpr unsigned NUM_PRIORITIES = 2;
+
+    message_handler_t _handler;
+    const DropPolicy _drop_policy;
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _condition_var {};
+    // For push() waiting for room in the control ring.
+    std::condition_variable _space_condition_var {};
+    // By Priority.
+    Ring _rings[NUM_PRIORITIES] {};
+    size_t _count {0};
+    bool _should_exit {false};
+
+    Stats _stats {0, 0, 0, 0};
+
+    std::thread *_dispatch_thread {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,221 @@
+#include "mavlink_dispatch_queue.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(MAVLinkDispatchQueue, DispatchesInOrder)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<uint8_t> received_seqs;
+    std::vector<dl_time_t> receive_times;
+
+    MAVLinkDispatchQueue queue([&](const mavlink_message_t &message,
+    const dl_time_t &receive_time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received_seqs.push_back(message.seq);
+        receive_times.push_back(receive_time);
+        cv.notify_one();
+    }, 16);
+    queue.start();
+
+    const dl_time_t start_time = std::chrono::steady_clock::now();
+    for (uint8_t i = 0; i < 10; ++i) {
+        mavlink_message_t message {};
+        message.seq = i;
+        EXPECT_TRUE(queue.push(message, start_time + std::chrono::milliseconds(i)));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(1), [&]() { return received_seqs.size() == 10; });
+    }
+    queue.stop();
+
+    ASSERT_EQ(received_seqs.size(), 10);
+    for (uint8_t i = 0; i < 10; ++i) {
+        EXPECT_EQ(received_seqs[i], i);
+        // When it was received, not when it was dispatched.
+        EXPECT_EQ(receive_times[i], start_time + std::chrono::milliseconds(i));
+    }
+
+    auto stats = queue.get_stats();
+    EXPECT_EQ(stats.enqueued, 10);
+    EXPECT_EQ(stats.dispatched, 10);
+    EXPECT_EQ(stats.dropped, 0);
+}
+
+TEST(MAVLinkDispatchQueue, DropNewestWhenFull)
+{
+    // Not started, so nothing gets consumed.
+    MAVLinkDispatchQueue queue(nullptr, 4, MAVLinkDispatchQueue::DropPolicy::DROP_NEWEST);
+
+    mavlink_message_t message {};
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.push(message, dl_time_t()));
+    }
+    EXPECT_FALSE(queue.push(message, dl_time_t()));
+    EXPECT_FALSE(queue.push(message, dl_time_t()));
+
+    EXPECT_EQ(queue.size(), 4);
+
+    auto stats = queue.get_stats();
+    EXPECT_EQ(stats.enqueued, 4);
+    EXPECT_EQ(stats.dropped, 2);
+    EXPECT_EQ(stats.high_watermark, 4);
+}
+
+TEST(MAVLinkDispatchQueue, DropOldestWhenFull)
+{
+    std::vector<uint8_t> received_seqs;
+    std::atomic<int> num_received {0};
+
+    MAVLinkDispatchQueue queue([&](const mavlink_message_t &message, const dl_time_t &) {
+        received_seqs.push_back(message.seq);
+        ++num_received;
+    }, 3, MAVLinkDispatchQueue::DropPolicy::DROP_OLDEST);
+
+    for (uint8_t i = 0; i < 5; ++i) {
+        mavlink_message_t message {};
+        message.seq = i;
+        queue.push(message, dl_time_t());
+    }
+    EXPECT_EQ(queue.size(), 3);
+    EXPECT_EQ(queue.get_stats().dropped, 2);
+
+    queue.start();
+    for (int i = 0; i < 100 && num_received < 3; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    queue.stop();
+
+    ASSERT_EQ(received_seqs.size(), 3);
+    EXPECT_EQ(received_seqs[0], 2);
+    EXPECT_EQ(received_seqs[1], 3);
+    EXPECT_EQ(received_seqs[2], 4);
+}
+
+TEST(MAVLinkDispatchQueue, RequestStopDoesNotWait)
+{
+    std::atomic<unsigned> num_dispatched {0};
+    MAVLinkDispatchQueue queue([&num_dispatched](const mavlink_message_t &,
+    const dl_time_t &) {
+        ++num_dispatched;
+    }, 16);
+    queue.start();
+
+    queue.request_stop();
+    // The dispatch thread returns by itself, this only joins it.
+    queue.stop();
+
+    mavlink_message_t message {};
+    queue.push(message, std::chrono::steady_clock::now());
+    EXPECT_EQ(num_dispatched, 0u);
+}
+
+TEST(MAVLinkDispatchQueue, ControlBeforeBulk)
+{
+    std::vector<uint32_t> received_msgids;
+    std::atomic<int> num_received {0};
+
+    MAVLinkDispatchQueue queue([&](const mavlink_message_t &message, const dl_time_t &) {
+        received_msgids.push_back(message.msgid);
+        ++num_received;
+    }, 8);
+
+    EXPECT_EQ(MAVLinkDispatchQueue::get_priority(MAVLINK_MSG_ID_PARAM_EXT_VALUE),
+              MAVLinkDispatchQueue::Priority::BULK);
+    EXPECT_EQ(MAVLinkDispatchQueue::get_priority(MAVLINK_MSG_ID_COMMAND_ACK),
+              MAVLinkDispatchQueue::Priority::CONTROL);
+
+    // Queued up before the dispatch thread runs.
+    mavlink_message_t message {};
+    message.msgid = MAVLINK_MSG_ID_PARAM_EXT_VALUE;
+    for (int i = 0; i < 8; ++i) {
+        EXPECT_TRUE(queue.push(message, dl_time_t()));
+    }
+    // The bulk ring is full, but this one doesn't go there.
+    message.msgid = MAVLINK_MSG_ID_COMMAND_ACK;
+    EXPECT_TRUE(queue.push(message, dl_time_t()));
+    message.msgid = MAVLINK_MSG_ID_HEARTBEAT;
+    EXPECT_TRUE(queue.push(message, dl_time_t()));
+    EXPECT_EQ(queue.size(), 10);
+
+    queue.start();
+    for (int i = 0; i < 100 && num_received < 10; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    queue.stop();
+
+    ASSERT_EQ(received_msgids.size(), 10);
+    EXPECT_EQ(received_msgids[0], MAVLINK_MSG_ID_COMMAND_ACK);
+    EXPECT_EQ(received_msgids[1], MAVLINK_MSG_ID_HEARTBEAT);
+    for (size_t i = 2; i < received_msgids.size(); ++i) {
+        EXPECT_EQ(received_msgids[i], MAVLINK_MSG_ID_PARAM_EXT_VALUE);
+    }
+    EXPECT_EQ(queue.get_stats().dropped, 0);
+}
+
+TEST(MAVLinkDispatchQueue, AcksSurviveFullBulkRing)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool gate_open = false;
+    bool handler_blocked = false;
+    unsigned num_acks = 0;
+
+    MAVLinkDispatchQueue queue([&](const mavlink_message_t &message, const dl_time_t &) {
+        std::unique_lock<std::mutex> lock(mutex);
+        handler_blocked = true;
+        cv.notify_all();
+        cv.wait(lock, [&]() { return gate_open; });
+        if (message.msgid == MAVLINK_MSG_ID_COMMAND_ACK) {
+            ++num_acks;
+            cv.notify_all();
+        }
+    }, 2);
+    queue.start();
+
+    // Keeps the dispatch thread busy so that nothing else gets consumed.
+    mavlink_message_t message {};
+    message.msgid = MAVLINK_MSG_ID_HEARTBEAT;
+    EXPECT_TRUE(queue.push(message, dl_time_t()));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(1), [&]() { return handler_blocked; }));
+    }
+
+    // The bulk ring overflows.
+    message.msgid = MAVLINK_MSG_ID_PARAM_VALUE;
+    for (int i = 0; i < 4; ++i) {
+        queue.push(message, dl_time_t());
+    }
+    EXPECT_EQ(queue.get_stats().dropped, 2);
+
+    // More acks than fit into the control ring, these wait instead of being dropped.
+    std::thread pusher([&queue]() {
+        mavlink_message_t ack {};
+        ack.msgid = MAVLINK_MSG_ID_COMMAND_ACK;
+        for (int i = 0; i < 5; ++i) {
+            EXPECT_TRUE(queue.push(ack, dl_time_t()));
+        }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        gate_open = true;
+        cv.notify_all();
+        cv.wait_for(lock, std::chrono::seconds(1), [&]() { return num_acks == 5; });
+    }
+    pusher.join();
+    queue.stop();
+
+    EXPECT_EQ(num_acks, 5u);
+    EXPECT_EQ(queue.get_stats().dropped, 2);
+}
@@ -0,0 +1,400 @@
+#include "mavlink_ftp.h"
+#include "mavlink_system.h"
+#include "log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr size_t MAVLinkFTP::Payload::HEADER_LEN;
+constexpr size_t MAVLinkFTP::Payload::MAX_DATA_LEN;
+constexpr double MAVLinkFTP::TIMEOUT_S;
+constexpr unsigned MAVLinkFTP::MAX_RETRIES;
+constexpr uint32_t MAVLinkFTP::PROGRESS_STEP_BYTES;
+
+MAVLinkFTP::MAVLinkFTP(MAVLinkSystem &parent) :
+    _parent(parent)
+{
+    _parent.register_mavlink_message_handler(
+        MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL,
+        std::bind(&MAVLinkFTP::process_file_transfer_protocol, this, std::placeholders::_1),
+        this);
+}
+
+MAVLinkFTP::~MAVLinkFTP()
+{
+    _parent.unregister_all_mavlink_message_handlers(this);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &component : _components) {
+        _parent.unregister_timeout_handler(component.second->timeout_cookie);
+    }
+}
+
+void MAVLinkFTP::download_async(const std::string &remote_path, const std::string &local_path,
+                                progress_callback_t progress_callback,
+                                result_callback_t callback,
+                                uint8_t component_id)
+{
+    if (remote_path.size() > Payload::MAX_DATA_LEN) {
+        LogErr() << "FTP path too long: " << remote_path;
+        if (callback) {
+            callback(Result::FILE_NOT_FOUND);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &component = _components[component_id];
+    if (!component) {
+        component.reset(new Component());
+    }
+
+    component->transfers.push_back(Transfer {remote_path, local_path,
+                                             progress_callback, callback});
+    if (component->state == State::IDLE) {
+        start_next(component_id, *component);
+    }
+}
+
+void MAVLinkFTP::process_file_transfer_protocol(const mavlink_message_t &message)
+{
+    mavlink_file_transfer_protocol_t ftp;
+    mavlink_msg_file_transfer_protocol_decode(&message, &ftp);
+
+    if (ftp.target_system != GCSClient::system_id) {
+        return;
+    }
+
+    Payload payload;
+    payload.decode(ftp.payload);
+    if (payload.opcode != Opcode::ACK && payload.opcode != Opcode::NAK) {
+        return;
+    }
+
+    calls_t calls;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _components.find(message.compid);
+        if (it == _components.end()) {
+            return;
+        }
+        Component &component = *it->second;
+
+        switch (component.state) {
+            case State::RESETTING:
+                if (payload.req_opcode == Opcode::RESET_SESSIONS) {
+                    send_open(message.compid, component);
+                }
+                break;
+            case State::OPENING:
+                if (payload.req_opcode == Opcode::OPEN_FILE_RO) {
+                    process_open_response(message.compid, component, payload, calls);
+                }
+                break;
+            case State::READING:
+                if (payload.req_opcode == Opcode::BURST_READ_FILE &&
+                    payload.session == component.session) {
+                    process_read_response(message.compid, component, payload, calls);
+                }
+                break;
+            case State::IDLE:
+                break;
+        }
+    }
+
+    for (const auto &call : calls) {
+        call();
+    }
+}
+
+void MAVLinkFTP::process_open_response(uint8_t component_id, Component &component,
+                                       const Payload &payload, calls_t &calls)
+{
+    if (payload.opcode == Opcode::NAK) {
+        const Error error = static_cast<Error>(payload.data[0]);
+        // A session left open, e.g. by a transfer we lost track of.
+        if (error == Error::NO_SESSIONS_AVAILABLE && !component.reset_sent) {
+            component.reset_sent = true;
+            component.state = State::RESETTING;
+            send_request(component_id, component, Opcode::RESET_SESSIONS, 0, nullptr, 0);
+            return;
+        }
+        finish(component_id, component, result_from_error(error), calls);
+        return;
+    }
+
+    if (payload.size < sizeof(uint32_t)) {
+        finish(component_id, component, Result::FAILED, calls);
+        return;
+    }
+    uint32_t file_size;
+    std::memcpy(&file_size, payload.data, sizeof(file_size));
+
+    component.session = payload.session;
+    component.state = State::READING;
+    component.retries = 0;
+    component.reported_bytes = 0;
+
+    const auto &transfer = component.transfers.front();
+    if (!component.file.open(transfer.local_path, file_size)) {
+        LogErr() << "Could not open file " << transfer.local_path;
+        finish(component_id, component, Result::FAILED_TO_OPEN_LOCAL_FILE, calls);
+        return;
+    }
+    if (component.file.is_complete()) {
+        finish(component_id, component, Result::SUCCESS, calls);
+        return;
+    }
+
+    send_burst_read(component_id, component);
+}
+
+void MAVLinkFTP::process_read_response(uint8_t component_id, Component &component,
+                                       const Payload &payload, calls_t &calls)
+{
+    if (payload.opcode == Opcode::NAK) {
+        const Error error = static_cast<Error>(payload.data[0]);
+        // A burst past what we still need, start over at the first hole.
+        if (error == Error::END_OF_FILE && ++component.retries <= MAX_RETRIES) {
+            send_burst_read(component_id, component);
+            return;
+        }
+        finish(component_id, component, result_from_error(error), calls);
+        return;
+    }
+
+    _parent.refresh_timeout_handler(component.timeout_cookie);
+    component.retries = 0;
+
+    component.file.add(payload.offset, payload.data,
+                       std::min<uint32_t>(payload.size, Payload::MAX_DATA_LEN));
+
+    if (component.file.is_complete()) {
+        finish(component_id, component, Result::SUCCESS, calls);
+        return;
+    }
+
+    if (payload.burst_complete) {
+        send_burst_read(component_id, component);
+    }
+
+    const uint32_t received = component.file.received_bytes();
+    if (received >= component.reported_bytes + PROGRESS_STEP_BYTES) {
+        component.reported_bytes = received;
+        const auto &progress_callback = component.transfers.front().progress_callback;
+        if (progress_callback) {
+            const uint32_t total = component.file.size();
+            calls.push_back([progress_callback, received, total]() {
+                progress_callback(received, total);
+            });
+        }
+    }
+}
+
+void MAVLinkFTP::timed_out(uint8_t component_id)
+{
+    calls_t calls;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _components.find(component_id);
+        if (it == _components.end()) {
+            return;
+        }
+        Component &component = *it->second;
+        component.timeout_cookie = nullptr;
+        if (component.state == State::IDLE) {
+            return;
+        }
+
+        if (++component.retries > MAX_RETRIES) {
+            LogWarn() << "FTP transfer of " << component.transfers.front().remote_path
+                      << " timed out";
+            finish(component_id, component, Result::TIMEOUT, calls);
+        } else if (component.state == State::READING) {
+            // The rest of the burst is lost, the holes are read again.
+            send_burst_read(component_id, component);
+        } else {
+            send_payload(component_id, component.last_request);
+            _parent.register_timeout_handler(std::bind(&MAVLinkFTP::timed_out, this, component_id),
+                                             TIMEOUT_S, &component.timeout_cookie);
+        }
+    }
+
+    for (const auto &call : calls) {
+        call();
+    }
+}
+
+void MAVLinkFTP::start_next(uint8_t component_id, Component &component)
+{
+    if (component.transfers.empty()) {
+        component.state = State::IDLE;
+        return;
+    }
+
+    component.reset_sent = false;
+    component.retries = 0;
+    send_open(component_id, component);
+}
+
+void MAVLinkFTP::send_open(uint8_t component_id, Component &component)
+{
+    const auto &path = component.transfers.front().remote_path;
+
+    component.state = State::OPENING;
+    send_request(component_id, component, Opcode::OPEN_FILE_RO, 0,
+                 reinterpret_cast<const uint8_t *>(path.c_str()),
+                 static_cast<uint8_t>(path.size()));
+}
+
+void MAVLinkFTP::send_burst_read(uint8_t component_id, Component &component)
+{
+    // The size is that of the pieces to send, the burst goes on from the offset.
+    send_request(component_id, component, Opcode::BURST_READ_FILE,
+                 component.file.first_missing(), nullptr,
+                 static_cast<uint8_t>(Payload::MAX_DATA_LEN));
+}
+
+void MAVLinkFTP::send_request(uint8_t component_id, Component &component, Opcode opcode,
+                              uint32_t offset, const uint8_t *data, uint8_t size)
+{
+    Payload &payload = component.last_request;
+    payload = Payload {};
+    payload.seq_number = ++component.seq_number;
+    payload.session = component.session;
+    payload.opcode = opcode;
+    payload.size = size;
+    payload.offset = offset;
+    if (data != nullptr) {
+        std::memcpy(payload.data, data, size);
+    }
+
+    send_payload(component_id, payload);
+
+    _parent.unregister_timeout_handler(component.timeout_cookie);
+    _parent.register_timeout_handler(std::bind(&MAVLinkFTP::timed_out, this, component_id),
+                                     TIMEOUT_S, &component.timeout_cookie);
+}
+
+void MAVLinkFTP::send_payload(uint8_t component_id, const Payload &payload)
+{
+    uint8_t buffer[MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN] {};
+    payload.encode(buffer);
+
+    mavlink_message_t message;
+    mavlink_msg_file_transfer_protocol_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            0,
+                                            _parent.get_system_id(),
+                                            component_id,
+                                            buffer);
+    _parent.send_message(message);
+}
+
+void MAVLinkFTP::finish(uint8_t component_id, Component &component, Result result,
+                        calls_t &calls)
+{
+    _parent.unregister_timeout_handler(component.timeout_cookie);
+    component.timeout_cookie = nullptr;
+
+    if (component.state == State::READING) {
+        // Not waiting for the answer, a session left open is reset by the next open.
+        Payload payload {};
+        payload.seq_number = ++component.seq_number;
+        payload.session = component.session;
+        payload.opcode = Opcode::TERMINATE_SESSION;
+        send_payload(component_id, payload);
+    }
+
+    if (!component.file.close() && result == Result::SUCCESS) {
+        result = Result::FAILED_TO_WRITE_LOCAL_FILE;
+    }
+
+    const auto transfer = component.transfers.front();
+    component.transfers.pop_front();
+
+    if (result == Result::SUCCESS && transfer.progress_callback) {
+        const uint32_t total = component.file.size();
+        calls.push_back([transfer, total]() { transfer.progress_callback(total, total); });
+    }
+    if (transfer.callback) {
+        calls.push_back([transfer, result]() { transfer.callback(result); });
+    }
+
+    component.state = State::IDLE;
+    start_next(component_id, component);
+}
+
+MAVLinkFTP::Result MAVLinkFTP::result_from_error(Error error)
+{
+    switch (error) {
+        case Error::FILE_NOT_FOUND:
+            return Result::FILE_NOT_FOUND;
+        case Error::FILE_PROTECTED:
+            return Result::FILE_PROTECTED;
+        case Error::NO_SESSIONS_AVAILABLE:
+            return Result::NO_SESSION_AVAILABLE;
+        default:
+            return Result::FAILED;
+    }
+}
+
+const char *MAVLinkFTP::result_str(Result result)
+{
+    switch (result) {
+        case Result::SUCCESS:
+            return "Success";
+        case Result::FILE_NOT_FOUND:
+            return "File not found";
+        case Result::FILE_PROTECTED:
+            return "File protected";
+        case Result::NO_SESSION_AVAILABLE:
+            return "No session available";
+        case Result::FAILED:
+            return "Failed";
+        case Result::TIMEOUT:
+            return "Timeout";
+        case Result::FAILED_TO_OPEN_LOCAL_FILE:
+            return "Failed to open local file";
+        case Result::FAILED_TO_WRITE_LOCAL_FILE:
+            return "Failed to write local file";
+        default:
+            return "Unknown";
+    }
+}
+
+// All fields little-endian, as everything in MAVLink.
+void MAVLinkFTP::Payload::encode(uint8_t *buffer) const
+{
+    buffer[0] = static_cast<uint8_t>(seq_number & 0xFF);
+    buffer[1] = static_cast<uint8_t>(seq_number >> 8);
+    buffer[2] = session;
+    buffer[3] = static_cast<uint8_t>(opcode);
+    buffer[4] = size;
+    buffer[5] = static_cast<uint8_t>(req_opcode);
+    buffer[6] = burst_complete ? 1 : 0;
+    buffer[7] = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        buffer[8 + i] = static_cast<uint8_t>(offset >> (8 * i));
+    }
+    std::memcpy(buffer + HEADER_LEN, data, std::min<size_t>(size, MAX_DATA_LEN));
+}
+
+void MAVLinkFTP::Payload::decode(const uint8_t *buffer)
+{
+    seq_number = static_cast<uint16_t>(buffer[0] | (buffer[1] << 8));
+    session = buffer[2];
+    opcode = static_cast<Opcode>(buffer[3]);
+    size = buffer[4];
+    req_opcode = static_cast<Opcode>(buffer[5]);
+    burst_complete = (buffer[6] != 0);
+    offset = 0;
+    for (unsigned i = 0; i < 4; ++i) {
+        offset |= uint32_t(buffer[8 + i]) << (8 * i);
+    }
+    std::memcpy(data, buffer + HEADER_LEN, MAX_DATA_LEN);
+}
+
+} // namespace dronecore
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "file_reassembler.h"
+#include "mavlink_include.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+class MAVLinkSystem;
+
+// Client for the MAVLink FTP protocol, to fetch files from the components of
+// a system. Files are read with burst reads: the component streams the file
+// without waiting for a request per piece, pieces lost on the way are read
+// again afterwards, and everything is written straight into the local file.
+//
+// Components typically serve one session at a time, so transfers from one
+// component are queued, while transfers from different components run
+// concurrently.
+class MAVLinkFTP
+{
+public:
+    explicit MAVLinkFTP(MAVLinkSystem &parent);
+    ~MAVLinkFTP();
+
+    enum class Result {
+        SUCCESS,
+        FILE_NOT_FOUND,
+        FILE_PROTECTED,
+        NO_SESSION_AVAILABLE,
+        FAILED,
+        TIMEOUT,
+        FAILED_TO_OPEN_LOCAL_FILE,
+        FAILED_TO_WRITE_LOCAL_FILE
+    };
+
+    static const char *result_str(Result result);
+
+    typedef std::function<void(Result)> result_callback_t;
+    typedef std::function<void(uint32_t bytes_received, uint32_t bytes_total)>
+    progress_callback_t;
+
+    // Downloads a file of the component to local_path, which is overwritten if
+    // it exists. The callbacks are called on the thread receiving messages.
+    void download_async(const std::string &remote_path, const std::string &local_path,
+                        progress_callback_t progress_callback, result_callback_t callback,
+                        uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
+
+    // Non-copyable
+    MAVLinkFTP(const MAVLinkFTP &) = delete;
+    const MAVLinkFTP &operator=(const MAVLinkFTP &) = delete;
+
+private:
+    enum class Opcode : uint8_t {
+        NONE = 0,
+        TERMINATE_SESSION = 1,
+        RESET_SESSIONS = 2,
+        LIST_DIRECTORY = 3,
+        OPEN_FILE_RO = 4,
+        READ_FILE = 5,
+        CREATE_FILE = 6,
+        WRITE_FILE = 7,
+        REMOVE_FILE = 8,
+        CREATE_DIRECTORY = 9,
+        REMOVE_DIRECTORY = 10,
+        OPEN_FILE_WO = 11,
+        TRUNCATE_FILE = 12,
+        RENAME = 13,
+        CALC_FILE_CRC32 = 14,
+        BURST_READ_FILE = 15,
+        ACK = 128,
+        NAK = 129
+    };
+
+    enum class Error : uint8_t {
+        NONE = 0,
+        FAIL = 1,
+        FAIL_ERRNO = 2,
+        INVALID_DATA_SIZE = 3,
+        INVALID_SESSION = 4,
+        NO_SESSIONS_AVAILABLE = 5,
+        END_OF_FILE = 6,
+        UNKNOWN_COMMAND = 7,
+        FILE_EXISTS = 8,
+        FILE_PROTECTED = 9,
+        FILE_NOT_FOUND = 10
+    };
+
+    // The payload of FILE_TRANSFER_PROTOCOL, a header and the data.
+    struct Payload {
+        static constexpr size_t HEADER_LEN = 12;
+        static constexpr size_t MAX_DATA_LEN =
+            MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN - HEADER_LEN;
+
+        uint16_t seq_number;
+        uint8_t session;
+        Opcode opcode;
+        uint8_t size;
+        Opcode req_opcode;
+        bool burst_complete;
+        uint32_t offset;
+        uint8_t data[MAX_DATA_LEN];
+
+        void encode(uint8_t *buffer) const;
+        void decode(const uint8_t *buffer);
+    };
+
+    struct Transfer {
+        std::string remote_path;
+        std::string local_path;
+        progress_callback_t progress_callback;
+        result_callback_t callback;
+    };
+
+    enum class State {
+        IDLE,
+        RESETTING,
+        OPENING,
+        READING
+    };
+
+    struct Component {
+        // The front one is in progress.
+        std::deque<Transfer> transfers {};
+        State state {State::IDLE};
+        uint8_t session {0};
+        uint16_t seq_number {0};
+        Payload last_request {};
+        bool reset_sent {false};
+        unsigned retries {0};
+        uint32_t reported_bytes {0};
+        FileReassembler file {};
+        void *timeout_cookie {nullptr};
+    };
+
+    // User callbacks, called once the mutex is unlocked.
+    typedef std::vector<std::function<void()>> calls_t;
+
+    void process_file_transfer_protocol(const mavlink_message_t &message);
+    void timed_out(uint8_t component_id);
+
+    // The following are all called with the mutex locked.
+    void process_open_response(uint8_t component_id, Component &component,
+                               const Payload &payload, calls_t &calls);
+    void process_read_response(uint8_t component_id, Component &component,
+                               const Payload &payload, calls_t &calls);
+    void start_next(uint8_t component_id, Component &component);
+    void send_open(uint8_t component_id, Component &component);
+    void send_burst_read(uint8_t component_id, Component &component);
+    void send_request(uint8_t component_id, Component &component, Opcode opcode,
+                      uint32_t offset, const uint8_t *data, uint8_t size);
+    void send_payload(uint8_t component_id, const Payload &payload);
+    void finish(uint8_t component_id, Component &component, Result result, calls_t &calls);
+
+    static Result result_from_error(Error error);
+
+    static constexpr double TIMEOUT_S = 0.5;
+    static constexpr unsigned MAX_RETRIES = 5;
+    // Progress is reported in steps of this many bytes, not for every piece.
+    static constexpr uint32_t PROGRESS_STEP_BYTES = 64 * 1024;
+
+    MAVLinkSystem &_parent;
+
+    std::mutex _mutex {};
+    std::map<uint8_t, std::unique_ptr<Component>> _components {};
+};
+
+} // namespace dronecore
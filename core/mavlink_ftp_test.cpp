@@ -0,0 +1,418 @@
+#include "mavlink_ftp.h"
+#include "dronecore_impl.h"
+#include "mavlink_system.h"
+#include "mocks/recording_connection.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+using dronecore::testing::RecordingConnection;
+
+// Opcodes and errors of the protocol, as the component sends them.
+enum : uint8_t {
+    TERMINATE_SESSION = 1,
+    RESET_SESSIONS = 2,
+    OPEN_FILE_RO = 4,
+    BURST_READ_FILE = 15,
+    ACK = 128,
+    NAK = 129
+};
+
+enum : uint8_t {
+    NO_SESSIONS_AVAILABLE = 5,
+    END_OF_FILE = 6,
+    FILE_NOT_FOUND = 10
+};
+
+static constexpr uint32_t PIECE_LEN = MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN - 12;
+static constexpr uint32_t FILE_SIZE = 2 * PIECE_LEN + 122;
+static constexpr uint8_t SESSION = 3;
+
+static const std::string PATH = "mavlink_ftp_test.bin";
+
+// The payload of FILE_TRANSFER_PROTOCOL, laid out by hand here so that the
+// test checks the format on the wire.
+struct FtpPayload {
+    uint16_t seq_number {0};
+    uint8_t session {0};
+    uint8_t opcode {0};
+    uint8_t size {0};
+    uint8_t req_opcode {0};
+    bool burst_complete {false};
+    uint32_t offset {0};
+    std::vector<uint8_t> data {};
+
+    static FtpPayload decode(const uint8_t *buffer)
+    {
+        FtpPayload payload;
+        payload.seq_number = static_cast<uint16_t>(buffer[0] | (buffer[1] << 8));
+        payload.session = buffer[2];
+        payload.opcode = buffer[3];
+        payload.size = buffer[4];
+        payload.req_opcode = buffer[5];
+        payload.burst_complete = (buffer[6] != 0);
+        for (unsigned i = 0; i < 4; ++i) {
+            payload.offset |= uint32_t(buffer[8 + i]) << (8 * i);
+        }
+        payload.data.assign(buffer + 12, buffer + 12 + std::min<uint32_t>(payload.size,
+                                                                          PIECE_LEN));
+        return payload;
+    }
+
+    void encode(uint8_t *buffer) const
+    {
+        buffer[0] = static_cast<uint8_t>(seq_number & 0xFF);
+        buffer[1] = static_cast<uint8_t>(seq_number >> 8);
+        buffer[2] = session;
+        buffer[3] = opcode;
+        buffer[4] = size;
+        buffer[5] = req_opcode;
+        buffer[6] = burst_complete ? 1 : 0;
+        for (unsigned i = 0; i < 4; ++i) {
+            buffer[8 + i] = static_cast<uint8_t>(offset >> (8 * i));
+        }
+        std::copy(data.begin(), data.end(), buffer + 12);
+    }
+};
+
+uint8_t file_byte(uint32_t offset)
+{
+    return static_cast<uint8_t>(offset * 7);
+}
+
+std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+// The FTP client of system 1, with the test playing the autopilot. Replies
+// are handled right away, the timeouts run on the system thread.
+struct FtpHarness {
+    FtpHarness() :
+        dc(new DroneCoreImpl()),
+        connection(new RecordingConnection(*dc)),
+        system(new MAVLinkSystem(*dc, 1, MAV_COMP_ID_AUTOPILOT1)),
+        ftp(new MAVLinkFTP(*system))
+    {
+        // From now on, what is sent to system 1 goes to the connection.
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                                   MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+        dc->receive_message(message, *connection, std::chrono::steady_clock::now());
+    }
+
+    ~FtpHarness()
+    {
+        ftp.reset();
+        system.reset();
+        dc.reset();
+        std::remove(PATH.c_str());
+    }
+
+    // Downloads to PATH, the result is set once it is done.
+    std::future<MAVLinkFTP::Result> download(const std::string &remote_path)
+    {
+        auto prom = std::make_shared<std::promise<MAVLinkFTP::Result>>();
+        ftp->download_async(remote_path, PATH, [this](uint32_t received, uint32_t total) {
+            progress.push_back(std::make_pair(received, total));
+        }, [prom](MAVLinkFTP::Result result) {
+            prom->set_value(result);
+        });
+        return prom->get_future();
+    }
+
+    std::vector<FtpPayload> take_requests()
+    {
+        std::vector<FtpPayload> requests;
+        for (const auto &message : connection->take(MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL)) {
+            uint8_t buffer[MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN] {};
+            mavlink_msg_file_transfer_protocol_get_payload(&message, buffer);
+            requests.push_back(FtpPayload::decode(buffer));
+        }
+        return requests;
+    }
+
+    void reply(const FtpPayload &payload)
+    {
+        uint8_t buffer[MAVLINK_MSG_FILE_TRANSFER_PROTOCOL_FIELD_PAYLOAD_LEN] {};
+        payload.encode(buffer);
+        mavlink_message_t message;
+        mavlink_msg_file_transfer_protocol_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, 0,
+                                                GCSClient::system_id,
+                                                GCSClient::component_id, buffer);
+        system->process_mavlink_message(message);
+    }
+
+    void ack_open(uint32_t file_size)
+    {
+        FtpPayload payload;
+        payload.session = SESSION;
+        payload.opcode = ACK;
+        payload.req_opcode = OPEN_FILE_RO;
+        payload.size = sizeof(file_size);
+        for (unsigned i = 0; i < 4; ++i) {
+            payload.data.push_back(static_cast<uint8_t>(file_size >> (8 * i)));
+        }
+        reply(payload);
+    }
+
+    void nak(uint8_t req_opcode, uint8_t error)
+    {
+        FtpPayload payload;
+        payload.session = SESSION;
+        payload.opcode = NAK;
+        payload.req_opcode = req_opcode;
+        payload.size = 1;
+        payload.data.push_back(error);
+        reply(payload);
+    }
+
+    // A piece of a burst, of the file made of file_byte().
+    void send_piece(uint32_t offset, bool burst_complete = false)
+    {
+        FtpPayload payload;
+        payload.session = SESSION;
+        payload.opcode = ACK;
+        payload.req_opcode = BURST_READ_FILE;
+        payload.burst_complete = burst_complete;
+        payload.offset = offset;
+        payload.size = static_cast<uint8_t>(std::min(PIECE_LEN, FILE_SIZE - offset));
+        for (uint32_t i = offset; i < offset + payload.size; ++i) {
+            payload.data.push_back(file_byte(i));
+        }
+        reply(payload);
+    }
+
+    // Checks that the one request sent is a burst read from the offset.
+    void expect_burst_read(uint32_t offset)
+    {
+        const auto requests = take_requests();
+        ASSERT_EQ(requests.size(), 1u);
+        EXPECT_EQ(requests[0].opcode, BURST_READ_FILE);
+        EXPECT_EQ(requests[0].session, SESSION);
+        EXPECT_EQ(requests[0].offset, offset);
+    }
+
+    // Checks that the file is complete and that the session was closed.
+    void expect_downloaded(std::future<MAVLinkFTP::Result> &result)
+    {
+        ASSERT_EQ(result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+        EXPECT_EQ(result.get(), MAVLinkFTP::Result::SUCCESS);
+
+        const auto requests = take_requests();
+        ASSERT_EQ(requests.size(), 1u);
+        EXPECT_EQ(requests[0].opcode, TERMINATE_SESSION);
+        EXPECT_EQ(requests[0].session, SESSION);
+
+        const auto data = read_file(PATH);
+        ASSERT_EQ(data.size(), FILE_SIZE);
+        for (uint32_t i = 0; i < FILE_SIZE; ++i) {
+            ASSERT_EQ(data[i], file_byte(i)) << "at " << i;
+        }
+    }
+
+    std::unique_ptr<DroneCoreImpl> dc;
+    std::unique_ptr<RecordingConnection> connection;
+    std::unique_ptr<MAVLinkSystem> system;
+    std::unique_ptr<MAVLinkFTP> ftp;
+    std::vector<std::pair<uint32_t, uint32_t>> progress {};
+};
+
+} // namespace
+
+TEST(MAVLinkFTP, DownloadsInOneBurst)
+{
+    FtpHarness harness;
+    auto result = harness.download("/fs/microsd/log/log.ulg");
+
+    auto requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].opcode, OPEN_FILE_RO);
+    EXPECT_EQ(std::string(requests[0].data.begin(), requests[0].data.end()),
+              "/fs/microsd/log/log.ulg");
+
+    harness.ack_open(FILE_SIZE);
+    harness.expect_burst_read(0);
+
+    // The burst goes on without further requests.
+    harness.send_piece(0);
+    harness.send_piece(PIECE_LEN);
+    EXPECT_TRUE(harness.take_requests().empty());
+    harness.send_piece(2 * PIECE_LEN, true);
+
+    harness.expect_downloaded(result);
+    ASSERT_FALSE(harness.progress.empty());
+    EXPECT_EQ(harness.progress.back(), std::make_pair(FILE_SIZE, FILE_SIZE));
+}
+
+TEST(MAVLinkFTP, LostPiecesReadAgain)
+{
+    FtpHarness harness;
+    auto result = harness.download("/log.ulg");
+    harness.take_requests();
+    harness.ack_open(FILE_SIZE);
+    harness.expect_burst_read(0);
+
+    // The piece in the middle got lost, the next burst starts there.
+    harness.send_piece(0);
+    harness.send_piece(2 * PIECE_LEN, true);
+    harness.expect_burst_read(PIECE_LEN);
+
+    harness.send_piece(PIECE_LEN, true);
+    harness.expect_downloaded(result);
+}
+
+TEST(MAVLinkFTP, EndOfFileRestartsBurst)
+{
+    FtpHarness harness;
+    auto result = harness.download("/log.ulg");
+    harness.take_requests();
+    harness.ack_open(FILE_SIZE);
+    harness.expect_burst_read(0);
+
+    harness.send_piece(0);
+    harness.send_piece(2 * PIECE_LEN);
+    // The burst ran past the end, the hole is read again.
+    harness.nak(BURST_READ_FILE, END_OF_FILE);
+    harness.expect_burst_read(PIECE_LEN);
+
+    harness.send_piece(PIECE_LEN);
+    harness.expect_downloaded(result);
+}
+
+TEST(MAVLinkFTP, EndlessEndOfFileFails)
+{
+    FtpHarness harness;
+    auto result = harness.download("/log.ulg");
+    harness.take_requests();
+    harness.ack_open(FILE_SIZE);
+    harness.expect_burst_read(0);
+
+    // Burst read again as often as it retries, then given up.
+    for (int i = 0; i < 5; ++i) {
+        harness.nak(BURST_READ_FILE, END_OF_FILE);
+        harness.expect_burst_read(0);
+    }
+    harness.nak(BURST_READ_FILE, END_OF_FILE);
+
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(result.get(), MAVLinkFTP::Result::FAILED);
+    const auto requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].opcode, TERMINATE_SESSION);
+}
+
+TEST(MAVLinkFTP, OpenNakEndsTransferAndStartsNext)
+{
+    FtpHarness harness;
+    auto first_result = harness.download("/first.ulg");
+    auto second_result = harness.download("/second.ulg");
+
+    // One transfer at a time with the same component.
+    auto requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(std::string(requests[0].data.begin(), requests[0].data.end()), "/first.ulg");
+
+    harness.nak(OPEN_FILE_RO, FILE_NOT_FOUND);
+    ASSERT_EQ(first_result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(first_result.get(), MAVLinkFTP::Result::FILE_NOT_FOUND);
+
+    // No session to terminate, the next open follows right away.
+    requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].opcode, OPEN_FILE_RO);
+    EXPECT_EQ(std::string(requests[0].data.begin(), requests[0].data.end()), "/second.ulg");
+
+    harness.ack_open(FILE_SIZE);
+    harness.expect_burst_read(0);
+    harness.send_piece(0);
+    harness.send_piece(PIECE_LEN);
+    harness.send_piece(2 * PIECE_LEN, true);
+    harness.expect_downloaded(second_result);
+}
+
+TEST(MAVLinkFTP, ResetsSessionsOnce)
+{
+    FtpHarness harness;
+    auto result = harness.download("/log.ulg");
+    harness.take_requests();
+
+    // A session left open, they are reset and the open is tried again.
+    harness.nak(OPEN_FILE_RO, NO_SESSIONS_AVAILABLE);
+    auto requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].opcode, RESET_SESSIONS);
+
+    FtpPayload reset_ack;
+    reset_ack.opcode = ACK;
+    reset_ack.req_opcode = RESET_SESSIONS;
+    harness.reply(reset_ack);
+    requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].opcode, OPEN_FILE_RO);
+
+    // But only once.
+    harness.nak(OPEN_FILE_RO, NO_SESSIONS_AVAILABLE);
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+    EXPECT_EQ(result.get(), MAVLinkFTP::Result::NO_SESSION_AVAILABLE);
+    EXPECT_TRUE(harness.take_requests().empty());
+}
+
+TEST(MAVLinkFTP, RequestsResentOnTimeout)
+{
+    FtpHarness harness;
+    auto result = harness.download("/log.ulg");
+    auto requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    const uint16_t open_seq_number = requests[0].seq_number;
+
+    // The open got lost, the same request is sent again.
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 1u);
+    EXPECT_EQ(requests[0].opcode, OPEN_FILE_RO);
+    EXPECT_EQ(requests[0].seq_number, open_seq_number);
+
+    harness.ack_open(FILE_SIZE);
+    harness.expect_burst_read(0);
+
+    // The rest of the burst got lost, it goes on from the first hole.
+    harness.send_piece(0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    harness.expect_burst_read(PIECE_LEN);
+
+    harness.send_piece(PIECE_LEN);
+    harness.send_piece(2 * PIECE_LEN, true);
+    harness.expect_downloaded(result);
+}
+
+TEST(MAVLinkFTP, TimesOutAfterRetries)
+{
+    FtpHarness harness;
+    auto result = harness.download("/log.ulg");
+
+    ASSERT_EQ(result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+    EXPECT_EQ(result.get(), MAVLinkFTP::Result::TIMEOUT);
+
+    // Sent once and retried five times.
+    const auto requests = harness.take_requests();
+    ASSERT_EQ(requests.size(), 6u);
+    for (const auto &request : requests) {
+        EXPECT_EQ(request.opcode, OPEN_FILE_RO);
+        EXPECT_EQ(request.seq_number, requests[0].seq_number);
+    }
+}
@@ -4,4 +4,13 @@
 #pragma GCC system_header
 #endif
 
+#include "mavlink_crc.h"
+
+// Packing and the byte-wise parser use the table lookup as well.
+#define HAVE_CRC_ACCUMULATE
+static inline void crc_accumulate(uint8_t data, uint16_t *crcAccum)
+{
+    *crcAccum = dronecore::MAVLinkCrc::accumulate(*crcAccum, data);
+}
+
 #include <mavlink/v2.0/common/mavlink.h>
@@ -0,0 +1,148 @@
+#include "mavlink_message_pool.h"
+#include <algorithm>
+#include <utility>
+
+namespace dronecore {
+
+constexpr size_t MAVLinkMessagePool::CHUNK_SIZE;
+constexpr size_t MAVLinkMessagePool::MAX_BLOCKS;
+constexpr unsigned MAVLinkMessagePool::THREAD_CACHE_SIZE;
+
+MAVLinkMessagePool::Handle::Handle(const Handle &other) :
+    _block(other._block)
+{
+    if (_block != nullptr) {
+        _block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+MAVLinkMessagePool::Handle &MAVLinkMessagePool::Handle::operator=(Handle other)
+{
+    std::swap(_block, other._block);
+    return *this;
+}
+
+void MAVLinkMessagePool::Handle::reset()
+{
+    if (_block != nullptr && _block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        instance().give_back(_block);
+    }
+    _block = nullptr;
+}
+
+const mavlink_message_t &MAVLinkMessagePool::Handle::operator*() const
+{
+    return _block->message;
+}
+
+MAVLinkMessagePool &MAVLinkMessagePool::instance()
+{
+    // Deliberately leaked, see header.
+    static MAVLinkMessagePool *pool = new MAVLinkMessagePool();
+    return *pool;
+}
+
+MAVLinkMessagePool::ThreadCache &MAVLinkMessagePool::thread_cache()
+{
+    static thread_local ThreadCache cache {{}, 0};
+    return cache;
+}
+
+MAVLinkMessagePool::ThreadCache::~ThreadCache()
+{
+    MAVLinkMessagePool &pool = instance();
+    std::lock_guard<std::mutex> lock(pool._mutex);
+    pool.move_from_cache(*this, count);
+}
+
+MAVLinkMessagePool::Handle MAVLinkMessagePool::acquire(const mavlink_message_t &message)
+{
+    Block *block = take();
+    if (block == nullptr) {
+        return Handle();
+    }
+    block->message = message;
+    block->refs.store(1, std::memory_order_relaxed);
+    return Handle(block);
+}
+
+void MAVLinkMessagePool::reserve(size_t num_messages)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _num_reserved += num_messages;
+    while (_num_blocks < _num_reserved && grow()) {}
+}
+
+void MAVLinkMessagePool::unreserve(size_t num_messages)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _num_reserved -= std::min(num_messages, _num_reserved);
+}
+
+size_t MAVLinkMessagePool::get_num_blocks() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _num_blocks;
+}
+
+MAVLinkMessagePool::Block *MAVLinkMessagePool::take()
+{
+    ThreadCache &cache = thread_cache();
+    if (cache.count == 0) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_free == nullptr) {
+            // More in use than reserved, e.g. while handed over to another queue.
+            grow();
+        }
+        move_to_cache(cache, THREAD_CACHE_SIZE / 2);
+        if (cache.count == 0) {
+            return nullptr;
+        }
+    }
+    return cache.blocks[--cache.count];
+}
+
+void MAVLinkMessagePool::give_back(Block *block)
+{
+    ThreadCache &cache = thread_cache();
+    if (cache.count == THREAD_CACHE_SIZE) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        move_from_cache(cache, THREAD_CACHE_SIZE / 2);
+    }
+    cache.blocks[cache.count++] = block;
+}
+
+bool MAVLinkMessagePool::grow()
+{
+    if (_num_blocks + CHUNK_SIZE > MAX_BLOCKS) {
+        return false;
+    }
+
+    std::unique_ptr<Block[]> chunk(new Block[CHUNK_SIZE]);
+    for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+        chunk[i].next = _free;
+        _free = &chunk[i];
+    }
+    _chunks.push_back(std::move(chunk));
+    _num_blocks += CHUNK_SIZE;
+    return true;
+}
+
+void MAVLinkMessagePool::move_to_cache(ThreadCache &cache, unsigned num_blocks)
+{
+    for (unsigned i = 0; i < num_blocks && _free != nullptr; ++i) {
+        cache.blocks[cache.count++] = _free;
+        _free = _free->next;
+    }
+}
+
+void MAVLinkMessagePool::move_from_cache(ThreadCache &cache, unsigned num_blocks)
+{
+    for (unsigned i = 0; i < num_blocks && cache.count > 0; ++i) {
+        Block *block = cache.blocks[--cache.count];
+        block->next = _free;
+        _free = block;
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// Received messages waiting in a queue between two threads are kept in blocks
+// of this pool and passed on as refcounted handles, so they are copied once
+// when queued instead of at every hand-over, and without allocating.
+//
+// The blocks are allocated in chunks as queues reserve them and are never freed.
+// Each thread keeps a few free blocks of its own, the shared free list is only
+// locked to exchange several of them at once.
+class MAVLinkMessagePool
+{
+    struct Block;
+
+public:
+    // Shares one block, the message can't be changed anymore.
+    class Handle
+    {
+    public:
+        Handle() = default;
+        ~Handle() { reset(); }
+        Handle(const Handle &other);
+        Handle(Handle &&other) : _block(other._block) { other._block = nullptr; }
+        Handle &operator=(Handle other);
+
+        void reset();
+
+        explicit operator bool() const { return _block != nullptr; }
+        const mavlink_message_t &operator*() const;
+        const mavlink_message_t *operator->() const { return &**this; }
+
+    private:
+        friend class MAVLinkMessagePool;
+        explicit Handle(Block *block) : _block(block) {}
+
+        Block *_block {nullptr};
+    };
+
+    // Deliberately leaked, threads return their cached blocks when they exit.
+    static MAVLinkMessagePool &instance();
+
+    // Empty if the pool is exhausted.
+    Handle acquire(const mavlink_message_t &message);
+
+    // Makes sure there are blocks for this many more messages, e.g. for a queue
+    // which is created, and gives them back with unreserve() when it is destroyed.
+    void reserve(size_t num_messages);
+    void unreserve(size_t num_messages);
+
+    size_t get_num_blocks() const;
+
+    static constexpr size_t CHUNK_SIZE = 256;
+    static constexpr size_t MAX_BLOCKS = 64 * CHUNK_SIZE;
+    static constexpr unsigned THREAD_CACHE_SIZE = 32;
+
+    // Non-copyable
+    MAVLinkMessagePool(const MAVLinkMessagePool &) = delete;
+    const MAVLinkMessagePool &operator=(const MAVLinkMessagePool &) = delete;
+
+private:
+    MAVLinkMessagePool() = default;
+    ~MAVLinkMessagePool() = default;
+
+    struct Block {
+        mavlink_message_t message;
+        std::atomic<unsigned> refs;
+        Block *next;
+    };
+
+    struct ThreadCache {
+        ~ThreadCache();
+
+        Block *blocks[THREAD_CACHE_SIZE];
+        unsigned count;
+    };
+
+    static ThreadCache &thread_cache();
+
+    Block *take();
+    void give_back(Block *block);
+    // These need to be called with _mutex locked.
+    // Returns false at MAX_BLOCKS.
+    bool grow();
+    void move_to_cache(ThreadCache &cache, unsigned num_blocks);
+    void move_from_cache(ThreadCache &cache, unsigned num_blocks);
+
+    mutable std::mutex _mutex {};
+    std::vector<std::unique_ptr<Block[]>> _chunks {};
+    size_t _num_blocks {0};
+    size_t _num_reserved {0};
+    Block *_free {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,70 @@
+#include "mavlink_message_pool.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(MAVLinkMessagePool, HandlesShareMessage)
+{
+    MAVLinkMessagePool &pool = MAVLinkMessagePool::instance();
+    pool.reserve(1);
+
+    mavlink_message_t message {};
+    message.seq = 42;
+    MAVLinkMessagePool::Handle handle = pool.acquire(message);
+    ASSERT_TRUE(handle);
+    EXPECT_EQ(handle->seq, 42);
+
+    MAVLinkMessagePool::Handle copy = handle;
+    EXPECT_EQ(&*copy, &*handle);
+
+    MAVLinkMessagePool::Handle moved = std::move(handle);
+    EXPECT_FALSE(handle);
+    EXPECT_EQ(&*moved, &*copy);
+
+    moved.reset();
+    EXPECT_EQ(copy->seq, 42);
+
+    pool.unreserve(1);
+}
+
+TEST(MAVLinkMessagePool, ReservesBlocks)
+{
+    MAVLinkMessagePool &pool = MAVLinkMessagePool::instance();
+    const size_t num_blocks = pool.get_num_blocks();
+
+    pool.reserve(num_blocks + 1);
+    EXPECT_GE(pool.get_num_blocks(), num_blocks + 1);
+    pool.unreserve(num_blocks + 1);
+}
+
+TEST(MAVLinkMessagePool, HandOverBetweenThreads)
+{
+    MAVLinkMessagePool &pool = MAVLinkMessagePool::instance();
+    constexpr unsigned num_messages = 100000;
+    constexpr unsigned batch_size = 100;
+    pool.reserve(batch_size);
+    const size_t num_blocks = pool.get_num_blocks();
+
+    // Acquired on this thread, released on another one, as between two stages.
+    for (unsigned i = 0; i < num_messages / batch_size; ++i) {
+        std::vector<MAVLinkMessagePool::Handle> batch;
+        for (unsigned j = 0; j < batch_size; ++j) {
+            mavlink_message_t message {};
+            message.seq = uint8_t(j);
+            batch.push_back(pool.acquire(message));
+            ASSERT_TRUE(batch.back());
+        }
+        std::thread([&batch]() {
+            for (unsigned j = 0; j < batch.size(); ++j) {
+                EXPECT_EQ(batch[j]->seq, uint8_t(j));
+            }
+            batch.clear();
+        }).join();
+    }
+
+    // The blocks came back, nothing new was needed.
+    EXPECT_EQ(pool.get_num_blocks(), num_blocks);
+    pool.unreserve(batch_size);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include "handler_profiler.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace dronecore {
+
+// Maps a decoded MAVLink message struct to its message ID and decode function,
+// so handlers can be registered by type. Using a message without a
+// specialization below is a compile error.
+template <typename T>
+struct MAVLinkMessageTraits;
+
+#define DRONECORE_MAVLINK_MESSAGE(name, NAME) \
+    template <> \
+    struct MAVLinkMessageTraits<mavlink_##name##_t> { \
+        static constexpr uint32_t ID = MAVLINK_MSG_ID_##NAME; \
+        static void decode(const mavlink_message_t &message, mavlink_##name##_t &decoded) \
+        { \
+            mavlink_msg_##name##_decode(&message, &decoded); \
+        } \
+    }
+
+DRONECORE_MAVLINK_MESSAGE(heartbeat, HEARTBEAT);
+DRONECORE_MAVLINK_MESSAGE(sys_status, SYS_STATUS);
+DRONECORE_MAVLINK_MESSAGE(gps_raw_int, GPS_RAW_INT);
+DRONECORE_MAVLINK_MESSAGE(attitude, ATTITUDE);
+DRONECORE_MAVLINK_MESSAGE(attitude_quaternion, ATTITUDE_QUATERNION);
+DRONECORE_MAVLINK_MESSAGE(local_position_ned, LOCAL_POSITION_NED);
+DRONECORE_MAVLINK_MESSAGE(global_position_int, GLOBAL_POSITION_INT);
+DRONECORE_MAVLINK_MESSAGE(rc_channels, RC_CHANNELS);
+DRONECORE_MAVLINK_MESSAGE(home_position, HOME_POSITION);
+DRONECORE_MAVLINK_MESSAGE(extended_sys_state, EXTENDED_SYS_STATE);
+DRONECORE_MAVLINK_MESSAGE(mount_orientation, MOUNT_ORIENTATION);
+DRONECORE_MAVLINK_MESSAGE(highres_imu, HIGHRES_IMU);
+DRONECORE_MAVLINK_MESSAGE(actuator_control_target, ACTUATOR_CONTROL_TARGET);
+DRONECORE_MAVLINK_MESSAGE(param_value, PARAM_VALUE);
+DRONECORE_MAVLINK_MESSAGE(autopilot_version, AUTOPILOT_VERSION);
+DRONECORE_MAVLINK_MESSAGE(timesync, TIMESYNC);
+DRONECORE_MAVLINK_MESSAGE(terrain_request, TERRAIN_REQUEST);
+DRONECORE_MAVLINK_MESSAGE(position_target_local_ned, POSITION_TARGET_LOCAL_NED);
+
+#undef DRONECORE_MAVLINK_MESSAGE
+
+// All typed handlers of one message ID. The message gets decoded once, only
+// when it arrives, and the same struct is handed to each of them together with
+// the message for the header (sysid, compid).
+class TypedDispatcherBase
+{
+public:
+    virtual ~TypedDispatcherBase() = default;
+
+    // Each handler is run through the profiler, under the system given.
+    virtual void dispatch(const mavlink_message_t &message, HandlerProfiler &profiler,
+                          const void *system) const = 0;
+
+    // A copy without the handlers of the cookie, nullptr if none are left.
+    virtual std::shared_ptr<const TypedDispatcherBase> without(const void *cookie) const = 0;
+};
+
+template <typename T>
+class TypedDispatcher : public TypedDispatcherBase
+{
+public:
+    typedef std::function<void(const mavlink_message_t &, const T &)> handler_t;
+
+    void dispatch(const mavlink_message_t &message, HandlerProfiler &profiler,
+                  const void *system) const override
+    {
+        T decoded;
+        MAVLinkMessageTraits<T>::decode(message, decoded);
+        for (const auto &entry : _entries) {
+            profiler.run(entry.slot, {system, entry.cookie, MAVLinkMessageTraits<T>::ID},
+            [&entry, &message, &decoded]() {
+                entry.handler(message, decoded);
+            });
+        }
+    }
+
+    std::shared_ptr<const TypedDispatcherBase> without(const void *cookie) const override
+    {
+        auto copy = std::make_shared<TypedDispatcher<T>>();
+        for (const auto &entry : _entries) {
+            if (entry.cookie != cookie) {
+                copy->_entries.push_back(entry);
+            }
+        }
+        if (copy->_entries.empty()) {
+            return nullptr;
+        }
+        return copy;
+    }
+
+    // Dispatchers are immutable once in the handler table, so adding makes a copy.
+    std::shared_ptr<const TypedDispatcherBase> with(const handler_t &handler,
+                                                    const void *cookie) const
+    {
+        auto copy = std::make_shared<TypedDispatcher<T>>(*this);
+        copy->_entries.push_back(Entry {handler, cookie, {}});
+        return copy;
+    }
+
+private:
+    struct Entry {
+        handler_t handler;
+        const void *cookie;
+        // Copies of the dispatcher count into the same timings.
+        HandlerProfiler::Slot slot;
+    };
+
+    std::vector<Entry> _entries {};
+};
+
+} // namespace dronecore
@@ -1,14 +1,18 @@
 #include "mavlink_parameters.h"
 #include "mavlink_system.h"
+#include <fstream>
+#include <sstream>
+#include <cstdio> // for std::rename
+#include <algorithm>
+#include <memory>
 
 namespace dronecore {
 
 MAVLinkParameters::MAVLinkParameters(MAVLinkSystem &parent) :
     _parent(parent)
 {
-    _parent.register_mavlink_message_handler(
-        MAVLINK_MSG_ID_PARAM_VALUE,
-        std::bind(&MAVLinkParameters::process_param_value, this, std::placeholders::_1), this);
+    _parent.register_message_handler<mavlink_param_value_t>(
+        this, &MAVLinkParameters::process_param_value);
 
     _parent.register_mavlink_message_handler(
         MAVLINK_MSG_ID_PARAM_EXT_VALUE,
@@ -17,17 +21,28 @@ MAVLinkParameters::MAVLinkParameters(MAVLinkSystem &parent) :
     _parent.register_mavlink_message_handler(
         MAVLINK_MSG_ID_PARAM_EXT_ACK,
         std::bind(&MAVLinkParameters::process_param_ext_ack, this, std::placeholders::_1), this);
+
+    _memory_account = _parent.get_memory_account("params");
 }
 
 MAVLinkParameters::~MAVLinkParameters()
 {
     _parent.unregister_all_mavlink_message_handlers(this);
+    _parent.unregister_timeout_handler(_cache_timeout_cookie);
+    _memory_account->release(_accounted_bytes);
+
+    std::lock_guard<std::mutex> lock(_state_mutex);
+    _parent.unregister_timeout_handler(_get_params_timeout_cookie);
+    for (const auto &work : _set_param_in_flight) {
+        _parent.unregister_timeout_handler(work.timeout_cookie);
+    }
 }
 
 void MAVLinkParameters::set_param_async(const std::string &name,
                                         const ParamValue &value,
                                         set_param_callback_t callback,
-                                        bool extended)
+                                        bool extended,
+                                        uint8_t component_id)
 {
     // if (value.is_float()) {
     //     LogDebug() << "setting param " << name << " to " << value.get_float();
@@ -35,7 +50,7 @@ void MAVLinkParameters::set_param_async(const std::string &name,
     //     LogDebug() << "setting param " << name << " to " << value.get_int();
     // }
 
-    if (name.size() > PARAM_ID_LEN) {
+    if (!ParamKey::fits(name)) {
         LogErr() << "Error: param name too long";
         if (callback) {
             callback(false);
@@ -45,22 +60,80 @@ void MAVLinkParameters::set_param_async(const std::string &name,
 
     SetParamWork new_work;
     new_work.callback = callback;
-    new_work.param_name = name;
+    new_work.key = ParamKey(name);
     new_work.param_value = value;
     new_work.extended = extended;
+    new_work.component_id = extended ? component_id : 0;
+
+    _set_param_inbox.push(new_work);
+    _parent.wake_system_thread();
+}
 
-    _set_param_queue.push_back(new_work);
+void MAVLinkParameters::set_params_async(const std::map<std::string, ParamValue> &params,
+                                         set_params_callback_t callback,
+                                         bool extended,
+                                         uint8_t component_id)
+{
+    set_params(params, nullptr, callback, extended, component_id);
+}
+
+void MAVLinkParameters::set_params(const std::map<std::string, ParamValue> &params,
+                                   progress_callback_t progress_callback,
+                                   set_params_callback_t callback,
+                                   bool extended,
+                                   uint8_t component_id)
+{
+    struct BatchResult {
+        std::mutex mutex {};
+        size_t num_done = 0;
+        std::vector<std::string> failed_params {};
+    };
+
+    if (params.empty()) {
+        if (callback) {
+            callback(true, std::vector<std::string>());
+        }
+        return;
+    }
 
+    auto result = std::make_shared<BatchResult>();
+    const size_t num_total = params.size();
+
+    for (const auto &param : params) {
+        const std::string name = param.first;
+        set_param_async(name, param.second,
+        [result, name, num_total, progress_callback, callback](bool success) {
+            size_t num_done;
+            std::vector<std::string> failed_params {};
+            {
+                std::lock_guard<std::mutex> lock(result->mutex);
+                if (!success) {
+                    result->failed_params.push_back(name);
+                }
+                num_done = ++result->num_done;
+                if (num_done == num_total) {
+                    failed_params = result->failed_params;
+                }
+            }
+            if (progress_callback) {
+                progress_callback(num_done, num_total);
+            }
+            if (num_done == num_total && callback) {
+                callback(failed_params.empty(), failed_params);
+            }
+        }, extended, component_id);
+    }
 }
 
 
 void MAVLinkParameters::get_param_async(const std::string &name,
                                         get_param_callback_t callback,
-                                        bool extended)
+                                        bool extended,
+                                        uint8_t component_id)
 {
     // LogDebug() << "getting param " << name << ", extended: " << (extended ? "yes" : "no");
 
-    if (name.size() > PARAM_ID_LEN) {
+    if (!ParamKey::fits(name)) {
         LogErr() << "Error: param name too long";
         if (callback) {
             ParamValue empty_param;
@@ -69,12 +142,178 @@ void MAVLinkParameters::get_param_async(const std::string &name,
         return;
     }
 
+    const ParamKey key(name);
+    if (!extended) {
+        ParamValue value;
+        if (get_param_from_cache(key, value)) {
+            if (callback) {
+                callback(true, value);
+            }
+            return;
+        }
+    }
+
     GetParamWork new_work;
     new_work.callback = callback;
-    new_work.param_name = name;
+    new_work.key = key;
     new_work.extended = extended;
+    new_work.component_id = extended ? component_id : 0;
 
-    _get_param_queue.push_back(new_work);
+    _get_param_inbox.push(new_work);
+    _parent.wake_system_thread();
+}
+
+void MAVLinkParameters::get_params_ext_async(const std::vector<std::string> &names,
+                                             get_params_callback_t callback,
+                                             uint8_t component_id)
+{
+    GetParamsWork new_work;
+    new_work.callback = callback;
+    new_work.component_id = component_id;
+
+    for (const auto &name : names) {
+        if (!ParamKey::fits(name)) {
+            LogErr() << "Error: param name too long";
+            continue;
+        }
+        const ParamKey key(name);
+        if (std::find(new_work.missing.begin(), new_work.missing.end(), key) ==
+            new_work.missing.end()) {
+            new_work.missing.push_back(key);
+        }
+    }
+
+    _get_params_inbox.push(new_work);
+    _parent.wake_system_thread();
+}
+
+void MAVLinkParameters::request_all_params_async()
+{
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+        if (_cache_state == CacheState::DOWNLOADING ||
+            _cache_state == CacheState::VALIDATING) {
+            return;
+        }
+        start_download();
+    }
+
+    send_param_request_list();
+}
+
+void MAVLinkParameters::use_snapshot(const std::string &path)
+{
+    param_map_t params {};
+    uint32_t hash = 0;
+    const bool loaded = load_snapshot(path, params, hash);
+
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+        _snapshot_path = path;
+
+        if (_cache_state == CacheState::DOWNLOADING ||
+            _cache_state == CacheState::VALIDATING) {
+            return;
+        }
+
+        if (!loaded) {
+            start_download();
+        } else {
+            _snapshot = params;
+            _snapshot_hash = hash;
+            account_cache_bytes();
+            _cache_state = CacheState::VALIDATING;
+            _parent.register_timeout_handler(std::bind(&MAVLinkParameters::cache_timeout, this),
+                                             CACHE_STALL_TIMEOUT_S,
+                                             &_cache_timeout_cookie);
+        }
+    }
+
+    if (loaded) {
+        send_param_request_read(ParamKey(HASH_CHECK_PARAM_ID));
+    } else {
+        send_param_request_list();
+    }
+}
+
+void MAVLinkParameters::apply_param_file_async(const std::string &path,
+                                               progress_callback_t progress_callback,
+                                               set_params_callback_t callback)
+{
+    ApplyParamFileWork work;
+    if (!load_param_file(path, work.params)) {
+        LogErr() << "Error: could not load params file " << path;
+        if (callback) {
+            callback(false, std::vector<std::string>());
+        }
+        return;
+    }
+    work.progress_callback = progress_callback;
+    work.callback = callback;
+
+    bool request_list = false;
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+        _apply_param_file_pending.push_back(work);
+        if (_cache_state == CacheState::NONE) {
+            start_download();
+            request_list = true;
+        }
+    }
+
+    if (request_list) {
+        send_param_request_list();
+    }
+
+    // Right away if the cache is complete already.
+    apply_pending_param_files();
+}
+
+void MAVLinkParameters::apply_pending_param_files()
+{
+    std::vector<ApplyParamFileWork> ready {};
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+        if (_cache_state != CacheState::COMPLETE) {
+            return;
+        }
+        ready.swap(_apply_param_file_pending);
+
+        for (auto &work : ready) {
+            // Params missing in the cache are set too, after an incomplete
+            // download we can't tell if the autopilot has them.
+            for (auto it = work.params.begin(); it != work.params.end();) {
+                auto cached = _cache.find(ParamKey(it->first));
+                if (cached != _cache.end() && cached->second.is_same_value(it->second)) {
+                    it = work.params.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    for (const auto &work : ready) {
+        LogDebug() << "Setting " << work.params.size() << " changed params from file";
+        set_params(work.params, work.progress_callback, work.callback, false, 0);
+    }
+}
+
+void MAVLinkParameters::start_download()
+{
+    _cache_state = CacheState::DOWNLOADING;
+    _cache_have_index.clear();
+    _cache_num_received = 0;
+    _cache_num_received_last_round = 0;
+    _cache_rounds_without_progress = 0;
+    _cache_have_hash = false;
+    _cache_saved = false;
+    _snapshot.clear();
+    account_cache_bytes();
+
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::cache_timeout, this),
+                                     CACHE_STALL_TIMEOUT_S,
+                                     &_cache_timeout_cookie);
 }
 
 //void MAVLinkParameters::save_async()
@@ -87,105 +326,91 @@ void MAVLinkParameters::do_work()
 {
     std::lock_guard<std::mutex> lock(_state_mutex);
 
-    if (_state != State::NONE) {
-        // If we're still busy, let's wait
-        return;
+    SetParamWork new_set_work;
+    while (_set_param_inbox.try_pop(new_set_work)) {
+        _set_param_queue.push_back(new_set_work);
+    }
+    GetParamWork new_get_work;
+    while (_get_param_inbox.try_pop(new_get_work)) {
+        _get_param_queue.push_back(new_get_work);
+    }
+    GetParamsWork new_get_params_work;
+    while (_get_params_inbox.try_pop(new_get_params_work)) {
+        _get_params_queue.push_back(new_get_params_work);
     }
 
-    if (_set_param_queue.size() > 0) {
-        // There params to set which we always do first
-        SetParamWork &work = _set_param_queue.front();
-
-        // We need to wait for this param to get sent back as confirmation.
-        _state = State::SET_PARAM_BUSY;
-
-        char param_id[PARAM_ID_LEN] = {};
-        STRNCPY(param_id, work.param_name.c_str(), sizeof(param_id));
-
-        mavlink_message_t message = {};
-        if (work.extended) {
-
-            char param_value_buf[128] = {};
-            work.param_value.get_128_bytes(param_value_buf);
+    // Keep the window of set requests full, they are acked one by one.
+    while (_set_param_in_flight.size() < SET_PARAM_WINDOW && !_set_param_queue.empty()) {
+        SetParamWork work = _set_param_queue.front();
 
-            // FIXME: extended currently always go to the camera component
-            mavlink_msg_param_ext_set_pack(GCSClient::system_id,
-                                           GCSClient::component_id,
-                                           &message,
-                                           _parent.get_system_id(),
-                                           MAV_COMP_ID_CAMERA,
-                                           param_id,
-                                           param_value_buf,
-                                           work.param_value.get_mav_param_ext_type());
-        } else {
-            // Param set is intended for Autopilot only.
-            mavlink_msg_param_set_pack(GCSClient::system_id,
-                                       GCSClient::component_id,
-                                       &message,
-                                       _parent.get_system_id(),
-                                       _parent.get_autopilot_id(),
-                                       param_id,
-                                       work.param_value.get_4_float_bytes(),
-                                       work.param_value.get_mav_param_type());
+        if (find_set_param_in_flight(work.key, work.component_id) !=
+            _set_param_in_flight.end()) {
+            // Two sets of the same param can't be told apart by their acks,
+            // and later sets need to win, so wait for the first one.
+            break;
         }
+        _set_param_queue.pop_front();
 
-        if (!_parent.send_message(message)) {
+        if (!send_set_param(work)) {
             LogErr() << "Error: Send message failed";
             if (work.callback) {
                 work.callback(false);
             }
-            _state = State::NONE;
-            return;
+            continue;
         }
 
-        // _last_request_time = _parent.get_time().steady_time();
+        work.sent_time = _parent.get_time().steady_time();
+        register_set_param_timeout(work);
+        _set_param_in_flight.push_back(work);
+    }
 
-        // We want to get notified if a timeout happens
-        _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_timeout, this),
-                                         0.5,
-                                         &_timeout_cookie);
+    if (!_set_param_in_flight.empty() || !_set_param_queue.empty()) {
+        // Sets go first, so a get after a set returns the new value.
+        return;
+    }
+
+    // The answers to the list are told apart by name, so this can run next to
+    // the single gets.
+    if (!_get_params_busy && !_get_params_queue.empty()) {
+        start_get_params();
+    }
+
+    if (_state != State::NONE) {
+        // If we're still busy, let's wait
+        return;
+    }
 
-    } else if (_get_param_queue.size() > 0) {
+    if (!_get_param_queue.empty()) {
 
         GetParamWork work = _get_param_queue.front();
 
+        if (!work.extended) {
+            ParamValue value;
+            if (get_param_from_cache(work.key, value)) {
+                _get_param_queue.pop_front();
+                if (work.callback) {
+                    work.callback(true, value);
+                }
+                _parent.wake_system_thread();
+                return;
+            }
+
+            std::lock_guard<std::mutex> cache_lock(_cache_mutex);
+            if (_cache_state == CacheState::DOWNLOADING ||
+                _cache_state == CacheState::VALIDATING) {
+                // The param is most likely on its way already, no need to
+                // ask for it separately.
+                return;
+            }
+        }
+
         // The busy flag gets reset when the param comes in
         // or after a timeout.
         _state = State::GET_PARAM_BUSY;
 
-        char param_id[PARAM_ID_LEN] = {};
-        STRNCPY(param_id, work.param_name.c_str(), sizeof(param_id));
-
-        // LogDebug() << "now getting: " << work.param_name;
-
-        mavlink_message_t message = {};
-        if (work.extended) {
-            mavlink_msg_param_ext_request_read_pack(GCSClient::system_id,
-                                                    GCSClient::component_id,
-                                                    &message,
-                                                    _parent.get_system_id(),
-                                                    MAV_COMP_ID_CAMERA,
-                                                    param_id,
-                                                    -1);
-
-        } else {
-            //LogDebug() << "request read: "
-            //    << (int)GCSClient::system_id << ":"
-            //    << (int)GCSClient::component_id <<
-            //    " to "
-            //    << (int)_parent.get_system_id() << ":"
-            //    << (int)_parent.get_autopilot_id();
-
-            mavlink_msg_param_request_read_pack(GCSClient::system_id,
-                                                GCSClient::component_id,
-                                                &message,
-                                                _parent.get_system_id(),
-                                                _parent.get_autopilot_id(),
-                                                param_id,
-                                                -1);
-        }
+        // LogDebug() << "now getting: " << work.key.str();
 
-        if (!_parent.send_message(message)) {
+        if (!send_get_param(work)) {
             LogErr() << "Error: Send message failed";
             if (work.callback) {
                 ParamValue empty_param;
@@ -195,35 +420,75 @@ void MAVLinkParameters::do_work()
             return;
         }
 
-        // _last_request_time = _parent.get_time().steady_time();
+        _last_request_time = _parent.get_time().steady_time();
 
         // We want to get notified if a timeout happens
-        _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_timeout, this),
-                                         0.5,
-                                         &_timeout_cookie);
+        register_get_param_timeout(work);
     }
 }
 
-void MAVLinkParameters::process_param_value(const mavlink_message_t &message)
+bool MAVLinkParameters::send_get_param(const GetParamWork &work)
+{
+    char param_id[PARAM_ID_LEN] = {};
+    work.key.copy_to(param_id);
+
+    mavlink_message_t message = {};
+    if (work.extended) {
+        mavlink_msg_param_ext_request_read_pack(GCSClient::system_id,
+                                                GCSClient::component_id,
+                                                &message,
+                                                _parent.get_system_id(),
+                                                work.component_id,
+                                                param_id,
+                                                -1);
+
+    } else {
+        mavlink_msg_param_request_read_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            _parent.get_system_id(),
+                                            _parent.get_autopilot_id(),
+                                            param_id,
+                                            -1);
+    }
+
+    return _parent.send_message(message);
+}
+
+void MAVLinkParameters::register_get_param_timeout(const GetParamWork &work)
+{
+    // Back off with every retry in case the link is just slower than estimated.
+    const double timeout_s = std::min(
+                                 _parent.get_rtt_estimator().get_timeout_s() * (1 << work.retries_done),
+                                 RttEstimator::MAX_TIMEOUT_S);
+
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::receive_timeout, this),
+                                     timeout_s,
+                                     &_timeout_cookie);
+}
+
+void MAVLinkParameters::process_param_value(const mavlink_param_value_t &param_value)
 {
     // LogDebug() << "getting param value";
 
-    mavlink_param_value_t param_value;
-    mavlink_msg_param_value_decode(&message, &param_value);
+    update_cache(param_value);
 
     std::lock_guard<std::mutex> lock(_state_mutex);
 
-    if (_state == State::NONE) {
-        return;
+    const ParamKey key(param_value.param_id);
+    auto in_flight = find_set_param_in_flight(key, 0);
+    if (in_flight != _set_param_in_flight.end() && !in_flight->extended) {
+        // The param is sent back as confirmation of a set.
+        finish_set_param(in_flight, true);
     }
 
     if (_state == State::GET_PARAM_BUSY) {
 
         // This means we should have a queue entry to use
-        if (_get_param_queue.size() > 0) {
+        if (!_get_param_queue.empty()) {
             GetParamWork &work = _get_param_queue.front();
 
-            if (strncmp(work.param_name.c_str(), param_value.param_id, PARAM_ID_LEN) == 0) {
+            if (work.key == key) {
 
                 if (work.callback) {
                     ParamValue value;
@@ -232,33 +497,17 @@ void MAVLinkParameters::process_param_value(const mavlink_message_t &message)
                 }
                 _state = State::NONE;
                 _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
+                // After a retry we can't tell which request was answered.
+                if (work.retries_done == 0) {
+                    _parent.get_rtt_estimator().add_sample(
+                        _parent.get_time().elapsed_since_s(_last_request_time));
+                }
                 _get_param_queue.pop_front();
+                _parent.wake_system_thread();
             }
         }
     }
 
-    else if (_state == State::SET_PARAM_BUSY) {
-
-        // This means we should have a queue entry to use
-        if (_set_param_queue.size() > 0) {
-            SetParamWork &work = _set_param_queue.front();
-
-            // Now it still needs to match the param name
-            if (strncmp(work.param_name.c_str(), param_value.param_id, PARAM_ID_LEN) == 0) {
-
-                // We are done, inform caller and go back to idle
-                if (work.callback) {
-                    work.callback(true);
-                }
-
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
-            }
-        }
-    }
 }
 
 void MAVLinkParameters::process_param_ext_value(const mavlink_message_t &message)
@@ -267,8 +516,14 @@ void MAVLinkParameters::process_param_ext_value(const mavlink_message_t &message
     mavlink_param_ext_value_t param_ext_value;
     mavlink_msg_param_ext_value_decode(&message, &param_ext_value);
 
+    update_ext_values(message.compid, param_ext_value);
+
     std::lock_guard<std::mutex> lock(_state_mutex);
 
+    if (_get_params_busy && _get_params_queue.front().component_id == message.compid) {
+        handle_get_params_value(param_ext_value);
+    }
+
     if (_state == State::NONE) {
         return;
     }
@@ -276,10 +531,11 @@ void MAVLinkParameters::process_param_ext_value(const mavlink_message_t &message
     if (_state == State::GET_PARAM_BUSY) {
 
         // This means we should have a queue entry to use
-        if (_get_param_queue.size() > 0) {
+        if (!_get_param_queue.empty()) {
             GetParamWork &work = _get_param_queue.front();
 
-            if (strncmp(work.param_name.c_str(), param_ext_value.param_id, PARAM_ID_LEN) == 0) {
+            if (work.component_id == message.compid &&
+                work.key == ParamKey(param_ext_value.param_id)) {
 
                 if (work.callback) {
                     ParamValue value;
@@ -288,35 +544,16 @@ void MAVLinkParameters::process_param_ext_value(const mavlink_message_t &message
                 }
                 _state = State::NONE;
                 _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _get_param_queue.pop_front();
-            }
-        }
-    }
-
-#if 0
-    else if (_state == State::SET_PARAM_BUSY) {
-
-        // This means we should have a queue entry to use
-        if (_set_param_queue.size() > 0) {
-            SetParamWork &work = _set_param_queue.front();
-
-            // Now it still needs to match the param name
-            if (strncmp(work.param_name.c_str(), param_ext_value.param_id, PARAM_ID_LEN) == 0) {
-
-                // We are done, inform caller and go back to idle
-                if (work.callback) {
-                    work.callback(true);
+                // After a retry we can't tell which request was answered.
+                if (work.retries_done == 0) {
+                    _parent.get_rtt_estimator().add_sample(
+                        _parent.get_time().elapsed_since_s(_last_request_time));
                 }
-
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
+                _get_param_queue.pop_front();
+                _parent.wake_system_thread();
             }
         }
     }
-#endif
 }
 
 void MAVLinkParameters::process_param_ext_ack(const mavlink_message_t &message)
@@ -328,50 +565,27 @@ void MAVLinkParameters::process_param_ext_ack(const mavlink_message_t &message)
 
     std::lock_guard<std::mutex> lock(_state_mutex);
 
-    if (_state != State::SET_PARAM_BUSY) {
+    auto in_flight = find_set_param_in_flight(ParamKey(param_ext_ack.param_id), message.compid);
+    if (in_flight == _set_param_in_flight.end() || !in_flight->extended) {
         return;
     }
 
-    // This means we should have a queue entry to use
-    if (_set_param_queue.size() > 0) {
-        SetParamWork &work = _set_param_queue.front();
+    if (param_ext_ack.param_result == PARAM_ACK_ACCEPTED) {
+        // We are done, inform caller
+        finish_set_param(in_flight, true);
 
-        // Now it still needs to match the param name
-        if (strncmp(work.param_name.c_str(), param_ext_ack.param_id, PARAM_ID_LEN) == 0) {
+    } else if (param_ext_ack.param_result == PARAM_ACK_IN_PROGRESS) {
 
-            if (param_ext_ack.param_result == PARAM_ACK_ACCEPTED) {
-                // We are done, inform caller and go back to idle
-                if (work.callback) {
-                    work.callback(true);
-                }
+        // Reset timeout and wait again.
+        _parent.refresh_timeout_handler(in_flight->timeout_cookie);
 
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
-
-            } else if (param_ext_ack.param_result == PARAM_ACK_IN_PROGRESS) {
+    } else {
 
-                // Reset timeout and wait again.
-                _parent.refresh_timeout_handler(_timeout_cookie);
-
-            } else {
+        LogErr() << "Somehow we did not get an ack, we got: " << int(param_ext_ack.param_result);
 
-                LogErr() << "Somehow we did not get an ack, we got: " << int(param_ext_ack.param_result);
-
-                // We are done but unsuccessful
-                // TODO: we need better error feedback
-                if (work.callback) {
-                    work.callback(false);
-                }
-
-                _state = State::NONE;
-                _parent.unregister_timeout_handler(_timeout_cookie);
-                // LogDebug() << "time taken: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                _set_param_queue.pop_front();
-            }
-
-        }
+        // We are done but unsuccessful
+        // TODO: we need better error feedback
+        finish_set_param(in_flight, false);
     }
 }
 
@@ -386,14 +600,26 @@ void MAVLinkParameters::receive_timeout()
 
     if (_state == State::GET_PARAM_BUSY) {
 
+        // The timeout handler is gone after firing.
+        _timeout_cookie = nullptr;
+
         // This means work has been going on that we should try again
-        if (_get_param_queue.size() > 0) {
+        if (!_get_param_queue.empty()) {
             GetParamWork &work = _get_param_queue.front();
 
+            if (work.retries_done < GET_PARAM_MAX_RETRIES) {
+                ++work.retries_done;
+                LogDebug() << "Retrying get param " << work.key.str();
+                if (send_get_param(work)) {
+                    register_get_param_timeout(work);
+                    return;
+                }
+            }
+
             if (work.callback) {
                 ParamValue empty_value;
                 // Notify about timeout
-                LogErr() << "Error: get param busy timeout: " << work.param_name;
+                LogErr() << "Error: get param busy timeout: " << work.key.str();
                 // LogErr() << "Got it after: " << _parent.get_time().elapsed_since_s(_last_request_time);
                 work.callback(false, empty_value);
             }
@@ -402,22 +628,729 @@ void MAVLinkParameters::receive_timeout()
         }
     }
 
-    else if (_state == State::SET_PARAM_BUSY) {
+}
 
-        // This means work has been going on that we should try again
-        if (_set_param_queue.size() > 0) {
-            SetParamWork &work = _set_param_queue.front();
+void MAVLinkParameters::set_param_timeout(ParamKey key, uint8_t component_id)
+{
+    std::lock_guard<std::mutex> lock(_state_mutex);
 
-            if (work.callback) {
-                // Notify about timeout
-                LogErr() << "Error: set param busy timeout: " << work.param_name;
-                // LogErr() << "Got it after: " << _parent.get_time().elapsed_since_s(_last_request_time);
-                work.callback(false);
+    auto in_flight = find_set_param_in_flight(key, component_id);
+    if (in_flight == _set_param_in_flight.end()) {
+        return;
+    }
+
+    // The timeout handler is gone after firing.
+    in_flight->timeout_cookie = nullptr;
+
+    if (in_flight->retries_done < SET_PARAM_MAX_RETRIES) {
+        ++in_flight->retries_done;
+        LogDebug() << "Retrying set param " << key.str();
+        if (send_set_param(*in_flight)) {
+            register_set_param_timeout(*in_flight);
+            return;
+        }
+    }
+
+    // Notify about timeout
+    LogErr() << "Error: set param busy timeout: " << key.str();
+    finish_set_param(in_flight, false);
+}
+
+std::vector<MAVLinkParameters::SetParamWork>::iterator
+MAVLinkParameters::find_set_param_in_flight(const ParamKey &key, uint8_t component_id)
+{
+    // Cameras have params of the same names.
+    return std::find_if(_set_param_in_flight.begin(), _set_param_in_flight.end(),
+    [&key, component_id](const SetParamWork & work) {
+        return work.component_id == component_id && work.key == key;
+    });
+}
+
+bool MAVLinkParameters::send_set_param(const SetParamWork &work)
+{
+    char param_id[PARAM_ID_LEN] = {};
+    work.key.copy_to(param_id);
+
+    mavlink_message_t message = {};
+    if (work.extended) {
+
+        char param_value_buf[128] = {};
+        work.param_value.get_128_bytes(param_value_buf);
+
+        mavlink_msg_param_ext_set_pack(GCSClient::system_id,
+                                       GCSClient::component_id,
+                                       &message,
+                                       _parent.get_system_id(),
+                                       work.component_id,
+                                       param_id,
+                                       param_value_buf,
+                                       work.param_value.get_mav_param_ext_type());
+    } else {
+        // Param set is intended for Autopilot only.
+        mavlink_msg_param_set_pack(GCSClient::system_id,
+                                   GCSClient::component_id,
+                                   &message,
+                                   _parent.get_system_id(),
+                                   _parent.get_autopilot_id(),
+                                   param_id,
+                                   work.param_value.get_4_float_bytes(),
+                                   work.param_value.get_mav_param_type());
+    }
+
+    return _parent.send_message(message);
+}
+
+void MAVLinkParameters::register_set_param_timeout(SetParamWork &work)
+{
+    // Back off with every retry in case the link is just slower than estimated.
+    const double timeout_s = std::min(
+                                 _parent.get_rtt_estimator().get_timeout_s() * (1 << work.retries_done),
+                                 RttEstimator::MAX_TIMEOUT_S);
+
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::set_param_timeout, this,
+                                               work.key, work.component_id),
+                                     timeout_s,
+                                     &work.timeout_cookie);
+}
+
+void MAVLinkParameters::finish_set_param(std::vector<SetParamWork>::iterator in_flight,
+                                         bool success)
+{
+    _parent.unregister_timeout_handler(in_flight->timeout_cookie);
+
+    // After a retry we can't tell which request was answered.
+    if (success && in_flight->retries_done == 0) {
+        _parent.get_rtt_estimator().add_sample(
+            _parent.get_time().elapsed_since_s(in_flight->sent_time));
+    }
+
+    set_param_callback_t callback = in_flight->callback;
+    _set_param_in_flight.erase(in_flight);
+
+    if (callback) {
+        callback(success);
+    }
+    // There is room in the window again.
+    _parent.wake_system_thread();
+}
+
+void MAVLinkParameters::start_get_params()
+{
+    _get_params_busy = true;
+    GetParamsWork &work = _get_params_queue.front();
+
+    if (work.missing.empty()) {
+        finish_get_params(true);
+        return;
+    }
+
+    if (!send_param_ext_request_list(work.component_id)) {
+        LogErr() << "Error: Send message failed";
+        read_missing_params(work);
+    }
+
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::get_params_timeout, this),
+                                     CACHE_STALL_TIMEOUT_S,
+                                     &_get_params_timeout_cookie);
+}
+
+void MAVLinkParameters::handle_get_params_value(const mavlink_param_ext_value_t &param_ext_value)
+{
+    GetParamsWork &work = _get_params_queue.front();
+
+    const ParamKey key(param_ext_value.param_id);
+
+    auto missing = std::find(work.missing.begin(), work.missing.end(), key);
+    if (missing == work.missing.end()) {
+        return;
+    }
+    work.missing.erase(missing);
+    work.values[key.str()].set_from_mavlink_param_ext_value(param_ext_value);
+
+    if (work.missing.empty()) {
+        finish_get_params(true);
+        return;
+    }
+
+    _parent.refresh_timeout_handler(_get_params_timeout_cookie);
+
+    auto reading = std::find(work.reading.begin(), work.reading.end(), key);
+    if (reading != work.reading.end()) {
+        work.reading.erase(reading);
+        read_missing_params(work);
+    }
+}
+
+void MAVLinkParameters::read_missing_params(GetParamsWork &work)
+{
+    // Keep the window of reads full.
+    for (const auto &key : work.missing) {
+        if (work.reading.size() >= GET_PARAMS_WINDOW) {
+            break;
+        }
+        if (std::find(work.reading.begin(), work.reading.end(), key) != work.reading.end()) {
+            continue;
+        }
+        if (!send_param_ext_request_read(key, work.component_id)) {
+            LogErr() << "Error: Send message failed";
+            break;
+        }
+        work.reading.push_back(key);
+    }
+}
+
+void MAVLinkParameters::finish_get_params(bool success)
+{
+    _parent.unregister_timeout_handler(_get_params_timeout_cookie);
+
+    GetParamsWork work = _get_params_queue.front();
+    _get_params_queue.pop_front();
+    _get_params_busy = false;
+
+    if (work.callback) {
+        work.callback(success, work.values);
+    }
+    // The next one can start.
+    _parent.wake_system_thread();
+}
+
+void MAVLinkParameters::get_params_timeout()
+{
+    std::lock_guard<std::mutex> lock(_state_mutex);
+
+    // The timeout handler is gone after firing.
+    _get_params_timeout_cookie = nullptr;
+
+    if (!_get_params_busy) {
+        return;
+    }
+    GetParamsWork &work = _get_params_queue.front();
+
+    if (work.values.size() == work.num_received_last_round) {
+        if (++work.rounds_without_progress > CACHE_MAX_ROUNDS_WITHOUT_PROGRESS) {
+            LogErr() << "Error: get params timeout, " << work.missing.size() << " missing";
+            finish_get_params(false);
+            return;
+        }
+    } else {
+        work.rounds_without_progress = 0;
+    }
+    work.num_received_last_round = work.values.size();
+
+    // Either the list stalled or reads got lost, ask again for what is missing.
+    work.reading.clear();
+    read_missing_params(work);
+
+    _parent.register_timeout_handler(std::bind(&MAVLinkParameters::get_params_timeout, this),
+                                     _parent.get_rtt_estimator().get_timeout_s(),
+                                     &_get_params_timeout_cookie);
+}
+
+bool MAVLinkParameters::send_param_ext_request_list(uint8_t component_id)
+{
+    mavlink_message_t message = {};
+    mavlink_msg_param_ext_request_list_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            _parent.get_system_id(),
+                                            component_id);
+
+    return _parent.send_message(message);
+}
+
+bool MAVLinkParameters::send_param_ext_request_read(const ParamKey &key,
+                                                     uint8_t component_id)
+{
+    char param_id[PARAM_ID_LEN] = {};
+    key.copy_to(param_id);
+
+    mavlink_message_t message = {};
+    mavlink_msg_param_ext_request_read_pack(GCSClient::system_id,
+                                            GCSClient::component_id,
+                                            &message,
+                                            _parent.get_system_id(),
+                                            component_id,
+                                            param_id,
+                                            -1);
+
+    return _parent.send_message(message);
+}
+
+bool MAVLinkParameters::get_param_from_cache(const ParamKey &key, ParamValue &value)
+{
+    std::lock_guard<std::mutex> lock(_cache_mutex);
+
+    auto it = _cache.find(key);
+    if (it == _cache.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+void MAVLinkParameters::update_cache(const mavlink_param_value_t &param_value)
+{
+    bool download_done = false;
+    bool request_list = false;
+    bool save = false;
+    param_map_t params_to_save {};
+    std::string snapshot_path {};
+    uint32_t hash = 0;
+
+    const ParamKey key(param_value.param_id);
+    ParamValue value;
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+
+        if (key == ParamKey(HASH_CHECK_PARAM_ID)) {
+            if (_cache_state != CacheState::NONE) {
+                memcpy(&hash, &param_value.param_value, sizeof(hash));
+                handle_hash(hash, request_list, save);
+                download_done = (_cache_state == CacheState::COMPLETE);
+            }
+
+        } else if (_cache_state != CacheState::VALIDATING) {
+
+            // Every value the vehicle sends is kept, also without a download,
+            // so that the cache follows changes made by anyone else.
+            value.set_from_mavlink_param_value(param_value);
+            const size_t num_cached = _cache.size();
+            ParamValue &cached = _cache[key];
+            changed = !cached.is_same_value(value);
+            cached = value;
+            if (_cache.size() != num_cached) {
+                account_cache_bytes();
+            }
+
+            if (_cache_state == CacheState::DOWNLOADING) {
+                if (param_value.param_count != _cache_have_index.size()) {
+                    // The first param in, or the param count changed under us.
+                    _cache_have_index.assign(param_value.param_count, false);
+                    _cache_num_received = 0;
+                }
+
+                if (param_value.param_index < _cache_have_index.size() &&
+                    !_cache_have_index[param_value.param_index]) {
+                    _cache_have_index[param_value.param_index] = true;
+                    ++_cache_num_received;
+                }
+
+                if (_cache_num_received == _cache_have_index.size()) {
+                    LogDebug() << "Received all " << _cache_num_received << " params";
+                    _cache_state = CacheState::COMPLETE;
+                    _parent.unregister_timeout_handler(_cache_timeout_cookie);
+                    download_done = true;
+                    save = should_save_snapshot();
+                } else {
+                    _parent.refresh_timeout_handler(_cache_timeout_cookie);
+                }
             }
-            _state = State::NONE;
-            _set_param_queue.pop_front();
+        }
+
+        if (save) {
+            _cache_saved = true;
+            params_to_save = _cache;
+            snapshot_path = _snapshot_path;
+            hash = _cache_hash;
         }
     }
+
+    if (changed) {
+        notify_param_changed(key.str(), value, false, 0);
+    }
+
+    if (request_list) {
+        send_param_request_list();
+    }
+
+    if (save && !save_snapshot(snapshot_path, params_to_save, hash)) {
+        LogWarn() << "Could not save param snapshot to " << snapshot_path;
+    }
+
+    if (download_done) {
+        apply_pending_param_files();
+        // Get requests have been waiting for the download.
+        _parent.wake_system_thread();
+    }
+}
+
+void MAVLinkParameters::update_ext_values(uint8_t component_id,
+                                          const mavlink_param_ext_value_t &param_ext_value)
+{
+    const ParamKey key(param_ext_value.param_id);
+
+    ParamValue value;
+    value.set_from_mavlink_param_ext_value(param_ext_value);
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+        param_map_t &values = _ext_values[component_id];
+        const size_t num_values = values.size();
+        ParamValue &last = values[key];
+        if (values.size() != num_values) {
+            account_cache_bytes();
+        }
+        if (last.is_same_value(value)) {
+            return;
+        }
+        last = value;
+    }
+
+    notify_param_changed(key.str(), value, true, component_id);
+}
+
+void MAVLinkParameters::notify_param_changed(const std::string &name, const ParamValue &value,
+                                             bool extended, uint8_t component_id)
+{
+    std::vector<param_changed_callback_t> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(_subscriptions_mutex);
+        for (const auto &subscription : _param_subscriptions) {
+            if (subscription.extended == extended &&
+                (!extended || subscription.component_id == component_id) &&
+                (subscription.name.empty() || subscription.name == name)) {
+                callbacks.push_back(subscription.callback);
+            }
+        }
+    }
+
+    for (const auto &callback : callbacks) {
+        callback(name, value);
+    }
+}
+
+MAVLinkParameters::param_subscription_handle_t
+MAVLinkParameters::subscribe_param(const std::string &name, param_changed_callback_t callback,
+                                   bool extended, uint8_t component_id)
+{
+    if (!callback) {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(_subscriptions_mutex);
+    const param_subscription_handle_t handle = _next_param_subscription_handle++;
+    _param_subscriptions.push_back(
+        ParamSubscription {handle, name, extended, extended ? component_id : uint8_t(0), callback});
+    return handle;
+}
+
+void MAVLinkParameters::unsubscribe_param(param_subscription_handle_t handle)
+{
+    std::lock_guard<std::mutex> lock(_subscriptions_mutex);
+    _param_subscriptions.erase(
+        std::remove_if(_param_subscriptions.begin(), _param_subscriptions.end(),
+    [handle](const ParamSubscription & subscription) {
+        return subscription.handle == handle;
+    }), _param_subscriptions.end());
+}
+
+void MAVLinkParameters::handle_hash(uint32_t hash, bool &request_list, bool &save)
+{
+    if (_cache_state == CacheState::VALIDATING) {
+        _parent.unregister_timeout_handler(_cache_timeout_cookie);
+
+        if (hash == _snapshot_hash) {
+            LogDebug() << "Using param snapshot " << _snapshot_path;
+            _cache = _snapshot;
+            _snapshot.clear();
+            account_cache_bytes();
+            _cache_hash = hash;
+            _cache_have_hash = true;
+            // Nothing new to save.
+            _cache_saved = true;
+            _cache_state = CacheState::COMPLETE;
+        } else {
+            LogDebug() << "Param snapshot outdated, downloading all params";
+            start_download();
+            request_list = true;
+        }
+        return;
+    }
+
+    _cache_hash = hash;
+    _cache_have_hash = true;
+    save = should_save_snapshot();
+}
+
+void MAVLinkParameters::account_cache_bytes()
+{
+    // A node holds the entry, the next pointer and the hash, a bucket is a pointer.
+    auto map_bytes = [](const param_map_t & map) {
+        return map.size() * (sizeof(param_map_t::value_type) + sizeof(void *) + sizeof(size_t)) +
+               map.bucket_count() * sizeof(void *);
+    };
+
+    size_t bytes = map_bytes(_cache) + map_bytes(_snapshot);
+    for (const auto &values : _ext_values) {
+        bytes += map_bytes(values.second);
+    }
+
+    if (bytes > _accounted_bytes) {
+        _memory_account->charge(bytes - _accounted_bytes);
+    } else {
+        _memory_account->release(_accounted_bytes - bytes);
+    }
+    _accounted_bytes = bytes;
+}
+
+bool MAVLinkParameters::should_save_snapshot() const
+{
+    // Only save complete downloads, the hash covers all params.
+    return !_snapshot_path.empty() &&
+           !_cache_saved &&
+           _cache_have_hash &&
+           _cache_state == CacheState::COMPLETE &&
+           !_cache_have_index.empty() &&
+           _cache_num_received == _cache_have_index.size();
+}
+
+void MAVLinkParameters::cache_timeout()
+{
+    bool request_list = false;
+    bool download_done = false;
+    std::vector<int16_t> missing {};
+    {
+        std::lock_guard<std::mutex> lock(_cache_mutex);
+
+        if (_cache_state == CacheState::VALIDATING) {
+            // No hash came back, so we can't trust the snapshot.
+            LogDebug() << "No param hash received, downloading all params";
+            start_download();
+            request_list = true;
+
+        } else if (_cache_state == CacheState::DOWNLOADING) {
+
+            if (_cache_num_received > _cache_num_received_last_round) {
+                _cache_rounds_without_progress = 0;
+            } else {
+                ++_cache_rounds_without_progress;
+            }
+            _cache_num_received_last_round = _cache_num_received;
+
+            if (_cache_rounds_without_progress >= CACHE_MAX_ROUNDS_WITHOUT_PROGRESS) {
+                LogWarn() << "Param download incomplete: " << _cache_num_received
+                          << " of " << _cache_have_index.size();
+                // Whatever is still missing is requested by name on demand.
+                _cache_state = CacheState::COMPLETE;
+                download_done = true;
+
+            } else {
+                if (_cache_have_index.empty()) {
+                    // Not a single param has come in, so the list request got lost.
+                    request_list = true;
+                } else {
+                    for (size_t i = 0; i < _cache_have_index.size(); ++i) {
+                        if (!_cache_have_index[i]) {
+                            missing.push_back(int16_t(i));
+                            if (missing.size() >= CACHE_MAX_READS_PER_ROUND) {
+                                break;
+                            }
+                        }
+                    }
+                }
+
+                _parent.register_timeout_handler(
+                    std::bind(&MAVLinkParameters::cache_timeout, this),
+                    CACHE_STALL_TIMEOUT_S,
+                    &_cache_timeout_cookie);
+            }
+        } else {
+            return;
+        }
+    }
+
+    if (request_list) {
+        send_param_request_list();
+    }
+
+    for (auto param_index : missing) {
+        send_param_request_read(param_index);
+    }
+
+    if (download_done) {
+        apply_pending_param_files();
+    }
+
+    if (!request_list && missing.empty()) {
+        _parent.wake_system_thread();
+    }
+}
+
+void MAVLinkParameters::send_param_request_list()
+{
+    mavlink_message_t message = {};
+    mavlink_msg_param_request_list_pack(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        _parent.get_system_id(),
+                                        _parent.get_autopilot_id());
+
+    if (!_parent.send_message(message)) {
+        LogErr() << "Error: Send message failed";
+    }
+}
+
+void MAVLinkParameters::send_param_request_read(int16_t param_index)
+{
+    // An empty param_id means the param is requested by index.
+    char param_id[PARAM_ID_LEN] = {};
+
+    mavlink_message_t message = {};
+    mavlink_msg_param_request_read_pack(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        _parent.get_system_id(),
+                                        _parent.get_autopilot_id(),
+                                        param_id,
+                                        param_index);
+
+    if (!_parent.send_message(message)) {
+        LogErr() << "Error: Send message failed";
+    }
+}
+
+void MAVLinkParameters::send_param_request_read(const ParamKey &key)
+{
+    char param_id[PARAM_ID_LEN] = {};
+    key.copy_to(param_id);
+
+    mavlink_message_t message = {};
+    mavlink_msg_param_request_read_pack(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        _parent.get_system_id(),
+                                        _parent.get_autopilot_id(),
+                                        param_id,
+                                        -1);
+
+    if (!_parent.send_message(message)) {
+        LogErr() << "Error: Send message failed";
+    }
+}
+
+// The snapshot is a text file with the hash in the first line, followed by one
+// line per param with name, MAV_PARAM_TYPE and the raw 4 bytes of the value.
+bool MAVLinkParameters::load_snapshot(const std::string &path, param_map_t &params,
+                                      uint32_t &hash)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) ||
+        std::sscanf(line.c_str(), "hash %u", &hash) != 1) {
+        LogWarn() << "Invalid param snapshot " << path;
+        return false;
+    }
+
+    while (std::getline(file, line)) {
+        std::istringstream line_stream(line);
+        std::string name;
+        unsigned type;
+        uint32_t bits;
+        if (!(line_stream >> name >> type >> bits) || !ParamKey::fits(name)) {
+            LogWarn() << "Invalid param snapshot " << path;
+            return false;
+        }
+
+        mavlink_param_value_t param_value {};
+        memcpy(&param_value.param_value, &bits, sizeof(bits));
+        param_value.param_type = uint8_t(type);
+
+        ParamValue value;
+        value.set_from_mavlink_param_value(param_value);
+        params[ParamKey(name)] = value;
+    }
+
+    return !params.empty();
+}
+
+bool MAVLinkParameters::save_snapshot(const std::string &path, const param_map_t &params,
+                                      uint32_t hash)
+{
+    // Write to a temporary file first, so a crash can't leave half a snapshot.
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file << "hash " << hash << '\n';
+        for (const auto &param : params) {
+            const float value = param.second.get_4_float_bytes();
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            file << param.first.str() << ' ' << unsigned(param.second.get_mav_param_type())
+                 << ' ' << bits << '\n';
+        }
+
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool MAVLinkParameters::load_param_file(const std::string &path,
+                                        std::map<std::string, ParamValue> &params)
+{
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream line_stream(line);
+        unsigned vehicle_id;
+        unsigned component_id;
+        std::string name;
+        std::string value_str;
+        unsigned type;
+        if (!(line_stream >> vehicle_id >> component_id >> name >> value_str >> type) ||
+            !ParamKey::fits(name)) {
+            LogWarn() << "Invalid params file line: " << line;
+            return false;
+        }
+
+        if (component_id != MAV_COMP_ID_AUTOPILOT1) {
+            continue;
+        }
+
+        char *end = nullptr;
+        ParamValue value;
+        switch (type) {
+            case MAV_PARAM_TYPE_INT32:
+                value.set_int32(int32_t(std::strtol(value_str.c_str(), &end, 10)));
+                break;
+            case MAV_PARAM_TYPE_UINT32:
+                // Sent as int32 like in ParamValue::set_from_mavlink_param_value().
+                value.set_int32(int32_t(std::strtoul(value_str.c_str(), &end, 10)));
+                break;
+            case MAV_PARAM_TYPE_REAL32:
+                value.set_float(std::strtof(value_str.c_str(), &end));
+                break;
+            default:
+                LogWarn() << "Unsupported type " << type << " of param " << name;
+                return false;
+        }
+        if (end == value_str.c_str() || *end != '\0') {
+            LogWarn() << "Invalid value of param " << name << ": " << value_str;
+            return false;
+        }
+
+        params[name] = value;
+    }
+
+    return true;
 }
 
 std::ostream &operator<<(std::ostream &strm, const MAVLinkParameters::ParamValue &obj)
@@ -3,13 +3,22 @@
 #include "log.h"
 #include "global_include.h"
 #include "mavlink_include.h"
-#include "locked_queue.h"
-#include "any.h"
+#include "memory_budget.h"
+#include "mpsc_queue.h"
+#include "param_key.h"
 #include <cstdint>
 #include <string>
 #include <functional>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <utility>
+#include <deque>
+#include <vector>
+#include <mutex>
 #include <cstring> // for memcpy
 #include <cassert>
+#include <cstdlib> // for abort
 
 namespace dronecore {
 
@@ -21,17 +30,14 @@ public:
     explicit MAVLinkParameters(MAVLinkSystem &parent);
     ~MAVLinkParameters();
 
+    // Holds one param value of any of the MAVLink param types. The numeric
+    // types are kept in place, so values can be copied around without
+    // allocating. Only custom (extended) values need the heap.
     class ParamValue
     {
     public:
         typedef char custom_type_t[128];
 
-        ParamValue &operator= (ParamValue value)
-        {
-            _value = value._value;
-            return *this;
-        }
-
         void set_from_mavlink_param_value(mavlink_param_value_t mavlink_value)
         {
             switch (mavlink_value.param_type) {
@@ -40,13 +46,13 @@ public:
                 case MAV_PARAM_TYPE_INT32: {
                         int32_t temp;
                         memcpy(&temp, &mavlink_value.param_value, sizeof(temp));
-                        _value = temp;
+                        set_int32(temp);
                     }
                     break;
                 case MAV_PARAM_TYPE_REAL32:
                     float temp;
                     memcpy(&temp, &mavlink_value.param_value, sizeof(temp));
-                    _value = temp;
+                    set_float(temp);
                     break;
                 default:
                     // This would be worrying
@@ -57,72 +63,52 @@ public:
 
         void set_from_mavlink_param_ext_value(mavlink_param_ext_value_t mavlink_ext_value)
         {
+            const char *bytes = &mavlink_ext_value.param_value[0];
+
             switch (mavlink_ext_value.param_type) {
-                case MAV_PARAM_EXT_TYPE_UINT8: {
-                        uint8_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT8:
+                    set_type(Type::UINT8);
+                    memcpy(&_value.u8, bytes, sizeof(_value.u8));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT8: {
-                        int8_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT8:
+                    set_type(Type::INT8);
+                    memcpy(&_value.i8, bytes, sizeof(_value.i8));
                     break;
-                case MAV_PARAM_EXT_TYPE_UINT16: {
-                        uint16_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT16:
+                    set_type(Type::UINT16);
+                    memcpy(&_value.u16, bytes, sizeof(_value.u16));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT16: {
-                        int16_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT16:
+                    set_type(Type::INT16);
+                    memcpy(&_value.i16, bytes, sizeof(_value.i16));
                     break;
-                case MAV_PARAM_EXT_TYPE_UINT32: {
-                        uint32_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT32:
+                    set_type(Type::UINT32);
+                    memcpy(&_value.u32, bytes, sizeof(_value.u32));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT32: {
-                        int32_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT32:
+                    set_type(Type::INT32);
+                    memcpy(&_value.i32, bytes, sizeof(_value.i32));
                     break;
-                case MAV_PARAM_EXT_TYPE_UINT64: {
-                        uint64_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_UINT64:
+                    set_type(Type::UINT64);
+                    memcpy(&_value.u64, bytes, sizeof(_value.u64));
                     break;
-                case MAV_PARAM_EXT_TYPE_INT64: {
-                        int64_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_INT64:
+                    set_type(Type::INT64);
+                    memcpy(&_value.i64, bytes, sizeof(_value.i64));
                     break;
-                case MAV_PARAM_EXT_TYPE_REAL32: {
-                        float temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_REAL32:
+                    set_type(Type::FLOAT);
+                    memcpy(&_value.f, bytes, sizeof(_value.f));
                     break;
-                case MAV_PARAM_EXT_TYPE_REAL64: {
-                        double temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_REAL64:
+                    set_type(Type::DOUBLE);
+                    memcpy(&_value.d, bytes, sizeof(_value.d));
                     break;
-                case MAV_PARAM_EXT_TYPE_CUSTOM: {
-                        custom_type_t temp;
-                        memcpy(&temp, &mavlink_ext_value.param_value[0], sizeof(temp));
-                        _value = temp;
-                    }
+                case MAV_PARAM_EXT_TYPE_CUSTOM:
+                    set_type(Type::CUSTOM);
+                    _custom_value.assign(bytes, sizeof(custom_type_t));
                     break;
                 default:
                     // This would be worrying
@@ -135,35 +121,25 @@ public:
         void set_from_xml(const std::string &type_str, const std::string &value_str)
         {
             if (strcmp(type_str.c_str(), "uint8") == 0) {
-                uint8_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_uint8(uint8_t(std::stoi(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "int8") == 0) {
-                int8_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_int8(int8_t(std::stoi(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "uint16") == 0) {
-                uint16_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_uint16(uint16_t(std::stoi(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "int16") == 0) {
-                int16_t temp = std::stoi(value_str.c_str());
-                _value = temp;
+                set_int16(int16_t(std::stoi(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "uint32") == 0) {
-                uint32_t temp = std::stol(value_str.c_str());
-                _value = temp;
+                set_uint32(uint32_t(std::stol(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "int32") == 0) {
-                int32_t temp = std::stol(value_str.c_str());
-                _value = temp;
+                set_int32(int32_t(std::stol(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "uint64") == 0) {
-                uint64_t temp = std::stoll(value_str.c_str());
-                _value = temp;
-            } else if (strcmp(type_str.c_str(), "uint64") == 0) {
-                int64_t temp = std::stoll(value_str.c_str());
-                _value = temp;
+                set_uint64(uint64_t(std::stoll(value_str.c_str())));
+            } else if (strcmp(type_str.c_str(), "int64") == 0) {
+                set_int64(int64_t(std::stoll(value_str.c_str())));
             } else if (strcmp(type_str.c_str(), "float") == 0) {
-                float temp = std::stof(value_str.c_str());
-                _value = temp;
+                set_float(std::stof(value_str.c_str()));
             } else if (strcmp(type_str.c_str(), "double") == 0) {
-                double temp = std::stod(value_str.c_str());
-                _value = temp;
+                set_double(std::stod(value_str.c_str()));
             } else {
                 LogErr() << "Unknown type: " << type_str;
             }
@@ -171,9 +147,9 @@ public:
 
         MAV_PARAM_TYPE get_mav_param_type() const
         {
-            if (_value.is<float>()) {
+            if (_type == Type::FLOAT) {
                 return MAV_PARAM_TYPE_REAL32;
-            } else if (_value.is<int32_t>()) {
+            } else if (_type == Type::INT32) {
                 return MAV_PARAM_TYPE_INT32;
             } else {
                 return MAV_PARAM_TYPE_REAL32;
@@ -182,247 +158,272 @@ public:
 
         MAV_PARAM_EXT_TYPE get_mav_param_ext_type() const
         {
-            if (_value.is<uint8_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT8;
-            } else if (_value.is<int8_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT8;
-            } else if (_value.is<uint16_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT16;
-            } else if (_value.is<int16_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT16;
-            } else if (_value.is<uint32_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT32;
-            } else if (_value.is<int32_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT32;
-            } else if (_value.is<uint64_t>()) {
-                return MAV_PARAM_EXT_TYPE_UINT64;
-            } else if (_value.is<int64_t>()) {
-                return MAV_PARAM_EXT_TYPE_INT64;
-            } else if (_value.is<float>()) {
-                return MAV_PARAM_EXT_TYPE_REAL32;
-            } else if (_value.is<double>()) {
-                return MAV_PARAM_EXT_TYPE_REAL64;
-            } else if (_value.is<custom_type_t>()) {
-                return MAV_PARAM_EXT_TYPE_CUSTOM;
-            } else {
-                LogErr() << "Unknown data type for param.";
-                assert(false);
-                return MAV_PARAM_EXT_TYPE_INT32;
+            switch (_type) {
+                case Type::UINT8:
+                    return MAV_PARAM_EXT_TYPE_UINT8;
+                case Type::INT8:
+                    return MAV_PARAM_EXT_TYPE_INT8;
+                case Type::UINT16:
+                    return MAV_PARAM_EXT_TYPE_UINT16;
+                case Type::INT16:
+                    return MAV_PARAM_EXT_TYPE_INT16;
+                case Type::UINT32:
+                    return MAV_PARAM_EXT_TYPE_UINT32;
+                case Type::INT32:
+                    return MAV_PARAM_EXT_TYPE_INT32;
+                case Type::UINT64:
+                    return MAV_PARAM_EXT_TYPE_UINT64;
+                case Type::INT64:
+                    return MAV_PARAM_EXT_TYPE_INT64;
+                case Type::FLOAT:
+                    return MAV_PARAM_EXT_TYPE_REAL32;
+                case Type::DOUBLE:
+                    return MAV_PARAM_EXT_TYPE_REAL64;
+                case Type::CUSTOM:
+                    return MAV_PARAM_EXT_TYPE_CUSTOM;
+                default:
+                    LogErr() << "Unknown data type for param.";
+                    assert(false);
+                    return MAV_PARAM_EXT_TYPE_INT32;
             }
         }
 
         float get_4_float_bytes() const
         {
-            if (_value.is<float>()) {
-                return _value.as<float>();
+            if (_type == Type::FLOAT) {
+                return _value.f;
             } else {
-                return *(reinterpret_cast<const float *>(&_value.as<int32_t>()));
+                float temp;
+                const int32_t value = get_int32();
+                memcpy(&temp, &value, sizeof(temp));
+                return temp;
             }
         }
 
         void get_128_bytes(char *bytes) const
         {
-            if (_value.is<uint8_t>()) {
-                memcpy(bytes, &_value.as<uint8_t>(), sizeof(uint8_t));
-            } else if (_value.is<int8_t>()) {
-                memcpy(bytes, &_value.as<int8_t>(), sizeof(int8_t));
-            } else if (_value.is<uint16_t>()) {
-                memcpy(bytes, &_value.as<uint16_t>(), sizeof(uint16_t));
-            } else if (_value.is<int16_t>()) {
-                memcpy(bytes, &_value.as<int16_t>(), sizeof(int16_t));
-            } else if (_value.is<uint32_t>()) {
-                memcpy(bytes, &_value.as<uint32_t>(), sizeof(uint32_t));
-            } else if (_value.is<int32_t>()) {
-                memcpy(bytes, &_value.as<int32_t>(), sizeof(int32_t));
-            } else if (_value.is<uint64_t>()) {
-                memcpy(bytes, &_value.as<uint64_t>(), sizeof(uint64_t));
-            } else if (_value.is<int64_t>()) {
-                memcpy(bytes, &_value.as<int64_t>(), sizeof(int64_t));
-            } else if (_value.is<float>()) {
-                memcpy(bytes, &_value.as<float>(), sizeof(float));
-            } else if (_value.is<double>()) {
-                memcpy(bytes, &_value.as<double>(), sizeof(double));
-            } else if (_value.is<custom_type_t>()) {
-                memcpy(bytes, &_value.as<custom_type_t>(), sizeof(custom_type_t));
-            } else {
-                LogErr() << "Unknown data type for param.";
-                assert(false);
+            switch (_type) {
+                case Type::UINT8:
+                    memcpy(bytes, &_value.u8, sizeof(_value.u8));
+                    break;
+                case Type::INT8:
+                    memcpy(bytes, &_value.i8, sizeof(_value.i8));
+                    break;
+                case Type::UINT16:
+                    memcpy(bytes, &_value.u16, sizeof(_value.u16));
+                    break;
+                case Type::INT16:
+                    memcpy(bytes, &_value.i16, sizeof(_value.i16));
+                    break;
+                case Type::UINT32:
+                    memcpy(bytes, &_value.u32, sizeof(_value.u32));
+                    break;
+                case Type::INT32:
+                    memcpy(bytes, &_value.i32, sizeof(_value.i32));
+                    break;
+                case Type::UINT64:
+                    memcpy(bytes, &_value.u64, sizeof(_value.u64));
+                    break;
+                case Type::INT64:
+                    memcpy(bytes, &_value.i64, sizeof(_value.i64));
+                    break;
+                case Type::FLOAT:
+                    memcpy(bytes, &_value.f, sizeof(_value.f));
+                    break;
+                case Type::DOUBLE:
+                    memcpy(bytes, &_value.d, sizeof(_value.d));
+                    break;
+                case Type::CUSTOM:
+                    memcpy(bytes, _custom_value.data(), _custom_value.size());
+                    break;
+                default:
+                    LogErr() << "Unknown data type for param.";
+                    assert(false);
+                    break;
             }
         }
 
         std::string get_string() const
         {
-            if (_value.is<uint8_t>()) {
-                return std::to_string(_value.as<uint8_t>());
-            } else if (_value.is<int8_t>()) {
-                return std::to_string(_value.as<int8_t>());
-            } else if (_value.is<uint16_t>()) {
-                return std::to_string(_value.as<uint16_t>());
-            } else if (_value.is<int16_t>()) {
-                return std::to_string(_value.as<int16_t>());
-            } else if (_value.is<uint32_t>()) {
-                return std::to_string(_value.as<uint32_t>());
-            } else if (_value.is<int32_t>()) {
-                return std::to_string(_value.as<int32_t>());
-            } else if (_value.is<uint64_t>()) {
-                return std::to_string(_value.as<uint64_t>());
-            } else if (_value.is<int64_t>()) {
-                return std::to_string(_value.as<int64_t>());
-            } else if (_value.is<float>()) {
-                return std::to_string(_value.as<float>());
-            } else if (_value.is<double>()) {
-                return std::to_string(_value.as<double>());
-            } else if (_value.is<custom_type_t>()) {
-                return std::string("(custom type)");
-            } else {
-                LogErr() << "Unknown data type for param.";
-                assert(false);
-                return std::string("(unknown)");
+            switch (_type) {
+                case Type::UINT8:
+                    return std::to_string(_value.u8);
+                case Type::INT8:
+                    return std::to_string(_value.i8);
+                case Type::UINT16:
+                    return std::to_string(_value.u16);
+                case Type::INT16:
+                    return std::to_string(_value.i16);
+                case Type::UINT32:
+                    return std::to_string(_value.u32);
+                case Type::INT32:
+                    return std::to_string(_value.i32);
+                case Type::UINT64:
+                    return std::to_string(_value.u64);
+                case Type::INT64:
+                    return std::to_string(_value.i64);
+                case Type::FLOAT:
+                    return std::to_string(_value.f);
+                case Type::DOUBLE:
+                    return std::to_string(_value.d);
+                case Type::CUSTOM:
+                    return std::string("(custom type)");
+                default:
+                    LogErr() << "Unknown data type for param.";
+                    assert(false);
+                    return std::string("(unknown)");
             }
         }
+
         float get_float() const
         {
-            return float(_value);
+            check_type(Type::FLOAT);
+            return _value.f;
         }
 
         double get_double() const
         {
-            return double(_value);
+            check_type(Type::DOUBLE);
+            return _value.d;
         }
 
         int8_t get_int8() const
         {
-            return int8_t(_value);
+            check_type(Type::INT8);
+            return _value.i8;
         }
 
         uint8_t get_uint8() const
         {
-            return uint8_t(_value);
+            check_type(Type::UINT8);
+            return _value.u8;
         }
 
         int32_t get_int32() const
         {
-            return int32_t(_value);
+            check_type(Type::INT32);
+            return _value.i32;
         }
 
         uint32_t get_uint32() const
         {
-            return uint32_t(_value);
+            check_type(Type::UINT32);
+            return _value.u32;
         }
 
         void set_float(float value)
         {
-            _value = value;
+            set_type(Type::FLOAT);
+            _value.f = value;
         }
 
         void set_double(double value)
         {
-            _value = value;
+            set_type(Type::DOUBLE);
+            _value.d = value;
         }
 
         void set_int8(int8_t value)
         {
-            _value = value;
+            set_type(Type::INT8);
+            _value.i8 = value;
         }
 
         void set_uint8(uint8_t value)
         {
-            _value = value;
+            set_type(Type::UINT8);
+            _value.u8 = value;
         }
 
         void set_int16(int16_t value)
         {
-            _value = value;
+            set_type(Type::INT16);
+            _value.i16 = value;
         }
 
         void set_uint16(uint16_t value)
         {
-            _value = value;
+            set_type(Type::UINT16);
+            _value.u16 = value;
         }
 
         void set_int32(int32_t value)
         {
-            _value = value;
+            set_type(Type::INT32);
+            _value.i32 = value;
         }
 
         void set_uint32(uint32_t value)
         {
-            _value = value;
+            set_type(Type::UINT32);
+            _value.u32 = value;
         }
 
         void set_int64(int64_t value)
         {
-            _value = value;
+            set_type(Type::INT64);
+            _value.i64 = value;
         }
 
         void set_uint64(uint64_t value)
         {
-            _value = value;
+            set_type(Type::UINT64);
+            _value.u64 = value;
         }
 
         bool is_uint8() const
         {
-            return (_value.is<uint8_t>());
+            return (_type == Type::UINT8);
         }
 
         bool is_int8() const
         {
-            return (_value.is<int8_t>());
+            return (_type == Type::INT8);
         }
 
         bool is_uint16() const
         {
-            return (_value.is<uint16_t>());
+            return (_type == Type::UINT16);
         }
 
         bool is_int16() const
         {
-            return (_value.is<int16_t>());
+            return (_type == Type::INT16);
         }
 
         bool is_uint32() const
         {
-            return (_value.is<uint32_t>());
+            return (_type == Type::UINT32);
         }
 
         bool is_int32() const
         {
-            return (_value.is<int32_t>());
+            return (_type == Type::INT32);
         }
 
         bool is_uint64() const
         {
-            return (_value.is<uint64_t>());
+            return (_type == Type::UINT64);
         }
 
         bool is_int64() const
         {
-            return (_value.is<int64_t>());
+            return (_type == Type::INT64);
         }
 
         bool is_float() const
         {
-            return (_value.is<float>());
+            return (_type == Type::FLOAT);
         }
 
         bool is_double() const
         {
-            return (_value.is<double>());
+            return (_type == Type::DOUBLE);
         }
 
         bool is_same_type(const ParamValue &rhs) const
         {
-            if ((_value.is<uint8_t>() && rhs._value.is<uint8_t>()) ||
-                (_value.is<int8_t>() && rhs._value.is<int8_t>()) ||
-                (_value.is<uint16_t>() && rhs._value.is<uint16_t>()) ||
-                (_value.is<int16_t>() && rhs._value.is<int16_t>()) ||
-                (_value.is<uint32_t>() && rhs._value.is<uint32_t>()) ||
-                (_value.is<int32_t>() && rhs._value.is<int32_t>()) ||
-                (_value.is<uint64_t>() && rhs._value.is<uint64_t>()) ||
-                (_value.is<int64_t>() && rhs._value.is<int64_t>()) ||
-                (_value.is<float>() && rhs._value.is<float>()) ||
-                (_value.is<double>() && rhs._value.is<double>()) ||
-                (_value.is<custom_type_t>() && rhs._value.is<custom_type_t>())) {
+            if (_type != Type::NONE && _type == rhs._type) {
                 return true;
             } else {
                 LogWarn() << "Comparison type mismatch between " << typestr()
@@ -436,104 +437,224 @@ public:
             if (!is_same_type(rhs)) {
                 return false;
             }
-            if (_value.is<uint8_t>()) {
-                return _value.as<uint8_t>() == rhs._value.as<uint8_t>();
-            } else if (_value.is<int8_t>()) {
-                return _value.as<int8_t>() == rhs._value.as<int8_t>();
-            } else if (_value.is<uint16_t>()) {
-                return _value.as<uint16_t>() == rhs._value.as<uint16_t>();
-            } else if (_value.is<int16_t>()) {
-                return _value.as<int16_t>() == rhs._value.as<int16_t>();
-            } else if (_value.is<uint32_t>()) {
-                return _value.as<uint32_t>() == rhs._value.as<uint32_t>();
-            } else if (_value.is<int32_t>()) {
-                return _value.as<int32_t>() == rhs._value.as<int32_t>();
-            } else if (_value.is<uint64_t>()) {
-                return _value.as<uint64_t>() == rhs._value.as<uint64_t>();
-            } else if (_value.is<int64_t>()) {
-                return _value.as<int64_t>() == rhs._value.as<int64_t>();
-            } else if (_value.is<float>()) {
-                return _value.as<float>() == rhs._value.as<float>();
-            } else if (_value.is<double>()) {
-                return _value.as<double>() == rhs._value.as<double>();
-            } else if (_value.is<custom_type_t>()) {
-                // FIXME: not clear how to handle this
+            switch (_type) {
+                case Type::UINT8:
+                    return _value.u8 == rhs._value.u8;
+                case Type::INT8:
+                    return _value.i8 == rhs._value.i8;
+                case Type::UINT16:
+                    return _value.u16 == rhs._value.u16;
+                case Type::INT16:
+                    return _value.i16 == rhs._value.i16;
+                case Type::UINT32:
+                    return _value.u32 == rhs._value.u32;
+                case Type::INT32:
+                    return _value.i32 == rhs._value.i32;
+                case Type::UINT64:
+                    return _value.u64 == rhs._value.u64;
+                case Type::INT64:
+                    return _value.i64 == rhs._value.i64;
+                case Type::FLOAT:
+                    return _value.f == rhs._value.f;
+                case Type::DOUBLE:
+                    return _value.d == rhs._value.d;
+                default:
+                    // FIXME: not clear how to handle custom types
+                    return false;
+            }
+        }
+
+        // Like operator== but also for custom values, and without complaining
+        // about different types, which are just a different value.
+        bool is_same_value(const ParamValue &rhs) const
+        {
+            if (_type == Type::NONE || _type != rhs._type) {
                 return false;
             }
-            // FIXME: Added to fix CI error (control reading end of non-void function)
-            return false;
+            if (_type == Type::CUSTOM) {
+                return _custom_value == rhs._custom_value;
+            }
+            return *this == rhs;
         }
 
         bool operator==(const std::string &value_str) const
         {
             // LogDebug() << "Compare " << typestr() << " and " << rhs.typestr();
-            if (_value.is<uint8_t>()) {
-                return _value.as<uint8_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<int8_t>()) {
-                return _value.as<int8_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<uint16_t>()) {
-                return _value.as<uint16_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<int16_t>()) {
-                return _value.as<int16_t>() == std::stoi(value_str.c_str());
-            } else if (_value.is<uint32_t>()) {
-                return _value.as<uint32_t>() == std::stoul(value_str.c_str());
-            } else if (_value.is<int32_t>()) {
-                return _value.as<int32_t>() == std::stol(value_str.c_str());
-            } else if (_value.is<uint64_t>()) {
-                return _value.as<uint64_t>() == std::stoull(value_str.c_str());
-            } else if (_value.is<int64_t>()) {
-                return _value.as<int64_t>() == std::stoll(value_str.c_str());
-            } else if (_value.is<float>()) {
-                return _value.as<float>() == std::stof(value_str.c_str());
-            } else if (_value.is<double>()) {
-                return _value.as<double>() == std::stod(value_str.c_str());
-            } else {
-                // This also covers custom_type_t
-                return false;
+            switch (_type) {
+                case Type::UINT8:
+                    return _value.u8 == std::stoi(value_str.c_str());
+                case Type::INT8:
+                    return _value.i8 == std::stoi(value_str.c_str());
+                case Type::UINT16:
+                    return _value.u16 == std::stoi(value_str.c_str());
+                case Type::INT16:
+                    return _value.i16 == std::stoi(value_str.c_str());
+                case Type::UINT32:
+                    return _value.u32 == std::stoul(value_str.c_str());
+                case Type::INT32:
+                    return _value.i32 == std::stol(value_str.c_str());
+                case Type::UINT64:
+                    return _value.u64 == std::stoull(value_str.c_str());
+                case Type::INT64:
+                    return _value.i64 == std::stoll(value_str.c_str());
+                case Type::FLOAT:
+                    return _value.f == std::stof(value_str.c_str());
+                case Type::DOUBLE:
+                    return _value.d == std::stod(value_str.c_str());
+                default:
+                    // This also covers custom_type_t
+                    return false;
             }
         }
 
         std::string typestr() const
         {
-            if (_value.is<uint8_t>()) {
-                return "uint8_t";
-            } else if (_value.is<int8_t>()) {
-                return "int8_t";
-            } else if (_value.is<uint16_t>()) {
-                return "uint16_t";
-            } else if (_value.is<int16_t>()) {
-                return "int16_t";
-            } else if (_value.is<uint32_t>()) {
-                return "uint32_t";
-            } else if (_value.is<int32_t>()) {
-                return "int32_t";
-            } else if (_value.is<uint64_t>()) {
-                return "uint64_t";
-            } else if (_value.is<int64_t>()) {
-                return "int64_t";
-            } else if (_value.is<float>()) {
-                return "float";
-            } else if (_value.is<double>()) {
-                return "double";
-            } else if (_value.is<custom_type_t>()) {
-                // FIXME: not clear how to handle this
-                return "unknown";
+            switch (_type) {
+                case Type::UINT8:
+                    return "uint8_t";
+                case Type::INT8:
+                    return "int8_t";
+                case Type::UINT16:
+                    return "uint16_t";
+                case Type::INT16:
+                    return "int16_t";
+                case Type::UINT32:
+                    return "uint32_t";
+                case Type::INT32:
+                    return "int32_t";
+                case Type::UINT64:
+                    return "uint64_t";
+                case Type::INT64:
+                    return "int64_t";
+                case Type::FLOAT:
+                    return "float";
+                case Type::DOUBLE:
+                    return "double";
+                default:
+                    // FIXME: not clear how to handle custom types
+                    return "unknown";
             }
-            // FIXME: Added to fix CI error (control reading end of non-void function)
-            return "unknown";
         }
 
     private:
-        Any _value;
+        enum class Type : uint8_t {
+            NONE,
+            UINT8,
+            INT8,
+            UINT16,
+            INT16,
+            UINT32,
+            INT32,
+            UINT64,
+            INT64,
+            FLOAT,
+            DOUBLE,
+            CUSTOM
+        };
+
+        void set_type(Type type)
+        {
+            _type = type;
+            if (type != Type::CUSTOM) {
+                _custom_value.clear();
+            }
+        }
 
+        void check_type(Type type) const
+        {
+            if (_type != type) {
+                // We don't have exceptions, so we abort like a bad any_cast would.
+                LogErr() << "Need to abort because of a bad param type: " << typestr();
+                abort();
+            }
+        }
+
+        Type _type = Type::NONE;
+        union {
+            uint8_t u8;
+            int8_t i8;
+            uint16_t u16;
+            int16_t i16;
+            uint32_t u32;
+            int32_t i32;
+            uint64_t u64;
+            int64_t i64;
+            float f;
+            double d;
+        } _value {};
+        // Only used for custom types.
+        std::string _custom_value {};
     };
 
+    // Extended params go to a camera, the component_id says which one. It is not
+    // used for normal params, they always go to the autopilot.
     typedef std::function <void(bool success)> set_param_callback_t;
     void set_param_async(const std::string &name, const ParamValue &value,
-                         set_param_callback_t callback, bool extended = false);
+                         set_param_callback_t callback, bool extended = false,
+                         uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Sets all params, several at a time. The callback comes once all are done.
+    typedef std::function <void(bool success, const std::vector<std::string> &failed_params)>
+    set_params_callback_t;
+    void set_params_async(const std::map<std::string, ParamValue> &params,
+                          set_params_callback_t callback, bool extended = false,
+                          uint8_t component_id = MAV_COMP_ID_CAMERA);
 
     typedef std::function <void(bool success, ParamValue value)> get_param_callback_t;
-    void get_param_async(const std::string &name, get_param_callback_t callback, bool extended = false);
+    void get_param_async(const std::string &name, get_param_callback_t callback, bool extended = false,
+                         uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Gets several extended params at once. One PARAM_EXT_REQUEST_LIST is sent and
+    // the wanted values are picked from the answers. Params that don't come in are
+    // then read by name, several at a time. The callback gets all values received,
+    // success only if none are missing.
+    typedef std::function <void(bool success, const std::map<std::string, ParamValue> &values)>
+    get_params_callback_t;
+    void get_params_ext_async(const std::vector<std::string> &names,
+                              get_params_callback_t callback,
+                              uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Downloads all params at once with PARAM_REQUEST_LIST and keeps them in a
+    // cache, so get_param_async() can answer right away instead of doing a
+    // round trip per param. Params missing after the list was sent are then
+    // requested by index. Only normal (not extended) params are cached.
+    void request_all_params_async();
+
+    // Warm-starts the cache from a snapshot file saved by an earlier download.
+    // The snapshot is only used if the param hash (_HASH_CHECK) of the autopilot
+    // still matches, otherwise all params are downloaded again. Complete
+    // downloads are saved to the same file.
+    void use_snapshot(const std::string &path);
+
+    // Loads a params file as saved by QGroundControl: one param per line with
+    // vehicle ID, component ID, name, value and MAV_PARAM_TYPE, separated by
+    // tabs. Lines starting with # are comments. Only the params of the
+    // autopilot are taken, and only of the int32 and float types it uses.
+    static bool load_param_file(const std::string &path,
+                                std::map<std::string, ParamValue> &params);
+
+    // Sets the params of a params file, but only those which differ from the
+    // cache, which is downloaded first if needed (see request_all_params_async()).
+    // Params the autopilot doesn't have count as failed. Progress is reported
+    // after every param set, out of the number which needed to be set.
+    typedef std::function <void(size_t num_done, size_t num_total)> progress_callback_t;
+    void apply_param_file_async(const std::string &path, progress_callback_t progress_callback,
+                                set_params_callback_t callback);
+
+    // Called with every new value of a param as it is sent by the vehicle,
+    // e.g. after another ground station or the autopilot itself changed it,
+    // so that plugins don't need to poll. Values which didn't change are left
+    // out. An empty name subscribes to all params (of the component, if
+    // extended). The callback is called directly from the receive thread.
+    typedef std::function <void(const std::string &name, ParamValue value)>
+    param_changed_callback_t;
+    typedef uint64_t param_subscription_handle_t;
+    param_subscription_handle_t subscribe_param(const std::string &name,
+                                                param_changed_callback_t callback,
+                                                bool extended = false,
+                                                uint8_t component_id = MAV_COMP_ID_CAMERA);
+    // The callback can still be running while this returns.
+    void unsubscribe_param(param_subscription_handle_t handle);
 
     //void save_async();
     void do_work();
@@ -544,45 +665,193 @@ public:
     MAVLinkParameters(const MAVLinkParameters &) = delete;
     const MAVLinkParameters &operator=(const MAVLinkParameters &) = delete;
 private:
-    void process_param_value(const mavlink_message_t &message);
+    void process_param_value(const mavlink_param_value_t &param_value);
     void process_param_ext_value(const mavlink_message_t &message);
     void process_param_ext_ack(const mavlink_message_t &message);
     void receive_timeout();
 
+    typedef std::unordered_map<ParamKey, ParamValue, ParamKey::Hash> param_map_t;
+
+    // Returns false if the param is not (yet) in the cache.
+    bool get_param_from_cache(const ParamKey &key, ParamValue &value);
+    void update_cache(const mavlink_param_value_t &param_value);
+    void update_ext_values(uint8_t component_id, const mavlink_param_ext_value_t &param_ext_value);
+    // Not to be called with any of our mutexes locked, the callbacks might call us.
+    void notify_param_changed(const std::string &name, const ParamValue &value, bool extended,
+                              uint8_t component_id);
+    void cache_timeout();
+    // Not to be called with any of our mutexes locked.
+    void apply_pending_param_files();
+    void set_params(const std::map<std::string, ParamValue> &params,
+                    progress_callback_t progress_callback, set_params_callback_t callback,
+                    bool extended, uint8_t component_id);
+    // Need to be called with _cache_mutex locked.
+    void start_download();
+    void handle_hash(uint32_t hash, bool &request_list, bool &save);
+    bool should_save_snapshot() const;
+    // Brings the memory account up to date with the cache, snapshot and
+    // extended values.
+    void account_cache_bytes();
+
+    void send_param_request_list();
+    void send_param_request_read(int16_t param_index);
+    void send_param_request_read(const ParamKey &key);
+
+    static bool load_snapshot(const std::string &path, param_map_t &params, uint32_t &hash);
+    static bool save_snapshot(const std::string &path, const param_map_t &params, uint32_t hash);
+
     MAVLinkSystem &_parent;
 
+    // Only for gets, sets are tracked in _set_param_in_flight.
     enum class State {
         NONE,
-        SET_PARAM_BUSY,
         GET_PARAM_BUSY
     } _state = State::NONE;
     std::mutex _state_mutex {};
 
     // Params can be up to 16 chars and without 0-termination.
     // Therefore we add a 0 here for storing.
-    static constexpr size_t PARAM_ID_LEN = 16 + 1;
+    static constexpr size_t PARAM_ID_LEN = ParamKey::MAX_LEN + 1;
 
     struct SetParamWork {
         set_param_callback_t callback = nullptr;
-        std::string param_name {};
+        ParamKey key {};
         ParamValue param_value {};
         bool extended = false;
+        // 0 for normal params.
+        uint8_t component_id = 0;
         int retries_done = 0;
+        void *timeout_cookie = nullptr;
+        dl_time_t sent_time {};
     };
 
-    LockedQueue<SetParamWork> _set_param_queue {};
+    // New work is pushed to the inboxes from any thread without locking and
+    // picked up by do_work(). The queues are only used with _state_mutex locked.
+    MPSCQueue<SetParamWork> _set_param_inbox {};
+    std::deque<SetParamWork> _set_param_queue {};
+
+    // Set requests sent and waiting for their ack, at most SET_PARAM_WINDOW.
+    std::vector<SetParamWork> _set_param_in_flight {};
+    static constexpr size_t SET_PARAM_WINDOW = 8;
+    static constexpr int SET_PARAM_MAX_RETRIES = 2;
+
+    // Need to be called with _state_mutex locked.
+    std::vector<SetParamWork>::iterator find_set_param_in_flight(const ParamKey &key,
+                                                                 uint8_t component_id);
+    bool send_set_param(const SetParamWork &work);
+    void register_set_param_timeout(SetParamWork &work);
+    void finish_set_param(std::vector<SetParamWork>::iterator in_flight, bool success);
+
+    void set_param_timeout(ParamKey key, uint8_t component_id);
 
     struct GetParamWork {
         get_param_callback_t callback = nullptr;
-        std::string param_name {};
+        ParamKey key {};
         bool extended = false;
+        uint8_t component_id = 0;
         int retries_done = 0;
     };
-    LockedQueue<GetParamWork> _get_param_queue {};
+    MPSCQueue<GetParamWork> _get_param_inbox {};
+    std::deque<GetParamWork> _get_param_queue {};
+    static constexpr int GET_PARAM_MAX_RETRIES = 2;
+
+    // Need to be called with _state_mutex locked.
+    bool send_get_param(const GetParamWork &work);
+    void register_get_param_timeout(const GetParamWork &work);
 
     void *_timeout_cookie = nullptr;
 
-    // dl_time_t _last_request_time = {};
+    struct GetParamsWork {
+        get_params_callback_t callback = nullptr;
+        uint8_t component_id = 0;
+        std::vector<ParamKey> missing {};
+        std::map<std::string, ParamValue> values {};
+        // When the list stalls, the missing params read and not answered yet.
+        std::vector<ParamKey> reading {};
+        size_t num_received_last_round = 0;
+        int rounds_without_progress = 0;
+    };
+    MPSCQueue<GetParamsWork> _get_params_inbox {};
+    // The front is being worked on, if _get_params_busy.
+    std::deque<GetParamsWork> _get_params_queue {};
+    bool _get_params_busy = false;
+    void *_get_params_timeout_cookie = nullptr;
+    static constexpr size_t GET_PARAMS_WINDOW = 8;
+
+    // Need to be called with _state_mutex locked.
+    void start_get_params();
+    void handle_get_params_value(const mavlink_param_ext_value_t &param_ext_value);
+    void read_missing_params(GetParamsWork &work);
+    void finish_get_params(bool success);
+
+    void get_params_timeout();
+    bool send_param_ext_request_list(uint8_t component_id);
+    bool send_param_ext_request_read(const ParamKey &key, uint8_t component_id);
+
+    enum class CacheState {
+        NONE,
+        VALIDATING,
+        DOWNLOADING,
+        COMPLETE
+    };
+
+    // PX4 sends a hash over all params with this name.
+    static constexpr auto HASH_CHECK_PARAM_ID = "_HASH_CHECK";
+
+    // If nothing comes in for this long, the missing params are requested.
+    static constexpr double CACHE_STALL_TIMEOUT_S = 1.0;
+    // Params requested by index at once, most links can't take more.
+    static constexpr unsigned CACHE_MAX_READS_PER_ROUND = 20;
+    static constexpr int CACHE_MAX_ROUNDS_WITHOUT_PROGRESS = 3;
+
+    std::mutex _cache_mutex {};
+    CacheState _cache_state = CacheState::NONE;
+    param_map_t _cache {};
+    // Which of the param_count indices we have received.
+    std::vector<bool> _cache_have_index {};
+    size_t _cache_num_received = 0;
+    size_t _cache_num_received_last_round = 0;
+    int _cache_rounds_without_progress = 0;
+    void *_cache_timeout_cookie = nullptr;
+
+    uint32_t _cache_hash = 0;
+    bool _cache_have_hash = false;
+    bool _cache_saved = false;
+    std::string _snapshot_path {};
+    // Loaded from file but not validated yet.
+    param_map_t _snapshot {};
+    uint32_t _snapshot_hash = 0;
+
+    // Params files waiting for the download to finish before they are diffed.
+    // Used with _cache_mutex locked.
+    struct ApplyParamFileWork {
+        std::map<std::string, ParamValue> params {};
+        progress_callback_t progress_callback = nullptr;
+        set_params_callback_t callback = nullptr;
+    };
+    std::vector<ApplyParamFileWork> _apply_param_file_pending {};
+
+    // When the get request currently busy was sent.
+    dl_time_t _last_request_time = {};
+
+    // Last values received of extended params by component ID, to tell if
+    // they changed. Used with _cache_mutex locked.
+    std::map<uint8_t, param_map_t> _ext_values {};
+
+    // Only counted, received params are never refused. Used with _cache_mutex locked.
+    std::shared_ptr<MemoryAccount> _memory_account {};
+    size_t _accounted_bytes = 0;
+
+    struct ParamSubscription {
+        param_subscription_handle_t handle;
+        std::string name;
+        bool extended;
+        uint8_t component_id;
+        param_changed_callback_t callback;
+    };
+    std::mutex _subscriptions_mutex {};
+    std::vector<ParamSubscription> _param_subscriptions {};
+    param_subscription_handle_t _next_param_subscription_handle = 1;
 };
 
 } // namespace dronecore
@@ -0,0 +1,606 @@
+#include "mavlink_parameters.h"
+#include "connection.h"
+#include "dronecore_impl.h"
+#include "mavlink_system.h"
+#include "mocks/recording_connection.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+using dronecore::testing::RecordingConnection;
+
+// The params of system 1, fed with messages by the test. Only the test calls
+// their do_work(), the timeouts run on the system thread.
+struct ParamsHarness {
+    ParamsHarness() :
+        dc(new DroneCoreImpl()),
+        connection(new RecordingConnection(*dc)),
+        system(new MAVLinkSystem(*dc, 1, MAV_COMP_ID_AUTOPILOT1)),
+        params(new MAVLinkParameters(*system))
+    {
+        // From now on, what is sent to system 1 goes to the connection.
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                                   MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+        dc->receive_message(message, *connection, std::chrono::steady_clock::now());
+    }
+
+    ~ParamsHarness()
+    {
+        // The connection needs to outlive DroneCoreImpl, which sends to it.
+        params.reset();
+        system.reset();
+        dc.reset();
+    }
+
+    void send_param_value(const char *name, float value, uint16_t index, uint16_t count)
+    {
+        mavlink_message_t message;
+        mavlink_msg_param_value_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, name, value,
+                                     MAV_PARAM_TYPE_REAL32, count, index);
+        system->process_mavlink_message(message);
+    }
+
+    // PX4 sends it as a param which is not counted.
+    void send_hash(uint32_t hash, uint16_t count)
+    {
+        float value;
+        memcpy(&value, &hash, sizeof(value));
+        mavlink_message_t message;
+        mavlink_msg_param_value_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, "_HASH_CHECK", value,
+                                     MAV_PARAM_TYPE_INT32, count, UINT16_MAX);
+        system->process_mavlink_message(message);
+    }
+
+    size_t num_list_requests()
+    {
+        return connection->take(MAVLINK_MSG_ID_PARAM_REQUEST_LIST).size();
+    }
+
+    // Params are read by index, or by name with the index -1.
+    struct ReadRequests {
+        std::vector<int16_t> indices;
+        std::vector<std::string> names;
+    };
+
+    ReadRequests take_read_requests()
+    {
+        ReadRequests requests;
+        for (const auto &message : connection->take(MAVLINK_MSG_ID_PARAM_REQUEST_READ)) {
+            const int16_t index = mavlink_msg_param_request_read_get_param_index(&message);
+            if (index >= 0) {
+                requests.indices.push_back(index);
+            } else {
+                char name[17] = {};
+                mavlink_msg_param_request_read_get_param_id(&message, name);
+                requests.names.push_back(name);
+            }
+        }
+        return requests;
+    }
+
+    // Names and values of the PARAM_SETs sent.
+    std::vector<std::pair<std::string, float>> take_sets()
+    {
+        std::vector<std::pair<std::string, float>> sets;
+        for (const auto &message : connection->take(MAVLINK_MSG_ID_PARAM_SET)) {
+            char name[17] = {};
+            mavlink_msg_param_set_get_param_id(&message, name);
+            sets.push_back(std::make_pair(std::string(name),
+                                          mavlink_msg_param_set_get_param_value(&message)));
+        }
+        return sets;
+    }
+
+    // Returns false if the param is not in the cache.
+    bool get_cached(const std::string &name, float &value)
+    {
+        // Answered right away from the cache, otherwise it is queued and never
+        // sent, as nobody calls do_work().
+        auto received = std::make_shared<std::pair<bool, float>>(false, 0.0f);
+        params->get_param_async(name, [received](bool success,
+        MAVLinkParameters::ParamValue param_value) {
+            *received = std::make_pair(success, param_value.get_float());
+        });
+        value = received->second;
+        return received->first;
+    }
+
+    std::unique_ptr<DroneCoreImpl> dc;
+    std::unique_ptr<RecordingConnection> connection;
+    std::unique_ptr<MAVLinkSystem> system;
+    std::unique_ptr<MAVLinkParameters> params;
+};
+
+} // namespace
+
+TEST(ParamValue, SetAndGet)
+{
+    MAVLinkParameters::ParamValue value;
+
+    value.set_float(1.5f);
+    EXPECT_TRUE(value.is_float());
+    EXPECT_FALSE(value.is_int32());
+    EXPECT_EQ(value.get_float(), 1.5f);
+    EXPECT_EQ(value.get_mav_param_type(), MAV_PARAM_TYPE_REAL32);
+
+    value.set_int32(-42);
+    EXPECT_TRUE(value.is_int32());
+    EXPECT_FALSE(value.is_float());
+    EXPECT_EQ(value.get_int32(), -42);
+    EXPECT_EQ(value.get_mav_param_type(), MAV_PARAM_TYPE_INT32);
+    EXPECT_EQ(value.get_string(), "-42");
+    EXPECT_TRUE(value == std::string("-42"));
+}
+
+TEST(ParamValue, CopyAndCompare)
+{
+    MAVLinkParameters::ParamValue value;
+    value.set_uint8(7);
+
+    MAVLinkParameters::ParamValue copy = value;
+    EXPECT_TRUE(copy.is_uint8());
+    EXPECT_TRUE(copy == value);
+
+    copy.set_uint8(8);
+    EXPECT_FALSE(copy == value);
+    EXPECT_EQ(value.get_uint8(), 7);
+
+    MAVLinkParameters::ParamValue other_type;
+    other_type.set_uint16(7);
+    EXPECT_FALSE(other_type == value);
+
+    static_assert(std::is_nothrow_move_constructible<MAVLinkParameters::ParamValue>::value,
+                  "ParamValue should be cheap to move");
+}
+
+TEST(ParamValue, SameValue)
+{
+    MAVLinkParameters::ParamValue none;
+    MAVLinkParameters::ParamValue value;
+    value.set_float(0.5f);
+    EXPECT_FALSE(none.is_same_value(value));
+    EXPECT_FALSE(value.is_same_value(none));
+
+    MAVLinkParameters::ParamValue same;
+    same.set_float(0.5f);
+    EXPECT_TRUE(same.is_same_value(value));
+
+    MAVLinkParameters::ParamValue other_type;
+    other_type.set_int32(0);
+    EXPECT_FALSE(other_type.is_same_value(value));
+
+    mavlink_param_ext_value_t ext_value {};
+    ext_value.param_type = MAV_PARAM_EXT_TYPE_CUSTOM;
+    strcpy(ext_value.param_value, "a");
+    MAVLinkParameters::ParamValue custom;
+    custom.set_from_mavlink_param_ext_value(ext_value);
+    MAVLinkParameters::ParamValue custom_same;
+    custom_same.set_from_mavlink_param_ext_value(ext_value);
+    EXPECT_TRUE(custom.is_same_value(custom_same));
+
+    strcpy(ext_value.param_value, "b");
+    MAVLinkParameters::ParamValue custom_other;
+    custom_other.set_from_mavlink_param_ext_value(ext_value);
+    EXPECT_FALSE(custom.is_same_value(custom_other));
+}
+
+TEST(ParamValue, ExtRoundTrip)
+{
+    MAVLinkParameters::ParamValue value;
+    value.set_uint64(0x123456789abcdefULL);
+    EXPECT_EQ(value.get_mav_param_ext_type(), MAV_PARAM_EXT_TYPE_UINT64);
+
+    mavlink_param_ext_value_t ext_value {};
+    value.get_128_bytes(ext_value.param_value);
+    ext_value.param_type = value.get_mav_param_ext_type();
+
+    MAVLinkParameters::ParamValue received;
+    received.set_from_mavlink_param_ext_value(ext_value);
+    EXPECT_TRUE(received.is_uint64());
+    EXPECT_TRUE(received == value);
+}
+
+TEST(ParamValue, FromXml)
+{
+    MAVLinkParameters::ParamValue value;
+
+    value.set_from_xml("int64", "-5");
+    EXPECT_TRUE(value.is_int64());
+    EXPECT_TRUE(value == std::string("-5"));
+
+    value.set_from_xml("double", "0.25");
+    EXPECT_TRUE(value.is_double());
+    EXPECT_EQ(value.get_double(), 0.25);
+}
+
+TEST(MAVLinkParameters, LoadParamFile)
+{
+    const std::string path = "mavlink_parameters_test.params";
+    {
+        std::ofstream file(path);
+        file << "# Onboard parameters for Vehicle 1\n"
+             << "#\n"
+             << "# Vehicle-Id Component-Id Name Value Type\n"
+             << "1\t1\tATT_BIAS_MAX\t0.050000000000000003\t9\n"
+             << "1\t1\tCOM_RC_LOSS_T\t0.5\t9\n"
+             << "1\t1\tSYS_AUTOSTART\t4001\t6\n"
+             << "1\t100\tCAM_ISO\t3\t6\n";
+    }
+
+    std::map<std::string, MAVLinkParameters::ParamValue> params;
+    ASSERT_TRUE(MAVLinkParameters::load_param_file(path, params));
+    // The camera param is left out.
+    ASSERT_EQ(params.size(), 3u);
+    EXPECT_TRUE(params["ATT_BIAS_MAX"].is_float());
+    EXPECT_EQ(params["ATT_BIAS_MAX"].get_float(), 0.05f);
+    EXPECT_EQ(params["COM_RC_LOSS_T"].get_float(), 0.5f);
+    EXPECT_TRUE(params["SYS_AUTOSTART"].is_int32());
+    EXPECT_EQ(params["SYS_AUTOSTART"].get_int32(), 4001);
+
+    {
+        std::ofstream file(path);
+        file << "1\t1\tSYS_AUTOSTART\tabc\t6\n";
+    }
+    params.clear();
+    EXPECT_FALSE(MAVLinkParameters::load_param_file(path, params));
+
+    std::remove(path.c_str());
+    EXPECT_FALSE(MAVLinkParameters::load_param_file(path, params));
+}
+
+TEST(MAVLinkParameters, CacheDownloadsAllParams)
+{
+    ParamsHarness harness;
+    float value = 0.0f;
+
+    // Without a download, values sent anyway are kept too.
+    harness.send_param_value("MPC_XY_CRUISE", 5.0f, 7, 10);
+    EXPECT_TRUE(harness.get_cached("MPC_XY_CRUISE", value));
+    EXPECT_EQ(value, 5.0f);
+    EXPECT_EQ(harness.num_list_requests(), 0u);
+
+    harness.params->request_all_params_async();
+    EXPECT_EQ(harness.num_list_requests(), 1u);
+    // Downloading already.
+    harness.params->request_all_params_async();
+    EXPECT_EQ(harness.num_list_requests(), 0u);
+
+    harness.send_param_value("PARAM_A", 1.0f, 0, 3);
+    harness.send_param_value("PARAM_C", 3.0f, 2, 3);
+    // Not one of the params, and not cached.
+    harness.send_hash(1234, 3);
+    EXPECT_FALSE(harness.get_cached("_HASH_CHECK", value));
+
+    // Index 1 got lost, it is asked for once the download stalls.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1300));
+    const auto requests = harness.take_read_requests();
+    EXPECT_EQ(requests.indices, std::vector<int16_t>({1}));
+    EXPECT_TRUE(requests.names.empty());
+    EXPECT_EQ(harness.num_list_requests(), 0u);
+
+    harness.send_param_value("PARAM_B", 2.0f, 1, 3);
+    EXPECT_TRUE(harness.get_cached("PARAM_A", value));
+    EXPECT_EQ(value, 1.0f);
+    EXPECT_TRUE(harness.get_cached("PARAM_B", value));
+    EXPECT_EQ(value, 2.0f);
+    EXPECT_TRUE(harness.get_cached("PARAM_C", value));
+    EXPECT_EQ(value, 3.0f);
+
+    // Complete, so nothing is asked for anymore, and a new request starts over.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    EXPECT_TRUE(harness.take_read_requests().indices.empty());
+    harness.params->request_all_params_async();
+    EXPECT_EQ(harness.num_list_requests(), 1u);
+}
+
+TEST(MAVLinkParameters, CacheRequestsListAgainIfNothingComes)
+{
+    ParamsHarness harness;
+
+    harness.params->request_all_params_async();
+    EXPECT_EQ(harness.num_list_requests(), 1u);
+
+    // Not a single param came in, so the list request got lost.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1300));
+    EXPECT_EQ(harness.num_list_requests(), 1u);
+    EXPECT_TRUE(harness.take_read_requests().indices.empty());
+}
+
+TEST(MAVLinkParameters, CacheDownloadsIfSnapshotNotConfirmed)
+{
+    const std::string path = "mavlink_parameters_test_snapshot.txt";
+    {
+        const float snapshot_value = 1.0f;
+        uint32_t bits;
+        memcpy(&bits, &snapshot_value, sizeof(bits));
+        std::ofstream file(path);
+        file << "hash 42\n" << "PARAM_A " << unsigned(MAV_PARAM_TYPE_REAL32) << ' ' << bits << '\n';
+    }
+
+    ParamsHarness harness;
+    float value = 0.0f;
+
+    // Only the hash is asked for, to check the snapshot.
+    harness.params->use_snapshot(path);
+    EXPECT_EQ(harness.take_read_requests().names, std::vector<std::string>({"_HASH_CHECK"}));
+    EXPECT_EQ(harness.num_list_requests(), 0u);
+
+    // Meanwhile, the params are not taken.
+    harness.send_param_value("PARAM_B", 2.0f, 1, 2);
+    EXPECT_FALSE(harness.get_cached("PARAM_B", value));
+
+    // No hash came back, so the snapshot can't be trusted.
+    std::this_thread::sleep_for(std::chrono::milliseconds(1300));
+    EXPECT_EQ(harness.num_list_requests(), 1u);
+    EXPECT_FALSE(harness.get_cached("PARAM_A", value));
+
+    std::remove(path.c_str());
+}
+
+TEST(MAVLinkParameters, SnapshotRoundTrip)
+{
+    const std::string path = "mavlink_parameters_test_round_trip.txt";
+    std::remove(path.c_str());
+    float value = 0.0f;
+
+    {
+        ParamsHarness harness;
+
+        // Nothing saved yet, so all params are downloaded, and saved once complete.
+        harness.params->use_snapshot(path);
+        EXPECT_EQ(harness.num_list_requests(), 1u);
+        harness.send_hash(1234, 2);
+        harness.send_param_value("PARAM_A", 1.0f, 0, 2);
+        harness.send_param_value("PARAM_B", 2.0f, 1, 2);
+    }
+
+    {
+        ParamsHarness harness;
+
+        // Same hash, so the snapshot is used and nothing downloaded.
+        harness.params->use_snapshot(path);
+        EXPECT_EQ(harness.take_read_requests().names, std::vector<std::string>({"_HASH_CHECK"}));
+        harness.send_hash(1234, 2);
+
+        EXPECT_TRUE(harness.get_cached("PARAM_A", value));
+        EXPECT_EQ(value, 1.0f);
+        EXPECT_TRUE(harness.get_cached("PARAM_B", value));
+        EXPECT_EQ(value, 2.0f);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+        EXPECT_EQ(harness.num_list_requests(), 0u);
+        const auto requests = harness.take_read_requests();
+        EXPECT_TRUE(requests.indices.empty());
+        EXPECT_TRUE(requests.names.empty());
+    }
+
+    {
+        ParamsHarness harness;
+
+        // The params changed on the autopilot since, so all of them are downloaded.
+        harness.params->use_snapshot(path);
+        EXPECT_EQ(harness.take_read_requests().names, std::vector<std::string>({"_HASH_CHECK"}));
+        harness.send_hash(5678, 3);
+        EXPECT_EQ(harness.num_list_requests(), 1u);
+        EXPECT_FALSE(harness.get_cached("PARAM_A", value));
+
+        // The list ends with the hash again.
+        harness.send_param_value("PARAM_A", 1.0f, 0, 3);
+        harness.send_param_value("PARAM_B", 2.5f, 1, 3);
+        harness.send_hash(5678, 3);
+        harness.send_param_value("PARAM_C", 3.0f, 2, 3);
+        EXPECT_TRUE(harness.get_cached("PARAM_B", value));
+        EXPECT_EQ(value, 2.5f);
+        EXPECT_TRUE(harness.get_cached("PARAM_C", value));
+        EXPECT_EQ(value, 3.0f);
+    }
+
+    // The new download replaced the snapshot.
+    {
+        std::ifstream file(path);
+        std::string line;
+        ASSERT_TRUE(std::getline(file, line));
+        EXPECT_EQ(line, "hash 5678");
+        size_t num_params = 0;
+        while (std::getline(file, line)) {
+            ++num_params;
+        }
+        EXPECT_EQ(num_params, 3u);
+    }
+
+    std::remove(path.c_str());
+}
+
+namespace {
+
+// Results by index of the set, -1 while it is not done.
+class SetResults
+{
+public:
+    explicit SetResults(size_t num_sets) : _results(num_sets, -1) {}
+
+    MAVLinkParameters::set_param_callback_t callback(size_t index)
+    {
+        return [this, index](bool success) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _results[index] = success ? 1 : 0;
+        };
+    }
+
+    std::vector<int> get()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _results;
+    }
+
+private:
+    std::mutex _mutex {};
+    std::vector<int> _results;
+};
+
+MAVLinkParameters::ParamValue make_float_value(float value)
+{
+    MAVLinkParameters::ParamValue param_value;
+    param_value.set_float(value);
+    return param_value;
+}
+
+} // namespace
+
+TEST(MAVLinkParameters, SetsKeepWindowOfRequests)
+{
+    // Outlives the params, which call back into it.
+    SetResults results(10);
+    ParamsHarness harness;
+
+    for (size_t i = 0; i < 10; ++i) {
+        harness.params->set_param_async("SET_" + std::to_string(i), make_float_value(float(i)),
+                                        results.callback(i));
+    }
+    harness.params->do_work();
+
+    // Eight at a time.
+    auto sets = harness.take_sets();
+    ASSERT_EQ(sets.size(), 8u);
+    for (size_t i = 0; i < sets.size(); ++i) {
+        EXPECT_EQ(sets[i].first, "SET_" + std::to_string(i));
+        EXPECT_EQ(sets[i].second, float(i));
+    }
+
+    // The value sent back acks the set of that param only, in whatever order.
+    harness.send_param_value("SET_5", 5.0f, 5, 10);
+    std::vector<int> expected(10, -1);
+    expected[5] = 1;
+    EXPECT_EQ(results.get(), expected);
+
+    // Which makes room for the next one.
+    harness.params->do_work();
+    sets = harness.take_sets();
+    ASSERT_EQ(sets.size(), 1u);
+    EXPECT_EQ(sets[0].first, "SET_8");
+
+    for (uint16_t i : {8, 0, 7, 1, 2, 3, 4, 6}) {
+        harness.send_param_value(("SET_" + std::to_string(i)).c_str(), float(i), i, 10);
+    }
+    harness.params->do_work();
+    sets = harness.take_sets();
+    ASSERT_EQ(sets.size(), 1u);
+    EXPECT_EQ(sets[0].first, "SET_9");
+
+    harness.send_param_value("SET_9", 9.0f, 9, 10);
+    EXPECT_EQ(results.get(), std::vector<int>(10, 1));
+}
+
+TEST(MAVLinkParameters, SetOfSameParamWaitsForAck)
+{
+    SetResults results(2);
+    ParamsHarness harness;
+
+    harness.params->set_param_async("SET_A", make_float_value(1.0f), results.callback(0));
+    harness.params->set_param_async("SET_A", make_float_value(2.0f), results.callback(1));
+    harness.params->do_work();
+
+    // The acks couldn't be told apart, so the second one waits.
+    auto sets = harness.take_sets();
+    ASSERT_EQ(sets.size(), 1u);
+    EXPECT_EQ(sets[0].second, 1.0f);
+
+    harness.send_param_value("SET_A", 1.0f, 0, 1);
+    harness.params->do_work();
+    sets = harness.take_sets();
+    ASSERT_EQ(sets.size(), 1u);
+    EXPECT_EQ(sets[0].second, 2.0f);
+
+    harness.send_param_value("SET_A", 2.0f, 0, 1);
+    EXPECT_EQ(results.get(), std::vector<int>({1, 1}));
+}
+
+TEST(MAVLinkParameters, SetResentOnTimeout)
+{
+    SetResults results(1);
+    ParamsHarness harness;
+
+    harness.params->set_param_async("SET_A", make_float_value(1.0f), results.callback(0));
+    harness.params->do_work();
+    EXPECT_EQ(harness.take_sets().size(), 1u);
+
+    // Resent after the default timeout of 0.5 s, then acked.
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    EXPECT_EQ(harness.take_sets().size(), 1u);
+    EXPECT_EQ(results.get(), std::vector<int>({-1}));
+
+    harness.send_param_value("SET_A", 1.0f, 0, 1);
+    EXPECT_EQ(results.get(), std::vector<int>({1}));
+}
+
+TEST(MAVLinkParameters, SetFailsAfterRetries)
+{
+    ParamsHarness harness;
+    // Short timeouts, as after fast round trips.
+    for (int i = 0; i < 10; ++i) {
+        harness.system->get_rtt_estimator().add_sample(0.001);
+    }
+
+    auto prom = std::make_shared<std::promise<bool>>();
+    auto fut = prom->get_future();
+    harness.params->set_param_async("SET_A", make_float_value(1.0f), [prom](bool success) {
+        prom->set_value(success);
+    });
+    harness.params->do_work();
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_FALSE(fut.get());
+    // Sent once and retried twice.
+    EXPECT_EQ(harness.take_sets().size(), 3u);
+}
+
+TEST(MAVLinkParameters, SubscriptionsGetChangedValues)
+{
+    ParamsHarness harness;
+
+    std::vector<std::pair<std::string, float>> cruise_changes;
+    std::vector<std::string> all_changes;
+    const auto cruise_handle = harness.params->subscribe_param(
+                                   "MPC_XY_CRUISE",
+    [&cruise_changes](const std::string & name, MAVLinkParameters::ParamValue value) {
+        cruise_changes.push_back(std::make_pair(name, value.get_float()));
+    });
+    harness.params->subscribe_param(
+        "", [&all_changes](const std::string & name, MAVLinkParameters::ParamValue) {
+        all_changes.push_back(name);
+    });
+
+    harness.send_param_value("MPC_XY_CRUISE", 5.0f, 7, 10);
+    harness.send_param_value("MIS_TAKEOFF_ALT", 2.5f, 3, 10);
+    ASSERT_EQ(cruise_changes.size(), 1u);
+    EXPECT_EQ(cruise_changes[0].first, "MPC_XY_CRUISE");
+    EXPECT_EQ(cruise_changes[0].second, 5.0f);
+    EXPECT_EQ(all_changes, std::vector<std::string>({"MPC_XY_CRUISE", "MIS_TAKEOFF_ALT"}));
+
+    // Sent again, e.g. in a download, but the same value.
+    harness.send_param_value("MPC_XY_CRUISE", 5.0f, 7, 10);
+    EXPECT_EQ(cruise_changes.size(), 1u);
+    EXPECT_EQ(all_changes.size(), 2u);
+
+    harness.send_param_value("MPC_XY_CRUISE", 8.0f, 7, 10);
+    ASSERT_EQ(cruise_changes.size(), 2u);
+    EXPECT_EQ(cruise_changes[1].second, 8.0f);
+    EXPECT_EQ(all_changes.size(), 3u);
+
+    harness.params->unsubscribe_param(cruise_handle);
+    harness.send_param_value("MPC_XY_CRUISE", 9.0f, 7, 10);
+    EXPECT_EQ(cruise_changes.size(), 2u);
+    EXPECT_EQ(all_changes.size(), 4u);
+}
@@ -1,5 +1,7 @@
 #include "mavlink_receiver.h"
 #include "global_include.h"
+#include "trace.h"
+#include <cstring>
 
 #if DROP_DEBUG ==1
 #include <iomanip>
@@ -7,19 +9,52 @@
 
 namespace dronecore {
 
-MAVLinkReceiver::MAVLinkReceiver(uint8_t channel) :
-    _channel(channel)
+MAVLinkReceiver::MAVLinkReceiver() :
+    _counters(_own_counters)
 #if DROP_DEBUG == 1
     , _last_time()
 #endif
 {
 }
 
+MAVLinkReceiver::MAVLinkReceiver(Counters &counters, bool shared_counters) :
+    _counters(counters),
+    _shared_counters(shared_counters)
+#if DROP_DEBUG == 1
+    , _last_time()
+#endif
+{
+}
+
+MAVLinkReceiver::Stats MAVLinkReceiver::Counters::get() const
+{
+    Stats stats;
+    stats.bytes_received = bytes_received.load(std::memory_order_relaxed);
+    stats.frames_parsed = frames_parsed.load(std::memory_order_relaxed);
+    stats.crc_errors = crc_errors.load(std::memory_order_relaxed);
+    stats.parse_errors = parse_errors.load(std::memory_order_relaxed);
+    stats.sequence_gaps = sequence_gaps.load(std::memory_order_relaxed);
+    stats.frames_filtered = frames_filtered.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MAVLinkReceiver::add(std::atomic<uint64_t> &counter, uint64_t value)
+{
+    if (_shared_counters) {
+        counter.fetch_add(value, std::memory_order_relaxed);
+        return;
+    }
+    // There is only one writer, so this doesn't need to be a locked increment.
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
 void MAVLinkReceiver::set_new_datagram(char *datagram, unsigned datagram_len)
 {
     _datagram = datagram;
     _datagram_len = datagram_len;
 
+    add(_counters.bytes_received, datagram_len);
+
 #if DROP_DEBUG == 1
     _bytes_received += _datagram_len;
 #endif
@@ -27,15 +62,78 @@ void MAVLinkReceiver::set_new_datagram(char *datagram, unsigned datagram_len)
 
 bool MAVLinkReceiver::parse_message()
 {
+    DRONECORE_TRACE_SCOPE("parse");
+    while (parse_next_message()) {
+        if (_filter == nullptr || _filter->accepts(_last_message.msgid)) {
+            return true;
+        }
+        add(_counters.frames_filtered, 1);
+    }
+    return false;
+}
+
+bool MAVLinkReceiver::parse_next_message()
+{
+    // Most of the time a datagram or read starts with a complete message, so
+    // we can copy it out in one go instead of feeding the parser byte by byte.
+    while (_status.parse_state <= MAVLINK_PARSE_STATE_IDLE) {
+        skip_to_frame_start();
+
+        const FramingResult result = frame_message_directly();
+        if (result == FramingResult::FRAMED) {
+            count_message();
+#if DROP_DEBUG == 1
+            debug_drop_rate();
+#endif
+            return true;
+        }
+        if (result != FramingResult::BAD_CHECKSUM) {
+            break;
+        }
+    }
+
+    uint64_t crc_errors = 0;
+    uint64_t parse_errors = 0;
+
     // Note that one datagram can contain multiple mavlink messages.
     for (unsigned i = 0; i < _datagram_len; ++i) {
-        if (mavlink_parse_char(_channel, _datagram[i], &_last_message, &_status) == 1) {
+        const uint8_t previous_state = _status.parse_state;
+        const uint8_t result = parse_char(uint8_t(_datagram[i]));
+
+        // The parser reports the errors since its last call here.
+        parse_errors += _status.packet_rx_drop_count;
+
+        // Once past the first checksum byte the frame is either good or has a
+        // wrong checksum. Signed frames wait for the signature first.
+        if (result != 1 &&
+            previous_state >= MAVLINK_PARSE_STATE_GOT_CRC1 &&
+            previous_state < MAVLINK_PARSE_STATE_SIGNATURE_WAIT &&
+            _status.parse_state != MAVLINK_PARSE_STATE_SIGNATURE_WAIT) {
+            ++crc_errors;
+        }
+
+        if (result == 1) {
+
+            const bool is_v1 = (_status.flags & MAVLINK_STATUS_FLAG_IN_MAVLINK1) != 0;
+            const bool is_signed = !is_v1 &&
+                                   (_last_message.incompat_flags & MAVLINK_IFLAG_SIGNED) != 0;
+            _last_frame_len = _last_message.len + MAVLINK_NUM_CHECKSUM_BYTES + 1 +
+                              (is_v1 ? MAVLINK_CORE_HEADER_MAVLINK1_LEN : MAVLINK_CORE_HEADER_LEN) +
+                              (is_signed ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+            // If it started in an earlier datagram it is put together on request.
+            _last_frame = (i + 1 >= _last_frame_len) ?
+                          reinterpret_cast<const uint8_t *>(_datagram + i + 1 - _last_frame_len) :
+                          nullptr;
 
             // Move the pointer to the datagram forward by the amount parsed.
             _datagram += (i + 1);
             // And decrease the length, so we don't overshoot in the next round.
             _datagram_len -= (i + 1);
 
+            add(_counters.crc_errors, crc_errors);
+            add(_counters.parse_errors, parse_errors);
+            count_message();
+
 #if DROP_DEBUG == 1
             debug_drop_rate();
 #endif
@@ -45,12 +143,239 @@ bool MAVLinkReceiver::parse_message()
         }
     }
 
+    add(_counters.crc_errors, crc_errors);
+    add(_counters.parse_errors, parse_errors);
+
     // No (more) messages, let's give up.
     _datagram = nullptr;
     _datagram_len = 0;
     return false;
 }
 
+uint8_t MAVLinkReceiver::parse_char(uint8_t c)
+{
+    // The same as mavlink_parse_char, just on our own parse state.
+    const uint8_t result = mavlink_frame_char_buffer(&_parse_message, &_parse_status, c,
+                                                     &_last_message, &_status);
+    if (result == MAVLINK_FRAMING_BAD_CRC || result == MAVLINK_FRAMING_BAD_SIGNATURE) {
+        // Dropped. Unlike mavlink_parse_char, a last byte of 0xFD is not taken as
+        // the start of the next frame: _status decides whether the next frame is
+        // framed directly, so both need to agree that the parser is idle. A frame
+        // right after is found by its own start byte.
+        _mav_parse_error(&_parse_status);
+        _parse_status.msg_received = MAVLINK_FRAMING_INCOMPLETE;
+        _parse_status.parse_state = MAVLINK_PARSE_STATE_IDLE;
+        _status.msg_received = MAVLINK_FRAMING_INCOMPLETE;
+        _status.parse_state = MAVLINK_PARSE_STATE_IDLE;
+        return 0;
+    }
+    return result;
+}
+
+namespace {
+
+constexpr uint64_t ALL_BYTES(uint8_t byte)
+{
+    return uint64_t(byte) * 0x0101010101010101ull;
+}
+
+// Non-zero if any byte of the word is zero.
+constexpr uint64_t has_zero_byte(uint64_t word)
+{
+    return (word - ALL_BYTES(0x01)) & ~word & ALL_BYTES(0x80);
+}
+
+} // namespace
+
+void MAVLinkReceiver::skip_to_frame_start()
+{
+    // The parser ignores everything in between frames one byte at a time,
+    // often there is nothing to skip though.
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(_datagram);
+    const uint8_t *end = begin + _datagram_len;
+    const uint8_t *pos = begin;
+    if (pos == end || *pos == MAVLINK_STX || *pos == MAVLINK_STX_MAVLINK1) {
+        return;
+    }
+
+    // Look at 8 bytes at a time until one of them might be a start byte.
+    while (end - pos >= 8) {
+        uint64_t word;
+        std::memcpy(&word, pos, sizeof(word));
+        if ((has_zero_byte(word ^ ALL_BYTES(MAVLINK_STX)) |
+             has_zero_byte(word ^ ALL_BYTES(MAVLINK_STX_MAVLINK1))) != 0) {
+            break;
+        }
+        pos += 8;
+    }
+    while (pos != end && *pos != MAVLINK_STX && *pos != MAVLINK_STX_MAVLINK1) {
+        ++pos;
+    }
+
+    _datagram += (pos - begin);
+    _datagram_len -= unsigned(pos - begin);
+}
+
+MAVLinkReceiver::FramingResult MAVLinkReceiver::frame_message_directly()
+{
+    // Everything special (incomplete or unknown messages) is left to the
+    // normal parser by returning UNHANDLED without consuming anything.
+    if (_datagram_len == 0) {
+        return FramingResult::UNHANDLED;
+    }
+
+    const uint8_t *buf = reinterpret_cast<const uint8_t *>(_datagram);
+
+    const bool is_v2 = (buf[0] == MAVLINK_STX);
+    if (!is_v2 && buf[0] != MAVLINK_STX_MAVLINK1) {
+        return FramingResult::UNHANDLED;
+    }
+
+    const unsigned header_len = is_v2 ? MAVLINK_CORE_HEADER_LEN : MAVLINK_CORE_HEADER_MAVLINK1_LEN;
+    if (_datagram_len < 1 + header_len) {
+        return FramingResult::UNHANDLED;
+    }
+
+    const uint8_t payload_len = buf[1];
+    uint8_t incompat_flags = 0;
+    uint8_t compat_flags = 0;
+    uint8_t seq, sysid, compid;
+    uint32_t msgid;
+
+    if (is_v2) {
+        incompat_flags = buf[2];
+        compat_flags = buf[3];
+        seq = buf[4];
+        sysid = buf[5];
+        compid = buf[6];
+        msgid = uint32_t(buf[7]) | (uint32_t(buf[8]) << 8) | (uint32_t(buf[9]) << 16);
+
+        if ((incompat_flags & ~MAVLINK_IFLAG_SIGNED) != 0) {
+            // Unknown flags.
+            return FramingResult::UNHANDLED;
+        }
+    } else {
+        seq = buf[2];
+        sysid = buf[3];
+        compid = buf[4];
+        msgid = buf[5];
+    }
+
+    // Signing is not set up, so like the parser we pass the signature on
+    // without checking it.
+    const bool is_signed = (incompat_flags & MAVLINK_IFLAG_SIGNED) != 0;
+
+    const unsigned frame_len = 1 + header_len + payload_len + MAVLINK_NUM_CHECKSUM_BYTES +
+                               (is_signed ? MAVLINK_SIGNATURE_BLOCK_LEN : 0);
+    if (_datagram_len < frame_len) {
+        return FramingResult::UNHANDLED;
+    }
+
+    const mavlink_msg_entry_t *entry = get_msg_entry(msgid);
+    if (entry == nullptr || payload_len > entry->max_msg_len) {
+        return FramingResult::UNHANDLED;
+    }
+
+    uint16_t checksum = MAVLinkCrc::calculate(&buf[1], header_len + payload_len);
+    checksum = MAVLinkCrc::accumulate(checksum, entry->crc_extra);
+
+    const uint8_t *ck = &buf[1 + header_len + payload_len];
+    if (ck[0] != (checksum & 0xFF) || ck[1] != (checksum >> 8)) {
+        // The parser would drop the frame as well, and count it the same way.
+        add(_counters.crc_errors, 1);
+        add(_counters.parse_errors, 1);
+        _datagram += frame_len;
+        _datagram_len -= frame_len;
+        return FramingResult::BAD_CHECKSUM;
+    }
+
+    _last_message.magic = buf[0];
+    _last_message.len = payload_len;
+    _last_message.incompat_flags = incompat_flags;
+    _last_message.compat_flags = compat_flags;
+    _last_message.seq = seq;
+    _last_message.sysid = sysid;
+    _last_message.compid = compid;
+    _last_message.msgid = msgid;
+    _last_message.checksum = checksum;
+    _last_message.ck[0] = ck[0];
+    _last_message.ck[1] = ck[1];
+
+    char *payload = _MAV_PAYLOAD_NON_CONST(&_last_message);
+    std::memcpy(payload, &buf[1 + header_len], payload_len);
+    // MAVLink 2 truncates trailing zeros, restore them like the parser does.
+    std::memset(payload + payload_len, 0, entry->max_msg_len - payload_len);
+
+    if (is_signed) {
+        std::memcpy(_last_message.signature, &ck[MAVLINK_NUM_CHECKSUM_BYTES],
+                    MAVLINK_SIGNATURE_BLOCK_LEN);
+    }
+
+    // Keep the parse status up-to-date the same way mavlink_parse_char does.
+    _status.msg_received = MAVLINK_FRAMING_OK;
+    _status.current_rx_seq = seq;
+    if (_status.packet_rx_success_count == 0) {
+        _status.packet_rx_drop_count = 0;
+    }
+    ++_status.packet_rx_success_count;
+    if (is_v2) {
+        _status.flags &= ~MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    } else {
+        _status.flags |= MAVLINK_STATUS_FLAG_IN_MAVLINK1;
+    }
+
+    _last_frame = buf;
+    _last_frame_len = frame_len;
+
+    _datagram += frame_len;
+    _datagram_len -= frame_len;
+    return FramingResult::FRAMED;
+}
+
+void MAVLinkReceiver::count_message()
+{
+    add(_counters.frames_parsed, 1);
+
+    const uint16_t key = uint16_t((_last_message.sysid << 8) | _last_message.compid);
+    SequenceSlot &slot = _sequence_slots[(_last_message.sysid * 31u + _last_message.compid) & 0xFF];
+
+    if (slot.used && slot.key == key) {
+        const uint8_t gap = uint8_t(_last_message.seq - slot.next_seq);
+        // Anything bigger is more likely a reboot or reordering than loss.
+        if (gap < 128) {
+            add(_counters.sequence_gaps, gap);
+        }
+    }
+    slot.key = key;
+    slot.next_seq = uint8_t(_last_message.seq + 1);
+    slot.used = true;
+}
+
+const uint8_t *MAVLinkReceiver::get_last_frame(size_t &frame_len)
+{
+    if (_last_frame == nullptr) {
+        _last_frame_len = mavlink_msg_to_send_buffer(_frame_buffer, &_last_message);
+        _last_frame = _frame_buffer;
+    }
+    frame_len = _last_frame_len;
+    return _last_frame;
+}
+
+const mavlink_msg_entry_t *MAVLinkReceiver::get_msg_entry(uint32_t msgid)
+{
+    MsgEntryCacheSlot &slot = _msg_entry_cache[msgid & 0xFF];
+    if (slot.entry != nullptr && slot.msgid == msgid) {
+        return slot.entry;
+    }
+
+    const mavlink_msg_entry_t *entry = mavlink_get_msg_entry(msgid);
+    if (entry != nullptr) {
+        slot.msgid = msgid;
+        slot.entry = entry;
+    }
+    return entry;
+}
+
 #if DROP_DEBUG == 1
 void MAVLinkReceiver::debug_drop_rate()
 {
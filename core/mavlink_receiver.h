@@ -2,18 +2,49 @@
 
 #include "mavlink_include.h"
 #include "global_include.h"
+#include "message_id_filter.h"
 #include <cstdint>
+#include <atomic>
 
 namespace dronecore {
 
 class MAVLinkReceiver
 {
 public:
-    explicit MAVLinkReceiver(uint8_t channel);
+    struct Stats {
+        uint64_t bytes_received;
+        uint64_t frames_parsed;
+        // Frames thrown away because of a wrong checksum.
+        uint64_t crc_errors;
+        // Everything the parser had to discard, including the CRC errors.
+        uint64_t parse_errors;
+        // Frames missing according to the sequence numbers of each component.
+        uint64_t sequence_gaps;
+        // Frames parsed but not handed on because of the message ID filter.
+        uint64_t frames_filtered;
+    };
 
-    uint8_t get_channel()
+    // Only written by the thread feeding the receiver, so they can be read
+    // at any time from other threads without slowing down the parsing.
+    // They can outlive the receiver, e.g. to keep counting across a restart.
+    // Receivers fed by different threads can share them if they are told so.
+    struct Counters {
+        std::atomic<uint64_t> bytes_received {0};
+        std::atomic<uint64_t> frames_parsed {0};
+        std::atomic<uint64_t> crc_errors {0};
+        std::atomic<uint64_t> parse_errors {0};
+        std::atomic<uint64_t> sequence_gaps {0};
+        std::atomic<uint64_t> frames_filtered {0};
+
+        Stats get() const;
+    };
+
+    MAVLinkReceiver();
+    explicit MAVLinkReceiver(Counters &counters, bool shared_counters = false);
+
+    Stats get_stats() const
     {
-        return _channel;
+        return _counters.get();
     }
 
     mavlink_message_t &get_last_message()
@@ -28,8 +59,18 @@ public:
 
     void set_new_datagram(char *datagram, unsigned datagram_len);
 
+    // Frames rejected by the filter are skipped by parse_message(), before
+    // anything else looks at them. The filter needs to outlive the receiver.
+    void set_filter(const MessageIdFilter *filter) { _filter = filter; }
+
     bool parse_message();
 
+    // The raw bytes of the last message, e.g. for forwarding it unchanged.
+    // Usually this points into the datagram, only if the message was split
+    // over several datagrams it needs to be put together again.
+    // Valid until the next call of parse_message() or set_new_datagram().
+    const uint8_t *get_last_frame(size_t &frame_len);
+
 #if DROP_DEBUG == 1
     void debug_drop_rate();
     void print_line(const char *index, unsigned count, unsigned count_total,
@@ -37,12 +78,59 @@ public:
 #endif
 
 private:
-    uint8_t _channel;
+    enum class FramingResult {
+        FRAMED,
+        // Dropped and counted, the next one can be framed.
+        BAD_CHECKSUM,
+        // Left for the parser.
+        UNHANDLED
+    };
+
+    bool parse_next_message();
+    uint8_t parse_char(uint8_t c);
+    void skip_to_frame_start();
+    FramingResult frame_message_directly();
+    void count_message();
+    void add(std::atomic<uint64_t> &counter, uint64_t value);
+    const mavlink_msg_entry_t *get_msg_entry(uint32_t msgid);
+
     mavlink_message_t _last_message = {};
+    // What the parser reports after every byte.
     mavlink_status_t _status = {};
+    // The parser works on these instead of the global ones of a MAVLink
+    // channel, so there can be any number of receivers.
+    mavlink_message_t _parse_message = {};
+    mavlink_status_t _parse_status = {};
     char *_datagram = nullptr;
     unsigned _datagram_len = 0;
 
+    const uint8_t *_last_frame = nullptr;
+    size_t _last_frame_len = 0;
+    uint8_t _frame_buffer[MAVLINK_MAX_PACKET_LEN] = {};
+
+    // Direct mapped cache in front of the binary search in mavlink_get_msg_entry,
+    // a link usually only carries a few dozen different messages.
+    struct MsgEntryCacheSlot {
+        uint32_t msgid;
+        const mavlink_msg_entry_t *entry;
+    };
+    MsgEntryCacheSlot _msg_entry_cache[256] = {};
+
+    Counters _own_counters {};
+    Counters &_counters;
+    bool _shared_counters {false};
+
+    const MessageIdFilter *_filter {nullptr};
+
+    // Same for the sequence numbers, a collision of two components only
+    // means that a gap is missed.
+    struct SequenceSlot {
+        uint16_t key;
+        uint8_t next_seq;
+        bool used;
+    };
+    SequenceSlot _sequence_slots[256] = {};
+
 #if DROP_DEBUG == 1
     unsigned _bytes_received = 0;
 
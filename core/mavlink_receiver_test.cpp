@@ -0,0 +1,330 @@
+#include "mavlink_receiver.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+static std::vector<char> pack_heartbeat(uint8_t sysid, uint8_t custom_mode)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(sysid, MAV_COMP_ID_AUTOPILOT1, &message,
+                               MAV_TYPE_GENERIC, MAV_AUTOPILOT_GENERIC, 0, custom_mode, 0);
+
+    std::vector<char> buffer(MAVLINK_MAX_PACKET_LEN);
+    const uint16_t len = mavlink_msg_to_send_buffer(reinterpret_cast<uint8_t *>(buffer.data()),
+                                                    &message);
+    buffer.resize(len);
+    return buffer;
+}
+
+TEST(MAVLinkReceiver, MultipleMessagesInOneDatagram)
+{
+    MAVLinkReceiver receiver;
+
+    std::vector<char> datagram;
+    for (uint8_t i = 1; i <= 3; ++i) {
+        auto packed = pack_heartbeat(i, 10 + i);
+        datagram.insert(datagram.end(), packed.begin(), packed.end());
+    }
+
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+
+    for (uint8_t i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(receiver.parse_message());
+        const mavlink_message_t &message = receiver.get_last_message();
+        EXPECT_EQ(message.msgid, MAVLINK_MSG_ID_HEARTBEAT);
+        EXPECT_EQ(message.sysid, i);
+        EXPECT_EQ(message.compid, MAV_COMP_ID_AUTOPILOT1);
+
+        mavlink_heartbeat_t heartbeat;
+        mavlink_msg_heartbeat_decode(&message, &heartbeat);
+        EXPECT_EQ(heartbeat.custom_mode, 10u + i);
+    }
+    EXPECT_FALSE(receiver.parse_message());
+}
+
+TEST(MAVLinkReceiver, MessageSplitOverDatagrams)
+{
+    MAVLinkReceiver receiver;
+
+    auto packed = pack_heartbeat(42, 7);
+    const unsigned first_len = unsigned(packed.size()) / 2;
+
+    receiver.set_new_datagram(packed.data(), first_len);
+    EXPECT_FALSE(receiver.parse_message());
+
+    receiver.set_new_datagram(packed.data() + first_len, unsigned(packed.size()) - first_len);
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 42);
+
+    // Afterwards the next complete one is fine again.
+    auto next = pack_heartbeat(43, 8);
+    receiver.set_new_datagram(next.data(), unsigned(next.size()));
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 43);
+}
+
+TEST(MAVLinkReceiver, GarbageAndBadChecksum)
+{
+    MAVLinkReceiver receiver;
+
+    auto corrupted = pack_heartbeat(1, 1);
+    corrupted[corrupted.size() - 1] ^= 0x55;
+
+    std::vector<char> datagram {'x', 'y', 'z'};
+    datagram.insert(datagram.end(), corrupted.begin(), corrupted.end());
+    auto valid = pack_heartbeat(2, 2);
+    datagram.insert(datagram.end(), valid.begin(), valid.end());
+
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 2);
+    EXPECT_FALSE(receiver.parse_message());
+}
+
+TEST(MAVLinkReceiver, BadChecksumEndingInStartByte)
+{
+    MAVLinkReceiver receiver;
+
+    // The last checksum byte looks like the start of a frame.
+    auto corrupted = pack_heartbeat(1, 1);
+    if (uint8_t(corrupted.back()) == MAVLINK_STX) {
+        corrupted[MAVLINK_NUM_HEADER_BYTES] ^= 0x55;
+    }
+    corrupted.back() = char(MAVLINK_STX);
+
+    // Split, so that it goes through the parser byte by byte.
+    const unsigned first_len = unsigned(corrupted.size()) / 2;
+    receiver.set_new_datagram(corrupted.data(), first_len);
+    EXPECT_FALSE(receiver.parse_message());
+
+    std::vector<char> datagram(corrupted.begin() + first_len, corrupted.end());
+    auto valid = pack_heartbeat(2, 2);
+    datagram.insert(datagram.end(), valid.begin(), valid.end());
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 2);
+    EXPECT_FALSE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_stats().crc_errors, 1u);
+
+    // The parser is not left in the middle of a frame either.
+    auto next = pack_heartbeat(3, 3);
+    const unsigned next_first_len = unsigned(next.size()) / 2;
+    receiver.set_new_datagram(next.data(), next_first_len);
+    EXPECT_FALSE(receiver.parse_message());
+    receiver.set_new_datagram(next.data() + next_first_len,
+                              unsigned(next.size()) - next_first_len);
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 3);
+}
+
+TEST(MAVLinkReceiver, SignedMessage)
+{
+    MAVLinkReceiver receiver;
+
+    // Turn a heartbeat into a signed one with a dummy signature.
+    auto packed = pack_heartbeat(5, 3);
+    ASSERT_EQ(uint8_t(packed[0]), MAVLINK_STX);
+    packed[2] = char(packed[2] | MAVLINK_IFLAG_SIGNED);
+
+    uint8_t *buf = reinterpret_cast<uint8_t *>(packed.data());
+    const unsigned crc_len = MAVLINK_CORE_HEADER_LEN + buf[1];
+    uint16_t checksum = crc_calculate(&buf[1], uint16_t(crc_len));
+    crc_accumulate(mavlink_get_msg_entry(MAVLINK_MSG_ID_HEARTBEAT)->crc_extra, &checksum);
+    packed[1 + crc_len] = char(checksum & 0xFF);
+    packed[1 + crc_len + 1] = char(checksum >> 8);
+
+    for (uint8_t i = 0; i < MAVLINK_SIGNATURE_BLOCK_LEN; ++i) {
+        packed.push_back(char(i));
+    }
+
+    auto next = pack_heartbeat(6, 4);
+    packed.insert(packed.end(), next.begin(), next.end());
+
+    receiver.set_new_datagram(packed.data(), unsigned(packed.size()));
+
+    ASSERT_TRUE(receiver.parse_message());
+    const mavlink_message_t &message = receiver.get_last_message();
+    EXPECT_EQ(message.sysid, 5);
+    EXPECT_EQ(message.incompat_flags & MAVLINK_IFLAG_SIGNED, MAVLINK_IFLAG_SIGNED);
+    EXPECT_EQ(message.signature[MAVLINK_SIGNATURE_BLOCK_LEN - 1], MAVLINK_SIGNATURE_BLOCK_LEN - 1);
+
+    // The signature is skipped correctly.
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 6);
+    EXPECT_FALSE(receiver.parse_message());
+}
+
+TEST(MAVLinkReceiver, LastFrame)
+{
+    MAVLinkReceiver receiver;
+
+    auto packed = pack_heartbeat(7, 1);
+    receiver.set_new_datagram(packed.data(), unsigned(packed.size()));
+    ASSERT_TRUE(receiver.parse_message());
+
+    size_t frame_len = 0;
+    const uint8_t *frame = receiver.get_last_frame(frame_len);
+    ASSERT_EQ(frame_len, packed.size());
+    EXPECT_EQ(reinterpret_cast<const char *>(frame), packed.data());
+
+    // Split over two datagrams the frame is put together again.
+    auto split = pack_heartbeat(8, 2);
+    receiver.set_new_datagram(split.data(), 3);
+    EXPECT_FALSE(receiver.parse_message());
+    receiver.set_new_datagram(split.data() + 3, unsigned(split.size()) - 3);
+    ASSERT_TRUE(receiver.parse_message());
+
+    frame = receiver.get_last_frame(frame_len);
+    ASSERT_EQ(frame_len, split.size());
+    EXPECT_EQ(std::vector<char>(frame, frame + frame_len), split);
+}
+
+TEST(MAVLinkReceiver, Stats)
+{
+    MAVLinkReceiver::Counters counters;
+    MAVLinkReceiver receiver(counters);
+
+    auto first = pack_heartbeat(9, 1);
+    // Uses up a sequence number but never arrives.
+    pack_heartbeat(9, 2);
+    auto corrupted = pack_heartbeat(9, 3);
+    corrupted[corrupted.size() - 1] ^= 0x55;
+    auto last = pack_heartbeat(9, 4);
+
+    std::vector<char> datagram = first;
+    datagram.insert(datagram.end(), corrupted.begin(), corrupted.end());
+    datagram.insert(datagram.end(), last.begin(), last.end());
+
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+    while (receiver.parse_message()) {}
+
+    const auto stats = receiver.get_stats();
+    EXPECT_EQ(stats.bytes_received, datagram.size());
+    EXPECT_EQ(stats.frames_parsed, 2u);
+    EXPECT_EQ(stats.crc_errors, 1u);
+    EXPECT_GE(stats.parse_errors, 1u);
+    // The lost and the corrupted one.
+    EXPECT_EQ(stats.sequence_gaps, 2u);
+
+    // The counters are shared and not reset by a new receiver.
+    MAVLinkReceiver other_receiver(counters);
+    EXPECT_EQ(other_receiver.get_stats().frames_parsed, 2u);
+}
+
+TEST(MAVLinkReceiver, SkipsFilteredMessages)
+{
+    MAVLinkReceiver::Counters counters;
+    MAVLinkReceiver receiver(counters);
+    MessageIdFilter filter;
+    filter.set(MessageIdFilter::Mode::DENY, {MAVLINK_MSG_ID_ATTITUDE});
+    receiver.set_filter(&filter);
+
+    std::vector<char> datagram = pack_heartbeat(1, 0);
+    for (unsigned i = 0; i < 3; ++i) {
+        mavlink_message_t message;
+        mavlink_msg_attitude_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                                  i, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+        uint8_t packed[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len = mavlink_msg_to_send_buffer(packed, &message);
+        datagram.insert(datagram.end(), packed, packed + len);
+    }
+    auto last = pack_heartbeat(1, 1);
+    datagram.insert(datagram.end(), last.begin(), last.end());
+
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().msgid, MAVLINK_MSG_ID_HEARTBEAT);
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().msgid, MAVLINK_MSG_ID_HEARTBEAT);
+    EXPECT_FALSE(receiver.parse_message());
+
+    const auto stats = receiver.get_stats();
+    EXPECT_EQ(stats.frames_parsed, 5u);
+    EXPECT_EQ(stats.frames_filtered, 3u);
+    EXPECT_EQ(stats.sequence_gaps, 0u);
+}
+
+TEST(MAVLinkReceiver, LongGarbageBetweenMessages)
+{
+    MAVLinkReceiver receiver;
+
+    // Not a start byte anywhere, but close to them.
+    std::vector<char> datagram;
+    for (unsigned i = 0; i < 101; ++i) {
+        datagram.push_back(char(0xFC + (i % 2) * 3));
+    }
+    auto first = pack_heartbeat(1, 1);
+    datagram.insert(datagram.end(), first.begin(), first.end());
+    datagram.insert(datagram.end(), 13, 'x');
+    auto corrupted = pack_heartbeat(2, 2);
+    corrupted[corrupted.size() - 2] ^= 0x55;
+    datagram.insert(datagram.end(), corrupted.begin(), corrupted.end());
+    auto second = pack_heartbeat(3, 3);
+    datagram.insert(datagram.end(), second.begin(), second.end());
+
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 1);
+    ASSERT_TRUE(receiver.parse_message());
+    EXPECT_EQ(receiver.get_last_message().sysid, 3);
+    EXPECT_FALSE(receiver.parse_message());
+
+    EXPECT_EQ(receiver.get_stats().crc_errors, 1u);
+    EXPECT_EQ(receiver.get_stats().frames_parsed, 2u);
+}
+
+TEST(MAVLinkReceiver, ManyReceiversSplitMessages)
+{
+    // More than there are MAVLink channels, each keeps its own parse state.
+    constexpr unsigned num_receivers = 3 * MAVLINK_COMM_NUM_BUFFERS;
+    std::vector<std::unique_ptr<MAVLinkReceiver>> receivers;
+    std::vector<std::vector<char>> packed;
+    for (unsigned i = 0; i < num_receivers; ++i) {
+        receivers.emplace_back(new MAVLinkReceiver());
+        packed.push_back(pack_heartbeat(uint8_t(i + 1), uint8_t(i)));
+    }
+
+    // Half of each first, so all of them are in the middle of a message.
+    for (unsigned i = 0; i < num_receivers; ++i) {
+        receivers[i]->set_new_datagram(packed[i].data(), unsigned(packed[i].size()) / 2);
+        EXPECT_FALSE(receivers[i]->parse_message());
+    }
+
+    for (unsigned i = 0; i < num_receivers; ++i) {
+        const unsigned first_len = unsigned(packed[i].size()) / 2;
+        receivers[i]->set_new_datagram(packed[i].data() + first_len,
+                                       unsigned(packed[i].size()) - first_len);
+        ASSERT_TRUE(receivers[i]->parse_message());
+        EXPECT_EQ(receivers[i]->get_last_message().sysid, i + 1);
+    }
+}
+
+TEST(MAVLinkReceiver, SharedCountersOnSeveralThreads)
+{
+    MAVLinkReceiver::Counters counters;
+    constexpr unsigned num_threads = 4;
+    constexpr unsigned num_datagrams = 10000;
+
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < num_threads; ++i) {
+        threads.push_back(std::thread([&counters, i]() {
+            MAVLinkReceiver receiver(counters, true);
+            for (unsigned j = 0; j < num_datagrams; ++j) {
+                auto datagram = pack_heartbeat(uint8_t(i + 1), 0);
+                receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+                while (receiver.parse_message()) {}
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(counters.get().frames_parsed, num_threads * num_datagrams);
+}
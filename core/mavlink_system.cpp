@@ -1,11 +1,21 @@
 #include "system.h"
 #include "global_include.h"
 #include "dronecore_impl.h"
+#include "geo.h"
 #include "mavlink_include.h"
 #include "mavlink_system.h"
 #include "plugin_impl_base.h"
+#include "thread_setup.h"
+#include "trace.h"
 #include <functional>
 #include <algorithm>
+#include <utility>
+#include <cstdlib>
+#include <cmath>
+#include <typeinfo>
+#ifdef __GNUG__
+#include <cxxabi.h>
+#endif
 #include "px4_custom_mode.h"
 
 // Set to 1 to log incoming/outgoing mavlink messages.
@@ -15,47 +25,61 @@ namespace dronecore {
 
 using namespace std::placeholders; // for `_1`
 
+constexpr double MAVLinkSystem::_AUTOPILOT_VERSION_MAX_TIMEOUT_S;
+constexpr double MAVLinkSystem::_TIMESYNC_FIRST_INTERVAL_S;
+constexpr double MAVLinkSystem::_TIMESYNC_INTERVAL_S;
+constexpr unsigned MAVLinkSystem::_TERRAIN_REQUEST_GRID_BITS;
+constexpr double MAVLinkSystem::MSG_RATE_STOP;
+
+namespace {
+
+// Of the message being handled on this thread, so it doesn't need to be
+// passed through every handler.
+thread_local dl_time_t handled_receive_time {};
+
+} // namespace
+
 MAVLinkSystem::MAVLinkSystem(DroneCoreImpl &parent,
                              uint8_t system_id, uint8_t comp_id) :
     _system_id(system_id),
     _parent(parent),
-    _params(*this),
     _commands(*this),
+    _time(parent.get_replay_clock()),
     _timeout_handler(_time),
     _call_every_handler(_time)
 {
-    _system_thread = new std::thread(system_thread, this);
-
-    register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
-        std::bind(&MAVLinkSystem::process_heartbeat, this, _1), this);
+    register_message_handler<mavlink_heartbeat_t>(this, &MAVLinkSystem::process_heartbeat);
 
     // We're registering for Autopilot version because it is a good time do so,
     // regardless whether we deal with Autopilot.
-    register_mavlink_message_handler(
-        MAVLINK_MSG_ID_AUTOPILOT_VERSION,
-        std::bind(&MAVLinkSystem::process_autopilot_version, this, _1), this);
+    register_message_handler<mavlink_autopilot_version_t>(
+        this, &MAVLinkSystem::process_autopilot_version);
 
     register_mavlink_message_handler(
         MAVLINK_MSG_ID_STATUSTEXT,
         std::bind(&MAVLinkSystem::process_statustext, this, _1), this);
 
+    register_message_handler<mavlink_timesync_t>(this, &MAVLinkSystem::process_timesync);
+
+    register_message_handler<mavlink_terrain_request_t>(
+        this, &MAVLinkSystem::process_terrain_request);
+
     add_new_component(comp_id);
+
+    _parent.get_system_scheduler().add(this, std::bind(&MAVLinkSystem::do_work, this));
 }
 
 MAVLinkSystem::~MAVLinkSystem()
 {
-    _should_exit = true;
+    _parent.get_system_scheduler().remove(this);
+    // The executor is shared, none of our callbacks may run after this.
+    _parent.get_callback_executor().cancel(this);
     unregister_all_mavlink_message_handlers(this);
 
     unregister_timeout_handler(_autopilot_version_timed_out_cookie);
-    unregister_timeout_handler(_heartbeat_timeout_cookie);
 
-    if (_system_thread != nullptr) {
-        _system_thread->join();
-        delete _system_thread;
-        _system_thread = nullptr;
-    }
+    delete _ftp.load();
+    delete _params.load();
 }
 
 bool MAVLinkSystem::is_connected() const
@@ -69,25 +93,43 @@ void MAVLinkSystem::register_mavlink_message_handler(uint16_t msg_id,
 {
     std::lock_guard<std::mutex> lock(_mavlink_handler_table_mutex);
 
-    MAVLinkHandlerTableEntry entry = {msg_id, callback, cookie};
-    _mavlink_handler_table.push_back(entry);
+    auto new_table = std::make_shared<handler_table_t>(*std::atomic_load(&_mavlink_handler_table));
+
+    MAVLinkHandlerTableEntry entry = {callback, cookie, {}};
+    (*new_table)[msg_id].handlers.push_back(entry);
+
+    std::atomic_store(&_mavlink_handler_table,
+                      std::shared_ptr<const handler_table_t>(new_table));
 }
 
 void MAVLinkSystem::unregister_all_mavlink_message_handlers(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_mavlink_handler_table_mutex);
 
-    for (auto it = _mavlink_handler_table.begin();
-         it != _mavlink_handler_table.end();
-         /* no ++it */) {
+    auto new_table = std::make_shared<handler_table_t>(*std::atomic_load(&_mavlink_handler_table));
+
+    for (auto it = new_table->begin(); it != new_table->end(); /* no ++it */) {
+
+        auto &handlers = it->second.handlers;
+        handlers.erase(std::remove_if(handlers.begin(), handlers.end(),
+        [cookie](const MAVLinkHandlerTableEntry & entry) {
+            return entry.cookie == cookie;
+        }), handlers.end());
 
-        if (it->cookie == cookie) {
-            it = _mavlink_handler_table.erase(it);
+        auto &typed = it->second.typed;
+        if (typed) {
+            typed = typed->without(cookie);
+        }
+
+        if (handlers.empty() && !typed) {
+            it = new_table->erase(it);
         } else {
             ++it;
         }
     }
-    _mavlink_handler_table.clear();
+
+    std::atomic_store(&_mavlink_handler_table,
+                      std::shared_ptr<const handler_table_t>(new_table));
 }
 
 void MAVLinkSystem::register_timeout_handler(std::function<void()> callback,
@@ -95,6 +137,8 @@ void MAVLinkSystem::register_timeout_handler(std::function<void()> callback,
                                              void **cookie)
 {
     _timeout_handler.add(callback, duration_s, cookie);
+    // The new timeout might be earlier than what the system thread waits for.
+    wake_system_thread();
 }
 
 void MAVLinkSystem::refresh_timeout_handler(const void *cookie)
@@ -108,44 +152,80 @@ void MAVLinkSystem::unregister_timeout_handler(const void *cookie)
 }
 
 void MAVLinkSystem::process_mavlink_message(const mavlink_message_t &message)
+{
+    process_mavlink_message(message, _time.steady_time());
+}
+
+void MAVLinkSystem::process_mavlink_message(const mavlink_message_t &message,
+                                            const dl_time_t &receive_time)
 {
     if (_communication_locked) {
         return;
     }
+    DRONECORE_TRACE_SCOPE("dispatch");
 
-    _mavlink_handler_table_mutex.lock();
+    _receive_stats.add(message, receive_time);
+    // Any message shows that the link is alive, checked in do_work().
+    _last_received_time.store(receive_time.time_since_epoch().count(), std::memory_order_relaxed);
+
+    // Restored after, a handler could pass on messages to another system.
+    const dl_time_t outer_receive_time = handled_receive_time;
+    handled_receive_time = receive_time;
+
+    // The snapshot stays valid even if a callback (un)registers handlers.
+    auto table = std::atomic_load(&_mavlink_handler_table);
+    HandlerProfiler &profiler = _parent.get_handler_profiler();
 
 #if MESSAGE_DEBUGGING==1
     bool forwarded = false;
 #endif
-    for (auto it = _mavlink_handler_table.begin(); it != _mavlink_handler_table.end(); ++it) {
-        if (it->msg_id == message.msgid) {
+    auto it = table->find(message.msgid);
+    if (it != table->end()) {
+        for (const auto &entry : it->second.handlers) {
+#if MESSAGE_DEBUGGING==1
+            LogDebug() << "Forwarding msg " << int(message.msgid) << " to " << size_t(entry.cookie);
+            forwarded = true;
+#endif
+            profiler.run(entry.slot, {this, entry.cookie, message.msgid}, [&entry, &message]() {
+                entry.callback(message);
+            });
+        }
+        if (it->second.typed) {
 #if MESSAGE_DEBUGGING==1
-            LogDebug() << "Forwarding msg " << int(message.msgid) << " to " << size_t(it->cookie);
+            LogDebug() << "Forwarding msg " << int(message.msgid) << " to typed handlers";
             forwarded = true;
 #endif
-            _mavlink_handler_table_mutex.unlock();
-            it->callback(message);
-            _mavlink_handler_table_mutex.lock();
+            it->second.typed->dispatch(message, profiler, this);
         }
     }
-    _mavlink_handler_table_mutex.unlock();
 
 #if MESSAGE_DEBUGGING==1
     if (!forwarded) {
         LogDebug() << "Ignoring msg " << int(message.msgid);
     }
 #endif
+
+    handled_receive_time = outer_receive_time;
+}
+
+dl_time_t MAVLinkSystem::get_receive_time()
+{
+    if (handled_receive_time == dl_time_t()) {
+        return _time.steady_time();
+    }
+    return handled_receive_time;
 }
 
 void MAVLinkSystem::add_call_every(std::function<void()> callback, float interval_s, void **cookie)
 {
     _call_every_handler.add(callback, interval_s, cookie);
+    wake_system_thread();
 }
 
 void MAVLinkSystem::change_call_every(float interval_s, const void *cookie)
 {
     _call_every_handler.change(interval_s, cookie);
+    wake_system_thread();
 }
 
 void MAVLinkSystem::reset_call_every(const void *cookie)
@@ -158,11 +238,9 @@ void MAVLinkSystem::remove_call_every(const void *cookie)
     _call_every_handler.remove(cookie);
 }
 
-void MAVLinkSystem::process_heartbeat(const mavlink_message_t &message)
+void MAVLinkSystem::process_heartbeat(const mavlink_message_t &message,
+                                      const mavlink_heartbeat_t &heartbeat)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
-
     if (message.compid == MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
         _armed = ((heartbeat.base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false);
         _hitl_enabled = ((heartbeat.base_mode & MAV_MODE_FLAG_HIL_ENABLED) ? true : false);
@@ -173,6 +251,15 @@ void MAVLinkSystem::process_heartbeat(const mavlink_message_t &message)
     /* If the component is an autopilot and
      * we don't know its UUID, then try to find out. */
     if (is_autopilot(message.compid) && !have_uuid()) {
+        // A vehicle seen before is discovered right away, the UUID is confirmed
+        // once AUTOPILOT_VERSION arrives.
+        uint64_t cached_uuid;
+        if (_parent.get_cached_uuid(message.sysid, cached_uuid)) {
+            _uuid = cached_uuid;
+            _uuid_from_cache = true;
+            _uuid_initialized = true;
+            _parent.update_system_directory();
+        }
         request_autopilot_version();
 
     } else if (!is_autopilot(message.compid)
@@ -181,46 +268,61 @@ void MAVLinkSystem::process_heartbeat(const mavlink_message_t &message)
         // non-autopilot system! Lets not delay for filling UUID anymore.
         _uuid = message.sysid;
         _uuid_initialized = true;
+        _parent.update_system_directory();
     }
 
     set_connected();
 }
 
-void MAVLinkSystem::process_autopilot_version(const mavlink_message_t &message)
+void MAVLinkSystem::process_autopilot_version(const mavlink_message_t &message,
+                                              const mavlink_autopilot_version_t &autopilot_version)
 {
     // Ignore if they don't come from the autopilot component
     if (message.compid != MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
         return;
     }
 
-    mavlink_autopilot_version_t autopilot_version;
-    mavlink_msg_autopilot_version_decode(&message, &autopilot_version);
+    {
+        std::lock_guard<std::mutex> lock(_autopilot_version_mutex);
+        // Only if not retransmitted, otherwise it's unclear which request this answers.
+        if (_autopilot_version_pending && _uuid_retries == 1) {
+            _rtt_estimator.add_sample(_time.elapsed_since_s(_autopilot_version_requested_time));
+        }
+        _autopilot_version_received = true;
+        _autopilot_version_pending = false;
+        unregister_timeout_handler(_autopilot_version_timed_out_cookie);
+        _autopilot_version_timed_out_cookie = nullptr;
+    }
 
     _supports_mission_int =
         ((autopilot_version.capabilities & MAV_PROTOCOL_CAPABILITY_MISSION_INT) ? true : false);
 
-    if (_uuid == 0 && autopilot_version.uid != 0) {
+    // Without a valid UUID, the mavlink system ID is the best we have.
+    const uint64_t uuid = (autopilot_version.uid != 0) ? autopilot_version.uid : _system_id;
+    const uint64_t previous_uuid = _uuid;
 
-        // This is the best case. The system has a UUID and we were able to get it.
-        _uuid = autopilot_version.uid;
+    if (_uuid == 0) {
+        _uuid = uuid;
 
-    } else if (_uuid == 0 && autopilot_version.uid == 0) {
+    } else if (_uuid != uuid && _uuid_from_cache) {
+        // Another vehicle with the same system ID than last time, so the
+        // discovered one is gone and this one is new.
+        LogWarn() << "System " << int(_system_id) << " is not " << _uuid << " anymore";
+        set_disconnected();
+        _uuid = uuid;
 
-        // This is not ideal because the system has no valid UUID.
-        // In this case we use the mavlink system ID as the UUID.
-        _uuid = _system_id;
-
-    } else if (_uuid != autopilot_version.uid) {
+    } else if (_uuid != uuid) {
         // TODO: this is bad, we should raise a flag to invalidate system.
         LogErr() << "Error: UUID changed";
     }
-
+    _uuid_from_cache = false;
+    _parent.cache_uuid(_system_id, _uuid);
 
     _uuid_initialized = true;
+    if (_uuid != previous_uuid) {
+        _parent.update_system_directory();
+    }
     set_connected();
-
-    _autopilot_version_pending = false;
-    unregister_timeout_handler(_autopilot_version_timed_out_cookie);
 }
 
 void MAVLinkSystem::process_statustext(const mavlink_message_t &message)
@@ -267,36 +369,167 @@ void MAVLinkSystem::process_statustext(const mavlink_message_t &message)
     LogDebug() << debug_str << ": " << text_with_null;
 }
 
-void MAVLinkSystem::heartbeats_timed_out()
+void MAVLinkSystem::process_terrain_request(const mavlink_terrain_request_t &terrain_request)
+{
+    auto terrain = _parent.get_terrain();
+    if (!terrain || terrain_request.grid_spacing == 0) {
+        return;
+    }
+
+    // The grid starts at the south-west corner of the request. Each bit of the
+    // mask is a block of 4 x 4 points, 8 blocks to the east in every row of
+    // blocks going north.
+    const FlatProjection projection(terrain_request.lat * 1e-7, terrain_request.lon * 1e-7);
+    const double spacing_m = double(terrain_request.grid_spacing);
+
+    for (unsigned grid_bit = 0; grid_bit < _TERRAIN_REQUEST_GRID_BITS; ++grid_bit) {
+        if ((terrain_request.mask & (uint64_t(1) << grid_bit)) == 0) {
+            continue;
+        }
+
+        double latitudes_deg[16];
+        double longitudes_deg[16];
+        for (unsigned i = 0; i < 16; ++i) {
+            const double north_m = double((grid_bit / 8) * 4 + i / 4) * spacing_m;
+            const double east_m = double((grid_bit % 8) * 4 + i % 4) * spacing_m;
+            projection.to_global(north_m, east_m, latitudes_deg[i], longitudes_deg[i]);
+        }
+
+        float elevations_m[16];
+        if (!terrain->get_elevations(latitudes_deg, longitudes_deg, 16, elevations_m)) {
+            continue;
+        }
+
+        mavlink_terrain_data_t terrain_data {};
+        terrain_data.lat = terrain_request.lat;
+        terrain_data.lon = terrain_request.lon;
+        terrain_data.grid_spacing = terrain_request.grid_spacing;
+        terrain_data.gridbit = uint8_t(grid_bit);
+        for (unsigned i = 0; i < 16; ++i) {
+            terrain_data.data[i] = int16_t(std::lround(elevations_m[i]));
+        }
+
+        mavlink_message_t message;
+        mavlink_msg_terrain_data_encode(GCSClient::system_id, GCSClient::component_id,
+                                        &message, &terrain_data);
+        send_message(message);
+    }
+}
+
+void MAVLinkSystem::process_timesync(const mavlink_timesync_t &timesync)
 {
-    LogInfo() << "heartbeats timed out";
+    if (timesync.tc1 == 0) {
+        // A request of the system, answered so it can synchronize to us as well.
+        mavlink_message_t message;
+        mavlink_msg_timesync_pack(GCSClient::system_id,
+                                  GCSClient::component_id,
+                                  &message,
+                                  steady_time_ns(),
+                                  timesync.ts1);
+        send_message(message);
+        return;
+    }
+
+    // The answer to one of our requests carries our send time in ts1. When it
+    // was handled would add our own delays to the round trip.
+    const int64_t received_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                    get_receive_time().time_since_epoch()).count();
+    _timesync.add_sample(timesync.ts1, timesync.tc1, received_ns);
+}
+
+void MAVLinkSystem::send_timesync_request()
+{
+    mavlink_message_t message;
+    mavlink_msg_timesync_pack(GCSClient::system_id,
+                              GCSClient::component_id,
+                              &message,
+                              0,
+                              steady_time_ns());
+    send_message(message);
+}
+
+int64_t MAVLinkSystem::steady_time_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               _time.steady_time().time_since_epoch()).count();
+}
+
+void MAVLinkSystem::link_timed_out()
+{
+    LogInfo() << "Nothing received from system " << int(_system_id) << ", timed out";
     set_disconnected();
 }
 
-void MAVLinkSystem::system_thread(MAVLinkSystem *self)
+void MAVLinkSystem::wake_system_thread()
+{
+    _parent.get_system_scheduler().wake(this);
+}
+
+double MAVLinkSystem::do_work()
 {
-    dl_time_t last_time {};
+    const double timesync_interval_s =
+        _timesync.is_synchronized() ? _TIMESYNC_INTERVAL_S : _TIMESYNC_FIRST_INTERVAL_S;
+    if (_connected && _time.elapsed_since_s(_last_timesync_time) >= timesync_interval_s) {
+        send_timesync_request();
+        _last_timesync_time = _time.steady_time();
+    }
+
+    _call_every_handler.run_once();
+    _timeout_handler.run_once();
+    MAVLinkParameters *params = _params.load(std::memory_order_acquire);
+    if (params != nullptr) {
+        params->do_work();
+    }
+    _commands.do_work();
 
-    while (!self->_should_exit) {
+    // Until the next timer is due, unless new work arrives before.
+    double wait_s = _MAX_WORK_INTERVAL_S;
 
-        if (self->_time.elapsed_since_s(last_time) >= MAVLinkSystem::_HEARTBEAT_SEND_INTERVAL_S) {
-            send_heartbeat(*self);
-            last_time = self->_time.steady_time();
+    if (_connected) {
+        wait_s = std::min(wait_s, timesync_interval_s -
+                          _time.elapsed_since_s(_last_timesync_time));
+
+        const double timeout_s = _parent.get_link_timeout_s();
+        const double silent_s = _time.elapsed_since_s(
+            dl_time_t(dl_time_t::duration(_last_received_time.load(std::memory_order_relaxed))));
+        if (silent_s >= timeout_s) {
+            link_timed_out();
+        } else {
+            // Right when it would time out, not a loop iteration later.
+            wait_s = std::min(wait_s, timeout_s - silent_s);
         }
+    }
+    wait_s = _timeout_handler.time_until_next_s(wait_s);
+    wait_s = _call_every_handler.time_until_next_s(wait_s);
+    return wait_s;
+}
 
-        self->_call_every_handler.run_once();
-        self->_timeout_handler.run_once();
-        self->_params.do_work();
-        self->_commands.do_work();
+MAVLinkParameters &MAVLinkSystem::params()
+{
+    MAVLinkParameters *params = _params.load(std::memory_order_acquire);
+    if (params == nullptr) {
+        std::lock_guard<std::mutex> lock(_lazy_mutex);
+        params = _params.load(std::memory_order_relaxed);
+        if (params == nullptr) {
+            params = new MAVLinkParameters(*this);
+            _params.store(params, std::memory_order_release);
+        }
+    }
+    return *params;
+}
 
-        if (self->_connected) {
-            // Work fairly fast if we're connected.
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        } else {
-            // Be less aggressive when unconnected.
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+MAVLinkFTP &MAVLinkSystem::get_ftp()
+{
+    MAVLinkFTP *ftp = _ftp.load(std::memory_order_acquire);
+    if (ftp == nullptr) {
+        std::lock_guard<std::mutex> lock(_lazy_mutex);
+        ftp = _ftp.load(std::memory_order_relaxed);
+        if (ftp == nullptr) {
+            ftp = new MAVLinkFTP(*this);
+            _ftp.store(ftp, std::memory_order_release);
         }
     }
+    return *ftp;
 }
 
 std::string MAVLinkSystem::component_name(uint8_t component_id)
@@ -325,15 +558,32 @@ std::string MAVLinkSystem::component_name(uint8_t component_id)
 
 void MAVLinkSystem::add_new_component(uint8_t component_id)
 {
-    auto res_pair = _components.insert(component_id);
-    if (res_pair.second) {
-        LogDebug() << "Component " << component_name(component_id) << " added.";
+    // Called for every message, usually the component is known already.
+    std::atomic<uint64_t> &word = _components[component_id / 64];
+    const uint64_t bit = uint64_t(1) << (component_id % 64);
+    if ((word.load(std::memory_order_relaxed) & bit) != 0) {
+        return;
+    }
+    if ((word.fetch_or(bit, std::memory_order_relaxed) & bit) != 0) {
+        // Someone else was faster.
+        return;
     }
+
+    if (component_id == MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
+        _autopilot_id = component_id;
+    } else if (component_id == MAV_COMP_ID_GIMBAL) {
+        _gimbal_id = component_id;
+    } else if (is_camera(component_id)) {
+        _camera_mask.fetch_or(uint8_t(1u << (component_id - MAV_COMP_ID_CAMERA)));
+    }
+    ++_num_components;
+
+    LogDebug() << "Component " << component_name(component_id) << " added.";
 }
 
 size_t MAVLinkSystem::total_components() const
 {
-    return _components.size();
+    return _num_components;
 }
 
 bool MAVLinkSystem::is_standalone() const
@@ -359,23 +609,14 @@ bool MAVLinkSystem::is_camera(uint8_t comp_id)
 
 bool MAVLinkSystem::has_camera(int camera_id) const
 {
-    int camera_comp_id = (camera_id == -1) ?
-                         camera_id : (MAV_COMP_ID_CAMERA + camera_id);
+    const uint8_t camera_mask = _camera_mask;
 
-    if (camera_comp_id == -1) { // Check whether the system has any camera.
-        for (auto compid : _components) {
-            if (is_camera(compid)) {
-                return true;
-            }
-        }
-    } else { // Look for the camera whose id is `camera_id`.
-        for (auto compid : _components) {
-            if (compid == camera_comp_id) {
-                return true;
-            }
-        }
+    if (camera_id == -1) { // Check whether the system has any camera.
+        return camera_mask != 0;
     }
-    return false;
+    // Look for the camera whose id is `camera_id`.
+    return camera_id >= 0 && camera_id <= (MAV_COMP_ID_CAMERA6 - MAV_COMP_ID_CAMERA) &&
+           (camera_mask & (1u << camera_id)) != 0;
 }
 
 bool MAVLinkSystem::has_gimbal() const
@@ -383,19 +624,6 @@ bool MAVLinkSystem::has_gimbal() const
     return get_gimbal_id() == MAV_COMP_ID_GIMBAL;
 }
 
-void MAVLinkSystem::send_heartbeat(MAVLinkSystem &self)
-{
-    mavlink_message_t message;
-    // GCSClient is not autopilot!; hence MAV_AUTOPILOT_INVALID.
-    mavlink_msg_heartbeat_pack(GCSClient::system_id,
-                               GCSClient::component_id,
-                               &message,
-                               MAV_TYPE_GCS,
-                               MAV_AUTOPILOT_INVALID,
-                               0, 0, 0);
-    self.send_message(message);
-}
-
 bool MAVLinkSystem::send_message(const mavlink_message_t &message)
 {
     if (_communication_locked) {
@@ -408,78 +636,123 @@ bool MAVLinkSystem::send_message(const mavlink_message_t &message)
     return _parent.send_message(message);
 }
 
-void MAVLinkSystem::request_autopilot_version()
+bool MAVLinkSystem::send_messages(const std::vector<mavlink_message_t> &messages)
 {
-    if (_uuid_initialized) {
-        // Already initialized, we can exit.
-        return;
+    if (_communication_locked) {
+        return false;
     }
 
-    if (!_autopilot_version_pending && _uuid_retries >= 3) {
-        // We give up getting a UUID and use the system ID.
+    return _parent.send_messages(messages);
+}
 
-        LogWarn() << "No UUID received, using system ID instead.";
-        _uuid = _system_id;
-        _uuid_initialized = true;
-        set_connected();
+void MAVLinkSystem::request_autopilot_version()
+{
+    std::lock_guard<std::mutex> lock(_autopilot_version_mutex);
+
+    if (_autopilot_version_received || _autopilot_version_pending) {
         return;
     }
 
     _autopilot_version_pending = true;
+    _uuid_retries = 0;
+    send_autopilot_version_request();
+}
 
-    // We don't care about an answer, we mostly care about receiving AUTOPILOT_VERSION.
-    MAVLinkCommands::CommandLong command {};
-
-    command.command = MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES;
-    command.params.param1 = 1.0f;
-    command.target_component_id = get_autopilot_id();
+// Needs to be called with _autopilot_version_mutex locked.
+void MAVLinkSystem::send_autopilot_version_request()
+{
+    // Sent directly rather than queued as command, so it doesn't wait behind others
+    // and we can retry quickly. We don't care about the ack, only about AUTOPILOT_VERSION.
+    mavlink_message_t message;
+    mavlink_msg_command_long_pack(GCSClient::system_id,
+                                  GCSClient::component_id,
+                                  &message,
+                                  get_system_id(),
+                                  get_autopilot_id(),
+                                  MAV_CMD_REQUEST_AUTOPILOT_CAPABILITIES,
+                                  0,
+                                  1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    send_message(message);
+
+    if (_uuid_retries == 0) {
+        _autopilot_version_requested_time = _time.steady_time();
+    }
 
-    send_command_async(command, nullptr);
+    // Short on a link we know nothing about yet, backing off in case it is slow.
+    double timeout_s = (_rtt_estimator.get_num_samples() > 0) ?
+                       _rtt_estimator.get_timeout_s() : _AUTOPILOT_VERSION_FIRST_TIMEOUT_S;
+    for (int i = 0; i < _uuid_retries; ++i) {
+        timeout_s *= 2.0;
+    }
+    timeout_s = std::min(timeout_s, _AUTOPILOT_VERSION_MAX_TIMEOUT_S);
     ++_uuid_retries;
 
-    // We set a timeout to stay "pending" for half a second. This way, we don't give up too
-    // early e.g. because multiple components send heartbeats and we receive them all at once
-    // and run out of retries.
+    register_timeout_handler(std::bind(&MAVLinkSystem::autopilot_version_timed_out, this),
+                             timeout_s,
+                             &_autopilot_version_timed_out_cookie);
+}
+
+void MAVLinkSystem::autopilot_version_timed_out()
+{
+    {
+        std::lock_guard<std::mutex> lock(_autopilot_version_mutex);
+        _autopilot_version_timed_out_cookie = nullptr;
+
+        if (!_autopilot_version_pending) {
+            return;
+        }
+        if (_uuid_retries < _AUTOPILOT_VERSION_MAX_REQUESTS) {
+            send_autopilot_version_request();
+            return;
+        }
+        _autopilot_version_pending = false;
+    }
+
+    if (_uuid_initialized) {
+        // Discovered with the cached UUID, that will have to do.
+        return;
+    }
 
-    // We create a temp reference, so we don't need to capture `this`.
-    auto &pending_tmp = _autopilot_version_pending;
-    register_timeout_handler(
-    [&pending_tmp]() {
-        pending_tmp = false;
-    },
-    0.5,
-    &_autopilot_version_timed_out_cookie);
+    // We give up getting a UUID and use the system ID.
+    LogWarn() << "No UUID received, using system ID instead.";
+    _uuid = _system_id;
+    _uuid_initialized = true;
+    set_connected();
 }
 
 void MAVLinkSystem::set_connected()
 {
-    bool enable_needed = false;
+    // Staying connected needs no bookkeeping here, do_work() looks at the time
+    // of the last received message.
+    if (_connected) {
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(_connection_mutex);
 
-        if (!_connected && _uuid_initialized) {
-
-            LogDebug() << "Found " << _components.size() << " component(s).";
+        if (_connected || !_uuid_initialized) {
+            return;
+        }
 
-            LogDebug() << "Discovered " << _uuid;
-            _parent.notify_on_discover(_uuid);
-            _connected = true;
+        LogDebug() << "Found " << _num_components << " component(s).";
 
-            register_timeout_handler(std::bind(&MAVLinkSystem::heartbeats_timed_out, this),
-                                     _HEARTBEAT_TIMEOUT_S,
-                                     &_heartbeat_timeout_cookie);
-            enable_needed = true;
+        LogDebug() << "Discovered " << _uuid;
+        _parent.notify_on_discover(_uuid);
+        _connected = true;
+    }
+    // So the link timeout is checked from now on.
+    wake_system_thread();
 
-        } else if (_connected) {
-            refresh_timeout_handler(_heartbeat_timeout_cookie);
-        }
-        // If not yet connected there is nothing to do/
+    // Plugins read params on enable, so get the cache going first.
+    const std::string param_cache_dir = _parent.get_param_cache_dir();
+    if (!param_cache_dir.empty()) {
+        params().use_snapshot(param_cache_dir + "/params_" + std::to_string(_uuid) + ".txt");
     }
-    if (enable_needed) {
-        std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
-        for (auto plugin_impl : _plugin_impls) {
-            plugin_impl->enable();
-        }
+
+    std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
+    for (auto plugin_impl : _plugin_impls) {
+        plugin_impl->enable();
     }
 }
 
@@ -488,15 +761,13 @@ void MAVLinkSystem::set_disconnected()
     {
         std::lock_guard<std::mutex> lock(_connection_mutex);
 
-        // This might not be needed because this is probably called from the triggered
-        // timeout anyway but it should also do no harm.
-        //unregister_timeout_handler(_heartbeat_timeout_cookie);
-        //_heartbeat_timeout_cookie = nullptr;
-
         _connected = false;
         _parent.notify_on_timeout(_uuid);
     }
 
+    // It might come back after a reboot, with a new clock.
+    _timesync.reset();
+
     {
         std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
         for (auto plugin_impl : _plugin_impls) {
@@ -511,6 +782,12 @@ uint64_t MAVLinkSystem::get_uuid() const
     return _uuid;
 }
 
+std::shared_ptr<MemoryAccount> MAVLinkSystem::get_memory_account(const std::string &name)
+{
+    return _parent.get_memory_budget().get_account(
+               "system " + std::to_string(unsigned(get_system_id())) + "/" + name);
+}
+
 uint8_t MAVLinkSystem::get_system_id() const
 {
     return _system_id;
@@ -525,14 +802,14 @@ void MAVLinkSystem::set_param_float_async(const std::string &name, float value,
 {
     MAVLinkParameters::ParamValue param_value;
     param_value.set_float(value);
-    _params.set_param_async(name, param_value, callback);
+    params().set_param_async(name, param_value, callback);
 }
 
 void MAVLinkSystem::set_param_int_async(const std::string &name, int32_t value, success_t callback)
 {
     MAVLinkParameters::ParamValue param_value;
     param_value.set_int32(value);
-    _params.set_param_async(name, param_value, callback);
+    params().set_param_async(name, param_value, callback);
 }
 
 void MAVLinkSystem::set_param_ext_float_async(const std::string &name, float value,
@@ -540,7 +817,7 @@ void MAVLinkSystem::set_param_ext_float_async(const std::string &name, float val
 {
     MAVLinkParameters::ParamValue param_value;
     param_value.set_float(value);
-    _params.set_param_async(name, param_value, callback, true);
+    params().set_param_async(name, param_value, callback, true);
 }
 
 void MAVLinkSystem::set_param_ext_int_async(const std::string &name, int32_t value,
@@ -548,28 +825,72 @@ void MAVLinkSystem::set_param_ext_int_async(const std::string &name, int32_t val
 {
     MAVLinkParameters::ParamValue param_value;
     param_value.set_int32(value);
-    _params.set_param_async(name, param_value, callback, true);
+    params().set_param_async(name, param_value, callback, true);
 }
 
 void MAVLinkSystem::get_param_float_async(const std::string &name,
                                           get_param_float_callback_t callback)
 {
-    _params.get_param_async(name, std::bind(&MAVLinkSystem::receive_float_param, _1, _2,
+    params().get_param_async(name, std::bind(&MAVLinkSystem::receive_float_param, _1, _2,
                                             callback));
 }
 
 void MAVLinkSystem::set_param_async(const std::string &name,
                                     MAVLinkParameters::ParamValue value,
                                     success_t callback,
-                                    bool extended)
+                                    bool extended,
+                                    uint8_t component_id)
 {
-    _params.set_param_async(name, value, callback, extended);
+    params().set_param_async(name, value, callback, extended, component_id);
 }
 
 void MAVLinkSystem::get_param_async(const std::string &name, get_param_callback_t callback,
-                                    bool extended)
+                                    bool extended,
+                                    uint8_t component_id)
+{
+    params().get_param_async(name, callback, extended, component_id);
+}
+
+void MAVLinkSystem::get_params_ext_async(const std::vector<std::string> &names,
+                                         MAVLinkParameters::get_params_callback_t callback,
+                                         uint8_t component_id)
+{
+    params().get_params_ext_async(names, callback, component_id);
+}
+
+void MAVLinkSystem::set_params_async(
+    const std::map<std::string, MAVLinkParameters::ParamValue> &params,
+    MAVLinkParameters::set_params_callback_t callback,
+    bool extended,
+    uint8_t component_id)
+{
+    params().set_params_async(params, callback, extended, component_id);
+}
+
+void MAVLinkSystem::request_all_params_async()
+{
+    params().request_all_params_async();
+}
+
+void MAVLinkSystem::apply_param_file_async(const std::string &path,
+                                           MAVLinkParameters::progress_callback_t progress_callback,
+                                           MAVLinkParameters::set_params_callback_t callback)
 {
-    _params.get_param_async(name, callback, extended);
+    params().apply_param_file_async(path, progress_callback, callback);
+}
+
+MAVLinkParameters::param_subscription_handle_t
+MAVLinkSystem::subscribe_param(const std::string &name,
+                               MAVLinkParameters::param_changed_callback_t callback,
+                               bool extended,
+                               uint8_t component_id)
+{
+    return params().subscribe_param(name, callback, extended, component_id);
+}
+
+void MAVLinkSystem::unsubscribe_param(MAVLinkParameters::param_subscription_handle_t handle)
+{
+    params().unsubscribe_param(handle);
 }
 
 MAVLinkCommands::Result
@@ -655,27 +976,27 @@ void MAVLinkSystem::set_flight_mode_async(FlightMode system_mode,
         return;
     }
 
-    send_command_async(command, callback);
+    send_command_async(command, std::move(callback));
 }
 
 void MAVLinkSystem::get_param_int_async(const std::string &name,
                                         get_param_int_callback_t callback)
 {
-    _params.get_param_async(name, std::bind(&MAVLinkSystem::receive_int_param, _1, _2,
+    params().get_param_async(name, std::bind(&MAVLinkSystem::receive_int_param, _1, _2,
                                             callback));
 }
 
 void MAVLinkSystem::get_param_ext_float_async(const std::string &name,
                                               get_param_float_callback_t callback)
 {
-    _params.get_param_async(name, std::bind(&MAVLinkSystem::receive_float_param, _1, _2,
+    params().get_param_async(name, std::bind(&MAVLinkSystem::receive_float_param, _1, _2,
                                             callback), true);
 }
 
 void MAVLinkSystem::get_param_ext_int_async(const std::string &name,
                                             get_param_int_callback_t callback)
 {
-    _params.get_param_async(name, std::bind(&MAVLinkSystem::receive_int_param, _1, _2,
+    params().get_param_async(name, std::bind(&MAVLinkSystem::receive_int_param, _1, _2,
                                             callback), true);
 }
 
@@ -705,38 +1026,32 @@ void MAVLinkSystem::receive_int_param(bool success, MAVLinkParameters::ParamValu
 
 uint8_t MAVLinkSystem::get_autopilot_id() const
 {
-    for (auto compid : _components)
-        if (compid == MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT) {
-            return compid;
-        }
     // FIXME: Not sure what should be returned if autopilot is not found
-    return uint8_t(0);
+    return _autopilot_id;
 }
 
 std::vector<uint8_t> MAVLinkSystem::get_camera_ids() const
 {
     std::vector<uint8_t> camera_ids {};
 
-    for (auto compid : _components)
-        if (compid >= MAV_COMP_ID_CAMERA && compid <= MAV_COMP_ID_CAMERA6) {
-            camera_ids.push_back(compid);
+    const uint8_t camera_mask = _camera_mask;
+    for (int i = 0; i <= MAV_COMP_ID_CAMERA6 - MAV_COMP_ID_CAMERA; ++i) {
+        if ((camera_mask & (1u << i)) != 0) {
+            camera_ids.push_back(uint8_t(MAV_COMP_ID_CAMERA + i));
         }
+    }
     return camera_ids;
 }
 
 uint8_t MAVLinkSystem::get_gimbal_id() const
 {
-    for (auto compid : _components)
-        if (compid == MAV_COMP_ID_GIMBAL) {
-            return compid;
-        }
-    return uint8_t(0);
+    return _gimbal_id;
 }
 
 MAVLinkCommands::Result
 MAVLinkSystem::send_command(MAVLinkCommands::CommandLong &command)
 {
-    if (_system_id == 0 && _components.size() == 0) {
+    if (_system_id == 0 && _num_components == 0) {
         return MAVLinkCommands::Result::NO_SYSTEM;
     }
     command.target_system_id = get_system_id();
@@ -746,7 +1061,7 @@ MAVLinkSystem::send_command(MAVLinkCommands::CommandLong &command)
 MAVLinkCommands::Result
 MAVLinkSystem::send_command(MAVLinkCommands::CommandInt &command)
 {
-    if (_system_id == 0 && _components.size() == 0) {
+    if (_system_id == 0 && _num_components == 0) {
         return MAVLinkCommands::Result::NO_SYSTEM;
     }
     command.target_system_id = get_system_id();
@@ -756,7 +1071,7 @@ MAVLinkSystem::send_command(MAVLinkCommands::CommandInt &command)
 void MAVLinkSystem::send_command_async(MAVLinkCommands::CommandLong &command,
                                        command_result_callback_t callback)
 {
-    if (_system_id == 0 && _components.size() == 0) {
+    if (_system_id == 0 && _num_components == 0) {
         if (callback) {
             callback(MAVLinkCommands::Result::NO_SYSTEM, NAN);
         }
@@ -764,13 +1079,13 @@ void MAVLinkSystem::send_command_async(MAVLinkCommands::CommandLong &command,
     }
     command.target_system_id = get_system_id();
 
-    _commands.queue_command_async(command, callback);
+    _commands.queue_command_async(command, std::move(callback));
 }
 
 void MAVLinkSystem::send_command_async(MAVLinkCommands::CommandInt &command,
                                        command_result_callback_t callback)
 {
-    if (_system_id == 0 && _components.size() == 0) {
+    if (_system_id == 0 && _num_components == 0) {
         if (callback) {
             callback(MAVLinkCommands::Result::NO_SYSTEM, NAN);
         }
@@ -778,7 +1093,7 @@ void MAVLinkSystem::send_command_async(MAVLinkCommands::CommandInt &command,
     }
     command.target_system_id = get_system_id();
 
-    _commands.queue_command_async(command, callback);
+    _commands.queue_command_async(command, std::move(callback));
 }
 
 
@@ -812,21 +1127,56 @@ void MAVLinkSystem::set_msg_rate_async(uint16_t message_id,
                                         component_id,
                                         command_msg_rate);
     if (result == MAVLinkCommands::Result::SUCCESS) {
-        send_command_async(command_msg_rate, callback);
+        send_command_async(command_msg_rate, std::move(callback));
     }
 }
 
+void MAVLinkSystem::set_msg_rates_async(const msg_rates_t &rates_hz,
+                                        command_result_callback_t callback,
+                                        uint8_t component_id)
+{
+    if (_system_id == 0 && _num_components == 0) {
+        if (callback) {
+            callback(MAVLinkCommands::Result::NO_SYSTEM, NAN);
+        }
+        return;
+    }
+
+    std::vector<MAVLinkCommands::CommandLong> commands {};
+    commands.reserve(rates_hz.size());
+    for (const auto &rate_hz : rates_hz) {
+        MAVLinkCommands::CommandLong command_msg_rate {};
+        auto result = make_command_msg_rate(rate_hz.first,
+                                            rate_hz.second,
+                                            component_id,
+                                            command_msg_rate);
+        if (result != MAVLinkCommands::Result::SUCCESS) {
+            if (callback) {
+                callback(result, NAN);
+            }
+            return;
+        }
+        command_msg_rate.target_system_id = get_system_id();
+        commands.push_back(command_msg_rate);
+    }
+
+    _commands.queue_command_batch_async(commands, std::move(callback));
+}
+
 MAVLinkCommands::Result
 MAVLinkSystem::make_command_msg_rate(uint16_t message_id,
                                      double rate_hz,
                                      uint8_t component_id,
                                      MAVLinkCommands::CommandLong &command)
 {
-    // If left at -1 it will stop the message stream.
-    float interval_us = -1.0f;
+    // If left at 0 the autopilot sends the message at its default rate.
+    float interval_us = 0.0f;
     if (rate_hz > 0) {
         interval_us = 1e6f / static_cast<float>(rate_hz);
-    } else {
+    } else if (rate_hz == MSG_RATE_STOP) {
+        // Stops the message stream.
+        interval_us = -1.0f;
+    } else if (rate_hz != 0) {
         LogErr() << "Rate(Hz) is invalid: %f" << rate_hz;
         return  MAVLinkCommands::Result::UNKNOWN_ERROR;
     }
@@ -875,17 +1225,66 @@ void MAVLinkSystem::unregister_plugin(PluginImplBase *plugin_impl)
     }
 }
 
-void MAVLinkSystem::call_user_callback(const std::function<void()> &func)
+void MAVLinkSystem::call_user_callback(const std::function<void()> &func,
+                                       const void *ordering_key,
+                                       CallbackExecutor::Policy policy)
 {
-    // Maybe we should be using a thread pool but for now, let's try
-    // if std::async is good enough and not much overhead.
+    // Only wrapped while profiling, otherwise the executor gets the callback as it is.
+    HandlerProfiler &profiler = _parent.get_handler_profiler();
+    std::function<void()> timed_func;
+    if (profiler.is_enabled()) {
+        timed_func = [this, &profiler, func]() {
+            profiler.run(_user_callback_slot,
+            {this, nullptr, HandlerProfiler::USER_CALLBACKS}, func);
+        };
+    }
+
+    // Unordered callbacks of a system still stay in order like before the executor was
+    // shared, but don't hold up other systems.
+    if (!_parent.get_callback_executor().submit(timed_func ? timed_func : func,
+                                                ordering_key ? ordering_key : this,
+                                                policy, this)) {
+        LogWarn() << "User callback dropped, callbacks are too slow";
+    }
+}
 
-    // std::async returns a future, in order to destruct it we need to do a blocking wait
-    // that we don't want to do here, therefore we stash it away and clean it up later.
-    auto some_future = std::async(std::launch::async | std::launch::deferred, func);
+std::string MAVLinkSystem::get_handler_name(const void *cookie)
+{
+    if (cookie == nullptr) {
+        return "user callbacks";
+    }
+    if (cookie == this) {
+        return "MAVLinkSystem";
+    }
+    if (cookie == &_commands) {
+        return "MAVLinkCommands";
+    }
+    if (cookie == _params.load()) {
+        return "MAVLinkParameters";
+    }
+    if (cookie == _ftp.load()) {
+        return "MAVLinkFTP";
+    }
 
-    // FIXME: we need to clean up this vector every now and then.
-    _pending_futures.push_back(std::move(some_future));
+    std::lock_guard<std::mutex> lock(_plugin_impls_mutex);
+    for (auto plugin_impl : _plugin_impls) {
+        if (plugin_impl != cookie) {
+            continue;
+        }
+        const char *name = typeid(*plugin_impl).name();
+#ifdef __GNUG__
+        int status = -1;
+        char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if (status == 0) {
+            std::string result(demangled);
+            free(demangled);
+            return result;
+        }
+        free(demangled);
+#endif
+        return name;
+    }
+    return "";
 }
 
 void MAVLinkSystem::lock_communication()
@@ -4,17 +4,27 @@
 #include "mavlink_include.h"
 #include "mavlink_parameters.h"
 #include "mavlink_commands.h"
+#include "mavlink_ftp.h"
 #include "timeout_handler.h"
+#include "rtt_estimator.h"
+#include "timesync.h"
+#include "receive_stats.h"
 #include "call_every_handler.h"
+#include "callback_executor.h"
+#include "mavlink_message_traits.h"
+#include "memory_budget.h"
 #include <cstdint>
 #include <functional>
 #include <atomic>
 #include <vector>
-#include <unordered_set>
+#include <utility>
+#include <unordered_map>
+#include <memory>
 #include <map>
 #include <thread>
 #include <mutex>
 #include <future>
+#include <condition_variable>
 
 namespace dronecore {
 
@@ -52,6 +62,11 @@ public:
     ~MAVLinkSystem();
 
     void process_mavlink_message(const mavlink_message_t &message);
+    void process_mavlink_message(const mavlink_message_t &message, const dl_time_t &receive_time);
+
+    // While handling a message when it was received, as close as the link can tell,
+    // otherwise now. Handlers should use this rather than the time they run at.
+    dl_time_t get_receive_time();
 
     typedef std::function<void(const mavlink_message_t &)> mavlink_message_handler_t;
 
@@ -59,6 +74,50 @@ public:
                                           mavlink_message_handler_t callback,
                                           const void *cookie);
 
+    // Typed registration, e.g.
+    //   register_message_handler<mavlink_attitude_t>(this, &TelemetryImpl::process_attitude);
+    // The message is decoded once for all typed handlers of it. The owner is the
+    // cookie to unregister with unregister_all_mavlink_message_handlers().
+    template <typename T, typename Owner>
+    void register_message_handler(Owner *owner, void (Owner::*handler)(const T &))
+    {
+        register_typed_message_handler<T>(
+        [owner, handler](const mavlink_message_t &, const T & decoded) {
+            (owner->*handler)(decoded);
+        }, owner);
+    }
+
+    // For handlers which need the header as well, still decoded only once.
+    template <typename T, typename Owner>
+    void register_message_handler(Owner *owner,
+                                  void (Owner::*handler)(const mavlink_message_t &, const T &))
+    {
+        register_typed_message_handler<T>(
+        [owner, handler](const mavlink_message_t & message, const T & decoded) {
+            (owner->*handler)(message, decoded);
+        }, owner);
+    }
+
+    template <typename T>
+    void register_typed_message_handler(typename TypedDispatcher<T>::handler_t handler,
+                                        const void *cookie)
+    {
+        std::lock_guard<std::mutex> lock(_mavlink_handler_table_mutex);
+
+        auto new_table = std::make_shared<handler_table_t>(*std::atomic_load(&_mavlink_handler_table));
+
+        const uint32_t msg_id = MAVLinkMessageTraits<T>::ID;
+        auto &typed = (*new_table)[msg_id].typed;
+        if (typed) {
+            typed = static_cast<const TypedDispatcher<T> &>(*typed).with(handler, cookie);
+        } else {
+            typed = TypedDispatcher<T>().with(handler, cookie);
+        }
+
+        std::atomic_store(&_mavlink_handler_table,
+                          std::shared_ptr<const handler_table_t>(new_table));
+    }
+
     void unregister_all_mavlink_message_handlers(const void *cookie);
 
     void register_timeout_handler(std::function<void()> callback,
@@ -73,6 +132,8 @@ public:
     void remove_call_every(const void *cookie);
 
     bool send_message(const mavlink_message_t &message);
+    // The messages can also be for other systems, they are routed by their target.
+    bool send_messages(const std::vector<mavlink_message_t> &messages);
 
     typedef std::function<void(MAVLinkCommands::Result, float)> command_result_callback_t;
 
@@ -88,6 +149,9 @@ public:
     void send_command_async(MAVLinkCommands::CommandInt &command,
                             command_result_callback_t callback);
 
+    // A rate of 0 asks for the default rate of the message, MSG_RATE_STOP stops it.
+    static constexpr double MSG_RATE_STOP = -1.0;
+
     MAVLinkCommands::Result
     set_msg_rate(uint16_t message_id, double rate_hz,
                  uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
@@ -96,6 +160,13 @@ public:
                             command_result_callback_t callback,
                             uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
 
+    // Sets the rates of many messages at once rather than one per round trip,
+    // e.g. on connect. The callback is called once all of them are acked.
+    typedef std::vector<std::pair<uint16_t, double>> msg_rates_t;
+    void set_msg_rates_async(const msg_rates_t &rates_hz,
+                             command_result_callback_t callback,
+                             uint8_t component_id = MAV_COMP_ID_AUTOPILOT1);
+
     void request_autopilot_version();
 
     // Adds unique component ids
@@ -144,17 +215,63 @@ public:
     typedef std::function <void(bool success, MAVLinkParameters::ParamValue value)>
     get_param_callback_t;
 
+    // The component ID is only used for extended params.
     void set_param_async(const std::string &name,
                          MAVLinkParameters::ParamValue value,
                          success_t callback,
-                         bool extended = false);
+                         bool extended = false,
+                         uint8_t component_id = MAV_COMP_ID_CAMERA);
     void get_param_async(const std::string &name, get_param_callback_t callback,
-                         bool extended = false);
+                         bool extended = false,
+                         uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    void get_params_ext_async(const std::vector<std::string> &names,
+                              MAVLinkParameters::get_params_callback_t callback,
+                              uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    void set_params_async(const std::map<std::string, MAVLinkParameters::ParamValue> &params,
+                          MAVLinkParameters::set_params_callback_t callback,
+                          bool extended = false,
+                          uint8_t component_id = MAV_COMP_ID_CAMERA);
+
+    // Fetches all params at once so that later gets are answered from a cache.
+    void request_all_params_async();
+
+    // Sets only the params of a QGroundControl params file which differ.
+    void apply_param_file_async(const std::string &path,
+                                MAVLinkParameters::progress_callback_t progress_callback,
+                                MAVLinkParameters::set_params_callback_t callback);
+
+    // Instead of polling a param, see MAVLinkParameters::subscribe_param().
+    MAVLinkParameters::param_subscription_handle_t
+    subscribe_param(const std::string &name,
+                    MAVLinkParameters::param_changed_callback_t callback,
+                    bool extended = false,
+                    uint8_t component_id = MAV_COMP_ID_CAMERA);
+    void unsubscribe_param(MAVLinkParameters::param_subscription_handle_t handle);
 
     bool is_connected() const;
 
     Time &get_time() { return _time; };
 
+    // The account of a part of this system, e.g. "system 1/params" for "params".
+    std::shared_ptr<MemoryAccount> get_memory_account(const std::string &name);
+
+    // Round trip time of commands and params, to derive their timeouts from.
+    RttEstimator &get_rtt_estimator() { return _rtt_estimator; };
+    // See MAVLinkCommands::set_in_progress_timeout_s().
+    void set_command_in_progress_timeout_s(double timeout_s)
+    {
+        _commands.set_in_progress_timeout_s(timeout_s);
+    }
+    // To convert timestamps of the system to our steady clock.
+    Timesync &get_timesync() { return _timesync; };
+
+    ReceiveStats &get_receive_stats() { return _receive_stats; };
+
+    // File transfers with the components, for plugins to fetch files over MAVLink.
+    MAVLinkFTP &get_ftp();
+
     void register_plugin(PluginImplBase *plugin_impl);
     void unregister_plugin(PluginImplBase *plugin_impl);
 
@@ -164,7 +281,20 @@ public:
     void lock_communication();
     void unlock_communication();
 
-    void call_user_callback(const std::function<void()> &func);
+    // User callbacks are run on a small thread pool so they can't block us.
+    // Callbacks with the same ordering key are called in order.
+    void call_user_callback(const std::function<void()> &func,
+                            const void *ordering_key = nullptr,
+                            CallbackExecutor::Policy policy = CallbackExecutor::Policy::QUEUE);
+
+    // Who registered the handlers under the cookie, for the handler timings.
+    // Empty if not known.
+    std::string get_handler_name(const void *cookie);
+
+    // Wakes up the system thread so new work (e.g. a queued command) is
+    // handled right away instead of on the next timer deadline. The thread is
+    // shared by all systems.
+    void wake_system_thread();
 
     // Non-copyable
     MAVLinkSystem(const MAVLinkSystem &) = delete;
@@ -178,17 +308,28 @@ private:
 
     bool have_uuid() const { return _uuid != 0 && _uuid_initialized; }
 
-    void process_heartbeat(const mavlink_message_t &message);
-    void process_autopilot_version(const mavlink_message_t &message);
+    void process_heartbeat(const mavlink_message_t &message,
+                           const mavlink_heartbeat_t &heartbeat);
+    void process_autopilot_version(const mavlink_message_t &message,
+                                   const mavlink_autopilot_version_t &autopilot_version);
     void process_statustext(const mavlink_message_t &message);
-    void heartbeats_timed_out();
+    void process_timesync(const mavlink_timesync_t &timesync);
+    void process_terrain_request(const mavlink_terrain_request_t &terrain_request);
+    void send_timesync_request();
+    int64_t steady_time_ns();
+    void link_timed_out();
+    void send_autopilot_version_request();
+    void autopilot_version_timed_out();
     void set_connected();
     void set_disconnected();
 
     static std::string component_name(uint8_t component_id);
 
-    static void system_thread(MAVLinkSystem *self);
-    static void send_heartbeat(MAVLinkSystem &self);
+    // Run by the system thread, returns the seconds until it is due again.
+    double do_work();
+
+    // Created on first use, most systems of a large fleet never need them.
+    MAVLinkParameters &params();
 
     // Last argument will hold Flight mode command.
     MAVLinkCommands::Result
@@ -209,20 +350,35 @@ private:
                                   get_param_int_callback_t callback);
 
     struct MAVLinkHandlerTableEntry {
-        uint16_t msg_id;
         mavlink_message_handler_t callback;
         const void *cookie; // This is the identification to unregister.
+        HandlerProfiler::Slot slot;
+    };
+
+    // Handlers are looked up by msg id. The whole table is an immutable snapshot
+    // which is replaced atomically on (un)registration, so dispatching never
+    // blocks and callbacks can register or unregister handlers themselves.
+    typedef std::vector<MAVLinkHandlerTableEntry> handler_list_t;
+    struct MessageHandlers {
+        handler_list_t handlers;
+        // Registered by message type, all of them share one decode.
+        std::shared_ptr<const TypedDispatcherBase> typed;
     };
+    typedef std::unordered_map<uint32_t, MessageHandlers> handler_table_t;
 
+    // Only serializes writers, dispatch uses std::atomic_load on the table.
     std::mutex _mavlink_handler_table_mutex {};
-    std::vector<MAVLinkHandlerTableEntry> _mavlink_handler_table {};
+    std::shared_ptr<const handler_table_t> _mavlink_handler_table {
+        std::make_shared<const handler_table_t>()
+    };
 
     std::atomic<uint8_t> _system_id;
 
     uint64_t _uuid {0};
 
-    int _uuid_retries = 0;
     std::atomic<bool> _uuid_initialized {false};
+    // Not confirmed by AUTOPILOT_VERSION yet.
+    std::atomic<bool> _uuid_from_cache {false};
 
     uint8_t _non_autopilot_heartbeats = 0;
 
@@ -234,38 +390,65 @@ private:
 
     command_result_callback_t _command_result_callback {nullptr};
 
-    std::thread *_system_thread {nullptr};
-    std::atomic<bool> _should_exit {false};
-
-    static constexpr double _HEARTBEAT_TIMEOUT_S = 3.0;
+    dl_time_t _last_timesync_time {};
 
     std::mutex _connection_mutex {};
-    bool _connected {false};
-    void *_heartbeat_timeout_cookie = nullptr;
+    std::atomic<bool> _connected {false};
+    // Steady time of the last message, as count of dl_time_t::duration.
+    std::atomic<int64_t> _last_received_time {0};
 
-    std::atomic<bool> _autopilot_version_pending {false};
+    std::mutex _autopilot_version_mutex {};
+    bool _autopilot_version_pending {false};
+    bool _autopilot_version_received {false};
+    int _uuid_retries = 0;
+    dl_time_t _autopilot_version_requested_time {};
     void *_autopilot_version_timed_out_cookie = nullptr;
 
-    static constexpr double _HEARTBEAT_SEND_INTERVAL_S = 1.0;
+    static constexpr double _AUTOPILOT_VERSION_FIRST_TIMEOUT_S = 0.1;
+    static constexpr double _AUTOPILOT_VERSION_MAX_TIMEOUT_S = 1.0;
+    static constexpr int _AUTOPILOT_VERSION_MAX_REQUESTS = 6;
+
+    // Even if nothing is due, the work runs this often.
+    static constexpr double _MAX_WORK_INTERVAL_S = 1.0;
+    // Faster until synchronized.
+    static constexpr double _TIMESYNC_FIRST_INTERVAL_S = 0.1;
+    static constexpr double _TIMESYNC_INTERVAL_S = 1.0;
 
-    MAVLinkParameters _params;
+    // Blocks of terrain in a TERRAIN_REQUEST, 8 by 7.
+    static constexpr unsigned _TERRAIN_REQUEST_GRID_BITS = 56;
+
+    RttEstimator _rtt_estimator {};
+    Timesync _timesync {};
+    ReceiveStats _receive_stats {};
+
+    std::mutex _lazy_mutex {};
+    std::atomic<MAVLinkParameters *> _params {nullptr};
+    std::atomic<MAVLinkFTP *> _ftp {nullptr};
 
     MAVLinkCommands _commands;
 
+    // Follows logs replayed by the parent, before the handlers using it.
+    Time _time;
+
     TimeoutHandler _timeout_handler;
     CallEveryHandler _call_every_handler;
 
-    Time _time {};
-
     std::atomic<bool> _communication_locked {false};
 
+    // The user callbacks of this system are timed together.
+    HandlerProfiler::Slot _user_callback_slot {};
+
     std::mutex _plugin_impls_mutex {};
     std::vector<PluginImplBase *> _plugin_impls {};
 
-    // We used set to maintain unique component ids
-    std::unordered_set<uint8_t> _components;
-
-    std::vector<std::future<void>> _pending_futures;
+    // Bitmap of the component ids seen, and the roles looked up once when added,
+    // so neither the receive path nor commands need a lock.
+    std::atomic<uint64_t> _components[4] {};
+    std::atomic<unsigned> _num_components {0};
+    std::atomic<uint8_t> _autopilot_id {0};
+    std::atomic<uint8_t> _gimbal_id {0};
+    // One bit per MAV_COMP_ID_CAMERA to MAV_COMP_ID_CAMERA6.
+    std::atomic<uint8_t> _camera_mask {0};
 };
 
 
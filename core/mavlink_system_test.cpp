@@ -0,0 +1,151 @@
+#include "mavlink_system.h"
+#include "dronecore_impl.h"
+#include "global_include.h"
+#include "mocks/recording_connection.h"
+#include "virtual_clock.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+using dronecore::testing::RecordingConnection;
+
+static constexpr uint8_t SYSTEM_ID = 1;
+static constexpr uint64_t UUID = 1234;
+
+// Discovers system 1 on the VirtualClock and notes its link timeouts in
+// virtual time, so timeouts of seconds take a fraction of that.
+struct LinkHarness {
+    LinkHarness()
+    {
+        // Not too short, the test needs to keep up with the clock while it
+        // sends messages.
+        EXPECT_TRUE(VirtualClock::enable(0.05));
+
+        dc.reset(new DroneCoreImpl());
+        connection.reset(new RecordingConnection(*dc));
+        dc->register_on_timeout([this](uint64_t uuid) {
+            std::lock_guard<std::mutex> lock(mutex);
+            timeouts.push_back(uuid);
+            timeout_time = time.steady_time();
+        });
+
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &message,
+                                   MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+        send(message);
+
+        mavlink_autopilot_version_t autopilot_version {};
+        autopilot_version.uid = UUID;
+        mavlink_msg_autopilot_version_encode(SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &message,
+                                             &autopilot_version);
+        send(message);
+    }
+
+    ~LinkHarness()
+    {
+        // The connection needs to outlive DroneCoreImpl, which sends to it.
+        dc.reset();
+        VirtualClock::disable();
+    }
+
+    void send(const mavlink_message_t &message)
+    {
+        last_sent_time = time.steady_time();
+        dc->receive_message(message, *connection, last_sent_time);
+    }
+
+    // Not a heartbeat, any message counts.
+    void send_attitude()
+    {
+        mavlink_message_t message;
+        mavlink_msg_attitude_pack(SYSTEM_ID, MAV_COMP_ID_AUTOPILOT1, &message,
+                                  0, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+        send(message);
+    }
+
+    size_t num_timeouts()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return timeouts.size();
+    }
+
+    // Returns false if there was none within a few seconds of real time.
+    bool wait_for_timeout()
+    {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (num_timeouts() == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return num_timeouts() > 0;
+    }
+
+    // How long after the last message it timed out, in virtual time.
+    double timed_out_after_s()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return std::chrono::duration<double>(timeout_time - last_sent_time).count();
+    }
+
+    Time time {};
+    std::unique_ptr<DroneCoreImpl> dc {};
+    std::unique_ptr<RecordingConnection> connection {};
+
+    std::mutex mutex {};
+    std::vector<uint64_t> timeouts {};
+    dl_time_t timeout_time {};
+    dl_time_t last_sent_time {};
+};
+
+} // namespace
+
+TEST(MAVLinkSystem, AnyMessageKeepsLinkAlive)
+{
+    LinkHarness harness;
+    ASSERT_EQ(harness.dc->get_system_uuids(), std::vector<uint64_t> {UUID});
+
+    // Well past the timeout in total, but never silent for as long.
+    for (int i = 0; i < 10; ++i) {
+        harness.time.sleep_for(std::chrono::seconds(1));
+        harness.send_attitude();
+    }
+    EXPECT_EQ(harness.num_timeouts(), 0u);
+    EXPECT_TRUE(harness.dc->is_connected(UUID));
+
+    ASSERT_TRUE(harness.wait_for_timeout());
+    EXPECT_EQ(harness.timeouts, std::vector<uint64_t> {UUID});
+    EXPECT_FALSE(harness.dc->is_connected(UUID));
+}
+
+TEST(MAVLinkSystem, TimesOutAfterSilence)
+{
+    LinkHarness harness;
+    const double timeout_s = DroneCore::DEFAULT_LINK_TIMEOUT_S;
+
+    ASSERT_TRUE(harness.wait_for_timeout());
+    EXPECT_EQ(harness.timeouts, std::vector<uint64_t> {UUID});
+    // Right when it expired, not at the next time the system thread looked.
+    EXPECT_GE(harness.timed_out_after_s(), timeout_s);
+    EXPECT_LT(harness.timed_out_after_s(), timeout_s + 0.1);
+}
+
+TEST(MAVLinkSystem, LoweredLinkTimeoutAppliesRightAway)
+{
+    LinkHarness harness;
+    const double default_timeout_s = DroneCore::DEFAULT_LINK_TIMEOUT_S;
+
+    harness.time.sleep_for(std::chrono::milliseconds(1500));
+    EXPECT_EQ(harness.num_timeouts(), 0u);
+
+    // The system thread planned to look again at 3 s, it is woken up instead.
+    harness.dc->set_link_timeout(1.0);
+    ASSERT_TRUE(harness.wait_for_timeout());
+    EXPECT_GE(harness.timed_out_after_s(), 1.5);
+    EXPECT_LT(harness.timed_out_after_s(), default_timeout_s);
+}
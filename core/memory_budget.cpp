@@ -0,0 +1,102 @@
+#include "memory_budget.h"
+
+namespace dronecore {
+
+MemoryAccount::MemoryAccount(const std::string &name, const std::shared_ptr<Total> &total) :
+    _name(name),
+    _total(total)
+{
+}
+
+bool MemoryAccount::try_charge(size_t bytes)
+{
+    // Counted first and taken back if over, so that two charges at the same
+    // time can't both squeeze in under a cap.
+    const uint64_t account_bytes = _bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    const uint64_t total_bytes = _total->bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+    const uint64_t cap_bytes = _cap_bytes.load(std::memory_order_relaxed);
+    const uint64_t total_cap_bytes = _total->cap_bytes.load(std::memory_order_relaxed);
+    if ((cap_bytes > 0 && account_bytes > cap_bytes) ||
+        (total_cap_bytes > 0 && total_bytes > total_cap_bytes)) {
+        _bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        _total->bytes.fetch_sub(bytes, std::memory_order_relaxed);
+        _num_refused.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    update_peak(account_bytes);
+    return true;
+}
+
+void MemoryAccount::charge(size_t bytes)
+{
+    const uint64_t account_bytes = _bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    _total->bytes.fetch_add(bytes, std::memory_order_relaxed);
+    update_peak(account_bytes);
+}
+
+void MemoryAccount::release(size_t bytes)
+{
+    _bytes.fetch_sub(bytes, std::memory_order_relaxed);
+    _total->bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+MemoryAccount::Usage MemoryAccount::get_usage() const
+{
+    Usage usage {};
+    usage.name = _name;
+    usage.bytes = _bytes.load(std::memory_order_relaxed);
+    usage.peak_bytes = _peak_bytes.load(std::memory_order_relaxed);
+    usage.cap_bytes = _cap_bytes.load(std::memory_order_relaxed);
+    usage.num_refused = _num_refused.load(std::memory_order_relaxed);
+    return usage;
+}
+
+void MemoryAccount::update_peak(uint64_t bytes)
+{
+    uint64_t peak_bytes = _peak_bytes.load(std::memory_order_relaxed);
+    while (bytes > peak_bytes &&
+           !_peak_bytes.compare_exchange_weak(peak_bytes, bytes, std::memory_order_relaxed)) {}
+}
+
+MemoryBudget::MemoryBudget() :
+    _total(std::make_shared<MemoryAccount::Total>())
+{
+}
+
+std::shared_ptr<MemoryAccount> MemoryBudget::get_account(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::shared_ptr<MemoryAccount> &account = _accounts[name];
+    if (!account) {
+        account.reset(new MemoryAccount(name, _total));
+    }
+    return account;
+}
+
+void MemoryBudget::set_cap(const std::string &name, uint64_t cap_bytes)
+{
+    get_account(name)->_cap_bytes.store(cap_bytes, std::memory_order_relaxed);
+}
+
+void MemoryBudget::set_total_cap(uint64_t cap_bytes)
+{
+    _total->cap_bytes.store(cap_bytes, std::memory_order_relaxed);
+}
+
+uint64_t MemoryBudget::get_total_bytes() const
+{
+    return _total->bytes.load(std::memory_order_relaxed);
+}
+
+void MemoryBudget::get_usage(std::vector<MemoryAccount::Usage> &usage) const
+{
+    usage.clear();
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (const auto &account : _accounts) {
+        usage.push_back(account.second->get_usage());
+    }
+}
+
+} // namespace dronecore
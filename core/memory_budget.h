@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Bytes held by the subsystems of a DroneCore instance, counted per named
+// account such as "terrain" or "system 1/params", with optional caps per
+// account and in total.
+//
+// Subsystems count what they hold with their account. What can be given up
+// asks with try_charge() and either makes room itself when refused (e.g. a
+// cache unloading what it used least recently) or refuses to take more on, the
+// rest is only counted with charge(). Counting is a few relaxed atomic
+// operations, the lock is only taken for looking up accounts and snapshots.
+class MemoryAccount
+{
+public:
+    struct Usage {
+        std::string name;
+        uint64_t bytes;
+        uint64_t peak_bytes;
+        uint64_t cap_bytes; // 0 without a cap.
+        uint64_t num_refused;
+    };
+
+    // Returns false and counts nothing if this would go over the cap of the
+    // account or the total one.
+    bool try_charge(size_t bytes);
+    // For what can't be refused, it also counts against the caps of later
+    // try_charge() calls.
+    void charge(size_t bytes);
+    void release(size_t bytes);
+
+    uint64_t get_bytes() const { return _bytes.load(std::memory_order_relaxed); }
+    Usage get_usage() const;
+
+    // Non-copyable
+    MemoryAccount(const MemoryAccount &) = delete;
+    const MemoryAccount &operator=(const MemoryAccount &) = delete;
+
+private:
+    friend class MemoryBudget;
+
+    // Shared by all accounts of a budget, so they can outlive it.
+    struct Total {
+        std::atomic<uint64_t> bytes {0};
+        std::atomic<uint64_t> cap_bytes {0};
+    };
+
+    MemoryAccount(const std::string &name, const std::shared_ptr<Total> &total);
+
+    void update_peak(uint64_t bytes);
+
+    const std::string _name;
+    const std::shared_ptr<Total> _total;
+
+    std::atomic<uint64_t> _bytes {0};
+    std::atomic<uint64_t> _peak_bytes {0};
+    std::atomic<uint64_t> _cap_bytes {0};
+    std::atomic<uint64_t> _num_refused {0};
+};
+
+class MemoryBudget
+{
+public:
+    MemoryBudget();
+    ~MemoryBudget() = default;
+
+    // The same account for the same name, created on first use.
+    std::shared_ptr<MemoryAccount> get_account(const std::string &name);
+
+    // 0 removes the cap. Lowering a cap below what is held doesn't release
+    // anything, only further try_charge() calls are refused.
+    void set_cap(const std::string &name, uint64_t cap_bytes);
+    void set_total_cap(uint64_t cap_bytes);
+
+    uint64_t get_total_bytes() const;
+    // Sorted by name.
+    void get_usage(std::vector<MemoryAccount::Usage> &usage) const;
+
+    // Non-copyable
+    MemoryBudget(const MemoryBudget &) = delete;
+    const MemoryBudget &operator=(const MemoryBudget &) = delete;
+
+private:
+    const std::shared_ptr<MemoryAccount::Total> _total;
+
+    mutable std::mutex _mutex {};
+    std::map<std::string, std::shared_ptr<MemoryAccount>> _accounts {};
+};
+
+} // namespace dronecore
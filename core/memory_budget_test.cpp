@@ -0,0 +1,69 @@
+#include "memory_budget.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(MemoryBudget, CountsPerAccount)
+{
+    MemoryBudget budget;
+    auto params = budget.get_account("system 1/params");
+    auto terrain = budget.get_account("terrain");
+    EXPECT_EQ(budget.get_account("terrain"), terrain);
+
+    params->charge(1000);
+    EXPECT_TRUE(terrain->try_charge(5000));
+    terrain->release(2000);
+    EXPECT_EQ(params->get_bytes(), 1000u);
+    EXPECT_EQ(terrain->get_bytes(), 3000u);
+    EXPECT_EQ(budget.get_total_bytes(), 4000u);
+
+    std::vector<MemoryAccount::Usage> usage;
+    budget.get_usage(usage);
+    ASSERT_EQ(usage.size(), 2u);
+    EXPECT_EQ(usage[0].name, "system 1/params");
+    EXPECT_EQ(usage[1].name, "terrain");
+    EXPECT_EQ(usage[1].bytes, 3000u);
+    EXPECT_EQ(usage[1].peak_bytes, 5000u);
+    EXPECT_EQ(usage[1].cap_bytes, 0u);
+}
+
+TEST(MemoryBudget, RefusesOverCap)
+{
+    MemoryBudget budget;
+    budget.set_cap("terrain", 4000);
+    auto terrain = budget.get_account("terrain");
+
+    EXPECT_TRUE(terrain->try_charge(3000));
+    EXPECT_FALSE(terrain->try_charge(2000));
+    EXPECT_EQ(terrain->get_bytes(), 3000u);
+    // What can't be refused still counts.
+    terrain->charge(2000);
+    EXPECT_FALSE(terrain->try_charge(1));
+    terrain->release(2000);
+    EXPECT_TRUE(terrain->try_charge(1000));
+
+    const MemoryAccount::Usage usage = terrain->get_usage();
+    EXPECT_EQ(usage.bytes, 4000u);
+    EXPECT_EQ(usage.peak_bytes, 5000u);
+    EXPECT_EQ(usage.num_refused, 2u);
+
+    budget.set_cap("terrain", 0);
+    EXPECT_TRUE(terrain->try_charge(100000));
+}
+
+TEST(MemoryBudget, RefusesOverTotalCap)
+{
+    MemoryBudget budget;
+    auto params = budget.get_account("system 1/params");
+    auto terrain = budget.get_account("terrain");
+    budget.set_total_cap(10000);
+
+    params->charge(8000);
+    EXPECT_FALSE(terrain->try_charge(3000));
+    EXPECT_TRUE(terrain->try_charge(2000));
+    EXPECT_EQ(budget.get_total_bytes(), 10000u);
+
+    params->release(8000);
+    EXPECT_TRUE(terrain->try_charge(3000));
+}
@@ -0,0 +1,26 @@
+#include "message_id_filter.h"
+
+namespace dronecore {
+
+constexpr uint32_t MessageIdFilter::MAX_MESSAGE_ID;
+constexpr uint32_t MessageIdFilter::HEARTBEAT_ID;
+
+void MessageIdFilter::set(Mode mode, const std::vector<uint32_t> &message_ids)
+{
+    // Let everything pass while the list is changing.
+    _mode.store(Mode::NONE, std::memory_order_release);
+
+    for (auto &bits : _bits) {
+        bits.store(0, std::memory_order_relaxed);
+    }
+    for (const uint32_t message_id : message_ids) {
+        if (message_id < MAX_MESSAGE_ID) {
+            _bits[message_id / 64].fetch_or(uint64_t(1) << (message_id % 64),
+                                            std::memory_order_relaxed);
+        }
+    }
+
+    _mode.store(mode, std::memory_order_release);
+}
+
+} // namespace dronecore
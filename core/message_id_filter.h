@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace dronecore {
+
+// Which message IDs a connection passes on, checked for every frame right
+// after parsing. It can be changed while the connection is receiving, a frame
+// parsed at that moment might still see the old setting.
+class MessageIdFilter
+{
+public:
+    enum class Mode : uint8_t {
+        NONE, // Everything passes.
+        ALLOW, // Only the listed IDs pass.
+        DENY // All but the listed IDs pass.
+    };
+
+    MessageIdFilter() = default;
+    ~MessageIdFilter() = default;
+
+    void set(Mode mode, const std::vector<uint32_t> &message_ids);
+
+    bool accepts(uint32_t message_id) const
+    {
+        const Mode mode = _mode.load(std::memory_order_acquire);
+        if (mode == Mode::NONE || message_id == HEARTBEAT_ID) {
+            return true;
+        }
+        const bool listed = message_id < MAX_MESSAGE_ID &&
+                            (_bits[message_id / 64].load(std::memory_order_relaxed) &
+                             (uint64_t(1) << (message_id % 64))) != 0;
+        return listed == (mode == Mode::ALLOW);
+    }
+
+    // IDs from here on can't be listed, no dialect uses them.
+    static constexpr uint32_t MAX_MESSAGE_ID = 65536;
+    // Heartbeats always pass, otherwise no system would be discovered.
+    static constexpr uint32_t HEARTBEAT_ID = 0;
+
+    // Non-copyable
+    MessageIdFilter(const MessageIdFilter &) = delete;
+    const MessageIdFilter &operator=(const MessageIdFilter &) = delete;
+
+private:
+    std::atomic<Mode> _mode {Mode::NONE};
+    std::atomic<uint64_t> _bits[MAX_MESSAGE_ID / 64] {};
+};
+
+} // namespace dronecore
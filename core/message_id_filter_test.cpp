@@ -0,0 +1,51 @@
+#include "message_id_filter.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(MessageIdFilter, PassesEverythingByDefault)
+{
+    MessageIdFilter filter;
+    EXPECT_TRUE(filter.accepts(0));
+    EXPECT_TRUE(filter.accepts(30));
+    EXPECT_TRUE(filter.accepts(12345));
+}
+
+TEST(MessageIdFilter, Allow)
+{
+    MessageIdFilter filter;
+    filter.set(MessageIdFilter::Mode::ALLOW, {30, 33, 12345});
+
+    EXPECT_TRUE(filter.accepts(30));
+    EXPECT_TRUE(filter.accepts(33));
+    EXPECT_TRUE(filter.accepts(12345));
+    EXPECT_FALSE(filter.accepts(31));
+    EXPECT_FALSE(filter.accepts(250));
+    EXPECT_FALSE(filter.accepts(MessageIdFilter::MAX_MESSAGE_ID + 1));
+    // Heartbeats are always needed.
+    EXPECT_TRUE(filter.accepts(MessageIdFilter::HEARTBEAT_ID));
+}
+
+TEST(MessageIdFilter, Deny)
+{
+    MessageIdFilter filter;
+    filter.set(MessageIdFilter::Mode::DENY, {250, 291, MessageIdFilter::HEARTBEAT_ID});
+
+    EXPECT_FALSE(filter.accepts(250));
+    EXPECT_FALSE(filter.accepts(291));
+    EXPECT_TRUE(filter.accepts(30));
+    EXPECT_TRUE(filter.accepts(MessageIdFilter::MAX_MESSAGE_ID + 1));
+    EXPECT_TRUE(filter.accepts(MessageIdFilter::HEARTBEAT_ID));
+}
+
+TEST(MessageIdFilter, Replace)
+{
+    MessageIdFilter filter;
+    filter.set(MessageIdFilter::Mode::DENY, {250});
+    filter.set(MessageIdFilter::Mode::DENY, {291});
+    EXPECT_TRUE(filter.accepts(250));
+    EXPECT_FALSE(filter.accepts(291));
+
+    filter.set(MessageIdFilter::Mode::NONE, {});
+    EXPECT_TRUE(filter.accepts(291));
+}
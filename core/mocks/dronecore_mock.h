@@ -1,6 +1,7 @@
 #include <gmock/gmock.h>
 
 #include "connection_result.h"
+#include "dronecore.h"
 
 namespace dronecore {
 namespace testing {
@@ -10,9 +11,14 @@ typedef std::function<void(uint64_t uuid)> event_callback_t;
 class MockDroneCore
 {
 public:
+    typedef DroneCore::LinkStats LinkStats;
+
     MOCK_CONST_METHOD1(add_udp_connection, ConnectionResult(int local_port_number));
     MOCK_CONST_METHOD1(register_on_discover, void(event_callback_t));
     MOCK_CONST_METHOD1(register_on_timeout, void(event_callback_t));
+    MOCK_CONST_METHOD2(get_link_stats, bool(const std::string &, LinkStats &));
+    MOCK_CONST_METHOD0(system_uuids, std::vector<uint64_t>());
+    MOCK_CONST_METHOD1(system, System & (uint64_t uuid));
 };
 
 } // namespace testing
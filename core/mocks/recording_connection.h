@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "connection.h"
+#include "dronecore_impl.h"
+
+namespace dronecore {
+namespace testing {
+
+// A connection which keeps what is sent for the test. Once DroneCoreImpl got
+// a message through it from a system, what is sent to that system goes here.
+class RecordingConnection : public Connection
+{
+public:
+    explicit RecordingConnection(DroneCoreImpl &parent) : Connection(parent) {}
+
+    ConnectionResult start() override { return ConnectionResult::SUCCESS; }
+    ConnectionResult stop() override { return ConnectionResult::SUCCESS; }
+    bool is_ok() const override { return true; }
+
+    bool send_message(const mavlink_message_t &message) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sent.push_back(message);
+        return true;
+    }
+
+    // Returns and forgets what was sent with this message ID so far.
+    std::vector<mavlink_message_t> take(uint32_t msgid)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<mavlink_message_t> taken;
+        std::vector<mavlink_message_t> kept;
+        for (const auto &message : _sent) {
+            if (message.msgid == msgid) {
+                taken.push_back(message);
+            } else {
+                kept.push_back(message);
+            }
+        }
+        _sent.swap(kept);
+        return taken;
+    }
+
+protected:
+    bool write_buffer(const uint8_t *, size_t) override { return true; }
+
+private:
+    std::mutex _mutex {};
+    std::vector<mavlink_message_t> _sent {};
+};
+
+} // namespace testing
+} // namespace dronecore
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace dronecore {
+
+// Unbounded queue for many producer threads and one consumer thread.
+// Pushing is lock-free (one exchange per item), popping takes no lock either,
+// but must only ever be done from one thread at a time.
+//
+// This is the node based queue by Dmitry Vyukov: producers swap themselves in
+// as the new head and link the previous head to them afterwards. Until that
+// link is set, the consumer sees the queue as empty, so an item pushed at
+// the same time might only show up on the next try_pop().
+template <class T>
+class MPSCQueue
+{
+public:
+    MPSCQueue() :
+        _head(&_stub),
+        _tail(&_stub)
+    {}
+
+    ~MPSCQueue()
+    {
+        T item;
+        while (try_pop(item)) {}
+
+        if (_tail != &_stub) {
+            delete _tail;
+        }
+    }
+
+    void push(T item)
+    {
+        Node *node = new Node(std::move(item));
+        Node *prev = _head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // Consumer only.
+    bool try_pop(T &item)
+    {
+        Node *tail = _tail;
+        Node *next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+
+        // The next node becomes the new stub, its value is moved out.
+        item = std::move(next->value);
+        _tail = next;
+
+        if (tail != &_stub) {
+            delete tail;
+        }
+        return true;
+    }
+
+    // Consumer only.
+    bool empty() const
+    {
+        return _tail->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Non-copyable
+    MPSCQueue(const MPSCQueue &) = delete;
+    const MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+private:
+    struct Node {
+        Node() = default;
+        explicit Node(T &&new_value) : value(std::move(new_value)) {}
+
+        std::atomic<Node *> next {nullptr};
+        T value {};
+    };
+
+    Node _stub {};
+    std::atomic<Node *> _head;
+    // Only touched by the consumer.
+    Node *_tail;
+};
+
+} // namespace dronecore
@@ -0,0 +1,80 @@
+#include "mpsc_queue.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <vector>
+#include <memory>
+
+using namespace dronecore;
+
+TEST(MPSCQueue, FifoOrder)
+{
+    MPSCQueue<int> queue;
+    EXPECT_TRUE(queue.empty());
+
+    int item = 0;
+    EXPECT_FALSE(queue.try_pop(item));
+
+    for (int i = 0; i < 10; ++i) {
+        queue.push(i);
+    }
+    EXPECT_FALSE(queue.empty());
+
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(queue.try_pop(item));
+        EXPECT_EQ(item, i);
+    }
+    EXPECT_FALSE(queue.try_pop(item));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(MPSCQueue, ReleasesItemsOnDestruction)
+{
+    auto shared = std::make_shared<int>(42);
+    {
+        MPSCQueue<std::shared_ptr<int>> queue;
+        queue.push(shared);
+        queue.push(shared);
+
+        std::shared_ptr<int> item;
+        ASSERT_TRUE(queue.try_pop(item));
+        item.reset();
+        EXPECT_EQ(shared.use_count(), 2);
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(MPSCQueue, ManyProducers)
+{
+    static constexpr int num_producers = 4;
+    static constexpr int num_items = 10000;
+
+    MPSCQueue<std::pair<int, int>> queue;
+
+    std::vector<std::thread> producers;
+    for (int producer = 0; producer < num_producers; ++producer) {
+        producers.emplace_back([&queue, producer]() {
+            for (int i = 0; i < num_items; ++i) {
+                queue.push(std::make_pair(producer, i));
+            }
+        });
+    }
+
+    // Every item arrives once, in order per producer.
+    std::vector<int> next_expected(num_producers, 0);
+    int num_received = 0;
+    while (num_received < num_producers * num_items) {
+        std::pair<int, int> item;
+        if (!queue.try_pop(item)) {
+            std::this_thread::yield();
+            continue;
+        }
+        EXPECT_EQ(item.second, next_expected[item.first]);
+        ++next_expected[item.first];
+        ++num_received;
+    }
+
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    EXPECT_TRUE(queue.empty());
+}
@@ -0,0 +1,45 @@
+#include "param_key.h"
+#include <cstring>
+
+namespace dronecore {
+
+constexpr size_t ParamKey::MAX_LEN;
+
+ParamKey::ParamKey(const char *param_id)
+{
+    size_t len = 0;
+    while (len < MAX_LEN && param_id[len] != '\0') {
+        ++len;
+    }
+    assign(param_id, len);
+}
+
+ParamKey::ParamKey(const std::string &name)
+{
+    assign(name.c_str(), name.size() < MAX_LEN ? name.size() : MAX_LEN);
+}
+
+std::string ParamKey::str() const
+{
+    char chars[MAX_LEN];
+    copy_to(chars);
+    size_t len = 0;
+    while (len < MAX_LEN && chars[len] != '\0') {
+        ++len;
+    }
+    return std::string(chars, len);
+}
+
+void ParamKey::copy_to(char *param_id) const
+{
+    memcpy(param_id, _words, MAX_LEN);
+}
+
+void ParamKey::assign(const char *chars, size_t len)
+{
+    char padded[MAX_LEN] = {};
+    memcpy(padded, chars, len);
+    memcpy(_words, padded, MAX_LEN);
+}
+
+} // namespace dronecore
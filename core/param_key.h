@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dronecore {
+
+// Name of a param as it goes over MAVLink: up to 16 chars, 0-padded and not
+// 0-terminated if all 16 are used. It is kept in two 64-bit words, so it is
+// compared and hashed without going through the chars and without allocating.
+class ParamKey
+{
+public:
+    static constexpr size_t MAX_LEN = 16;
+
+    ParamKey() = default;
+    // Anything beyond MAX_LEN chars is cut off, check with fits() first.
+    explicit ParamKey(const char *param_id);
+    explicit ParamKey(const std::string &name);
+
+    static bool fits(const std::string &name) { return name.size() <= MAX_LEN; }
+
+    bool empty() const { return _words[0] == 0; }
+    std::string str() const;
+    // Writes all MAX_LEN bytes, 0-padded as in the param_id fields.
+    void copy_to(char *param_id) const;
+
+    size_t hash() const
+    {
+        // Both words mixed in one go, good enough for the few hundred params
+        // of a vehicle.
+        const uint64_t mixed = (_words[0] ^ (_words[1] * 0x9e3779b97f4a7c15ULL)) *
+                               0xff51afd7ed558ccdULL;
+        return size_t(mixed ^ (mixed >> 32));
+    }
+
+    bool operator==(const ParamKey &other) const
+    {
+        return _words[0] == other._words[0] && _words[1] == other._words[1];
+    }
+    bool operator!=(const ParamKey &other) const { return !(*this == other); }
+
+    struct Hash {
+        size_t operator()(const ParamKey &key) const { return key.hash(); }
+    };
+
+private:
+    void assign(const char *chars, size_t len);
+
+    uint64_t _words[2] {0, 0};
+};
+
+} // namespace dronecore
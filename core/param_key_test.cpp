@@ -0,0 +1,59 @@
+#include "param_key.h"
+#include <gtest/gtest.h>
+#include <cstring>
+#include <unordered_map>
+
+using namespace dronecore;
+
+TEST(ParamKey, RoundTrip)
+{
+    EXPECT_EQ(ParamKey("SYS_AUTOSTART").str(), "SYS_AUTOSTART");
+    EXPECT_EQ(ParamKey(std::string("MPC_XY_VEL_MAX")).str(), "MPC_XY_VEL_MAX");
+    EXPECT_TRUE(ParamKey().empty());
+    EXPECT_TRUE(ParamKey("").empty());
+    EXPECT_EQ(ParamKey().str(), "");
+}
+
+TEST(ParamKey, SixteenCharsWithoutTermination)
+{
+    // As received, the 16 chars fill the field and are followed by anything.
+    const char param_id[] = "CAM_EXPOSURE_MODExyz";
+    const ParamKey key(param_id);
+    EXPECT_EQ(key.str(), "CAM_EXPOSURE_MOD");
+    EXPECT_EQ(key, ParamKey(std::string("CAM_EXPOSURE_MOD")));
+
+    char copied[ParamKey::MAX_LEN + 1] = {};
+    key.copy_to(copied);
+    EXPECT_STREQ(copied, "CAM_EXPOSURE_MOD");
+
+    EXPECT_TRUE(ParamKey::fits("CAM_EXPOSURE_MOD"));
+    EXPECT_FALSE(ParamKey::fits("CAM_EXPOSURE_MODE"));
+}
+
+TEST(ParamKey, CopyIsPadded)
+{
+    char param_id[ParamKey::MAX_LEN];
+    memset(param_id, 'x', sizeof(param_id));
+    ParamKey("CAM_ISO").copy_to(param_id);
+
+    EXPECT_STREQ(param_id, "CAM_ISO");
+    for (size_t i = strlen("CAM_ISO"); i < sizeof(param_id); ++i) {
+        EXPECT_EQ(param_id[i], '\0');
+    }
+}
+
+TEST(ParamKey, CompareAndHash)
+{
+    EXPECT_EQ(ParamKey("CAM_ISO"), ParamKey(std::string("CAM_ISO")));
+    EXPECT_NE(ParamKey("CAM_ISO"), ParamKey("CAM_ISO2"));
+    // Differs only in the second word.
+    EXPECT_NE(ParamKey("CAM_SHUTTERSPD_A"), ParamKey("CAM_SHUTTERSPD_B"));
+    EXPECT_EQ(ParamKey("CAM_ISO").hash(), ParamKey(std::string("CAM_ISO")).hash());
+
+    std::unordered_map<ParamKey, int, ParamKey::Hash> map;
+    map[ParamKey("CAM_ISO")] = 1;
+    map[ParamKey("CAM_SHUTTERSPD_A")] = 2;
+    map[ParamKey("CAM_SHUTTERSPD_B")] = 3;
+    EXPECT_EQ(map.size(), 3u);
+    EXPECT_EQ(map[ParamKey(std::string("CAM_SHUTTERSPD_B"))], 3);
+}
@@ -0,0 +1,68 @@
+#include "allocation_counter.h"
+#include "mavlink_receiver.h"
+#include "mavlink_dispatch_queue.h"
+#include "receive_stats.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+std::vector<char> pack_heartbeats(unsigned num)
+{
+    std::vector<char> buffer;
+    for (unsigned i = 0; i < num; ++i) {
+        mavlink_message_t message;
+        mavlink_msg_heartbeat_pack(2, MAV_COMP_ID_AUTOPILOT1, &message,
+                                   MAV_TYPE_GENERIC, MAV_AUTOPILOT_GENERIC, 0, i, 0);
+        uint8_t packed[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t len = mavlink_msg_to_send_buffer(packed, &message);
+        buffer.insert(buffer.end(), packed, packed + len);
+    }
+    return buffer;
+}
+
+} // namespace
+
+TEST(ReceivePathAllocations, ParseAndCount)
+{
+    MAVLinkReceiver receiver;
+    ReceiveStats receive_stats;
+    Time time;
+    std::vector<char> datagram = pack_heartbeats(100);
+
+    // The first message of an ID gets its counter.
+    receiver.set_new_datagram(datagram.data(), unsigned(datagram.size()));
+    ASSERT_TRUE(receiver.parse_message());
+    receive_stats.add(receiver.get_last_message(), time.steady_time());
+
+    unsigned num_parsed = 1;
+    {
+        AllocationCounter counter;
+        while (receiver.parse_message()) {
+            receive_stats.add(receiver.get_last_message(), time.steady_time());
+            ++num_parsed;
+        }
+        EXPECT_EQ(counter.get(), 0u);
+    }
+    EXPECT_EQ(num_parsed, 100u);
+}
+
+TEST(ReceivePathAllocations, DispatchQueuePush)
+{
+    MAVLinkDispatchQueue queue([](const mavlink_message_t &, const dl_time_t &) {}, 16);
+    queue.start();
+
+    mavlink_message_t message {};
+    const dl_time_t receive_time = std::chrono::steady_clock::now();
+    {
+        AllocationCounter counter;
+        for (unsigned i = 0; i < 100; ++i) {
+            queue.push(message, receive_time);
+        }
+        EXPECT_EQ(counter.get(), 0u);
+    }
+
+    queue.stop();
+}
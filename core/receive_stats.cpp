@@ -0,0 +1,121 @@
+#include "receive_stats.h"
+#include <algorithm>
+
+namespace dronecore {
+
+ReceiveStats::ReceiveStats()
+{
+    reset();
+}
+
+void ReceiveStats::add(const mavlink_message_t &message, const dl_time_t &time)
+{
+    unsigned frame_len = message.len + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+    if (message.magic == MAVLINK_STX && (message.incompat_flags & MAVLINK_IFLAG_SIGNED)) {
+        frame_len += MAVLINK_SIGNATURE_BLOCK_LEN;
+    }
+
+    const int last_sequence =
+        _last_sequence[message.compid].exchange(message.seq, std::memory_order_relaxed);
+    if (last_sequence >= 0) {
+        const unsigned gap = (unsigned(message.seq) - unsigned(last_sequence) - 1) & 0xff;
+        if (gap < MAX_SEQUENCE_GAP) {
+            _num_lost.fetch_add(gap, std::memory_order_relaxed);
+        }
+    }
+
+    Counter *counter = find_counter(message.msgid);
+    if (counter == nullptr) {
+        // All slots are taken by other message IDs.
+        return;
+    }
+
+    const uint64_t count = counter->count.fetch_add(1, std::memory_order_relaxed);
+    counter->bytes.fetch_add(frame_len, std::memory_order_relaxed);
+    const dl_time_t last_time(dl_time_t::duration(
+                                  counter->last_time.exchange(time.time_since_epoch().count(),
+                                                              std::memory_order_relaxed)));
+
+    if (count > 0) {
+        const double interval_s = std::chrono::duration<double>(time - last_time).count();
+
+        double average_interval_s = interval_s;
+        if (count > 1) {
+            average_interval_s = counter->average_interval_s.load(std::memory_order_relaxed);
+            average_interval_s += INTERVAL_GAIN * (interval_s - average_interval_s);
+        }
+        counter->average_interval_s.store(average_interval_s, std::memory_order_relaxed);
+
+        if (interval_s > counter->max_gap_s.load(std::memory_order_relaxed)) {
+            counter->max_gap_s.store(interval_s, std::memory_order_relaxed);
+        }
+    }
+}
+
+ReceiveStats::Counter *ReceiveStats::find_counter(uint32_t message_id)
+{
+    // The common messages have IDs below 256 and get their own slot.
+    for (unsigned i = 0; i < NUM_COUNTERS; ++i) {
+        Counter &counter = _counters[(message_id + i) % NUM_COUNTERS];
+        uint32_t slot_id = counter.message_id.load(std::memory_order_relaxed);
+        if (slot_id == NO_MESSAGE_ID &&
+            counter.message_id.compare_exchange_strong(slot_id, message_id,
+                                                       std::memory_order_relaxed)) {
+            return &counter;
+        }
+        if (slot_id == message_id) {
+            return &counter;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<ReceiveStats::Entry> ReceiveStats::get_entries() const
+{
+    std::vector<Entry> entries {};
+    for (const auto &counter : _counters) {
+        Entry entry {};
+        entry.message_id = counter.message_id.load(std::memory_order_relaxed);
+        entry.count = counter.count.load(std::memory_order_relaxed);
+        if (entry.message_id == NO_MESSAGE_ID || entry.count == 0) {
+            continue;
+        }
+        entry.bytes = counter.bytes.load(std::memory_order_relaxed);
+        entry.average_interval_s = counter.average_interval_s.load(std::memory_order_relaxed);
+        entry.max_gap_s = counter.max_gap_s.load(std::memory_order_relaxed);
+        entries.push_back(entry);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry & lhs, const Entry & rhs) {
+        return lhs.message_id < rhs.message_id;
+    });
+    return entries;
+}
+
+uint64_t ReceiveStats::get_num_lost() const
+{
+    return _num_lost.load(std::memory_order_relaxed);
+}
+
+void ReceiveStats::reset()
+{
+    for (auto &counter : _counters) {
+        clear(counter);
+    }
+    for (auto &last_sequence : _last_sequence) {
+        last_sequence.store(-1, std::memory_order_relaxed);
+    }
+    _num_lost.store(0, std::memory_order_relaxed);
+}
+
+void ReceiveStats::clear(Counter &counter)
+{
+    counter.count.store(0, std::memory_order_relaxed);
+    counter.bytes.store(0, std::memory_order_relaxed);
+    counter.average_interval_s.store(0.0, std::memory_order_relaxed);
+    counter.max_gap_s.store(0.0, std::memory_order_relaxed);
+    counter.last_time.store(0, std::memory_order_relaxed);
+    counter.message_id.store(NO_MESSAGE_ID, std::memory_order_relaxed);
+}
+
+} // namespace dronecore
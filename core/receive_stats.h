@@ -0,0 +1,74 @@
+#pragma once
+
+#include "global_include.h"
+#include "mavlink_include.h"
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace dronecore {
+
+// Counts the messages received from one system per message ID, so it can be
+// checked whether requested message rates took effect and how regular they
+// arrive. Messages lost are detected from gaps in the sequence numbers of
+// each component.
+//
+// add() is on the receive path, so it doesn't lock: the counters live in a
+// fixed table indexed by the message ID, with the IDs above 255 probed into
+// free slots. Concurrent adds for the same message ID may skew the interval
+// statistics slightly, the counts stay exact.
+class ReceiveStats
+{
+public:
+    struct Entry {
+        uint32_t message_id;
+        uint64_t count;
+        uint64_t bytes;
+        // Exponentially weighted moving average.
+        double average_interval_s;
+        double max_gap_s;
+    };
+
+    ReceiveStats();
+    ~ReceiveStats() = default;
+
+    void add(const mavlink_message_t &message, const dl_time_t &time);
+
+    // Sorted by message ID.
+    std::vector<Entry> get_entries() const;
+    uint64_t get_num_lost() const;
+
+    void reset();
+
+    // Non-copyable
+    ReceiveStats(const ReceiveStats &) = delete;
+    const ReceiveStats &operator=(const ReceiveStats &) = delete;
+
+private:
+    struct Counter {
+        // NO_MESSAGE_ID while the slot is free.
+        std::atomic<uint32_t> message_id;
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> bytes;
+        std::atomic<double> average_interval_s;
+        std::atomic<double> max_gap_s;
+        std::atomic<dl_time_t::rep> last_time;
+    };
+
+    Counter *find_counter(uint32_t message_id);
+    static void clear(Counter &counter);
+
+    static constexpr uint32_t NO_MESSAGE_ID = 0xffffffff;
+    static constexpr unsigned NUM_COUNTERS = 256;
+    // Weight of a new interval in the moving average.
+    static constexpr double INTERVAL_GAIN = 0.1;
+    // Bigger jumps in the sequence are rather reordering or a restart than loss.
+    static constexpr unsigned MAX_SEQUENCE_GAP = 128;
+
+    Counter _counters[NUM_COUNTERS];
+    // Last sequence number per component, -1 if none was received yet.
+    std::atomic<int> _last_sequence[256];
+    std::atomic<uint64_t> _num_lost {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,94 @@
+#include "receive_stats.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+static mavlink_message_t make_message(uint32_t msgid, uint8_t compid, uint8_t seq)
+{
+    mavlink_message_t message {};
+    message.magic = MAVLINK_STX;
+    message.msgid = msgid;
+    message.compid = compid;
+    message.seq = seq;
+    message.len = 9;
+    return message;
+}
+
+TEST(ReceiveStats, CountsPerMessageId)
+{
+    ReceiveStats stats;
+    dl_time_t time {};
+
+    uint8_t seq = 0;
+    for (unsigned i = 0; i < 10; ++i) {
+        stats.add(make_message(MAVLINK_MSG_ID_HEARTBEAT, 1, seq++), time);
+        stats.add(make_message(MAVLINK_MSG_ID_ATTITUDE, 1, seq++), time);
+        time += std::chrono::milliseconds(100);
+    }
+
+    const auto entries = stats.get_entries();
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].message_id, MAVLINK_MSG_ID_HEARTBEAT);
+    EXPECT_EQ(entries[0].count, 10u);
+    EXPECT_EQ(entries[0].bytes, 10u * (9 + MAVLINK_NUM_NON_PAYLOAD_BYTES));
+    EXPECT_NEAR(entries[0].average_interval_s, 0.1, 1e-6);
+    EXPECT_NEAR(entries[0].max_gap_s, 0.1, 1e-6);
+    EXPECT_EQ(stats.get_num_lost(), 0u);
+}
+
+TEST(ReceiveStats, MaxGap)
+{
+    ReceiveStats stats;
+    dl_time_t time {};
+
+    uint8_t seq = 0;
+    for (unsigned i = 0; i < 5; ++i) {
+        stats.add(make_message(MAVLINK_MSG_ID_ATTITUDE, 1, seq++), time);
+        time += std::chrono::milliseconds(i == 2 ? 1000 : 20);
+    }
+
+    const auto entries = stats.get_entries();
+    ASSERT_EQ(entries.size(), 1u);
+    EXPECT_NEAR(entries[0].max_gap_s, 1.0, 1e-6);
+    EXPECT_GT(entries[0].average_interval_s, 0.02);
+}
+
+TEST(ReceiveStats, SequenceLoss)
+{
+    ReceiveStats stats;
+    dl_time_t time {};
+
+    stats.add(make_message(MAVLINK_MSG_ID_HEARTBEAT, 1, 254), time);
+    // 255, 0 and 1 are lost, across the wrap around.
+    stats.add(make_message(MAVLINK_MSG_ID_HEARTBEAT, 1, 2), time);
+    // Another component has its own sequence.
+    stats.add(make_message(MAVLINK_MSG_ID_HEARTBEAT, 100, 17), time);
+    stats.add(make_message(MAVLINK_MSG_ID_HEARTBEAT, 100, 18), time);
+    EXPECT_EQ(stats.get_num_lost(), 3u);
+
+    // A duplicate is not counted as loss.
+    stats.add(make_message(MAVLINK_MSG_ID_HEARTBEAT, 100, 18), time);
+    EXPECT_EQ(stats.get_num_lost(), 3u);
+
+    stats.reset();
+    EXPECT_EQ(stats.get_num_lost(), 0u);
+    EXPECT_TRUE(stats.get_entries().empty());
+}
+
+TEST(ReceiveStats, MessageIdsAbove255)
+{
+    ReceiveStats stats;
+    dl_time_t time {};
+
+    // 322 and 66 would share a slot.
+    stats.add(make_message(MAVLINK_MSG_ID_PARAM_EXT_VALUE, 1, 0), time);
+    stats.add(make_message(66, 1, 1), time);
+    stats.add(make_message(MAVLINK_MSG_ID_PARAM_EXT_VALUE, 1, 2), time);
+
+    const auto entries = stats.get_entries();
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].message_id, 66u);
+    EXPECT_EQ(entries[0].count, 1u);
+    EXPECT_EQ(entries[1].message_id, MAVLINK_MSG_ID_PARAM_EXT_VALUE);
+    EXPECT_EQ(entries[1].count, 2u);
+}
@@ -0,0 +1,54 @@
+#include "rtt_estimator.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+constexpr double RttEstimator::DEFAULT_TIMEOUT_S;
+constexpr double RttEstimator::MIN_TIMEOUT_S;
+constexpr double RttEstimator::MAX_TIMEOUT_S;
+
+void RttEstimator::add_sample(double rtt_s)
+{
+    if (!(rtt_s >= 0.0)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_num_samples == 0) {
+        _smoothed_rtt_s = rtt_s;
+        _rtt_variance_s = rtt_s / 2.0;
+    } else {
+        // Gains as recommended in RFC 6298: alpha = 1/8, beta = 1/4.
+        _rtt_variance_s = 0.75 * _rtt_variance_s + 0.25 * std::fabs(_smoothed_rtt_s - rtt_s);
+        _smoothed_rtt_s = 0.875 * _smoothed_rtt_s + 0.125 * rtt_s;
+    }
+    ++_num_samples;
+}
+
+double RttEstimator::get_timeout_s() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_num_samples == 0) {
+        return DEFAULT_TIMEOUT_S;
+    }
+
+    const double timeout_s = _smoothed_rtt_s + 4.0 * _rtt_variance_s;
+    return std::min(std::max(timeout_s, MIN_TIMEOUT_S), MAX_TIMEOUT_S);
+}
+
+double RttEstimator::get_smoothed_rtt_s() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _smoothed_rtt_s;
+}
+
+unsigned RttEstimator::get_num_samples() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _num_samples;
+}
+
+} // namespace dronecore
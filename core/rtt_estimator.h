@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+
+namespace dronecore {
+
+// Smoothed round trip time of a link, estimated as in TCP (Jacobson/Karels,
+// RFC 6298). Request/response timeouts are derived from it, so slow links
+// don't get spurious retries and fast links don't wait needlessly.
+//
+// Only requests which were not retransmitted should be sampled, otherwise it
+// is not clear which transmission the response belongs to (Karn's algorithm).
+class RttEstimator
+{
+public:
+    RttEstimator() = default;
+    ~RttEstimator() = default;
+
+    void add_sample(double rtt_s);
+
+    // Timeout until a request is considered lost.
+    double get_timeout_s() const;
+
+    double get_smoothed_rtt_s() const;
+    unsigned get_num_samples() const;
+
+    // Used until the first sample comes in, this is what we always used before.
+    static constexpr double DEFAULT_TIMEOUT_S = 0.5;
+    // Leave some slack for the other side to process the request.
+    static constexpr double MIN_TIMEOUT_S = 0.1;
+    static constexpr double MAX_TIMEOUT_S = 5.0;
+
+    // Non-copyable
+    RttEstimator(const RttEstimator &) = delete;
+    const RttEstimator &operator=(const RttEstimator &) = delete;
+
+private:
+    mutable std::mutex _mutex {};
+    double _smoothed_rtt_s {0.0};
+    double _rtt_variance_s {0.0};
+    unsigned _num_samples {0};
+};
+
+} // namespace dronecore
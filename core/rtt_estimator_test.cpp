@@ -0,0 +1,54 @@
+#include "rtt_estimator.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+TEST(RttEstimator, DefaultWithoutSamples)
+{
+    RttEstimator estimator;
+    EXPECT_EQ(estimator.get_num_samples(), 0u);
+    EXPECT_DOUBLE_EQ(estimator.get_timeout_s(), RttEstimator::DEFAULT_TIMEOUT_S);
+}
+
+TEST(RttEstimator, SlowLink)
+{
+    RttEstimator estimator;
+
+    // A laggy LTE link.
+    for (unsigned i = 0; i < 20; ++i) {
+        estimator.add_sample((i % 2 == 0) ? 0.3 : 0.8);
+    }
+
+    EXPECT_NEAR(estimator.get_smoothed_rtt_s(), 0.55, 0.05);
+    // Longer than the variation, so we don't retry a response which is just late.
+    EXPECT_GT(estimator.get_timeout_s(), 0.8);
+    EXPECT_LE(estimator.get_timeout_s(), RttEstimator::MAX_TIMEOUT_S);
+}
+
+TEST(RttEstimator, FastLink)
+{
+    RttEstimator estimator;
+
+    for (unsigned i = 0; i < 20; ++i) {
+        estimator.add_sample(0.002);
+    }
+
+    EXPECT_DOUBLE_EQ(estimator.get_timeout_s(), RttEstimator::MIN_TIMEOUT_S);
+    EXPECT_EQ(estimator.get_num_samples(), 20u);
+}
+
+TEST(RttEstimator, IgnoresInvalidSamples)
+{
+    RttEstimator estimator;
+    estimator.add_sample(-1.0);
+    estimator.add_sample(NAN);
+    EXPECT_EQ(estimator.get_num_samples(), 0u);
+}
+
+TEST(RttEstimator, Clamped)
+{
+    RttEstimator estimator;
+    estimator.add_sample(30.0);
+    EXPECT_DOUBLE_EQ(estimator.get_timeout_s(), RttEstimator::MAX_TIMEOUT_S);
+}
@@ -3,31 +3,60 @@
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <chrono>
 #include <cstdio>
+#include <utility>
+#include <vector>
 
 namespace dronecore {
 
 /*
  * Thread-safe queue taken from:
  * http://stackoverflow.com/questions/15278343/c11-thread-safe-queue#answer-16075550
+ *
+ * Items are moved in and out, so move-only types work too, except for dequeue()
+ * which returns nullptr when stopped and is therefore only for pointers.
  */
 
 template <class T>
 class SafeQueue
 {
 public:
-    SafeQueue() :
+    // With a capacity of 0 the queue is unbounded.
+    explicit SafeQueue(size_t capacity = 0) :
         _queue(),
         _mutex(),
-        _condition_var()
+        _condition_var(),
+        _not_full_condition_var(),
+        _capacity(capacity)
     {}
     ~SafeQueue() {}
 
-    void enqueue(T item)
+    // Waits while the queue is full, returns false if stopped meanwhile.
+    bool enqueue(T item)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (is_full() && !_should_exit) {
+            _not_full_condition_var.wait(lock);
+        }
+        if (_should_exit) {
+            return false;
+        }
+        _queue.push(std::move(item));
+        _condition_var.notify_one();
+        return true;
+    }
+
+    // Returns false right away if the queue is full or stopped.
+    bool try_enqueue(T item)
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        _queue.push(item);
+        if (is_full() || _should_exit) {
+            return false;
+        }
+        _queue.push(std::move(item));
         _condition_var.notify_one();
+        return true;
     }
 
     T dequeue()
@@ -40,9 +69,51 @@ public:
             // Release lock during the wait and re-aquire it afterwards.
             _condition_var.wait(lock);
         }
-        T item = _queue.front();
-        _queue.pop();
-        return item;
+        return pop();
+    }
+
+    // Returns false if nothing came within the timeout, or if stopped.
+    template <class Rep, class Period>
+    bool try_dequeue_for(T &item, const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (_queue.empty()) {
+            if (_should_exit ||
+                _condition_var.wait_until(lock, deadline) == std::cv_status::timeout) {
+                if (_queue.empty()) {
+                    return false;
+                }
+                break;
+            }
+        }
+        item = pop();
+        return true;
+    }
+
+    // Waits for at least one item, then appends up to max_items of what is queued
+    // to items. Returns the number appended, 0 once stopped.
+    size_t dequeue_batch(std::vector<T> &items, size_t max_items)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_queue.empty()) {
+            if (_should_exit) {
+                return 0;
+            }
+            _condition_var.wait(lock);
+        }
+        size_t num_items = 0;
+        while (!_queue.empty() && num_items < max_items) {
+            items.push_back(pop());
+            ++num_items;
+        }
+        return num_items;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _queue.size();
     }
 
     void stop()
@@ -52,12 +123,29 @@ public:
         std::lock_guard<std::mutex> lock(_mutex);
         _should_exit = true;
         _condition_var.notify_all();
+        _not_full_condition_var.notify_all();
     }
 
 private:
+    // Need to be called with _mutex locked.
+    bool is_full() const
+    {
+        return _capacity > 0 && _queue.size() >= _capacity;
+    }
+
+    T pop()
+    {
+        T item = std::move(_queue.front());
+        _queue.pop();
+        _not_full_condition_var.notify_one();
+        return item;
+    }
+
     std::queue<T> _queue;
     mutable std::mutex _mutex;
     std::condition_variable _condition_var;
+    std::condition_variable _not_full_condition_var;
+    const size_t _capacity;
     bool _should_exit = false;
 };
 
@@ -0,0 +1,89 @@
+#include "safe_queue.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(SafeQueue, TimedDequeue)
+{
+    SafeQueue<int> queue;
+
+    int item = 0;
+    const auto before = std::chrono::steady_clock::now();
+    EXPECT_FALSE(queue.try_dequeue_for(item, std::chrono::milliseconds(20)));
+    EXPECT_GE(std::chrono::steady_clock::now() - before, std::chrono::milliseconds(20));
+
+    EXPECT_TRUE(queue.enqueue(42));
+    ASSERT_TRUE(queue.try_dequeue_for(item, std::chrono::milliseconds(20)));
+    EXPECT_EQ(item, 42);
+}
+
+TEST(SafeQueue, BoundedCapacity)
+{
+    SafeQueue<int> queue(2);
+
+    EXPECT_TRUE(queue.try_enqueue(1));
+    EXPECT_TRUE(queue.try_enqueue(2));
+    EXPECT_FALSE(queue.try_enqueue(3));
+    EXPECT_EQ(queue.size(), 2);
+
+    // Blocks until there is room.
+    std::atomic<bool> enqueued {false};
+    std::thread producer([&queue, &enqueued]() {
+        enqueued = queue.enqueue(3);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_FALSE(enqueued);
+
+    int item = 0;
+    ASSERT_TRUE(queue.try_dequeue_for(item, std::chrono::milliseconds(0)));
+    EXPECT_EQ(item, 1);
+    producer.join();
+    EXPECT_TRUE(enqueued);
+    EXPECT_EQ(queue.size(), 2);
+}
+
+TEST(SafeQueue, StopReleasesProducersAndConsumers)
+{
+    SafeQueue<int> queue(1);
+    EXPECT_TRUE(queue.enqueue(1));
+
+    std::atomic<bool> enqueued {true};
+    std::thread producer([&queue, &enqueued]() {
+        enqueued = queue.enqueue(2);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.stop();
+    producer.join();
+    EXPECT_FALSE(enqueued);
+    EXPECT_FALSE(queue.try_enqueue(3));
+
+    // What is queued can still be taken out.
+    std::vector<int> items {};
+    EXPECT_EQ(queue.dequeue_batch(items, 10), 1);
+    EXPECT_EQ(queue.dequeue_batch(items, 10), 0);
+}
+
+TEST(SafeQueue, BatchOfMoveOnly)
+{
+    SafeQueue<std::unique_ptr<int>> queue;
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(queue.enqueue(std::unique_ptr<int>(new int(i))));
+    }
+
+    std::vector<std::unique_ptr<int>> items {};
+    EXPECT_EQ(queue.dequeue_batch(items, 3), 3);
+    EXPECT_EQ(queue.dequeue_batch(items, 3), 2);
+    ASSERT_EQ(items.size(), 5);
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(*items[i], i);
+    }
+
+    // dequeue() returns nullptr once stopped.
+    queue.stop();
+    EXPECT_EQ(queue.dequeue(), nullptr);
+}
@@ -0,0 +1,141 @@
+#include "send_batcher.h"
+#include "log.h"
+#include "thread_setup.h"
+#include <algorithm>
+#include <chrono>
+
+namespace dronecore {
+
+SendBatcher::SendBatcher(write_t write, size_t max_len, double max_delay_s) :
+    _write(write),
+    // We need to fit at least one frame.
+    _max_len(std::max(max_len, size_t(MAVLINK_MAX_PACKET_LEN))),
+    _max_delay_s(max_delay_s)
+{
+    _buffer.reserve(_max_len);
+}
+
+SendBatcher::~SendBatcher()
+{
+    stop();
+}
+
+void SendBatcher::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_flush_thread != nullptr) {
+        return;
+    }
+    _should_exit = false;
+    _flush_thread = new std::thread(flush_thread, this);
+}
+
+void SendBatcher::stop()
+{
+    std::thread *thread_to_join = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        thread_to_join = _flush_thread;
+        _flush_thread = nullptr;
+    }
+    _condition_var.notify_all();
+
+    if (thread_to_join != nullptr) {
+        thread_to_join->join();
+        delete thread_to_join;
+    }
+
+    flush();
+}
+
+bool SendBatcher::push(const mavlink_message_t &message)
+{
+    uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+
+    bool success = true;
+    bool was_empty = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_buffer.size() + frame_len > _max_len) {
+            success = write_pending();
+        }
+
+        was_empty = _buffer.empty();
+        _buffer.insert(_buffer.end(), frame, frame + frame_len);
+
+        if (is_high_priority(message.msgid) || _flush_thread == nullptr) {
+            // Don't keep anything waiting behind this one.
+            return write_pending() && success;
+        }
+    }
+
+    if (was_empty) {
+        // The flush thread needs to start the deadline.
+        _condition_var.notify_one();
+    }
+    return success;
+}
+
+bool SendBatcher::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return write_pending();
+}
+
+bool SendBatcher::write_pending()
+{
+    if (_buffer.empty()) {
+        return true;
+    }
+
+    const bool success = _write(_buffer.data(), _buffer.size());
+    _buffer.clear();
+    return success;
+}
+
+bool SendBatcher::is_high_priority(uint32_t msgid)
+{
+    switch (msgid) {
+        case MAVLINK_MSG_ID_COMMAND_LONG:
+        case MAVLINK_MSG_ID_COMMAND_INT:
+        case MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED:
+        case MAVLINK_MSG_ID_SET_POSITION_TARGET_GLOBAL_INT:
+        case MAVLINK_MSG_ID_SET_ATTITUDE_TARGET:
+        case MAVLINK_MSG_ID_MANUAL_CONTROL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void SendBatcher::flush_thread(SendBatcher *self)
+{
+    setup_thread(ThreadRole::Io, "send_batch");
+
+    const auto max_delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                               std::chrono::duration<double>(self->_max_delay_s));
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+    while (!self->_should_exit) {
+        if (self->_buffer.empty()) {
+            self->_condition_var.wait(lock);
+            continue;
+        }
+
+        // Something arrived, give it max_delay to fill up the buffer.
+        const auto deadline = std::chrono::steady_clock::now() + max_delay;
+        while (!self->_should_exit && !self->_buffer.empty() &&
+               std::chrono::steady_clock::now() < deadline) {
+            self->_condition_var.wait_until(lock, deadline);
+        }
+
+        if (!self->write_pending()) {
+            LogErr() << "Writing batched messages failed";
+        }
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace dronecore {
+
+// Packs several outgoing MAVLink frames into one buffer which is written to the
+// link at once (e.g. one UDP datagram or one TCP write). The buffer is written
+// when it is full, when the oldest frame has waited for max_delay_s, or right
+// away for messages which should not be delayed (commands, setpoints).
+class SendBatcher
+{
+public:
+    typedef std::function<bool(const uint8_t *data, size_t len)> write_t;
+
+    SendBatcher(write_t write, size_t max_len, double max_delay_s);
+    ~SendBatcher();
+
+    void start();
+    // Writes what is still pending.
+    void stop();
+
+    // Only returns false if a write which happened in this call failed.
+    bool push(const mavlink_message_t &message);
+    bool flush();
+
+    static bool is_high_priority(uint32_t msgid);
+
+    // 1500 bytes MTU minus IP and UDP header.
+    static constexpr size_t DEFAULT_MAX_LEN = 1472;
+    static constexpr double DEFAULT_MAX_DELAY_S = 0.005;
+
+    // Non-copyable
+    SendBatcher(const SendBatcher &) = delete;
+    const SendBatcher &operator=(const SendBatcher &) = delete;
+
+private:
+    // Need to be called with _mutex locked.
+    bool write_pending();
+
+    static void flush_thread(SendBatcher *self);
+
+    write_t _write;
+    const size_t _max_len;
+    const double _max_delay_s;
+
+    std::mutex _mutex {};
+    std::condition_variable _condition_var {};
+    std::vector<uint8_t> _buffer {};
+    bool _should_exit {false};
+
+    std::thread *_flush_thread {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,116 @@
+#include "send_batcher.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+using namespace dronecore;
+
+static mavlink_message_t make_heartbeat()
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(1, 1, &message, MAV_TYPE_GCS, 0, 0, 0, 0);
+    return message;
+}
+
+static size_t frame_len(const mavlink_message_t &message)
+{
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    return mavlink_msg_to_send_buffer(buffer, &message);
+}
+
+TEST(SendBatcher, PacksUntilDeadline)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<size_t> writes;
+
+    SendBatcher batcher([&](const uint8_t *, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex);
+        writes.push_back(len);
+        cv.notify_one();
+        return true;
+    }, SendBatcher::DEFAULT_MAX_LEN, 0.05);
+    batcher.start();
+
+    const auto message = make_heartbeat();
+    for (unsigned i = 0; i < 5; ++i) {
+        EXPECT_TRUE(batcher.push(message));
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(1), [&]() { return !writes.empty(); });
+    }
+    batcher.stop();
+
+    ASSERT_EQ(writes.size(), 1);
+    EXPECT_EQ(writes[0], 5 * frame_len(message));
+}
+
+TEST(SendBatcher, WritesWhenFull)
+{
+    std::vector<size_t> writes;
+
+    const auto message = make_heartbeat();
+    const size_t max_len = 3 * frame_len(message) + MAVLINK_MAX_PACKET_LEN;
+
+    SendBatcher batcher([&](const uint8_t *, size_t len) {
+        writes.push_back(len);
+        return true;
+    }, max_len, 10.0);
+    batcher.start();
+
+    const unsigned frames_per_write = unsigned(max_len / frame_len(message));
+    for (unsigned i = 0; i < frames_per_write + 1; ++i) {
+        EXPECT_TRUE(batcher.push(message));
+    }
+
+    // The first batch is written, the last frame is still waiting.
+    ASSERT_EQ(writes.size(), 1);
+    EXPECT_EQ(writes[0], frames_per_write * frame_len(message));
+
+    batcher.stop();
+    ASSERT_EQ(writes.size(), 2);
+    EXPECT_EQ(writes[1], frame_len(message));
+}
+
+TEST(SendBatcher, HighPriorityFlushes)
+{
+    std::vector<size_t> writes;
+
+    SendBatcher batcher([&](const uint8_t *, size_t len) {
+        writes.push_back(len);
+        return true;
+    }, SendBatcher::DEFAULT_MAX_LEN, 10.0);
+    batcher.start();
+
+    const auto heartbeat = make_heartbeat();
+    EXPECT_TRUE(batcher.push(heartbeat));
+    EXPECT_EQ(writes.size(), 0);
+
+    mavlink_message_t command;
+    mavlink_msg_command_long_pack(1, 1, &command, 1, 1, MAV_CMD_COMPONENT_ARM_DISARM, 0,
+                                  1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+    EXPECT_TRUE(batcher.push(command));
+
+    // The heartbeat goes out together with the command.
+    ASSERT_EQ(writes.size(), 1);
+    EXPECT_EQ(writes[0], frame_len(heartbeat) + frame_len(command));
+
+    batcher.stop();
+    EXPECT_EQ(writes.size(), 1);
+}
+
+TEST(SendBatcher, WritesDirectlyWhenNotStarted)
+{
+    unsigned num_writes = 0;
+
+    SendBatcher batcher([&](const uint8_t *, size_t) {
+        ++num_writes;
+        return false;
+    }, SendBatcher::DEFAULT_MAX_LEN, 10.0);
+
+    EXPECT_FALSE(batcher.push(make_heartbeat()));
+    EXPECT_EQ(num_writes, 1);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace dronecore {
+
+class SeqLockReader;
+
+// Holds a small plain struct which is written now and then and read often,
+// e.g. the latest telemetry. Readers never take a lock and never stop a
+// writer, they just copy the value again if a write happened in the meantime.
+// Writers only wait for each other, which is rare as there is usually just
+// the receive thread.
+//
+// The value is kept as relaxed atomic words so that the racy copy of a read
+// is well-defined, the sequence number tells whether the copy is usable.
+template <class T>
+class SeqLock
+{
+public:
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock can only hold trivially copyable types");
+
+    SeqLock() :
+        SeqLock(T {})
+    {}
+
+    explicit SeqLock(const T &value)
+    {
+        write_words(value);
+    }
+
+    T load() const
+    {
+        uint32_t version;
+        return load(version);
+    }
+
+    // Also gives the version of the value, which changes with every store or update.
+    T load(uint32_t &version) const
+    {
+        T value;
+        uint32_t seq_before;
+        uint32_t seq_after;
+        do {
+            seq_before = _seq.load(std::memory_order_acquire);
+            read_words(value);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            seq_after = _seq.load(std::memory_order_relaxed);
+        } while ((seq_before & 1) != 0 || seq_before != seq_after);
+        version = seq_before;
+        return value;
+    }
+
+    void store(const T &value)
+    {
+        const uint32_t seq = lock_writer();
+        write_words(value);
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Changes part of the value, f gets a reference to the current one.
+    template <class F>
+    void update(F f)
+    {
+        const uint32_t seq = lock_writer();
+        T value;
+        read_words(value);
+        f(value);
+        write_words(value);
+        _seq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Non-copyable
+    SeqLock(const SeqLock &) = delete;
+    const SeqLock &operator=(const SeqLock &) = delete;
+
+private:
+    friend class SeqLockReader;
+
+    static constexpr size_t NUM_WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    // Makes the sequence number odd, returns what it was before.
+    uint32_t lock_writer()
+    {
+        uint32_t seq = _seq.load(std::memory_order_relaxed);
+        while ((seq & 1) != 0 ||
+               !_seq.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire)) {
+            if ((seq & 1) != 0) {
+                std::this_thread::yield();
+                seq = _seq.load(std::memory_order_relaxed);
+            }
+        }
+        // The data must not be written before the odd sequence number is visible.
+        std::atomic_thread_fence(std::memory_order_release);
+        return seq;
+    }
+
+    void read_words(T &value) const
+    {
+        uint32_t words[NUM_WORDS];
+        for (size_t i = 0; i < NUM_WORDS; ++i) {
+            words[i] = _words[i].load(std::memory_order_relaxed);
+        }
+        std::memcpy(&value, words, sizeof(T));
+    }
+
+    void write_words(const T &value)
+    {
+        uint32_t words[NUM_WORDS] = {};
+        std::memcpy(words, &value, sizeof(T));
+        for (size_t i = 0; i < NUM_WORDS; ++i) {
+            _words[i].store(words[i], std::memory_order_relaxed);
+        }
+    }
+
+    std::atomic<uint32_t> _seq {0};
+    std::atomic<uint32_t> _words[NUM_WORDS];
+};
+
+// Reads several SeqLocks so that the values are consistent with each other, as
+// if they had all been read at once. Each one is still written on its own, so
+// a reader of one of them only copies again when that one was written.
+//
+//     SeqLockReader reader;
+//     do {
+//         reader.restart();
+//         a = reader.load(_a);
+//         b = reader.load(_b);
+//     } while (!reader.is_consistent());
+class SeqLockReader
+{
+public:
+    static constexpr size_t MAX_LOCKS = 16;
+
+    void restart() { _num_locks = 0; }
+
+    template <class T>
+    T load(const SeqLock<T> &seqlock)
+    {
+        assert(_num_locks < MAX_LOCKS);
+        T value = seqlock.load(_versions[_num_locks]);
+        _seqs[_num_locks++] = &seqlock._seq;
+        return value;
+    }
+
+    // False if any of the values loaded since restart() was written meanwhile.
+    bool is_consistent() const
+    {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        for (size_t i = 0; i < _num_locks; ++i) {
+            if (_seqs[i]->load(std::memory_order_relaxed) != _versions[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    const std::atomic<uint32_t> *_seqs[MAX_LOCKS] {};
+    uint32_t _versions[MAX_LOCKS] {};
+    size_t _num_locks {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,126 @@
+#include "seqlock.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include <atomic>
+
+using namespace dronecore;
+
+namespace {
+
+struct Sample {
+    double a;
+    double b;
+    float c;
+    bool d;
+};
+
+} // namespace
+
+TEST(SeqLock, StoreAndLoad)
+{
+    SeqLock<Sample> seqlock(Sample {1.0, 2.0, 3.0f, false});
+
+    Sample sample = seqlock.load();
+    EXPECT_EQ(sample.a, 1.0);
+    EXPECT_EQ(sample.c, 3.0f);
+
+    seqlock.store(Sample {4.0, 5.0, 6.0f, true});
+    sample = seqlock.load();
+    EXPECT_EQ(sample.a, 4.0);
+    EXPECT_EQ(sample.b, 5.0);
+    EXPECT_EQ(sample.c, 6.0f);
+    EXPECT_TRUE(sample.d);
+
+    seqlock.update([](Sample &value) { value.d = false; });
+    sample = seqlock.load();
+    EXPECT_EQ(sample.a, 4.0);
+    EXPECT_FALSE(sample.d);
+}
+
+TEST(SeqLock, VersionChangesWithEveryWrite)
+{
+    SeqLock<Sample> seqlock(Sample {1.0, 2.0, 3.0f, false});
+
+    uint32_t first;
+    uint32_t again;
+    seqlock.load(first);
+    seqlock.load(again);
+    EXPECT_EQ(first, again);
+
+    // Even if the same value is stored again.
+    seqlock.store(Sample {1.0, 2.0, 3.0f, false});
+    uint32_t stored;
+    seqlock.load(stored);
+    EXPECT_NE(stored, first);
+
+    seqlock.update([](Sample &) {});
+    uint32_t updated;
+    seqlock.load(updated);
+    EXPECT_NE(updated, stored);
+}
+
+TEST(SeqLock, ReadersNeverSeeTornValues)
+{
+    // Consistent from the start, the reader can come before the first store.
+    SeqLock<Sample> seqlock(Sample {0.0, 0.0, 0.0f, true});
+    std::atomic<bool> done {false};
+
+    std::thread writer([&]() {
+        for (int i = 1; i <= 100000; ++i) {
+            seqlock.store(Sample {double(i), double(i), float(i), (i % 2) == 0});
+        }
+        done = true;
+    });
+
+    std::thread updater([&]() {
+        for (int i = 0; i < 10000; ++i) {
+            seqlock.update([](Sample &value) { value.d = ((int(value.a) % 2) == 0); });
+        }
+    });
+
+    // At least once, the writer may be done before the reader starts.
+    do {
+        const Sample sample = seqlock.load();
+        ASSERT_EQ(sample.a, sample.b);
+        ASSERT_EQ(float(sample.a), sample.c);
+        ASSERT_EQ((int(sample.a) % 2) == 0, sample.d);
+    } while (!done);
+
+    writer.join();
+    updater.join();
+}
+
+TEST(SeqLockReader, ReadsSeveralConsistently)
+{
+    // The writer always writes first then second, so together second is never
+    // ahead of first and never more than one behind.
+    SeqLock<Sample> first(Sample {0.0, 0.0, 0.0f, false});
+    SeqLock<Sample> second(Sample {0.0, 0.0, 0.0f, false});
+    std::atomic<bool> done {false};
+
+    std::thread writer([&]() {
+        for (int i = 1; i <= 100000; ++i) {
+            first.store(Sample {double(i), 0.0, 0.0f, false});
+            second.store(Sample {double(i), 0.0, 0.0f, false});
+        }
+        done = true;
+    });
+
+    SeqLockReader reader;
+    do {
+        Sample a;
+        Sample b;
+        do {
+            reader.restart();
+            // Read the other way round, so that without checking both these could be
+            // far apart.
+            b = reader.load(second);
+            a = reader.load(first);
+        } while (!reader.is_consistent());
+
+        ASSERT_LE(b.a, a.a);
+        ASSERT_LE(a.a, b.a + 1.0);
+    } while (!done);
+
+    writer.join();
+}
@@ -1,6 +1,7 @@
 #include "serial_connection.h"
 #include "global_include.h"
 #include "log.h"
+#include "thread_setup.h"
 
 
 #if defined(LINUX)
@@ -8,6 +9,7 @@
 #include <fcntl.h>
 #include <asm/termbits.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h> // for ASYNC_LOW_LATENCY
 
 #elif defined(APPLE)
 #include <unistd.h>
@@ -15,6 +17,10 @@
 #include <termios.h>
 #endif
 
+#if defined(LINUX) || defined(APPLE)
+#include <poll.h>
+#endif
+
 #ifndef WINDOWS
 #define GET_ERROR() strerror(errno)
 #else
@@ -53,7 +59,11 @@ namespace dronecore {
 SerialConnection::SerialConnection(DroneCoreImpl &parent, const std::string &path, int baudrate):
     Connection(parent),
     _serial_node(path),
-    _baudrate(baudrate)
+    _baudrate(baudrate),
+    _tx_queue(std::bind(&SerialConnection::write_port, this, std::placeholders::_1,
+                        std::placeholders::_2),
+              TxQueue::DEFAULT_MAX_WRITE_LEN, TxQueue::DEFAULT_MAX_QUEUED_BYTES,
+              std::bind(&SerialConnection::request_stop, this))
 {
     if (baudrate == 0) {
         _baudrate = DEFAULT_SERIAL_BAUDRATE;
@@ -61,6 +71,10 @@ SerialConnection::SerialConnection(DroneCoreImpl &parent, const std::string &pat
     if (path == "") {
         _serial_node = DEFAULT_SERIAL_DEV_PATH;
     }
+
+    // Serial links are usually telemetry radios, so budget them by default.
+    // 10 bits per byte on the wire, and leave some headroom for the radio.
+    set_tx_budget(_baudrate / 10 * TX_BUDGET_RATIO);
 }
 
 SerialConnection::~SerialConnection()
@@ -77,9 +91,7 @@ bool SerialConnection::is_ok() const
 
 ConnectionResult SerialConnection::start()
 {
-    if (!start_mavlink_receiver()) {
-        return ConnectionResult::CONNECTIONS_EXHAUSTED;
-    }
+    start_mavlink_receiver();
 
     ConnectionResult ret = setup_port();
     if (ret != ConnectionResult::SUCCESS) {
@@ -87,6 +99,11 @@ ConnectionResult SerialConnection::start()
     }
 
     start_recv_thread();
+    _tx_queue.start();
+
+    start_tx_scheduler([this](const mavlink_message_t &message) {
+        return transmit(message);
+    });
 
     return ConnectionResult::SUCCESS;
 }
@@ -154,14 +171,22 @@ ConnectionResult SerialConnection::setup_port()
     tc.c_cflag &= ~(CSIZE | PARENB | CRTSCTS);
     tc.c_cflag |= CS8;
 
-    tc.c_cc[VMIN] = 1; // We want at least 1 byte to be available.
-    tc.c_cc[VTIME] = 0; // We don't timeout but wait indefinitely.
+    if (_read_mode == ReadMode::BULK) {
+        tc.c_cc[VMIN] = 255; // Try to fill a bigger chunk per read.
+        tc.c_cc[VTIME] = 1; // But give up after 100 ms without new bytes.
+    } else {
+        tc.c_cc[VMIN] = 1; // We want at least 1 byte to be available.
+        tc.c_cc[VTIME] = 0; // We don't timeout but wait indefinitely.
+    }
 #endif
 
 #if defined(LINUX)
     // CBAUD and BOTHER don't seem to be available for macOS with termios.
+    // With BOTHER any baudrate is possible, e.g. 921600 or 3000000.
     tc.c_cflag &= ~(CBAUD);
     tc.c_cflag |= BOTHER;
+    tc.c_ispeed = _baudrate;
+    tc.c_ospeed = _baudrate;
 
     if (ioctl(_fd, TCSETS2, &tc) == -1) {
         LogErr() << "Could not set terminal attributes " << GET_ERROR();
@@ -175,6 +200,10 @@ ConnectionResult SerialConnection::setup_port()
         close(_fd);
         return ConnectionResult::CONNECTION_ERROR;
     }
+
+    if (_read_mode == ReadMode::LOW_LATENCY) {
+        set_low_latency();
+    }
 #elif defined(APPLE)
     tc.c_cflag |= CLOCAL; // Without this a write() blocks indefinitely.
 
@@ -236,14 +265,44 @@ ConnectionResult SerialConnection::setup_port()
 
 void SerialConnection::start_recv_thread()
 {
+#if defined(LINUX) || defined(APPLE)
+    // Closing the port doesn't wake up a blocking read().
+    if (_wake_fds[0] < 0 && pipe(_wake_fds) != 0) {
+        LogErr() << "pipe failure: " << GET_ERROR();
+        _wake_fds[0] = -1;
+        _wake_fds[1] = -1;
+    }
+#endif
     _recv_thread = new std::thread(receive, this);
 }
 
-ConnectionResult SerialConnection::stop()
+void SerialConnection::request_stop()
 {
     _should_exit = true;
 #if defined(LINUX) || defined(APPLE)
-    close(_fd);
+    if (_wake_fds[1] >= 0) {
+        const char wake = 0;
+        if (write(_wake_fds[1], &wake, 1) != 1) {
+            LogErr() << "write failure: " << GET_ERROR();
+        }
+    }
+#endif
+}
+
+ConnectionResult SerialConnection::stop()
+{
+    // Get the queued messages out while the port is still open. If the port
+    // doesn't take them in time, request_stop() wakes up the stuck write.
+    stop_tx_scheduler();
+    _tx_queue.stop();
+
+    request_stop();
+#if defined(LINUX) || defined(APPLE)
+    // Only once, stop() is called again by the destructor.
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
 #elif defined(WINDOWS)
     CloseHandle(_handle);
 #endif
@@ -253,6 +312,14 @@ ConnectionResult SerialConnection::stop()
         delete _recv_thread;
         _recv_thread = nullptr;
     }
+#if defined(LINUX) || defined(APPLE)
+    for (int &wake_fd : _wake_fds) {
+        if (wake_fd >= 0) {
+            close(wake_fd);
+            wake_fd = -1;
+        }
+    }
+#endif
 
     // We need to stop this after stopping the receive thread, otherwise
     // it can happen that we interfere with the parsing of a message.
@@ -262,6 +329,42 @@ ConnectionResult SerialConnection::stop()
 }
 
 bool SerialConnection::send_message(const mavlink_message_t &message)
+{
+    if (_tx_scheduler) {
+        return _tx_scheduler->push(message);
+    }
+    return transmit(message);
+}
+
+bool SerialConnection::transmit(const mavlink_message_t &message)
+{
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+
+    if (!_tx_queue.push(buffer, buffer_len, TxScheduler::get_priority(message.msgid))) {
+        // The drops are counted in the link stats (tx_dropped), a full queue
+        // shouldn't flood the log on top of it.
+        const auto now = std::chrono::steady_clock::now();
+        const auto next = now + std::chrono::seconds(DROP_WARNING_INTERVAL_S);
+        auto next_warning = _next_drop_warning.load();
+        if (now.time_since_epoch().count() >= next_warning &&
+            _next_drop_warning.compare_exchange_strong(next_warning,
+                                                       next.time_since_epoch().count())) {
+            LogWarn() << "Serial transmit queue full, " << _tx_queue.get_stats().dropped
+                      << " messages dropped so far";
+        }
+        return false;
+    }
+    return true;
+}
+
+bool SerialConnection::write_buffer(const uint8_t *buffer, size_t buffer_len)
+{
+    // Forwarded traffic is mostly telemetry, it shouldn't wait behind a mission upload.
+    return _tx_queue.push(buffer, buffer_len, TxScheduler::Priority::CONTROL);
+}
+
+bool SerialConnection::write_port(const uint8_t *buffer, size_t buffer_len)
 {
     if (_serial_node.empty()) {
         LogErr() << "Dev Path unknown";
@@ -273,35 +376,110 @@ bool SerialConnection::send_message(const mavlink_message_t &message)
         return false;
     }
 
-    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
-
     int send_len;
 #if defined(LINUX) || defined(APPLE)
-    send_len =  write(_fd, buffer, buffer_len);
+    // The port stays blocking, the read modes don't work with O_NONBLOCK. Instead
+    // of blocking in write() until everything fits, wait until the port takes more,
+    // so a port which stopped sending or a stop() don't hold up the thread.
+    size_t written = 0;
+    while (written < buffer_len) {
+        struct pollfd fds[2] = {
+            {_fd, POLLOUT, 0},
+            {_wake_fds[0], POLLIN, 0}
+        };
+        const int num_ready = poll(fds, 2, WRITE_TIMEOUT_MS);
+        if (num_ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (num_ready == 0) {
+            LogErr() << "write timeout";
+            return false;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            // Stopping, what is left doesn't need to go out anymore.
+            return false;
+        }
+        const ssize_t len = write(_fd, buffer + written, buffer_len - written);
+        if (len <= 0) {
+            break;
+        }
+        written += size_t(len);
+    }
+    send_len = int(written);
 #else
-    if (!WriteFile(_handle, buffer, buffer_len, LPDWORD(&send_len), NULL)) {
+    if (!WriteFile(_handle, buffer, DWORD(buffer_len), LPDWORD(&send_len), NULL)) {
         LogErr() << "WriteFile failure: " << GET_ERROR();
         return false;
     }
 #endif
 
-    if (send_len != buffer_len) {
+    if (send_len != int(buffer_len)) {
         LogErr() << "write failure: " << GET_ERROR();
         return false;
     }
 
+    count_bytes_sent(buffer_len);
     return true;
 }
 
+void SerialConnection::set_low_latency()
+{
+#if defined(LINUX)
+    // Not all drivers support this (e.g. not the ones for onboard UARTs),
+    // so carry on without it.
+    struct serial_struct serial;
+    if (ioctl(_fd, TIOCGSERIAL, &serial) == -1) {
+        LogDebug() << "Could not get serial info: " << GET_ERROR();
+        return;
+    }
+
+    serial.flags |= ASYNC_LOW_LATENCY;
+
+    if (ioctl(_fd, TIOCSSERIAL, &serial) == -1) {
+        LogWarn() << "Could not set low latency: " << GET_ERROR();
+    }
+#endif
+}
+
+void SerialConnection::add_read_to_stats(int recv_len)
+{
+    size_t bucket = 0;
+    while ((recv_len >> (bucket + 1)) > 0 && bucket + 1 < NUM_READ_HISTOGRAM_BUCKETS) {
+        ++bucket;
+    }
+
+    std::lock_guard<std::mutex> lock(_read_stats_mutex);
+    ++_read_stats.num_reads;
+    _read_stats.num_bytes += uint64_t(recv_len);
+    ++_read_stats.histogram[bucket];
+}
+
+SerialConnection::ReadStats SerialConnection::get_read_stats() const
+{
+    std::lock_guard<std::mutex> lock(_read_stats_mutex);
+    return _read_stats;
+}
+
 void SerialConnection::receive(SerialConnection *parent)
 {
-    // Enough for MTU 1500 bytes.
-    char buffer[2048];
+    setup_thread(ThreadRole::Io, "serial_recv");
+
+    char buffer[READ_BUFFER_LEN];
 
     while (!parent->_should_exit) {
         int recv_len;
 #if defined(LINUX) || defined(APPLE)
+        struct pollfd fds[2] = {
+            {parent->_fd, POLLIN, 0},
+            {parent->_wake_fds[0], POLLIN, 0}
+        };
+        // A negative fd is ignored, without the pipe this is a blocking read.
+        if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN) != 0) {
+            continue;
+        }
         recv_len = read(parent->_fd, buffer, sizeof(buffer));
         if (recv_len < -1) {
             LogErr() << "read failure: " << GET_ERROR();
@@ -312,9 +490,10 @@ void SerialConnection::receive(SerialConnection *parent)
             continue;
         }
 #endif
-        if (recv_len > static_cast<int>(sizeof(buffer)) || recv_len == 0) {
+        if (recv_len > static_cast<int>(sizeof(buffer)) || recv_len <= 0) {
             continue;
         }
+        parent->add_read_to_stats(recv_len);
         parent->_mavlink_receiver->set_new_datagram(buffer, recv_len);
         // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
         while (parent->_mavlink_receiver->parse_message()) {
@@ -2,7 +2,10 @@
 
 #include <mutex>
 #include <atomic>
+#include <array>
+#include <chrono>
 #include "connection.h"
+#include "tx_queue.h"
 
 #if defined(WINDOWS)
 #include <windows.h>
@@ -19,32 +22,82 @@ public:
     bool is_ok() const;
     ConnectionResult start();
     ConnectionResult stop();
+    void request_stop() override;
     ~SerialConnection();
 
+    // Only queues the message, it is written to the port by a thread of its own.
     bool send_message(const mavlink_message_t &message);
 
+    enum class ReadMode {
+        // Return from read() as soon as anything arrived, and ask the driver
+        // (e.g. FTDI) not to hold back data for its latency timer.
+        LOW_LATENCY,
+        // Collect up to 255 bytes per read() or until the line is idle for
+        // 100 ms, fewer wakeups at the cost of latency.
+        BULK
+    };
+
+    // Needs to be set before start().
+    void set_read_mode(ReadMode read_mode) { _read_mode = read_mode; }
+
+    // Number of bytes per read() in power of 2 buckets: 1, 2-3, 4-7, ...
+    static constexpr size_t NUM_READ_HISTOGRAM_BUCKETS = 13;
+
+    struct ReadStats {
+        uint64_t num_reads;
+        uint64_t num_bytes;
+        std::array<uint64_t, NUM_READ_HISTOGRAM_BUCKETS> histogram;
+    };
+
+    ReadStats get_read_stats() const;
+
+    TxQueue::Stats get_tx_queue_stats() const override { return _tx_queue.get_stats(); }
+
     // Non-copyable
     SerialConnection(const SerialConnection &) = delete;
     const SerialConnection &operator=(const SerialConnection &) = delete;
 
 private:
     ConnectionResult setup_port();
+    bool transmit(const mavlink_message_t &message);
+    // Forwarded frames are queued as well.
+    bool write_buffer(const uint8_t *buffer, size_t buffer_len);
+    // Only called by the thread of the transmit queue.
+    bool write_port(const uint8_t *buffer, size_t buffer_len);
     void start_recv_thread();
     static void receive(SerialConnection *parent);
+    void set_low_latency();
+    void add_read_to_stats(int recv_len);
 
     static constexpr int DEFAULT_SERIAL_BAUDRATE = 9600;
     static constexpr auto DEFAULT_SERIAL_DEV_PATH = "/dev/ttyS0";
+    static constexpr double TX_BUDGET_RATIO = 0.8;
+    // Longest wait for the port to take more data before the write fails.
+    static constexpr int WRITE_TIMEOUT_MS = 1000;
+    static constexpr int DROP_WARNING_INTERVAL_S = 5;
     std::string _serial_node = {};
     int _baudrate = DEFAULT_SERIAL_BAUDRATE;
 
-    std::mutex _mutex = {};
+    // Enough for bursts at 921600 baud and more.
+    static constexpr size_t READ_BUFFER_LEN = 4096;
+
+    ReadMode _read_mode = ReadMode::LOW_LATENCY;
+
+    mutable std::mutex _read_stats_mutex = {};
+    ReadStats _read_stats {0, 0, {}};
+
 #if !defined(WINDOWS)
     int _fd = -1;
+    // Written to by request_stop(), the receive thread waits on both.
+    int _wake_fds[2] = {-1, -1};
 #else
     HANDLE _handle;
 #endif
     std::thread *_recv_thread = nullptr;
+    TxQueue _tx_queue;
     std::atomic_bool _should_exit{false};
+    // Steady clock ticks, until then dropped messages are only counted.
+    std::atomic<std::chrono::steady_clock::rep> _next_drop_warning {0};
 };
 
 } // namespace dronecore
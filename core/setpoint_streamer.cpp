@@ -0,0 +1,144 @@
+#include "setpoint_streamer.h"
+#include "log.h"
+#include "thread_setup.h"
+#include <algorithm>
+#include <chrono>
+
+#if defined(LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace dronecore {
+
+SetpointStreamer::SetpointStreamer(send_t send, double rate_hz) :
+    _send(send),
+    _period_ns(int64_t(1e9 / std::max(rate_hz, 1.0)))
+{}
+
+SetpointStreamer::~SetpointStreamer()
+{
+    stop();
+}
+
+void SetpointStreamer::start()
+{
+    if (_stream_thread != nullptr) {
+        return;
+    }
+    _should_exit = false;
+    _stats.store(Stats {});
+    _stream_thread = new std::thread(stream_thread, this);
+}
+
+void SetpointStreamer::stop()
+{
+    if (_stream_thread == nullptr) {
+        return;
+    }
+    _should_exit = true;
+    _stream_thread->join();
+    delete _stream_thread;
+    _stream_thread = nullptr;
+}
+
+SetpointStreamer::Stats SetpointStreamer::get_stats() const
+{
+    return _stats.load();
+}
+
+void SetpointStreamer::stream_thread(SetpointStreamer *self)
+{
+    bool realtime_priority = setup_thread(ThreadRole::Setpoint, "setpoint");
+    if (get_thread_config(ThreadRole::Setpoint).realtime_priority == 0) {
+        realtime_priority = self->set_realtime_priority();
+    }
+
+    uint64_t num_sent = 0;
+    uint64_t num_missed = 0;
+    double sum_jitter_us = 0.0;
+    double max_jitter_us = 0.0;
+
+    int64_t deadline_ns = now_ns();
+
+    while (!self->_should_exit) {
+        sleep_until_ns(deadline_ns);
+        const int64_t woke_ns = now_ns();
+
+        self->_send();
+
+        const double jitter_us = double(std::max(woke_ns - deadline_ns, int64_t(0))) * 1e-3;
+        ++num_sent;
+        sum_jitter_us += jitter_us;
+        max_jitter_us = std::max(max_jitter_us, jitter_us);
+
+        deadline_ns += self->_period_ns;
+        if (woke_ns >= deadline_ns) {
+            // We missed at least one deadline, rather than catching up with a
+            // burst of setpoints, continue at the rate from now.
+            num_missed += uint64_t((woke_ns - deadline_ns) / self->_period_ns) + 1;
+            deadline_ns = woke_ns + self->_period_ns;
+        }
+
+        Stats stats {};
+        stats.num_sent = num_sent;
+        stats.num_missed = num_missed;
+        stats.mean_jitter_us = sum_jitter_us / double(num_sent);
+        stats.max_jitter_us = max_jitter_us;
+        stats.realtime_priority = realtime_priority;
+        self->_stats.store(stats);
+    }
+}
+
+bool SetpointStreamer::set_realtime_priority()
+{
+#if defined(LINUX)
+    const int min_priority = sched_get_priority_min(SCHED_FIFO);
+    const int max_priority = sched_get_priority_max(SCHED_FIFO);
+
+    struct sched_param param {};
+    // Leave room above for what's more important than setpoints.
+    param.sched_priority = min_priority + (max_priority - min_priority) / 2;
+
+    const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (ret != 0) {
+        LogWarn() << "Could not get realtime priority for setpoints: " << strerror(ret);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+int64_t SetpointStreamer::now_ns()
+{
+#if defined(LINUX)
+    struct timespec now {};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return int64_t(now.tv_sec) * 1000000000 + now.tv_nsec;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void SetpointStreamer::sleep_until_ns(int64_t deadline_ns)
+{
+#if defined(LINUX)
+    struct timespec deadline {};
+    deadline.tv_sec = time_t(deadline_ns / 1000000000);
+    deadline.tv_nsec = long(deadline_ns % 1000000000);
+    // Restart when interrupted by a signal, the deadline stays the same.
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {}
+#else
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+                                      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                          std::chrono::nanoseconds(deadline_ns))));
+#endif
+}
+
+} // namespace dronecore
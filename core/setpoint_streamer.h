@@ -0,0 +1,62 @@
+#pragma once
+
+#include "seqlock.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+namespace dronecore {
+
+// Calls a function at a fixed rate from its own thread, independent of the
+// system thread and whatever params or commands keep it busy. Used for what
+// needs to reach the vehicle at a steady rate, e.g. offboard setpoints or
+// manual control.
+//
+// The thread sleeps until absolute deadlines, so the period doesn't drift by
+// the time the function takes, and it asks for realtime (SCHED_FIFO) priority
+// where permitted, unless a priority is configured for ThreadRole::Setpoint.
+// How late each call is after its deadline goes into the stats.
+class SetpointStreamer
+{
+public:
+    typedef std::function<void()> send_t;
+
+    SetpointStreamer(send_t send, double rate_hz);
+    ~SetpointStreamer();
+
+    void start();
+    // Waits for the thread, up to one period.
+    void stop();
+
+    struct Stats {
+        uint64_t num_sent;
+        // Skipped because the thread was more than a period late.
+        uint64_t num_missed;
+        double mean_jitter_us;
+        double max_jitter_us;
+        bool realtime_priority;
+    };
+    Stats get_stats() const;
+
+    // Non-copyable
+    SetpointStreamer(const SetpointStreamer &) = delete;
+    const SetpointStreamer &operator=(const SetpointStreamer &) = delete;
+
+private:
+    static void stream_thread(SetpointStreamer *self);
+    static int64_t now_ns();
+    static void sleep_until_ns(int64_t deadline_ns);
+    bool set_realtime_priority();
+
+    send_t _send;
+    const int64_t _period_ns;
+
+    std::atomic<bool> _should_exit {false};
+    std::thread *_stream_thread {nullptr};
+
+    // Written by the stream thread only.
+    SeqLock<Stats> _stats {Stats {}};
+};
+
+} // namespace dronecore
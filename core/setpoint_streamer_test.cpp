@@ -0,0 +1,61 @@
+#include "setpoint_streamer.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(SetpointStreamer, SendsAtRate)
+{
+    std::atomic<unsigned> num_calls {0};
+
+    SetpointStreamer streamer([&num_calls]() { ++num_calls; }, 100.0);
+    EXPECT_EQ(streamer.get_stats().num_sent, 0);
+
+    streamer.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    streamer.stop();
+
+    // 20 at 100 Hz, leave room for a loaded machine.
+    const unsigned num_calls_stopped = num_calls;
+    EXPECT_GE(num_calls_stopped, 10);
+    EXPECT_LE(num_calls_stopped, 22);
+
+    const SetpointStreamer::Stats stats = streamer.get_stats();
+    EXPECT_EQ(stats.num_sent, num_calls_stopped);
+    EXPECT_GE(stats.max_jitter_us, stats.mean_jitter_us);
+    EXPECT_GE(stats.mean_jitter_us, 0.0);
+
+    // Nothing is sent once stopped.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(num_calls, num_calls_stopped);
+}
+
+TEST(SetpointStreamer, SkipsMissedDeadlines)
+{
+    std::atomic<unsigned> num_calls {0};
+
+    // Every call takes about 3 periods.
+    SetpointStreamer streamer([&num_calls]() {
+        ++num_calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    }, 100.0);
+
+    streamer.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    streamer.stop();
+
+    const SetpointStreamer::Stats stats = streamer.get_stats();
+    EXPECT_EQ(stats.num_sent, num_calls);
+    // No burst to catch up.
+    EXPECT_LE(num_calls, 8);
+    EXPECT_GT(stats.num_missed, 0);
+}
+
+TEST(SetpointStreamer, StopsWithoutStart)
+{
+    SetpointStreamer streamer(nullptr, 10.0);
+    streamer.stop();
+    EXPECT_EQ(streamer.get_stats().num_sent, 0);
+}
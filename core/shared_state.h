@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+struct SharedStateSegment;
+
+/**
+ * @brief State of one system in the shared memory segment, see
+ * DroneCore::publish_shared_state().
+ *
+ * The layout is fixed so that processes not using DroneCore can read the segment
+ * as well. The segment starts with a header of native endian words:
+ * - `uint32_t magic` (0x44435353), set last once the segment is ready.
+ * - `uint32_t version` (1).
+ * - `uint32_t row_size`, the size of a row in bytes including its sequence number.
+ * - `uint32_t num_rows` (256), one row per system ID.
+ * - `uint64_t present[4]`, bit `id % 64` of `present[id / 64]` is set once the
+ *   system with that ID has been published.
+ *
+ * The rows follow, each a `uint32_t` sequence number and then this struct padded to
+ * a multiple of 4 bytes. A row is usable if the sequence number was even and the same
+ * before and after copying it, otherwise it was being written and needs to be copied
+ * again.
+ */
+struct SharedStateRow {
+    /** @brief Time of the last update in microseconds of the monotonic clock. */
+    uint64_t update_time_us;
+    double latitude_deg; /**< @brief Latitude in degrees, NAN if not received yet. */
+    double longitude_deg; /**< @brief Longitude in degrees, NAN if not received yet. */
+    float absolute_altitude_m; /**< @brief Altitude above mean sea level. */
+    float relative_altitude_m; /**< @brief Altitude above takeoff. */
+    float roll_deg; /**< @brief Roll angle in degrees. */
+    float pitch_deg; /**< @brief Pitch angle in degrees. */
+    float yaw_deg; /**< @brief Yaw angle in degrees. */
+    float battery_voltage_v; /**< @brief Battery voltage in volts. */
+    /** @brief Battery remaining (range: 0.0 to 1.0). */
+    float battery_remaining_percent;
+    uint32_t custom_mode; /**< @brief Autopilot specific flight mode. */
+    uint8_t base_mode; /**< @brief MAV_MODE_FLAG bits of the heartbeat. */
+};
+
+/**
+ * @brief Reads the state published by DroneCore::publish_shared_state() in another
+ * process.
+ *
+ * Reading never blocks the publishing process and doesn't involve it at all: rows are
+ * copied straight out of the shared memory.
+ */
+class SharedStateReader
+{
+public:
+    /**
+     * @brief Constructor, the reader is not open yet.
+     */
+    SharedStateReader() = default;
+
+    /**
+     * @brief Destructor, closes the segment.
+     */
+    ~SharedStateReader();
+
+    /**
+     * @brief Maps the segment read-only.
+     *
+     * A segment published again later, e.g. after the publishing process restarted,
+     * is a new one: open it again to see it.
+     *
+     * @param name Name of the segment, as passed to DroneCore::publish_shared_state().
+     * @return true if the segment exists and is ready. Always false on Windows.
+     */
+    bool open(const std::string &name);
+
+    /**
+     * @brief Unmaps the segment.
+     */
+    void close();
+
+    /**
+     * @brief Copies the state of a system.
+     *
+     * @param system_id System ID of the system.
+     * @param row Copy of the state.
+     * @return true if the system has been published.
+     */
+    bool get(uint8_t system_id, SharedStateRow &row) const;
+
+    /**
+     * @brief The system IDs which have been published.
+     *
+     * @return System IDs in ascending order, empty if not open.
+     */
+    std::vector<uint8_t> get_system_ids() const;
+
+    // Non-copyable
+    SharedStateReader(const SharedStateReader &) = delete;
+    const SharedStateReader &operator=(const SharedStateReader &) = delete;
+
+private:
+    const SharedStateSegment *_segment {nullptr};
+    size_t _size {0};
+};
+
+} // namespace dronecore
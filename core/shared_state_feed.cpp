@@ -0,0 +1,251 @@
+#include "shared_state_feed.h"
+#include "global_include.h"
+#include "log.h"
+
+#if defined(LINUX) || defined(APPLE)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#define GET_ERROR(_x) strerror(_x)
+
+namespace dronecore {
+
+constexpr uint32_t SharedStateSegment::MAGIC;
+constexpr uint32_t SharedStateSegment::VERSION;
+constexpr unsigned SharedStateSegment::NUM_ROWS;
+
+// Other processes rely on these, see shared_state.h.
+static_assert(offsetof(SharedStateSegment, present) == 16, "header changed");
+static_assert(offsetof(SharedStateSegment, rows) == 48, "header changed");
+static_assert(sizeof(SeqLock<SharedStateRow>) ==
+              sizeof(uint32_t) + (sizeof(SharedStateRow) + 3) / 4 * 4,
+              "row is not a sequence number and the words");
+
+SharedStateSegment::SharedStateSegment()
+{
+    for (auto &bits : present) {
+        bits = 0;
+    }
+    SharedStateRow row {};
+    row.latitude_deg = NAN;
+    row.longitude_deg = NAN;
+    row.absolute_altitude_m = NAN;
+    row.relative_altitude_m = NAN;
+    row.roll_deg = NAN;
+    row.pitch_deg = NAN;
+    row.yaw_deg = NAN;
+    row.battery_voltage_v = NAN;
+    row.battery_remaining_percent = NAN;
+    for (auto &seq_lock : rows) {
+        seq_lock.store(row);
+    }
+}
+
+static uint64_t now_us()
+{
+    // The monotonic clock, the same in every process.
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+SharedStateFeed::~SharedStateFeed()
+{
+    stop();
+}
+
+bool SharedStateFeed::start(const std::string &name)
+{
+#if defined(LINUX) || defined(APPLE)
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_segment.load() != nullptr) {
+        LogErr() << "Already publishing the shared state to " << _name;
+        return false;
+    }
+
+    // A new segment, readers of one left over keep theirs until they open again.
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        LogErr() << "shm_open error: " << GET_ERROR(errno);
+        return false;
+    }
+
+    const size_t size = sizeof(SharedStateSegment);
+    void *mapping = MAP_FAILED;
+    if (ftruncate(fd, off_t(size)) == 0) {
+        mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    // The mapping stays valid without the file descriptor.
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        LogErr() << "mmap error: " << GET_ERROR(errno);
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    SharedStateSegment *segment = new (mapping) SharedStateSegment();
+    segment->magic.store(SharedStateSegment::MAGIC, std::memory_order_release);
+
+    _name = name;
+    _segment.store(segment);
+    return true;
+#else
+    UNUSED(name);
+    LogErr() << "Publishing the shared state is not supported on this platform";
+    return false;
+#endif
+}
+
+void SharedStateFeed::stop()
+{
+#if defined(LINUX) || defined(APPLE)
+    std::lock_guard<std::mutex> lock(_mutex);
+    SharedStateSegment *segment = _segment.exchange(nullptr);
+    if (segment == nullptr) {
+        return;
+    }
+
+    // Setters which took the segment before are still writing to it.
+    while (_num_writing.load() != 0) {
+        std::this_thread::yield();
+    }
+
+    munmap(segment, sizeof(SharedStateSegment));
+    shm_unlink(_name.c_str());
+    _name.clear();
+#endif
+}
+
+void SharedStateFeed::set_position(uint8_t system_id, int32_t latitude_e7,
+                                   int32_t longitude_e7, float absolute_altitude_m,
+                                   float relative_altitude_m)
+{
+    update(system_id, [&](SharedStateRow & row) {
+        row.update_time_us = now_us();
+        row.latitude_deg = latitude_e7 * 1e-7;
+        row.longitude_deg = longitude_e7 * 1e-7;
+        row.absolute_altitude_m = absolute_altitude_m;
+        row.relative_altitude_m = relative_altitude_m;
+    });
+}
+
+void SharedStateFeed::set_attitude(uint8_t system_id, float roll_deg, float pitch_deg,
+                                   float yaw_deg)
+{
+    update(system_id, [&](SharedStateRow & row) {
+        row.update_time_us = now_us();
+        row.roll_deg = roll_deg;
+        row.pitch_deg = pitch_deg;
+        row.yaw_deg = yaw_deg;
+    });
+}
+
+void SharedStateFeed::set_battery(uint8_t system_id, float voltage_v, float remaining_percent)
+{
+    update(system_id, [&](SharedStateRow & row) {
+        row.update_time_us = now_us();
+        row.battery_voltage_v = voltage_v;
+        row.battery_remaining_percent = remaining_percent;
+    });
+}
+
+void SharedStateFeed::set_mode(uint8_t system_id, uint8_t base_mode, uint32_t custom_mode)
+{
+    update(system_id, [&](SharedStateRow & row) {
+        row.update_time_us = now_us();
+        row.base_mode = base_mode;
+        row.custom_mode = custom_mode;
+    });
+}
+
+SharedStateReader::~SharedStateReader()
+{
+    close();
+}
+
+bool SharedStateReader::open(const std::string &name)
+{
+    close();
+
+#if defined(LINUX) || defined(APPLE)
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat info;
+    const size_t size = sizeof(SharedStateSegment);
+    void *mapping = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && size_t(info.st_size) >= size) {
+        mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const SharedStateSegment *segment = static_cast<const SharedStateSegment *>(mapping);
+    if (segment->magic.load(std::memory_order_acquire) != SharedStateSegment::MAGIC ||
+        segment->version != SharedStateSegment::VERSION) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    _segment = segment;
+    _size = size;
+    return true;
+#else
+    UNUSED(name);
+    return false;
+#endif
+}
+
+void SharedStateReader::close()
+{
+#if defined(LINUX) || defined(APPLE)
+    if (_segment != nullptr) {
+        munmap(const_cast<SharedStateSegment *>(_segment), _size);
+        _segment = nullptr;
+    }
+#endif
+}
+
+bool SharedStateReader::get(uint8_t system_id, SharedStateRow &row) const
+{
+    if (_segment == nullptr ||
+        (_segment->present[system_id / 64].load(std::memory_order_acquire) &
+         (uint64_t(1) << (system_id % 64))) == 0) {
+        return false;
+    }
+    row = _segment->rows[system_id].load();
+    return true;
+}
+
+std::vector<uint8_t> SharedStateReader::get_system_ids() const
+{
+    std::vector<uint8_t> system_ids;
+    if (_segment == nullptr) {
+        return system_ids;
+    }
+    for (unsigned word = 0; word < SharedStateSegment::NUM_ROWS / 64; ++word) {
+        for (uint64_t bits = _segment->present[word].load(std::memory_order_acquire);
+             bits != 0; bits &= bits - 1) {
+            system_ids.push_back(uint8_t(word * 64 + unsigned(__builtin_ctzll(bits))));
+        }
+    }
+    return system_ids;
+}
+
+} // namespace dronecore
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "seqlock.h"
+#include "shared_state.h"
+
+namespace dronecore {
+
+// The layout described in shared_state.h.
+struct SharedStateSegment {
+    static constexpr uint32_t MAGIC = 0x44435353;
+    static constexpr uint32_t VERSION = 1;
+    static constexpr unsigned NUM_ROWS = 256;
+
+    std::atomic<uint32_t> magic {0};
+    uint32_t version {VERSION};
+    uint32_t row_size {sizeof(SeqLock<SharedStateRow>)};
+    uint32_t num_rows {NUM_ROWS};
+    std::atomic<uint64_t> present[NUM_ROWS / 64];
+    SeqLock<SharedStateRow> rows[NUM_ROWS];
+
+    SharedStateSegment();
+};
+
+// Publishes the state of every system into a POSIX shared memory segment, for
+// local processes which want it at the full rate without going through gRPC.
+//
+// The setters are called on the receive path and don't do anything unless
+// publishing. Stopping waits for setters running at that moment, so the
+// segment can be unmapped safely.
+class SharedStateFeed
+{
+public:
+    SharedStateFeed() = default;
+    ~SharedStateFeed();
+
+    // The name is of the form "/dronecore_state". A segment of the same name
+    // left over is replaced.
+    bool start(const std::string &name);
+    void stop();
+
+    void set_position(uint8_t system_id, int32_t latitude_e7, int32_t longitude_e7,
+                      float absolute_altitude_m, float relative_altitude_m);
+    void set_attitude(uint8_t system_id, float roll_deg, float pitch_deg, float yaw_deg);
+    void set_battery(uint8_t system_id, float voltage_v, float remaining_percent);
+    void set_mode(uint8_t system_id, uint8_t base_mode, uint32_t custom_mode);
+
+    // Non-copyable
+    SharedStateFeed(const SharedStateFeed &) = delete;
+    const SharedStateFeed &operator=(const SharedStateFeed &) = delete;
+
+private:
+    template <class F>
+    void update(uint8_t system_id, F f);
+
+    // Start and stop are rare, they take turns.
+    std::mutex _mutex {};
+    std::string _name {};
+
+    std::atomic<SharedStateSegment *> _segment {nullptr};
+    // Setters between looking at the segment and being done with it.
+    std::atomic<unsigned> _num_writing {0};
+};
+
+template <class F>
+void SharedStateFeed::update(uint8_t system_id, F f)
+{
+    _num_writing.fetch_add(1);
+    SharedStateSegment *segment = _segment.load();
+    if (segment != nullptr) {
+        segment->rows[system_id].update(f);
+        segment->present[system_id / 64].fetch_or(uint64_t(1) << (system_id % 64),
+                                                  std::memory_order_release);
+    }
+    _num_writing.fetch_sub(1);
+}
+
+} // namespace dronecore
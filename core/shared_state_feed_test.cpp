@@ -0,0 +1,102 @@
+#include "shared_state_feed.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <thread>
+
+#if defined(LINUX) || defined(APPLE)
+#include <unistd.h>
+
+using namespace dronecore;
+
+namespace {
+
+std::string segment_name()
+{
+    return "/dronecore_test_state_" + std::to_string(getpid());
+}
+
+} // namespace
+
+TEST(SharedStateFeed, ReaderSeesUpdates)
+{
+    const std::string name = segment_name();
+    SharedStateFeed feed;
+    SharedStateReader reader;
+
+    // Nothing to read before publishing.
+    EXPECT_FALSE(reader.open(name));
+    // Not publishing, so this goes nowhere.
+    feed.set_battery(9, 12.0f, 0.9f);
+
+    ASSERT_TRUE(feed.start(name));
+    EXPECT_FALSE(feed.start(name));
+    feed.set_position(7, 473977418, 85455939, 488.0f, 10.0f);
+    feed.set_mode(3, 0x80, 4);
+
+    ASSERT_TRUE(reader.open(name));
+    const std::vector<uint8_t> system_ids = reader.get_system_ids();
+    ASSERT_EQ(system_ids.size(), 2u);
+    EXPECT_EQ(system_ids[0], 3);
+    EXPECT_EQ(system_ids[1], 7);
+
+    SharedStateRow row;
+    EXPECT_FALSE(reader.get(9, row));
+    ASSERT_TRUE(reader.get(7, row));
+    EXPECT_NEAR(row.latitude_deg, 47.3977418, 1e-9);
+    EXPECT_FLOAT_EQ(row.relative_altitude_m, 10.0f);
+    EXPECT_TRUE(std::isnan(row.yaw_deg));
+    EXPECT_GT(row.update_time_us, 0u);
+
+    feed.set_attitude(7, 1.0f, 2.0f, 90.0f);
+    ASSERT_TRUE(reader.get(7, row));
+    EXPECT_FLOAT_EQ(row.yaw_deg, 90.0f);
+    EXPECT_FLOAT_EQ(row.absolute_altitude_m, 488.0f);
+
+    ASSERT_TRUE(reader.get(3, row));
+    EXPECT_EQ(row.base_mode, 0x80);
+    EXPECT_EQ(row.custom_mode, 4u);
+
+    // The reader keeps its mapping, but the segment is gone for new ones.
+    feed.stop();
+    ASSERT_TRUE(reader.get(3, row));
+    SharedStateReader late_reader;
+    EXPECT_FALSE(late_reader.open(name));
+}
+
+TEST(SharedStateFeed, RowsConsistentWhileWriting)
+{
+    const std::string name = segment_name();
+    SharedStateFeed feed;
+    ASSERT_TRUE(feed.start(name));
+    SharedStateReader reader;
+    ASSERT_TRUE(reader.open(name));
+
+    std::atomic<bool> done {false};
+    std::thread writer([&]() {
+        for (int i = 0; !done; ++i) {
+            const float value = float(i % 1000);
+            feed.set_attitude(1, value, value, value);
+        }
+    });
+
+    for (int i = 0; i < 100000; ++i) {
+        SharedStateRow row;
+        if (reader.get(1, row)) {
+            ASSERT_EQ(row.roll_deg, row.pitch_deg);
+            ASSERT_EQ(row.roll_deg, row.yaw_deg);
+        }
+    }
+
+    done = true;
+    writer.join();
+    // Stopping while writing must not crash the writers either.
+    std::thread stopper([&]() { feed.stop(); });
+    for (int i = 0; i < 1000; ++i) {
+        feed.set_attitude(1, 1.0f, 1.0f, 1.0f);
+    }
+    stopper.join();
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+constexpr double SpatialIndex::DEFAULT_CELL_SIZE_M;
+constexpr unsigned SpatialIndex::MAX_SYSTEMS;
+
+// Beyond this many rings of cells a nearest neighbour search just goes through
+// all systems, the fleet is spread thinly compared to the cells.
+static constexpr int MAX_SEARCH_RINGS = 16;
+
+SpatialIndex::SpatialIndex(double cell_size_m) :
+    _cell_size_m(cell_size_m)
+{
+}
+
+void SpatialIndex::set_proximity_distance(double distance_m)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _proximity_distance_m = distance_m;
+    // Pairs are reported again against the new distance.
+    for (auto &row : _close) {
+        for (auto &word : row) {
+            word = 0;
+        }
+    }
+}
+
+void SpatialIndex::update(uint8_t system_id, double latitude_deg, double longitude_deg,
+                          std::vector<ProximityAlert> &alerts)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (!_has_origin) {
+        _projection = FlatProjection(latitude_deg, longitude_deg);
+        _has_origin = true;
+    }
+
+    double east_m;
+    double north_m;
+    to_local(latitude_deg, longitude_deg, east_m, north_m);
+    const uint64_t key = cell_key(cell_of(east_m), cell_of(north_m));
+
+    if (!_present[system_id]) {
+        _present[system_id] = true;
+        ++_num_systems;
+        _cells[key].push_back(system_id);
+    } else if (_cell[system_id] != key) {
+        unlink(system_id);
+        _cells[key].push_back(system_id);
+    }
+    _east_m[system_id] = east_m;
+    _north_m[system_id] = north_m;
+    _cell[system_id] = key;
+
+    if (_proximity_distance_m <= 0.0) {
+        return;
+    }
+    const double distance_sq = _proximity_distance_m * _proximity_distance_m;
+
+    // Pairs which are apart again can be reported again later.
+    for (unsigned word = 0; word < MAX_SYSTEMS / 64; ++word) {
+        for (uint64_t bits = _close[system_id][word]; bits != 0; bits &= bits - 1) {
+            const uint8_t other = uint8_t(word * 64 + unsigned(__builtin_ctzll(bits)));
+            const double d_east = _east_m[other] - east_m;
+            const double d_north = _north_m[other] - north_m;
+            if (d_east * d_east + d_north * d_north > distance_sq) {
+                set_close(system_id, other, false);
+            }
+        }
+    }
+
+    _candidates.clear();
+    collect_within(east_m, north_m, _proximity_distance_m, _candidates);
+    for (const auto &candidate : _candidates) {
+        if (candidate.system_id == system_id || is_close(system_id, candidate.system_id)) {
+            continue;
+        }
+        set_close(system_id, candidate.system_id, true);
+        alerts.push_back(ProximityAlert {system_id, candidate.system_id,
+                                         std::sqrt(candidate.distance_sq)});
+    }
+}
+
+void SpatialIndex::remove(uint8_t system_id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_present[system_id]) {
+        return;
+    }
+
+    unlink(system_id);
+    _present[system_id] = false;
+    --_num_systems;
+
+    for (unsigned other = 0; other < MAX_SYSTEMS; ++other) {
+        set_close(system_id, uint8_t(other), false);
+    }
+}
+
+void SpatialIndex::find_within(double latitude_deg, double longitude_deg, double radius_m,
+                               std::vector<uint8_t> &system_ids) const
+{
+    system_ids.clear();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_has_origin) {
+        return;
+    }
+
+    double east_m;
+    double north_m;
+    to_local(latitude_deg, longitude_deg, east_m, north_m);
+
+    _candidates.clear();
+    collect_within(east_m, north_m, radius_m, _candidates);
+    std::sort(_candidates.begin(), _candidates.end());
+
+    for (const auto &candidate : _candidates) {
+        system_ids.push_back(candidate.system_id);
+    }
+}
+
+void SpatialIndex::find_nearest(double latitude_deg, double longitude_deg, unsigned k,
+                                std::vector<uint8_t> &system_ids) const
+{
+    system_ids.clear();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_has_origin || k == 0) {
+        return;
+    }
+
+    double east_m;
+    double north_m;
+    to_local(latitude_deg, longitude_deg, east_m, north_m);
+    const int32_t center_x = cell_of(east_m);
+    const int32_t center_y = cell_of(north_m);
+
+    _candidates.clear();
+    auto add_cell = [&](int32_t x, int32_t y) {
+        auto it = _cells.find(cell_key(x, y));
+        if (it == _cells.end()) {
+            return;
+        }
+        for (uint8_t other : it->second) {
+            const double d_east = _east_m[other] - east_m;
+            const double d_north = _north_m[other] - north_m;
+            _candidates.push_back(Candidate {d_east * d_east + d_north * d_north, other});
+        }
+    };
+
+    // Rings of cells around the one of the position, until the k-th closest
+    // found is closer than anything in the rings not searched yet.
+    for (int ring = 0; ; ++ring) {
+        if (ring > MAX_SEARCH_RINGS) {
+            _candidates.clear();
+            collect_within(east_m, north_m, INFINITY, _candidates);
+            break;
+        }
+
+        if (ring == 0) {
+            add_cell(center_x, center_y);
+        } else {
+            for (int32_t i = -ring; i <= ring; ++i) {
+                add_cell(center_x + i, center_y - ring);
+                add_cell(center_x + i, center_y + ring);
+            }
+            for (int32_t i = -ring + 1; i <= ring - 1; ++i) {
+                add_cell(center_x - ring, center_y + i);
+                add_cell(center_x + ring, center_y + i);
+            }
+        }
+
+        if (_candidates.size() == _num_systems) {
+            break;
+        }
+        if (_candidates.size() >= k) {
+            std::nth_element(_candidates.begin(), _candidates.begin() + (k - 1),
+                             _candidates.end());
+            const double searched_m = double(ring) * _cell_size_m;
+            if (_candidates[k - 1].distance_sq <= searched_m * searched_m) {
+                break;
+            }
+        }
+    }
+
+    const size_t num = std::min(size_t(k), _candidates.size());
+    std::partial_sort(_candidates.begin(), _candidates.begin() + num, _candidates.end());
+    for (size_t i = 0; i < num; ++i) {
+        system_ids.push_back(_candidates[i].system_id);
+    }
+}
+
+void SpatialIndex::to_local(double latitude_deg, double longitude_deg, double &east_m,
+                            double &north_m) const
+{
+    _projection.to_local(latitude_deg, longitude_deg, north_m, east_m);
+}
+
+uint64_t SpatialIndex::cell_key(int32_t x, int32_t y) const
+{
+    return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+}
+
+int32_t SpatialIndex::cell_of(double m) const
+{
+    return int32_t(std::floor(m / _cell_size_m));
+}
+
+void SpatialIndex::unlink(uint8_t system_id)
+{
+    auto it = _cells.find(_cell[system_id]);
+    if (it == _cells.end()) {
+        return;
+    }
+
+    std::vector<uint8_t> &ids = it->second;
+    ids.erase(std::remove(ids.begin(), ids.end(), system_id), ids.end());
+    if (ids.empty()) {
+        _cells.erase(it);
+    }
+}
+
+void SpatialIndex::collect_within(double east_m, double north_m, double radius_m,
+                                  std::vector<Candidate> &candidates) const
+{
+    const double radius_sq = radius_m * radius_m;
+    auto add_if_within = [&](uint8_t other) {
+        const double d_east = _east_m[other] - east_m;
+        const double d_north = _north_m[other] - north_m;
+        const double distance_sq = d_east * d_east + d_north * d_north;
+        if (distance_sq <= radius_sq) {
+            candidates.push_back(Candidate {distance_sq, other});
+        }
+    };
+
+    const double num_cells_across = 2.0 * radius_m / _cell_size_m + 1.0;
+    if (!(num_cells_across * num_cells_across < double(_cells.size()))) {
+        // Covers more cells than there are, cheaper to go through all systems.
+        for (unsigned other = 0; other < MAX_SYSTEMS; ++other) {
+            if (_present[other]) {
+                add_if_within(uint8_t(other));
+            }
+        }
+        return;
+    }
+
+    const int32_t min_x = cell_of(east_m - radius_m);
+    const int32_t max_x = cell_of(east_m + radius_m);
+    const int32_t min_y = cell_of(north_m - radius_m);
+    const int32_t max_y = cell_of(north_m + radius_m);
+    for (int32_t x = min_x; x <= max_x; ++x) {
+        for (int32_t y = min_y; y <= max_y; ++y) {
+            auto it = _cells.find(cell_key(x, y));
+            if (it == _cells.end()) {
+                continue;
+            }
+            for (uint8_t other : it->second) {
+                add_if_within(other);
+            }
+        }
+    }
+}
+
+bool SpatialIndex::is_close(uint8_t a, uint8_t b) const
+{
+    return (_close[a][b / 64] & (uint64_t(1) << (b % 64))) != 0;
+}
+
+void SpatialIndex::set_close(uint8_t a, uint8_t b, bool close)
+{
+    if (close) {
+        _close[a][b / 64] |= uint64_t(1) << (b % 64);
+        _close[b][a / 64] |= uint64_t(1) << (a % 64);
+    } else {
+        _close[a][b / 64] &= ~(uint64_t(1) << (b % 64));
+        _close[b][a / 64] &= ~(uint64_t(1) << (a % 64));
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "geo.h"
+
+namespace dronecore {
+
+// Positions of all system IDs on a uniform grid, for radius and nearest
+// neighbour queries without comparing every pair.
+//
+// Positions are projected onto a local plane (east, north) around the first
+// position added, which is accurate to well below a meter for a fleet spread
+// over tens of kilometers. Altitudes are left out.
+//
+// Optionally, pairs of systems closer than a distance are tracked as they move:
+// each update only checks the cells around the system that moved.
+class SpatialIndex
+{
+public:
+    explicit SpatialIndex(double cell_size_m = DEFAULT_CELL_SIZE_M);
+    ~SpatialIndex() = default;
+
+    struct ProximityAlert {
+        uint8_t system_id;
+        uint8_t other_system_id;
+        double distance_m;
+    };
+
+    // Pairs closer than this are reported by update(), 0 to stop tracking.
+    void set_proximity_distance(double distance_m);
+
+    // Pairs which came closer than the proximity distance are added to the alerts.
+    void update(uint8_t system_id, double latitude_deg, double longitude_deg,
+                std::vector<ProximityAlert> &alerts);
+    void remove(uint8_t system_id);
+
+    // Sorted by distance, closest first.
+    void find_within(double latitude_deg, double longitude_deg, double radius_m,
+                     std::vector<uint8_t> &system_ids) const;
+    void find_nearest(double latitude_deg, double longitude_deg, unsigned k,
+                      std::vector<uint8_t> &system_ids) const;
+
+    static constexpr double DEFAULT_CELL_SIZE_M = 100.0;
+    static constexpr unsigned MAX_SYSTEMS = 256;
+
+    // Non-copyable
+    SpatialIndex(const SpatialIndex &) = delete;
+    const SpatialIndex &operator=(const SpatialIndex &) = delete;
+
+private:
+    struct Candidate {
+        double distance_sq;
+        uint8_t system_id;
+
+        bool operator<(const Candidate &other) const
+        {
+            return distance_sq < other.distance_sq;
+        }
+    };
+
+    // These need to be called with _mutex locked.
+    void to_local(double latitude_deg, double longitude_deg, double &east_m,
+                  double &north_m) const;
+    uint64_t cell_key(int32_t x, int32_t y) const;
+    int32_t cell_of(double m) const;
+    void unlink(uint8_t system_id);
+    // Distance squared of the systems within the radius, in any order.
+    void collect_within(double east_m, double north_m, double radius_m,
+                        std::vector<Candidate> &candidates) const;
+    bool is_close(uint8_t a, uint8_t b) const;
+    void set_close(uint8_t a, uint8_t b, bool close);
+
+    const double _cell_size_m;
+
+    mutable std::mutex _mutex {};
+
+    bool _has_origin {false};
+    FlatProjection _projection {};
+
+    unsigned _num_systems {0};
+    bool _present[MAX_SYSTEMS] {};
+    double _east_m[MAX_SYSTEMS] {};
+    double _north_m[MAX_SYSTEMS] {};
+    uint64_t _cell[MAX_SYSTEMS] {};
+    // System IDs in each cell which is not empty.
+    std::unordered_map<uint64_t, std::vector<uint8_t>> _cells {};
+    // Scratch space of the queries, kept to not allocate every time.
+    mutable std::vector<Candidate> _candidates {};
+
+    double _proximity_distance_m {0.0};
+    // Bit matrix of the pairs currently closer than the proximity distance.
+    uint64_t _close[MAX_SYSTEMS][MAX_SYSTEMS / 64] {};
+};
+
+} // namespace dronecore
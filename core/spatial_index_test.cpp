@@ -0,0 +1,115 @@
+#include "spatial_index.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace dronecore;
+
+namespace {
+
+constexpr double LATITUDE_DEG = 47.3977;
+constexpr double LONGITUDE_DEG = 8.5456;
+// Roughly, at this latitude.
+constexpr double M_PER_DEG_LATITUDE = 111195.0;
+const double M_PER_DEG_LONGITUDE = 111195.0 * std::cos(LATITUDE_DEG * M_PI / 180.0);
+
+void place(SpatialIndex &index, uint8_t system_id, double east_m, double north_m,
+           std::vector<SpatialIndex::ProximityAlert> &alerts)
+{
+    index.update(system_id, LATITUDE_DEG + north_m / M_PER_DEG_LATITUDE,
+                 LONGITUDE_DEG + east_m / M_PER_DEG_LONGITUDE, alerts);
+}
+
+} // namespace
+
+TEST(SpatialIndex, FindsWithinRadius)
+{
+    SpatialIndex index;
+    std::vector<SpatialIndex::ProximityAlert> alerts;
+    place(index, 1, 0.0, 0.0, alerts);
+    place(index, 2, 50.0, 0.0, alerts);
+    place(index, 3, 0.0, -150.0, alerts);
+    place(index, 4, 1000.0, 1000.0, alerts);
+
+    std::vector<uint8_t> system_ids;
+    index.find_within(LATITUDE_DEG, LONGITUDE_DEG, 200.0, system_ids);
+    EXPECT_EQ(system_ids, (std::vector<uint8_t> {1, 2, 3}));
+
+    // Moved away into another cell.
+    place(index, 2, 500.0, 0.0, alerts);
+    index.find_within(LATITUDE_DEG, LONGITUDE_DEG, 200.0, system_ids);
+    EXPECT_EQ(system_ids, (std::vector<uint8_t> {1, 3}));
+
+    index.remove(3);
+    index.find_within(LATITUDE_DEG, LONGITUDE_DEG, 200.0, system_ids);
+    EXPECT_EQ(system_ids, (std::vector<uint8_t> {1}));
+}
+
+TEST(SpatialIndex, NearestMatchesBruteForce)
+{
+    SpatialIndex index(50.0);
+    std::vector<SpatialIndex::ProximityAlert> alerts;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<double> offset_m(-5000.0, 5000.0);
+
+    double east_m[200];
+    double north_m[200];
+    for (unsigned i = 0; i < 200; ++i) {
+        east_m[i] = offset_m(random);
+        north_m[i] = offset_m(random);
+        place(index, uint8_t(i), east_m[i], north_m[i], alerts);
+    }
+
+    for (unsigned query = 0; query < 50; ++query) {
+        const double q_east_m = offset_m(random);
+        const double q_north_m = offset_m(random);
+
+        std::vector<unsigned> expected(200);
+        for (unsigned i = 0; i < 200; ++i) {
+            expected[i] = i;
+        }
+        std::sort(expected.begin(), expected.end(), [&](unsigned a, unsigned b) {
+            return std::hypot(east_m[a] - q_east_m, north_m[a] - q_north_m) <
+                   std::hypot(east_m[b] - q_east_m, north_m[b] - q_north_m);
+        });
+
+        std::vector<uint8_t> system_ids;
+        index.find_nearest(LATITUDE_DEG + q_north_m / M_PER_DEG_LATITUDE,
+                           LONGITUDE_DEG + q_east_m / M_PER_DEG_LONGITUDE, 5, system_ids);
+        ASSERT_EQ(system_ids.size(), 5u);
+        for (unsigned i = 0; i < 5; ++i) {
+            EXPECT_EQ(system_ids[i], expected[i]);
+        }
+    }
+}
+
+TEST(SpatialIndex, ReportsPairsComingClose)
+{
+    SpatialIndex index;
+    index.set_proximity_distance(30.0);
+    std::vector<SpatialIndex::ProximityAlert> alerts;
+
+    place(index, 1, 0.0, 0.0, alerts);
+    place(index, 2, 100.0, 0.0, alerts);
+    EXPECT_EQ(alerts.size(), 0u);
+
+    place(index, 2, 20.0, 0.0, alerts);
+    ASSERT_EQ(alerts.size(), 1u);
+    EXPECT_EQ(alerts[0].system_id, 2);
+    EXPECT_EQ(alerts[0].other_system_id, 1);
+    EXPECT_NEAR(alerts[0].distance_m, 20.0, 0.1);
+
+    // Still close, no matter which one moves.
+    alerts.clear();
+    place(index, 2, 25.0, 0.0, alerts);
+    place(index, 1, 5.0, 0.0, alerts);
+    EXPECT_EQ(alerts.size(), 0u);
+
+    // Apart and close again.
+    place(index, 1, -50.0, 0.0, alerts);
+    place(index, 1, 0.0, 0.0, alerts);
+    ASSERT_EQ(alerts.size(), 1u);
+    EXPECT_EQ(alerts[0].system_id, 1);
+    EXPECT_EQ(alerts[0].other_system_id, 2);
+}
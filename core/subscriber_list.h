@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "global_include.h"
+
+namespace dronecore {
+
+// Subscribers of one stream of values.
+//
+// Subscribing and unsubscribing copy the list and swap it in, so notifying
+// only takes a reference to the current list and never blocks on the lock.
+// Without subscribers, notifying is a single relaxed load.
+//
+// A subscriber can be limited to a maximum rate, values coming in faster are
+// left out for it before they are passed on or queued.
+template <typename T>
+class SubscriberList
+{
+public:
+    typedef std::function<void(T)> callback_t;
+    // Returns false to not notify a subscriber of a value. Only called by the
+    // thread notifying, so it can keep state such as the last value passed.
+    typedef std::function<bool(const T &)> filter_t;
+
+    // Handles are given out by the user of the list so that they can be
+    // unique across several lists. Handle 0 is reserved for set().
+    typedef uint64_t handle_t;
+
+    // When the next value is due for a subscriber with a maximum rate. Like
+    // filters, only used by the thread notifying.
+    struct RateLimit {
+        RateLimit(double max_rate_hz, Time &clock) :
+            interval(std::chrono::duration_cast<dl_time_t::duration>(
+                         std::chrono::duration<double>(1.0 / max_rate_hz))),
+            time(clock) {}
+
+        const dl_time_t::duration interval;
+        Time &time;
+        dl_time_t next_due {};
+    };
+
+    struct Subscriber {
+        handle_t handle;
+        callback_t callback;
+        filter_t filter;
+        std::shared_ptr<RateLimit> rate_limit;
+
+        bool wants(const T &value) const
+        {
+            if (!rate_limit) {
+                return !filter || filter(value);
+            }
+
+            // Values at exactly the rate asked for jitter around when they are due,
+            // so they are taken from half an interval early on.
+            const dl_time_t now = rate_limit->time.steady_time();
+            if (now < rate_limit->next_due - rate_limit->interval / 2 ||
+                (filter && !filter(value))) {
+                return false;
+            }
+            // Keeps to the rate on average even if the values come in unevenly,
+            // but doesn't catch up on a gap.
+            rate_limit->next_due += rate_limit->interval;
+            if (rate_limit->next_due <= now) {
+                rate_limit->next_due = now + rate_limit->interval;
+            }
+            return true;
+        }
+    };
+    typedef std::vector<std::shared_ptr<const Subscriber>> subscribers_t;
+
+    // The single subscriber of the old one-callback-per-stream interface,
+    // replaced on every call, nullptr removes it.
+    void set(const callback_t &callback)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto subscribers = copy_without(0);
+        if (callback) {
+            subscribers->push_back(std::make_shared<const Subscriber>(
+                                       Subscriber {0, callback, nullptr, nullptr}));
+        }
+        swap_in(subscribers);
+    }
+
+    void add(handle_t handle, const callback_t &callback)
+    {
+        if (!callback) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto subscribers = copy_without(handle);
+        subscribers->push_back(std::make_shared<const Subscriber>(
+                                   Subscriber {handle, callback, nullptr, nullptr}));
+        swap_in(subscribers);
+    }
+
+    // Replaces the filter of a subscriber, nullptr removes it. Returns false if
+    // there is no subscriber with this handle.
+    bool set_filter(handle_t handle, const filter_t &filter)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto subscribers = std::make_shared<subscribers_t>(*_subscribers);
+        for (auto &subscriber : *subscribers) {
+            if (subscriber->handle == handle) {
+                subscriber = std::make_shared<const Subscriber>(
+                                 Subscriber {handle, subscriber->callback, filter,
+                                             subscriber->rate_limit});
+                swap_in(subscribers);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Limits the values passed to a subscriber to a maximum rate, 0 to pass all
+    // of them again. The time needs to outlive the subscriber. Returns false if
+    // there is no subscriber with this handle.
+    bool set_max_rate(handle_t handle, double max_rate_hz, Time &time)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto subscribers = std::make_shared<subscribers_t>(*_subscribers);
+        for (auto &subscriber : *subscribers) {
+            if (subscriber->handle == handle) {
+                subscriber = std::make_shared<const Subscriber>(
+                                 Subscriber {handle, subscriber->callback, subscriber->filter,
+                                             (max_rate_hz > 0.0) ?
+                                             std::make_shared<RateLimit>(max_rate_hz, time) :
+                                             nullptr});
+                swap_in(subscribers);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns false if there was no subscriber with this handle.
+    bool remove(handle_t handle)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto subscribers = copy_without(handle);
+        if (subscribers->size() == _num_subscribers.load(std::memory_order_relaxed)) {
+            return false;
+        }
+        swap_in(subscribers);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return _num_subscribers.load(std::memory_order_relaxed) == 0;
+    }
+
+    // The list as it is now, later changes don't affect it.
+    std::shared_ptr<const subscribers_t> get() const
+    {
+        return std::atomic_load(&_subscribers);
+    }
+
+    // Calls all subscribers which want the value directly.
+    void call(T value) const
+    {
+        if (empty()) {
+            return;
+        }
+        const auto subscribers = get();
+        for (const auto &subscriber : *subscribers) {
+            if (subscriber->wants(value)) {
+                subscriber->callback(value);
+            }
+        }
+    }
+
+private:
+    // Need to be called with _mutex locked.
+    std::shared_ptr<subscribers_t> copy_without(handle_t handle) const
+    {
+        auto subscribers = std::make_shared<subscribers_t>();
+        for (const auto &subscriber : *_subscribers) {
+            if (subscriber->handle != handle) {
+                subscribers->push_back(subscriber);
+            }
+        }
+        return subscribers;
+    }
+
+    void swap_in(const std::shared_ptr<subscribers_t> &subscribers)
+    {
+        _num_subscribers.store(subscribers->size(), std::memory_order_relaxed);
+        std::atomic_store(&_subscribers, std::shared_ptr<const subscribers_t>(subscribers));
+    }
+
+    std::mutex _mutex {};
+    std::shared_ptr<const subscribers_t> _subscribers {std::make_shared<const subscribers_t>()};
+    std::atomic<size_t> _num_subscribers {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,164 @@
+#include "subscriber_list.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(SubscriberList, CallsAll)
+{
+    SubscriberList<int> subscribers;
+    EXPECT_TRUE(subscribers.empty());
+
+    int sum_a = 0;
+    int sum_b = 0;
+    subscribers.add(1, [&sum_a](int value) { sum_a += value; });
+    subscribers.add(2, [&sum_b](int value) { sum_b += value; });
+    EXPECT_FALSE(subscribers.empty());
+
+    subscribers.call(3);
+    EXPECT_EQ(sum_a, 3);
+    EXPECT_EQ(sum_b, 3);
+
+    EXPECT_TRUE(subscribers.remove(1));
+    EXPECT_FALSE(subscribers.remove(1));
+
+    subscribers.call(4);
+    EXPECT_EQ(sum_a, 3);
+    EXPECT_EQ(sum_b, 7);
+
+    EXPECT_TRUE(subscribers.remove(2));
+    EXPECT_TRUE(subscribers.empty());
+}
+
+TEST(SubscriberList, SetReplacesOnlyItself)
+{
+    SubscriberList<int> subscribers;
+
+    int count_set_a = 0;
+    int count_set_b = 0;
+    int count_added = 0;
+    subscribers.set([&count_set_a](int) { ++count_set_a; });
+    subscribers.add(5, [&count_added](int) { ++count_added; });
+    subscribers.set([&count_set_b](int) { ++count_set_b; });
+
+    subscribers.call(0);
+    EXPECT_EQ(count_set_a, 0);
+    EXPECT_EQ(count_set_b, 1);
+    EXPECT_EQ(count_added, 1);
+
+    subscribers.set(nullptr);
+    subscribers.call(0);
+    EXPECT_EQ(count_set_b, 1);
+    EXPECT_EQ(count_added, 2);
+}
+
+TEST(SubscriberList, UnsubscribeWhileCalling)
+{
+    SubscriberList<int> subscribers;
+
+    // The list being called is not changed, the next call is.
+    int count = 0;
+    subscribers.add(1, [&](int) {
+        ++count;
+        subscribers.remove(1);
+    });
+
+    subscribers.call(0);
+    subscribers.call(0);
+    EXPECT_EQ(count, 1);
+}
+
+TEST(SubscriberList, FilterSkipsSubscriber)
+{
+    SubscriberList<int> subscribers;
+
+    std::vector<int> received_a;
+    std::vector<int> received_b;
+    subscribers.add(1, [&received_a](int value) { received_a.push_back(value); });
+    subscribers.add(2, [&received_b](int value) { received_b.push_back(value); });
+
+    // Only on change, keeping the last value passed.
+    bool has_last = false;
+    int last = 0;
+    EXPECT_TRUE(subscribers.set_filter(1, [&](const int &value) {
+        if (has_last && value == last) {
+            return false;
+        }
+        has_last = true;
+        last = value;
+        return true;
+    }));
+    EXPECT_FALSE(subscribers.set_filter(3, nullptr));
+
+    for (int value : {1, 1, 2, 2, 2, 1}) {
+        subscribers.call(value);
+    }
+    EXPECT_EQ(received_a, (std::vector<int> {1, 2, 1}));
+    EXPECT_EQ(received_b.size(), 6u);
+
+    EXPECT_TRUE(subscribers.set_filter(1, nullptr));
+    subscribers.call(1);
+    EXPECT_EQ(received_a.size(), 4u);
+}
+
+TEST(SubscriberList, MaxRateDecimates)
+{
+    SubscriberList<int> subscribers;
+    FakeTime time;
+
+    std::vector<int> received_slow;
+    std::vector<int> received_fast;
+    subscribers.add(1, [&received_slow](int value) { received_slow.push_back(value); });
+    subscribers.add(2, [&received_fast](int value) { received_fast.push_back(value); });
+
+    EXPECT_TRUE(subscribers.set_max_rate(1, 10.0, time));
+    EXPECT_FALSE(subscribers.set_max_rate(3, 10.0, time));
+
+    // Much faster than 10 Hz, only the first one is due.
+    for (int value = 0; value < 10; ++value) {
+        subscribers.call(value);
+    }
+    EXPECT_EQ(received_slow, (std::vector<int> {0}));
+    EXPECT_EQ(received_fast.size(), 10u);
+
+    time.sleep_for(std::chrono::milliseconds(120));
+    subscribers.call(10);
+    subscribers.call(11);
+    EXPECT_EQ(received_slow, (std::vector<int> {0, 10}));
+
+    EXPECT_TRUE(subscribers.set_max_rate(1, 0.0, time));
+    subscribers.call(12);
+    subscribers.call(13);
+    EXPECT_EQ(received_slow, (std::vector<int> {0, 10, 12, 13}));
+}
+
+TEST(SubscriberList, MaxRatePassesJitteredStream)
+{
+    SubscriberList<int> subscribers;
+    FakeTime time;
+    const dl_time_t start = time.steady_time();
+
+    std::vector<int> received;
+    subscribers.add(1, [&received](int value) { received.push_back(value); });
+    EXPECT_TRUE(subscribers.set_max_rate(1, 10.0, time));
+
+    // At exactly 10 Hz on average, but each value a bit early or late.
+    for (int value = 0; value < 100; ++value) {
+        const int jitter_ms = (value % 3 == 0) ? -30 : ((value % 3 == 1) ? 20 : 0);
+        const dl_time_t due = start + std::chrono::milliseconds(1000 + value * 100 + jitter_ms);
+        time.sleep_for(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           due - time.steady_time()));
+        subscribers.call(value);
+    }
+    EXPECT_EQ(received.size(), 100u);
+
+    // Twice as fast as asked for, every other one is left out.
+    received.clear();
+    for (int value = 0; value < 100; ++value) {
+        time.sleep_for(std::chrono::milliseconds(50));
+        subscribers.call(value);
+    }
+    EXPECT_GE(received.size(), 49u);
+    EXPECT_LE(received.size(), 51u);
+}
@@ -48,14 +48,40 @@ bool System::has_gimbal() const
     return _mavlink_system->has_gimbal();
 }
 
+std::vector<System::MessageStats> System::get_message_stats() const
+{
+    std::vector<MessageStats> message_stats {};
+    for (const auto &entry : _mavlink_system->get_receive_stats().get_entries()) {
+        MessageStats stats {};
+        stats.message_id = entry.message_id;
+        stats.count = entry.count;
+        stats.bytes = entry.bytes;
+        stats.average_interval_s = entry.average_interval_s;
+        stats.max_gap_s = entry.max_gap_s;
+        message_stats.push_back(stats);
+    }
+    return message_stats;
+}
+
+uint64_t System::get_num_messages_lost() const
+{
+    return _mavlink_system->get_receive_stats().get_num_lost();
+}
+
+void System::reset_message_stats()
+{
+    _mavlink_system->get_receive_stats().reset();
+}
+
 void System::add_new_component(uint8_t component_id)
 {
     return _mavlink_system->add_new_component(component_id);
 }
 
-void System::process_mavlink_message(const mavlink_message_t &message)
+void System::process_mavlink_message(const mavlink_message_t &message,
+                                     const dl_time_t &receive_time)
 {
-    return _mavlink_system->process_mavlink_message(message);
+    return _mavlink_system->process_mavlink_message(message, receive_time);
 }
 
 void System::set_system_id(uint8_t system_id)
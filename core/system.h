@@ -2,6 +2,9 @@
 
 #include "global_include.h"
 #include "mavlink_include.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 namespace dronecore {
 
@@ -62,6 +65,41 @@ public:
      */
     bool has_gimbal() const;
 
+    /**
+     * @brief Receive statistics of one MAVLink message ID.
+     */
+    struct MessageStats {
+        uint32_t message_id; /**< @brief MAVLink message ID. */
+        uint64_t count; /**< @brief Number of messages received. */
+        uint64_t bytes; /**< @brief Bytes received, including the MAVLink framing. */
+        double average_interval_s; /**< @brief Smoothed time between messages. */
+        double max_gap_s; /**< @brief Longest time between two messages. */
+    };
+
+    /**
+     * @brief Get receive statistics for every message ID received from this system.
+     *
+     * This can be used to check if requested message rates took effect, and how
+     * regularly the messages arrive.
+     *
+     * @return Statistics sorted by message ID.
+     */
+    std::vector<MessageStats> get_message_stats() const;
+
+    /**
+     * @brief Get the number of messages lost from this system.
+     *
+     * Losses are detected from gaps in the MAVLink sequence numbers.
+     *
+     * @return Number of messages lost since connecting.
+     */
+    uint64_t get_num_messages_lost() const;
+
+    /**
+     * @brief Reset the statistics returned by get_message_stats() and get_num_messages_lost().
+     */
+    void reset_message_stats();
+
 
     // Non-copyable
     /**
@@ -77,7 +115,7 @@ public:
 private:
 
     void add_new_component(uint8_t component_id);
-    void process_mavlink_message(const mavlink_message_t &message);
+    void process_mavlink_message(const mavlink_message_t &message, const dl_time_t &receive_time);
     void set_system_id(uint8_t system_id);
     bool is_connected() const;
     uint64_t get_uuid() const;
@@ -0,0 +1,62 @@
+#include "system_directory.h"
+
+namespace dronecore {
+
+SystemDirectory::SystemDirectory(const std::vector<Entry> &entries)
+{
+    _systems.reserve(entries.size());
+    for (const auto &entry : entries) {
+        _systems.push_back(entry.system);
+        if (entry.uuid != 0) {
+            _uuids.push_back(entry.uuid);
+        }
+    }
+
+    if (_uuids.empty()) {
+        return;
+    }
+
+    size_t num_slots = 4;
+    while (num_slots < 2 * _uuids.size()) {
+        num_slots *= 2;
+    }
+    _slots.assign(num_slots, Entry {0, nullptr});
+    _mask = num_slots - 1;
+
+    for (const auto &entry : entries) {
+        if (entry.uuid == 0) {
+            continue;
+        }
+        size_t index = hash(entry.uuid) & _mask;
+        while (_slots[index].uuid != 0 && _slots[index].uuid != entry.uuid) {
+            index = (index + 1) & _mask;
+        }
+        if (_slots[index].uuid == 0) {
+            _slots[index] = entry;
+        }
+    }
+}
+
+System *SystemDirectory::find(uint64_t uuid) const
+{
+    if (uuid == 0 || _slots.empty()) {
+        return nullptr;
+    }
+
+    for (size_t index = hash(uuid) & _mask; _slots[index].uuid != 0;
+         index = (index + 1) & _mask) {
+        if (_slots[index].uuid == uuid) {
+            return _slots[index].system;
+        }
+    }
+    return nullptr;
+}
+
+size_t SystemDirectory::hash(uint64_t uuid)
+{
+    // UUIDs made from system IDs are small, so the high bits need mixing in.
+    const uint64_t mixed = (uuid ^ (uuid >> 33)) * 0xff51afd7ed558ccdULL;
+    return size_t(mixed ^ (mixed >> 33));
+}
+
+} // namespace dronecore
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dronecore {
+
+class System;
+
+// Snapshot of the systems for the lookups of the application, by UUID and as
+// a list. It is never changed once built, so it can be read from any thread
+// without locking and without allocating, while messages are routed. A new
+// one is built and published whenever a system is added or its UUID changes.
+//
+// The systems are owned elsewhere and outlive every snapshot.
+class SystemDirectory
+{
+public:
+    struct Entry {
+        uint64_t uuid; // 0 while not known yet
+        System *system;
+    };
+
+    SystemDirectory() = default;
+    // In the order of the system IDs, the first of several with the same UUID is found.
+    explicit SystemDirectory(const std::vector<Entry> &entries);
+
+    // nullptr if there is no system with this UUID, or for UUID 0.
+    System *find(uint64_t uuid) const;
+
+    // All systems, also those without UUID.
+    size_t size() const { return _systems.size(); }
+    System *system(size_t index) const { return _systems[index]; }
+
+    // The UUIDs known so far, in the order of the system IDs.
+    const std::vector<uint64_t> &uuids() const { return _uuids; }
+
+private:
+    static size_t hash(uint64_t uuid);
+
+    std::vector<System *> _systems {};
+    std::vector<uint64_t> _uuids {};
+    // Open addressing with linear probing, at most half full. An empty slot
+    // has UUID 0, which never gets in.
+    std::vector<Entry> _slots {};
+    size_t _mask {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,62 @@
+#include "system_directory.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+namespace {
+
+// Only compared, never used.
+char storage[300];
+
+System *fake_system(size_t index)
+{
+    return reinterpret_cast<System *>(&storage[index]);
+}
+
+} // namespace
+
+TEST(SystemDirectory, Empty)
+{
+    const SystemDirectory directory;
+    EXPECT_EQ(directory.size(), 0u);
+    EXPECT_TRUE(directory.uuids().empty());
+    EXPECT_EQ(directory.find(42), nullptr);
+    EXPECT_EQ(directory.find(0), nullptr);
+}
+
+TEST(SystemDirectory, FindsByUuid)
+{
+    const SystemDirectory directory({
+        {0x1234567890abcdefULL, fake_system(0)},
+        {0, fake_system(1)},
+        {2, fake_system(2)},
+        {2, fake_system(3)},
+    });
+
+    EXPECT_EQ(directory.size(), 4u);
+    EXPECT_EQ(directory.system(1), fake_system(1));
+    EXPECT_EQ(directory.uuids(), (std::vector<uint64_t> {0x1234567890abcdefULL, 2, 2}));
+
+    EXPECT_EQ(directory.find(0x1234567890abcdefULL), fake_system(0));
+    // The first one with the same UUID, as when going through the list.
+    EXPECT_EQ(directory.find(2), fake_system(2));
+    EXPECT_EQ(directory.find(0), nullptr);
+    EXPECT_EQ(directory.find(3), nullptr);
+}
+
+TEST(SystemDirectory, FindsAllOfAFleet)
+{
+    std::vector<SystemDirectory::Entry> entries;
+    for (size_t i = 0; i < 255; ++i) {
+        // Both system IDs and real UUIDs, which only differ in the high bits.
+        const uint64_t uuid = (i % 2 == 0) ? i + 1 : (uint64_t(i) << 40) | 1;
+        entries.push_back(SystemDirectory::Entry {uuid, fake_system(i)});
+    }
+    const SystemDirectory directory(entries);
+
+    for (const auto &entry : entries) {
+        EXPECT_EQ(directory.find(entry.uuid), entry.system) << entry.uuid;
+    }
+    EXPECT_EQ(directory.find(uint64_t(1) << 40), nullptr);
+    EXPECT_EQ(directory.find(1000), nullptr);
+}
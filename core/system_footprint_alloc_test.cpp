@@ -0,0 +1,82 @@
+#include "allocation_counter.h"
+#include "connection.h"
+#include "dronecore_impl.h"
+#include <gtest/gtest.h>
+#include <string>
+#if defined(LINUX)
+#include <dirent.h>
+#endif
+
+using namespace dronecore;
+
+namespace {
+
+// Messages are handed to DroneCoreImpl directly, what is sent is swallowed.
+class NullConnection : public Connection
+{
+public:
+    explicit NullConnection(DroneCoreImpl &parent) : Connection(parent) {}
+
+    ConnectionResult start() override { return ConnectionResult::SUCCESS; }
+    ConnectionResult stop() override { return ConnectionResult::SUCCESS; }
+    bool is_ok() const override { return true; }
+    bool send_message(const mavlink_message_t &) override { return true; }
+
+protected:
+    bool write_buffer(const uint8_t *, size_t) override { return true; }
+};
+
+constexpr unsigned NUM_SYSTEMS = 200;
+
+#if defined(LINUX)
+unsigned count_threads()
+{
+    unsigned num_threads = 0;
+    DIR *dir = opendir("/proc/self/task");
+    if (dir == nullptr) {
+        return 0;
+    }
+    while (dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            ++num_threads;
+        }
+    }
+    closedir(dir);
+    return num_threads;
+}
+#endif
+
+} // namespace
+
+// Systems only get created with what every system needs, the rest like params,
+// FTP and the plugins only once they are used. Also they share the threads.
+TEST(SystemFootprint, ManySystems)
+{
+    DroneCoreImpl dc;
+    NullConnection connection(dc);
+
+#if defined(LINUX)
+    const unsigned num_threads_before = count_threads();
+#endif
+
+    size_t num_bytes = 0;
+    {
+        AllocationCounter counter;
+        for (unsigned i = 0; i < NUM_SYSTEMS; ++i) {
+            mavlink_message_t message;
+            mavlink_msg_heartbeat_pack(uint8_t(i + 1), MAV_COMP_ID_AUTOPILOT1, &message,
+                                       MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+            dc.receive_message(message, connection, std::chrono::steady_clock::now());
+        }
+        num_bytes = counter.get_bytes();
+    }
+
+    const size_t bytes_per_system = num_bytes / NUM_SYSTEMS;
+    RecordProperty("bytes_per_system", std::to_string(bytes_per_system));
+    EXPECT_LT(bytes_per_system, 64u * 1024u);
+
+#if defined(LINUX)
+    // The shared threads already exist, nothing is started per system.
+    EXPECT_LT(count_threads(), num_threads_before + 4);
+#endif
+}
@@ -0,0 +1,156 @@
+#include "system_scheduler.h"
+#include "thread_setup.h"
+#include "virtual_clock.h"
+
+namespace dronecore {
+
+SystemScheduler::SystemScheduler()
+{
+    _thread = new std::thread(scheduler_thread, this);
+}
+
+SystemScheduler::~SystemScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+    }
+    _cv.notify_one();
+
+    _thread->join();
+    delete _thread;
+    _thread = nullptr;
+
+    VirtualClock::clear_deadline(this);
+}
+
+void SystemScheduler::add(const void *key, const work_t &work)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries[key] = Entry {work, now(), false};
+        ++_generation;
+    }
+    VirtualClock::touch();
+    _cv.notify_one();
+}
+
+void SystemScheduler::remove(const void *key)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if (std::this_thread::get_id() == _thread->get_id()) {
+        // From within the work itself, it is removed once that returns.
+        if (_running == key) {
+            _remove_running = true;
+            return;
+        }
+    } else {
+        _done_cv.wait(lock, [this, key]() { return _running != key; });
+    }
+    _entries.erase(key);
+}
+
+void SystemScheduler::wake(const void *key)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        if (it == _entries.end()) {
+            return;
+        }
+        it->second.woken = true;
+        it->second.due = now();
+        ++_generation;
+    }
+    VirtualClock::touch();
+    _cv.notify_one();
+}
+
+void SystemScheduler::set_timer_slack(double slack_s)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _timer_slack = std::chrono::duration_cast<clock_t::duration>(
+                           std::chrono::duration<double>(slack_s > 0.0 ? slack_s : 0.0));
+    }
+    _cv.notify_one();
+}
+
+void SystemScheduler::scheduler_thread(SystemScheduler *self)
+{
+    setup_thread(ThreadRole::System, "system");
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+    while (!self->_should_exit) {
+        auto next = self->_entries.end();
+        for (auto it = self->_entries.begin(); it != self->_entries.end(); ++it) {
+            if (next == self->_entries.end() || it->second.due < next->second.due) {
+                next = it;
+            }
+        }
+
+        if (next == self->_entries.end()) {
+            self->_cv.wait(lock);
+            self->_num_wakeups.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        if (next->second.due > self->now() && VirtualClock::is_enabled()) {
+            // Without slack, timers all land on the virtual times they asked for.
+            const clock_t::time_point due = next->second.due;
+            const uint64_t generation = self->_generation;
+            lock.unlock();
+            VirtualClock::set_deadline(self, due, [self]() { self->_cv.notify_one(); });
+            lock.lock();
+            self->_cv.wait(lock, [self, due, generation]() {
+                return self->_should_exit || self->_generation != generation ||
+                       !VirtualClock::is_enabled() || self->now() >= due;
+            });
+            self->_num_wakeups.fetch_add(1, std::memory_order_relaxed);
+            // Set again if there still is something to wait for, an empty
+            // scheduler doesn't hold the clock at its last entry.
+            lock.unlock();
+            VirtualClock::clear_deadline(self);
+            lock.lock();
+            continue;
+        }
+        if (next->second.due > self->now()) {
+            // Something might get added or woken in the meantime. Once awake,
+            // everything else due by then is run as well.
+            self->_cv.wait_until(lock, next->second.woken ? next->second.due :
+                                 next->second.due + self->_timer_slack);
+            self->_num_wakeups.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const void *key = next->first;
+        Entry &entry = next->second;
+        entry.woken = false;
+        self->_running = key;
+
+        // Entries are only removed while not running, so the reference stays valid.
+        lock.unlock();
+        const double wait_s = entry.work();
+        VirtualClock::touch();
+        lock.lock();
+
+        self->_running = nullptr;
+        self->_done_cv.notify_all();
+
+        if (self->_remove_running) {
+            self->_remove_running = false;
+            self->_entries.erase(key);
+        } else if (!entry.woken) {
+            // Unless woken up while running, then there is more to do right away.
+            entry.due = self->now() + std::chrono::duration_cast<clock_t::duration>(
+                            std::chrono::duration<double>(wait_s > 0.0 ? wait_s : 0.0));
+        }
+    }
+}
+
+SystemScheduler::clock_t::time_point SystemScheduler::now()
+{
+    return VirtualClock::is_enabled() ? _time.steady_time() : clock_t::now();
+}
+
+} // namespace dronecore
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "global_include.h"
+
+namespace dronecore {
+
+// Runs the periodic work of all systems (heartbeats, timeouts, queued commands
+// and params) on one thread, instead of a thread per system. The work returns
+// how long until it wants to run again, and can be woken up earlier when new
+// work is queued.
+//
+// With the VirtualClock enabled, due times are on the virtual clock, and the
+// thread waits for that to get there instead of for the real time.
+class SystemScheduler
+{
+public:
+    // Returns the seconds until it is due again.
+    typedef std::function<double()> work_t;
+
+    SystemScheduler();
+    ~SystemScheduler();
+
+    // The work is due right away.
+    void add(const void *key, const work_t &work);
+    // Once this returns the work isn't running anymore and won't be called again.
+    void remove(const void *key);
+    void wake(const void *key);
+
+    // Work is run up to this much later than it asked for, so work of several
+    // systems due around the same time runs on one wakeup of the thread. Woken
+    // work still runs right away. 0 by default.
+    void set_timer_slack(double slack_s);
+
+    // How often the thread woke up, for timers or woken work.
+    uint64_t num_wakeups() const { return _num_wakeups.load(std::memory_order_relaxed); }
+
+    // Non-copyable
+    SystemScheduler(const SystemScheduler &) = delete;
+    const SystemScheduler &operator=(const SystemScheduler &) = delete;
+
+private:
+    typedef std::chrono::steady_clock clock_t;
+
+    struct Entry {
+        work_t work;
+        clock_t::time_point due;
+        bool woken;
+    };
+
+    static void scheduler_thread(SystemScheduler *self);
+    clock_t::time_point now();
+
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+    std::condition_variable _done_cv {};
+    std::map<const void *, Entry> _entries {};
+    const void *_running {nullptr};
+    bool _remove_running {false};
+    bool _should_exit {false};
+    clock_t::duration _timer_slack {0};
+    std::atomic<uint64_t> _num_wakeups {0};
+    // One more for every add or wake, to not miss them while setting a
+    // deadline with the VirtualClock.
+    uint64_t _generation {0};
+    Time _time {};
+
+    std::thread *_thread {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,147 @@
+#include "system_scheduler.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace dronecore;
+
+TEST(SystemScheduler, RunsWorkWhenDue)
+{
+    SystemScheduler scheduler;
+    std::atomic<int> num_runs {0};
+
+    int key;
+    scheduler.add(&key, [&num_runs]() {
+        ++num_runs;
+        return 0.05;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    scheduler.remove(&key);
+
+    // Right away, then every 50 ms.
+    EXPECT_GE(num_runs, 2);
+    EXPECT_LE(num_runs, 4);
+
+    const int num_runs_removed = num_runs;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(num_runs, num_runs_removed);
+}
+
+TEST(SystemScheduler, RunsWokenWorkEarly)
+{
+    SystemScheduler scheduler;
+    std::atomic<int> num_runs {0};
+
+    int key;
+    scheduler.add(&key, [&num_runs]() {
+        ++num_runs;
+        return 10.0;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(num_runs, 1);
+
+    scheduler.wake(&key);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(num_runs, 2);
+
+    scheduler.remove(&key);
+}
+
+TEST(SystemScheduler, RunsManySystemsOnOneThread)
+{
+    SystemScheduler scheduler;
+    static constexpr int NUM_SYSTEMS = 200;
+    int keys[NUM_SYSTEMS];
+    std::atomic<int> num_runs {0};
+    std::atomic<bool> same_thread {true};
+    std::thread::id scheduler_thread_id {};
+    std::mutex mutex;
+
+    for (auto &key : keys) {
+        scheduler.add(&key, [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (scheduler_thread_id == std::thread::id()) {
+                scheduler_thread_id = std::this_thread::get_id();
+            } else if (scheduler_thread_id != std::this_thread::get_id()) {
+                same_thread = false;
+            }
+            ++num_runs;
+            return 1.0;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    for (auto &key : keys) {
+        scheduler.remove(&key);
+    }
+
+    EXPECT_EQ(num_runs, NUM_SYSTEMS);
+    EXPECT_TRUE(same_thread);
+}
+
+TEST(SystemScheduler, RemoveWaitsForRunningWork)
+{
+    SystemScheduler scheduler;
+    std::atomic<bool> running {false};
+    std::atomic<bool> finished {false};
+
+    int key;
+    scheduler.add(&key, [&running, &finished]() {
+        running = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        finished = true;
+        return 1.0;
+    });
+
+    while (!running) {
+        std::this_thread::yield();
+    }
+    scheduler.remove(&key);
+    EXPECT_TRUE(finished);
+}
+
+TEST(SystemScheduler, WorkCanRemoveItself)
+{
+    SystemScheduler scheduler;
+    std::atomic<int> num_runs {0};
+
+    int key;
+    scheduler.add(&key, [&scheduler, &key, &num_runs]() {
+        ++num_runs;
+        scheduler.remove(&key);
+        return 0.0;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(num_runs, 1);
+}
+
+TEST(SystemScheduler, TimerSlackRunsWorkDueTogether)
+{
+    SystemScheduler scheduler;
+    scheduler.set_timer_slack(0.1);
+    std::atomic<int> num_runs {0};
+
+    // Due 20 ms apart, so without slack every run would be a wakeup of its own.
+    int keys[2];
+    scheduler.add(&keys[0], [&num_runs]() {
+        ++num_runs;
+        return 0.05;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    scheduler.add(&keys[1], [&num_runs]() {
+        ++num_runs;
+        return 0.05;
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    scheduler.remove(&keys[0]);
+    scheduler.remove(&keys[1]);
+
+    // Every 150 ms instead of 50 ms, both on the same wakeup.
+    EXPECT_GE(num_runs, 6);
+    EXPECT_LE(num_runs, 12);
+    EXPECT_LE(scheduler.num_wakeups(), uint64_t(num_runs / 2 + 2));
+}
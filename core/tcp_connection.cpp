@@ -1,18 +1,22 @@
 #include "tcp_connection.h"
 #include "global_include.h"
 #include "log.h"
+#include "thread_setup.h"
 
 #ifndef WINDOWS
 #include <netinet/in.h>
+#include <netinet/tcp.h> // for TCP_NODELAY
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h> // for close()
 #else
 #pragma comment(lib, "Ws2_32.lib") // Without this, Ws2_32.lib is not included in static library.
 #endif
 
-#include <cassert>
+#include <algorithm>
 
 #ifndef WINDOWS
 #define GET_ERROR(_x) strerror(_x)
@@ -43,9 +47,7 @@ bool TcpConnection::is_ok() const
 
 ConnectionResult TcpConnection::start()
 {
-    if (!start_mavlink_receiver()) {
-        return ConnectionResult::CONNECTIONS_EXHAUSTED;
-    }
+    start_mavlink_receiver();
 
     ConnectionResult ret = setup_port();
     if (ret != ConnectionResult::SUCCESS) {
@@ -54,6 +56,14 @@ ConnectionResult TcpConnection::start()
 
     start_recv_thread();
 
+    start_send_batcher([this](const uint8_t *data, size_t len) {
+        return write_buffer(data, len);
+    });
+
+    start_tx_scheduler([this](const mavlink_message_t &message) {
+        return transmit(message);
+    });
+
     return ConnectionResult::SUCCESS;
 }
 
@@ -69,50 +79,229 @@ ConnectionResult TcpConnection::setup_port()
     }
 #endif
 
-    _socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
 
-    if (_socket_fd < 0) {
+    if (socket_fd < 0) {
         LogErr() << "socket error" << GET_ERROR(errno);
         _is_ok = false;
         return ConnectionResult::SOCKET_ERROR;
     }
 
+    configure_socket(socket_fd);
+
     struct sockaddr_in remote_addr {};
     remote_addr.sin_family = AF_INET;
     remote_addr.sin_port = htons(_remote_port_number);
     remote_addr.sin_addr.s_addr = inet_addr(_remote_ip.c_str());
 
-    if (connect(_socket_fd, reinterpret_cast<sockaddr *>(&remote_addr),
-                sizeof(struct sockaddr_in)) < 0) {
-        LogErr() << "connect error: " << GET_ERROR(errno);
+    if (!connect_socket(socket_fd, remote_addr)) {
+        close_socket(socket_fd);
         _is_ok = false;
         return ConnectionResult::SOCKET_CONNECTION_ERROR;
     }
 
-    _is_ok = true;
+    std::lock_guard<std::mutex> send_lock(_send_mutex);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_should_exit) {
+            close_socket(socket_fd);
+            return ConnectionResult::SOCKET_CONNECTION_ERROR;
+        }
+        _socket_fd = socket_fd;
+        _is_ok = true;
+    }
+
+    // Whatever was sent while we were disconnected goes out first.
+    flush_queued_writes();
+
     return ConnectionResult::SUCCESS;
 }
 
-void TcpConnection::start_recv_thread()
+void TcpConnection::configure_socket(int socket_fd)
 {
-    _recv_thread = new std::thread(receive, this);
+    // MAVLink frames are small and latency matters more than throughput.
+    int nodelay = 1;
+    if (setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY,
+                   reinterpret_cast<const char *>(&nodelay), sizeof(nodelay)) != 0) {
+        LogWarn() << "setsockopt TCP_NODELAY error: " << GET_ERROR(errno);
+    }
+
+    if (_send_buffer_size > 0 &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF,
+                   reinterpret_cast<const char *>(&_send_buffer_size),
+                   sizeof(_send_buffer_size)) != 0) {
+        LogWarn() << "setsockopt SO_SNDBUF error: " << GET_ERROR(errno);
+    }
+
+    if (_receive_buffer_size > 0 &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF,
+                   reinterpret_cast<const char *>(&_receive_buffer_size),
+                   sizeof(_receive_buffer_size)) != 0) {
+        LogWarn() << "setsockopt SO_RCVBUF error: " << GET_ERROR(errno);
+    }
+
+#ifndef WINDOWS
+    // One stream can't be split into classes, and it is what control goes over.
+    const int tos = get_tos(TxScheduler::Priority::CONTROL);
+    if (_socket_options.qos &&
+        setsockopt(socket_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0) {
+        LogWarn() << "setsockopt IP_TOS error: " << GET_ERROR(errno);
+    }
+#endif
 }
 
-ConnectionResult TcpConnection::stop()
+bool TcpConnection::connect_socket(int socket_fd, const struct sockaddr_in &remote_addr)
 {
-    _should_exit = true;
+#ifndef WINDOWS
+    // Connect non-blocking so that an unreachable host can't hang us for the
+    // whole TCP connect timeout.
+    const int flags = fcntl(socket_fd, F_GETFL, 0);
+    fcntl(socket_fd, F_SETFL, flags | O_NONBLOCK);
+
+    int ret = connect(socket_fd, reinterpret_cast<const sockaddr *>(&remote_addr),
+                      sizeof(struct sockaddr_in));
+
+    if (ret < 0 && errno == EINPROGRESS) {
+        struct pollfd fds[1] {};
+        fds[0].fd = socket_fd;
+        fds[0].events = POLLOUT;
+
+        ret = poll(fds, 1, int(CONNECT_TIMEOUT_S * 1000));
+        if (ret == 0) {
+            LogErr() << "connect error: timeout";
+            return false;
+        }
+        if (ret > 0) {
+            int error = 0;
+            socklen_t error_len = sizeof(error);
+            getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &error, &error_len);
+            errno = error;
+            ret = (error == 0) ? 0 : -1;
+        }
+    }
+
+    if (ret < 0) {
+        LogErr() << "connect error: " << GET_ERROR(errno);
+        return false;
+    }
+
+    // Back to blocking for the receive thread.
+    fcntl(socket_fd, F_SETFL, flags);
+    return true;
+#else
+    if (connect(socket_fd, reinterpret_cast<const sockaddr *>(&remote_addr),
+                sizeof(struct sockaddr_in)) < 0) {
+        LogErr() << "connect error: " << GET_ERROR(errno);
+        return false;
+    }
+    return true;
+#endif
+}
 
+void TcpConnection::shutdown_socket(int socket_fd)
+{
+    if (socket_fd < 0) {
+        return;
+    }
 #ifndef WINDOWS
     // This should interrupt a recv/recvfrom call.
-    shutdown(_socket_fd, SHUT_RDWR);
+    shutdown(socket_fd, SHUT_RDWR);
+#else
+    shutdown(socket_fd, SD_BOTH);
+#endif
+}
 
+void TcpConnection::close_socket(int socket_fd)
+{
+    if (socket_fd < 0) {
+        return;
+    }
+    shutdown_socket(socket_fd);
+#ifndef WINDOWS
     // But on Mac, closing is also needed to stop blocking recv/recvfrom.
-    close(_socket_fd);
+    close(socket_fd);
 #else
-    shutdown(_socket_fd, SD_BOTH);
+    closesocket(socket_fd);
+#endif
+}
+
+void TcpConnection::close_socket_once_unused()
+{
+    {
+        // Gets a send which is stuck on it to return.
+        std::lock_guard<std::mutex> lock(_mutex);
+        shutdown_socket(_socket_fd);
+    }
+
+    std::lock_guard<std::mutex> send_lock(_send_mutex);
+    std::lock_guard<std::mutex> lock(_mutex);
+    close_socket(_socket_fd);
+    _socket_fd = -1;
+}
+
+void TcpConnection::reconnect()
+{
+    double backoff_s = MIN_RECONNECT_BACKOFF_S;
+
+    close_socket_once_unused();
+
+    while (!_should_exit) {
+        {
+            // Wait, but let stop() interrupt us.
+            std::unique_lock<std::mutex> lock(_mutex);
+            _reconnect_cv.wait_for(lock, std::chrono::duration<double>(backoff_s),
+            [this]() { return _should_exit.load(); });
+        }
+
+        if (_should_exit) {
+            return;
+        }
+
+        if (setup_port() == ConnectionResult::SUCCESS) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_stats.reconnects;
+            LogInfo() << "TCP reconnected";
+            return;
+        }
 
-    closesocket(_socket_fd);
+        backoff_s = std::min(backoff_s * 2.0, MAX_RECONNECT_BACKOFF_S);
+    }
+}
+
+void TcpConnection::start_recv_thread()
+{
+    _recv_thread = new std::thread(receive, this);
+}
+
+void TcpConnection::request_stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+#ifndef WINDOWS
+        // Interrupts a blocking recv, sending still works.
+        if (_socket_fd >= 0) {
+            shutdown(_socket_fd, SHUT_RD);
+        }
+#endif
+    }
+    _reconnect_cv.notify_all();
+}
+
+ConnectionResult TcpConnection::stop()
+{
+    // Get the queued and batched messages out while the socket is still open.
+    stop_tx_scheduler();
+    stop_send_batcher();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+    }
+    _reconnect_cv.notify_all();
+    close_socket_once_unused();
 
+#ifdef WINDOWS
     WSACleanup();
 #endif
 
@@ -131,42 +320,135 @@ ConnectionResult TcpConnection::stop()
 
 bool TcpConnection::send_message(const mavlink_message_t &message)
 {
-    if (_remote_ip.empty()) {
-        LogErr() << "Remote IP unknown";
-        return false;
+    if (_tx_scheduler) {
+        return _tx_scheduler->push(message);
     }
+    return transmit(message);
+}
 
-    if (_remote_port_number == 0) {
-        LogErr() << "Remote port unknown";
-        return false;
+bool TcpConnection::transmit(const mavlink_message_t &message)
+{
+    count_frame_sent(message);
+    return write_message(message);
+}
+
+bool TcpConnection::write_buffer(const uint8_t *buffer, size_t buffer_len)
+{
+    std::lock_guard<std::mutex> send_lock(_send_mutex);
+
+    int socket_fd;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_is_ok) {
+            // Keep it until we are reconnected, so a short outage doesn't lose anything.
+            queue_write(buffer, buffer_len);
+            return true;
+        }
+        socket_fd = _socket_fd;
+    }
+
+    const size_t sent = send_all(socket_fd, buffer, buffer_len);
+    // The receive thread notices and reconnects, the rest goes out afterwards.
+    finish_send(buffer, buffer_len, sent);
+    return true;
+}
+
+size_t TcpConnection::send_all(int socket_fd, const uint8_t *buffer, size_t buffer_len)
+{
+#if defined(LINUX)
+    // Don't get killed by SIGPIPE if the other side went away.
+    const int flags = MSG_NOSIGNAL;
+#else
+    const int flags = 0;
+#endif
+
+    size_t sent = 0;
+    while (sent < buffer_len) {
+        int send_len = send(socket_fd, reinterpret_cast<const char *>(buffer + sent),
+                            buffer_len - sent, flags);
+        if (send_len <= 0) {
+            LogErr() << "send failure: " << GET_ERROR(errno);
+            break;
+        }
+        sent += size_t(send_len);
     }
+    return sent;
+}
 
-    struct sockaddr_in dest_addr {};
-    dest_addr.sin_family = AF_INET;
+bool TcpConnection::finish_send(const uint8_t *buffer, size_t buffer_len, size_t sent)
+{
+    count_bytes_sent(sent);
 
-    inet_pton(AF_INET, _remote_ip.c_str(), &dest_addr.sin_addr.s_addr);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stats.bytes_sent += sent;
 
-    dest_addr.sin_port = htons(_remote_port_number);
+    if (sent == buffer_len) {
+        return true;
+    }
 
-    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
-    uint16_t buffer_len = mavlink_msg_to_send_buffer(buffer, &message);
+    _is_ok = false;
+    // What went out already must not be sent again.
+    queue_write(buffer + sent, buffer_len - sent);
+    return false;
+}
 
-    // TODO: remove this assert again
-    assert(buffer_len <= MAVLINK_MAX_PACKET_LEN);
+void TcpConnection::queue_write(const uint8_t *buffer, size_t buffer_len)
+{
+    // Make room by dropping the oldest writes, the newest setpoints matter most.
+    while (!_queued_writes.empty() && _stats.bytes_queued + buffer_len > MAX_QUEUED_BYTES) {
+        _stats.bytes_queued -= _queued_writes.front().size();
+        _queued_writes.pop_front();
+        ++_stats.writes_dropped;
+    }
 
-    int send_len = sendto(_socket_fd, reinterpret_cast<char *>(buffer), buffer_len, 0,
-                          reinterpret_cast<const sockaddr *>(&dest_addr), sizeof(dest_addr));
+    if (buffer_len > MAX_QUEUED_BYTES) {
+        ++_stats.writes_dropped;
+        return;
+    }
 
-    if (send_len != buffer_len) {
-        LogErr() << "sendto failure: " << GET_ERROR(errno);
-        _is_ok = false;
-        return false;
+    _queued_writes.emplace_back(buffer, buffer + buffer_len);
+    _stats.bytes_queued += buffer_len;
+}
+
+void TcpConnection::flush_queued_writes()
+{
+    while (true) {
+        std::vector<uint8_t> write {};
+        int socket_fd;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_queued_writes.empty() || !_is_ok) {
+                return;
+            }
+            write = std::move(_queued_writes.front());
+            _queued_writes.pop_front();
+            _stats.bytes_queued -= write.size();
+            socket_fd = _socket_fd;
+        }
+
+        const size_t sent = send_all(socket_fd, write.data(), write.size());
+        if (!finish_send(write.data(), write.size(), sent)) {
+            return;
+        }
     }
-    return true;
+}
+
+void TcpConnection::set_socket_buffer_sizes(int send_buffer_size, int receive_buffer_size)
+{
+    _send_buffer_size = send_buffer_size;
+    _receive_buffer_size = receive_buffer_size;
+}
+
+TcpConnection::Stats TcpConnection::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
 }
 
 void TcpConnection::receive(TcpConnection *parent)
 {
+    setup_thread(ThreadRole::Io, "tcp_recv");
+
     // Enough for MTU 1500 bytes.
     char buffer[2048];
 
@@ -174,8 +456,9 @@ void TcpConnection::receive(TcpConnection *parent)
 
         if (!parent->_is_ok) {
             LogErr() << "TCP receive error, trying to reconnect...";
-            std::this_thread::sleep_for(std::chrono::seconds(1));
-            parent->setup_port();
+            // Sending keeps queueing meanwhile, so nobody else is blocked by this.
+            parent->reconnect();
+            continue;
         }
 
         int recv_len = recv(parent->_socket_fd, buffer, sizeof(buffer), 0);
@@ -183,6 +466,9 @@ void TcpConnection::receive(TcpConnection *parent)
         if (recv_len == 0) {
             // This can happen when shutdown is called on the socket,
             // therefore we check _should_exit again.
+            if (parent->_should_exit) {
+                break;
+            }
             parent->_is_ok = false;
             continue;
         }
@@ -196,6 +482,11 @@ void TcpConnection::receive(TcpConnection *parent)
             continue;
         }
 
+        {
+            std::lock_guard<std::mutex> lock(parent->_mutex);
+            parent->_stats.bytes_received += uint64_t(recv_len);
+        }
+
         parent->_mavlink_receiver->set_new_datagram(buffer, recv_len);
 
         // Parse all mavlink messages in one data packet. Once exhausted, we'll exit while.
@@ -2,6 +2,9 @@
 
 #include <mutex>
 #include <atomic>
+#include <deque>
+#include <vector>
+#include <condition_variable>
 #include "connection.h"
 #include <sys/types.h>
 #ifndef WINDOWS
@@ -25,25 +28,78 @@ public:
     bool is_ok() const;
     ConnectionResult start();
     ConnectionResult stop();
+    void request_stop() override;
 
     bool send_message(const mavlink_message_t &message);
 
+    // Needs to be set before start(), 0 keeps the system default.
+    void set_socket_buffer_sizes(int send_buffer_size, int receive_buffer_size);
+
+    struct Stats {
+        uint64_t bytes_sent;
+        uint64_t bytes_received;
+        uint64_t reconnects;
+        // Writes which didn't fit into the queue while disconnected.
+        uint64_t writes_dropped;
+        size_t bytes_queued;
+    };
+
+    Stats get_stats() const;
+
     // Non-copyable
     TcpConnection(const TcpConnection &) = delete;
     const TcpConnection &operator=(const TcpConnection &) = delete;
 
 private:
     ConnectionResult setup_port();
+    bool transmit(const mavlink_message_t &message);
+    bool write_buffer(const uint8_t *buffer, size_t buffer_len);
     void start_recv_thread();
     int resolve_address(const std::string &ip_address, int port, struct sockaddr_in *addr);
     static void receive(TcpConnection *parent);
 
+    void configure_socket(int socket_fd);
+    bool connect_socket(int socket_fd, const struct sockaddr_in &remote_addr);
+    void reconnect();
+    void close_socket_once_unused();
+    static void shutdown_socket(int socket_fd);
+    static void close_socket(int socket_fd);
+
+    // Returns how much got sent, less than buffer_len if the connection broke.
+    static size_t send_all(int socket_fd, const uint8_t *buffer, size_t buffer_len);
+
+    // Need to be called with _send_mutex locked but not _mutex.
+    void flush_queued_writes();
+    // Returns false if only part of it was sent, the rest is queued.
+    bool finish_send(const uint8_t *buffer, size_t buffer_len, size_t sent);
+
+    // Needs to be called with _mutex locked.
+    void queue_write(const uint8_t *buffer, size_t buffer_len);
+
+    static constexpr double CONNECT_TIMEOUT_S = 2.0;
+    static constexpr double MIN_RECONNECT_BACKOFF_S = 0.1;
+    static constexpr double MAX_RECONNECT_BACKOFF_S = 5.0;
+    // Enough for a few seconds of setpoints and heartbeats.
+    static constexpr size_t MAX_QUEUED_BYTES = 16 * 1024;
+
     std::string _remote_ip = {};
     int _remote_port_number;
 
-    std::mutex _mutex = {};
+    int _send_buffer_size = 0;
+    int _receive_buffer_size = 0;
+
+    // Serializes the writes and keeps the socket open while sending. The send
+    // can block, so it happens without _mutex. Locked before _mutex.
+    std::mutex _send_mutex = {};
+    // Protects the socket, the queue and the stats.
+    mutable std::mutex _mutex = {};
+    std::condition_variable _reconnect_cv = {};
     int _socket_fd = -1;
 
+    // Written once we are connected again.
+    std::deque<std::vector<uint8_t>> _queued_writes = {};
+    Stats _stats {0, 0, 0, 0, 0};
+
     std::thread *_recv_thread = nullptr;
     std::atomic_bool _should_exit;
     std::atomic_bool _is_ok {false};
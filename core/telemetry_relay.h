@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "dronecore.h"
+
+namespace dronecore {
+
+/**
+ * @brief Decodes the datagrams sent by DroneCore::start_telemetry_relay(), e.g. on a
+ * server which collects the state of vehicles from many field stations.
+ *
+ * Each datagram starts with a header in network byte order:
+ * - `uint32_t magic` (0x44435452, "DCTR").
+ * - `uint8_t version` (1).
+ * - `uint8_t flags`, bit 0 is set for keyframes.
+ * - `uint32_t sequence`, one more for every datagram.
+ * - `uint32_t body_size`, the size of the body before compression.
+ *
+ * The rest is the body compressed with zlib. The body has an entry for every system
+ * with a changed field: the `uint8_t` system ID, a `uint16_t` bit per changed field
+ * and the changed fields, in the order of DroneCore::FleetState, all in network byte
+ * order. Keyframes have all fields of all systems as they are. In any other datagram
+ * each field is XORed with its value in the datagram before, which leaves mostly zero
+ * bytes for zlib.
+ *
+ * Since every datagram builds on the one before, the decoder waits for a keyframe
+ * when it starts and after any datagram was lost.
+ */
+class TelemetryRelayDecoder
+{
+public:
+    /**
+     * @brief Constructor, waits for a keyframe.
+     */
+    TelemetryRelayDecoder();
+
+    /**
+     * @brief Destructor.
+     */
+    ~TelemetryRelayDecoder() = default;
+
+    /**
+     * @brief Possible results of decoding a datagram.
+     */
+    enum class Result {
+        OK, /**< @brief The state is updated. */
+        WAITING_FOR_KEYFRAME, /**< @brief Ignored until the next keyframe. */
+        INVALID /**< @brief Not a relay datagram, or corrupt. */
+    };
+
+    /**
+     * @brief Applies a datagram to the state.
+     *
+     * @param datagram The datagram as received.
+     * @param datagram_len Length of the datagram in bytes.
+     * @return Whether the state was updated.
+     */
+    Result decode(const void *datagram, size_t datagram_len);
+
+    /**
+     * @brief Copies the state of all systems, as of the last datagram decoded.
+     *
+     * @param state The columns, in the same form as DroneCore::get_fleet_state().
+     */
+    void get(DroneCore::FleetState &state) const;
+
+    /**
+     * @brief Whether a keyframe has been decoded and nothing lost since.
+     *
+     * @return true if the state is complete.
+     */
+    bool is_synced() const { return _synced; }
+
+    // Non-copyable
+    TelemetryRelayDecoder(const TelemetryRelayDecoder &) = delete;
+    const TelemetryRelayDecoder &operator=(const TelemetryRelayDecoder &) = delete;
+
+private:
+    // The raw bits of each field, per system ID.
+    std::vector<uint64_t> _fields;
+    uint64_t _present[256 / 64] {};
+    bool _synced {false};
+    uint32_t _next_sequence {0};
+    std::vector<uint8_t> _body {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,454 @@
+#include "telemetry_relay_feed.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_setup.h"
+
+#ifndef WINDOWS
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr uint32_t TelemetryRelayFormat::MAGIC;
+constexpr uint8_t TelemetryRelayFormat::VERSION;
+constexpr uint8_t TelemetryRelayFormat::FLAG_KEYFRAME;
+constexpr size_t TelemetryRelayFormat::HEADER_SIZE;
+constexpr unsigned TelemetryRelayFormat::NUM_SYSTEMS;
+constexpr unsigned TelemetryRelayFormat::NUM_FIELDS;
+
+namespace {
+
+constexpr uint16_t ALL_FIELDS = (1u << TelemetryRelayFormat::NUM_FIELDS) - 1;
+
+template <class T>
+void put_be(T &buffer, uint64_t value, size_t num_bytes)
+{
+    for (size_t i = 0; i < num_bytes; ++i) {
+        buffer.push_back(static_cast<typename T::value_type>(
+                             (value >> (8 * (num_bytes - 1 - i))) & 0xff));
+    }
+}
+
+uint64_t get_be(const uint8_t *bytes, size_t num_bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < num_bytes; ++i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+uint64_t double_bits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+uint64_t float_bits(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double bits_double(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+float bits_float(uint64_t bits)
+{
+    const uint32_t bits32 = static_cast<uint32_t>(bits);
+    float value;
+    std::memcpy(&value, &bits32, sizeof(value));
+    return value;
+}
+
+// The system ID and every field.
+size_t get_full_entry_size()
+{
+    size_t size = 1;
+    for (unsigned field = 0; field < TelemetryRelayFormat::NUM_FIELDS; ++field) {
+        size += TelemetryRelayFormat::get_field_size(field);
+    }
+    return size;
+}
+
+} // namespace
+
+size_t TelemetryRelayFormat::get_field_size(unsigned field)
+{
+    switch (field) {
+        case 0: // latitude_deg
+        case 1: // longitude_deg
+            return 8;
+        case 10: // base_mode
+            return 1;
+        default:
+            return 4;
+    }
+}
+
+void TelemetryRelayFormat::get_row(const DroneCore::FleetState &state, size_t index, Row &row)
+{
+    row.fields[0] = double_bits(state.latitude_deg[index]);
+    row.fields[1] = double_bits(state.longitude_deg[index]);
+    row.fields[2] = float_bits(state.absolute_altitude_m[index]);
+    row.fields[3] = float_bits(state.relative_altitude_m[index]);
+    row.fields[4] = float_bits(state.roll_deg[index]);
+    row.fields[5] = float_bits(state.pitch_deg[index]);
+    row.fields[6] = float_bits(state.yaw_deg[index]);
+    row.fields[7] = float_bits(state.battery_voltage_v[index]);
+    row.fields[8] = float_bits(state.battery_remaining_percent[index]);
+    row.fields[9] = state.custom_mode[index];
+    row.fields[10] = state.base_mode[index];
+}
+
+void TelemetryRelayFormat::append_row(uint8_t system_id, const Row &row,
+                                      DroneCore::FleetState &state)
+{
+    state.system_ids.push_back(system_id);
+    state.latitude_deg.push_back(bits_double(row.fields[0]));
+    state.longitude_deg.push_back(bits_double(row.fields[1]));
+    state.absolute_altitude_m.push_back(bits_float(row.fields[2]));
+    state.relative_altitude_m.push_back(bits_float(row.fields[3]));
+    state.roll_deg.push_back(bits_float(row.fields[4]));
+    state.pitch_deg.push_back(bits_float(row.fields[5]));
+    state.yaw_deg.push_back(bits_float(row.fields[6]));
+    state.battery_voltage_v.push_back(bits_float(row.fields[7]));
+    state.battery_remaining_percent.push_back(bits_float(row.fields[8]));
+    state.custom_mode.push_back(static_cast<uint32_t>(row.fields[9]));
+    state.base_mode.push_back(static_cast<uint8_t>(row.fields[10]));
+}
+
+TelemetryRelayEncoder::TelemetryRelayEncoder()
+{
+    std::memset(_last, 0, sizeof(_last));
+    std::fill(std::begin(_sent), std::end(_sent), false);
+}
+
+bool TelemetryRelayEncoder::encode(const DroneCore::FleetState &state, bool keyframe,
+                                   std::string &datagram, size_t &body_size)
+{
+    _body.clear();
+
+    TelemetryRelayFormat::Row row;
+    for (size_t i = 0; i < state.system_ids.size(); ++i) {
+        const uint8_t system_id = state.system_ids[i];
+        TelemetryRelayFormat::get_row(state, i, row);
+        const TelemetryRelayFormat::Row &last = _last[system_id];
+        // Systems new to the receiver get all fields as they are, like in a keyframe.
+        const bool is_delta = !keyframe && _sent[system_id];
+
+        uint16_t changed = ALL_FIELDS;
+        if (is_delta) {
+            changed = 0;
+            for (unsigned field = 0; field < TelemetryRelayFormat::NUM_FIELDS; ++field) {
+                if (row.fields[field] != last.fields[field]) {
+                    changed |= (1u << field);
+                }
+            }
+            if (changed == 0) {
+                continue;
+            }
+        }
+
+        put_be(_body, system_id, 1);
+        put_be(_body, changed, 2);
+        for (unsigned field = 0; field < TelemetryRelayFormat::NUM_FIELDS; ++field) {
+            if (changed & (1u << field)) {
+                const uint64_t value = is_delta ? (row.fields[field] ^ last.fields[field]) :
+                                       row.fields[field];
+                put_be(_body, value, TelemetryRelayFormat::get_field_size(field));
+            }
+        }
+
+        _last[system_id] = row;
+        _sent[system_id] = true;
+    }
+
+    if (!keyframe && _body.empty()) {
+        return false;
+    }
+
+    datagram.clear();
+    put_be(datagram, TelemetryRelayFormat::MAGIC, 4);
+    put_be(datagram, TelemetryRelayFormat::VERSION, 1);
+    put_be(datagram, keyframe ? TelemetryRelayFormat::FLAG_KEYFRAME : 0, 1);
+    put_be(datagram, _sequence++, 4);
+    put_be(datagram, _body.size(), 4);
+
+    uLongf compressed_len = compressBound(_body.size());
+    datagram.resize(TelemetryRelayFormat::HEADER_SIZE + compressed_len);
+    compress2(reinterpret_cast<Bytef *>(&datagram[TelemetryRelayFormat::HEADER_SIZE]),
+              &compressed_len, reinterpret_cast<const Bytef *>(_body.data()), _body.size(),
+              Z_BEST_COMPRESSION);
+    datagram.resize(TelemetryRelayFormat::HEADER_SIZE + compressed_len);
+
+    body_size = _body.size();
+    return true;
+}
+
+TelemetryRelayFeed::~TelemetryRelayFeed()
+{
+    stop();
+}
+
+bool TelemetryRelayFeed::start(const std::string &host, int port, double rate_hz,
+                               double keyframe_interval_s)
+{
+#ifndef WINDOWS
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_relay_thread != nullptr) {
+        LogErr() << "Telemetry relay already running";
+        return false;
+    }
+
+    in_addr addr;
+    if (inet_pton(AF_INET, host.c_str(), &addr) != 1 || port <= 0 || port > 65535 ||
+        !(rate_hz > 0.0) || !(keyframe_interval_s > 0.0)) {
+        LogErr() << "Invalid telemetry relay to " << host << ":" << port;
+        return false;
+    }
+
+    const int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (socket_fd < 0) {
+        LogErr() << "socket error: " << strerror(errno);
+        return false;
+    }
+
+    _should_exit = false;
+    _relay_thread = new std::thread(&TelemetryRelayFeed::relay_thread, this, socket_fd,
+                                    addr.s_addr, htons(static_cast<uint16_t>(port)),
+                                    rate_hz, keyframe_interval_s);
+    LogInfo() << "Relaying telemetry to " << host << ":" << port;
+    return true;
+#else
+    UNUSED(host);
+    UNUSED(port);
+    UNUSED(rate_hz);
+    UNUSED(keyframe_interval_s);
+    LogErr() << "Telemetry relay not supported on Windows";
+    return false;
+#endif
+}
+
+void TelemetryRelayFeed::stop()
+{
+    std::thread *relay_thread = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_relay_thread == nullptr) {
+            return;
+        }
+        _should_exit = true;
+        relay_thread = _relay_thread;
+        _relay_thread = nullptr;
+    }
+    _cv.notify_all();
+
+    relay_thread->join();
+    delete relay_thread;
+}
+
+DroneCore::TelemetryRelayStats TelemetryRelayFeed::get_stats() const
+{
+    DroneCore::TelemetryRelayStats stats;
+    stats.datagrams_sent = _datagrams_sent.load(std::memory_order_relaxed);
+    stats.keyframes_sent = _keyframes_sent.load(std::memory_order_relaxed);
+    stats.raw_bytes = _raw_bytes.load(std::memory_order_relaxed);
+    stats.bytes_sent = _bytes_sent.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TelemetryRelayFeed::relay_thread(int socket_fd, uint32_t ip, uint16_t port,
+                                      double rate_hz, double keyframe_interval_s)
+{
+#ifndef WINDOWS
+    setup_thread(ThreadRole::Background, "telemetry_relay");
+
+    sockaddr_in dest_addr {};
+    dest_addr.sin_family = AF_INET;
+    dest_addr.sin_addr.s_addr = ip;
+    dest_addr.sin_port = port;
+
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(1.0 / rate_hz));
+    const long keyframe_every = std::max(1L, std::lround(keyframe_interval_s * rate_hz));
+    const size_t full_entry_size = get_full_entry_size();
+
+    TelemetryRelayEncoder encoder;
+    DroneCore::FleetState state;
+    std::string datagram;
+    // The first one is a keyframe.
+    long since_keyframe = keyframe_every;
+    auto deadline = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_should_exit) {
+        lock.unlock();
+
+        _get_state(state);
+        const bool keyframe = (since_keyframe >= keyframe_every);
+        size_t body_size = 0;
+        if (encoder.encode(state, keyframe, datagram, body_size)) {
+            const auto sent = sendto(socket_fd, datagram.data(), datagram.size(), 0,
+                                     reinterpret_cast<const sockaddr *>(&dest_addr),
+                                     sizeof(dest_addr));
+            if (sent == static_cast<ssize_t>(datagram.size())) {
+                _datagrams_sent.fetch_add(1, std::memory_order_relaxed);
+                _bytes_sent.fetch_add(datagram.size(), std::memory_order_relaxed);
+                if (keyframe) {
+                    _keyframes_sent.fetch_add(1, std::memory_order_relaxed);
+                }
+            } else {
+                // The receiver waits for the next keyframe.
+                LogWarn() << "Telemetry relay sendto error: " << strerror(errno);
+            }
+        }
+        _raw_bytes.fetch_add(state.system_ids.size() * full_entry_size,
+                             std::memory_order_relaxed);
+        since_keyframe = keyframe ? 1 : since_keyframe + 1;
+
+        deadline += period;
+        lock.lock();
+        _cv.wait_until(lock, deadline, [this]() { return _should_exit; });
+    }
+    lock.unlock();
+
+    close(socket_fd);
+#else
+    UNUSED(socket_fd);
+    UNUSED(ip);
+    UNUSED(port);
+    UNUSED(rate_hz);
+    UNUSED(keyframe_interval_s);
+#endif
+}
+
+TelemetryRelayDecoder::TelemetryRelayDecoder() :
+    _fields(TelemetryRelayFormat::NUM_SYSTEMS * TelemetryRelayFormat::NUM_FIELDS, 0)
+{}
+
+TelemetryRelayDecoder::Result TelemetryRelayDecoder::decode(const void *datagram,
+                                                            size_t datagram_len)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(datagram);
+    if (datagram_len < TelemetryRelayFormat::HEADER_SIZE ||
+        get_be(bytes, 4) != TelemetryRelayFormat::MAGIC ||
+        bytes[4] != TelemetryRelayFormat::VERSION) {
+        return Result::INVALID;
+    }
+
+    const bool keyframe = (bytes[5] & TelemetryRelayFormat::FLAG_KEYFRAME) != 0;
+    const uint32_t sequence = static_cast<uint32_t>(get_be(bytes + 6, 4));
+    const uint64_t body_size = get_be(bytes + 10, 4);
+
+    if (!keyframe && (!_synced || sequence != _next_sequence)) {
+        _synced = false;
+        return Result::WAITING_FOR_KEYFRAME;
+    }
+
+    // Every system with every field, and the changed field bits.
+    if (body_size > TelemetryRelayFormat::NUM_SYSTEMS * (get_full_entry_size() + 2)) {
+        return Result::INVALID;
+    }
+    _body.resize(body_size);
+    uLongf body_len = body_size;
+    if (uncompress(_body.data(), &body_len, bytes + TelemetryRelayFormat::HEADER_SIZE,
+                   datagram_len - TelemetryRelayFormat::HEADER_SIZE) != Z_OK ||
+        body_len != body_size) {
+        return Result::INVALID;
+    }
+
+    // Checked as a whole first, so that a corrupt body leaves the state alone.
+    size_t offset = 0;
+    while (offset < _body.size()) {
+        if (offset + 3 > _body.size()) {
+            return Result::INVALID;
+        }
+        const uint16_t changed = static_cast<uint16_t>(get_be(&_body[offset + 1], 2));
+        offset += 3;
+        if ((changed & ~ALL_FIELDS) != 0) {
+            return Result::INVALID;
+        }
+        for (unsigned field = 0; field < TelemetryRelayFormat::NUM_FIELDS; ++field) {
+            if (changed & (1u << field)) {
+                offset += TelemetryRelayFormat::get_field_size(field);
+            }
+        }
+        if (offset > _body.size()) {
+            return Result::INVALID;
+        }
+    }
+
+    if (keyframe) {
+        std::fill(std::begin(_present), std::end(_present), 0);
+    }
+
+    offset = 0;
+    while (offset < _body.size()) {
+        const uint8_t system_id = _body[offset];
+        const uint16_t changed = static_cast<uint16_t>(get_be(&_body[offset + 1], 2));
+        offset += 3;
+
+        uint64_t *fields = &_fields[system_id * TelemetryRelayFormat::NUM_FIELDS];
+        const uint64_t bit = uint64_t(1) << (system_id % 64);
+        const bool is_delta = (_present[system_id / 64] & bit) != 0;
+        for (unsigned field = 0; field < TelemetryRelayFormat::NUM_FIELDS; ++field) {
+            if (changed & (1u << field)) {
+                const size_t field_size = TelemetryRelayFormat::get_field_size(field);
+                const uint64_t value = get_be(&_body[offset], field_size);
+                fields[field] = is_delta ? (fields[field] ^ value) : value;
+                offset += field_size;
+            }
+        }
+        _present[system_id / 64] |= bit;
+    }
+
+    _synced = true;
+    _next_sequence = sequence + 1;
+    return Result::OK;
+}
+
+void TelemetryRelayDecoder::get(DroneCore::FleetState &state) const
+{
+    state.system_ids.clear();
+    state.latitude_deg.clear();
+    state.longitude_deg.clear();
+    state.absolute_altitude_m.clear();
+    state.relative_altitude_m.clear();
+    state.roll_deg.clear();
+    state.pitch_deg.clear();
+    state.yaw_deg.clear();
+    state.battery_voltage_v.clear();
+    state.battery_remaining_percent.clear();
+    state.base_mode.clear();
+    state.custom_mode.clear();
+
+    TelemetryRelayFormat::Row row;
+    for (unsigned system_id = 0; system_id < TelemetryRelayFormat::NUM_SYSTEMS; ++system_id) {
+        if ((_present[system_id / 64] & (uint64_t(1) << (system_id % 64))) == 0) {
+            continue;
+        }
+        std::copy_n(&_fields[system_id * TelemetryRelayFormat::NUM_FIELDS],
+                    TelemetryRelayFormat::NUM_FIELDS, row.fields);
+        TelemetryRelayFormat::append_row(static_cast<uint8_t>(system_id), row, state);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "dronecore.h"
+#include "telemetry_relay.h"
+
+namespace dronecore {
+
+// The datagrams described in telemetry_relay.h.
+struct TelemetryRelayFormat {
+    static constexpr uint32_t MAGIC = 0x44435452;
+    static constexpr uint8_t VERSION = 1;
+    static constexpr uint8_t FLAG_KEYFRAME = 1;
+    static constexpr size_t HEADER_SIZE = 14;
+    static constexpr unsigned NUM_SYSTEMS = 256;
+    // In the order of DroneCore::FleetState.
+    static constexpr unsigned NUM_FIELDS = 11;
+
+    // A system by the raw bits of its fields, so that a NAN equals itself.
+    struct Row {
+        uint64_t fields[NUM_FIELDS];
+    };
+
+    static size_t get_field_size(unsigned field);
+    static void get_row(const DroneCore::FleetState &state, size_t index, Row &row);
+    static void append_row(uint8_t system_id, const Row &row, DroneCore::FleetState &state);
+};
+
+// Turns snapshots of the fleet state into datagrams with only what changed
+// since the one before, compressed with zlib.
+class TelemetryRelayEncoder
+{
+public:
+    TelemetryRelayEncoder();
+    ~TelemetryRelayEncoder() = default;
+
+    // Returns false if nothing changed and it isn't a keyframe, there is no
+    // datagram to send then. body_size is the size before compression.
+    bool encode(const DroneCore::FleetState &state, bool keyframe, std::string &datagram,
+                size_t &body_size);
+
+    // Non-copyable
+    TelemetryRelayEncoder(const TelemetryRelayEncoder &) = delete;
+    const TelemetryRelayEncoder &operator=(const TelemetryRelayEncoder &) = delete;
+
+private:
+    TelemetryRelayFormat::Row _last[TelemetryRelayFormat::NUM_SYSTEMS];
+    bool _sent[TelemetryRelayFormat::NUM_SYSTEMS];
+    uint32_t _sequence {0};
+    // Kept to not allocate for every datagram.
+    std::string _body {};
+};
+
+// Sends the fleet state to a UDP address at a fixed rate from its own thread,
+// for uplinks where bandwidth costs, e.g. from field stations over LTE.
+// Every keyframe_interval_s there is a keyframe for receivers which joined
+// late or lost a datagram.
+class TelemetryRelayFeed
+{
+public:
+    typedef std::function<void(DroneCore::FleetState &)> get_state_t;
+
+    explicit TelemetryRelayFeed(get_state_t get_state) : _get_state(get_state) {}
+    ~TelemetryRelayFeed();
+
+    // The host is an IPv4 address. Returns false if already running or on Windows.
+    bool start(const std::string &host, int port, double rate_hz, double keyframe_interval_s);
+    void stop();
+
+    DroneCore::TelemetryRelayStats get_stats() const;
+
+    // Non-copyable
+    TelemetryRelayFeed(const TelemetryRelayFeed &) = delete;
+    const TelemetryRelayFeed &operator=(const TelemetryRelayFeed &) = delete;
+
+private:
+    void relay_thread(int socket_fd, uint32_t ip, uint16_t port, double rate_hz,
+                      double keyframe_interval_s);
+
+    get_state_t _get_state;
+
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+    bool _should_exit {false};
+    std::thread *_relay_thread {nullptr};
+
+    std::atomic<uint64_t> _datagrams_sent {0};
+    std::atomic<uint64_t> _keyframes_sent {0};
+    std::atomic<uint64_t> _raw_bytes {0};
+    std::atomic<uint64_t> _bytes_sent {0};
+};
+
+} // namespace dronecore
@@ -0,0 +1,243 @@
+#include "telemetry_relay_feed.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+#ifndef WINDOWS
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace dronecore;
+
+namespace {
+
+void add_system(DroneCore::FleetState &state, uint8_t system_id)
+{
+    state.system_ids.push_back(system_id);
+    state.latitude_deg.push_back(47.3977418 + system_id * 1e-4);
+    state.longitude_deg.push_back(8.5455939);
+    state.absolute_altitude_m.push_back(488.0f);
+    state.relative_altitude_m.push_back(10.0f);
+    state.roll_deg.push_back(0.0f);
+    state.pitch_deg.push_back(0.0f);
+    state.yaw_deg.push_back(90.0f);
+    state.battery_voltage_v.push_back(NAN);
+    state.battery_remaining_percent.push_back(NAN);
+    state.base_mode.push_back(0x80);
+    state.custom_mode.push_back(4);
+}
+
+// Moves every system a bit, like a fleet flying at a few m/s sampled at 1 Hz.
+void step(DroneCore::FleetState &state, unsigned tick)
+{
+    for (size_t i = 0; i < state.system_ids.size(); ++i) {
+        state.latitude_deg[i] += 3e-5;
+        state.relative_altitude_m[i] = 10.0f + 0.1f * static_cast<float>(tick % 7);
+        state.absolute_altitude_m[i] = 478.0f + state.relative_altitude_m[i];
+        state.roll_deg[i] = 0.5f * static_cast<float>(tick % 3);
+        if (tick % 10 == 0) {
+            state.battery_voltage_v[i] = 12.0f - 0.01f * static_cast<float>(tick);
+        }
+    }
+}
+
+std::vector<uint64_t> bits(const DroneCore::FleetState &state)
+{
+    std::vector<uint64_t> result;
+    TelemetryRelayFormat::Row row;
+    for (size_t i = 0; i < state.system_ids.size(); ++i) {
+        TelemetryRelayFormat::get_row(state, i, row);
+        result.push_back(state.system_ids[i]);
+        result.insert(result.end(), row.fields, row.fields + TelemetryRelayFormat::NUM_FIELDS);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(TelemetryRelay, DecodesWhatWasEncoded)
+{
+    TelemetryRelayEncoder encoder;
+    TelemetryRelayDecoder decoder;
+    DroneCore::FleetState state;
+    for (uint8_t system_id = 1; system_id <= 20; ++system_id) {
+        add_system(state, system_id);
+    }
+
+    std::string datagram;
+    size_t body_size = 0;
+    DroneCore::FleetState decoded;
+    for (unsigned tick = 0; tick < 50; ++tick) {
+        if (tick == 20) {
+            add_system(state, 200);
+        }
+        const bool keyframe = (tick % 10 == 0);
+        if (encoder.encode(state, keyframe, datagram, body_size)) {
+            ASSERT_EQ(decoder.decode(datagram.data(), datagram.size()),
+                      TelemetryRelayDecoder::Result::OK);
+        }
+        decoder.get(decoded);
+        // Bit by bit, so that NAN equals NAN.
+        ASSERT_EQ(bits(decoded), bits(state));
+        step(state, tick);
+    }
+}
+
+TEST(TelemetryRelay, SendsOnlyChangedFields)
+{
+    TelemetryRelayEncoder encoder;
+    DroneCore::FleetState state;
+    add_system(state, 1);
+    add_system(state, 2);
+
+    std::string datagram;
+    size_t body_size = 0;
+    ASSERT_TRUE(encoder.encode(state, true, datagram, body_size));
+    EXPECT_EQ(body_size, 2 * (3 + 49u));
+
+    // Nothing to send, NAN included.
+    EXPECT_FALSE(encoder.encode(state, false, datagram, body_size));
+
+    state.yaw_deg[1] = 91.0f;
+    ASSERT_TRUE(encoder.encode(state, false, datagram, body_size));
+    EXPECT_EQ(body_size, 3 + 4u);
+
+    // Keyframes have everything, changed or not.
+    ASSERT_TRUE(encoder.encode(state, true, datagram, body_size));
+    EXPECT_EQ(body_size, 2 * (3 + 49u));
+}
+
+TEST(TelemetryRelay, WaitsForKeyframe)
+{
+    TelemetryRelayEncoder encoder;
+    DroneCore::FleetState state;
+    add_system(state, 1);
+
+    std::string keyframe;
+    std::string delta1;
+    std::string delta2;
+    size_t body_size = 0;
+    ASSERT_TRUE(encoder.encode(state, true, keyframe, body_size));
+    step(state, 1);
+    ASSERT_TRUE(encoder.encode(state, false, delta1, body_size));
+    step(state, 2);
+    ASSERT_TRUE(encoder.encode(state, false, delta2, body_size));
+
+    // Joining late.
+    TelemetryRelayDecoder decoder;
+    EXPECT_EQ(decoder.decode(delta1.data(), delta1.size()),
+              TelemetryRelayDecoder::Result::WAITING_FOR_KEYFRAME);
+    EXPECT_FALSE(decoder.is_synced());
+
+    // Losing delta1.
+    EXPECT_EQ(decoder.decode(keyframe.data(), keyframe.size()),
+              TelemetryRelayDecoder::Result::OK);
+    EXPECT_TRUE(decoder.is_synced());
+    EXPECT_EQ(decoder.decode(delta2.data(), delta2.size()),
+              TelemetryRelayDecoder::Result::WAITING_FOR_KEYFRAME);
+    EXPECT_FALSE(decoder.is_synced());
+
+    std::string next_keyframe;
+    ASSERT_TRUE(encoder.encode(state, true, next_keyframe, body_size));
+    EXPECT_EQ(decoder.decode(next_keyframe.data(), next_keyframe.size()),
+              TelemetryRelayDecoder::Result::OK);
+    DroneCore::FleetState decoded;
+    decoder.get(decoded);
+    EXPECT_EQ(bits(decoded), bits(state));
+}
+
+TEST(TelemetryRelay, RejectsCorruptDatagrams)
+{
+    TelemetryRelayEncoder encoder;
+    TelemetryRelayDecoder decoder;
+    DroneCore::FleetState state;
+    add_system(state, 1);
+
+    std::string datagram;
+    size_t body_size = 0;
+    ASSERT_TRUE(encoder.encode(state, true, datagram, body_size));
+
+    EXPECT_EQ(decoder.decode(datagram.data(), 10), TelemetryRelayDecoder::Result::INVALID);
+    std::string truncated = datagram.substr(0, datagram.size() - 2);
+    EXPECT_EQ(decoder.decode(truncated.data(), truncated.size()),
+              TelemetryRelayDecoder::Result::INVALID);
+    std::string wrong_magic = datagram;
+    wrong_magic[0] = 'X';
+    EXPECT_EQ(decoder.decode(wrong_magic.data(), wrong_magic.size()),
+              TelemetryRelayDecoder::Result::INVALID);
+
+    DroneCore::FleetState decoded;
+    decoder.get(decoded);
+    EXPECT_TRUE(decoded.system_ids.empty());
+}
+
+TEST(TelemetryRelay, SendsLessThanTheRawState)
+{
+    TelemetryRelayEncoder encoder;
+    DroneCore::FleetState state;
+    for (uint8_t system_id = 1; system_id <= 50; ++system_id) {
+        add_system(state, system_id);
+    }
+
+    std::string datagram;
+    size_t body_size = 0;
+    size_t raw_bytes = 0;
+    size_t bytes_sent = 0;
+    for (unsigned tick = 0; tick < 100; ++tick) {
+        if (encoder.encode(state, tick % 10 == 0, datagram, body_size)) {
+            bytes_sent += datagram.size();
+        }
+        raw_bytes += state.system_ids.size() * 50;
+        step(state, tick);
+    }
+    EXPECT_LT(bytes_sent * 3, raw_bytes);
+}
+
+#ifndef WINDOWS
+TEST(TelemetryRelay, FeedSendsOverUdp)
+{
+    const int socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    ASSERT_GE(socket_fd, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    ASSERT_EQ(bind(socket_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(getsockname(socket_fd, reinterpret_cast<sockaddr *>(&addr), &addr_len), 0);
+    timeval timeout {1, 0};
+    setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    DroneCore::FleetState state;
+    add_system(state, 42);
+    TelemetryRelayFeed feed([&state](DroneCore::FleetState & copy) { copy = state; });
+    EXPECT_FALSE(feed.start("not an address", ntohs(addr.sin_port), 50.0, 1.0));
+    ASSERT_TRUE(feed.start("127.0.0.1", ntohs(addr.sin_port), 50.0, 1.0));
+    EXPECT_FALSE(feed.start("127.0.0.1", ntohs(addr.sin_port), 50.0, 1.0));
+
+    char buffer[2048];
+    const auto received = recv(socket_fd, buffer, sizeof(buffer), 0);
+    ASSERT_GT(received, 0);
+    feed.stop();
+    close(socket_fd);
+
+    // The first one is a keyframe.
+    TelemetryRelayDecoder decoder;
+    ASSERT_EQ(decoder.decode(buffer, static_cast<size_t>(received)),
+              TelemetryRelayDecoder::Result::OK);
+    DroneCore::FleetState decoded;
+    decoder.get(decoded);
+    EXPECT_EQ(bits(decoded), bits(state));
+
+    const DroneCore::TelemetryRelayStats stats = feed.get_stats();
+    EXPECT_GE(stats.datagrams_sent, 1u);
+    EXPECT_GE(stats.keyframes_sent, 1u);
+    EXPECT_GT(stats.raw_bytes, 0u);
+    EXPECT_GT(stats.bytes_sent, 0u);
+}
+#endif
@@ -0,0 +1,282 @@
+#include "terrain_cache.h"
+#include "log.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#if defined(LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h> // for close()
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+namespace dronecore {
+
+constexpr unsigned TerrainCache::DEFAULT_MAX_TILES;
+
+static constexpr unsigned SRTM1_SIZE = 3601;
+static constexpr unsigned SRTM3_SIZE = 1201;
+static constexpr int16_t VOID_SAMPLE = -32768;
+
+TerrainCache::TerrainCache(const std::string &tile_dir, unsigned max_tiles,
+                           std::shared_ptr<MemoryAccount> memory_account) :
+    _tile_dir(tile_dir),
+    _max_tiles(std::max(max_tiles, 1u)),
+    _memory_account(memory_account)
+{
+}
+
+TerrainCache::~TerrainCache()
+{
+    for (auto &tile : _tiles) {
+        unload(tile.second);
+    }
+}
+
+bool TerrainCache::get_elevation(double latitude_deg, double longitude_deg, float &elevation_m)
+{
+    return get_elevations(&latitude_deg, &longitude_deg, 1, &elevation_m);
+}
+
+bool TerrainCache::get_elevations(const double *latitudes_deg, const double *longitudes_deg,
+                                  size_t count, float *elevations_m)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool all_found = true;
+    size_t i = 0;
+    while (i < count) {
+        if (!std::isfinite(latitudes_deg[i]) || !std::isfinite(longitudes_deg[i]) ||
+            std::fabs(latitudes_deg[i]) > 90.0 || std::fabs(longitudes_deg[i]) > 180.0) {
+            elevations_m[i++] = NAN;
+            all_found = false;
+            continue;
+        }
+
+        // The positions up to end are on the same tile.
+        const int latitude_tile = int(std::floor(latitudes_deg[i]));
+        const int longitude_tile = int(std::floor(longitudes_deg[i]));
+        size_t end = i + 1;
+        while (end < count &&
+               std::floor(latitudes_deg[end]) == double(latitude_tile) &&
+               std::floor(longitudes_deg[end]) == double(longitude_tile)) {
+            ++end;
+        }
+
+        const Tile &tile = get_tile(tile_key(latitude_tile, longitude_tile),
+                                    latitude_tile, longitude_tile);
+        if (tile.samples == nullptr) {
+            std::fill(elevations_m + i, elevations_m + end, NAN);
+            all_found = false;
+        } else {
+            interpolate(tile, latitudes_deg + i, longitudes_deg + i, end - i, elevations_m + i);
+            for (size_t j = i; j < end && all_found; ++j) {
+                all_found = !std::isnan(elevations_m[j]);
+            }
+        }
+        i = end;
+    }
+    return all_found;
+}
+
+unsigned TerrainCache::get_num_tiles() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return unsigned(_tiles.size());
+}
+
+std::string TerrainCache::get_tile_name(int latitude_deg, int longitude_deg)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%c%02d%c%03d.hgt",
+             latitude_deg < 0 ? 'S' : 'N', std::abs(latitude_deg),
+             longitude_deg < 0 ? 'W' : 'E', std::abs(longitude_deg));
+    return std::string(name);
+}
+
+const TerrainCache::Tile &TerrainCache::get_tile(int32_t key, int latitude_deg,
+                                                 int longitude_deg)
+{
+    auto it = _tiles.find(key);
+    if (it != _tiles.end()) {
+        _lru.splice(_lru.begin(), _lru, it->second.lru_it);
+        if (it->second.refused) {
+            load(key, it->second);
+        }
+        return it->second;
+    }
+
+    if (_tiles.size() >= _max_tiles) {
+        auto oldest = _tiles.find(_lru.back());
+        unload(oldest->second);
+        _tiles.erase(oldest);
+        _lru.pop_back();
+    }
+
+    _lru.push_front(key);
+    Tile &tile = _tiles[key];
+    tile.latitude_deg = latitude_deg;
+    tile.longitude_deg = longitude_deg;
+    tile.samples = nullptr;
+    tile.len = 0;
+    tile.size = 0;
+    tile.refused = false;
+    tile.lru_it = _lru.begin();
+    load(key, tile);
+    return tile;
+}
+
+void TerrainCache::load(int32_t key, Tile &tile)
+{
+    tile.refused = false;
+
+    const std::string path = _tile_dir + "/" + get_tile_name(tile.latitude_deg,
+                                                             tile.longitude_deg);
+#if defined(LINUX)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return;
+    }
+    const size_t len = size_t(file_stat.st_size);
+    if (!make_room(len, key)) {
+        close(fd);
+        tile.refused = true;
+        return;
+    }
+    void *data = (len > 0) ? mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED) {
+        if (_memory_account) {
+            _memory_account->release(len);
+        }
+        return;
+    }
+    tile.samples = static_cast<const uint8_t *>(data);
+    tile.len = len;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return;
+    }
+    file.seekg(0, std::ios::end);
+    const size_t len = size_t(file.tellg());
+    file.seekg(0, std::ios::beg);
+    if (!make_room(len, key)) {
+        tile.refused = true;
+        return;
+    }
+    tile.contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (tile.contents.size() != len) {
+        // Changed while reading, the bytes taken are what is kept.
+        if (_memory_account) {
+            _memory_account->release(len);
+            _memory_account->charge(tile.contents.size());
+        }
+    }
+    tile.samples = tile.contents.data();
+    tile.len = tile.contents.size();
+#endif
+
+    if (tile.len == size_t(SRTM1_SIZE) * SRTM1_SIZE * 2) {
+        tile.size = SRTM1_SIZE;
+    } else if (tile.len == size_t(SRTM3_SIZE) * SRTM3_SIZE * 2) {
+        tile.size = SRTM3_SIZE;
+    } else {
+        LogWarn() << "Invalid terrain tile " << path;
+        unload(tile);
+    }
+}
+
+void TerrainCache::unload(Tile &tile)
+{
+#if defined(LINUX)
+    if (tile.samples != nullptr) {
+        munmap(const_cast<uint8_t *>(tile.samples), tile.len);
+    }
+#endif
+    if (_memory_account && tile.len > 0) {
+        _memory_account->release(tile.len);
+    }
+    tile.contents.clear();
+    tile.contents.shrink_to_fit();
+    tile.samples = nullptr;
+    tile.len = 0;
+}
+
+bool TerrainCache::make_room(size_t len, int32_t keep_key)
+{
+    if (!_memory_account) {
+        return true;
+    }
+
+    // From the least recently used, the kept one is the most recent.
+    for (auto it = _lru.rbegin(); !_memory_account->try_charge(len); ++it) {
+        while (it != _lru.rend() && (*it == keep_key || _tiles[*it].len == 0)) {
+            ++it;
+        }
+        if (it == _lru.rend()) {
+            LogWarn() << "No memory left for terrain tile of " << len << " bytes";
+            return false;
+        }
+        // Stays known, only the samples go, so the list doesn't change.
+        unload(_tiles[*it]);
+        _tiles[*it].refused = true;
+    }
+    return true;
+}
+
+int32_t TerrainCache::tile_key(int latitude_deg, int longitude_deg)
+{
+    return int32_t((latitude_deg + 90) * 360 + (longitude_deg + 180));
+}
+
+void TerrainCache::interpolate(const Tile &tile, const double *latitudes_deg,
+                               const double *longitudes_deg, size_t count,
+                               float *elevations_m)
+{
+    const uint8_t *samples = tile.samples;
+    const double samples_per_deg = double(tile.size - 1);
+    const double north_deg = double(tile.latitude_deg + 1);
+    const double west_deg = double(tile.longitude_deg);
+    const int max_index = int(tile.size) - 2;
+    const size_t row_len = tile.size;
+
+    // Big-endian, that's how SRTM comes.
+    auto sample = [samples](size_t index) {
+        return int16_t(uint16_t(uint16_t(samples[2 * index]) << 8) | samples[2 * index + 1]);
+    };
+
+    for (size_t i = 0; i < count; ++i) {
+        const double row = (north_deg - latitudes_deg[i]) * samples_per_deg;
+        const double col = (longitudes_deg[i] - west_deg) * samples_per_deg;
+        const int row_0 = std::min(std::max(int(row), 0), max_index);
+        const int col_0 = std::min(std::max(int(col), 0), max_index);
+        const double t_row = row - double(row_0);
+        const double t_col = col - double(col_0);
+
+        const size_t index = size_t(row_0) * row_len + size_t(col_0);
+        const int16_t nw = sample(index);
+        const int16_t ne = sample(index + 1);
+        const int16_t sw = sample(index + row_len);
+        const int16_t se = sample(index + row_len + 1);
+
+        const double north = double(nw) + t_col * double(ne - nw);
+        const double south = double(sw) + t_col * double(se - sw);
+        const double elevation_m = north + t_row * (south - north);
+
+        const bool has_void = (nw == VOID_SAMPLE) | (ne == VOID_SAMPLE) |
+                              (sw == VOID_SAMPLE) | (se == VOID_SAMPLE);
+        elevations_m[i] = has_void ? NAN : float(elevation_m);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "memory_budget.h"
+
+namespace dronecore {
+
+// Terrain elevations above mean sea level from SRTM tiles in a directory.
+//
+// Each tile is a .hgt file covering one degree, named after its south-west
+// corner, e.g. N47E008.hgt for 47 to 48 N and 8 to 9 E. It holds 1201 x 1201
+// (3 arc seconds) or 3601 x 3601 (1 arc second) big-endian int16 samples in
+// meters, rows from north to south, -32768 where there is no data.
+//
+// Tiles are mapped into memory when first needed and at most max_tiles stay
+// mapped, the least recently used one is unmapped first. Tiles which are not
+// there are remembered as well, so they are not looked for again and again.
+//
+// With a memory account, the bytes of the tiles loaded are counted with it. If
+// it refuses a tile, the least recently used ones are unloaded to make room.
+class TerrainCache
+{
+public:
+    explicit TerrainCache(const std::string &tile_dir, unsigned max_tiles = DEFAULT_MAX_TILES,
+                          std::shared_ptr<MemoryAccount> memory_account = nullptr);
+    ~TerrainCache();
+
+    // Bilinear between the four samples around the position. False where there
+    // is no tile or no data.
+    bool get_elevation(double latitude_deg, double longitude_deg, float &elevation_m);
+    // The same for many positions at once, NAN where there is no data. Returns
+    // true if all were found. Positions next to each other are best on the same
+    // tile, runs of them are interpolated in a loop without branches.
+    bool get_elevations(const double *latitudes_deg, const double *longitudes_deg, size_t count,
+                        float *elevations_m);
+
+    unsigned get_num_tiles() const;
+
+    static std::string get_tile_name(int latitude_deg, int longitude_deg);
+
+    static constexpr unsigned DEFAULT_MAX_TILES = 16;
+
+    // Non-copyable
+    TerrainCache(const TerrainCache &) = delete;
+    const TerrainCache &operator=(const TerrainCache &) = delete;
+
+private:
+    struct Tile {
+        int latitude_deg;
+        int longitude_deg;
+        // nullptr if the tile is missing or invalid.
+        const uint8_t *samples;
+        size_t len;
+        // Samples along each side.
+        unsigned size;
+        // There was no room for it, it is tried again the next time.
+        bool refused;
+        std::list<int32_t>::iterator lru_it;
+        // Only used where files are read rather than mapped.
+        std::vector<uint8_t> contents;
+    };
+
+    // These need to be called with _mutex locked.
+    const Tile &get_tile(int32_t key, int latitude_deg, int longitude_deg);
+    void load(int32_t key, Tile &tile);
+    void unload(Tile &tile);
+    // Unloads the least recently used tiles other than the one kept until the
+    // account takes the bytes. Returns false if there was still no room.
+    bool make_room(size_t len, int32_t keep_key);
+
+    static int32_t tile_key(int latitude_deg, int longitude_deg);
+    static void interpolate(const Tile &tile, const double *latitudes_deg,
+                            const double *longitudes_deg, size_t count, float *elevations_m);
+
+    const std::string _tile_dir;
+    const unsigned _max_tiles;
+    const std::shared_ptr<MemoryAccount> _memory_account;
+
+    mutable std::mutex _mutex {};
+    std::unordered_map<int32_t, Tile> _tiles {};
+    // Most recently used first.
+    std::list<int32_t> _lru {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,147 @@
+#include "terrain_cache.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using namespace dronecore;
+
+static const std::string tile_dir = ".";
+
+// An SRTM3 tile rising by a meter per sample to the east and 2 m to the south.
+static std::string write_tile(int latitude_deg, int longitude_deg, int16_t base_m,
+                              bool with_void = false)
+{
+    const unsigned size = 1201;
+    std::vector<uint8_t> bytes(size * size * 2);
+    for (unsigned row = 0; row < size; ++row) {
+        for (unsigned col = 0; col < size; ++col) {
+            int16_t value = int16_t(base_m + int(col) + 2 * int(row));
+            if (with_void && row == 300 && col == 300) {
+                value = -32768;
+            }
+            const size_t index = (size_t(row) * size + col) * 2;
+            bytes[index] = uint8_t(uint16_t(value) >> 8);
+            bytes[index + 1] = uint8_t(uint16_t(value) & 0xff);
+        }
+    }
+
+    const std::string path = tile_dir + "/" +
+                             TerrainCache::get_tile_name(latitude_deg, longitude_deg);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(bytes.data()), std::streamsize(bytes.size()));
+    return path;
+}
+
+TEST(TerrainCache, TileName)
+{
+    EXPECT_EQ(TerrainCache::get_tile_name(47, 8), "N47E008.hgt");
+    EXPECT_EQ(TerrainCache::get_tile_name(-34, -58), "S34W058.hgt");
+    EXPECT_EQ(TerrainCache::get_tile_name(0, -180), "N00W180.hgt");
+}
+
+TEST(TerrainCache, Interpolates)
+{
+    const std::string path = write_tile(47, 8, 400);
+    TerrainCache terrain(tile_dir);
+
+    float elevation_m;
+    // North-west corner.
+    ASSERT_TRUE(terrain.get_elevation(48.0 - 1e-9, 8.0, elevation_m));
+    EXPECT_NEAR(elevation_m, 400.0f, 1e-3f);
+    // South-east corner.
+    ASSERT_TRUE(terrain.get_elevation(47.0, 9.0 - 1e-9, elevation_m));
+    EXPECT_NEAR(elevation_m, 400.0f + 1200.0f + 2400.0f, 1e-2f);
+    // Half a sample east and south of a sample.
+    ASSERT_TRUE(terrain.get_elevation(48.0 - 10.5 / 1200.0, 8.0 + 20.5 / 1200.0, elevation_m));
+    EXPECT_NEAR(elevation_m, 400.0f + 20.5f + 21.0f, 1e-3f);
+
+    // No tile further north.
+    EXPECT_FALSE(terrain.get_elevation(48.5, 8.5, elevation_m));
+
+    std::remove(path.c_str());
+}
+
+TEST(TerrainCache, Batch)
+{
+    const std::string path = write_tile(47, 8, 0, true);
+    TerrainCache terrain(tile_dir);
+
+    const double latitudes_deg[] = {47.5, 47.5, 48.5, 47.25, 48.0 - 300.0 / 1200.0};
+    const double longitudes_deg[] = {8.5, 8.75, 8.5, 8.5, 8.0 + 300.0 / 1200.0};
+    float elevations_m[5];
+    EXPECT_FALSE(terrain.get_elevations(latitudes_deg, longitudes_deg, 5, elevations_m));
+
+    EXPECT_NEAR(elevations_m[0], 600.0f + 1200.0f, 1e-2f);
+    EXPECT_NEAR(elevations_m[1], 900.0f + 1200.0f, 1e-2f);
+    // No tile, and no data right there.
+    EXPECT_TRUE(std::isnan(elevations_m[2]));
+    EXPECT_NEAR(elevations_m[3], 600.0f + 1800.0f, 1e-2f);
+    EXPECT_TRUE(std::isnan(elevations_m[4]));
+
+    EXPECT_TRUE(terrain.get_elevations(latitudes_deg, longitudes_deg, 2, elevations_m));
+
+    std::remove(path.c_str());
+}
+
+TEST(TerrainCache, KeepsRecentlyUsedTiles)
+{
+    const std::string path_1 = write_tile(47, 8, 100);
+    const std::string path_2 = write_tile(47, 9, 200);
+    TerrainCache terrain(tile_dir, 2);
+
+    float elevation_m;
+    ASSERT_TRUE(terrain.get_elevation(47.5, 8.5, elevation_m));
+    ASSERT_TRUE(terrain.get_elevation(47.5, 9.5, elevation_m));
+    EXPECT_EQ(terrain.get_num_tiles(), 2u);
+
+    // A missing tile counts too, the least recently used one goes.
+    ASSERT_TRUE(terrain.get_elevation(47.5, 8.5, elevation_m));
+    EXPECT_FALSE(terrain.get_elevation(46.5, 8.5, elevation_m));
+    EXPECT_EQ(terrain.get_num_tiles(), 2u);
+
+    // Mapped again when needed.
+    ASSERT_TRUE(terrain.get_elevation(47.5, 9.5, elevation_m));
+    EXPECT_NEAR(elevation_m, 200.0f + 600.0f + 1200.0f, 1e-2f);
+    ASSERT_TRUE(terrain.get_elevation(47.5, 8.5, elevation_m));
+    EXPECT_NEAR(elevation_m, 100.0f + 600.0f + 1200.0f, 1e-2f);
+
+    std::remove(path_1.c_str());
+    std::remove(path_2.c_str());
+}
+
+TEST(TerrainCache, StaysWithinMemoryCap)
+{
+    const std::string path_1 = write_tile(47, 8, 100);
+    const std::string path_2 = write_tile(47, 9, 200);
+    const size_t tile_len = size_t(1201) * 1201 * 2;
+
+    MemoryBudget budget;
+    budget.set_cap("terrain", tile_len + tile_len / 2);
+    TerrainCache terrain(tile_dir, 16, budget.get_account("terrain"));
+
+    float elevation_m;
+    ASSERT_TRUE(terrain.get_elevation(47.5, 8.5, elevation_m));
+    EXPECT_EQ(budget.get_account("terrain")->get_bytes(), tile_len);
+
+    // Only one fits, the other one is unloaded for it.
+    ASSERT_TRUE(terrain.get_elevation(47.5, 9.5, elevation_m));
+    EXPECT_NEAR(elevation_m, 200.0f + 600.0f + 1200.0f, 1e-2f);
+    EXPECT_EQ(budget.get_account("terrain")->get_bytes(), tile_len);
+
+    ASSERT_TRUE(terrain.get_elevation(47.5, 8.5, elevation_m));
+    EXPECT_NEAR(elevation_m, 100.0f + 600.0f + 1200.0f, 1e-2f);
+    EXPECT_EQ(budget.get_account("terrain")->get_bytes(), tile_len);
+
+    // Without any room, the tile is not there for now.
+    budget.set_cap("terrain", tile_len / 2);
+    EXPECT_FALSE(terrain.get_elevation(47.5, 9.5, elevation_m));
+    EXPECT_EQ(budget.get_account("terrain")->get_bytes(), 0u);
+
+    budget.set_cap("terrain", 0);
+    ASSERT_TRUE(terrain.get_elevation(47.5, 9.5, elevation_m));
+
+    std::remove(path_1.c_str());
+    std::remove(path_2.c_str());
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+namespace dronecore {
+
+/**
+ * @brief What a thread started by DroneCore is used for, see DroneCore::set_thread_config().
+ *
+ * Threads are named after it with a `dc-` prefix, e.g. `dc-udp_recv`, so they can be
+ * told apart in tools such as top, htop or perf.
+ */
+enum class ThreadRole {
+    Io, /**< @brief Receiving and sending on connections, and replaying log files. */
+    System, /**< @brief Handling messages and timeouts for each system. */
+    Callback, /**< @brief Calling user callbacks. */
+    Setpoint, /**< @brief Streaming offboard setpoints or manual control at a fixed rate. */
+    Background /**< @brief Downloads, log output and other work which can wait. */
+};
+
+/**
+ * @brief How threads of a ThreadRole are run.
+ */
+struct ThreadConfig {
+    /**
+     * @brief CPUs the threads may run on, empty for any.
+     */
+    std::vector<int> cpus {};
+
+    /**
+     * @brief Realtime (SCHED_FIFO) priority from 1 to 99, 0 for normal scheduling.
+     *
+     * This usually needs root or CAP_SYS_NICE. Setpoint threads ask for a realtime
+     * priority of their own unless one is configured.
+     */
+    int realtime_priority = 0;
+};
+
+} // namespace dronecore
@@ -0,0 +1,118 @@
+#include "thread_setup.h"
+#include "global_include.h"
+#include "log.h"
+#include <cstdio>
+#include <mutex>
+
+#if defined(LINUX) || defined(APPLE)
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace dronecore {
+
+// Indexed by ThreadRole.
+static constexpr int NUM_ROLES = static_cast<int>(ThreadRole::Background) + 1;
+
+static std::mutex &configs_mutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+static ThreadConfig *configs()
+{
+    static ThreadConfig thread_configs[NUM_ROLES];
+    return thread_configs;
+}
+
+void set_thread_config(ThreadRole role, const ThreadConfig &config)
+{
+    std::lock_guard<std::mutex> lock(configs_mutex());
+    configs()[static_cast<int>(role)] = config;
+}
+
+ThreadConfig get_thread_config(ThreadRole role)
+{
+    std::lock_guard<std::mutex> lock(configs_mutex());
+    return configs()[static_cast<int>(role)];
+}
+
+static void set_name(const char *name)
+{
+    // Linux allows 15 characters.
+    char thread_name[16];
+    std::snprintf(thread_name, sizeof(thread_name), "dc-%s", name);
+
+#if defined(LINUX)
+    pthread_setname_np(pthread_self(), thread_name);
+#elif defined(APPLE)
+    pthread_setname_np(thread_name);
+#else
+    UNUSED(thread_name);
+#endif
+}
+
+static void set_affinity(const char *name, const std::vector<int> &cpus)
+{
+#if defined(LINUX)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (int cpu : cpus) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) {
+            LogWarn() << "Invalid CPU " << cpu << " for thread " << name;
+            return;
+        }
+        CPU_SET(cpu, &cpu_set);
+    }
+
+    // Only the calling thread, also where pthread_setaffinity_np is missing.
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+        LogWarn() << "Could not set CPU affinity of thread " << name << ": "
+                  << strerror(errno);
+    }
+#else
+    UNUSED(cpus);
+    LogWarn() << "CPU affinity of thread " << name << " not supported on this platform";
+#endif
+}
+
+static bool set_realtime_priority(const char *name, int priority)
+{
+#if defined(LINUX) || defined(APPLE)
+    struct sched_param param {};
+    param.sched_priority = priority;
+
+    const int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (ret != 0) {
+        LogWarn() << "Could not set realtime priority " << priority << " of thread "
+                  << name << ": " << strerror(ret);
+        return false;
+    }
+    return true;
+#else
+    UNUSED(priority);
+    LogWarn() << "Realtime priority of thread " << name << " not supported on this platform";
+    return false;
+#endif
+}
+
+bool setup_thread(ThreadRole role, const char *name)
+{
+    set_name(name);
+
+    const ThreadConfig config = get_thread_config(role);
+
+    if (!config.cpus.empty()) {
+        set_affinity(name, config.cpus);
+    }
+
+    if (config.realtime_priority > 0) {
+        return set_realtime_priority(name, config.realtime_priority);
+    }
+    return false;
+}
+
+} // namespace dronecore
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "thread_config.h"
+
+namespace dronecore {
+
+// The configuration of the threads is global, set once for all DroneCore
+// instances, and read by every thread when it starts.
+void set_thread_config(ThreadRole role, const ThreadConfig &config);
+ThreadConfig get_thread_config(ThreadRole role);
+
+// To be called first thing by every thread DroneCore starts. Names the calling
+// thread "dc-<name>", cut to what the platform allows, and applies the
+// configuration of its role where supported. Failures are logged but the thread
+// runs on as it is.
+//
+// Returns true if the thread now runs with the configured realtime priority.
+bool setup_thread(ThreadRole role, const char *name);
+
+} // namespace dronecore
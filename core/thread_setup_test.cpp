@@ -0,0 +1,69 @@
+#include "thread_setup.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+#if defined(LINUX)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace dronecore;
+
+#if defined(LINUX)
+TEST(ThreadSetup, NamesThread)
+{
+    std::string name;
+    std::thread thread([&name]() {
+        setup_thread(ThreadRole::Io, "a_rather_long_name");
+        char buffer[16] {};
+        pthread_getname_np(pthread_self(), buffer, sizeof(buffer));
+        name = buffer;
+    });
+    thread.join();
+
+    // Cut to 15 characters.
+    EXPECT_EQ(name, "dc-a_rather_lon");
+}
+
+TEST(ThreadSetup, SetsAffinity)
+{
+    ThreadConfig config;
+    config.cpus = {0};
+    set_thread_config(ThreadRole::Background, config);
+
+    bool only_cpu_0 = false;
+    std::thread thread([&only_cpu_0]() {
+        setup_thread(ThreadRole::Background, "test");
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set), &cpu_set), 0);
+        only_cpu_0 = CPU_ISSET(0, &cpu_set) && CPU_COUNT(&cpu_set) == 1;
+    });
+    thread.join();
+    EXPECT_TRUE(only_cpu_0);
+
+    // Other roles are not affected.
+    EXPECT_TRUE(get_thread_config(ThreadRole::Io).cpus.empty());
+
+    set_thread_config(ThreadRole::Background, ThreadConfig {});
+    EXPECT_TRUE(get_thread_config(ThreadRole::Background).cpus.empty());
+}
+
+TEST(ThreadSetup, RunsOnWithInvalidConfig)
+{
+    ThreadConfig config;
+    config.cpus = {-1};
+    config.realtime_priority = 1000;
+    set_thread_config(ThreadRole::Callback, config);
+
+    bool realtime_priority = true;
+    std::thread thread([&realtime_priority]() {
+        realtime_priority = setup_thread(ThreadRole::Callback, "test");
+    });
+    thread.join();
+    EXPECT_FALSE(realtime_priority);
+
+    set_thread_config(ThreadRole::Callback, ThreadConfig {});
+}
+#endif
@@ -13,16 +13,16 @@ TimeoutHandler::~TimeoutHandler()
 
 void TimeoutHandler::add(std::function<void()> callback, double duration_s, void **cookie)
 {
-    auto new_timeout = std::make_shared<Timeout>();
-    new_timeout->callback = callback;
-    new_timeout->time = _time.steady_time_in_future(duration_s);
-    new_timeout->duration_s = duration_s;
-
-    void *new_cookie = static_cast<void *>(new_timeout.get());
+    void *new_cookie = nullptr;
 
     {
         std::lock_guard<std::mutex> lock(_timeouts_mutex);
-        _timeouts.insert(std::pair<void *, std::shared_ptr<Timeout>>(new_cookie, new_timeout));
+        TimerWheel::Entry *new_timeout = _timeouts.allocate();
+        new_timeout->callback = callback;
+        new_timeout->duration_s = duration_s;
+        _timeouts.schedule(new_timeout, _time.steady_time_in_future(duration_s));
+
+        new_cookie = _timeouts.cookie(new_timeout);
     }
 
     if (cookie != nullptr) {
@@ -34,10 +34,9 @@ void TimeoutHandler::refresh(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_timeouts_mutex);
 
-    auto it = _timeouts.find(const_cast<void *>(cookie));
-    if (it != _timeouts.end()) {
-        dl_time_t future_time = _time.steady_time_in_future(it->second->duration_s);
-        it->second->time = future_time;
+    TimerWheel::Entry *timeout = _timeouts.lookup(cookie);
+    if (timeout != nullptr) {
+        _timeouts.schedule(timeout, _time.steady_time_in_future(timeout->duration_s));
     }
 }
 
@@ -45,43 +44,57 @@ void TimeoutHandler::remove(const void *cookie)
 {
     std::lock_guard<std::mutex> lock(_timeouts_mutex);
 
-    auto it = _timeouts.find(const_cast<void *>(cookie));
-    if (it != _timeouts.end()) {
-        _timeouts.erase(const_cast<void *>(cookie));
+    TimerWheel::Entry *timeout = _timeouts.lookup(cookie);
+    if (timeout != nullptr) {
+        _timeouts.release(timeout);
     }
 }
 
 void TimeoutHandler::run_once()
 {
-    _timeouts_mutex.lock();
-
-    dl_time_t now = _time.steady_time();
-
-    for (auto it = _timeouts.begin(); it != _timeouts.end(); /* no ++it */) {
+    std::vector<void *> due {};
 
-        // If time is passed, call timeout callback.
-        if (it->second->time < now) {
-
-            if (it->second->callback) {
+    {
+        std::lock_guard<std::mutex> lock(_timeouts_mutex);
 
-                // Get a copy for the callback because we will remove it.
-                std::function<void()> callback = it->second->callback;
+        _due.clear();
+        _timeouts.collect_due(_time.steady_time(), _due);
+        for (auto timeout : _due) {
+            due.push_back(_timeouts.cookie(timeout));
+        }
+    }
 
-                // Self-destruct before calling to avoid locking issues.
-                _timeouts.erase(it++);
+    for (auto due_cookie : due) {
+        std::function<void()> callback;
+        {
+            std::lock_guard<std::mutex> lock(_timeouts_mutex);
 
-                // Unlock while we callback because it might in turn want to add timeouts.
-                _timeouts_mutex.unlock();
-                callback();
-                _timeouts_mutex.lock();
+            // A previous callback might have removed this one already.
+            TimerWheel::Entry *timeout = _timeouts.lookup(due_cookie);
+            if (timeout == nullptr) {
+                continue;
             }
 
+            // Get a copy for the callback because we will remove it.
+            callback = timeout->callback;
+
+            // Self-destruct before calling to avoid locking issues.
+            _timeouts.release(timeout);
+        }
 
-        } else {
-            ++it;
+        // We don't hold the lock while we callback because it might in turn
+        // want to add timeouts.
+        if (callback) {
+            callback();
         }
     }
-    _timeouts_mutex.unlock();
+}
+
+double TimeoutHandler::time_until_next_s(double max_s)
+{
+    std::lock_guard<std::mutex> lock(_timeouts_mutex);
+
+    return _timeouts.time_until_next_s(_time.steady_time(), max_s);
 }
 
 } // namespace dronecore
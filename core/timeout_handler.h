@@ -3,8 +3,9 @@
 #include <mutex>
 #include <memory>
 #include <functional>
-#include <map>
+#include <vector>
 #include "global_include.h"
+#include "timer_wheel.h"
 
 namespace dronecore {
 
@@ -26,14 +27,12 @@ public:
 
     void run_once();
 
-private:
-    struct Timeout {
-        std::function<void()> callback;
-        dl_time_t time;
-        double duration_s;
-    };
+    // Seconds until the next timeout is due, or max_s if there is none earlier.
+    double time_until_next_s(double max_s);
 
-    std::map<void *, std::shared_ptr<Timeout>> _timeouts {};
+private:
+    TimerWheel _timeouts {};
+    std::vector<TimerWheel::Entry *> _due {};
     std::mutex _timeouts_mutex {};
 
     Time &_time;
@@ -148,3 +148,51 @@ TEST(TimeoutHandler, TimeoutRemovedDuringCallback)
     th.run_once();
     EXPECT_TRUE(timeout_happened);
 }
+
+TEST(TimeoutHandler, StaleCookieDoesNotRemoveNewTimeout)
+{
+    Time time {};
+    TimeoutHandler th(time);
+
+    void *old_cookie = nullptr;
+    th.add([]() {}, 0.5, &old_cookie);
+    time.sleep_for(std::chrono::milliseconds(600));
+    th.run_once();
+
+    // Likely gets the entry of the timeout which just fired.
+    bool timeout_happened = false;
+    void *new_cookie = nullptr;
+    th.add([&timeout_happened]() {
+        timeout_happened = true;
+    }, 0.5, &new_cookie);
+    EXPECT_NE(new_cookie, old_cookie);
+
+    th.remove(old_cookie);
+    th.refresh(old_cookie);
+    time.sleep_for(std::chrono::milliseconds(600));
+    th.run_once();
+    EXPECT_TRUE(timeout_happened);
+}
+
+TEST(TimeoutHandler, TimeUntilNext)
+{
+    Time time {};
+    TimeoutHandler th(time);
+
+    EXPECT_DOUBLE_EQ(th.time_until_next_s(1.0), 1.0);
+
+    void *cookie1 = nullptr;
+    void *cookie2 = nullptr;
+    th.add([]() {}, 0.5, &cookie1);
+    th.add([]() {}, 0.2, &cookie2);
+
+    EXPECT_NEAR(th.time_until_next_s(1.0), 0.2, 0.01);
+    EXPECT_NEAR(th.time_until_next_s(0.1), 0.1, 0.01);
+
+    th.remove(cookie2);
+    time.sleep_for(std::chrono::milliseconds(100));
+    EXPECT_NEAR(th.time_until_next_s(1.0), 0.4, 0.01);
+
+    time.sleep_for(std::chrono::milliseconds(500));
+    EXPECT_DOUBLE_EQ(th.time_until_next_s(1.0), 0.0);
+}
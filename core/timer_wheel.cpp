@@ -0,0 +1,202 @@
+#include "timer_wheel.h"
+
+namespace dronecore {
+
+TimerWheel::TimerWheel() :
+    _slots(NUM_SLOTS, nullptr)
+{
+}
+
+TimerWheel::~TimerWheel()
+{
+}
+
+TimerWheel::Entry *TimerWheel::allocate()
+{
+    if (_free_entries.empty()) {
+        _chunks.emplace_back(new Entry[CHUNK_SIZE]);
+        Entry *chunk = _chunks.back().get();
+        for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+            chunk[i].index = (_chunks.size() - 1) * CHUNK_SIZE + i;
+        }
+        // Push in reverse so that the first entry is handed out first.
+        for (size_t i = CHUNK_SIZE; i > 0; --i) {
+            _free_entries.push_back(&chunk[i - 1]);
+        }
+    }
+
+    Entry *entry = _free_entries.back();
+    _free_entries.pop_back();
+    entry->in_use = true;
+    return entry;
+}
+
+void TimerWheel::release(Entry *entry)
+{
+    unschedule(entry);
+    entry->callback = nullptr;
+    entry->in_use = false;
+    ++entry->generation;
+    _free_entries.push_back(entry);
+}
+
+void *TimerWheel::cookie(const Entry *entry) const
+{
+    const uintptr_t value = (entry->generation << INDEX_BITS) | (entry->index + 1);
+    return reinterpret_cast<void *>(value);
+}
+
+TimerWheel::Entry *TimerWheel::lookup(const void *cookie) const
+{
+    const uintptr_t value = reinterpret_cast<uintptr_t>(cookie);
+    if ((value & INDEX_MASK) == 0) {
+        return nullptr;
+    }
+
+    const size_t index = (value & INDEX_MASK) - 1;
+    if (index >= _chunks.size() * CHUNK_SIZE) {
+        return nullptr;
+    }
+
+    Entry *entry = &_chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+    if (!entry->in_use || (entry->generation << INDEX_BITS) != (value & ~INDEX_MASK)) {
+        return nullptr;
+    }
+    return entry;
+}
+
+void TimerWheel::schedule(Entry *entry, dl_time_t deadline)
+{
+    unschedule(entry);
+
+    if (!_next_tick_initialized) {
+        _next_tick = to_tick(deadline);
+        _next_tick_initialized = true;
+    }
+
+    entry->deadline = deadline;
+    entry->deadline_tick = to_tick(deadline);
+
+    // Anything which would land in an already checked slot needs to go into
+    // the next slot we're going to check.
+    const int64_t tick = (entry->deadline_tick < _next_tick) ? _next_tick : entry->deadline_tick;
+    entry->slot = slot_index(tick);
+    Entry *&head = _slots[entry->slot];
+
+    entry->prev = nullptr;
+    entry->next = head;
+    if (head != nullptr) {
+        head->prev = entry;
+    }
+    head = entry;
+    entry->scheduled = true;
+    ++_num_scheduled;
+}
+
+void TimerWheel::unschedule(Entry *entry)
+{
+    if (!entry->scheduled) {
+        return;
+    }
+
+    if (entry->prev != nullptr) {
+        entry->prev->next = entry->next;
+    } else {
+        _slots[entry->slot] = entry->next;
+    }
+    if (entry->next != nullptr) {
+        entry->next->prev = entry->prev;
+    }
+
+    entry->prev = nullptr;
+    entry->next = nullptr;
+    entry->scheduled = false;
+    --_num_scheduled;
+}
+
+void TimerWheel::collect_due(dl_time_t now, std::vector<Entry *> &due)
+{
+    if (!_next_tick_initialized || _num_scheduled == 0) {
+        return;
+    }
+
+    const int64_t now_tick = to_tick(now);
+
+    // If we're behind by more than a full round, every slot needs a look once.
+    int64_t first_tick = _next_tick;
+    if (now_tick - first_tick >= int64_t(NUM_SLOTS)) {
+        first_tick = now_tick - int64_t(NUM_SLOTS) + 1;
+    }
+
+    std::vector<Entry *> to_move {};
+
+    for (int64_t tick = first_tick; tick <= now_tick; ++tick) {
+        Entry *entry = _slots[slot_index(tick)];
+        while (entry != nullptr) {
+            Entry *next = entry->next;
+            if (entry->deadline <= now) {
+                unschedule(entry);
+                due.push_back(entry);
+            } else if (entry->deadline_tick < now_tick) {
+                // Was put into this slot late, but is not due yet.
+                to_move.push_back(entry);
+            }
+            entry = next;
+        }
+    }
+
+    // The slot of now_tick is checked again next time because we might be
+    // in the middle of it.
+    if (now_tick > _next_tick) {
+        _next_tick = now_tick;
+    }
+
+    for (auto entry : to_move) {
+        schedule(entry, entry->deadline);
+    }
+}
+
+double TimerWheel::time_until_next_s(dl_time_t now, double max_s) const
+{
+    if (_num_scheduled == 0) {
+        return max_s;
+    }
+
+    const int64_t now_tick = to_tick(now);
+    const int64_t first_tick = (_next_tick < now_tick) ? _next_tick : now_tick;
+
+    // Only look at the slots up to max_s, we don't care about later ones.
+    int64_t max_ticks = int64_t(max_s * 1e6) / TICK_US + 1;
+    if (max_ticks > int64_t(NUM_SLOTS)) {
+        max_ticks = int64_t(NUM_SLOTS);
+    }
+
+    double next_s = max_s;
+    for (int64_t tick = first_tick; tick <= now_tick + max_ticks; ++tick) {
+        for (Entry *entry = _slots[slot_index(tick)]; entry != nullptr; entry = entry->next) {
+            const double remaining_s =
+                std::chrono::duration<double>(entry->deadline - now).count();
+            if (remaining_s < next_s) {
+                next_s = remaining_s;
+            }
+        }
+        if (tick >= now_tick && next_s * 1e6 < double((tick - now_tick) * TICK_US)) {
+            // Nothing in a later slot can be earlier.
+            break;
+        }
+    }
+    return (next_s > 0.0) ? next_s : 0.0;
+}
+
+int64_t TimerWheel::to_tick(dl_time_t time)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               time.time_since_epoch()).count() / TICK_US;
+}
+
+size_t TimerWheel::slot_index(int64_t tick) const
+{
+    return size_t(tick) % NUM_SLOTS;
+}
+
+} // namespace dronecore
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "global_include.h"
+
+namespace dronecore {
+
+// Hashed timer wheel used by TimeoutHandler and CallEveryHandler.
+//
+// Entries are hashed into slots by their deadline, so inserting, moving and
+// cancelling an entry is O(1) and checking for due entries only looks at the
+// slots which passed since the last check. Entries are taken from a pool
+// which grows in chunks and are reused, so adding timers doesn't allocate.
+//
+// The wheel is not thread-safe, the users are expected to lock around it.
+class TimerWheel
+{
+public:
+    struct Entry {
+        std::function<void()> callback {};
+        double duration_s {0.0};
+        dl_time_t reference_time {};
+
+    private:
+        friend class TimerWheel;
+        dl_time_t deadline {};
+        int64_t deadline_tick {0};
+        size_t slot {0};
+        Entry *prev {nullptr};
+        Entry *next {nullptr};
+        bool in_use {false};
+        bool scheduled {false};
+        size_t index {0};
+        // Changes every time the entry is released, so a stale cookie of a
+        // reused entry can be detected.
+        uintptr_t generation {0};
+    };
+
+    TimerWheel();
+    ~TimerWheel();
+
+    // delete copy and move constructors and assign operators
+    TimerWheel(TimerWheel const &) = delete;            // Copy construct
+    TimerWheel(TimerWheel &&) = delete;                 // Move construct
+    TimerWheel &operator=(TimerWheel const &) = delete; // Copy assign
+    TimerWheel &operator=(TimerWheel &&) = delete;      // Move assign
+
+    Entry *allocate();
+    void release(Entry *entry);
+
+    // The cookie encodes the entry and its generation, so it doesn't match
+    // anymore once the entry has been released, even if it gets reused.
+    void *cookie(const Entry *entry) const;
+
+    // Returns the entry if the cookie belongs to an entry in use, nullptr otherwise.
+    Entry *lookup(const void *cookie) const;
+
+    // (Re-)schedules an entry, it is due once now is past the deadline.
+    void schedule(Entry *entry, dl_time_t deadline);
+    void unschedule(Entry *entry);
+
+    // Unschedules all entries which are due at now and appends them to due.
+    void collect_due(dl_time_t now, std::vector<Entry *> &due);
+
+    // Seconds from now until the earliest deadline, or max_s if none is earlier.
+    double time_until_next_s(dl_time_t now, double max_s) const;
+
+    size_t size() const { return _num_scheduled; }
+
+private:
+    static int64_t to_tick(dl_time_t time);
+    size_t slot_index(int64_t tick) const;
+
+    static constexpr int64_t TICK_US = 10000;
+    static constexpr size_t NUM_SLOTS = 512;
+    static constexpr size_t CHUNK_SIZE = 64;
+
+    // The lower half of a cookie is the entry index + 1, the upper half the generation.
+    static constexpr unsigned INDEX_BITS = sizeof(uintptr_t) * 4;
+    static constexpr uintptr_t INDEX_MASK = (uintptr_t(1) << INDEX_BITS) - 1;
+
+    std::vector<Entry *> _slots;
+    int64_t _next_tick {0};
+    bool _next_tick_initialized {false};
+    size_t _num_scheduled {0};
+
+    std::vector<std::unique_ptr<Entry[]>> _chunks {};
+    std::vector<Entry *> _free_entries {};
+};
+
+} // namespace dronecore
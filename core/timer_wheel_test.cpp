@@ -0,0 +1,138 @@
+#include "timer_wheel.h"
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace dronecore;
+
+static dl_time_t start_time()
+{
+    return dl_time_t(std::chrono::seconds(1000));
+}
+
+TEST(TimerWheel, CollectsOnlyDueEntries)
+{
+    TimerWheel wheel;
+    const dl_time_t start = start_time();
+
+    auto *early = wheel.allocate();
+    auto *late = wheel.allocate();
+    wheel.schedule(early, start + std::chrono::milliseconds(50));
+    wheel.schedule(late, start + std::chrono::milliseconds(200));
+    EXPECT_EQ(wheel.size(), 2);
+
+    std::vector<TimerWheel::Entry *> due;
+    wheel.collect_due(start + std::chrono::milliseconds(40), due);
+    EXPECT_TRUE(due.empty());
+
+    wheel.collect_due(start + std::chrono::milliseconds(60), due);
+    ASSERT_EQ(due.size(), 1);
+    EXPECT_EQ(due[0], early);
+    EXPECT_EQ(wheel.size(), 1);
+
+    due.clear();
+    wheel.collect_due(start + std::chrono::milliseconds(201), due);
+    ASSERT_EQ(due.size(), 1);
+    EXPECT_EQ(due[0], late);
+    EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST(TimerWheel, LongerThanOneRound)
+{
+    TimerWheel wheel;
+    const dl_time_t start = start_time();
+
+    auto *entry = wheel.allocate();
+    wheel.schedule(entry, start + std::chrono::seconds(20));
+
+    std::vector<TimerWheel::Entry *> due;
+    for (int i = 1; i < 20; ++i) {
+        wheel.collect_due(start + std::chrono::seconds(i), due);
+        EXPECT_TRUE(due.empty());
+    }
+
+    wheel.collect_due(start + std::chrono::milliseconds(20001), due);
+    ASSERT_EQ(due.size(), 1);
+    EXPECT_EQ(due[0], entry);
+}
+
+TEST(TimerWheel, UnscheduleAndReschedule)
+{
+    TimerWheel wheel;
+    const dl_time_t start = start_time();
+
+    auto *entry = wheel.allocate();
+    wheel.schedule(entry, start + std::chrono::milliseconds(100));
+    wheel.unschedule(entry);
+
+    std::vector<TimerWheel::Entry *> due;
+    wheel.collect_due(start + std::chrono::milliseconds(150), due);
+    EXPECT_TRUE(due.empty());
+
+    // Scheduling in the past still gets picked up next time.
+    wheel.schedule(entry, start + std::chrono::milliseconds(120));
+    wheel.collect_due(start + std::chrono::milliseconds(160), due);
+    ASSERT_EQ(due.size(), 1);
+    EXPECT_EQ(due[0], entry);
+}
+
+TEST(TimerWheel, LookupAndReuse)
+{
+    TimerWheel wheel;
+
+    int not_an_entry = 0;
+    EXPECT_EQ(wheel.lookup(nullptr), nullptr);
+    EXPECT_EQ(wheel.lookup(&not_an_entry), nullptr);
+
+    auto *entry = wheel.allocate();
+    void *cookie = wheel.cookie(entry);
+    EXPECT_EQ(wheel.lookup(cookie), entry);
+
+    wheel.release(entry);
+    EXPECT_EQ(wheel.lookup(cookie), nullptr);
+
+    // The entry is reused right away but the old cookie must not match it.
+    auto *reused = wheel.allocate();
+    EXPECT_EQ(reused, entry);
+    EXPECT_EQ(wheel.lookup(cookie), nullptr);
+    EXPECT_NE(wheel.cookie(reused), cookie);
+    EXPECT_EQ(wheel.lookup(wheel.cookie(reused)), reused);
+}
+
+TEST(TimerWheel, TimeUntilNext)
+{
+    TimerWheel wheel;
+    const dl_time_t start = start_time();
+
+    EXPECT_DOUBLE_EQ(wheel.time_until_next_s(start, 1.0), 1.0);
+
+    auto *entry1 = wheel.allocate();
+    auto *entry2 = wheel.allocate();
+    wheel.schedule(entry1, start + std::chrono::milliseconds(300));
+    wheel.schedule(entry2, start + std::chrono::milliseconds(150));
+
+    EXPECT_NEAR(wheel.time_until_next_s(start, 1.0), 0.15, 1e-6);
+    EXPECT_NEAR(wheel.time_until_next_s(start, 0.1), 0.1, 1e-6);
+
+    wheel.release(entry2);
+    EXPECT_NEAR(wheel.time_until_next_s(start, 1.0), 0.3, 1e-6);
+}
+
+TEST(TimerWheel, ManyEntries)
+{
+    TimerWheel wheel;
+    const dl_time_t start = start_time();
+
+    const int num_entries = 1000;
+    for (int i = 0; i < num_entries; ++i) {
+        wheel.schedule(wheel.allocate(), start + std::chrono::milliseconds(i * 7));
+    }
+
+    std::vector<TimerWheel::Entry *> due;
+    for (int ms = 0; ms <= num_entries * 7; ms += 10) {
+        wheel.collect_due(start + std::chrono::milliseconds(ms), due);
+    }
+    wheel.collect_due(start + std::chrono::milliseconds(num_entries * 7 + 1), due);
+
+    EXPECT_EQ(due.size(), num_entries);
+    EXPECT_EQ(wheel.size(), 0);
+}
@@ -0,0 +1,156 @@
+#include "timesync.h"
+#include <cstdlib>
+
+namespace dronecore {
+
+constexpr int64_t Timesync::MAX_RTT_NS;
+constexpr int64_t Timesync::RTT_SLACK_NS;
+constexpr int64_t Timesync::RESET_THRESHOLD_NS;
+constexpr unsigned Timesync::NUM_SAMPLES_TO_RESET;
+constexpr unsigned Timesync::NUM_SAMPLES_TO_SYNC;
+constexpr double Timesync::OFFSET_GAIN;
+constexpr double Timesync::SKEW_GAIN;
+constexpr double Timesync::LATENCY_GAIN;
+
+void Timesync::add_sample(int64_t local_sent_ns, int64_t remote_ns, int64_t local_received_ns)
+{
+    const int64_t rtt_ns = local_received_ns - local_sent_ns;
+    if (rtt_ns < 0 || rtt_ns > MAX_RTT_NS) {
+        return;
+    }
+
+    // Assuming the way there took as long as the way back.
+    const int64_t local_ns = local_sent_ns + rtt_ns / 2;
+    const int64_t offset_ns = remote_ns - local_ns;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_num_samples == 0) {
+        restart(offset_ns, local_ns);
+        _min_rtt_ns = rtt_ns;
+        publish();
+        return;
+    }
+
+    // The fastest round trip is slowly forgotten, in case the link got slower.
+    if (rtt_ns < _min_rtt_ns) {
+        _min_rtt_ns = rtt_ns;
+    } else {
+        _min_rtt_ns += (rtt_ns - _min_rtt_ns) / 64;
+    }
+    if (rtt_ns > 2 * _min_rtt_ns + RTT_SLACK_NS) {
+        return;
+    }
+
+    const double elapsed_ns = double(local_ns - _ref_local_ns);
+    const int64_t predicted_ns = _offset_ns + int64_t(_skew * elapsed_ns);
+    const int64_t error_ns = offset_ns - predicted_ns;
+
+    if (std::llabs(error_ns) > RESET_THRESHOLD_NS) {
+        // A single one could still be an outlier.
+        if (++_num_off_samples >= NUM_SAMPLES_TO_RESET) {
+            restart(offset_ns, local_ns);
+            _min_rtt_ns = rtt_ns;
+            publish();
+        }
+        return;
+    }
+    _num_off_samples = 0;
+
+    _offset_ns = predicted_ns + int64_t(OFFSET_GAIN * double(error_ns));
+    if (elapsed_ns > 0.0) {
+        _skew += SKEW_GAIN * double(error_ns) / elapsed_ns;
+    }
+    _ref_local_ns = local_ns;
+    ++_num_samples;
+    publish();
+}
+
+bool Timesync::remote_to_local_ns(int64_t remote_ns, int64_t &local_ns) const
+{
+    if (!_synchronized.load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    unsigned seq;
+    int64_t offset_ns;
+    double skew;
+    int64_t ref_local_ns;
+    do {
+        seq = _seq.load(std::memory_order_acquire);
+        offset_ns = _published_offset_ns.load(std::memory_order_relaxed);
+        skew = _published_skew.load(std::memory_order_relaxed);
+        ref_local_ns = _published_ref_local_ns.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != _seq.load(std::memory_order_relaxed));
+
+    // The drift is small enough that the offset can be looked up at the
+    // roughly converted time.
+    const int64_t rough_local_ns = remote_ns - offset_ns;
+    local_ns = remote_ns - (offset_ns + int64_t(skew * double(rough_local_ns - ref_local_ns)));
+    return true;
+}
+
+void Timesync::add_message_time(int64_t remote_ns, int64_t local_received_ns)
+{
+    int64_t local_ns;
+    if (!remote_to_local_ns(remote_ns, local_ns)) {
+        return;
+    }
+    const double latency_s = double(local_received_ns - local_ns) * 1e-9;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    const double average_s = _latency_s.load(std::memory_order_relaxed);
+    _latency_s.store(std::isnan(average_s) ? latency_s :
+                     average_s + LATENCY_GAIN * (latency_s - average_s),
+                     std::memory_order_relaxed);
+}
+
+double Timesync::get_latency_s() const
+{
+    return _latency_s.load(std::memory_order_relaxed);
+}
+
+double Timesync::get_skew() const
+{
+    return _published_skew.load(std::memory_order_relaxed);
+}
+
+bool Timesync::is_synchronized() const
+{
+    return _synchronized.load(std::memory_order_acquire);
+}
+
+void Timesync::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _num_samples = 0;
+    _num_off_samples = 0;
+    _synchronized.store(false, std::memory_order_release);
+    _latency_s.store(NAN, std::memory_order_relaxed);
+}
+
+void Timesync::restart(int64_t offset_ns, int64_t local_ns)
+{
+    _offset_ns = offset_ns;
+    _skew = 0.0;
+    _ref_local_ns = local_ns;
+    _num_samples = 1;
+    _num_off_samples = 0;
+    _synchronized.store(false, std::memory_order_release);
+    _latency_s.store(NAN, std::memory_order_relaxed);
+}
+
+void Timesync::publish()
+{
+    _seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _published_offset_ns.store(_offset_ns, std::memory_order_relaxed);
+    _published_skew.store(_skew, std::memory_order_relaxed);
+    _published_ref_local_ns.store(_ref_local_ns, std::memory_order_relaxed);
+    _seq.fetch_add(1, std::memory_order_release);
+
+    _synchronized.store(_num_samples >= NUM_SAMPLES_TO_SYNC, std::memory_order_release);
+}
+
+} // namespace dronecore
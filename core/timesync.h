@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+namespace dronecore {
+
+// Estimates how the clock of a system relates to our steady clock from TIMESYNC
+// round trips, so that its timestamps (time_boot_ms, time_usec) can be converted.
+//
+// Each round trip gives the offset of the remote clock at the middle of the
+// round trip. Round trips much slower than the fastest seen lately are not
+// used, as it is unknown which direction the delay was in. The offset and its
+// drift are tracked with an alpha-beta filter, a jump of the offset (e.g. the
+// vehicle rebooted) restarts the estimate.
+//
+// Times are in nanoseconds, local ones of the steady clock.
+class Timesync
+{
+public:
+    Timesync() = default;
+    ~Timesync() = default;
+
+    void add_sample(int64_t local_sent_ns, int64_t remote_ns, int64_t local_received_ns);
+
+    // Lock-free, false until enough round trips were seen.
+    bool remote_to_local_ns(int64_t remote_ns, int64_t &local_ns) const;
+
+    // For the latency of a message, from the remote time it was sampled at.
+    void add_message_time(int64_t remote_ns, int64_t local_received_ns);
+    // Moving average, NAN as long as not synchronized.
+    double get_latency_s() const;
+
+    // Drift of the remote clock relative to ours, e.g. 1e-5 if it is 10 ppm faster.
+    double get_skew() const;
+    bool is_synchronized() const;
+
+    // Starts over, e.g. when the link timed out.
+    void reset();
+
+    // Round trips slower than this are ignored, whatever the link is.
+    static constexpr int64_t MAX_RTT_NS = 1000000000;
+    // Round trips are used up to twice the fastest plus this.
+    static constexpr int64_t RTT_SLACK_NS = 2000000;
+    // Offset changes bigger than this are not drift but a new clock.
+    static constexpr int64_t RESET_THRESHOLD_NS = 100000000;
+    // So many off samples in a row restart the estimate.
+    static constexpr unsigned NUM_SAMPLES_TO_RESET = 3;
+    static constexpr unsigned NUM_SAMPLES_TO_SYNC = 5;
+    static constexpr double OFFSET_GAIN = 0.1;
+    static constexpr double SKEW_GAIN = 0.01;
+    static constexpr double LATENCY_GAIN = 0.05;
+
+    // Non-copyable
+    Timesync(const Timesync &) = delete;
+    const Timesync &operator=(const Timesync &) = delete;
+
+private:
+    // Needs to be called with _mutex locked.
+    void publish();
+    void restart(int64_t offset_ns, int64_t local_ns);
+
+    std::mutex _mutex {};
+    int64_t _offset_ns {0};
+    double _skew {0.0};
+    int64_t _ref_local_ns {0};
+    int64_t _min_rtt_ns {0};
+    unsigned _num_samples {0};
+    unsigned _num_off_samples {0};
+
+    // The estimate for readers, consistent if _seq was even and the same
+    // before and after reading.
+    std::atomic<unsigned> _seq {0};
+    std::atomic<int64_t> _published_offset_ns {0};
+    std::atomic<double> _published_skew {0.0};
+    std::atomic<int64_t> _published_ref_local_ns {0};
+    std::atomic<bool> _synchronized {false};
+
+    std::atomic<double> _latency_s {NAN};
+};
+
+} // namespace dronecore
@@ -0,0 +1,127 @@
+#include "timesync.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+
+using namespace dronecore;
+
+namespace {
+
+// A remote clock which started at some point and runs slightly fast.
+struct RemoteClock {
+    int64_t start_local_ns;
+    double skew;
+
+    int64_t at(int64_t local_ns) const
+    {
+        return int64_t(double(local_ns - start_local_ns) * (1.0 + skew));
+    }
+};
+
+constexpr int64_t SECOND_NS = 1000000000;
+constexpr int64_t MILLISECOND_NS = 1000000;
+
+// Round trips once a second with jittery but symmetric delays.
+int64_t run_round_trips(Timesync &timesync, const RemoteClock &remote, int64_t local_ns,
+                        unsigned num, std::mt19937 &random)
+{
+    std::uniform_int_distribution<int64_t> delay_ns(5 * MILLISECOND_NS, 6 * MILLISECOND_NS);
+    for (unsigned i = 0; i < num; ++i) {
+        const int64_t delay = delay_ns(random);
+        timesync.add_sample(local_ns, remote.at(local_ns + delay), local_ns + 2 * delay);
+        local_ns += SECOND_NS;
+    }
+    return local_ns;
+}
+
+} // namespace
+
+TEST(Timesync, NotSynchronizedAtFirst)
+{
+    Timesync timesync;
+    int64_t local_ns;
+    EXPECT_FALSE(timesync.remote_to_local_ns(0, local_ns));
+    EXPECT_FALSE(timesync.is_synchronized());
+    EXPECT_TRUE(std::isnan(timesync.get_latency_s()));
+}
+
+TEST(Timesync, ConvertsWithOffsetAndDrift)
+{
+    Timesync timesync;
+    std::mt19937 random(42);
+    const RemoteClock remote {1000 * SECOND_NS, 50e-6};
+
+    const int64_t now_ns = run_round_trips(timesync, remote, 2000 * SECOND_NS, 600, random);
+    ASSERT_TRUE(timesync.is_synchronized());
+    EXPECT_NEAR(timesync.get_skew(), 50e-6, 5e-6);
+
+    // Also a bit into the future, the drift is accounted for.
+    for (int64_t local_ns : {now_ns, now_ns + 10 * SECOND_NS}) {
+        int64_t converted_ns;
+        ASSERT_TRUE(timesync.remote_to_local_ns(remote.at(local_ns), converted_ns));
+        EXPECT_LT(std::llabs(converted_ns - local_ns), MILLISECOND_NS / 2);
+    }
+}
+
+TEST(Timesync, IgnoresSlowRoundTrips)
+{
+    Timesync timesync;
+    std::mt19937 random(1);
+    const RemoteClock remote {0, 0.0};
+
+    int64_t local_ns = run_round_trips(timesync, remote, 100 * SECOND_NS, 20, random);
+
+    // Delayed on the way back only, which would shift the offset by 100 ms.
+    for (int i = 0; i < 10; ++i) {
+        timesync.add_sample(local_ns, remote.at(local_ns + 5 * MILLISECOND_NS),
+                            local_ns + 205 * MILLISECOND_NS);
+        local_ns += SECOND_NS;
+    }
+
+    int64_t converted_ns;
+    ASSERT_TRUE(timesync.remote_to_local_ns(remote.at(local_ns), converted_ns));
+    EXPECT_LT(std::llabs(converted_ns - local_ns), MILLISECOND_NS);
+}
+
+TEST(Timesync, StartsOverWhenTheRemoteRestarts)
+{
+    Timesync timesync;
+    std::mt19937 random(2);
+
+    int64_t local_ns = run_round_trips(timesync, RemoteClock {0, 0.0}, 100 * SECOND_NS, 20,
+                                       random);
+    ASSERT_TRUE(timesync.is_synchronized());
+
+    // Rebooted, its clock starts from 0 again.
+    const RemoteClock rebooted {local_ns, 0.0};
+    local_ns = run_round_trips(timesync, rebooted, local_ns, Timesync::NUM_SAMPLES_TO_RESET,
+                               random);
+    EXPECT_FALSE(timesync.is_synchronized());
+
+    local_ns = run_round_trips(timesync, rebooted, local_ns, Timesync::NUM_SAMPLES_TO_SYNC,
+                               random);
+    int64_t converted_ns;
+    ASSERT_TRUE(timesync.remote_to_local_ns(rebooted.at(local_ns), converted_ns));
+    EXPECT_LT(std::llabs(converted_ns - local_ns), MILLISECOND_NS);
+}
+
+TEST(Timesync, AveragesLatency)
+{
+    Timesync timesync;
+    std::mt19937 random(3);
+    const RemoteClock remote {0, 0.0};
+
+    int64_t local_ns = run_round_trips(timesync, remote, 100 * SECOND_NS, 20, random);
+
+    // Sampled 30 ms before it arrives.
+    for (int i = 0; i < 100; ++i) {
+        timesync.add_message_time(remote.at(local_ns), local_ns + 30 * MILLISECOND_NS);
+        local_ns += 10 * MILLISECOND_NS;
+    }
+    EXPECT_NEAR(timesync.get_latency_s(), 0.03, 0.001);
+
+    timesync.reset();
+    EXPECT_FALSE(timesync.is_synchronized());
+    EXPECT_TRUE(std::isnan(timesync.get_latency_s()));
+}
@@ -0,0 +1,235 @@
+#include "tlog_columns.h"
+#include "global_include.h"
+#include "log.h"
+#include "mavlink_include.h"
+#include "tlog_reader.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace dronecore {
+
+namespace {
+
+// Where a message of interest is in the log.
+struct MessageRef {
+    uint64_t time_us;
+    const uint8_t *payload;
+    uint8_t payload_len;
+    uint8_t system_id;
+};
+
+// MAVLink 2 cuts trailing zeros off the payload, those read as 0.
+template <class T>
+T read_field(const MessageRef &ref, size_t offset)
+{
+    uint8_t bytes[sizeof(T)] {};
+    for (size_t i = 0; i < sizeof(T) && offset + i < ref.payload_len; ++i) {
+        bytes[i] = ref.payload[offset + i];
+    }
+    // Little-endian on the wire, as on all platforms we build for.
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+// Fills a column from one field of all messages, f converts the field.
+template <class T, class C, class F>
+void decode_column(const std::vector<MessageRef> &refs, size_t offset, std::vector<C> &column,
+                   F f)
+{
+    column.resize(refs.size());
+    for (size_t i = 0; i < refs.size(); ++i) {
+        column[i] = f(read_field<T>(refs[i], offset));
+    }
+}
+
+void decode_common(const std::vector<MessageRef> &refs, std::vector<uint64_t> &time_us,
+                   std::vector<uint8_t> &system_id)
+{
+    time_us.resize(refs.size());
+    system_id.resize(refs.size());
+    for (size_t i = 0; i < refs.size(); ++i) {
+        time_us[i] = refs[i].time_us;
+        system_id[i] = refs[i].system_id;
+    }
+}
+
+// Payload offsets, the fields are on the wire ordered by size.
+namespace global_position_int_offset {
+constexpr size_t LAT = 4;
+constexpr size_t LON = 8;
+constexpr size_t ALT = 12;
+constexpr size_t RELATIVE_ALT = 16;
+}
+
+namespace attitude_offset {
+constexpr size_t ROLL = 4;
+constexpr size_t PITCH = 8;
+constexpr size_t YAW = 12;
+}
+
+namespace sys_status_offset {
+constexpr size_t VOLTAGE_BATTERY = 14;
+constexpr size_t BATTERY_REMAINING = 30;
+}
+
+template <class T>
+bool write_npy_file(const std::string &path, const char *descr, const std::vector<T> &column)
+{
+    // Format version 1.0: magic, version, header length and the header,
+    // padded with spaces to a multiple of 64 bytes and ending with a newline.
+    std::string header = std::string("{'descr': '") + descr +
+                         "', 'fortran_order': False, 'shape': (" +
+                         std::to_string(column.size()) + ",), }";
+    const size_t preamble_len = 10;
+    const size_t padded_len = (preamble_len + header.size() + 1 + 63) / 64 * 64;
+    header.append(padded_len - preamble_len - header.size() - 1, ' ');
+    header.push_back('\n');
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        LogErr() << "Could not open " << path;
+        return false;
+    }
+
+    const uint8_t preamble[preamble_len] = {
+        0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+        static_cast<uint8_t>(header.size() & 0xff), static_cast<uint8_t>(header.size() >> 8)
+    };
+    // As it is in memory, little-endian like the descr says.
+    const bool ok = std::fwrite(preamble, 1, preamble_len, file) == preamble_len &&
+                    std::fwrite(header.data(), 1, header.size(), file) == header.size() &&
+                    std::fwrite(column.data(), sizeof(T), column.size(), file) == column.size();
+    if (std::fclose(file) != 0 || !ok) {
+        LogErr() << "Could not write " << path;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool TlogColumns::read(const std::string &path)
+{
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        LogErr() << "Could not open " << path;
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t buffer[65536];
+    size_t len;
+    while ((len = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + len);
+    }
+    const bool failed = std::ferror(file) != 0;
+    std::fclose(file);
+    if (failed) {
+        LogErr() << "Could not read " << path;
+        return false;
+    }
+
+    decode(data.data(), data.size());
+    return true;
+}
+
+void TlogColumns::decode(const uint8_t *data, size_t len)
+{
+    std::vector<MessageRef> positions;
+    std::vector<MessageRef> attitudes;
+    std::vector<MessageRef> sys_statuses;
+
+    TlogReader reader(data, len);
+    uint64_t time_us;
+    const uint8_t *frame;
+    size_t frame_len;
+    while (reader.next(time_us, frame, frame_len)) {
+        MessageRef ref {time_us, nullptr, frame[1], 0};
+        uint32_t message_id;
+        if (frame[0] == MAVLINK_STX_MAVLINK1) {
+            ref.system_id = frame[3];
+            message_id = frame[5];
+            ref.payload = frame + 1 + MAVLINK_CORE_HEADER_MAVLINK1_LEN;
+        } else {
+            ref.system_id = frame[5];
+            message_id = frame[7] | (uint32_t(frame[8]) << 8) | (uint32_t(frame[9]) << 16);
+            ref.payload = frame + 1 + MAVLINK_CORE_HEADER_LEN;
+        }
+
+        switch (message_id) {
+            case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
+                positions.push_back(ref);
+                break;
+            case MAVLINK_MSG_ID_ATTITUDE:
+                attitudes.push_back(ref);
+                break;
+            case MAVLINK_MSG_ID_SYS_STATUS:
+                sys_statuses.push_back(ref);
+                break;
+            default:
+                break;
+        }
+    }
+
+    decode_common(positions, position.time_us, position.system_id);
+    decode_column<int32_t>(positions, global_position_int_offset::LAT, position.latitude_deg,
+    [](int32_t lat) { return lat * 1e-7; });
+    decode_column<int32_t>(positions, global_position_int_offset::LON, position.longitude_deg,
+    [](int32_t lon) { return lon * 1e-7; });
+    decode_column<int32_t>(positions, global_position_int_offset::ALT, position.absolute_altitude_m,
+    [](int32_t alt) { return alt * 1e-3f; });
+    decode_column<int32_t>(positions, global_position_int_offset::RELATIVE_ALT,
+                           position.relative_altitude_m,
+    [](int32_t relative_alt) { return relative_alt * 1e-3f; });
+
+    decode_common(attitudes, attitude.time_us, attitude.system_id);
+    decode_column<float>(attitudes, attitude_offset::ROLL, attitude.roll_deg, [](float roll) {
+        return to_deg_from_rad(roll);
+    });
+    decode_column<float>(attitudes, attitude_offset::PITCH, attitude.pitch_deg, [](float pitch) {
+        return to_deg_from_rad(pitch);
+    });
+    decode_column<float>(attitudes, attitude_offset::YAW, attitude.yaw_deg, [](float yaw) {
+        return to_deg_from_rad(yaw);
+    });
+
+    decode_common(sys_statuses, battery.time_us, battery.system_id);
+    decode_column<uint16_t>(sys_statuses, sys_status_offset::VOLTAGE_BATTERY, battery.voltage_v,
+    [](uint16_t voltage) {
+        return (voltage == UINT16_MAX) ? NAN : voltage * 1e-3f;
+    });
+    // -1 if the autopilot doesn't estimate it.
+    decode_column<int8_t>(sys_statuses, sys_status_offset::BATTERY_REMAINING,
+                          battery.remaining_percent, [](int8_t remaining) {
+        return (remaining < 0) ? NAN : remaining * 1e-2f;
+    });
+}
+
+bool TlogColumns::write_npy(const std::string &directory) const
+{
+    const std::string prefix = directory + "/";
+    return write_npy_file(prefix + "position.time_us.npy", "<u8", position.time_us) &&
+           write_npy_file(prefix + "position.system_id.npy", "|u1", position.system_id) &&
+           write_npy_file(prefix + "position.latitude_deg.npy", "<f8", position.latitude_deg) &&
+           write_npy_file(prefix + "position.longitude_deg.npy", "<f8",
+                          position.longitude_deg) &&
+           write_npy_file(prefix + "position.absolute_altitude_m.npy", "<f4",
+                          position.absolute_altitude_m) &&
+           write_npy_file(prefix + "position.relative_altitude_m.npy", "<f4",
+                          position.relative_altitude_m) &&
+           write_npy_file(prefix + "attitude.time_us.npy", "<u8", attitude.time_us) &&
+           write_npy_file(prefix + "attitude.system_id.npy", "|u1", attitude.system_id) &&
+           write_npy_file(prefix + "attitude.roll_deg.npy", "<f4", attitude.roll_deg) &&
+           write_npy_file(prefix + "attitude.pitch_deg.npy", "<f4", attitude.pitch_deg) &&
+           write_npy_file(prefix + "attitude.yaw_deg.npy", "<f4", attitude.yaw_deg) &&
+           write_npy_file(prefix + "battery.time_us.npy", "<u8", battery.time_us) &&
+           write_npy_file(prefix + "battery.system_id.npy", "|u1", battery.system_id) &&
+           write_npy_file(prefix + "battery.voltage_v.npy", "<f4", battery.voltage_v) &&
+           write_npy_file(prefix + "battery.remaining_percent.npy", "<f4",
+                          battery.remaining_percent);
+}
+
+} // namespace dronecore
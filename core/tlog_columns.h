@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+/**
+ * @brief Telemetry of a recorded telemetry log (.tlog) decoded into columns, for analytics.
+ *
+ * Every table has one vector per field, all of the same length: row `i` is the `i`-th
+ * message of that kind in the log, from any system. The vectors can be handed to
+ * columnar formats such as Apache Arrow as they are, or written with write_npy().
+ *
+ * Logs are decoded column by column rather than message by message: the messages of a
+ * kind are found first, then each field is read from all of them in one loop.
+ */
+class TlogColumns
+{
+public:
+    /**
+     * @brief Positions, from GLOBAL_POSITION_INT.
+     */
+    struct Position {
+        std::vector<uint64_t> time_us {}; /**< @brief Receive time since the Unix epoch. */
+        std::vector<uint8_t> system_id {}; /**< @brief System ID of the sender. */
+        std::vector<double> latitude_deg {}; /**< @brief Latitude in degrees. */
+        std::vector<double> longitude_deg {}; /**< @brief Longitude in degrees. */
+        std::vector<float> absolute_altitude_m {}; /**< @brief Altitude AMSL in metres. */
+        std::vector<float> relative_altitude_m {}; /**< @brief Altitude above takeoff. */
+    };
+
+    /**
+     * @brief Attitudes, from ATTITUDE.
+     */
+    struct Attitude {
+        std::vector<uint64_t> time_us {}; /**< @brief Receive time since the Unix epoch. */
+        std::vector<uint8_t> system_id {}; /**< @brief System ID of the sender. */
+        std::vector<float> roll_deg {}; /**< @brief Roll angle in degrees. */
+        std::vector<float> pitch_deg {}; /**< @brief Pitch angle in degrees. */
+        std::vector<float> yaw_deg {}; /**< @brief Yaw angle in degrees. */
+    };
+
+    /**
+     * @brief Battery states, from SYS_STATUS.
+     */
+    struct Battery {
+        std::vector<uint64_t> time_us {}; /**< @brief Receive time since the Unix epoch. */
+        std::vector<uint8_t> system_id {}; /**< @brief System ID of the sender. */
+        std::vector<float> voltage_v {}; /**< @brief Voltage in volts, NAN if unknown. */
+        /** @brief Remaining (range: 0.0 to 1.0), NAN if unknown. */
+        std::vector<float> remaining_percent {};
+    };
+
+    Position position {}; /**< @brief The positions in the log. */
+    Attitude attitude {}; /**< @brief The attitudes in the log. */
+    Battery battery {}; /**< @brief The battery states in the log. */
+
+    /**
+     * @brief Decodes a log file, replacing what was decoded before.
+     *
+     * @param path Path of the .tlog file.
+     * @return `false` if the file can't be read.
+     */
+    bool read(const std::string &path);
+
+    /**
+     * @brief Decodes a log in memory, replacing what was decoded before.
+     *
+     * @param data The log as written to the file.
+     * @param len Length of the log in bytes.
+     */
+    void decode(const uint8_t *data, size_t len);
+
+    /**
+     * @brief Writes every column to a NumPy `.npy` file of its own.
+     *
+     * The files are named after table and field, e.g. `position.latitude_deg.npy`, and
+     * can be memory-mapped with `numpy.load(path, mmap_mode='r')` and wrapped by
+     * `pyarrow` or `pandas` without converting them.
+     *
+     * @param directory Existing directory to write the files to.
+     * @return `false` if a file can't be written.
+     */
+    bool write_npy(const std::string &directory) const;
+};
+
+} // namespace dronecore
@@ -0,0 +1,140 @@
+#include "tlog_columns.h"
+#include "mavlink_include.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(LINUX) || defined(APPLE)
+#include <unistd.h>
+#endif
+
+using namespace dronecore;
+
+static void append_message(std::vector<uint8_t> &log, uint64_t time_us,
+                           const mavlink_message_t &message)
+{
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        log.push_back(uint8_t(time_us >> shift));
+    }
+
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+    log.insert(log.end(), buffer, buffer + len);
+}
+
+static std::vector<uint8_t> make_log()
+{
+    std::vector<uint8_t> log;
+    mavlink_message_t message;
+
+    mavlink_msg_heartbeat_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                               MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+    append_message(log, 1000000, message);
+
+    mavlink_msg_global_position_int_pack(1, MAV_COMP_ID_AUTOPILOT1, &message, 100,
+                                         473977418, 85455939, 488000, 10000, 0, 0, 0, 0);
+    append_message(log, 1010000, message);
+
+    mavlink_msg_attitude_pack(2, MAV_COMP_ID_AUTOPILOT1, &message, 100,
+                              0.1f, -0.2f, 1.5f, 0.0f, 0.0f, 0.0f);
+    append_message(log, 1020000, message);
+
+    // Everything after the battery voltage is 0, which MAVLink 2 cuts off.
+    mavlink_msg_sys_status_pack(1, MAV_COMP_ID_AUTOPILOT1, &message,
+                                0, 0, 0, 0, 12150, 0, 0, 0, 0, 0, 0, 0, 0);
+    append_message(log, 1030000, message);
+
+    mavlink_msg_global_position_int_pack(2, MAV_COMP_ID_AUTOPILOT1, &message, 120,
+                                         -338688300, 1512093000, -5000, 0, 0, 0, 0, 0);
+    append_message(log, 1040000, message);
+
+    mavlink_msg_sys_status_pack(2, MAV_COMP_ID_AUTOPILOT1, &message,
+                                0, 0, 0, 0, UINT16_MAX, -1, -1, 0, 0, 0, 0, 0, 0);
+    append_message(log, 1050000, message);
+
+    return log;
+}
+
+TEST(TlogColumns, DecodesColumnByColumn)
+{
+    const std::vector<uint8_t> log = make_log();
+    TlogColumns columns;
+    columns.decode(log.data(), log.size());
+
+    ASSERT_EQ(columns.position.time_us.size(), 2u);
+    EXPECT_EQ(columns.position.time_us, (std::vector<uint64_t> {1010000, 1040000}));
+    EXPECT_EQ(columns.position.system_id, (std::vector<uint8_t> {1, 2}));
+    EXPECT_DOUBLE_EQ(columns.position.latitude_deg[0], 47.3977418);
+    EXPECT_DOUBLE_EQ(columns.position.longitude_deg[1], 151.2093);
+    EXPECT_FLOAT_EQ(columns.position.absolute_altitude_m[0], 488.0f);
+    EXPECT_FLOAT_EQ(columns.position.absolute_altitude_m[1], -5.0f);
+    EXPECT_FLOAT_EQ(columns.position.relative_altitude_m[0], 10.0f);
+    EXPECT_FLOAT_EQ(columns.position.relative_altitude_m[1], 0.0f);
+
+    ASSERT_EQ(columns.attitude.time_us.size(), 1u);
+    EXPECT_EQ(columns.attitude.system_id[0], 2);
+    EXPECT_NEAR(columns.attitude.roll_deg[0], 5.7296f, 1e-3f);
+    EXPECT_NEAR(columns.attitude.pitch_deg[0], -11.4592f, 1e-3f);
+    EXPECT_NEAR(columns.attitude.yaw_deg[0], 85.9437f, 1e-3f);
+
+    ASSERT_EQ(columns.battery.time_us.size(), 2u);
+    EXPECT_FLOAT_EQ(columns.battery.voltage_v[0], 12.15f);
+    EXPECT_FLOAT_EQ(columns.battery.remaining_percent[0], 0.0f);
+    EXPECT_TRUE(std::isnan(columns.battery.voltage_v[1]));
+    EXPECT_TRUE(std::isnan(columns.battery.remaining_percent[1]));
+
+    // Decoding again replaces it.
+    columns.decode(log.data(), 0);
+    EXPECT_TRUE(columns.position.time_us.empty());
+    EXPECT_TRUE(columns.battery.remaining_percent.empty());
+}
+
+#if defined(LINUX) || defined(APPLE)
+TEST(TlogColumns, WritesNpyFiles)
+{
+    const std::vector<uint8_t> log = make_log();
+    TlogColumns columns;
+    columns.decode(log.data(), log.size());
+
+    char directory[] = "/tmp/dronecore_tlog_columns_XXXXXX";
+    ASSERT_NE(mkdtemp(directory), nullptr);
+    ASSERT_TRUE(columns.write_npy(directory));
+    EXPECT_FALSE(columns.write_npy(std::string(directory) + "/missing"));
+
+    const std::string path = std::string(directory) + "/position.latitude_deg.npy";
+    std::FILE *file = std::fopen(path.c_str(), "rb");
+    ASSERT_NE(file, nullptr);
+    std::vector<uint8_t> content(4096);
+    content.resize(std::fread(content.data(), 1, content.size(), file));
+    std::fclose(file);
+
+    ASSERT_GT(content.size(), 10u);
+    EXPECT_EQ(std::string(content.begin() + 1, content.begin() + 6), "NUMPY");
+    const size_t header_len = content[8] | (size_t(content[9]) << 8);
+    EXPECT_EQ((10 + header_len) % 64, 0u);
+    const std::string header(content.begin() + 10, content.begin() + 10 + header_len);
+    EXPECT_NE(header.find("'descr': '<f8'"), std::string::npos);
+    EXPECT_NE(header.find("'shape': (2,)"), std::string::npos);
+    EXPECT_EQ(header.back(), '\n');
+    ASSERT_EQ(content.size(), 10 + header_len + 2 * sizeof(double));
+
+    double latitude_deg[2];
+    std::memcpy(latitude_deg, &content[10 + header_len], sizeof(latitude_deg));
+    EXPECT_DOUBLE_EQ(latitude_deg[0], 47.3977418);
+
+    const char *names[] = {
+        "position.time_us", "position.system_id", "position.latitude_deg",
+        "position.longitude_deg", "position.absolute_altitude_m",
+        "position.relative_altitude_m", "attitude.time_us", "attitude.system_id",
+        "attitude.roll_deg", "attitude.pitch_deg", "attitude.yaw_deg", "battery.time_us",
+        "battery.system_id", "battery.voltage_v", "battery.remaining_percent"
+    };
+    for (const char *name : names) {
+        EXPECT_EQ(std::remove((std::string(directory) + "/" + name + ".npy").c_str()), 0) << name;
+    }
+    rmdir(directory);
+}
+#endif
@@ -0,0 +1,69 @@
+#include "tlog_reader.h"
+#include "mavlink_include.h"
+
+namespace dronecore {
+
+constexpr size_t TlogReader::TIMESTAMP_LEN;
+
+TlogReader::TlogReader(const uint8_t *data, size_t len) :
+    _data(data),
+    _len(len)
+{}
+
+bool TlogReader::next(uint64_t &time_us, const uint8_t *&frame, size_t &frame_len)
+{
+    while (_pos + TIMESTAMP_LEN < _len) {
+        const uint8_t *record = _data + _pos;
+        const size_t len = get_frame_len(record + TIMESTAMP_LEN, _len - _pos - TIMESTAMP_LEN);
+
+        if (len == 0) {
+            // Look for the next record one byte further on.
+            ++_pos;
+            ++_num_bytes_skipped;
+            continue;
+        }
+
+        time_us = 0;
+        for (size_t i = 0; i < TIMESTAMP_LEN; ++i) {
+            time_us = (time_us << 8) | record[i];
+        }
+        frame = record + TIMESTAMP_LEN;
+        frame_len = len;
+
+        _pos += TIMESTAMP_LEN + len;
+        return true;
+    }
+
+    _num_bytes_skipped += _len - _pos;
+    _pos = _len;
+    return false;
+}
+
+size_t TlogReader::get_frame_len(const uint8_t *frame, size_t available_len)
+{
+    if (available_len < 3) {
+        return 0;
+    }
+
+    const size_t payload_len = frame[1];
+    size_t len = 0;
+
+    if (frame[0] == MAVLINK_STX_MAVLINK1) {
+        len = 1 + MAVLINK_CORE_HEADER_MAVLINK1_LEN + payload_len + 2;
+    } else if (frame[0] == MAVLINK_STX) {
+        len = 1 + MAVLINK_CORE_HEADER_LEN + payload_len + 2;
+        if (frame[2] & MAVLINK_IFLAG_SIGNED) {
+            len += MAVLINK_SIGNATURE_BLOCK_LEN;
+        }
+    } else {
+        return 0;
+    }
+
+    // A frame cut off at the end of the log.
+    if (len > available_len) {
+        return 0;
+    }
+    return len;
+}
+
+} // namespace dronecore
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dronecore {
+
+// Splits a telemetry log (.tlog, as written by QGroundControl or MAVProxy)
+// into its frames without copying. Every frame is preceded by its receive
+// time in microseconds since the Unix epoch, big-endian. Bytes which don't
+// make up a frame, e.g. of a log cut off while writing, are skipped.
+class TlogReader
+{
+public:
+    TlogReader(const uint8_t *data, size_t len);
+
+    // Returns false at the end of the log. The frame points into the data.
+    bool next(uint64_t &time_us, const uint8_t *&frame, size_t &frame_len);
+
+    size_t num_bytes_skipped() const { return _num_bytes_skipped; }
+
+    // Non-copyable
+    TlogReader(const TlogReader &) = delete;
+    const TlogReader &operator=(const TlogReader &) = delete;
+
+private:
+    // Returns 0 if there is no frame start.
+    static size_t get_frame_len(const uint8_t *frame, size_t available_len);
+
+    static constexpr size_t TIMESTAMP_LEN = 8;
+
+    const uint8_t *_data;
+    const size_t _len;
+    size_t _pos {0};
+    size_t _num_bytes_skipped {0};
+};
+
+} // namespace dronecore
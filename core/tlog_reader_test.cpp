@@ -0,0 +1,67 @@
+#include "tlog_reader.h"
+#include "mavlink_include.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+static void append_heartbeat(std::vector<uint8_t> &log, uint64_t time_us, uint8_t sysid)
+{
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        log.push_back(uint8_t(time_us >> shift));
+    }
+
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(sysid, MAV_COMP_ID_AUTOPILOT1, &message,
+                               MAV_TYPE_GENERIC, MAV_AUTOPILOT_GENERIC, 0, 0, 0);
+
+    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    const uint16_t len = mavlink_msg_to_send_buffer(buffer, &message);
+    log.insert(log.end(), buffer, buffer + len);
+}
+
+TEST(TlogReader, SplitsFrames)
+{
+    std::vector<uint8_t> log;
+    append_heartbeat(log, 1000000, 1);
+    append_heartbeat(log, 1020000, 2);
+
+    TlogReader reader(log.data(), log.size());
+
+    uint64_t time_us;
+    const uint8_t *frame;
+    size_t frame_len;
+
+    ASSERT_TRUE(reader.next(time_us, frame, frame_len));
+    EXPECT_EQ(time_us, 1000000u);
+    EXPECT_EQ(frame, log.data() + 8);
+    EXPECT_EQ(frame[0], MAVLINK_STX);
+
+    ASSERT_TRUE(reader.next(time_us, frame, frame_len));
+    EXPECT_EQ(time_us, 1020000u);
+    EXPECT_EQ(frame + frame_len, log.data() + log.size());
+
+    EXPECT_FALSE(reader.next(time_us, frame, frame_len));
+    EXPECT_EQ(reader.num_bytes_skipped(), 0u);
+}
+
+TEST(TlogReader, SkipsGarbage)
+{
+    std::vector<uint8_t> log {0x00, 0x12, 0x34};
+    append_heartbeat(log, 5, 1);
+    append_heartbeat(log, 6, 1);
+    // Cut off in the middle of the last frame.
+    log.resize(log.size() - 4);
+
+    TlogReader reader(log.data(), log.size());
+
+    uint64_t time_us;
+    const uint8_t *frame;
+    size_t frame_len;
+
+    ASSERT_TRUE(reader.next(time_us, frame, frame_len));
+    EXPECT_EQ(time_us, 5u);
+
+    EXPECT_FALSE(reader.next(time_us, frame, frame_len));
+    EXPECT_GT(reader.num_bytes_skipped(), 3u);
+}
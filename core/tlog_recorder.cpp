@@ -0,0 +1,220 @@
+#include "tlog_recorder.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "thread_setup.h"
+
+namespace dronecore {
+
+constexpr uint32_t TlogRecorder::BUFFER_SIZE;
+constexpr std::chrono::milliseconds TlogRecorder::FLUSH_INTERVAL;
+constexpr size_t TlogRecorder::TIMESTAMP_LEN;
+constexpr unsigned TlogRecorder::GENERATION_SHIFT;
+constexpr uint64_t TlogRecorder::RESERVED_MASK;
+
+TlogRecorder::TlogRecorder() {}
+
+TlogRecorder::~TlogRecorder()
+{
+    stop();
+}
+
+bool TlogRecorder::start(const std::string &path)
+{
+    stop();
+
+    _file = std::fopen(path.c_str(), "wb");
+    if (_file == nullptr) {
+        return false;
+    }
+    // Buffers are written whole, buffering them in stdio would only copy them again.
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+
+    for (auto &buffer : _buffers) {
+        // Only allocated once something is recorded.
+        if (buffer.data == nullptr) {
+            buffer.data = std::unique_ptr<uint8_t[]>(new uint8_t[BUFFER_SIZE]);
+        }
+        buffer.done = 0;
+        buffer.end = BUFFER_SIZE;
+        buffer.reserved = 0;
+        buffer.full = false;
+    }
+    _state = 0;
+    _frames_recorded = 0;
+    _frames_dropped = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = false;
+        _bytes_written = 0;
+        _write_failed = false;
+    }
+
+    _writer_thread = new std::thread(writer_thread, this);
+    _recording = true;
+    return true;
+}
+
+void TlogRecorder::stop()
+{
+    if (_writer_thread == nullptr) {
+        return;
+    }
+
+    _recording = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+    }
+    _cv.notify_one();
+
+    _writer_thread->join();
+    delete _writer_thread;
+    _writer_thread = nullptr;
+
+    std::fclose(_file);
+    _file = nullptr;
+}
+
+void TlogRecorder::record(const uint8_t *frame, size_t frame_len)
+{
+    if (!is_recording()) {
+        return;
+    }
+
+    record(frame, frame_len, static_cast<uint64_t>(
+               std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count()));
+}
+
+void TlogRecorder::record(const uint8_t *frame, size_t frame_len, uint64_t time_us)
+{
+    if (!is_recording() || frame_len > BUFFER_SIZE - TIMESTAMP_LEN) {
+        return;
+    }
+
+    // Tried again once the buffers are swapped.
+    const uint32_t len = static_cast<uint32_t>(frame_len);
+    if (!try_record(frame, len, time_us) && !try_record(frame, len, time_us)) {
+        _frames_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+TlogRecorder::Stats TlogRecorder::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Stats stats {};
+    stats.frames_recorded = _frames_recorded.load(std::memory_order_relaxed);
+    stats.frames_dropped = _frames_dropped.load(std::memory_order_relaxed);
+    stats.bytes_written = _bytes_written;
+    stats.write_failed = _write_failed;
+    return stats;
+}
+
+bool TlogRecorder::try_record(const uint8_t *frame, uint32_t frame_len, uint64_t time_us)
+{
+    const uint32_t record_len = static_cast<uint32_t>(TIMESTAMP_LEN) + frame_len;
+    const uint64_t state = _state.fetch_add(record_len, std::memory_order_acq_rel);
+    Buffer &buffer = buffer_of(state);
+    const uint32_t offset = static_cast<uint32_t>(state & RESERVED_MASK);
+
+    if (uint64_t(offset) + record_len <= BUFFER_SIZE) {
+        uint8_t *record = buffer.data.get() + offset;
+        for (size_t i = 0; i < TIMESTAMP_LEN; ++i) {
+            record[i] = static_cast<uint8_t>(time_us >> (8 * (TIMESTAMP_LEN - 1 - i)));
+        }
+        std::memcpy(record + TIMESTAMP_LEN, frame, frame_len);
+        buffer.done.fetch_add(record_len, std::memory_order_release);
+        _frames_recorded.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Records are contiguous, so the data ends where the first one without space begins.
+    uint32_t end = buffer.end.load(std::memory_order_relaxed);
+    while (offset < end &&
+           !buffer.end.compare_exchange_weak(end, offset, std::memory_order_relaxed)) {}
+    buffer.done.fetch_add(record_len, std::memory_order_release);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    // Unless someone else swapped already.
+    if ((_state.load() >> GENERATION_SHIFT) == (state >> GENERATION_SHIFT)) {
+        swap_buffers();
+    }
+    return false;
+}
+
+bool TlogRecorder::swap_buffers()
+{
+    const uint64_t generation = _state.load() >> GENERATION_SHIFT;
+    Buffer &next = _buffers[(generation + 1) % 2];
+    if (next.full) {
+        return false;
+    }
+    next.done = 0;
+    next.end = BUFFER_SIZE;
+
+    const uint64_t state = _state.exchange((generation + 1) << GENERATION_SHIFT);
+    Buffer &current = buffer_of(state);
+    current.reserved = static_cast<uint32_t>(state & RESERVED_MASK);
+    current.full = true;
+    _cv.notify_one();
+    return true;
+}
+
+void TlogRecorder::writer_thread(TlogRecorder *self)
+{
+    setup_thread(ThreadRole::Background, "tlog_writer");
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+    bool flush_due = false;
+    while (true) {
+        Buffer *full = nullptr;
+        for (auto &buffer : self->_buffers) {
+            if (buffer.full) {
+                full = &buffer;
+            }
+        }
+
+        if (full == nullptr) {
+            const bool has_data = (self->_state.load() & RESERVED_MASK) > 0;
+            if (has_data && (flush_due || self->_should_exit)) {
+                self->swap_buffers();
+                flush_due = false;
+                continue;
+            }
+            // Only exits once everything is written.
+            if (self->_should_exit) {
+                break;
+            }
+            flush_due = (self->_cv.wait_for(lock, FLUSH_INTERVAL) == std::cv_status::timeout);
+            continue;
+        }
+
+        const uint32_t reserved = full->reserved;
+        lock.unlock();
+
+        // Records which got their space before the swap might still be copied.
+        while (full->done.load(std::memory_order_acquire) != reserved) {
+            std::this_thread::yield();
+        }
+        const uint32_t len = std::min(reserved, full->end.load(std::memory_order_relaxed));
+        const size_t written = std::fwrite(full->data.get(), 1, len, self->_file);
+
+        lock.lock();
+        self->_bytes_written += written;
+        if (written != len) {
+            self->_write_failed = true;
+        }
+        full->full = false;
+
+        // The current buffer may have run out of space while this one was written.
+        if ((self->_state.load() & RESERVED_MASK) > BUFFER_SIZE) {
+            self->swap_buffers();
+        }
+    }
+}
+
+} // namespace dronecore
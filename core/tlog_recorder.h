@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace dronecore {
+
+// Records MAVLink frames into a telemetry log (.tlog) which TlogReader and
+// FileConnection can replay: every frame preceded by its time in microseconds
+// since the Unix epoch, big-endian.
+//
+// Frames are copied into one of two large buffers, a background thread writes
+// the other one to the file in one go. Recording a frame reserves its space
+// with one atomic add and copies it there, so the threads receiving and
+// sending never take a lock or wait for the disk. Only when a buffer is full
+// the buffers are swapped under a mutex. If the disk can't keep up and both
+// buffers are full, frames are dropped and counted.
+class TlogRecorder
+{
+public:
+    static constexpr uint32_t BUFFER_SIZE = 1024 * 1024;
+    // Partly filled buffers are written after this long, so little is lost on a crash.
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL {1000};
+    static constexpr size_t TIMESTAMP_LEN = 8;
+
+    struct Stats {
+        uint64_t frames_recorded;
+        uint64_t frames_dropped;
+        uint64_t bytes_written;
+        bool write_failed;
+    };
+
+    TlogRecorder();
+    ~TlogRecorder();
+
+    // Replaces the file if it exists.
+    bool start(const std::string &path);
+    // Writes what is left and closes the file.
+    void stop();
+
+    bool is_recording() const { return _recording.load(std::memory_order_relaxed); }
+
+    // Can be called from any thread, frames are ignored while not recording.
+    void record(const uint8_t *frame, size_t frame_len);
+    void record(const uint8_t *frame, size_t frame_len, uint64_t time_us);
+
+    Stats get_stats() const;
+
+    // Non-copyable
+    TlogRecorder(const TlogRecorder &) = delete;
+    const TlogRecorder &operator=(const TlogRecorder &) = delete;
+
+private:
+    struct Buffer {
+        std::unique_ptr<uint8_t[]> data {};
+        // Bytes reserved in this buffer which are copied, or found no space.
+        std::atomic<uint32_t> done {0};
+        // Where the first record which found no space would have started.
+        std::atomic<uint32_t> end {BUFFER_SIZE};
+        // The following are only used with the mutex locked.
+        uint32_t reserved {0};
+        bool full {false};
+    };
+
+    // The generation of buffers in the upper half, the bytes reserved in the
+    // current buffer in the lower half.
+    static constexpr unsigned GENERATION_SHIFT = 32;
+    static constexpr uint64_t RESERVED_MASK = 0xFFFFFFFF;
+
+    Buffer &buffer_of(uint64_t state) { return _buffers[(state >> GENERATION_SHIFT) % 2]; }
+
+    // Returns false if a record found no space.
+    bool try_record(const uint8_t *frame, uint32_t frame_len, uint64_t time_us);
+    // Called with the mutex locked, returns false if the other buffer isn't written yet.
+    bool swap_buffers();
+
+    static void writer_thread(TlogRecorder *self);
+
+    std::atomic<bool> _recording {false};
+    std::atomic<uint64_t> _state {0};
+    Buffer _buffers[2] {};
+
+    std::atomic<uint64_t> _frames_recorded {0};
+    std::atomic<uint64_t> _frames_dropped {0};
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _cv {};
+    bool _should_exit {false};
+    uint64_t _bytes_written {0};
+    bool _write_failed {false};
+
+    std::FILE *_file {nullptr};
+    std::thread *_writer_thread {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,115 @@
+#include "tlog_recorder.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+static const std::string PATH = "tlog_recorder_test.tlog";
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+static uint64_t read_time_us(const uint8_t *record)
+{
+    uint64_t time_us = 0;
+    for (size_t i = 0; i < TlogRecorder::TIMESTAMP_LEN; ++i) {
+        time_us = (time_us << 8) | record[i];
+    }
+    return time_us;
+}
+
+TEST(TlogRecorder, WritesTimestampedFrames)
+{
+    const std::vector<uint8_t> first {0xFD, 1, 2, 3};
+    const std::vector<uint8_t> second {0xFE, 4, 5};
+
+    TlogRecorder recorder;
+    ASSERT_TRUE(recorder.start(PATH));
+    EXPECT_TRUE(recorder.is_recording());
+    recorder.record(first.data(), first.size(), 0x0102030405060708);
+    recorder.record(second.data(), second.size(), 42);
+    recorder.stop();
+    EXPECT_FALSE(recorder.is_recording());
+
+    const auto data = read_file(PATH);
+    ASSERT_EQ(data.size(), 2 * TlogRecorder::TIMESTAMP_LEN + first.size() + second.size());
+
+    // Big-endian, as in tlogs of QGroundControl.
+    EXPECT_EQ(data[0], 0x01);
+    EXPECT_EQ(read_time_us(data.data()), 0x0102030405060708u);
+    EXPECT_EQ(std::vector<uint8_t>(data.begin() + 8, data.begin() + 12), first);
+    EXPECT_EQ(read_time_us(data.data() + 12), 42u);
+    EXPECT_EQ(std::vector<uint8_t>(data.begin() + 20, data.end()), second);
+
+    EXPECT_EQ(recorder.get_stats().bytes_written, data.size());
+    EXPECT_EQ(recorder.get_stats().frames_recorded, 2u);
+    EXPECT_EQ(recorder.get_stats().frames_dropped, 0u);
+
+    // Ignored while not recording.
+    recorder.record(first.data(), first.size());
+    EXPECT_EQ(read_file(PATH).size(), data.size());
+    EXPECT_EQ(recorder.get_stats().frames_recorded, 2u);
+
+    std::remove(PATH.c_str());
+}
+
+TEST(TlogRecorder, KeepsRecordsWholeFromManyThreads)
+{
+    static constexpr unsigned NUM_THREADS = 4;
+    // Several buffers worth.
+    static constexpr unsigned NUM_FRAMES = 20000;
+    static constexpr size_t FRAME_LEN = 100;
+
+    TlogRecorder recorder;
+    ASSERT_TRUE(recorder.start(PATH));
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < NUM_THREADS; ++t) {
+        threads.push_back(std::thread([&recorder, t]() {
+            std::vector<uint8_t> frame(FRAME_LEN, static_cast<uint8_t>(t));
+            for (unsigned i = 0; i < NUM_FRAMES; ++i) {
+                recorder.record(frame.data(), frame.size(), t);
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    recorder.stop();
+
+    const auto data = read_file(PATH);
+    const size_t record_len = TlogRecorder::TIMESTAMP_LEN + FRAME_LEN;
+    ASSERT_EQ(data.size() % record_len, 0u);
+
+    // Each record is from one thread only, nothing got mixed up.
+    for (size_t pos = 0; pos < data.size(); pos += record_len) {
+        const uint64_t t = read_time_us(data.data() + pos);
+        ASSERT_LT(t, NUM_THREADS);
+        for (size_t i = 0; i < FRAME_LEN; ++i) {
+            ASSERT_EQ(data[pos + TlogRecorder::TIMESTAMP_LEN + i], t);
+        }
+    }
+
+    const auto stats = recorder.get_stats();
+    EXPECT_EQ(stats.frames_recorded, data.size() / record_len);
+    EXPECT_EQ(stats.frames_recorded + stats.frames_dropped, NUM_THREADS * NUM_FRAMES);
+    EXPECT_FALSE(stats.write_failed);
+
+    std::remove(PATH.c_str());
+}
+
+TEST(TlogRecorder, FailsForInvalidPath)
+{
+    TlogRecorder recorder;
+    EXPECT_FALSE(recorder.start("/nonexistent/directory/test.tlog"));
+    EXPECT_FALSE(recorder.is_recording());
+}
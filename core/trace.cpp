@@ -0,0 +1,165 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+
+#if defined(LINUX) || defined(APPLE)
+#include <pthread.h>
+#endif
+
+namespace dronecore {
+
+constexpr size_t Trace::RING_SIZE;
+
+Trace &Trace::instance()
+{
+    // Never destroyed, threads might still trace at exit.
+    static Trace *trace = new Trace();
+    return *trace;
+}
+
+void Trace::start()
+{
+    _start_ns.store(now_ns(), std::memory_order_relaxed);
+    _enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::stop()
+{
+    _enabled.store(false, std::memory_order_relaxed);
+}
+
+void Trace::add_span(const char *name, uint64_t start_ns, uint64_t end_ns)
+{
+    add(Type::SPAN, name, start_ns, end_ns - start_ns);
+}
+
+void Trace::add_async(const char *name, uint64_t id, bool begin)
+{
+    add(begin ? Type::ASYNC_BEGIN : Type::ASYNC_END, name, now_ns(), id);
+}
+
+void Trace::add(Type type, const char *name, uint64_t timestamp_ns, uint64_t value)
+{
+    Ring &ring = get_ring();
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    Event &event = ring.events[head & (RING_SIZE - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.timestamp_ns.store(timestamp_ns, std::memory_order_relaxed);
+    event.value.store(value, std::memory_order_relaxed);
+    event.type.store(type, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+Trace::Ring &Trace::get_ring()
+{
+    static thread_local Ring *ring = nullptr;
+    if (ring != nullptr) {
+        return *ring;
+    }
+
+    ring = new Ring();
+#if defined(LINUX) || defined(APPLE)
+    if (pthread_getname_np(pthread_self(), ring->thread_name, sizeof(ring->thread_name)) != 0) {
+        ring->thread_name[0] = '\0';
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(_rings_mutex);
+    ring->thread_id = unsigned(_rings.size()) + 1;
+    _rings.push_back(ring);
+    return *ring;
+}
+
+void Trace::get_chrome_trace(std::string &json) const
+{
+    const uint64_t start_ns = _start_ns.load(std::memory_order_relaxed);
+
+    json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    char buffer[256];
+    struct Copy {
+        const char *name;
+        uint64_t timestamp_ns;
+        uint64_t value;
+        Type type;
+    };
+    std::vector<Copy> copies;
+    auto append = [&json, &first, &buffer](int len) {
+        if (!first) {
+            json += ',';
+        }
+        first = false;
+        json.append(buffer, size_t(len) < sizeof(buffer) ? size_t(len) : sizeof(buffer) - 1);
+    };
+
+    std::lock_guard<std::mutex> lock(_rings_mutex);
+    for (const Ring *ring : _rings) {
+        append(std::snprintf(buffer, sizeof(buffer),
+                             "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                             "\"args\":{\"name\":\"%s\"}}",
+                             ring->thread_id, ring->thread_name));
+
+        // Copied first, the thread of the ring keeps adding meanwhile.
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t begin = head > RING_SIZE ? head - RING_SIZE : 0;
+        copies.resize(size_t(head - begin));
+        for (uint64_t i = begin; i < head; ++i) {
+            const Event &event = ring->events[i & (RING_SIZE - 1)];
+            Copy &copy = copies[size_t(i - begin)];
+            copy.name = event.name.load(std::memory_order_relaxed);
+            copy.timestamp_ns = event.timestamp_ns.load(std::memory_order_relaxed);
+            copy.value = event.value.load(std::memory_order_relaxed);
+            copy.type = event.type.load(std::memory_order_relaxed);
+        }
+        // Events the thread got to again while copying might be torn.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t new_head = ring->head.load(std::memory_order_relaxed);
+        const uint64_t first_intact = new_head >= RING_SIZE ? new_head - RING_SIZE + 1 : 0;
+
+        for (uint64_t i = std::max(begin, first_intact); i < head; ++i) {
+            const Copy &copy = copies[size_t(i - begin)];
+            if (copy.timestamp_ns < start_ns) {
+                continue;
+            }
+            const double ts_us = double(copy.timestamp_ns - start_ns) * 1e-3;
+
+            if (copy.type == Type::SPAN) {
+                append(std::snprintf(buffer, sizeof(buffer),
+                                     "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                                     "\"ts\":%.3f,\"dur\":%.3f}",
+                                     copy.name, ring->thread_id, ts_us, double(copy.value) * 1e-3));
+            } else {
+                append(std::snprintf(buffer, sizeof(buffer),
+                                     "{\"name\":\"%s\",\"cat\":\"dronecore\",\"ph\":\"%c\","
+                                     "\"id\":\"0x%" PRIx64 "\",\"pid\":1,\"tid\":%u,\"ts\":%.3f}",
+                                     copy.name, copy.type == Type::ASYNC_BEGIN ? 'b' : 'e',
+                                     copy.value, ring->thread_id, ts_us));
+            }
+        }
+    }
+    json += "]}";
+}
+
+bool Trace::write_chrome_trace(const std::string &path) const
+{
+    std::string json;
+    get_chrome_trace(json);
+
+    std::ofstream file(path, std::ios::out | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    file << json;
+    return bool(file);
+}
+
+uint64_t Trace::now_ns()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+} // namespace dronecore
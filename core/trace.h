@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Spans of the hot paths on one timeline, from receiving a datagram down to the
+// user callbacks, and commands from sending to their ack. Written as a Chrome
+// trace (JSON), which chrome://tracing and the Perfetto UI open.
+//
+// Each thread records into a ring of its own without locking, the oldest spans
+// get overwritten. Rings are never freed, so the trace can still be written
+// after a thread exited.
+//
+// The trace points below are only compiled in with DRONECORE_TRACING=1, without
+// it they are empty and start() has nothing to record.
+class Trace
+{
+public:
+    static constexpr size_t RING_SIZE = 16384; // Needs to be a power of 2.
+
+    static Trace &instance();
+
+    // Spans recorded before are left out of the trace.
+    void start();
+    void stop();
+    bool is_enabled() const { return _enabled.load(std::memory_order_relaxed); }
+
+    // Names need to be string literals.
+    void add_span(const char *name, uint64_t start_ns, uint64_t end_ns);
+    // Begin and end are matched by name and id, they can be on different threads.
+    void add_async(const char *name, uint64_t id, bool begin);
+
+    void get_chrome_trace(std::string &json) const;
+    bool write_chrome_trace(const std::string &path) const;
+
+    static uint64_t now_ns();
+
+    // Adds a span from construction to destruction, if enabled at construction.
+    class Scope
+    {
+    public:
+        explicit Scope(const char *name) :
+            _name(name),
+            _start_ns(Trace::instance().is_enabled() ? now_ns() : 0)
+        {}
+        ~Scope()
+        {
+            if (_start_ns != 0) {
+                Trace::instance().add_span(_name, _start_ns, now_ns());
+            }
+        }
+
+        // Non-copyable
+        Scope(const Scope &) = delete;
+        const Scope &operator=(const Scope &) = delete;
+
+    private:
+        const char *_name;
+        const uint64_t _start_ns;
+    };
+
+    // Non-copyable
+    Trace(const Trace &) = delete;
+    const Trace &operator=(const Trace &) = delete;
+
+private:
+    Trace() = default;
+
+    enum class Type : uint8_t {
+        SPAN,
+        ASYNC_BEGIN,
+        ASYNC_END
+    };
+
+    // Atomic so the writer can read a ring while its thread adds to it.
+    struct Event {
+        std::atomic<const char *> name;
+        std::atomic<uint64_t> timestamp_ns;
+        // Duration of a span, or the id of an async event.
+        std::atomic<uint64_t> value;
+        std::atomic<Type> type;
+    };
+
+    struct Ring {
+        unsigned thread_id;
+        char thread_name[16];
+        // Number of events added, only ever written by the thread of the ring.
+        std::atomic<uint64_t> head;
+        Event events[RING_SIZE];
+    };
+
+    void add(Type type, const char *name, uint64_t timestamp_ns, uint64_t value);
+    Ring &get_ring();
+
+    std::atomic<bool> _enabled {false};
+    std::atomic<uint64_t> _start_ns {0};
+
+    mutable std::mutex _rings_mutex {};
+    std::vector<Ring *> _rings {};
+};
+
+} // namespace dronecore
+
+#if DRONECORE_TRACING == 1
+#define DRONECORE_TRACE_CONCAT_(a, b) a##b
+#define DRONECORE_TRACE_CONCAT(a, b) DRONECORE_TRACE_CONCAT_(a, b)
+#define DRONECORE_TRACE_SCOPE(name) \
+    ::dronecore::Trace::Scope DRONECORE_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define DRONECORE_TRACE_ASYNC_BEGIN(name, id) \
+    do { \
+        if (::dronecore::Trace::instance().is_enabled()) { \
+            ::dronecore::Trace::instance().add_async(name, id, true); \
+        } \
+    } while (false)
+#define DRONECORE_TRACE_ASYNC_END(name, id) \
+    do { \
+        if (::dronecore::Trace::instance().is_enabled()) { \
+            ::dronecore::Trace::instance().add_async(name, id, false); \
+        } \
+    } while (false)
+#else
+#define DRONECORE_TRACE_SCOPE(name)
+#define DRONECORE_TRACE_ASYNC_BEGIN(name, id) do {} while (false)
+#define DRONECORE_TRACE_ASYNC_END(name, id) do {} while (false)
+#endif
@@ -0,0 +1,95 @@
+#include "trace.h"
+#include <gtest/gtest.h>
+#include <thread>
+
+using namespace dronecore;
+
+static size_t count_of(const std::string &json, const std::string &part)
+{
+    size_t count = 0;
+    for (size_t pos = json.find(part); pos != std::string::npos; pos = json.find(part, pos + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+TEST(Trace, NothingRecordedWhenStopped)
+{
+    Trace &trace = Trace::instance();
+    trace.start();
+    trace.stop();
+    {
+        Trace::Scope scope("stopped");
+    }
+
+    std::string json;
+    trace.get_chrome_trace(json);
+    EXPECT_EQ(count_of(json, "\"stopped\""), 0u);
+}
+
+TEST(Trace, SpansOfSeveralThreads)
+{
+    Trace &trace = Trace::instance();
+    trace.start();
+    {
+        Trace::Scope scope("outer");
+        Trace::Scope inner_scope("inner");
+    }
+    std::thread thread([]() {
+        Trace::Scope scope("other thread");
+    });
+    thread.join();
+    trace.add_async("command", 42, true);
+    trace.add_async("command", 42, false);
+    trace.stop();
+
+    std::string json;
+    trace.get_chrome_trace(json);
+    EXPECT_EQ(json.front(), '{');
+    EXPECT_EQ(json.back(), '}');
+    EXPECT_EQ(count_of(json, "\"name\":\"outer\",\"ph\":\"X\""), 1u);
+    EXPECT_EQ(count_of(json, "\"name\":\"inner\",\"ph\":\"X\""), 1u);
+    EXPECT_EQ(count_of(json, "\"name\":\"other thread\",\"ph\":\"X\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"b\",\"id\":\"0x2a\""), 1u);
+    EXPECT_EQ(count_of(json, "\"ph\":\"e\",\"id\":\"0x2a\""), 1u);
+    EXPECT_GE(count_of(json, "\"thread_name\""), 2u);
+}
+
+TEST(Trace, RestartLeavesOutEarlierSpans)
+{
+    Trace &trace = Trace::instance();
+    trace.start();
+    {
+        Trace::Scope scope("before restart");
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    trace.start();
+    {
+        Trace::Scope scope("after restart");
+    }
+    trace.stop();
+
+    std::string json;
+    trace.get_chrome_trace(json);
+    EXPECT_EQ(count_of(json, "\"before restart\""), 0u);
+    EXPECT_EQ(count_of(json, "\"after restart\""), 1u);
+}
+
+TEST(Trace, RingKeepsNewestSpans)
+{
+    Trace &trace = Trace::instance();
+    trace.start();
+    std::thread thread([]() {
+        for (size_t i = 0; i < Trace::RING_SIZE + 100; ++i) {
+            Trace::Scope scope("many");
+        }
+    });
+    thread.join();
+    trace.stop();
+
+    std::string json;
+    trace.get_chrome_trace(json);
+    // The oldest one shares its event with the next one, which might be written
+    // while copying.
+    EXPECT_EQ(count_of(json, "\"many\""), Trace::RING_SIZE - 1);
+}
@@ -0,0 +1,163 @@
+#include "tx_queue.h"
+#include "thread_setup.h"
+#include <chrono>
+
+namespace dronecore {
+
+constexpr size_t TxQueue::DEFAULT_MAX_WRITE_LEN;
+constexpr size_t TxQueue::DEFAULT_MAX_QUEUED_BYTES;
+constexpr unsigned TxQueue::DEFAULT_DRAIN_TIMEOUT_MS;
+
+TxQueue::TxQueue(write_t write, size_t max_write_len, size_t max_queued_bytes,
+                 abort_write_t abort_write) :
+    _write(write),
+    _max_write_len(max_write_len),
+    _max_queued_bytes(max_queued_bytes),
+    _abort_write(abort_write)
+{
+    _write_buffer.reserve(max_write_len);
+}
+
+TxQueue::~TxQueue()
+{
+    stop();
+}
+
+void TxQueue::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_write_thread != nullptr) {
+        return;
+    }
+    _should_exit = false;
+    _should_abort = false;
+    _exited = false;
+    _write_thread = new std::thread(write_thread, this);
+}
+
+void TxQueue::stop(unsigned drain_timeout_ms)
+{
+    std::thread *thread;
+    bool aborted = false;
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        thread = _write_thread;
+        _write_thread = nullptr;
+        _should_exit = true;
+        _condition_var.notify_one();
+
+        const auto drain_timeout = std::chrono::milliseconds(drain_timeout_ms);
+        const auto exited = [this]() { return _exited; };
+        if (thread != nullptr && !_exited_condition_var.wait_for(lock, drain_timeout, exited)) {
+            // One deadline for everything left, not one timeout per write.
+            _should_abort = true;
+            aborted = true;
+        }
+    }
+
+    if (aborted && _abort_write) {
+        _abort_write();
+    }
+
+    if (thread != nullptr) {
+        thread->join();
+        delete thread;
+    }
+}
+
+bool TxQueue::push(const uint8_t *frame, size_t len, TxScheduler::Priority priority)
+{
+    if (len == 0 || len > UINT16_MAX) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_num_queued_bytes + len > _max_queued_bytes) {
+            ++_num_dropped;
+            return false;
+        }
+
+        Lane &lane = _lanes[size_t(priority)];
+        lane.bytes.insert(lane.bytes.end(), frame, frame + len);
+        lane.frame_lens.push_back(uint16_t(len));
+        ++_num_queued;
+        _num_queued_bytes += len;
+    }
+    _condition_var.notify_one();
+    return true;
+}
+
+TxQueue::Stats TxQueue::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return Stats {_num_queued, _num_dropped};
+}
+
+void TxQueue::take_frames()
+{
+    bool full = false;
+    for (Lane &lane : _lanes) {
+        while (!full && !lane.frame_lens.empty()) {
+            const size_t len = lane.frame_lens.front();
+            if (!_write_buffer.empty() && _write_buffer.size() + len > _max_write_len) {
+                full = true;
+                break;
+            }
+            _write_buffer.insert(_write_buffer.end(), lane.bytes.begin() + lane.read_pos,
+                                 lane.bytes.begin() + lane.read_pos + len);
+            lane.read_pos += len;
+            lane.frame_lens.pop_front();
+            --_num_queued;
+            _num_queued_bytes -= len;
+        }
+
+        if (lane.frame_lens.empty()) {
+            lane.bytes.clear();
+            lane.read_pos = 0;
+        } else if (lane.read_pos > lane.bytes.size() / 2) {
+            // Mostly written already, move the rest to the front.
+            lane.bytes.erase(lane.bytes.begin(), lane.bytes.begin() + lane.read_pos);
+            lane.read_pos = 0;
+        }
+    }
+}
+
+void TxQueue::write_thread(TxQueue *self)
+{
+    setup_thread(ThreadRole::Io, "tx_queue");
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+    while (true) {
+        while (self->_num_queued == 0 && !self->_should_exit) {
+            self->_condition_var.wait(lock);
+        }
+        if (self->_should_abort) {
+            self->_num_dropped += self->_num_queued;
+            for (Lane &lane : self->_lanes) {
+                lane.bytes.clear();
+                lane.read_pos = 0;
+                lane.frame_lens.clear();
+            }
+            self->_num_queued = 0;
+            self->_num_queued_bytes = 0;
+        }
+        if (self->_num_queued == 0) {
+            // Only exit once everything is written (or dropped).
+            break;
+        }
+
+        self->_write_buffer.clear();
+        self->take_frames();
+
+        // The link reports its own errors, the frames are gone either way.
+        lock.unlock();
+        self->_write(self->_write_buffer.data(), self->_write_buffer.size());
+        lock.lock();
+    }
+
+    self->_exited = true;
+    self->_exited_condition_var.notify_all();
+}
+
+} // namespace dronecore
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "tx_scheduler.h"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace dronecore {
+
+// Writes outgoing frames to a slow link (e.g. a serial radio) from a thread of
+// its own, so that senders never wait for the link. Control frames go out before
+// bulk frames queued earlier, and the frames waiting are written together, up
+// to max_write_len bytes at once. Frames which don't fit anymore are dropped.
+class TxQueue
+{
+public:
+    typedef std::function<bool(const uint8_t *data, size_t len)> write_t;
+    // Makes a write that is stuck (e.g. on a port held up by flow control)
+    // return, it is called from stop() once draining takes too long.
+    typedef std::function<void()> abort_write_t;
+
+    struct Stats {
+        size_t queued; // Frames waiting to be written.
+        uint64_t dropped;
+    };
+
+    TxQueue(write_t write, size_t max_write_len = DEFAULT_MAX_WRITE_LEN,
+            size_t max_queued_bytes = DEFAULT_MAX_QUEUED_BYTES,
+            abort_write_t abort_write = nullptr);
+    ~TxQueue();
+
+    void start();
+    // Writes what is still queued, for at most drain_timeout_ms. What is left
+    // after that is dropped.
+    void stop(unsigned drain_timeout_ms = DEFAULT_DRAIN_TIMEOUT_MS);
+
+    // Returns false if the frame was dropped because the queue is full.
+    bool push(const uint8_t *frame, size_t len, TxScheduler::Priority priority);
+
+    Stats get_stats() const;
+
+    static constexpr size_t DEFAULT_MAX_WRITE_LEN = 512;
+    // A couple of seconds at 57600 baud.
+    static constexpr size_t DEFAULT_MAX_QUEUED_BYTES = 16384;
+    static constexpr unsigned DEFAULT_DRAIN_TIMEOUT_MS = 1000;
+
+    // Non-copyable
+    TxQueue(const TxQueue &) = delete;
+    const TxQueue &operator=(const TxQueue &) = delete;
+
+private:
+    // Frames of one priority, back to back.
+    struct Lane {
+        std::vector<uint8_t> bytes {};
+        size_t read_pos {0};
+        std::deque<uint16_t> frame_lens {};
+    };
+
+    // Needs to be called with _mutex locked. Moves whole frames to the write
+    // buffer, control ones first, at least one even if it is longer.
+    void take_frames();
+
+    static void write_thread(TxQueue *self);
+
+    write_t _write;
+    const size_t _max_write_len;
+    const size_t _max_queued_bytes;
+    abort_write_t _abort_write;
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _condition_var {};
+    // Signals stop() that the write thread is done.
+    std::condition_variable _exited_condition_var {};
+    // By TxScheduler::Priority.
+    Lane _lanes[2] {};
+    size_t _num_queued {0};
+    size_t _num_queued_bytes {0};
+    uint64_t _num_dropped {0};
+    bool _should_exit {false};
+    // Set once draining took too long, the rest is dropped.
+    bool _should_abort {false};
+    bool _exited {false};
+
+    // Only used by the write thread, kept to not allocate for every write.
+    std::vector<uint8_t> _write_buffer {};
+
+    std::thread *_write_thread {nullptr};
+};
+
+} // namespace dronecore
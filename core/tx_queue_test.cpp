@@ -0,0 +1,208 @@
+#include "tx_queue.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+// Records the writes, the first one blocks until released.
+class FakeLink
+{
+public:
+    bool write(const uint8_t *data, size_t len)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _writes.push_back(std::vector<uint8_t>(data, data + len));
+        _cv.notify_all();
+        _cv.wait(lock, [this]() { return _released; });
+        return true;
+    }
+
+    void wait_for_writes(size_t num_writes)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _cv.wait_for(lock, std::chrono::seconds(1), [this, num_writes]() {
+            return _writes.size() >= num_writes;
+        });
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _released = true;
+        _cv.notify_all();
+    }
+
+    std::vector<std::vector<uint8_t>> writes()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _writes;
+    }
+
+private:
+    std::mutex _mutex {};
+    std::condition_variable _cv {};
+    std::vector<std::vector<uint8_t>> _writes {};
+    bool _released {false};
+};
+
+void push(TxQueue &queue, uint8_t value, size_t len, TxScheduler::Priority priority)
+{
+    std::vector<uint8_t> frame(len, value);
+    EXPECT_TRUE(queue.push(frame.data(), frame.size(), priority));
+}
+
+} // namespace
+
+TEST(TxQueue, WritesWaitingFramesTogether)
+{
+    FakeLink link;
+    TxQueue queue([&link](const uint8_t *data, size_t len) { return link.write(data, len); });
+    queue.start();
+
+    push(queue, 1, 3, TxScheduler::Priority::CONTROL);
+    link.wait_for_writes(1);
+
+    // While the first write is stuck, the others queue up.
+    push(queue, 2, 3, TxScheduler::Priority::CONTROL);
+    push(queue, 3, 3, TxScheduler::Priority::CONTROL);
+    EXPECT_EQ(queue.get_stats().queued, 2u);
+
+    link.release();
+    link.wait_for_writes(2);
+    queue.stop();
+
+    const auto writes = link.writes();
+    ASSERT_EQ(writes.size(), 2u);
+    EXPECT_EQ(writes[0], std::vector<uint8_t>({1, 1, 1}));
+    EXPECT_EQ(writes[1], std::vector<uint8_t>({2, 2, 2, 3, 3, 3}));
+    EXPECT_EQ(queue.get_stats().queued, 0u);
+}
+
+TEST(TxQueue, ControlGoesFirst)
+{
+    FakeLink link;
+    TxQueue queue([&link](const uint8_t *data, size_t len) { return link.write(data, len); });
+    queue.start();
+
+    push(queue, 1, 1, TxScheduler::Priority::BULK);
+    link.wait_for_writes(1);
+
+    push(queue, 2, 1, TxScheduler::Priority::BULK);
+    push(queue, 3, 1, TxScheduler::Priority::BULK);
+    push(queue, 4, 1, TxScheduler::Priority::CONTROL);
+
+    link.release();
+    queue.stop();
+
+    const auto writes = link.writes();
+    ASSERT_EQ(writes.size(), 2u);
+    EXPECT_EQ(writes[1], std::vector<uint8_t>({4, 2, 3}));
+}
+
+TEST(TxQueue, KeepsFramesWhole)
+{
+    std::vector<std::vector<uint8_t>> writes;
+    TxQueue queue([&writes](const uint8_t *data, size_t len) {
+        writes.push_back(std::vector<uint8_t>(data, data + len));
+        return true;
+    }, 10);
+
+    // Queued before the thread runs, so all of them are waiting at once.
+    push(queue, 1, 4, TxScheduler::Priority::BULK);
+    push(queue, 2, 4, TxScheduler::Priority::BULK);
+    push(queue, 3, 4, TxScheduler::Priority::BULK);
+    push(queue, 4, 12, TxScheduler::Priority::BULK);
+    queue.start();
+    queue.stop();
+
+    ASSERT_EQ(writes.size(), 3u);
+    EXPECT_EQ(writes[0], std::vector<uint8_t>({1, 1, 1, 1, 2, 2, 2, 2}));
+    EXPECT_EQ(writes[1], std::vector<uint8_t>({3, 3, 3, 3}));
+    // Longer than a write, but still goes out in one.
+    EXPECT_EQ(writes[2].size(), 12u);
+}
+
+TEST(TxQueue, DropsWhenFull)
+{
+    TxQueue queue([](const uint8_t *, size_t) { return true; },
+                  TxQueue::DEFAULT_MAX_WRITE_LEN, 10);
+
+    const uint8_t frame[4] {};
+    EXPECT_TRUE(queue.push(frame, sizeof(frame), TxScheduler::Priority::BULK));
+    EXPECT_TRUE(queue.push(frame, sizeof(frame), TxScheduler::Priority::BULK));
+    EXPECT_FALSE(queue.push(frame, sizeof(frame), TxScheduler::Priority::CONTROL));
+
+    const TxQueue::Stats stats = queue.get_stats();
+    EXPECT_EQ(stats.queued, 2u);
+    EXPECT_EQ(stats.dropped, 1u);
+}
+
+TEST(TxQueue, StopGivesUpOnStuckWrite)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool aborted = false;
+    unsigned num_writes = 0;
+
+    // Like a port held up by flow control: a write only returns once aborted.
+    TxQueue queue([&](const uint8_t *, size_t) {
+        std::unique_lock<std::mutex> lock(mutex);
+        ++num_writes;
+        cv.notify_all();
+        cv.wait(lock, [&aborted]() { return aborted; });
+        return false;
+    }, 4, TxQueue::DEFAULT_MAX_QUEUED_BYTES, [&]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+        cv.notify_all();
+    });
+    queue.start();
+
+    push(queue, 1, 4, TxScheduler::Priority::BULK);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        ASSERT_TRUE(cv.wait_for(lock, std::chrono::seconds(1), [&num_writes]() {
+            return num_writes == 1;
+        }));
+    }
+    // Each of these would need a write of its own.
+    for (uint8_t i = 2; i < 10; ++i) {
+        push(queue, i, 4, TxScheduler::Priority::BULK);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    queue.stop(100);
+    const auto took = std::chrono::steady_clock::now() - start;
+
+    EXPECT_LT(took, std::chrono::seconds(1));
+    EXPECT_TRUE(aborted);
+    // Nothing else is written once aborted.
+    EXPECT_EQ(num_writes, 1u);
+
+    const TxQueue::Stats stats = queue.get_stats();
+    EXPECT_EQ(stats.queued, 0u);
+    EXPECT_EQ(stats.dropped, 8u);
+}
+
+TEST(TxQueue, StopDrainsInTime)
+{
+    bool aborted = false;
+    std::vector<std::vector<uint8_t>> writes;
+    TxQueue queue([&writes](const uint8_t *data, size_t len) {
+        writes.push_back(std::vector<uint8_t>(data, data + len));
+        return true;
+    }, 4, TxQueue::DEFAULT_MAX_QUEUED_BYTES, [&aborted]() { aborted = true; });
+
+    push(queue, 1, 4, TxScheduler::Priority::BULK);
+    push(queue, 2, 4, TxScheduler::Priority::BULK);
+    queue.start();
+    queue.stop();
+
+    EXPECT_FALSE(aborted);
+    EXPECT_EQ(writes.size(), 2u);
+    EXPECT_EQ(queue.get_stats().dropped, 0u);
+}
@@ -0,0 +1,167 @@
+#include "tx_scheduler.h"
+#include "log.h"
+#include "thread_setup.h"
+#include <algorithm>
+
+namespace dronecore {
+
+TxScheduler::TxScheduler(send_t send, double bytes_per_s, size_t max_bulk_queued) :
+    _send(send),
+    _bytes_per_s(bytes_per_s),
+    _max_tokens(std::max(bytes_per_s * 0.1, double(MAVLINK_MAX_PACKET_LEN))),
+    _max_bulk_queued(max_bulk_queued),
+    _tokens(_max_tokens),
+    _last_refill(clock_t::now())
+{}
+
+TxScheduler::~TxScheduler()
+{
+    stop();
+}
+
+void TxScheduler::start()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_scheduler_thread != nullptr) {
+        return;
+    }
+    _should_exit = false;
+    _scheduler_thread = new std::thread(scheduler_thread, this);
+}
+
+void TxScheduler::stop()
+{
+    std::thread *thread_to_join = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _should_exit = true;
+        thread_to_join = _scheduler_thread;
+        _scheduler_thread = nullptr;
+    }
+    _condition_var.notify_all();
+
+    if (thread_to_join != nullptr) {
+        thread_to_join->join();
+        delete thread_to_join;
+    }
+
+    std::deque<mavlink_message_t> remaining {};
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        remaining.swap(_bulk_queue);
+    }
+
+    std::lock_guard<std::mutex> send_lock(_send_mutex);
+    for (const auto &message : remaining) {
+        _send(message);
+    }
+}
+
+bool TxScheduler::push(const mavlink_message_t &message)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        if (_scheduler_thread != nullptr &&
+            get_priority(message.msgid) == Priority::BULK) {
+
+            if (_bulk_queue.size() >= _max_bulk_queued) {
+                LogWarn() << "Bulk transmit queue full, dropping message " << message.msgid;
+                return false;
+            }
+            _bulk_queue.push_back(message);
+            _condition_var.notify_one();
+            return true;
+        }
+
+        refill_tokens();
+        // Don't let a burst of control messages stall bulk traffic for too long.
+        _tokens = std::max(_tokens - frame_len(message), -_max_tokens);
+    }
+
+    std::lock_guard<std::mutex> send_lock(_send_mutex);
+    return _send(message);
+}
+
+size_t TxScheduler::num_bulk_queued() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _bulk_queue.size();
+}
+
+TxScheduler::Priority TxScheduler::get_priority(uint32_t msgid)
+{
+    switch (msgid) {
+        case MAVLINK_MSG_ID_MISSION_ITEM:
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST:
+        case MAVLINK_MSG_ID_MISSION_REQUEST_INT:
+        case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+        case MAVLINK_MSG_ID_MISSION_REQUEST_PARTIAL_LIST:
+        case MAVLINK_MSG_ID_MISSION_WRITE_PARTIAL_LIST:
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+        case MAVLINK_MSG_ID_MISSION_ACK:
+        case MAVLINK_MSG_ID_MISSION_CLEAR_ALL:
+        case MAVLINK_MSG_ID_PARAM_SET:
+        case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+        case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+        case MAVLINK_MSG_ID_PARAM_EXT_SET:
+        case MAVLINK_MSG_ID_PARAM_EXT_REQUEST_READ:
+        case MAVLINK_MSG_ID_PARAM_EXT_REQUEST_LIST:
+        case MAVLINK_MSG_ID_FILE_TRANSFER_PROTOCOL:
+        case MAVLINK_MSG_ID_LOG_REQUEST_DATA:
+            return Priority::BULK;
+        default:
+            return Priority::CONTROL;
+    }
+}
+
+void TxScheduler::refill_tokens()
+{
+    const auto now = clock_t::now();
+    const double elapsed_s = std::chrono::duration<double>(now - _last_refill).count();
+    _last_refill = now;
+    _tokens = std::min(_tokens + elapsed_s * _bytes_per_s, _max_tokens);
+}
+
+double TxScheduler::frame_len(const mavlink_message_t &message)
+{
+    return double(message.len + MAVLINK_NUM_NON_PAYLOAD_BYTES);
+}
+
+void TxScheduler::scheduler_thread(TxScheduler *self)
+{
+    setup_thread(ThreadRole::Io, "tx_sched");
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+    while (!self->_should_exit) {
+        if (self->_bulk_queue.empty()) {
+            self->_condition_var.wait(lock);
+            continue;
+        }
+
+        self->refill_tokens();
+        const double len = self->frame_len(self->_bulk_queue.front());
+        if (self->_tokens < len) {
+            // Wait until there is enough budget for the next frame.
+            self->_condition_var.wait_for(
+                lock, std::chrono::duration<double>((len - self->_tokens) / self->_bytes_per_s));
+            continue;
+        }
+        self->_tokens -= len;
+
+        const mavlink_message_t message = self->_bulk_queue.front();
+        self->_bulk_queue.pop_front();
+
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> send_lock(self->_send_mutex);
+            if (!self->_send(message)) {
+                LogErr() << "Sending bulk message failed";
+            }
+        }
+        lock.lock();
+    }
+}
+
+} // namespace dronecore
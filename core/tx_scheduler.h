@@ -0,0 +1,79 @@
+#pragma once
+
+#include "mavlink_include.h"
+#include <cstdint>
+#include <functional>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+namespace dronecore {
+
+// Keeps a link within its byte budget without delaying control traffic.
+// Control messages (heartbeats, commands, setpoints) are sent right away,
+// bulk messages (mission items, params, file transfer) are queued and sent
+// from a token bucket which gets refilled at the link's byte rate.
+// Control messages use up tokens as well, so bulk traffic backs off for them.
+class TxScheduler
+{
+public:
+    enum class Priority {
+        CONTROL,
+        BULK
+    };
+
+    typedef std::function<bool(const mavlink_message_t &)> send_t;
+
+    TxScheduler(send_t send, double bytes_per_s,
+                size_t max_bulk_queued = DEFAULT_MAX_BULK_QUEUED);
+    ~TxScheduler();
+
+    void start();
+    // Sends what is still queued.
+    void stop();
+
+    // Returns false if a control message failed to send or the bulk queue is full.
+    bool push(const mavlink_message_t &message);
+
+    size_t num_bulk_queued() const;
+
+    static Priority get_priority(uint32_t msgid);
+
+    static constexpr size_t DEFAULT_MAX_BULK_QUEUED = 100;
+
+    // Non-copyable
+    TxScheduler(const TxScheduler &) = delete;
+    const TxScheduler &operator=(const TxScheduler &) = delete;
+
+private:
+    typedef std::chrono::steady_clock clock_t;
+
+    // Need to be called with _mutex locked.
+    void refill_tokens();
+
+    static double frame_len(const mavlink_message_t &message);
+    static void scheduler_thread(TxScheduler *self);
+
+    send_t _send;
+    const double _bytes_per_s;
+    // Allow bursts of 100 ms of link time but at least one full frame.
+    const double _max_tokens;
+    const size_t _max_bulk_queued;
+
+    // Control messages are sent from the caller's thread, bulk ones from the
+    // scheduler thread, this keeps them from interleaving on the link.
+    std::mutex _send_mutex {};
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _condition_var {};
+    std::deque<mavlink_message_t> _bulk_queue {};
+    double _tokens;
+    clock_t::time_point _last_refill;
+    bool _should_exit {false};
+
+    std::thread *_scheduler_thread {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,105 @@
+#include "tx_scheduler.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+using namespace dronecore;
+
+static mavlink_message_t make_message(uint32_t msgid, uint8_t len)
+{
+    mavlink_message_t message {};
+    message.msgid = msgid;
+    message.len = len;
+    return message;
+}
+
+TEST(TxScheduler, Classifies)
+{
+    EXPECT_EQ(TxScheduler::get_priority(MAVLINK_MSG_ID_HEARTBEAT),
+              TxScheduler::Priority::CONTROL);
+    EXPECT_EQ(TxScheduler::get_priority(MAVLINK_MSG_ID_COMMAND_LONG),
+              TxScheduler::Priority::CONTROL);
+    EXPECT_EQ(TxScheduler::get_priority(MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED),
+              TxScheduler::Priority::CONTROL);
+    EXPECT_EQ(TxScheduler::get_priority(MAVLINK_MSG_ID_MISSION_ITEM_INT),
+              TxScheduler::Priority::BULK);
+    EXPECT_EQ(TxScheduler::get_priority(MAVLINK_MSG_ID_PARAM_EXT_SET),
+              TxScheduler::Priority::BULK);
+}
+
+TEST(TxScheduler, ControlGoesFirst)
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<uint32_t> sent;
+
+    // Budget for a few frames per second only.
+    TxScheduler scheduler([&](const mavlink_message_t &message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        sent.push_back(message.msgid);
+        cv.notify_one();
+        return true;
+    }, 1000.0);
+    scheduler.start();
+
+    // These use up the initial budget, the rest has to wait.
+    for (unsigned i = 0; i < 10; ++i) {
+        EXPECT_TRUE(scheduler.push(make_message(MAVLINK_MSG_ID_MISSION_ITEM_INT, 200)));
+    }
+
+    EXPECT_TRUE(scheduler.push(make_message(MAVLINK_MSG_ID_HEARTBEAT, 9)));
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // The heartbeat was sent right away, before most of the mission items.
+        ASSERT_FALSE(sent.empty());
+        EXPECT_EQ(sent.back(), MAVLINK_MSG_ID_HEARTBEAT);
+        EXPECT_LT(sent.size(), 10u);
+    }
+    EXPECT_GT(scheduler.num_bulk_queued(), 0u);
+
+    scheduler.stop();
+
+    // Nothing is lost on stop.
+    EXPECT_EQ(sent.size(), 11);
+    EXPECT_EQ(scheduler.num_bulk_queued(), 0);
+}
+
+TEST(TxScheduler, DropsWhenBulkQueueFull)
+{
+    unsigned num_sent = 0;
+
+    TxScheduler scheduler([&](const mavlink_message_t &) {
+        ++num_sent;
+        return true;
+    }, 1.0, 2);
+    scheduler.start();
+
+    // The initial budget is enough for one frame only, which might already
+    // be picked up by the scheduler thread.
+    unsigned num_accepted = 0;
+    for (unsigned i = 0; i < 5; ++i) {
+        if (scheduler.push(make_message(MAVLINK_MSG_ID_PARAM_SET, 255))) {
+            ++num_accepted;
+        }
+    }
+    EXPECT_LE(num_accepted, 3);
+    EXPECT_GE(num_accepted, 2);
+
+    scheduler.stop();
+    EXPECT_EQ(num_sent, num_accepted);
+}
+
+TEST(TxScheduler, SendsDirectlyWhenNotStarted)
+{
+    unsigned num_sent = 0;
+
+    TxScheduler scheduler([&](const mavlink_message_t &) {
+        ++num_sent;
+        return true;
+    }, 1.0);
+
+    EXPECT_TRUE(scheduler.push(make_message(MAVLINK_MSG_ID_MISSION_ITEM_INT, 200)));
+    EXPECT_EQ(num_sent, 1);
+}
@@ -1,6 +1,8 @@
 #include "udp_connection.h"
 #include "global_include.h"
 #include "log.h"
+#include "thread_setup.h"
+#include "trace.h"
 
 #ifndef WINDOWS
 #include <netinet/in.h>
@@ -16,6 +18,8 @@
 #endif
 
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 
 #ifndef WINDOWS
 #define GET_ERROR(_x) strerror(_x)
@@ -30,7 +34,10 @@ UdpConnection::UdpConnection(DroneCoreImpl &parent,
                              int local_port_number):
     Connection(parent),
     _local_ip(local_ip),
-    _local_port_number(local_port_number) {}
+    _local_port_number(local_port_number)
+{
+    std::fill(std::begin(_remote_index_by_sysid), std::end(_remote_index_by_sysid), -1);
+}
 
 UdpConnection::~UdpConnection()
 {
@@ -45,21 +52,41 @@ bool UdpConnection::is_ok() const
 
 ConnectionResult UdpConnection::start()
 {
-    if (!start_mavlink_receiver()) {
-        return ConnectionResult::CONNECTIONS_EXHAUSTED;
-    }
+    const unsigned num_sockets = get_num_sockets_to_open();
+    start_mavlink_receiver(num_sockets);
 
-    ConnectionResult ret = setup_port();
+    ConnectionResult ret = setup_port(num_sockets);
     if (ret != ConnectionResult::SUCCESS) {
         return ret;
     }
 
-    start_recv_thread();
+    start_recv_threads();
+
+    start_send_batcher([this](const uint8_t *data, size_t len) {
+        return write_buffer(data, len);
+    });
+
+    start_tx_scheduler([this](const mavlink_message_t &message) {
+        return transmit(message);
+    });
 
     return ConnectionResult::SUCCESS;
 }
 
-ConnectionResult UdpConnection::setup_port()
+unsigned UdpConnection::get_num_sockets_to_open() const
+{
+#if defined(LINUX)
+    // The event loop reads everything on one thread anyway.
+    if (_event_loop && _event_loop->is_running()) {
+        return 1;
+    }
+    return std::max(_num_sockets, 1u);
+#else
+    return 1;
+#endif
+}
+
+ConnectionResult UdpConnection::setup_port(unsigned num_sockets)
 {
 
 #ifdef WINDOWS
@@ -70,54 +97,171 @@ ConnectionResult UdpConnection::setup_port()
     }
 #endif
 
-    _socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    for (unsigned i = 0; i < num_sockets; ++i) {
+        int socket_fd = -1;
+        ConnectionResult ret = open_socket(num_sockets > 1, socket_fd);
+        if (socket_fd >= 0) {
+            // Also if it failed, so that stop() closes it.
+            _receive_sockets.emplace_back(new ReceiveSocket {socket_fd, i, nullptr, {}});
+            if (i == 0) {
+                _socket_fd = socket_fd;
+            }
+        }
+        if (ret != ConnectionResult::SUCCESS) {
+            return ret;
+        }
+    }
+
+    return ConnectionResult::SUCCESS;
+}
+
+ConnectionResult UdpConnection::open_socket(bool reuse_port, int &socket_fd)
+{
+    socket_fd = socket(AF_INET, SOCK_DGRAM, 0);
 
-    if (_socket_fd < 0) {
+    if (socket_fd < 0) {
         LogErr() << "socket error" << GET_ERROR(errno);
         return ConnectionResult::SOCKET_ERROR;
     }
 
+    const CliArg::SocketOptions &options = _socket_options;
+    if (options.send_buffer_size > 0 &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_SNDBUF,
+                   reinterpret_cast<const char *>(&options.send_buffer_size),
+                   sizeof(options.send_buffer_size)) != 0) {
+        LogWarn() << "setsockopt SO_SNDBUF error: " << GET_ERROR(errno);
+    }
+    if (options.receive_buffer_size > 0 &&
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVBUF,
+                   reinterpret_cast<const char *>(&options.receive_buffer_size),
+                   sizeof(options.receive_buffer_size)) != 0) {
+        LogWarn() << "setsockopt SO_RCVBUF error: " << GET_ERROR(errno);
+    }
+
+#if defined(LINUX)
+    if (reuse_port) {
+        // All sockets of the port form a group, the kernel picks one for each
+        // datagram by hashing its addresses.
+        int enable = 1;
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0) {
+            LogErr() << "SO_REUSEPORT error: " << GET_ERROR(errno);
+            return ConnectionResult::SOCKET_ERROR;
+        }
+    }
+#else
+    UNUSED(reuse_port);
+#endif
+
     struct sockaddr_in addr {};
     addr.sin_family = AF_INET;
     inet_pton(AF_INET, _local_ip.c_str(), &(addr.sin_addr));
     addr.sin_port = htons(_local_port_number);
 
-    if (bind(_socket_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    if (bind(socket_fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
         LogErr() << "bind error: " << GET_ERROR(errno);
         return ConnectionResult::BIND_ERROR;
     }
 
+#if defined(LINUX)
+    // Have the kernel stamp datagrams on arrival, so the time spent waiting
+    // for us to read them doesn't count towards the latency.
+    int enable = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable)) != 0) {
+        LogWarn() << "No receive timestamps: " << GET_ERROR(errno);
+    }
+
+    if (_busy_poll_s > 0.0 && !(_event_loop && _event_loop->is_running())) {
+        // Every read polls the device queue this long before giving up. Above
+        // net.core.busy_read this needs CAP_NET_ADMIN, we still spin without.
+        int busy_poll_us = int(std::min(_busy_poll_s * 1e6, 1e6));
+        if (setsockopt(socket_fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll_us,
+                       sizeof(busy_poll_us)) != 0) {
+            LogWarn() << "No SO_BUSY_POLL: " << GET_ERROR(errno);
+        }
+    }
+#endif
+
     return ConnectionResult::SUCCESS;
 }
 
-void UdpConnection::start_recv_thread()
+void UdpConnection::start_recv_threads()
 {
-    _recv_thread = new std::thread(receive, this);
+#if defined(LINUX)
+    for (auto &receive_socket : _receive_sockets) {
+        receive_socket->buffers.resize(BATCH_SIZE * RECV_BUFFER_LEN);
+    }
+
+    if (_event_loop && _event_loop->is_running()) {
+        // There is only one socket in this case.
+        ReceiveSocket *receive_socket = _receive_sockets[0].get();
+        _uses_event_loop = _event_loop->add_fd(_socket_fd, [this, receive_socket]() {
+            // Only take what is already there, we must not block the event loop.
+            receive_batch(*receive_socket, MSG_DONTWAIT);
+        });
+        if (_uses_event_loop) {
+            return;
+        }
+    }
+#endif
+    for (auto &receive_socket : _receive_sockets) {
+        receive_socket->thread = new std::thread(receive, this, receive_socket.get());
+    }
+}
+
+void UdpConnection::request_stop()
+{
+    _should_exit = true;
+
+#ifndef WINDOWS
+    // Interrupts a blocking recvmmsg/recvfrom, sending still works.
+    for (auto &receive_socket : _receive_sockets) {
+        shutdown(receive_socket->fd, SHUT_RD);
+    }
+#endif
 }
 
 ConnectionResult UdpConnection::stop()
 {
+    // Get the queued and batched messages out while the socket is still open.
+    stop_tx_scheduler();
+    stop_send_batcher();
+
     _should_exit = true;
 
+    if (_uses_event_loop) {
+        _event_loop->remove_fd(_socket_fd);
+        _uses_event_loop = false;
+    }
+
+    // Only once, stop() is called again by the destructor.
+    for (auto &receive_socket : _receive_sockets) {
 #ifndef WINDOWS
-    // This should interrupt a recv/recvfrom call.
-    shutdown(_socket_fd, SHUT_RDWR);
+        // This should interrupt a recv/recvfrom call.
+        shutdown(receive_socket->fd, SHUT_RDWR);
 
-    // But on Mac, closing is also needed to stop blocking recv/recvfrom.
-    close(_socket_fd);
+        // But on Mac, closing is also needed to stop blocking recv/recvfrom.
+        close(receive_socket->fd);
 #else
-    shutdown(_socket_fd, SD_BOTH);
-
-    closesocket(_socket_fd);
+        shutdown(receive_socket->fd, SD_BOTH);
 
-    WSACleanup();
+        closesocket(receive_socket->fd);
 #endif
+    }
+#ifdef WINDOWS
+    if (!_receive_sockets.empty()) {
+        WSACleanup();
+    }
+#endif
+    _socket_fd = -1;
+    _tos = 0;
 
-    if (_recv_thread) {
-        _recv_thread->join();
-        delete _recv_thread;
-        _recv_thread = nullptr;
+    for (auto &receive_socket : _receive_sockets) {
+        if (receive_socket->thread) {
+            receive_socket->thread->join();
+            delete receive_socket->thread;
+        }
     }
+    _receive_sockets.clear();
 
     // We need to stop this after stopping the receive thread, otherwise
     // it can happen that we interfere with the parsing of a message.
@@ -126,28 +270,81 @@ ConnectionResult UdpConnection::stop()
     return ConnectionResult::SUCCESS;
 }
 
-bool UdpConnection::send_message(const mavlink_message_t &message)
+int UdpConnection::find_remote(const struct sockaddr_in &addr) const
 {
-    struct sockaddr_in dest_addr {};
+    for (size_t i = 0; i < _remote_addrs.size(); ++i) {
+        if (_remote_addrs[i].sin_addr.s_addr == addr.sin_addr.s_addr &&
+            _remote_addrs[i].sin_port == addr.sin_port) {
+            return int(i);
+        }
+    }
+    return -1;
+}
 
-    {
-        std::lock_guard<std::mutex> lock(_remote_mutex);
+int UdpConnection::get_remote_index(uint8_t target_system_id) const
+{
+    // Broadcasts, and targets we don't know, go to everyone.
+    if (target_system_id == 0) {
+        return -1;
+    }
+    return _remote_index_by_sysid[target_system_id];
+}
 
-        if (_remote_ip.empty()) {
-            LogErr() << "Remote IP unknown";
-            return false;
-        }
+bool UdpConnection::send_to_remotes(const uint8_t *buffer, size_t buffer_len,
+                                    uint8_t target_system_id)
+{
+    if (_remote_addrs.empty()) {
+        LogErr() << "Remote IP/port unknown";
+        return false;
+    }
 
-        if (_remote_port_number == 0) {
-            LogErr() << "Remote port unknown";
-            return false;
+    const int remote_index = get_remote_index(target_system_id);
+    const size_t begin = (remote_index >= 0) ? size_t(remote_index) : 0;
+    const size_t end = (remote_index >= 0) ? size_t(remote_index) + 1 : _remote_addrs.size();
+
+    bool success = true;
+    for (size_t i = begin; i < end; ++i) {
+        int send_len = sendto(_socket_fd, reinterpret_cast<const char *>(buffer), buffer_len, 0,
+                              reinterpret_cast<const sockaddr *>(&_remote_addrs[i]),
+                              sizeof(_remote_addrs[i]));
+
+        if (send_len != int(buffer_len)) {
+            LogErr() << "sendto failure: " << GET_ERROR(errno);
+            success = false;
+        } else {
+            count_bytes_sent(buffer_len);
         }
+    }
+    return success;
+}
 
-        dest_addr.sin_family = AF_INET;
-
-        inet_pton(AF_INET, _remote_ip.c_str(), &dest_addr.sin_addr.s_addr);
+bool UdpConnection::send_message(const mavlink_message_t &message)
+{
+    if (_tx_scheduler) {
+        return _tx_scheduler->push(message);
+    }
+    return transmit(message);
+}
 
-        dest_addr.sin_port = htons(_remote_port_number);
+bool UdpConnection::transmit(const mavlink_message_t &message)
+{
+    const uint8_t target_system_id = get_target_system_id(message);
+    const TxScheduler::Priority priority = TxScheduler::get_priority(message.msgid);
+    count_frame_sent(message);
+
+    // With QoS only bulk messages are batched, a datagram has one class.
+    if (_send_batcher &&
+        !(_socket_options.qos && priority == TxScheduler::Priority::CONTROL)) {
+        bool has_single_target = false;
+        {
+            std::lock_guard<std::mutex> lock(_remote_mutex);
+            has_single_target = (_remote_addrs.size() > 1 &&
+                                 get_remote_index(target_system_id) >= 0);
+        }
+        // Batches go to all remotes, so don't put a message for only one in there.
+        if (!has_single_target) {
+            return _send_batcher->push(message);
+        }
     }
 
     uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
@@ -156,27 +353,135 @@ bool UdpConnection::send_message(const mavlink_message_t &message)
     // TODO: remove this assert again
     assert(buffer_len <= MAVLINK_MAX_PACKET_LEN);
 
-    int send_len = sendto(_socket_fd, reinterpret_cast<char *>(buffer), buffer_len, 0,
-                          reinterpret_cast<const sockaddr *>(&dest_addr), sizeof(dest_addr));
+    std::lock_guard<std::mutex> lock(_remote_mutex);
+    set_traffic_class(priority);
+    return send_to_remotes(buffer, buffer_len, target_system_id);
+}
+
+bool UdpConnection::write_buffer(const uint8_t *buffer, size_t buffer_len)
+{
+    std::lock_guard<std::mutex> lock(_remote_mutex);
+    set_traffic_class(TxScheduler::Priority::BULK);
+    return send_to_remotes(buffer, buffer_len, 0);
+}
+
+void UdpConnection::set_traffic_class(TxScheduler::Priority priority)
+{
+    if (!_socket_options.qos) {
+        return;
+    }
+
+    // The sending socket is shared by both classes, it is only changed when the
+    // class does, which is rare compared to the messages sent.
+    const int tos = get_tos(priority);
+    if (tos == _tos) {
+        return;
+    }
+#ifndef WINDOWS
+    if (setsockopt(_socket_fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0) {
+        LogWarn() << "setsockopt IP_TOS error: " << GET_ERROR(errno);
+    }
+#endif
+    _tos = tos;
+}
+
+bool UdpConnection::send_messages(const std::vector<mavlink_message_t> &messages)
+{
+    if (_send_batcher || _tx_scheduler || _socket_options.qos) {
+        // Packing them into as few datagrams as possible beats sendmmsg,
+        // and the scheduler needs to see every message, as does QoS marking.
+        return Connection::send_messages(messages);
+    }
+
+#if defined(LINUX)
+    std::lock_guard<std::mutex> lock(_remote_mutex);
 
-    if (send_len != buffer_len) {
-        LogErr() << "sendto failure: " << GET_ERROR(errno);
+    if (_remote_addrs.empty()) {
+        LogErr() << "Remote IP/port unknown";
         return false;
     }
 
+    uint8_t buffers[BATCH_SIZE][MAVLINK_MAX_PACKET_LEN];
+    struct iovec iovecs[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    unsigned batch_len = 0;
+
+    auto send_batch = [&]() {
+        unsigned sent = 0;
+        while (sent < batch_len) {
+            int ret = sendmmsg(_socket_fd, &msgs[sent], batch_len - sent, 0);
+            if (ret <= 0) {
+                LogErr() << "sendmmsg failure: " << GET_ERROR(errno);
+                return false;
+            }
+            for (unsigned i = sent; i < sent + unsigned(ret); ++i) {
+                count_bytes_sent(iovecs[i].iov_len);
+            }
+            sent += unsigned(ret);
+        }
+        batch_len = 0;
+        return true;
+    };
+
+    for (const auto &message : messages) {
+        uint8_t frame[MAVLINK_MAX_PACKET_LEN];
+        const uint16_t frame_len = mavlink_msg_to_send_buffer(frame, &message);
+        count_frame_sent(message);
+
+        const int remote_index = get_remote_index(get_target_system_id(message));
+        const size_t begin = (remote_index >= 0) ? size_t(remote_index) : 0;
+        const size_t end = (remote_index >= 0) ? size_t(remote_index) + 1 : _remote_addrs.size();
+
+        for (size_t remote = begin; remote < end; ++remote) {
+            if (batch_len == BATCH_SIZE && !send_batch()) {
+                return false;
+            }
+
+            std::memcpy(buffers[batch_len], frame, frame_len);
+            iovecs[batch_len].iov_base = buffers[batch_len];
+            iovecs[batch_len].iov_len = frame_len;
+            std::memset(&msgs[batch_len], 0, sizeof(msgs[batch_len]));
+            msgs[batch_len].msg_hdr.msg_iov = &iovecs[batch_len];
+            msgs[batch_len].msg_hdr.msg_iovlen = 1;
+            msgs[batch_len].msg_hdr.msg_name = &_remote_addrs[remote];
+            msgs[batch_len].msg_hdr.msg_namelen = sizeof(_remote_addrs[remote]);
+            ++batch_len;
+        }
+    }
+    return send_batch();
+#else
+    for (const auto &message : messages) {
+        if (!send_message(message)) {
+            return false;
+        }
+    }
     return true;
+#endif
 }
 
-void UdpConnection::receive(UdpConnection *parent)
+void UdpConnection::receive(UdpConnection *parent, ReceiveSocket *receive_socket)
 {
-    // Enough for MTU 1500 bytes.
-    char buffer[2048];
+    setup_thread(ThreadRole::Io, "udp_recv");
+
+#if defined(LINUX)
+    while (!parent->_should_exit) {
+        if (parent->_busy_poll_s > 0.0) {
+            if (!parent->receive_spinning(*receive_socket)) {
+                parent->receive_parked(*receive_socket);
+            }
+            continue;
+        }
+        // Block for the first datagram, then take whatever else is already queued.
+        parent->receive_batch(*receive_socket, MSG_WAITFORONE);
+    }
+#else
+    char buffer[RECV_BUFFER_LEN];
 
     while (!parent->_should_exit) {
 
         struct sockaddr_in src_addr = {};
         socklen_t src_addr_len = sizeof(src_addr);
-        int recv_len = recvfrom(parent->_socket_fd, buffer, sizeof(buffer), 0,
+        int recv_len = recvfrom(receive_socket->fd, buffer, sizeof(buffer), 0,
                                 reinterpret_cast<struct sockaddr *>(&src_addr), &src_addr_len);
 
         if (recv_len == 0) {
@@ -192,42 +497,157 @@ void UdpConnection::receive(UdpConnection *parent)
             continue;
         }
 
-        {
-            std::lock_guard<std::mutex> lock(parent->_remote_mutex);
-
-            int new_remote_port_number = ntohs(src_addr.sin_port);
-            std::string new_remote_ip(inet_ntoa(src_addr.sin_addr));
+        parent->receive_datagram(*parent->_mavlink_receiver, buffer, recv_len, src_addr,
+                                 parent->_time.steady_time());
+    }
+#endif
+}
 
-            if (parent->_remote_ip.empty() ||
-                parent->_remote_port_number == 0) {
+#if defined(LINUX)
+int UdpConnection::receive_batch(ReceiveSocket &receive_socket, int flags)
+{
+    // Fetch several datagrams per syscall when a lot of traffic is coming in.
+    struct iovec iovecs[BATCH_SIZE];
+    struct mmsghdr msgs[BATCH_SIZE];
+    struct sockaddr_in src_addrs[BATCH_SIZE];
+    // For the SO_TIMESTAMPNS of each datagram.
+    char controls[BATCH_SIZE][CMSG_SPACE(sizeof(struct timespec))];
+
+    std::memset(msgs, 0, sizeof(msgs));
+    for (unsigned i = 0; i < BATCH_SIZE; ++i) {
+        iovecs[i].iov_base = &receive_socket.buffers[i * RECV_BUFFER_LEN];
+        iovecs[i].iov_len = RECV_BUFFER_LEN;
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &src_addrs[i];
+        msgs[i].msg_hdr.msg_namelen = sizeof(src_addrs[i]);
+        msgs[i].msg_hdr.msg_control = controls[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(controls[i]);
+    }
 
-                // Set IP if we don't know it yet.
-                parent->_remote_ip = new_remote_ip;
-                parent->_remote_port_number = new_remote_port_number;
+    int num_received = recvmmsg(receive_socket.fd, msgs, BATCH_SIZE, flags, nullptr);
 
-                LogInfo() << "New device on: " << parent->_remote_ip
-                          << ":" << parent->_remote_port_number;
+    if (num_received <= 0) {
+        // This happens on desctruction when close(_socket_fd) is called,
+        // therefore be quiet.
+        return 0;
+    }
 
-            } else if (parent->_remote_ip.compare(new_remote_ip) != 0 ||
-                       parent->_remote_port_number != new_remote_port_number) {
+    // The kernel stamps with the wall clock, taken together with the steady
+    // one to know how long ago that was.
+    const std::chrono::system_clock::time_point wall_now = std::chrono::system_clock::now();
+    const dl_time_t now = _time.steady_time();
 
-                // It is possible that wifi disconnects and a device might get a new
-                // IP and/or UDP port.
-                parent->_remote_ip = new_remote_ip;
-                parent->_remote_port_number = new_remote_port_number;
+    MAVLinkReceiver &receiver = get_mavlink_receiver(receive_socket.receiver_index);
+    for (int i = 0; i < num_received; ++i) {
+        if (msgs[i].msg_len == 0) {
+            continue;
+        }
+        receive_datagram(receiver, &receive_socket.buffers[i * RECV_BUFFER_LEN],
+                         int(msgs[i].msg_len), src_addrs[i],
+                         get_receive_time(msgs[i].msg_hdr, wall_now, now));
+    }
+    return num_received;
+}
 
-                LogInfo() << "Device changed to: " << new_remote_ip << ":" << new_remote_port_number;
-            }
+bool UdpConnection::receive_spinning(ReceiveSocket &receive_socket)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                              std::chrono::duration<double>(_busy_poll_s));
+
+    while (!_should_exit) {
+        const bool received = (receive_batch(receive_socket, MSG_DONTWAIT) > 0);
+        const auto now = std::chrono::steady_clock::now();
+        if (received || now >= deadline) {
+            count_receive_wait(true, now - start, received);
+            return received;
         }
+    }
+    return false;
+}
 
-        parent->_mavlink_receiver->set_new_datagram(buffer, recv_len);
+void UdpConnection::receive_parked(ReceiveSocket &receive_socket)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const bool received = (receive_batch(receive_socket, MSG_WAITFORONE) > 0);
+    count_receive_wait(false, std::chrono::steady_clock::now() - start, received);
+}
 
-        // Parse all mavlink messages in one datagram. Once exhausted, we'll exit while.
-        while (parent->_mavlink_receiver->parse_message()) {
-            parent->receive_message(parent->_mavlink_receiver->get_last_message());
+dl_time_t UdpConnection::get_receive_time(struct msghdr &msg_hdr,
+                                          const std::chrono::system_clock::time_point &wall_now,
+                                          const dl_time_t &now)
+{
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg_hdr); cmsg != nullptr;
+         cmsg = CMSG_NXTHDR(&msg_hdr, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPNS) {
+            continue;
         }
+        struct timespec stamp;
+        std::memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+
+        const std::chrono::nanoseconds age =
+            wall_now.time_since_epoch() -
+            (std::chrono::seconds(stamp.tv_sec) + std::chrono::nanoseconds(stamp.tv_nsec));
+        if (age.count() < 0 || std::chrono::duration<double>(age).count() > MAX_TIMESTAMP_AGE_S) {
+            break;
+        }
+        return now - std::chrono::duration_cast<dl_time_t::duration>(age);
+    }
+    // Not stamped, e.g. the option isn't supported.
+    return now;
+}
+#endif
+
+void UdpConnection::receive_datagram(MAVLinkReceiver &receiver, char *buffer, int recv_len,
+                                     const struct sockaddr_in &src_addr,
+                                     const dl_time_t &receive_time)
+{
+    DRONECORE_TRACE_SCOPE("udp receive");
+    receiver.set_new_datagram(buffer, recv_len);
+
+    // Parse all mavlink messages in one datagram. Once exhausted, we'll exit while.
+    while (receiver.parse_message()) {
+        const mavlink_message_t &message = receiver.get_last_message();
+        learn_remote(message.sysid, src_addr);
+        receive_message(receiver, message, receive_time);
     }
 }
 
+void UdpConnection::learn_remote(uint8_t system_id, const struct sockaddr_in &src_addr)
+{
+    std::lock_guard<std::mutex> lock(_remote_mutex);
+
+    const int old_index = _remote_index_by_sysid[system_id];
+    if (old_index >= 0 &&
+        _remote_addrs[old_index].sin_addr.s_addr == src_addr.sin_addr.s_addr &&
+        _remote_addrs[old_index].sin_port == src_addr.sin_port) {
+        // Nothing new, which is almost always the case.
+        return;
+    }
+
+    int new_index = find_remote(src_addr);
+
+    if (new_index < 0 && old_index >= 0 &&
+        std::count(std::begin(_remote_index_by_sysid), std::end(_remote_index_by_sysid),
+                   old_index) == 1) {
+        // It is possible that wifi disconnects and a device might get a new
+        // IP and/or UDP port. Nobody else uses the old one, so replace it.
+        _remote_addrs[old_index] = src_addr;
+        new_index = old_index;
+
+        LogInfo() << "Device changed to: " << inet_ntoa(src_addr.sin_addr)
+                  << ":" << ntohs(src_addr.sin_port);
+
+    } else if (new_index < 0) {
+        _remote_addrs.push_back(src_addr);
+        new_index = int(_remote_addrs.size()) - 1;
+
+        LogInfo() << "New device on: " << inet_ntoa(src_addr.sin_addr)
+                  << ":" << ntohs(src_addr.sin_port);
+    }
+
+    _remote_index_by_sysid[system_id] = new_index;
+}
 
 } // namespace dronecore
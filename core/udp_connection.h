@@ -4,8 +4,17 @@
 #include <mutex>
 #include <thread>
 #include <atomic>
+#include <vector>
+#include <memory>
 #include "connection.h"
 
+#ifndef WINDOWS
+#include <netinet/in.h>
+#else
+#include <winsock2.h>
+#undef SOCKET_ERROR // conflicts with ConnectionResult::SOCKET_ERROR
+#endif
+
 namespace dronecore {
 
 class UdpConnection : public Connection
@@ -16,28 +25,90 @@ public:
     bool is_ok() const;
     ConnectionResult start();
     ConnectionResult stop();
+    void request_stop() override;
 
     bool send_message(const mavlink_message_t &message);
+    bool send_messages(const std::vector<mavlink_message_t> &messages);
+
+    // Opens several sockets on the same port (SO_REUSEPORT), each with its own
+    // receive thread. The kernel spreads the remotes over them by address, so
+    // all datagrams of one remote are still read by the same thread.
+    // Needs to be set before start(), only Linux without event loop supports more than 1.
+    void set_num_sockets(unsigned num_sockets) { _num_sockets = num_sockets; }
+
+    // The receive threads poll for up to max_spin_s after each read before they
+    // block again, this saves the wakeup at the cost of a busy core.
+    // Needs to be set before start(), only Linux without event loop, 0 disables it.
+    void set_busy_poll(double max_spin_s) { _busy_poll_s = max_spin_s; }
 
     // Non-copyable
     UdpConnection(const UdpConnection &) = delete;
     const UdpConnection &operator=(const UdpConnection &) = delete;
 
 private:
-    ConnectionResult setup_port();
-    void start_recv_thread();
+    // One of the sockets bound to the port, the first one is also used for sending.
+    struct ReceiveSocket {
+        int fd;
+        // Index of the receiver parsing what comes in on it.
+        unsigned receiver_index;
+        std::thread *thread;
+        std::vector<char> buffers;
+    };
 
-    static void receive(UdpConnection *parent);
+    unsigned get_num_sockets_to_open() const;
+    ConnectionResult setup_port(unsigned num_sockets);
+    ConnectionResult open_socket(bool reuse_port, int &socket_fd);
+    bool transmit(const mavlink_message_t &message);
+    bool write_buffer(const uint8_t *buffer, size_t buffer_len);
+    void start_recv_threads();
+
+    static void receive(UdpConnection *parent, ReceiveSocket *receive_socket);
+    int receive_batch(ReceiveSocket &receive_socket, int flags);
+    // Returns false if nothing came in while polling.
+    bool receive_spinning(ReceiveSocket &receive_socket);
+    void receive_parked(ReceiveSocket &receive_socket);
+    static dl_time_t get_receive_time(struct msghdr &msg_hdr,
+                                      const std::chrono::system_clock::time_point &wall_now,
+                                      const dl_time_t &now);
+    void receive_datagram(MAVLinkReceiver &receiver, char *buffer, int recv_len,
+                          const struct sockaddr_in &src_addr, const dl_time_t &receive_time);
+    void learn_remote(uint8_t system_id, const struct sockaddr_in &src_addr);
+
+    // Need to be called with _remote_mutex locked.
+    int find_remote(const struct sockaddr_in &addr) const;
+    int get_remote_index(uint8_t target_system_id) const;
+    bool send_to_remotes(const uint8_t *buffer, size_t buffer_len, uint8_t target_system_id);
+    void set_traffic_class(TxScheduler::Priority priority);
 
     std::string _local_ip;
     int _local_port_number;
 
+    // Several systems can talk to us on the same port, so we remember the
+    // address for every sysid. Targeted messages only go to their system,
+    // everything else goes to all remotes we know of.
+    // The addresses are kept in their binary form so that sending doesn't need
+    // to convert them for every message.
     std::mutex _remote_mutex {};
-    std::string _remote_ip {};
-    int _remote_port_number {0};
+    std::vector<struct sockaddr_in> _remote_addrs {};
+    // Index into _remote_addrs or -1 if unknown.
+    int _remote_index_by_sysid[256];
+    // IP_TOS of the sending socket, also protected by _remote_mutex.
+    int _tos {0};
+
+    // Enough for MTU 1500 bytes.
+    static constexpr size_t RECV_BUFFER_LEN = 2048;
+    // Number of datagrams fetched or sent per recvmmsg/sendmmsg call.
+    static constexpr unsigned BATCH_SIZE = 16;
+    // Kernel timestamps older than this are rather off because the
+    // wall clock was set, the time we get to them is used instead.
+    static constexpr double MAX_TIMESTAMP_AGE_S = 1.0;
 
+    unsigned _num_sockets {1};
+    double _busy_poll_s {0.0};
+    // Used for sending, same as the fd of the first receive socket.
     int _socket_fd {-1};
-    std::thread *_recv_thread {nullptr};
+    std::vector<std::unique_ptr<ReceiveSocket>> _receive_sockets {};
+    bool _uses_event_loop {false};
     std::atomic_bool _should_exit {false};
 };
 
@@ -0,0 +1,211 @@
+#include "unix_connection.h"
+#include "global_include.h"
+#include "log.h"
+#include "thread_setup.h"
+
+#if defined(LINUX)
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <unistd.h> // for close()
+#endif
+
+#include <cstring>
+
+#define GET_ERROR(_x) strerror(_x)
+
+namespace dronecore {
+
+UnixConnection::UnixConnection(DroneCoreImpl &parent, const std::string &path) :
+    Connection(parent),
+    _path(path) {}
+
+UnixConnection::~UnixConnection()
+{
+    // If no one explicitly called stop before, we should at least do it.
+    stop();
+}
+
+bool UnixConnection::is_ok() const
+{
+    return _is_ok;
+}
+
+ConnectionResult UnixConnection::start()
+{
+#if defined(LINUX)
+    start_mavlink_receiver();
+
+    ConnectionResult ret = setup_port();
+    if (ret != ConnectionResult::SUCCESS) {
+        return ret;
+    }
+
+    start_recv_thread();
+
+    start_send_batcher([this](const uint8_t *data, size_t len) {
+        return write_buffer(data, len);
+    });
+
+    start_tx_scheduler([this](const mavlink_message_t &message) {
+        return transmit(message);
+    });
+
+    return ConnectionResult::SUCCESS;
+#else
+    LogErr() << "Unix socket connections are only supported on Linux";
+    return ConnectionResult::NOT_IMPLEMENTED;
+#endif
+}
+
+ConnectionResult UnixConnection::setup_port()
+{
+#if defined(LINUX)
+    struct sockaddr_un remote_addr {};
+    remote_addr.sun_family = AF_UNIX;
+
+    if (_path.length() >= sizeof(remote_addr.sun_path)) {
+        LogErr() << "Unix socket path too long: " << _path;
+        return ConnectionResult::CONNECTION_URL_INVALID;
+    }
+    std::strncpy(remote_addr.sun_path, _path.c_str(), sizeof(remote_addr.sun_path) - 1);
+
+    _socket_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+    if (_socket_fd < 0) {
+        LogErr() << "socket error" << GET_ERROR(errno);
+        return ConnectionResult::SOCKET_ERROR;
+    }
+
+    if (connect(_socket_fd, reinterpret_cast<sockaddr *>(&remote_addr),
+                sizeof(remote_addr)) < 0) {
+        LogErr() << "connect error: " << GET_ERROR(errno);
+        close(_socket_fd);
+        _socket_fd = -1;
+        return ConnectionResult::SOCKET_CONNECTION_ERROR;
+    }
+
+    _is_ok = true;
+    return ConnectionResult::SUCCESS;
+#else
+    return ConnectionResult::NOT_IMPLEMENTED;
+#endif
+}
+
+void UnixConnection::start_recv_thread()
+{
+    _recv_thread = new std::thread(receive, this);
+}
+
+void UnixConnection::request_stop()
+{
+    _should_exit = true;
+
+#if defined(LINUX)
+    // Interrupts a blocking recv, sending still works.
+    if (_socket_fd >= 0) {
+        shutdown(_socket_fd, SHUT_RD);
+    }
+#endif
+}
+
+ConnectionResult UnixConnection::stop()
+{
+    // Get the queued and batched messages out while the socket is still open.
+    stop_tx_scheduler();
+    stop_send_batcher();
+
+    _should_exit = true;
+
+#if defined(LINUX)
+    if (_socket_fd >= 0) {
+        // This should interrupt a recv call.
+        shutdown(_socket_fd, SHUT_RDWR);
+        close(_socket_fd);
+        _socket_fd = -1;
+    }
+#endif
+
+    if (_recv_thread) {
+        _recv_thread->join();
+        delete _recv_thread;
+        _recv_thread = nullptr;
+    }
+
+    // We need to stop this after stopping the receive thread, otherwise
+    // it can happen that we interfere with the parsing of a message.
+    stop_mavlink_receiver();
+
+    return ConnectionResult::SUCCESS;
+}
+
+bool UnixConnection::send_message(const mavlink_message_t &message)
+{
+    if (_tx_scheduler) {
+        return _tx_scheduler->push(message);
+    }
+    return transmit(message);
+}
+
+bool UnixConnection::transmit(const mavlink_message_t &message)
+{
+    return write_message(message);
+}
+
+bool UnixConnection::write_buffer(const uint8_t *buffer, size_t buffer_len)
+{
+#if defined(LINUX)
+    std::lock_guard<std::mutex> lock(_send_mutex);
+
+    // A packet is sent whole or not at all. Don't get killed by SIGPIPE if the
+    // bridge went away.
+    const ssize_t send_len = send(_socket_fd, buffer, buffer_len, MSG_NOSIGNAL);
+
+    if (send_len != ssize_t(buffer_len)) {
+        LogErr() << "send failure: " << GET_ERROR(errno);
+        _is_ok = false;
+        return false;
+    }
+    count_bytes_sent(buffer_len);
+    return true;
+#else
+    UNUSED(buffer);
+    UNUSED(buffer_len);
+    return false;
+#endif
+}
+
+void UnixConnection::receive(UnixConnection *parent)
+{
+    setup_thread(ThreadRole::Io, "unix_recv");
+
+#if defined(LINUX)
+    char buffer[RECV_BUFFER_LEN];
+
+    while (!parent->_should_exit) {
+        const ssize_t recv_len = recv(parent->_socket_fd, buffer, sizeof(buffer), 0);
+
+        if (recv_len <= 0) {
+            // 0 means the bridge closed the socket, otherwise this happens on
+            // destruction when the socket is shut down.
+            if (!parent->_should_exit && parent->_is_ok) {
+                LogErr() << "Unix socket closed";
+            }
+            parent->_is_ok = false;
+            break;
+        }
+
+        // The packet is parsed right from the receive buffer.
+        parent->_mavlink_receiver->set_new_datagram(buffer, unsigned(recv_len));
+
+        // Parse all mavlink messages in one packet. Once exhausted, we'll exit while.
+        while (parent->_mavlink_receiver->parse_message()) {
+            parent->receive_message(parent->_mavlink_receiver->get_last_message());
+        }
+    }
+#else
+    UNUSED(parent);
+#endif
+}
+
+} // namespace dronecore
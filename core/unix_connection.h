@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include "connection.h"
+
+namespace dronecore {
+
+// Connects to a MAVLink bridge on the same host (e.g. mavlink-router or SITL)
+// through a SOCK_SEQPACKET Unix domain socket. Packet boundaries are kept, so
+// every packet holds whole MAVLink frames and is handed to the parser directly
+// from the receive buffer. Only available on Linux.
+class UnixConnection : public Connection
+{
+public:
+    explicit UnixConnection(DroneCoreImpl &parent, const std::string &path);
+    ~UnixConnection();
+    bool is_ok() const;
+    ConnectionResult start();
+    ConnectionResult stop();
+    void request_stop() override;
+
+    bool send_message(const mavlink_message_t &message);
+
+    // Non-copyable
+    UnixConnection(const UnixConnection &) = delete;
+    const UnixConnection &operator=(const UnixConnection &) = delete;
+
+private:
+    ConnectionResult setup_port();
+    bool transmit(const mavlink_message_t &message);
+    bool write_buffer(const uint8_t *buffer, size_t buffer_len);
+    void start_recv_thread();
+    static void receive(UnixConnection *parent);
+
+    // Bigger than any batch of frames we send or expect to receive.
+    static constexpr size_t RECV_BUFFER_LEN = 4096;
+
+    std::string _path;
+
+    std::mutex _send_mutex {};
+    int _socket_fd {-1};
+
+    std::thread *_recv_thread {nullptr};
+    std::atomic_bool _should_exit {false};
+    std::atomic_bool _is_ok {false};
+};
+
+} // namespace dronecore
@@ -0,0 +1,40 @@
+#include "dronecore_impl.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+using namespace dronecore;
+
+TEST(UuidCache, KeptAcrossSessions)
+{
+    {
+        DroneCoreImpl dc;
+        dc.set_param_cache_dir(".");
+
+        uint64_t uuid;
+        EXPECT_FALSE(dc.get_cached_uuid(1, uuid));
+        dc.cache_uuid(1, 0x1234567890ABCDEF);
+        dc.cache_uuid(42, 42);
+    }
+
+    DroneCoreImpl dc;
+    dc.set_param_cache_dir(".");
+
+    uint64_t uuid = 0;
+    EXPECT_TRUE(dc.get_cached_uuid(1, uuid));
+    EXPECT_EQ(uuid, 0x1234567890ABCDEFu);
+    EXPECT_TRUE(dc.get_cached_uuid(42, uuid));
+    EXPECT_EQ(uuid, 42u);
+    EXPECT_FALSE(dc.get_cached_uuid(2, uuid));
+
+    std::remove("./uuids.txt");
+}
+
+TEST(UuidCache, OnlyInMemoryWithoutDir)
+{
+    DroneCoreImpl dc;
+    dc.cache_uuid(3, 33);
+
+    uint64_t uuid = 0;
+    EXPECT_TRUE(dc.get_cached_uuid(3, uuid));
+    EXPECT_EQ(uuid, 33u);
+}
@@ -0,0 +1,208 @@
+#include "virtual_clock.h"
+#include "log.h"
+#include "thread_setup.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dronecore {
+
+namespace {
+
+struct Deadline {
+    dl_time_t time;
+    VirtualClock::wake_t wake;
+};
+
+std::atomic<bool> enabled {false};
+std::atomic<uint64_t> activity {0};
+std::atomic<uint64_t> advances {0};
+
+// Guards everything below.
+std::mutex mutex;
+std::condition_variable clock_cv;
+std::condition_variable sleep_cv;
+std::map<const void *, Deadline> deadlines;
+std::chrono::steady_clock::duration settle {};
+bool should_exit {false};
+unsigned replays {0};
+std::thread *thread {nullptr};
+
+} // namespace
+
+bool VirtualClock::enable(double settle_s)
+{
+    if (!(settle_s > 0.0)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (thread != nullptr) {
+        return false;
+    }
+    if (replays > 0) {
+        LogErr() << "Virtual time can't be enabled while replaying a log";
+        return false;
+    }
+
+    settle = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                 std::chrono::duration<double>(settle_s));
+    should_exit = false;
+    Time::set_virtual_time(std::chrono::steady_clock::now());
+    enabled.store(true, std::memory_order_release);
+    thread = new std::thread(clock_thread);
+    return true;
+}
+
+void VirtualClock::disable()
+{
+    std::thread *clock_thread = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (thread == nullptr) {
+            return;
+        }
+        should_exit = true;
+        enabled.store(false, std::memory_order_release);
+        clock_thread = thread;
+        thread = nullptr;
+    }
+    clock_cv.notify_all();
+    clock_thread->join();
+    delete clock_thread;
+
+    Time::clear_virtual_time();
+
+    // Everyone waiting goes back to the real clock.
+    std::lock_guard<std::mutex> lock(mutex);
+    sleep_cv.notify_all();
+    for (const auto &deadline : deadlines) {
+        if (deadline.second.wake) {
+            deadline.second.wake();
+        }
+    }
+}
+
+bool VirtualClock::is_enabled()
+{
+    return enabled.load(std::memory_order_acquire);
+}
+
+void VirtualClock::set_deadline(const void *key, dl_time_t deadline, const wake_t &wake)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    deadlines[key] = Deadline {deadline, wake};
+}
+
+void VirtualClock::clear_deadline(const void *key)
+{
+    // Also waits for its wake to return, so the owner can go away after this.
+    std::lock_guard<std::mutex> lock(mutex);
+    deadlines.erase(key);
+}
+
+void VirtualClock::sleep_until(dl_time_t deadline)
+{
+    Time time;
+    const int key = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    deadlines[&key] = Deadline {deadline, nullptr};
+    sleep_cv.wait(lock, [&time, deadline]() {
+        return !is_enabled() || time.steady_time() >= deadline;
+    });
+    deadlines.erase(&key);
+    lock.unlock();
+
+    touch();
+}
+
+void VirtualClock::touch()
+{
+    if (is_enabled()) {
+        activity.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t VirtualClock::num_advances()
+{
+    return advances.load(std::memory_order_relaxed);
+}
+
+bool VirtualClock::begin_replay()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (thread != nullptr) {
+        LogErr() << "A log can't be replayed while virtual time is enabled";
+        return false;
+    }
+    ++replays;
+    return true;
+}
+
+void VirtualClock::end_replay()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (replays > 0) {
+        --replays;
+    }
+}
+
+void VirtualClock::clock_thread()
+{
+    setup_thread(ThreadRole::System, "virtual_clock");
+
+    Time time;
+    std::unique_lock<std::mutex> lock(mutex);
+    uint64_t last_activity = activity.load(std::memory_order_relaxed);
+    while (!should_exit) {
+        clock_cv.wait_for(lock, settle);
+        if (should_exit) {
+            break;
+        }
+
+        // Only once everything settled, replies from simulated peers might
+        // still be on their way otherwise.
+        const uint64_t current_activity = activity.load(std::memory_order_relaxed);
+        if (current_activity != last_activity) {
+            last_activity = current_activity;
+            continue;
+        }
+        if (deadlines.empty()) {
+            continue;
+        }
+
+        // Deadlines passed already are from owners which are busy or don't
+        // wait anymore, they don't hold the clock back.
+        dl_time_t now = time.steady_time();
+        bool has_next = false;
+        dl_time_t next {};
+        for (const auto &deadline : deadlines) {
+            if (deadline.second.time > now && (!has_next || deadline.second.time < next)) {
+                next = deadline.second.time;
+                has_next = true;
+            }
+        }
+        if (has_next) {
+            now = next;
+            Time::set_virtual_time(now);
+            advances.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Everyone due, again on every tick in case a wake got lost while the
+        // owner was about to wait.
+        sleep_cv.notify_all();
+        for (const auto &deadline : deadlines) {
+            if (deadline.second.wake && deadline.second.time <= now) {
+                deadline.second.wake();
+            }
+        }
+    }
+}
+
+} // namespace dronecore
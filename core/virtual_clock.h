@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "global_include.h"
+
+namespace dronecore {
+
+// Accelerated virtual time, for running scenarios against simulated peers
+// faster than real time. While enabled, the steady time of all Time instances
+// is virtual and stands still as long as there is work. Once nothing happened
+// for settle_s of real time, the clock jumps to the earliest deadline anyone
+// waits for: the next work of a SystemScheduler or the end of a sleep.
+//
+// Like Time::set_virtual_time() this is global for the process, and it can't
+// be enabled while a log file is replayed, nor a log replayed while it is
+// enabled. It is meant to stay enabled for as long
+// as DroneCore instances exist, deadlines set before or during it aren't
+// moved when it is disabled.
+class VirtualClock
+{
+public:
+    typedef std::function<void()> wake_t;
+
+    // The clock starts at the current steady time.
+    static bool enable(double settle_s);
+    static void disable();
+    static bool is_enabled();
+
+    // For the owner of the key to be woken once the clock reached the
+    // deadline. Setting it again replaces the deadline of the key.
+    static void set_deadline(const void *key, dl_time_t deadline, const wake_t &wake);
+    static void clear_deadline(const void *key);
+
+    // Blocks until the clock reached the deadline, or it is disabled.
+    static void sleep_until(dl_time_t deadline);
+
+    // To be called by whoever does work, it keeps the clock from advancing
+    // for another settle_s.
+    static void touch();
+
+    // How often the clock jumped ahead.
+    static uint64_t num_advances();
+
+    // Around replaying a log, false if the clock is enabled.
+    static bool begin_replay();
+    static void end_replay();
+
+private:
+    static void clock_thread();
+};
+
+} // namespace dronecore
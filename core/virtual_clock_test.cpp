@@ -0,0 +1,169 @@
+#include "virtual_clock.h"
+#include "system_scheduler.h"
+#include "timeout_handler.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+double real_elapsed_s(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
+
+} // namespace
+
+TEST(VirtualClock, EnablesOnce)
+{
+    EXPECT_FALSE(VirtualClock::enable(0.0));
+    EXPECT_FALSE(VirtualClock::is_enabled());
+
+    ASSERT_TRUE(VirtualClock::enable(0.001));
+    EXPECT_TRUE(VirtualClock::is_enabled());
+    EXPECT_FALSE(VirtualClock::enable(0.001));
+
+    VirtualClock::disable();
+    EXPECT_FALSE(VirtualClock::is_enabled());
+}
+
+TEST(VirtualClock, ExcludesReplay)
+{
+    ASSERT_TRUE(VirtualClock::begin_replay());
+    EXPECT_FALSE(VirtualClock::enable(0.001));
+    VirtualClock::end_replay();
+
+    ASSERT_TRUE(VirtualClock::enable(0.001));
+    EXPECT_FALSE(VirtualClock::begin_replay());
+    VirtualClock::disable();
+}
+
+TEST(VirtualClock, SleepsSkipAhead)
+{
+    ASSERT_TRUE(VirtualClock::enable(0.001));
+    Time time;
+    const dl_time_t start = time.steady_time();
+    const auto real_start = std::chrono::steady_clock::now();
+
+    time.sleep_for(std::chrono::minutes(10));
+
+    EXPECT_GE(time.elapsed_since_s(start), 600.0);
+    EXPECT_LT(real_elapsed_s(real_start), 1.0);
+
+    VirtualClock::disable();
+}
+
+TEST(VirtualClock, SchedulerRunsOnVirtualTime)
+{
+    ASSERT_TRUE(VirtualClock::enable(0.001));
+    Time time;
+    const auto real_start = std::chrono::steady_clock::now();
+
+    std::mutex mutex;
+    std::vector<dl_time_t> run_times;
+    {
+        SystemScheduler scheduler;
+        int key;
+        scheduler.add(&key, [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            run_times.push_back(time.steady_time());
+            return 10.0;
+        });
+
+        while (real_elapsed_s(real_start) < 5.0) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (run_times.size() >= 10) {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        scheduler.remove(&key);
+    }
+    VirtualClock::disable();
+
+    // Every 10 s of virtual time, in much less real time.
+    ASSERT_GE(run_times.size(), 10u);
+    for (size_t i = 1; i < run_times.size(); ++i) {
+        EXPECT_DOUBLE_EQ(std::chrono::duration<double>(run_times[i] - run_times[i - 1]).count(),
+                         10.0);
+    }
+    EXPECT_LT(real_elapsed_s(real_start), 5.0);
+    EXPECT_GE(VirtualClock::num_advances(), 9u);
+}
+
+TEST(VirtualClock, TimeoutsFireAsSoonAsIdle)
+{
+    ASSERT_TRUE(VirtualClock::enable(0.001));
+    Time time;
+    TimeoutHandler timeout_handler(time);
+    const auto real_start = std::chrono::steady_clock::now();
+    const dl_time_t start = time.steady_time();
+
+    std::atomic<bool> timed_out {false};
+    std::atomic<double> timed_out_after_s {0.0};
+    void *cookie = nullptr;
+    timeout_handler.add([&]() {
+        timed_out_after_s = time.elapsed_since_s(start);
+        timed_out = true;
+    }, 30.0, &cookie);
+
+    {
+        SystemScheduler scheduler;
+        int key;
+        scheduler.add(&key, [&timeout_handler]() {
+            timeout_handler.run_once();
+            return timeout_handler.time_until_next_s(1.0);
+        });
+        while (!timed_out && real_elapsed_s(real_start) < 5.0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        scheduler.remove(&key);
+    }
+    VirtualClock::disable();
+
+    EXPECT_TRUE(timed_out);
+    EXPECT_GE(timed_out_after_s, 30.0);
+    EXPECT_LT(timed_out_after_s, 31.0);
+    EXPECT_LT(real_elapsed_s(real_start), 5.0);
+}
+
+TEST(VirtualClock, IdleSchedulerDoesNotHoldClock)
+{
+    ASSERT_TRUE(VirtualClock::enable(0.001));
+    const auto real_start = std::chrono::steady_clock::now();
+
+    SystemScheduler scheduler;
+    int key;
+    std::atomic<unsigned> num_runs {0};
+    scheduler.add(&key, [&num_runs]() {
+        ++num_runs;
+        return 10.0;
+    });
+    while (num_runs < 2 && real_elapsed_s(real_start) < 5.0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    // It goes on waiting with nothing to do.
+    scheduler.remove(&key);
+
+    std::atomic<bool> slept {false};
+    std::thread sleeper([&slept]() {
+        Time time;
+        time.sleep_for(std::chrono::minutes(10));
+        slept = true;
+    });
+    while (!slept && real_elapsed_s(real_start) < 5.0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_TRUE(slept);
+
+    // Wakes the sleeper in any case.
+    VirtualClock::disable();
+    sleeper.join();
+}
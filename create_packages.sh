@@ -26,6 +26,7 @@ library_files="\
     plugins/gimbal/gimbal.h=/usr/include/dronecore/gimbal.h \
     plugins/info/info.h=/usr/include/dronecore/info.h \
     plugins/logging/logging.h=/usr/include/dronecore/logging.h \
+    plugins/manual_control/manual_control.h=/usr/include/dronecore/manual_control.h \
     plugins/mission/mission.h=/usr/include/dronecore/mission.h \
     plugins/mission/mission_item.h=/usr/include/dronecore/mission_item.h \
     plugins/offboard/offboard.h=/usr/include/dronecore/offboard.h \
@@ -235,3 +235,51 @@ TEST(CameraTest, SetSettings)
         EXPECT_STREQ(description.c_str(), "Shutter Speed");
     }
 }
+
+TEST(CameraTest, SetSeveralSettings)
+{
+    DroneCore dc;
+
+    ConnectionResult connection_ret = dc.add_udp_connection();
+    ASSERT_EQ(connection_ret, ConnectionResult::SUCCESS);
+
+    // Wait for system to connect via heartbeat.
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    System &system = dc.system();
+    ASSERT_TRUE(system.has_camera());
+    auto camera = std::make_shared<Camera>(system);
+
+    // We need to wait for the camera definition to be ready
+    // because we don't have a check yet.
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    set_mode(camera, Camera::Mode::PHOTO);
+
+    // One of them is garbage, so none is set.
+    EXPECT_EQ(set_settings(camera, {{"CAM_PHOTOQUAL", "1"}, {"DOES_NOT", "EXIST"}}),
+              Camera::Result::ERROR);
+
+    if (is_e90) {
+        std::string value_set;
+
+        // ISO can only be set in manual exposure mode, which comes first.
+        EXPECT_EQ(set_settings(camera, {{"CAM_EXPMODE", "1"}, {"CAM_ISO", "400"},
+            {"CAM_COLORMODE", "5"}
+        }), Camera::Result::SUCCESS);
+        EXPECT_EQ(get_setting(camera, "CAM_EXPMODE", value_set), Camera::Result::SUCCESS);
+        EXPECT_STREQ("1", value_set.c_str());
+        EXPECT_EQ(get_setting(camera, "CAM_ISO", value_set), Camera::Result::SUCCESS);
+        EXPECT_STREQ("400", value_set.c_str());
+        EXPECT_EQ(get_setting(camera, "CAM_COLORMODE", value_set), Camera::Result::SUCCESS);
+        EXPECT_STREQ("5", value_set.c_str());
+
+        // But not the other way around.
+        EXPECT_EQ(set_settings(camera, {{"CAM_EXPMODE", "0"}, {"CAM_ISO", "100"}}),
+                  Camera::Result::ERROR);
+
+        // Back to auto exposure mode
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+        EXPECT_EQ(set_setting(camera, "CAM_EXPMODE", "0"), Camera::Result::SUCCESS);
+    }
+}
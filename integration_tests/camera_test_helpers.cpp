@@ -86,6 +86,27 @@ Camera::Result set_setting(std::shared_ptr<Camera> camera,
     return Camera::Result::TIMEOUT;
 }
 
+Camera::Result set_settings(std::shared_ptr<Camera> camera,
+                            const std::vector<Camera::SettingOption> &options)
+{
+    auto prom = std::make_shared<std::promise<Camera::Result>>();
+    auto ret = prom->get_future();
+
+    camera->set_options_async(options,
+    [prom](Camera::Result result) {
+        prom->set_value(result);
+    });
+
+    auto status = ret.wait_for(std::chrono::seconds(2));
+
+    EXPECT_EQ(status, std::future_status::ready);
+
+    if (status == std::future_status::ready) {
+        return ret.get();
+    }
+    return Camera::Result::TIMEOUT;
+}
+
 dronecore::Camera::Result get_setting(std::shared_ptr<dronecore::Camera> camera,
                                       const std::string &setting,
                                       std::string &option)
@@ -10,6 +10,9 @@ dronecore::Camera::Result set_setting(std::shared_ptr<dronecore::Camera> camera,
                                       const std::string &setting,
                                       const std::string &option);
 
+dronecore::Camera::Result set_settings(std::shared_ptr<dronecore::Camera> camera,
+                                       const std::vector<dronecore::Camera::SettingOption> &options);
+
 dronecore::Camera::Result get_setting(std::shared_ptr<dronecore::Camera> camera,
                                       const std::string &setting,
                                       std::string &option);
@@ -1,3 +1,5 @@
+#include <cstdio>
+#include <future>
 #include <iostream>
 #include "dronecore.h"
 #include "integration_test_helper.h"
@@ -36,3 +38,49 @@ TEST_F(SitlTest, Logging)
     log_ret = logging->stop_logging();
     ASSERT_EQ(log_ret, Logging::Result::SUCCESS);
 }
+
+TEST_F(SitlTest, LoggingDownload)
+{
+    DroneCore dc;
+
+    ConnectionResult ret = dc.add_udp_connection();
+    ASSERT_EQ(ret, ConnectionResult::SUCCESS);
+
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    System &system = dc.system();
+    auto logging = std::make_shared<Logging>(system);
+
+    std::vector<Logging::LogEntry> entries;
+    {
+        auto prom = std::make_shared<std::promise<Logging::Result>>();
+        auto future_result = prom->get_future();
+        logging->get_log_entries_async(
+        [prom, &entries](Logging::Result result, std::vector<Logging::LogEntry> received) {
+            entries = received;
+            prom->set_value(result);
+        });
+        ASSERT_EQ(future_result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        ASSERT_EQ(future_result.get(), Logging::Result::SUCCESS);
+    }
+
+    if (entries.empty()) {
+        LogWarn() << "No logs on the vehicle to download";
+        return;
+    }
+
+    const std::string path = "integration_test_download.ulg";
+    auto prom = std::make_shared<std::promise<Logging::Result>>();
+    auto future_result = prom->get_future();
+    logging->download_log_async(entries.back(), path,
+    [](float progress) {
+        LogDebug() << "Log download: " << int(progress * 100.0f) << "%";
+    },
+    [prom](Logging::Result result) {
+        prom->set_value(result);
+    });
+
+    ASSERT_EQ(future_result.wait_for(std::chrono::seconds(120)), std::future_status::ready);
+    EXPECT_EQ(future_result.get(), Logging::Result::SUCCESS);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,67 @@
+#include <atomic>
+#include <future>
+#include <memory>
+#include "perf_results.h"
+#include "dronecore.h"
+#include "plugins/action/action.h"
+#include "plugins/telemetry/telemetry.h"
+
+using namespace dronecore;
+
+TEST_F(SitlPerfTest, DiscoveryAndTakeoff)
+{
+    DroneCore dc;
+
+    {
+        auto prom = std::make_shared<std::promise<void>>();
+        auto future_result = prom->get_future();
+        std::atomic<bool> discovered {false};
+        dc.register_on_discover([prom, &discovered](uint64_t) {
+            if (!discovered.exchange(true)) {
+                prom->set_value();
+            }
+        });
+
+        const auto start_time = std::chrono::steady_clock::now();
+        ASSERT_EQ(dc.add_udp_connection(), ConnectionResult::SUCCESS);
+        ASSERT_EQ(future_result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        record_perf_result("time_to_discovery", seconds_since(start_time), "s");
+        dc.register_on_discover(nullptr);
+    }
+
+    System &system = dc.system();
+    auto telemetry = std::make_shared<Telemetry>(system);
+    auto action = std::make_shared<Action>(system);
+
+    while (!telemetry->health_all_ok()) {
+        LogInfo() << "Waiting for system to be ready";
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    // Until the command is acknowledged, not until the vehicle is up.
+    auto start_time = std::chrono::steady_clock::now();
+    ASSERT_EQ(action->arm(), ActionResult::SUCCESS);
+    record_perf_result("arm_command_latency", seconds_since(start_time), "s");
+
+    start_time = std::chrono::steady_clock::now();
+    ASSERT_EQ(action->takeoff(), ActionResult::SUCCESS);
+    record_perf_result("takeoff_command_latency", seconds_since(start_time), "s");
+
+    start_time = std::chrono::steady_clock::now();
+    while (!telemetry->in_air() && seconds_since(start_time) < 10.0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(telemetry->in_air());
+    record_perf_result("takeoff_to_in_air", seconds_since(start_time), "s");
+
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+
+    start_time = std::chrono::steady_clock::now();
+    EXPECT_EQ(action->land(), ActionResult::SUCCESS);
+    record_perf_result("land_command_latency", seconds_since(start_time), "s");
+
+    for (int i = 0; i < 60 && telemetry->armed(); ++i) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    EXPECT_FALSE(telemetry->armed());
+}
@@ -0,0 +1,49 @@
+#include <memory>
+#include <string>
+#include <vector>
+#include "perf_results.h"
+#include "camera_test_helpers.h"
+#include "dronecore.h"
+#include "system.h"
+
+using namespace dronecore;
+
+// Like the other camera tests, this needs a camera instead of SITL.
+TEST(CameraPerfTest, SettingsRefresh)
+{
+    DroneCore dc;
+    ASSERT_EQ(dc.add_udp_connection(), ConnectionResult::SUCCESS);
+
+    // Wait for system to connect via heartbeat.
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+
+    System &system = dc.system();
+    ASSERT_TRUE(system.has_camera());
+
+    // Until the definition file is downloaded and parsed.
+    auto start_time = std::chrono::steady_clock::now();
+    auto camera = std::make_shared<Camera>(system);
+    std::vector<std::string> settings;
+    while (!camera->get_possible_settings(settings) && seconds_since(start_time) < 30.0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_FALSE(settings.empty());
+    record_perf_result("settings_available", seconds_since(start_time), "s");
+    record_perf_result("num_settings", double(settings.size()), "count");
+
+    std::vector<Camera::SettingOption> options;
+    start_time = std::chrono::steady_clock::now();
+    for (const auto &setting : settings) {
+        std::string option;
+        if (get_setting(camera, setting, option) == Camera::Result::SUCCESS) {
+            options.push_back(Camera::SettingOption {setting, option});
+        }
+    }
+    record_perf_result("get_all_settings", seconds_since(start_time), "s");
+    EXPECT_EQ(options.size(), settings.size());
+
+    // Setting them to what they are still reads back everything depending on them.
+    start_time = std::chrono::steady_clock::now();
+    EXPECT_EQ(set_settings(camera, options), Camera::Result::SUCCESS);
+    record_perf_result("set_all_settings", seconds_since(start_time), "s");
+}
@@ -0,0 +1,79 @@
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+#include "perf_results.h"
+#include "dronecore.h"
+#include "plugins/telemetry/telemetry.h"
+#include "plugins/mission/mission.h"
+
+using namespace dronecore;
+
+static std::vector<std::shared_ptr<MissionItem>> make_mission_items(unsigned num_items)
+{
+    std::vector<std::shared_ptr<MissionItem>> mission_items;
+    for (unsigned i = 0; i < num_items; ++i) {
+        auto item = std::make_shared<MissionItem>();
+        // Around the SITL home, a few metres apart.
+        item->set_position(47.3977 + double(i % 100) * 1e-5, 8.5456 + double(i / 100) * 1e-5);
+        item->set_relative_altitude(10.0f);
+        item->set_speed(5.0f);
+        mission_items.push_back(item);
+    }
+    return mission_items;
+}
+
+TEST_F(SitlPerfTest, MissionTransfer)
+{
+    DroneCore dc;
+    ASSERT_EQ(dc.add_udp_connection(), ConnectionResult::SUCCESS);
+
+    // Wait for system to connect via heartbeat.
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    ASSERT_TRUE(dc.is_connected());
+
+    System &system = dc.system();
+    auto telemetry = std::make_shared<Telemetry>(system);
+    auto mission = std::make_shared<Mission>(system);
+
+    while (!telemetry->health_all_ok()) {
+        LogInfo() << "Waiting for system to be ready";
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    for (unsigned num_items : {10u, 100u, 1000u}) {
+        const auto mission_items = make_mission_items(num_items);
+        const std::string suffix = std::to_string(num_items) + "_items";
+
+        {
+            auto prom = std::make_shared<std::promise<Mission::Result>>();
+            auto future_result = prom->get_future();
+            const auto start_time = std::chrono::steady_clock::now();
+            mission->upload_mission_async(mission_items, [prom](Mission::Result result) {
+                prom->set_value(result);
+            });
+            ASSERT_EQ(future_result.wait_for(std::chrono::seconds(60)),
+                      std::future_status::ready);
+            const double upload_s = seconds_since(start_time);
+            ASSERT_EQ(future_result.get(), Mission::Result::SUCCESS);
+            record_perf_result("upload_" + suffix, upload_s, "s");
+        }
+
+        {
+            auto prom = std::make_shared<std::promise<size_t>>();
+            auto future_result = prom->get_future();
+            const auto start_time = std::chrono::steady_clock::now();
+            mission->download_mission_async(
+                [prom](Mission::Result result,
+            std::vector<std::shared_ptr<MissionItem>> mission_items_downloaded) {
+                EXPECT_EQ(result, Mission::Result::SUCCESS);
+                prom->set_value(mission_items_downloaded.size());
+            });
+            ASSERT_EQ(future_result.wait_for(std::chrono::seconds(60)),
+                      std::future_status::ready);
+            const double download_s = seconds_since(start_time);
+            EXPECT_EQ(future_result.get(), mission_items.size());
+            record_perf_result("download_" + suffix, download_s, "s");
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#include <cmath>
+#include <memory>
+#include "perf_results.h"
+#include "dronecore.h"
+#include "plugins/action/action.h"
+#include "plugins/telemetry/telemetry.h"
+#include "plugins/offboard/offboard.h"
+
+using namespace dronecore;
+
+TEST_F(SitlPerfTest, OffboardSetpointJitter)
+{
+    static constexpr float STREAMING_RATE_HZ = 50.0f;
+
+    DroneCore dc;
+    ASSERT_EQ(dc.add_udp_connection(), ConnectionResult::SUCCESS);
+
+    // Wait for system to connect via heartbeat.
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    ASSERT_TRUE(dc.is_connected());
+
+    System &system = dc.system();
+    auto telemetry = std::make_shared<Telemetry>(system);
+    auto action = std::make_shared<Action>(system);
+    auto offboard = std::make_shared<Offboard>(system);
+
+    while (!telemetry->health_all_ok()) {
+        LogInfo() << "Waiting for system to be ready";
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    ASSERT_EQ(action->arm(), ActionResult::SUCCESS);
+    ASSERT_EQ(action->takeoff(), ActionResult::SUCCESS);
+    std::this_thread::sleep_for(std::chrono::seconds(5));
+
+    offboard->enable_realtime_streaming(STREAMING_RATE_HZ);
+    offboard->enable_latency_measurement(STREAMING_RATE_HZ);
+
+    // Send it once before starting offboard, otherwise it will be rejected.
+    offboard->set_velocity_ned({0.0f, 0.0f, 0.0f, 0.0f});
+    ASSERT_EQ(offboard->start(), Offboard::Result::SUCCESS);
+
+    // A new setpoint every 10 ms for 10 s, so that every report has a new one.
+    const float step_size = 0.01f;
+    const unsigned steps = 1000;
+    for (unsigned i = 0; i < steps; ++i) {
+        const float vx = 2.0f * sinf(float(i) * step_size);
+        offboard->set_velocity_ned({vx, 0.0f, 0.0f, 0.0f});
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    const Offboard::StreamingStats streaming_stats = offboard->get_streaming_stats();
+    const Offboard::LatencyStats latency_stats = offboard->get_latency_stats();
+    offboard->disable_latency_measurement();
+
+    EXPECT_GT(streaming_stats.num_sent, 0u);
+    record_perf_result("setpoints_sent", double(streaming_stats.num_sent), "count");
+    record_perf_result("setpoints_missed", double(streaming_stats.num_missed), "count");
+    record_perf_result("mean_jitter", streaming_stats.mean_jitter_us, "us");
+    record_perf_result("max_jitter", streaming_stats.max_jitter_us, "us");
+    record_perf_result("realtime_priority", streaming_stats.realtime_priority ? 1.0 : 0.0,
+                       "bool");
+
+    EXPECT_GT(latency_stats.num_matched, 0u);
+    record_perf_result("setpoints_matched", double(latency_stats.num_matched), "count");
+    record_perf_result("setpoints_lost", double(latency_stats.num_lost), "count");
+    record_perf_result("mean_latency", latency_stats.mean_latency_us, "us");
+    record_perf_result("max_latency", latency_stats.max_latency_us, "us");
+
+    EXPECT_EQ(offboard->stop(), Offboard::Result::SUCCESS);
+    offboard->disable_realtime_streaming();
+    EXPECT_EQ(action->land(), ActionResult::SUCCESS);
+
+    for (int i = 0; i < 60 && telemetry->armed(); ++i) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+}
@@ -0,0 +1,87 @@
+#include "perf_results.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+struct PerfResult {
+    std::string test;
+    std::string metric;
+    double value;
+    std::string unit;
+};
+
+std::mutex results_mutex;
+std::vector<PerfResult> results;
+
+std::string escape(const std::string &str)
+{
+    std::string escaped;
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            escaped.push_back('\\');
+        }
+        escaped.push_back(c);
+    }
+    return escaped;
+}
+
+class PerfResultsEnvironment : public testing::Environment
+{
+public:
+    void TearDown() override
+    {
+        std::lock_guard<std::mutex> lock(results_mutex);
+        if (results.empty()) {
+            return;
+        }
+
+        const char *env_path = std::getenv("DRONECORE_PERF_RESULTS");
+        const std::string path = (env_path != nullptr) ? env_path : "perf_results.json";
+        std::FILE *file = std::fopen(path.c_str(), "w");
+        if (file == nullptr) {
+            LogErr() << "Could not write " << path;
+            return;
+        }
+
+        std::fprintf(file, "{\"results\": [\n");
+        for (size_t i = 0; i < results.size(); ++i) {
+            const PerfResult &result = results[i];
+            // JSON has no NaN, a measurement which failed is null.
+            char value[32] = "null";
+            if (std::isfinite(result.value)) {
+                std::snprintf(value, sizeof(value), "%.9g", result.value);
+            }
+            std::fprintf(file, "  {\"test\": \"%s\", \"metric\": \"%s\", \"value\": %s, "
+                         "\"unit\": \"%s\"}%s\n",
+                         escape(result.test).c_str(), escape(result.metric).c_str(), value,
+                         escape(result.unit).c_str(), (i + 1 < results.size()) ? "," : "");
+        }
+        std::fprintf(file, "]}\n");
+        std::fclose(file);
+        LogInfo() << "Wrote " << results.size() << " results to " << path;
+    }
+};
+
+// Owned by gtest.
+testing::Environment *const environment =
+    testing::AddGlobalTestEnvironment(new PerfResultsEnvironment());
+
+} // namespace
+
+void record_perf_result(const std::string &metric, double value, const std::string &unit)
+{
+    const testing::TestInfo *info = testing::UnitTest::GetInstance()->current_test_info();
+    const std::string test = (info != nullptr) ?
+                             std::string(info->test_case_name()) + "." + info->name() : "";
+
+    LogInfo() << test << " " << metric << ": " << value << " " << unit;
+
+    std::lock_guard<std::mutex> lock(results_mutex);
+    results.push_back(PerfResult {test, metric, value, unit});
+}
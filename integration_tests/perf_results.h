@@ -0,0 +1,24 @@
+#pragma once
+
+#include "integration_test_helper.h"
+#include <chrono>
+#include <string>
+
+// The performance tests are in integration_tests_perf_runner, which ctest runs
+// with the label perf (`ctest -L perf`). They are named *Perf*, so that one kind
+// can be picked, e.g. with `--gtest_filter=CameraPerfTest.*` when there is a camera.
+//
+// What they measure is written as JSON when all tests are done, to the file
+// in DRONECORE_PERF_RESULTS or else perf_results.json:
+//
+//     {"results": [{"test": "SitlPerfTest.MissionTransfer",
+//                   "metric": "upload_100_items", "value": 0.52, "unit": "s"}, ...]}
+class SitlPerfTest : public SitlTest {};
+
+// Adds a measurement of the test which is running.
+void record_perf_result(const std::string &metric, double value, const std::string &unit);
+
+inline double seconds_since(std::chrono::steady_clock::time_point since)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+}
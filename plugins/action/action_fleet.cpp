@@ -0,0 +1,75 @@
+#include "action_fleet.h"
+#include "action_fleet_impl.h"
+
+namespace dronecore {
+
+ActionFleet::ActionFleet(DroneCore &dronecore, const std::vector<uint64_t> &uuids) :
+    _impl { new ActionFleetImpl(dronecore, uuids) }
+{
+}
+
+ActionFleet::~ActionFleet()
+{
+}
+
+ActionFleet::Result ActionFleet::arm()
+{
+    return _impl->run(&Action::arm_async);
+}
+
+ActionFleet::Result ActionFleet::disarm()
+{
+    return _impl->run(&Action::disarm_async);
+}
+
+ActionFleet::Result ActionFleet::takeoff()
+{
+    return _impl->run(&Action::takeoff_async);
+}
+
+ActionFleet::Result ActionFleet::land()
+{
+    return _impl->run(&Action::land_async);
+}
+
+ActionFleet::Result ActionFleet::return_to_launch()
+{
+    return _impl->run(&Action::return_to_launch_async);
+}
+
+ActionFleet::Result ActionFleet::kill()
+{
+    return _impl->run(&Action::kill_async);
+}
+
+void ActionFleet::arm_async(result_callback_t callback)
+{
+    _impl->run_async(&Action::arm_async, callback);
+}
+
+void ActionFleet::disarm_async(result_callback_t callback)
+{
+    _impl->run_async(&Action::disarm_async, callback);
+}
+
+void ActionFleet::takeoff_async(result_callback_t callback)
+{
+    _impl->run_async(&Action::takeoff_async, callback);
+}
+
+void ActionFleet::land_async(result_callback_t callback)
+{
+    _impl->run_async(&Action::land_async, callback);
+}
+
+void ActionFleet::return_to_launch_async(result_callback_t callback)
+{
+    _impl->run_async(&Action::return_to_launch_async, callback);
+}
+
+void ActionFleet::kill_async(result_callback_t callback)
+{
+    _impl->run_async(&Action::kill_async, callback);
+}
+
+} // namespace dronecore
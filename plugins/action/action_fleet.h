@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "action_result.h"
+
+namespace dronecore {
+
+class DroneCore;
+class ActionFleetImpl;
+
+/**
+ * @brief The ActionFleet class sends the same action to several drones at once.
+ *
+ * The action is sent to all systems concurrently rather than one after the other,
+ * so arming 30 drones takes about as long as arming one. The results are collected
+ * as they arrive and are reported together once all drones have answered.
+ */
+class ActionFleet
+{
+public:
+    /**
+     * @brief Constructor. Creates the Action plugins of the given systems.
+     *
+     * @param dronecore The DroneCore instance the systems are connected to.
+     * @param uuids The UUIDs of the systems to control.
+     */
+    ActionFleet(DroneCore &dronecore, const std::vector<uint64_t> &uuids);
+
+    /**
+     * @brief Destructor (internal use only).
+     */
+    ~ActionFleet();
+
+    /**
+     * @brief Result of an action for one system.
+     */
+    struct SystemResult {
+        uint64_t uuid; /**< @brief UUID of the system. */
+        ActionResult result; /**< @brief Result of the action on this system. */
+        double latency_s; /**< @brief Time from sending until the result arrived, in seconds. */
+    };
+
+    /**
+     * @brief Result of an action for the whole fleet.
+     */
+    struct Result {
+        bool success; /**< @brief True if the action succeeded on all systems. */
+        std::vector<SystemResult> results; /**< @brief Results in the order of the UUIDs. */
+    };
+
+    /**
+     * @brief Callback type for asynchronous ActionFleet calls.
+     */
+    typedef std::function<void(const Result &)> result_callback_t;
+
+    /**
+     * @brief Arm all drones (synchronous).
+     *
+     * @note Before arming take all safety precautions and stand clear of the drones!
+     *
+     * @return Results of all systems.
+     */
+    Result arm();
+
+    /**
+     * @brief Disarm all drones (synchronous).
+     *
+     * @return Results of all systems.
+     */
+    Result disarm();
+
+    /**
+     * @brief Take off with all drones (synchronous).
+     *
+     * @return Results of all systems.
+     */
+    Result takeoff();
+
+    /**
+     * @brief Land all drones (synchronous).
+     *
+     * @return Results of all systems.
+     */
+    Result land();
+
+    /**
+     * @brief Return all drones to their launch positions (synchronous).
+     *
+     * @return Results of all systems.
+     */
+    Result return_to_launch();
+
+    /**
+     * @brief Kill all drones (synchronous).
+     *
+     * @note The motors will stop immediately and the drones will fall!
+     *
+     * @return Results of all systems.
+     */
+    Result kill();
+
+    /**
+     * @brief Arm all drones (asynchronous).
+     *
+     * @param callback Function to call once all systems have answered.
+     */
+    void arm_async(result_callback_t callback);
+
+    /**
+     * @brief Disarm all drones (asynchronous).
+     *
+     * @param callback Function to call once all systems have answered.
+     */
+    void disarm_async(result_callback_t callback);
+
+    /**
+     * @brief Take off with all drones (asynchronous).
+     *
+     * @param callback Function to call once all systems have answered.
+     */
+    void takeoff_async(result_callback_t callback);
+
+    /**
+     * @brief Land all drones (asynchronous).
+     *
+     * @param callback Function to call once all systems have answered.
+     */
+    void land_async(result_callback_t callback);
+
+    /**
+     * @brief Return all drones to their launch positions (asynchronous).
+     *
+     * @param callback Function to call once all systems have answered.
+     */
+    void return_to_launch_async(result_callback_t callback);
+
+    /**
+     * @brief Kill all drones (asynchronous).
+     *
+     * @param callback Function to call once all systems have answered.
+     */
+    void kill_async(result_callback_t callback);
+
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    ActionFleet(const ActionFleet &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const ActionFleet &operator=(const ActionFleet &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<ActionFleetImpl> _impl;
+};
+
+} // namespace dronecore
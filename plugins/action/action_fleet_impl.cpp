@@ -0,0 +1,80 @@
+#include "action_fleet_impl.h"
+#include "completion.h"
+#include <chrono>
+#include <mutex>
+
+namespace dronecore {
+
+ActionFleetImpl::ActionFleetImpl(DroneCore &dronecore, const std::vector<uint64_t> &uuids)
+{
+    for (auto uuid : uuids) {
+        _actions.push_back(std::make_pair(uuid, std::make_shared<Action>(dronecore.system(uuid))));
+    }
+}
+
+ActionFleetImpl::~ActionFleetImpl() {}
+
+void ActionFleetImpl::run_async(action_async_t action,
+                                const ActionFleet::result_callback_t &callback)
+{
+    struct Collected {
+        std::mutex mutex {};
+        size_t num_remaining = 0;
+        ActionFleet::Result result {true, {}};
+    };
+
+    if (_actions.empty()) {
+        if (callback) {
+            callback(ActionFleet::Result {true, {}});
+        }
+        return;
+    }
+
+    auto collected = std::make_shared<Collected>();
+    collected->num_remaining = _actions.size();
+    for (const auto &action_of_system : _actions) {
+        collected->result.results.push_back(
+            ActionFleet::SystemResult {action_of_system.first, ActionResult::UNKNOWN, 0.0});
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < _actions.size(); ++i) {
+        Action &system_action = *_actions[i].second;
+
+        // Results can come right away or later from any thread.
+        (system_action.*action)([collected, i, start, callback](ActionResult result) {
+            const double latency_s = std::chrono::duration<double>(
+                                         std::chrono::steady_clock::now() - start).count();
+            ActionFleet::Result fleet_result {};
+            {
+                std::lock_guard<std::mutex> lock(collected->mutex);
+                collected->result.results[i].result = result;
+                collected->result.results[i].latency_s = latency_s;
+                if (result != ActionResult::SUCCESS) {
+                    collected->result.success = false;
+                }
+                if (--collected->num_remaining > 0) {
+                    return;
+                }
+                fleet_result = collected->result;
+            }
+            if (callback) {
+                callback(fleet_result);
+            }
+        });
+    }
+}
+
+ActionFleet::Result ActionFleetImpl::run(action_async_t action)
+{
+    Completion<ActionFleet::Result> completion;
+
+    run_async(action, [&completion](const ActionFleet::Result & result) {
+        completion.complete(result);
+    });
+
+    return completion.wait();
+}
+
+} // namespace dronecore
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "action.h"
+#include "action_fleet.h"
+#include "dronecore.h"
+
+namespace dronecore {
+
+class ActionFleetImpl
+{
+public:
+    ActionFleetImpl(DroneCore &dronecore, const std::vector<uint64_t> &uuids);
+    ~ActionFleetImpl();
+
+    typedef void (Action::*action_async_t)(Action::result_callback_t callback);
+
+    // Starts the action on all systems at once, the callback comes with the last result.
+    void run_async(action_async_t action, const ActionFleet::result_callback_t &callback);
+    ActionFleet::Result run(action_async_t action);
+
+    // Non-copyable
+    ActionFleetImpl(const ActionFleetImpl &) = delete;
+    const ActionFleetImpl &operator=(const ActionFleetImpl &) = delete;
+
+private:
+    std::vector<std::pair<uint64_t, std::shared_ptr<Action>>> _actions {};
+};
+
+} // namespace dronecore
@@ -2,6 +2,7 @@
 #include "dronecore_impl.h"
 #include "global_include.h"
 #include "px4_custom_mode.h"
+#include <string>
 
 namespace dronecore {
 
@@ -24,11 +25,22 @@ void ActionImpl::init()
     _parent->register_mavlink_message_handler(
         MAVLINK_MSG_ID_EXTENDED_SYS_STATE,
         std::bind(&ActionImpl::process_extended_sys_state, this, _1), this);
+
+    for (const char *name : {"MIS_TAKEOFF_ALT", "MPC_XY_CRUISE"}) {
+        _param_subscriptions.push_back(_parent->subscribe_param(
+                                           name, std::bind(&ActionImpl::receive_param_changed,
+                                                           this, _1, _2)));
+    }
 }
 
 void ActionImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+
+    for (auto handle : _param_subscriptions) {
+        _parent->unsubscribe_param(handle);
+    }
+    _param_subscriptions.clear();
 }
 
 void ActionImpl::enable()
@@ -39,6 +51,38 @@ void ActionImpl::enable()
     // called while we are being created here.
     _parent->set_msg_rate_async(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, 1.0, nullptr,
                                 MAVLinkCommands::DEFAULT_COMPONENT_ID_AUTOPILOT);
+
+    prefetch_params();
+}
+
+void ActionImpl::prefetch_params()
+{
+    // Both requests go out at once, later changes come in through
+    // receive_param_changed().
+    _parent->get_param_float_async("MIS_TAKEOFF_ALT", [this](bool success, float value) {
+        if (success) {
+            _relative_takeoff_altitude_m = value;
+        }
+    });
+    _parent->get_param_float_async("MPC_XY_CRUISE", [this](bool success, float value) {
+        if (success) {
+            _max_speed_m_s = value;
+        }
+    });
+}
+
+void ActionImpl::receive_param_changed(const std::string &name,
+                                       MAVLinkParameters::ParamValue value)
+{
+    if (!value.is_float()) {
+        return;
+    }
+
+    if (name == "MIS_TAKEOFF_ALT") {
+        _relative_takeoff_altitude_m = value.get_float();
+    } else if (name == "MPC_XY_CRUISE") {
+        _max_speed_m_s = value.get_float();
+    }
 }
 
 void ActionImpl::disable() {}
@@ -415,8 +459,7 @@ void ActionImpl::set_takeoff_altitude(float relative_altitude_m)
 void ActionImpl::receive_takeoff_alt_param(bool success, float new_relative_altitude_m)
 {
     if (success) {
-        // TODO: This should not be buffered like this, the param system
-        //       needs some refactoring.
+        // Also updated from PARAM_VALUE, this is in case the ack got lost.
         _relative_takeoff_altitude_m = new_relative_altitude_m;
     }
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 #include "action.h"
 #include "action_result.h"
@@ -60,6 +63,9 @@ private:
     ActionResult taking_off_allowed() const;
 
     void process_extended_sys_state(const mavlink_message_t &message);
+    // Keeps the cached params up to date, whoever changes them.
+    void receive_param_changed(const std::string &name, MAVLinkParameters::ParamValue value);
+    void prefetch_params();
 
     void receive_max_speed_result(bool success, float new_speed_m_s);
 
@@ -76,9 +82,13 @@ private:
     std::atomic<bool>_vtol_transition_support_known {false};
     std::atomic<bool> _vtol_transition_possible {false};
 
-    float _relative_takeoff_altitude_m = 2.5f;
+    // Cached on enable() and updated from PARAM_VALUE, so actions don't need to
+    // wait for params.
+    std::atomic<float> _relative_takeoff_altitude_m {2.5f};
 
-    float _max_speed_m_s = NAN;
+    std::atomic<float> _max_speed_m_s {NAN};
+
+    std::vector<MAVLinkParameters::param_subscription_handle_t> _param_subscriptions {};
 
     static constexpr uint8_t VEHICLE_MODE_FLAG_CUSTOM_MODE_ENABLED = 1;
 };
@@ -3,9 +3,9 @@
 
 namespace dronecore {
 
-Camera::Camera(System &system) :
+Camera::Camera(System &system, int camera_id) :
     PluginBase(),
-    _impl { new CameraImpl(system) }
+    _impl { new CameraImpl(system, camera_id) }
 {
 }
 
@@ -103,6 +103,14 @@ void Camera::capture_info_async(capture_info_callback_t callback)
     _impl->capture_info_async(callback);
 }
 
+void Camera::download_media_async(const std::vector<std::string> &file_urls,
+                                  const std::string &local_directory,
+                                  download_media_callback_t callback,
+                                  unsigned num_parallel)
+{
+    _impl->download_media_async(file_urls, local_directory, callback, num_parallel);
+}
+
 void Camera::set_option_async(const std::string &setting,
                               const std::string &option,
                               const result_callback_t &callback)
@@ -110,6 +118,12 @@ void Camera::set_option_async(const std::string &setting,
     _impl->set_option_async(setting, option, callback);
 }
 
+void Camera::set_options_async(const std::vector<SettingOption> &options,
+                               const result_callback_t &callback)
+{
+    _impl->set_options_async(options, callback);
+}
+
 void Camera::get_option_async(const std::string &setting,
                               const get_option_callback_t &callback)
 {
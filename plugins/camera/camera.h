@@ -34,9 +34,16 @@ public:
      *     auto camera = std::make_shared<Camera>(system);
      *     ```
      *
+     * A system with several cameras gets one plugin per camera:
+     *
+     *     ```cpp
+     *     auto second_camera = std::make_shared<Camera>(system, 1);
+     *     ```
+     *
      * @param system The specific system associated with this plugin.
+     * @param camera_id ID of the camera starting from 0 onwards, as in System::has_camera().
      */
-    explicit Camera(System &system);
+    explicit Camera(System &system, int camera_id = 0);
 
     /**
      * @brief Destructor (internal use only).
@@ -331,6 +338,32 @@ public:
      */
     void capture_info_async(capture_info_callback_t callback);
 
+    /**
+     * @brief Callback type for media downloads, called once per file.
+     */
+    typedef std::function<void(Result result, const std::string &file_url,
+                               const std::string &local_path)> download_media_callback_t;
+
+    /**
+     * @brief Download images or videos from the camera (asynchronous).
+     *
+     * Several files are transferred at the same time over HTTP, and connections to
+     * the camera are kept open between files. The files are written to disk while
+     * they are downloaded. If a download fails, downloading the same file again to
+     * the same directory continues where it stopped.
+     *
+     * @param file_urls Download URLs, e.g. CaptureInfo::file_url.
+     * @param local_directory Existing directory to save the files in, under the
+     *                        file names of the URLs.
+     * @param callback Function to call as each file is done.
+     * @param num_parallel Number of files transferred at the same time. This only
+     *                     takes effect if no other download is going on.
+     */
+    void download_media_async(const std::vector<std::string> &file_urls,
+                              const std::string &local_directory,
+                              download_media_callback_t callback,
+                              unsigned num_parallel = 4);
+
     /**
      * @brief Information about camera status.
      */
@@ -357,6 +390,9 @@ public:
     /**
      * @brief Get camera status (asynchronous).
      *
+     * The status broadcast by the camera is used if it is recent, otherwise the
+     * camera is asked for it.
+     *
      * @param callback Function to call with camera status.
      */
     void get_status_async(get_status_callback_t callback);
@@ -412,6 +448,32 @@ public:
     void set_option_async(const std::string &setting,
                           const std::string &option,
                           const result_callback_t &callback);
+
+    /**
+     * @brief A setting and the option to set it to.
+     */
+    struct SettingOption {
+        std::string setting; /**< @brief The machine readable name of the setting. */
+        std::string option; /**< @brief The machine readable name of the option value. */
+    };
+
+    /**
+     * @brief Set the options of several settings at once (asynchronous).
+     *
+     * This is quicker than setting them one by one, e.g. to switch to another
+     * profile: the settings are all sent at once and the settings depending on
+     * them are only read back from the camera once at the end.
+     *
+     * Every option is checked against the settings before it in the list, so a
+     * setting which depends on another one (e.g. a video resolution on the video
+     * mode) can follow it in the same call. If any option is not possible, none
+     * is set.
+     *
+     * @param options The settings and their options, in order.
+     * @param callback The callback to get the result, success only if all are set.
+     */
+    void set_options_async(const std::vector<SettingOption> &options,
+                           const result_callback_t &callback);
     /**
      * @brief Get the human readable string of a setting.
      *
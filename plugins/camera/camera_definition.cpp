@@ -1,9 +1,13 @@
 #include "global_include.h"
 #include "log.h"
 #include "camera_definition.h"
+#include <algorithm>
+#include <cstring>
 
 namespace dronecore {
 
+constexpr unsigned CameraDefinition::NO_INDEX;
+
 CameraDefinition::CameraDefinition() {}
 
 CameraDefinition::~CameraDefinition() {}
@@ -40,6 +44,26 @@ std::string CameraDefinition::get_vendor() const
     return _vendor;
 }
 
+// As read from the XML, before the names are resolved.
+struct CameraDefinition::ParsedOption {
+    std::string name;
+    MAVLinkParameters::ParamValue value;
+    std::vector<std::string> exclusions;
+    std::vector<std::pair<std::string, std::vector<MAVLinkParameters::ParamValue>>>
+            parameter_ranges;
+    bool is_default;
+};
+
+struct CameraDefinition::ParsedParameter {
+    std::string name;
+    std::string description;
+    bool is_control;
+    bool is_readonly;
+    bool is_writeonly;
+    std::vector<std::string> updates;
+    std::vector<ParsedOption> options;
+};
+
 bool CameraDefinition::parse_xml()
 {
     auto e_mavlinkcamera = _doc.FirstChildElement("mavlinkcamera");
@@ -76,6 +100,8 @@ bool CameraDefinition::parse_xml()
         return false;
     }
 
+    std::vector<ParsedParameter> parsed {};
+
     std::map<std::string, std::string> type_map {};
     // We need all types first.
     for (auto e_parameter = e_parameters->FirstChildElement("parameter");
@@ -101,7 +127,7 @@ bool CameraDefinition::parse_xml()
          e_parameter != nullptr;
          e_parameter = e_parameter->NextSiblingElement("parameter")) {
 
-        auto new_parameter = std::make_shared<Parameter>();
+        std::unique_ptr<ParsedParameter> new_parameter(new ParsedParameter());
 
         const char *param_name = e_parameter->Attribute("name");
         if (!param_name) {
@@ -200,7 +226,7 @@ bool CameraDefinition::parse_xml()
                 return false;
             }
 
-            auto new_option = std::make_shared<Option>();
+            std::unique_ptr<ParsedOption> new_option(new ParsedOption());
 
             new_option->name = option_name;
 
@@ -237,7 +263,7 @@ bool CameraDefinition::parse_xml()
                         return false;
                     }
 
-                    parameter_range_t new_parameter_range;
+                    std::vector<MAVLinkParameters::ParamValue> new_parameter_range;
 
                     for (auto e_roption = e_parameterrange->FirstChildElement("roption");
                          e_roption != nullptr;
@@ -263,7 +289,7 @@ bool CameraDefinition::parse_xml()
                         MAVLinkParameters::ParamValue new_param_value;
                         new_param_value.set_from_xml(
                             type_map[roption_parameter_str], roption_value_str);
-                        new_parameter_range[roption_name_str] = new_param_value;
+                        new_parameter_range.push_back(new_param_value);
 
                         // LogDebug() << "range option: "
                         //            << roption_name_str
@@ -272,13 +298,14 @@ bool CameraDefinition::parse_xml()
                         //            << " (" << new_param_value.typestr() << ")";
                     }
 
-                    new_option->parameter_ranges[roption_parameter_str] = new_parameter_range;
+                    new_option->parameter_ranges.push_back(
+                        std::make_pair(std::string(roption_parameter_str), new_parameter_range));
 
                     // LogDebug() << "adding to: " << roption_parameter_str;
                 }
             }
 
-            new_parameter->options.push_back(new_option);
+            new_parameter->options.push_back(std::move(*new_option));
         }
 
         if (!found_default) {
@@ -288,40 +315,149 @@ bool CameraDefinition::parse_xml()
             continue;
         }
 
-        _parameter_map[param_name] = new_parameter;
-
-        InternalCurrentSetting empty_setting {};
-        empty_setting.needs_updating = true;
-        _current_settings[param_name] = empty_setting;
+        new_parameter->name = param_name;
+        parsed.push_back(std::move(*new_parameter));
     }
 
+    compile(parsed);
     return true;
 }
 
-void CameraDefinition::assume_default_settings()
+void CameraDefinition::compile(std::vector<ParsedParameter> &parsed)
 {
-    _current_settings.clear();
+    // A parameter defined again replaces the earlier one.
+    std::map<std::string, ParsedParameter *> by_name {};
+    for (auto &parameter : parsed) {
+        by_name[parameter.name] = &parameter;
+    }
+
+    _parameters.clear();
+    _options.clear();
+    _updates.clear();
+    _exclusions.clear();
+    _ranges.clear();
+    _parameter_indices.clear();
+
+    std::vector<MAVLinkParameters::ParamValue> range_values {};
+
+    // The map is sorted by name, so are the indices.
+    for (const auto &entry : by_name) {
+        _parameter_indices[entry.first] = unsigned(_parameters.size());
+        _parameters.push_back(Parameter {});
+    }
+
+    unsigned parameter_index = 0;
+    for (const auto &entry : by_name) {
+        const ParsedParameter &parsed_parameter = *entry.second;
+        Parameter &parameter = _parameters[parameter_index++];
+
+        parameter.name = parsed_parameter.name;
+        parameter.description = parsed_parameter.description;
+        parameter.is_control = parsed_parameter.is_control;
+        parameter.is_readonly = parsed_parameter.is_readonly;
+        parameter.is_writeonly = parsed_parameter.is_writeonly;
+        parameter.needs_updating = true;
+        parameter.current_option = NO_INDEX;
+        // Nothing is excluded before there is a current setting.
+        parameter.is_possible = parameter.is_control;
+        parameter.exclusion_option = NO_INDEX;
+        parameter.range_option = NO_INDEX;
+        parameter.num_excluded_by = 0;
+        parameter.num_ranges_on = 0;
+
+        // Updates of parameters we don't know are not understood, so dropped.
+        parameter.first_update = unsigned(_updates.size());
+        for (const auto &update : parsed_parameter.updates) {
+            const unsigned index = get_setting_index(update);
+            if (index != NO_INDEX) {
+                _updates.push_back(index);
+            }
+        }
+        parameter.num_updates = unsigned(_updates.size()) - parameter.first_update;
+
+        parameter.first_option = unsigned(_options.size());
+        parameter.num_options = unsigned(parsed_parameter.options.size());
+        parameter.default_option = NO_INDEX;
+
+        for (const auto &parsed_option : parsed_parameter.options) {
+            Option option {};
+            option.name = parsed_option.name;
+            option.value = parsed_option.value;
+            option.is_possible = false;
+
+            if (parsed_option.is_default) {
+                parameter.default_option = unsigned(_options.size());
+            }
+
+            option.first_exclusion = unsigned(_exclusions.size());
+            for (const auto &exclusion : parsed_option.exclusions) {
+                const unsigned index = get_setting_index(exclusion);
+                if (index != NO_INDEX) {
+                    _exclusions.push_back(index);
+                }
+            }
+            option.num_exclusions = unsigned(_exclusions.size()) - option.first_exclusion;
+
+            option.first_range = unsigned(_ranges.size());
+            for (const auto &parameter_range : parsed_option.parameter_ranges) {
+                const unsigned index = get_setting_index(parameter_range.first);
+                if (index == NO_INDEX) {
+                    continue;
+                }
+                for (const auto &value : parameter_range.second) {
+                    // The options of the parameter in the range might not be
+                    // compiled yet, they are resolved below.
+                    _ranges.push_back(Range {index, NO_INDEX});
+                    range_values.push_back(value);
+                }
+            }
+            option.num_ranges = unsigned(_ranges.size()) - option.first_range;
 
-    for (const auto &parameter : _parameter_map) {
-        for (const auto &option : parameter.second->options) {
+            _options.push_back(option);
+        }
+    }
 
-            if (!option->is_default) {
-                // LogDebug() << option->name << " not default";
-                continue;
+    // Now that all options are known, find the one each range value stands for.
+    for (unsigned i = 0; i < _ranges.size(); ++i) {
+        const Parameter &parameter = _parameters[_ranges[i].parameter];
+        for (unsigned option = 0; option < parameter.num_options; ++option) {
+            if (_options[parameter.first_option + option].value == range_values[i]) {
+                _ranges[i].option = option;
+                break;
             }
-            // LogDebug() << option->name << " default value: " << option->value << " (type: " << option->value.typestr() << ")";
+        }
+    }
+
+    _num_in_range.assign(_options.size(), 0);
+
+    _dirty.clear();
+    _is_dirty.assign(_parameters.size(), 0);
+    for (unsigned i = 0; i < _parameters.size(); ++i) {
+        mark_dirty(i);
+    }
+
+    update_possible();
+}
 
-            _current_settings[parameter.first] = InternalCurrentSetting {option->value, false};
+void CameraDefinition::assume_default_settings()
+{
+    for (unsigned i = 0; i < _parameters.size(); ++i) {
+        const unsigned default_option = _parameters[i].default_option;
+        if (default_option == NO_INDEX) {
+            continue;
         }
+        set_current_value(i, _options[default_option].value, false);
     }
+
+    update_possible();
 }
 
 bool CameraDefinition::get_all_settings(std::map<std::string, MAVLinkParameters::ParamValue>
                                         &settings)
 {
     settings.clear();
-    for (const auto &current_setting : _current_settings) {
-        settings[current_setting.first] = current_setting.second.value;
+    for (const auto &parameter : _parameters) {
+        settings[parameter.name] = parameter.value;
     }
 
     return (settings.size() > 0);
@@ -332,38 +468,9 @@ bool CameraDefinition::get_possible_settings(
 {
     settings.clear();
 
-    // Find all exclusions
-    // TODO: use set instead of vector
-    std::vector<std::string> exclusions {};
-
-    for (const auto &parameter : _parameter_map) {
-        for (const auto &option : parameter.second->options) {
-            if (_current_settings[parameter.first].needs_updating) {
-                continue;
-            }
-            if (_current_settings[parameter.first].value == option->value) {
-                for (const auto &exclusion : option->exclusions) {
-                    // LogDebug() << "found exclusion for " << parameter.first
-                    //            << "(" << option->value << "): " << exclusion;
-                    exclusions.push_back(exclusion);
-                }
-            }
-        }
-    }
-
-    for (const auto &setting : _current_settings) {
-        bool excluded = false;
-        for (const auto &exclusion : exclusions) {
-            if (setting.first == exclusion) {
-                excluded = true;
-            }
-        }
-        if (!_parameter_map[setting.first]->is_control) {
-            continue;
-        }
-
-        if (!excluded) {
-            settings[setting.first] = setting.second.value;
+    for (const auto &parameter : _parameters) {
+        if (parameter.is_possible) {
+            settings[parameter.name] = parameter.value;
         }
     }
 
@@ -373,7 +480,8 @@ bool CameraDefinition::get_possible_settings(
 bool CameraDefinition::set_setting(const std::string &name,
                                    const MAVLinkParameters::ParamValue &value)
 {
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    const unsigned index = get_setting_index(name);
+    if (index == NO_INDEX) {
         LogErr() << "Unknown setting to set";
         return false;
     }
@@ -398,33 +506,32 @@ bool CameraDefinition::set_setting(const std::string &name,
     }
 
     // LogDebug() << "Setting " << name << " of type: " << changed_value.typestr();
-    _current_settings[name].value = changed_value;
-    _current_settings[name].needs_updating = false;
+    set_current_value(index, changed_value, false);
 
     // Some param changes cause other params to change, so they need to be updated.
     // The camera definition just keeps track of these params but the actual param fetching
     // needs to happen outside of this class.
-    for (const auto &update : _parameter_map[name]->updates) {
-        if (_current_settings.find(update) == _current_settings.end()) {
-            // LogDebug() << "Update to '" << update << "' not understood.";
-            continue;
-        }
-        _current_settings[update].needs_updating = true;
+    const Parameter &parameter = _parameters[index];
+    for (unsigned i = 0; i < parameter.num_updates; ++i) {
+        const unsigned update = _updates[parameter.first_update + i];
+        set_current_value(update, _parameters[update].value, true);
     }
 
+    update_possible();
     return true;
 }
 
 bool CameraDefinition::get_setting(const std::string &name,
                                    MAVLinkParameters::ParamValue &value)
 {
-    if (_current_settings.find(name) == _current_settings.end()) {
+    const unsigned index = get_setting_index(name);
+    if (index == NO_INDEX) {
         LogErr() << "Unknown setting to get";
         return false;
     }
 
-    if (!_current_settings.at(name).needs_updating) {
-        value = _current_settings.at(name).value;
+    if (!_parameters[index].needs_updating) {
+        value = _parameters[index].value;
         return true;
     } else {
         return false;
@@ -435,19 +542,21 @@ bool CameraDefinition::get_option_value(const std::string &param_name,
                                         const std::string &option_value,
                                         MAVLinkParameters::ParamValue &value)
 {
-    if (_parameter_map.find(param_name) == _parameter_map.end()) {
+    const unsigned index = get_setting_index(param_name);
+    if (index == NO_INDEX) {
         LogErr() << "Unknown parameter to get option";
         return false;
     }
 
-    for (const auto &option : _parameter_map[param_name]->options) {
-        if (option->value == option_value) {
-            value = option->value;
+    const Parameter &parameter = _parameters[index];
+    for (unsigned i = 0; i < parameter.num_options; ++i) {
+        const Option &option = _options[parameter.first_option + i];
+        if (option.value == option_value) {
+            value = option.value;
             return true;
         }
     }
 
-
     return false;
 }
 
@@ -456,13 +565,15 @@ bool CameraDefinition::get_all_options(
 {
     values.clear();
 
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    const unsigned index = get_setting_index(name);
+    if (index == NO_INDEX) {
         LogErr() << "Unknown parameter to get all options";
         return false;
     }
 
-    for (const auto &option : _parameter_map[name]->options) {
-        values.push_back(option->value);
+    const Parameter &parameter = _parameters[index];
+    for (unsigned i = 0; i < parameter.num_options; ++i) {
+        values.push_back(_options[parameter.first_option + i].value);
     }
 
     return true;
@@ -473,91 +584,22 @@ bool CameraDefinition::get_possible_options(
 {
     values.clear();
 
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    const unsigned index = get_setting_index(name);
+    if (index == NO_INDEX) {
         LogErr() << "Unknown parameter to get possible options";
         return false;
     }
 
-    std::map<std::string, MAVLinkParameters::ParamValue> settings;
-    if (!get_possible_settings(settings)) {
-        return false;
-    }
-    if (settings.find(name) == settings.end()) {
+    if (!is_setting_possible(index)) {
         LogErr() << "Setting " << name << " currently not applicable";
         return false;
     }
 
-    // Find all exclusions because excluded parameters need to be neglected for range
-    // check below.
-    // TODO: use set instead of vector
-    std::vector<std::string> exclusions {};
-
-    for (const auto &parameter : _parameter_map) {
-        for (const auto &option : parameter.second->options) {
-            if (_current_settings[parameter.first].needs_updating) {
-                // LogWarn() << parameter.first << " needs updating";
-                continue;
-            }
-            if (_current_settings[parameter.first].value == option->value) {
-                for (const auto &exclusion : option->exclusions) {
-                    // LogDebug() << "found exclusion for " << parameter.first
-                    //            << "(" << option->value << "): " << exclusion;
-                    exclusions.push_back(exclusion);
-                }
-            }
-        }
-    }
-
-    // TODO: use set instead of vector for this
-    std::vector<MAVLinkParameters::ParamValue> allowed_ranges {};
-
-    // Check allowed ranges.
-    for (const auto &parameter : _parameter_map) {
-
-        if (!parameter.second->is_control) {
-            continue;
-        }
-
-        bool excluded = false;
-        for (const auto &exclusion : exclusions) {
-            if (parameter.first == exclusion) {
-                excluded = true;
-            }
-        }
-        if (excluded) {
-            continue;
-        }
-
-        for (const auto &option : parameter.second->options) {
-            if (_current_settings[parameter.first].needs_updating) {
-                // LogWarn() << parameter.first << " needs updating";
-                continue;
-            }
-            // Only look at current set option.
-            if (_current_settings[parameter.first].value == option->value) {
-                // Go through parameter ranges but only concerning the parameter that
-                // we're interested in..
-                if (option->parameter_ranges.find(name)
-                    != option->parameter_ranges.end()) {
-
-                    for (const auto &range : option->parameter_ranges[name]) {
-                        allowed_ranges.push_back(range.second);
-                    }
-                }
-            }
-        }
-    }
-
-    // Intersect
-    for (const auto &option : _parameter_map[name]->options) {
-        bool option_allowed = false;
-        for (const auto &allowed_range : allowed_ranges) {
-            if (option->value == allowed_range) {
-                option_allowed = true;
-            }
-        }
-        if (option_allowed || allowed_ranges.size() == 0) {
-            values.push_back(option->value);
+    const Parameter &parameter = _parameters[index];
+    for (unsigned i = 0; i < parameter.num_options; ++i) {
+        const Option &option = _options[parameter.first_option + i];
+        if (option.is_possible) {
+            values.push_back(option.value);
         }
     }
 
@@ -568,9 +610,9 @@ bool CameraDefinition::get_unknown_params(std::vector<std::string> &params)
 {
     params.clear();
 
-    for (const auto &parameter : _parameter_map) {
-        if (_current_settings[parameter.first].needs_updating) {
-            params.push_back(parameter.first);
+    for (const auto &parameter : _parameters) {
+        if (parameter.needs_updating) {
+            params.push_back(parameter.name);
         }
     }
     return true;
@@ -578,21 +620,24 @@ bool CameraDefinition::get_unknown_params(std::vector<std::string> &params)
 
 void CameraDefinition::set_all_params_unknown()
 {
-    for (auto &parameter : _parameter_map) {
-        _current_settings[parameter.first].needs_updating = true;
+    for (unsigned i = 0; i < _parameters.size(); ++i) {
+        set_current_value(i, _parameters[i].value, true);
     }
+
+    update_possible();
 }
 
 bool CameraDefinition::get_setting_str(const std::string &name, std::string &description)
 {
     description.clear();
 
-    if (_parameter_map.find(name) == _parameter_map.end()) {
+    const unsigned index = get_setting_index(name);
+    if (index == NO_INDEX) {
         LogWarn() << "Setting " << name << " not found.";
         return false;
     }
 
-    description = _parameter_map[name]->description;
+    description = _parameters[index].description;
     return true;
 }
 
@@ -602,16 +647,17 @@ bool CameraDefinition::get_option_str(const std::string &setting_name,
 {
     description.clear();
 
-    if (_parameter_map.find(setting_name) == _parameter_map.end()) {
+    const unsigned index = get_setting_index(setting_name);
+    if (index == NO_INDEX) {
         LogWarn() << "Setting " << setting_name << " not found.";
         return false;
     }
 
-    for (const auto &option : _parameter_map[setting_name]->options) {
-        std::stringstream value_ss {};
-        value_ss << option->value;
-        if (option->value == option_name) {
-            description = option->name;
+    const Parameter &parameter = _parameters[index];
+    for (unsigned i = 0; i < parameter.num_options; ++i) {
+        const Option &option = _options[parameter.first_option + i];
+        if (option.value == option_name) {
+            description = option.name;
             return true;
         }
     }
@@ -619,4 +665,180 @@ bool CameraDefinition::get_option_str(const std::string &setting_name,
     return false;
 }
 
+unsigned CameraDefinition::get_setting_index(const std::string &name) const
+{
+    const auto it = _parameter_indices.find(name);
+    if (it == _parameter_indices.end()) {
+        return NO_INDEX;
+    }
+    return it->second;
+}
+
+const std::string &CameraDefinition::get_setting_name(unsigned setting) const
+{
+    static const std::string unknown {};
+    if (setting >= _parameters.size()) {
+        return unknown;
+    }
+    return _parameters[setting].name;
+}
+
+bool CameraDefinition::is_setting_possible(unsigned setting) const
+{
+    return setting < _parameters.size() && _parameters[setting].is_possible;
+}
+
+unsigned CameraDefinition::get_num_options(unsigned setting) const
+{
+    if (setting >= _parameters.size()) {
+        return 0;
+    }
+    return _parameters[setting].num_options;
+}
+
+const MAVLinkParameters::ParamValue &CameraDefinition::get_option_value(unsigned setting,
+                                                                        unsigned option) const
+{
+    static const MAVLinkParameters::ParamValue unknown {};
+    if (option >= get_num_options(setting)) {
+        return unknown;
+    }
+    return _options[_parameters[setting].first_option + option].value;
+}
+
+bool CameraDefinition::is_option_possible(unsigned setting, unsigned option) const
+{
+    if (option >= get_num_options(setting)) {
+        return false;
+    }
+    return _options[_parameters[setting].first_option + option].is_possible;
+}
+
+void CameraDefinition::set_current_value(unsigned parameter_index,
+                                         const MAVLinkParameters::ParamValue &value,
+                                         bool needs_updating)
+{
+    Parameter &parameter = _parameters[parameter_index];
+    parameter.value = value;
+    parameter.needs_updating = needs_updating;
+
+    // A value that needs updating can't be relied on to exclude anything.
+    unsigned current_option = NO_INDEX;
+    if (!needs_updating) {
+        for (unsigned i = 0; i < parameter.num_options; ++i) {
+            if (_options[parameter.first_option + i].value == value) {
+                current_option = parameter.first_option + i;
+                break;
+            }
+        }
+    }
+
+    if (current_option == parameter.current_option) {
+        return;
+    }
+    parameter.current_option = current_option;
+
+    apply_exclusions(parameter_index);
+    apply_ranges(parameter_index);
+}
+
+void CameraDefinition::apply_exclusions(unsigned parameter_index)
+{
+    Parameter &parameter = _parameters[parameter_index];
+    const unsigned old_option = parameter.exclusion_option;
+    const unsigned new_option = parameter.current_option;
+    if (old_option == new_option) {
+        return;
+    }
+    parameter.exclusion_option = new_option;
+
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        const unsigned option_index = (pass == 0) ? old_option : new_option;
+        if (option_index == NO_INDEX) {
+            continue;
+        }
+        const Option &option = _options[option_index];
+        for (unsigned i = 0; i < option.num_exclusions; ++i) {
+            const unsigned excluded = _exclusions[option.first_exclusion + i];
+            Parameter &excluded_parameter = _parameters[excluded];
+
+            if (pass == 0) {
+                --excluded_parameter.num_excluded_by;
+            } else {
+                ++excluded_parameter.num_excluded_by;
+            }
+
+            const bool is_possible =
+                excluded_parameter.is_control && excluded_parameter.num_excluded_by == 0;
+            if (is_possible != excluded_parameter.is_possible) {
+                excluded_parameter.is_possible = is_possible;
+                mark_dirty(excluded);
+                // Only possible parameters limit the options of others.
+                apply_ranges(excluded);
+            }
+        }
+    }
+}
+
+void CameraDefinition::apply_ranges(unsigned parameter_index)
+{
+    Parameter &parameter = _parameters[parameter_index];
+    const unsigned old_option = parameter.range_option;
+    const unsigned new_option = parameter.is_possible ? parameter.current_option : NO_INDEX;
+    if (old_option == new_option) {
+        return;
+    }
+    parameter.range_option = new_option;
+
+    for (unsigned pass = 0; pass < 2; ++pass) {
+        const unsigned option_index = (pass == 0) ? old_option : new_option;
+        if (option_index == NO_INDEX) {
+            continue;
+        }
+        const Option &option = _options[option_index];
+        for (unsigned i = 0; i < option.num_ranges; ++i) {
+            const Range &range = _ranges[option.first_range + i];
+            Parameter &limited_parameter = _parameters[range.parameter];
+            const unsigned limited_option = (range.option == NO_INDEX) ?
+                                            NO_INDEX : limited_parameter.first_option + range.option;
+
+            if (pass == 0) {
+                --limited_parameter.num_ranges_on;
+                if (limited_option != NO_INDEX) {
+                    --_num_in_range[limited_option];
+                }
+            } else {
+                ++limited_parameter.num_ranges_on;
+                if (limited_option != NO_INDEX) {
+                    ++_num_in_range[limited_option];
+                }
+            }
+            mark_dirty(range.parameter);
+        }
+    }
+}
+
+void CameraDefinition::mark_dirty(unsigned parameter_index)
+{
+    if (!_is_dirty[parameter_index]) {
+        _is_dirty[parameter_index] = 1;
+        _dirty.push_back(parameter_index);
+    }
+}
+
+void CameraDefinition::update_possible()
+{
+    for (const unsigned parameter_index : _dirty) {
+        const Parameter &parameter = _parameters[parameter_index];
+        for (unsigned i = 0; i < parameter.num_options; ++i) {
+            const unsigned option = parameter.first_option + i;
+            _options[option].is_possible = parameter.is_possible &&
+                                           (parameter.num_ranges_on == 0 ||
+                                            _num_in_range[option] > 0);
+        }
+        _is_dirty[parameter_index] = 0;
+    }
+    _dirty.clear();
+}
+
 } // namespace dronecore
@@ -5,6 +5,7 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <unordered_map>
 #include <string>
 
 namespace dronecore {
@@ -50,41 +51,112 @@ public:
     bool get_unknown_params(std::vector<std::string> &params);
     void set_all_params_unknown();
 
+    // Index based queries, without any lookup by name or allocation. The indices are
+    // valid until the next load.
+    static constexpr unsigned NO_INDEX = unsigned(-1);
+
+    unsigned get_num_settings() const { return unsigned(_parameters.size()); }
+    unsigned get_setting_index(const std::string &name) const;
+    const std::string &get_setting_name(unsigned setting) const;
+    // Settings of this camera with a UI control and not excluded by another setting.
+    bool is_setting_possible(unsigned setting) const;
+
+    unsigned get_num_options(unsigned setting) const;
+    const MAVLinkParameters::ParamValue &get_option_value(unsigned setting,
+                                                          unsigned option) const;
+    // Options of a possible setting which are in the range allowed by the others.
+    bool is_option_possible(unsigned setting, unsigned option) const;
+
     // Non-copyable
     CameraDefinition(const CameraDefinition &) = delete;
     const CameraDefinition &operator=(const CameraDefinition &) = delete;
 
 private:
-    typedef std::map<std::string, MAVLinkParameters::ParamValue> parameter_range_t;
+    bool parse_xml();
+    // Turns the parsed XML into the tables below.
+    struct ParsedOption;
+    struct ParsedParameter;
+    void compile(std::vector<ParsedParameter> &parsed);
+
+    void set_current_value(unsigned parameter, const MAVLinkParameters::ParamValue &value,
+                           bool needs_updating);
+
+    // A change of the current option of a parameter is only followed along the
+    // exclusions and ranges of the old and new option, so only the parameters they
+    // point to are looked at again.
+    void apply_exclusions(unsigned parameter);
+    void apply_ranges(unsigned parameter);
+    void mark_dirty(unsigned parameter);
+    // Updates the options of the parameters marked dirty.
+    void update_possible();
+
+    tinyxml2::XMLDocument _doc {};
+
+    // All names are resolved to indices once the XML is parsed. The options of every
+    // parameter, and the exclusions and ranges of every option, are contiguous ranges
+    // in flat tables.
+    struct Range {
+        unsigned parameter;
+        // NO_INDEX if the value is none of the parameter's options.
+        unsigned option;
+    };
 
     struct Option {
         std::string name;
         MAVLinkParameters::ParamValue value;
-        std::vector<std::string> exclusions;
-        std::map<std::string, parameter_range_t> parameter_ranges;
-        bool is_default;
+        unsigned first_exclusion;
+        unsigned num_exclusions;
+        unsigned first_range;
+        unsigned num_ranges;
+        bool is_possible;
     };
 
     struct Parameter {
+        std::string name;
         std::string description;
         bool is_control;
         bool is_readonly;
         bool is_writeonly;
-        std::vector<std::string> updates;
-        std::vector<std::shared_ptr<Option>> options;
-    };
-    bool parse_xml();
-
-    tinyxml2::XMLDocument _doc {};
+        unsigned first_update;
+        unsigned num_updates;
+        unsigned first_option;
+        unsigned num_options;
+        unsigned default_option;
 
-    std::map<std::string, std::shared_ptr<Parameter>> _parameter_map;
-
-    struct InternalCurrentSetting {
+        // The current setting.
         MAVLinkParameters::ParamValue value;
         bool needs_updating;
+        // NO_INDEX if the value is none of the options or it needs updating.
+        unsigned current_option;
+        bool is_possible;
+
+        // The options whose exclusions and ranges are counted below, NO_INDEX if none.
+        unsigned exclusion_option;
+        unsigned range_option;
+        // Number of current options excluding this parameter.
+        unsigned num_excluded_by;
+        // Number of ranges of possible parameters limiting this one.
+        unsigned num_ranges_on;
     };
 
-    std::map<std::string, InternalCurrentSetting> _current_settings;
+    // Sorted by name.
+    std::vector<Parameter> _parameters {};
+    std::vector<Option> _options {};
+    // Parameter indices.
+    std::vector<unsigned> _updates {};
+    std::vector<unsigned> _exclusions {};
+    std::vector<Range> _ranges {};
+
+    // Only looked up when a name comes in from outside.
+    std::unordered_map<std::string, unsigned> _parameter_indices {};
+
+    // Number of ranges of possible parameters including each option.
+    std::vector<unsigned> _num_in_range {};
+
+    // Parameters whose options need to be looked at again, kept to not allocate
+    // every time.
+    std::vector<unsigned> _dirty {};
+    std::vector<uint8_t> _is_dirty {};
 
     std::string _model;
     std::string _vendor;
@@ -0,0 +1,206 @@
+// Measures parsing, memory footprint and queries of camera definitions.
+//
+// Run from the root with the definition files to measure, by default the E90
+// one of the unit tests:
+//
+//     build/default/plugins/camera/camera_definition_benchmark [file.xml ...]
+
+#include "camera_definition.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+// Every allocation is prefixed with its size, so that the bytes in use can be
+// counted. Enough to keep the alignment of malloc.
+static constexpr size_t ALLOCATION_HEADER_LEN = 16;
+static std::atomic<size_t> bytes_in_use {0};
+static std::atomic<size_t> num_allocations {0};
+
+// Results are stored here so that the measured loops are not optimized away.
+volatile unsigned benchmark_sink = 0;
+
+void *operator new(size_t size)
+{
+    void *block = std::malloc(size + ALLOCATION_HEADER_LEN);
+    if (!block) {
+        std::abort();
+    }
+    *static_cast<size_t *>(block) = size;
+    bytes_in_use += size;
+    ++num_allocations;
+    return static_cast<char *>(block) + ALLOCATION_HEADER_LEN;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    if (!ptr) {
+        return;
+    }
+    void *block = static_cast<char *>(ptr) - ALLOCATION_HEADER_LEN;
+    bytes_in_use -= *static_cast<size_t *>(block);
+    std::free(block);
+}
+
+static bool read_file(const std::string &path, std::string &content)
+{
+    std::ifstream file_stream(path);
+    if (!file_stream.is_open()) {
+        return false;
+    }
+    std::getline(file_stream, content, '\0');
+    return true;
+}
+
+// Runs the function until at least MIN_DURATION_S passed, a few times, and
+// prints the fastest time per call.
+static void measure(const std::string &name, const std::function<void()> &function)
+{
+    static constexpr double MIN_DURATION_S = 0.1;
+    static constexpr int NUM_RUNS = 5;
+
+    double best_s_per_call = 0.0;
+    size_t allocations_per_call = 0;
+
+    for (int run = 0; run < NUM_RUNS; ++run) {
+        const size_t num_allocations_before = num_allocations;
+        const auto start = std::chrono::steady_clock::now();
+
+        unsigned num_calls = 0;
+        double duration_s = 0.0;
+        do {
+            function();
+            ++num_calls;
+            duration_s = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start).count();
+        } while (duration_s < MIN_DURATION_S);
+
+        const double s_per_call = duration_s / num_calls;
+        if (run == 0 || s_per_call < best_s_per_call) {
+            best_s_per_call = s_per_call;
+        }
+        allocations_per_call = (num_allocations - num_allocations_before) / num_calls;
+    }
+
+    std::printf("  %-28s %12.3f us %8zu allocations\n", name.c_str(),
+                best_s_per_call * 1e6, allocations_per_call);
+}
+
+static bool benchmark_file(const std::string &path)
+{
+    std::string content;
+    if (!read_file(path, content)) {
+        std::printf("Could not read %s\n", path.c_str());
+        return false;
+    }
+
+    std::printf("%s (%zu bytes)\n", path.c_str(), content.size());
+
+    {
+        const size_t bytes_before = bytes_in_use;
+        CameraDefinition cd;
+        if (!cd.load_string(content)) {
+            std::printf("  Could not load it\n");
+            return false;
+        }
+        cd.assume_default_settings();
+        std::printf("  %-28s %12zu bytes, %u settings\n", "memory in use",
+                    bytes_in_use - bytes_before, cd.get_num_settings());
+    }
+
+    measure("load_string", [&content]() {
+        CameraDefinition cd;
+        cd.load_string(content);
+    });
+
+    CameraDefinition cd;
+    cd.load_string(content);
+    cd.assume_default_settings();
+
+    std::map<std::string, MAVLinkParameters::ParamValue> settings;
+    measure("get_all_settings", [&cd, &settings]() {
+        settings.clear();
+        cd.get_all_settings(settings);
+    });
+
+    measure("get_possible_settings", [&cd, &settings]() {
+        settings.clear();
+        cd.get_possible_settings(settings);
+    });
+
+    // All queries the settings UI does on a change.
+    std::vector<std::string> names;
+    for (unsigned i = 0; i < cd.get_num_settings(); ++i) {
+        names.push_back(cd.get_setting_name(i));
+    }
+    measure("get_possible_options (all)", [&cd, &names]() {
+        std::vector<MAVLinkParameters::ParamValue> options;
+        for (unsigned i = 0; i < cd.get_num_settings(); ++i) {
+            // Others are not asked for and would only log errors.
+            if (!cd.is_setting_possible(i)) {
+                continue;
+            }
+            options.clear();
+            cd.get_possible_options(names[i], options);
+        }
+    });
+
+    measure("get_setting_str (all)", [&cd, &names]() {
+        std::string description;
+        for (const auto &name : names) {
+            cd.get_setting_str(name, description);
+        }
+    });
+
+    measure("is_option_possible (all)", [&cd]() {
+        unsigned num_possible = 0;
+        for (unsigned setting = 0; setting < cd.get_num_settings(); ++setting) {
+            for (unsigned option = 0; option < cd.get_num_options(setting); ++option) {
+                num_possible += cd.is_option_possible(setting, option) ? 1 : 0;
+            }
+        }
+        benchmark_sink = num_possible;
+    });
+
+    // Cycles through the options of every setting, each change updates what
+    // is possible.
+    std::vector<unsigned> next_option(cd.get_num_settings(), 0);
+    measure("set_setting", [&cd, &next_option]() {
+        for (unsigned setting = 0; setting < cd.get_num_settings(); ++setting) {
+            const unsigned num_options = cd.get_num_options(setting);
+            if (num_options == 0) {
+                continue;
+            }
+            next_option[setting] = (next_option[setting] + 1) % num_options;
+            cd.set_setting(cd.get_setting_name(setting),
+                           cd.get_option_value(setting, next_option[setting]));
+        }
+    });
+
+    return true;
+}
+
+int main(int argc, const char *argv[])
+{
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        paths.push_back(argv[i]);
+    }
+    if (paths.empty()) {
+        paths.push_back("plugins/camera/e90_unit_test.xml");
+    }
+
+    bool success = true;
+    for (const auto &path : paths) {
+        success = benchmark_file(path) && success;
+    }
+    return success ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+#include "camera_definition_cache.h"
+#include "log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+
+#if defined(WINDOWS)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <errno.h>
+#endif
+
+namespace dronecore {
+
+CameraDefinitionCache::CameraDefinitionCache(const std::string &directory) :
+    _directory(directory) {}
+
+std::string CameraDefinitionCache::default_directory()
+{
+#if defined(WINDOWS)
+    const char *base = std::getenv("LOCALAPPDATA");
+    if (base == nullptr || base[0] == '\0') {
+        return "";
+    }
+    return std::string(base) + "\\dronecore\\camera_definitions";
+#else
+    const char *base = std::getenv("XDG_CACHE_HOME");
+    if (base != nullptr && base[0] != '\0') {
+        return std::string(base) + "/dronecore/camera_definitions";
+    }
+    const char *home = std::getenv("HOME");
+    if (home == nullptr || home[0] == '\0') {
+        return "";
+    }
+    return std::string(home) + "/.cache/dronecore/camera_definitions";
+#endif
+}
+
+static std::string sanitize(const std::string &name)
+{
+    std::string sanitized;
+    for (char c : name) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '-') {
+            sanitized += c;
+        } else {
+            sanitized += '_';
+        }
+    }
+    return sanitized;
+}
+
+std::string CameraDefinitionCache::file_name(const Key &key)
+{
+    // FNV-1a, the URI only needs to be told apart from other ones of the same camera.
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key.uri) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    std::ostringstream name;
+    name << sanitize(key.vendor) << "_" << sanitize(key.model) << "_v" << key.version << "_"
+         << std::hex << std::setw(16) << std::setfill('0') << hash << ".xml";
+    return name.str();
+}
+
+bool CameraDefinitionCache::load(const Key &key, std::string &content,
+                                 HttpValidators &validators) const
+{
+    if (_directory.empty()) {
+        return false;
+    }
+
+    const std::string path = _directory + "/" + file_name(key);
+
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    if (content.empty()) {
+        return false;
+    }
+
+    // Without validators, the server is just not asked whether it changed.
+    validators = HttpValidators {};
+    std::ifstream validators_file(path + ".validators");
+    if (validators_file.is_open()) {
+        std::getline(validators_file, validators.etag);
+        std::getline(validators_file, validators.last_modified);
+    }
+    return true;
+}
+
+bool CameraDefinitionCache::store(const Key &key, const std::string &content,
+                                  const HttpValidators &validators)
+{
+    if (_directory.empty()) {
+        return false;
+    }
+
+    if (!make_directories(_directory)) {
+        LogWarn() << "Could not create camera definition cache in " << _directory;
+        return false;
+    }
+
+    const std::string path = _directory + "/" + file_name(key);
+
+    return write_file(path + ".validators", validators.etag + "\n" +
+                      validators.last_modified + "\n") &&
+           write_file(path, content);
+}
+
+bool CameraDefinitionCache::write_file(const std::string &path, const std::string &content)
+{
+    // Written next to it and renamed, so that another instance never reads half a file.
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+        file << content;
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+#if defined(WINDOWS)
+    // Windows doesn't replace an existing file on rename.
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool CameraDefinitionCache::make_directories(const std::string &path)
+{
+    // Every parent first, it's fine if they exist already.
+    for (size_t pos = path.find_first_of("/\\", 1); ; pos = path.find_first_of("/\\", pos + 1)) {
+        const std::string parent = path.substr(0, pos);
+#if defined(WINDOWS)
+        const int ret = _mkdir(parent.c_str());
+#else
+        const int ret = mkdir(parent.c_str(), 0755);
+#endif
+        if (ret != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (pos == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+} // namespace dronecore
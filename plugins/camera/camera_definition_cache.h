@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "curl_wrapper_types.h"
+
+namespace dronecore {
+
+// Camera definition files kept on disk, so that a camera seen before can be used
+// right away instead of waiting for the download.
+//
+// A file is stored per vendor, model, definition version and URI. The HTTP
+// validators it was downloaded with are kept next to it, to ask the server
+// whether it changed when the camera doesn't report a version.
+class CameraDefinitionCache
+{
+public:
+    // An empty directory disables the cache.
+    explicit CameraDefinitionCache(const std::string &directory);
+    ~CameraDefinitionCache() {}
+
+    // In the user's cache directory, empty if there is none.
+    static std::string default_directory();
+
+    struct Key {
+        std::string vendor;
+        std::string model;
+        uint16_t version;
+        std::string uri;
+    };
+
+    bool load(const Key &key, std::string &content, HttpValidators &validators) const;
+    bool store(const Key &key, const std::string &content, const HttpValidators &validators);
+
+    // File name without directory, only made of characters safe in any file system.
+    static std::string file_name(const Key &key);
+
+    // Non-copyable
+    CameraDefinitionCache(const CameraDefinitionCache &) = delete;
+    const CameraDefinitionCache &operator=(const CameraDefinitionCache &) = delete;
+
+private:
+    static bool make_directories(const std::string &path);
+    static bool write_file(const std::string &path, const std::string &content);
+
+    std::string _directory;
+};
+
+} // namespace dronecore
@@ -0,0 +1,78 @@
+#include "camera_definition_cache.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+using namespace dronecore;
+
+static const std::string cache_directory = "camera_definition_cache_test/nested";
+
+static CameraDefinitionCache::Key make_key()
+{
+    CameraDefinitionCache::Key key {};
+    key.vendor = "Yuneec";
+    key.model = "E90";
+    key.version = 3;
+    key.uri = "http://10.1.1.1/camera/E90.xml";
+    return key;
+}
+
+static void remove_cache(const CameraDefinitionCache::Key &key)
+{
+    const std::string path = cache_directory + "/" + CameraDefinitionCache::file_name(key);
+    std::remove(path.c_str());
+    std::remove((path + ".validators").c_str());
+    std::remove(cache_directory.c_str());
+    std::remove("camera_definition_cache_test");
+}
+
+TEST(CameraDefinitionCache, StoresAndLoads)
+{
+    const auto key = make_key();
+    remove_cache(key);
+
+    CameraDefinitionCache cache(cache_directory);
+
+    std::string content;
+    HttpValidators validators {};
+    EXPECT_FALSE(cache.load(key, content, validators));
+
+    HttpValidators stored {};
+    stored.etag = "\"abc\"";
+    stored.last_modified = "Wed, 21 Oct 2015 07:28:00 GMT";
+    ASSERT_TRUE(cache.store(key, "<mavlinkcamera/>", stored));
+
+    ASSERT_TRUE(cache.load(key, content, validators));
+    EXPECT_EQ(content, "<mavlinkcamera/>");
+    EXPECT_EQ(validators.etag, stored.etag);
+    EXPECT_EQ(validators.last_modified, stored.last_modified);
+
+    // Another version is another file.
+    auto other = key;
+    other.version = 4;
+    EXPECT_FALSE(cache.load(other, content, validators));
+
+    remove_cache(key);
+}
+
+TEST(CameraDefinitionCache, MakesSafeFileNames)
+{
+    auto key = make_key();
+    key.vendor = "../..";
+    key.model = "a/b\\c";
+
+    const std::string name = CameraDefinitionCache::file_name(key);
+    EXPECT_EQ(name.find('/'), std::string::npos);
+    EXPECT_EQ(name.find('\\'), std::string::npos);
+    EXPECT_EQ(name.find(".."), std::string::npos);
+
+    // The URI is part of it, too.
+    auto other = key;
+    other.uri += "?v=2";
+    EXPECT_NE(CameraDefinitionCache::file_name(other), name);
+}
+
+TEST(CameraDefinitionCache, DisabledWithoutDirectory)
+{
+    CameraDefinitionCache cache("");
+    EXPECT_FALSE(cache.store(make_key(), "<mavlinkcamera/>", HttpValidators {}));
+}
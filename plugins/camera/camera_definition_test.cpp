@@ -486,3 +486,46 @@ TEST(CameraDefinition, E90OptionHumanReadable)
     EXPECT_FALSE(cd.get_option_str("PIPAPO", "123", description));
     EXPECT_STREQ(description.c_str(), "");
 }
+
+TEST(CameraDefinition, E90IndexQueriesMatchNamed)
+{
+    CameraDefinition cd;
+    ASSERT_TRUE(cd.load_file(e90_unit_test_file));
+    cd.assume_default_settings();
+
+    EXPECT_EQ(cd.get_num_settings(), 16);
+    EXPECT_EQ(cd.get_setting_index("PIPAPO"), CameraDefinition::NO_INDEX);
+
+    // Video mode so that the ranges of CAM_VIDFMT apply.
+    MAVLinkParameters::ParamValue value;
+    value.set_uint32(1);
+    EXPECT_TRUE(cd.set_setting("CAM_MODE", value));
+
+    std::map<std::string, MAVLinkParameters::ParamValue> possible_settings {};
+    EXPECT_TRUE(cd.get_possible_settings(possible_settings));
+
+    for (unsigned i = 0; i < cd.get_num_settings(); ++i) {
+        const std::string &name = cd.get_setting_name(i);
+        EXPECT_EQ(cd.get_setting_index(name), i);
+        EXPECT_EQ(cd.is_setting_possible(i), possible_settings.count(name) == 1);
+
+        std::vector<MAVLinkParameters::ParamValue> all_options {};
+        EXPECT_TRUE(cd.get_all_options(name, all_options));
+        ASSERT_EQ(cd.get_num_options(i), all_options.size());
+
+        std::vector<MAVLinkParameters::ParamValue> possible_options {};
+        cd.get_possible_options(name, possible_options);
+
+        std::vector<MAVLinkParameters::ParamValue> indexed_options {};
+        for (unsigned j = 0; j < cd.get_num_options(i); ++j) {
+            EXPECT_EQ(cd.get_option_value(i, j), all_options[j]);
+            if (cd.is_option_possible(i, j)) {
+                indexed_options.push_back(cd.get_option_value(i, j));
+            }
+        }
+        EXPECT_EQ(indexed_options, possible_options);
+    }
+
+    EXPECT_FALSE(cd.is_setting_possible(cd.get_num_settings()));
+    EXPECT_EQ(cd.get_num_options(cd.get_num_settings()), 0);
+}
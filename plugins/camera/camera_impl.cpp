@@ -5,13 +5,22 @@
 #include "mavlink_include.h"
 #include "http_loader.h"
 #include <functional>
+#include <cstring>
 
 namespace dronecore {
 
 using namespace std::placeholders; // for `_1`
 
-CameraImpl::CameraImpl(System &system) :
-    PluginImplBase(system)
+constexpr double CameraImpl::STATUS_RATE_HZ;
+constexpr double CameraImpl::CAPTURE_RECOVERY_INTERVAL_S;
+constexpr unsigned CameraImpl::CAPTURE_RECOVERY_BATCH;
+
+// MAV_CMD_REQUEST_MESSAGE, not in all MAVLink headers yet.
+static constexpr uint16_t REQUEST_MESSAGE_COMMAND = 512;
+
+CameraImpl::CameraImpl(System &system, int camera_id) :
+    PluginImplBase(system),
+    _component_id(uint8_t(MAV_COMP_ID_CAMERA + camera_id))
 {
     _parent->register_plugin(this);
 }
@@ -53,6 +62,8 @@ void CameraImpl::init()
         std::bind(&CameraImpl::process_video_information, this, _1),
         this);
 
+    _http_loader.reset(new HttpLoader());
+
     auto command_camera_info = make_command_request_camera_info();
 
     _parent->send_command_async(command_camera_info, nullptr);
@@ -61,16 +72,53 @@ void CameraImpl::init()
 void CameraImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+
+    // Waits for a download still going on.
+    _http_loader.reset();
+    {
+        std::lock_guard<std::mutex> lock(_definition_download.mutex);
+        _definition_download.uri.clear();
+    }
+
+    std::shared_ptr<HttpLoader> media_loader {};
+    {
+        std::lock_guard<std::mutex> lock(_media_download.mutex);
+        media_loader = std::move(_media_download.loader);
+        _media_download.num_pending = 0;
+    }
+    // Waits for the transfers going on, outside of the lock their callbacks take.
+    media_loader.reset();
 }
 
 void CameraImpl::enable()
 {
+    // Params the camera sends out as they change are taken in directly, only
+    // the ones never seen need to be fetched.
+    _param_subscription = _parent->subscribe_param(
+                              "", std::bind(&CameraImpl::receive_param_changed, this,
+                                            std::placeholders::_1, std::placeholders::_2),
+                              true, _component_id);
     refresh_params();
+
+    _parent->add_call_every([this]() { request_missing_captures(); },
+                            float(CAPTURE_RECOVERY_INTERVAL_S),
+                            &_capture_info.recovery_cookie);
+
+    // Cameras that don't support this are polled on get_status_async().
+    _parent->set_msg_rates_async({
+        {MAVLINK_MSG_ID_CAMERA_CAPTURE_STATUS, STATUS_RATE_HZ},
+        {MAVLINK_MSG_ID_STORAGE_INFORMATION, STATUS_RATE_HZ}
+    }, nullptr, _component_id);
 }
 
 void CameraImpl::disable()
 {
+    _parent->unsubscribe_param(_param_subscription);
+    _param_subscription = 0;
     invalidate_params();
+
+    _parent->remove_call_every(_capture_info.recovery_cookie);
+    _capture_info.recovery_cookie = nullptr;
 }
 
 MAVLinkCommands::CommandLong
@@ -80,11 +128,24 @@ CameraImpl::make_command_request_camera_info()
 
     command_camera_info.command = MAV_CMD_REQUEST_CAMERA_INFORMATION;
     command_camera_info.params.param1 = 1.0f; // Request it
-    command_camera_info.target_component_id = MAV_COMP_ID_CAMERA;
+    command_camera_info.target_component_id = _component_id;
 
     return command_camera_info;
 }
 
+MAVLinkCommands::CommandLong
+CameraImpl::make_command_request_image_captured(int index)
+{
+    MAVLinkCommands::CommandLong command {};
+
+    command.command = REQUEST_MESSAGE_COMMAND;
+    command.params.param1 = float(MAVLINK_MSG_ID_CAMERA_IMAGE_CAPTURED);
+    command.params.param2 = float(index);
+    command.target_component_id = _component_id;
+
+    return command;
+}
+
 MAVLinkCommands::CommandLong
 CameraImpl::make_command_take_photo(float interval_s, float no_of_photos)
 {
@@ -95,7 +156,7 @@ CameraImpl::make_command_take_photo(float interval_s, float no_of_photos)
     cmd_take_photo.params.param2 = interval_s;
     cmd_take_photo.params.param3 = no_of_photos;
     cmd_take_photo.params.param4 = float(_capture.sequence++);
-    cmd_take_photo.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_take_photo.target_component_id = _component_id;
 
     return cmd_take_photo;
 }
@@ -106,7 +167,7 @@ CameraImpl::make_command_stop_photo()
     MAVLinkCommands::CommandLong cmd_stop_photo {};
 
     cmd_stop_photo.command = MAV_CMD_IMAGE_STOP_CAPTURE;
-    cmd_stop_photo.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_stop_photo.target_component_id = _component_id;
 
     return cmd_stop_photo;
 }
@@ -119,7 +180,7 @@ CameraImpl::make_command_start_video(float capture_status_rate_hz)
     cmd_start_video.command = MAV_CMD_VIDEO_START_CAPTURE;
     cmd_start_video.params.param1 = 0.f; // Reserved, set to 0
     cmd_start_video.params.param2 = capture_status_rate_hz;
-    cmd_start_video.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_start_video.target_component_id = _component_id;
 
     return cmd_start_video;
 }
@@ -131,7 +192,7 @@ CameraImpl::make_command_stop_video()
 
     cmd_stop_video.command = MAV_CMD_VIDEO_STOP_CAPTURE;
     cmd_stop_video.params.param1 = 0.f; // Reserved, set to 0
-    cmd_stop_video.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_stop_video.target_component_id = _component_id;
 
     return cmd_stop_video;
 }
@@ -144,7 +205,7 @@ CameraImpl::make_command_set_camera_mode(float mavlink_mode)
     cmd_set_camera_mode.command = MAV_CMD_SET_CAMERA_MODE;
     cmd_set_camera_mode.params.param1 = 0.0f; // Reserved, set to 0
     cmd_set_camera_mode.params.param2 = mavlink_mode;
-    cmd_set_camera_mode.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_set_camera_mode.target_component_id = _component_id;
 
     return  cmd_set_camera_mode;
 }
@@ -156,7 +217,7 @@ CameraImpl::make_command_request_camera_settings()
 
     cmd_req_camera_settings.command = MAV_CMD_REQUEST_CAMERA_SETTINGS;
     cmd_req_camera_settings.params.param1 = 1.f; // Request it
-    cmd_req_camera_settings.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_req_camera_settings.target_component_id = _component_id;
 
     return cmd_req_camera_settings;
 }
@@ -168,6 +229,7 @@ CameraImpl::make_command_request_camera_capture_status()
 
     cmd_req_camera_cap_stat.command = MAV_CMD_REQUEST_CAMERA_CAPTURE_STATUS;
     cmd_req_camera_cap_stat.params.param1 = 1.0f; // Request it
+    cmd_req_camera_cap_stat.target_component_id = _component_id;
 
     return cmd_req_camera_cap_stat;
 }
@@ -180,7 +242,7 @@ CameraImpl::make_command_request_storage_info()
     cmd_req_storage_info.command = MAV_CMD_REQUEST_STORAGE_INFORMATION;
     cmd_req_storage_info.params.param1 = 0.f; // Reserved, set to 0
     cmd_req_storage_info.params.param2 = 1.f; // Request it
-    cmd_req_storage_info.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_req_storage_info.target_component_id = _component_id;
 
     return cmd_req_storage_info;
 }
@@ -191,7 +253,7 @@ CameraImpl::make_command_start_video_streaming()
     MAVLinkCommands::CommandLong cmd_start_video_streaming {};
 
     cmd_start_video_streaming.command = MAV_CMD_VIDEO_START_STREAMING;
-    cmd_start_video_streaming.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_start_video_streaming.target_component_id = _component_id;
 
     return  cmd_start_video_streaming;
 }
@@ -202,7 +264,7 @@ CameraImpl::make_command_stop_video_streaming()
     MAVLinkCommands::CommandLong cmd_stop_video_streaming {};
 
     cmd_stop_video_streaming.command = MAV_CMD_VIDEO_STOP_STREAMING;
-    cmd_stop_video_streaming.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_stop_video_streaming.target_component_id = _component_id;
 
     return  cmd_stop_video_streaming;
 
@@ -217,8 +279,8 @@ CameraImpl::make_message_set_video_stream_settings(const Camera::VideoStreamSett
                                                GCSClient::component_id,
                                                &msg,
                                                _parent->get_system_id(),
-                                               MAV_COMP_ID_CAMERA,
-                                               MAV_COMP_ID_CAMERA, // Is it right ?
+                                               _component_id,
+                                               _component_id, // Is it right ?
                                                settings.frame_rate_hz,
                                                settings.horizontal_resolution_pix,
                                                settings.vertical_resolution_pix,
@@ -236,7 +298,7 @@ CameraImpl::make_command_request_video_stream_info()
 
     cmd_req_video_stream_info.command = MAV_CMD_REQUEST_VIDEO_STREAM_INFORMATION;
     cmd_req_video_stream_info.params.param2 = 1.0f;
-    cmd_req_video_stream_info.target_component_id = MAV_COMP_ID_CAMERA;
+    cmd_req_video_stream_info.target_component_id = _component_id;
 
     return cmd_req_video_stream_info;
 }
@@ -511,6 +573,8 @@ void CameraImpl::get_status_async(Camera::get_status_callback_t callback)
         return;
     }
 
+    bool poll_camera_capture_status;
+    bool poll_storage_information;
     {
         std::lock_guard<std::mutex> lock(_status.mutex);
 
@@ -522,17 +586,34 @@ void CameraImpl::get_status_async(Camera::get_status_callback_t callback)
                 return;
             }
         }
+
+        mark_stale_status();
+        poll_camera_capture_status = !_status.received_camera_capture_status;
+        poll_storage_information = !_status.received_storage_information;
+
+        if (!poll_camera_capture_status && !poll_storage_information) {
+            // The broadcasts are recent enough, no need to ask.
+            callback(Camera::Result::SUCCESS, _status.data);
+            return;
+        }
+
         // Let's create a subscription for the (hopefully) incoming messages.
         _status.callback = callback;
     }
 
-    auto cmd_req_camera_capture_stat = make_command_request_camera_capture_status();
-    _parent->send_command_async(cmd_req_camera_capture_stat,
-                                std::bind(&CameraImpl::receive_camera_capture_status_result, this, _1));
+    if (poll_camera_capture_status) {
+        auto cmd_req_camera_capture_stat = make_command_request_camera_capture_status();
+        _parent->send_command_async(cmd_req_camera_capture_stat,
+                                    std::bind(&CameraImpl::receive_camera_capture_status_result,
+                                              this, _1));
+    }
 
-    auto cmd_req_storage_info = make_command_request_storage_info();
-    _parent->send_command_async(cmd_req_storage_info,
-                                std::bind(&CameraImpl::receive_storage_information_result, this, _1));
+    if (poll_storage_information) {
+        auto cmd_req_storage_info = make_command_request_storage_info();
+        _parent->send_command_async(cmd_req_storage_info,
+                                    std::bind(&CameraImpl::receive_storage_information_result,
+                                              this, _1));
+    }
 
     _parent->register_timeout_handler(std::bind(&CameraImpl::status_timeout_happened, this),
                                       DEFAULT_TIMEOUT_S, &_status.timeout_cookie);
@@ -559,6 +640,68 @@ void CameraImpl::receive_camera_capture_status_result(MAVLinkCommands::Result re
     _parent->refresh_timeout_handler(_status.timeout_cookie);
 }
 
+void CameraImpl::download_media_async(const std::vector<std::string> &file_urls,
+                                      const std::string &local_directory,
+                                      Camera::download_media_callback_t callback,
+                                      unsigned num_parallel)
+{
+    if (num_parallel == 0) {
+        num_parallel = 1;
+    }
+
+    std::lock_guard<std::mutex> lock(_media_download.mutex);
+
+    if (!_media_download.loader ||
+        (_media_download.num_pending == 0 && _media_download.num_transfers != num_parallel)) {
+        _media_download.loader.reset(new HttpLoader(num_parallel));
+        _media_download.num_transfers = num_parallel;
+    }
+
+    for (const auto &file_url : file_urls) {
+        const std::string file_name = get_media_file_name(file_url);
+        if (file_name.empty()) {
+            LogErr() << "No file name in " << file_url;
+            if (callback) {
+                callback(Camera::Result::WRONG_ARGUMENT, file_url, "");
+            }
+            continue;
+        }
+        const std::string local_path = local_directory + "/" + file_name;
+
+        ++_media_download.num_pending;
+        _media_download.loader->download_async(
+            file_url, local_path,
+        [this, callback, file_url, local_path](int, Status status, CURLcode) {
+            if (status != Status::Finished && status != Status::Error) {
+                return 0;
+            }
+            if (callback) {
+                callback(status == Status::Finished ? Camera::Result::SUCCESS :
+                         Camera::Result::ERROR, file_url, local_path);
+            }
+            // Only now, so that the loader isn't replaced from within its own callback.
+            std::lock_guard<std::mutex> callback_lock(_media_download.mutex);
+            if (_media_download.num_pending > 0) {
+                --_media_download.num_pending;
+            }
+            return 0;
+        }, true);
+    }
+}
+
+std::string CameraImpl::get_media_file_name(const std::string &file_url)
+{
+    std::string path = file_url.substr(0, file_url.find_first_of("?#"));
+    const size_t slash = path.find_last_of('/');
+    if (slash != std::string::npos) {
+        path = path.substr(slash + 1);
+    }
+    if (path == "." || path == "..") {
+        return "";
+    }
+    return path;
+}
+
 void CameraImpl::capture_info_async(Camera::capture_info_callback_t callback)
 {
     std::lock_guard<std::mutex> lock(_capture_info.mutex);
@@ -568,6 +711,11 @@ void CameraImpl::capture_info_async(Camera::capture_info_callback_t callback)
 
 void CameraImpl::process_camera_capture_status(const mavlink_message_t &message)
 {
+    // Other cameras of the same system send the same messages.
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_camera_capture_status_t camera_capture_status;
     mavlink_msg_camera_capture_status_decode(&message, &camera_capture_status);
 
@@ -578,6 +726,7 @@ void CameraImpl::process_camera_capture_status(const mavlink_message_t &message)
         _status.data.photo_interval_on = (camera_capture_status.image_status == 2 ||
                                           camera_capture_status.image_status == 3);
         _status.received_camera_capture_status = true;
+        _status.camera_capture_status_time = _parent->get_time().steady_time();
     }
 
     check_status();
@@ -585,6 +734,10 @@ void CameraImpl::process_camera_capture_status(const mavlink_message_t &message)
 
 void CameraImpl::process_storage_information(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_storage_information_t storage_information;
     mavlink_msg_storage_information_decode(&message, &storage_information);
 
@@ -601,6 +754,7 @@ void CameraImpl::process_storage_information(const mavlink_message_t &message)
         _status.data.used_storage_mib = storage_information.used_capacity;
         _status.data.total_storage_mib = storage_information.total_capacity;
         _status.received_storage_information = true;
+        _status.storage_information_time = _parent->get_time().steady_time();
     }
 
     check_status();
@@ -608,12 +762,22 @@ void CameraImpl::process_storage_information(const mavlink_message_t &message)
 
 void CameraImpl::process_camera_image_captured(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_camera_image_captured_t image_captured;
     mavlink_msg_camera_image_captured_decode(&message, &image_captured);
 
     {
         std::lock_guard<std::mutex> lock(_capture_info.mutex);
 
+        if (!_capture_info.sequence.add(image_captured.image_index,
+                                        image_captured.time_boot_ms)) {
+            // Requested again, but the first one made it after all.
+            return;
+        }
+
         if (_capture_info.callback) {
             Camera::CaptureInfo capture_info = {};
             capture_info.position.latitude_deg = image_captured.lat / 1e7;
@@ -633,8 +797,40 @@ void CameraImpl::process_camera_image_captured(const mavlink_message_t &message)
     }
 }
 
+void CameraImpl::request_missing_captures()
+{
+    std::vector<int> indices;
+    {
+        std::lock_guard<std::mutex> lock(_capture_info.mutex);
+        // Only worth it for someone getting the capture info.
+        if (!_capture_info.callback || _capture_info.num_requests_pending > 0) {
+            return;
+        }
+        _capture_info.sequence.take_missing(CAPTURE_RECOVERY_BATCH, indices);
+        _capture_info.num_requests_pending = unsigned(indices.size());
+    }
+
+    for (int index : indices) {
+        auto command = make_command_request_image_captured(index);
+        _parent->send_command_async(command,
+        [this](MAVLinkCommands::Result result, float) {
+            if (result == MAVLinkCommands::Result::IN_PROGRESS) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(_capture_info.mutex);
+            if (_capture_info.num_requests_pending > 0) {
+                --_capture_info.num_requests_pending;
+            }
+        });
+    }
+}
+
 void CameraImpl::process_camera_settings(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(_get_mode.mutex);
 
     if (_get_mode.callback == nullptr) {
@@ -658,11 +854,18 @@ void CameraImpl::process_camera_settings(const mavlink_message_t &message)
             break;
     }
 
-    if (_camera_definition) {
-        // This "parameter" needs to be manually set.
-        MAVLinkParameters::ParamValue value;
-        value.set_uint32(camera_settings.mode_id);
-        _camera_definition->set_setting("CAM_MODE", value);
+    bool has_definition = false;
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (_camera_definition.definition) {
+            // This "parameter" needs to be manually set.
+            MAVLinkParameters::ParamValue value;
+            value.set_uint32(camera_settings.mode_id);
+            _camera_definition.definition->set_setting("CAM_MODE", value);
+            has_definition = true;
+        }
+    }
+    if (has_definition) {
         refresh_params();
     }
 
@@ -674,14 +877,35 @@ void CameraImpl::process_camera_settings(const mavlink_message_t &message)
 
 void CameraImpl::process_camera_information(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_camera_information_t camera_information;
     mavlink_msg_camera_information_decode(&message, &camera_information);
 
-    load_definition_file(camera_information.cam_definition_uri);
+    // The strings are not terminated if they fill the whole array.
+    CameraDefinitionCache::Key key {};
+    key.vendor = std::string(reinterpret_cast<const char *>(camera_information.vendor_name),
+                             strnlen(reinterpret_cast<const char *>(camera_information.vendor_name),
+                                     sizeof(camera_information.vendor_name)));
+    key.model = std::string(reinterpret_cast<const char *>(camera_information.model_name),
+                            strnlen(reinterpret_cast<const char *>(camera_information.model_name),
+                                    sizeof(camera_information.model_name)));
+    key.version = camera_information.cam_definition_version;
+    key.uri = std::string(camera_information.cam_definition_uri,
+                          strnlen(camera_information.cam_definition_uri,
+                                  sizeof(camera_information.cam_definition_uri)));
+
+    load_definition_file(key);
 }
 
 void CameraImpl::process_video_information(const mavlink_message_t &message)
 {
+    if (message.compid != _component_id) {
+        return;
+    }
+
     mavlink_video_stream_information_t received_video_info;
     mavlink_msg_video_stream_information_decode(&message, &received_video_info);
 
@@ -711,13 +935,25 @@ void CameraImpl::check_status()
         if (_status.callback) {
             _status.callback(Camera::Result::SUCCESS, _status.data);
             _status.callback = nullptr;
-            _status.received_camera_capture_status = false;
-            _status.received_storage_information = false;
             _parent->unregister_timeout_handler(_status.timeout_cookie);
         }
     }
 }
 
+void CameraImpl::mark_stale_status()
+{
+    Time &time = _parent->get_time();
+
+    if (_status.received_camera_capture_status &&
+        time.elapsed_since_s(_status.camera_capture_status_time) > STATUS_STALE_S) {
+        _status.received_camera_capture_status = false;
+    }
+    if (_status.received_storage_information &&
+        time.elapsed_since_s(_status.storage_information_time) > STATUS_STALE_S) {
+        _status.received_storage_information = false;
+    }
+}
+
 void CameraImpl::status_timeout_happened()
 {
     std::lock_guard<std::mutex> lock(_status.mutex);
@@ -775,7 +1011,7 @@ void CameraImpl::receive_set_mode_command_result(MAVLinkCommands::Result command
         callback(camera_result, mode);
     }
 
-    if (command_result == MAVLinkCommands::Result::SUCCESS && _camera_definition) {
+    if (command_result == MAVLinkCommands::Result::SUCCESS) {
         // This "parameter" needs to be manually set.
 
         uint32_t mavlink_mode;
@@ -795,7 +1031,13 @@ void CameraImpl::receive_set_mode_command_result(MAVLinkCommands::Result command
 
         MAVLinkParameters::ParamValue value;
         value.set_uint32(mavlink_mode);
-        _camera_definition->set_setting("CAM_MODE", value);
+        {
+            std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+            if (!_camera_definition.definition) {
+                return;
+            }
+            _camera_definition.definition->set_setting("CAM_MODE", value);
+        }
         refresh_params();
     }
 }
@@ -829,33 +1071,127 @@ void CameraImpl::get_mode_timeout_happened()
     }
 }
 
-void CameraImpl::load_definition_file(const std::string &uri)
+void CameraImpl::load_definition_file(const CameraDefinitionCache::Key &key)
+{
+    {
+        std::lock_guard<std::mutex> lock(_definition_download.mutex);
+        if (_definition_download.uri == key.uri) {
+            return;
+        }
+        _definition_download.uri = key.uri;
+    }
+
+    if (!_http_loader) {
+        return;
+    }
+
+    // Reading and parsing the file is left to the loader thread, like the download.
+    HttpLoader *http_loader = _http_loader.get();
+    http_loader->call_async([this, key, http_loader]() {
+        load_cached_definition_file(key, *http_loader);
+    });
+}
+
+void CameraImpl::load_cached_definition_file(const CameraDefinitionCache::Key &key,
+                                             HttpLoader &http_loader)
 {
-    HttpLoader http_loader;
     std::string content;
-    LogInfo() << "Downloading camera definition from: " << uri;
-    if (!http_loader.download_text_sync(uri, content)) {
+    HttpValidators validators {};
+    bool have_cached = _definition_cache.load(key, content, validators);
+    if (have_cached) {
+        if (use_definition_file(content)) {
+            LogInfo() << "Using cached camera definition for " << key.vendor << " " << key.model;
+
+            // A versioned definition doesn't change without a new version.
+            if (key.version != 0) {
+                return;
+            }
+        } else {
+            LogWarn() << "Cached camera definition is invalid, downloading it again.";
+            have_cached = false;
+            validators = HttpValidators {};
+        }
+    }
+
+    LogInfo() << "Downloading camera definition from: " << key.uri;
+    http_loader.download_text_if_modified_async(
+        key.uri, validators,
+        [this, key, have_cached](bool success, bool modified, const std::string & downloaded,
+    const HttpValidators & received) {
+        receive_definition_file(key, have_cached, success, modified, downloaded, received);
+    });
+}
+
+void CameraImpl::receive_definition_file(const CameraDefinitionCache::Key &key, bool have_cached,
+                                         bool success, bool modified,
+                                         const std::string &content,
+                                         const HttpValidators &validators)
+{
+    if (!success) {
+        if (have_cached) {
+            LogWarn() << "Failed to check camera definition, keeping cached one.";
+            return;
+        }
         LogErr() << "Failed to download camera definition.";
+        retry_definition_file(key);
         return;
     }
 
-    _camera_definition.reset(new CameraDefinition());
-    _camera_definition->load_string(content);
+    if (!modified) {
+        // The cached one is up to date.
+        return;
+    }
 
-    refresh_params();
+    // Only a definition which can be used is worth keeping.
+    if (!use_definition_file(content)) {
+        LogErr() << "Failed to parse camera definition"
+                 << (have_cached ? ", keeping cached one." : ".");
+        if (!have_cached) {
+            retry_definition_file(key);
+        }
+        return;
+    }
+    _definition_cache.store(key, content, validators);
 }
 
-bool CameraImpl::get_possible_settings(std::vector<std::string> &settings)
+void CameraImpl::retry_definition_file(const CameraDefinitionCache::Key &key)
 {
-    settings.clear();
+    // Try again with the next camera information.
+    std::lock_guard<std::mutex> lock(_definition_download.mutex);
+    if (_definition_download.uri == key.uri) {
+        _definition_download.uri.clear();
+    }
+}
 
-    if (!_camera_definition) {
-        LogWarn() << "Error: no camera definition available yet";
+bool CameraImpl::use_definition_file(const std::string &content)
+{
+    // Parsed on the calling thread, only the finished definition is swapped in.
+    std::unique_ptr<CameraDefinition> camera_definition(new CameraDefinition());
+    if (!camera_definition->load_string(content)) {
         return false;
     }
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        _camera_definition.definition.swap(camera_definition);
+    }
+
+    refresh_params();
+    return true;
+}
+
+bool CameraImpl::get_possible_settings(std::vector<std::string> &settings)
+{
+    settings.clear();
 
     std::map<std::string, MAVLinkParameters::ParamValue> cd_settings {};
-    _camera_definition->get_possible_settings(cd_settings);
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (!_camera_definition.definition) {
+            LogWarn() << "Error: no camera definition available yet";
+            return false;
+        }
+        _camera_definition.definition->get_possible_settings(cd_settings);
+    }
 
     for (const auto &cd_setting : cd_settings) {
         if (cd_setting.first.compare("CAM_MODE") == 0) {
@@ -874,14 +1210,16 @@ bool CameraImpl::get_possible_options(const std::string &setting_name,
 {
     options.clear();
 
-    if (!_camera_definition) {
-        LogWarn() << "Error: no camera definition available yet";
-        return false;
-    }
-
     std::vector<MAVLinkParameters::ParamValue> values;
-    if (!_camera_definition->get_possible_options(setting_name, values)) {
-        return false;
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (!_camera_definition.definition) {
+            LogWarn() << "Error: no camera definition available yet";
+            return false;
+        }
+        if (!_camera_definition.definition->get_possible_options(setting_name, values)) {
+            return false;
+        }
     }
 
     for (const auto &value : values) {
@@ -897,25 +1235,32 @@ void CameraImpl::set_option_async(const std::string &setting,
                                   const std::string &option,
                                   const Camera::result_callback_t &callback)
 {
-    if (!_camera_definition) {
-        LogWarn() << "Error: no camera defnition available yet.";
-        if (callback) {
-            callback(Camera::Result::ERROR);
+    // We get it first so that we have the type of the param value.
+    MAVLinkParameters::ParamValue value;
+    std::vector<MAVLinkParameters::ParamValue> possible_values;
+    bool has_definition = false;
+    bool has_value = false;
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (_camera_definition.definition) {
+            has_definition = true;
+            has_value = _camera_definition.definition->get_option_value(setting, option, value);
+            if (has_value) {
+                _camera_definition.definition->get_possible_options(setting, possible_values);
+            }
         }
-        return;
     }
 
-    // We get it first so that we have the type of the param value.
-    MAVLinkParameters::ParamValue value;
-    if (!_camera_definition->get_option_value(setting, option, value)) {
+    if (!has_definition) {
+        LogWarn() << "Error: no camera defnition available yet.";
+    }
+    if (!has_value) {
         if (callback) {
             callback(Camera::Result::ERROR);
         }
         return;
     }
 
-    std::vector<MAVLinkParameters::ParamValue> possible_values;
-    _camera_definition->get_possible_options(setting, possible_values);
     bool allowed = false;
     for (const auto &possible_value : possible_values) {
         if (value == possible_value) {
@@ -933,9 +1278,15 @@ void CameraImpl::set_option_async(const std::string &setting,
     _parent->set_param_async(setting, value,
     [this, callback, setting, value](bool success) {
         if (success) {
-            if (this->_camera_definition) {
-
-                _camera_definition->set_setting(setting, value);
+            bool has_definition_now = false;
+            {
+                std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+                if (_camera_definition.definition) {
+                    _camera_definition.definition->set_setting(setting, value);
+                    has_definition_now = true;
+                }
+            }
+            if (has_definition_now) {
                 refresh_params();
             }
             if (callback) {
@@ -947,14 +1298,99 @@ void CameraImpl::set_option_async(const std::string &setting,
             }
         }
     },
-    true);
+    true, _component_id);
 
 }
 
+void CameraImpl::set_options_async(const std::vector<Camera::SettingOption> &options,
+                                   const Camera::result_callback_t &callback)
+{
+    // Each option is set in the definition right away, so the exclusions and
+    // ranges it brings are in place for the options after it.
+    std::map<std::string, MAVLinkParameters::ParamValue> params;
+    bool allowed = true;
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (!_camera_definition.definition) {
+            LogWarn() << "Error: no camera defnition available yet.";
+            allowed = false;
+        }
+        for (auto it = options.begin(); allowed && it != options.end(); ++it) {
+            MAVLinkParameters::ParamValue value;
+            if (!get_possible_option_value(it->setting, it->option, value)) {
+                LogErr() << "Setting " << it->setting << "(" << it->option << ") not allowed";
+                allowed = false;
+                break;
+            }
+            _camera_definition.definition->set_setting(it->setting, value);
+            params[it->setting] = value;
+        }
+    }
+
+    if (!allowed) {
+        if (!params.empty()) {
+            // Back to what the camera has, nothing was sent.
+            invalidate_params();
+            refresh_params();
+        }
+        if (callback) {
+            callback(Camera::Result::ERROR);
+        }
+        return;
+    }
+
+    _parent->set_params_async(params,
+    [this, callback](bool success, const std::vector<std::string> &failed_params) {
+        if (!success) {
+            for (const auto &name : failed_params) {
+                LogWarn() << "Setting " << name << " failed";
+            }
+            invalidate_params();
+        }
+        // Once for all settings, not for each of them.
+        refresh_params();
+        if (callback) {
+            callback(success ? Camera::Result::SUCCESS : Camera::Result::ERROR);
+        }
+    },
+    true, _component_id);
+}
+
+bool CameraImpl::get_possible_option_value(const std::string &setting,
+                                           const std::string &option,
+                                           MAVLinkParameters::ParamValue &value)
+{
+    CameraDefinition &definition = *_camera_definition.definition;
+    const unsigned index = definition.get_setting_index(setting);
+    if (index == CameraDefinition::NO_INDEX || !definition.is_setting_possible(index) ||
+        !definition.get_option_value(setting, option, value)) {
+        return false;
+    }
+
+    for (unsigned i = 0; i < definition.get_num_options(index); ++i) {
+        if (definition.get_option_value(index, i) == value) {
+            return definition.is_option_possible(index, i);
+        }
+    }
+    return false;
+}
+
 void CameraImpl::get_option_async(const std::string &setting,
                                   const Camera::get_option_callback_t &callback)
 {
-    if (!_camera_definition) {
+    MAVLinkParameters::ParamValue value;
+    bool has_definition = false;
+    bool is_cached = false;
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (_camera_definition.definition) {
+            has_definition = true;
+            // We should have this cached and don't need to get the param.
+            is_cached = _camera_definition.definition->get_setting(setting, value);
+        }
+    }
+
+    if (!has_definition) {
         LogWarn() << "Error: no camera defnition available yet.";
         if (callback) {
             callback(Camera::Result::ERROR, "");
@@ -962,9 +1398,7 @@ void CameraImpl::get_option_async(const std::string &setting,
         return;
     }
 
-    MAVLinkParameters::ParamValue value;
-    // We should have this cached and don't need to get the param.
-    if (_camera_definition->get_setting(setting, value)) {
+    if (is_cached) {
         if (callback) {
             callback(Camera::Result::SUCCESS, value.get_string());
         }
@@ -978,11 +1412,12 @@ void CameraImpl::get_option_async(const std::string &setting,
                 return;
             }
             // We need to check again by the time this callback runs
-            if (!this->_camera_definition) {
+            std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+            if (!_camera_definition.definition) {
                 return;
             }
-            this->_camera_definition->set_setting(setting, value);
-        }, true);
+            _camera_definition.definition->set_setting(setting, value);
+        }, true, _component_id);
 
         // At this point it might be a good idea to refresh but it's a bit scary
         // as the stack keeps growing at this point.
@@ -992,59 +1427,78 @@ void CameraImpl::get_option_async(const std::string &setting,
 
 void CameraImpl::refresh_params()
 {
-    if (!_camera_definition) {
-        return;
+    std::vector<std::string> params {};
+    {
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (!_camera_definition.definition ||
+            !_camera_definition.definition->get_unknown_params(params)) {
+            return;
+        }
     }
 
-    std::vector<std::string> params {};
-    if (!_camera_definition->get_unknown_params(params)) {
+    if (params.empty()) {
         return;
     }
 
-    for (const auto &param : params) {
-        std::string param_name = param;
-        _parent->get_param_async(param_name,
-        [param_name, this](bool success, MAVLinkParameters::ParamValue value) {
-            if (!success) {
-                return;
-            }
-            // We need to check again by the time this callback runs
-            if (!this->_camera_definition) {
-                return;
-            }
-            this->_camera_definition->set_setting(param_name, value);
-        }, true);
+    _parent->get_params_ext_async(params,
+    [this](bool success, const std::map<std::string, MAVLinkParameters::ParamValue> &values) {
+        if (!success) {
+            LogWarn() << "Not all camera params could be fetched";
+        }
+        // We need to check again by the time this callback runs
+        std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+        if (!_camera_definition.definition) {
+            return;
+        }
+        for (const auto &value : values) {
+            _camera_definition.definition->set_setting(value.first, value.second);
+        }
+    }, _component_id);
+}
+
+void CameraImpl::receive_param_changed(const std::string &name,
+                                       MAVLinkParameters::ParamValue value)
+{
+    std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+    // Not all params of the camera are settings of its definition.
+    if (!_camera_definition.definition ||
+        _camera_definition.definition->get_setting_index(name) == CameraDefinition::NO_INDEX) {
+        return;
     }
+    _camera_definition.definition->set_setting(name, value);
 }
 
 void CameraImpl::invalidate_params()
 {
-    if (!_camera_definition) {
+    std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+    if (!_camera_definition.definition) {
         return;
     }
 
-    _camera_definition->set_all_params_unknown();
+    _camera_definition.definition->set_all_params_unknown();
 }
 
 bool CameraImpl::get_setting_str(const std::string &setting_name,
                                  std::string &description)
 {
-    if (!_camera_definition) {
+    std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+    if (!_camera_definition.definition) {
         return false;
     }
 
-    return _camera_definition->get_setting_str(setting_name, description);
+    return _camera_definition.definition->get_setting_str(setting_name, description);
 }
 
 bool CameraImpl::get_option_str(const std::string &setting_name,
                                 const std::string &option_name,
                                 std::string &description)
 {
-    if (!_camera_definition) {
+    std::lock_guard<std::mutex> lock(_camera_definition.mutex);
+    if (!_camera_definition.definition) {
         return false;
     }
 
-    return _camera_definition->get_option_str(setting_name, option_name, description);
+    return _camera_definition.definition->get_option_str(setting_name, option_name, description);
 }
 
 } // namespace dronecore
@@ -4,14 +4,21 @@
 #include "camera.h"
 #include "plugin_impl_base.h"
 #include "camera_definition.h"
+#include "camera_definition_cache.h"
+#include "capture_sequence.h"
 #include "mavlink_system.h"
+#include <memory>
+#include <mutex>
+#include <string>
 
 namespace dronecore {
 
+class HttpLoader;
+
 class CameraImpl : public PluginImplBase
 {
 public:
-    CameraImpl(System &system);
+    CameraImpl(System &system, int camera_id = 0);
     ~CameraImpl();
 
     void init() override;
@@ -45,12 +52,20 @@ public:
 
     void capture_info_async(Camera::capture_info_callback_t callback);
 
+    void download_media_async(const std::vector<std::string> &file_urls,
+                              const std::string &local_directory,
+                              Camera::download_media_callback_t callback,
+                              unsigned num_parallel);
+
     void get_status_async(Camera::get_status_callback_t callback);
 
     void set_option_async(const std::string &setting,
                           const std::string &option,
                           const Camera::result_callback_t &callback);
 
+    void set_options_async(const std::vector<Camera::SettingOption> &options,
+                           const Camera::result_callback_t &callback);
+
     void get_option_async(const std::string &setting,
                           const Camera::get_option_callback_t &callback);
 
@@ -72,13 +87,22 @@ private:
         std::mutex mutex {};
         Camera::get_status_callback_t callback {nullptr};
         Camera::Status data {};
+        // The latest broadcast or polled state, and when it came in.
         bool received_camera_capture_status {false};
         bool received_storage_information {false};
+        dl_time_t camera_capture_status_time {};
+        dl_time_t storage_information_time {};
         void *timeout_cookie {nullptr};
     } _status;
 
     static constexpr double DEFAULT_TIMEOUT_S = 3.0;
 
+    // The camera is asked to broadcast its status at this rate, queries are
+    // answered from the latest one. Only once it is older than STATUS_STALE_S
+    // it is polled.
+    static constexpr double STATUS_RATE_HZ = 1.0;
+    static constexpr double STATUS_STALE_S = 3.0;
+
     struct {
         std::mutex mutex {};
         Camera::mode_callback_t callback {nullptr};
@@ -93,8 +117,17 @@ private:
     struct {
         std::mutex mutex {};
         Camera::capture_info_callback_t callback {nullptr};
+        CaptureSequence sequence {};
+        // Requests for lost images not answered yet, the next batch waits for them.
+        unsigned num_requests_pending {0};
+        void *recovery_cookie {nullptr};
     } _capture_info;
 
+    // Lost images are requested again this often, a few at a time, so catching up
+    // doesn't fill the uplink.
+    static constexpr double CAPTURE_RECOVERY_INTERVAL_S = 1.0;
+    static constexpr unsigned CAPTURE_RECOVERY_BATCH = 4;
+
     struct {
         std::mutex mutex {};
         Camera::VideoStreamInfo info;
@@ -129,6 +162,7 @@ private:
     static bool interval_valid(float interval_s);
 
     void process_camera_image_captured(const mavlink_message_t &message);
+    void request_missing_captures();
     void process_storage_information(const mavlink_message_t &message);
     void process_camera_capture_status(const mavlink_message_t &message);
     void process_camera_settings(const mavlink_message_t &message);
@@ -139,13 +173,30 @@ private:
     void receive_camera_capture_status_result(MAVLinkCommands::Result result);
 
     void check_status();
+    // Needs to be called with _status.mutex locked.
+    void mark_stale_status();
 
     void status_timeout_happened();
 
-    void load_definition_file(const std::string &uri);
+    void load_definition_file(const CameraDefinitionCache::Key &key);
+    // These run on the loader thread.
+    void load_cached_definition_file(const CameraDefinitionCache::Key &key,
+                                     HttpLoader &http_loader);
+    void receive_definition_file(const CameraDefinitionCache::Key &key, bool have_cached,
+                                 bool success, bool modified, const std::string &content,
+                                 const HttpValidators &validators);
+    void retry_definition_file(const CameraDefinitionCache::Key &key);
+    // Returns false if the content can't be parsed, the definition in use is kept then.
+    bool use_definition_file(const std::string &content);
 
     void refresh_params();
+    // Looks the option up among the ones currently possible for the setting.
+    // Needs to be called with _camera_definition.mutex locked.
+    bool get_possible_option_value(const std::string &setting, const std::string &option,
+                                   MAVLinkParameters::ParamValue &value);
     void invalidate_params();
+    // Settings changed on the camera, e.g. by another ground station.
+    void receive_param_changed(const std::string &name, MAVLinkParameters::ParamValue value);
 
     // Utility methods for convenience
     MAVLinkCommands::CommandLong make_command_take_photo(float interval_s, float no_of_photos);
@@ -156,6 +207,7 @@ private:
     MAVLinkCommands::CommandLong make_command_request_camera_settings();
     MAVLinkCommands::CommandLong make_command_request_camera_capture_status();
     MAVLinkCommands::CommandLong make_command_request_storage_info();
+    MAVLinkCommands::CommandLong make_command_request_image_captured(int index);
 
     MAVLinkCommands::CommandLong make_command_start_video(float capture_status_rate_hz);
     MAVLinkCommands::CommandLong make_command_stop_video();
@@ -169,7 +221,41 @@ private:
     MAVLinkCommands::CommandLong make_command_request_video_stream_info();
 
 
-    std::unique_ptr<CameraDefinition> _camera_definition {};
+    // Cameras have the component IDs from MAV_COMP_ID_CAMERA onwards, messages
+    // of the other ones are ignored.
+    const uint8_t _component_id;
+
+    // Replaced on the loader thread while messages and user calls use it, and it
+    // isn't thread-safe itself, so it is only ever used with the mutex locked.
+    struct {
+        std::mutex mutex {};
+        std::unique_ptr<CameraDefinition> definition {};
+    } _camera_definition {};
+    MAVLinkParameters::param_subscription_handle_t _param_subscription = 0;
+
+    // Downloads the definition file on its own thread, so that handling messages
+    // doesn't wait for the HTTP round trip.
+    std::unique_ptr<HttpLoader> _http_loader {};
+
+    CameraDefinitionCache _definition_cache {CameraDefinitionCache::default_directory()};
+
+    struct {
+        std::mutex mutex {};
+        // The definition being downloaded or loaded, it is not downloaded again
+        // every time the camera information comes in.
+        std::string uri {};
+    } _definition_download {};
+
+    struct {
+        std::mutex mutex {};
+        // Separate from the definition download, so that it doesn't wait behind
+        // hundreds of images.
+        std::shared_ptr<HttpLoader> loader {};
+        unsigned num_transfers {0};
+        unsigned num_pending {0};
+    } _media_download {};
+
+    static std::string get_media_file_name(const std::string &file_url);
 };
 
 
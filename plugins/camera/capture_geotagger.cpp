@@ -0,0 +1,155 @@
+#include "capture_geotagger.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstring>
+
+namespace dronecore {
+
+constexpr size_t CaptureGeotagger::FILE_URL_LEN;
+
+CaptureGeotagger::CaptureGeotagger(pose_lookup_t pose_lookup, sink_t sink, size_t batch_size) :
+    _pose_lookup(pose_lookup),
+    _sink(sink),
+    _records(std::max(batch_size, size_t(1)))
+{}
+
+CaptureGeotagger::~CaptureGeotagger()
+{
+    flush();
+}
+
+void CaptureGeotagger::add(const Camera::CaptureInfo &capture_info)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Record &record = _records[_num_records];
+    record.time_utc_us = capture_info.time_utc_us;
+    record.index = capture_info.index;
+    record.success = capture_info.success;
+    record.camera_position = capture_info.position;
+    record.camera_quaternion = capture_info.quaternion;
+
+    const int64_t steady_time_us = int64_t(capture_info.time_utc_us) +
+                                   get_utc_to_steady_offset_us();
+    record.has_vehicle_pose = (steady_time_us > 0 && _pose_lookup &&
+                               _pose_lookup(uint64_t(steady_time_us),
+                                            record.vehicle_position,
+                                            record.vehicle_quaternion));
+    if (!record.has_vehicle_pose) {
+        record.vehicle_position = Camera::CaptureInfo::Position {};
+        record.vehicle_quaternion = Camera::CaptureInfo::Quaternion {};
+    }
+
+    const size_t url_len = std::min(capture_info.file_url.size(), sizeof(record.file_url) - 1);
+    memcpy(record.file_url, capture_info.file_url.c_str(), url_len);
+    record.file_url[url_len] = '\0';
+
+    if (++_num_records == _records.size()) {
+        flush_locked();
+    }
+}
+
+void CaptureGeotagger::flush()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    flush_locked();
+}
+
+void CaptureGeotagger::flush_locked()
+{
+    if (_num_records == 0) {
+        return;
+    }
+    if (_sink) {
+        _sink(_records.data(), _num_records);
+    }
+    _num_records = 0;
+}
+
+void CaptureGeotagger::set_utc_to_steady_offset_us(int64_t offset_us)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _have_offset = true;
+    _offset_us = offset_us;
+}
+
+int64_t CaptureGeotagger::get_utc_to_steady_offset_us() const
+{
+    if (_have_offset) {
+        return _offset_us;
+    }
+
+    // The captures come in right after they are taken, so the clocks read now
+    // give the offset well enough.
+    const int64_t steady_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now().time_since_epoch()).count();
+    const int64_t utc_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::system_clock::now().time_since_epoch()).count();
+    return steady_us - utc_us;
+}
+
+CaptureGeotagger::sink_t CaptureGeotagger::csv_file_sink(std::FILE *file)
+{
+    if (std::fprintf(file, "%s\n", csv_header()) < 0) {
+        LogErr() << "Could not write capture CSV header";
+    }
+
+    return [file](const Record * records, size_t num_records) {
+        char line[1024];
+        for (size_t i = 0; i < num_records; ++i) {
+            const int len = format_csv(records[i], line, sizeof(line) - 1);
+            if (len < 0 || size_t(len) >= sizeof(line) - 1) {
+                LogErr() << "Could not format capture " << records[i].index;
+                continue;
+            }
+            line[len] = '\n';
+            if (std::fwrite(line, 1, size_t(len) + 1, file) != size_t(len) + 1) {
+                LogErr() << "Could not write capture " << records[i].index;
+                return;
+            }
+        }
+        std::fflush(file);
+    };
+}
+
+const char *CaptureGeotagger::csv_header()
+{
+    return "time_utc_us,index,success,"
+           "camera_latitude_deg,camera_longitude_deg,"
+           "camera_absolute_altitude_m,camera_relative_altitude_m,"
+           "camera_q_w,camera_q_x,camera_q_y,camera_q_z,"
+           "has_vehicle_pose,"
+           "vehicle_latitude_deg,vehicle_longitude_deg,"
+           "vehicle_absolute_altitude_m,vehicle_relative_altitude_m,"
+           "vehicle_q_w,vehicle_q_x,vehicle_q_y,vehicle_q_z,"
+           "file_url";
+}
+
+int CaptureGeotagger::format_csv(const Record &record, char *buffer, size_t buffer_len)
+{
+    return std::snprintf(buffer, buffer_len,
+                         "%" PRIu64 ",%d,%d,"
+                         "%.7f,%.7f,%.3f,%.3f,%.6f,%.6f,%.6f,%.6f,"
+                         "%d,"
+                         "%.7f,%.7f,%.3f,%.3f,%.6f,%.6f,%.6f,%.6f,"
+                         "%s",
+                         record.time_utc_us, record.index, record.success ? 1 : 0,
+                         record.camera_position.latitude_deg,
+                         record.camera_position.longitude_deg,
+                         double(record.camera_position.absolute_altitude_m),
+                         double(record.camera_position.relative_altitude_m),
+                         double(record.camera_quaternion.w), double(record.camera_quaternion.x),
+                         double(record.camera_quaternion.y), double(record.camera_quaternion.z),
+                         record.has_vehicle_pose ? 1 : 0,
+                         record.vehicle_position.latitude_deg,
+                         record.vehicle_position.longitude_deg,
+                         double(record.vehicle_position.absolute_altitude_m),
+                         double(record.vehicle_position.relative_altitude_m),
+                         double(record.vehicle_quaternion.w), double(record.vehicle_quaternion.x),
+                         double(record.vehicle_quaternion.y), double(record.vehicle_quaternion.z),
+                         record.file_url);
+}
+
+} // namespace dronecore
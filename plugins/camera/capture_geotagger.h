@@ -0,0 +1,155 @@
+#pragma once
+
+#include "camera.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+/**
+ * @brief Joins captured images with the vehicle pose at capture time.
+ *
+ * The pose is looked up in a history of positions and attitudes (e.g. the one of
+ * Telemetry, see Telemetry::set_history_capacity()) at the capture time, and the
+ * joined records are handed to a sink in batches. The records are of fixed size
+ * and the batch buffer is allocated once, so nothing is allocated per image.
+ *
+ * For mapping missions, feed it from Camera::capture_info_async():
+ *
+ * ```
+ * CaptureGeotagger geotagger(
+ * [&telemetry](uint64_t time_us, Camera::CaptureInfo::Position &position,
+ *              Camera::CaptureInfo::Quaternion &quaternion) {
+ *     Telemetry::Position p;
+ *     Telemetry::Quaternion q;
+ *     if (!telemetry.position_at(time_us, p) || !telemetry.attitude_quaternion_at(time_us, q)) {
+ *         return false;
+ *     }
+ *     position = {p.latitude_deg, p.longitude_deg, p.absolute_altitude_m, p.relative_altitude_m};
+ *     quaternion = {q.w, q.x, q.y, q.z};
+ *     return true;
+ * }, CaptureGeotagger::csv_file_sink(file), 64);
+ *
+ * camera.capture_info_async([&geotagger](Camera::CaptureInfo info) { geotagger.add(info); });
+ * ```
+ */
+class CaptureGeotagger
+{
+public:
+    /**
+     * @brief Longest file URL kept, as in CAMERA_IMAGE_CAPTURED, with 0-termination.
+     */
+    static constexpr size_t FILE_URL_LEN = 205 + 1;
+
+    /**
+     * @brief One captured image joined with the vehicle pose.
+     */
+    struct Record {
+        uint64_t time_utc_us; /**< @brief Capture time in UTC (since UNIX epoch) in microseconds. */
+        int index; /**< @brief Zero-based index of this image since armed. */
+        bool success; /**< @brief True if capture was successful. */
+        Camera::CaptureInfo::Position camera_position; /**< @brief Position reported by the camera. */
+        Camera::CaptureInfo::Quaternion camera_quaternion; /**< @brief Attitude reported by the camera. */
+        bool has_vehicle_pose; /**< @brief False if the capture time is not covered by the history. */
+        Camera::CaptureInfo::Position vehicle_position; /**< @brief Vehicle position at capture time. */
+        Camera::CaptureInfo::Quaternion vehicle_quaternion; /**< @brief Vehicle attitude at capture time. */
+        char file_url[FILE_URL_LEN]; /**< @brief Download URL, cut to FILE_URL_LEN - 1 characters. */
+    };
+
+    /**
+     * @brief Looks up the vehicle pose at a time of `std::chrono::steady_clock` in microseconds.
+     *
+     * Returns false if the time is not covered.
+     */
+    typedef std::function<bool(uint64_t time_us,
+                               Camera::CaptureInfo::Position &position,
+                               Camera::CaptureInfo::Quaternion &quaternion)> pose_lookup_t;
+
+    /**
+     * @brief Gets a batch of records, valid only during the call.
+     *
+     * The records lie next to each other in memory, so they can be written out or
+     * copied into a message (e.g. a gRPC stream) in one go. The sink is called with
+     * the geotagger locked, so it must not call back into it.
+     */
+    typedef std::function<void(const Record *records, size_t num_records)> sink_t;
+
+    /**
+     * @brief Constructor.
+     *
+     * @param pose_lookup Gets the vehicle pose at capture time.
+     * @param sink Gets the records once batch_size have been added or on flush().
+     * @param batch_size Number of records buffered, at least 1.
+     */
+    CaptureGeotagger(pose_lookup_t pose_lookup, sink_t sink, size_t batch_size);
+
+    /**
+     * @brief Destructor, hands the remaining records to the sink.
+     */
+    ~CaptureGeotagger();
+
+    /**
+     * @brief Add a captured image.
+     */
+    void add(const Camera::CaptureInfo &capture_info);
+
+    /**
+     * @brief Hand the buffered records to the sink now.
+     */
+    void flush();
+
+    /**
+     * @brief Set the offset from UTC to `std::chrono::steady_clock`.
+     *
+     * By default it is taken from the system clock when adding an image. A better
+     * one can be set if the clock of the vehicle is known to differ.
+     *
+     * @param offset_us Steady time minus UTC in microseconds.
+     */
+    void set_utc_to_steady_offset_us(int64_t offset_us);
+
+    /**
+     * @brief Sink writing one CSV line per record to a file.
+     *
+     * The header line is written first. The file is not closed.
+     */
+    static sink_t csv_file_sink(std::FILE *file);
+
+    /**
+     * @brief Format a record as CSV line, without newline.
+     *
+     * @return Length of the line, as snprintf.
+     */
+    static int format_csv(const Record &record, char *buffer, size_t buffer_len);
+
+    /**
+     * @brief Header line for format_csv(), without newline.
+     */
+    static const char *csv_header();
+
+    // Non-copyable
+    CaptureGeotagger(const CaptureGeotagger &) = delete;
+    const CaptureGeotagger &operator=(const CaptureGeotagger &) = delete;
+
+private:
+    // Need to be called with _mutex locked.
+    void flush_locked();
+    int64_t get_utc_to_steady_offset_us() const;
+
+    pose_lookup_t _pose_lookup;
+    sink_t _sink;
+
+    std::mutex _mutex {};
+    // Allocated once, only the first _num_records are used.
+    std::vector<Record> _records;
+    size_t _num_records {0};
+
+    bool _have_offset {false};
+    int64_t _offset_us {0};
+};
+
+} // namespace dronecore
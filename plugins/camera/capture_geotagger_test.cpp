@@ -0,0 +1,117 @@
+#include "capture_geotagger.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+static Camera::CaptureInfo make_capture_info(int index, uint64_t time_utc_us)
+{
+    Camera::CaptureInfo capture_info {};
+    capture_info.position = {47.0, 8.0, 500.0f, 20.0f};
+    capture_info.quaternion = {1.0f, 0.0f, 0.0f, 0.0f};
+    capture_info.time_utc_us = time_utc_us;
+    capture_info.success = true;
+    capture_info.index = index;
+    capture_info.file_url = "http://10.1.1.1/DCIM/" + std::to_string(index) + ".jpg";
+    return capture_info;
+}
+
+// Only covers steady times from 1000 to 2000, latitude goes with the time.
+static bool lookup_pose(uint64_t time_us, Camera::CaptureInfo::Position &position,
+                        Camera::CaptureInfo::Quaternion &quaternion)
+{
+    if (time_us < 1000 || time_us > 2000) {
+        return false;
+    }
+    position = {double(time_us) / 1000.0, 9.0, 600.0f, 30.0f};
+    quaternion = {0.0f, 1.0f, 0.0f, 0.0f};
+    return true;
+}
+
+TEST(CaptureGeotagger, JoinsPoseAndBatches)
+{
+    std::vector<CaptureGeotagger::Record> received {};
+    std::vector<size_t> batch_sizes {};
+
+    {
+        CaptureGeotagger geotagger(lookup_pose,
+        [&](const CaptureGeotagger::Record * records, size_t num_records) {
+            received.insert(received.end(), records, records + num_records);
+            batch_sizes.push_back(num_records);
+        }, 2);
+        // UTC 11000 is steady 1000.
+        geotagger.set_utc_to_steady_offset_us(-10000);
+
+        geotagger.add(make_capture_info(0, 11000));
+        EXPECT_TRUE(received.empty());
+        geotagger.add(make_capture_info(1, 11500));
+        EXPECT_EQ(received.size(), 2);
+
+        // Not covered by the history.
+        geotagger.add(make_capture_info(2, 15000));
+        // The rest is handed out on destruction.
+    }
+
+    ASSERT_EQ(received.size(), 3);
+    ASSERT_EQ(batch_sizes.size(), 2);
+    EXPECT_EQ(batch_sizes[0], 2);
+    EXPECT_EQ(batch_sizes[1], 1);
+
+    EXPECT_EQ(received[0].index, 0);
+    EXPECT_TRUE(received[0].has_vehicle_pose);
+    EXPECT_DOUBLE_EQ(received[0].vehicle_position.latitude_deg, 1.0);
+    EXPECT_DOUBLE_EQ(received[0].camera_position.latitude_deg, 47.0);
+    EXPECT_FLOAT_EQ(received[0].vehicle_quaternion.x, 1.0f);
+    EXPECT_STREQ(received[0].file_url, "http://10.1.1.1/DCIM/0.jpg");
+
+    EXPECT_TRUE(received[1].has_vehicle_pose);
+    EXPECT_DOUBLE_EQ(received[1].vehicle_position.latitude_deg, 1.5);
+
+    EXPECT_EQ(received[2].index, 2);
+    EXPECT_FALSE(received[2].has_vehicle_pose);
+    EXPECT_DOUBLE_EQ(received[2].vehicle_position.latitude_deg, 0.0);
+}
+
+TEST(CaptureGeotagger, CutsLongFileUrl)
+{
+    std::string file_url {};
+
+    CaptureGeotagger geotagger(nullptr,
+    [&](const CaptureGeotagger::Record * records, size_t) {
+        file_url = records[0].file_url;
+    }, 1);
+
+    Camera::CaptureInfo capture_info = make_capture_info(0, 1);
+    capture_info.file_url = std::string(300, 'a');
+    geotagger.add(capture_info);
+
+    EXPECT_EQ(file_url, std::string(CaptureGeotagger::FILE_URL_LEN - 1, 'a'));
+}
+
+TEST(CaptureGeotagger, WritesCsv)
+{
+    std::FILE *file = std::tmpfile();
+    ASSERT_NE(file, nullptr);
+
+    {
+        CaptureGeotagger geotagger(lookup_pose, CaptureGeotagger::csv_file_sink(file), 8);
+        geotagger.set_utc_to_steady_offset_us(0);
+        geotagger.add(make_capture_info(3, 1000));
+    }
+
+    std::rewind(file);
+    char line[1024];
+    ASSERT_NE(std::fgets(line, sizeof(line), file), nullptr);
+    EXPECT_EQ(std::string(line), std::string(CaptureGeotagger::csv_header()) + "\n");
+
+    ASSERT_NE(std::fgets(line, sizeof(line), file), nullptr);
+    EXPECT_EQ(std::string(line),
+              "1000,3,1,47.0000000,8.0000000,500.000,20.000,1.000000,0.000000,0.000000,0.000000,"
+              "1,1.0000000,9.0000000,600.000,30.000,0.000000,1.000000,0.000000,0.000000,"
+              "http://10.1.1.1/DCIM/3.jpg\n");
+
+    EXPECT_EQ(std::fgets(line, sizeof(line), file), nullptr);
+    std::fclose(file);
+}
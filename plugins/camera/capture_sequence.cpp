@@ -0,0 +1,115 @@
+#include "capture_sequence.h"
+
+namespace dronecore {
+
+constexpr int CaptureSequence::WINDOW;
+constexpr unsigned CaptureSequence::MAX_REQUESTS;
+
+CaptureSequence::CaptureSequence() :
+    _received(WINDOW / 64, 0),
+    _time_boot_ms(WINDOW, 0),
+    _num_requests(WINDOW, 0)
+{
+}
+
+bool CaptureSequence::add(int index, uint32_t time_boot_ms)
+{
+    if (index < 0) {
+        // Not counted, nothing to keep track of.
+        return true;
+    }
+
+    const bool in_window = _started && index < _next && _next - index <= WINDOW;
+    if (in_window && is_received(index)) {
+        if (_time_boot_ms[slot(index)] == time_boot_ms) {
+            return false;
+        }
+        // Another image with the same index, the camera started over.
+        reset();
+    } else if (_started && !in_window && index < _next) {
+        // Too far back to be one of ours.
+        reset();
+    } else if (_started && index >= _next + WINDOW) {
+        // Everything in between is lost, no point in requesting it.
+        reset();
+    }
+
+    if (!_started) {
+        // Images from before we started listening are not requested.
+        _started = true;
+        _first = index;
+        _next = index;
+    }
+
+    while (_next <= index) {
+        clear(_next);
+        ++_next;
+    }
+    if (_first < _next - WINDOW) {
+        _first = _next - WINDOW;
+    }
+
+    set_received(index, time_boot_ms);
+    advance_first();
+    return true;
+}
+
+void CaptureSequence::take_missing(unsigned max_num, std::vector<int> &indices)
+{
+    indices.clear();
+
+    for (int index = _first; index < _next && indices.size() < max_num; ++index) {
+        if (is_received(index) || _num_requests[slot(index)] >= MAX_REQUESTS) {
+            continue;
+        }
+        ++_num_requests[slot(index)];
+        indices.push_back(index);
+    }
+
+    advance_first();
+}
+
+unsigned CaptureSequence::num_missing() const
+{
+    unsigned num = 0;
+    for (int index = _first; index < _next; ++index) {
+        if (!is_received(index) && _num_requests[slot(index)] < MAX_REQUESTS) {
+            ++num;
+        }
+    }
+    return num;
+}
+
+void CaptureSequence::reset()
+{
+    _started = false;
+    _first = 0;
+    _next = 0;
+}
+
+bool CaptureSequence::is_received(int index) const
+{
+    return (_received[slot(index) / 64] & (uint64_t(1) << (slot(index) % 64))) != 0;
+}
+
+void CaptureSequence::set_received(int index, uint32_t time_boot_ms)
+{
+    _received[slot(index) / 64] |= uint64_t(1) << (slot(index) % 64);
+    _time_boot_ms[slot(index)] = time_boot_ms;
+}
+
+void CaptureSequence::clear(int index)
+{
+    _received[slot(index) / 64] &= ~(uint64_t(1) << (slot(index) % 64));
+    _num_requests[slot(index)] = 0;
+}
+
+void CaptureSequence::advance_first()
+{
+    while (_first < _next &&
+           (is_received(_first) || _num_requests[slot(_first)] >= MAX_REQUESTS)) {
+        ++_first;
+    }
+}
+
+} // namespace dronecore
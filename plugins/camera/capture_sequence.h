@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace dronecore {
+
+// Keeps track of which image indices of CAMERA_IMAGE_CAPTURED have come in, so the
+// ones lost on the link can be requested again.
+//
+// Only the last WINDOW indices are tracked, one bit each. Images missing before
+// the newest one received are handed out by take_missing() to be requested, each
+// up to MAX_REQUESTS times, then they are given up on.
+class CaptureSequence
+{
+public:
+    CaptureSequence();
+    ~CaptureSequence() = default;
+
+    static constexpr int WINDOW = 1024;
+    static constexpr unsigned MAX_REQUESTS = 3;
+
+    // Returns false if the image came in already, e.g. a requested copy after a late
+    // original. The capture time tells it apart from the same index of a new
+    // sequence, after the camera started counting from 0 again.
+    bool add(int index, uint32_t time_boot_ms);
+
+    // The oldest images missing, up to max_num of them.
+    void take_missing(unsigned max_num, std::vector<int> &indices);
+
+    unsigned num_missing() const;
+
+    void reset();
+
+private:
+    static unsigned slot(int index) { return unsigned(index) % unsigned(WINDOW); }
+    bool is_received(int index) const;
+    void set_received(int index, uint32_t time_boot_ms);
+    void clear(int index);
+    // Past the images received or given up on.
+    void advance_first();
+
+    bool _started {false};
+    // Everything before this is received or given up on.
+    int _first {0};
+    // One past the newest image received.
+    int _next {0};
+
+    std::vector<uint64_t> _received;
+    std::vector<uint32_t> _time_boot_ms;
+    std::vector<uint8_t> _num_requests;
+};
+
+} // namespace dronecore
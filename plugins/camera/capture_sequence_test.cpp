@@ -0,0 +1,99 @@
+#include "capture_sequence.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(CaptureSequence, FindsGaps)
+{
+    CaptureSequence sequence;
+    std::vector<int> missing;
+
+    EXPECT_TRUE(sequence.add(3, 300));
+    EXPECT_TRUE(sequence.add(4, 400));
+    // From before the first one, they are not missing.
+    sequence.take_missing(10, missing);
+    EXPECT_TRUE(missing.empty());
+
+    EXPECT_TRUE(sequence.add(7, 700));
+    EXPECT_TRUE(sequence.add(9, 900));
+    EXPECT_EQ(sequence.num_missing(), 3u);
+
+    sequence.take_missing(2, missing);
+    EXPECT_EQ(missing, std::vector<int>({5, 6}));
+
+    // Requested ones come in.
+    EXPECT_TRUE(sequence.add(5, 500));
+    EXPECT_TRUE(sequence.add(6, 600));
+    sequence.take_missing(10, missing);
+    EXPECT_EQ(missing, std::vector<int>({8}));
+}
+
+TEST(CaptureSequence, GivesUpAfterMaxRequests)
+{
+    CaptureSequence sequence;
+    std::vector<int> missing;
+
+    EXPECT_TRUE(sequence.add(0, 0));
+    EXPECT_TRUE(sequence.add(2, 200));
+
+    for (unsigned i = 0; i < CaptureSequence::MAX_REQUESTS; ++i) {
+        sequence.take_missing(10, missing);
+        EXPECT_EQ(missing, std::vector<int>({1}));
+    }
+    sequence.take_missing(10, missing);
+    EXPECT_TRUE(missing.empty());
+    EXPECT_EQ(sequence.num_missing(), 0u);
+
+    // Still taken if it comes in after all.
+    EXPECT_TRUE(sequence.add(1, 100));
+    EXPECT_FALSE(sequence.add(1, 100));
+}
+
+TEST(CaptureSequence, DropsDuplicates)
+{
+    CaptureSequence sequence;
+
+    EXPECT_TRUE(sequence.add(0, 0));
+    EXPECT_TRUE(sequence.add(1, 100));
+    EXPECT_FALSE(sequence.add(1, 100));
+    EXPECT_FALSE(sequence.add(0, 0));
+}
+
+TEST(CaptureSequence, StartsOverWithNewSequence)
+{
+    CaptureSequence sequence;
+    std::vector<int> missing;
+
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(sequence.add(i, uint32_t(i * 100)));
+    }
+
+    // Armed again, the indices start from 0 with later capture times.
+    EXPECT_TRUE(sequence.add(0, 5000));
+    EXPECT_TRUE(sequence.add(2, 5200));
+    sequence.take_missing(10, missing);
+    EXPECT_EQ(missing, std::vector<int>({1}));
+}
+
+TEST(CaptureSequence, OnlyTracksWindow)
+{
+    CaptureSequence sequence;
+    std::vector<int> missing;
+
+    EXPECT_TRUE(sequence.add(0, 0));
+    EXPECT_TRUE(sequence.add(CaptureSequence::WINDOW + 9, 1));
+    sequence.take_missing(1000, missing);
+    EXPECT_TRUE(missing.empty());
+
+    EXPECT_TRUE(sequence.add(CaptureSequence::WINDOW + 20, 2));
+    EXPECT_EQ(sequence.num_missing(), 10u);
+
+    // Getting as far behind as the window, the oldest ones are given up.
+    EXPECT_TRUE(sequence.add(2 * CaptureSequence::WINDOW + 15, 3));
+    sequence.take_missing(10000, missing);
+    ASSERT_FALSE(missing.empty());
+    EXPECT_EQ(missing.front(), CaptureSequence::WINDOW + 16);
+    // All but the one received in the window up to the newest one.
+    EXPECT_EQ(missing.size(), size_t(CaptureSequence::WINDOW - 2));
+}
@@ -0,0 +1,462 @@
+#include "dronecore.h"
+#include "curl_wrapper.h"
+#include <atomic>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#ifndef WINDOWS
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+using namespace dronecore;
+
+#ifndef WINDOWS
+namespace {
+
+// Answers HTTP requests on localhost, one per connection, with whatever respond()
+// returns for the request head.
+class LocalHttpServer
+{
+public:
+    typedef std::function<std::string(const std::string &request)> respond_t;
+
+    explicit LocalHttpServer(const respond_t &respond) :
+        _respond(respond)
+    {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t addr_len = sizeof(addr);
+        if (bind(_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) != 0 ||
+            listen(_fd, 4) != 0 ||
+            getsockname(_fd, reinterpret_cast<struct sockaddr *>(&addr), &addr_len) != 0) {
+            return;
+        }
+        _port = ntohs(addr.sin_port);
+        _thread = std::thread(&LocalHttpServer::serve, this);
+    }
+
+    ~LocalHttpServer()
+    {
+        if (_thread.joinable()) {
+            // Wakes up accept() with a connection of its own.
+            _should_exit = true;
+            const int wake_fd = socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in addr {};
+            addr.sin_family = AF_INET;
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            addr.sin_port = htons(_port);
+            connect(wake_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+            _thread.join();
+            close(wake_fd);
+        }
+        close(_fd);
+    }
+
+    std::string url(const std::string &path) const
+    {
+        return "http://127.0.0.1:" + std::to_string(_port) + path;
+    }
+
+    std::vector<std::string> requests()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _requests;
+    }
+
+private:
+    void serve()
+    {
+        while (true) {
+            const int connection = accept(_fd, nullptr, nullptr);
+            if (connection < 0) {
+                return;
+            }
+            if (_should_exit) {
+                close(connection);
+                return;
+            }
+
+            std::string request;
+            char buffer[1024];
+            while (request.find("\r\n\r\n") == std::string::npos) {
+                const ssize_t len = recv(connection, buffer, sizeof(buffer), 0);
+                if (len <= 0) {
+                    break;
+                }
+                request.append(buffer, static_cast<size_t>(len));
+            }
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _requests.push_back(request);
+            }
+
+            // The client may hang up early, which must not raise SIGPIPE.
+            int send_flags = 0;
+#if defined(MSG_NOSIGNAL)
+            send_flags = MSG_NOSIGNAL;
+#elif defined(SO_NOSIGPIPE)
+            const int one = 1;
+            setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+            const std::string response = _respond(request);
+            send(connection, response.c_str(), response.size(), send_flags);
+            close(connection);
+        }
+    }
+
+    respond_t _respond;
+    int _fd {-1};
+    uint16_t _port {0};
+    std::thread _thread {};
+    std::atomic<bool> _should_exit {false};
+    std::mutex _mutex {};
+    std::vector<std::string> _requests {};
+};
+
+} // namespace
+#endif
+
+class CurlTest : public testing::Test
+{
+protected:
+    std::string _file_url_existing_http;
+    std::string _file_url_existing_https;
+    std::string _file_url_not_existing;
+    std::string _local_path;
+
+    virtual void SetUp()
+    {
+        clean();
+        _file_url_existing_http =
+            "http://s3.eu-central-1.amazonaws.com/404f358a-48b5-4aaf-b5fd-adc84ffb0f31/dronecore_test_file";
+        _file_url_existing_https =
+            "https://s3.eu-central-1.amazonaws.com/404f358a-48b5-4aaf-b5fd-adc84ffb0f31/dronecore_test_file";
+        _file_url_not_existing = "https://notexisting.file/does-really-not-exist";
+        _local_path = "testfile.txt";
+    }
+
+    virtual void TearDown()
+    {
+        clean();
+    }
+
+    void clean()
+    {
+        remove(_local_path.c_str());
+        remove((_local_path + ".part").c_str());
+    }
+
+    void write_file(const std::string &path, const std::string &content)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << content;
+    }
+
+    std::string read_file(const std::string &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    bool check_file_exists(const std::string &file_path)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        std::ifstream infile(file_path.c_str());
+        return infile.good();
+    }
+};
+
+TEST_F(CurlTest, Curl_DownloadText_HTTP_Success)
+{
+    std::string content;
+
+    CurlWrapper curl_wrapper;
+    bool success = curl_wrapper.download_text(_file_url_existing_http, content);
+
+    EXPECT_EQ(success, true);
+    EXPECT_EQ(content, "content of this file\n");
+}
+
+TEST_F(CurlTest, Curl_DownloadText_HTTPS_Success)
+{
+    std::string content;
+
+    CurlWrapper curl_wrapper;
+    bool success = curl_wrapper.download_text(_file_url_existing_https, content);
+
+    EXPECT_EQ(success, true);
+    EXPECT_EQ(content, "content of this file\n");
+}
+
+TEST_F(CurlTest, Curl_DownloadText_FileNotFound)
+{
+    std::string content = "content gets cleared if download fails";
+
+    CurlWrapper curl_wrapper;
+    bool success = curl_wrapper.download_text(_file_url_not_existing, content);
+
+    EXPECT_EQ(success, false);
+    EXPECT_EQ(content, "");
+}
+
+TEST_F(CurlTest, Curl_DownloadFile_WithoutProgressFeedback_Success)
+{
+    CurlWrapper curl_wrapper;
+
+    bool success = curl_wrapper.download_file_to_path(_file_url_existing_https, _local_path, nullptr);
+    EXPECT_EQ(success, true);
+
+    bool file_exists = check_file_exists(_local_path);
+    EXPECT_EQ(file_exists, true);
+}
+
+TEST_F(CurlTest, Curl_DownloadFile_WithoutProgressFeedback_FileNotFound)
+{
+    CurlWrapper curl_wrapper;
+
+    bool success = curl_wrapper.download_file_to_path(_file_url_not_existing, _local_path, nullptr);
+    EXPECT_EQ(success, false);
+
+    bool file_exists = check_file_exists(_local_path);
+    EXPECT_EQ(file_exists, false);
+}
+
+TEST_F(CurlTest, Curl_DownloadFile_ProgressFeedback_Success)
+{
+    int last_progress;
+    Status last_status;
+    CURLcode last_curl_code;
+
+    auto progress = [&last_progress, &last_status, &last_curl_code]
+    (int got_progress, Status status, CURLcode curl_code) -> int {
+        last_progress = got_progress;
+        last_status = status;
+        last_curl_code = curl_code;
+        return 0;
+    };
+
+    CurlWrapper curl_wrapper;
+
+    bool success = curl_wrapper.download_file_to_path(_file_url_existing_https, _local_path, progress);
+    EXPECT_EQ(success, true);
+    EXPECT_EQ(last_progress, 100);
+    EXPECT_EQ(last_status, Status::Finished);
+    EXPECT_EQ(last_curl_code, CURLcode::CURLE_OK);
+
+    bool file_exists = check_file_exists(_local_path);
+    EXPECT_EQ(file_exists, true);
+}
+
+TEST_F(CurlTest, Curl_DownloadFile_ProgressFeedback_COULDNT_RESOLVE_HOST)
+{
+    int last_progress;
+    Status last_status;
+    CURLcode last_curl_code;
+
+    auto progress = [&last_progress, &last_status, &last_curl_code]
+    (int got_progress, Status status, CURLcode curl_code) -> int {
+        last_progress = got_progress;
+        last_status = status;
+        last_curl_code = curl_code;
+        return 0;
+    };
+
+    CurlWrapper curl_wrapper;
+
+    bool success = curl_wrapper.download_file_to_path(_file_url_not_existing, _local_path, progress);
+    EXPECT_EQ(success, false);
+    EXPECT_EQ(last_progress, 0);
+    EXPECT_EQ(last_status, Status::Error);
+    EXPECT_EQ(last_curl_code, CURLcode::CURLE_COULDNT_RESOLVE_HOST);
+
+    bool file_exists = check_file_exists(_local_path);
+    EXPECT_EQ(file_exists, false);
+}
+
+#ifndef WINDOWS
+TEST_F(CurlTest, Curl_DownloadTextIfModified_NotModified)
+{
+    const std::string body = "<mavlinkcamera/>";
+    LocalHttpServer server([&body](const std::string & request) -> std::string {
+        if (request.find("If-None-Match: \"1\"\r\n") != std::string::npos)
+        {
+            return "HTTP/1.1 304 Not Modified\r\nConnection: close\r\n\r\n";
+        }
+        return "HTTP/1.1 200 OK\r\nETag: \"1\"\r\n"
+               "Last-Modified: Wed, 21 Oct 2015 07:28:00 GMT\r\n"
+               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+               "Connection: close\r\n\r\n" + body;
+    });
+
+    CurlWrapper curl_wrapper;
+    HttpValidators validators {};
+    std::string content;
+    bool modified = false;
+
+    // Without validators it is downloaded.
+    EXPECT_TRUE(curl_wrapper.download_text_if_modified(server.url("/camera.xml"), validators,
+                                                       content, modified));
+    EXPECT_TRUE(modified);
+    EXPECT_EQ(content, body);
+    EXPECT_EQ(validators.etag, "\"1\"");
+    EXPECT_EQ(validators.last_modified, "Wed, 21 Oct 2015 07:28:00 GMT");
+
+    // With them the server says it's unchanged, and they are kept.
+    EXPECT_TRUE(curl_wrapper.download_text_if_modified(server.url("/camera.xml"), validators,
+                                                       content, modified));
+    EXPECT_FALSE(modified);
+    EXPECT_EQ(content, "");
+    EXPECT_EQ(validators.etag, "\"1\"");
+    EXPECT_EQ(validators.last_modified, "Wed, 21 Oct 2015 07:28:00 GMT");
+
+    const auto requests = server.requests();
+    ASSERT_EQ(requests.size(), 2);
+    EXPECT_EQ(requests[0].find("If-None-Match:"), std::string::npos);
+    EXPECT_NE(requests[1].find("If-Modified-Since: Wed, 21 Oct 2015 07:28:00 GMT\r\n"),
+              std::string::npos);
+}
+
+TEST_F(CurlTest, Curl_DownloadChunks)
+{
+    const std::string body(100000, 'x');
+    LocalHttpServer server([&body](const std::string &) -> std::string {
+        return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n"
+               "Connection: close\r\n\r\n" + body;
+    });
+
+    CurlWrapper curl_wrapper;
+    std::string received;
+    unsigned num_chunks = 0;
+    EXPECT_TRUE(curl_wrapper.download_chunks(server.url("/camera.xml"),
+    [&received, &num_chunks](const char *data, size_t len) {
+        received.append(data, len);
+        ++num_chunks;
+        return true;
+    }));
+    EXPECT_EQ(received, body);
+    EXPECT_GT(num_chunks, 1u);
+
+    // Stops once the consumer has seen enough.
+    received.clear();
+    EXPECT_FALSE(curl_wrapper.download_chunks(server.url("/camera.xml"),
+    [&received](const char *data, size_t len) {
+        received.append(data, len);
+        return false;
+    }));
+    EXPECT_GT(received.size(), 0u);
+    EXPECT_LT(received.size(), body.size());
+}
+
+TEST_F(CurlTest, Curl_DownloadChunks_Error)
+{
+    LocalHttpServer server([](const std::string &) -> std::string {
+        return "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\n"
+               "Connection: close\r\n\r\nnot found";
+    });
+
+    CurlWrapper curl_wrapper;
+    std::string received;
+    EXPECT_FALSE(curl_wrapper.download_chunks(server.url("/camera.xml"),
+    [&received](const char *data, size_t len) {
+        received.append(data, len);
+        return true;
+    }));
+    // The error page is not handed on as content.
+    EXPECT_EQ(received, "");
+}
+
+TEST_F(CurlTest, Curl_DownloadFileResumable_ContinuesPart)
+{
+    const std::string body = "0123456789";
+    LocalHttpServer server([&body](const std::string & request) -> std::string {
+        if (request.find("Range: bytes=5-\r\n") != std::string::npos)
+        {
+            return "HTTP/1.1 206 Partial Content\r\nContent-Range: bytes 5-9/10\r\n"
+                   "Content-Length: 5\r\nConnection: close\r\n\r\n" + body.substr(5);
+        }
+        return "HTTP/1.1 200 OK\r\nContent-Length: 10\r\nConnection: close\r\n\r\n" + body;
+    });
+
+    write_file(_local_path + ".part", "01234");
+
+    CurlWrapper curl_wrapper;
+    EXPECT_TRUE(curl_wrapper.download_file_to_path_resumable(server.url("/video.mp4"),
+                                                             _local_path, nullptr));
+    EXPECT_EQ(read_file(_local_path), body);
+    EXPECT_FALSE(check_file_exists(_local_path + ".part"));
+
+    const auto requests = server.requests();
+    ASSERT_EQ(requests.size(), 1);
+    EXPECT_NE(requests[0].find("Range: bytes=5-\r\n"), std::string::npos);
+}
+
+TEST_F(CurlTest, Curl_DownloadFileResumable_StartsOverIfRangeIgnored)
+{
+    const std::string body = "0123456789";
+    LocalHttpServer server([&body](const std::string &) -> std::string {
+        return "HTTP/1.1 200 OK\r\nContent-Length: 10\r\nConnection: close\r\n\r\n" + body;
+    });
+
+    write_file(_local_path + ".part", "abcde");
+
+    CurlWrapper curl_wrapper;
+    EXPECT_TRUE(curl_wrapper.download_file_to_path_resumable(server.url("/video.mp4"),
+                                                             _local_path, nullptr));
+    EXPECT_EQ(read_file(_local_path), body);
+}
+
+TEST_F(CurlTest, Curl_DownloadFileResumable_KeepsPartOnError)
+{
+    LocalHttpServer server([](const std::string &) -> std::string {
+        return "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\n"
+               "Connection: close\r\n\r\n";
+    });
+
+    write_file(_local_path + ".part", "01234");
+
+    Status last_status = Status::Idle;
+    auto progress = [&last_status](int, Status status, CURLcode) -> int {
+        last_status = status;
+        return 0;
+    };
+
+    CurlWrapper curl_wrapper;
+    EXPECT_FALSE(curl_wrapper.download_file_to_path_resumable(server.url("/video.mp4"),
+                                                              _local_path, progress));
+    EXPECT_EQ(last_status, Status::Error);
+    EXPECT_FALSE(check_file_exists(_local_path));
+    // To continue from there next time.
+    EXPECT_EQ(read_file(_local_path + ".part"), "01234");
+}
+
+TEST_F(CurlTest, Curl_DownloadTextIfModified_Error)
+{
+    LocalHttpServer server([](const std::string &) -> std::string {
+        return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+    });
+
+    CurlWrapper curl_wrapper;
+    HttpValidators validators {};
+    validators.etag = "\"1\"";
+    std::string content;
+    bool modified = true;
+
+    EXPECT_FALSE(curl_wrapper.download_text_if_modified(server.url("/camera.xml"), validators,
+                                                        content, modified));
+    EXPECT_FALSE(modified);
+    EXPECT_EQ(validators.etag, "\"1\"");
+}
+#endif
@@ -0,0 +1,513 @@
+#include "global_include.h"
+#include "log.h"
+#include "curl_wrapper.h"
+#include <sstream>
+#include <iostream>
+#include <stdio.h>
+#include <fstream>
+#include <string>
+
+namespace dronecore {
+
+
+CurlShare::CurlShare() :
+    _share(curl_share_init())
+{
+    if (_share == nullptr) {
+        return;
+    }
+    curl_share_setopt(_share, CURLSHOPT_LOCKFUNC, lock);
+    curl_share_setopt(_share, CURLSHOPT_UNLOCKFUNC, unlock);
+    curl_share_setopt(_share, CURLSHOPT_USERDATA, this);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // Not the connection cache: libcurl doesn't support sharing it between
+    // handles used from different threads. Each handle keeps its own open
+    // connections between transfers instead.
+}
+
+CurlShare::~CurlShare()
+{
+    // All handles using it need to be cleaned up before.
+    if (_share != nullptr) {
+        curl_share_cleanup(_share);
+    }
+}
+
+void CurlShare::lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+    UNUSED(handle);
+    UNUSED(access);
+    reinterpret_cast<CurlShare *>(userptr)->_mutexes[data].lock();
+}
+
+void CurlShare::unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+    UNUSED(handle);
+    reinterpret_cast<CurlShare *>(userptr)->_mutexes[data].unlock();
+}
+
+CurlWrapper::CurlWrapper(const std::shared_ptr<CurlShare> &share) :
+    _share(share)
+{
+}
+
+CurlWrapper::~CurlWrapper()
+{
+    // The handle goes before the share it uses.
+    _curl.reset();
+}
+
+std::shared_ptr<CURL> CurlWrapper::get_handle()
+{
+    if (_curl == nullptr) {
+        _curl = std::shared_ptr<CURL>(curl_easy_init(), curl_easy_cleanup);
+        if (_curl == nullptr) {
+            return _curl;
+        }
+    } else {
+        // Forgets the options of the last transfer but keeps the connections.
+        curl_easy_reset(_curl.get());
+    }
+
+    // Reset clears these too.
+    if (_share != nullptr && _share->get() != nullptr) {
+        curl_easy_setopt(_curl.get(), CURLOPT_SHARE, _share->get());
+    }
+    // Keeps idle connections from being dropped by NATs between transfers.
+    curl_easy_setopt(_curl.get(), CURLOPT_TCP_KEEPALIVE, 1L);
+    return _curl;
+}
+
+// converts curl output to string
+// taken from https://stackoverflow.com/questions/9786150/save-curl-content-result-into-a-string-in-c
+static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    reinterpret_cast<std::string *>(userp)->append(reinterpret_cast<char *>(contents), size * nmemb);
+    return size * nmemb;
+}
+
+bool CurlWrapper::download_text(const std::string &url, std::string &content)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto curl = get_handle();
+    std::string readBuffer;
+
+    if (nullptr != curl) {
+        CURLcode res;
+
+        curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, write_callback);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &readBuffer);
+        res = curl_easy_perform(curl.get());
+        content = readBuffer;
+
+        if (res == CURLcode::CURLE_OK) {
+            return true;
+        } else {
+            LogErr() << "Error while downloading text, curl error code: " << curl_easy_strerror(res);
+            return false;
+        }
+    } else {
+        LogErr() << "Error: cannot start uploading because of curl initialization error. ";
+        return false;
+    }
+}
+
+// Picks the validators out of the response headers.
+static size_t header_callback(char *buffer, size_t size, size_t nitems, void *userp)
+{
+    HttpValidators &validators = *reinterpret_cast<HttpValidators *>(userp);
+    const std::string header(buffer, size * nitems);
+
+    const size_t colon = header.find(':');
+    if (colon == std::string::npos) {
+        return size * nitems;
+    }
+
+    std::string name = header.substr(0, colon);
+    for (auto &c : name) {
+        c = char(tolower(c));
+    }
+
+    const size_t value_begin = header.find_first_not_of(" \t", colon + 1);
+    const size_t value_end = header.find_last_not_of(" \t\r\n");
+    if (value_begin == std::string::npos || value_end < value_begin) {
+        return size * nitems;
+    }
+    const std::string value = header.substr(value_begin, value_end - value_begin + 1);
+
+    if (name == "etag") {
+        validators.etag = value;
+    } else if (name == "last-modified") {
+        validators.last_modified = value;
+    }
+    return size * nitems;
+}
+
+bool CurlWrapper::download_text_if_modified(const std::string &url, HttpValidators &validators,
+                                            std::string &content, bool &modified)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto curl = get_handle();
+    content.clear();
+    modified = false;
+
+    if (nullptr == curl) {
+        LogErr() << "Error: cannot start downloading because of curl initialization error. ";
+        return false;
+    }
+
+    struct curl_slist *chunk = NULL;
+    if (!validators.etag.empty()) {
+        chunk = curl_slist_append(chunk, ("If-None-Match: " + validators.etag).c_str());
+    }
+    if (!validators.last_modified.empty()) {
+        chunk = curl_slist_append(chunk,
+                                  ("If-Modified-Since: " + validators.last_modified).c_str());
+    }
+
+    HttpValidators received {};
+    std::string readBuffer;
+
+    curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+    curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+    curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, chunk);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &readBuffer);
+    curl_easy_setopt(curl.get(), CURLOPT_HEADERFUNCTION, header_callback);
+    curl_easy_setopt(curl.get(), CURLOPT_HEADERDATA, &received);
+    CURLcode res = curl_easy_perform(curl.get());
+
+    curl_slist_free_all(chunk);
+
+    if (res != CURLcode::CURLE_OK) {
+        LogErr() << "Error while downloading text, curl error code: " << curl_easy_strerror(res);
+        return false;
+    }
+
+    long response_code = 0;
+    curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+
+    if (response_code == 304) {
+        return true;
+    }
+
+    // Other schemes than http don't have a response code.
+    if (response_code != 0 && (response_code < 200 || response_code >= 300)) {
+        LogErr() << "Error while downloading text, HTTP response code: " << response_code;
+        return false;
+    }
+
+    content = readBuffer;
+    modified = true;
+    validators = received;
+    return true;
+}
+
+static int upload_progress_update(void *p, double dltotal, double dlnow, double ultotal,
+                                  double ulnow)
+{
+    UNUSED(dltotal);
+    UNUSED(dlnow);
+
+    struct dl_up_progress *myp = reinterpret_cast<struct dl_up_progress *>(p);
+
+    if (myp->progress_callback == nullptr) {
+        return 0;
+    }
+
+    if (ultotal == 0 || ulnow == 0) {
+        return myp->progress_callback(0, Status::Idle, CURLcode::CURLE_OK);
+    }
+
+    int percentage = static_cast<int>(100.0 / ultotal * ulnow);
+
+    if (percentage > myp->progress_in_percentage) {
+        myp->progress_in_percentage = percentage;
+        return myp->progress_callback(percentage, Status::Uploading, CURLcode::CURLE_OK);
+    }
+
+    return 0;
+}
+
+size_t get_file_size(const std::string &path)
+{
+    std::streampos begin, end;
+    std::ifstream myfile(path.c_str(), std::ios::binary);
+    begin = myfile.tellg();
+    myfile.seekg(0, std::ios::end);
+    end = myfile.tellg();
+    myfile.close();
+    return ((end - begin) > 0) ? (end - begin) : 0;
+}
+
+template <typename T>
+std::string to_string(T value)
+{
+    std::ostringstream os;
+    os << value;
+    return os.str();
+}
+
+bool CurlWrapper::upload_file(const std::string &url, const std::string &path,
+                              const progress_callback_t &progress_callback)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto curl = get_handle();
+    CURLcode res;
+
+    if (nullptr != curl) {
+        struct dl_up_progress prog;
+        prog.progress_callback = progress_callback;
+
+        curl_httppost *post = NULL;
+        curl_httppost *last = NULL;
+
+        struct curl_slist *chunk = NULL;
+
+        // avoid sending 'Expect: 100-Continue' header, required by some server implementations
+        chunk = curl_slist_append(chunk, "Expect:");
+
+        // disable chunked upload
+        chunk = curl_slist_append(chunk, "Content-Encoding: ");
+
+        // to allow efficient file upload, we need to add the file size to the header
+        std::string filesize_header = "File-Size: " + to_string(get_file_size(path));
+        chunk = curl_slist_append(chunk, filesize_header.c_str());
+
+        curl_formadd(&post, &last,
+                     CURLFORM_COPYNAME, "file",
+                     CURLFORM_FILE, path.c_str(),
+                     CURLFORM_END);
+
+        curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSFUNCTION, upload_progress_update);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSDATA, &prog);
+        curl_easy_setopt(curl.get(), CURLOPT_VERBOSE, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_HTTPHEADER, chunk);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_HTTPPOST, post);
+        curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
+
+        res = curl_easy_perform(curl.get());
+
+        curl_slist_free_all(chunk);
+        curl_formfree(post);
+
+        if (res == CURLcode::CURLE_OK) {
+            if (nullptr != progress_callback) {
+                progress_callback(100, Status::Finished, CURLcode::CURLE_OK);
+            }
+            return true;
+        } else {
+            if (nullptr != progress_callback) {
+                progress_callback(0, Status::Error, res);
+            }
+            LogErr() << "Error while uploading file, curl error code: " << curl_easy_strerror(res);
+            return false;
+        }
+    } else {
+        LogErr() << "Error: cannot start uploading because of curl initialization error.";
+        return false;
+    }
+}
+
+static int download_progress_update(void *p, double dltotal, double dlnow, double ultotal,
+                                    double ulnow)
+{
+    UNUSED(ultotal);
+    UNUSED(ulnow);
+
+    struct dl_up_progress *myp = reinterpret_cast<struct dl_up_progress *>(p);
+
+    if (myp->progress_callback == nullptr) {
+        return 0;
+    }
+
+    if (dltotal == 0 || dlnow == 0) {
+        return myp->progress_callback(0, Status::Idle, CURLcode::CURLE_OK);
+    }
+
+    int percentage = static_cast<int>(100 / dltotal * dlnow);
+
+    if (percentage > myp->progress_in_percentage) {
+        myp->progress_in_percentage = percentage;
+        return myp->progress_callback(percentage, Status::Downloading, CURLcode::CURLE_OK);
+    }
+
+    return 0;
+}
+
+static size_t chunk_write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    const auto &chunk_callback = *reinterpret_cast<const chunk_callback_t *>(userp);
+    if (!chunk_callback(reinterpret_cast<const char *>(contents), size * nmemb)) {
+        // Anything other than what was passed makes curl abort.
+        return 0;
+    }
+    return size * nmemb;
+}
+
+bool CurlWrapper::download_chunks(const std::string &url, const chunk_callback_t &chunk_callback)
+{
+    if (!chunk_callback) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto curl = get_handle();
+
+    if (nullptr != curl) {
+        curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, chunk_write_callback);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, &chunk_callback);
+        const CURLcode res = curl_easy_perform(curl.get());
+
+        if (res == CURLcode::CURLE_OK) {
+            return true;
+        } else {
+            LogErr() << "Error while downloading, curl error code: " << curl_easy_strerror(res);
+            return false;
+        }
+    } else {
+        LogErr() << "Error: cannot start downloading because of curl initialization error.";
+        return false;
+    }
+}
+
+bool CurlWrapper::download_file_to_path(const std::string &url, const std::string &path, const
+                                        progress_callback_t &progress_callback)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto curl = get_handle();
+    FILE *fp;
+
+    if (nullptr != curl) {
+        CURLcode res;
+        struct dl_up_progress prog;
+        prog.progress_callback = progress_callback;
+
+        fp = fopen(path.c_str(), "wb");
+        curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSFUNCTION, download_progress_update);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSDATA, &prog);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, NULL);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, fp);
+        curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
+        res = curl_easy_perform(curl.get());
+        fclose(fp);
+
+        if (res == CURLcode::CURLE_OK) {
+            if (nullptr != progress_callback) {
+                progress_callback(100, Status::Finished, res);
+            }
+            return true;
+        } else {
+            if (nullptr != progress_callback) {
+                progress_callback(0, Status::Error, res);
+            }
+            remove(path.c_str());
+            LogErr() << "Error while downloading file, curl error code: " << curl_easy_strerror(res);
+            return false;
+        }
+    } else {
+        LogErr() << "Error: cannot start downloading file because of curl initialization error. ";
+        return false;
+    }
+}
+
+static size_t file_write_callback(void *contents, size_t size, size_t nmemb, void *userp)
+{
+    return fwrite(contents, size, nmemb, reinterpret_cast<FILE *>(userp)) * size;
+}
+
+bool CurlWrapper::download_file_to_path_resumable(const std::string &url,
+                                                  const std::string &path,
+                                                  const progress_callback_t &progress_callback)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const std::string part_path = path + ".part";
+    CURLcode res = CURLcode::CURLE_OK;
+    long response_code = 0;
+
+    // Once more from the start if the server can't send the rest.
+    for (unsigned attempt = 0; attempt < 2; ++attempt) {
+        auto curl = get_handle();
+
+        if (nullptr == curl) {
+            LogErr() << "Error: cannot start downloading file because of curl "
+                     << "initialization error. ";
+            return false;
+        }
+
+        FILE *fp = fopen(part_path.c_str(), "ab");
+        if (fp == nullptr) {
+            LogErr() << "Error: cannot open " << part_path;
+            return false;
+        }
+        fseek(fp, 0, SEEK_END);
+        const curl_off_t resume_from = ftell(fp);
+
+        struct dl_up_progress prog;
+        prog.progress_callback = progress_callback;
+
+        curl_easy_setopt(curl.get(), CURLOPT_CONNECTTIMEOUT, 5L);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSFUNCTION, download_progress_update);
+        curl_easy_setopt(curl.get(), CURLOPT_PROGRESSDATA, &prog);
+        curl_easy_setopt(curl.get(), CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEFUNCTION, file_write_callback);
+        curl_easy_setopt(curl.get(), CURLOPT_WRITEDATA, fp);
+        curl_easy_setopt(curl.get(), CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl.get(), CURLOPT_FAILONERROR, 1L);
+        if (resume_from > 0) {
+            curl_easy_setopt(curl.get(), CURLOPT_RESUME_FROM_LARGE, resume_from);
+        }
+        res = curl_easy_perform(curl.get());
+
+        fclose(fp);
+
+        response_code = 0;
+        curl_easy_getinfo(curl.get(), CURLINFO_RESPONSE_CODE, &response_code);
+
+        // The server ignored the range and would send the whole file, curl stops
+        // before anything is written then.
+        const bool range_ignored = (res == CURLcode::CURLE_RANGE_ERROR && resume_from > 0);
+        if (!range_ignored) {
+            break;
+        }
+        remove(part_path.c_str());
+    }
+
+    if (res != CURLcode::CURLE_OK) {
+        if (response_code == 416) {
+            // Nothing sensible to resume from, start over next time.
+            remove(part_path.c_str());
+        }
+        if (nullptr != progress_callback) {
+            progress_callback(0, Status::Error, res);
+        }
+        LogErr() << "Error while downloading file, curl error code: " << curl_easy_strerror(res);
+        return false;
+    }
+
+    if (rename(part_path.c_str(), path.c_str()) != 0) {
+        if (nullptr != progress_callback) {
+            progress_callback(0, Status::Error, res);
+        }
+        LogErr() << "Error: cannot move " << part_path << " to " << path;
+        return false;
+    }
+
+    if (nullptr != progress_callback) {
+        progress_callback(100, Status::Finished, res);
+    }
+    return true;
+}
+
+} // namespace dronecore
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include "curl_include.h"
+#include "curl_wrapper_types.h"
+
+#ifdef TESTING
+#include <gmock/gmock.h>
+using namespace testing;
+#endif // TESTING
+
+namespace dronecore {
+
+class ICurlWrapper
+{
+public:
+    virtual bool download_text(const std::string &url, std::string &content) = 0;
+    // Sends the validators along and updates them from the response. If the server says
+    // nothing changed, this succeeds with modified set to false and content left empty.
+    virtual bool download_text_if_modified(const std::string &url, HttpValidators &validators,
+                                           std::string &content, bool &modified) = 0;
+    // The body is handed on without being buffered. Fails if the consumer aborts.
+    virtual bool download_chunks(const std::string &url,
+                                 const chunk_callback_t &chunk_callback) = 0;
+    virtual bool download_file_to_path(const std::string &url, const std::string &path,
+                                       const progress_callback_t &progress_callback) = 0;
+    // Downloads to path + ".part" first, which is kept if the download fails, and
+    // continues from where it stopped the next time.
+    virtual bool download_file_to_path_resumable(const std::string &url, const std::string &path,
+                                                 const progress_callback_t &progress_callback) = 0;
+    virtual bool upload_file(const std::string &url, const std::string &path, const
+                             progress_callback_t &progress_callback) = 0;
+
+    virtual ~ICurlWrapper() {}
+};
+
+// Shared by several CurlWrappers, e.g. those of an HttpLoader, so that their
+// transfers share DNS lookups and TLS sessions.
+class CurlShare
+{
+public:
+    CurlShare();
+    ~CurlShare();
+
+    CURLSH *get() const { return _share; }
+
+    // Non-copyable
+    CurlShare(const CurlShare &) = delete;
+    const CurlShare &operator=(const CurlShare &) = delete;
+
+private:
+    static void lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr);
+    static void unlock(CURL *handle, curl_lock_data data, void *userptr);
+
+    std::mutex _mutexes[CURL_LOCK_DATA_LAST] {};
+    CURLSH *_share = nullptr;
+};
+
+class CurlWrapper : public ICurlWrapper
+{
+public:
+    explicit CurlWrapper(const std::shared_ptr<CurlShare> &share = nullptr);
+    ~CurlWrapper();
+
+    // ICurlWrapper
+    bool download_text(const std::string &url, std::string &content) override;
+    bool download_text_if_modified(const std::string &url, HttpValidators &validators,
+                                   std::string &content, bool &modified) override;
+    bool download_chunks(const std::string &url, const chunk_callback_t &chunk_callback) override;
+    bool download_file_to_path(const std::string &url, const std::string &path,
+                               const progress_callback_t &progress_callback) override;
+    bool download_file_to_path_resumable(const std::string &url, const std::string &path,
+                                         const progress_callback_t &progress_callback) override;
+    bool upload_file(const std::string &url, const std::string &path,
+                     const progress_callback_t &progress_callback) override;
+
+    // Non-copyable
+    CurlWrapper(const CurlWrapper &) = delete;
+    const CurlWrapper &operator=(const CurlWrapper &) = delete;
+
+private:
+    // The same handle is used for all transfers, so connections to the same
+    // server are kept open and reused. Need to be called with _mutex locked.
+    std::shared_ptr<CURL> get_handle();
+
+    std::mutex _mutex {};
+    std::shared_ptr<CURL> _curl {};
+    std::shared_ptr<CurlShare> _share {};
+};
+
+#ifdef TESTING
+class CurlWrapperMock : public ICurlWrapper
+{
+public:
+    MOCK_METHOD2(download_text, bool(const std::string &url, std::string &content));
+    MOCK_METHOD4(download_text_if_modified, bool(const std::string &url,
+                                                 HttpValidators &validators,
+                                                 std::string &content, bool &modified));
+    MOCK_METHOD2(download_chunks, bool(const std::string &url,
+                                       const chunk_callback_t &chunk_callback));
+    MOCK_METHOD3(download_file_to_path, bool(const std::string &url, const std::string &path,
+                                             const progress_callback_t &progress_callback));
+    MOCK_METHOD3(download_file_to_path_resumable, bool(const std::string &url,
+                                                       const std::string &path,
+                                                       const progress_callback_t &progress_callback));
+    MOCK_METHOD3(upload_file, bool(const std::string &url, const std::string &path, const
+                                   progress_callback_t &progress_callback));
+};
+#endif // TESTING
+
+} // namespace dronecore
@@ -1,6 +1,7 @@
 #pragma once
 #include "curl_include.h"
 #include <functional>
+#include <string>
 
 namespace dronecore {
 
@@ -14,6 +15,16 @@ enum class Status {
 
 typedef std::function<int(int progress, Status status, CURLcode curl_code)> progress_callback_t;
 
+// Gets the body of a download piece by piece as it arrives, returning false
+// aborts the download.
+typedef std::function<bool(const char *data, size_t len)> chunk_callback_t;
+
+// What a server told us about a download, to ask later whether it changed.
+struct HttpValidators {
+    std::string etag;
+    std::string last_modified;
+};
+
 struct dl_up_progress {
     int progress_in_percentage = 0;
     progress_callback_t progress_callback;
@@ -0,0 +1,245 @@
+#include "http_loader.h"
+#include "curl_wrapper.h"
+#include "thread_setup.h"
+
+namespace dronecore {
+
+
+HttpLoader::HttpLoader(const std::shared_ptr<ICurlWrapper> &curl_wrapper,
+                       unsigned num_transfers)
+    : _curl_wrapper(curl_wrapper)
+{
+    // The wrapper is shared by all threads.
+    _transfer_curl_wrappers.assign(num_transfers > 0 ? num_transfers : 1, curl_wrapper);
+    start();
+}
+
+HttpLoader::HttpLoader(unsigned num_transfers) :
+    _curl_share(std::make_shared<CurlShare>())
+{
+    _curl_wrapper = std::make_shared<CurlWrapper>(_curl_share);
+    _transfer_curl_wrappers.push_back(_curl_wrapper);
+    for (unsigned i = 1; i < num_transfers; ++i) {
+        _transfer_curl_wrappers.push_back(std::make_shared<CurlWrapper>(_curl_share));
+    }
+    start();
+}
+
+HttpLoader::~HttpLoader()
+{
+    stop();
+}
+
+void HttpLoader::start()
+{
+    _should_exit = false;
+    for (const auto &curl_wrapper : _transfer_curl_wrappers) {
+        _work_threads.push_back(new std::thread(work_thread, this, curl_wrapper));
+    }
+}
+
+void HttpLoader::stop()
+{
+    _should_exit = true;
+    _work_queue.stop();
+    for (auto work_thread : _work_threads) {
+        work_thread->join();
+        delete work_thread;
+    }
+    _work_threads.clear();
+}
+
+bool HttpLoader::download_sync(const std::string &url, const std::string &local_path)
+{
+    auto work_item = std::make_shared<DownloadItem>(url, local_path, nullptr);
+    bool success = do_download(work_item, _curl_wrapper);
+    return success;
+}
+
+void HttpLoader::download_async(const std::string &url, const std::string &local_path,
+                                const progress_callback_t &progress_callback,
+                                bool resume)
+{
+    auto work_item = std::make_shared<DownloadItem>(url, local_path, progress_callback, resume);
+    _work_queue.enqueue(work_item);
+}
+
+bool HttpLoader::upload_sync(const std::string &target_url, const std::string &local_path)
+{
+    auto work_item = std::make_shared<UploadItem>(target_url, local_path, nullptr);
+    bool success = do_upload(work_item, _curl_wrapper);
+    return success;
+}
+
+void HttpLoader::upload_async(const std::string &target_url, const std::string &local_path,
+                              const progress_callback_t &progress_callback)
+{
+    auto work_item = std::make_shared<UploadItem>(target_url, local_path, progress_callback);
+    _work_queue.enqueue(work_item);
+}
+
+void HttpLoader::call_async(const std::function<void()> &func)
+{
+    auto work_item = std::make_shared<CallItem>(func);
+    _work_queue.enqueue(work_item);
+}
+
+void HttpLoader::work_thread(HttpLoader *self, std::shared_ptr<ICurlWrapper> curl_wrapper)
+{
+    setup_thread(ThreadRole::Background, "http");
+
+    while (!self->_should_exit) {
+        auto item = self->_work_queue.dequeue();
+        if (item == nullptr || curl_wrapper == nullptr) {
+            continue;
+        }
+        do_item(item, curl_wrapper);
+    }
+}
+
+void HttpLoader::do_item(const std::shared_ptr<WorkItem> &item,
+                         const std::shared_ptr<ICurlWrapper> &curl_wrapper)
+{
+    auto download_item = std::dynamic_pointer_cast<DownloadItem>(item);
+    if (nullptr != download_item) {
+        do_download(download_item, curl_wrapper);
+        return;
+    }
+
+    auto download_text_item = std::dynamic_pointer_cast<DownloadTextItem>(item);
+    if (nullptr != download_text_item) {
+        do_download_text(download_text_item, curl_wrapper);
+        return;
+    }
+
+    auto download_text_if_modified_item =
+        std::dynamic_pointer_cast<DownloadTextIfModifiedItem>(item);
+    if (nullptr != download_text_if_modified_item) {
+        do_download_text_if_modified(download_text_if_modified_item, curl_wrapper);
+        return;
+    }
+
+    auto download_chunks_item = std::dynamic_pointer_cast<DownloadChunksItem>(item);
+    if (nullptr != download_chunks_item) {
+        do_download_chunks(download_chunks_item, curl_wrapper);
+        return;
+    }
+
+    auto upload_item = std::dynamic_pointer_cast<UploadItem>(item);
+    if (nullptr != upload_item) {
+        do_upload(upload_item, curl_wrapper);
+        return;
+    }
+
+    auto call_item = std::dynamic_pointer_cast<CallItem>(item);
+    if (nullptr != call_item) {
+        if (call_item->get_func()) {
+            call_item->get_func()();
+        }
+        return;
+    }
+}
+
+bool HttpLoader::do_download(const std::shared_ptr<DownloadItem> &item,
+                             const std::shared_ptr<ICurlWrapper> &curl_wrapper)
+{
+    if (item->get_resume()) {
+        return curl_wrapper->download_file_to_path_resumable(item->get_url(),
+                                                             item->get_local_path(),
+                                                             item->get_progress_callback());
+    }
+    bool success = curl_wrapper->download_file_to_path(item->get_url(), item->get_local_path(),
+                                                       item->get_progress_callback());
+    return success;
+}
+
+bool HttpLoader::do_download_text(const std::shared_ptr<DownloadTextItem> &item,
+                                  const std::shared_ptr<ICurlWrapper> &curl_wrapper)
+{
+    std::string content;
+    bool success = curl_wrapper->download_text(item->get_url(), content);
+
+    const auto callback = item->get_callback();
+    if (callback) {
+        callback(success, content);
+    }
+    return success;
+}
+
+bool HttpLoader::do_download_text_if_modified(const std::shared_ptr<DownloadTextIfModifiedItem>
+                                              &item,
+                                              const std::shared_ptr<ICurlWrapper> &curl_wrapper)
+{
+    HttpValidators validators = item->get_validators();
+    std::string content;
+    bool modified = false;
+    bool success = curl_wrapper->download_text_if_modified(item->get_url(), validators, content,
+                                                           modified);
+
+    const auto callback = item->get_callback();
+    if (callback) {
+        callback(success, modified, content, validators);
+    }
+    return success;
+}
+
+bool HttpLoader::do_download_chunks(const std::shared_ptr<DownloadChunksItem> &item,
+                                    const std::shared_ptr<ICurlWrapper> &curl_wrapper)
+{
+    bool success = curl_wrapper->download_chunks(item->get_url(), item->get_chunk_callback());
+
+    const auto callback = item->get_callback();
+    if (callback) {
+        callback(success);
+    }
+    return success;
+}
+
+bool HttpLoader::do_upload(const std::shared_ptr<UploadItem> &item,
+                           const std::shared_ptr<ICurlWrapper> &curl_wrapper)
+{
+    bool success = curl_wrapper->upload_file(item->get_target_url(), item->get_local_path(),
+                                             item->get_progress_callback());
+    return success;
+}
+
+bool HttpLoader::download_text_sync(const std::string &url, std::string &content)
+{
+    bool success = _curl_wrapper->download_text(url, content);
+    return success;
+}
+
+void HttpLoader::download_text_async(const std::string &url,
+                                     const download_text_callback_t &callback)
+{
+    auto work_item = std::make_shared<DownloadTextItem>(url, callback);
+    _work_queue.enqueue(work_item);
+}
+
+void HttpLoader::download_text_if_modified_async(const std::string &url,
+                                                 const HttpValidators &validators,
+                                                 const download_text_if_modified_callback_t
+                                                 &callback)
+{
+    auto work_item = std::make_shared<DownloadTextIfModifiedItem>(url, validators, callback);
+    _work_queue.enqueue(work_item);
+}
+
+bool HttpLoader::download_chunks_sync(const std::string &url,
+                                      const chunk_callback_t &chunk_callback)
+{
+    bool success = _curl_wrapper->download_chunks(url, chunk_callback);
+    return success;
+}
+
+void HttpLoader::download_chunks_async(const std::string &url,
+                                       const chunk_callback_t &chunk_callback,
+                                       const download_chunks_callback_t &callback)
+{
+    auto work_item = std::make_shared<DownloadChunksItem>(url, chunk_callback, callback);
+    _work_queue.enqueue(work_item);
+}
+
+} // namespace dronecore
+
+
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <string>
+#include "safe_queue.h"
+#include "curl_wrapper.h"
+
+namespace dronecore {
+
+class ICurlWrapper;
+
+class HttpLoader
+{
+public:
+    // All transfers go through the given wrapper, e.g. a mock in the tests.
+    explicit HttpLoader(const std::shared_ptr<ICurlWrapper> &curl_wrapper,
+                        unsigned num_transfers = 1);
+
+    // The async work is done by num_transfers threads. Each keeps its handle
+    // and its connections, and all share their DNS lookups and TLS sessions.
+    explicit HttpLoader(unsigned num_transfers = 1);
+    ~HttpLoader();
+
+    void start();
+    void stop();
+
+    bool download_sync(const std::string &url, const std::string &local_path);
+    bool download_text_sync(const std::string &url, std::string &content);
+
+    typedef std::function<void(bool success, const std::string &content)>
+    download_text_callback_t;
+    // The callback is called on the worker thread once the download is done.
+    void download_text_async(const std::string &url, const download_text_callback_t &callback);
+
+    // With modified false, the content the validators were received with is still valid.
+    typedef std::function<void(bool success, bool modified, const std::string &content,
+                               const HttpValidators &validators)>
+    download_text_if_modified_callback_t;
+    void download_text_if_modified_async(const std::string &url,
+                                         const HttpValidators &validators,
+                                         const download_text_if_modified_callback_t &callback);
+    // The chunks are handed to chunk_callback as they arrive, on the worker thread for
+    // the async call, so that the body can be processed without buffering all of it.
+    bool download_chunks_sync(const std::string &url, const chunk_callback_t &chunk_callback);
+    typedef std::function<void(bool success)> download_chunks_callback_t;
+    void download_chunks_async(const std::string &url, const chunk_callback_t &chunk_callback,
+                               const download_chunks_callback_t &callback);
+
+    // With resume, an interrupted download is continued when it is tried again.
+    void download_async(const std::string &url, const std::string &local_path,
+                        const progress_callback_t &progress_callback = nullptr,
+                        bool resume = false);
+
+    bool upload_sync(const std::string &target_url, const std::string &local_path);
+    void upload_async(const std::string &target_url, const std::string &local_path,
+                      const progress_callback_t &progress_callback = nullptr);
+
+    // Calls func on a worker thread in turn with the transfers, e.g. to process
+    // what was downloaded without holding up the caller.
+    void call_async(const std::function<void()> &func);
+
+    // Non-copyable
+    HttpLoader(const HttpLoader &) = delete;
+    const HttpLoader &operator=(const HttpLoader &) = delete;
+
+private:
+
+    class WorkItem
+    {
+    public:
+        WorkItem() {}
+        virtual ~WorkItem() {}
+
+        WorkItem(WorkItem &) = delete;
+        WorkItem operator=(WorkItem &) = delete;
+    };
+
+    class DownloadTextItem : public WorkItem
+    {
+    public:
+        DownloadTextItem(const std::string &url, const download_text_callback_t &callback) :
+            _url(url),
+            _callback(callback) { }
+
+        std::string get_url() const
+        {
+            return _url;
+        }
+
+        download_text_callback_t get_callback() const
+        {
+            return _callback;
+        }
+
+        DownloadTextItem(DownloadTextItem &) = delete;
+        DownloadTextItem operator=(DownloadTextItem &) = delete;
+
+    private:
+        std::string _url;
+        download_text_callback_t _callback {};
+    };
+
+    class DownloadTextIfModifiedItem : public WorkItem
+    {
+    public:
+        DownloadTextIfModifiedItem(const std::string &url, const HttpValidators &validators,
+                                   const download_text_if_modified_callback_t &callback) :
+            _url(url),
+            _validators(validators),
+            _callback(callback) { }
+
+        std::string get_url() const
+        {
+            return _url;
+        }
+
+        HttpValidators get_validators() const
+        {
+            return _validators;
+        }
+
+        download_text_if_modified_callback_t get_callback() const
+        {
+            return _callback;
+        }
+
+        DownloadTextIfModifiedItem(DownloadTextIfModifiedItem &) = delete;
+        DownloadTextIfModifiedItem operator=(DownloadTextIfModifiedItem &) = delete;
+
+    private:
+        std::string _url;
+        HttpValidators _validators;
+        download_text_if_modified_callback_t _callback {};
+    };
+
+    class DownloadChunksItem : public WorkItem
+    {
+    public:
+        DownloadChunksItem(const std::string &url, const chunk_callback_t &chunk_callback,
+                           const download_chunks_callback_t &callback) :
+            _url(url),
+            _chunk_callback(chunk_callback),
+            _callback(callback) { }
+
+        std::string get_url() const
+        {
+            return _url;
+        }
+
+        const chunk_callback_t &get_chunk_callback() const
+        {
+            return _chunk_callback;
+        }
+
+        download_chunks_callback_t get_callback() const
+        {
+            return _callback;
+        }
+
+        DownloadChunksItem(DownloadChunksItem &) = delete;
+        DownloadChunksItem operator=(DownloadChunksItem &) = delete;
+
+    private:
+        std::string _url;
+        chunk_callback_t _chunk_callback {};
+        download_chunks_callback_t _callback {};
+    };
+
+    class DownloadItem : public WorkItem
+    {
+    public:
+        DownloadItem(const std::string &url, const std::string &local_path,
+                     const progress_callback_t &progress_callback, bool resume = false) :
+            _url(url),
+            _local_path(local_path),
+            _progress_callback(progress_callback),
+            _resume(resume) { }
+
+        std::string get_local_path() const
+        {
+            return _local_path;
+        }
+
+        std::string get_url() const
+        {
+            return _url;
+        }
+
+        progress_callback_t get_progress_callback() const
+        {
+            return _progress_callback;
+        }
+
+        bool get_resume() const
+        {
+            return _resume;
+        }
+
+        DownloadItem(DownloadItem &) = delete;
+        DownloadItem operator=(DownloadItem &) = delete;
+
+    private:
+        std::string _url;
+        std::string _local_path;
+        progress_callback_t _progress_callback {};
+        bool _resume;
+    };
+
+
+    class UploadItem : public WorkItem
+    {
+    public:
+        UploadItem(const std::string &target_url, const std::string &local_path,
+                   const progress_callback_t &progress_callback) :
+            _target_url(target_url),
+            _local_path(local_path),
+            _progress_callback(progress_callback) { }
+
+        std::string get_local_path() const
+        {
+            return _local_path;
+        }
+
+        std::string get_target_url() const
+        {
+            return _target_url;
+        }
+
+        progress_callback_t get_progress_callback() const
+        {
+            return _progress_callback;
+        }
+
+        UploadItem(UploadItem &) = delete;
+        UploadItem operator=(UploadItem &) = delete;
+
+    private:
+        std::string _target_url;
+        std::string _local_path;
+        progress_callback_t _progress_callback {};
+    };
+
+    class CallItem : public WorkItem
+    {
+    public:
+        explicit CallItem(const std::function<void()> &func) :
+            _func(func) { }
+
+        const std::function<void()> &get_func() const
+        {
+            return _func;
+        }
+
+        CallItem(CallItem &) = delete;
+        CallItem operator=(CallItem &) = delete;
+
+    private:
+        std::function<void()> _func {};
+    };
+
+    static void work_thread(HttpLoader *self, std::shared_ptr<ICurlWrapper> curl_wrapper);
+    static void do_item(const std::shared_ptr<WorkItem> &item,
+                        const std::shared_ptr<ICurlWrapper> &curl_wrapper);
+    static bool do_download_text(const std::shared_ptr<DownloadTextItem> &item,
+                                 const std::shared_ptr<ICurlWrapper> &curl_wrapper);
+    static bool do_download_text_if_modified(const std::shared_ptr<DownloadTextIfModifiedItem>
+                                             &item,
+                                             const std::shared_ptr<ICurlWrapper> &curl_wrapper);
+    static bool do_download_chunks(const std::shared_ptr<DownloadChunksItem> &item,
+                                   const std::shared_ptr<ICurlWrapper> &curl_wrapper);
+    static bool do_download(const std::shared_ptr<DownloadItem> &item,
+                            const std::shared_ptr<ICurlWrapper> &curl_wrapper);
+    static bool do_upload(const std::shared_ptr<UploadItem> &item,
+                          const std::shared_ptr<ICurlWrapper> &curl_wrapper);
+
+    // Declared first so that it outlives the wrappers using it.
+    std::shared_ptr<CurlShare> _curl_share {};
+
+    // Used for the sync calls, and by the first work thread.
+    std::shared_ptr<ICurlWrapper> _curl_wrapper;
+    // One per work thread.
+    std::vector<std::shared_ptr<ICurlWrapper>> _transfer_curl_wrappers {};
+
+    SafeQueue <std::shared_ptr<WorkItem>> _work_queue {};
+    std::vector<std::thread *> _work_threads {};
+
+    std::atomic<bool> _should_exit {false};
+};
+
+} // namespace dronecore
+
+
@@ -0,0 +1,444 @@
+#include "dronecore.h"
+#include "http_loader.h"
+#include "curl_include.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <numeric>
+#include <mutex>
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+class HttpLoaderTest : public testing::Test
+{
+protected:
+    const std::string _file_url_1 = "http://subdomain.domain.com/some_folder/some_file";
+    const std::string _file_url_2 = "http://subdomain.domain.com/some_folder/another_file.txt";
+    const std::string _file_url_3 = "http://subdomain.domain.com/some_folder/yet_another_file.mp4";
+    const std::string _file_local_path_1 = "some_file";
+    const std::string _file_local_path_2 = "another_file.txt";
+    const std::string _file_local_path_3 = "yet_another_file.mp4";
+
+    virtual void SetUp()
+    {
+        clean();
+    }
+
+    virtual void TearDown()
+    {
+        clean();
+    }
+
+    void clean()
+    {
+        remove(_file_local_path_1.c_str());
+        remove(_file_local_path_2.c_str());
+        remove(_file_local_path_3.c_str());
+    }
+
+    bool check_file_exists(const std::string &file_path)
+    {
+        std::ifstream infile(file_path.c_str());
+        return infile.good();
+    }
+
+    void write_file(const std::string &path, const std::string &content)
+    {
+        std::ofstream file;
+        file.open(path);
+        file << content;
+        file.close();
+    }
+
+    void expect_all_simulated_downloads_to_succeed(const std::shared_ptr<CurlWrapperMock> &curl_wrapper)
+    {
+        EXPECT_CALL(*curl_wrapper, download_file_to_path(_, _, _))
+        .WillRepeatedly(Invoke([&](const std::string &/*url*/, const std::string & path,
+        const progress_callback_t &progress_callback) {
+            for (size_t i = 0; i <= 100; i++) {
+                if (progress_callback != nullptr) {
+                    progress_callback(i, Status::Downloading, CURLcode::CURLE_OK);
+                }
+            }
+
+            write_file(path, "downloaded file content\n");
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+            progress_callback(100, Status::Finished, CURLcode::CURLE_OK);
+            return true;
+        }));
+    }
+
+    void expect_one_simulated_download_to_fail(const std::shared_ptr<CurlWrapperMock> &curl_wrapper,
+                                               const std::string &url, const std::string &path)
+    {
+        EXPECT_CALL(*curl_wrapper, download_file_to_path(url, path, _))
+        .WillOnce(Invoke([&](const std::string &/*url*/, const std::string &/*path*/,
+        const progress_callback_t &progress_callback) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            progress_callback(0, Status::Error, CURLcode::CURLE_COULDNT_RESOLVE_HOST);
+            return false;
+        }));
+    }
+
+    void expect_one_simulated_download_to_succeed(const std::shared_ptr<CurlWrapperMock> &curl_wrapper,
+                                                  const std::string &url, const std::string &path)
+    {
+        EXPECT_CALL(*curl_wrapper, download_file_to_path(url, path, _))
+        .WillOnce(Invoke([&](const std::string &/*url*/, const std::string & got_path,
+        const progress_callback_t &progress_callback) {
+            for (size_t i = 0; i <= 100; i++) {
+                if (progress_callback != nullptr) {
+                    progress_callback(i, Status::Downloading, CURLcode::CURLE_OK);
+                }
+            }
+
+            write_file(got_path, "downloaded file content\n");
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+            progress_callback(100, Status::Finished, CURLcode::CURLE_OK);
+            return true;
+        }));
+    }
+};
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadAsync_OneBad)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    expect_one_simulated_download_to_succeed(curl_wrapper_mock, _file_url_1, _file_local_path_1);
+    expect_one_simulated_download_to_fail(curl_wrapper_mock, _file_url_2, _file_local_path_2);
+    expect_one_simulated_download_to_succeed(curl_wrapper_mock, _file_url_3, _file_local_path_3);
+
+    std::vector<int> callback_results_progress;
+    int callback_finished_counter = 0;
+    int callback_error_counter = 0;
+
+    progress_callback_t progress = [&callback_results_progress,
+                                    &callback_finished_counter,
+                                    &callback_error_counter]
+    (int got_progress, Status status, CURLcode curl_code) -> int {
+        if (status == Status::Downloading)
+        {
+            callback_results_progress.push_back(got_progress);
+        } else if (status == Status::Error && curl_code == CURLcode::CURLE_COULDNT_RESOLVE_HOST)
+        {
+            callback_error_counter++;
+        } else if (status == Status::Finished && curl_code == CURLcode::CURLE_OK)
+        {
+            callback_finished_counter++;
+        }
+        return 0;
+    };
+
+    http_loader->download_async(_file_url_1, _file_local_path_1, progress);
+    http_loader->download_async(_file_url_2, _file_local_path_2, progress);
+    http_loader->download_async(_file_url_3, _file_local_path_3, progress);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    EXPECT_EQ(check_file_exists(_file_local_path_1), true);
+    EXPECT_EQ(check_file_exists(_file_local_path_2), false);
+    EXPECT_EQ(check_file_exists(_file_local_path_3), true);
+
+    int callback_results_sum = std::accumulate(callback_results_progress.begin(),
+                                               callback_results_progress.end(), 0);
+    EXPECT_EQ(callback_results_sum, 2 * 5050);
+    EXPECT_EQ(callback_results_progress.size(), 2 * 101);
+    EXPECT_EQ(callback_finished_counter, 2);
+    EXPECT_EQ(callback_error_counter, 1);
+
+    clean();
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadAsync_AllGood)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    expect_all_simulated_downloads_to_succeed(curl_wrapper_mock);
+
+    std::vector<int> callback_results_progress;
+    int callback_finished_counter = 0;
+    int callback_error_counter = 0;
+
+    progress_callback_t progress = [&callback_results_progress,
+                                    &callback_finished_counter,
+                                    &callback_error_counter]
+    (int got_progress, Status status, CURLcode curl_code) -> int {
+        if (status == Status::Downloading)
+        {
+            callback_results_progress.push_back(got_progress);
+        } else if (status == Status::Error && curl_code == CURLcode::CURLE_COULDNT_RESOLVE_HOST)
+        {
+            callback_error_counter++;
+        } else if (status == Status::Finished && curl_code == CURLcode::CURLE_OK)
+        {
+            callback_finished_counter++;
+        }
+        return 0;
+    };
+
+    http_loader->download_async(_file_url_1, _file_local_path_1, progress);
+    http_loader->download_async(_file_url_2, _file_local_path_2, progress);
+    http_loader->download_async(_file_url_3, _file_local_path_3, progress);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    EXPECT_EQ(check_file_exists(_file_local_path_1), true);
+    EXPECT_EQ(check_file_exists(_file_local_path_2), true);
+    EXPECT_EQ(check_file_exists(_file_local_path_3), true);
+
+    int callback_results_sum = std::accumulate(callback_results_progress.begin(),
+                                               callback_results_progress.end(), 0);
+    EXPECT_EQ(callback_results_sum, 3 * 5050);
+    EXPECT_EQ(callback_results_progress.size(), 3 * 101);
+    EXPECT_EQ(callback_finished_counter, 3);
+    EXPECT_EQ(callback_error_counter, 0);
+
+    clean();
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadTextAsync)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    EXPECT_CALL(*curl_wrapper_mock, download_text(_file_url_1, _))
+    .WillOnce(Invoke([&](const std::string &/*url*/, std::string & content) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        content = "<mavlinkcamera/>";
+        return true;
+    }));
+    EXPECT_CALL(*curl_wrapper_mock, download_text(_file_url_2, _))
+    .WillOnce(Return(false));
+
+    std::mutex mutex;
+    std::vector<std::pair<bool, std::string>> results;
+    auto callback = [&mutex, &results](bool success, const std::string & content) {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::make_pair(success, content));
+    };
+
+    const auto before = std::chrono::steady_clock::now();
+    http_loader->download_text_async(_file_url_1, callback);
+    http_loader->download_text_async(_file_url_2, callback);
+    // Doesn't wait for the download.
+    EXPECT_LT(std::chrono::steady_clock::now() - before, std::chrono::milliseconds(20));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_TRUE(results[0].first);
+    EXPECT_EQ(results[0].second, "<mavlinkcamera/>");
+    EXPECT_FALSE(results[1].first);
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_CallAsync)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    EXPECT_CALL(*curl_wrapper_mock, download_text(_file_url_1, _))
+    .WillOnce(Invoke([&](const std::string &/*url*/, std::string & content) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        content = "<mavlinkcamera/>";
+        return true;
+    }));
+
+    std::mutex mutex;
+    std::vector<std::string> calls;
+    http_loader->download_text_async(_file_url_1,
+    [&mutex, &calls](bool, const std::string &) {
+        std::lock_guard<std::mutex> lock(mutex);
+        calls.push_back("download");
+    });
+    const auto caller_id = std::this_thread::get_id();
+    http_loader->call_async([&mutex, &calls, caller_id]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        calls.push_back((std::this_thread::get_id() != caller_id) ? "call" : "wrong thread");
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    // In turn with the download on the single worker.
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(calls, (std::vector<std::string> {"download", "call"}));
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadChunksAsync)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    EXPECT_CALL(*curl_wrapper_mock, download_chunks(_file_url_1, _))
+    .WillOnce(Invoke([&](const std::string &/*url*/, const chunk_callback_t &chunk_callback) {
+        const std::string chunks[] = {"<mavlink", "camera/>", "ignored"};
+        for (const auto &chunk : chunks) {
+            if (!chunk_callback(chunk.c_str(), chunk.size())) {
+                return false;
+            }
+        }
+        return true;
+    }));
+
+    std::mutex mutex;
+    std::string received {};
+    std::vector<bool> results {};
+
+    http_loader->download_chunks_async(_file_url_1,
+    [&mutex, &received](const char *data, size_t len) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.append(data, len);
+        // Abort after the second chunk.
+        return received.size() < 16;
+    },
+    [&mutex, &results](bool success) {
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(success);
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(received, "<mavlinkcamera/>");
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_FALSE(results[0]);
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadTextIfModifiedAsync)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    EXPECT_CALL(*curl_wrapper_mock, download_text_if_modified(_file_url_1, _, _, _))
+    .WillOnce(Invoke([&](const std::string &/*url*/, HttpValidators & validators,
+    std::string & content, bool &modified) {
+        // Sent along as given.
+        EXPECT_EQ(validators.etag, "\"1\"");
+        validators.etag = "\"2\"";
+        content = "<mavlinkcamera/>";
+        modified = true;
+        return true;
+    }));
+
+    std::mutex mutex;
+    bool called = false;
+    HttpValidators validators {};
+    validators.etag = "\"1\"";
+    http_loader->download_text_if_modified_async(_file_url_1, validators,
+                                                 [&mutex, &called](bool success, bool modified,
+                                                         const std::string & content,
+    const HttpValidators & received) {
+        std::lock_guard<std::mutex> lock(mutex);
+        called = true;
+        EXPECT_TRUE(success);
+        EXPECT_TRUE(modified);
+        EXPECT_EQ(content, "<mavlinkcamera/>");
+        EXPECT_EQ(received.etag, "\"2\"");
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_TRUE(called);
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadTextIfModifiedAsync_NotModified)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock);
+
+    EXPECT_CALL(*curl_wrapper_mock, download_text_if_modified(_file_url_1, _, _, _))
+    .WillOnce(Invoke([&](const std::string &/*url*/, HttpValidators & /*validators*/,
+    std::string & content, bool &modified) {
+        content.clear();
+        modified = false;
+        return true;
+    }));
+
+    std::mutex mutex;
+    bool called = false;
+    HttpValidators validators {};
+    validators.etag = "\"1\"";
+    validators.last_modified = "Wed, 21 Oct 2015 07:28:00 GMT";
+    http_loader->download_text_if_modified_async(_file_url_1, validators,
+                                                 [&mutex, &called](bool success, bool modified,
+                                                         const std::string & content,
+    const HttpValidators & received) {
+        std::lock_guard<std::mutex> lock(mutex);
+        called = true;
+        EXPECT_TRUE(success);
+        EXPECT_FALSE(modified);
+        EXPECT_EQ(content, "");
+        // Still those of the cached content.
+        EXPECT_EQ(received.etag, "\"1\"");
+        EXPECT_EQ(received.last_modified, "Wed, 21 Oct 2015 07:28:00 GMT");
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_TRUE(called);
+}
+
+TEST_F(HttpLoaderTest, HttpLoader_DownloadAsync_Parallel)
+{
+    auto curl_wrapper_mock = std::make_shared<CurlWrapperMock>();
+    auto http_loader = std::make_shared<HttpLoader>(curl_wrapper_mock, 3);
+
+    std::mutex mutex;
+    int num_running = 0;
+    int max_running = 0;
+
+    EXPECT_CALL(*curl_wrapper_mock, download_file_to_path_resumable(_, _, _))
+    .Times(3)
+    .WillRepeatedly(Invoke([&](const std::string &/*url*/, const std::string & path,
+    const progress_callback_t &progress_callback) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            max_running = std::max(max_running, ++num_running);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        write_file(path, "downloaded file content\n");
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --num_running;
+        }
+        progress_callback(100, Status::Finished, CURLcode::CURLE_OK);
+        return true;
+    }));
+
+    int callback_finished_counter = 0;
+    progress_callback_t progress = [&mutex, &callback_finished_counter]
+    (int /*got_progress*/, Status status, CURLcode /*curl_code*/) -> int {
+        if (status == Status::Finished)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            callback_finished_counter++;
+        }
+        return 0;
+    };
+
+    http_loader->download_async(_file_url_1, _file_local_path_1, progress, true);
+    http_loader->download_async(_file_url_2, _file_local_path_2, progress, true);
+    http_loader->download_async(_file_url_3, _file_local_path_3, progress, true);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(130));
+
+    EXPECT_EQ(check_file_exists(_file_local_path_1), true);
+    EXPECT_EQ(check_file_exists(_file_local_path_2), true);
+    EXPECT_EQ(check_file_exists(_file_local_path_3), true);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(callback_finished_counter, 3);
+    EXPECT_GT(max_running, 1);
+
+    clean();
+}
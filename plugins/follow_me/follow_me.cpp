@@ -33,6 +33,11 @@ void FollowMe::set_target_location(const TargetLocation &target_location)
     return _impl->set_target_location(target_location);
 }
 
+void FollowMe::set_target_send_rate(float rate_hz)
+{
+    _impl->set_target_send_rate(rate_hz);
+}
+
 const FollowMe::TargetLocation &FollowMe::get_last_location() const
 {
     return _impl->get_last_location();
@@ -127,9 +127,9 @@ public:
         double longitude_deg; /**< @brief Longitude, in degrees */
         double absolute_altitude_m; /**< @brief AMSL, in meters */
 
-        float velocity_x_m_s; /**< @brief X-velocity in m/s */
-        float velocity_y_m_s; /**< @brief Y-velocity in m/s */
-        float velocity_z_m_s; /**< @brief Z-velocity in m/s */
+        float velocity_x_m_s; /**< @brief X-velocity (north) in m/s, all 0 if unknown */
+        float velocity_y_m_s; /**< @brief Y-velocity (east) in m/s, all 0 if unknown */
+        float velocity_z_m_s; /**< @brief Z-velocity (down) in m/s, all 0 if unknown */
     };
 
     /**
@@ -148,6 +148,17 @@ public:
      */
     void set_target_location(const TargetLocation &location);
 
+    /**
+     * @brief Sets how often the location of the target is sent to the vehicle.
+     *
+     * Between calls of set_target_location(), the location is extrapolated using the
+     * estimated velocity of the target. While the target is not moving, its location
+     * is only sent once a second to save bandwidth.
+     *
+     * @param[in] rate_hz Rate while the target is moving, 10 Hz by default.
+     */
+    void set_target_send_rate(float rate_hz);
+
     /**
      * @brief Returns the last location of the target.
      * @return Last location of the target.
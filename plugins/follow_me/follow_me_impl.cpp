@@ -1,7 +1,11 @@
 #include "follow_me_impl.h"
 #include "system.h"
 #include "global_include.h"
+#include "completion.h"
 #include "px4_custom_mode.h"
+#include <algorithm>
+#include <initializer_list>
+#include <map>
 
 namespace dronecore {
 
@@ -24,15 +28,26 @@ FollowMeImpl::~FollowMeImpl()
 
 void FollowMeImpl::init()
 {
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
-        std::bind(&FollowMeImpl::process_heartbeat, this, _1), static_cast<void *>(this));
+    _parent->register_message_handler<mavlink_heartbeat_t>(
+        this, &FollowMeImpl::process_heartbeat);
+
+    for (const char *name : {"NAV_MIN_FT_HT", "NAV_FT_DST", "NAV_FT_FS", "NAV_FT_RS"}) {
+        _param_subscriptions.push_back(_parent->subscribe_param(
+                                           name, std::bind(&FollowMeImpl::receive_param_changed,
+                                                           this, _1, _2)));
+    }
+
     set_default_config();
 }
 
 void FollowMeImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+
+    for (auto handle : _param_subscriptions) {
+        _parent->unsubscribe_param(handle);
+    }
+    _param_subscriptions.clear();
 }
 
 void FollowMeImpl::enable() {}
@@ -55,56 +70,23 @@ FollowMe::Result FollowMeImpl::set_config(const FollowMe::Config &config)
         return FollowMe::Result::SET_CONFIG_FAILED;
     }
 
-    auto height = config.min_height_m;
-    auto distance = config.follow_distance_m;
-    int32_t direction = static_cast<int32_t>(config.follow_direction);
-    auto responsiveness = config.responsiveness;
-
-    _config_change_requested = 0;
+    // All changes go out at once and we wait for the vehicle to confirm them.
+    Completion<bool> completion;
+    set_config_params_async(config, true, [&completion](bool success) {
+        completion.complete(success);
+    });
 
-    // Send configuration to Vehicle
-    if (_config.min_height_m != height) {
-        _parent->set_param_float_async("NAV_MIN_FT_HT", height,
-                                       std::bind(&FollowMeImpl::receive_param_min_height,
-                                                 this, _1, height));
-        _config_change_requested |= ConfigParameter::MIN_HEIGHT;
-    }
-    if (_config.follow_distance_m != distance) {
-        _parent->set_param_float_async("NAV_FT_DST", distance,
-                                       std::bind(&FollowMeImpl::receive_param_follow_distance,
-                                                 this, _1, distance));
-        _config_change_requested |= ConfigParameter::DISTANCE;
-    }
-    if (_config.follow_direction != config.follow_direction) {
-        _parent->set_param_int_async("NAV_FT_FS", direction,
-                                     std::bind(&FollowMeImpl::receive_param_follow_direction,
-                                               this, _1, direction));
-        _config_change_requested |= ConfigParameter::FOLLOW_DIRECTION;
-    }
-    if (_config.responsiveness != responsiveness) {
-        _parent->set_param_float_async("NAV_FT_RS", responsiveness,
-                                       std::bind(&FollowMeImpl::receive_param_responsiveness,
-                                                 this, _1, responsiveness));
-        _config_change_requested |= ConfigParameter::RESPONSIVENESS;
+    if (!completion.wait()) {
+        LogErr() << debug_str << "set_config() failed for some parameters.";
+        return FollowMe::Result::SET_CONFIG_FAILED;
     }
 
-    if (_config_change_requested == 0) {
-        LogDebug() << debug_str <<  "Requested configuration is NO different from existing one!";
-    } else {
-        using namespace std::this_thread; // for sleep_for()
-        using namespace std::chrono; // for milliseconds()
-        // Lets wait for confirmation from Vehicle about configuration change.
-        while (_config_change_requested) {
-            LogDebug() << debug_str <<  "Waiting for the system confirmation of the new configuration..";
-            sleep_for(milliseconds(10));
-        }
-        LogInfo() << debug_str <<  "Configured: " << "Min height: " <<
-                  _config.min_height_m <<
-                  " meters, Follow distance: " <<
-                  _config.follow_distance_m << " meters, Follow direction: " <<
-                  FollowMe::Config::to_str(_config.follow_direction) << ", Responsiveness: " <<
-                  _config.responsiveness ;
-    }
+    LogInfo() << debug_str <<  "Configured: " << "Min height: " <<
+              _config.min_height_m <<
+              " meters, Follow distance: " <<
+              _config.follow_distance_m << " meters, Follow direction: " <<
+              FollowMe::Config::to_str(_config.follow_direction) << ", Responsiveness: " <<
+              _config.responsiveness ;
 
     return FollowMe::Result::SUCCESS;
 }
@@ -113,6 +95,7 @@ void FollowMeImpl::set_target_location(const FollowMe::TargetLocation &location)
 {
     _mutex.lock();
     _target_location = location;
+    _predictor.update(location, _parent->get_time().elapsed_s());
     // We're interested only in lat, long.
     _estimatation_capabilities |= (1 << static_cast<int>(EstimationCapabilites::POS));
 
@@ -120,15 +103,9 @@ void FollowMeImpl::set_target_location(const FollowMe::TargetLocation &location)
         _mutex.unlock();
         return;
     }
-    // If set already, reschedule it.
-    if (_target_location_cookie) {
-        _parent->reset_call_every(_target_location_cookie);
-        _target_location_cookie = nullptr;
-    } else {
-        // Regiter now for sending in the next cycle.
-        _parent->add_call_every([this]() { send_target_location(); },
-        SENDER_RATE,
-        &_target_location_cookie);
+    // Once registered, the new location is picked up by the next cycle.
+    if (!_target_location_cookie) {
+        start_sending_target_location();
     }
     _mutex.unlock();
 
@@ -136,6 +113,32 @@ void FollowMeImpl::set_target_location(const FollowMe::TargetLocation &location)
     send_target_location();
 }
 
+void FollowMeImpl::set_target_send_rate(float rate_hz)
+{
+    if (!(rate_hz > 0.0f)) {
+        LogErr() << debug_str << "Invalid target send rate: " << rate_hz;
+        return;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    _send_rate_hz = rate_hz;
+    // The call every is changed when the target is sent next.
+}
+
+void FollowMeImpl::start_sending_target_location()
+{
+    // We assume that mutex was acquired by the caller
+    _send_interval_s = get_send_interval_s();
+    _parent->add_call_every([this]() { send_target_location(); },
+    _send_interval_s,
+    &_target_location_cookie);
+}
+
+float FollowMeImpl::get_send_interval_s() const
+{
+    // We assume that mutex was acquired by the caller
+    return _predictor.is_stationary() ? STATIONARY_SEND_INTERVAL_S : 1.0f / _send_rate_hz;
+}
+
 const FollowMe::TargetLocation &FollowMeImpl::get_last_location() const
 {
     std::lock_guard<std::mutex> lock(_mutex);
@@ -158,10 +161,8 @@ FollowMe::Result FollowMeImpl::start()
         // If location was set before, lets send it to vehicle
         std::lock_guard<std::mutex> lock(
             _mutex); // locking is not necessary here but lets do it for integrity
-        if (is_target_location_set()) {
-            _parent->add_call_every([this]() { send_target_location(); },
-            SENDER_RATE,
-            &_target_location_cookie);
+        if (is_target_location_set() && !_target_location_cookie) {
+            start_sending_target_location();
         }
     }
     return result;
@@ -186,95 +187,108 @@ void FollowMeImpl::set_default_config()
     LogInfo() << debug_str <<  "Applying default FollowMe configuration FollowMe to the system...";
     FollowMe::Config default_config {};
 
-    auto height = default_config.min_height_m;
-    auto distance = default_config.follow_distance_m;
-    int32_t direction = static_cast<int32_t>(default_config.follow_direction);
-    auto responsiveness = default_config.responsiveness;
-
-    // Send configuration to Vehicle
-    _parent->set_param_float_async("NAV_MIN_FT_HT", height,
-                                   std::bind(&FollowMeImpl::receive_param_min_height,
-                                             this, _1, height));
-    _parent->set_param_float_async("NAV_FT_DST", distance,
-                                   std::bind(&FollowMeImpl::receive_param_follow_distance,
-                                             this, _1, distance));
-    _parent->set_param_int_async("NAV_FT_FS", direction,
-                                 std::bind(&FollowMeImpl::receive_param_follow_direction,
-                                           this, _1, direction));
-    _parent->set_param_float_async("NAV_FT_RS", responsiveness,
-                                   std::bind(&FollowMeImpl::receive_param_responsiveness,
-                                             this, _1, responsiveness));
+    set_config_params_async(default_config, false, nullptr);
 }
 
-bool FollowMeImpl::is_config_ok(const FollowMe::Config &config) const
+void FollowMeImpl::set_config_params_async(const FollowMe::Config &config, bool only_changed,
+                                           const config_callback_t &callback)
 {
-    auto config_ok = false;
+    std::map<std::string, MAVLinkParameters::ParamValue> params {};
 
-    if (config.min_height_m < FollowMe::Config::MIN_HEIGHT_M) {
-        LogErr() << debug_str <<  "Err: Min height must be atleast 8.0 meters";
-    } else if (config.follow_distance_m < FollowMe::Config::MIN_FOLLOW_DIST_M) {
-        LogErr() << debug_str <<  "Err: Min Follow distance must be atleast 1.0 meter";
-    } else if (config.follow_direction < FollowMe::Config::FollowDirection::FRONT_RIGHT ||
-               config.follow_direction > FollowMe::Config::FollowDirection::NONE) {
-        LogErr() << debug_str <<  "Err: Invalid Follow direction";
-    } else if (config.responsiveness < FollowMe::Config::MIN_RESPONSIVENESS ||
-               config.responsiveness > FollowMe::Config::MAX_RESPONSIVENESS) {
-        LogErr() << debug_str <<  "Err: Responsiveness must be in range (0.0 to 1.0)";
-    } else { // Config is OK
-        config_ok = true;
+    if (!only_changed || _config.min_height_m != config.min_height_m) {
+        params["NAV_MIN_FT_HT"].set_float(config.min_height_m);
+    }
+    if (!only_changed || _config.follow_distance_m != config.follow_distance_m) {
+        params["NAV_FT_DST"].set_float(config.follow_distance_m);
+    }
+    if (!only_changed || _config.follow_direction != config.follow_direction) {
+        params["NAV_FT_FS"].set_int32(static_cast<int32_t>(config.follow_direction));
+    }
+    if (!only_changed || _config.responsiveness != config.responsiveness) {
+        params["NAV_FT_RS"].set_float(config.responsiveness);
     }
 
-    return config_ok;
+    if (params.empty()) {
+        LogDebug() << debug_str <<  "Requested configuration is NO different from existing one!";
+    }
+
+    _parent->set_params_async(params, [this, config, callback](bool success,
+    const std::vector<std::string> &failed_params) {
+        receive_config_params(config, failed_params);
+        if (callback) {
+            callback(success);
+        }
+    });
 }
 
-void FollowMeImpl::receive_param_min_height(bool success, float min_height_m)
+void FollowMeImpl::receive_config_params(const FollowMe::Config &config,
+                                         const std::vector<std::string> &failed_params)
 {
-    if (success) {
-        _config.min_height_m = min_height_m;
-        _config_change_requested &= ~(ConfigParameter::MIN_HEIGHT);
+    auto failed = [&failed_params](const std::string & name) {
+        return std::find(failed_params.begin(), failed_params.end(), name) != failed_params.end();
+    };
+
+    // The ones not changed are set to what they already were.
+    if (!failed("NAV_MIN_FT_HT")) {
+        _config.min_height_m = config.min_height_m;
     } else {
-        LogErr() << debug_str <<  "Failed to set NAV_MIN_FT_HT: " << min_height_m << "m";
+        LogErr() << debug_str <<  "Failed to set NAV_MIN_FT_HT: " << config.min_height_m << "m";
     }
-}
-
-void FollowMeImpl::receive_param_follow_distance(bool success, float follow_distance_m)
-{
-    if (success) {
-        _config.follow_distance_m = follow_distance_m;
-        _config_change_requested &= ~(ConfigParameter::DISTANCE);
+    if (!failed("NAV_FT_DST")) {
+        _config.follow_distance_m = config.follow_distance_m;
+    } else {
+        LogErr() << debug_str <<  "Failed to set NAV_FT_DST: " << config.follow_distance_m << "m";
+    }
+    if (!failed("NAV_FT_FS")) {
+        _config.follow_direction = config.follow_direction;
     } else {
-        LogErr() << debug_str <<  "Failed to set NAV_FT_DST: " << follow_distance_m << "m";
+        LogErr() << debug_str <<  "Failed to set NAV_FT_FS: "
+                 << FollowMe::Config::to_str(config.follow_direction);
+    }
+    if (!failed("NAV_FT_RS")) {
+        _config.responsiveness = config.responsiveness;
+    } else {
+        LogErr() << debug_str <<  "Failed to set NAV_FT_RS: " << config.responsiveness;
     }
 }
 
-void FollowMeImpl::receive_param_follow_direction(bool success, int32_t direction)
+void FollowMeImpl::receive_param_changed(const std::string &name,
+                                         MAVLinkParameters::ParamValue value)
 {
-    auto new_direction = FollowMe::Config::FollowDirection::NONE;
-    switch (direction) {
-        case 0: new_direction = FollowMe::Config::FollowDirection::FRONT_RIGHT; break;
-        case 1: new_direction = FollowMe::Config::FollowDirection::BEHIND; break;
-        case 2: new_direction = FollowMe::Config::FollowDirection::FRONT; break;
-        case 3: new_direction = FollowMe::Config::FollowDirection::FRONT_LEFT; break;
-        default: break;
-    }
-    if (success) {
-        if (new_direction != FollowMe::Config::FollowDirection::NONE) {
-            _config.follow_direction = new_direction;
-            _config_change_requested &= ~(ConfigParameter::FOLLOW_DIRECTION);
+    if (name == "NAV_MIN_FT_HT" && value.is_float()) {
+        _config.min_height_m = value.get_float();
+    } else if (name == "NAV_FT_DST" && value.is_float()) {
+        _config.follow_distance_m = value.get_float();
+    } else if (name == "NAV_FT_FS" && value.is_int32()) {
+        const int32_t direction = value.get_int32();
+        if (direction >= int32_t(FollowMe::Config::FollowDirection::FRONT_RIGHT) &&
+            direction <= int32_t(FollowMe::Config::FollowDirection::NONE)) {
+            _config.follow_direction = static_cast<FollowMe::Config::FollowDirection>(direction);
         }
-    } else {
-        LogErr() << debug_str <<  "Failed to set NAV_FT_FS: " <<  FollowMe::Config::to_str(new_direction);
+    } else if (name == "NAV_FT_RS" && value.is_float()) {
+        _config.responsiveness = value.get_float();
     }
 }
 
-void FollowMeImpl::receive_param_responsiveness(bool success, float responsiveness)
+bool FollowMeImpl::is_config_ok(const FollowMe::Config &config) const
 {
-    if (success) {
-        _config.responsiveness = responsiveness;
-        _config_change_requested &= ~(ConfigParameter::RESPONSIVENESS);
-    } else {
-        LogErr() << debug_str <<  "Failed to set NAV_FT_RS: " << responsiveness;
+    auto config_ok = false;
+
+    if (config.min_height_m < FollowMe::Config::MIN_HEIGHT_M) {
+        LogErr() << debug_str <<  "Err: Min height must be atleast 8.0 meters";
+    } else if (config.follow_distance_m < FollowMe::Config::MIN_FOLLOW_DIST_M) {
+        LogErr() << debug_str <<  "Err: Min Follow distance must be atleast 1.0 meter";
+    } else if (config.follow_direction < FollowMe::Config::FollowDirection::FRONT_RIGHT ||
+               config.follow_direction > FollowMe::Config::FollowDirection::NONE) {
+        LogErr() << debug_str <<  "Err: Invalid Follow direction";
+    } else if (config.responsiveness < FollowMe::Config::MIN_RESPONSIVENESS ||
+               config.responsiveness > FollowMe::Config::MAX_RESPONSIVENESS) {
+        LogErr() << debug_str <<  "Err: Responsiveness must be in range (0.0 to 1.0)";
+    } else { // Config is OK
+        config_ok = true;
     }
+
+    return config_ok;
 }
 
 FollowMe::Result
@@ -312,21 +326,36 @@ void FollowMeImpl::send_target_location()
         return;
     }
 
-    dl_time_t now = _time.steady_time();
+    const double now_s = _parent->get_time().elapsed_s();
     // needed by http://mavlink.org/messages/common#FOLLOW_TARGET
-    uint64_t elapsed_msec = static_cast<uint64_t>(_time.elapsed_since_s(now) * 1000); // milliseconds
+    const uint64_t elapsed_msec = static_cast<uint64_t>(now_s * 1000); // milliseconds
 
-    _mutex.lock();
-//   LogDebug() << debug_str <<  "Lat: " << _target_location.latitude_deg << " Lon: " << _target_location.longitude_deg <<
-//	" Alt: " << _target_location.absolute_altitude_m;
-    const int32_t lat_int = static_cast<int32_t>(_target_location.latitude_deg * 1e7);
-    const int32_t lon_int = static_cast<int32_t>(_target_location.longitude_deg * 1e7);
-    const float alt = static_cast<float>(_target_location.absolute_altitude_m);
-    _mutex.unlock();
+    TargetPredictor::Prediction prediction {};
+    uint8_t estimation_capabilities = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_predictor.predict(now_s, prediction)) {
+            return;
+        }
+        estimation_capabilities = _estimatation_capabilities;
+        if (_predictor.has_velocity()) {
+            estimation_capabilities |= (1 << static_cast<int>(EstimationCapabilites::VEL)) |
+                                       (1 << static_cast<int>(EstimationCapabilites::ACCEL));
+        }
+
+        // Slow down while the target stands still, and speed up again once it moves.
+        const float send_interval_s = get_send_interval_s();
+        if (_target_location_cookie && send_interval_s != _send_interval_s) {
+            _parent->change_call_every(send_interval_s, _target_location_cookie);
+            _send_interval_s = send_interval_s;
+        }
+    }
+
+    const int32_t lat_int = static_cast<int32_t>(prediction.latitude_deg * 1e7);
+    const int32_t lon_int = static_cast<int32_t>(prediction.longitude_deg * 1e7);
+    const float alt = static_cast<float>(prediction.absolute_altitude_m);
 
     const float pos_std_dev[] = { NAN, NAN, NAN };
-    const float vel[] = { NAN, NAN, NAN };
-    const float accel_unknown[] = { NAN, NAN, NAN };
     const float attitude_q_unknown[] = { 1.f, NAN, NAN, NAN };
     const float rates_unknown[] = { NAN, NAN, NAN };
     uint64_t custom_state = 0;
@@ -336,12 +365,12 @@ void FollowMeImpl::send_target_location()
                                    GCSClient::component_id,
                                    &msg,
                                    elapsed_msec,
-                                   _estimatation_capabilities,
+                                   estimation_capabilities,
                                    lat_int,
                                    lon_int,
                                    alt,
-                                   vel,
-                                   accel_unknown,
+                                   prediction.velocity_m_s,
+                                   prediction.acceleration_m_s2,
                                    attitude_q_unknown,
                                    rates_unknown,
                                    pos_std_dev,
@@ -351,7 +380,10 @@ void FollowMeImpl::send_target_location()
         LogErr() << debug_str <<  "send_target_location() failed..";
     } else {
         std::lock_guard<std::mutex> lock(_mutex);
-        _last_location = _target_location;
+        _last_location = FollowMe::TargetLocation {
+            prediction.latitude_deg, prediction.longitude_deg, prediction.absolute_altitude_m,
+            prediction.velocity_m_s[0], prediction.velocity_m_s[1], prediction.velocity_m_s[2]
+        };
     }
 }
 
@@ -365,11 +397,8 @@ void FollowMeImpl::stop_sending_target_location()
     _mode = Mode::NOT_ACTIVE;
 }
 
-void FollowMeImpl::process_heartbeat(const mavlink_message_t &message)
+void FollowMeImpl::process_heartbeat(const mavlink_heartbeat_t &heartbeat)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
-
     bool follow_me_active = false; // tells whether we're in FollowMe mode right now
     if (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
 
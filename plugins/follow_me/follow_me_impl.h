@@ -6,6 +6,7 @@
 #include "system.h"
 #include "mavlink_system.h"
 #include "timeout_handler.h"
+#include "target_predictor.h"
 #include "global_include.h"
 #include "log.h"
 
@@ -27,6 +28,7 @@ public:
     FollowMe::Result set_config(const FollowMe::Config &config);
 
     void set_target_location(const FollowMe::TargetLocation &location);
+    void set_target_send_rate(float rate_hz);
     const FollowMe::TargetLocation &get_last_location() const;
 
     bool is_active() const;
@@ -35,26 +37,34 @@ public:
     FollowMe::Result stop();
 
 private:
-    typedef unsigned int config_val_t;
-    void process_heartbeat(const mavlink_message_t &message);
+    void process_heartbeat(const mavlink_heartbeat_t &heartbeat);
 
-    enum class ConfigParameter;
     // Config methods
     void set_default_config();
     bool is_config_ok(const FollowMe::Config &config) const;
-    void receive_param_min_height(bool success, float min_height_m);
-    void receive_param_follow_distance(bool success, float distance);
-    void receive_param_follow_direction(bool success, int32_t direction);
-    void receive_param_responsiveness(bool success, float rsp);
+    // Writes the params of config in one batch, all of them or only those which
+    // differ from _config. _config is updated with the ones that were set.
+    typedef std::function<void(bool success)> config_callback_t;
+    void set_config_params_async(const FollowMe::Config &config, bool only_changed,
+                                 const config_callback_t &callback);
+    void receive_config_params(const FollowMe::Config &config,
+                               const std::vector<std::string> &failed_params);
+    // Keeps _config in line with params changed by anyone else.
+    void receive_param_changed(const std::string &name, MAVLinkParameters::ParamValue value);
     FollowMe::Result to_follow_me_result(MAVLinkCommands::Result result) const;
 
     bool is_target_location_set() const;
     void send_target_location();
     void stop_sending_target_location();
 
+    // Needs to be called with _mutex locked.
+    void start_sending_target_location();
+    float get_send_interval_s() const;
+
     enum class EstimationCapabilites {
         POS,
-        VEL
+        VEL,
+        ACCEL
     };
 
     enum class Mode {
@@ -62,46 +72,24 @@ private:
         ACTIVE
     } _mode = Mode::NOT_ACTIVE;
 
-    enum class ConfigParameter {
-        NONE = 0,
-        FOLLOW_DIRECTION = 1 << 0,
-        MIN_HEIGHT = 1 << 1,
-        DISTANCE = 1 << 2,
-        RESPONSIVENESS = 1 << 3
-    };
-
-    friend config_val_t operator ~(ConfigParameter cfgp)
-    {
-        return ~static_cast<config_val_t>(cfgp);
-    }
-    friend config_val_t operator |(config_val_t config_val, ConfigParameter cfgp)
-    {
-        return (config_val) | static_cast<config_val_t>(cfgp);
-    }
-    friend config_val_t operator |=(config_val_t &config_val, ConfigParameter cfgp)
-    {
-        return config_val = config_val | static_cast<config_val_t>(cfgp);
-    }
-    friend bool operator !=(config_val_t config_val, ConfigParameter cfgp)
-    {
-        return config_val != static_cast<config_val_t>(cfgp);
-    }
-    friend bool operator ==(config_val_t config_val, ConfigParameter cfgp)
-    {
-        return config_val == static_cast<config_val_t>(cfgp);
-    }
-
     mutable std::mutex _mutex {};
-    FollowMe::TargetLocation _target_location; // sent to vehicle
+    FollowMe::TargetLocation _target_location; // set by the app
     FollowMe::TargetLocation _last_location; // sent to vehicle
     void *_target_location_cookie = nullptr;
 
-    Time _time {};
+    // Extrapolates _target_location to the time it is sent.
+    TargetPredictor _predictor {};
+    float _send_rate_hz = DEFAULT_SEND_RATE_HZ;
+    // What the call every currently runs at.
+    float _send_interval_s = 0.0f;
+
     uint8_t _estimatation_capabilities = 0; // sent to vehicle
     FollowMe::Config _config {}; // has FollowMe configuration settings
-    config_val_t _config_change_requested = 0;
+    std::vector<MAVLinkParameters::param_subscription_handle_t> _param_subscriptions {};
 
-    const float SENDER_RATE = 1.0f; // send location updates once in a second
+    static constexpr float DEFAULT_SEND_RATE_HZ = 10.0f;
+    // While the target doesn't move.
+    static constexpr float STATIONARY_SEND_INTERVAL_S = 1.0f;
 
     std::string debug_str = "FollowMe: ";
 };
@@ -0,0 +1,200 @@
+#include "target_predictor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+// Phone GPS, roughly 3 m horizontally, which is also used for the altitude.
+static constexpr double POSITION_VARIANCE_M2 = 9.0;
+static constexpr double VELOCITY_VARIANCE_M2_S2 = 0.25;
+// Initially we know nothing about the velocity, a person walking or cycling.
+static constexpr double INITIAL_VELOCITY_VARIANCE_M2_S2 = 25.0;
+// How much the target changes its velocity, as white noise acceleration.
+static constexpr double ACCELERATION_VARIANCE_M2_S4 = 1.0;
+// Low pass of the acceleration, which is estimated from velocity changes.
+static constexpr float ACCELERATION_FILTER_GAIN = 0.5f;
+
+constexpr double TargetPredictor::MAX_EXTRAPOLATION_S;
+constexpr float TargetPredictor::STATIONARY_SPEED_M_S;
+
+TargetPredictor::TargetPredictor()
+{
+    reset();
+}
+
+void TargetPredictor::reset()
+{
+    _initialized = false;
+    _num_updates = 0;
+    _velocity_measured = false;
+    for (unsigned i = 0; i < 3; ++i) {
+        _axes[i].init(0.0);
+        _acceleration_m_s2[i] = 0.0f;
+    }
+}
+
+void TargetPredictor::update(const FollowMe::TargetLocation &location, double time_s)
+{
+    if (!std::isfinite(location.latitude_deg) || !std::isfinite(location.longitude_deg)) {
+        return;
+    }
+    const double altitude_m = std::isfinite(location.absolute_altitude_m) ?
+                              location.absolute_altitude_m : 0.0;
+
+    if (!_initialized) {
+        _initialized = true;
+        _projection = FlatProjection(location.latitude_deg, location.longitude_deg);
+        _altitude_origin_m = altitude_m;
+        _last_time_s = time_s;
+    }
+
+    double measured[3];
+    to_local(location.latitude_deg, location.longitude_deg, altitude_m, measured);
+
+    const float velocity[3] = {location.velocity_x_m_s, location.velocity_y_m_s,
+                               location.velocity_z_m_s
+                              };
+    const bool velocity_set =
+        std::isfinite(velocity[0]) && std::isfinite(velocity[1]) && std::isfinite(velocity[2]) &&
+        (velocity[0] != 0.0f || velocity[1] != 0.0f || velocity[2] != 0.0f);
+
+    // Locations out of order are taken as arriving now.
+    const double dt_s = std::max(time_s - _last_time_s, 0.0);
+
+    for (unsigned i = 0; i < 3; ++i) {
+        Axis &axis = _axes[i];
+        if (_num_updates == 0) {
+            axis.init(measured[i]);
+        } else {
+            const double velocity_before = axis.velocity;
+            axis.predict(dt_s, ACCELERATION_VARIANCE_M2_S4);
+            axis.update_position(measured[i], POSITION_VARIANCE_M2);
+
+            if (velocity_set) {
+                axis.update_velocity(double(velocity[i]), VELOCITY_VARIANCE_M2_S2);
+            }
+            if (dt_s > 0.0) {
+                const float acceleration = float((axis.velocity - velocity_before) / dt_s);
+                _acceleration_m_s2[i] += ACCELERATION_FILTER_GAIN *
+                                         (acceleration - _acceleration_m_s2[i]);
+            }
+        }
+        if (_num_updates == 0 && velocity_set) {
+            axis.velocity = double(velocity[i]);
+            axis.p_vv = VELOCITY_VARIANCE_M2_S2;
+        }
+    }
+
+    _velocity_measured = _velocity_measured || velocity_set;
+    _last_time_s = time_s;
+    ++_num_updates;
+}
+
+bool TargetPredictor::predict(double time_s, Prediction &prediction) const
+{
+    if (_num_updates == 0) {
+        return false;
+    }
+
+    const double since_update_s = std::max(time_s - _last_time_s, 0.0);
+    const double dt_s = std::min(since_update_s, MAX_EXTRAPOLATION_S);
+    const bool moving = has_velocity() && !is_stationary() &&
+                        since_update_s <= MAX_EXTRAPOLATION_S;
+
+    double local[3];
+    for (unsigned i = 0; i < 3; ++i) {
+        const double velocity = has_velocity() ? _axes[i].velocity : 0.0;
+        local[i] = _axes[i].position + velocity * dt_s;
+        // Once we stop extrapolating, the target is held.
+        prediction.velocity_m_s[i] = moving ? float(velocity) : 0.0f;
+        prediction.acceleration_m_s2[i] = moving ? _acceleration_m_s2[i] : 0.0f;
+    }
+    to_global(local, prediction);
+    return true;
+}
+
+bool TargetPredictor::has_velocity() const
+{
+    return _velocity_measured || _num_updates >= 2;
+}
+
+bool TargetPredictor::is_stationary() const
+{
+    if (!has_velocity()) {
+        return true;
+    }
+    const double speed_m_s = std::sqrt(_axes[0].velocity * _axes[0].velocity +
+                                       _axes[1].velocity * _axes[1].velocity +
+                                       _axes[2].velocity * _axes[2].velocity);
+    return speed_m_s < double(STATIONARY_SPEED_M_S);
+}
+
+void TargetPredictor::to_local(double latitude_deg, double longitude_deg, double altitude_m,
+                               double local[3]) const
+{
+    // Equirectangular, good enough for the distances a target moves.
+    _projection.to_local(latitude_deg, longitude_deg, local[0], local[1]);
+    local[2] = _altitude_origin_m - altitude_m;
+}
+
+void TargetPredictor::to_global(const double local[3], Prediction &prediction) const
+{
+    _projection.to_global(local[0], local[1], prediction.latitude_deg, prediction.longitude_deg);
+    prediction.absolute_altitude_m = _altitude_origin_m - local[2];
+}
+
+void TargetPredictor::Axis::init(double initial_position)
+{
+    position = initial_position;
+    velocity = 0.0;
+    p_pp = POSITION_VARIANCE_M2;
+    p_pv = 0.0;
+    p_vv = INITIAL_VELOCITY_VARIANCE_M2_S2;
+}
+
+void TargetPredictor::Axis::predict(double dt_s, double acceleration_variance)
+{
+    position += velocity * dt_s;
+
+    // P = F P F' + Q with F = [1 dt; 0 1].
+    const double dt2 = dt_s * dt_s;
+    p_pp += 2.0 * dt_s * p_pv + dt2 * p_vv + acceleration_variance * dt2 * dt2 / 4.0;
+    p_pv += dt_s * p_vv + acceleration_variance * dt2 * dt_s / 2.0;
+    p_vv += acceleration_variance * dt2;
+}
+
+void TargetPredictor::Axis::update_position(double measured, double variance)
+{
+    const double innovation = measured - position;
+    const double s = p_pp + variance;
+    const double k_p = p_pp / s;
+    const double k_v = p_pv / s;
+
+    position += k_p * innovation;
+    velocity += k_v * innovation;
+
+    const double p_pp_before = p_pp;
+    const double p_pv_before = p_pv;
+    p_pp -= k_p * p_pp_before;
+    p_pv -= k_p * p_pv_before;
+    p_vv -= k_v * p_pv_before;
+}
+
+void TargetPredictor::Axis::update_velocity(double measured, double variance)
+{
+    const double innovation = measured - velocity;
+    const double s = p_vv + variance;
+    const double k_p = p_pv / s;
+    const double k_v = p_vv / s;
+
+    position += k_p * innovation;
+    velocity += k_v * innovation;
+
+    const double p_pv_before = p_pv;
+    const double p_vv_before = p_vv;
+    p_pp -= k_p * p_pv_before;
+    p_pv -= k_p * p_vv_before;
+    p_vv -= k_v * p_vv_before;
+}
+
+} // namespace dronecore
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "follow_me.h"
+#include "geo.h"
+
+namespace dronecore {
+
+// Constant-velocity Kalman filter of the target, one per axis of a local
+// north/east/down frame around the first location. It smooths the locations
+// set by the app and extrapolates between them, so that the target can be sent
+// more often than the app gets locations (e.g. 1 Hz for phone GPS).
+//
+// Not thread-safe, FollowMeImpl calls it with its mutex locked.
+class TargetPredictor
+{
+public:
+    struct Prediction {
+        double latitude_deg;
+        double longitude_deg;
+        double absolute_altitude_m;
+        float velocity_m_s[3]; // north, east, down
+        float acceleration_m_s2[3]; // north, east, down
+    };
+
+    TargetPredictor();
+
+    // The velocity of the location is used too, unless it's all 0 or not finite.
+    void update(const FollowMe::TargetLocation &location, double time_s);
+    void reset();
+
+    // Extrapolated to time_s, but only up to MAX_EXTRAPOLATION_S after the last
+    // location, after that the target is held there.
+    // Returns false if there is no location yet.
+    bool predict(double time_s, Prediction &prediction) const;
+
+    // Once the velocity has been measured or estimated from two locations.
+    bool has_velocity() const;
+    bool is_stationary() const;
+
+    static constexpr double MAX_EXTRAPOLATION_S = 2.0;
+    static constexpr float STATIONARY_SPEED_M_S = 0.3f;
+
+private:
+    struct Axis {
+        double position;
+        double velocity;
+        // Covariance
+        double p_pp;
+        double p_pv;
+        double p_vv;
+
+        void init(double initial_position);
+        void predict(double dt_s, double acceleration_variance);
+        void update_position(double measured, double variance);
+        void update_velocity(double measured, double variance);
+    };
+
+    void to_local(double latitude_deg, double longitude_deg, double altitude_m,
+                  double local[3]) const;
+    void to_global(const double local[3], Prediction &prediction) const;
+
+    bool _initialized {false};
+    unsigned _num_updates {0};
+    bool _velocity_measured {false};
+    double _last_time_s {0.0};
+
+    // Origin of the local frame.
+    FlatProjection _projection {};
+    double _altitude_origin_m {0.0};
+
+    Axis _axes[3] {};
+    float _acceleration_m_s2[3] {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,91 @@
+#include "target_predictor.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+// About 1 m north at the latitude below.
+static constexpr double LATITUDE_PER_M_DEG = 1.0 / 111195.0;
+
+static FollowMe::TargetLocation make_location(double north_m)
+{
+    return FollowMe::TargetLocation {47.0 + north_m * LATITUDE_PER_M_DEG, 8.0, 500.0,
+                                     0.0f, 0.0f, 0.0f};
+}
+
+TEST(TargetPredictor, NothingWithoutLocation)
+{
+    TargetPredictor predictor;
+    TargetPredictor::Prediction prediction {};
+    EXPECT_FALSE(predictor.predict(0.0, prediction));
+    EXPECT_FALSE(predictor.has_velocity());
+    EXPECT_TRUE(predictor.is_stationary());
+}
+
+TEST(TargetPredictor, HoldsSingleLocation)
+{
+    TargetPredictor predictor;
+    predictor.update(make_location(0.0), 10.0);
+
+    TargetPredictor::Prediction prediction {};
+    ASSERT_TRUE(predictor.predict(11.0, prediction));
+    EXPECT_DOUBLE_EQ(prediction.latitude_deg, 47.0);
+    EXPECT_DOUBLE_EQ(prediction.longitude_deg, 8.0);
+    EXPECT_DOUBLE_EQ(prediction.absolute_altitude_m, 500.0);
+    EXPECT_FLOAT_EQ(prediction.velocity_m_s[0], 0.0f);
+}
+
+TEST(TargetPredictor, ExtrapolatesBetweenLocations)
+{
+    TargetPredictor predictor;
+
+    // Walking north at 2 m/s with locations at 1 Hz.
+    for (int i = 0; i <= 10; ++i) {
+        predictor.update(make_location(2.0 * i), double(i));
+    }
+    EXPECT_TRUE(predictor.has_velocity());
+    EXPECT_FALSE(predictor.is_stationary());
+
+    TargetPredictor::Prediction prediction {};
+    ASSERT_TRUE(predictor.predict(10.5, prediction));
+    const double north_m = (prediction.latitude_deg - 47.0) / LATITUDE_PER_M_DEG;
+    EXPECT_NEAR(north_m, 21.0, 0.5);
+    EXPECT_NEAR(prediction.velocity_m_s[0], 2.0f, 0.2f);
+    EXPECT_NEAR(prediction.velocity_m_s[1], 0.0f, 0.1f);
+    EXPECT_NEAR(prediction.acceleration_m_s2[0], 0.0f, 0.2f);
+
+    // Not further than MAX_EXTRAPOLATION_S, and then held.
+    ASSERT_TRUE(predictor.predict(20.0, prediction));
+    const double held_north_m = (prediction.latitude_deg - 47.0) / LATITUDE_PER_M_DEG;
+    EXPECT_NEAR(held_north_m, 20.0 + 2.0 * TargetPredictor::MAX_EXTRAPOLATION_S, 0.5);
+    EXPECT_FLOAT_EQ(prediction.velocity_m_s[0], 0.0f);
+}
+
+TEST(TargetPredictor, UsesMeasuredVelocity)
+{
+    TargetPredictor predictor;
+    FollowMe::TargetLocation location = make_location(0.0);
+    location.velocity_y_m_s = 3.0f;
+    predictor.update(location, 0.0);
+
+    EXPECT_TRUE(predictor.has_velocity());
+
+    TargetPredictor::Prediction prediction {};
+    ASSERT_TRUE(predictor.predict(1.0, prediction));
+    EXPECT_FLOAT_EQ(prediction.velocity_m_s[1], 3.0f);
+    EXPECT_GT(prediction.longitude_deg, 8.0);
+}
+
+TEST(TargetPredictor, StationaryTarget)
+{
+    TargetPredictor predictor;
+    for (int i = 0; i <= 10; ++i) {
+        predictor.update(make_location(0.0), double(i));
+    }
+    EXPECT_TRUE(predictor.has_velocity());
+    EXPECT_TRUE(predictor.is_stationary());
+
+    predictor.reset();
+    TargetPredictor::Prediction prediction {};
+    EXPECT_FALSE(predictor.predict(11.0, prediction));
+}
@@ -34,6 +34,21 @@ void Gimbal::set_roi_location_async(double latitude_deg, double longitude_deg, f
     _impl->set_roi_location_async(latitude_deg, longitude_deg, altitude_m, callback);
 }
 
+void Gimbal::enable_angle_streaming(float rate_hz)
+{
+    _impl->enable_angle_streaming(rate_hz);
+}
+
+void Gimbal::disable_angle_streaming()
+{
+    _impl->disable_angle_streaming();
+}
+
+void Gimbal::set_streamed_pitch_and_yaw(float pitch_deg, float yaw_deg)
+{
+    _impl->set_streamed_pitch_and_yaw(pitch_deg, yaw_deg);
+}
+
 const char *Gimbal::result_str(Result result)
 {
     switch (result) {
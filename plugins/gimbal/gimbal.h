@@ -118,6 +118,34 @@ public:
     void set_roi_location_async(double latitude_deg, double longitude_deg, float altitude_m,
                                 result_callback_t callback);
 
+    /**
+     * @brief Start streaming gimbal pitch and yaw angles at a fixed rate.
+     *
+     * Rather than a command with acknowledgement and retries for every change, the
+     * angles last set with set_streamed_pitch_and_yaw() are sent at rate_hz without
+     * waiting for acknowledgements. This is meant for tracking, where the angles
+     * change many times a second and only the latest matters.
+     *
+     * @param rate_hz Rate at which the angles are sent, e.g. 30 Hz.
+     */
+    void enable_angle_streaming(float rate_hz);
+
+    /**
+     * @brief Stop streaming gimbal angles.
+     */
+    void disable_angle_streaming();
+
+    /**
+     * @brief Set gimbal pitch and yaw angles to stream.
+     *
+     * Returns right away, the angles go out with the next cycle of the stream
+     * started with enable_angle_streaming().
+     *
+     * @param pitch_deg The pitch angle in degrees. Negative to point down.
+     * @param yaw_deg The yaw angle in degrees. Positive for clock-wise, range -180..180 or 0..360.
+     */
+    void set_streamed_pitch_and_yaw(float pitch_deg, float yaw_deg);
+
     /**
      * @brief Copy constructor (object is not copyable).
      */
@@ -2,6 +2,7 @@
 #include "mavlink_system.h"
 #include "global_include.h"
 #include "mavlink_include.h"
+#include "log.h"
 #include <functional>
 
 namespace dronecore {
@@ -19,7 +20,11 @@ GimbalImpl::~GimbalImpl()
 
 void GimbalImpl::init() {}
 
-void GimbalImpl::deinit() {}
+void GimbalImpl::deinit()
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    stop_streaming();
+}
 
 void GimbalImpl::enable() {}
 
@@ -86,6 +91,67 @@ void GimbalImpl::set_roi_location_async(double latitude_deg, double longitude_de
                                                    std::placeholders::_1, callback));
 }
 
+void GimbalImpl::enable_angle_streaming(float rate_hz)
+{
+    if (!(rate_hz > 0.0f)) {
+        LogErr() << "Invalid gimbal streaming rate: " << rate_hz;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    if (_stream_cookie) {
+        _parent->change_call_every(1.0f / rate_hz, _stream_cookie);
+        return;
+    }
+    _parent->add_call_every([this]() { send_streamed_angles(); },
+    1.0f / rate_hz,
+    &_stream_cookie);
+}
+
+void GimbalImpl::disable_angle_streaming()
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    stop_streaming();
+}
+
+void GimbalImpl::stop_streaming()
+{
+    if (_stream_cookie) {
+        _parent->remove_call_every(_stream_cookie);
+        _stream_cookie = nullptr;
+    }
+}
+
+void GimbalImpl::set_streamed_pitch_and_yaw(float pitch_deg, float yaw_deg)
+{
+    _streamed_angles.store(Angles {true, pitch_deg, yaw_deg});
+}
+
+void GimbalImpl::send_streamed_angles()
+{
+    const Angles angles = _streamed_angles.load();
+    if (!angles.set) {
+        return;
+    }
+
+    // The same as set_pitch_and_yaw() but without confirmation and without
+    // going through MAVLinkCommands, so nothing waits for the ack or retries.
+    const float roll_deg = 0.0f;
+    mavlink_msg_command_long_pack(GCSClient::system_id,
+                                  GCSClient::component_id,
+                                  &_stream_message,
+                                  _parent->get_system_id(),
+                                  _parent->get_autopilot_id(),
+                                  MAV_CMD_DO_MOUNT_CONTROL,
+                                  0,
+                                  angles.pitch_deg,
+                                  roll_deg,
+                                  angles.yaw_deg,
+                                  0.0f, 0.0f, 0.0f,
+                                  float(MAV_MOUNT_MODE_MAVLINK_TARGETING));
+    _parent->send_message(_stream_message);
+}
+
 void GimbalImpl::receive_command_result(MAVLinkCommands::Result command_result,
                                         const Gimbal::result_callback_t &callback)
 {
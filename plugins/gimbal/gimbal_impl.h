@@ -1,9 +1,12 @@
 #pragma once
 
+#include <mutex>
 #include "system.h"
 #include "mavlink_system.h"
+#include "mavlink_include.h"
 #include "gimbal.h"
 #include "plugin_impl_base.h"
+#include "seqlock.h"
 
 namespace dronecore {
 
@@ -29,6 +32,10 @@ public:
     void set_roi_location_async(double latitude_deg, double longitude_deg, float altitude_m,
                                 Gimbal::result_callback_t callback);
 
+    void enable_angle_streaming(float rate_hz);
+    void disable_angle_streaming();
+    void set_streamed_pitch_and_yaw(float pitch_deg, float yaw_deg);
+
     // Non-copyable
     GimbalImpl(const GimbalImpl &) = delete;
     const GimbalImpl &operator=(const GimbalImpl &) = delete;
@@ -39,6 +46,24 @@ private:
 
     static void receive_command_result(MAVLinkCommands::Result command_result,
                                        const Gimbal::result_callback_t &callback);
+
+    void send_streamed_angles();
+    // Needs to be called with _stream_mutex locked.
+    void stop_streaming();
+
+    struct Angles {
+        bool set;
+        float pitch_deg;
+        float yaw_deg;
+    };
+    // Only the latest angles are kept, the user's thread never waits for the sending one.
+    SeqLock<Angles> _streamed_angles {Angles {false, 0.0f, 0.0f}};
+
+    std::mutex _stream_mutex {};
+    void *_stream_cookie = nullptr;
+
+    // Packed into on every cycle, only used by the call every.
+    mavlink_message_t _stream_message {};
 };
 
 
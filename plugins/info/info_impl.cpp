@@ -23,13 +23,11 @@ void InfoImpl::init()
 {
     using namespace std::placeholders; // for `_1`
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
-        std::bind(&InfoImpl::process_heartbeat, this, _1), this);
+    _parent->register_message_handler<mavlink_heartbeat_t>(
+        this, &InfoImpl::process_heartbeat);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_AUTOPILOT_VERSION,
-        std::bind(&InfoImpl::process_autopilot_version, this, _1), this);
+    _parent->register_message_handler<mavlink_autopilot_version_t>(
+        this, &InfoImpl::process_autopilot_version);
 }
 
 void InfoImpl::deinit()
@@ -41,9 +39,9 @@ void InfoImpl::enable() {}
 
 void InfoImpl::disable() {}
 
-void InfoImpl::process_heartbeat(const mavlink_message_t &message)
+void InfoImpl::process_heartbeat(const mavlink_heartbeat_t &heartbeat)
 {
-    UNUSED(message);
+    UNUSED(heartbeat);
 
     if (!is_complete()) {
         // We try to request more info if not all info is available.
@@ -53,12 +51,8 @@ void InfoImpl::process_heartbeat(const mavlink_message_t &message)
     }
 }
 
-void InfoImpl::process_autopilot_version(const mavlink_message_t &message)
+void InfoImpl::process_autopilot_version(const mavlink_autopilot_version_t &autopilot_version)
 {
-    mavlink_autopilot_version_t autopilot_version;
-
-    mavlink_msg_autopilot_version_decode(&message, &autopilot_version);
-
     Info::Version version {};
 
     version.flight_sw_major = (autopilot_version.flight_sw_version >> (8 * 3)) & 0xFF;
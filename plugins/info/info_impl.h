@@ -28,8 +28,8 @@ private:
     void set_version(Info::Version version);
     void set_product(Info::Product product);
 
-    void process_heartbeat(const mavlink_message_t &message);
-    void process_autopilot_version(const mavlink_message_t &message);
+    void process_heartbeat(const mavlink_heartbeat_t &heartbeat);
+    void process_autopilot_version(const mavlink_autopilot_version_t &autopilot_version);
 
     mutable std::mutex _version_mutex;
     Info::Version _version = {};
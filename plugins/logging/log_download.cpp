@@ -0,0 +1,168 @@
+#include "log_download.h"
+
+#include <algorithm>
+
+#if defined(LINUX)
+#include <fcntl.h>
+#endif
+
+namespace dronecore {
+
+constexpr uint32_t LogDownload::CHUNK_SIZE;
+constexpr uint32_t LogDownload::MAX_REQUEST_CHUNKS;
+constexpr uint32_t LogDownload::MAX_CHUNKS_BETWEEN_HOLES;
+constexpr uint32_t LogDownload::BITS_PER_WORD;
+constexpr size_t LogDownload::FILE_BUFFER_SIZE;
+
+LogDownload::LogDownload() {}
+
+LogDownload::~LogDownload()
+{
+    close();
+}
+
+bool LogDownload::open(const std::string &path, uint32_t size)
+{
+    close();
+
+    _file = std::fopen(path.c_str(), "wb");
+    if (_file == nullptr) {
+        return false;
+    }
+    std::setvbuf(_file, nullptr, _IOFBF, FILE_BUFFER_SIZE);
+
+    bool preallocated = false;
+#if defined(LINUX)
+    // Reserves the space on the disk, not only the size of the file.
+    preallocated = (size == 0 || posix_fallocate(fileno(_file), 0, size) == 0);
+#endif
+    if (!preallocated && size > 0) {
+        if (std::fseek(_file, static_cast<long>(size - 1), SEEK_SET) != 0 ||
+            std::fputc(0, _file) == EOF) {
+            std::fclose(_file);
+            _file = nullptr;
+            return false;
+        }
+    }
+    _file_offset = preallocated ? 0 : size;
+    _write_failed = false;
+
+    _size = size;
+    _num_chunks = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    _num_received = 0;
+    _first_missing = 0;
+    _request = Request {0, 0};
+
+    _received.assign((_num_chunks + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+    for (uint32_t i = _num_chunks; i < _received.size() * BITS_PER_WORD; ++i) {
+        _received[i / BITS_PER_WORD] |= uint64_t(1) << (i % BITS_PER_WORD);
+    }
+    return true;
+}
+
+bool LogDownload::close()
+{
+    if (_file != nullptr) {
+        if (std::fclose(_file) != 0) {
+            _write_failed = true;
+        }
+        _file = nullptr;
+    }
+    return !_write_failed;
+}
+
+bool LogDownload::add(uint32_t offset, const uint8_t *data, uint8_t count)
+{
+    if (_file == nullptr) {
+        return false;
+    }
+
+    const uint32_t request_end = _request.offset + _request.count;
+
+    // The vehicle answers a request past the end of the log without data.
+    if (count == 0) {
+        return offset >= _size;
+    }
+
+    // We only ever request whole chunks.
+    if (offset % CHUNK_SIZE != 0 || offset >= _size ||
+        count != std::min(CHUNK_SIZE, _size - offset)) {
+        return false;
+    }
+
+    const uint32_t chunk = offset / CHUNK_SIZE;
+    if (!is_received(chunk)) {
+        write(offset, data, count);
+        _received[chunk / BITS_PER_WORD] |= uint64_t(1) << (chunk % BITS_PER_WORD);
+        ++_num_received;
+    }
+
+    return offset < request_end && offset + count >= request_end;
+}
+
+LogDownload::Request LogDownload::next_request()
+{
+    _first_missing = find_chunk(_first_missing, _num_chunks, false);
+
+    const uint32_t begin = _first_missing;
+    const uint32_t limit = std::min(begin + MAX_REQUEST_CHUNKS, _num_chunks);
+
+    uint32_t end = find_chunk(begin, limit, true);
+    while (end < limit) {
+        const uint32_t next_hole = find_chunk(end, limit, false);
+        if (next_hole == limit || next_hole - end > MAX_CHUNKS_BETWEEN_HOLES) {
+            break;
+        }
+        end = find_chunk(next_hole, limit, true);
+    }
+
+    _request.offset = begin * CHUNK_SIZE;
+    _request.count = std::min(end * CHUNK_SIZE, _size) - _request.offset;
+    return _request;
+}
+
+float LogDownload::progress() const
+{
+    if (_num_chunks == 0) {
+        return 1.0f;
+    }
+    return float(_num_received) / float(_num_chunks);
+}
+
+bool LogDownload::is_received(uint32_t chunk) const
+{
+    return (_received[chunk / BITS_PER_WORD] >> (chunk % BITS_PER_WORD)) & 1;
+}
+
+uint32_t LogDownload::find_chunk(uint32_t from, uint32_t to, bool received) const
+{
+    uint32_t chunk = from;
+    while (chunk < to) {
+        const uint64_t word = _received[chunk / BITS_PER_WORD];
+        const uint64_t bits = (received ? word : ~word) >> (chunk % BITS_PER_WORD);
+        if (bits == 0) {
+            // Skips the rest of the word.
+            chunk += BITS_PER_WORD - chunk % BITS_PER_WORD;
+        } else if (bits & 1) {
+            return chunk;
+        } else {
+            ++chunk;
+        }
+    }
+    return to;
+}
+
+void LogDownload::write(uint32_t offset, const uint8_t *data, uint8_t count)
+{
+    if (offset != _file_offset &&
+        std::fseek(_file, static_cast<long>(offset), SEEK_SET) != 0) {
+        _write_failed = true;
+        return;
+    }
+    if (std::fwrite(data, 1, count, _file) != count) {
+        _write_failed = true;
+    }
+    _file_offset = offset + count;
+}
+
+} // namespace dronecore
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace dronecore {
+
+// Downloads one log from the vehicle with LOG_REQUEST_DATA into a file that is
+// preallocated to the size of the log, each chunk of LOG_DATA is written at its
+// offset as it arrives.
+//
+// Which chunks arrived is kept in a bitmap. A request covers a large window of
+// missing chunks, which the vehicle streams without waiting for us, and once
+// it is through only the holes are requested again. Holes close to each other
+// are requested together, sending a few chunks again is cheaper than a round
+// trip for each hole.
+class LogDownload
+{
+public:
+    // Bytes of log data in one LOG_DATA.
+    static constexpr uint32_t CHUNK_SIZE = 90;
+    // About a megabyte, a second on a fast link.
+    static constexpr uint32_t MAX_REQUEST_CHUNKS = 11651;
+    // Holes with at most this many chunks received in between go into one request.
+    static constexpr uint32_t MAX_CHUNKS_BETWEEN_HOLES = 64;
+
+    struct Request {
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    LogDownload();
+    ~LogDownload();
+
+    // Replaces the file if it exists.
+    bool open(const std::string &path, uint32_t size);
+    // Returns false if writing the file failed.
+    bool close();
+
+    // Returns true if the data ends the current request, so the next one can be sent.
+    bool add(uint32_t offset, const uint8_t *data, uint8_t count);
+
+    // Makes the next request current, only to be called while not complete.
+    Request next_request();
+
+    bool is_complete() const { return _num_received == _num_chunks; }
+    bool write_failed() const { return _write_failed; }
+    float progress() const;
+
+    // Non-copyable
+    LogDownload(const LogDownload &) = delete;
+    const LogDownload &operator=(const LogDownload &) = delete;
+
+private:
+    static constexpr uint32_t BITS_PER_WORD = 64;
+    // Chunks mostly arrive in order, so most writes just go into the buffer.
+    static constexpr size_t FILE_BUFFER_SIZE = 256 * 1024;
+
+    bool is_received(uint32_t chunk) const;
+    // The first chunk in [from, to) which is (not) received, or `to` if there is none.
+    uint32_t find_chunk(uint32_t from, uint32_t to, bool received) const;
+    void write(uint32_t offset, const uint8_t *data, uint8_t count);
+
+    uint32_t _size {0};
+    uint32_t _num_chunks {0};
+    uint32_t _num_received {0};
+    // No chunk before this one is missing.
+    uint32_t _first_missing {0};
+    // Bits past the last chunk are set, so they are never missing.
+    std::vector<uint64_t> _received {};
+    Request _request {0, 0};
+
+    std::FILE *_file {nullptr};
+    // Where the next write goes without seeking.
+    uint32_t _file_offset {0};
+    bool _write_failed {false};
+};
+
+} // namespace dronecore
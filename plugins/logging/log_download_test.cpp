@@ -0,0 +1,148 @@
+#include "log_download.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+static const std::string PATH = "log_download_test.ulg";
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+class LogDownloadTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        for (size_t i = 0; i < LOG_SIZE; ++i) {
+            _log.push_back(static_cast<uint8_t>(i * 13));
+        }
+        ASSERT_TRUE(_download.open(PATH, LOG_SIZE));
+    }
+
+    void TearDown() override
+    {
+        _download.close();
+        std::remove(PATH.c_str());
+    }
+
+    // Like the vehicle, it sends the chunks of a request, except the ones to lose.
+    bool send(const LogDownload::Request &request, const std::vector<uint32_t> &lost = {})
+    {
+        bool ended = false;
+        for (uint32_t offset = request.offset; offset < request.offset + request.count;
+             offset += LogDownload::CHUNK_SIZE) {
+            if (std::find(lost.begin(), lost.end(), offset / LogDownload::CHUNK_SIZE) !=
+                lost.end()) {
+                continue;
+            }
+            const uint32_t count = std::min(LogDownload::CHUNK_SIZE, LOG_SIZE - offset);
+            ended = _download.add(offset, _log.data() + offset, static_cast<uint8_t>(count));
+        }
+        return ended;
+    }
+
+    // Ten full chunks and a partial one.
+    static constexpr uint32_t LOG_SIZE = 10 * LogDownload::CHUNK_SIZE + 45;
+
+    std::vector<uint8_t> _log {};
+    LogDownload _download {};
+};
+
+constexpr uint32_t LogDownloadTest::LOG_SIZE;
+
+TEST_F(LogDownloadTest, RequestsWholeLogAtOnce)
+{
+    const auto request = _download.next_request();
+    EXPECT_EQ(request.offset, 0u);
+    EXPECT_EQ(request.count, LOG_SIZE);
+
+    EXPECT_TRUE(send(request));
+    EXPECT_TRUE(_download.is_complete());
+    EXPECT_TRUE(_download.close());
+    EXPECT_EQ(read_file(PATH), _log);
+}
+
+TEST_F(LogDownloadTest, RequestsHolesAgain)
+{
+    EXPECT_TRUE(send(_download.next_request(), {2, 3}));
+    EXPECT_FALSE(_download.is_complete());
+    EXPECT_FLOAT_EQ(_download.progress(), 9.0f / 11.0f);
+
+    const auto request = _download.next_request();
+    EXPECT_EQ(request.offset, 2 * LogDownload::CHUNK_SIZE);
+    EXPECT_EQ(request.count, 2 * LogDownload::CHUNK_SIZE);
+
+    EXPECT_TRUE(send(request));
+    EXPECT_TRUE(_download.is_complete());
+    EXPECT_TRUE(_download.close());
+    EXPECT_EQ(read_file(PATH), _log);
+}
+
+TEST_F(LogDownloadTest, RequestsCloseHolesTogether)
+{
+    // The last chunk lost too, so the request does not end.
+    EXPECT_FALSE(send(_download.next_request(), {1, 4, 10}));
+
+    // Up to the end, holes are less than the limit apart.
+    const auto request = _download.next_request();
+    EXPECT_EQ(request.offset, 1 * LogDownload::CHUNK_SIZE);
+    EXPECT_EQ(request.count, LOG_SIZE - request.offset);
+
+    EXPECT_TRUE(send(request));
+    EXPECT_TRUE(_download.is_complete());
+    EXPECT_TRUE(_download.close());
+    EXPECT_EQ(read_file(PATH), _log);
+}
+
+TEST_F(LogDownloadTest, IgnoresInvalidChunks)
+{
+    _download.next_request();
+
+    // Not at a chunk, past the end, and too short.
+    EXPECT_FALSE(_download.add(1, _log.data(), 90));
+    EXPECT_FALSE(_download.add(LOG_SIZE, _log.data(), 90));
+    EXPECT_FALSE(_download.add(0, _log.data(), 10));
+    EXPECT_FLOAT_EQ(_download.progress(), 0.0f);
+}
+
+TEST(LogDownload, LimitsRequestSize)
+{
+    const uint32_t size = 3 * LogDownload::MAX_REQUEST_CHUNKS * LogDownload::CHUNK_SIZE;
+
+    LogDownload download;
+    ASSERT_TRUE(download.open(PATH, size));
+
+    const auto request = download.next_request();
+    EXPECT_EQ(request.offset, 0u);
+    EXPECT_EQ(request.count, LogDownload::MAX_REQUEST_CHUNKS * LogDownload::CHUNK_SIZE);
+
+    download.close();
+    std::remove(PATH.c_str());
+}
+
+TEST(LogDownload, CompletesEmptyLog)
+{
+    LogDownload download;
+    ASSERT_TRUE(download.open(PATH, 0));
+    EXPECT_TRUE(download.is_complete());
+    EXPECT_TRUE(download.close());
+    EXPECT_TRUE(read_file(PATH).empty());
+
+    std::remove(PATH.c_str());
+}
+
+TEST(LogDownload, FailsForInvalidPath)
+{
+    LogDownload download;
+    EXPECT_FALSE(download.open("/nonexistent/directory/log.ulg", 100));
+}
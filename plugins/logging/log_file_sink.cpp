@@ -0,0 +1,156 @@
+#include "log_file_sink.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "thread_setup.h"
+
+namespace dronecore {
+
+constexpr size_t LogFileSink::BLOCK_SIZE;
+constexpr size_t LogFileSink::NUM_BLOCKS;
+constexpr size_t LogFileSink::BLOCK_ALIGNMENT;
+constexpr size_t LogFileSink::NO_BLOCK;
+
+LogFileSink::LogFileSink() {}
+
+LogFileSink::~LogFileSink()
+{
+    close();
+}
+
+bool LogFileSink::open(const std::string &path)
+{
+    close();
+
+    _file = std::fopen(path.c_str(), "wb");
+    if (_file == nullptr) {
+        return false;
+    }
+    // Blocks are written whole, buffering them in stdio would only copy them again.
+    std::setvbuf(_file, nullptr, _IONBF, 0);
+
+    // Only allocated once something is logged.
+    if (_storage == nullptr) {
+        size_t space = NUM_BLOCKS * BLOCK_SIZE + BLOCK_ALIGNMENT;
+        _storage = std::unique_ptr<uint8_t[]>(new uint8_t[space]);
+        void *ptr = _storage.get();
+        _blocks = static_cast<uint8_t *>(std::align(BLOCK_ALIGNMENT, NUM_BLOCKS * BLOCK_SIZE,
+                                                    ptr, space));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _free.clear();
+        for (size_t i = 0; i < NUM_BLOCKS; ++i) {
+            _free.push_back(i);
+        }
+        _full.clear();
+        _should_exit = false;
+        _stats = Stats {};
+    }
+    _filling = NO_BLOCK;
+    _filled_len = 0;
+
+    _writer_thread = new std::thread(writer_thread, this);
+    return true;
+}
+
+void LogFileSink::close()
+{
+    if (_writer_thread == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_filling != NO_BLOCK) {
+            queue_filled();
+        }
+        _should_exit = true;
+    }
+    _cv.notify_one();
+
+    _writer_thread->join();
+    delete _writer_thread;
+    _writer_thread = nullptr;
+
+    std::fclose(_file);
+    _file = nullptr;
+}
+
+void LogFileSink::write(const uint8_t *data, size_t len)
+{
+    if (_writer_thread == nullptr) {
+        return;
+    }
+
+    while (len > 0) {
+        if (_filling == NO_BLOCK) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_free.empty()) {
+                _stats.bytes_dropped += len;
+                return;
+            }
+            _filling = _free.back();
+            _free.pop_back();
+            _filled_len = 0;
+        }
+
+        const size_t chunk_len = std::min(len, BLOCK_SIZE - _filled_len);
+        std::memcpy(block(_filling) + _filled_len, data, chunk_len);
+        _filled_len += chunk_len;
+        data += chunk_len;
+        len -= chunk_len;
+
+        if (_filled_len == BLOCK_SIZE) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            queue_filled();
+        }
+    }
+}
+
+LogFileSink::Stats LogFileSink::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _stats;
+}
+
+void LogFileSink::queue_filled()
+{
+    _full.push_back(std::make_pair(_filling, _filled_len));
+    _filling = NO_BLOCK;
+    _filled_len = 0;
+    _cv.notify_one();
+}
+
+void LogFileSink::writer_thread(LogFileSink *self)
+{
+    setup_thread(ThreadRole::Background, "log_file");
+
+    std::unique_lock<std::mutex> lock(self->_mutex);
+    while (true) {
+        self->_cv.wait(lock, [self]() { return !self->_full.empty() || self->_should_exit; });
+        // Only exits once everything is written.
+        if (self->_full.empty()) {
+            break;
+        }
+
+        const auto filled = self->_full.front();
+        self->_full.pop_front();
+
+        lock.unlock();
+        const size_t written = std::fwrite(self->block(filled.first), 1, filled.second,
+                                           self->_file);
+        lock.lock();
+
+        self->_stats.bytes_written += written;
+        if (written != filled.second) {
+            self->_stats.write_failed = true;
+            self->_stats.bytes_dropped += filled.second - written;
+        }
+        self->_free.push_back(filled.first);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace dronecore {
+
+// Writes a file in large, aligned blocks from a background thread, so that the
+// thread receiving the data never waits for the disk. Data is copied once, into
+// the block being filled, and full blocks are written in one go each.
+//
+// If the disk can't keep up and no block is free, data is dropped and counted
+// rather than blocking the caller.
+class LogFileSink
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+    // Half a megabyte, several seconds of a log streamed over wifi.
+    static constexpr size_t NUM_BLOCKS = 8;
+    static constexpr size_t BLOCK_ALIGNMENT = 4096;
+
+    struct Stats {
+        uint64_t bytes_written;
+        uint64_t bytes_dropped;
+        bool write_failed;
+    };
+
+    LogFileSink();
+    ~LogFileSink();
+
+    // Replaces the file if it exists.
+    bool open(const std::string &path);
+    // Writes what is left and closes the file.
+    void close();
+
+    // Only to be called from one thread at a time.
+    void write(const uint8_t *data, size_t len);
+
+    Stats get_stats() const;
+
+    // Non-copyable
+    LogFileSink(const LogFileSink &) = delete;
+    const LogFileSink &operator=(const LogFileSink &) = delete;
+
+private:
+    static constexpr size_t NO_BLOCK = NUM_BLOCKS;
+
+    uint8_t *block(size_t index) const { return _blocks + index * BLOCK_SIZE; }
+
+    // Called with the mutex locked.
+    void queue_filled();
+
+    static void writer_thread(LogFileSink *self);
+
+    std::unique_ptr<uint8_t[]> _storage;
+    uint8_t *_blocks {nullptr};
+
+    // Only used by the thread writing into the sink.
+    size_t _filling {NO_BLOCK};
+    size_t _filled_len {0};
+
+    mutable std::mutex _mutex {};
+    std::condition_variable _cv {};
+    std::vector<size_t> _free {};
+    // Blocks with their length, in the order they were filled.
+    std::deque<std::pair<size_t, size_t>> _full {};
+    bool _should_exit {false};
+    Stats _stats {};
+
+    std::FILE *_file {nullptr};
+    std::thread *_writer_thread {nullptr};
+};
+
+} // namespace dronecore
@@ -0,0 +1,72 @@
+#include "log_file_sink.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+static const std::string PATH = "log_file_sink_test.ulg";
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                                std::istreambuf_iterator<char>());
+}
+
+TEST(LogFileSink, WritesEverythingOnClose)
+{
+    std::vector<uint8_t> data;
+    // More than a block, in small writes like MAVLink payloads.
+    for (size_t i = 0; i < LogFileSink::BLOCK_SIZE + 1000; ++i) {
+        data.push_back(static_cast<uint8_t>(i * 7));
+    }
+
+    LogFileSink sink;
+    ASSERT_TRUE(sink.open(PATH));
+    for (size_t i = 0; i < data.size(); i += 249) {
+        sink.write(data.data() + i, std::min<size_t>(249, data.size() - i));
+    }
+    sink.close();
+
+    EXPECT_EQ(read_file(PATH), data);
+
+    const auto stats = sink.get_stats();
+    EXPECT_EQ(stats.bytes_written, data.size());
+    EXPECT_EQ(stats.bytes_dropped, 0u);
+    EXPECT_FALSE(stats.write_failed);
+
+    std::remove(PATH.c_str());
+}
+
+TEST(LogFileSink, ReplacesFileWhenOpenedAgain)
+{
+    const std::vector<uint8_t> first(100, 1);
+    const std::vector<uint8_t> second(10, 2);
+
+    LogFileSink sink;
+    ASSERT_TRUE(sink.open(PATH));
+    sink.write(first.data(), first.size());
+    ASSERT_TRUE(sink.open(PATH));
+    sink.write(second.data(), second.size());
+    sink.close();
+
+    EXPECT_EQ(read_file(PATH), second);
+
+    std::remove(PATH.c_str());
+}
+
+TEST(LogFileSink, FailsForInvalidPath)
+{
+    LogFileSink sink;
+    EXPECT_FALSE(sink.open("/nonexistent/directory/log.ulg"));
+
+    // Ignored without a file.
+    const uint8_t data[] = {1, 2, 3};
+    sink.write(data, sizeof(data));
+    sink.close();
+}
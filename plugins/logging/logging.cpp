@@ -33,6 +33,28 @@ void Logging::stop_logging_async(result_callback_t callback)
     _impl->stop_logging_async(callback);
 }
 
+Logging::Result Logging::start_logging_to_file(const std::string &path)
+{
+    return _impl->start_logging_to_file(path);
+}
+
+Logging::StreamStats Logging::get_stream_stats() const
+{
+    return _impl->get_stream_stats();
+}
+
+void Logging::get_log_entries_async(log_entries_callback_t callback)
+{
+    _impl->get_log_entries_async(callback);
+}
+
+void Logging::download_log_async(const LogEntry &entry, const std::string &path,
+                                 download_progress_callback_t progress_callback,
+                                 result_callback_t callback)
+{
+    _impl->download_log_async(entry, path, progress_callback, callback);
+}
+
 const char *Logging::result_str(Result result)
 {
     switch (result) {
@@ -48,6 +70,10 @@ const char *Logging::result_str(Result result)
             return "Command denied";
         case Result::TIMEOUT:
             return "Timeout";
+        case Result::FAILED_TO_OPEN_LOG_FILE:
+            return "Failed to open log file";
+        case Result::FAILED_TO_WRITE_LOG_FILE:
+            return "Failed to write log file";
         case Result::UNKNOWN:
         default:
             return "Unknown";
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <string>
+#include <vector>
 #include "plugin_base.h"
 
 namespace dronecore {
@@ -10,9 +13,8 @@ class LoggingImpl;
 class System;
 
 /**
- * @brief The Logging class allows log data using logger and log streaming from the vehicle.
- *
- * **This feature is not yet implemented**.
+ * @brief The Logging class allows to start and stop the logger of the vehicle, and to stream
+ * its log to a ULog file.
  */
 class Logging : public PluginBase
 {
@@ -45,6 +47,8 @@ public:
         BUSY, /**< @brief %System busy. */
         COMMAND_DENIED, /**< @brief Command denied. */
         TIMEOUT, /**< @brief Timeout. */
+        FAILED_TO_OPEN_LOG_FILE, /**< @brief The log file could not be opened for writing. */
+        FAILED_TO_WRITE_LOG_FILE, /**< @brief Writing the log file failed. */
         UNKNOWN /**< @brief Unknown error. */
     };
 
@@ -64,8 +68,6 @@ public:
     /**
      * @brief Start logging (synchronous).
      *
-     * **This feature is not yet implemented**.
-     *
      * @return Result of request.
      */
     Result start_logging() const;
@@ -73,8 +75,6 @@ public:
     /**
      * @brief Stop logging (synchronous).
      *
-     * **This feature is not yet implemented**.
-     *
      * @return Result of request.
      */
     Result stop_logging() const;
@@ -82,8 +82,6 @@ public:
     /**
      * @brief Start logging (asynchronous).
      *
-     * **This feature is not yet implemented**.
-     *
      * @param callback Callback to get result of request.
      */
     void start_logging_async(result_callback_t callback);
@@ -91,12 +89,89 @@ public:
     /**
      * @brief Stop logging (asynchronous).
      *
-     * **This feature is not yet implemented**.
-     *
      * @param callback Callback to get result of request.
      */
     void stop_logging_async(result_callback_t callback);
 
+    /**
+     * @brief Start logging and stream the log to a file (synchronous).
+     *
+     * The log is streamed over MAVLink as it is written on the vehicle, and saved as a
+     * ULog file. Parts lost on the way are left out of the file, marked as dropouts.
+     * The file is written from a background thread and closed by `stop_logging()`.
+     *
+     * @param path File path of the ULog file, it is overwritten if it exists.
+     * @return Result of request, Result::FAILED_TO_OPEN_LOG_FILE if the file could not
+     *     be opened.
+     */
+    Result start_logging_to_file(const std::string &path);
+
+    /**
+     * @brief Statistics of the log streamed since `start_logging_to_file()`.
+     */
+    struct StreamStats {
+        uint64_t bytes_received; /**< @brief Bytes of log data received. */
+        uint64_t bytes_written; /**< @brief Bytes written to the file so far. */
+        uint64_t bytes_dropped; /**< @brief Bytes not written because the disk could not
+                                     keep up, or writing failed. */
+        uint32_t messages_received; /**< @brief Messages with log data received. */
+        uint32_t messages_lost; /**< @brief Messages lost according to their sequence numbers. */
+        uint32_t messages_duplicated; /**< @brief Messages received again and ignored. */
+    };
+
+    /**
+     * @brief Get the statistics of the log streamed to a file.
+     *
+     * @return Statistics of the current or last log.
+     */
+    StreamStats get_stream_stats() const;
+
+    /**
+     * @brief A log stored on the vehicle.
+     */
+    struct LogEntry {
+        uint16_t id; /**< @brief ID of the log. */
+        uint32_t date_utc_s; /**< @brief Time the log was created in seconds since the UNIX
+                                  epoch, 0 if unknown. */
+        uint32_t size_bytes; /**< @brief Size of the log in bytes. */
+    };
+
+    /**
+     * @brief Callback type for the list of logs.
+     */
+    typedef std::function<void(Result, std::vector<LogEntry>)> log_entries_callback_t;
+
+    /**
+     * @brief Get the list of logs stored on the vehicle (asynchronous).
+     *
+     * @param callback Callback to get the result and the logs, sorted by ID.
+     */
+    void get_log_entries_async(log_entries_callback_t callback);
+
+    /**
+     * @brief Callback type for the progress of a log download, from 0 to 1.
+     */
+    typedef std::function<void(float progress)> download_progress_callback_t;
+
+    /**
+     * @brief Download a log from the vehicle to a file (asynchronous).
+     *
+     * The log is requested in large windows which the vehicle streams without waiting,
+     * parts lost on the way are requested again. The file is allocated to the size of the
+     * log first and the data written at its place as it arrives.
+     *
+     * Only one log can be downloaded at a time.
+     *
+     * @param entry The log to download, as listed by `get_log_entries_async()`.
+     * @param path File path to save the log to, it is overwritten if it exists.
+     * @param progress_callback Callback to get the progress of the download.
+     * @param callback Callback to get the result once the download is done, Result::BUSY
+     *     if another log is being downloaded.
+     */
+    void download_log_async(const LogEntry &entry, const std::string &path,
+                            download_progress_callback_t progress_callback,
+                            result_callback_t callback);
+
     // Non-copyable
     /**
      * @brief Copy constructor (object is not copyable).
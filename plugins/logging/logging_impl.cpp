@@ -1,12 +1,21 @@
 #include "global_include.h"
 #include "logging_impl.h"
 #include "dronecore_impl.h"
+#include "log.h"
 #include "px4_custom_mode.h"
+#include <algorithm>
+#include <chrono>
 
 namespace dronecore {
 
+constexpr double LoggingImpl::LOG_ENTRIES_TIMEOUT_S;
+constexpr double LoggingImpl::DOWNLOAD_TIMEOUT_S;
+constexpr unsigned LoggingImpl::MAX_DOWNLOAD_RETRIES;
+constexpr float LoggingImpl::PROGRESS_STEP;
+
 LoggingImpl::LoggingImpl(System &system) :
-    PluginImplBase(system)
+    PluginImplBase(system),
+    _assembler([this](const uint8_t *data, size_t len) { _sink.write(data, len); })
 {
     _parent->register_plugin(this);
 }
@@ -27,11 +36,35 @@ void LoggingImpl::init()
     _parent->register_mavlink_message_handler(
         MAVLINK_MSG_ID_LOGGING_DATA_ACKED,
         std::bind(&LoggingImpl::process_logging_data_acked, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_LOG_ENTRY,
+        std::bind(&LoggingImpl::process_log_entry, this, _1), this);
+
+    _parent->register_mavlink_message_handler(
+        MAVLINK_MSG_ID_LOG_DATA,
+        std::bind(&LoggingImpl::process_log_data, this, _1), this);
 }
 
 void LoggingImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+    close_log_file();
+
+    {
+        std::lock_guard<std::mutex> lock(_entries_mutex);
+        _parent->unregister_timeout_handler(_entries_timeout_cookie);
+        _entries_timeout_cookie = nullptr;
+        _entries_callback = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_download_mutex);
+        _parent->unregister_timeout_handler(_download_timeout_cookie);
+        _download_timeout_cookie = nullptr;
+        _download.close();
+        _downloading = false;
+    }
 }
 
 void LoggingImpl::enable() {}
@@ -49,7 +82,7 @@ Logging::Result LoggingImpl::start_logging() const
     return logging_result_from_command_result(_parent->send_command(command));
 }
 
-Logging::Result LoggingImpl::stop_logging() const
+Logging::Result LoggingImpl::stop_logging()
 {
     MAVLinkCommands::CommandLong command {};
 
@@ -57,7 +90,9 @@ Logging::Result LoggingImpl::stop_logging() const
     MAVLinkCommands::CommandLong::set_as_reserved(command.params, 0.f);
     command.target_component_id = _parent->get_autopilot_id();
 
-    return logging_result_from_command_result(_parent->send_command(command));
+    const auto result = logging_result_from_command_result(_parent->send_command(command));
+    close_log_file();
+    return result;
 }
 
 void LoggingImpl::start_logging_async(const Logging::result_callback_t &callback)
@@ -81,15 +116,71 @@ void LoggingImpl::stop_logging_async(const Logging::result_callback_t &callback)
     MAVLinkCommands::CommandLong::set_as_reserved(command.params, 0.f);
     command.target_component_id = _parent->get_autopilot_id();
 
-    _parent->send_command_async(command, std::bind(&LoggingImpl::command_result_callback,
-                                                   std::placeholders::_1,
-                                                   callback));
+    _parent->send_command_async(command, [this, callback](MAVLinkCommands::Result result, float) {
+        if (result != MAVLinkCommands::Result::IN_PROGRESS) {
+            close_log_file();
+        }
+        command_result_callback(result, callback);
+    });
+}
+
+Logging::Result LoggingImpl::start_logging_to_file(const std::string &path)
+{
+    {
+        std::lock_guard<std::mutex> lock(_stream_mutex);
+        if (!_sink.open(path)) {
+            LogErr() << "Could not open log file " << path;
+            return Logging::Result::FAILED_TO_OPEN_LOG_FILE;
+        }
+        _assembler.reset();
+        _streaming = true;
+    }
+
+    const auto result = start_logging();
+    if (result != Logging::Result::SUCCESS) {
+        close_log_file();
+    }
+    return result;
+}
+
+Logging::StreamStats LoggingImpl::get_stream_stats() const
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    const auto assembler_stats = _assembler.get_stats();
+    const auto sink_stats = _sink.get_stats();
+
+    Logging::StreamStats stats {};
+    stats.bytes_received = assembler_stats.bytes_received;
+    stats.bytes_written = sink_stats.bytes_written;
+    stats.bytes_dropped = sink_stats.bytes_dropped;
+    stats.messages_received = assembler_stats.messages_received;
+    stats.messages_lost = assembler_stats.messages_lost;
+    stats.messages_duplicated = assembler_stats.messages_duplicated;
+    return stats;
+}
+
+void LoggingImpl::close_log_file()
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    if (!_streaming) {
+        return;
+    }
+    _streaming = false;
+    _sink.close();
+
+    const auto stats = _sink.get_stats();
+    if (stats.write_failed) {
+        LogErr() << "Writing log file failed, " << stats.bytes_dropped << " bytes lost";
+    }
 }
 
 void LoggingImpl::process_logging_data(const mavlink_message_t &message)
 {
     mavlink_logging_data_t logging_data;
     mavlink_msg_logging_data_decode(&message, &logging_data);
+
+    add_log_data(logging_data.sequence, logging_data.first_message_offset,
+                 logging_data.data, logging_data.length);
 }
 
 void LoggingImpl::process_logging_data_acked(const mavlink_message_t &message)
@@ -97,6 +188,7 @@ void LoggingImpl::process_logging_data_acked(const mavlink_message_t &message)
     mavlink_logging_data_acked_t logging_data_acked;
     mavlink_msg_logging_data_acked_decode(&message, &logging_data_acked);
 
+    // Acked before anything else, the vehicle waits for it to send more.
     mavlink_message_t answer;
     mavlink_msg_logging_ack_pack(GCSClient::system_id,
                                  GCSClient::component_id,
@@ -106,6 +198,259 @@ void LoggingImpl::process_logging_data_acked(const mavlink_message_t &message)
                                  logging_data_acked.sequence);
 
     _parent->send_message(answer);
+
+    add_log_data(logging_data_acked.sequence, logging_data_acked.first_message_offset,
+                 logging_data_acked.data, logging_data_acked.length);
+}
+
+void LoggingImpl::add_log_data(uint16_t sequence, uint8_t first_message_offset,
+                               const uint8_t *data, uint8_t length)
+{
+    std::lock_guard<std::mutex> lock(_stream_mutex);
+    if (!_streaming) {
+        return;
+    }
+
+    const uint64_t now_ms = static_cast<uint64_t>(
+                                std::chrono::duration_cast<std::chrono::milliseconds>(
+                                    _parent->get_time().steady_time().time_since_epoch()).count());
+    _assembler.add(sequence, first_message_offset, data,
+                   std::min<uint8_t>(length, MAVLINK_MSG_LOGGING_DATA_FIELD_DATA_LEN), now_ms);
+}
+
+void LoggingImpl::get_log_entries_async(const Logging::log_entries_callback_t &callback)
+{
+    bool busy = false;
+    {
+        std::lock_guard<std::mutex> lock(_entries_mutex);
+        busy = bool(_entries_callback);
+        if (!busy) {
+            _entries_callback = callback;
+            _entries.clear();
+
+            _parent->register_timeout_handler(std::bind(&LoggingImpl::log_entries_timed_out, this),
+                                              LOG_ENTRIES_TIMEOUT_S, &_entries_timeout_cookie);
+
+            mavlink_message_t message;
+            mavlink_msg_log_request_list_pack(GCSClient::system_id,
+                                              GCSClient::component_id,
+                                              &message,
+                                              _parent->get_system_id(),
+                                              _parent->get_autopilot_id(),
+                                              0, 0xFFFF);
+            _parent->send_message(message);
+        }
+    }
+
+    if (busy && callback) {
+        callback(Logging::Result::BUSY, std::vector<Logging::LogEntry>());
+    }
+}
+
+void LoggingImpl::process_log_entry(const mavlink_message_t &message)
+{
+    mavlink_log_entry_t log_entry;
+    mavlink_msg_log_entry_decode(&message, &log_entry);
+
+    Logging::log_entries_callback_t callback;
+    std::vector<Logging::LogEntry> entries;
+    {
+        std::lock_guard<std::mutex> lock(_entries_mutex);
+        if (!_entries_callback) {
+            return;
+        }
+
+        // Without logs, the vehicle sends one entry with a count of 0.
+        if (log_entry.num_logs > 0) {
+            const auto it = std::find_if(_entries.begin(), _entries.end(),
+            [&log_entry](const Logging::LogEntry & entry) {
+                return entry.id == log_entry.id;
+            });
+            if (it == _entries.end()) {
+                _entries.push_back(Logging::LogEntry {log_entry.id, log_entry.time_utc,
+                                                      log_entry.size});
+            }
+
+            if (_entries.size() < size_t(log_entry.num_logs)) {
+                _parent->refresh_timeout_handler(_entries_timeout_cookie);
+                return;
+            }
+        }
+
+        _parent->unregister_timeout_handler(_entries_timeout_cookie);
+        _entries_timeout_cookie = nullptr;
+        callback.swap(_entries_callback);
+        entries.swap(_entries);
+    }
+
+    std::sort(entries.begin(), entries.end(),
+    [](const Logging::LogEntry & lhs, const Logging::LogEntry & rhs) {
+        return lhs.id < rhs.id;
+    });
+    callback(Logging::Result::SUCCESS, entries);
+}
+
+void LoggingImpl::log_entries_timed_out()
+{
+    Logging::log_entries_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_entries_mutex);
+        _entries_timeout_cookie = nullptr;
+        callback.swap(_entries_callback);
+        _entries.clear();
+    }
+
+    if (callback) {
+        callback(Logging::Result::TIMEOUT, std::vector<Logging::LogEntry>());
+    }
+}
+
+void LoggingImpl::download_log_async(const Logging::LogEntry &entry, const std::string &path,
+                                     const Logging::download_progress_callback_t &progress_callback,
+                                     const Logging::result_callback_t &callback)
+{
+    Logging::Result result;
+    {
+        std::lock_guard<std::mutex> lock(_download_mutex);
+        if (_downloading) {
+            result = Logging::Result::BUSY;
+        } else if (!_download.open(path, entry.size_bytes)) {
+            LogErr() << "Could not open log file " << path;
+            result = Logging::Result::FAILED_TO_OPEN_LOG_FILE;
+        } else if (_download.is_complete()) {
+            // Nothing to download for an empty log.
+            result = _download.close() ? Logging::Result::SUCCESS :
+                     Logging::Result::FAILED_TO_WRITE_LOG_FILE;
+        } else {
+            _downloading = true;
+            _download_id = entry.id;
+            _download_retries = 0;
+            _download_reported_progress = 0.0f;
+            _download_progress_callback = progress_callback;
+            _download_callback = callback;
+
+            _parent->register_timeout_handler(std::bind(&LoggingImpl::download_timed_out, this),
+                                              DOWNLOAD_TIMEOUT_S, &_download_timeout_cookie);
+            send_next_log_request();
+            return;
+        }
+    }
+
+    if (callback) {
+        callback(result);
+    }
+}
+
+void LoggingImpl::process_log_data(const mavlink_message_t &message)
+{
+    mavlink_log_data_t log_data;
+    mavlink_msg_log_data_decode(&message, &log_data);
+
+    std::unique_lock<std::mutex> lock(_download_mutex);
+    if (!_downloading || log_data.id != _download_id) {
+        return;
+    }
+
+    _parent->refresh_timeout_handler(_download_timeout_cookie);
+    _download_retries = 0;
+
+    const bool request_done =
+        _download.add(log_data.ofs, log_data.data,
+                      std::min<uint8_t>(log_data.count, MAVLINK_MSG_LOG_DATA_FIELD_DATA_LEN));
+
+    if (_download.write_failed()) {
+        LogErr() << "Writing log file failed";
+        finish_download(lock, Logging::Result::FAILED_TO_WRITE_LOG_FILE);
+        return;
+    }
+    if (_download.is_complete()) {
+        finish_download(lock, Logging::Result::SUCCESS);
+        return;
+    }
+    if (request_done) {
+        send_next_log_request();
+    }
+
+    const float progress = _download.progress();
+    if (progress < _download_reported_progress + PROGRESS_STEP) {
+        return;
+    }
+    _download_reported_progress = progress;
+    const auto progress_callback = _download_progress_callback;
+    lock.unlock();
+
+    if (progress_callback) {
+        progress_callback(progress);
+    }
+}
+
+void LoggingImpl::download_timed_out()
+{
+    std::unique_lock<std::mutex> lock(_download_mutex);
+    _download_timeout_cookie = nullptr;
+    if (!_downloading) {
+        return;
+    }
+
+    if (++_download_retries > MAX_DOWNLOAD_RETRIES) {
+        LogWarn() << "Log download timed out";
+        finish_download(lock, Logging::Result::TIMEOUT);
+        return;
+    }
+
+    // The end of the request got lost, the holes are requested again.
+    _parent->register_timeout_handler(std::bind(&LoggingImpl::download_timed_out, this),
+                                      DOWNLOAD_TIMEOUT_S, &_download_timeout_cookie);
+    send_next_log_request();
+}
+
+void LoggingImpl::send_next_log_request()
+{
+    const auto request = _download.next_request();
+
+    mavlink_message_t message;
+    mavlink_msg_log_request_data_pack(GCSClient::system_id,
+                                      GCSClient::component_id,
+                                      &message,
+                                      _parent->get_system_id(),
+                                      _parent->get_autopilot_id(),
+                                      _download_id,
+                                      request.offset,
+                                      request.count);
+    _parent->send_message(message);
+}
+
+void LoggingImpl::finish_download(std::unique_lock<std::mutex> &lock, Logging::Result result)
+{
+    _parent->unregister_timeout_handler(_download_timeout_cookie);
+    _download_timeout_cookie = nullptr;
+
+    // Lets the vehicle close the log and stop sending.
+    mavlink_message_t message;
+    mavlink_msg_log_request_end_pack(GCSClient::system_id,
+                                     GCSClient::component_id,
+                                     &message,
+                                     _parent->get_system_id(),
+                                     _parent->get_autopilot_id());
+    _parent->send_message(message);
+
+    if (!_download.close() && result == Logging::Result::SUCCESS) {
+        result = Logging::Result::FAILED_TO_WRITE_LOG_FILE;
+    }
+    _downloading = false;
+
+    Logging::download_progress_callback_t progress_callback;
+    Logging::result_callback_t callback;
+    progress_callback.swap(_download_progress_callback);
+    callback.swap(_download_callback);
+    lock.unlock();
+
+    if (result == Logging::Result::SUCCESS && progress_callback) {
+        progress_callback(1.0f);
+    }
+    if (callback) {
+        callback(result);
+    }
 }
 
 Logging::Result
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <mutex>
+#include <string>
+#include <vector>
+
 #include "plugin_impl_base.h"
 #include "mavlink_include.h"
 #include "system.h"
 #include "mavlink_system.h"
 #include "logging.h"
+#include "log_download.h"
+#include "log_file_sink.h"
+#include "ulog_stream_assembler.h"
 
 namespace dronecore {
 
@@ -21,19 +28,68 @@ public:
     void disable() override;
 
     Logging::Result start_logging() const;
-    Logging::Result stop_logging() const;
+    Logging::Result stop_logging();
 
     void start_logging_async(const Logging::result_callback_t &callback);
     void stop_logging_async(const Logging::result_callback_t &callback);
 
+    Logging::Result start_logging_to_file(const std::string &path);
+    Logging::StreamStats get_stream_stats() const;
+
+    void get_log_entries_async(const Logging::log_entries_callback_t &callback);
+    void download_log_async(const Logging::LogEntry &entry, const std::string &path,
+                            const Logging::download_progress_callback_t &progress_callback,
+                            const Logging::result_callback_t &callback);
+
 private:
     void process_logging_data(const mavlink_message_t &message);
     void process_logging_data_acked(const mavlink_message_t &message);
+    void add_log_data(uint16_t sequence, uint8_t first_message_offset,
+                      const uint8_t *data, uint8_t length);
+    void close_log_file();
+
+    void process_log_entry(const mavlink_message_t &message);
+    void log_entries_timed_out();
+
+    void process_log_data(const mavlink_message_t &message);
+    void download_timed_out();
+    // Called with the download mutex locked, finishing unlocks it for the callbacks.
+    void send_next_log_request();
+    void finish_download(std::unique_lock<std::mutex> &lock, Logging::Result result);
+
+    static constexpr double LOG_ENTRIES_TIMEOUT_S = 1.0;
+    // Chunks come in back to back, a pause this long means the rest of a request is lost.
+    static constexpr double DOWNLOAD_TIMEOUT_S = 0.5;
+    static constexpr unsigned MAX_DOWNLOAD_RETRIES = 10;
+    // Reported in steps of a percent, not for every chunk.
+    static constexpr float PROGRESS_STEP = 0.01f;
 
     static Logging::Result logging_result_from_command_result(MAVLinkCommands::Result result);
 
     static void command_result_callback(MAVLinkCommands::Result command_result,
                                         const Logging::result_callback_t &callback);
+
+    // The log comes in on the thread of the message handlers, the file is opened
+    // and closed from the threads of the user.
+    mutable std::mutex _stream_mutex {};
+    LogFileSink _sink {};
+    ULogStreamAssembler _assembler;
+    bool _streaming {false};
+
+    std::mutex _entries_mutex {};
+    Logging::log_entries_callback_t _entries_callback {nullptr};
+    std::vector<Logging::LogEntry> _entries {};
+    void *_entries_timeout_cookie {nullptr};
+
+    std::mutex _download_mutex {};
+    LogDownload _download {};
+    bool _downloading {false};
+    uint16_t _download_id {0};
+    unsigned _download_retries {0};
+    float _download_reported_progress {0.0f};
+    Logging::download_progress_callback_t _download_progress_callback {nullptr};
+    Logging::result_callback_t _download_callback {nullptr};
+    void *_download_timeout_cookie {nullptr};
 };
 
 } // namespace dronecore
@@ -0,0 +1,67 @@
+#include "ulog_stream_assembler.h"
+
+#include <algorithm>
+
+namespace dronecore {
+
+constexpr uint8_t ULogStreamAssembler::NO_MESSAGE_START;
+
+void ULogStreamAssembler::reset()
+{
+    _started = false;
+    _resyncing = false;
+    _stats = Stats {};
+}
+
+void ULogStreamAssembler::add(uint16_t sequence, uint8_t first_message_offset,
+                              const uint8_t *data, uint8_t length, uint64_t now_ms)
+{
+    ++_stats.messages_received;
+
+    // Half of the sequence ahead counts as lost, the other half as sent again.
+    const uint16_t num_lost = static_cast<uint16_t>(sequence - _next_sequence);
+    if (_started && num_lost >= 0x8000) {
+        ++_stats.messages_duplicated;
+        return;
+    }
+
+    _stats.bytes_received += length;
+
+    if (_started && num_lost > 0) {
+        _stats.messages_lost += num_lost;
+        if (!_resyncing) {
+            _resyncing = true;
+            write_dropout(now_ms - _last_ms);
+        }
+    }
+
+    _started = true;
+    _next_sequence = static_cast<uint16_t>(sequence + 1);
+    _last_ms = now_ms;
+
+    size_t begin = 0;
+    if (_resyncing) {
+        if (first_message_offset == NO_MESSAGE_START || first_message_offset >= length) {
+            return;
+        }
+        begin = first_message_offset;
+        _resyncing = false;
+    }
+
+    _write(data + begin, length - begin);
+}
+
+void ULogStreamAssembler::write_dropout(uint64_t duration_ms)
+{
+    const uint16_t duration = static_cast<uint16_t>(std::min<uint64_t>(duration_ms, 0xFFFF));
+
+    // ULog message header (size of the rest and type 'O'), then the duration,
+    // all little-endian.
+    const uint8_t dropout[] = {
+        2, 0, 'O',
+        static_cast<uint8_t>(duration & 0xFF), static_cast<uint8_t>(duration >> 8)
+    };
+    _write(dropout, sizeof(dropout));
+}
+
+} // namespace dronecore
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace dronecore {
+
+// Puts the payloads of LOGGING_DATA and LOGGING_DATA_ACKED, which share one
+// sequence, back together into a ULog file. Payloads are passed on in one piece
+// as they come in, nothing is buffered here.
+//
+// Lost payloads are detected from gaps in the sequence. After a loss, the rest of
+// the ULog message that was cut off is skipped up to the first message starting
+// in a payload, and a ULog dropout message is written in its place, so the file
+// stays readable. Payloads sent again because our ack got lost are dropped.
+class ULogStreamAssembler
+{
+public:
+    typedef std::function<void(const uint8_t *data, size_t len)> write_callback_t;
+
+    // In LOGGING_DATA, for a payload without the start of a message.
+    static constexpr uint8_t NO_MESSAGE_START = 255;
+
+    struct Stats {
+        uint64_t bytes_received;
+        uint32_t messages_received;
+        uint32_t messages_lost;
+        uint32_t messages_duplicated;
+    };
+
+    explicit ULogStreamAssembler(const write_callback_t &write) : _write(write) {}
+
+    // For a new log, the next payload is taken as its start.
+    void reset();
+
+    // now_ms is any monotonic time, it only sets the duration of dropouts.
+    void add(uint16_t sequence, uint8_t first_message_offset,
+             const uint8_t *data, uint8_t length, uint64_t now_ms);
+
+    Stats get_stats() const { return _stats; }
+
+private:
+    void write_dropout(uint64_t duration_ms);
+
+    const write_callback_t _write;
+
+    bool _started {false};
+    // Set after a loss until a message starts again.
+    bool _resyncing {false};
+    uint16_t _next_sequence {0};
+    uint64_t _last_ms {0};
+    Stats _stats {};
+};
+
+} // namespace dronecore
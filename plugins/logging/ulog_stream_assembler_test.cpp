@@ -0,0 +1,86 @@
+#include "ulog_stream_assembler.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+class ULogStreamAssemblerTest : public ::testing::Test
+{
+protected:
+    ULogStreamAssemblerTest() :
+        _assembler([this](const uint8_t *data, size_t len) {
+        _written.insert(_written.end(), data, data + len);
+    }) {}
+
+    void add(uint16_t sequence, uint8_t first_message_offset,
+             const std::vector<uint8_t> &data, uint64_t now_ms = 0)
+    {
+        _assembler.add(sequence, first_message_offset, data.data(),
+                       static_cast<uint8_t>(data.size()), now_ms);
+    }
+
+    std::vector<uint8_t> _written {};
+    ULogStreamAssembler _assembler;
+};
+
+TEST_F(ULogStreamAssemblerTest, WritesPayloadsInOrder)
+{
+    add(0, 0, {1, 2, 3});
+    add(1, ULogStreamAssembler::NO_MESSAGE_START, {4, 5});
+    add(2, 1, {6, 7});
+
+    EXPECT_EQ(_written, std::vector<uint8_t>({1, 2, 3, 4, 5, 6, 7}));
+
+    const auto stats = _assembler.get_stats();
+    EXPECT_EQ(stats.messages_received, 3u);
+    EXPECT_EQ(stats.messages_lost, 0u);
+    EXPECT_EQ(stats.bytes_received, 7u);
+}
+
+TEST_F(ULogStreamAssemblerTest, SkipsToNextMessageAfterLoss)
+{
+    add(0, 0, {1, 2}, 1000);
+    // 1 and 2 are lost, 3 is the rest of a message, 4 starts one at offset 1.
+    add(3, ULogStreamAssembler::NO_MESSAGE_START, {3, 4}, 1300);
+    add(4, 1, {5, 6, 7}, 1310);
+
+    // After the first payload, the dropout message of 300 ms.
+    EXPECT_EQ(_written, std::vector<uint8_t>({1, 2, 2, 0, 'O', 0x2C, 0x01, 6, 7}));
+    EXPECT_EQ(_assembler.get_stats().messages_lost, 2u);
+}
+
+TEST_F(ULogStreamAssemblerTest, DropsPayloadsSentAgain)
+{
+    add(10, 0, {1});
+    add(11, 0, {2});
+    add(11, 0, {2});
+    add(10, 0, {1});
+    add(12, 0, {3});
+
+    EXPECT_EQ(_written, std::vector<uint8_t>({1, 2, 3}));
+
+    const auto stats = _assembler.get_stats();
+    EXPECT_EQ(stats.messages_duplicated, 2u);
+    EXPECT_EQ(stats.messages_lost, 0u);
+}
+
+TEST_F(ULogStreamAssemblerTest, HandlesSequenceWrap)
+{
+    add(65535, 0, {1});
+    add(0, 0, {2});
+    add(2, 0, {3});
+
+    EXPECT_EQ(_written, std::vector<uint8_t>({1, 2, 2, 0, 'O', 0, 0, 3}));
+    EXPECT_EQ(_assembler.get_stats().messages_lost, 1u);
+}
+
+TEST_F(ULogStreamAssemblerTest, StartsOverAfterReset)
+{
+    add(100, 0, {1});
+    _assembler.reset();
+    add(0, 0, {2});
+
+    EXPECT_EQ(_written, std::vector<uint8_t>({1, 2}));
+    EXPECT_EQ(_assembler.get_stats().messages_received, 1u);
+    EXPECT_EQ(_assembler.get_stats().messages_lost, 0u);
+}
@@ -0,0 +1,36 @@
+#include "manual_control.h"
+#include "manual_control_impl.h"
+
+namespace dronecore {
+
+ManualControl::ManualControl(System &system) :
+    PluginBase(),
+    _impl { new ManualControlImpl(system) }
+{
+}
+
+ManualControl::~ManualControl()
+{
+}
+
+void ManualControl::set_input(Input input)
+{
+    _impl->set_input(input);
+}
+
+void ManualControl::start_streaming(float rate_hz)
+{
+    _impl->start_streaming(rate_hz);
+}
+
+void ManualControl::stop_streaming()
+{
+    _impl->stop_streaming();
+}
+
+ManualControl::StreamingStats ManualControl::get_streaming_stats() const
+{
+    return _impl->get_streaming_stats();
+}
+
+} // namespace dronecore
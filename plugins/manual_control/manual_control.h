@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "plugin_base.h"
+
+namespace dronecore {
+
+class ManualControlImpl;
+class System;
+
+/**
+ * @brief The ManualControl class sends joystick or gamepad input to the vehicle.
+ *
+ * The input is streamed as MANUAL_CONTROL messages at a fixed rate from a
+ * thread of its own, the same way offboard setpoints are streamed with
+ * Offboard::enable_realtime_streaming(). Only the latest input is kept, setting
+ * it never waits for the sending.
+ */
+class ManualControl : public PluginBase
+{
+public:
+    /**
+     * @brief Constructor. Creates the plugin for a specific System.
+     *
+     * The plugin is typically created as shown below:
+     *
+     *     ```cpp
+     *     auto manual_control = std::make_shared<ManualControl>(system);
+     *     ```
+     *
+     * @param system The specific system associated with this plugin.
+     */
+    explicit ManualControl(System &system);
+
+    /**
+     * @brief Destructor (internal use only).
+     */
+    ~ManualControl();
+
+    /**
+     * @brief Stick positions and buttons.
+     *
+     * Values out of range are clamped.
+     */
+    struct Input {
+        float x; /**< @brief Pitch stick, forward is positive (range: -1 to 1). */
+        float y; /**< @brief Roll stick, right is positive (range: -1 to 1). */
+        float z; /**< @brief Thrust stick (range: 0 to 1). */
+        float r; /**< @brief Yaw stick, clockwise is positive (range: -1 to 1). */
+        uint16_t buttons; /**< @brief Bit mask of the buttons pressed, bit 0 for button 1. */
+    };
+
+    /**
+     * @brief Set the input to stream.
+     *
+     * Returns right away, the input goes out with the next cycle of the stream
+     * started with start_streaming(), and is repeated until the next one is set.
+     * Nothing is sent before the first input is set.
+     *
+     * @param input The latest stick positions and buttons.
+     */
+    void set_input(Input input);
+
+    /**
+     * @brief Start streaming the input at a fixed rate.
+     *
+     * The thread asks for realtime priority where permitted, see
+     * ThreadRole::Setpoint. Calling it again restarts the stream at the new rate.
+     *
+     * @param rate_hz Rate at which the input is sent, 50 to 100 Hz is typical.
+     */
+    void start_streaming(float rate_hz = 50.0f);
+
+    /**
+     * @brief Stop streaming the input.
+     *
+     * The autopilot considers the manual control lost after a while, depending
+     * on its configuration.
+     */
+    void stop_streaming();
+
+    /**
+     * @brief Timing of the stream since it was started.
+     *
+     * The jitter is how late a message is sent after its deadline. The latency
+     * is from set_input() to when the message with that input was handed to the
+     * connection, it is only counted once per input even though it is repeated.
+     */
+    struct StreamingStats {
+        uint64_t num_sent; /**< @brief Messages sent since streaming was started. */
+        uint64_t num_missed; /**< @brief Messages skipped because the thread was more than a period late. */
+        double mean_jitter_us; /**< @brief Mean jitter in microseconds. */
+        double max_jitter_us; /**< @brief Largest jitter in microseconds. */
+        uint64_t num_inputs; /**< @brief Different inputs sent since streaming was started. */
+        double mean_latency_us; /**< @brief Mean latency of the inputs in microseconds. */
+        double max_latency_us; /**< @brief Largest latency of an input in microseconds. */
+        bool realtime_priority; /**< @brief True if the thread runs with realtime (SCHED_FIFO) priority. */
+    };
+
+    /**
+     * @brief Get the timing of the stream.
+     *
+     * @return Stats since the streaming was started, all 0 if it is not.
+     */
+    StreamingStats get_streaming_stats() const;
+
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    ManualControl(const ManualControl &) = delete;
+
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const ManualControl &operator=(const ManualControl &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<ManualControlImpl> _impl;
+};
+
+} // namespace dronecore
@@ -0,0 +1,143 @@
+#include "global_include.h"
+#include "manual_control_impl.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace dronecore {
+
+ManualControlImpl::ManualControlImpl(System &system) :
+    PluginImplBase(system)
+{
+    _parent->register_plugin(this);
+}
+
+ManualControlImpl::~ManualControlImpl()
+{
+    _parent->unregister_plugin(this);
+}
+
+void ManualControlImpl::init() {}
+
+void ManualControlImpl::deinit()
+{
+    stop_streaming();
+}
+
+void ManualControlImpl::enable() {}
+
+void ManualControlImpl::disable() {}
+
+void ManualControlImpl::set_input(ManualControl::Input input)
+{
+    mavlink_manual_control_t manual_control {};
+    manual_control.target = _parent->get_system_id();
+    manual_control.x = to_axis(input.x, -1.0f);
+    manual_control.y = to_axis(input.y, -1.0f);
+    manual_control.z = to_axis(input.z, 0.0f);
+    manual_control.r = to_axis(input.r, -1.0f);
+    manual_control.buttons = input.buttons;
+
+    Slot slot {};
+    mavlink_msg_manual_control_encode(GCSClient::system_id, GCSClient::component_id,
+                                      &slot.message, &manual_control);
+
+    std::lock_guard<std::mutex> lock(_input_mutex);
+    slot.seq = ++_input_seq;
+    slot.set_time_ns = now_ns();
+    _slot.store(slot);
+}
+
+void ManualControlImpl::start_streaming(float rate_hz)
+{
+    std::lock_guard<std::mutex> lock(_streamer_mutex);
+    if (_streamer) {
+        // Restarted with the new rate.
+        _streamer->stop();
+    }
+
+    // The thread is stopped, so nothing else touches these.
+    _latency_stats.store(LatencyStats {});
+    _last_seq_sent = 0;
+    _sum_latency_us = 0.0;
+
+    _streamer.reset(new SetpointStreamer([this]() { send_input(); }, double(rate_hz)));
+    _streamer->start();
+}
+
+void ManualControlImpl::stop_streaming()
+{
+    std::unique_ptr<SetpointStreamer> streamer {};
+    {
+        std::lock_guard<std::mutex> lock(_streamer_mutex);
+        streamer = std::move(_streamer);
+    }
+    // Waits for the thread, outside of the lock.
+    streamer.reset();
+}
+
+ManualControl::StreamingStats ManualControlImpl::get_streaming_stats() const
+{
+    std::lock_guard<std::mutex> lock(_streamer_mutex);
+    if (!_streamer) {
+        return ManualControl::StreamingStats {};
+    }
+    const SetpointStreamer::Stats stats = _streamer->get_stats();
+    const LatencyStats latency_stats = _latency_stats.load();
+
+    ManualControl::StreamingStats streaming_stats {};
+    streaming_stats.num_sent = stats.num_sent;
+    streaming_stats.num_missed = stats.num_missed;
+    streaming_stats.mean_jitter_us = stats.mean_jitter_us;
+    streaming_stats.max_jitter_us = stats.max_jitter_us;
+    streaming_stats.num_inputs = latency_stats.num_inputs;
+    streaming_stats.mean_latency_us = latency_stats.mean_latency_us;
+    streaming_stats.max_latency_us = latency_stats.max_latency_us;
+    streaming_stats.realtime_priority = stats.realtime_priority;
+    return streaming_stats;
+}
+
+void ManualControlImpl::send_input()
+{
+    Slot slot = _slot.load();
+    if (slot.seq == 0) {
+        return;
+    }
+
+    // A new sequence number for every message, also when the input is repeated.
+    mavlink_finalize_message(&slot.message, GCSClient::system_id, GCSClient::component_id,
+                             MAVLINK_MSG_ID_MANUAL_CONTROL_MIN_LEN,
+                             MAVLINK_MSG_ID_MANUAL_CONTROL_LEN,
+                             MAVLINK_MSG_ID_MANUAL_CONTROL_CRC);
+    _parent->send_message(slot.message);
+
+    if (slot.seq == _last_seq_sent) {
+        return;
+    }
+    _last_seq_sent = slot.seq;
+
+    const double latency_us = double(std::max(now_ns() - slot.set_time_ns, int64_t(0))) * 1e-3;
+    LatencyStats latency_stats = _latency_stats.load();
+    ++latency_stats.num_inputs;
+    _sum_latency_us += latency_us;
+    latency_stats.mean_latency_us = _sum_latency_us / double(latency_stats.num_inputs);
+    latency_stats.max_latency_us = std::max(latency_stats.max_latency_us, latency_us);
+    _latency_stats.store(latency_stats);
+}
+
+int16_t ManualControlImpl::to_axis(float value, float min)
+{
+    if (!std::isfinite(value)) {
+        value = 0.0f;
+    }
+    // MANUAL_CONTROL axes go from -1000 to 1000.
+    return int16_t(std::lround(std::min(std::max(value, min), 1.0f) * 1000.0f));
+}
+
+int64_t ManualControlImpl::now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace dronecore
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include "plugin_impl_base.h"
+#include "mavlink_include.h"
+#include "system.h"
+#include "mavlink_system.h"
+#include "manual_control.h"
+#include "setpoint_streamer.h"
+#include "seqlock.h"
+
+namespace dronecore {
+
+class ManualControlImpl : public PluginImplBase
+{
+public:
+    ManualControlImpl(System &system);
+    ~ManualControlImpl();
+
+    void init() override;
+    void deinit() override;
+
+    void enable() override;
+    void disable() override;
+
+    void set_input(ManualControl::Input input);
+
+    void start_streaming(float rate_hz);
+    void stop_streaming();
+    ManualControl::StreamingStats get_streaming_stats() const;
+
+    // Non-copyable
+    ManualControlImpl(const ManualControlImpl &) = delete;
+    const ManualControlImpl &operator=(const ManualControlImpl &) = delete;
+
+private:
+    // Called by the streamer thread only.
+    void send_input();
+
+    static int16_t to_axis(float value, float min);
+    static int64_t now_ns();
+
+    // Packed when the input is set, sending only finalizes it again for the
+    // sequence number.
+    struct Slot {
+        // 0 until the first input is set.
+        uint64_t seq;
+        int64_t set_time_ns;
+        mavlink_message_t message;
+    };
+    // Handed from the user's thread to the sending one without a lock, neither
+    // ever waits for the other.
+    SeqLock<Slot> _slot {Slot {0, 0, mavlink_message_t {}}};
+    // Only to number the inputs, set_input() can be called from several threads.
+    std::mutex _input_mutex {};
+    uint64_t _input_seq = 0;
+
+    struct LatencyStats {
+        uint64_t num_inputs;
+        double mean_latency_us;
+        double max_latency_us;
+    };
+    // Written by the streamer thread only.
+    SeqLock<LatencyStats> _latency_stats {LatencyStats {}};
+    uint64_t _last_seq_sent = 0;
+    double _sum_latency_us = 0.0;
+
+    // Not held while sending, stopping the streamer waits for its thread.
+    mutable std::mutex _streamer_mutex {};
+    std::unique_ptr<SetpointStreamer> _streamer {};
+};
+
+} // namespace dronecore
@@ -1,5 +1,7 @@
 #include "mission.h"
 #include "mission_impl.h"
+#include "mission_fleet_upload.h"
+#include "mission_analysis.h"
 #include <vector>
 #include "mavlink_include.h"
 
@@ -16,17 +18,89 @@ Mission::~Mission()
 }
 
 
+Mission::Result Mission::analyze_mission(const mission_items_t &mission_items,
+                                         Analysis &analysis)
+{
+    return MissionAnalysis::analyze(mission_items, 0, mission_items.size(), analysis)
+           ? Result::SUCCESS : Result::INVALID_ARGUMENT;
+}
+
+Mission::Result Mission::update_mission_analysis(const mission_items_t &mission_items,
+                                                 size_t first_changed, size_t num_changed,
+                                                 Analysis &analysis)
+{
+    return MissionAnalysis::analyze(mission_items, first_changed, num_changed, analysis)
+           ? Result::SUCCESS : Result::INVALID_ARGUMENT;
+}
+
 void Mission::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
                                    result_callback_t callback)
 {
     _impl->upload_mission_async(mission_items, callback);
 }
 
+void Mission::update_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+                                   result_callback_t callback)
+{
+    _impl->update_mission_async(mission_items, callback);
+}
+
+void Mission::upload_mission_to_fleet_async(const std::vector<Mission *> &missions,
+                                            const mission_items_t &mission_items,
+                                            fleet_result_callback_t callback,
+                                            fleet_progress_callback_t progress_callback,
+                                            unsigned max_concurrent)
+{
+    std::vector<MissionImpl *> impls;
+    impls.reserve(missions.size());
+    for (auto mission : missions) {
+        impls.push_back(mission->_impl.get());
+    }
+
+    MissionFleetUpload::start(impls, mission_items, callback, progress_callback, max_concurrent);
+}
+
+void Mission::upload_survey_async(const Survey &survey, result_callback_t callback)
+{
+    _impl->upload_survey_async(survey, callback);
+}
+
+void Mission::upload_mission_file_async(const std::string &path, result_callback_t callback)
+{
+    _impl->upload_mission_file_async(path, callback);
+}
+
 void Mission::download_mission_async(Mission::mission_items_and_result_callback_t callback)
 {
     _impl->download_mission_async(callback);
 }
 
+Mission::Result Mission::save_downloaded_mission_file(const std::string &path) const
+{
+    return _impl->save_downloaded_mission_file(path);
+}
+
+void Mission::upload_geofence_async(const Geofence &geofence, result_callback_t callback)
+{
+    _impl->upload_geofence_async(geofence, callback);
+}
+
+void Mission::download_geofence_async(geofence_and_result_callback_t callback)
+{
+    _impl->download_geofence_async(callback);
+}
+
+void Mission::upload_rally_points_async(const std::vector<RallyPoint> &rally_points,
+                                        result_callback_t callback)
+{
+    _impl->upload_rally_points_async(rally_points, callback);
+}
+
+void Mission::download_rally_points_async(rally_points_and_result_callback_t callback)
+{
+    _impl->download_rally_points_async(callback);
+}
+
 void Mission::start_mission_async(result_callback_t callback)
 {
     _impl->start_mission_async(callback);
@@ -70,6 +144,10 @@ const char *Mission::result_str(Result result)
             return "Failed to parse QGC plan";
         case Result::UNSUPPORTED_MISSION_CMD:
             return "Unsupported Mission command";
+        case Result::FAILED_TO_OPEN_MISSION_FILE:
+            return "Failed to open mission file";
+        case Result::FAILED_TO_PARSE_MISSION_FILE:
+            return "Failed to parse mission file";
         case Result::UNKNOWN:
         default:
             return "Unknown";
@@ -97,4 +175,10 @@ Mission::Result Mission::import_qgroundcontrol_mission(Mission::mission_items_t
     return MissionImpl::import_qgroundcontrol_mission(mission_items, qgc_plan_file);
 }
 
+Mission::Result Mission::save_mission_file(const Mission::mission_items_t &mission_items,
+                                           const std::string &path)
+{
+    return MissionImpl::save_mission_file(mission_items, path);
+}
+
 } // namespace dronelin
@@ -50,7 +50,9 @@ public:
         NO_MISSION_AVAILABLE, /**< @brief No mission available on system. */
         FAILED_TO_OPEN_QGC_PLAN, /**< @brief Failed to open QGroundControl plan */
         FAILED_TO_PARSE_QGC_PLAN, /**< @brief Failed to parse QGroundControl plan */
-        UNSUPPORTED_MISSION_CMD /**< @brief Unsupported mission command */
+        UNSUPPORTED_MISSION_CMD, /**< @brief Unsupported mission command */
+        FAILED_TO_OPEN_MISSION_FILE, /**< @brief Failed to open or write mission file */
+        FAILED_TO_PARSE_MISSION_FILE /**< @brief Mission file is corrupt or of an unknown version */
     };
 
     /**
@@ -89,18 +91,212 @@ public:
     static Result import_qgroundcontrol_mission(mission_items_t &mission_items,
                                                 const std::string &qgc_plan_file);
 
+    /**
+     * @brief Saves mission items to a binary mission file.
+     *
+     * The file holds the items as they are sent to the vehicle, so it can be uploaded
+     * with `upload_mission_file_async()` without converting anything. This is meant for
+     * very large missions, for which a QGC plan is slow to write and read.
+     *
+     * @param mission_items Reference to vector of mission items.
+     * @param path File path of the mission file, it is overwritten if it exists.
+     * @return Result::SUCCESS if the file was written, Result::FAILED_TO_OPEN_MISSION_FILE
+     *     otherwise.
+     */
+    static Result save_mission_file(const mission_items_t &mission_items,
+                                    const std::string &path);
+
+    /**
+     * @brief Estimates of a mission before flying it, see `analyze_mission()`.
+     */
+    struct Analysis {
+        /**
+         * @brief Estimates up to one mission item.
+         */
+        struct Item {
+            /** @brief Distance from the previous item with a position, 0 without position. */
+            double segment_distance_m;
+            double distance_m; /**< @brief Distance from the first item to this one. */
+            double arrival_time_s; /**< @brief Time from the first item until arriving here. */
+            /** @brief Photos taken before arriving here, not counting the action of this item. */
+            unsigned photos;
+        };
+
+        /** @brief Speed used until an item sets one, must be positive. */
+        float default_speed_m_s {5.0f};
+
+        std::vector<Item> items {}; /**< @brief One for each mission item, in order. */
+        double distance_m {0.0}; /**< @brief Distance of the whole mission. */
+        double time_s {0.0}; /**< @brief Time until leaving the last item. */
+        unsigned photos {0}; /**< @brief Photos taken during the whole mission. */
+    };
+
+    /**
+     * @brief Estimates distance, time and photos of mission items.
+     *
+     * Distances are flown straight from item to item, including altitude changes, at the
+     * speed set by the items before and without accelerating. Loiter times are added, and
+     * photos are counted for single photos and for photo intervals while they are running.
+     *
+     * Large missions are spread over several threads.
+     *
+     * @param mission_items Reference to vector of mission items.
+     * @param[in,out] analysis The estimates, `default_speed_m_s` is used as set.
+     * @return Result::SUCCESS, or Result::INVALID_ARGUMENT if an item is missing or the
+     *     default speed is not positive.
+     */
+    static Result analyze_mission(const mission_items_t &mission_items, Analysis &analysis);
+
+    /**
+     * @brief Updates the estimates of `analyze_mission()` after some items were changed.
+     *
+     * Only the distances of the changed items and their neighbours are calculated again,
+     * the rest is carried over. If the number of items changed, the whole mission is
+     * analyzed again.
+     *
+     * @param mission_items Reference to vector of mission items, with the changes.
+     * @param first_changed Index of the first item changed.
+     * @param num_changed Number of items changed from there on.
+     * @param[in,out] analysis The estimates of the mission before the change.
+     * @return Result::SUCCESS, or Result::INVALID_ARGUMENT if an item is missing or the
+     *     default speed is not positive.
+     */
+    static Result update_mission_analysis(const mission_items_t &mission_items,
+                                          size_t first_changed, size_t num_changed,
+                                          Analysis &analysis);
+
     /**
      * @brief Uploads a vector of mission items to the system (asynchronous).
      *
      * The mission items are uploaded to a drone. Once uploaded the mission can be started and
      * executed even if a connection is lost.
      *
+     * The mission items are copied when this is called, changing them afterwards does not
+     * affect the upload.
+     *
      * @param mission_items Reference to vector of mission items.
      * @param callback Callback to receive result of this request.
      */
     void upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
                               result_callback_t callback);
 
+    /**
+     * @brief Updates the mission on the system to a vector of mission items (asynchronous).
+     *
+     * The mission items are compared to the mission last uploaded to or downloaded from
+     * the system, and only the items that changed are sent, using partial writes. This is
+     * much faster than `upload_mission_async()` on slow links when only a few items
+     * were changed.
+     *
+     * If no mission is known for the system yet, or the number of items sent over the
+     * link would change, the whole mission is uploaded instead.
+     *
+     * @param mission_items Reference to vector of mission items.
+     * @param callback Callback to receive result of this request.
+     */
+    void update_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+                              result_callback_t callback);
+
+    /**
+     * @brief Callback type for `upload_mission_to_fleet_async()`.
+     *
+     * @param results Result for each of the Mission plugins, in the order they were given.
+     */
+    typedef std::function<void(std::vector<Result> results)> fleet_result_callback_t;
+
+    /**
+     * @brief Callback type to receive the progress of `upload_mission_to_fleet_async()`.
+     *
+     * @param items_sent Mission items sent so far, summed over all systems.
+     * @param items_total Mission items to send to all systems together.
+     */
+    typedef std::function<void(int items_sent, int items_total)> fleet_progress_callback_t;
+
+    /**
+     * @brief Uploads the same mission to several systems at once (asynchronous).
+     *
+     * The mission is converted into MAVLink messages only once and shared by all uploads.
+     * Messages to systems on the same link are queued one after another, so every upload
+     * gets its share of the link.
+     *
+     * The Mission plugins need to stay alive until the callback has been called.
+     *
+     * @param missions The Mission plugins of the systems to upload to.
+     * @param mission_items Vector of mission items.
+     * @param callback Callback receiving a result for every system once all are done.
+     * @param progress_callback Callback receiving the progress summed over all systems, can be
+     *     nullptr.
+     * @param max_concurrent Most uploads to run at the same time, the next one starts when one
+     *     is done. 0 starts all of them right away.
+     */
+    static void upload_mission_to_fleet_async(const std::vector<Mission *> &missions,
+                                              const mission_items_t &mission_items,
+                                              fleet_result_callback_t callback,
+                                              fleet_progress_callback_t progress_callback,
+                                              unsigned max_concurrent = 0);
+
+    /**
+     * @brief Area to cover with a lawnmower pattern, see `upload_survey_async()`.
+     */
+    struct Survey {
+        /**
+         * @brief Corner of the area.
+         */
+        struct Vertex {
+            double latitude_deg; /**< @brief Latitude in degrees (range: -90 to +90). */
+            double longitude_deg; /**< @brief Longitude in degrees (range: -180 to +180). */
+        };
+
+        std::vector<Vertex> polygon {}; /**< @brief Corners of the area, in order. */
+        double line_spacing_m {20.0}; /**< @brief Distance between the survey lines. */
+        /** @brief Altitude above takeoff, or above the terrain if `terrain_tile_dir` is set. */
+        float relative_altitude_m {30.0f};
+        double heading_deg {0.0}; /**< @brief Direction of the lines, 0 is north. */
+        /** @brief Camera trigger distance along the lines, 0 to take no pictures. */
+        double trigger_distance_m {0.0};
+        /**
+         * @brief Directory with SRTM tiles (.hgt files, e.g. N47E008.hgt) to follow the
+         * terrain, empty to fly at a constant altitude above takeoff.
+         */
+        std::string terrain_tile_dir {};
+        /** @brief When following the terrain, the longest distance between waypoints. */
+        double terrain_spacing_m {50.0};
+    };
+
+    /**
+     * @brief Generates a survey of an area and uploads it to the system (asynchronous).
+     *
+     * The area is covered by parallel lines flown in alternating directions. Where the
+     * polygon is concave, a line can be split into several parts. If a trigger distance is
+     * set, the camera is triggered along each line and stopped at its end.
+     *
+     * To follow the terrain, the lines get waypoints at least every `terrain_spacing_m`. Their
+     * altitudes are then above mean sea level: the terrain elevation interpolated from the
+     * tiles plus `relative_altitude_m`.
+     *
+     * The items are generated directly as they are sent to the vehicle, spread over several
+     * threads for large areas, without creating any MissionItem. Each of them counts as one mission
+     * item for `current_mission_item()` and `total_mission_items()`.
+     *
+     * @param survey The area and pattern to fly.
+     * @param callback Callback to receive result of this request, Result::INVALID_ARGUMENT
+     *     if the survey has fewer than three corners, no positive line spacing or no line
+     *     fits into it, or if terrain is missing for any of the waypoints.
+     */
+    void upload_survey_async(const Survey &survey, result_callback_t callback);
+
+    /**
+     * @brief Uploads a binary mission file to the system (asynchronous).
+     *
+     * The items of the file are sent as they are. Each of them counts as one mission item
+     * for `current_mission_item()` and `total_mission_items()`.
+     *
+     * @param path File path of a mission file written by `save_mission_file()` or
+     *     `save_downloaded_mission_file()`.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_mission_file_async(const std::string &path, result_callback_t callback);
+
     /**
      * @brief Callback type for `download_mission_async()` call to get mission items and result.
      */
@@ -113,10 +309,116 @@ public:
      * The method will fail if any of the downloaded mission items are not supported
      * by the DroneCore API.
      *
+     * If the autopilot reports an opaque mission id and it matches the one of the mission
+     * downloaded from the same vehicle before, the cached copy is used instead of
+     * transferring the mission again.
+     *
      * @param callback Callback to receive mission items and result of this request.
      */
     void download_mission_async(mission_items_and_result_callback_t callback);
 
+    /**
+     * @brief Saves the mission last downloaded from the system to a binary mission file.
+     *
+     * Unlike the mission items reported by `download_mission_async()`, this includes items
+     * which are not supported by the DroneCore API.
+     *
+     * @param path File path of the mission file, it is overwritten if it exists.
+     * @return Result::SUCCESS if the file was written, Result::NO_MISSION_AVAILABLE if nothing
+     *     was downloaded yet, Result::FAILED_TO_OPEN_MISSION_FILE otherwise.
+     */
+    Result save_downloaded_mission_file(const std::string &path) const;
+
+    /**
+     * @brief Areas the vehicle needs to stay in or out of, see `upload_geofence_async()`.
+     */
+    struct Geofence {
+        /**
+         * @brief Corner of a polygon.
+         */
+        struct Vertex {
+            double latitude_deg; /**< @brief Latitude in degrees (range: -90 to +90). */
+            double longitude_deg; /**< @brief Longitude in degrees (range: -180 to +180). */
+        };
+
+        /**
+         * @brief Polygon of the geofence.
+         */
+        struct Polygon {
+            /**
+             * @brief Which side of the polygon the vehicle needs to stay on.
+             */
+            enum class Type {
+                INCLUSION, /**< @brief The vehicle needs to stay inside. */
+                EXCLUSION /**< @brief The vehicle needs to stay outside. */
+            };
+
+            Type type {Type::INCLUSION}; /**< @brief Inclusion or exclusion. */
+            std::vector<Vertex> vertices {}; /**< @brief Corners, in order, at least three. */
+        };
+
+        std::vector<Polygon> polygons {}; /**< @brief All polygons of the geofence. */
+    };
+
+    /**
+     * @brief Place to return to instead of home, see `upload_rally_points_async()`.
+     */
+    struct RallyPoint {
+        double latitude_deg; /**< @brief Latitude in degrees (range: -90 to +90). */
+        double longitude_deg; /**< @brief Longitude in degrees (range: -180 to +180). */
+        float relative_altitude_m; /**< @brief Altitude above takeoff. */
+    };
+
+    /**
+     * @brief Uploads a geofence to the system, replacing the one on it (asynchronous).
+     *
+     * The geofence, the rally points and the mission are transferred independently, an
+     * upload or download of each of them can run at the same time as the others.
+     *
+     * @param geofence The polygons of the geofence, none to clear it.
+     * @param callback Callback to receive result of this request, Result::INVALID_ARGUMENT if
+     *     a polygon has fewer than three corners.
+     */
+    void upload_geofence_async(const Geofence &geofence, result_callback_t callback);
+
+    /**
+     * @brief Callback type for `download_geofence_async()`.
+     */
+    typedef std::function<void(Result, Geofence)> geofence_and_result_callback_t;
+
+    /**
+     * @brief Downloads the geofence from the system (asynchronous).
+     *
+     * Like the mission, the geofence isn't transferred again if the autopilot reports the
+     * same opaque id as for the one downloaded from the same vehicle before.
+     *
+     * @param callback Callback to receive the geofence and result of this request,
+     *     Result::UNSUPPORTED if it contains anything but polygons.
+     */
+    void download_geofence_async(geofence_and_result_callback_t callback);
+
+    /**
+     * @brief Uploads rally points to the system, replacing the ones on it (asynchronous).
+     *
+     * @param rally_points The rally points, none to clear them.
+     * @param callback Callback to receive result of this request.
+     */
+    void upload_rally_points_async(const std::vector<RallyPoint> &rally_points,
+                                   result_callback_t callback);
+
+    /**
+     * @brief Callback type for `download_rally_points_async()`.
+     */
+    typedef std::function<void(Result, std::vector<RallyPoint>)>
+    rally_points_and_result_callback_t;
+
+    /**
+     * @brief Downloads the rally points from the system (asynchronous).
+     *
+     * @param callback Callback to receive the rally points and result of this request.
+     */
+    void download_rally_points_async(rally_points_and_result_callback_t callback);
+
     /**
      * @brief Starts the mission (asynchronous).
      *
@@ -0,0 +1,191 @@
+#include "mission_analysis.h"
+#include "geo.h"
+#include "thread_setup.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace dronecore {
+
+constexpr size_t MissionAnalysis::MIN_ITEMS_PER_THREAD;
+
+bool MissionAnalysis::analyze(const Mission::mission_items_t &mission_items,
+                              size_t first_changed, size_t num_changed,
+                              Mission::Analysis &analysis, unsigned num_threads)
+{
+    if (!(analysis.default_speed_m_s > 0.0f)) {
+        return false;
+    }
+    for (const auto &item : mission_items) {
+        if (!item) {
+            return false;
+        }
+    }
+
+    const size_t num_items = mission_items.size();
+    size_t begin = std::min(first_changed, num_items);
+    size_t end = begin + std::min(num_changed, num_items - begin);
+
+    if (analysis.items.size() != num_items) {
+        analysis.items.assign(num_items, Mission::Analysis::Item {0.0, 0.0, 0.0, 0});
+        begin = 0;
+        end = num_items;
+    } else {
+        // The next item with a position is measured from one which changed.
+        while (end < num_items && !has_position(*mission_items[end])) {
+            ++end;
+        }
+        if (end < num_items) {
+            ++end;
+        }
+    }
+
+    calculate_segments_in_parallel(mission_items, begin, end, analysis, num_threads);
+    sum_up(mission_items, analysis);
+    return true;
+}
+
+void MissionAnalysis::calculate_segments_in_parallel(const Mission::mission_items_t
+                                                     &mission_items,
+                                                     size_t begin, size_t end,
+                                                     Mission::Analysis &analysis,
+                                                     unsigned num_threads)
+{
+    if (num_threads == 0) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    const size_t num_items = end - begin;
+    num_threads = unsigned(std::max(size_t(1), std::min(size_t(num_threads),
+                                                        num_items / MIN_ITEMS_PER_THREAD)));
+
+    const size_t items_per_thread = (num_items + num_threads - 1) / num_threads;
+    std::vector<std::thread> threads;
+
+    // The first block is done on this thread, each block sets its own items only.
+    for (unsigned i = 1; i < num_threads; ++i) {
+        const size_t block_begin = std::min(begin + i * items_per_thread, end);
+        const size_t block_end = std::min(block_begin + items_per_thread, end);
+        threads.push_back(std::thread([&, block_begin, block_end]() {
+            setup_thread(ThreadRole::Background, "analysis");
+            calculate_segments(mission_items, block_begin, block_end, analysis);
+        }));
+    }
+    calculate_segments(mission_items, begin, std::min(begin + items_per_thread, end), analysis);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+void MissionAnalysis::calculate_segments(const Mission::mission_items_t &mission_items,
+                                         size_t begin, size_t end,
+                                         Mission::Analysis &analysis)
+{
+    // The previous position can be in the block before.
+    const MissionItem *previous = nullptr;
+    for (size_t i = begin; i > 0; --i) {
+        if (has_position(*mission_items[i - 1])) {
+            previous = mission_items[i - 1].get();
+            break;
+        }
+    }
+
+    for (size_t i = begin; i < end; ++i) {
+        const MissionItem &item = *mission_items[i];
+        double segment_distance_m = 0.0;
+
+        if (has_position(item)) {
+            if (previous != nullptr) {
+                segment_distance_m = haversine_distance_m(previous->get_latitude_deg(),
+                                                          previous->get_longitude_deg(),
+                                                          item.get_latitude_deg(),
+                                                          item.get_longitude_deg());
+                const float climb_m = item.get_relative_altitude_m() -
+                                      previous->get_relative_altitude_m();
+                if (std::isfinite(climb_m)) {
+                    segment_distance_m = std::sqrt(segment_distance_m * segment_distance_m +
+                                                   double(climb_m * climb_m));
+                }
+            }
+            previous = &item;
+        }
+
+        analysis.items[i].segment_distance_m = segment_distance_m;
+    }
+}
+
+void MissionAnalysis::sum_up(const Mission::mission_items_t &mission_items,
+                             Mission::Analysis &analysis)
+{
+    double distance_m = 0.0;
+    double time_s = 0.0;
+    unsigned photos = 0;
+    float speed_m_s = analysis.default_speed_m_s;
+
+    // A photo interval takes one right away and then one every interval.
+    bool interval_running = false;
+    double interval_start_s = 0.0;
+    double interval_s = 0.0;
+    auto interval_photos = [&]() {
+        return 1 + unsigned(std::floor((time_s - interval_start_s) / interval_s));
+    };
+
+    for (size_t i = 0; i < mission_items.size(); ++i) {
+        const MissionItem &item = *mission_items[i];
+        Mission::Analysis::Item &result = analysis.items[i];
+
+        distance_m += result.segment_distance_m;
+        time_s += result.segment_distance_m / double(speed_m_s);
+        result.distance_m = distance_m;
+        result.arrival_time_s = time_s;
+        result.photos = photos + (interval_running ? interval_photos() : 0);
+
+        switch (item.get_camera_action()) {
+            case MissionItem::CameraAction::TAKE_PHOTO:
+                ++photos;
+                break;
+            case MissionItem::CameraAction::START_PHOTO_INTERVAL:
+                if (interval_running) {
+                    photos += interval_photos();
+                }
+                interval_s = item.get_camera_photo_interval_s();
+                interval_running = (interval_s > 0.0);
+                interval_start_s = time_s;
+                break;
+            case MissionItem::CameraAction::STOP_PHOTO_INTERVAL:
+                if (interval_running) {
+                    photos += interval_photos();
+                    interval_running = false;
+                }
+                break;
+            default:
+                break;
+        }
+
+        const float loiter_time_s = item.get_loiter_time_s();
+        if (loiter_time_s > 0.0f) {
+            time_s += double(loiter_time_s);
+        }
+
+        // The speed is used after the item.
+        const float item_speed_m_s = item.get_speed_m_s();
+        if (item_speed_m_s > 0.0f) {
+            speed_m_s = item_speed_m_s;
+        }
+    }
+
+    if (interval_running) {
+        photos += interval_photos();
+    }
+
+    analysis.distance_m = distance_m;
+    analysis.time_s = time_s;
+    analysis.photos = photos;
+}
+
+bool MissionAnalysis::has_position(const MissionItem &item)
+{
+    return std::isfinite(item.get_latitude_deg()) && std::isfinite(item.get_longitude_deg());
+}
+
+} // namespace dronecore
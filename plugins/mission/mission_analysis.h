@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include "mission.h"
+
+namespace dronecore {
+
+// Estimates of a mission, see Mission::analyze_mission().
+//
+// The distances between items need trigonometry and are independent of each
+// other, so they are calculated in blocks on separate threads for large missions
+// and only for the changed items when updating. Times and photos depend on the
+// items before, they are summed up on one thread afterwards, which is cheap.
+class MissionAnalysis
+{
+public:
+    // Analyzes the items first_changed to first_changed + num_changed and sums up
+    // all of them. Everything is analyzed if the number of items doesn't match.
+    // Returns false if an item is nullptr or the default speed is not positive.
+    // With num_threads 0, as many threads as the hardware supports are used.
+    static bool analyze(const Mission::mission_items_t &mission_items,
+                        size_t first_changed, size_t num_changed,
+                        Mission::Analysis &analysis, unsigned num_threads = 0);
+
+private:
+    // Sets the segment distances of the items begin to end.
+    static void calculate_segments(const Mission::mission_items_t &mission_items,
+                                   size_t begin, size_t end, Mission::Analysis &analysis);
+    static void calculate_segments_in_parallel(const Mission::mission_items_t &mission_items,
+                                               size_t begin, size_t end,
+                                               Mission::Analysis &analysis,
+                                               unsigned num_threads);
+    static void sum_up(const Mission::mission_items_t &mission_items,
+                       Mission::Analysis &analysis);
+
+    static bool has_position(const MissionItem &item);
+
+    // Below this, spreading the items over threads costs more than it saves.
+    static constexpr size_t MIN_ITEMS_PER_THREAD = 4096;
+};
+
+} // namespace dronecore
@@ -0,0 +1,136 @@
+#include "mission_analysis.h"
+#include "geo.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+static std::shared_ptr<MissionItem> make_item(double latitude_deg, double longitude_deg,
+                                              float relative_altitude_m)
+{
+    auto item = std::make_shared<MissionItem>();
+    item->set_position(latitude_deg, longitude_deg);
+    item->set_relative_altitude(relative_altitude_m);
+    return item;
+}
+
+// A line north, one item every 0.001 degrees (about 111 m).
+static Mission::mission_items_t make_line(unsigned num_items)
+{
+    Mission::mission_items_t items;
+    for (unsigned i = 0; i < num_items; ++i) {
+        items.push_back(make_item(47.0 + 0.001 * i, 8.0, 10.0f));
+    }
+    return items;
+}
+
+static void expect_same(const Mission::Analysis &a, const Mission::Analysis &b)
+{
+    ASSERT_EQ(a.items.size(), b.items.size());
+    for (size_t i = 0; i < a.items.size(); ++i) {
+        EXPECT_DOUBLE_EQ(a.items[i].segment_distance_m, b.items[i].segment_distance_m);
+        EXPECT_DOUBLE_EQ(a.items[i].distance_m, b.items[i].distance_m);
+        EXPECT_DOUBLE_EQ(a.items[i].arrival_time_s, b.items[i].arrival_time_s);
+        EXPECT_EQ(a.items[i].photos, b.items[i].photos);
+    }
+    EXPECT_DOUBLE_EQ(a.distance_m, b.distance_m);
+    EXPECT_DOUBLE_EQ(a.time_s, b.time_s);
+    EXPECT_EQ(a.photos, b.photos);
+}
+
+TEST(MissionAnalysis, DistanceAndTime)
+{
+    auto items = make_line(3);
+    items[1]->set_relative_altitude(110.0f);
+    items[1]->set_speed(10.0f);
+    items[1]->set_loiter_time(30.0f);
+    // Without position, it is where the previous item was.
+    items.push_back(std::make_shared<MissionItem>());
+
+    Mission::Analysis analysis;
+    analysis.default_speed_m_s = 5.0f;
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), analysis));
+    ASSERT_EQ(analysis.items.size(), 4u);
+
+    const double north_m = 0.001 * M_PI / 180.0 * EARTH_RADIUS_M;
+    const double climb_m = std::sqrt(north_m * north_m + 100.0 * 100.0);
+
+    EXPECT_DOUBLE_EQ(analysis.items[0].segment_distance_m, 0.0);
+    EXPECT_DOUBLE_EQ(analysis.items[0].arrival_time_s, 0.0);
+    EXPECT_NEAR(analysis.items[1].segment_distance_m, climb_m, 1e-6);
+    EXPECT_NEAR(analysis.items[1].arrival_time_s, climb_m / 5.0, 1e-6);
+    EXPECT_NEAR(analysis.items[2].segment_distance_m, climb_m, 1e-6);
+    EXPECT_NEAR(analysis.items[2].arrival_time_s, climb_m / 5.0 + 30.0 + climb_m / 10.0, 1e-6);
+    EXPECT_DOUBLE_EQ(analysis.items[3].segment_distance_m, 0.0);
+    EXPECT_NEAR(analysis.distance_m, 2.0 * climb_m, 1e-6);
+    EXPECT_DOUBLE_EQ(analysis.time_s, analysis.items[3].arrival_time_s);
+}
+
+TEST(MissionAnalysis, Photos)
+{
+    auto items = make_line(5);
+    items[0]->set_camera_action(MissionItem::CameraAction::TAKE_PHOTO);
+    items[1]->set_camera_action(MissionItem::CameraAction::START_PHOTO_INTERVAL);
+    items[1]->set_camera_photo_interval(2.0);
+    items[3]->set_camera_action(MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
+
+    Mission::Analysis analysis;
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), analysis));
+
+    const double interval_time_s = analysis.items[3].arrival_time_s -
+                                   analysis.items[1].arrival_time_s;
+    const unsigned interval_photos = 1 + unsigned(std::floor(interval_time_s / 2.0));
+
+    EXPECT_EQ(analysis.items[0].photos, 0u);
+    EXPECT_EQ(analysis.items[1].photos, 1u);
+    const double to_item_2_s = analysis.items[2].arrival_time_s -
+                               analysis.items[1].arrival_time_s;
+    EXPECT_EQ(analysis.items[2].photos, 1u + 1u + unsigned(std::floor(to_item_2_s / 2.0)));
+    EXPECT_EQ(analysis.items[4].photos, 1u + interval_photos);
+    EXPECT_EQ(analysis.photos, 1u + interval_photos);
+}
+
+TEST(MissionAnalysis, UpdateMatchesFullAnalysis)
+{
+    auto items = make_line(100);
+    Mission::Analysis updated;
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), updated));
+
+    items[40] = make_item(47.2, 8.1, 50.0f);
+    items[41] = std::make_shared<MissionItem>();
+    items[41]->set_speed(12.0f);
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 40, 2, updated));
+
+    Mission::Analysis full;
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), full));
+    expect_same(updated, full);
+
+    // A different number of items is analyzed completely.
+    items.pop_back();
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, 0, updated));
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), full));
+    expect_same(updated, full);
+}
+
+TEST(MissionAnalysis, ThreadsGiveSameResult)
+{
+    const auto items = make_line(20000);
+
+    Mission::Analysis one_thread;
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), one_thread, 1));
+    Mission::Analysis four_threads;
+    ASSERT_TRUE(MissionAnalysis::analyze(items, 0, items.size(), four_threads, 4));
+    expect_same(one_thread, four_threads);
+}
+
+TEST(MissionAnalysis, InvalidArguments)
+{
+    auto items = make_line(2);
+    Mission::Analysis analysis;
+    analysis.default_speed_m_s = 0.0f;
+    EXPECT_FALSE(MissionAnalysis::analyze(items, 0, items.size(), analysis));
+
+    analysis.default_speed_m_s = 5.0f;
+    items.push_back(nullptr);
+    EXPECT_FALSE(MissionAnalysis::analyze(items, 0, items.size(), analysis));
+}
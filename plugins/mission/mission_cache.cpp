@@ -0,0 +1,89 @@
+#include "mission_cache.h"
+
+namespace dronecore {
+
+MissionCache &MissionCache::instance()
+{
+    static MissionCache cache;
+    return cache;
+}
+
+void MissionCache::store(uint64_t uuid, uint32_t opaque_id,
+                         const std::vector<mavlink_mission_item_int_t> &items,
+                         uint8_t mission_type)
+{
+    if (uuid == 0 || opaque_id == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry &entry = _entries[key_t(uuid, mission_type)];
+    entry.opaque_id = opaque_id;
+    entry.crc = crc32(items);
+    entry.items = items;
+}
+
+bool MissionCache::lookup(uint64_t uuid, uint32_t opaque_id, unsigned count,
+                          std::vector<mavlink_mission_item_int_t> &items,
+                          uint8_t mission_type) const
+{
+    if (uuid == 0 || opaque_id == 0) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(key_t(uuid, mission_type));
+    if (it == _entries.end()) {
+        return false;
+    }
+
+    const Entry &entry = it->second;
+    if (entry.opaque_id != opaque_id || entry.items.size() != count ||
+        crc32(entry.items) != entry.crc) {
+        return false;
+    }
+
+    items = entry.items;
+    return true;
+}
+
+void MissionCache::forget(uint64_t uuid, uint8_t mission_type)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.erase(key_t(uuid, mission_type));
+}
+
+template<typename T>
+static void crc_field(uint32_t &crc, const T &field)
+{
+    // Bitwise CRC-32 (IEEE 802.3), this only runs once per transfer.
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&field);
+    for (size_t i = 0; i < sizeof(field); ++i) {
+        crc ^= bytes[i];
+        for (unsigned bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+}
+
+uint32_t MissionCache::crc32(const std::vector<mavlink_mission_item_int_t> &items)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const auto &item : items) {
+        crc_field(crc, item.seq);
+        crc_field(crc, item.frame);
+        crc_field(crc, item.command);
+        crc_field(crc, item.autocontinue);
+        crc_field(crc, item.param1);
+        crc_field(crc, item.param2);
+        crc_field(crc, item.param3);
+        crc_field(crc, item.param4);
+        crc_field(crc, item.x);
+        crc_field(crc, item.y);
+        crc_field(crc, item.z);
+        crc_field(crc, item.mission_type);
+    }
+    return ~crc;
+}
+
+} // namespace dronecore
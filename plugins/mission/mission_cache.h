@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "mavlink_include.h"
+
+namespace dronecore {
+
+// Missions downloaded before, keyed by the UUID of the vehicle and the mission
+// type, so geofences and rally points are kept apart from it. An entry is
+// only served again if the autopilot reports the same opaque mission id, which
+// it changes whenever its mission changes. A CRC over the wire items guards
+// the cached copy itself.
+//
+// The cache lives as long as the process, so that it survives reconnects.
+class MissionCache
+{
+public:
+    static MissionCache &instance();
+
+    // Nothing is stored without an opaque id, there would be no way to tell
+    // whether the mission is still the same.
+    void store(uint64_t uuid, uint32_t opaque_id,
+               const std::vector<mavlink_mission_item_int_t> &items,
+               uint8_t mission_type = MAV_MISSION_TYPE_MISSION);
+
+    // Returns false unless there is an intact entry for the same opaque id and count.
+    bool lookup(uint64_t uuid, uint32_t opaque_id, unsigned count,
+                std::vector<mavlink_mission_item_int_t> &items,
+                uint8_t mission_type = MAV_MISSION_TYPE_MISSION) const;
+
+    void forget(uint64_t uuid, uint8_t mission_type = MAV_MISSION_TYPE_MISSION);
+
+    // CRC-32 over what the items do, leaving out targets and the current flag.
+    static uint32_t crc32(const std::vector<mavlink_mission_item_int_t> &items);
+
+private:
+    struct Entry {
+        uint32_t opaque_id;
+        uint32_t crc;
+        std::vector<mavlink_mission_item_int_t> items;
+    };
+
+    typedef std::pair<uint64_t, uint8_t> key_t;
+
+    mutable std::mutex _mutex {};
+    std::map<key_t, Entry> _entries {};
+};
+
+} // namespace dronecore
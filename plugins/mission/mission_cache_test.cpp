@@ -0,0 +1,86 @@
+#include "mission_cache.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+static std::vector<mavlink_mission_item_int_t> make_items(unsigned count)
+{
+    std::vector<mavlink_mission_item_int_t> items(count, mavlink_mission_item_int_t {});
+    for (unsigned i = 0; i < count; ++i) {
+        items[i].seq = i;
+        items[i].command = MAV_CMD_NAV_WAYPOINT;
+        items[i].x = 473977418 + int32_t(i);
+        items[i].y = 85455939;
+        items[i].z = 10.0f;
+    }
+    return items;
+}
+
+TEST(MissionCache, ServesSameOpaqueIdOnly)
+{
+    MissionCache cache;
+    const auto items = make_items(5);
+    std::vector<mavlink_mission_item_int_t> cached;
+
+    cache.store(42, 1234, items);
+
+    EXPECT_TRUE(cache.lookup(42, 1234, 5, cached));
+    EXPECT_EQ(MissionCache::crc32(cached), MissionCache::crc32(items));
+
+    // The mission changed on the autopilot.
+    EXPECT_FALSE(cache.lookup(42, 1235, 5, cached));
+    // Another vehicle.
+    EXPECT_FALSE(cache.lookup(43, 1234, 5, cached));
+    // Count doesn't match.
+    EXPECT_FALSE(cache.lookup(42, 1234, 4, cached));
+
+    cache.forget(42);
+    EXPECT_FALSE(cache.lookup(42, 1234, 5, cached));
+}
+
+TEST(MissionCache, NeedsOpaqueIdAndUuid)
+{
+    MissionCache cache;
+    const auto items = make_items(3);
+    std::vector<mavlink_mission_item_int_t> cached;
+
+    cache.store(42, 0, items);
+    EXPECT_FALSE(cache.lookup(42, 0, 3, cached));
+
+    cache.store(0, 1234, items);
+    EXPECT_FALSE(cache.lookup(0, 1234, 3, cached));
+}
+
+TEST(MissionCache, CrcCoversItems)
+{
+    auto items = make_items(3);
+    const uint32_t crc = MissionCache::crc32(items);
+
+    // Not part of what the item does.
+    items[0].current = 1;
+    items[1].target_system = 255;
+    EXPECT_EQ(MissionCache::crc32(items), crc);
+
+    items[2].z = 11.0f;
+    EXPECT_NE(MissionCache::crc32(items), crc);
+}
+
+TEST(MissionCache, KeepsMissionTypesApart)
+{
+    MissionCache cache;
+    const auto mission = make_items(5);
+    const auto fence = make_items(3);
+    std::vector<mavlink_mission_item_int_t> cached;
+
+    cache.store(42, 1234, mission);
+    cache.store(42, 1234, fence, MAV_MISSION_TYPE_FENCE);
+
+    EXPECT_TRUE(cache.lookup(42, 1234, 5, cached));
+    EXPECT_FALSE(cache.lookup(42, 1234, 5, cached, MAV_MISSION_TYPE_FENCE));
+    EXPECT_TRUE(cache.lookup(42, 1234, 3, cached, MAV_MISSION_TYPE_FENCE));
+
+    // Uploading a mission leaves the fence alone.
+    cache.forget(42);
+    EXPECT_FALSE(cache.lookup(42, 1234, 5, cached));
+    EXPECT_TRUE(cache.lookup(42, 1234, 3, cached, MAV_MISSION_TYPE_FENCE));
+}
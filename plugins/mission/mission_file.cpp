@@ -0,0 +1,203 @@
+#include "mission_file.h"
+#include "mission_cache.h"
+#include "log.h"
+
+#if defined(LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h> // for close()
+#else
+#include <fstream>
+#include <iterator>
+#endif
+
+#include <cstdio>
+#include <cstring>
+
+#define GET_ERROR(_x) strerror(_x)
+
+namespace dronecore {
+
+constexpr size_t MissionFile::HEADER_LEN;
+constexpr uint16_t MissionFile::VERSION;
+constexpr size_t MissionFile::RECORD_LEN;
+
+static const char MAGIC[4] = {'D', 'C', 'M', 'I'};
+
+#if defined(LINUX)
+static bool write_all(int fd, const uint8_t *data, size_t len)
+{
+    while (len > 0) {
+        const ssize_t written = write(fd, data, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LogErr() << "write error: " << GET_ERROR(errno);
+            return false;
+        }
+        data += written;
+        len -= size_t(written);
+    }
+    return true;
+}
+#endif
+
+void MissionFile::make_header(uint32_t num_items, uint32_t crc, uint8_t *header)
+{
+    const uint16_t version = VERSION;
+    const uint16_t record_len = RECORD_LEN;
+
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    std::memcpy(header + 4, &version, sizeof(version));
+    std::memcpy(header + 6, &record_len, sizeof(record_len));
+    std::memcpy(header + 8, &num_items, sizeof(num_items));
+    std::memcpy(header + 12, &crc, sizeof(crc));
+}
+
+bool MissionFile::check_header(const uint8_t *header, size_t file_len, uint32_t &num_items,
+                               uint32_t &crc)
+{
+    if (file_len < HEADER_LEN || std::memcmp(header, MAGIC, sizeof(MAGIC)) != 0) {
+        return false;
+    }
+
+    uint16_t version;
+    uint16_t record_len;
+    std::memcpy(&version, header + 4, sizeof(version));
+    std::memcpy(&record_len, header + 6, sizeof(record_len));
+    std::memcpy(&num_items, header + 8, sizeof(num_items));
+    std::memcpy(&crc, header + 12, sizeof(crc));
+
+    if (version != VERSION || record_len != RECORD_LEN) {
+        LogErr() << "Mission file version " << version << " not supported";
+        return false;
+    }
+
+    return file_len == HEADER_LEN + size_t(num_items) * RECORD_LEN;
+}
+
+MissionFile::Result MissionFile::save(const std::string &path,
+                                      const std::vector<mavlink_mission_item_int_t> &items)
+{
+    const size_t records_len = items.size() * RECORD_LEN;
+    uint8_t header[HEADER_LEN];
+    make_header(items.size(), MissionCache::crc32(items), header);
+
+    const std::string tmp_path = path + ".tmp";
+
+#if defined(LINUX)
+    // Not through a shared mapping: running out of disk space would only
+    // show as a SIGBUS when writing to it.
+    const int fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LogErr() << "open error: " << GET_ERROR(errno);
+        return Result::OPEN_ERROR;
+    }
+
+    bool success = write_all(fd, header, HEADER_LEN) &&
+                   write_all(fd, reinterpret_cast<const uint8_t *>(items.data()), records_len);
+    // Only renamed once it is on disk, or a crash could leave an empty file.
+    if (success && fsync(fd) < 0) {
+        LogErr() << "fsync error: " << GET_ERROR(errno);
+        success = false;
+    }
+    if (close(fd) < 0) {
+        success = false;
+    }
+#else
+    bool success = false;
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (file) {
+            file.write(reinterpret_cast<const char *>(header), HEADER_LEN);
+            file.write(reinterpret_cast<const char *>(items.data()), records_len);
+            success = bool(file);
+        }
+    }
+#if defined(WINDOWS)
+    // Windows doesn't replace an existing file on rename.
+    if (success) {
+        std::remove(path.c_str());
+    }
+#endif
+#endif
+
+    if (!success || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        return Result::OPEN_ERROR;
+    }
+    return Result::SUCCESS;
+}
+
+MissionFile::Result MissionFile::load(const std::string &path,
+                                      std::vector<mavlink_mission_item_int_t> &items)
+{
+    items.clear();
+
+#if defined(LINUX)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        LogErr() << "open error: " << GET_ERROR(errno);
+        return Result::OPEN_ERROR;
+    }
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        return Result::OPEN_ERROR;
+    }
+
+    const size_t len = size_t(file_stat.st_size);
+    if (len < HEADER_LEN) {
+        close(fd);
+        return Result::FORMAT_ERROR;
+    }
+
+    void *data = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        LogErr() << "mmap error: " << GET_ERROR(errno);
+        return Result::OPEN_ERROR;
+    }
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return Result::OPEN_ERROR;
+    }
+
+    const std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)),
+                                        std::istreambuf_iterator<char>());
+    const size_t len = contents.size();
+    const uint8_t *bytes = contents.data();
+#endif
+
+    Result result = Result::SUCCESS;
+    uint32_t num_items = 0;
+    uint32_t crc = 0;
+    if (!check_header(bytes, len, num_items, crc)) {
+        result = Result::FORMAT_ERROR;
+
+    } else {
+        items.resize(num_items);
+        if (num_items > 0) {
+            std::memcpy(items.data(), bytes + HEADER_LEN, num_items * RECORD_LEN);
+        }
+
+        if (MissionCache::crc32(items) != crc) {
+            LogErr() << "Mission file checksum mismatch";
+            items.clear();
+            result = Result::FORMAT_ERROR;
+        }
+    }
+
+#if defined(LINUX)
+    munmap(data, len);
+#endif
+    return result;
+}
+
+} // namespace dronecore
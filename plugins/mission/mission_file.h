@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mavlink_include.h"
+
+namespace dronecore {
+
+// Missions saved as they go over the wire: a header followed by the
+// mission_item_int records, with a CRC-32 of the records in the header.
+// Files are read through memory mapping where available. They are written
+// to a temporary file next to them first, which replaces the old one once
+// complete, so a crash or a full disk never leaves half a mission.
+//
+// The records are stored in the byte order of the host, which is little
+// endian on everything we build for.
+class MissionFile
+{
+public:
+    enum class Result {
+        SUCCESS,
+        OPEN_ERROR,
+        FORMAT_ERROR
+    };
+
+    static Result save(const std::string &path,
+                       const std::vector<mavlink_mission_item_int_t> &items);
+    static Result load(const std::string &path, std::vector<mavlink_mission_item_int_t> &items);
+
+private:
+    static void make_header(uint32_t num_items, uint32_t crc, uint8_t *header);
+    // Returns false if this is not a mission file we can read.
+    static bool check_header(const uint8_t *header, size_t file_len, uint32_t &num_items,
+                             uint32_t &crc);
+
+    static constexpr size_t HEADER_LEN = 16;
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t RECORD_LEN = sizeof(mavlink_mission_item_int_t);
+};
+
+} // namespace dronecore
@@ -0,0 +1,92 @@
+#include "mission_file.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+
+using namespace dronecore;
+
+static const std::string mission_file_path = "mission_file_test.dcm";
+
+static std::vector<mavlink_mission_item_int_t> make_items(unsigned count)
+{
+    std::vector<mavlink_mission_item_int_t> items(count, mavlink_mission_item_int_t {});
+    for (unsigned i = 0; i < count; ++i) {
+        items[i].seq = i;
+        items[i].command = MAV_CMD_NAV_WAYPOINT;
+        items[i].frame = MAV_FRAME_GLOBAL_RELATIVE_ALT_INT;
+        items[i].x = 473977418 + int32_t(i);
+        items[i].y = 85455939 - int32_t(i);
+        items[i].z = 10.0f + float(i);
+    }
+    return items;
+}
+
+TEST(MissionFile, SavesAndLoads)
+{
+    const auto items = make_items(1000);
+    ASSERT_EQ(MissionFile::save(mission_file_path, items), MissionFile::Result::SUCCESS);
+
+    std::vector<mavlink_mission_item_int_t> loaded;
+    ASSERT_EQ(MissionFile::load(mission_file_path, loaded), MissionFile::Result::SUCCESS);
+    ASSERT_EQ(loaded.size(), items.size());
+    for (unsigned i = 0; i < items.size(); ++i) {
+        EXPECT_EQ(loaded[i].seq, items[i].seq);
+        EXPECT_EQ(loaded[i].x, items[i].x);
+        EXPECT_EQ(loaded[i].y, items[i].y);
+        EXPECT_EQ(loaded[i].z, items[i].z);
+    }
+
+    // An empty mission is a valid file, too.
+    ASSERT_EQ(MissionFile::save(mission_file_path, {}), MissionFile::Result::SUCCESS);
+    ASSERT_EQ(MissionFile::load(mission_file_path, loaded), MissionFile::Result::SUCCESS);
+    EXPECT_EQ(loaded.size(), 0);
+
+    std::remove(mission_file_path.c_str());
+}
+
+TEST(MissionFile, RefusesBrokenFiles)
+{
+    std::vector<mavlink_mission_item_int_t> loaded;
+    EXPECT_EQ(MissionFile::load("does_not_exist.dcm", loaded), MissionFile::Result::OPEN_ERROR);
+
+    ASSERT_EQ(MissionFile::save(mission_file_path, make_items(10)),
+              MissionFile::Result::SUCCESS);
+
+    // Flip a byte in the last record.
+    {
+        std::fstream file(mission_file_path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(-4, std::ios::end);
+        file.put('\x42');
+    }
+    EXPECT_EQ(MissionFile::load(mission_file_path, loaded), MissionFile::Result::FORMAT_ERROR);
+    EXPECT_EQ(loaded.size(), 0);
+
+    {
+        std::ofstream file(mission_file_path, std::ios::binary | std::ios::trunc);
+        file << "{ \"fileType\": \"Plan\" }";
+    }
+    EXPECT_EQ(MissionFile::load(mission_file_path, loaded), MissionFile::Result::FORMAT_ERROR);
+
+    std::remove(mission_file_path.c_str());
+}
+
+TEST(MissionFile, ReplacesFileAsAWhole)
+{
+    ASSERT_EQ(MissionFile::save(mission_file_path, make_items(10)),
+              MissionFile::Result::SUCCESS);
+    // Nothing left behind next to it.
+    EXPECT_FALSE(std::ifstream(mission_file_path + ".tmp").good());
+
+    // The temporary file can't be created in a directory that doesn't exist.
+    EXPECT_EQ(MissionFile::save("does_not_exist/" + mission_file_path, make_items(5)),
+              MissionFile::Result::OPEN_ERROR);
+
+    // Replaced as a whole.
+    ASSERT_EQ(MissionFile::save(mission_file_path, make_items(3)),
+              MissionFile::Result::SUCCESS);
+    std::vector<mavlink_mission_item_int_t> loaded;
+    ASSERT_EQ(MissionFile::load(mission_file_path, loaded), MissionFile::Result::SUCCESS);
+    EXPECT_EQ(loaded.size(), 3);
+
+    std::remove(mission_file_path.c_str());
+}
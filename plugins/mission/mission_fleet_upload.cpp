@@ -0,0 +1,116 @@
+#include "mission_fleet_upload.h"
+#include "log.h"
+
+namespace dronecore {
+
+void MissionFleetUpload::start(const std::vector<MissionImpl *> &missions,
+                               const Mission::mission_items_t &mission_items,
+                               const Mission::fleet_result_callback_t &callback,
+                               const Mission::fleet_progress_callback_t &progress_callback,
+                               unsigned max_concurrent)
+{
+    if (missions.size() == 0) {
+        if (callback) {
+            callback(std::vector<Mission::Result>());
+        }
+        return;
+    }
+
+    // Kept alive by the callbacks of the uploads until the last one is done.
+    auto upload = std::make_shared<MissionFleetUpload>(missions, mission_items, callback,
+                                                       progress_callback, max_concurrent);
+    upload->start_next();
+}
+
+MissionFleetUpload::MissionFleetUpload(const std::vector<MissionImpl *> &missions,
+                                       const Mission::mission_items_t &mission_items,
+                                       const Mission::fleet_result_callback_t &callback,
+                                       const Mission::fleet_progress_callback_t &progress_callback,
+                                       unsigned max_concurrent) :
+    _missions(missions),
+    _mission_items(mission_items),
+    _encoded(MissionImpl::encode_mission(mission_items)),
+    _callback(callback),
+    _progress_callback(progress_callback),
+    _max_concurrent(max_concurrent == 0 ? unsigned(missions.size()) : max_concurrent),
+    _results(missions.size(), Mission::Result::UNKNOWN),
+    _num_items_sent(missions.size(), 0)
+{}
+
+void MissionFleetUpload::start_next()
+{
+    std::vector<unsigned> to_start;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        while (_num_active < _max_concurrent && _next_mission < _missions.size()) {
+            to_start.push_back(_next_mission++);
+            ++_num_active;
+        }
+    }
+
+    auto self = shared_from_this();
+    std::weak_ptr<MissionFleetUpload> weak_self = self;
+
+    for (unsigned index : to_start) {
+        // The item callback stays with the plugin until its next upload, so it
+        // must not keep us alive.
+        _missions[index]->upload_encoded_mission_async(
+            _mission_items, _encoded,
+        [self, index](Mission::Result result) {
+            self->receive_result(index, result);
+        },
+        [weak_self, index](uint16_t seq) {
+            auto upload = weak_self.lock();
+            if (upload) {
+                upload->receive_item_sent(index, seq);
+            }
+        });
+    }
+}
+
+void MissionFleetUpload::receive_item_sent(unsigned index, uint16_t seq)
+{
+    int items_sent = 0;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        // Items requested again don't count twice.
+        if (int(seq) + 1 <= _num_items_sent[index]) {
+            return;
+        }
+        _total_items_sent += int(seq) + 1 - _num_items_sent[index];
+        _num_items_sent[index] = int(seq) + 1;
+        items_sent = _total_items_sent;
+    }
+
+    if (_progress_callback) {
+        _progress_callback(items_sent, int(_encoded->items.size() * _missions.size()));
+    }
+}
+
+void MissionFleetUpload::receive_result(unsigned index, Mission::Result result)
+{
+    bool is_done = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _results[index] = result;
+        --_num_active;
+        ++_num_done;
+        is_done = (_num_done == _missions.size());
+    }
+
+    if (result != Mission::Result::SUCCESS) {
+        LogWarn() << "Mission upload " << index << " of fleet failed: "
+                  << Mission::result_str(result);
+    }
+
+    if (!is_done) {
+        start_next();
+        return;
+    }
+
+    if (_callback) {
+        _callback(_results);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "mission.h"
+#include "mission_impl.h"
+
+namespace dronecore {
+
+// Uploads one mission to many systems.
+//
+// The mission is encoded once and the wire items are shared by all uploads. Each
+// system still runs its own MissionImpl state machine, this only starts them,
+// keeps at most max_concurrent of them running and collects the results.
+class MissionFleetUpload : public std::enable_shared_from_this<MissionFleetUpload>
+{
+public:
+    static void start(const std::vector<MissionImpl *> &missions,
+                      const Mission::mission_items_t &mission_items,
+                      const Mission::fleet_result_callback_t &callback,
+                      const Mission::fleet_progress_callback_t &progress_callback,
+                      unsigned max_concurrent);
+
+    MissionFleetUpload(const std::vector<MissionImpl *> &missions,
+                       const Mission::mission_items_t &mission_items,
+                       const Mission::fleet_result_callback_t &callback,
+                       const Mission::fleet_progress_callback_t &progress_callback,
+                       unsigned max_concurrent);
+
+    // Non-copyable
+    MissionFleetUpload(const MissionFleetUpload &) = delete;
+    const MissionFleetUpload &operator=(const MissionFleetUpload &) = delete;
+
+private:
+    void start_next();
+    void receive_item_sent(unsigned index, uint16_t seq);
+    void receive_result(unsigned index, Mission::Result result);
+
+    const std::vector<MissionImpl *> _missions;
+    const Mission::mission_items_t _mission_items;
+    const std::shared_ptr<const MissionImpl::EncodedMission> _encoded;
+    const Mission::fleet_result_callback_t _callback;
+    const Mission::fleet_progress_callback_t _progress_callback;
+    const unsigned _max_concurrent;
+
+    std::mutex _mutex {};
+    std::vector<Mission::Result> _results;
+    // Per system, the items up to here have been sent at least once.
+    std::vector<int> _num_items_sent;
+    int _total_items_sent {0};
+    unsigned _next_mission {0};
+    unsigned _num_active {0};
+    unsigned _num_done {0};
+};
+
+} // namespace dronecore
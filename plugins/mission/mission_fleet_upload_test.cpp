@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+#include "connection.h"
+#include "dronecore_impl.h"
+#include "mission.h"
+#include "mission_impl.h"
+#include "mission_fleet_upload.h"
+#include "system.h"
+
+using namespace dronecore;
+
+namespace {
+
+// Messages are handed to DroneCoreImpl directly, what is sent is swallowed.
+class NullConnection : public Connection
+{
+public:
+    explicit NullConnection(DroneCoreImpl &parent) : Connection(parent) {}
+
+    ConnectionResult start() override { return ConnectionResult::SUCCESS; }
+    ConnectionResult stop() override { return ConnectionResult::SUCCESS; }
+    bool is_ok() const override { return true; }
+    bool send_message(const mavlink_message_t &) override { return true; }
+
+protected:
+    bool write_buffer(const uint8_t *, size_t) override { return true; }
+};
+
+// Discovers a system which supports MISSION_ITEM_INT, its UUID is the system ID.
+void discover_system(DroneCoreImpl &dc, Connection &connection, uint8_t system_id)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(system_id, MAV_COMP_ID_AUTOPILOT1, &message,
+                               MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+
+    mavlink_autopilot_version_t autopilot_version {};
+    autopilot_version.capabilities = MAV_PROTOCOL_CAPABILITY_MISSION_INT;
+    autopilot_version.uid = system_id;
+    mavlink_msg_autopilot_version_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message,
+                                         &autopilot_version);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+}
+
+} // namespace
+
+static Mission::mission_items_t make_mission_items()
+{
+    Mission::mission_items_t mission_items;
+
+    auto first = std::make_shared<MissionItem>();
+    first->set_position(47.3977418, 8.5455939);
+    first->set_relative_altitude(10.0f);
+    first->set_speed(5.0f);
+    mission_items.push_back(first);
+
+    auto second = std::make_shared<MissionItem>();
+    second->set_position(47.3980000, 8.5460000);
+    second->set_relative_altitude(15.0f);
+    second->set_loiter_time(3.0f);
+    mission_items.push_back(second);
+
+    return mission_items;
+}
+
+TEST(MissionFleetUpload, EncodesMissionOnce)
+{
+    const auto mission_items = make_mission_items();
+    const auto encoded = MissionImpl::encode_mission(mission_items);
+    ASSERT_TRUE(encoded != nullptr);
+
+    // Position and speed of the first item, position and delay of the second.
+    ASSERT_EQ(encoded->items.size(), 4u);
+    ASSERT_EQ(encoded->sources.size(), encoded->items.size());
+    ASSERT_EQ(encoded->hashes.size(), encoded->items.size());
+
+    for (unsigned seq = 0; seq < encoded->items.size(); ++seq) {
+        EXPECT_EQ(encoded->items[seq].seq, seq);
+        // Set for each system when it is sent.
+        EXPECT_EQ(encoded->items[seq].target_system, 0);
+        EXPECT_EQ(encoded->hashes[seq],
+                  MissionImpl::hash_mavlink_mission_item(encoded->items[seq]));
+    }
+
+    EXPECT_EQ(encoded->items[0].command, MAV_CMD_NAV_WAYPOINT);
+    EXPECT_EQ(encoded->items[0].x, 473977418);
+    EXPECT_EQ(encoded->items[1].command, MAV_CMD_DO_CHANGE_SPEED);
+}
+
+TEST(MissionFleetUpload, ReportsEmptyFleet)
+{
+    bool called = false;
+    MissionFleetUpload::start({}, make_mission_items(),
+    [&called](std::vector<Mission::Result> results) {
+        called = true;
+        EXPECT_EQ(results.size(), 0u);
+    }, nullptr, 0);
+    EXPECT_TRUE(called);
+}
+
+TEST(MissionFleetUpload, StartsNextAfterSilentSystem)
+{
+    // The connection needs to outlive DroneCoreImpl, which sends to it.
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<NullConnection> connection(new NullConnection(*dc));
+    discover_system(*dc, *connection, 1);
+    discover_system(*dc, *connection, 2);
+
+    std::unique_ptr<Mission> first(new Mission(dc->get_system(1)));
+    std::unique_ptr<Mission> second(new Mission(dc->get_system(2)));
+
+    // Neither requests any items, so one at a time the second only starts once
+    // the first has timed out.
+    auto prom = std::make_shared<std::promise<std::vector<Mission::Result>>>();
+    auto fut = prom->get_future();
+    Mission::upload_mission_to_fleet_async({first.get(), second.get()}, make_mission_items(),
+    [prom](std::vector<Mission::Result> results) {
+        prom->set_value(results);
+    }, nullptr, 1);
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+    const std::vector<Mission::Result> results = fut.get();
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_EQ(results[0], Mission::Result::TIMEOUT);
+    EXPECT_EQ(results[1], Mission::Result::TIMEOUT);
+
+    first.reset();
+    second.reset();
+    dc.reset();
+}
+
+TEST(MissionFleetUpload, RefusesMoreItemsThanCountFits)
+{
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<NullConnection> connection(new NullConnection(*dc));
+    discover_system(*dc, *connection, 3);
+    discover_system(*dc, *connection, 4);
+
+    std::unique_ptr<Mission> first(new Mission(dc->get_system(3)));
+    std::unique_ptr<Mission> second(new Mission(dc->get_system(4)));
+
+    // A plain waypoint each, one more than MISSION_COUNT can announce.
+    Mission::mission_items_t mission_items;
+    for (unsigned i = 0; i <= UINT16_MAX; ++i) {
+        auto item = std::make_shared<MissionItem>();
+        item->set_position(47.3977418, 8.5455939);
+        mission_items.push_back(item);
+    }
+
+    // Refused right away instead of timing out.
+    auto prom = std::make_shared<std::promise<std::vector<Mission::Result>>>();
+    auto fut = prom->get_future();
+    Mission::upload_mission_to_fleet_async({first.get(), second.get()}, mission_items,
+    [prom](std::vector<Mission::Result> results) {
+        prom->set_value(results);
+    }, nullptr, 0);
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    const std::vector<Mission::Result> results = fut.get();
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_EQ(results[0], Mission::Result::TOO_MANY_MISSION_ITEMS);
+    EXPECT_EQ(results[1], Mission::Result::TOO_MANY_MISSION_ITEMS);
+    EXPECT_EQ(first->total_mission_items(), 0);
+
+    first.reset();
+    second.reset();
+    dc.reset();
+}
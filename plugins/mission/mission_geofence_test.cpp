@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "mission_impl.h"
+
+using namespace dronecore;
+
+static Mission::Geofence::Polygon make_polygon(Mission::Geofence::Polygon::Type type,
+                                               unsigned num_vertices)
+{
+    Mission::Geofence::Polygon polygon;
+    polygon.type = type;
+    for (unsigned i = 0; i < num_vertices; ++i) {
+        polygon.vertices.push_back(Mission::Geofence::Vertex {47.3977 + 0.0001 * i,
+                                                              8.5456 - 0.0001 * i});
+    }
+    return polygon;
+}
+
+TEST(MissionGeofence, RoundTrip)
+{
+    Mission::Geofence geofence;
+    geofence.polygons.push_back(make_polygon(Mission::Geofence::Polygon::Type::INCLUSION, 5000));
+    geofence.polygons.push_back(make_polygon(Mission::Geofence::Polygon::Type::EXCLUSION, 3));
+
+    std::vector<mavlink_mission_item_int_t> items;
+    ASSERT_EQ(MissionImpl::make_geofence_items(geofence, items), Mission::Result::SUCCESS);
+    ASSERT_EQ(items.size(), 5003u);
+    EXPECT_EQ(items[0].command, MAV_CMD_NAV_FENCE_POLYGON_VERTEX_INCLUSION);
+    EXPECT_EQ(items[0].mission_type, MAV_MISSION_TYPE_FENCE);
+    EXPECT_EQ(items[5000].command, MAV_CMD_NAV_FENCE_POLYGON_VERTEX_EXCLUSION);
+    EXPECT_EQ(items[5000].param1, 3.0f);
+
+    Mission::Geofence downloaded;
+    ASSERT_EQ(MissionImpl::assemble_geofence(items, downloaded), Mission::Result::SUCCESS);
+    ASSERT_EQ(downloaded.polygons.size(), 2u);
+    for (unsigned i = 0; i < 2; ++i) {
+        const auto &polygon = geofence.polygons[i];
+        ASSERT_EQ(downloaded.polygons[i].vertices.size(), polygon.vertices.size());
+        EXPECT_EQ(downloaded.polygons[i].type, polygon.type);
+        for (unsigned j = 0; j < polygon.vertices.size(); ++j) {
+            EXPECT_NEAR(downloaded.polygons[i].vertices[j].latitude_deg,
+                        polygon.vertices[j].latitude_deg, 1e-7);
+            EXPECT_NEAR(downloaded.polygons[i].vertices[j].longitude_deg,
+                        polygon.vertices[j].longitude_deg, 1e-7);
+        }
+    }
+}
+
+TEST(MissionGeofence, RejectsBadPolygons)
+{
+    Mission::Geofence geofence;
+    geofence.polygons.push_back(make_polygon(Mission::Geofence::Polygon::Type::INCLUSION, 2));
+
+    std::vector<mavlink_mission_item_int_t> items;
+    EXPECT_EQ(MissionImpl::make_geofence_items(geofence, items),
+              Mission::Result::INVALID_ARGUMENT);
+
+    // A polygon cut short on the autopilot.
+    geofence.polygons[0] = make_polygon(Mission::Geofence::Polygon::Type::INCLUSION, 4);
+    ASSERT_EQ(MissionImpl::make_geofence_items(geofence, items), Mission::Result::SUCCESS);
+    items.pop_back();
+    Mission::Geofence downloaded;
+    EXPECT_EQ(MissionImpl::assemble_geofence(items, downloaded), Mission::Result::UNSUPPORTED);
+    EXPECT_EQ(downloaded.polygons.size(), 0u);
+
+    // Circles aren't supported.
+    items.assign(1, mavlink_mission_item_int_t {});
+    items[0].command = MAV_CMD_NAV_FENCE_CIRCLE_INCLUSION;
+    EXPECT_EQ(MissionImpl::assemble_geofence(items, downloaded), Mission::Result::UNSUPPORTED);
+}
+
+TEST(MissionRallyPoints, RoundTrip)
+{
+    const std::vector<Mission::RallyPoint> rally_points {
+        {47.3977, 8.5456, 20.0f},
+        {47.3980, 8.5460, 35.0f}
+    };
+
+    std::vector<mavlink_mission_item_int_t> items;
+    MissionImpl::make_rally_point_items(rally_points, items);
+    ASSERT_EQ(items.size(), 2u);
+    EXPECT_EQ(items[1].command, MAV_CMD_NAV_RALLY_POINT);
+    EXPECT_EQ(items[1].mission_type, MAV_MISSION_TYPE_RALLY);
+
+    std::vector<Mission::RallyPoint> downloaded;
+    ASSERT_EQ(MissionImpl::assemble_rally_points(items, downloaded), Mission::Result::SUCCESS);
+    ASSERT_EQ(downloaded.size(), 2u);
+    EXPECT_NEAR(downloaded[1].latitude_deg, 47.3980, 1e-7);
+    EXPECT_NEAR(downloaded[1].longitude_deg, 8.5460, 1e-7);
+    EXPECT_EQ(downloaded[1].relative_altitude_m, 35.0f);
+}
@@ -1,18 +1,27 @@
 #include "mission_impl.h"
 #include "mission_item_impl.h"
+#include "mission_cache.h"
+#include "mission_file.h"
+#include "survey_generator.h"
 #include "system.h"
 #include "global_include.h"
-#include <fstream> // for `std::ifstream`
-#include <sstream> // for `std::stringstream`
+#include <algorithm>
 #include <cmath>
 
+// Only newer MAVLink headers carry the opaque mission id in MISSION_COUNT.
+#if MAVLINK_MSG_ID_MISSION_COUNT_LEN >= 9
+#define MISSION_COUNT_HAS_OPAQUE_ID
+#endif
+
 namespace dronecore {
 
 using namespace std::placeholders; // for `_1`
 
 
 MissionImpl::MissionImpl(System &system) :
-    PluginImplBase(system)
+    PluginImplBase(system),
+    _geofence_transfer(*_parent, MAV_MISSION_TYPE_FENCE),
+    _rally_point_transfer(*_parent, MAV_MISSION_TYPE_RALLY)
 {
     _parent->register_plugin(this);
 }
@@ -58,6 +67,8 @@ void MissionImpl::enable() {}
 void MissionImpl::disable()
 {
     _parent->unregister_timeout_handler(_timeout_cookie);
+    _geofence_transfer.cancel();
+    _rally_point_transfer.cancel();
 }
 
 void MissionImpl::deinit()
@@ -65,21 +76,34 @@ void MissionImpl::deinit()
     _parent->unregister_all_mavlink_message_handlers(this);
 }
 
-void MissionImpl::process_mission_request(const mavlink_message_t &unused)
+MissionTransfer *MissionImpl::get_transfer(uint8_t mission_type)
+{
+    switch (mission_type) {
+        case MAV_MISSION_TYPE_FENCE:
+            return &_geofence_transfer;
+        case MAV_MISSION_TYPE_RALLY:
+            return &_rally_point_transfer;
+        default:
+            return nullptr;
+    }
+}
+
+void MissionImpl::process_mission_request(const mavlink_message_t &message)
 {
     // We only support int, so we nack this and thus tell the autopilot to use int.
-    UNUSED(unused);
+    mavlink_mission_request_t mission_request;
+    mavlink_msg_mission_request_decode(&message, &mission_request);
 
-    mavlink_message_t message;
+    mavlink_message_t ack_message;
     mavlink_msg_mission_ack_pack(GCSClient::system_id,
                                  GCSClient::component_id,
-                                 &message,
+                                 &ack_message,
                                  _parent->get_system_id(),
                                  _parent->get_autopilot_id(),
                                  MAV_MISSION_UNSUPPORTED,
-                                 MAV_MISSION_TYPE_MISSION);
+                                 mission_request.mission_type);
 
-    _parent->send_message(message);
+    _parent->send_message(ack_message);
 
     // Reset the timeout because we're still communicating.
     _parent->refresh_timeout_handler(_timeout_cookie);
@@ -97,6 +121,12 @@ void MissionImpl::process_mission_request_int(const mavlink_message_t &message)
         return;
     }
 
+    MissionTransfer *transfer = get_transfer(mission_request_int.mission_type);
+    if (transfer != nullptr) {
+        transfer->process_mission_request_int(mission_request_int);
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(_activity.mutex);
         if (_activity.state != Activity::State::SET_MISSION) {
@@ -118,14 +148,6 @@ void MissionImpl::process_mission_request_int(const mavlink_message_t &message)
 
 void MissionImpl::process_mission_ack(const mavlink_message_t &message)
 {
-    {
-        std::lock_guard<std::mutex> lock(_activity.mutex);
-        if (_activity.state != Activity::State::SET_MISSION) {
-            LogWarn() << "Error: not sure how to process Mission ack.";
-            return;
-        }
-    }
-
     mavlink_mission_ack_t mission_ack;
     mavlink_msg_mission_ack_decode(&message, &mission_ack);
 
@@ -136,6 +158,20 @@ void MissionImpl::process_mission_ack(const mavlink_message_t &message)
         return;
     }
 
+    MissionTransfer *transfer = get_transfer(mission_ack.mission_type);
+    if (transfer != nullptr) {
+        transfer->process_mission_ack(mission_ack);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_activity.mutex);
+        if (_activity.state != Activity::State::SET_MISSION) {
+            LogWarn() << "Error: not sure how to process Mission ack.";
+            return;
+        }
+    }
+
     // We got some response, so it wasn't a timeout and we can remove it.
     _parent->unregister_timeout_handler(_timeout_cookie);
 
@@ -146,12 +182,22 @@ void MissionImpl::process_mission_ack(const mavlink_message_t &message)
     }
 
     if (mission_ack.type == MAV_MISSION_ACCEPTED) {
+        // A partial update might have more ranges to go.
+        if (send_next_partial_range()) {
+            return;
+        }
+
         // Reset current and reached; we don't want to get confused
         // from earlier messages.
         {
             std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-            _mission_data.last_current_mavlink_mission_item = -1;
-            _mission_data.last_reached_mavlink_mission_item = -1;
+            _progress.last_current_mavlink_mission_item = -1;
+            _progress.last_reached_mavlink_mission_item = -1;
+            publish_progress();
+            // Now we know what is on the autopilot.
+            _mission_data.synced_item_hashes.swap(_mission_data.pending_item_hashes);
+            _mission_data.pending_item_hashes.clear();
+            _mission_data.partial_ranges.clear();
         }
         {
             std::lock_guard<std::mutex> lock(_activity.mutex);
@@ -162,10 +208,12 @@ void MissionImpl::process_mission_ack(const mavlink_message_t &message)
         LogInfo() << "Mission accepted";
 
     } else if (mission_ack.type == MAV_MISSION_NO_SPACE) {
+        forget_synced_mission();
         LogErr() << "Error: too many waypoints: " << int(mission_ack.type);
         report_mission_result(result_callback, Mission::Result::TOO_MANY_MISSION_ITEMS);
 
     } else {
+        forget_synced_mission();
         LogErr() << "Error: unknown mission ack: " << int(mission_ack.type);
         report_mission_result(result_callback, Mission::Result::ERROR);
     }
@@ -179,8 +227,9 @@ void MissionImpl::process_mission_current(const mavlink_message_t &message)
     bool should_report_progress = false;
     {
         std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-        if (_mission_data.last_current_mavlink_mission_item != mission_current.seq) {
-            _mission_data.last_current_mavlink_mission_item = mission_current.seq;
+        if (_progress.last_current_mavlink_mission_item != mission_current.seq) {
+            _progress.last_current_mavlink_mission_item = mission_current.seq;
+            publish_progress();
             should_report_progress = true;
         }
     }
@@ -200,8 +249,9 @@ void MissionImpl::process_mission_current(const mavlink_message_t &message)
     bool set_current_successful = false;
     {
         std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-        if (_mission_data.last_current_mavlink_mission_item == mission_current.seq) {
-            _mission_data.last_current_mavlink_mission_item = -1;
+        if (_progress.last_current_mavlink_mission_item == mission_current.seq) {
+            _progress.last_current_mavlink_mission_item = -1;
+            publish_progress();
             set_current_successful = true;
         }
     }
@@ -222,9 +272,12 @@ void MissionImpl::process_mission_item_reached(const mavlink_message_t &message)
     mavlink_msg_mission_item_reached_decode(&message, &mission_item_reached);
 
     bool should_report_progress = false;
-    if (_mission_data.last_reached_mavlink_mission_item != mission_item_reached.seq) {
-        _mission_data.last_reached_mavlink_mission_item = mission_item_reached.seq;
-        should_report_progress = true;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        if (_progress.last_reached_mavlink_mission_item != mission_item_reached.seq) {
+            _progress.last_reached_mavlink_mission_item = mission_item_reached.seq;
+            should_report_progress = true;
+        }
     }
 
     if (should_report_progress) {
@@ -234,6 +287,15 @@ void MissionImpl::process_mission_item_reached(const mavlink_message_t &message)
 
 void MissionImpl::process_mission_count(const mavlink_message_t &message)
 {
+    mavlink_mission_count_t mission_count;
+    mavlink_msg_mission_count_decode(&message, &mission_count);
+
+    MissionTransfer *transfer = get_transfer(mission_count.mission_type);
+    if (transfer != nullptr) {
+        transfer->process_mission_count(mission_count);
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(_activity.mutex);
         if (_activity.state != Activity::State::GET_MISSION) {
@@ -241,25 +303,65 @@ void MissionImpl::process_mission_count(const mavlink_message_t &message)
         }
     }
 
-    mavlink_mission_count_t mission_count;
-    mavlink_msg_mission_count_decode(&message, &mission_count);
+    uint32_t opaque_id = 0;
+#if defined(MISSION_COUNT_HAS_OPAQUE_ID)
+    opaque_id = mission_count.opaque_id;
+#endif
 
+    bool is_cached = false;
     {
         std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
         _mission_data.num_mission_items_to_download = mission_count.count;
         _mission_data.next_mission_item_to_download = 0;
+        _mission_data.first_missing_mission_item = 0;
+        _mission_data.num_mission_items_downloaded = 0;
+        _mission_data.download_opaque_id = opaque_id;
+
+        // If the autopilot still has the mission we downloaded before, there
+        // is no need to transfer it again.
+        is_cached = MissionCache::instance().lookup(_parent->get_uuid(), opaque_id,
+                                                    mission_count.count,
+                                                    _mission_data.mavlink_mission_items_downloaded);
+        if (is_cached) {
+            _mission_data.next_mission_item_to_download = mission_count.count;
+            _mission_data.first_missing_mission_item = mission_count.count;
+            _mission_data.num_mission_items_downloaded = mission_count.count;
+            _mission_data.mission_items_downloaded.assign(mission_count.count, true);
+        } else {
+            _mission_data.mavlink_mission_items_downloaded.assign(mission_count.count,
+                                                                  mavlink_mission_item_int_t {});
+            _mission_data.mission_items_downloaded.assign(mission_count.count, false);
+        }
     }
 
     // We are now requesting mission items and use a lower timeout for this.
     _parent->unregister_timeout_handler(_timeout_cookie);
 
+    if (is_cached) {
+        LogInfo() << "Mission unchanged, using cached copy";
+    }
+
+    if (is_cached || mission_count.count == 0) {
+        finish_mission_download();
+        return;
+    }
+
     _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
                                       RETRY_TIMEOUT_S, &_timeout_cookie);
-    download_next_mission_item();
+    request_next_mission_items();
 }
 
 void MissionImpl::process_mission_item_int(const mavlink_message_t &message)
 {
+    mavlink_mission_item_int_t mission_item_int;
+    mavlink_msg_mission_item_int_decode(&message, &mission_item_int);
+
+    MissionTransfer *transfer = get_transfer(mission_item_int.mission_type);
+    if (transfer != nullptr) {
+        transfer->process_mission_item_int(mission_item_int);
+        return;
+    }
+
     {
         std::lock_guard<std::mutex> lock(_activity.mutex);
         if (_activity.state != Activity::State::GET_MISSION) {
@@ -267,58 +369,109 @@ void MissionImpl::process_mission_item_int(const mavlink_message_t &message)
         }
     }
 
-    auto mission_item_int_ptr = std::make_shared<mavlink_mission_item_int_t>();
-    mavlink_msg_mission_item_int_decode(&message, mission_item_int_ptr.get());
-
+    bool is_complete = false;
     {
         std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-        if (mission_item_int_ptr->seq == _mission_data.next_mission_item_to_download) {
-            LogDebug() << "Received mission item " << _mission_data.next_mission_item_to_download;
+        const int seq = mission_item_int.seq;
+
+        if (seq >= _mission_data.num_mission_items_to_download) {
+            LogWarn() << "Received mission item " << seq << " out of range (ignored)";
+            return;
+        }
 
-            _mission_data.mavlink_mission_items_downloaded.push_back(mission_item_int_ptr);
+        if (_mission_data.mission_items_downloaded[seq]) {
+            // This is an answer to a request we repeated, nothing new.
+            LogDebug() << "Received mission item " << seq << " again (ignored)";
+
+        } else {
+            LogDebug() << "Received mission item " << seq;
+
+            _mission_data.mavlink_mission_items_downloaded[seq] = mission_item_int;
+            _mission_data.mission_items_downloaded[seq] = true;
+            ++_mission_data.num_mission_items_downloaded;
             _mission_data.retries = 0;
 
-            if (_mission_data.next_mission_item_to_download + 1 ==
-                _mission_data.num_mission_items_to_download) {
+            int &first_missing = _mission_data.first_missing_mission_item;
+            while (first_missing < _mission_data.num_mission_items_to_download &&
+                   _mission_data.mission_items_downloaded[first_missing]) {
+                ++first_missing;
+            }
+        }
 
-                // Wrap things up if we're finished.
-                _parent->unregister_timeout_handler(_timeout_cookie);
+        is_complete = (_mission_data.num_mission_items_downloaded ==
+                       _mission_data.num_mission_items_to_download);
+    }
 
-                mavlink_message_t ack_message;
-                mavlink_msg_mission_ack_pack(GCSClient::system_id,
-                                             GCSClient::component_id,
-                                             &ack_message,
-                                             _parent->get_system_id(),
-                                             _parent->get_autopilot_id(),
-                                             MAV_MISSION_ACCEPTED,
-                                             MAV_MISSION_TYPE_MISSION);
+    if (is_complete) {
+        // Wrap things up if we're finished.
+        _parent->unregister_timeout_handler(_timeout_cookie);
+        finish_mission_download();
 
-                _parent->send_message(ack_message);
+    } else {
+        // Otherwise keep going, we at least still seem to be active.
+        _parent->refresh_timeout_handler(_timeout_cookie);
+        request_next_mission_items();
+    }
+}
 
-                assemble_mission_items();
+void MissionImpl::finish_mission_download()
+{
+    mavlink_message_t ack_message;
+    mavlink_msg_mission_ack_pack(GCSClient::system_id,
+                                 GCSClient::component_id,
+                                 &ack_message,
+                                 _parent->get_system_id(),
+                                 _parent->get_autopilot_id(),
+                                 MAV_MISSION_ACCEPTED,
+                                 MAV_MISSION_TYPE_MISSION);
 
-            } else {
-                // Otherwise keep going.
-                ++_mission_data.next_mission_item_to_download;
-                _parent->refresh_timeout_handler(_timeout_cookie);
-                download_next_mission_item();
-            }
+    _parent->send_message(ack_message);
 
-        } else {
-            LogDebug() << "Received mission item " << int(mission_item_int_ptr->seq)
-                       << " instead of " << _mission_data.next_mission_item_to_download << " (ignored)";
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        MissionCache::instance().store(_parent->get_uuid(), _mission_data.download_opaque_id,
+                                       _mission_data.mavlink_mission_items_downloaded);
+    }
 
-            // Refresh because we at least still seem to be active.
-            _parent->refresh_timeout_handler(_timeout_cookie);
+    assemble_mission_items();
+}
 
-            // And request it again in case our request got lost.
-            download_next_mission_item();
-            return;
+void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>>
+                                       &mission_items,
+                                       const Mission::result_callback_t &callback)
+{
+    bool should_report_mission_result = false;
+    {
+        std::lock_guard<std::mutex> lock(_activity.mutex);
+        if (_activity.state != Activity::State::NONE) {
+            should_report_mission_result = true;
         }
     }
+
+    if (should_report_mission_result) {
+        report_mission_result(callback, Mission::Result::BUSY);
+        return;
+    }
+
+    if (!_parent->does_support_mission_int()) {
+        LogWarn() << "Mission int messages not supported";
+        report_mission_result(callback, Mission::Result::ERROR);
+        return;
+    }
+
+    copy_mission_item_vector(mission_items);
+
+    index_mavlink_mission_items();
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        hash_mavlink_mission_items(_mission_data.pending_item_hashes);
+    }
+
+    send_mission_count(callback);
 }
 
-void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<MissionItem>>
+void MissionImpl::update_mission_async(const std::vector<std::shared_ptr<MissionItem>>
                                        &mission_items,
                                        const Mission::result_callback_t &callback)
 {
@@ -341,9 +494,455 @@ void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<Mission
         return;
     }
 
-    copy_mission_item_vector(mission_items);
+    copy_mission_item_vector(mission_items);
+
+    index_mavlink_mission_items();
+
+    bool can_update_partially = false;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        hash_mavlink_mission_items(_mission_data.pending_item_hashes);
+
+        // A partial write can only replace items, not add or remove them.
+        can_update_partially = (_mission_data.synced_item_hashes.size() > 0 &&
+                                _mission_data.synced_item_hashes.size() ==
+                                _mission_data.pending_item_hashes.size());
+        if (can_update_partially) {
+            find_changed_ranges(_mission_data.synced_item_hashes,
+                                _mission_data.pending_item_hashes,
+                                _mission_data.partial_ranges);
+            _mission_data.next_partial_range = 0;
+        }
+    }
+
+    if (!can_update_partially) {
+        LogDebug() << "Mission can't be updated partially, uploading all of it";
+        send_mission_count(callback);
+        return;
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        if (_mission_data.partial_ranges.size() == 0) {
+            // Nothing changed, nothing to send.
+            report_mission_result(callback, Mission::Result::SUCCESS);
+            return;
+        }
+        MissionCache::instance().forget(_parent->get_uuid());
+        _mission_data.result_callback = callback;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_activity.mutex);
+        _activity.state = Activity::State::SET_MISSION;
+    }
+
+    if (!send_next_partial_range()) {
+        {
+            std::lock_guard<std::mutex> lock(_activity.mutex);
+            _activity.state = Activity::State::NONE;
+        }
+        report_mission_result(callback, Mission::Result::ERROR);
+    }
+}
+
+void MissionImpl::upload_mission_file_async(const std::string &path,
+                                            const Mission::result_callback_t &callback)
+{
+    bool should_report_mission_result = false;
+    {
+        std::lock_guard<std::mutex> lock(_activity.mutex);
+        if (_activity.state != Activity::State::NONE) {
+            should_report_mission_result = true;
+        }
+    }
+
+    if (should_report_mission_result) {
+        report_mission_result(callback, Mission::Result::BUSY);
+        return;
+    }
+
+    if (!_parent->does_support_mission_int()) {
+        LogWarn() << "Mission int messages not supported";
+        report_mission_result(callback, Mission::Result::ERROR);
+        return;
+    }
+
+    std::vector<mavlink_mission_item_int_t> raw_items;
+    const MissionFile::Result file_result = MissionFile::load(path, raw_items);
+    if (file_result != MissionFile::Result::SUCCESS) {
+        report_mission_result(callback, to_mission_result(file_result));
+        return;
+    }
+
+    upload_raw_mission_items(raw_items, callback);
+}
+
+void MissionImpl::upload_survey_async(const Mission::Survey &survey,
+                                      const Mission::result_callback_t &callback)
+{
+    bool should_report_mission_result = false;
+    {
+        std::lock_guard<std::mutex> lock(_activity.mutex);
+        if (_activity.state != Activity::State::NONE) {
+            should_report_mission_result = true;
+        }
+    }
+
+    if (should_report_mission_result) {
+        report_mission_result(callback, Mission::Result::BUSY);
+        return;
+    }
+
+    if (!_parent->does_support_mission_int()) {
+        LogWarn() << "Mission int messages not supported";
+        report_mission_result(callback, Mission::Result::ERROR);
+        return;
+    }
+
+    std::vector<mavlink_mission_item_int_t> raw_items;
+    if (!SurveyGenerator::generate(survey, raw_items)) {
+        LogErr() << "Invalid survey";
+        report_mission_result(callback, Mission::Result::INVALID_ARGUMENT);
+        return;
+    }
+
+    upload_raw_mission_items(raw_items, callback);
+}
+
+std::shared_ptr<const MissionImpl::EncodedMission>
+MissionImpl::encode_mission(const Mission::mission_items_t &mission_items)
+{
+    auto encoded = std::make_shared<EncodedMission>();
+    index_mavlink_mission_items(mission_items, encoded->sources);
+
+    encoded->items.resize(encoded->sources.size());
+    encoded->hashes.reserve(encoded->sources.size());
+    for (unsigned seq = 0; seq < encoded->sources.size(); ++seq) {
+        make_mavlink_mission_item(mission_items, encoded->sources[seq], seq, encoded->items[seq]);
+        encoded->hashes.push_back(hash_mavlink_mission_item(encoded->items[seq]));
+    }
+
+    return encoded;
+}
+
+void MissionImpl::upload_encoded_mission_async(const Mission::mission_items_t &mission_items,
+                                               const std::shared_ptr<const EncodedMission> &encoded,
+                                               const Mission::result_callback_t &callback,
+                                               const item_sent_callback_t &item_sent_callback)
+{
+    bool should_report_mission_result = false;
+    {
+        std::lock_guard<std::mutex> lock(_activity.mutex);
+        if (_activity.state != Activity::State::NONE) {
+            should_report_mission_result = true;
+        }
+    }
+
+    if (should_report_mission_result) {
+        report_mission_result(callback, Mission::Result::BUSY);
+        return;
+    }
+
+    if (!_parent->does_support_mission_int()) {
+        LogWarn() << "Mission int messages not supported";
+        report_mission_result(callback, Mission::Result::ERROR);
+        return;
+    }
+
+    // MISSION_COUNT can't announce more, and what is on the autopilot stays as it is.
+    if (encoded->sources.size() > UINT16_MAX) {
+        report_mission_result(callback, Mission::Result::TOO_MANY_MISSION_ITEMS);
+        return;
+    }
+
+    copy_mission_item_vector(mission_items);
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        _mission_data.raw_mavlink_mission_items.clear();
+        _mission_data.mavlink_mission_item_sources = encoded->sources;
+        _mission_data.encoded_mission = encoded;
+        _mission_data.item_sent_callback = item_sent_callback;
+        _mission_data.pending_item_hashes = encoded->hashes;
+        publish_progress();
+    }
+
+    send_mission_count(callback);
+}
+
+void MissionImpl::upload_raw_mission_items(std::vector<mavlink_mission_item_int_t> &raw_items,
+                                           const Mission::result_callback_t &callback)
+{
+    // MISSION_COUNT can't announce more, and what is on the autopilot stays as it is.
+    if (raw_items.size() > UINT16_MAX) {
+        report_mission_result(callback, Mission::Result::TOO_MANY_MISSION_ITEMS);
+        return;
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        // The items go out as they are, every one counts as a mission item.
+        _mission_data.mission_items.clear();
+        _mission_data.raw_mavlink_mission_items.swap(raw_items);
+        _mission_data.encoded_mission.reset();
+        _mission_data.item_sent_callback = nullptr;
+        _mission_data.mavlink_mission_item_sources.clear();
+        _mission_data.mavlink_mission_item_sources.reserve(
+            _mission_data.raw_mavlink_mission_items.size());
+        for (unsigned i = 0; i < _mission_data.raw_mavlink_mission_items.size(); ++i) {
+            add_mavlink_mission_item_source(_mission_data.mavlink_mission_item_sources,
+                                            int(i), MavlinkItemKind::RAW);
+        }
+        publish_progress();
+
+        hash_mavlink_mission_items(_mission_data.pending_item_hashes);
+    }
+
+    send_mission_count(callback);
+}
+
+Mission::Result MissionImpl::save_downloaded_mission_file(const std::string &path) const
+{
+    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+    if (_mission_data.mavlink_mission_items_downloaded.size() == 0) {
+        return Mission::Result::NO_MISSION_AVAILABLE;
+    }
+
+    return to_mission_result(MissionFile::save(path,
+                                               _mission_data.mavlink_mission_items_downloaded));
+}
+
+void MissionImpl::upload_geofence_async(const Mission::Geofence &geofence,
+                                        const Mission::result_callback_t &callback)
+{
+    std::vector<mavlink_mission_item_int_t> items;
+    const Mission::Result result = make_geofence_items(geofence, items);
+    if (result != Mission::Result::SUCCESS) {
+        report_mission_result(callback, result);
+        return;
+    }
+
+    _geofence_transfer.upload_async(items, [this, callback](Mission::Result transfer_result) {
+        report_mission_result(callback, transfer_result);
+    });
+}
+
+void MissionImpl::download_geofence_async(const Mission::geofence_and_result_callback_t
+                                          &callback)
+{
+    _geofence_transfer.download_async(
+        [this, callback](Mission::Result result,
+    const std::vector<mavlink_mission_item_int_t> &items) {
+        Mission::Geofence geofence;
+        if (result == Mission::Result::SUCCESS) {
+            result = assemble_geofence(items, geofence);
+        }
+
+        if (callback == nullptr) {
+            LogWarn() << "Callback is not set";
+            return;
+        }
+        _parent->call_user_callback([callback, result, geofence]() {
+            callback(result, geofence);
+        });
+    });
+}
+
+void MissionImpl::upload_rally_points_async(const std::vector<Mission::RallyPoint> &rally_points,
+                                            const Mission::result_callback_t &callback)
+{
+    std::vector<mavlink_mission_item_int_t> items;
+    make_rally_point_items(rally_points, items);
+    if (items.size() > UINT16_MAX) {
+        report_mission_result(callback, Mission::Result::TOO_MANY_MISSION_ITEMS);
+        return;
+    }
+
+    _rally_point_transfer.upload_async(items, [this, callback](Mission::Result transfer_result) {
+        report_mission_result(callback, transfer_result);
+    });
+}
+
+void MissionImpl::download_rally_points_async(const Mission::rally_points_and_result_callback_t
+                                              &callback)
+{
+    _rally_point_transfer.download_async(
+        [this, callback](Mission::Result result,
+    const std::vector<mavlink_mission_item_int_t> &items) {
+        std::vector<Mission::RallyPoint> rally_points;
+        if (result == Mission::Result::SUCCESS) {
+            result = assemble_rally_points(items, rally_points);
+        }
+
+        if (callback == nullptr) {
+            LogWarn() << "Callback is not set";
+            return;
+        }
+        _parent->call_user_callback([callback, result, rally_points]() {
+            callback(result, rally_points);
+        });
+    });
+}
+
+Mission::Result MissionImpl::make_geofence_items(const Mission::Geofence &geofence,
+                                                 std::vector<mavlink_mission_item_int_t> &items)
+{
+    items.clear();
+
+    for (const auto &polygon : geofence.polygons) {
+        if (polygon.vertices.size() < 3) {
+            LogErr() << "Geofence polygon needs at least three vertices";
+            return Mission::Result::INVALID_ARGUMENT;
+        }
+
+        const uint16_t command = (polygon.type == Mission::Geofence::Polygon::Type::INCLUSION) ?
+                                 MAV_CMD_NAV_FENCE_POLYGON_VERTEX_INCLUSION :
+                                 MAV_CMD_NAV_FENCE_POLYGON_VERTEX_EXCLUSION;
+
+        // Every vertex carries the vertex count of its polygon, consecutive
+        // ones make up a polygon.
+        for (const auto &vertex : polygon.vertices) {
+            mavlink_mission_item_int_t item {};
+            item.frame = MAV_FRAME_GLOBAL_INT;
+            item.command = command;
+            item.param1 = float(polygon.vertices.size());
+            item.x = int32_t(std::round(vertex.latitude_deg * 1e7));
+            item.y = int32_t(std::round(vertex.longitude_deg * 1e7));
+            item.mission_type = MAV_MISSION_TYPE_FENCE;
+            items.push_back(item);
+        }
+    }
+
+    if (items.size() > UINT16_MAX) {
+        return Mission::Result::TOO_MANY_MISSION_ITEMS;
+    }
+    return Mission::Result::SUCCESS;
+}
+
+Mission::Result MissionImpl::assemble_geofence(const std::vector<mavlink_mission_item_int_t>
+                                               &items, Mission::Geofence &geofence)
+{
+    geofence.polygons.clear();
+
+    size_t i = 0;
+    while (i < items.size()) {
+        const mavlink_mission_item_int_t &first = items[i];
+
+        Mission::Geofence::Polygon polygon;
+        if (first.command == MAV_CMD_NAV_FENCE_POLYGON_VERTEX_INCLUSION) {
+            polygon.type = Mission::Geofence::Polygon::Type::INCLUSION;
+        } else if (first.command == MAV_CMD_NAV_FENCE_POLYGON_VERTEX_EXCLUSION) {
+            polygon.type = Mission::Geofence::Polygon::Type::EXCLUSION;
+        } else {
+            LogErr() << "UNSUPPORTED geofence item command (" << first.command << ")";
+            geofence.polygons.clear();
+            return Mission::Result::UNSUPPORTED;
+        }
+
+        const size_t num_vertices = size_t(first.param1);
+        if (num_vertices < 3 || i + num_vertices > items.size()) {
+            LogErr() << "Geofence polygon with wrong vertex count";
+            geofence.polygons.clear();
+            return Mission::Result::UNSUPPORTED;
+        }
+
+        polygon.vertices.reserve(num_vertices);
+        for (size_t j = i; j < i + num_vertices; ++j) {
+            if (items[j].command != first.command || size_t(items[j].param1) != num_vertices) {
+                LogErr() << "Geofence polygon ends early";
+                geofence.polygons.clear();
+                return Mission::Result::UNSUPPORTED;
+            }
+            polygon.vertices.push_back(Mission::Geofence::Vertex {double(items[j].x) * 1e-7,
+                                                                  double(items[j].y) * 1e-7});
+        }
+
+        geofence.polygons.push_back(std::move(polygon));
+        i += num_vertices;
+    }
+
+    return Mission::Result::SUCCESS;
+}
+
+void MissionImpl::make_rally_point_items(const std::vector<Mission::RallyPoint> &rally_points,
+                                         std::vector<mavlink_mission_item_int_t> &items)
+{
+    items.clear();
+    items.reserve(rally_points.size());
+
+    for (const auto &rally_point : rally_points) {
+        mavlink_mission_item_int_t item {};
+        item.frame = MAV_FRAME_GLOBAL_RELATIVE_ALT_INT;
+        item.command = MAV_CMD_NAV_RALLY_POINT;
+        item.x = int32_t(std::round(rally_point.latitude_deg * 1e7));
+        item.y = int32_t(std::round(rally_point.longitude_deg * 1e7));
+        item.z = rally_point.relative_altitude_m;
+        item.mission_type = MAV_MISSION_TYPE_RALLY;
+        items.push_back(item);
+    }
+}
+
+Mission::Result MissionImpl::assemble_rally_points(const std::vector<mavlink_mission_item_int_t>
+                                                   &items,
+                                                   std::vector<Mission::RallyPoint> &rally_points)
+{
+    rally_points.clear();
+    rally_points.reserve(items.size());
+
+    for (const auto &item : items) {
+        if (item.command != MAV_CMD_NAV_RALLY_POINT ||
+            item.frame != MAV_FRAME_GLOBAL_RELATIVE_ALT_INT) {
+            LogErr() << "UNSUPPORTED rally point (" << item.command << ", frame "
+                     << int(item.frame) << ")";
+            rally_points.clear();
+            return Mission::Result::UNSUPPORTED;
+        }
+        rally_points.push_back(Mission::RallyPoint {double(item.x) * 1e-7,
+                                                    double(item.y) * 1e-7, item.z});
+    }
+
+    return Mission::Result::SUCCESS;
+}
+
+Mission::Result MissionImpl::save_mission_file(const Mission::mission_items_t &mission_items,
+                                               const std::string &path)
+{
+    std::vector<MavlinkItemSource> sources;
+    index_mavlink_mission_items(mission_items, sources);
+
+    std::vector<mavlink_mission_item_int_t> mavlink_items(sources.size());
+    for (unsigned seq = 0; seq < sources.size(); ++seq) {
+        make_mavlink_mission_item(mission_items, sources[seq], seq, mavlink_items[seq]);
+    }
+
+    return to_mission_result(MissionFile::save(path, mavlink_items));
+}
+
+Mission::Result MissionImpl::to_mission_result(MissionFile::Result result)
+{
+    switch (result) {
+        case MissionFile::Result::SUCCESS:
+            return Mission::Result::SUCCESS;
+        case MissionFile::Result::OPEN_ERROR:
+            return Mission::Result::FAILED_TO_OPEN_MISSION_FILE;
+        case MissionFile::Result::FORMAT_ERROR:
+            return Mission::Result::FAILED_TO_PARSE_MISSION_FILE;
+        default:
+            return Mission::Result::UNKNOWN;
+    }
+}
 
-    assemble_mavlink_messages();
+void MissionImpl::send_mission_count(const Mission::result_callback_t &callback)
+{
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        // Whatever was on the autopilot before is about to be replaced.
+        MissionCache::instance().forget(_parent->get_uuid());
+        _mission_data.synced_item_hashes.clear();
+        _mission_data.partial_ranges.clear();
+        _mission_data.next_partial_range = 0;
+    }
 
     mavlink_message_t message;
     mavlink_msg_mission_count_pack(GCSClient::system_id,
@@ -351,7 +950,7 @@ void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<Mission
                                    &message,
                                    _parent->get_system_id(),
                                    _parent->get_autopilot_id(),
-                                   _mission_data.mavlink_mission_item_messages.size(),
+                                   _mission_data.mavlink_mission_item_sources.size(),
                                    MAV_MISSION_TYPE_MISSION);
 
     if (!_parent->send_message(message)) {
@@ -374,6 +973,104 @@ void MissionImpl::upload_mission_async(const std::vector<std::shared_ptr<Mission
     }
 }
 
+bool MissionImpl::send_next_partial_range()
+{
+    seq_range_t range;
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        if (_mission_data.next_partial_range >= _mission_data.partial_ranges.size()) {
+            return false;
+        }
+        range = _mission_data.partial_ranges[_mission_data.next_partial_range++];
+    }
+
+    LogDebug() << "Updating mission items " << range.first << " to " << range.second;
+
+    // The autopilot requests the items in the range and acks once it has them all.
+    mavlink_message_t message;
+    mavlink_msg_mission_write_partial_list_pack(GCSClient::system_id,
+                                                GCSClient::component_id,
+                                                &message,
+                                                _parent->get_system_id(),
+                                                _parent->get_autopilot_id(),
+                                                range.first,
+                                                range.second,
+                                                MAV_MISSION_TYPE_MISSION);
+
+    if (!_parent->send_message(message)) {
+        return false;
+    }
+
+    _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
+                                      PROCESS_TIMEOUT_S, &_timeout_cookie);
+    return true;
+}
+
+void MissionImpl::hash_mavlink_mission_items(std::vector<uint64_t> &hashes)
+{
+    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+    hashes.clear();
+    hashes.reserve(_mission_data.mavlink_mission_item_sources.size());
+
+    mavlink_mission_item_int_t mavlink_item;
+    for (unsigned seq = 0; seq < _mission_data.mavlink_mission_item_sources.size(); ++seq) {
+        make_mavlink_mission_item(seq, mavlink_item);
+        hashes.push_back(hash_mavlink_mission_item(mavlink_item));
+    }
+}
+
+template<typename T>
+static void hash_field(uint64_t &hash, const T &field)
+{
+    // FNV-1a
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&field);
+    for (size_t i = 0; i < sizeof(field); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+}
+
+uint64_t MissionImpl::hash_mavlink_mission_item(const mavlink_mission_item_int_t &item)
+{
+    // The targets and the current flag are left out, they depend on the direction
+    // the item was sent in and are not part of what the item does.
+    uint64_t hash = 14695981039346656037ULL;
+    hash_field(hash, item.seq);
+    hash_field(hash, item.frame);
+    hash_field(hash, item.command);
+    hash_field(hash, item.autocontinue);
+    hash_field(hash, item.param1);
+    hash_field(hash, item.param2);
+    hash_field(hash, item.param3);
+    hash_field(hash, item.param4);
+    hash_field(hash, item.x);
+    hash_field(hash, item.y);
+    hash_field(hash, item.z);
+    hash_field(hash, item.mission_type);
+    return hash;
+}
+
+void MissionImpl::find_changed_ranges(const std::vector<uint64_t> &before,
+                                      const std::vector<uint64_t> &after,
+                                      std::vector<seq_range_t> &ranges)
+{
+    ranges.clear();
+
+    const size_t size = std::min(before.size(), after.size());
+    for (size_t seq = 0; seq < size; ++seq) {
+        if (before[seq] == after[seq]) {
+            continue;
+        }
+
+        // Every partial write costs a round trip, so it is cheaper to resend a
+        // few unchanged items in between than to start a new range.
+        if (ranges.size() > 0 && seq - ranges.back().second <= MAX_UNCHANGED_IN_RANGE + 1) {
+            ranges.back().second = seq;
+        } else {
+            ranges.push_back(seq_range_t(seq, seq));
+        }
+    }
+}
+
 void MissionImpl::download_mission_async(const Mission::mission_items_and_result_callback_t
                                          &callback)
 {
@@ -417,245 +1114,217 @@ void MissionImpl::download_mission_async(const Mission::mission_items_and_result
         std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
         // Clear our internal cache and re-populate it.
         _mission_data.mavlink_mission_items_downloaded.clear();
+        _mission_data.mission_items_downloaded.clear();
+        _mission_data.num_mission_items_to_download = -1;
         _mission_data.retries = 0;
         _mission_data.mission_items_and_result_callback = callback;
     }
 }
 
-void MissionImpl::assemble_mavlink_messages()
+void MissionImpl::index_mavlink_mission_items()
 {
     std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-    _mission_data.mavlink_mission_item_messages.clear();
-
-    bool last_position_valid = false; // This flag is to protect us from using an invalid x/y.
-    MAV_FRAME last_frame;
-    int32_t last_x;
-    int32_t last_y;
-    float last_z;
-
-    unsigned item_i = 0;
-    for (auto item : _mission_data.mission_items) {
+    _mission_data.raw_mavlink_mission_items.clear();
+    _mission_data.encoded_mission.reset();
+    _mission_data.item_sent_callback = nullptr;
+    index_mavlink_mission_items(_mission_data.mission_items,
+                                _mission_data.mavlink_mission_item_sources);
+    publish_progress();
+}
 
-        MissionItemImpl &mission_item_impl = (*(item)->_impl);
+void MissionImpl::index_mavlink_mission_items(const Mission::mission_items_t &mission_items,
+                                              std::vector<MavlinkItemSource> &sources)
+{
+    sources.clear();
+    // Most items turn into one mavlink item, the rest grows as needed.
+    sources.reserve(mission_items.size());
 
-        if (mission_item_impl.is_position_finite()) {
-            // Current is the 0th waypoint
-            uint8_t current = ((_mission_data.mavlink_mission_item_messages.size() == 0) ? 1 : 0);
+    // This is to protect us from using an invalid x/y.
+    int last_position_index = -1;
 
-            auto message = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mission_data.mavlink_mission_item_messages.size(),
-                                              mission_item_impl.get_mavlink_frame(),
-                                              mission_item_impl.get_mavlink_cmd(),
-                                              current,
-                                              mission_item_impl.get_mavlink_autocontinue(),
-                                              mission_item_impl.get_mavlink_param1(),
-                                              mission_item_impl.get_mavlink_param2(),
-                                              mission_item_impl.get_mavlink_param3(),
-                                              mission_item_impl.get_mavlink_param4(),
-                                              mission_item_impl.get_mavlink_x(),
-                                              mission_item_impl.get_mavlink_y(),
-                                              mission_item_impl.get_mavlink_z(),
-                                              MAV_MISSION_TYPE_MISSION);
+    int item_i = 0;
+    for (const auto &item : mission_items) {
 
-            last_position_valid = true; // because we checked is_position_finite
-            last_x = mission_item_impl.get_mavlink_x();
-            last_y = mission_item_impl.get_mavlink_y();
-            last_z = mission_item_impl.get_mavlink_z();
-            last_frame = mission_item_impl.get_mavlink_frame();
+        const MissionItemImpl &mission_item_impl = (*(item)->_impl);
 
-            _mission_data.mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mission_data.mavlink_mission_item_messages.size()), item_i});
-            _mission_data.mavlink_mission_item_messages.push_back(message);
+        if (mission_item_impl.is_position_finite()) {
+            add_mavlink_mission_item_source(sources, item_i, MavlinkItemKind::POSITION);
+            last_position_index = item_i;
         }
 
         if (std::isfinite(mission_item_impl.get_speed_m_s())) {
-
             // The speed has changed, we need to add a speed command.
-
-            // Current is the 0th waypoint
-            uint8_t current = ((_mission_data.mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-            uint8_t autocontinue = 1;
-
-            auto message_speed = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message_speed.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mission_data.mavlink_mission_item_messages.size(),
-                                              MAV_FRAME_MISSION,
-                                              MAV_CMD_DO_CHANGE_SPEED,
-                                              current,
-                                              autocontinue,
-                                              1.0f, // ground speed
-                                              mission_item_impl.get_speed_m_s(),
-                                              -1.0f, // no throttle change
-                                              0.0f, // absolute
-                                              0,
-                                              0,
-                                              NAN,
-                                              MAV_MISSION_TYPE_MISSION);
-
-            _mission_data.mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mission_data.mavlink_mission_item_messages.size()), item_i});
-            _mission_data.mavlink_mission_item_messages.push_back(message_speed);
+            add_mavlink_mission_item_source(sources, item_i, MavlinkItemKind::SPEED);
         }
 
         if (std::isfinite(mission_item_impl.get_gimbal_yaw_deg()) ||
             std::isfinite(mission_item_impl.get_gimbal_pitch_deg())) {
             // The gimbal has changed, we need to add a gimbal command.
-
-            // Current is the 0th waypoint
-            uint8_t current = ((_mission_data.mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-            uint8_t autocontinue = 1;
-
-            auto message_gimbal = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message_gimbal.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mission_data.mavlink_mission_item_messages.size(),
-                                              MAV_FRAME_MISSION,
-                                              MAV_CMD_DO_MOUNT_CONTROL,
-                                              current,
-                                              autocontinue,
-                                              mission_item_impl.get_gimbal_pitch_deg(), // pitch
-                                              0.0f, // roll (yes it is a weird order)
-                                              mission_item_impl.get_gimbal_yaw_deg(), // yaw
-                                              NAN,
-                                              0,
-                                              0,
-                                              MAV_MOUNT_MODE_MAVLINK_TARGETING,
-                                              MAV_MISSION_TYPE_MISSION);
-
-            _mission_data.mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mission_data.mavlink_mission_item_messages.size()), item_i});
-            _mission_data.mavlink_mission_item_messages.push_back(message_gimbal);
+            add_mavlink_mission_item_source(sources, item_i, MavlinkItemKind::GIMBAL);
         }
 
         // FIXME: It is a bit of a hack to set a LOITER_TIME waypoint to add a delay.
         //        A better solution would be to properly use NAV_DELAY instead. This
         //        would not require us to keep the last lat/lon.
         if (std::isfinite(mission_item_impl.get_loiter_time_s())) {
-            if (!last_position_valid) {
+            if (last_position_index < 0) {
                 // In the case where we get a delay without a previous position, we will have to
                 // ignore it.
                 LogErr() << "Can't set camera action delay without previous position set.";
 
             } else {
-
-                // Current is the 0th waypoint
-                uint8_t current = ((_mission_data.mavlink_mission_item_messages.size() == 0) ? 1 : 0);
-
-                uint8_t autocontinue = 1;
-
-                std::shared_ptr<mavlink_message_t> message_delay(new mavlink_message_t());
-                mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                                  GCSClient::component_id,
-                                                  message_delay.get(),
-                                                  _parent->get_system_id(),
-                                                  _parent->get_autopilot_id(),
-                                                  _mission_data.mavlink_mission_item_messages.size(),
-                                                  last_frame,
-                                                  MAV_CMD_NAV_LOITER_TIME,
-                                                  current,
-                                                  autocontinue,
-                                                  mission_item_impl.get_loiter_time_s(), // loiter time in seconds
-                                                  NAN, // empty
-                                                  0.0f, // radius around waypoint in meters ?
-                                                  0.0f, // loiter at center of waypoint
-                                                  last_x,
-                                                  last_y,
-                                                  last_z,
-                                                  MAV_MISSION_TYPE_MISSION);
-
-                _mission_data.mavlink_mission_item_to_mission_item_indices.insert(
-                    std::pair <int, int>
-                {static_cast<int>(_mission_data.mavlink_mission_item_messages.size()), item_i});
-                _mission_data.mavlink_mission_item_messages.push_back(message_delay);
+                add_mavlink_mission_item_source(sources, item_i, MavlinkItemKind::DELAY,
+                                                last_position_index);
             }
         }
 
         if (mission_item_impl.get_camera_action() != MissionItem::CameraAction::NONE) {
             // There is a camera action that we need to send.
+            add_mavlink_mission_item_source(sources, item_i, MavlinkItemKind::CAMERA);
+        }
+
+        ++item_i;
+    }
+}
+
+void MissionImpl::add_mavlink_mission_item_source(std::vector<MavlinkItemSource> &sources,
+                                                  int mission_item_index, MavlinkItemKind kind,
+                                                  int position_item_index)
+{
+    MavlinkItemSource source;
+    source.mission_item_index = mission_item_index;
+    source.position_item_index = position_item_index;
+    source.kind = kind;
+    sources.push_back(source);
+}
+
+void MissionImpl::make_mavlink_mission_item(uint16_t seq, mavlink_mission_item_int_t &mavlink_item)
+{
+    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+    const MavlinkItemSource &source = _mission_data.mavlink_mission_item_sources.at(seq);
+
+    if (_mission_data.encoded_mission) {
+        mavlink_item = _mission_data.encoded_mission->items.at(seq);
+    } else if (source.kind == MavlinkItemKind::RAW) {
+        // Loaded from a mission file, these go out as they are.
+        mavlink_item = _mission_data.raw_mavlink_mission_items.at(source.mission_item_index);
+        mavlink_item.seq = seq;
+        mavlink_item.current = (seq == 0) ? 1 : 0;
+        mavlink_item.mission_type = MAV_MISSION_TYPE_MISSION;
+    } else {
+        make_mavlink_mission_item(_mission_data.mission_items, source, seq, mavlink_item);
+    }
+
+    mavlink_item.target_system = _parent->get_system_id();
+    mavlink_item.target_component = _parent->get_autopilot_id();
+}
+
+void MissionImpl::make_mavlink_mission_item(const Mission::mission_items_t &mission_items,
+                                            const MavlinkItemSource &source, uint16_t seq,
+                                            mavlink_mission_item_int_t &mavlink_item)
+{
+    const MissionItemImpl &mission_item_impl =
+        *(mission_items.at(source.mission_item_index)->_impl);
+
+    mavlink_item = mavlink_mission_item_int_t {};
+    mavlink_item.seq = seq;
+    // Current is the 0th waypoint
+    mavlink_item.current = (seq == 0) ? 1 : 0;
+    mavlink_item.autocontinue = 1;
+    mavlink_item.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    switch (source.kind) {
+        case MavlinkItemKind::POSITION:
+            mavlink_item.frame = mission_item_impl.get_mavlink_frame();
+            mavlink_item.command = mission_item_impl.get_mavlink_cmd();
+            mavlink_item.autocontinue = mission_item_impl.get_mavlink_autocontinue();
+            mavlink_item.param1 = mission_item_impl.get_mavlink_param1();
+            mavlink_item.param2 = mission_item_impl.get_mavlink_param2();
+            mavlink_item.param3 = mission_item_impl.get_mavlink_param3();
+            mavlink_item.param4 = mission_item_impl.get_mavlink_param4();
+            mavlink_item.x = mission_item_impl.get_mavlink_x();
+            mavlink_item.y = mission_item_impl.get_mavlink_y();
+            mavlink_item.z = mission_item_impl.get_mavlink_z();
+            break;
+
+        case MavlinkItemKind::SPEED:
+            mavlink_item.frame = MAV_FRAME_MISSION;
+            mavlink_item.command = MAV_CMD_DO_CHANGE_SPEED;
+            mavlink_item.param1 = 1.0f; // ground speed
+            mavlink_item.param2 = mission_item_impl.get_speed_m_s();
+            mavlink_item.param3 = -1.0f; // no throttle change
+            mavlink_item.param4 = 0.0f; // absolute
+            mavlink_item.z = NAN;
+            break;
 
-            // Current is the 0th waypoint
-            uint8_t current = ((_mission_data.mavlink_mission_item_messages.size() == 0) ? 1 : 0);
+        case MavlinkItemKind::GIMBAL:
+            mavlink_item.frame = MAV_FRAME_MISSION;
+            mavlink_item.command = MAV_CMD_DO_MOUNT_CONTROL;
+            mavlink_item.param1 = mission_item_impl.get_gimbal_pitch_deg(); // pitch
+            mavlink_item.param2 = 0.0f; // roll (yes it is a weird order)
+            mavlink_item.param3 = mission_item_impl.get_gimbal_yaw_deg(); // yaw
+            mavlink_item.param4 = NAN;
+            mavlink_item.z = MAV_MOUNT_MODE_MAVLINK_TARGETING;
+            break;
 
-            uint8_t autocontinue = 1;
+        case MavlinkItemKind::DELAY: {
+                // Loiter at the last position we went to.
+                const MissionItemImpl &position_impl =
+                    *(mission_items.at(source.position_item_index)->_impl);
+
+                mavlink_item.frame = position_impl.get_mavlink_frame();
+                mavlink_item.command = MAV_CMD_NAV_LOITER_TIME;
+                mavlink_item.param1 = mission_item_impl.get_loiter_time_s(); // loiter time in seconds
+                mavlink_item.param2 = NAN; // empty
+                mavlink_item.param3 = 0.0f; // radius around waypoint in meters ?
+                mavlink_item.param4 = 0.0f; // loiter at center of waypoint
+                mavlink_item.x = position_impl.get_mavlink_x();
+                mavlink_item.y = position_impl.get_mavlink_y();
+                mavlink_item.z = position_impl.get_mavlink_z();
+                break;
+            }
 
-            uint16_t command = 0;
-            float param1 = NAN;
-            float param2 = NAN;
-            float param3 = NAN;
+        case MavlinkItemKind::CAMERA:
+            mavlink_item.frame = MAV_FRAME_MISSION;
+            mavlink_item.param1 = NAN;
+            mavlink_item.param2 = NAN;
+            mavlink_item.param3 = NAN;
+            mavlink_item.param4 = NAN;
+            mavlink_item.z = NAN;
             switch (mission_item_impl.get_camera_action()) {
                 case MissionItem::CameraAction::TAKE_PHOTO:
-                    command = MAV_CMD_IMAGE_START_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    param2 = 0.0f; // no duration, take only one picture
-                    param3 = 1.0f; // only take one picture
+                    mavlink_item.command = MAV_CMD_IMAGE_START_CAPTURE;
+                    mavlink_item.param1 = 0.0f; // all camera IDs
+                    mavlink_item.param2 = 0.0f; // no duration, take only one picture
+                    mavlink_item.param3 = 1.0f; // only take one picture
                     break;
                 case MissionItem::CameraAction::START_PHOTO_INTERVAL:
-                    command = MAV_CMD_IMAGE_START_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
-                    param2 = mission_item_impl.get_camera_photo_interval_s();
-                    param3 = 0.0f; // unlimited photos
+                    mavlink_item.command = MAV_CMD_IMAGE_START_CAPTURE;
+                    mavlink_item.param1 = 0.0f; // all camera IDs
+                    mavlink_item.param2 = mission_item_impl.get_camera_photo_interval_s();
+                    mavlink_item.param3 = 0.0f; // unlimited photos
                     break;
                 case MissionItem::CameraAction::STOP_PHOTO_INTERVAL:
-                    command = MAV_CMD_IMAGE_STOP_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
+                    mavlink_item.command = MAV_CMD_IMAGE_STOP_CAPTURE;
+                    mavlink_item.param1 = 0.0f; // all camera IDs
                     break;
                 case MissionItem::CameraAction::START_VIDEO:
-                    command = MAV_CMD_VIDEO_START_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
+                    mavlink_item.command = MAV_CMD_VIDEO_START_CAPTURE;
+                    mavlink_item.param1 = 0.0f; // all camera IDs
                     break;
                 case MissionItem::CameraAction::STOP_VIDEO:
-                    command = MAV_CMD_VIDEO_STOP_CAPTURE;
-                    param1 = 0.0f; // all camera IDs
+                    mavlink_item.command = MAV_CMD_VIDEO_STOP_CAPTURE;
+                    mavlink_item.param1 = 0.0f; // all camera IDs
                     break;
                 default:
                     LogErr() << "Error: camera action not supported";
                     break;
             }
+            break;
 
-            auto message_camera = std::make_shared<mavlink_message_t>();
-            mavlink_msg_mission_item_int_pack(GCSClient::system_id,
-                                              GCSClient::component_id,
-                                              message_camera.get(),
-                                              _parent->get_system_id(),
-                                              _parent->get_autopilot_id(),
-                                              _mission_data.mavlink_mission_item_messages.size(),
-                                              MAV_FRAME_MISSION,
-                                              command,
-                                              current,
-                                              autocontinue,
-                                              param1,
-                                              param2,
-                                              param3,
-                                              NAN,
-                                              0,
-                                              0,
-                                              NAN,
-                                              MAV_MISSION_TYPE_MISSION);
-
-            _mission_data.mavlink_mission_item_to_mission_item_indices.insert(
-                std::pair <int, int>
-            {static_cast<int>(_mission_data.mavlink_mission_item_messages.size()), item_i});
-            _mission_data.mavlink_mission_item_messages.push_back(message_camera);
-        }
-
-        ++item_i;
+        case MavlinkItemKind::RAW:
+            // Not generated, these are copied as they are.
+            break;
     }
 }
 
@@ -671,97 +1340,107 @@ void MissionImpl::assemble_mission_items()
         auto new_mission_item = std::make_shared<MissionItem>();
         bool have_set_position = false;
 
-        if (_mission_data.mavlink_mission_items_downloaded.size() > 0) {
-            // The first mission item needs to be a waypoint with position.
-            if (_mission_data.mavlink_mission_items_downloaded.at(0)->command != MAV_CMD_NAV_WAYPOINT) {
-                LogErr() << "First mission item is not a waypoint";
-                result = Mission::Result::UNSUPPORTED;
-                return;
-            }
-        }
-
         if (_mission_data.mavlink_mission_items_downloaded.size() == 0) {
             LogErr() << "No downloaded mission items";
             result = Mission::Result::NO_MISSION_AVAILABLE;
-            return;
-        }
-
-        for (auto &it : _mission_data.mavlink_mission_items_downloaded) {
-            LogDebug() << "Assembling Message: " << int(it->seq);
-
-
-            if (it->command == MAV_CMD_NAV_WAYPOINT) {
-                if (it->frame != MAV_FRAME_GLOBAL_RELATIVE_ALT_INT) {
-                    LogErr() << "Waypoint frame not supported unsupported";
-                    result = Mission::Result::UNSUPPORTED;
-                    break;
-                }
-
-                if (have_set_position) {
-                    // When a new position comes in, create next mission item.
-                    _mission_data.mission_items.push_back(new_mission_item);
-                    new_mission_item = std::make_shared<MissionItem>();
-                    have_set_position = false;
-                }
-
-                new_mission_item->set_position(double(it->x) * 1e-7, double(it->y) * 1e-7);
-                new_mission_item->set_relative_altitude(it->z);
 
-                new_mission_item->set_fly_through(!(it->param1 > 0));
-
-                have_set_position = true;
-
-            } else if (it->command == MAV_CMD_DO_MOUNT_CONTROL) {
-                if (int(it->z) != MAV_MOUNT_MODE_MAVLINK_TARGETING) {
-                    LogErr() << "Gimbal mount mode unsupported";
-                    result = Mission::Result::UNSUPPORTED;
-                    break;
-                }
+        } else if (_mission_data.mavlink_mission_items_downloaded.at(0).command !=
+                   MAV_CMD_NAV_WAYPOINT) {
+            // The first mission item needs to be a waypoint with position.
+            LogErr() << "First mission item is not a waypoint";
+            result = Mission::Result::UNSUPPORTED;
+        }
 
-                new_mission_item->set_gimbal_pitch_and_yaw(it->param1, it->param3);
+        if (result == Mission::Result::SUCCESS) {
+            for (const auto &it : _mission_data.mavlink_mission_items_downloaded) {
+                LogDebug() << "Assembling Message: " << int(it.seq);
+
+
+                if (it.command == MAV_CMD_NAV_WAYPOINT) {
+                    if (it.frame != MAV_FRAME_GLOBAL_RELATIVE_ALT_INT) {
+                        LogErr() << "Waypoint frame not supported unsupported";
+                        result = Mission::Result::UNSUPPORTED;
+                        break;
+                    }
+
+                    if (have_set_position) {
+                        // When a new position comes in, create next mission item.
+                        _mission_data.mission_items.push_back(new_mission_item);
+                        new_mission_item = std::make_shared<MissionItem>();
+                        have_set_position = false;
+                    }
+
+                    new_mission_item->set_position(double(it.x) * 1e-7, double(it.y) * 1e-7);
+                    new_mission_item->set_relative_altitude(it.z);
+
+                    new_mission_item->set_fly_through(!(it.param1 > 0));
+
+                    have_set_position = true;
+
+                } else if (it.command == MAV_CMD_DO_MOUNT_CONTROL) {
+                    if (int(it.z) != MAV_MOUNT_MODE_MAVLINK_TARGETING) {
+                        LogErr() << "Gimbal mount mode unsupported";
+                        result = Mission::Result::UNSUPPORTED;
+                        break;
+                    }
+
+                    new_mission_item->set_gimbal_pitch_and_yaw(it.param1, it.param3);
+
+                } else if (it.command == MAV_CMD_IMAGE_START_CAPTURE) {
+                    if (it.param2 > 0 && int(it.param3) == 0) {
+                        new_mission_item->set_camera_action(MissionItem::CameraAction::START_PHOTO_INTERVAL);
+                        new_mission_item->set_camera_photo_interval(double(it.param2));
+                    } else if (int(it.param2) == 0 && int(it.param3) == 1) {
+                        new_mission_item->set_camera_action(MissionItem::CameraAction::TAKE_PHOTO);
+                    } else {
+                        LogErr() << "Mission item START_CAPTURE params unsupported.";
+                        result = Mission::Result::UNSUPPORTED;
+                        break;
+                    }
+
+                } else if (it.command == MAV_CMD_IMAGE_STOP_CAPTURE) {
+                    new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
+
+                } else if (it.command == MAV_CMD_VIDEO_START_CAPTURE) {
+                    new_mission_item->set_camera_action(MissionItem::CameraAction::START_VIDEO);
+
+                } else if (it.command == MAV_CMD_VIDEO_STOP_CAPTURE) {
+                    new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_VIDEO);
+
+                } else if (it.command == MAV_CMD_DO_CHANGE_SPEED) {
+                    if (int(it.param1) == 1 && it.param3 < 0 && int(it.param4) == 0) {
+                        new_mission_item->set_speed(it.param2);
+                    } else {
+                        LogErr() << "Mission item DO_CHANGE_SPEED params unsupported";
+                        result = Mission::Result::UNSUPPORTED;
+                    }
+
+                } else if (it.command == MAV_CMD_NAV_LOITER_TIME) {
+                    new_mission_item->set_loiter_time(it.param1);
 
-            } else if (it->command == MAV_CMD_IMAGE_START_CAPTURE) {
-                if (it->param2 > 0 && int(it->param3) == 0) {
-                    new_mission_item->set_camera_action(MissionItem::CameraAction::START_PHOTO_INTERVAL);
-                    new_mission_item->set_camera_photo_interval(double(it->param2));
-                } else if (int(it->param2) == 0 && int(it->param3) == 1) {
-                    new_mission_item->set_camera_action(MissionItem::CameraAction::TAKE_PHOTO);
                 } else {
-                    LogErr() << "Mission item START_CAPTURE params unsupported.";
+                    LogErr() << "UNSUPPORTED mission item command (" << it.command << ")";
                     result = Mission::Result::UNSUPPORTED;
                     break;
                 }
+            }
 
-            } else if (it->command == MAV_CMD_IMAGE_STOP_CAPTURE) {
-                new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_PHOTO_INTERVAL);
-
-            } else if (it->command == MAV_CMD_VIDEO_START_CAPTURE) {
-                new_mission_item->set_camera_action(MissionItem::CameraAction::START_VIDEO);
-
-            } else if (it->command == MAV_CMD_VIDEO_STOP_CAPTURE) {
-                new_mission_item->set_camera_action(MissionItem::CameraAction::STOP_VIDEO);
-
-            } else if (it->command == MAV_CMD_DO_CHANGE_SPEED) {
-                if (int(it->param1) == 1 && it->param3 < 0 && int(it->param4) == 0) {
-                    new_mission_item->set_speed(it->param2);
-                } else {
-                    LogErr() << "Mission item DO_CHANGE_SPEED params unsupported";
-                    result = Mission::Result::UNSUPPORTED;
-                }
+            // Don't forget to add last mission item.
+            _mission_data.mission_items.push_back(new_mission_item);
+        }
 
-            } else if (it->command == MAV_CMD_NAV_LOITER_TIME) {
-                new_mission_item->set_loiter_time(it->param1);
+        publish_progress();
 
-            } else {
-                LogErr() << "UNSUPPORTED mission item command (" << it->command << ")";
-                result = Mission::Result::UNSUPPORTED;
-                break;
+        // This is what is on the autopilot now, so we can update against it.
+        _mission_data.synced_item_hashes.clear();
+        if (result == Mission::Result::SUCCESS) {
+            _mission_data.synced_item_hashes.reserve(
+                _mission_data.mavlink_mission_items_downloaded.size());
+            for (const auto &item : _mission_data.mavlink_mission_items_downloaded) {
+                _mission_data.synced_item_hashes.push_back(hash_mavlink_mission_item(item));
             }
         }
 
-        // Don't forget to add last mission item.
-        _mission_data.mission_items.push_back(new_mission_item);
-
         // Copy the callback out of the locked scope.
         callback = _mission_data.mission_items_and_result_callback;
     }
@@ -774,22 +1453,61 @@ void MissionImpl::assemble_mission_items()
     }
 }
 
-void MissionImpl::download_next_mission_item()
+void MissionImpl::request_next_mission_items()
 {
-    mavlink_message_t message;
-    {
-        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-        mavlink_msg_mission_request_int_pack(GCSClient::system_id,
-                                             GCSClient::component_id,
-                                             &message,
-                                             _parent->get_system_id(),
-                                             _parent->get_autopilot_id(),
-                                             _mission_data.next_mission_item_to_download,
-                                             MAV_MISSION_TYPE_MISSION);
+    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+
+    // Keep a window of requests in flight ahead of the first item still missing,
+    // instead of waiting for each item before requesting the next one.
+    while (_mission_data.next_mission_item_to_download <
+           _mission_data.num_mission_items_to_download &&
+           _mission_data.next_mission_item_to_download <
+           _mission_data.first_missing_mission_item + int(DOWNLOAD_WINDOW)) {
+        request_mission_item(_mission_data.next_mission_item_to_download++);
+    }
+}
+
+void MissionImpl::request_missing_mission_items()
+{
+    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+
+    if (_mission_data.num_mission_items_to_download < 0) {
+        // We don't even have the count yet.
+        mavlink_message_t message;
+        mavlink_msg_mission_request_list_pack(GCSClient::system_id,
+                                              GCSClient::component_id,
+                                              &message,
+                                              _parent->get_system_id(),
+                                              _parent->get_autopilot_id(),
+                                              MAV_MISSION_TYPE_MISSION);
+        _parent->send_message(message);
+        return;
+    }
 
-        LogDebug() << "Requested mission item " << _mission_data.next_mission_item_to_download;
+    // Only the gaps among the items requested so far are requested again.
+    for (int seq = _mission_data.first_missing_mission_item;
+         seq < _mission_data.next_mission_item_to_download; ++seq) {
+        if (!_mission_data.mission_items_downloaded[seq]) {
+            request_mission_item(seq);
+        }
     }
 
+    request_next_mission_items();
+}
+
+void MissionImpl::request_mission_item(int seq)
+{
+    mavlink_message_t message;
+    mavlink_msg_mission_request_int_pack(GCSClient::system_id,
+                                         GCSClient::component_id,
+                                         &message,
+                                         _parent->get_system_id(),
+                                         _parent->get_autopilot_id(),
+                                         seq,
+                                         MAV_MISSION_TYPE_MISSION);
+
+    LogDebug() << "Requested mission item " << seq;
+
     _parent->send_message(message);
 }
 
@@ -859,13 +1577,14 @@ void MissionImpl::set_current_mission_item_async(int current, Mission::result_ca
     {
         std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
         // We need to find the first mavlink item which maps to the current mission item.
-        for (auto it = _mission_data.mavlink_mission_item_to_mission_item_indices.begin();
-             it != _mission_data.mavlink_mission_item_to_mission_item_indices.end();
-             ++it) {
-            if (it->second == current) {
-                mavlink_index = it->first;
-                break;
-            }
+        // The indices only ever go up, so we can search them.
+        const auto &sources = _mission_data.mavlink_mission_item_sources;
+        auto it = std::lower_bound(sources.begin(), sources.end(), current,
+        [](const MavlinkItemSource & source, int index) {
+            return source.mission_item_index < index;
+        });
+        if (it != sources.end() && it->mission_item_index == current) {
+            mavlink_index = int(it - sources.begin());
         }
     }
 
@@ -902,24 +1621,59 @@ void MissionImpl::upload_mission_item(uint16_t seq)
 {
     std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
     LogDebug() << "Send mission item " << int(seq);
-    if (seq >= _mission_data.mavlink_mission_item_messages.size()) {
+    if (seq >= _mission_data.mavlink_mission_item_sources.size()) {
         LogErr() << "Mission item requested out of bounds.";
         return;
     }
 
-    _parent->send_message(*_mission_data.mavlink_mission_item_messages.at(seq));
+    // The item is only generated now that it is requested.
+    mavlink_mission_item_int_t mavlink_item;
+    make_mavlink_mission_item(seq, mavlink_item);
+
+    mavlink_message_t message;
+    mavlink_msg_mission_item_int_encode(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        &mavlink_item);
+
+    _parent->send_message(message);
+
+    if (_mission_data.item_sent_callback) {
+        const auto item_sent_callback = _mission_data.item_sent_callback;
+        _parent->call_user_callback([item_sent_callback, seq]() {
+            item_sent_callback(seq);
+        });
+    }
 }
 
-void MissionImpl::copy_mission_item_vector(const std::vector<std::shared_ptr<MissionItem>>
-                                           &mission_items)
+void MissionImpl::forget_synced_mission()
 {
     std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-    _mission_data.mission_items.clear();
+    // We don't know what the autopilot ended up with.
+    _mission_data.synced_item_hashes.clear();
+    _mission_data.pending_item_hashes.clear();
+    _mission_data.partial_ranges.clear();
+}
 
-    // Copy over the shared_ptr into our own vector.
-    for (auto item : mission_items) {
-        _mission_data.mission_items.push_back(item);
+void MissionImpl::copy_mission_item_vector(const std::vector<std::shared_ptr<MissionItem>>
+                                           &mission_items)
+{
+    // The wire items are made from these on request, so keep our own copies in case the
+    // caller changes theirs while the upload is going on.
+    Mission::mission_items_t copies;
+    copies.reserve(mission_items.size());
+    for (const auto &item : mission_items) {
+        if (!item) {
+            copies.push_back(nullptr);
+            continue;
+        }
+        auto copy = std::make_shared<MissionItem>();
+        *(copy->_impl) = *(item->_impl);
+        copies.push_back(copy);
     }
+
+    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+    _mission_data.mission_items.swap(copies);
 }
 
 void MissionImpl::report_mission_result(const Mission::result_callback_t &callback,
@@ -944,14 +1698,21 @@ void MissionImpl::report_mission_items_and_result(const Mission::mission_items_a
         return;
     }
 
-    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-    if (result != Mission::Result::SUCCESS) {
-        // Don't return garbage, better clear it.
-        _mission_data.mission_items.clear();
+    // The items are copied once here, under the lock, and then moved into the
+    // callback. The copy of the lambda by the executor only copies the pointer.
+    auto mission_items = std::make_shared<Mission::mission_items_t>();
+    {
+        std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+        if (result != Mission::Result::SUCCESS) {
+            // Don't return garbage, better clear it.
+            _mission_data.mission_items.clear();
+            publish_progress();
+        } else {
+            *mission_items = _mission_data.mission_items;
+        }
     }
-    _parent->call_user_callback([callback, result, this]() {
-        // This one is tricky because we keep the lock of the mission data during the callback.
-        callback(result, _mission_data.mission_items);
+    _parent->call_user_callback([callback, result, mission_items]() {
+        callback(result, std::move(*mission_items));
     });
 }
 
@@ -988,25 +1749,26 @@ void MissionImpl::receive_command_result(MAVLinkCommands::Result result,
 
 bool MissionImpl::is_mission_finished() const
 {
-    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+    const int last_current = _progress.last_current_mavlink_mission_item;
+    const int last_reached = _progress.last_reached_mavlink_mission_item;
+    const int total_mavlink = _progress.total_mavlink_mission_items;
 
-    if (_mission_data.last_current_mavlink_mission_item < 0) {
+    if (last_current < 0) {
         return false;
     }
 
-    if (_mission_data.last_reached_mavlink_mission_item < 0) {
+    if (last_reached < 0) {
         return false;
     }
 
-    if (_mission_data.mavlink_mission_item_messages.size() == 0) {
+    if (total_mavlink == 0) {
         return false;
     }
 
     // It is not straightforward to look at "current" because it jumps to 0
     // once the last item has been done. Therefore we have to lo decide using
     // "reached" here.
-    return (unsigned(_mission_data.last_reached_mavlink_mission_item + 1)
-            == _mission_data.mavlink_mission_item_messages.size());
+    return (last_reached + 1 == total_mavlink);
 }
 
 int MissionImpl::current_mission_item() const
@@ -1017,28 +1779,37 @@ int MissionImpl::current_mission_item() const
         return total_mission_items();
     }
 
-    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+    return _progress.current_mission_item;
+}
 
-    // We want to return the current mission item and not the underlying
-    // mavlink mission item. Therefore we check the index map.
-    auto entry = _mission_data.mavlink_mission_item_to_mission_item_indices.find(
-                     _mission_data.last_current_mavlink_mission_item);
+int MissionImpl::total_mission_items() const
+{
+    return _progress.total_mission_items;
+}
 
-    if (entry != _mission_data.mavlink_mission_item_to_mission_item_indices.end()) {
-        return entry->second;
+void MissionImpl::publish_progress()
+{
+    if (_mission_data.raw_mavlink_mission_items.size() > 0) {
+        _progress.total_mission_items = int(_mission_data.raw_mavlink_mission_items.size());
+    } else {
+        _progress.total_mission_items = int(_mission_data.mission_items.size());
+    }
+    _progress.total_mavlink_mission_items =
+        int(_mission_data.mavlink_mission_item_sources.size());
 
+    // We want to return the current mission item and not the underlying
+    // mavlink mission item. Therefore we check the index map.
+    const int mavlink_index = _progress.last_current_mavlink_mission_item;
+    if (mavlink_index >= 0 &&
+        unsigned(mavlink_index) < _mission_data.mavlink_mission_item_sources.size()) {
+        _progress.current_mission_item =
+            _mission_data.mavlink_mission_item_sources[mavlink_index].mission_item_index;
     } else {
         // Somehow we couldn't find it in the map
-        return -1;
+        _progress.current_mission_item = -1;
     }
 }
 
-int MissionImpl::total_mission_items() const
-{
-    std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
-    return _mission_data.mission_items.size();
-}
-
 void MissionImpl::subscribe_progress(Mission::progress_callback_t callback)
 {
     std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
@@ -1048,6 +1819,7 @@ void MissionImpl::subscribe_progress(Mission::progress_callback_t callback)
 void MissionImpl::process_timeout()
 {
     bool should_retry = false;
+    bool upload_timed_out = false;
     {
         std::lock_guard<std::mutex> lock(_activity.mutex);
 
@@ -1055,8 +1827,9 @@ void MissionImpl::process_timeout()
             // We can't retry this, the autopilot should be requesting the items
             // again.
             _activity.state = Activity::State::NONE;
+            forget_synced_mission();
             LogWarn() << "Mission handling timed out while uploading mission.";
-            return;
+            upload_timed_out = true;
 
         } else if (_activity.state == Activity::State::GET_MISSION) {
             should_retry = true;
@@ -1065,6 +1838,16 @@ void MissionImpl::process_timeout()
         }
     }
 
+    if (upload_timed_out) {
+        Mission::result_callback_t result_callback;
+        {
+            std::lock_guard<std::recursive_mutex> lock(_mission_data.mutex);
+            result_callback = _mission_data.result_callback;
+        }
+        report_mission_result(result_callback, Mission::Result::TIMEOUT);
+        return;
+    }
+
     if (should_retry) {
         _mission_data.mutex.lock();
         if (_mission_data.retries++ > MAX_RETRIES) {
@@ -1081,11 +1864,11 @@ void MissionImpl::process_timeout()
         } else {
             _mission_data.mutex.unlock();
 
-            LogWarn() << "Retrying requesting mission item...";
+            LogWarn() << "Retrying requesting missing mission items...";
             // We are retrying, so we use the lower timeout.
             _parent->register_timeout_handler(std::bind(&MissionImpl::process_timeout, this),
                                               RETRY_TIMEOUT_S, &_timeout_cookie);
-            download_next_mission_item();
+            request_missing_mission_items();
         }
 
     }
@@ -1095,32 +1878,39 @@ Mission::Result
 MissionImpl::import_qgroundcontrol_mission(Mission::mission_items_t &mission_items,
                                            const std::string &qgc_plan_file)
 {
-    std::ifstream file(qgc_plan_file);
-    if (!file) { // File open error
-        return Mission::Result::FAILED_TO_OPEN_QGC_PLAN;
-    }
+    // Clear old mission items
+    mission_items.clear();
+
+    Mission::Result result = Mission::Result::SUCCESS;
+    auto new_mission_item = std::make_shared<MissionItem>();
 
-    // Read QGC plan into a string stream
-    std::stringstream ss;
-    ss << file.rdbuf();
-    file.close();
+    // The mission items are built while the plan is parsed, item by item.
+    auto add_item = [&](const QGCPlanParser::Item & item) {
+        result = build_mission_items(static_cast<MAV_CMD>(item.command), item.params,
+                                     new_mission_item, mission_items);
+        return result == Mission::Result::SUCCESS;
+    };
 
-    std::string err;
-    const auto parsed_plan = Json::parse(ss.str(), err); // parse QGC plan
-    if (!err.empty()) { // Parse error
+    bool open_failed = false;
+    const bool parsed = QGCPlanParser::parse_file(qgc_plan_file, add_item, open_failed);
+
+    if (open_failed) { // File open error
+        return Mission::Result::FAILED_TO_OPEN_QGC_PLAN;
+    }
+    if (!parsed) { // Parse error
+        mission_items.clear();
         return Mission::Result::FAILED_TO_PARSE_QGC_PLAN;
     }
 
-    // Clear old mission items
-    mission_items.clear();
-
-    // Import mission items
-    return import_mission_items(mission_items, parsed_plan);
+    // Don't forget to add the last mission which possibly didn't have position set.
+    mission_items.push_back(new_mission_item);
+    return result;
 }
 
 // Build a mission item out of command, params and add them to the mission vector.
 Mission::Result
-MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
+MissionImpl::build_mission_items(MAV_CMD command,
+                                 const double (&params)[QGCPlanParser::MAX_PARAMS],
                                  std::shared_ptr<MissionItem> &new_mission_item,
                                  Mission::mission_items_t &all_mission_items)
 {
@@ -1199,35 +1989,4 @@ MissionImpl::build_mission_items(MAV_CMD command, std::vector<double> params,
     return result;
 }
 
-Mission::Result
-MissionImpl::import_mission_items(Mission::mission_items_t &all_mission_items,
-                                  const Json &qgc_plan_json)
-{
-    const auto json_mission_items = qgc_plan_json["mission"];
-    Mission::Result result = Mission::Result::SUCCESS;
-    auto new_mission_item = std::make_shared<MissionItem>();
-
-    // Iterate JSON mission items and build DroneCore mission items
-    for (auto &json_mission_item : json_mission_items["items"].array_items()) {
-        // Parameters of Mission item & MAV command of it.
-        MAV_CMD command = static_cast<MAV_CMD>(json_mission_item["command"].int_value());
-
-        // Extract parameters of each mission item
-        std::vector<double> params;
-        for (auto &p : json_mission_item["params"].array_items()) {
-            params.push_back(p.number_value());
-        }
-
-        result = build_mission_items(command, params,
-                                     new_mission_item,
-                                     all_mission_items);
-        if (result != Mission::Result::SUCCESS) {
-            break;
-        }
-    }
-    // Don't forget to add the last mission which possibly didn't have position set.
-    all_mission_items.push_back(new_mission_item);
-    return result;
-}
-
 } // namespace dronecore
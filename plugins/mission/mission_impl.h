@@ -1,17 +1,18 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
-#include <map>
 #include <mutex>
+#include <utility>
 
 #include "system.h"
 #include "mavlink_system.h"
 #include "mavlink_include.h"
 #include "mission.h"
 #include "plugin_impl_base.h"
-#include <json11.hpp>
-
-using namespace json11;
+#include "qgc_plan_parser.h"
+#include "mission_file.h"
+#include "mission_transfer.h"
 
 namespace dronecore {
 
@@ -30,8 +31,52 @@ public:
     void upload_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
                               const Mission::result_callback_t &callback);
 
+    void update_mission_async(const std::vector<std::shared_ptr<MissionItem>> &mission_items,
+                              const Mission::result_callback_t &callback);
+
+    void upload_mission_file_async(const std::string &path,
+                                   const Mission::result_callback_t &callback);
+
+    void upload_survey_async(const Mission::Survey &survey,
+                             const Mission::result_callback_t &callback);
+
+    // The wire items of a mission, generated once to be uploaded to several systems.
+    struct EncodedMission;
+    static std::shared_ptr<const EncodedMission> encode_mission(const Mission::mission_items_t
+                                                                &mission_items);
+
+    typedef std::function<void(uint16_t seq)> item_sent_callback_t;
+
+    // The encoded mission needs to be made from the same mission_items.
+    void upload_encoded_mission_async(const Mission::mission_items_t &mission_items,
+                                      const std::shared_ptr<const EncodedMission> &encoded,
+                                      const Mission::result_callback_t &callback,
+                                      const item_sent_callback_t &item_sent_callback);
+
     void download_mission_async(const Mission::mission_items_and_result_callback_t &callback);
 
+    Mission::Result save_downloaded_mission_file(const std::string &path) const;
+
+    void upload_geofence_async(const Mission::Geofence &geofence,
+                               const Mission::result_callback_t &callback);
+    void download_geofence_async(const Mission::geofence_and_result_callback_t &callback);
+
+    void upload_rally_points_async(const std::vector<Mission::RallyPoint> &rally_points,
+                                   const Mission::result_callback_t &callback);
+    void download_rally_points_async(const Mission::rally_points_and_result_callback_t
+                                     &callback);
+
+    // Between the geofence and rally points and their wire items, without seq and targets.
+    static Mission::Result make_geofence_items(const Mission::Geofence &geofence,
+                                               std::vector<mavlink_mission_item_int_t> &items);
+    static Mission::Result assemble_geofence(const std::vector<mavlink_mission_item_int_t> &items,
+                                             Mission::Geofence &geofence);
+    static void make_rally_point_items(const std::vector<Mission::RallyPoint> &rally_points,
+                                       std::vector<mavlink_mission_item_int_t> &items);
+    static Mission::Result assemble_rally_points(const std::vector<mavlink_mission_item_int_t>
+                                                 &items,
+                                                 std::vector<Mission::RallyPoint> &rally_points);
+
     void start_mission_async(const Mission::result_callback_t &callback);
     void pause_mission_async(const Mission::result_callback_t &callback);
 
@@ -46,6 +91,21 @@ public:
 
     static Mission::Result import_qgroundcontrol_mission(Mission::mission_items_t &mission_items,
                                                          const std::string &qgc_plan_file);
+
+    static Mission::Result save_mission_file(const Mission::mission_items_t &mission_items,
+                                             const std::string &path);
+
+    // First and last seq, both included.
+    typedef std::pair<uint16_t, uint16_t> seq_range_t;
+
+    // The ranges of seqs to send so that the items hashed in before become the ones
+    // hashed in after. Both need to be of the same size.
+    static void find_changed_ranges(const std::vector<uint64_t> &before,
+                                    const std::vector<uint64_t> &after,
+                                    std::vector<seq_range_t> &ranges);
+
+    static uint64_t hash_mavlink_mission_item(const mavlink_mission_item_int_t &item);
+
     // Non-copyable
     MissionImpl(const MissionImpl &) = delete;
     const MissionImpl &operator=(const MissionImpl &) = delete;
@@ -61,11 +121,58 @@ private:
 
     void process_timeout();
 
+    // The transfer of the geofence or rally points, nullptr for the mission itself.
+    MissionTransfer *get_transfer(uint8_t mission_type);
+
     void upload_mission_item(uint16_t seq);
 
+    // Takes the items, which are sent as they are.
+    void upload_raw_mission_items(std::vector<mavlink_mission_item_int_t> &raw_items,
+                                  const Mission::result_callback_t &callback);
+    void send_mission_count(const Mission::result_callback_t &callback);
+    static Mission::Result to_mission_result(MissionFile::Result result);
+    bool send_next_partial_range();
+    void hash_mavlink_mission_items(std::vector<uint64_t> &hashes);
+    void forget_synced_mission();
+
     void copy_mission_item_vector(const std::vector<std::shared_ptr<MissionItem>> &mission_items);
 
-    void assemble_mavlink_messages();
+    // What a mavlink item is generated from.
+    enum class MavlinkItemKind : uint8_t {
+        POSITION,
+        SPEED,
+        GIMBAL,
+        DELAY,
+        CAMERA,
+        // Loaded from a mission file, mission_item_index is the index of the raw item.
+        RAW
+    };
+    struct MavlinkItemSource {
+        int mission_item_index;
+        // The item with the position to loiter at, only used by DELAY.
+        int position_item_index;
+        MavlinkItemKind kind;
+    };
+
+public:
+    struct EncodedMission {
+        std::vector<MavlinkItemSource> sources;
+        // Without targets, these are set for each system when sending.
+        std::vector<mavlink_mission_item_int_t> items;
+        std::vector<uint64_t> hashes;
+    };
+
+private:
+    void index_mavlink_mission_items();
+    static void index_mavlink_mission_items(const Mission::mission_items_t &mission_items,
+                                            std::vector<MavlinkItemSource> &sources);
+    static void add_mavlink_mission_item_source(std::vector<MavlinkItemSource> &sources,
+                                                int mission_item_index, MavlinkItemKind kind,
+                                                int position_item_index = -1);
+    void make_mavlink_mission_item(uint16_t seq, mavlink_mission_item_int_t &mavlink_item);
+    static void make_mavlink_mission_item(const Mission::mission_items_t &mission_items,
+                                          const MavlinkItemSource &source, uint16_t seq,
+                                          mavlink_mission_item_int_t &mavlink_item);
 
     void report_mission_result(const Mission::result_callback_t &callback,
                                Mission::Result result);
@@ -74,18 +181,21 @@ private:
                                          Mission::Result result);
 
     void report_progress();
+    // Needs to be called with _mission_data.mutex locked whenever the mission or
+    // the current item changes.
+    void publish_progress();
 
     void receive_command_result(MAVLinkCommands::Result result,
                                 const Mission::result_callback_t callback);
 
-    void download_next_mission_item();
+    void request_next_mission_items();
+    void request_missing_mission_items();
+    void request_mission_item(int seq);
+    void finish_mission_download();
     void assemble_mission_items();
 
     static Mission::Result
-    import_mission_items(Mission::mission_items_t &mission_items,
-                         const Json &mission_json);
-    static Mission::Result
-    build_mission_items(MAV_CMD command, std::vector<double> params,
+    build_mission_items(MAV_CMD command, const double (&params)[QGCPlanParser::MAX_PARAMS],
                         std::shared_ptr<MissionItem> &new_mission_item,
                         Mission::mission_items_t &all_mission_items);
 
@@ -103,23 +213,62 @@ private:
     struct MissionData {
         mutable std::recursive_mutex mutex {};
         unsigned retries = 0;
-        int last_current_mavlink_mission_item {-1};
-        int last_reached_mavlink_mission_item {-1};
         std::vector<std::shared_ptr<MissionItem>> mission_items {};
-        std::vector<std::shared_ptr<mavlink_message_t>> mavlink_mission_item_messages {};
-        std::map<int, int> mavlink_mission_item_to_mission_item_indices {};
+        // What each mavlink item is made of, indexed by seq. The items are
+        // only generated when the autopilot requests them.
+        std::vector<MavlinkItemSource> mavlink_mission_item_sources {};
+        // Items of a mission file being uploaded, used instead of mission_items.
+        std::vector<mavlink_mission_item_int_t> raw_mavlink_mission_items {};
+        // Shared with other systems the same mission is uploaded to, used instead
+        // of generating the items.
+        std::shared_ptr<const EncodedMission> encoded_mission {};
+        item_sent_callback_t item_sent_callback {nullptr};
+        // Hashes of the items on the autopilot as of the last transfer, empty if unknown.
+        std::vector<uint64_t> synced_item_hashes {};
+        // Hashes of the items being uploaded.
+        std::vector<uint64_t> pending_item_hashes {};
+        std::vector<seq_range_t> partial_ranges {};
+        unsigned next_partial_range {0};
         int num_mission_items_to_download {-1};
+        // The first item not requested yet.
         int next_mission_item_to_download {-1};
-        std::vector<std::shared_ptr<mavlink_mission_item_int_t>> mavlink_mission_items_downloaded {};
+        // Everything below has been received.
+        int first_missing_mission_item {-1};
+        int num_mission_items_downloaded {0};
+        // As reported in MISSION_COUNT, 0 if the autopilot doesn't support it.
+        uint32_t download_opaque_id {0};
+        // Indexed by seq, items arrive in any order.
+        std::vector<mavlink_mission_item_int_t> mavlink_mission_items_downloaded {};
+        std::vector<bool> mission_items_downloaded {};
         Mission::result_callback_t result_callback {nullptr};
         Mission::mission_items_and_result_callback_t mission_items_and_result_callback {nullptr};
         Mission::progress_callback_t progress_callback {nullptr};
     } _mission_data {};
 
+    // Published for readers such as a UI polling the progress, so that they never
+    // wait for the mission data lock. Written with _mission_data.mutex held.
+    struct Progress {
+        std::atomic<int> last_current_mavlink_mission_item {-1};
+        std::atomic<int> last_reached_mavlink_mission_item {-1};
+        // The mission item the current mavlink item belongs to, -1 if unknown.
+        std::atomic<int> current_mission_item {-1};
+        std::atomic<int> total_mission_items {0};
+        std::atomic<int> total_mavlink_mission_items {0};
+    } _progress {};
+
     void *_timeout_cookie {nullptr};
 
+    // Not part of the mission state above, so they can run alongside it.
+    MissionTransfer _geofence_transfer;
+    MissionTransfer _rally_point_transfer;
+
     static constexpr unsigned MAX_RETRIES = 3;
 
+    static constexpr unsigned MAX_UNCHANGED_IN_RANGE = 3;
+
+    // Number of mission item requests kept in flight while downloading.
+    static constexpr unsigned DOWNLOAD_WINDOW = 8;
+
     static constexpr uint8_t VEHICLE_MODE_FLAG_CUSTOM_MODE_ENABLED = 1;
 
     // FIXME: these chould potentially change anytime
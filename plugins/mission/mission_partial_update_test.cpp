@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "mission_impl.h"
+
+using namespace dronecore;
+
+TEST(MissionPartialUpdate, FindsNoRangesIfUnchanged)
+{
+    std::vector<uint64_t> hashes {1, 2, 3, 4};
+    std::vector<MissionImpl::seq_range_t> ranges {{0, 0}};
+
+    MissionImpl::find_changed_ranges(hashes, hashes, ranges);
+    EXPECT_EQ(ranges.size(), 0);
+}
+
+TEST(MissionPartialUpdate, FindsChangedRanges)
+{
+    std::vector<uint64_t> before(20, 0);
+    std::vector<uint64_t> after(before);
+    after[1] = 1;
+    after[2] = 1;
+    // Close enough to be sent along with the ones before.
+    after[5] = 1;
+    // Too far away, this is a separate range.
+    after[15] = 1;
+
+    std::vector<MissionImpl::seq_range_t> ranges;
+    MissionImpl::find_changed_ranges(before, after, ranges);
+
+    ASSERT_EQ(ranges.size(), 2);
+    EXPECT_EQ(ranges[0].first, 1);
+    EXPECT_EQ(ranges[0].second, 5);
+    EXPECT_EQ(ranges[1].first, 15);
+    EXPECT_EQ(ranges[1].second, 15);
+}
+
+TEST(MissionPartialUpdate, HashIgnoresTargetAndCurrent)
+{
+    mavlink_mission_item_int_t item {};
+    item.seq = 3;
+    item.command = MAV_CMD_NAV_WAYPOINT;
+    item.x = 473977418;
+    item.y = 85455939;
+    item.z = 10.0f;
+
+    mavlink_mission_item_int_t downloaded = item;
+    downloaded.target_system = 255;
+    downloaded.current = 1;
+    EXPECT_EQ(MissionImpl::hash_mavlink_mission_item(item),
+              MissionImpl::hash_mavlink_mission_item(downloaded));
+
+    mavlink_mission_item_int_t moved = item;
+    moved.x += 1;
+    EXPECT_NE(MissionImpl::hash_mavlink_mission_item(item),
+              MissionImpl::hash_mavlink_mission_item(moved));
+}
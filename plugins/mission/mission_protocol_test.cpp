@@ -0,0 +1,357 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "connection.h"
+#include "dronecore_impl.h"
+#include "mavlink_system.h"
+#include "mission.h"
+#include "mission_file.h"
+#include "mission_impl.h"
+#include "system.h"
+
+using namespace dronecore;
+
+namespace {
+
+// Messages are handed to DroneCoreImpl directly, what is sent is kept for the test.
+class RecordingConnection : public Connection
+{
+public:
+    explicit RecordingConnection(DroneCoreImpl &parent) : Connection(parent) {}
+
+    ConnectionResult start() override { return ConnectionResult::SUCCESS; }
+    ConnectionResult stop() override { return ConnectionResult::SUCCESS; }
+    bool is_ok() const override { return true; }
+
+    bool send_message(const mavlink_message_t &message) override
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _sent.push_back(message);
+        return true;
+    }
+
+    // Returns and forgets what was sent with this message ID so far.
+    std::vector<mavlink_message_t> take(uint32_t msgid)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        std::vector<mavlink_message_t> taken;
+        std::vector<mavlink_message_t> kept;
+        for (const auto &message : _sent) {
+            if (message.msgid == msgid) {
+                taken.push_back(message);
+            } else {
+                kept.push_back(message);
+            }
+        }
+        _sent.swap(kept);
+        return taken;
+    }
+
+protected:
+    bool write_buffer(const uint8_t *, size_t) override { return true; }
+
+private:
+    std::mutex _mutex {};
+    std::vector<mavlink_message_t> _sent {};
+};
+
+// Discovers a system which supports MISSION_ITEM_INT, its UUID is the system ID.
+void discover_system(DroneCoreImpl &dc, Connection &connection, uint8_t system_id)
+{
+    mavlink_message_t message;
+    mavlink_msg_heartbeat_pack(system_id, MAV_COMP_ID_AUTOPILOT1, &message,
+                               MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_PX4, 0, 0, 0);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+
+    mavlink_autopilot_version_t autopilot_version {};
+    autopilot_version.capabilities = MAV_PROTOCOL_CAPABILITY_MISSION_INT;
+    autopilot_version.uid = system_id;
+    mavlink_msg_autopilot_version_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message,
+                                         &autopilot_version);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+}
+
+void request_item(DroneCoreImpl &dc, Connection &connection, uint8_t system_id, uint16_t seq)
+{
+    mavlink_mission_request_int_t request {};
+    request.target_system = GCSClient::system_id;
+    request.target_component = GCSClient::component_id;
+    request.seq = seq;
+    request.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_request_int_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message, &request);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+}
+
+void send_count(DroneCoreImpl &dc, Connection &connection, uint8_t system_id, uint16_t count)
+{
+    mavlink_mission_count_t mission_count {};
+    mission_count.target_system = GCSClient::system_id;
+    mission_count.target_component = GCSClient::component_id;
+    mission_count.count = count;
+    mission_count.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_count_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message,
+                                     &mission_count);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+}
+
+// A plain waypoint, one mission item each.
+void send_item(DroneCoreImpl &dc, Connection &connection, uint8_t system_id, uint16_t seq)
+{
+    mavlink_mission_item_int_t item {};
+    item.target_system = GCSClient::system_id;
+    item.target_component = GCSClient::component_id;
+    item.seq = seq;
+    item.frame = MAV_FRAME_GLOBAL_RELATIVE_ALT_INT;
+    item.command = MAV_CMD_NAV_WAYPOINT;
+    item.autocontinue = 1;
+    item.x = 473977418 + seq;
+    item.y = 85455939;
+    item.z = 10.0f;
+    item.mission_type = MAV_MISSION_TYPE_MISSION;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_item_int_encode(system_id, MAV_COMP_ID_AUTOPILOT1, &message, &item);
+    dc.receive_message(message, connection, std::chrono::steady_clock::now());
+}
+
+std::vector<uint16_t> requested_seqs(RecordingConnection &connection)
+{
+    std::vector<uint16_t> seqs;
+    for (const auto &message : connection.take(MAVLINK_MSG_ID_MISSION_REQUEST_INT)) {
+        seqs.push_back(mavlink_msg_mission_request_int_get_seq(&message));
+    }
+    return seqs;
+}
+
+} // namespace
+
+static Mission::mission_items_t make_mission_items()
+{
+    Mission::mission_items_t mission_items;
+
+    auto first = std::make_shared<MissionItem>();
+    first->set_position(47.3977418, 8.5455939);
+    first->set_relative_altitude(10.0f);
+    first->set_speed(5.0f);
+    mission_items.push_back(first);
+
+    auto second = std::make_shared<MissionItem>();
+    second->set_position(47.3980000, 8.5460000);
+    second->set_relative_altitude(15.0f);
+    second->set_loiter_time(3.0f);
+    mission_items.push_back(second);
+
+    return mission_items;
+}
+
+TEST(MissionProtocol, UploadSendsRequestedSeqs)
+{
+    // The connection needs to outlive DroneCoreImpl, which sends to it.
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<RecordingConnection> connection(new RecordingConnection(*dc));
+    discover_system(*dc, *connection, 11);
+    std::unique_ptr<Mission> mission(new Mission(dc->get_system(11)));
+
+    const auto mission_items = make_mission_items();
+    const auto expected = MissionImpl::encode_mission(mission_items);
+    ASSERT_EQ(expected->items.size(), 4u);
+
+    mission->upload_mission_async(mission_items, [](Mission::Result) {});
+    const auto counts = connection->take(MAVLINK_MSG_ID_MISSION_COUNT);
+    ASSERT_EQ(counts.size(), 1u);
+    EXPECT_EQ(mavlink_msg_mission_count_get_count(&counts[0]), 4);
+
+    // Each seq is made when it is asked for, in whatever order that is.
+    for (uint16_t seq : {3, 1, 0, 2}) {
+        request_item(*dc, *connection, 11, seq);
+
+        const auto sent = connection->take(MAVLINK_MSG_ID_MISSION_ITEM_INT);
+        ASSERT_EQ(sent.size(), 1u);
+        mavlink_mission_item_int_t item;
+        mavlink_msg_mission_item_int_decode(&sent[0], &item);
+
+        EXPECT_EQ(item.seq, seq);
+        EXPECT_EQ(item.target_system, 11);
+        EXPECT_EQ(item.current, seq == 0 ? 1 : 0);
+        EXPECT_EQ(MissionImpl::hash_mavlink_mission_item(item), expected->hashes[seq]);
+    }
+
+    mission.reset();
+    dc.reset();
+}
+
+TEST(MissionProtocol, UploadIgnoresLaterChangesToItems)
+{
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<RecordingConnection> connection(new RecordingConnection(*dc));
+    discover_system(*dc, *connection, 12);
+    std::unique_ptr<Mission> mission(new Mission(dc->get_system(12)));
+
+    auto mission_items = make_mission_items();
+    const auto expected = MissionImpl::encode_mission(mission_items);
+
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto fut = prom->get_future();
+    mission->upload_mission_async(mission_items, [prom](Mission::Result result) {
+        prom->set_value(result);
+    });
+
+    // The items are only encoded once requested, by then the caller changed them.
+    mission_items[0]->set_position(0.0, 0.0);
+    mission_items[1]->set_loiter_time(30.0f);
+    mission_items.clear();
+
+    for (uint16_t seq = 0; seq < expected->items.size(); ++seq) {
+        request_item(*dc, *connection, 12, seq);
+
+        const auto sent = connection->take(MAVLINK_MSG_ID_MISSION_ITEM_INT);
+        ASSERT_EQ(sent.size(), 1u);
+        mavlink_mission_item_int_t item;
+        mavlink_msg_mission_item_int_decode(&sent[0], &item);
+        EXPECT_EQ(MissionImpl::hash_mavlink_mission_item(item), expected->hashes[seq]);
+    }
+
+    mavlink_mission_ack_t ack {};
+    ack.target_system = GCSClient::system_id;
+    ack.target_component = GCSClient::component_id;
+    ack.type = MAV_MISSION_ACCEPTED;
+    ack.mission_type = MAV_MISSION_TYPE_MISSION;
+    mavlink_message_t message;
+    mavlink_msg_mission_ack_encode(12, MAV_COMP_ID_AUTOPILOT1, &message, &ack);
+    dc->receive_message(message, *connection, std::chrono::steady_clock::now());
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), Mission::Result::SUCCESS);
+
+    mission.reset();
+    dc.reset();
+}
+
+TEST(MissionProtocol, DownloadKeepsWindowOfRequests)
+{
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<RecordingConnection> connection(new RecordingConnection(*dc));
+    discover_system(*dc, *connection, 13);
+    std::unique_ptr<Mission> mission(new Mission(dc->get_system(13)));
+
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto fut = prom->get_future();
+    mission->download_mission_async(
+    [prom](Mission::Result result, Mission::mission_items_t mission_items) {
+        EXPECT_EQ(mission_items.size(), 20u);
+        prom->set_value(result);
+    });
+    ASSERT_EQ(connection->take(MAVLINK_MSG_ID_MISSION_REQUEST_LIST).size(), 1u);
+
+    send_count(*dc, *connection, 13, 20);
+    EXPECT_EQ(requested_seqs(*connection),
+              std::vector<uint16_t>({0, 1, 2, 3, 4, 5, 6, 7}));
+
+    // The window only moves on once the first missing item is in.
+    for (uint16_t seq = 7; seq >= 1; --seq) {
+        send_item(*dc, *connection, 13, seq);
+    }
+    EXPECT_TRUE(requested_seqs(*connection).empty());
+
+    send_item(*dc, *connection, 13, 0);
+    EXPECT_EQ(requested_seqs(*connection),
+              std::vector<uint16_t>({8, 9, 10, 11, 12, 13, 14, 15}));
+
+    // Duplicates don't count.
+    send_item(*dc, *connection, 13, 3);
+    EXPECT_TRUE(requested_seqs(*connection).empty());
+
+    for (uint16_t seq = 8; seq < 20; ++seq) {
+        send_item(*dc, *connection, 13, seq);
+    }
+    EXPECT_EQ(connection->take(MAVLINK_MSG_ID_MISSION_ACK).size(), 1u);
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), Mission::Result::SUCCESS);
+
+    mission.reset();
+    dc.reset();
+}
+
+TEST(MissionProtocol, DownloadRequestsOnlyGapsAgain)
+{
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<RecordingConnection> connection(new RecordingConnection(*dc));
+    discover_system(*dc, *connection, 14);
+    std::unique_ptr<Mission> mission(new Mission(dc->get_system(14)));
+
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto fut = prom->get_future();
+    mission->download_mission_async(
+    [prom](Mission::Result result, Mission::mission_items_t mission_items) {
+        EXPECT_EQ(mission_items.size(), 4u);
+        prom->set_value(result);
+    });
+
+    send_count(*dc, *connection, 14, 4);
+    EXPECT_EQ(requested_seqs(*connection), std::vector<uint16_t>({0, 1, 2, 3}));
+
+    // Items 1 and 2 get lost.
+    send_item(*dc, *connection, 14, 0);
+    send_item(*dc, *connection, 14, 3);
+
+    // After the timeout only those are requested again.
+    std::vector<uint16_t> seqs;
+    for (int i = 0; i < 50 && seqs.empty(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        seqs = requested_seqs(*connection);
+    }
+    EXPECT_EQ(seqs, std::vector<uint16_t>({1, 2}));
+
+    send_item(*dc, *connection, 14, 2);
+    send_item(*dc, *connection, 14, 1);
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), Mission::Result::SUCCESS);
+
+    mission.reset();
+    dc.reset();
+}
+
+TEST(MissionProtocol, UploadRefusesMoreItemsThanCountFits)
+{
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<RecordingConnection> connection(new RecordingConnection(*dc));
+    discover_system(*dc, *connection, 15);
+    std::unique_ptr<Mission> mission(new Mission(dc->get_system(15)));
+
+    // One more than MISSION_COUNT can announce.
+    const std::string path = "mission_protocol_test.dcm";
+    std::vector<mavlink_mission_item_int_t> raw_items(size_t(UINT16_MAX) + 1);
+    ASSERT_EQ(MissionFile::save(path, raw_items), MissionFile::Result::SUCCESS);
+
+    auto prom = std::make_shared<std::promise<Mission::Result>>();
+    auto fut = prom->get_future();
+    mission->upload_mission_file_async(path, [prom](Mission::Result result) {
+        prom->set_value(result);
+    });
+    std::remove(path.c_str());
+
+    ASSERT_EQ(fut.wait_for(std::chrono::seconds(2)), std::future_status::ready);
+    EXPECT_EQ(fut.get(), Mission::Result::TOO_MANY_MISSION_ITEMS);
+    EXPECT_EQ(connection->take(MAVLINK_MSG_ID_MISSION_COUNT).size(), 0u);
+    EXPECT_EQ(mission->total_mission_items(), 0);
+
+    // Nothing was started, so the next upload isn't busy.
+    mission->upload_mission_async(make_mission_items(), [](Mission::Result) {});
+    const auto counts = connection->take(MAVLINK_MSG_ID_MISSION_COUNT);
+    ASSERT_EQ(counts.size(), 1u);
+    EXPECT_EQ(mavlink_msg_mission_count_get_count(&counts[0]), 4);
+
+    mission.reset();
+    dc.reset();
+}
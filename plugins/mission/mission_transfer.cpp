@@ -0,0 +1,378 @@
+#include "mission_transfer.h"
+#include "mission_cache.h"
+#include "mavlink_system.h"
+#include "global_include.h"
+#include "log.h"
+
+// Only newer MAVLink headers carry the opaque mission id in MISSION_COUNT.
+#if MAVLINK_MSG_ID_MISSION_COUNT_LEN >= 9
+#define MISSION_COUNT_HAS_OPAQUE_ID
+#endif
+
+namespace dronecore {
+
+constexpr unsigned MissionTransfer::MAX_RETRIES;
+constexpr unsigned MissionTransfer::DOWNLOAD_WINDOW;
+constexpr double MissionTransfer::RETRY_TIMEOUT_S;
+constexpr double MissionTransfer::PROCESS_TIMEOUT_S;
+
+MissionTransfer::MissionTransfer(MAVLinkSystem &parent, uint8_t mission_type) :
+    _parent(parent),
+    _mission_type(mission_type)
+{
+}
+
+MissionTransfer::~MissionTransfer()
+{
+    cancel();
+}
+
+void MissionTransfer::upload_async(std::vector<mavlink_mission_item_int_t> &items,
+                                   const result_callback_t &callback)
+{
+    Mission::Result result = Mission::Result::ERROR;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (start(State::UPLOAD, result)) {
+            // Whatever was on the autopilot before is about to be replaced.
+            MissionCache::instance().forget(_parent.get_uuid(), _mission_type);
+
+            _items.swap(items);
+            _result_callback = callback;
+
+            mavlink_message_t message;
+            mavlink_msg_mission_count_pack(GCSClient::system_id,
+                                           GCSClient::component_id,
+                                           &message,
+                                           _parent.get_system_id(),
+                                           _parent.get_autopilot_id(),
+                                           uint16_t(_items.size()),
+                                           _mission_type);
+
+            if (_parent.send_message(message)) {
+                // The autopilot pulls the items now.
+                _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                                 PROCESS_TIMEOUT_S, &_timeout_cookie);
+                return;
+            }
+            _state = State::NONE;
+            _result_callback = nullptr;
+        }
+    }
+
+    callback(result);
+}
+
+void MissionTransfer::download_async(const items_and_result_callback_t &callback)
+{
+    Mission::Result result = Mission::Result::ERROR;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (start(State::DOWNLOAD, result)) {
+            _items.clear();
+            _items_downloaded.clear();
+            _num_items_to_download = -1;
+            _items_and_result_callback = callback;
+
+            send_request_list();
+            // We retry the list request and the item requests, so we use the lower timeout.
+            _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                             RETRY_TIMEOUT_S, &_timeout_cookie);
+            return;
+        }
+    }
+
+    callback(result, std::vector<mavlink_mission_item_int_t>());
+}
+
+bool MissionTransfer::start(State state, Mission::Result &result)
+{
+    if (_state != State::NONE) {
+        result = Mission::Result::BUSY;
+        return false;
+    }
+    // Only the int messages are used.
+    if (!_parent.does_support_mission_int()) {
+        LogWarn() << "Mission int messages not supported";
+        result = Mission::Result::ERROR;
+        return false;
+    }
+    _state = state;
+    _retries = 0;
+    return true;
+}
+
+void MissionTransfer::cancel()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _parent.unregister_timeout_handler(_timeout_cookie);
+    _state = State::NONE;
+    _result_callback = nullptr;
+    _items_and_result_callback = nullptr;
+}
+
+void MissionTransfer::process_mission_request_int(const mavlink_mission_request_int_t &request)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_state != State::UPLOAD) {
+        return;
+    }
+
+    if (request.seq >= _items.size()) {
+        LogErr() << "Item of mission type " << int(_mission_type) << " requested out of bounds.";
+        return;
+    }
+
+    mavlink_mission_item_int_t item = _items[request.seq];
+    item.seq = request.seq;
+    item.target_system = _parent.get_system_id();
+    item.target_component = _parent.get_autopilot_id();
+    item.mission_type = _mission_type;
+
+    mavlink_message_t message;
+    mavlink_msg_mission_item_int_encode(GCSClient::system_id,
+                                        GCSClient::component_id,
+                                        &message,
+                                        &item);
+    _parent.send_message(message);
+
+    // Reset the timeout because we're still communicating.
+    _parent.refresh_timeout_handler(_timeout_cookie);
+}
+
+void MissionTransfer::process_mission_ack(const mavlink_mission_ack_t &ack)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::UPLOAD) {
+            return;
+        }
+    }
+
+    if (ack.type == MAV_MISSION_ACCEPTED) {
+        finish_upload(Mission::Result::SUCCESS);
+    } else if (ack.type == MAV_MISSION_NO_SPACE) {
+        LogErr() << "Error: too many items of mission type " << int(_mission_type);
+        finish_upload(Mission::Result::TOO_MANY_MISSION_ITEMS);
+    } else {
+        LogErr() << "Error: unknown mission ack: " << int(ack.type);
+        finish_upload(Mission::Result::ERROR);
+    }
+}
+
+void MissionTransfer::process_mission_count(const mavlink_mission_count_t &count)
+{
+    bool is_done = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::DOWNLOAD || _num_items_to_download >= 0) {
+            return;
+        }
+
+        _download_opaque_id = 0;
+#if defined(MISSION_COUNT_HAS_OPAQUE_ID)
+        _download_opaque_id = count.opaque_id;
+#endif
+        _num_items_to_download = count.count;
+        _next_item_to_download = 0;
+        _first_missing_item = 0;
+        _num_items_downloaded = 0;
+        _retries = 0;
+
+        // If the autopilot still has what we downloaded before, there is no
+        // need to transfer it again.
+        if (MissionCache::instance().lookup(_parent.get_uuid(), _download_opaque_id,
+                                            count.count, _items, _mission_type)) {
+            LogInfo() << "Items of mission type " << int(_mission_type)
+                      << " unchanged, using cached copy";
+            is_done = true;
+        } else {
+            _items.assign(count.count, mavlink_mission_item_int_t {});
+            _items_downloaded.assign(count.count, false);
+            is_done = (count.count == 0);
+        }
+
+        if (!is_done) {
+            _parent.refresh_timeout_handler(_timeout_cookie);
+            request_next_items();
+        }
+    }
+
+    if (is_done) {
+        finish_download(Mission::Result::SUCCESS);
+    }
+}
+
+void MissionTransfer::process_mission_item_int(const mavlink_mission_item_int_t &item)
+{
+    bool is_complete = false;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::DOWNLOAD || _num_items_to_download < 0) {
+            return;
+        }
+
+        const int seq = item.seq;
+        if (seq >= _num_items_to_download || _items_downloaded[seq]) {
+            // Out of range, or an answer to a request we repeated.
+            return;
+        }
+
+        _items[seq] = item;
+        _items_downloaded[seq] = true;
+        ++_num_items_downloaded;
+        _retries = 0;
+        while (_first_missing_item < _num_items_to_download &&
+               _items_downloaded[_first_missing_item]) {
+            ++_first_missing_item;
+        }
+
+        is_complete = (_num_items_downloaded == _num_items_to_download);
+        if (!is_complete) {
+            _parent.refresh_timeout_handler(_timeout_cookie);
+            request_next_items();
+        }
+    }
+
+    if (is_complete) {
+        finish_download(Mission::Result::SUCCESS);
+    }
+}
+
+void MissionTransfer::process_timeout()
+{
+    State timed_out = State::NONE;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state == State::DOWNLOAD && _retries++ < MAX_RETRIES) {
+            LogWarn() << "Retrying requesting missing items of mission type "
+                      << int(_mission_type);
+            _parent.register_timeout_handler(std::bind(&MissionTransfer::process_timeout, this),
+                                             RETRY_TIMEOUT_S, &_timeout_cookie);
+            request_missing_items();
+            return;
+        }
+        timed_out = _state;
+    }
+
+    // Uploads can't be retried, the autopilot should be requesting the items again.
+    if (timed_out == State::UPLOAD) {
+        LogWarn() << "Uploading items of mission type " << int(_mission_type) << " timed out.";
+        finish_upload(Mission::Result::TIMEOUT);
+    } else if (timed_out == State::DOWNLOAD) {
+        LogWarn() << "Downloading items of mission type " << int(_mission_type) << " timed out.";
+        finish_download(Mission::Result::TIMEOUT);
+    }
+}
+
+void MissionTransfer::request_next_items()
+{
+    // Keep a window of requests in flight ahead of the first item still missing.
+    while (_next_item_to_download < _num_items_to_download &&
+           _next_item_to_download < _first_missing_item + int(DOWNLOAD_WINDOW)) {
+        request_item(_next_item_to_download++);
+    }
+}
+
+void MissionTransfer::request_missing_items()
+{
+    if (_num_items_to_download < 0) {
+        // We don't even have the count yet.
+        send_request_list();
+        return;
+    }
+
+    // Only the gaps among the items requested so far are requested again.
+    for (int seq = _first_missing_item; seq < _next_item_to_download; ++seq) {
+        if (!_items_downloaded[seq]) {
+            request_item(seq);
+        }
+    }
+    request_next_items();
+}
+
+void MissionTransfer::request_item(int seq)
+{
+    mavlink_message_t message;
+    mavlink_msg_mission_request_int_pack(GCSClient::system_id,
+                                         GCSClient::component_id,
+                                         &message,
+                                         _parent.get_system_id(),
+                                         _parent.get_autopilot_id(),
+                                         uint16_t(seq),
+                                         _mission_type);
+    _parent.send_message(message);
+}
+
+void MissionTransfer::send_request_list()
+{
+    mavlink_message_t message;
+    mavlink_msg_mission_request_list_pack(GCSClient::system_id,
+                                          GCSClient::component_id,
+                                          &message,
+                                          _parent.get_system_id(),
+                                          _parent.get_autopilot_id(),
+                                          _mission_type);
+    _parent.send_message(message);
+}
+
+void MissionTransfer::finish_upload(Mission::Result result)
+{
+    result_callback_t callback;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::UPLOAD) {
+            // Finished already, e.g. timed out just before the ack.
+            return;
+        }
+        _parent.unregister_timeout_handler(_timeout_cookie);
+        _state = State::NONE;
+        _items.clear();
+        callback = _result_callback;
+        _result_callback = nullptr;
+    }
+
+    if (callback) {
+        callback(result);
+    }
+}
+
+void MissionTransfer::finish_download(Mission::Result result)
+{
+    items_and_result_callback_t callback;
+    std::vector<mavlink_mission_item_int_t> items;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_state != State::DOWNLOAD) {
+            return;
+        }
+        _parent.unregister_timeout_handler(_timeout_cookie);
+        _state = State::NONE;
+        callback = _items_and_result_callback;
+        _items_and_result_callback = nullptr;
+
+        if (result == Mission::Result::SUCCESS) {
+            mavlink_message_t message;
+            mavlink_msg_mission_ack_pack(GCSClient::system_id,
+                                         GCSClient::component_id,
+                                         &message,
+                                         _parent.get_system_id(),
+                                         _parent.get_autopilot_id(),
+                                         MAV_MISSION_ACCEPTED,
+                                         _mission_type);
+            _parent.send_message(message);
+
+            MissionCache::instance().store(_parent.get_uuid(), _download_opaque_id, _items,
+                                           _mission_type);
+            items.swap(_items);
+        }
+        _items.clear();
+        _items_downloaded.clear();
+    }
+
+    if (callback) {
+        callback(result, items);
+    }
+}
+
+} // namespace dronecore
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "mavlink_include.h"
+#include "mission.h"
+
+namespace dronecore {
+
+class MAVLinkSystem;
+
+// Uploads and downloads the items of one mission type other than the mission,
+// i.e. the geofence or the rally points. Each type has its own transfer and
+// timeout, so they can run at the same time as each other and as the mission.
+//
+// Like the mission, downloads keep a window of requests in flight and only
+// request the gaps again, and are served from MissionCache if the autopilot
+// still reports the same opaque id.
+class MissionTransfer
+{
+public:
+    typedef std::function<void(Mission::Result)> result_callback_t;
+    typedef std::function<void(Mission::Result, const std::vector<mavlink_mission_item_int_t> &)>
+    items_and_result_callback_t;
+
+    MissionTransfer(MAVLinkSystem &parent, uint8_t mission_type);
+    ~MissionTransfer();
+
+    // Takes the items, their seq, targets and mission type are set when sending.
+    // The callbacks are called on the thread handling the messages.
+    void upload_async(std::vector<mavlink_mission_item_int_t> &items,
+                      const result_callback_t &callback);
+    void download_async(const items_and_result_callback_t &callback);
+
+    // Drops what is going on without reporting, e.g. when the system timed out.
+    void cancel();
+
+    // Messages of this mission type, passed on by MissionImpl.
+    void process_mission_request_int(const mavlink_mission_request_int_t &request);
+    void process_mission_ack(const mavlink_mission_ack_t &ack);
+    void process_mission_count(const mavlink_mission_count_t &count);
+    void process_mission_item_int(const mavlink_mission_item_int_t &item);
+
+    // Non-copyable
+    MissionTransfer(const MissionTransfer &) = delete;
+    const MissionTransfer &operator=(const MissionTransfer &) = delete;
+
+private:
+    enum class State {
+        NONE,
+        UPLOAD,
+        DOWNLOAD
+    };
+
+    void process_timeout();
+
+    // These need to be called with _mutex locked.
+    // Sets the result to report if it can't.
+    bool start(State state, Mission::Result &result);
+    void request_next_items();
+    void request_missing_items();
+    void request_item(int seq);
+    void send_request_list();
+
+    void finish_upload(Mission::Result result);
+    void finish_download(Mission::Result result);
+
+    MAVLinkSystem &_parent;
+    const uint8_t _mission_type;
+
+    std::mutex _mutex {};
+    State _state {State::NONE};
+    unsigned _retries {0};
+    // Being uploaded, or downloaded indexed by seq.
+    std::vector<mavlink_mission_item_int_t> _items {};
+    std::vector<bool> _items_downloaded {};
+    int _num_items_to_download {-1};
+    // The first item not requested yet.
+    int _next_item_to_download {0};
+    // Everything below has been received.
+    int _first_missing_item {0};
+    int _num_items_downloaded {0};
+    uint32_t _download_opaque_id {0};
+    result_callback_t _result_callback {nullptr};
+    items_and_result_callback_t _items_and_result_callback {nullptr};
+
+    void *_timeout_cookie {nullptr};
+
+    static constexpr unsigned MAX_RETRIES = 3;
+    static constexpr unsigned DOWNLOAD_WINDOW = 8;
+    static constexpr double RETRY_TIMEOUT_S = 0.250;
+    static constexpr double PROCESS_TIMEOUT_S = 1.5;
+};
+
+} // namespace dronecore
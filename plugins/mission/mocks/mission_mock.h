@@ -13,6 +13,7 @@ class MockMission
 public:
     MOCK_CONST_METHOD2(upload_mission_async, void(const std::vector<std::shared_ptr<MissionItem>> &,
                                                   Mission::result_callback_t));
+    MOCK_CONST_METHOD1(download_mission_async, void(Mission::mission_items_and_result_callback_t));
     MOCK_CONST_METHOD1(start_mission_async, void(Mission::result_callback_t));
 };
 
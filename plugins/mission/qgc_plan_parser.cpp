@@ -0,0 +1,395 @@
+#include "qgc_plan_parser.h"
+#include "global_include.h"
+#include "log.h"
+
+#if defined(LINUX)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h> // for close()
+#endif
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace dronecore {
+
+constexpr unsigned QGCPlanParser::MAX_PARAMS;
+
+QGCPlanParser::QGCPlanParser(const char *data, size_t len) :
+    _pos(data),
+    _end(data + len)
+{}
+
+bool QGCPlanParser::parse(const item_callback_t &callback)
+{
+    _callback = callback;
+    _stopped = false;
+
+    if (!parse_plan()) {
+        return false;
+    }
+    if (_stopped) {
+        return true;
+    }
+
+    // Nothing but whitespace may follow.
+    skip_whitespace();
+    return _pos == _end;
+}
+
+bool QGCPlanParser::parse_file(const std::string &path, const item_callback_t &callback,
+                               bool &open_failed)
+{
+    open_failed = false;
+
+#if defined(LINUX)
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        open_failed = true;
+        return false;
+    }
+
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) < 0) {
+        close(fd);
+        open_failed = true;
+        return false;
+    }
+
+    const size_t len = size_t(file_stat.st_size);
+    if (len == 0) {
+        // Can't map an empty file, and it is no plan either.
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        open_failed = true;
+        return false;
+    }
+
+    // The plan is read once from start to end.
+    madvise(data, len, MADV_SEQUENTIAL);
+
+    QGCPlanParser parser(static_cast<const char *>(data), len);
+    const bool success = parser.parse(callback);
+
+    munmap(data, len);
+    return success;
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        open_failed = true;
+        return false;
+    }
+
+    std::stringstream ss;
+    ss << file.rdbuf();
+    const std::string text = ss.str();
+
+    QGCPlanParser parser(text.data(), text.size());
+    return parser.parse(callback);
+#endif
+}
+
+bool QGCPlanParser::parse_plan()
+{
+    return parse_object([this](const char *key, size_t key_len) {
+        if (is_key(key, key_len, "mission")) {
+            return parse_mission();
+        }
+        return skip_value(1);
+    });
+}
+
+bool QGCPlanParser::parse_mission()
+{
+    return parse_object([this](const char *key, size_t key_len) {
+        if (is_key(key, key_len, "items")) {
+            return parse_items();
+        }
+        return skip_value(2);
+    });
+}
+
+bool QGCPlanParser::parse_items()
+{
+    if (!consume('[')) {
+        return false;
+    }
+    if (consume(']')) {
+        return true;
+    }
+
+    do {
+        if (!parse_item()) {
+            return false;
+        }
+        if (_stopped) {
+            return true;
+        }
+    } while (consume(','));
+
+    return consume(']');
+}
+
+bool QGCPlanParser::parse_item()
+{
+    Item item {};
+
+    const bool success = parse_object([this, &item](const char *key, size_t key_len) {
+        if (is_key(key, key_len, "command")) {
+            double command = 0.0;
+            if (!parse_number(command)) {
+                return false;
+            }
+            item.command = int(command);
+            return true;
+
+        } else if (is_key(key, key_len, "params")) {
+            return parse_params(item);
+        }
+        return skip_value(3);
+    });
+
+    if (!success) {
+        return false;
+    }
+
+    if (!_callback(item)) {
+        _stopped = true;
+    }
+    return true;
+}
+
+bool QGCPlanParser::parse_params(Item &item)
+{
+    if (!consume('[')) {
+        return false;
+    }
+    if (consume(']')) {
+        return true;
+    }
+
+    unsigned i = 0;
+    do {
+        double value = 0.0;
+        skip_whitespace();
+        if (_pos < _end && *_pos == 'n') {
+            // QGroundControl writes null for unused params.
+            if (!parse_literal("null")) {
+                return false;
+            }
+        } else if (!parse_number(value)) {
+            return false;
+        }
+
+        // Anything past the params of a mission item is ignored.
+        if (i < MAX_PARAMS) {
+            item.params[i] = value;
+        }
+        ++i;
+    } while (consume(','));
+
+    return consume(']');
+}
+
+bool QGCPlanParser::parse_number(double &value)
+{
+    skip_whitespace();
+    const char *begin = _pos;
+
+    // Check the JSON number syntax, strtod alone would accept more.
+    if (_pos < _end && *_pos == '-') {
+        ++_pos;
+    }
+    const char *digits = _pos;
+    while (_pos < _end && *_pos >= '0' && *_pos <= '9') {
+        ++_pos;
+    }
+    if (_pos == digits) {
+        return false;
+    }
+    if (_pos < _end && *_pos == '.') {
+        ++_pos;
+        digits = _pos;
+        while (_pos < _end && *_pos >= '0' && *_pos <= '9') {
+            ++_pos;
+        }
+        if (_pos == digits) {
+            return false;
+        }
+    }
+    if (_pos < _end && (*_pos == 'e' || *_pos == 'E')) {
+        ++_pos;
+        if (_pos < _end && (*_pos == '+' || *_pos == '-')) {
+            ++_pos;
+        }
+        digits = _pos;
+        while (_pos < _end && *_pos >= '0' && *_pos <= '9') {
+            ++_pos;
+        }
+        if (_pos == digits) {
+            return false;
+        }
+    }
+
+    // The text is not terminated, so strtod gets a terminated copy.
+    const size_t len = size_t(_pos - begin);
+    char buffer[64];
+    if (len < sizeof(buffer)) {
+        std::memcpy(buffer, begin, len);
+        buffer[len] = '\0';
+        value = std::strtod(buffer, nullptr);
+    } else {
+        value = std::strtod(std::string(begin, len).c_str(), nullptr);
+    }
+    return true;
+}
+
+bool QGCPlanParser::parse_string(const char *&begin, size_t &len)
+{
+    if (!consume('"')) {
+        return false;
+    }
+
+    begin = _pos;
+    while (_pos < _end && *_pos != '"') {
+        if (*_pos == '\\') {
+            // Skip whatever is escaped, this includes the quote.
+            ++_pos;
+            if (_pos == _end) {
+                return false;
+            }
+        } else if (static_cast<unsigned char>(*_pos) < 0x20) {
+            // Control characters need to be escaped.
+            return false;
+        }
+        ++_pos;
+    }
+    if (_pos == _end) {
+        return false;
+    }
+
+    len = size_t(_pos - begin);
+    ++_pos;
+    return true;
+}
+
+bool QGCPlanParser::parse_literal(const char *literal)
+{
+    const size_t len = std::strlen(literal);
+    if (size_t(_end - _pos) < len || std::memcmp(_pos, literal, len) != 0) {
+        return false;
+    }
+    _pos += len;
+    return true;
+}
+
+bool QGCPlanParser::skip_value(unsigned depth)
+{
+    if (depth > MAX_DEPTH) {
+        LogErr() << "QGC plan nested too deeply";
+        return false;
+    }
+
+    skip_whitespace();
+    if (_pos == _end) {
+        return false;
+    }
+
+    switch (*_pos) {
+        case '{':
+            return parse_object([this, depth](const char *, size_t) {
+                return skip_value(depth + 1);
+            });
+
+        case '[':
+            ++_pos;
+            if (consume(']')) {
+                return true;
+            }
+            do {
+                if (!skip_value(depth + 1)) {
+                    return false;
+                }
+            } while (consume(','));
+            return consume(']');
+
+        case '"': {
+                const char *begin;
+                size_t len;
+                return parse_string(begin, len);
+            }
+
+        case 't':
+            return parse_literal("true");
+        case 'f':
+            return parse_literal("false");
+        case 'n':
+            return parse_literal("null");
+
+        default: {
+                double value;
+                return parse_number(value);
+            }
+    }
+}
+
+bool QGCPlanParser::parse_object(const std::function<bool(const char *key, size_t key_len)>
+                                 &parse_member)
+{
+    if (!consume('{')) {
+        return false;
+    }
+    if (consume('}')) {
+        return true;
+    }
+
+    do {
+        skip_whitespace();
+        const char *key;
+        size_t key_len;
+        if (!parse_string(key, key_len) || !consume(':')) {
+            return false;
+        }
+        if (!parse_member(key, key_len)) {
+            return false;
+        }
+        if (_stopped) {
+            return true;
+        }
+    } while (consume(','));
+
+    return consume('}');
+}
+
+void QGCPlanParser::skip_whitespace()
+{
+    while (_pos < _end &&
+           (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t')) {
+        ++_pos;
+    }
+}
+
+bool QGCPlanParser::consume(char c)
+{
+    skip_whitespace();
+    if (_pos < _end && *_pos == c) {
+        ++_pos;
+        return true;
+    }
+    return false;
+}
+
+bool QGCPlanParser::is_key(const char *key, size_t key_len, const char *name)
+{
+    return std::strlen(name) == key_len && std::memcmp(key, name, key_len) == 0;
+}
+
+} // namespace dronecore
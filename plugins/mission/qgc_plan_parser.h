@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace dronecore {
+
+// Reads the mission items out of a QGroundControl plan in one pass over the
+// JSON text, without building a document tree. Only the "command" and "params"
+// of the items in "mission" / "items" are looked at, everything else is
+// checked for being valid JSON and skipped.
+class QGCPlanParser
+{
+public:
+    static constexpr unsigned MAX_PARAMS = 7;
+
+    struct Item {
+        int command;
+        // Missing params and nulls are 0.
+        double params[MAX_PARAMS];
+    };
+
+    // Return false to stop parsing.
+    typedef std::function<bool(const Item &item)> item_callback_t;
+
+    QGCPlanParser(const char *data, size_t len);
+
+    // Calls back for every mission item in order. Returns false if the plan is
+    // not valid JSON, only what was parsed before stopping is checked.
+    bool parse(const item_callback_t &callback);
+
+    // Maps the file into memory where possible and parses it. Returns false
+    // if the file can't be opened, open_failed tells the two errors apart.
+    static bool parse_file(const std::string &path, const item_callback_t &callback,
+                           bool &open_failed);
+
+    // Non-copyable
+    QGCPlanParser(const QGCPlanParser &) = delete;
+    const QGCPlanParser &operator=(const QGCPlanParser &) = delete;
+
+private:
+    bool parse_plan();
+    bool parse_mission();
+    bool parse_items();
+    bool parse_item();
+    bool parse_params(Item &item);
+    bool parse_number(double &value);
+    // The string as it is in the text, escapes are not resolved.
+    bool parse_string(const char *&begin, size_t &len);
+    bool parse_literal(const char *literal);
+    bool skip_value(unsigned depth);
+
+    // Calls parse_member for every member of an object, with the key.
+    bool parse_object(const std::function<bool(const char *key, size_t key_len)> &parse_member);
+
+    void skip_whitespace();
+    bool consume(char c);
+
+    static bool is_key(const char *key, size_t key_len, const char *name);
+
+    // Deeper nesting than this is refused rather than risking the stack.
+    static constexpr unsigned MAX_DEPTH = 64;
+
+    const char *_pos;
+    const char *const _end;
+    item_callback_t _callback {nullptr};
+    bool _stopped {false};
+};
+
+} // namespace dronecore
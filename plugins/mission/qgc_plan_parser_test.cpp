@@ -0,0 +1,71 @@
+#include "qgc_plan_parser.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace dronecore;
+
+static bool parse(const std::string &text, std::vector<QGCPlanParser::Item> &items)
+{
+    items.clear();
+    QGCPlanParser parser(text.data(), text.size());
+    return parser.parse([&items](const QGCPlanParser::Item & item) {
+        items.push_back(item);
+        return true;
+    });
+}
+
+TEST(QGCPlanParser, ReadsItems)
+{
+    const std::string plan =
+        "{ \"fileType\": \"Plan\", \"geoFence\": { \"polygon\": [ ], \"version\": 1 },\n"
+        "  \"mission\": { \"cruiseSpeed\": 15, \"items\": [\n"
+        "    { \"autoContinue\": true, \"command\": 22, \"frame\": 3,\n"
+        "      \"params\": [ 0, 0, 0, null, 47.39781011, 8.54553801, 15 ],\n"
+        "      \"type\": \"SimpleItem\" },\n"
+        "    { \"command\": 16, \"params\": [ 1, -2.5e1, 0.5, null, 47.3, 8.5, 1E2 ],\n"
+        "      \"nested\": { \"command\": 99, \"params\": [ 7 ] } }\n"
+        "  ], \"plannedHomePosition\": [ 47.3, 8.5, 488 ] },\n"
+        "  \"name\": \"with \\\"escapes\\\" and \\\\ }\", \"version\": 1 }\n";
+
+    std::vector<QGCPlanParser::Item> items;
+    ASSERT_TRUE(parse(plan, items));
+    ASSERT_EQ(items.size(), 2);
+
+    EXPECT_EQ(items[0].command, 22);
+    EXPECT_DOUBLE_EQ(items[0].params[3], 0.0);
+    EXPECT_DOUBLE_EQ(items[0].params[4], 47.39781011);
+    EXPECT_DOUBLE_EQ(items[0].params[6], 15.0);
+
+    // Nested objects of an item are not mistaken for the item.
+    EXPECT_EQ(items[1].command, 16);
+    EXPECT_DOUBLE_EQ(items[1].params[0], 1.0);
+    EXPECT_DOUBLE_EQ(items[1].params[1], -25.0);
+    EXPECT_DOUBLE_EQ(items[1].params[6], 100.0);
+}
+
+TEST(QGCPlanParser, RefusesInvalidJson)
+{
+    std::vector<QGCPlanParser::Item> items;
+    EXPECT_FALSE(parse("", items));
+    EXPECT_FALSE(parse("{ \"mission\": { \"items\": [ { \"command\": 16, } ] } }", items));
+    EXPECT_FALSE(parse("{ \"mission\": { \"items\": [ { \"command\": 1.e5 } ] } }", items));
+    EXPECT_FALSE(parse("{ \"name\": \"unterminated }", items));
+    EXPECT_FALSE(parse("{ } trailing", items));
+    EXPECT_FALSE(parse(std::string(100, '[') + std::string(100, ']'), items));
+    EXPECT_FALSE(parse("{ \"a\": " + std::string(100, '[') + std::string(100, ']') + " }", items));
+}
+
+TEST(QGCPlanParser, StopsWhenAsked)
+{
+    const std::string plan =
+        "{ \"mission\": { \"items\": [ { \"command\": 16 }, { \"command\": 17 } ] } }";
+    unsigned num_items = 0;
+
+    QGCPlanParser parser(plan.data(), plan.size());
+    EXPECT_TRUE(parser.parse([&num_items](const QGCPlanParser::Item &) {
+        ++num_items;
+        return false;
+    }));
+    EXPECT_EQ(num_items, 1);
+}
@@ -0,0 +1,287 @@
+#include "survey_generator.h"
+#include "global_include.h"
+#include "log.h"
+#include "terrain_cache.h"
+#include "thread_setup.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace dronecore {
+
+constexpr unsigned SurveyGenerator::MIN_LINES_PER_THREAD;
+
+bool SurveyGenerator::generate(const Mission::Survey &survey,
+                               std::vector<mavlink_mission_item_int_t> &items,
+                               unsigned num_threads)
+{
+    items.clear();
+
+    if (survey.polygon.size() < 3 ||
+        !std::isfinite(survey.line_spacing_m) || survey.line_spacing_m <= 0.0 ||
+        !std::isfinite(survey.relative_altitude_m) || !std::isfinite(survey.heading_deg) ||
+        !std::isfinite(survey.trigger_distance_m) || survey.trigger_distance_m < 0.0) {
+        return false;
+    }
+    if (!survey.terrain_tile_dir.empty() &&
+        !(std::isfinite(survey.terrain_spacing_m) && survey.terrain_spacing_m > 0.0)) {
+        return false;
+    }
+
+    double latitude_origin_deg = 0.0;
+    double longitude_origin_deg = 0.0;
+    for (const auto &vertex : survey.polygon) {
+        if (!std::isfinite(vertex.latitude_deg) || !std::isfinite(vertex.longitude_deg)) {
+            return false;
+        }
+        latitude_origin_deg += vertex.latitude_deg;
+        longitude_origin_deg += vertex.longitude_deg;
+    }
+
+    Projection projection {};
+    projection.flat = FlatProjection(latitude_origin_deg / survey.polygon.size(),
+                                     longitude_origin_deg / survey.polygon.size());
+    projection.sin_heading = std::sin(to_rad_from_deg(survey.heading_deg));
+    projection.cos_heading = std::cos(to_rad_from_deg(survey.heading_deg));
+
+    std::vector<Point> polygon;
+    polygon.reserve(survey.polygon.size());
+    double min_across_m = INFINITY;
+    double max_across_m = -INFINITY;
+    for (const auto &vertex : survey.polygon) {
+        polygon.push_back(project(projection, vertex));
+        min_across_m = std::min(min_across_m, polygon.back().across_m);
+        max_across_m = std::max(max_across_m, polygon.back().across_m);
+    }
+
+    // The lines are centered in the area, half a spacing in from the edge.
+    const double width_m = max_across_m - min_across_m;
+    // Every line gives at least two items, don't even start on a survey that can't fit.
+    if (width_m / survey.line_spacing_m >= UINT16_MAX) {
+        return false;
+    }
+    const unsigned num_lines = unsigned(std::floor(width_m / survey.line_spacing_m)) + 1;
+    const double first_across_m = min_across_m +
+                                  (width_m - (num_lines - 1) * survey.line_spacing_m) / 2.0;
+
+    if (num_threads == 0) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    num_threads = std::max(1u, std::min(num_threads,
+                                        num_lines / MIN_LINES_PER_THREAD));
+
+    const unsigned lines_per_thread = (num_lines + num_threads - 1) / num_threads;
+    std::vector<std::vector<mavlink_mission_item_int_t>> blocks(num_threads);
+    std::vector<std::thread> threads;
+
+    // The first block is done on this thread.
+    for (unsigned i = 1; i < num_threads; ++i) {
+        const unsigned first_line = std::min(i * lines_per_thread, num_lines);
+        const unsigned end_line = std::min(first_line + lines_per_thread, num_lines);
+        std::vector<mavlink_mission_item_int_t> *block = &blocks[i];
+        threads.push_back(std::thread([&, first_line, end_line, block]() {
+            setup_thread(ThreadRole::Background, "survey");
+            generate_lines(survey, projection, polygon, first_across_m, first_line, end_line,
+                           *block);
+        }));
+    }
+    generate_lines(survey, projection, polygon, first_across_m, 0,
+                   std::min(lines_per_thread, num_lines), blocks[0]);
+
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    size_t num_items = 0;
+    for (const auto &block : blocks) {
+        num_items += block.size();
+    }
+    items.reserve(num_items);
+    for (const auto &block : blocks) {
+        items.insert(items.end(), block.begin(), block.end());
+    }
+
+    // Sequence numbers are 16 bit.
+    if (items.size() > UINT16_MAX) {
+        items.clear();
+        return false;
+    }
+
+    if (!survey.terrain_tile_dir.empty() && !follow_terrain(survey, items)) {
+        items.clear();
+        return false;
+    }
+
+    for (size_t seq = 0; seq < items.size(); ++seq) {
+        items[seq].seq = uint16_t(seq);
+    }
+
+    return items.size() > 0;
+}
+
+void SurveyGenerator::generate_lines(const Mission::Survey &survey, const Projection &projection,
+                                     const std::vector<Point> &polygon, double first_across_m,
+                                     unsigned first_line, unsigned end_line,
+                                     std::vector<mavlink_mission_item_int_t> &items)
+{
+    const bool with_trigger = survey.trigger_distance_m > 0.0;
+    const bool with_terrain = !survey.terrain_tile_dir.empty();
+    // Two waypoints per line, and two for the trigger if needed.
+    items.reserve((end_line - first_line) * (with_trigger ? 4 : 2));
+
+    std::vector<double> crossings;
+
+    for (unsigned line = first_line; line < end_line; ++line) {
+        const double across_m = first_across_m + line * survey.line_spacing_m;
+
+        // Where the line crosses the edges of the polygon. Each edge includes its
+        // start but not its end, so corners on the line are not counted twice.
+        crossings.clear();
+        for (size_t i = 0; i < polygon.size(); ++i) {
+            const Point &from = polygon[i];
+            const Point &to = polygon[(i + 1) % polygon.size()];
+
+            if ((from.across_m <= across_m && across_m < to.across_m) ||
+                (to.across_m <= across_m && across_m < from.across_m)) {
+                const double t = (across_m - from.across_m) / (to.across_m - from.across_m);
+                crossings.push_back(from.along_m + t * (to.along_m - from.along_m));
+            }
+        }
+
+        // Every other line is flown backwards.
+        const bool is_backwards = (line % 2) == 1;
+        if (is_backwards) {
+            std::sort(crossings.begin(), crossings.end(), std::greater<double>());
+        } else {
+            std::sort(crossings.begin(), crossings.end());
+        }
+
+        // Inside the polygon between pairs of crossings.
+        for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+            add_waypoint(survey, projection, Point {crossings[i], across_m}, items);
+            if (with_trigger) {
+                add_trigger(survey.trigger_distance_m, items);
+            }
+            if (with_terrain) {
+                add_terrain_waypoints(survey, projection, Point {crossings[i], across_m},
+                                      Point {crossings[i + 1], across_m}, items);
+            }
+            add_waypoint(survey, projection, Point {crossings[i + 1], across_m}, items);
+            if (with_trigger) {
+                add_trigger(0.0, items);
+            }
+        }
+    }
+}
+
+void SurveyGenerator::add_waypoint(const Mission::Survey &survey, const Projection &projection,
+                                   const Point &point,
+                                   std::vector<mavlink_mission_item_int_t> &items)
+{
+    double latitude_deg;
+    double longitude_deg;
+    unproject(projection, point, latitude_deg, longitude_deg);
+
+    mavlink_mission_item_int_t item {};
+    item.frame = MAV_FRAME_GLOBAL_RELATIVE_ALT_INT;
+    item.command = MAV_CMD_NAV_WAYPOINT;
+    item.autocontinue = 1;
+    item.param1 = 0.0f; // no hold, fly through
+    item.param2 = 0.0f; // default acceptance radius
+    item.param3 = 0.0f; // pass through the waypoint
+    item.param4 = NAN; // keep yaw
+    item.x = int32_t(std::round(latitude_deg * 1e7));
+    item.y = int32_t(std::round(longitude_deg * 1e7));
+    item.z = survey.relative_altitude_m;
+    item.mission_type = MAV_MISSION_TYPE_MISSION;
+    items.push_back(item);
+}
+
+void SurveyGenerator::add_terrain_waypoints(const Mission::Survey &survey,
+                                            const Projection &projection,
+                                            const Point &from, const Point &to,
+                                            std::vector<mavlink_mission_item_int_t> &items)
+{
+    const double length_m = std::fabs(to.along_m - from.along_m);
+    const unsigned num_segments = unsigned(std::ceil(length_m / survey.terrain_spacing_m));
+
+    for (unsigned i = 1; i < num_segments; ++i) {
+        const double t = double(i) / double(num_segments);
+        add_waypoint(survey, projection,
+                     Point {from.along_m + t * (to.along_m - from.along_m), from.across_m},
+                     items);
+    }
+}
+
+bool SurveyGenerator::follow_terrain(const Mission::Survey &survey,
+                                     std::vector<mavlink_mission_item_int_t> &items)
+{
+    std::vector<size_t> waypoints;
+    std::vector<double> latitudes_deg;
+    std::vector<double> longitudes_deg;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (items[i].command == MAV_CMD_NAV_WAYPOINT) {
+            waypoints.push_back(i);
+            latitudes_deg.push_back(double(items[i].x) * 1e-7);
+            longitudes_deg.push_back(double(items[i].y) * 1e-7);
+        }
+    }
+
+    std::vector<float> elevations_m(waypoints.size());
+    TerrainCache terrain(survey.terrain_tile_dir);
+    if (!terrain.get_elevations(latitudes_deg.data(), longitudes_deg.data(), waypoints.size(),
+                                elevations_m.data())) {
+        LogErr() << "Terrain missing for survey in " << survey.terrain_tile_dir;
+        return false;
+    }
+
+    for (size_t i = 0; i < waypoints.size(); ++i) {
+        mavlink_mission_item_int_t &item = items[waypoints[i]];
+        item.frame = MAV_FRAME_GLOBAL_INT;
+        item.z = elevations_m[i] + survey.relative_altitude_m;
+    }
+    return true;
+}
+
+void SurveyGenerator::add_trigger(double distance_m,
+                                  std::vector<mavlink_mission_item_int_t> &items)
+{
+    mavlink_mission_item_int_t item {};
+    item.frame = MAV_FRAME_MISSION;
+    item.command = MAV_CMD_DO_SET_CAM_TRIGG_DIST;
+    item.autocontinue = 1;
+    item.param1 = float(distance_m); // 0 stops triggering
+    item.param2 = 0.0f; // no shutter integration
+    item.param3 = (distance_m > 0.0) ? 1.0f : 0.0f; // trigger once right away
+    item.z = NAN;
+    item.mission_type = MAV_MISSION_TYPE_MISSION;
+    items.push_back(item);
+}
+
+SurveyGenerator::Point SurveyGenerator::project(const Projection &projection,
+                                                const Mission::Survey::Vertex &vertex)
+{
+    double north_m;
+    double east_m;
+    projection.flat.to_local(vertex.latitude_deg, vertex.longitude_deg, north_m, east_m);
+
+    // Rotate so that the lines run along the first axis.
+    Point point;
+    point.along_m = east_m * projection.sin_heading + north_m * projection.cos_heading;
+    point.across_m = east_m * projection.cos_heading - north_m * projection.sin_heading;
+    return point;
+}
+
+void SurveyGenerator::unproject(const Projection &projection, const Point &point,
+                                double &latitude_deg, double &longitude_deg)
+{
+    // The rotation is its own inverse.
+    const double east_m = point.along_m * projection.sin_heading +
+                          point.across_m * projection.cos_heading;
+    const double north_m = point.along_m * projection.cos_heading -
+                           point.across_m * projection.sin_heading;
+
+    projection.flat.to_global(north_m, east_m, latitude_deg, longitude_deg);
+}
+
+} // namespace dronecore
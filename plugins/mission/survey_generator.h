@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include "mission.h"
+#include "mavlink_include.h"
+#include "geo.h"
+
+namespace dronecore {
+
+// Turns a survey area into mission items as they go over the wire.
+//
+// The polygon is projected onto a plane around its center, which is accurate
+// enough for areas of a few kilometers. The lines are independent of each other,
+// so large surveys are split into blocks of lines generated on separate threads
+// and joined in order afterwards. With terrain following, the elevations of all
+// waypoints are looked up in one batch at the end.
+class SurveyGenerator
+{
+public:
+    // Returns false if the survey is invalid, no line fits into it, it needs
+    // more items than a mission can have or terrain is missing.
+    // With num_threads 0, as many threads as the hardware supports are used.
+    static bool generate(const Mission::Survey &survey,
+                         std::vector<mavlink_mission_item_int_t> &items,
+                         unsigned num_threads = 0);
+
+private:
+    struct Point {
+        double along_m;
+        double across_m;
+    };
+
+    struct Projection {
+        FlatProjection flat;
+        double sin_heading;
+        double cos_heading;
+    };
+
+    static Point project(const Projection &projection, const Mission::Survey::Vertex &vertex);
+    static void unproject(const Projection &projection, const Point &point,
+                          double &latitude_deg, double &longitude_deg);
+
+    // Appends the items of the lines first_line to end_line, seq is set later.
+    static void generate_lines(const Mission::Survey &survey, const Projection &projection,
+                               const std::vector<Point> &polygon, double first_across_m,
+                               unsigned first_line, unsigned end_line,
+                               std::vector<mavlink_mission_item_int_t> &items);
+
+    static void add_waypoint(const Mission::Survey &survey, const Projection &projection,
+                             const Point &point, std::vector<mavlink_mission_item_int_t> &items);
+    // Waypoints between two on a line, so that the altitude can follow the terrain.
+    static void add_terrain_waypoints(const Mission::Survey &survey, const Projection &projection,
+                                      const Point &from, const Point &to,
+                                      std::vector<mavlink_mission_item_int_t> &items);
+    // Turns the waypoints into altitudes above mean sea level.
+    static bool follow_terrain(const Mission::Survey &survey,
+                               std::vector<mavlink_mission_item_int_t> &items);
+    static void add_trigger(double distance_m, std::vector<mavlink_mission_item_int_t> &items);
+
+    // Below this, spreading the lines over threads costs more than it saves.
+    static constexpr unsigned MIN_LINES_PER_THREAD = 64;
+};
+
+} // namespace dronecore
@@ -0,0 +1,214 @@
+#include "survey_generator.h"
+#include "terrain_cache.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+using namespace dronecore;
+
+// About 1 km by 1 km around Zurich.
+static Mission::Survey make_square_survey()
+{
+    Mission::Survey survey {};
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3900, 8.5400});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3990, 8.5400});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3990, 8.5532});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3900, 8.5532});
+    survey.line_spacing_m = 50.0;
+    survey.relative_altitude_m = 40.0f;
+    return survey;
+}
+
+TEST(SurveyGenerator, CoversSquare)
+{
+    const auto survey = make_square_survey();
+
+    std::vector<mavlink_mission_item_int_t> items;
+    ASSERT_TRUE(SurveyGenerator::generate(survey, items));
+
+    // 1 km wide with 50 m spacing, two waypoints per line.
+    EXPECT_EQ(items.size() % 2, 0u);
+    EXPECT_GE(items.size(), 2u * 19u);
+    EXPECT_LE(items.size(), 2u * 21u);
+
+    for (unsigned i = 0; i < items.size(); ++i) {
+        EXPECT_EQ(items[i].seq, i);
+        EXPECT_EQ(items[i].command, MAV_CMD_NAV_WAYPOINT);
+        EXPECT_EQ(items[i].frame, MAV_FRAME_GLOBAL_RELATIVE_ALT_INT);
+        EXPECT_EQ(items[i].z, 40.0f);
+        // All inside the area.
+        EXPECT_GE(items[i].x, 473900000 - 10);
+        EXPECT_LE(items[i].x, 473990000 + 10);
+        EXPECT_GE(items[i].y, 85400000 + 10);
+        EXPECT_LE(items[i].y, 85532000 - 10);
+    }
+
+    // Heading north, every line keeps its longitude and they alternate in direction.
+    for (unsigned i = 0; i + 1 < items.size(); i += 2) {
+        EXPECT_NEAR(items[i].y, items[i + 1].y, 1);
+        if ((i / 2) % 2 == 0) {
+            EXPECT_LT(items[i].x, items[i + 1].x);
+        } else {
+            EXPECT_GT(items[i].x, items[i + 1].x);
+        }
+    }
+}
+
+TEST(SurveyGenerator, SameResultWithThreads)
+{
+    auto survey = make_square_survey();
+    // Enough lines to be spread over threads.
+    survey.line_spacing_m = 2.0;
+    survey.heading_deg = 30.0;
+
+    std::vector<mavlink_mission_item_int_t> single_threaded;
+    ASSERT_TRUE(SurveyGenerator::generate(survey, single_threaded, 1));
+
+    std::vector<mavlink_mission_item_int_t> multi_threaded;
+    ASSERT_TRUE(SurveyGenerator::generate(survey, multi_threaded, 4));
+
+    ASSERT_EQ(single_threaded.size(), multi_threaded.size());
+    for (unsigned i = 0; i < single_threaded.size(); ++i) {
+        EXPECT_EQ(multi_threaded[i].seq, i);
+        EXPECT_EQ(single_threaded[i].x, multi_threaded[i].x);
+        EXPECT_EQ(single_threaded[i].y, multi_threaded[i].y);
+    }
+}
+
+TEST(SurveyGenerator, TriggersCamera)
+{
+    auto survey = make_square_survey();
+    survey.trigger_distance_m = 10.0;
+
+    std::vector<mavlink_mission_item_int_t> items;
+    ASSERT_TRUE(SurveyGenerator::generate(survey, items));
+    ASSERT_EQ(items.size() % 4, 0u);
+
+    for (unsigned i = 0; i < items.size(); i += 4) {
+        EXPECT_EQ(items[i].command, MAV_CMD_NAV_WAYPOINT);
+        EXPECT_EQ(items[i + 1].command, MAV_CMD_DO_SET_CAM_TRIGG_DIST);
+        EXPECT_EQ(items[i + 1].param1, 10.0f);
+        EXPECT_EQ(items[i + 2].command, MAV_CMD_NAV_WAYPOINT);
+        EXPECT_EQ(items[i + 3].command, MAV_CMD_DO_SET_CAM_TRIGG_DIST);
+        EXPECT_EQ(items[i + 3].param1, 0.0f);
+    }
+}
+
+TEST(SurveyGenerator, SplitsLinesInConcaveArea)
+{
+    // U shape open to the north.
+    auto survey = make_square_survey();
+    survey.polygon.clear();
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3900, 8.5400});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3990, 8.5400});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3990, 8.5440});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3930, 8.5440});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3930, 8.5492});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3990, 8.5492});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3990, 8.5532});
+    survey.polygon.push_back(Mission::Survey::Vertex {47.3900, 8.5532});
+
+    // Lines run east-west, through both arms in the upper part.
+    survey.heading_deg = 90.0;
+
+    std::vector<mavlink_mission_item_int_t> items;
+    ASSERT_TRUE(SurveyGenerator::generate(survey, items));
+
+    // Lines in the upper part cross the gap and are split, so there are more
+    // segments than lines.
+    unsigned num_segments_in_upper_part = 0;
+    for (unsigned i = 0; i < items.size(); i += 2) {
+        if (items[i].x > 473950000) {
+            ++num_segments_in_upper_part;
+            // No segment goes through the gap.
+            const int32_t min_y = std::min(items[i].y, items[i + 1].y);
+            const int32_t max_y = std::max(items[i].y, items[i + 1].y);
+            EXPECT_FALSE(min_y < 85450000 && max_y > 85480000);
+        }
+    }
+    EXPECT_GT(num_segments_in_upper_part, 0u);
+    EXPECT_EQ(num_segments_in_upper_part % 2, 0u);
+}
+
+TEST(SurveyGenerator, RejectsInvalid)
+{
+    std::vector<mavlink_mission_item_int_t> items;
+
+    auto survey = make_square_survey();
+    survey.polygon.pop_back();
+    survey.polygon.pop_back();
+    EXPECT_FALSE(SurveyGenerator::generate(survey, items));
+
+    survey = make_square_survey();
+    survey.line_spacing_m = 0.0;
+    EXPECT_FALSE(SurveyGenerator::generate(survey, items));
+
+    survey = make_square_survey();
+    survey.polygon[1].latitude_deg = NAN;
+    EXPECT_FALSE(SurveyGenerator::generate(survey, items));
+
+    // Way too many lines for one mission.
+    survey = make_square_survey();
+    survey.line_spacing_m = 0.001;
+    EXPECT_FALSE(SurveyGenerator::generate(survey, items));
+    EXPECT_TRUE(items.empty());
+}
+
+// An SRTM3 tile of Zurich rising by a meter per sample to the east.
+static std::string write_terrain_tile()
+{
+    const unsigned size = 1201;
+    std::vector<char> bytes(size * size * 2);
+    for (unsigned row = 0; row < size; ++row) {
+        for (unsigned col = 0; col < size; ++col) {
+            const uint16_t value = uint16_t(400 + col);
+            const size_t index = (size_t(row) * size + col) * 2;
+            bytes[index] = char(value >> 8);
+            bytes[index + 1] = char(value & 0xff);
+        }
+    }
+    const std::string path = "./" + TerrainCache::get_tile_name(47, 8);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(bytes.data(), std::streamsize(bytes.size()));
+    return path;
+}
+
+TEST(SurveyGenerator, FollowsTerrain)
+{
+    const std::string path = write_terrain_tile();
+
+    auto survey = make_square_survey();
+    survey.heading_deg = 90.0;
+    survey.terrain_tile_dir = ".";
+    survey.terrain_spacing_m = 100.0;
+
+    std::vector<mavlink_mission_item_int_t> items;
+    ASSERT_TRUE(SurveyGenerator::generate(survey, items));
+
+    // About 1 km long lines, so at least 10 waypoints each.
+    EXPECT_GE(items.size(), 19u * 11u);
+
+    TerrainCache terrain(".");
+    for (unsigned i = 0; i < items.size(); ++i) {
+        EXPECT_EQ(items[i].seq, i);
+        EXPECT_EQ(items[i].frame, MAV_FRAME_GLOBAL_INT);
+
+        float elevation_m;
+        ASSERT_TRUE(terrain.get_elevation(items[i].x * 1e-7, items[i].y * 1e-7, elevation_m));
+        EXPECT_NEAR(items[i].z, elevation_m + 40.0f, 0.01f);
+
+        // The lines go east, along which the terrain rises.
+        if (i > 0 && items[i].x == items[i - 1].x) {
+            EXPECT_LE(haversine_distance_m(items[i - 1].x * 1e-7, items[i - 1].y * 1e-7,
+                                           items[i].x * 1e-7, items[i].y * 1e-7), 100.5);
+        }
+    }
+
+    // No tiles for the area.
+    survey.terrain_tile_dir = "./does_not_exist";
+    EXPECT_FALSE(SurveyGenerator::generate(survey, items));
+    EXPECT_TRUE(items.empty());
+
+    std::remove(path.c_str());
+}
@@ -0,0 +1,18 @@
+#include <gmock/gmock.h>
+
+#include "offboard/offboard.h"
+
+namespace dronecore {
+namespace testing {
+
+class MockOffboard
+{
+public:
+    MOCK_CONST_METHOD0(start, Offboard::Result());
+    MOCK_CONST_METHOD0(stop, Offboard::Result());
+    MOCK_CONST_METHOD1(set_velocity_ned, void(Offboard::VelocityNEDYaw));
+    MOCK_CONST_METHOD1(set_velocity_body, void(Offboard::VelocityBodyYawspeed));
+};
+
+} // namespace testing
+} // namespace dronecore
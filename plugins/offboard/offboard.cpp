@@ -38,6 +38,11 @@ bool Offboard::is_active() const
     return _impl->is_active();
 }
 
+void Offboard::set_position_ned(Offboard::PositionNEDYaw position_ned_yaw)
+{
+    return _impl->set_position_ned(position_ned_yaw);
+}
+
 void Offboard::set_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw)
 {
     return _impl->set_velocity_ned(velocity_ned_yaw);
@@ -48,6 +53,66 @@ void Offboard::set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_ya
     return _impl->set_velocity_body(velocity_body_yawspeed);
 }
 
+void Offboard::set_acceleration_ned(Offboard::AccelerationNED acceleration_ned)
+{
+    return _impl->set_acceleration_ned(acceleration_ned);
+}
+
+void Offboard::set_attitude(Offboard::Attitude attitude)
+{
+    return _impl->set_attitude(attitude);
+}
+
+void Offboard::set_attitude_rate(Offboard::AttitudeRate attitude_rate)
+{
+    return _impl->set_attitude_rate(attitude_rate);
+}
+
+Offboard::Result Offboard::append_trajectory(const std::vector<TrajectoryPoint> &points)
+{
+    return _impl->append_trajectory(points);
+}
+
+void Offboard::clear_trajectory()
+{
+    _impl->clear_trajectory();
+}
+
+size_t Offboard::get_trajectory_space() const
+{
+    return _impl->get_trajectory_space();
+}
+
+void Offboard::enable_realtime_streaming(float rate_hz)
+{
+    _impl->enable_realtime_streaming(rate_hz);
+}
+
+void Offboard::disable_realtime_streaming()
+{
+    _impl->disable_realtime_streaming();
+}
+
+Offboard::StreamingStats Offboard::get_streaming_stats() const
+{
+    return _impl->get_streaming_stats();
+}
+
+void Offboard::enable_latency_measurement(float report_rate_hz)
+{
+    _impl->enable_latency_measurement(report_rate_hz);
+}
+
+void Offboard::disable_latency_measurement()
+{
+    _impl->disable_latency_measurement();
+}
+
+Offboard::LatencyStats Offboard::get_latency_stats() const
+{
+    return _impl->get_latency_stats();
+}
+
 const char *Offboard::result_str(Result result)
 {
     switch (result) {
@@ -63,6 +128,12 @@ const char *Offboard::result_str(Result result)
             return "Command denied";
         case Result::TIMEOUT:
             return "Timeout";
+        case Result::NO_SETPOINT_SET:
+            return "No setpoint set";
+        case Result::TRAJECTORY_INVALID:
+            return "Trajectory invalid";
+        case Result::TRAJECTORY_BUFFER_FULL:
+            return "Trajectory buffer full";
         case Result::UNKNOWN:
         default:
             return "Unknown";
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <vector>
 #include "plugin_base.h"
 
 namespace dronecore {
@@ -11,9 +13,10 @@ class System;
 
 
 /**
- * @brief This class is used to control a drone with velocity commands.
+ * @brief This class is used to control a drone with position, velocity, acceleration,
+ * attitude or attitude rate commands.
  *
- * The module is called offboard because the velocity commands can be sent from external sources
+ * The module is called offboard because the commands can be sent from external sources
  * as opposed to onboard control right inside the autopilot "board".
  *
  * Client code must specify a setpoint before starting offboard mode.
@@ -56,6 +59,8 @@ public:
         COMMAND_DENIED, /**< @brief Command denied. */
         TIMEOUT, /**< @brief %Request timeout. */
         NO_SETPOINT_SET, /**< Can't start without setpoint set. */
+        TRAJECTORY_INVALID, /**< @brief Trajectory times are not increasing. */
+        TRAJECTORY_BUFFER_FULL, /**< @brief Not enough space for the trajectory points, try later. */
         UNKNOWN /**< @brief Unknown error. */
     };
 
@@ -72,6 +77,16 @@ public:
      */
     typedef std::function<void(Result)> result_callback_t;
 
+    /**
+     * @brief Type for position commands in NED (North East Down) coordinates and yaw.
+     */
+    struct PositionNEDYaw {
+        float north_m; /**< @brief Position North in metres. */
+        float east_m; /**< @brief Position East in metres. */
+        float down_m; /**< @brief Position Down in metres. */
+        float yaw_deg; /**< @brief Yaw in degrees (0 North, positive is clock-wise looking from above). */
+    };
+
     /**
      * @brief Type for Velocity commands in NED (North East Down) coordinates and yaw.
      */
@@ -93,6 +108,86 @@ public:
                                    looking from above). */
     };
 
+    /**
+     * @brief Type for acceleration commands in NED (North East Down) coordinates.
+     */
+    struct AccelerationNED {
+        float north_m_s2; /**< @brief Acceleration North in metres/second^2. */
+        float east_m_s2; /**< @brief Acceleration East in metres/second^2. */
+        float down_m_s2; /**< @brief Acceleration Down in metres/second^2. */
+    };
+
+    /**
+     * @brief Type for attitude commands with thrust.
+     */
+    struct Attitude {
+        float roll_deg; /**< @brief Roll angle in degrees (positive is right side down). */
+        float pitch_deg; /**< @brief Pitch angle in degrees (positive is nose up). */
+        float yaw_deg; /**< @brief Yaw angle in degrees (0 North, positive is clock-wise looking from above). */
+        float thrust_value; /**< @brief Thrust from 0 to 1. */
+    };
+
+    /**
+     * @brief Type for body angular rate commands with thrust.
+     */
+    struct AttitudeRate {
+        float roll_deg_s; /**< @brief Roll angular rate in degrees/second (positive for right side down). */
+        float pitch_deg_s; /**< @brief Pitch angular rate in degrees/second (positive for nose up). */
+        float yaw_deg_s; /**< @brief Yaw angular rate in degrees/second (positive for clock-wise looking from above). */
+        float thrust_value; /**< @brief Thrust from 0 to 1. */
+    };
+
+    /**
+     * @brief Type for a point of a trajectory in NED (North East Down) coordinates.
+     */
+    struct TrajectoryPoint {
+        double time_s; /**< @brief Time since the start of the trajectory in seconds. */
+        float north_m; /**< @brief Position North in metres. */
+        float east_m; /**< @brief Position East in metres. */
+        float down_m; /**< @brief Position Down in metres. */
+        float north_m_s; /**< @brief Velocity North in metres/second. */
+        float east_m_s; /**< @brief Velocity East in metres/second. */
+        float down_m_s; /**< @brief Velocity Down in metres/second. */
+        float yaw_deg; /**< @brief Yaw in degrees (0 North, positive is clock-wise looking from above). */
+    };
+
+    /**
+     * @brief Timing of the setpoints sent with realtime streaming.
+     *
+     * The jitter is how late a setpoint is sent after its deadline.
+     */
+    struct StreamingStats {
+        uint64_t num_sent; /**< @brief Setpoints sent since streaming was enabled. */
+        uint64_t num_missed; /**< @brief Setpoints skipped because the thread was more than a period late. */
+        double mean_jitter_us; /**< @brief Mean jitter in microseconds. */
+        double max_jitter_us; /**< @brief Largest jitter in microseconds. */
+        bool realtime_priority; /**< @brief True if the thread runs with realtime (SCHED_FIFO) priority. */
+    };
+
+    /**
+     * @brief Delay and loss of setpoints, as reported back by the autopilot.
+     *
+     * The latency is from sending a new setpoint until the autopilot reports it
+     * as the one it follows. A setpoint replaced before it was reported counts
+     * neither as matched nor as lost.
+     */
+    struct LatencyStats {
+        uint64_t num_matched; /**< @brief New setpoints reported back. */
+        uint64_t num_lost; /**< @brief New setpoints not reported back within a second, nor any newer one. */
+        double mean_latency_us; /**< @brief Mean latency in microseconds. */
+        double max_latency_us; /**< @brief Largest latency in microseconds. */
+        /**
+         * @brief Setpoints by latency: below 1 ms, below 2 ms, and so on doubling,
+         * the last one counts all longer ones.
+         */
+        std::vector<uint64_t> latency_histogram;
+        /**
+         * @brief Runs of setpoints lost in a row by length: 1, 2 to 3, 4 to 7, and so
+         * on doubling, the last one counts all longer runs.
+         */
+        std::vector<uint64_t> loss_histogram;
+    };
+
     /**
      * @brief Start offboard control (synchronous).
      *
@@ -139,6 +234,13 @@ public:
      */
     bool is_active() const;
 
+    /**
+     * @brief Set the position in NED coordinates and yaw.
+     *
+     * @param position_ned_yaw Position and yaw `struct`.
+     */
+    void set_position_ned(PositionNEDYaw position_ned_yaw);
+
     /**
      * @brief Set the velocity in NED coordinates and yaw.
      *
@@ -153,6 +255,110 @@ public:
      */
     void set_velocity_body(VelocityBodyYawspeed velocity_body_yawspeed);
 
+    /**
+     * @brief Set the acceleration in NED coordinates.
+     *
+     * @param acceleration_ned Acceleration `struct`.
+     */
+    void set_acceleration_ned(AccelerationNED acceleration_ned);
+
+    /**
+     * @brief Set the attitude and thrust.
+     *
+     * @param attitude Attitude and thrust `struct`.
+     */
+    void set_attitude(Attitude attitude);
+
+    /**
+     * @brief Set the body angular rates and thrust.
+     *
+     * @param attitude_rate Angular rates and thrust `struct`.
+     */
+    void set_attitude_rate(AttitudeRate attitude_rate);
+
+    /**
+     * @brief Append points to the trajectory to fly.
+     *
+     * The trajectory is buffered and interpolated locally, and the setpoint at the
+     * current time is sent with each resend, so the rate doesn't depend on how fast
+     * points are appended. Use enable_realtime_streaming() for a higher rate.
+     *
+     * The trajectory starts when its first point is appended, the times of the
+     * points count from then. Segments can be appended while the trajectory is
+     * flown, while space is left (see get_trajectory_space()). After the last
+     * point, its position is held.
+     *
+     * This replaces any other setpoint.
+     *
+     * @param points Points with increasing times, later than the ones appended before.
+     * @return Result of request, nothing is appended if not successful.
+     */
+    Offboard::Result append_trajectory(const std::vector<TrajectoryPoint> &points);
+
+    /**
+     * @brief Drop the rest of the trajectory and hold the current position of it.
+     *
+     * The next point appended starts a new trajectory.
+     */
+    void clear_trajectory();
+
+    /**
+     * @brief Get the number of trajectory points which can still be appended.
+     *
+     * @return Number of points.
+     */
+    size_t get_trajectory_space() const;
+
+    /**
+     * @brief Resend setpoints from a dedicated thread (opt-in).
+     *
+     * By default setpoints are resent by the thread which also handles params and
+     * commands, so they can be late by some 10 ms or more. With realtime streaming,
+     * a thread of its own sends them at a fixed rate, with realtime priority if the
+     * process is permitted to (e.g. on Linux with CAP_SYS_NICE).
+     *
+     * @param rate_hz Rate at which setpoints are sent in Hz.
+     */
+    void enable_realtime_streaming(float rate_hz);
+
+    /**
+     * @brief Go back to resending setpoints from the system thread.
+     */
+    void disable_realtime_streaming();
+
+    /**
+     * @brief Get the timing of the realtime streaming.
+     *
+     * @return Stats since the streaming was enabled, all 0 if it is not.
+     */
+    StreamingStats get_streaming_stats() const;
+
+    /**
+     * @brief Start measuring the latency of position, velocity and acceleration setpoints.
+     *
+     * The autopilot is asked to report the setpoint it follows
+     * (POSITION_TARGET_LOCAL_NED) at the given rate, which should be at least the
+     * rate at which the setpoints change. Setpoints in the body frame, attitude
+     * setpoints and trajectories are not measured.
+     *
+     * @param report_rate_hz Rate at which the autopilot reports its setpoint in Hz.
+     */
+    void enable_latency_measurement(float report_rate_hz);
+
+    /**
+     * @brief Stop measuring the latency of setpoints.
+     *
+     * The stats are kept until the measurement is enabled again.
+     */
+    void disable_latency_measurement();
+
+    /**
+     * @brief Get the latency and loss of the setpoints.
+     *
+     * @return Stats since the measurement was enabled.
+     */
+    LatencyStats get_latency_stats() const;
+
     /**
      * @brief Copy constructor (object is not copyable).
      */
@@ -163,6 +369,9 @@ public:
     const Offboard &operator=(const Offboard &) = delete;
 
 private:
+    /** @private Sets the setpoints of several vehicles through their implementation. */
+    friend class OffboardFleetImpl;
+
     /** @private Underlying implementation, set at instantiation */
     std::unique_ptr<OffboardImpl> _impl;
 };
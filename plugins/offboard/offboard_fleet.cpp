@@ -0,0 +1,33 @@
+#include "offboard_fleet.h"
+#include "offboard_fleet_impl.h"
+
+namespace dronecore {
+
+OffboardFleet::OffboardFleet(const std::vector<std::shared_ptr<Offboard>> &offboards) :
+    _impl { new OffboardFleetImpl(offboards) }
+{
+}
+
+OffboardFleet::~OffboardFleet()
+{
+}
+
+bool OffboardFleet::set_position_ned(const std::vector<Offboard::PositionNEDYaw>
+                                     &position_ned_yaw)
+{
+    return _impl->set_position_ned(position_ned_yaw);
+}
+
+bool OffboardFleet::set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw>
+                                     &velocity_ned_yaw)
+{
+    return _impl->set_velocity_ned(velocity_ned_yaw);
+}
+
+bool OffboardFleet::set_velocity_body(const std::vector<Offboard::VelocityBodyYawspeed>
+                                      &velocity_body_yawspeed)
+{
+    return _impl->set_velocity_body(velocity_body_yawspeed);
+}
+
+} // namespace dronecore
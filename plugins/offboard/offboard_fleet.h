@@ -0,0 +1,76 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "offboard.h"
+
+namespace dronecore {
+
+class OffboardFleetImpl;
+
+/**
+ * @brief This class sets the offboard setpoints of several vehicles at once.
+ *
+ * Rather than every Offboard packing and sending its own setpoint, all setpoints
+ * of a tick are packed in one pass and handed to the connections at once, so
+ * that UDP connections can send them with a single system call.
+ *
+ * The Offboard objects still resend the last setpoint when no tick comes in time,
+ * and offboard mode is still started and stopped on each of them.
+ */
+class OffboardFleet
+{
+public:
+    /**
+     * @brief Constructor.
+     *
+     * @param offboards The Offboard plugins of the vehicles, the setpoints of a
+     * tick are in the same order.
+     */
+    explicit OffboardFleet(const std::vector<std::shared_ptr<Offboard>> &offboards);
+
+    /**
+     * @brief Destructor (internal use only).
+     */
+    ~OffboardFleet();
+
+    /**
+     * @brief Set the position in NED coordinates and yaw of all vehicles.
+     *
+     * @param position_ned_yaw One setpoint per vehicle.
+     * @return false if the number of setpoints does not match or sending failed.
+     */
+    bool set_position_ned(const std::vector<Offboard::PositionNEDYaw> &position_ned_yaw);
+
+    /**
+     * @brief Set the velocity in NED coordinates and yaw of all vehicles.
+     *
+     * @param velocity_ned_yaw One setpoint per vehicle.
+     * @return false if the number of setpoints does not match or sending failed.
+     */
+    bool set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw> &velocity_ned_yaw);
+
+    /**
+     * @brief Set the velocity in body coordinates and yaw angular rate of all vehicles.
+     *
+     * @param velocity_body_yawspeed One setpoint per vehicle.
+     * @return false if the number of setpoints does not match or sending failed.
+     */
+    bool set_velocity_body(const std::vector<Offboard::VelocityBodyYawspeed>
+                           &velocity_body_yawspeed);
+
+    /**
+     * @brief Copy constructor (object is not copyable).
+     */
+    OffboardFleet(const OffboardFleet &) = delete;
+    /**
+     * @brief Equality operator (object is not copyable).
+     */
+    const OffboardFleet &operator=(const OffboardFleet &) = delete;
+
+private:
+    /** @private Underlying implementation, set at instantiation */
+    std::unique_ptr<OffboardFleetImpl> _impl;
+};
+
+} // namespace dronecore
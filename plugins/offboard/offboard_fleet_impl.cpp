@@ -0,0 +1,63 @@
+#include "offboard_fleet_impl.h"
+#include "log.h"
+
+namespace dronecore {
+
+OffboardFleetImpl::OffboardFleetImpl(const std::vector<std::shared_ptr<Offboard>> &offboards) :
+    _offboards(offboards)
+{
+    _messages.reserve(_offboards.size());
+}
+
+OffboardFleetImpl::~OffboardFleetImpl() {}
+
+bool OffboardFleetImpl::set_position_ned(const std::vector<Offboard::PositionNEDYaw>
+                                         &position_ned_yaw)
+{
+    return send(position_ned_yaw, [](OffboardImpl & impl, Offboard::PositionNEDYaw setpoint) {
+        return impl.prepare_position_ned(setpoint);
+    });
+}
+
+bool OffboardFleetImpl::set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw>
+                                         &velocity_ned_yaw)
+{
+    return send(velocity_ned_yaw, [](OffboardImpl & impl, Offboard::VelocityNEDYaw setpoint) {
+        return impl.prepare_velocity_ned(setpoint);
+    });
+}
+
+bool OffboardFleetImpl::set_velocity_body(const std::vector<Offboard::VelocityBodyYawspeed>
+                                          &velocity_body_yawspeed)
+{
+    return send(velocity_body_yawspeed,
+    [](OffboardImpl & impl, Offboard::VelocityBodyYawspeed setpoint) {
+        return impl.prepare_velocity_body(setpoint);
+    });
+}
+
+template<typename Setpoint, typename Prepare>
+bool OffboardFleetImpl::send(const std::vector<Setpoint> &setpoints, Prepare prepare)
+{
+    if (setpoints.size() != _offboards.size()) {
+        LogErr() << "Got " << setpoints.size() << " setpoints for "
+                 << _offboards.size() << " vehicles";
+        return false;
+    }
+    if (_offboards.empty()) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _messages.clear();
+    for (size_t i = 0; i < setpoints.size(); ++i) {
+        _messages.push_back(prepare(*_offboards[i]->_impl, setpoints[i]));
+    }
+
+    // All vehicles share the connections and each message is routed by its
+    // target, so it doesn't matter which one sends them.
+    return _offboards.front()->_impl->send_messages(_messages);
+}
+
+} // namespace dronecore
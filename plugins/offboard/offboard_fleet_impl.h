@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "offboard.h"
+#include "offboard_impl.h"
+#include "mavlink_include.h"
+
+namespace dronecore {
+
+class OffboardFleetImpl
+{
+public:
+    explicit OffboardFleetImpl(const std::vector<std::shared_ptr<Offboard>> &offboards);
+    ~OffboardFleetImpl();
+
+    bool set_position_ned(const std::vector<Offboard::PositionNEDYaw> &position_ned_yaw);
+    bool set_velocity_ned(const std::vector<Offboard::VelocityNEDYaw> &velocity_ned_yaw);
+    bool set_velocity_body(const std::vector<Offboard::VelocityBodyYawspeed>
+                           &velocity_body_yawspeed);
+
+private:
+    // Packs the setpoints of all vehicles, then sends them with one call.
+    template<typename Setpoint, typename Prepare>
+    bool send(const std::vector<Setpoint> &setpoints, Prepare prepare);
+
+    std::vector<std::shared_ptr<Offboard>> _offboards;
+
+    // Reused for every tick, and locked for it.
+    std::mutex _mutex {};
+    std::vector<mavlink_message_t> _messages {};
+};
+
+} // namespace dronecore
@@ -2,6 +2,8 @@
 #include "offboard_impl.h"
 #include "dronecore_impl.h"
 #include "px4_custom_mode.h"
+#include <chrono>
+#include <cmath>
 
 namespace dronecore {
 
@@ -19,15 +21,23 @@ OffboardImpl::~OffboardImpl()
 void OffboardImpl::init()
 {
     // We need the system state.
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
-        std::bind(&OffboardImpl::process_heartbeat, this, std::placeholders::_1),
-        this);
+    _parent->register_message_handler<mavlink_heartbeat_t>(
+        this, &OffboardImpl::process_heartbeat);
+    _parent->register_message_handler<mavlink_position_target_local_ned_t>(
+        this, &OffboardImpl::process_position_target_local_ned);
 }
 
 void OffboardImpl::deinit()
 {
     _parent->unregister_all_mavlink_message_handlers(this);
+
+    std::unique_ptr<SetpointStreamer> streamer {};
+    {
+        std::lock_guard<std::mutex> lock(_streamer_mutex);
+        streamer = std::move(_streamer);
+    }
+    // Waits for the thread, outside of the lock.
+    streamer.reset();
 }
 
 void OffboardImpl::enable() {}
@@ -36,11 +46,8 @@ void OffboardImpl::disable() {}
 
 Offboard::Result OffboardImpl::start()
 {
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-        if (_mode == Mode::NOT_ACTIVE) {
-            return Offboard::Result::NO_SETPOINT_SET;
-        }
+    if (get_mode() == Mode::NOT_ACTIVE) {
+        return Offboard::Result::NO_SETPOINT_SET;
     }
 
     return offboard_result_from_command_result(
@@ -51,9 +58,7 @@ Offboard::Result OffboardImpl::stop()
 {
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        if (_mode != Mode::NOT_ACTIVE) {
-            stop_sending_setpoints();
-        }
+        stop_sending_setpoints();
     }
 
     return offboard_result_from_command_result(
@@ -62,15 +67,11 @@ Offboard::Result OffboardImpl::stop()
 
 void OffboardImpl::start_async(Offboard::result_callback_t callback)
 {
-    {
-        std::lock_guard<std::mutex> lock(_mutex);
-
-        if (_mode == Mode::NOT_ACTIVE) {
-            if (callback) {
-                callback(Offboard::Result::NO_SETPOINT_SET);
-            }
-            return;
+    if (get_mode() == Mode::NOT_ACTIVE) {
+        if (callback) {
+            callback(Offboard::Result::NO_SETPOINT_SET);
         }
+        return;
     }
 
     _parent->set_flight_mode_async(
@@ -83,9 +84,7 @@ void OffboardImpl::stop_async(Offboard::result_callback_t callback)
 {
     {
         std::lock_guard<std::mutex> lock(_mutex);
-        if (_mode != Mode::NOT_ACTIVE) {
-            stop_sending_setpoints();
-        }
+        stop_sending_setpoints();
     }
 
     _parent->set_flight_mode_async(
@@ -96,8 +95,12 @@ void OffboardImpl::stop_async(Offboard::result_callback_t callback)
 
 bool OffboardImpl::is_active() const
 {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return (_mode != Mode::NOT_ACTIVE);
+    return (get_mode() != Mode::NOT_ACTIVE);
+}
+
+OffboardImpl::Mode OffboardImpl::get_mode() const
+{
+    return _setpoint.load().mode;
 }
 
 void OffboardImpl::receive_command_result(MAVLinkCommands::Result result,
@@ -109,159 +112,460 @@ void OffboardImpl::receive_command_result(MAVLinkCommands::Result result,
     }
 }
 
+// Bits of the type mask of SET_POSITION_TARGET_LOCAL_NED, a set bit means ignore.
+static constexpr uint16_t IGNORE_X = (1 << 0);
+static constexpr uint16_t IGNORE_Y = (1 << 1);
+static constexpr uint16_t IGNORE_Z = (1 << 2);
+static constexpr uint16_t IGNORE_VX = (1 << 3);
+static constexpr uint16_t IGNORE_VY = (1 << 4);
+static constexpr uint16_t IGNORE_VZ = (1 << 5);
+static constexpr uint16_t IGNORE_AX = (1 << 6);
+static constexpr uint16_t IGNORE_AY = (1 << 7);
+static constexpr uint16_t IGNORE_AZ = (1 << 8);
+//static constexpr uint16_t IS_FORCE = (1 << 9);
+static constexpr uint16_t IGNORE_YAW = (1 << 10);
+static constexpr uint16_t IGNORE_YAW_RATE = (1 << 11);
+
+static constexpr uint16_t IGNORE_POSITION = IGNORE_X | IGNORE_Y | IGNORE_Z;
+static constexpr uint16_t IGNORE_VELOCITY = IGNORE_VX | IGNORE_VY | IGNORE_VZ;
+static constexpr uint16_t IGNORE_ACCELERATION = IGNORE_AX | IGNORE_AY | IGNORE_AZ;
+
+// Bits of the type mask of SET_ATTITUDE_TARGET.
+static constexpr uint8_t IGNORE_BODY_ROLL_RATE = (1 << 0);
+static constexpr uint8_t IGNORE_BODY_PITCH_RATE = (1 << 1);
+static constexpr uint8_t IGNORE_BODY_YAW_RATE = (1 << 2);
+//static constexpr uint8_t IGNORE_THROTTLE = (1 << 6);
+static constexpr uint8_t IGNORE_ATTITUDE = (1 << 7);
+
+// Quaternion (w, x, y, z) of the rotation by yaw, then pitch, then roll, in radians.
+static void quaternion_from_euler(float roll, float pitch, float yaw, float q[4])
+{
+    const float cr = cosf(roll / 2.0f);
+    const float sr = sinf(roll / 2.0f);
+    const float cp = cosf(pitch / 2.0f);
+    const float sp = sinf(pitch / 2.0f);
+    const float cy = cosf(yaw / 2.0f);
+    const float sy = sinf(yaw / 2.0f);
+
+    q[0] = cr * cp * cy + sr * sp * sy;
+    q[1] = sr * cp * cy - cr * sp * sy;
+    q[2] = cr * sp * cy + sr * cp * sy;
+    q[3] = cr * cp * sy - sr * sp * cy;
+}
+
+void OffboardImpl::set_position_ned(Offboard::PositionNEDYaw position_ned_yaw)
+{
+    set_setpoint(Mode::POSITION_NED, make_position_ned_message(position_ned_yaw));
+}
+
+mavlink_message_t
+OffboardImpl::make_position_ned_message(Offboard::PositionNEDYaw position_ned_yaw)
+{
+    return make_position_target_message(MAV_FRAME_LOCAL_NED,
+                                        IGNORE_VELOCITY | IGNORE_ACCELERATION |
+                                        IGNORE_YAW_RATE,
+                                        position_ned_yaw.north_m,
+                                        position_ned_yaw.east_m,
+                                        position_ned_yaw.down_m,
+                                        0.0f, 0.0f, 0.0f,
+                                        0.0f, 0.0f, 0.0f,
+                                        to_rad_from_deg(position_ned_yaw.yaw_deg), 0.0f);
+}
+
 void OffboardImpl::set_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw)
 {
-    _mutex.lock();
-    _velocity_ned_yaw = velocity_ned_yaw;
+    set_setpoint(Mode::VELOCITY_NED, make_velocity_ned_message(velocity_ned_yaw));
+}
+
+mavlink_message_t
+OffboardImpl::make_velocity_ned_message(Offboard::VelocityNEDYaw velocity_ned_yaw)
+{
+    return make_position_target_message(MAV_FRAME_LOCAL_NED,
+                                        IGNORE_POSITION | IGNORE_ACCELERATION |
+                                        IGNORE_YAW_RATE,
+                                        0.0f, 0.0f, 0.0f,
+                                        velocity_ned_yaw.north_m_s,
+                                        velocity_ned_yaw.east_m_s,
+                                        velocity_ned_yaw.down_m_s,
+                                        0.0f, 0.0f, 0.0f,
+                                        to_rad_from_deg(velocity_ned_yaw.yaw_deg), 0.0f);
+}
+
+void OffboardImpl::set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed)
+{
+    set_setpoint(Mode::VELOCITY_BODY, make_velocity_body_message(velocity_body_yawspeed));
+}
+
+mavlink_message_t
+OffboardImpl::make_velocity_body_message(Offboard::VelocityBodyYawspeed velocity_body_yawspeed)
+{
+    return make_position_target_message(MAV_FRAME_BODY_NED,
+                                        IGNORE_POSITION | IGNORE_ACCELERATION |
+                                        IGNORE_YAW,
+                                        0.0f, 0.0f, 0.0f,
+                                        velocity_body_yawspeed.forward_m_s,
+                                        velocity_body_yawspeed.right_m_s,
+                                        velocity_body_yawspeed.down_m_s,
+                                        0.0f, 0.0f, 0.0f,
+                                        0.0f,
+                                        to_rad_from_deg(velocity_body_yawspeed.yawspeed_deg_s));
+}
+
+void OffboardImpl::set_acceleration_ned(Offboard::AccelerationNED acceleration_ned)
+{
+    set_setpoint(Mode::ACCELERATION_NED,
+                 make_position_target_message(MAV_FRAME_LOCAL_NED,
+                                              IGNORE_POSITION | IGNORE_VELOCITY |
+                                              IGNORE_YAW | IGNORE_YAW_RATE,
+                                              0.0f, 0.0f, 0.0f,
+                                              0.0f, 0.0f, 0.0f,
+                                              acceleration_ned.north_m_s2,
+                                              acceleration_ned.east_m_s2,
+                                              acceleration_ned.down_m_s2,
+                                              0.0f, 0.0f));
+}
+
+void OffboardImpl::set_attitude(Offboard::Attitude attitude)
+{
+    float q[4];
+    quaternion_from_euler(to_rad_from_deg(attitude.roll_deg),
+                          to_rad_from_deg(attitude.pitch_deg),
+                          to_rad_from_deg(attitude.yaw_deg), q);
+
+    set_setpoint(Mode::ATTITUDE,
+                 make_attitude_target_message(IGNORE_BODY_ROLL_RATE | IGNORE_BODY_PITCH_RATE |
+                                              IGNORE_BODY_YAW_RATE,
+                                              q, 0.0f, 0.0f, 0.0f, attitude.thrust_value));
+}
+
+void OffboardImpl::set_attitude_rate(Offboard::AttitudeRate attitude_rate)
+{
+    const float q[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+
+    set_setpoint(Mode::ATTITUDE_RATE,
+                 make_attitude_target_message(IGNORE_ATTITUDE, q,
+                                              to_rad_from_deg(attitude_rate.roll_deg_s),
+                                              to_rad_from_deg(attitude_rate.pitch_deg_s),
+                                              to_rad_from_deg(attitude_rate.yaw_deg_s),
+                                              attitude_rate.thrust_value));
+}
+
+mavlink_message_t OffboardImpl::prepare_position_ned(Offboard::PositionNEDYaw position_ned_yaw)
+{
+    return prepare_setpoint(Mode::POSITION_NED, make_position_ned_message(position_ned_yaw));
+}
+
+mavlink_message_t OffboardImpl::prepare_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw)
+{
+    return prepare_setpoint(Mode::VELOCITY_NED, make_velocity_ned_message(velocity_ned_yaw));
+}
+
+mavlink_message_t
+OffboardImpl::prepare_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed)
+{
+    return prepare_setpoint(Mode::VELOCITY_BODY,
+                            make_velocity_body_message(velocity_body_yawspeed));
+}
+
+bool OffboardImpl::send_messages(const std::vector<mavlink_message_t> &messages)
+{
+    return _parent->send_messages(messages);
+}
+
+void OffboardImpl::set_setpoint(Mode mode, const mavlink_message_t &message)
+{
+    store_setpoint(mode, message);
+
+    // also send it right now to reduce latency
+    send_setpoint();
+}
+
+mavlink_message_t OffboardImpl::prepare_setpoint(Mode mode, const mavlink_message_t &message)
+{
+    store_setpoint(mode, message);
+
+    mavlink_message_t stamped = message;
+    stamp_setpoint(stamped);
+    return stamped;
+}
+
+void OffboardImpl::store_setpoint(Mode mode, const mavlink_message_t &message)
+{
+    _setpoint.store(Setpoint {mode, message});
 
-    if (_mode != Mode::VELOCITY_NED) {
-        if (_call_every_cookie) {
-            // If we're already sending other setpoints, stop that now.
-            _parent->remove_call_every(_call_every_cookie);
-            _call_every_cookie = nullptr;
+    // Only the first setpoint sets up the resending, the ones after just get
+    // picked up by it.
+    if (!_sending_setpoints.load(std::memory_order_acquire)) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_sending_setpoints && !_realtime_streaming) {
+            // We automatically send setpoints from now on.
+            _parent->add_call_every([this]() { send_setpoint(); },
+            SEND_INTERVAL_S,
+            &_call_every_cookie);
         }
-        // We automatically send NED setpoints from now on.
-        _parent->add_call_every([this]() { send_velocity_ned(); },
-        SEND_INTERVAL_S,
-        &_call_every_cookie);
+        _sending_setpoints.store(true, std::memory_order_release);
+    }
+}
 
-        _mode = Mode::VELOCITY_NED;
-    } else {
-        // We're already sending these kind of setpoints. Since the setpoint change, let's
-        // reschedule the next call, so we don't send setpoints too often.
-        _parent->reset_call_every(_call_every_cookie);
+Offboard::Result
+OffboardImpl::append_trajectory(const std::vector<Offboard::TrajectoryPoint> &points)
+{
+    const Offboard::Result result = _trajectory.append(points, _parent->get_time().elapsed_s());
+    if (result != Offboard::Result::SUCCESS || _trajectory.empty()) {
+        return result;
     }
-    _mutex.unlock();
 
-    // also send it right now to reduce latency
-    send_velocity_ned();
+    if (get_mode() != Mode::TRAJECTORY) {
+        set_setpoint(Mode::TRAJECTORY, mavlink_message_t {});
+    }
+    return result;
 }
 
-void OffboardImpl::set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed)
+void OffboardImpl::clear_trajectory()
+{
+    _trajectory.clear_and_hold(_parent->get_time().elapsed_s());
+}
+
+size_t OffboardImpl::get_trajectory_space() const
 {
-    _mutex.lock();
-    _velocity_body_yawspeed = velocity_body_yawspeed;
+    return _trajectory.get_space();
+}
 
-    if (_mode != Mode::VELOCITY_BODY) {
-        if (_call_every_cookie) {
-            // If we're already sending other setpoints, stop that now.
-            _parent->remove_call_every(_call_every_cookie);
-            _call_every_cookie = nullptr;
+void OffboardImpl::enable_realtime_streaming(float rate_hz)
+{
+    {
+        std::lock_guard<std::mutex> lock(_streamer_mutex);
+        if (_streamer) {
+            // Restarted with the new rate.
+            _streamer->stop();
         }
-        // We automatically send body setpoints from now on.
-        _parent->add_call_every([this]() { send_velocity_body(); },
+        _streamer.reset(new SetpointStreamer([this]() { send_setpoint(); }, double(rate_hz)));
+        _streamer->start();
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _realtime_streaming = true;
+    if (_call_every_cookie) {
+        _parent->remove_call_every(_call_every_cookie);
+        _call_every_cookie = nullptr;
+    }
+}
+
+void OffboardImpl::disable_realtime_streaming()
+{
+    std::unique_ptr<SetpointStreamer> streamer {};
+    {
+        std::lock_guard<std::mutex> lock(_streamer_mutex);
+        streamer = std::move(_streamer);
+    }
+    if (!streamer) {
+        return;
+    }
+    // Waits for the thread.
+    streamer.reset();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _realtime_streaming = false;
+
+    // Continue with the setpoints from the system thread.
+    if (_sending_setpoints) {
+        _parent->add_call_every([this]() { send_setpoint(); },
         SEND_INTERVAL_S,
         &_call_every_cookie);
+    }
+}
+
+Offboard::StreamingStats OffboardImpl::get_streaming_stats() const
+{
+    std::lock_guard<std::mutex> lock(_streamer_mutex);
+    if (!_streamer) {
+        return Offboard::StreamingStats {};
+    }
+    const SetpointStreamer::Stats stats = _streamer->get_stats();
+
+    Offboard::StreamingStats streaming_stats {};
+    streaming_stats.num_sent = stats.num_sent;
+    streaming_stats.num_missed = stats.num_missed;
+    streaming_stats.mean_jitter_us = stats.mean_jitter_us;
+    streaming_stats.max_jitter_us = stats.max_jitter_us;
+    streaming_stats.realtime_priority = stats.realtime_priority;
+    return streaming_stats;
+}
 
-        _mode = Mode::VELOCITY_BODY;
+void OffboardImpl::enable_latency_measurement(float report_rate_hz)
+{
+    _echo_matcher.reset();
+    _measuring_latency.store(true, std::memory_order_relaxed);
+
+    _parent->set_msg_rate_async(
+        MAVLINK_MSG_ID_POSITION_TARGET_LOCAL_NED,
+        double(report_rate_hz),
+    [](MAVLinkCommands::Result result, float) {
+        if (result != MAVLinkCommands::Result::SUCCESS &&
+            result != MAVLinkCommands::Result::IN_PROGRESS) {
+            LogWarn() << "Requesting setpoint reports failed";
+        }
+    });
+}
+
+void OffboardImpl::disable_latency_measurement()
+{
+    // The reports are left at their rate, others might use them.
+    _measuring_latency.store(false, std::memory_order_relaxed);
+}
+
+Offboard::LatencyStats OffboardImpl::get_latency_stats() const
+{
+    return _echo_matcher.get_stats();
+}
+
+void OffboardImpl::process_position_target_local_ned(
+    const mavlink_position_target_local_ned_t &position_target)
+{
+    if (!_measuring_latency.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const float values[SetpointEchoMatcher::NUM_VALUES] = {
+        position_target.x, position_target.y, position_target.z,
+        position_target.vx, position_target.vy, position_target.vz,
+        position_target.afx, position_target.afy, position_target.afz,
+        position_target.yaw, position_target.yaw_rate
+    };
+    _echo_matcher.reported(
+        values,
+        std::chrono::duration<double>(_parent->get_receive_time().time_since_epoch()).count());
+}
+
+void OffboardImpl::record_sent_setpoint(const mavlink_message_t &message)
+{
+    if (!_measuring_latency.load(std::memory_order_relaxed) ||
+        message.msgid != MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED) {
+        return;
+    }
+
+    mavlink_set_position_target_local_ned_t setpoint;
+    mavlink_msg_set_position_target_local_ned_decode(&message, &setpoint);
+    // The autopilot reports setpoints in the body frame rotated to local NED.
+    if (setpoint.coordinate_frame != MAV_FRAME_LOCAL_NED) {
+        return;
+    }
+
+    const SetpointEchoMatcher::Target target {
+        setpoint.type_mask, {
+            setpoint.x, setpoint.y, setpoint.z,
+            setpoint.vx, setpoint.vy, setpoint.vz,
+            setpoint.afx, setpoint.afy, setpoint.afz,
+            setpoint.yaw, setpoint.yaw_rate
+        }
+    };
+    _echo_matcher.sent(target, _parent->get_time().elapsed_s());
+}
+
+void OffboardImpl::send_setpoint()
+{
+    const Setpoint setpoint = _setpoint.load();
+    if (setpoint.mode == Mode::NOT_ACTIVE) {
+        return;
+    }
+    if (setpoint.mode == Mode::TRAJECTORY) {
+        send_trajectory_setpoint();
+        return;
+    }
+    mavlink_message_t message = setpoint.message;
+    stamp_setpoint(message);
+    _parent->send_message(message);
+}
+
+void OffboardImpl::stamp_setpoint(mavlink_message_t &message)
+{
+    // Both setpoint messages start with time_boot_ms, so that is all there is to
+    // patch before the header and checksum are done again.
+    _mav_put_uint32_t(_MAV_PAYLOAD_NON_CONST(&message), 0,
+                      static_cast<uint32_t>(_parent->get_time().elapsed_s() * 1e3));
+
+    if (message.msgid == MAVLINK_MSG_ID_SET_ATTITUDE_TARGET) {
+        mavlink_finalize_message(&message, GCSClient::system_id, GCSClient::component_id,
+                                 MAVLINK_MSG_ID_SET_ATTITUDE_TARGET_MIN_LEN,
+                                 MAVLINK_MSG_ID_SET_ATTITUDE_TARGET_LEN,
+                                 MAVLINK_MSG_ID_SET_ATTITUDE_TARGET_CRC);
     } else {
-        // We're already sending these kind of setpoints. Since the setpoint change, let's
-        // reschedule the next call, so we don't send setpoints too often.
-        _parent->reset_call_every(_call_every_cookie);
+        mavlink_finalize_message(&message, GCSClient::system_id, GCSClient::component_id,
+                                 MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED_MIN_LEN,
+                                 MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED_LEN,
+                                 MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED_CRC);
     }
-    _mutex.unlock();
 
-    // also send it right now to reduce latency
-    send_velocity_body();
-}
-
-void OffboardImpl::send_velocity_ned()
-{
-    const static uint16_t IGNORE_X = (1 << 0);
-    const static uint16_t IGNORE_Y = (1 << 1);
-    const static uint16_t IGNORE_Z = (1 << 2);
-    //const static uint16_t IGNORE_VX = (1 << 3);
-    //const static uint16_t IGNORE_VY = (1 << 4);
-    //const static uint16_t IGNORE_VZ = (1 << 5);
-    const static uint16_t IGNORE_AX = (1 << 6);
-    const static uint16_t IGNORE_AY = (1 << 7);
-    const static uint16_t IGNORE_AZ = (1 << 8);
-    //const static uint16_t IS_FORCE = (1 << 9);
-    //const static uint16_t IGNORE_YAW = (1 << 10);
-    const static uint16_t IGNORE_YAW_RATE = (1 << 11);
-
-    _mutex.lock();
-    const float yaw = to_rad_from_deg(_velocity_ned_yaw.yaw_deg);
-    const float yaw_rate = 0.0f;
-    const float x = 0.0f;
-    const float y = 0.0f;
-    const float z = 0.0f;
-    const float vx = _velocity_ned_yaw.north_m_s;
-    const float vy = _velocity_ned_yaw.east_m_s;
-    const float vz = _velocity_ned_yaw.down_m_s;
-    const float afx = 0.0f;
-    const float afy = 0.0f;
-    const float afz = 0.0f;
-    _mutex.unlock();
+    record_sent_setpoint(message);
+}
+
+void OffboardImpl::send_trajectory_setpoint()
+{
+    const double now_s = _parent->get_time().elapsed_s();
+
+    Offboard::TrajectoryPoint point {};
+    if (!_trajectory.sample(now_s, point)) {
+        return;
+    }
 
     mavlink_message_t message;
     mavlink_msg_set_position_target_local_ned_pack(GCSClient::system_id,
                                                    GCSClient::component_id,
                                                    &message,
-                                                   static_cast<uint32_t>(_parent->get_time().elapsed_s() * 1e3),
+                                                   static_cast<uint32_t>(now_s * 1e3),
                                                    _parent->get_system_id(),
                                                    _parent->get_autopilot_id(),
                                                    MAV_FRAME_LOCAL_NED,
-                                                   IGNORE_X | IGNORE_Y | IGNORE_Z |
-                                                   IGNORE_AX | IGNORE_AY | IGNORE_AZ |
-                                                   IGNORE_YAW_RATE,
-                                                   x, y, z, vx, vy, vz, afx, afy, afz,
-                                                   yaw, yaw_rate);
+                                                   IGNORE_ACCELERATION | IGNORE_YAW_RATE,
+                                                   point.north_m, point.east_m, point.down_m,
+                                                   point.north_m_s, point.east_m_s, point.down_m_s,
+                                                   0.0f, 0.0f, 0.0f,
+                                                   to_rad_from_deg(point.yaw_deg), 0.0f);
     _parent->send_message(message);
 }
 
-void OffboardImpl::send_velocity_body()
-{
-
-    const static uint16_t IGNORE_X = (1 << 0);
-    const static uint16_t IGNORE_Y = (1 << 1);
-    const static uint16_t IGNORE_Z = (1 << 2);
-    //const static uint16_t IGNORE_VX = (1 << 3);
-    //const static uint16_t IGNORE_VY = (1 << 4);
-    //const static uint16_t IGNORE_VZ = (1 << 5);
-    const static uint16_t IGNORE_AX = (1 << 6);
-    const static uint16_t IGNORE_AY = (1 << 7);
-    const static uint16_t IGNORE_AZ = (1 << 8);
-    //const static uint16_t IS_FORCE = (1 << 9);
-    const static uint16_t IGNORE_YAW = (1 << 10);
-    //const static uint16_t IGNORE_YAW_RATE = (1 << 11);
-
-
-    _mutex.lock();
-    const float yaw = 0.0f;
-    const float yaw_rate = to_rad_from_deg(_velocity_body_yawspeed.yawspeed_deg_s);
-    const float x = 0.0f;
-    const float y = 0.0f;
-    const float z = 0.0f;
-    const float vx = _velocity_body_yawspeed.forward_m_s;
-    const float vy = _velocity_body_yawspeed.right_m_s;
-    const float vz = _velocity_body_yawspeed.down_m_s;
-    const float afx = 0.0f;
-    const float afy = 0.0f;
-    const float afz = 0.0f;
-    _mutex.unlock();
-
+mavlink_message_t
+OffboardImpl::make_position_target_message(uint8_t frame, uint16_t type_mask,
+                                           float x, float y, float z,
+                                           float vx, float vy, float vz,
+                                           float afx, float afy, float afz,
+                                           float yaw, float yaw_rate)
+{
     mavlink_message_t message;
     mavlink_msg_set_position_target_local_ned_pack(GCSClient::system_id,
                                                    GCSClient::component_id,
                                                    &message,
-                                                   static_cast<uint32_t>(_parent->get_time().elapsed_s() * 1e3),
+                                                   0,
                                                    _parent->get_system_id(),
                                                    _parent->get_autopilot_id(),
-                                                   MAV_FRAME_BODY_NED,
-                                                   IGNORE_X | IGNORE_Y | IGNORE_Z |
-                                                   IGNORE_AX | IGNORE_AY | IGNORE_AZ |
-                                                   IGNORE_YAW,
+                                                   frame,
+                                                   type_mask,
                                                    x, y, z, vx, vy, vz, afx, afy, afz,
                                                    yaw, yaw_rate);
-    _parent->send_message(message);
+    return message;
 }
 
-void OffboardImpl::process_heartbeat(const mavlink_message_t &message)
+mavlink_message_t
+OffboardImpl::make_attitude_target_message(uint8_t type_mask, const float q[4],
+                                           float roll_rate, float pitch_rate,
+                                           float yaw_rate, float thrust)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
+    mavlink_message_t message;
+    mavlink_msg_set_attitude_target_pack(GCSClient::system_id,
+                                         GCSClient::component_id,
+                                         &message,
+                                         0,
+                                         _parent->get_system_id(),
+                                         _parent->get_autopilot_id(),
+                                         type_mask,
+                                         q,
+                                         roll_rate, pitch_rate, yaw_rate,
+                                         thrust);
+    return message;
+}
 
+void OffboardImpl::process_heartbeat(const mavlink_heartbeat_t &heartbeat)
+{
     bool offboard_mode_active = false;
     if (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
 
@@ -273,13 +577,11 @@ void OffboardImpl::process_heartbeat(const mavlink_message_t &message)
         }
     }
 
-    {
+    if (!offboard_mode_active && get_mode() != Mode::NOT_ACTIVE) {
+        // It seems that we are no longer in offboard mode but still trying to send
+        // setpoints. Let's stop for now.
         std::lock_guard<std::mutex> lock(_mutex);
-        if (!offboard_mode_active && _mode != Mode::NOT_ACTIVE) {
-            // It seems that we are no longer in offboard mode but still trying to send
-            // setpoints. Let's stop for now.
-            stop_sending_setpoints();
-        }
+        stop_sending_setpoints();
     }
 }
 
@@ -291,7 +593,8 @@ void OffboardImpl::stop_sending_setpoints()
         _parent->remove_call_every(_call_every_cookie);
         _call_every_cookie = nullptr;
     }
-    _mode = Mode::NOT_ACTIVE;
+    _setpoint.update([](Setpoint & setpoint) { setpoint.mode = Mode::NOT_ACTIVE; });
+    _sending_setpoints.store(false, std::memory_order_release);
 }
 
 Offboard::Result
@@ -1,11 +1,17 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include "plugin_impl_base.h"
 #include "mavlink_include.h"
 #include "system.h"
 #include "mavlink_system.h"
 #include "offboard.h"
+#include "setpoint_echo_matcher.h"
+#include "setpoint_streamer.h"
+#include "trajectory_buffer.h"
+#include "seqlock.h"
 
 namespace dronecore {
 
@@ -29,14 +35,76 @@ public:
 
     bool is_active() const;
 
+    void set_position_ned(Offboard::PositionNEDYaw position_ned_yaw);
     void set_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw);
     void set_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed);
+    void set_acceleration_ned(Offboard::AccelerationNED acceleration_ned);
+    void set_attitude(Offboard::Attitude attitude);
+    void set_attitude_rate(Offboard::AttitudeRate attitude_rate);
 
-private:
-    void send_velocity_ned();
-    void send_velocity_body();
+    Offboard::Result append_trajectory(const std::vector<Offboard::TrajectoryPoint> &points);
+    void clear_trajectory();
+    size_t get_trajectory_space() const;
+
+    // For OffboardFleet: these set the setpoint like the setters above, but
+    // rather than sending it right away they return it ready to send.
+    mavlink_message_t prepare_position_ned(Offboard::PositionNEDYaw position_ned_yaw);
+    mavlink_message_t prepare_velocity_ned(Offboard::VelocityNEDYaw velocity_ned_yaw);
+    mavlink_message_t prepare_velocity_body(Offboard::VelocityBodyYawspeed velocity_body_yawspeed);
+    bool send_messages(const std::vector<mavlink_message_t> &messages);
+
+    void enable_realtime_streaming(float rate_hz);
+    void disable_realtime_streaming();
+    Offboard::StreamingStats get_streaming_stats() const;
 
-    void process_heartbeat(const mavlink_message_t &message);
+    void enable_latency_measurement(float report_rate_hz);
+    void disable_latency_measurement();
+    Offboard::LatencyStats get_latency_stats() const;
+
+private:
+    enum class Mode {
+        NOT_ACTIVE,
+        POSITION_NED,
+        VELOCITY_NED,
+        VELOCITY_BODY,
+        ACCELERATION_NED,
+        ATTITUDE,
+        ATTITUDE_RATE,
+        // Sampled from _trajectory on every send.
+        TRAJECTORY
+    };
+
+    // Packed with time 0, send_setpoint() fills in the time.
+    mavlink_message_t make_position_target_message(uint8_t frame, uint16_t type_mask,
+                                                   float x, float y, float z,
+                                                   float vx, float vy, float vz,
+                                                   float afx, float afy, float afz,
+                                                   float yaw, float yaw_rate);
+    mavlink_message_t make_attitude_target_message(uint8_t type_mask, const float q[4],
+                                                   float roll_rate, float pitch_rate,
+                                                   float yaw_rate, float thrust);
+
+    mavlink_message_t make_position_ned_message(Offboard::PositionNEDYaw position_ned_yaw);
+    mavlink_message_t make_velocity_ned_message(Offboard::VelocityNEDYaw velocity_ned_yaw);
+    mavlink_message_t make_velocity_body_message(
+        Offboard::VelocityBodyYawspeed velocity_body_yawspeed);
+
+    // Makes the message the one to resend from now on and sends it right away.
+    void set_setpoint(Mode mode, const mavlink_message_t &message);
+    // Same but returns the message stamped for sending, rather than sending it.
+    mavlink_message_t prepare_setpoint(Mode mode, const mavlink_message_t &message);
+    void store_setpoint(Mode mode, const mavlink_message_t &message);
+    // Fills in the time, header and checksum of a packed setpoint.
+    void stamp_setpoint(mavlink_message_t &message);
+    // Sends the setpoint of the current mode, if any.
+    void send_setpoint();
+    void send_trajectory_setpoint();
+
+    void process_heartbeat(const mavlink_heartbeat_t &heartbeat);
+    void process_position_target_local_ned(
+        const mavlink_position_target_local_ned_t &position_target);
+    // Passes a setpoint about to be sent to the latency measurement.
+    void record_sent_setpoint(const mavlink_message_t &message);
     void receive_command_result(MAVLinkCommands::Result result,
                                 const Offboard::result_callback_t &callback);
 
@@ -45,16 +113,37 @@ private:
 
     void stop_sending_setpoints();
 
-    mutable std::mutex _mutex {};
-    enum class Mode {
-        NOT_ACTIVE,
-        VELOCITY_NED,
-        VELOCITY_BODY
-    } _mode = Mode::NOT_ACTIVE;
-    Offboard::VelocityNEDYaw _velocity_ned_yaw {};
-    Offboard::VelocityBodyYawspeed _velocity_body_yawspeed {};
+    Mode get_mode() const;
+
+    // The setpoint is packed once when it is set. Resending only copies it out
+    // and patches the time, rather than packing it every cycle.
+    struct Setpoint {
+        Mode mode;
+        mavlink_message_t message;
+    };
+    // Handed from the user's thread to the sending one without a lock, neither
+    // ever waits for the other.
+    SeqLock<Setpoint> _setpoint {Setpoint {Mode::NOT_ACTIVE, mavlink_message_t {}}};
+
+    // Set once setpoints are resent, so that further setpoints don't need the lock.
+    std::atomic<bool> _sending_setpoints {false};
 
+    // Protects the registration of the resending below.
+    mutable std::mutex _mutex {};
     void *_call_every_cookie = nullptr;
+    // While set, _streamer sends the setpoints instead of the call every.
+    bool _realtime_streaming = false;
+
+    // Not locked with _mutex, stopping the streamer waits for its thread.
+    mutable std::mutex _streamer_mutex {};
+    std::unique_ptr<SetpointStreamer> _streamer {};
+
+    static constexpr size_t TRAJECTORY_CAPACITY = 1000;
+    TrajectoryBuffer _trajectory {TRAJECTORY_CAPACITY};
+
+    // Checked on every send, the matcher is only used while it is set.
+    std::atomic<bool> _measuring_latency {false};
+    SetpointEchoMatcher _echo_matcher {};
 
     const float SEND_INTERVAL_S = 0.1f;
 };
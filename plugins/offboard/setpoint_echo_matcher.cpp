@@ -0,0 +1,146 @@
+#include "setpoint_echo_matcher.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dronecore {
+
+constexpr unsigned SetpointEchoMatcher::NUM_VALUES;
+constexpr double SetpointEchoMatcher::DEFAULT_LOSS_TIMEOUT_S;
+constexpr unsigned SetpointEchoMatcher::CAPACITY;
+constexpr unsigned SetpointEchoMatcher::NUM_LATENCY_BUCKETS;
+constexpr unsigned SetpointEchoMatcher::NUM_LOSS_BUCKETS;
+
+// Reported values are copies of what was sent, this only allows for rounding.
+static constexpr float MATCH_TOLERANCE = 1e-4f;
+
+SetpointEchoMatcher::SetpointEchoMatcher(double loss_timeout_s) :
+    _loss_timeout_s(loss_timeout_s)
+{
+}
+
+void SetpointEchoMatcher::reset()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _head = 0;
+    _count = 0;
+    _has_last_sent = false;
+    _num_matched = 0;
+    _num_lost = 0;
+    _total_latency_us = 0.0;
+    _max_latency_us = 0.0;
+    std::fill(std::begin(_latency_histogram), std::end(_latency_histogram), 0);
+    _loss_run = 0;
+    std::fill(std::begin(_loss_histogram), std::end(_loss_histogram), 0);
+}
+
+void SetpointEchoMatcher::sent(const Target &target, double time_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    expire(time_s);
+
+    if (_has_last_sent && _last_sent.type_mask == target.type_mask &&
+        same_values(_last_sent, target.values)) {
+        return;
+    }
+    _has_last_sent = true;
+    _last_sent = target;
+
+    if (_count == CAPACITY) {
+        // Forgotten like the ones replaced before they were reported.
+        _head = (_head + 1) % CAPACITY;
+        --_count;
+    }
+    _waiting[(_head + _count) % CAPACITY] = Waiting {target, time_s};
+    ++_count;
+}
+
+void SetpointEchoMatcher::reported(const float values[NUM_VALUES], double time_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    expire(time_s);
+
+    // Newest first, the autopilot reports the setpoint it currently follows.
+    for (unsigned i = _count; i > 0; --i) {
+        const Waiting &waiting = _waiting[(_head + i - 1) % CAPACITY];
+        if (!same_values(waiting.target, values)) {
+            continue;
+        }
+
+        const double latency_us = std::max((time_s - waiting.sent_s) * 1e6, 0.0);
+        ++_num_matched;
+        _total_latency_us += latency_us;
+        _max_latency_us = std::max(_max_latency_us, latency_us);
+        const uint64_t latency_ms = static_cast<uint64_t>(latency_us / 1e3);
+        const unsigned bucket = (latency_ms == 0) ? 0 : floor_log2(latency_ms) + 1;
+        ++_latency_histogram[std::min(bucket, NUM_LATENCY_BUCKETS - 1)];
+        end_loss_run();
+
+        // The matched one and all older ones are done.
+        _head = (_head + i) % CAPACITY;
+        _count -= i;
+        return;
+    }
+    // Otherwise it is a setpoint already matched, or not one of ours.
+}
+
+Offboard::LatencyStats SetpointEchoMatcher::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Offboard::LatencyStats stats {};
+    stats.num_matched = _num_matched;
+    stats.num_lost = _num_lost;
+    stats.mean_latency_us = (_num_matched > 0) ? _total_latency_us / double(_num_matched) : 0.0;
+    stats.max_latency_us = _max_latency_us;
+    stats.latency_histogram.assign(std::begin(_latency_histogram), std::end(_latency_histogram));
+    stats.loss_histogram.assign(std::begin(_loss_histogram), std::end(_loss_histogram));
+    // The setpoints lost so far are counted as a run of their own.
+    if (_loss_run > 0) {
+        ++stats.loss_histogram[std::min(floor_log2(_loss_run), NUM_LOSS_BUCKETS - 1)];
+    }
+    return stats;
+}
+
+void SetpointEchoMatcher::expire(double now_s)
+{
+    while (_count > 0 && now_s - _waiting[_head].sent_s > _loss_timeout_s) {
+        ++_num_lost;
+        ++_loss_run;
+        _head = (_head + 1) % CAPACITY;
+        --_count;
+    }
+}
+
+void SetpointEchoMatcher::end_loss_run()
+{
+    if (_loss_run == 0) {
+        return;
+    }
+    ++_loss_histogram[std::min(floor_log2(_loss_run), NUM_LOSS_BUCKETS - 1)];
+    _loss_run = 0;
+}
+
+bool SetpointEchoMatcher::same_values(const Target &target, const float values[NUM_VALUES])
+{
+    // Bits 0 to 8 ignore x to afz, 10 and 11 yaw and yaw rate. Bit 9 (force)
+    // doesn't ignore a value.
+    static constexpr unsigned MASK_BITS[NUM_VALUES] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 10, 11};
+
+    for (unsigned i = 0; i < NUM_VALUES; ++i) {
+        if ((target.type_mask & (1u << MASK_BITS[i])) != 0) {
+            continue;
+        }
+        const float tolerance = MATCH_TOLERANCE * std::max(1.0f, std::fabs(target.values[i]));
+        if (!(std::fabs(values[i] - target.values[i]) <= tolerance)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+unsigned SetpointEchoMatcher::floor_log2(uint64_t value)
+{
+    return 63u - unsigned(__builtin_clzll(value));
+}
+
+} // namespace dronecore
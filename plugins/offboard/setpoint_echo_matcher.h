@@ -0,0 +1,85 @@
+#pragma once
+
+#include "offboard.h"
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+namespace dronecore {
+
+// Measures how long setpoints take until the autopilot applies them, from the
+// setpoints it reports back (POSITION_TARGET_LOCAL_NED).
+//
+// Resending the same setpoint doesn't count, only changes are waited for. A
+// report matches the newest setpoint with the same values; older setpoints
+// still waiting were replaced before they were applied and are forgotten. A
+// setpoint not reported back within the loss timeout, nor any newer one, is
+// counted as lost.
+class SetpointEchoMatcher
+{
+public:
+    static constexpr unsigned NUM_VALUES = 11;
+
+    // x, y, z, vx, vy, vz, afx, afy, afz, yaw, yaw_rate as in the message, the
+    // ones ignored by the type mask are not compared.
+    struct Target {
+        uint16_t type_mask;
+        float values[NUM_VALUES];
+    };
+
+    explicit SetpointEchoMatcher(double loss_timeout_s = DEFAULT_LOSS_TIMEOUT_S);
+    ~SetpointEchoMatcher() = default;
+
+    void reset();
+
+    void sent(const Target &target, double time_s);
+    void reported(const float values[NUM_VALUES], double time_s);
+
+    Offboard::LatencyStats get_stats() const;
+
+    static constexpr double DEFAULT_LOSS_TIMEOUT_S = 1.0;
+    // Setpoints waiting to be reported, older ones are forgotten.
+    static constexpr unsigned CAPACITY = 32;
+    static constexpr unsigned NUM_LATENCY_BUCKETS = 12;
+    static constexpr unsigned NUM_LOSS_BUCKETS = 8;
+
+    // Non-copyable
+    SetpointEchoMatcher(const SetpointEchoMatcher &) = delete;
+    const SetpointEchoMatcher &operator=(const SetpointEchoMatcher &) = delete;
+
+private:
+    struct Waiting {
+        Target target;
+        double sent_s;
+    };
+
+    // These need to be called with _mutex locked.
+    void expire(double now_s);
+    void end_loss_run();
+
+    static bool same_values(const Target &target, const float values[NUM_VALUES]);
+    // Of a value above 0.
+    static unsigned floor_log2(uint64_t value);
+
+    const double _loss_timeout_s;
+
+    mutable std::mutex _mutex {};
+
+    Waiting _waiting[CAPACITY] {};
+    unsigned _head {0};
+    unsigned _count {0};
+    // Compared against to skip the resending of a setpoint.
+    bool _has_last_sent {false};
+    Target _last_sent {};
+
+    uint64_t _num_matched {0};
+    uint64_t _num_lost {0};
+    double _total_latency_us {0.0};
+    double _max_latency_us {0.0};
+    uint64_t _latency_histogram[NUM_LATENCY_BUCKETS] {};
+    // Setpoints lost in a row so far.
+    uint64_t _loss_run {0};
+    uint64_t _loss_histogram[NUM_LOSS_BUCKETS] {};
+};
+
+} // namespace dronecore
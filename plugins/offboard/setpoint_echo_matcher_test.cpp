@@ -0,0 +1,92 @@
+#include "setpoint_echo_matcher.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+// Velocity setpoint, position and acceleration ignored.
+static SetpointEchoMatcher::Target make_velocity_target(float north_m_s)
+{
+    SetpointEchoMatcher::Target target {};
+    target.type_mask = 0x1c7;
+    target.values[3] = north_m_s;
+    return target;
+}
+
+static void report_velocity(SetpointEchoMatcher &matcher, float north_m_s, double time_s)
+{
+    // The autopilot fills in position setpoints of its own.
+    const float values[SetpointEchoMatcher::NUM_VALUES] = {
+        12.0f, 3.0f, -5.0f, north_m_s, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f
+    };
+    matcher.reported(values, time_s);
+}
+
+TEST(SetpointEchoMatcher, MeasuresLatencyOfChanges)
+{
+    SetpointEchoMatcher matcher;
+
+    matcher.sent(make_velocity_target(1.0f), 10.0);
+    // Resent, the latency still counts from the first one.
+    matcher.sent(make_velocity_target(1.0f), 10.02);
+    report_velocity(matcher, 1.0f, 10.005);
+    // Reported again, already matched.
+    report_velocity(matcher, 1.0f, 10.03);
+
+    matcher.sent(make_velocity_target(2.0f), 11.0);
+    report_velocity(matcher, 1.0f, 11.001);
+    report_velocity(matcher, 2.0f, 11.012);
+
+    const Offboard::LatencyStats stats = matcher.get_stats();
+    EXPECT_EQ(stats.num_matched, 2u);
+    EXPECT_EQ(stats.num_lost, 0u);
+    EXPECT_NEAR(stats.mean_latency_us, 8500.0, 1.0);
+    EXPECT_NEAR(stats.max_latency_us, 12000.0, 1.0);
+    ASSERT_EQ(stats.latency_histogram.size(), SetpointEchoMatcher::NUM_LATENCY_BUCKETS);
+    // 5 ms is below 8 ms, 12 ms below 16 ms.
+    EXPECT_EQ(stats.latency_histogram[3], 1u);
+    EXPECT_EQ(stats.latency_histogram[4], 1u);
+}
+
+TEST(SetpointEchoMatcher, ReplacedSetpointsAreNotLost)
+{
+    SetpointEchoMatcher matcher(1.0);
+
+    matcher.sent(make_velocity_target(1.0f), 0.0);
+    matcher.sent(make_velocity_target(2.0f), 0.01);
+    matcher.sent(make_velocity_target(3.0f), 0.02);
+    report_velocity(matcher, 3.0f, 0.05);
+
+    // Long after, nothing older is waiting anymore.
+    matcher.sent(make_velocity_target(3.0f), 5.0);
+
+    const Offboard::LatencyStats stats = matcher.get_stats();
+    EXPECT_EQ(stats.num_matched, 1u);
+    EXPECT_EQ(stats.num_lost, 0u);
+    EXPECT_NEAR(stats.mean_latency_us, 30000.0, 1.0);
+}
+
+TEST(SetpointEchoMatcher, CountsRunsOfLostSetpoints)
+{
+    SetpointEchoMatcher matcher(1.0);
+
+    // Three setpoints a few seconds apart which are never reported.
+    matcher.sent(make_velocity_target(1.0f), 0.0);
+    matcher.sent(make_velocity_target(2.0f), 2.0);
+    matcher.sent(make_velocity_target(3.0f), 4.0);
+    matcher.sent(make_velocity_target(4.0f), 6.0);
+    report_velocity(matcher, 4.0f, 6.1);
+
+    matcher.sent(make_velocity_target(5.0f), 8.0);
+    matcher.sent(make_velocity_target(6.0f), 10.0);
+
+    const Offboard::LatencyStats stats = matcher.get_stats();
+    EXPECT_EQ(stats.num_matched, 1u);
+    EXPECT_EQ(stats.num_lost, 4u);
+    ASSERT_EQ(stats.loss_histogram.size(), SetpointEchoMatcher::NUM_LOSS_BUCKETS);
+    // A run of 3, and the one lost since then.
+    EXPECT_EQ(stats.loss_histogram[0], 1u);
+    EXPECT_EQ(stats.loss_histogram[1], 1u);
+
+    matcher.reset();
+    EXPECT_EQ(matcher.get_stats().num_lost, 0u);
+}
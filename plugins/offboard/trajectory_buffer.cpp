@@ -0,0 +1,157 @@
+#include "trajectory_buffer.h"
+#include <cmath>
+#include <limits>
+
+namespace dronecore {
+
+TrajectoryBuffer::TrajectoryBuffer(size_t capacity) :
+    _points(capacity)
+{}
+
+Offboard::Result TrajectoryBuffer::append(const std::vector<Offboard::TrajectoryPoint> &points,
+                                          double now_s)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (points.empty()) {
+        return Offboard::Result::SUCCESS;
+    }
+
+    double last_time_s = (_size > 0) ? get(_size - 1).time_s :
+                         -std::numeric_limits<double>::infinity();
+    for (const auto &point : points) {
+        if (!(point.time_s > last_time_s)) {
+            return Offboard::Result::TRAJECTORY_INVALID;
+        }
+        last_time_s = point.time_s;
+    }
+
+    if (points.size() > _points.size() - _size) {
+        return Offboard::Result::TRAJECTORY_BUFFER_FULL;
+    }
+
+    if (!_started) {
+        _started = true;
+        _start_s = now_s;
+        _holding = false;
+    }
+
+    for (const auto &point : points) {
+        _points[(_first + _size) % _points.size()] = point;
+        ++_size;
+    }
+    return Offboard::Result::SUCCESS;
+}
+
+void TrajectoryBuffer::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _first = 0;
+    _size = 0;
+    _started = false;
+    _holding = false;
+}
+
+void TrajectoryBuffer::clear_and_hold(double now_s)
+{
+    // In one go, so the sender never sees the trajectory without the hold.
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Offboard::TrajectoryPoint point {};
+    if (sample_locked(now_s, point)) {
+        _hold_point = point;
+        _hold_point.time_s = 0.0;
+        _hold_point.north_m_s = _hold_point.east_m_s = _hold_point.down_m_s = 0.0f;
+        _holding = true;
+    }
+    _first = 0;
+    _size = 0;
+    _started = false;
+}
+
+bool TrajectoryBuffer::empty() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _size == 0;
+}
+
+size_t TrajectoryBuffer::get_space() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _points.size() - _size;
+}
+
+bool TrajectoryBuffer::sample(double now_s, Offboard::TrajectoryPoint &point)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return sample_locked(now_s, point);
+}
+
+bool TrajectoryBuffer::sample_locked(double now_s, Offboard::TrajectoryPoint &point)
+{
+    if (_size == 0) {
+        if (_holding) {
+            point = _hold_point;
+            return true;
+        }
+        return false;
+    }
+
+    const double time_s = now_s - _start_s;
+
+    // Drop what is flown, but keep the point before time_s to interpolate from.
+    while (_size >= 2 && get(1).time_s <= time_s) {
+        _first = (_first + 1) % _points.size();
+        --_size;
+    }
+
+    const Offboard::TrajectoryPoint &first = get(0);
+
+    if (time_s <= first.time_s) {
+        point = first;
+        if (time_s < first.time_s) {
+            point.north_m_s = point.east_m_s = point.down_m_s = 0.0f;
+        }
+    } else if (_size == 1) {
+        // The end of the trajectory, stay there until more is appended.
+        point = first;
+        point.north_m_s = point.east_m_s = point.down_m_s = 0.0f;
+    } else {
+        point = interpolate(first, get(1), time_s);
+    }
+    point.time_s = time_s;
+    return true;
+}
+
+const Offboard::TrajectoryPoint &TrajectoryBuffer::get(size_t i) const
+{
+    return _points[(_first + i) % _points.size()];
+}
+
+Offboard::TrajectoryPoint TrajectoryBuffer::interpolate(const Offboard::TrajectoryPoint &before,
+                                                        const Offboard::TrajectoryPoint &after,
+                                                        double time_s)
+{
+    const float ratio = float((time_s - before.time_s) / (after.time_s - before.time_s));
+    auto lerp = [ratio](float a, float b) { return a + (b - a) * ratio; };
+
+    Offboard::TrajectoryPoint point {};
+    point.north_m = lerp(before.north_m, after.north_m);
+    point.east_m = lerp(before.east_m, after.east_m);
+    point.down_m = lerp(before.down_m, after.down_m);
+    point.north_m_s = lerp(before.north_m_s, after.north_m_s);
+    point.east_m_s = lerp(before.east_m_s, after.east_m_s);
+    point.down_m_s = lerp(before.down_m_s, after.down_m_s);
+
+    // The short way round, e.g. from 350 to 10 degrees over 0.
+    float yaw_change_deg = std::fmod(after.yaw_deg - before.yaw_deg, 360.0f);
+    if (yaw_change_deg > 180.0f) {
+        yaw_change_deg -= 360.0f;
+    } else if (yaw_change_deg < -180.0f) {
+        yaw_change_deg += 360.0f;
+    }
+    point.yaw_deg = before.yaw_deg + yaw_change_deg * ratio;
+    return point;
+}
+
+} // namespace dronecore
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "offboard.h"
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// Fixed-capacity ring of trajectory points, appended by the user and sampled
+// by the setpoint sender. Points already flown are dropped as the trajectory
+// is sampled, which makes room for more segments.
+//
+// The times of the points count from the start of the trajectory, which is
+// when the first point is appended after construction or clear().
+class TrajectoryBuffer
+{
+public:
+    explicit TrajectoryBuffer(size_t capacity);
+
+    // Either all points are appended or none. Times need to increase, also
+    // from the last point buffered.
+    Offboard::Result append(const std::vector<Offboard::TrajectoryPoint> &points, double now_s);
+
+    void clear();
+    // Drops the rest of the trajectory but holds its position at now_s, with zero
+    // velocity, until points are appended again. These start a new trajectory.
+    void clear_and_hold(double now_s);
+
+    bool empty() const;
+    // Number of points which still fit.
+    size_t get_space() const;
+
+    // Interpolates the trajectory at now_s. Before the first point, its position
+    // is held, after the last one, its position and yaw with zero velocity.
+    // Returns false if there are no points and nothing is held.
+    bool sample(double now_s, Offboard::TrajectoryPoint &point);
+
+    // Non-copyable
+    TrajectoryBuffer(const TrajectoryBuffer &) = delete;
+    const TrajectoryBuffer &operator=(const TrajectoryBuffer &) = delete;
+
+private:
+    // Need to be called with _mutex locked, i counts from the oldest point.
+    const Offboard::TrajectoryPoint &get(size_t i) const;
+    bool sample_locked(double now_s, Offboard::TrajectoryPoint &point);
+
+    static Offboard::TrajectoryPoint interpolate(const Offboard::TrajectoryPoint &before,
+                                                 const Offboard::TrajectoryPoint &after,
+                                                 double time_s);
+
+    mutable std::mutex _mutex {};
+    std::vector<Offboard::TrajectoryPoint> _points;
+    size_t _first {0};
+    size_t _size {0};
+
+    bool _started {false};
+    double _start_s {0.0};
+
+    // Left by clear_and_hold() until the next trajectory starts.
+    bool _holding {false};
+    Offboard::TrajectoryPoint _hold_point {};
+};
+
+} // namespace dronecore
@@ -0,0 +1,124 @@
+#include "trajectory_buffer.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace dronecore;
+
+static Offboard::TrajectoryPoint make_point(double time_s, float north_m, float yaw_deg)
+{
+    Offboard::TrajectoryPoint point {};
+    point.time_s = time_s;
+    point.north_m = north_m;
+    point.north_m_s = 1.0f;
+    point.yaw_deg = yaw_deg;
+    return point;
+}
+
+TEST(TrajectoryBuffer, InterpolatesFromStart)
+{
+    TrajectoryBuffer buffer(10);
+    Offboard::TrajectoryPoint point {};
+    EXPECT_FALSE(buffer.sample(0.0, point));
+
+    // Starts at 100 s.
+    ASSERT_EQ(buffer.append({make_point(0.0, 0.0f, 0.0f), make_point(2.0, 2.0f, 90.0f)}, 100.0),
+              Offboard::Result::SUCCESS);
+
+    ASSERT_TRUE(buffer.sample(100.0, point));
+    EXPECT_FLOAT_EQ(point.north_m, 0.0f);
+
+    ASSERT_TRUE(buffer.sample(101.5, point));
+    EXPECT_DOUBLE_EQ(point.time_s, 1.5);
+    EXPECT_FLOAT_EQ(point.north_m, 1.5f);
+    EXPECT_FLOAT_EQ(point.north_m_s, 1.0f);
+    EXPECT_FLOAT_EQ(point.yaw_deg, 67.5f);
+
+    // The end is held.
+    ASSERT_TRUE(buffer.sample(105.0, point));
+    EXPECT_FLOAT_EQ(point.north_m, 2.0f);
+    EXPECT_FLOAT_EQ(point.north_m_s, 0.0f);
+    EXPECT_FLOAT_EQ(point.yaw_deg, 90.0f);
+}
+
+TEST(TrajectoryBuffer, InterpolatesYawTheShortWay)
+{
+    TrajectoryBuffer buffer(10);
+    ASSERT_EQ(buffer.append({make_point(0.0, 0.0f, 350.0f), make_point(1.0, 0.0f, 10.0f)}, 0.0),
+              Offboard::Result::SUCCESS);
+
+    Offboard::TrajectoryPoint point {};
+    ASSERT_TRUE(buffer.sample(0.25, point));
+    EXPECT_FLOAT_EQ(point.yaw_deg, 355.0f);
+}
+
+TEST(TrajectoryBuffer, AppendsSegmentsAndFreesSpace)
+{
+    TrajectoryBuffer buffer(3);
+
+    ASSERT_EQ(buffer.append({make_point(0.0, 0.0f, 0.0f), make_point(1.0, 1.0f, 0.0f),
+                             make_point(2.0, 2.0f, 0.0f)
+                            }, 0.0),
+              Offboard::Result::SUCCESS);
+    EXPECT_EQ(buffer.get_space(), 0);
+    EXPECT_EQ(buffer.append({make_point(3.0, 3.0f, 0.0f)}, 0.0),
+              Offboard::Result::TRAJECTORY_BUFFER_FULL);
+
+    // Times need to go on from the last point.
+    Offboard::TrajectoryPoint point {};
+    ASSERT_TRUE(buffer.sample(1.5, point));
+    EXPECT_EQ(buffer.get_space(), 1);
+    EXPECT_EQ(buffer.append({make_point(2.0, 3.0f, 0.0f)}, 0.0),
+              Offboard::Result::TRAJECTORY_INVALID);
+    EXPECT_EQ(buffer.append({make_point(3.0, 3.0f, 0.0f)}, 10.0),
+              Offboard::Result::SUCCESS);
+
+    // Still on the time base of the first segment.
+    ASSERT_TRUE(buffer.sample(2.5, point));
+    EXPECT_FLOAT_EQ(point.north_m, 2.5f);
+}
+
+TEST(TrajectoryBuffer, ClearRestarts)
+{
+    TrajectoryBuffer buffer(4);
+    ASSERT_EQ(buffer.append({make_point(0.0, 5.0f, 0.0f)}, 0.0), Offboard::Result::SUCCESS);
+    buffer.clear();
+    EXPECT_TRUE(buffer.empty());
+
+    ASSERT_EQ(buffer.append({make_point(0.0, 1.0f, 0.0f), make_point(1.0, 2.0f, 0.0f)}, 50.0),
+              Offboard::Result::SUCCESS);
+
+    Offboard::TrajectoryPoint point {};
+    ASSERT_TRUE(buffer.sample(50.5, point));
+    EXPECT_FLOAT_EQ(point.north_m, 1.5f);
+}
+
+TEST(TrajectoryBuffer, ClearHoldsUntilNextTrajectory)
+{
+    TrajectoryBuffer buffer(4);
+    ASSERT_EQ(buffer.append({make_point(0.0, 0.0f, 0.0f), make_point(10.0, 10.0f, 0.0f)}, 0.0),
+              Offboard::Result::SUCCESS);
+
+    buffer.clear_and_hold(4.0);
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.get_space(), 4u);
+
+    // Where it was when cleared, standing still.
+    Offboard::TrajectoryPoint point {};
+    ASSERT_TRUE(buffer.sample(20.0, point));
+    EXPECT_FLOAT_EQ(point.north_m, 4.0f);
+    EXPECT_FLOAT_EQ(point.north_m_s, 0.0f);
+
+    // The next trajectory starts at 0 again, counting from when it is appended.
+    ASSERT_EQ(buffer.append({make_point(0.0, 1.0f, 0.0f), make_point(1.0, 2.0f, 0.0f)}, 50.0),
+              Offboard::Result::SUCCESS);
+    ASSERT_TRUE(buffer.sample(50.5, point));
+    EXPECT_FLOAT_EQ(point.north_m, 1.5f);
+
+    // Nothing held after a plain clear.
+    buffer.clear();
+    EXPECT_FALSE(buffer.sample(60.0, point));
+
+    // Nor if there was nothing to hold.
+    buffer.clear_and_hold(70.0);
+    EXPECT_FALSE(buffer.sample(70.0, point));
+}
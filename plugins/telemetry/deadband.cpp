@@ -0,0 +1,54 @@
+#include "deadband.h"
+#include "geo.h"
+#include <cmath>
+
+namespace dronecore {
+
+// Either of them NAN, but not both.
+static bool nan_changed(double last, double value)
+{
+    return std::isnan(last) != std::isnan(value);
+}
+
+static bool exceeds(double last, double value, double deadband)
+{
+    return nan_changed(last, value) || std::fabs(value - last) > deadband;
+}
+
+bool exceeds_deadband(const Telemetry::Position &last, const Telemetry::Position &value,
+                      double deadband)
+{
+    if (nan_changed(last.latitude_deg, value.latitude_deg) ||
+        nan_changed(last.longitude_deg, value.longitude_deg) ||
+        exceeds(double(last.absolute_altitude_m), double(value.absolute_altitude_m), deadband) ||
+        exceeds(double(last.relative_altitude_m), double(value.relative_altitude_m), deadband)) {
+        return true;
+    }
+
+    // Both NAN, which doesn't change.
+    if (std::isnan(value.latitude_deg) || std::isnan(value.longitude_deg)) {
+        return false;
+    }
+    return haversine_distance_m(last.latitude_deg, last.longitude_deg,
+                                value.latitude_deg, value.longitude_deg) > deadband;
+}
+
+bool exceeds_deadband(const Telemetry::Battery &last, const Telemetry::Battery &value,
+                      double deadband)
+{
+    if (std::isnan(last.remaining_percent) && std::isnan(value.remaining_percent)) {
+        return last.voltage_v != value.voltage_v;
+    }
+    return exceeds(double(last.remaining_percent), double(value.remaining_percent), deadband);
+}
+
+bool exceeds_deadband(const Telemetry::RCStatus &last, const Telemetry::RCStatus &value,
+                      double deadband)
+{
+    return last.available_once != value.available_once ||
+           last.available != value.available ||
+           exceeds(double(last.signal_strength_percent), double(value.signal_strength_percent),
+                   deadband);
+}
+
+} // namespace dronecore
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "telemetry.h"
+
+namespace dronecore {
+
+// Whether a value changed enough since the last one notified to notify a
+// subscriber again. The deadband is in the unit of the stream:
+//
+// - Position: meters, horizontally or vertically.
+// - Battery: remaining (range: 0 to 1), or any change of the voltage if the
+//   remaining is not estimated.
+// - RC status: signal strength in percent, and any change of availability.
+//
+// For all other streams any change is enough. Values turning NAN or back are
+// always a change.
+bool exceeds_deadband(const Telemetry::Position &last, const Telemetry::Position &value,
+                      double deadband);
+bool exceeds_deadband(const Telemetry::Battery &last, const Telemetry::Battery &value,
+                      double deadband);
+bool exceeds_deadband(const Telemetry::RCStatus &last, const Telemetry::RCStatus &value,
+                      double deadband);
+
+template<typename T>
+bool exceeds_deadband(const T &last, const T &value, double /*deadband*/)
+{
+    return !(last == value);
+}
+
+// A filter for SubscriberList passing the first value and then those exceeding
+// the deadband compared to the last value passed.
+template<typename T>
+std::function<bool(const T &)> make_deadband_filter(double deadband)
+{
+    bool has_last = false;
+    T last {};
+    return [deadband, has_last, last](const T & value) mutable {
+        if (has_last && !exceeds_deadband(last, value, deadband)) {
+            return false;
+        }
+        has_last = true;
+        last = value;
+        return true;
+    };
+}
+
+} // namespace dronecore
@@ -0,0 +1,65 @@
+#include "deadband.h"
+#include <gtest/gtest.h>
+#include <cmath>
+#include <vector>
+
+using namespace dronecore;
+
+TEST(Deadband, Position)
+{
+    const Telemetry::Position last {47.3977, 8.5456, 488.0f, 10.0f};
+
+    // About 0.3 m north.
+    Telemetry::Position value {47.3977027, 8.5456, 488.0f, 10.0f};
+    EXPECT_FALSE(exceeds_deadband(last, value, 0.5));
+    EXPECT_TRUE(exceeds_deadband(last, value, 0.2));
+
+    value = last;
+    value.relative_altitude_m = 10.6f;
+    EXPECT_TRUE(exceeds_deadband(last, value, 0.5));
+
+    value = last;
+    value.latitude_deg = double(NAN);
+    EXPECT_TRUE(exceeds_deadband(last, value, 1000.0));
+    EXPECT_FALSE(exceeds_deadband(value, value, 0.0));
+}
+
+TEST(Deadband, Battery)
+{
+    const Telemetry::Battery last {12.1f, 0.80f};
+    EXPECT_FALSE(exceeds_deadband(last, Telemetry::Battery {12.0f, 0.795f}, 0.01));
+    EXPECT_TRUE(exceeds_deadband(last, Telemetry::Battery {12.0f, 0.785f}, 0.01));
+
+    // Without a remaining estimate the voltage is all there is.
+    const Telemetry::Battery no_remaining {12.1f, NAN};
+    EXPECT_TRUE(exceeds_deadband(last, no_remaining, 0.01));
+    EXPECT_FALSE(exceeds_deadband(no_remaining, no_remaining, 0.01));
+    EXPECT_TRUE(exceeds_deadband(no_remaining, Telemetry::Battery {12.0f, NAN}, 0.01));
+}
+
+TEST(Deadband, RCStatus)
+{
+    const Telemetry::RCStatus last {true, true, 80.0f};
+    EXPECT_FALSE(exceeds_deadband(last, Telemetry::RCStatus {true, true, 83.0f}, 5.0));
+    EXPECT_TRUE(exceeds_deadband(last, Telemetry::RCStatus {true, true, 86.0f}, 5.0));
+    EXPECT_TRUE(exceeds_deadband(last, Telemetry::RCStatus {true, false, 80.0f}, 5.0));
+}
+
+TEST(Deadband, FilterPassesChangesOnly)
+{
+    auto filter = make_deadband_filter<Telemetry::Battery>(0.05);
+
+    std::vector<float> passed;
+    for (float remaining : {0.90f, 0.89f, 0.87f, 0.84f, 0.83f, 0.78f}) {
+        if (filter(Telemetry::Battery {12.0f, remaining})) {
+            passed.push_back(remaining);
+        }
+    }
+    EXPECT_EQ(passed, (std::vector<float> {0.90f, 0.84f, 0.78f}));
+
+    // Health and the like without a deadband of their own, any change.
+    auto on_change = make_deadband_filter<bool>(0.0);
+    EXPECT_TRUE(on_change(false));
+    EXPECT_FALSE(on_change(false));
+    EXPECT_TRUE(on_change(true));
+}
@@ -4,8 +4,6 @@
 
 namespace dronecore {
 
-// TODO: this needs to be unit tested.
-
 Telemetry::EulerAngle to_euler_angle_from_quaternion(Telemetry::Quaternion quaternion)
 {
     auto &q = quaternion;
@@ -23,12 +21,16 @@ Telemetry::EulerAngle to_euler_angle_from_quaternion(Telemetry::Quaternion quate
 
 Telemetry::Quaternion to_quaternion_from_euler_angle(Telemetry::EulerAngle euler_angle)
 {
-    const double cos_phi_2 = cos(double(euler_angle.roll_deg) / 2.0);
-    const double sin_phi_2 = sin(double(euler_angle.roll_deg) / 2.0);
-    const double cos_theta_2 = cos(double(euler_angle.pitch_deg) / 2.0);
-    const double sin_theta_2 = sin(double(euler_angle.pitch_deg) / 2.0);
-    const double cos_psi_2 = cos(double(euler_angle.yaw_deg) / 2.0);
-    const double sin_psi_2 = sin(double(euler_angle.yaw_deg) / 2.0);
+    const double phi = to_rad_from_deg(double(euler_angle.roll_deg));
+    const double theta = to_rad_from_deg(double(euler_angle.pitch_deg));
+    const double psi = to_rad_from_deg(double(euler_angle.yaw_deg));
+
+    const double cos_phi_2 = cos(phi / 2.0);
+    const double sin_phi_2 = sin(phi / 2.0);
+    const double cos_theta_2 = cos(theta / 2.0);
+    const double sin_theta_2 = sin(theta / 2.0);
+    const double cos_psi_2 = cos(psi / 2.0);
+    const double sin_psi_2 = sin(psi / 2.0);
 
     // Need to disable astyle for this block.
     // *INDENT-OFF*
@@ -43,5 +45,87 @@ Telemetry::Quaternion to_quaternion_from_euler_angle(Telemetry::EulerAngle euler
     return quaternion;
 }
 
+void to_euler_angles_from_quaternions(const float *w, const float *x, const float *y,
+                                      const float *z, size_t count,
+                                      float *roll_deg, float *pitch_deg, float *yaw_deg)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const float qw = w[i];
+        const float qx = x[i];
+        const float qy = y[i];
+        const float qz = z[i];
+
+        // Same as to_deg_from_rad() but inline, so the loop stays vectorizable.
+        roll_deg[i] = atan2f(2.0f * (qw * qx + qy * qz), 1.0f - 2.0f * (qx * qx + qy * qy))
+                      / M_PI_F * 180.0f;
+        pitch_deg[i] = asinf(2.0f * (qw * qy - qz * qx)) / M_PI_F * 180.0f;
+        yaw_deg[i] = atan2f(2.0f * (qw * qz + qx * qy), 1.0f - 2.0f * (qy * qy + qz * qz))
+                     / M_PI_F * 180.0f;
+    }
+}
+
+void to_quaternions_from_euler_angles(const float *roll_deg, const float *pitch_deg,
+                                      const float *yaw_deg, size_t count,
+                                      float *w, float *x, float *y, float *z)
+{
+    for (size_t i = 0; i < count; ++i) {
+        const double phi = to_rad_from_deg(double(roll_deg[i]));
+        const double theta = to_rad_from_deg(double(pitch_deg[i]));
+        const double psi = to_rad_from_deg(double(yaw_deg[i]));
+
+        const double cos_phi_2 = cos(phi / 2.0);
+        const double sin_phi_2 = sin(phi / 2.0);
+        const double cos_theta_2 = cos(theta / 2.0);
+        const double sin_theta_2 = sin(theta / 2.0);
+        const double cos_psi_2 = cos(psi / 2.0);
+        const double sin_psi_2 = sin(psi / 2.0);
+
+        // *INDENT-OFF*
+        w[i] = float(cos_phi_2 * cos_theta_2 * cos_psi_2 + sin_phi_2 * sin_theta_2 * sin_psi_2);
+        x[i] = float(sin_phi_2 * cos_theta_2 * cos_psi_2 - cos_phi_2 * sin_theta_2 * sin_psi_2);
+        y[i] = float(cos_phi_2 * sin_theta_2 * cos_psi_2 + sin_phi_2 * cos_theta_2 * sin_psi_2);
+        z[i] = float(cos_phi_2 * cos_theta_2 * sin_psi_2 - sin_phi_2 * sin_theta_2 * cos_psi_2);
+        // *INDENT-ON*
+    }
+}
+
+Telemetry::Quaternion interpolate_quaternion(Telemetry::Quaternion a, Telemetry::Quaternion b,
+                                             double t)
+{
+    double dot = double(a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z);
+
+    // q and -q are the same rotation, take the shorter way.
+    double sign_b = 1.0;
+    if (dot < 0.0) {
+        dot = -dot;
+        sign_b = -1.0;
+    }
+
+    double weight_a = 1.0 - t;
+    double weight_b = t;
+    // Close to each other linear interpolation is good enough and stable.
+    if (dot < 0.9995) {
+        const double theta = acos(dot);
+        const double sin_theta = sin(theta);
+        weight_a = sin((1.0 - t) * theta) / sin_theta;
+        weight_b = sin(t * theta) / sin_theta;
+    }
+    weight_b *= sign_b;
+
+    double w = weight_a * double(a.w) + weight_b * double(b.w);
+    double x = weight_a * double(a.x) + weight_b * double(b.x);
+    double y = weight_a * double(a.y) + weight_b * double(b.y);
+    double z = weight_a * double(a.z) + weight_b * double(b.z);
+
+    const double norm = sqrt(w * w + x * x + y * y + z * z);
+    if (norm > 0.0) {
+        w /= norm;
+        x /= norm;
+        y /= norm;
+        z /= norm;
+    }
+
+    return Telemetry::Quaternion {float(w), float(x), float(y), float(z)};
+}
 
 } // namespace dronecore
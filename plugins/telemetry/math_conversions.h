@@ -1,10 +1,26 @@
 #pragma once
 
 #include "telemetry.h"
+#include <cstddef>
 
 namespace dronecore {
 
 Telemetry::EulerAngle to_euler_angle_from_quaternion(Telemetry::Quaternion quaternion);
 Telemetry::Quaternion to_quaternion_from_euler_angle(Telemetry::EulerAngle euler_angle);
 
+// Spherical linear interpolation, t from 0 (a) to 1 (b).
+Telemetry::Quaternion interpolate_quaternion(Telemetry::Quaternion a, Telemetry::Quaternion b,
+                                             double t);
+
+// Batch versions of the conversions above for samples stored field by field
+// (struct of arrays), e.g. as copied out of a TelemetryHistory. The results
+// are the same as for the single conversions. The loops don't branch per
+// sample, so the compiler can vectorize them.
+void to_euler_angles_from_quaternions(const float *w, const float *x, const float *y,
+                                      const float *z, size_t count,
+                                      float *roll_deg, float *pitch_deg, float *yaw_deg);
+void to_quaternions_from_euler_angles(const float *roll_deg, const float *pitch_deg,
+                                      const float *yaw_deg, size_t count,
+                                      float *w, float *x, float *y, float *z);
+
 } // namespace dronecore
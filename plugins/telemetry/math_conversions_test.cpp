@@ -0,0 +1,87 @@
+#include "math_conversions.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(MathConversions, BatchMatchesSingle)
+{
+    const Telemetry::EulerAngle euler_angles[] = {
+        {0.0f, 0.0f, 0.0f},
+        {10.0f, -20.0f, 30.0f},
+        {-170.0f, 45.0f, 179.0f},
+        {90.0f, 89.0f, -90.0f},
+        {1.0f, 2.0f, 3.0f}
+    };
+    const size_t count = sizeof(euler_angles) / sizeof(euler_angles[0]);
+
+    float roll_deg[count], pitch_deg[count], yaw_deg[count];
+    for (size_t i = 0; i < count; ++i) {
+        roll_deg[i] = euler_angles[i].roll_deg;
+        pitch_deg[i] = euler_angles[i].pitch_deg;
+        yaw_deg[i] = euler_angles[i].yaw_deg;
+    }
+
+    float w[count], x[count], y[count], z[count];
+    to_quaternions_from_euler_angles(roll_deg, pitch_deg, yaw_deg, count, w, x, y, z);
+
+    float roll_back_deg[count], pitch_back_deg[count], yaw_back_deg[count];
+    to_euler_angles_from_quaternions(w, x, y, z, count,
+                                     roll_back_deg, pitch_back_deg, yaw_back_deg);
+
+    for (size_t i = 0; i < count; ++i) {
+        const Telemetry::Quaternion quaternion = to_quaternion_from_euler_angle(euler_angles[i]);
+        EXPECT_EQ(w[i], quaternion.w);
+        EXPECT_EQ(x[i], quaternion.x);
+        EXPECT_EQ(y[i], quaternion.y);
+        EXPECT_EQ(z[i], quaternion.z);
+
+        const Telemetry::EulerAngle euler_angle = to_euler_angle_from_quaternion(quaternion);
+        EXPECT_FLOAT_EQ(roll_back_deg[i], euler_angle.roll_deg);
+        EXPECT_FLOAT_EQ(pitch_back_deg[i], euler_angle.pitch_deg);
+        EXPECT_FLOAT_EQ(yaw_back_deg[i], euler_angle.yaw_deg);
+    }
+}
+
+TEST(MathConversions, QuaternionFromEulerAngle)
+{
+    // Rotations by 90 degrees about each axis and none at all.
+    const float half_sqrt_2 = 0.70710678f;
+    struct {
+        Telemetry::EulerAngle euler_angle;
+        Telemetry::Quaternion quaternion;
+    } const known[] = {
+        {{0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f, 0.0f}},
+        {{90.0f, 0.0f, 0.0f}, {half_sqrt_2, half_sqrt_2, 0.0f, 0.0f}},
+        {{0.0f, 90.0f, 0.0f}, {half_sqrt_2, 0.0f, half_sqrt_2, 0.0f}},
+        {{0.0f, 0.0f, 90.0f}, {half_sqrt_2, 0.0f, 0.0f, half_sqrt_2}},
+        {{0.0f, 0.0f, -90.0f}, {half_sqrt_2, 0.0f, 0.0f, -half_sqrt_2}}
+    };
+
+    for (const auto &rotation : known) {
+        const Telemetry::Quaternion quaternion =
+            to_quaternion_from_euler_angle(rotation.euler_angle);
+        EXPECT_NEAR(quaternion.w, rotation.quaternion.w, 1e-6f);
+        EXPECT_NEAR(quaternion.x, rotation.quaternion.x, 1e-6f);
+        EXPECT_NEAR(quaternion.y, rotation.quaternion.y, 1e-6f);
+        EXPECT_NEAR(quaternion.z, rotation.quaternion.z, 1e-6f);
+    }
+}
+
+TEST(MathConversions, EulerAngleRoundTrip)
+{
+    // Away from +-90 degrees of pitch, where roll and yaw can't be told apart.
+    const Telemetry::EulerAngle euler_angles[] = {
+        {10.0f, -20.0f, 30.0f},
+        {-170.0f, 45.0f, 179.0f},
+        {120.0f, -80.0f, -45.0f},
+        {1.0f, 2.0f, 3.0f}
+    };
+
+    for (const auto &euler_angle : euler_angles) {
+        const Telemetry::EulerAngle back =
+            to_euler_angle_from_quaternion(to_quaternion_from_euler_angle(euler_angle));
+        EXPECT_NEAR(back.roll_deg, euler_angle.roll_deg, 1e-3f);
+        EXPECT_NEAR(back.pitch_deg, euler_angle.pitch_deg, 1e-3f);
+        EXPECT_NEAR(back.yaw_deg, euler_angle.yaw_deg, 1e-3f);
+    }
+}
@@ -0,0 +1,120 @@
+#include "message_rates.h"
+#include <algorithm>
+
+namespace dronecore {
+
+bool MessageRates::add_subscriber(uint64_t handle, uint32_t message_id,
+                                  double &combined_rate_hz)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _subscriber_message_ids[handle] = message_id;
+    Requests &requests = _requests[message_id];
+    requests.subscriber_rates_hz[handle] = 0.0;
+    return update_combined_rate(requests, combined_rate_hz);
+}
+
+bool MessageRates::get_message_id(uint64_t handle, uint32_t &message_id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _subscriber_message_ids.find(handle);
+    if (it == _subscriber_message_ids.end()) {
+        return false;
+    }
+    message_id = it->second;
+    return true;
+}
+
+bool MessageRates::set_manual_rate(uint32_t message_id, double rate_hz,
+                                   double &combined_rate_hz)
+{
+    if (!(rate_hz >= 0.0)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Requests &requests = _requests[message_id];
+    requests.manual_rate_hz = rate_hz;
+    return update_combined_rate(requests, combined_rate_hz);
+}
+
+bool MessageRates::set_subscriber_rate(uint64_t handle, double rate_hz,
+                                       double &combined_rate_hz)
+{
+    if (!(rate_hz >= 0.0)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _subscriber_message_ids.find(handle);
+    if (it == _subscriber_message_ids.end()) {
+        return false;
+    }
+
+    Requests &requests = _requests[it->second];
+    requests.subscriber_rates_hz[handle] = rate_hz;
+    return update_combined_rate(requests, combined_rate_hz);
+}
+
+bool MessageRates::remove_subscriber(uint64_t handle, uint32_t &message_id,
+                                     double &combined_rate_hz)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _subscriber_message_ids.find(handle);
+    if (it == _subscriber_message_ids.end()) {
+        return false;
+    }
+    message_id = it->second;
+    _subscriber_message_ids.erase(it);
+
+    auto requests = _requests.find(message_id);
+    if (requests == _requests.end()) {
+        return false;
+    }
+    requests->second.subscriber_rates_hz.erase(handle);
+    return update_combined_rate(requests->second, combined_rate_hz);
+}
+
+double MessageRates::get_rate(uint32_t message_id) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _requests.find(message_id);
+    if (it == _requests.end()) {
+        return 0.0;
+    }
+    return it->second.combined_rate_hz;
+}
+
+std::vector<std::pair<uint32_t, double>> MessageRates::get_rates() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::vector<std::pair<uint32_t, double>> rates {};
+    for (const auto &request : _requests) {
+        if (request.second.combined_rate_hz != 0.0) {
+            rates.push_back(std::make_pair(request.first, request.second.combined_rate_hz));
+        }
+    }
+    return rates;
+}
+
+bool MessageRates::update_combined_rate(Requests &requests, double &combined_rate_hz)
+{
+    double rate_hz = requests.manual_rate_hz;
+    for (const auto &subscriber_rate : requests.subscriber_rates_hz) {
+        rate_hz = std::max(rate_hz, subscriber_rate.second);
+    }
+    if (rate_hz == requests.combined_rate_hz) {
+        return false;
+    }
+    requests.combined_rate_hz = rate_hz;
+    combined_rate_hz = rate_hz;
+    return true;
+}
+
+} // namespace dronecore
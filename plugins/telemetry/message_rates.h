@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace dronecore {
+
+// Works out the rate to request for each message from what is asked for:
+// the rate set with set_rate_...() and the rates of all its subscribers. The
+// highest one wins. Once nobody asks for a rate anymore, the message goes
+// back to its default rate (0). It is never stopped: plugins and the core
+// use many of these messages internally, without subscribing to them.
+//
+// Messages nobody ever subscribed to or asked a rate for are not tracked,
+// they stay at whatever the autopilot sends by default.
+class MessageRates
+{
+public:
+    // Each of these returns true if the combined rate of the message changed,
+    // which is then written to combined_rate_hz. A rate of 0 asks for nothing
+    // in particular, negative rates are ignored and return false.
+    //
+    // Subscribers need to be added before they can ask for a rate.
+    bool add_subscriber(uint64_t handle, uint32_t message_id, double &combined_rate_hz);
+    bool set_manual_rate(uint32_t message_id, double rate_hz, double &combined_rate_hz);
+    bool set_subscriber_rate(uint64_t handle, double rate_hz, double &combined_rate_hz);
+    // Drops the subscriber and the rate it asked for, if any.
+    bool remove_subscriber(uint64_t handle, uint32_t &message_id, double &combined_rate_hz);
+
+    // Returns false if the subscriber was not added.
+    bool get_message_id(uint64_t handle, uint32_t &message_id) const;
+
+    // 0 for the default rate.
+    double get_rate(uint32_t message_id) const;
+    // All messages not at their default rate, to set them again e.g. on connect.
+    std::vector<std::pair<uint32_t, double>> get_rates() const;
+
+private:
+    struct Requests {
+        double manual_rate_hz {0.0};
+        // Every subscriber, those that didn't ask for a rate at 0.
+        std::map<uint64_t, double> subscriber_rates_hz {};
+        // Until told otherwise, the autopilot sends at the default rate.
+        double combined_rate_hz {0.0};
+    };
+
+    // Need to be called with _mutex locked.
+    static bool update_combined_rate(Requests &requests, double &combined_rate_hz);
+
+    mutable std::mutex _mutex {};
+    std::map<uint32_t, Requests> _requests {};
+    std::map<uint64_t, uint32_t> _subscriber_message_ids {};
+};
+
+} // namespace dronecore
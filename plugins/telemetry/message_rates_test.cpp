@@ -0,0 +1,143 @@
+#include "message_rates.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+using namespace dronecore;
+
+TEST(MessageRates, HighestWins)
+{
+    MessageRates rates;
+    double rate_hz = -1.0;
+
+    // Not added yet.
+    EXPECT_FALSE(rates.set_subscriber_rate(1, 10.0, rate_hz));
+
+    // Still at the default rate.
+    EXPECT_FALSE(rates.add_subscriber(1, 33, rate_hz));
+    EXPECT_FALSE(rates.add_subscriber(2, 33, rate_hz));
+    EXPECT_TRUE(rates.set_subscriber_rate(1, 10.0, rate_hz));
+    EXPECT_EQ(rate_hz, 10.0);
+
+    // Lower than what is already requested, nothing to send.
+    EXPECT_FALSE(rates.set_subscriber_rate(2, 5.0, rate_hz));
+    EXPECT_FALSE(rates.set_manual_rate(33, 1.0, rate_hz));
+
+    EXPECT_TRUE(rates.set_manual_rate(33, 50.0, rate_hz));
+    EXPECT_EQ(rate_hz, 50.0);
+    EXPECT_TRUE(rates.set_manual_rate(33, 0.0, rate_hz));
+    EXPECT_EQ(rate_hz, 10.0);
+
+    // Other messages are independent.
+    EXPECT_EQ(rates.get_rate(30), 0.0);
+}
+
+TEST(MessageRates, BackToDefaultWhenNobodyAsks)
+{
+    MessageRates rates;
+    double rate_hz = -1.0;
+    uint32_t message_id = 0;
+
+    rates.add_subscriber(1, 105, rate_hz);
+    rates.add_subscriber(2, 105, rate_hz);
+    rates.set_subscriber_rate(1, 100.0, rate_hz);
+    rates.set_subscriber_rate(2, 20.0, rate_hz);
+
+    uint32_t found_message_id = 0;
+    EXPECT_TRUE(rates.get_message_id(2, found_message_id));
+    EXPECT_EQ(found_message_id, 105u);
+
+    EXPECT_TRUE(rates.remove_subscriber(1, message_id, rate_hz));
+    EXPECT_EQ(message_id, 105u);
+    EXPECT_EQ(rate_hz, 20.0);
+
+    // Never added.
+    EXPECT_FALSE(rates.remove_subscriber(3, message_id, rate_hz));
+
+    // Not stopped, the SDK itself might still need it.
+    EXPECT_TRUE(rates.remove_subscriber(2, message_id, rate_hz));
+    EXPECT_EQ(rate_hz, 0.0);
+    EXPECT_EQ(rates.get_rate(105), 0.0);
+
+    // Nothing to send for a new subscriber.
+    EXPECT_FALSE(rates.add_subscriber(4, 105, rate_hz));
+}
+
+TEST(MessageRates, DefaultRateWithoutAnyAsking)
+{
+    MessageRates rates;
+    double rate_hz = -1.0;
+    uint32_t message_id = 0;
+
+    rates.add_subscriber(1, 30, rate_hz);
+    rates.add_subscriber(2, 30, rate_hz);
+    EXPECT_TRUE(rates.set_subscriber_rate(1, 50.0, rate_hz));
+
+    // The other subscriber still gets the message, at its default rate.
+    EXPECT_TRUE(rates.remove_subscriber(1, message_id, rate_hz));
+    EXPECT_EQ(rate_hz, 0.0);
+
+    // Or at the rate it asks for, and once it doesn't anymore back at the default.
+    EXPECT_TRUE(rates.set_subscriber_rate(2, 5.0, rate_hz));
+    EXPECT_EQ(rate_hz, 5.0);
+    EXPECT_TRUE(rates.set_subscriber_rate(2, 0.0, rate_hz));
+    EXPECT_EQ(rate_hz, 0.0);
+
+    // The last one leaving without asking for a rate changes nothing, so
+    // nothing is sent, and certainly no -1.
+    rate_hz = 123.0;
+    EXPECT_FALSE(rates.remove_subscriber(2, message_id, rate_hz));
+    EXPECT_EQ(rate_hz, 123.0);
+    EXPECT_EQ(rates.get_rate(30), 0.0);
+}
+
+TEST(MessageRates, IgnoresNegativeRates)
+{
+    MessageRates rates;
+    double rate_hz = -1.0;
+
+    rates.add_subscriber(1, 33, rate_hz);
+    rates.set_subscriber_rate(1, 10.0, rate_hz);
+
+    EXPECT_FALSE(rates.set_subscriber_rate(1, -5.0, rate_hz));
+    EXPECT_FALSE(rates.set_subscriber_rate(1, NAN, rate_hz));
+    EXPECT_FALSE(rates.set_manual_rate(33, -5.0, rate_hz));
+    EXPECT_EQ(rates.get_rate(33), 10.0);
+}
+
+TEST(MessageRates, ListsRequestedRates)
+{
+    MessageRates rates;
+    double rate_hz = -1.0;
+
+    rates.set_manual_rate(33, 10.0, rate_hz);
+    rates.add_subscriber(1, 105, rate_hz);
+    rates.set_subscriber_rate(1, 50.0, rate_hz);
+    // Back at the default rate, nothing to set again.
+    rates.set_manual_rate(30, 5.0, rate_hz);
+    rates.set_manual_rate(30, 0.0, rate_hz);
+    rates.add_subscriber(2, 32, rate_hz);
+
+    const auto requested = rates.get_rates();
+    ASSERT_EQ(requested.size(), 2u);
+    EXPECT_EQ(requested[0].first, 33u);
+    EXPECT_EQ(requested[0].second, 10.0);
+    EXPECT_EQ(requested[1].first, 105u);
+    EXPECT_EQ(requested[1].second, 50.0);
+}
+
+TEST(MessageRates, LastSubscriberWithRateLeaving)
+{
+    MessageRates rates;
+    double rate_hz = -1.0;
+    uint32_t message_id = 0;
+
+    rates.add_subscriber(1, 24, rate_hz);
+    rates.set_subscriber_rate(1, 20.0, rate_hz);
+
+    // E.g. actions and the fleet state still need it, so it goes back to the
+    // default rate instead of being stopped.
+    EXPECT_TRUE(rates.remove_subscriber(1, message_id, rate_hz));
+    EXPECT_EQ(message_id, 24u);
+    EXPECT_EQ(rate_hz, 0.0);
+    EXPECT_TRUE(rates.get_rates().empty());
+}
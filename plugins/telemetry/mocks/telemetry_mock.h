@@ -24,6 +24,7 @@ public:
                        void(Telemetry::attitude_euler_angle_callback_t));
     MOCK_CONST_METHOD1(ground_speed_ned_async, void(Telemetry::ground_speed_ned_callback_t));
     MOCK_CONST_METHOD1(rc_status_async, void(Telemetry::rc_status_callback_t));
+    MOCK_CONST_METHOD0(snapshot, Telemetry::Snapshot());
 };
 
 } // namespace testing
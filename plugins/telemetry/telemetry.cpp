@@ -61,6 +61,31 @@ Telemetry::Result Telemetry::set_rate_rc_status(double rate_hz)
     return _impl->set_rate_rc_status(rate_hz);
 }
 
+Telemetry::Result Telemetry::set_rate_position_velocity_ned(double rate_hz)
+{
+    return _impl->set_rate_position_velocity_ned(rate_hz);
+}
+
+Telemetry::Result Telemetry::set_rate_attitude_angular_velocity_body(double rate_hz)
+{
+    return _impl->set_rate_attitude_angular_velocity_body(rate_hz);
+}
+
+Telemetry::Result Telemetry::set_rate_imu(double rate_hz)
+{
+    return _impl->set_rate_imu(rate_hz);
+}
+
+Telemetry::Result Telemetry::set_rate_odometry(double rate_hz)
+{
+    return _impl->set_rate_odometry(rate_hz);
+}
+
+Telemetry::Result Telemetry::set_rate_actuator_control_target(double rate_hz)
+{
+    return _impl->set_rate_actuator_control_target(rate_hz);
+}
+
 void Telemetry::set_rate_position_async(double rate_hz, result_callback_t callback)
 {
     _impl->set_rate_position_async(rate_hz, callback);
@@ -105,6 +130,31 @@ void Telemetry::set_rate_rc_status_async(double rate_hz, result_callback_t callb
     _impl->set_rate_rc_status_async(rate_hz, callback);
 }
 
+void Telemetry::set_rate_position_velocity_ned_async(double rate_hz, result_callback_t callback)
+{
+    _impl->set_rate_position_velocity_ned_async(rate_hz, callback);
+}
+
+void Telemetry::set_rate_attitude_angular_velocity_body_async(double rate_hz, result_callback_t callback)
+{
+    _impl->set_rate_attitude_angular_velocity_body_async(rate_hz, callback);
+}
+
+void Telemetry::set_rate_imu_async(double rate_hz, result_callback_t callback)
+{
+    _impl->set_rate_imu_async(rate_hz, callback);
+}
+
+void Telemetry::set_rate_odometry_async(double rate_hz, result_callback_t callback)
+{
+    _impl->set_rate_odometry_async(rate_hz, callback);
+}
+
+void Telemetry::set_rate_actuator_control_target_async(double rate_hz, result_callback_t callback)
+{
+    _impl->set_rate_actuator_control_target_async(rate_hz, callback);
+}
+
 Telemetry::Position Telemetry::position() const
 {
     return _impl->get_position();
@@ -180,66 +230,204 @@ Telemetry::RCStatus Telemetry::rc_status() const
     return _impl->get_rc_status();
 }
 
+Telemetry::Snapshot Telemetry::snapshot() const
+{
+    return _impl->get_snapshot();
+}
+
+void Telemetry::set_history_capacity(size_t num_samples)
+{
+    _impl->set_history_capacity(num_samples);
+}
+
+void Telemetry::position_history(uint64_t since_us, std::vector<PositionSample> &samples) const
+{
+    _impl->get_position_history(since_us, samples);
+}
+
+void Telemetry::attitude_quaternion_history(uint64_t since_us,
+                                            std::vector<QuaternionSample> &samples) const
+{
+    _impl->get_attitude_quaternion_history(since_us, samples);
+}
+
+void Telemetry::attitude_euler_angle_history(uint64_t since_us,
+                                             std::vector<EulerAngleSample> &samples) const
+{
+    _impl->get_attitude_euler_angle_history(since_us, samples);
+}
+
+void Telemetry::position_history_columns(uint64_t since_us, PositionColumns &columns) const
+{
+    _impl->get_position_history_columns(since_us, columns);
+}
+
+void Telemetry::attitude_quaternion_history_columns(uint64_t since_us,
+                                                    QuaternionColumns &columns) const
+{
+    _impl->get_attitude_quaternion_history_columns(since_us, columns);
+}
+
+bool Telemetry::position_at(uint64_t time_us, Position &position) const
+{
+    return _impl->get_position_at(time_us, position);
+}
+
+bool Telemetry::attitude_quaternion_at(uint64_t time_us, Quaternion &quaternion) const
+{
+    return _impl->get_attitude_quaternion_at(time_us, quaternion);
+}
+
+double Telemetry::latency_s() const
+{
+    return _impl->get_latency_s();
+}
+
+Telemetry::PositionVelocityNED Telemetry::position_velocity_ned() const
+{
+    return _impl->get_position_velocity_ned();
+}
+
+Telemetry::AngularVelocityBody Telemetry::attitude_angular_velocity_body() const
+{
+    return _impl->get_attitude_angular_velocity_body();
+}
+
+Telemetry::IMU Telemetry::imu() const
+{
+    return _impl->get_imu();
+}
+
+Telemetry::Odometry Telemetry::odometry() const
+{
+    return _impl->get_odometry();
+}
+
+Telemetry::ActuatorControlTarget Telemetry::actuator_control_target() const
+{
+    return _impl->get_actuator_control_target();
+}
+
 void Telemetry::position_async(position_callback_t callback)
 {
     return _impl->position_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_position(position_callback_t callback)
+{
+    return _impl->subscribe_position(callback);
+}
+
 void Telemetry::home_position_async(position_callback_t callback)
 {
     return _impl->home_position_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_home_position(position_callback_t callback)
+{
+    return _impl->subscribe_home_position(callback);
+}
+
 void Telemetry::in_air_async(in_air_callback_t callback)
 {
     return _impl->in_air_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_in_air(in_air_callback_t callback)
+{
+    return _impl->subscribe_in_air(callback);
+}
+
 void Telemetry::armed_async(armed_callback_t callback)
 {
     return _impl->armed_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_armed(armed_callback_t callback)
+{
+    return _impl->subscribe_armed(callback);
+}
+
 void Telemetry::attitude_quaternion_async(attitude_quaternion_callback_t callback)
 {
     return _impl->attitude_quaternion_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_attitude_quaternion(attitude_quaternion_callback_t callback)
+{
+    return _impl->subscribe_attitude_quaternion(callback);
+}
+
 void Telemetry::attitude_euler_angle_async(attitude_euler_angle_callback_t callback)
 {
     return _impl->attitude_euler_angle_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_attitude_euler_angle(attitude_euler_angle_callback_t callback)
+{
+    return _impl->subscribe_attitude_euler_angle(callback);
+}
+
 void Telemetry::camera_attitude_quaternion_async(attitude_quaternion_callback_t callback)
 {
     return _impl->camera_attitude_quaternion_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_camera_attitude_quaternion(attitude_quaternion_callback_t callback)
+{
+    return _impl->subscribe_camera_attitude_quaternion(callback);
+}
+
 void Telemetry::camera_attitude_euler_angle_async(attitude_euler_angle_callback_t callback)
 {
     return _impl->camera_attitude_euler_angle_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_camera_attitude_euler_angle(attitude_euler_angle_callback_t callback)
+{
+    return _impl->subscribe_camera_attitude_euler_angle(callback);
+}
+
 void Telemetry::ground_speed_ned_async(ground_speed_ned_callback_t callback)
 {
     return _impl->ground_speed_ned_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_ground_speed_ned(ground_speed_ned_callback_t callback)
+{
+    return _impl->subscribe_ground_speed_ned(callback);
+}
+
 void Telemetry::gps_info_async(gps_info_callback_t callback)
 {
     return _impl->gps_info_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_gps_info(gps_info_callback_t callback)
+{
+    return _impl->subscribe_gps_info(callback);
+}
+
 void Telemetry::battery_async(battery_callback_t callback)
 {
     return _impl->battery_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_battery(battery_callback_t callback)
+{
+    return _impl->subscribe_battery(callback);
+}
+
 void Telemetry::flight_mode_async(flight_mode_callback_t callback)
 {
     return _impl->flight_mode_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_flight_mode(flight_mode_callback_t callback)
+{
+    return _impl->subscribe_flight_mode(callback);
+}
+
 std::string Telemetry::flight_mode_str(FlightMode flight_mode)
 {
     switch (flight_mode) {
@@ -271,16 +459,107 @@ void Telemetry::health_async(health_callback_t callback)
     return _impl->health_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_health(health_callback_t callback)
+{
+    return _impl->subscribe_health(callback);
+}
+
 void Telemetry::health_all_ok_async(health_all_ok_callback_t callback)
 {
     return _impl->health_all_ok_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_health_all_ok(health_all_ok_callback_t callback)
+{
+    return _impl->subscribe_health_all_ok(callback);
+}
+
 void Telemetry::rc_status_async(rc_status_callback_t callback)
 {
     return _impl->rc_status_async(callback);
 }
 
+Telemetry::subscription_handle_t Telemetry::subscribe_rc_status(rc_status_callback_t callback)
+{
+    return _impl->subscribe_rc_status(callback);
+}
+
+void Telemetry::position_velocity_ned_async(position_velocity_ned_callback_t callback)
+{
+    return _impl->position_velocity_ned_async(callback);
+}
+
+Telemetry::subscription_handle_t Telemetry::subscribe_position_velocity_ned(position_velocity_ned_callback_t callback)
+{
+    return _impl->subscribe_position_velocity_ned(callback);
+}
+
+void Telemetry::attitude_angular_velocity_body_async(attitude_angular_velocity_body_callback_t callback)
+{
+    return _impl->attitude_angular_velocity_body_async(callback);
+}
+
+Telemetry::subscription_handle_t Telemetry::subscribe_attitude_angular_velocity_body(attitude_angular_velocity_body_callback_t callback)
+{
+    return _impl->subscribe_attitude_angular_velocity_body(callback);
+}
+
+void Telemetry::imu_async(imu_callback_t callback)
+{
+    return _impl->imu_async(callback);
+}
+
+Telemetry::subscription_handle_t Telemetry::subscribe_imu(imu_callback_t callback)
+{
+    return _impl->subscribe_imu(callback);
+}
+
+void Telemetry::odometry_async(odometry_callback_t callback)
+{
+    return _impl->odometry_async(callback);
+}
+
+Telemetry::subscription_handle_t Telemetry::subscribe_odometry(odometry_callback_t callback)
+{
+    return _impl->subscribe_odometry(callback);
+}
+
+void Telemetry::actuator_control_target_async(actuator_control_target_callback_t callback)
+{
+    return _impl->actuator_control_target_async(callback);
+}
+
+Telemetry::subscription_handle_t Telemetry::subscribe_actuator_control_target(actuator_control_target_callback_t callback)
+{
+    return _impl->subscribe_actuator_control_target(callback);
+}
+
+void Telemetry::set_conflate_subscriptions(bool enable)
+{
+    _impl->set_conflate_subscriptions(enable);
+}
+
+bool Telemetry::set_subscription_deadband(subscription_handle_t handle, double deadband)
+{
+    return _impl->set_subscription_deadband(handle, deadband);
+}
+
+bool Telemetry::unsubscribe(subscription_handle_t handle)
+{
+    return _impl->unsubscribe(handle);
+}
+
+Telemetry::Result Telemetry::set_subscription_rate(subscription_handle_t handle, double rate_hz)
+{
+    return _impl->set_subscription_rate(handle, rate_hz);
+}
+
+void Telemetry::set_subscription_rate_async(subscription_handle_t handle, double rate_hz,
+                                            result_callback_t callback)
+{
+    _impl->set_subscription_rate_async(handle, rate_hz, callback);
+}
+
 const char *Telemetry::result_str(Result result)
 {
     switch (result) {
@@ -420,4 +699,42 @@ std::ostream &operator<<(std::ostream &str, Telemetry::RCStatus const &rc_status
            << ", signal_strength_percent: " << rc_status.signal_strength_percent << "]";
 }
 
+bool operator==(const Telemetry::PositionVelocityNED &lhs,
+                const Telemetry::PositionVelocityNED &rhs)
+{
+    return lhs.north_m == rhs.north_m
+           && lhs.east_m == rhs.east_m
+           && lhs.down_m == rhs.down_m
+           && lhs.velocity_north_m_s == rhs.velocity_north_m_s
+           && lhs.velocity_east_m_s == rhs.velocity_east_m_s
+           && lhs.velocity_down_m_s == rhs.velocity_down_m_s;
+}
+
+std::ostream &operator<<(std::ostream &str,
+                         Telemetry::PositionVelocityNED const &position_velocity_ned)
+{
+    return str << "[north_m: " << position_velocity_ned.north_m
+           << ", east_m: " << position_velocity_ned.east_m
+           << ", down_m: " << position_velocity_ned.down_m
+           << ", velocity_north_m_s: " << position_velocity_ned.velocity_north_m_s
+           << ", velocity_east_m_s: " << position_velocity_ned.velocity_east_m_s
+           << ", velocity_down_m_s: " << position_velocity_ned.velocity_down_m_s << "]";
+}
+
+bool operator==(const Telemetry::AngularVelocityBody &lhs,
+                const Telemetry::AngularVelocityBody &rhs)
+{
+    return lhs.roll_rad_s == rhs.roll_rad_s
+           && lhs.pitch_rad_s == rhs.pitch_rad_s
+           && lhs.yaw_rad_s == rhs.yaw_rad_s;
+}
+
+std::ostream &operator<<(std::ostream &str,
+                         Telemetry::AngularVelocityBody const &angular_velocity_body)
+{
+    return str << "[roll_rad_s: " << angular_velocity_body.roll_rad_s
+           << ", pitch_rad_s: " << angular_velocity_body.pitch_rad_s
+           << ", yaw_rad_s: " << angular_velocity_body.yaw_rad_s << "]";
+}
+
 } // namespace dronecore
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <vector>
 #include "plugin_base.h"
 
 namespace dronecore {
@@ -150,6 +152,158 @@ public:
         float signal_strength_percent; /**< @brief Signal strength as a percentage (range: 0 to 100). */
     };
 
+    /**
+     * @brief Local position and velocity type, relative to the local origin in NED frame.
+     */
+    struct PositionVelocityNED {
+        float north_m; /**< @brief Position in North direction in metres. */
+        float east_m; /**< @brief Position in East direction in metres. */
+        float down_m; /**< @brief Position in Down direction in metres. */
+        float velocity_north_m_s; /**< @brief Velocity in North direction in metres/second. */
+        float velocity_east_m_s; /**< @brief Velocity in East direction in metres/second. */
+        float velocity_down_m_s; /**< @brief Velocity in Down direction in metres/second. */
+    };
+
+    /**
+     * @brief Angular velocity type, in body frame (forward, right, down).
+     */
+    struct AngularVelocityBody {
+        float roll_rad_s; /**< @brief Roll rate in radians/second. */
+        float pitch_rad_s; /**< @brief Pitch rate in radians/second. */
+        float yaw_rad_s; /**< @brief Yaw rate in radians/second. */
+    };
+
+    /**
+     * @brief IMU measurement type, in body frame (forward, right, down).
+     */
+    struct IMU {
+        uint64_t timestamp_us; /**< @brief Time of the measurement on the vehicle in microseconds. */
+        float acceleration_forward_m_s2; /**< @brief Acceleration forward in metres/second^2. */
+        float acceleration_right_m_s2; /**< @brief Acceleration to the right in metres/second^2. */
+        float acceleration_down_m_s2; /**< @brief Acceleration downwards in metres/second^2. */
+        float angular_velocity_forward_rad_s; /**< @brief Angular velocity about the forward axis. */
+        float angular_velocity_right_rad_s; /**< @brief Angular velocity about the right axis. */
+        float angular_velocity_down_rad_s; /**< @brief Angular velocity about the down axis. */
+        float magnetic_field_forward_gauss; /**< @brief Magnetic field forward in Gauss. */
+        float magnetic_field_right_gauss; /**< @brief Magnetic field to the right in Gauss. */
+        float magnetic_field_down_gauss; /**< @brief Magnetic field downwards in Gauss. */
+        float absolute_pressure_hpa; /**< @brief Absolute pressure in hectopascal. */
+        float temperature_degc; /**< @brief Temperature in degrees Celsius. */
+    };
+
+    /**
+     * @brief Odometry type, as estimated by the vehicle or an external system.
+     */
+    struct Odometry {
+        uint64_t timestamp_us; /**< @brief Time of the estimate on the vehicle in microseconds. */
+        uint8_t frame_id; /**< @brief Frame of the position (MAV_FRAME). */
+        uint8_t child_frame_id; /**< @brief Frame of the velocities (MAV_FRAME). */
+        float x_m; /**< @brief X position in metres. */
+        float y_m; /**< @brief Y position in metres. */
+        float z_m; /**< @brief Z position in metres. */
+        Quaternion q; /**< @brief Orientation. */
+        float velocity_x_m_s; /**< @brief X velocity in metres/second. */
+        float velocity_y_m_s; /**< @brief Y velocity in metres/second. */
+        float velocity_z_m_s; /**< @brief Z velocity in metres/second. */
+        AngularVelocityBody angular_velocity_body; /**< @brief Angular velocity. */
+    };
+
+    /**
+     * @brief Actuator control target type.
+     */
+    struct ActuatorControlTarget {
+        uint8_t group; /**< @brief Actuator group, 0 is the flight control group. */
+        float controls[8]; /**< @brief Normalized outputs (range: -1 to 1, throttle 0 to 1). */
+    };
+
+    /**
+     * @brief All telemetry state at one point in time.
+     *
+     * The values are consistent with each other, e.g. position and ground speed always
+     * come from the same MAVLink message. The `*_time_us` fields hold the time a value was
+     * received in microseconds of `std::chrono::steady_clock`, or 0 if nothing has been
+     * received yet.
+     */
+    struct Snapshot {
+        Position position; /**< @brief Position. */
+        uint64_t position_time_us; /**< @brief Receive time of position and ground speed. */
+        GroundSpeedNED ground_speed_ned; /**< @brief Ground speed in NED coordinates. */
+        Position home_position; /**< @brief Home position. */
+        uint64_t home_position_time_us; /**< @brief Receive time of the home position. */
+        bool in_air; /**< @brief true if in air. */
+        uint64_t in_air_time_us; /**< @brief Receive time of the in-air state. */
+        bool armed; /**< @brief true if armed. */
+        FlightMode flight_mode; /**< @brief Flight mode. */
+        uint64_t heartbeat_time_us; /**< @brief Receive time of armed state and flight mode. */
+        Quaternion attitude_quaternion; /**< @brief Attitude of the vehicle. */
+        uint64_t attitude_time_us; /**< @brief Receive time of the attitude. */
+        EulerAngle camera_attitude_euler_angle; /**< @brief Attitude of the camera. */
+        uint64_t camera_attitude_time_us; /**< @brief Receive time of the camera attitude. */
+        GPSInfo gps_info; /**< @brief GPS information. */
+        uint64_t gps_info_time_us; /**< @brief Receive time of the GPS information. */
+        Battery battery; /**< @brief Battery status. */
+        uint64_t battery_time_us; /**< @brief Receive time of the battery status. */
+        Health health; /**< @brief Health flags. */
+        RCStatus rc_status; /**< @brief RC status. */
+        uint64_t rc_status_time_us; /**< @brief Receive time of the RC status. */
+    };
+
+    /**
+     * @brief Position with its time, as kept in the history.
+     *
+     * Once the clocks are synchronized using TIMESYNC, the time is when the vehicle
+     * measured it, converted to `std::chrono::steady_clock`. Before, it is the receive time.
+     */
+    struct PositionSample {
+        uint64_t time_us; /**< @brief Time in microseconds of `std::chrono::steady_clock`. */
+        Position position; /**< @brief Position. */
+    };
+
+    /**
+     * @brief Attitude with its time, as kept in the history.
+     *
+     * The time is as for PositionSample.
+     */
+    struct QuaternionSample {
+        uint64_t time_us; /**< @brief Time in microseconds of `std::chrono::steady_clock`. */
+        Quaternion quaternion; /**< @brief Attitude as quaternion. */
+    };
+
+    /**
+     * @brief Attitude in Euler angles with its time, converted from the history.
+     */
+    struct EulerAngleSample {
+        uint64_t time_us; /**< @brief Time in microseconds of `std::chrono::steady_clock`. */
+        EulerAngle euler_angle; /**< @brief Attitude as Euler angles. */
+    };
+
+    /**
+     * @brief Positions of the history as columns, all of the same length.
+     *
+     * The vectors can be handed to columnar formats such as Apache Arrow as they are.
+     * The time is as for PositionSample.
+     */
+    struct PositionColumns {
+        std::vector<uint64_t> time_us {}; /**< @brief Time in microseconds. */
+        std::vector<double> latitude_deg {}; /**< @brief Latitude in degrees. */
+        std::vector<double> longitude_deg {}; /**< @brief Longitude in degrees. */
+        std::vector<float> absolute_altitude_m {}; /**< @brief Altitude AMSL in metres. */
+        std::vector<float> relative_altitude_m {}; /**< @brief Altitude above takeoff. */
+    };
+
+    /**
+     * @brief Attitudes of the history as columns, all of the same length.
+     *
+     * The time is as for PositionSample.
+     */
+    struct QuaternionColumns {
+        std::vector<uint64_t> time_us {}; /**< @brief Time in microseconds. */
+        std::vector<float> w {}; /**< @brief Quaternion entry 0, also denoted as a. */
+        std::vector<float> x {}; /**< @brief Quaternion entry 1, also denoted as b. */
+        std::vector<float> y {}; /**< @brief Quaternion entry 2, also denoted as c. */
+        std::vector<float> z {}; /**< @brief Quaternion entry 3, also denoted as d. */
+    };
+
     /**
      * @brief Results enum for telemetry requests.
      */
@@ -248,6 +402,46 @@ public:
      */
     Result set_rate_rc_status(double rate_hz);
 
+    /**
+     * @brief Set rate of local position and velocity (NED) updates (synchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @return Result of request.
+     */
+    Result set_rate_position_velocity_ned(double rate_hz);
+
+    /**
+     * @brief Set rate of body angular velocity updates (synchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @return Result of request.
+     */
+    Result set_rate_attitude_angular_velocity_body(double rate_hz);
+
+    /**
+     * @brief Set rate of IMU updates (synchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @return Result of request.
+     */
+    Result set_rate_imu(double rate_hz);
+
+    /**
+     * @brief Set rate of odometry updates (synchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @return Result of request.
+     */
+    Result set_rate_odometry(double rate_hz);
+
+    /**
+     * @brief Set rate of actuator control target updates (synchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @return Result of request.
+     */
+    Result set_rate_actuator_control_target(double rate_hz);
+
     /**
      * @brief Set rate of position updates (asynchronous).
      *
@@ -320,6 +514,46 @@ public:
      */
     void set_rate_rc_status_async(double rate_hz, result_callback_t callback);
 
+    /**
+     * @brief Set rate of local position and velocity (NED) updates (asynchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @param callback Callback to receive request result.
+     */
+    void set_rate_position_velocity_ned_async(double rate_hz, result_callback_t callback);
+
+    /**
+     * @brief Set rate of body angular velocity updates (asynchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @param callback Callback to receive request result.
+     */
+    void set_rate_attitude_angular_velocity_body_async(double rate_hz, result_callback_t callback);
+
+    /**
+     * @brief Set rate of IMU updates (asynchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @param callback Callback to receive request result.
+     */
+    void set_rate_imu_async(double rate_hz, result_callback_t callback);
+
+    /**
+     * @brief Set rate of odometry updates (asynchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @param callback Callback to receive request result.
+     */
+    void set_rate_odometry_async(double rate_hz, result_callback_t callback);
+
+    /**
+     * @brief Set rate of actuator control target updates (asynchronous).
+     *
+     * @param rate_hz Rate in Hz.
+     * @param callback Callback to receive request result.
+     */
+    void set_rate_actuator_control_target_async(double rate_hz, result_callback_t callback);
+
     /**
      * @brief Get the current position (synchronous).
      *
@@ -427,6 +661,155 @@ public:
      */
     RCStatus rc_status() const;
 
+    /**
+     * @brief Get the current local position and velocity (synchronous).
+     *
+     * @return Local position and velocity in NED.
+     */
+    PositionVelocityNED position_velocity_ned() const;
+
+    /**
+     * @brief Get the current angular velocity in body frame (synchronous).
+     *
+     * @return Angular velocity.
+     */
+    AngularVelocityBody attitude_angular_velocity_body() const;
+
+    /**
+     * @brief Get the latest IMU measurement (synchronous).
+     *
+     * @return IMU measurement.
+     */
+    IMU imu() const;
+
+    /**
+     * @brief Get the latest odometry (synchronous).
+     *
+     * @return Odometry.
+     */
+    Odometry odometry() const;
+
+    /**
+     * @brief Get the latest actuator control target (synchronous).
+     *
+     * @return Actuator control target.
+     */
+    ActuatorControlTarget actuator_control_target() const;
+
+    /**
+     * @brief Get all telemetry state at once (synchronous).
+     *
+     * Unlike calling the getters one after the other, this returns values which
+     * belong together, taken without blocking the reception of new ones.
+     *
+     * @return Telemetry snapshot.
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @brief Keep a history of the latest positions and attitudes.
+     *
+     * The history is off by default. Its memory is set aside here, afterwards
+     * recording it doesn't allocate. Changing the capacity drops what was recorded.
+     *
+     * @param num_samples Number of samples to keep per stream (0 to disable).
+     *                    At 50 Hz, 500 samples cover the last 10 seconds.
+     */
+    void set_history_capacity(size_t num_samples);
+
+    /**
+     * @brief Get the recorded positions newer than a given time (synchronous).
+     *
+     * @param since_us Time in microseconds of `std::chrono::steady_clock`,
+     *                 0 for all recorded.
+     * @param samples Filled with the samples, oldest first. Its memory is reused, so
+     *                repeated calls don't allocate once it is big enough.
+     */
+    void position_history(uint64_t since_us, std::vector<PositionSample> &samples) const;
+
+    /**
+     * @brief Get the recorded attitudes newer than a given time (synchronous).
+     *
+     * @param since_us Time in microseconds of `std::chrono::steady_clock`,
+     *                 0 for all recorded.
+     * @param samples Filled with the samples, oldest first. Its memory is reused, so
+     *                repeated calls don't allocate once it is big enough.
+     */
+    void attitude_quaternion_history(uint64_t since_us,
+                                     std::vector<QuaternionSample> &samples) const;
+
+    /**
+     * @brief Get the recorded attitudes newer than a given time as Euler angles (synchronous).
+     *
+     * The samples are converted all at once, which is a lot faster than
+     * converting them one by one, e.g. for log analysis.
+     *
+     * @param since_us Time in microseconds of `std::chrono::steady_clock`,
+     *                 0 for all recorded.
+     * @param samples Filled with the samples, oldest first.
+     */
+    void attitude_euler_angle_history(uint64_t since_us,
+                                      std::vector<EulerAngleSample> &samples) const;
+
+    /**
+     * @brief Get the recorded positions newer than a given time as columns (synchronous).
+     *
+     * Copied field by field straight out of the history, which is how it is stored,
+     * e.g. for analytics which want columns rather than one struct per sample.
+     *
+     * @param since_us Time in microseconds of `std::chrono::steady_clock`,
+     *                 0 for all recorded.
+     * @param columns Filled with the samples, oldest first. Its memory is reused.
+     */
+    void position_history_columns(uint64_t since_us, PositionColumns &columns) const;
+
+    /**
+     * @brief Get the recorded attitudes newer than a given time as columns (synchronous).
+     *
+     * @param since_us Time in microseconds of `std::chrono::steady_clock`,
+     *                 0 for all recorded.
+     * @param columns Filled with the samples, oldest first. Its memory is reused.
+     */
+    void attitude_quaternion_history_columns(uint64_t since_us,
+                                             QuaternionColumns &columns) const;
+
+    /**
+     * @brief Get the position at a given time (synchronous).
+     *
+     * Linearly interpolated between the recorded positions.
+     *
+     * @param time_us Time in microseconds of `std::chrono::steady_clock`.
+     * @param position The interpolated position.
+     * @return `true` if the time is covered by the history.
+     */
+    bool position_at(uint64_t time_us, Position &position) const;
+
+    /**
+     * @brief Get the attitude at a given time (synchronous).
+     *
+     * Interpolated (slerp) between the recorded attitudes.
+     *
+     * @param time_us Time in microseconds of `std::chrono::steady_clock`.
+     * @param quaternion The interpolated attitude.
+     * @return `true` if the time is covered by the history.
+     */
+    bool attitude_quaternion_at(uint64_t time_us, Quaternion &quaternion) const;
+
+    /**
+     * @brief Get the end-to-end latency of position and attitude (synchronous).
+     *
+     * This is the time from the measurement on the vehicle until it is received,
+     * averaged. It needs the vehicle to answer TIMESYNC requests.
+     *
+     * @return Latency in seconds, NAN as long as the clocks are not synchronized.
+     */
+    double latency_s() const;
+
+    /**
+     * @brief Handle of a subscriber added with one of the `subscribe_...()` methods.
+     */
+    typedef uint64_t subscription_handle_t;
+
     /**
      * @brief Callback type for position updates.
      */
@@ -439,6 +822,16 @@ public:
      */
     void position_async(position_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to position updates (asynchronous).
+     *
+     * Unlike position_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_position(position_callback_t callback);
+
     /**
      * @brief Subscribe to home position updates (asynchronous).
      *
@@ -446,6 +839,16 @@ public:
      */
     void home_position_async(position_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to home position updates (asynchronous).
+     *
+     * Unlike home_position_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_home_position(position_callback_t callback);
+
     /**
      * @brief Callback type for in-air updates.
      *
@@ -460,6 +863,16 @@ public:
      */
     void in_air_async(in_air_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to in-air updates (asynchronous).
+     *
+     * Unlike in_air_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_in_air(in_air_callback_t callback);
+
     /**
      * @brief Callback type for armed updates (asynchronous).
      *
@@ -476,6 +889,16 @@ public:
      */
     void armed_async(armed_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to armed updates (asynchronous).
+     *
+     * Unlike armed_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_armed(armed_callback_t callback);
+
     /**
      * @brief Callback type for attitude updates in quaternion.
      *
@@ -490,6 +913,16 @@ public:
      */
     void attitude_quaternion_async(attitude_quaternion_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to attitude updates (asynchronous).
+     *
+     * Unlike attitude_quaternion_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_attitude_quaternion(attitude_quaternion_callback_t callback);
+
     /**
      * @brief Callback type for attitude updates in Euler angles.
      *
@@ -504,6 +937,16 @@ public:
      */
     void attitude_euler_angle_async(attitude_euler_angle_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to attitude updates (asynchronous).
+     *
+     * Unlike attitude_euler_angle_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_attitude_euler_angle(attitude_euler_angle_callback_t callback);
+
     /**
      * @brief Subscribe to camera attitude updates in quaternion (asynchronous).
      *
@@ -511,6 +954,16 @@ public:
      */
     void camera_attitude_quaternion_async(attitude_quaternion_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to camera attitude updates (asynchronous).
+     *
+     * Unlike camera_attitude_quaternion_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_camera_attitude_quaternion(attitude_quaternion_callback_t callback);
+
     /**
      * @brief Subscribe to camera attitude updates in Euler angles (asynchronous).
      *
@@ -518,6 +971,16 @@ public:
      */
     void camera_attitude_euler_angle_async(attitude_euler_angle_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to camera attitude updates (asynchronous).
+     *
+     * Unlike camera_attitude_euler_angle_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_camera_attitude_euler_angle(attitude_euler_angle_callback_t callback);
+
     /**
      * @brief Callback type for ground speed (NED) updates.
      *
@@ -532,6 +995,16 @@ public:
      */
     void ground_speed_ned_async(ground_speed_ned_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to ground speed updates (asynchronous).
+     *
+     * Unlike ground_speed_ned_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_ground_speed_ned(ground_speed_ned_callback_t callback);
+
     /**
      * @brief Callback type for GPS information updates.
      *
@@ -546,6 +1019,16 @@ public:
      */
     void gps_info_async(gps_info_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to GPS information updates (asynchronous).
+     *
+     * Unlike gps_info_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_gps_info(gps_info_callback_t callback);
+
     /**
      * @brief Callback type for battery status updates.
      *
@@ -560,6 +1043,16 @@ public:
      */
     void battery_async(battery_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to battery status updates (asynchronous).
+     *
+     * Unlike battery_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_battery(battery_callback_t callback);
+
     /**
      * @brief Callback type for flight mode updates.
      *
@@ -576,6 +1069,16 @@ public:
      */
     void flight_mode_async(flight_mode_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to flight mode updates (asynchronous).
+     *
+     * Unlike flight_mode_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_flight_mode(flight_mode_callback_t callback);
+
     /**
      * @brief Callback type for health status updates.
      *
@@ -586,12 +1089,23 @@ public:
     /**
      * @brief Subscribe to health status updates (asynchronous).
      *
-     * Note that health status updates are limited to 1Hz.
+     * The callback is only called when the health changed, and once with the
+     * current health after subscribing.
      *
      * @param callback Function to call with updates.
      */
     void health_async(health_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to health updates (asynchronous).
+     *
+     * Unlike health_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_health(health_callback_t callback);
+
     /**
      * @brief Callback type for health status updates.
      *
@@ -602,12 +1116,23 @@ public:
     /**
      * @brief Subscribe to overall health status updates (asynchronous).
      *
-     * Note that overall health status updates are limited to 1Hz.
+     * The callback is only called when the overall health changed, and once with
+     * the current value after subscribing.
      *
      * @param callback Function to call with updates.
      */
     void health_all_ok_async(health_all_ok_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to overall health updates (asynchronous).
+     *
+     * Unlike health_all_ok_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_health_all_ok(health_all_ok_callback_t callback);
+
     /**
      * @brief Callback type for RC status updates.
      *
@@ -622,6 +1147,214 @@ public:
      */
     void rc_status_async(rc_status_callback_t callback);
 
+    /**
+     * @brief Add a subscriber to RC status updates (asynchronous).
+     *
+     * Unlike rc_status_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_rc_status(rc_status_callback_t callback);
+
+    /**
+     * @brief Callback type for local position and velocity updates.
+     */
+    typedef std::function<void(PositionVelocityNED position_velocity_ned)>
+    position_velocity_ned_callback_t;
+
+    /**
+     * @brief Subscribe to local position and velocity updates (asynchronous).
+     *
+     * This and the other high-rate subscriptions below are meant for control loops.
+     * The callback is called directly from the thread handling the received messages,
+     * also when conflation is enabled, so it needs to return quickly.
+     *
+     * @param callback Function to call with updates.
+     */
+    void position_velocity_ned_async(position_velocity_ned_callback_t callback);
+
+    /**
+     * @brief Add a subscriber to local position and velocity updates (asynchronous).
+     *
+     * Unlike position_velocity_ned_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_position_velocity_ned(position_velocity_ned_callback_t callback);
+
+    /**
+     * @brief Callback type for body angular velocity updates.
+     */
+    typedef std::function<void(AngularVelocityBody angular_velocity_body)>
+    attitude_angular_velocity_body_callback_t;
+
+    /**
+     * @brief Subscribe to body angular velocity updates (asynchronous).
+     *
+     * @param callback Function to call with updates.
+     */
+    void attitude_angular_velocity_body_async(attitude_angular_velocity_body_callback_t callback);
+
+    /**
+     * @brief Add a subscriber to body angular velocity updates (asynchronous).
+     *
+     * Unlike attitude_angular_velocity_body_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_attitude_angular_velocity_body(attitude_angular_velocity_body_callback_t callback);
+
+    /**
+     * @brief Callback type for IMU updates.
+     */
+    typedef std::function<void(IMU imu)> imu_callback_t;
+
+    /**
+     * @brief Subscribe to IMU updates (asynchronous).
+     *
+     * @param callback Function to call with updates.
+     */
+    void imu_async(imu_callback_t callback);
+
+    /**
+     * @brief Add a subscriber to IMU updates (asynchronous).
+     *
+     * Unlike imu_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_imu(imu_callback_t callback);
+
+    /**
+     * @brief Callback type for odometry updates.
+     */
+    typedef std::function<void(Odometry odometry)> odometry_callback_t;
+
+    /**
+     * @brief Subscribe to odometry updates (asynchronous).
+     *
+     * @param callback Function to call with updates.
+     */
+    void odometry_async(odometry_callback_t callback);
+
+    /**
+     * @brief Add a subscriber to odometry updates (asynchronous).
+     *
+     * Unlike odometry_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_odometry(odometry_callback_t callback);
+
+    /**
+     * @brief Callback type for actuator control target updates.
+     */
+    typedef std::function<void(ActuatorControlTarget actuator_control_target)>
+    actuator_control_target_callback_t;
+
+    /**
+     * @brief Subscribe to actuator control target updates (asynchronous).
+     *
+     * @param callback Function to call with updates.
+     */
+    void actuator_control_target_async(actuator_control_target_callback_t callback);
+
+    /**
+     * @brief Add a subscriber to actuator control target updates (asynchronous).
+     *
+     * Unlike actuator_control_target_async(), this doesn't replace earlier subscribers.
+     *
+     * @param callback Function to call with updates.
+     * @return Handle to remove the subscriber again with unsubscribe().
+     */
+    subscription_handle_t subscribe_actuator_control_target(actuator_control_target_callback_t callback);
+
+    /**
+     * @brief Only deliver the latest value to slow subscribers.
+     *
+     * By default, subscription callbacks are called directly for every update received.
+     * With conflation enabled, the callbacks are instead called from a separate thread
+     * and if a callback is still busy when new updates arrive, only the newest update
+     * is delivered next while the older updates not yet delivered are discarded.
+     *
+     * @param enable `true` to enable conflation for all subscriptions.
+     */
+    void set_conflate_subscriptions(bool enable);
+
+    /**
+     * @brief Only notify a subscriber when its value changed by more than a deadband.
+     *
+     * Updates which didn't change the value enough since the last one the subscriber got
+     * are dropped as they are received, before any callback is called or queued. The
+     * first update after setting the deadband is always delivered.
+     *
+     * The deadband is in the unit of the subscription:
+     * - Position and home position: meters, horizontally or vertically.
+     * - Battery: remaining (range: 0.0 to 1.0), or any change of the voltage if the
+     *   autopilot doesn't estimate the remaining.
+     * - RC status: signal strength in percent, and any change of availability.
+     * - All others: any change, the deadband is only used to turn the filter on or off.
+     *
+     * Not available for IMU, odometry and actuator control target subscribers.
+     *
+     * @param handle Handle returned when subscribing.
+     * @param deadband Deadband in the unit above, 0 for any change, negative to deliver
+     * all updates again.
+     * @return `false` if there is no subscriber with this handle that supports it.
+     */
+    bool set_subscription_deadband(subscription_handle_t handle, double deadband);
+
+    /**
+     * @brief Remove a subscriber added with one of the `subscribe_...()` methods.
+     *
+     * The callback can still be running or, with conflation, be called once more
+     * while this returns.
+     *
+     * @param handle Handle returned when subscribing.
+     * @return `false` if there is no subscriber with this handle.
+     */
+    bool unsubscribe(subscription_handle_t handle);
+
+    /**
+     * @brief Ask for a rate for the updates of a subscriber (synchronous).
+     *
+     * The autopilot is asked for the highest rate of all subscribers of the same
+     * message and of the rate set with the matching `set_rate_...()` method. Once
+     * nobody asks for a rate anymore, the message goes back to its default rate.
+     * It is never stopped, the SDK itself still needs it. Messages nobody
+     * subscribed to or asked a rate for are left as they are.
+     *
+     * The subscriber itself is called at most at this rate, even if others ask
+     * for more: updates in between are left out for it.
+     *
+     * Only works for subscribers to a single message, not e.g. for health or
+     * flight mode subscribers.
+     *
+     * @param handle Handle returned when subscribing.
+     * @param rate_hz Rate in Hz, 0 to stop asking for one and get all updates,
+     *                negative rates are rejected.
+     * @return Result of request.
+     */
+    Result set_subscription_rate(subscription_handle_t handle, double rate_hz);
+
+    /**
+     * @brief Ask for a rate for the updates of a subscriber (asynchronous).
+     *
+     * See set_subscription_rate().
+     *
+     * @param handle Handle returned when subscribing.
+     * @param rate_hz Rate in Hz, 0 to stop asking for one and get all updates,
+     *                negative rates are rejected.
+     * @param callback Callback to receive request result.
+     */
+    void set_subscription_rate_async(subscription_handle_t handle, double rate_hz,
+                                     result_callback_t callback);
+
     // Non-copyable
     /**
      * @brief Copy constructor (object is not copyable).
@@ -661,4 +1394,14 @@ std::ostream &operator<<(std::ostream &str, Telemetry::GroundSpeedNED const &gro
 bool operator==(const Telemetry::RCStatus &lhs, const Telemetry::RCStatus &rhs);
 std::ostream &operator<<(std::ostream &str, Telemetry::RCStatus const &rc_status);
 
+bool operator==(const Telemetry::PositionVelocityNED &lhs,
+                const Telemetry::PositionVelocityNED &rhs);
+std::ostream &operator<<(std::ostream &str,
+                         Telemetry::PositionVelocityNED const &position_velocity_ned);
+
+bool operator==(const Telemetry::AngularVelocityBody &lhs,
+                const Telemetry::AngularVelocityBody &rhs);
+std::ostream &operator<<(std::ostream &str,
+                         Telemetry::AngularVelocityBody const &angular_velocity_body);
+
 } // namespace dronecore
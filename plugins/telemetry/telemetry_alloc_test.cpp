@@ -0,0 +1,128 @@
+#include "allocation_counter.h"
+#include "connection.h"
+#include "dronecore_impl.h"
+#include "system.h"
+#include "telemetry.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <vector>
+
+using namespace dronecore;
+
+namespace {
+
+// Messages are handed to DroneCoreImpl directly, what is sent is swallowed.
+class NullConnection : public Connection
+{
+public:
+    explicit NullConnection(DroneCoreImpl &parent) : Connection(parent) {}
+
+    ConnectionResult start() override { return ConnectionResult::SUCCESS; }
+    ConnectionResult stop() override { return ConnectionResult::SUCCESS; }
+    bool is_ok() const override { return true; }
+    bool send_message(const mavlink_message_t &) override { return true; }
+
+protected:
+    bool write_buffer(const uint8_t *, size_t) override { return true; }
+};
+
+constexpr uint8_t SYSTEM_ID = 1;
+constexpr uint8_t COMPONENT_ID = 1;
+
+std::vector<mavlink_message_t> make_telemetry_messages()
+{
+    std::vector<mavlink_message_t> messages;
+    mavlink_message_t message;
+
+    mavlink_heartbeat_t heartbeat {};
+    heartbeat.type = MAV_TYPE_QUADROTOR;
+    heartbeat.autopilot = MAV_AUTOPILOT_PX4;
+    mavlink_msg_heartbeat_encode(SYSTEM_ID, COMPONENT_ID, &message, &heartbeat);
+    messages.push_back(message);
+
+    mavlink_attitude_t attitude {};
+    attitude.rollspeed = 0.5f;
+    mavlink_msg_attitude_encode(SYSTEM_ID, COMPONENT_ID, &message, &attitude);
+    messages.push_back(message);
+
+    mavlink_attitude_quaternion_t attitude_quaternion {};
+    attitude_quaternion.q1 = 1.0f;
+    mavlink_msg_attitude_quaternion_encode(SYSTEM_ID, COMPONENT_ID, &message,
+                                           &attitude_quaternion);
+    messages.push_back(message);
+
+    mavlink_global_position_int_t global_position_int {};
+    mavlink_msg_global_position_int_encode(SYSTEM_ID, COMPONENT_ID, &message,
+                                           &global_position_int);
+    messages.push_back(message);
+
+    mavlink_local_position_ned_t local_position_ned {};
+    mavlink_msg_local_position_ned_encode(SYSTEM_ID, COMPONENT_ID, &message,
+                                          &local_position_ned);
+    messages.push_back(message);
+
+    mavlink_highres_imu_t highres_imu {};
+    mavlink_msg_highres_imu_encode(SYSTEM_ID, COMPONENT_ID, &message, &highres_imu);
+    messages.push_back(message);
+
+    mavlink_sys_status_t sys_status {};
+    mavlink_msg_sys_status_encode(SYSTEM_ID, COMPONENT_ID, &message, &sys_status);
+    messages.push_back(message);
+
+    mavlink_gps_raw_int_t gps_raw_int {};
+    mavlink_msg_gps_raw_int_encode(SYSTEM_ID, COMPONENT_ID, &message, &gps_raw_int);
+    messages.push_back(message);
+
+    mavlink_extended_sys_state_t extended_sys_state {};
+    mavlink_msg_extended_sys_state_encode(SYSTEM_ID, COMPONENT_ID, &message,
+                                          &extended_sys_state);
+    messages.push_back(message);
+
+    return messages;
+}
+
+} // namespace
+
+// Covers MAVLinkSystem::process_mavlink_message and the TelemetryImpl handlers
+// behind it, without any subscriptions.
+TEST(TelemetryAllocations, ProcessMessages)
+{
+    // The connection needs to outlive DroneCoreImpl, which sends to it.
+    std::unique_ptr<DroneCoreImpl> dc(new DroneCoreImpl());
+    std::unique_ptr<NullConnection> connection(new NullConnection(*dc));
+
+    // Discovery, with a UUID so that the autopilot version isn't requested
+    // on every heartbeat.
+    const std::vector<mavlink_message_t> messages = make_telemetry_messages();
+    dc->receive_message(messages[0], *connection, std::chrono::steady_clock::now());
+
+    mavlink_autopilot_version_t autopilot_version {};
+    autopilot_version.uid = 42;
+    mavlink_message_t message;
+    mavlink_msg_autopilot_version_encode(SYSTEM_ID, COMPONENT_ID, &message, &autopilot_version);
+    dc->receive_message(message, *connection, std::chrono::steady_clock::now());
+
+    System &system = dc->get_system(42);
+    std::unique_ptr<Telemetry> telemetry(new Telemetry(system));
+
+    // The first message of each ID creates its receive counter.
+    for (const auto &telemetry_message : messages) {
+        dc->receive_message(telemetry_message, *connection, std::chrono::steady_clock::now());
+    }
+
+    {
+        AllocationCounter allocations;
+        for (unsigned i = 0; i < 100; ++i) {
+            for (const auto &telemetry_message : messages) {
+                dc->receive_message(telemetry_message, *connection,
+                                    std::chrono::steady_clock::now());
+            }
+        }
+        EXPECT_EQ(allocations.get(), 0u);
+    }
+
+    EXPECT_FLOAT_EQ(telemetry->attitude_angular_velocity_body().roll_rad_s, 0.5f);
+
+    telemetry.reset();
+    dc.reset();
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace dronecore {
+
+// Fixed-capacity history of one telemetry stream, the oldest samples are
+// overwritten once it is full. Samples older than the newest one are dropped,
+// e.g. when the timestamps switch to the synchronized vehicle time.
+//
+// The values are stored field by field (struct of arrays), so the time
+// search only touches the timestamps, and nothing is allocated after
+// set_capacity(). The lock is only held to copy samples in or out.
+template <size_t NUM_FIELDS>
+class TelemetryHistory
+{
+public:
+    typedef double fields_t[NUM_FIELDS];
+
+    // Drops all samples, 0 disables the history.
+    void set_capacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _capacity = capacity;
+        _time_us.assign(capacity, 0);
+        _values.assign(capacity * NUM_FIELDS, 0.0);
+        _next = 0;
+        _size = 0;
+    }
+
+    size_t capacity() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _capacity;
+    }
+
+    void add(uint64_t time_us, const fields_t &fields)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_capacity == 0) {
+            return;
+        }
+        if (_size > 0 && time_us < _time_us[get_slot(_size - 1)]) {
+            return;
+        }
+
+        _time_us[_next] = time_us;
+        for (size_t field = 0; field < NUM_FIELDS; ++field) {
+            _values[field * _capacity + _next] = fields[field];
+        }
+        _next = (_next + 1) % _capacity;
+        if (_size < _capacity) {
+            ++_size;
+        }
+    }
+
+    // Calls f(time_us, fields) for all samples newer than since_us, oldest first.
+    template <class F>
+    void for_each_since(uint64_t since_us, F f) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        fields_t fields;
+        for (size_t i = lower_bound(since_us + 1); i < _size; ++i) {
+            const size_t slot = get_slot(i);
+            read_fields(slot, fields);
+            f(_time_us[slot], fields);
+        }
+    }
+
+    // Calls f(time_us, columns, num_samples) for the samples newer than since_us,
+    // oldest first, columns[field] pointing to the values of each field. The
+    // samples are in a ring, so f is called twice if they wrap around.
+    template <class F>
+    void for_each_block_since(uint64_t since_us, F f) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        const double *columns[NUM_FIELDS];
+        for (size_t i = lower_bound(since_us + 1); i < _size;) {
+            const size_t slot = get_slot(i);
+            const size_t num_samples = std::min(_size - i, _capacity - slot);
+            for (size_t field = 0; field < NUM_FIELDS; ++field) {
+                columns[field] = &_values[field * _capacity + slot];
+            }
+            f(&_time_us[slot], columns, num_samples);
+            i += num_samples;
+        }
+    }
+
+    // Gets the two samples around time_us, both are the same if one matches
+    // exactly. Returns false if time_us is not covered by the history.
+    bool get_bracket(uint64_t time_us,
+                     uint64_t &before_time_us, fields_t &before,
+                     uint64_t &after_time_us, fields_t &after) const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        const size_t i = lower_bound(time_us);
+        if (i >= _size) {
+            return false;
+        }
+
+        const size_t after_slot = get_slot(i);
+        if (_time_us[after_slot] == time_us) {
+            before_time_us = after_time_us = time_us;
+            read_fields(after_slot, before);
+            read_fields(after_slot, after);
+            return true;
+        }
+
+        if (i == 0) {
+            return false;
+        }
+
+        const size_t before_slot = get_slot(i - 1);
+        before_time_us = _time_us[before_slot];
+        read_fields(before_slot, before);
+        after_time_us = _time_us[after_slot];
+        read_fields(after_slot, after);
+        return true;
+    }
+
+private:
+    // Need to be called with _mutex locked, i counts from the oldest sample.
+    size_t get_slot(size_t i) const
+    {
+        return (_next + _capacity - _size + i) % _capacity;
+    }
+
+    // Index of the first sample not older than time_us.
+    size_t lower_bound(uint64_t time_us) const
+    {
+        size_t low = 0;
+        size_t high = _size;
+        while (low < high) {
+            const size_t mid = low + (high - low) / 2;
+            if (_time_us[get_slot(mid)] < time_us) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    void read_fields(size_t slot, fields_t &fields) const
+    {
+        for (size_t field = 0; field < NUM_FIELDS; ++field) {
+            fields[field] = _values[field * _capacity + slot];
+        }
+    }
+
+    mutable std::mutex _mutex {};
+    size_t _capacity {0};
+    std::vector<uint64_t> _time_us {};
+    // All values of the first field, then all of the second one, etc.
+    std::vector<double> _values {};
+    size_t _next {0};
+    size_t _size {0};
+};
+
+} // namespace dronecore
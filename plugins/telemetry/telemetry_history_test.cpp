@@ -0,0 +1,116 @@
+#include "telemetry_history.h"
+#include <gtest/gtest.h>
+
+using namespace dronecore;
+
+TEST(TelemetryHistory, DisabledByDefault)
+{
+    TelemetryHistory<1> history;
+    const double fields[1] = {1.0};
+    history.add(10, fields);
+
+    unsigned count = 0;
+    history.for_each_since(0, [&](uint64_t, const double (&)[1]) { ++count; });
+    EXPECT_EQ(count, 0u);
+}
+
+TEST(TelemetryHistory, OverwritesOldest)
+{
+    TelemetryHistory<2> history;
+    history.set_capacity(3);
+
+    for (uint64_t i = 1; i <= 5; ++i) {
+        const double fields[2] = {double(i), -double(i)};
+        history.add(i * 10, fields);
+    }
+
+    std::vector<uint64_t> times;
+    history.for_each_since(0, [&](uint64_t time_us, const double (&fields)[2]) {
+        times.push_back(time_us);
+        EXPECT_EQ(fields[0] * 10.0, double(time_us));
+        EXPECT_EQ(fields[1], -fields[0]);
+    });
+    EXPECT_EQ(times, (std::vector<uint64_t> {30, 40, 50}));
+
+    times.clear();
+    history.for_each_since(40, [&](uint64_t time_us, const double (&)[2]) {
+        times.push_back(time_us);
+    });
+    EXPECT_EQ(times, (std::vector<uint64_t> {50}));
+}
+
+TEST(TelemetryHistory, Bracket)
+{
+    TelemetryHistory<1> history;
+    history.set_capacity(10);
+
+    for (uint64_t i = 1; i <= 4; ++i) {
+        const double fields[1] = {double(i)};
+        history.add(i * 100, fields);
+    }
+
+    uint64_t before_time_us, after_time_us;
+    double before[1], after[1];
+
+    ASSERT_TRUE(history.get_bracket(250, before_time_us, before, after_time_us, after));
+    EXPECT_EQ(before_time_us, 200u);
+    EXPECT_EQ(after_time_us, 300u);
+    EXPECT_EQ(before[0], 2.0);
+    EXPECT_EQ(after[0], 3.0);
+
+    ASSERT_TRUE(history.get_bracket(400, before_time_us, before, after_time_us, after));
+    EXPECT_EQ(before_time_us, 400u);
+    EXPECT_EQ(after_time_us, 400u);
+
+    EXPECT_FALSE(history.get_bracket(50, before_time_us, before, after_time_us, after));
+    EXPECT_FALSE(history.get_bracket(401, before_time_us, before, after_time_us, after));
+}
+
+TEST(TelemetryHistory, DropsOlderThanNewest)
+{
+    TelemetryHistory<1> history;
+    history.set_capacity(10);
+
+    for (uint64_t time_us : {10, 20, 15, 20, 30}) {
+        const double fields[1] = {double(time_us)};
+        history.add(time_us, fields);
+    }
+
+    std::vector<uint64_t> times;
+    history.for_each_since(0, [&](uint64_t time_us, const double (&)[1]) {
+        times.push_back(time_us);
+    });
+    EXPECT_EQ(times, (std::vector<uint64_t> {10, 20, 20, 30}));
+}
+
+TEST(TelemetryHistory, BlocksWrapAround)
+{
+    TelemetryHistory<2> history;
+    history.set_capacity(4);
+
+    for (uint64_t i = 1; i <= 6; ++i) {
+        const double fields[2] = {double(i), -double(i)};
+        history.add(i * 10, fields);
+    }
+
+    std::vector<size_t> block_sizes;
+    std::vector<uint64_t> times;
+    std::vector<double> second_field;
+    history.for_each_block_since(0, [&](const uint64_t *time_us, const double *const *columns,
+    size_t num_samples) {
+        block_sizes.push_back(num_samples);
+        times.insert(times.end(), time_us, time_us + num_samples);
+        second_field.insert(second_field.end(), columns[1], columns[1] + num_samples);
+    });
+    // Slots 2 and 3, then 0 and 1.
+    EXPECT_EQ(block_sizes, (std::vector<size_t> {2, 2}));
+    EXPECT_EQ(times, (std::vector<uint64_t> {30, 40, 50, 60}));
+    EXPECT_EQ(second_field, (std::vector<double> {-3.0, -4.0, -5.0, -6.0}));
+
+    times.clear();
+    history.for_each_block_since(40, [&](const uint64_t *time_us, const double *const *,
+    size_t num_samples) {
+        times.insert(times.end(), time_us, time_us + num_samples);
+    });
+    EXPECT_EQ(times, (std::vector<uint64_t> {50, 60}));
+}
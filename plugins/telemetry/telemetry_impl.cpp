@@ -4,49 +4,40 @@
 #include "global_include.h"
 #include "px4_custom_mode.h"
 #include <cmath>
+#include <cstring>
 #include <functional>
+#include <initializer_list>
 
 namespace dronecore {
 
 TelemetryImpl::TelemetryImpl(System &system) :
     PluginImplBase(system),
-    _position_mutex(),
-    _position(Telemetry::Position {double(NAN), double(NAN), NAN, NAN}),
-    _home_position_mutex(),
-    _home_position(Telemetry::Position {double(NAN), double(NAN), NAN, NAN}),
-    _in_air(false),
-    _armed(false),
-    _attitude_quaternion_mutex(),
-    _attitude_quaternion(Telemetry::Quaternion {NAN, NAN, NAN, NAN}),
-    _camera_attitude_euler_angle_mutex(),
-    _camera_attitude_euler_angle(Telemetry::EulerAngle {NAN, NAN, NAN}),
-    _ground_speed_ned_mutex(),
-    _ground_speed_ned(Telemetry::GroundSpeedNED {NAN, NAN, NAN}),
-    _gps_info_mutex(),
-    _gps_info(Telemetry::GPSInfo {0, 0}),
-    _battery_mutex(),
-    _battery(Telemetry::Battery {NAN, NAN}),
-    _flight_mode_mutex(),
-    _flight_mode(Telemetry::FlightMode::UNKNOWN),
-    _health_mutex(),
-    _health(Telemetry::Health {false, false, false, false, false, false, false}),
-    _rc_status_mutex(),
-    _rc_status(Telemetry::RCStatus {false, false, 0.0f}),
-    _position_subscription(nullptr),
-    _home_position_subscription(nullptr),
-    _in_air_subscription(nullptr),
-    _armed_subscription(nullptr),
-    _attitude_quaternion_subscription(nullptr),
-    _attitude_euler_angle_subscription(nullptr),
-    _camera_attitude_quaternion_subscription(nullptr),
-    _camera_attitude_euler_angle_subscription(nullptr),
-    _ground_speed_ned_subscription(nullptr),
-    _gps_info_subscription(nullptr),
-    _battery_subscription(nullptr),
-    _flight_mode_subscription(nullptr),
-    _health_subscription(nullptr),
-    _health_all_ok_subscription(nullptr),
-    _rc_status_subscription(nullptr),
+    _position(PositionState {Telemetry::Position {double(NAN), double(NAN), NAN, NAN},
+                             Telemetry::GroundSpeedNED {NAN, NAN, NAN}, 0}),
+    _home_position(HomePositionState {Telemetry::Position {double(NAN), double(NAN), NAN, NAN},
+                                      false, 0}),
+    _in_air(Timed<bool> {false, 0}),
+    _heartbeat(HeartbeatState {false, Telemetry::FlightMode::UNKNOWN, 0}),
+    _attitude_quaternion(Timed<Telemetry::Quaternion> {
+                             Telemetry::Quaternion {NAN, NAN, NAN, NAN}, 0}),
+    _camera_attitude_euler_angle(Timed<Telemetry::EulerAngle> {
+                                     Telemetry::EulerAngle {NAN, NAN, NAN}, 0}),
+    _gps_info(GPSInfoState {Telemetry::GPSInfo {0, 0}, false, 0}),
+    _battery(Timed<Telemetry::Battery> {Telemetry::Battery {NAN, NAN}, 0}),
+    _calibration_health(Telemetry::Health {}),
+    _rc_status(Timed<Telemetry::RCStatus> {Telemetry::RCStatus {}, 0}),
+    _attitude_euler_angle_cache({0, to_euler_angle_from_quaternion(
+                                     Telemetry::Quaternion {NAN, NAN, NAN, NAN})}),
+    _camera_attitude_quaternion_cache({0, to_quaternion_from_euler_angle(
+                                           Telemetry::EulerAngle {NAN, NAN, NAN})}),
+    _position_velocity_ned(Telemetry::PositionVelocityNED {NAN, NAN, NAN, NAN, NAN, NAN}),
+    _attitude_angular_velocity_body(Telemetry::AngularVelocityBody {NAN, NAN, NAN}),
+    _imu(Telemetry::IMU {0, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN, NAN}),
+    _odometry(Telemetry::Odometry {0, 0, 0, NAN, NAN, NAN,
+                                   Telemetry::Quaternion {NAN, NAN, NAN, NAN},
+                                   NAN, NAN, NAN,
+                                   Telemetry::AngularVelocityBody {NAN, NAN, NAN}}),
+    _actuator_control_target(Telemetry::ActuatorControlTarget {0, {}}),
     _ground_speed_ned_rate_hz(0.0),
     _position_rate_hz(-1.0)
 {
@@ -62,41 +53,50 @@ void TelemetryImpl::init()
 {
     using namespace std::placeholders; // for `_1`
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
-        std::bind(&TelemetryImpl::process_global_position_int, this, _1), this);
+    _parent->register_message_handler<mavlink_global_position_int_t>(
+        this, &TelemetryImpl::process_global_position_int);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HOME_POSITION,
-        std::bind(&TelemetryImpl::process_home_position, this, _1), this);
+    _parent->register_message_handler<mavlink_home_position_t>(
+        this, &TelemetryImpl::process_home_position);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_ATTITUDE_QUATERNION,
-        std::bind(&TelemetryImpl::process_attitude_quaternion, this, _1), this);
+    _parent->register_message_handler<mavlink_attitude_quaternion_t>(
+        this, &TelemetryImpl::process_attitude_quaternion);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_MOUNT_ORIENTATION,
-        std::bind(&TelemetryImpl::process_mount_orientation, this, _1), this);
+    _parent->register_message_handler<mavlink_mount_orientation_t>(
+        this, &TelemetryImpl::process_mount_orientation);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_GPS_RAW_INT,
-        std::bind(&TelemetryImpl::process_gps_raw_int, this, _1), this);
+    _parent->register_message_handler<mavlink_gps_raw_int_t>(
+        this, &TelemetryImpl::process_gps_raw_int);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_EXTENDED_SYS_STATE,
-        std::bind(&TelemetryImpl::process_extended_sys_state, this, _1), this);
+    _parent->register_message_handler<mavlink_extended_sys_state_t>(
+        this, &TelemetryImpl::process_extended_sys_state);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_SYS_STATUS,
-        std::bind(&TelemetryImpl::process_sys_status, this, _1), this);
+    _parent->register_message_handler<mavlink_sys_status_t>(
+        this, &TelemetryImpl::process_sys_status);
 
-    _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_HEARTBEAT,
-        std::bind(&TelemetryImpl::process_heartbeat, this, _1), this);
+    _parent->register_message_handler<mavlink_heartbeat_t>(
+        this, &TelemetryImpl::process_heartbeat);
+
+    _parent->register_message_handler<mavlink_rc_channels_t>(
+        this, &TelemetryImpl::process_rc_channels);
+
+    _parent->register_message_handler<mavlink_local_position_ned_t>(
+        this, &TelemetryImpl::process_local_position_ned);
+
+    _parent->register_message_handler<mavlink_attitude_t>(
+        this, &TelemetryImpl::process_attitude);
 
+    _parent->register_message_handler<mavlink_highres_imu_t>(
+        this, &TelemetryImpl::process_highres_imu);
+
+#ifdef MAVLINK_MSG_ID_ODOMETRY
     _parent->register_mavlink_message_handler(
-        MAVLINK_MSG_ID_RC_CHANNELS,
-        std::bind(&TelemetryImpl::process_rc_channels, this, _1), this);
+        MAVLINK_MSG_ID_ODOMETRY,
+        std::bind(&TelemetryImpl::process_odometry, this, _1), this);
+#endif
+
+    _parent->register_message_handler<mavlink_actuator_control_target_t>(
+        this, &TelemetryImpl::process_actuator_control_target);
 }
 
 void TelemetryImpl::deinit()
@@ -106,6 +106,19 @@ void TelemetryImpl::deinit()
 
 void TelemetryImpl::enable()
 {
+    // Rates asked for and messages stopped before connecting, or before the
+    // vehicle rebooted, are set again, all at once rather than one per round trip.
+    MAVLinkSystem::msg_rates_t rates_hz {};
+    for (const auto &rate_hz : _message_rates.get_rates()) {
+        rates_hz.push_back(std::make_pair(uint16_t(rate_hz.first), rate_hz.second));
+    }
+    if (!rates_hz.empty()) {
+        _parent->set_msg_rates_async(rates_hz, [](MAVLinkCommands::Result result, float) {
+            if (result != MAVLinkCommands::Result::SUCCESS) {
+                LogWarn() << "Setting message rates failed";
+            }
+        });
+    }
 
     _parent->register_timeout_handler(
         std::bind(&TelemetryImpl::receive_rc_channels_timeout, this), 1.0, &_timeout_cookie);
@@ -113,6 +126,20 @@ void TelemetryImpl::enable()
     // FIXME: The calibration check should eventually be better than this.
     //        For now, we just do the same as QGC does.
 
+    // Got once here, the values the vehicle sends out when they change are
+    // followed afterwards instead of getting them again.
+    for (const char *name : {"CAL_GYRO0_ID", "CAL_ACC0_ID", "CAL_MAG0_ID"
+#ifdef LEVEL_CALIBRATION
+                             , "SENS_BOARD_X_OFF"
+#endif
+                            }) {
+        _param_subscriptions.push_back(_parent->subscribe_param(
+                                           name, std::bind(&TelemetryImpl::receive_param_changed,
+                                                           this,
+                                                           std::placeholders::_1,
+                                                           std::placeholders::_2)));
+    }
+
     _parent->get_param_int_async(std::string("CAL_GYRO0_ID"),
                                  std::bind(&TelemetryImpl::receive_param_cal_gyro,
                                            this,
@@ -146,6 +173,11 @@ void TelemetryImpl::enable()
 void TelemetryImpl::disable()
 {
     _parent->unregister_timeout_handler(_timeout_cookie);
+
+    for (auto handle : _param_subscriptions) {
+        _parent->unsubscribe_param(handle);
+    }
+    _param_subscriptions.clear();
 }
 
 Telemetry::Result TelemetryImpl::set_rate_position(double rate_hz)
@@ -153,32 +185,27 @@ Telemetry::Result TelemetryImpl::set_rate_position(double rate_hz)
     _position_rate_hz = rate_hz;
     double max_rate_hz = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
 
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_home_position(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_HOME_POSITION, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_HOME_POSITION, rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_in_air(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_attitude(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_ATTITUDE_QUATERNION, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_ATTITUDE_QUATERNION, rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_camera_attitude(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_MOUNT_ORIENTATION, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_MOUNT_ORIENTATION, rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_ground_speed_ned(double rate_hz)
@@ -186,26 +213,52 @@ Telemetry::Result TelemetryImpl::set_rate_ground_speed_ned(double rate_hz)
     _ground_speed_ned_rate_hz = rate_hz;
     double max_rate_hz = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
 
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_gps_info(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_GPS_RAW_INT, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_GPS_RAW_INT, rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_battery(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_SYS_STATUS, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_SYS_STATUS, rate_hz);
 }
 
 Telemetry::Result TelemetryImpl::set_rate_rc_status(double rate_hz)
 {
-    return telemetry_result_from_command_result(
-               _parent->set_msg_rate(MAVLINK_MSG_ID_RC_CHANNELS, rate_hz));
+    return request_msg_rate(MAVLINK_MSG_ID_RC_CHANNELS, rate_hz);
+}
+
+Telemetry::Result TelemetryImpl::set_rate_position_velocity_ned(double rate_hz)
+{
+    return request_msg_rate(MAVLINK_MSG_ID_LOCAL_POSITION_NED, rate_hz);
+}
+
+Telemetry::Result TelemetryImpl::set_rate_attitude_angular_velocity_body(double rate_hz)
+{
+    return request_msg_rate(MAVLINK_MSG_ID_ATTITUDE, rate_hz);
+}
+
+Telemetry::Result TelemetryImpl::set_rate_imu(double rate_hz)
+{
+    return request_msg_rate(MAVLINK_MSG_ID_HIGHRES_IMU, rate_hz);
+}
+
+Telemetry::Result TelemetryImpl::set_rate_odometry(double rate_hz)
+{
+#ifdef MAVLINK_MSG_ID_ODOMETRY
+    return request_msg_rate(MAVLINK_MSG_ID_ODOMETRY, rate_hz);
+#else
+    UNUSED(rate_hz);
+    return Telemetry::Result::UNKNOWN;
+#endif
+}
+
+Telemetry::Result TelemetryImpl::set_rate_actuator_control_target(double rate_hz)
+{
+    return request_msg_rate(MAVLINK_MSG_ID_ACTUATOR_CONTROL_TARGET, rate_hz);
 }
 
 void TelemetryImpl::set_rate_position_async(double rate_hz, Telemetry::result_callback_t callback)
@@ -213,45 +266,30 @@ void TelemetryImpl::set_rate_position_async(double rate_hz, Telemetry::result_ca
     _position_rate_hz = rate_hz;
     double max_rate_hz = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
 
-    _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
-        max_rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    request_msg_rate_async(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz, callback);
 
 }
 
 void TelemetryImpl::set_rate_home_position_async(double rate_hz,
                                                  Telemetry::result_callback_t callback)
 {
-    _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_HOME_POSITION,
-        rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    request_msg_rate_async(MAVLINK_MSG_ID_HOME_POSITION, rate_hz, callback);
 }
 
 void TelemetryImpl::set_rate_in_air_async(double rate_hz, Telemetry::result_callback_t callback)
 {
-    _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_EXTENDED_SYS_STATE,
-        rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    request_msg_rate_async(MAVLINK_MSG_ID_EXTENDED_SYS_STATE, rate_hz, callback);
 }
 
 void TelemetryImpl::set_rate_attitude_async(double rate_hz, Telemetry::result_callback_t callback)
 {
-    _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_ATTITUDE_QUATERNION,
-        rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    request_msg_rate_async(MAVLINK_MSG_ID_ATTITUDE_QUATERNION, rate_hz, callback);
 }
 
 void TelemetryImpl::set_rate_camera_attitude_async(double rate_hz,
                                                    Telemetry::result_callback_t callback)
 {
-    _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_MOUNT_ORIENTATION,
-        rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    request_msg_rate_async(MAVLINK_MSG_ID_MOUNT_ORIENTATION, rate_hz, callback);
 }
 
 void TelemetryImpl::set_rate_ground_speed_ned_async(double rate_hz,
@@ -260,34 +298,194 @@ void TelemetryImpl::set_rate_ground_speed_ned_async(double rate_hz,
     _ground_speed_ned_rate_hz = rate_hz;
     double max_rate_hz = std::max(_position_rate_hz, _ground_speed_ned_rate_hz);
 
-    _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_GLOBAL_POSITION_INT,
-        max_rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    request_msg_rate_async(MAVLINK_MSG_ID_GLOBAL_POSITION_INT, max_rate_hz, callback);
 }
 
 void TelemetryImpl::set_rate_gps_info_async(double rate_hz, Telemetry::result_callback_t callback)
 {
+    request_msg_rate_async(MAVLINK_MSG_ID_GPS_RAW_INT, rate_hz, callback);
+}
+
+void TelemetryImpl::set_rate_battery_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+    request_msg_rate_async(MAVLINK_MSG_ID_SYS_STATUS, rate_hz, callback);
+}
+
+void TelemetryImpl::set_rate_rc_status_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+    request_msg_rate_async(MAVLINK_MSG_ID_RC_CHANNELS, rate_hz, callback);
+}
+
+void TelemetryImpl::set_rate_position_velocity_ned_async(double rate_hz,
+                                                         Telemetry::result_callback_t callback)
+{
+    request_msg_rate_async(MAVLINK_MSG_ID_LOCAL_POSITION_NED, rate_hz, callback);
+}
+
+void TelemetryImpl::set_rate_attitude_angular_velocity_body_async(double rate_hz,
+                                                                  Telemetry::result_callback_t callback)
+{
+    request_msg_rate_async(MAVLINK_MSG_ID_ATTITUDE, rate_hz, callback);
+}
+
+void TelemetryImpl::set_rate_imu_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+    request_msg_rate_async(MAVLINK_MSG_ID_HIGHRES_IMU, rate_hz, callback);
+}
+
+void TelemetryImpl::set_rate_odometry_async(double rate_hz, Telemetry::result_callback_t callback)
+{
+#ifdef MAVLINK_MSG_ID_ODOMETRY
+    request_msg_rate_async(MAVLINK_MSG_ID_ODOMETRY, rate_hz, callback);
+#else
+    UNUSED(rate_hz);
+    if (callback) {
+        callback(Telemetry::Result::UNKNOWN);
+    }
+#endif
+}
+
+void TelemetryImpl::set_rate_actuator_control_target_async(double rate_hz,
+                                                           Telemetry::result_callback_t callback)
+{
+    request_msg_rate_async(MAVLINK_MSG_ID_ACTUATOR_CONTROL_TARGET, rate_hz, callback);
+}
+
+Telemetry::Result TelemetryImpl::set_subscription_rate(Telemetry::subscription_handle_t handle,
+                                                     double rate_hz)
+{
+    if (!(rate_hz >= 0.0)) {
+        LogErr() << "Invalid rate: " << rate_hz;
+        return Telemetry::Result::UNKNOWN;
+    }
+
+    uint32_t message_id;
+    if (!_message_rates.get_message_id(handle, message_id)) {
+        LogErr() << "No subscription to set a rate for";
+        return Telemetry::Result::UNKNOWN;
+    }
+    set_subscriber_max_rate(handle, rate_hz);
+
+    double combined_rate_hz;
+    if (!_message_rates.set_subscriber_rate(handle, rate_hz, combined_rate_hz)) {
+        // Someone else already asks for more.
+        return Telemetry::Result::SUCCESS;
+    }
+    return telemetry_result_from_command_result(
+               _parent->set_msg_rate(uint16_t(message_id), combined_rate_hz));
+}
+
+void TelemetryImpl::set_subscription_rate_async(Telemetry::subscription_handle_t handle,
+                                                double rate_hz,
+                                                Telemetry::result_callback_t callback)
+{
+    uint32_t message_id;
+    if (!(rate_hz >= 0.0) || !_message_rates.get_message_id(handle, message_id)) {
+        LogErr() << "No subscription or invalid rate: " << rate_hz;
+        if (callback) {
+            callback(Telemetry::Result::UNKNOWN);
+        }
+        return;
+    }
+    set_subscriber_max_rate(handle, rate_hz);
+
+    double combined_rate_hz;
+    if (!_message_rates.set_subscriber_rate(handle, rate_hz, combined_rate_hz)) {
+        if (callback) {
+            callback(Telemetry::Result::SUCCESS);
+        }
+        return;
+    }
     _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_GPS_RAW_INT,
-        rate_hz,
+        uint16_t(message_id),
+        combined_rate_hz,
         std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
 }
 
-void TelemetryImpl::set_rate_battery_async(double rate_hz, Telemetry::result_callback_t callback)
+bool TelemetryImpl::set_subscriber_max_rate(Telemetry::subscription_handle_t handle,
+                                            double rate_hz)
+{
+    if (handle == 0) {
+        return false;
+    }
+
+    Time &time = _parent->get_time();
+
+    // Only the subscriptions to a single message, like the rates of _message_rates.
+    return _position_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _home_position_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _in_air_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _attitude_quaternion_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _attitude_euler_angle_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _camera_attitude_quaternion_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _camera_attitude_euler_angle_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _ground_speed_ned_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _gps_info_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _battery_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _rc_status_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _position_velocity_ned_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _attitude_angular_velocity_body_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _imu_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _odometry_subscriptions.set_max_rate(handle, rate_hz, time) ||
+           _actuator_control_target_subscriptions.set_max_rate(handle, rate_hz, time);
+}
+
+Telemetry::Result TelemetryImpl::request_msg_rate(uint16_t message_id, double rate_hz)
+{
+    if (!(rate_hz >= 0.0)) {
+        LogErr() << "Invalid rate: " << rate_hz;
+        return Telemetry::Result::UNKNOWN;
+    }
+
+    // What subscribers asked for is sent as well, so they don't get slowed down.
+    double combined_rate_hz;
+    _message_rates.set_manual_rate(message_id, rate_hz, combined_rate_hz);
+
+    return telemetry_result_from_command_result(
+               _parent->set_msg_rate(message_id, _message_rates.get_rate(message_id)));
+}
+
+void TelemetryImpl::request_msg_rate_async(uint16_t message_id, double rate_hz,
+                                           const Telemetry::result_callback_t &callback)
 {
+    if (!(rate_hz >= 0.0)) {
+        LogErr() << "Invalid rate: " << rate_hz;
+        if (callback) {
+            callback(Telemetry::Result::UNKNOWN);
+        }
+        return;
+    }
+
+    double combined_rate_hz;
+    _message_rates.set_manual_rate(message_id, rate_hz, combined_rate_hz);
+
     _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_SYS_STATUS,
-        rate_hz,
+        message_id,
+        _message_rates.get_rate(message_id),
         std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
 }
 
-void TelemetryImpl::set_rate_rc_status_async(double rate_hz, Telemetry::result_callback_t callback)
+void TelemetryImpl::send_negotiated_msg_rate(uint32_t message_id, double rate_hz)
 {
+    // Nobody waits for this, only complain if it didn't work.
     _parent->set_msg_rate_async(
-        MAVLINK_MSG_ID_RC_CHANNELS,
+        uint16_t(message_id),
         rate_hz,
-        std::bind(&TelemetryImpl::command_result_callback, std::placeholders::_1, callback));
+    [message_id](MAVLinkCommands::Result result, float) {
+        if (result != MAVLinkCommands::Result::SUCCESS &&
+            result != MAVLinkCommands::Result::IN_PROGRESS) {
+            LogWarn() << "Setting rate of message " << message_id << " failed";
+        }
+    });
+}
+
+void TelemetryImpl::add_rate_subscriber(Telemetry::subscription_handle_t handle,
+                                        uint32_t message_id)
+{
+    double rate_hz;
+    if (_message_rates.add_subscriber(handle, message_id, rate_hz)) {
+        send_negotiated_msg_rate(message_id, rate_hz);
+    }
 }
 
 Telemetry::Result TelemetryImpl::telemetry_result_from_command_result(
@@ -319,33 +517,26 @@ void TelemetryImpl::command_result_callback(MAVLinkCommands::Result command_resu
     callback(action_result);
 }
 
-void TelemetryImpl::process_global_position_int(const mavlink_message_t &message)
+void TelemetryImpl::process_global_position_int(const mavlink_global_position_int_t &global_position_int)
 {
-    mavlink_global_position_int_t global_position_int;
-    mavlink_msg_global_position_int_decode(&message, &global_position_int);
-    set_position(Telemetry::Position({global_position_int.lat * 1e-7,
-                                      global_position_int.lon * 1e-7,
-                                      global_position_int.alt * 1e-3f,
-                                      global_position_int.relative_alt * 1e-3f
-                                     }));
-    set_ground_speed_ned({global_position_int.vx * 1e-2f,
-                          global_position_int.vy * 1e-2f,
-                          global_position_int.vz * 1e-2f
-                         });
+    set_position_and_ground_speed_ned(global_position_int.time_boot_ms,
+                                      Telemetry::Position({global_position_int.lat * 1e-7,
+                                                           global_position_int.lon * 1e-7,
+                                                           global_position_int.alt * 1e-3f,
+                                                           global_position_int.relative_alt * 1e-3f
+                                                          }),
+                                      Telemetry::GroundSpeedNED({global_position_int.vx * 1e-2f,
+                                                                 global_position_int.vy * 1e-2f,
+                                                                 global_position_int.vz * 1e-2f
+                                                                }));
 
-    if (_position_subscription) {
-        _position_subscription(get_position());
-    }
+    notify_subscription(_position_subscriptions, get_position());
 
-    if (_ground_speed_ned_subscription) {
-        _ground_speed_ned_subscription(get_ground_speed_ned());
-    }
+    notify_subscription(_ground_speed_ned_subscriptions, get_ground_speed_ned());
 }
 
-void TelemetryImpl::process_home_position(const mavlink_message_t &message)
+void TelemetryImpl::process_home_position(const mavlink_home_position_t &home_position)
 {
-    mavlink_home_position_t home_position;
-    mavlink_msg_home_position_decode(&message, &home_position);
     set_home_position(Telemetry::Position({home_position.latitude * 1e-7,
                                            home_position.longitude * 1e-7,
                                            home_position.altitude * 1e-3f,
@@ -353,18 +544,11 @@ void TelemetryImpl::process_home_position(const mavlink_message_t &message)
                                            0.0f
                                           }));
 
-    set_health_home_position(true);
-
-    if (_home_position_subscription) {
-        _home_position_subscription(get_home_position());
-    }
+    notify_subscription(_home_position_subscriptions, get_home_position());
 }
 
-void TelemetryImpl::process_attitude_quaternion(const mavlink_message_t &message)
+void TelemetryImpl::process_attitude_quaternion(const mavlink_attitude_quaternion_t &attitude_quaternion)
 {
-    mavlink_attitude_quaternion_t attitude_quaternion;
-    mavlink_msg_attitude_quaternion_decode(&message, &attitude_quaternion);
-
     Telemetry::Quaternion quaternion {
         attitude_quaternion.q1,
         attitude_quaternion.q2,
@@ -372,22 +556,18 @@ void TelemetryImpl::process_attitude_quaternion(const mavlink_message_t &message
         attitude_quaternion.q4
     };
 
-    set_attitude_quaternion(quaternion);
+    set_attitude_quaternion(attitude_quaternion.time_boot_ms, quaternion);
 
-    if (_attitude_quaternion_subscription) {
-        _attitude_quaternion_subscription(get_attitude_quaternion());
-    }
+    notify_subscription(_attitude_quaternion_subscriptions, quaternion);
 
-    if (_attitude_euler_angle_subscription) {
-        _attitude_euler_angle_subscription(get_attitude_euler_angle());
+    // The conversion is only done if someone wants it.
+    if (!_attitude_euler_angle_subscriptions.empty()) {
+        notify_subscription(_attitude_euler_angle_subscriptions, get_attitude_euler_angle());
     }
 }
 
-void TelemetryImpl::process_mount_orientation(const mavlink_message_t &message)
+void TelemetryImpl::process_mount_orientation(const mavlink_mount_orientation_t &mount_orientation)
 {
-    mavlink_mount_orientation_t mount_orientation;
-    mavlink_msg_mount_orientation_decode(&message, &mount_orientation);
-
     Telemetry::EulerAngle euler_angle {
         mount_orientation.roll,
         mount_orientation.pitch,
@@ -396,42 +576,30 @@ void TelemetryImpl::process_mount_orientation(const mavlink_message_t &message)
 
     set_camera_attitude_euler_angle(euler_angle);
 
-    if (_camera_attitude_quaternion_subscription) {
-        _camera_attitude_quaternion_subscription(get_camera_attitude_quaternion());
+    if (!_camera_attitude_quaternion_subscriptions.empty()) {
+        notify_subscription(_camera_attitude_quaternion_subscriptions,
+                            get_camera_attitude_quaternion());
     }
 
-    if (_camera_attitude_euler_angle_subscription) {
-        _camera_attitude_euler_angle_subscription(get_camera_attitude_euler_angle());
-    }
+    notify_subscription(_camera_attitude_euler_angle_subscriptions, euler_angle);
 }
 
-void TelemetryImpl::process_gps_raw_int(const mavlink_message_t &message)
+void TelemetryImpl::process_gps_raw_int(const mavlink_gps_raw_int_t &gps_raw_int)
 {
-    mavlink_gps_raw_int_t gps_raw_int;
-    mavlink_msg_gps_raw_int_decode(&message, &gps_raw_int);
-    set_gps_info({gps_raw_int.satellites_visible,
-                  gps_raw_int.fix_type
-                 });
-
     // TODO: This is just an interim hack, we will have to look at
     //       estimator flags in order to decide if the position
     //       estimate is good enough.
     const bool gps_ok = ((gps_raw_int.fix_type >= 3) && (gps_raw_int.satellites_visible >= 8));
 
-    set_health_global_position(gps_ok);
-    // Local is not different from global for now until things like flow are in place.
-    set_health_local_position(gps_ok);
+    set_gps_info({gps_raw_int.satellites_visible,
+                  gps_raw_int.fix_type
+                 }, gps_ok);
 
-    if (_gps_info_subscription) {
-        _gps_info_subscription(get_gps_info());
-    }
+    notify_subscription(_gps_info_subscriptions, get_gps_info());
 }
 
-void TelemetryImpl::process_extended_sys_state(const mavlink_message_t &message)
+void TelemetryImpl::process_extended_sys_state(const mavlink_extended_sys_state_t &extended_sys_state)
 {
-    mavlink_extended_sys_state_t extended_sys_state;
-    mavlink_msg_extended_sys_state_decode(&message, &extended_sys_state);
-
     if (extended_sys_state.landed_state == MAV_LANDED_STATE_IN_AIR) {
         set_in_air(true);
     } else if (extended_sys_state.landed_state == MAV_LANDED_STATE_ON_GROUND) {
@@ -439,70 +607,149 @@ void TelemetryImpl::process_extended_sys_state(const mavlink_message_t &message)
     }
     // If landed_state is undefined, we use what we have received last.
 
-    if (_in_air_subscription) {
-        _in_air_subscription(in_air());
-    }
+    notify_subscription(_in_air_subscriptions, in_air());
 
 }
 
-void TelemetryImpl::process_sys_status(const mavlink_message_t &message)
+void TelemetryImpl::process_sys_status(const mavlink_sys_status_t &sys_status)
 {
-    mavlink_sys_status_t sys_status;
-    mavlink_msg_sys_status_decode(&message, &sys_status);
     set_battery(Telemetry::Battery({sys_status.voltage_battery * 1e-3f,
                                     // FIXME: it is strange calling it percent when the range goes from 0 to 1.
                                     sys_status.battery_remaining * 1e-2f
                                    }));
 
-    if (_battery_subscription) {
-        _battery_subscription(get_battery());
-    }
+    notify_subscription(_battery_subscriptions, get_battery());
+
+    set_health_sensors(sys_status.onboard_control_sensors_present,
+                       sys_status.onboard_control_sensors_health);
+    notify_health_if_changed();
 }
 
-void TelemetryImpl::process_heartbeat(const mavlink_message_t &message)
+void TelemetryImpl::process_heartbeat(const mavlink_heartbeat_t &heartbeat)
 {
-    mavlink_heartbeat_t heartbeat;
-    mavlink_msg_heartbeat_decode(&message, &heartbeat);
+    const bool has_flight_mode = (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) != 0;
 
-    set_armed(((heartbeat.base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false));
+    set_heartbeat_state(((heartbeat.base_mode & MAV_MODE_FLAG_SAFETY_ARMED) ? true : false),
+                        has_flight_mode,
+                        to_flight_mode_from_custom_mode(heartbeat.custom_mode));
 
-    if (_armed_subscription) {
-        _armed_subscription(armed());
-    }
+    notify_subscription(_armed_subscriptions, armed());
 
-    if (heartbeat.base_mode & MAV_MODE_FLAG_CUSTOM_MODE_ENABLED) {
-
-        Telemetry::FlightMode flight_mode = to_flight_mode_from_custom_mode(heartbeat.custom_mode);
-        set_flight_mode(flight_mode);
-
-        if (_flight_mode_subscription) {
-            _flight_mode_subscription(get_flight_mode());
-        }
+    if (has_flight_mode) {
+        notify_subscription(_flight_mode_subscriptions, get_flight_mode());
     }
 
-    if (_health_subscription) {
-        _health_subscription(get_health());
-    }
-    if (_health_all_ok_subscription) {
-        _health_all_ok_subscription(get_health_all_ok());
-    }
+    notify_health_if_changed();
 }
 
-void TelemetryImpl::process_rc_channels(const mavlink_message_t &message)
+void TelemetryImpl::process_rc_channels(const mavlink_rc_channels_t &rc_channels)
 {
-    mavlink_rc_channels_t rc_channels;
-    mavlink_msg_rc_channels_decode(&message, &rc_channels);
-
     bool rc_ok = (rc_channels.chancount > 0);
     set_rc_status(rc_ok, rc_channels.rssi);
 
-    if (_rc_status_subscription) {
-        _rc_status_subscription(get_rc_status());
-    }
+    notify_subscription(_rc_status_subscriptions, get_rc_status());
 
     _parent->refresh_timeout_handler(_timeout_cookie);
 }
 
+void TelemetryImpl::process_local_position_ned(const mavlink_local_position_ned_t &local_position_ned)
+{
+    const Telemetry::PositionVelocityNED position_velocity_ned {
+        local_position_ned.x,
+        local_position_ned.y,
+        local_position_ned.z,
+        local_position_ned.vx,
+        local_position_ned.vy,
+        local_position_ned.vz
+    };
+    _position_velocity_ned.store(position_velocity_ned);
+
+    _position_velocity_ned_subscriptions.call(position_velocity_ned);
+}
+
+void TelemetryImpl::process_attitude(const mavlink_attitude_t &attitude)
+{
+    const Telemetry::AngularVelocityBody angular_velocity_body {
+        attitude.rollspeed,
+        attitude.pitchspeed,
+        attitude.yawspeed
+    };
+    _attitude_angular_velocity_body.store(angular_velocity_body);
+
+    _attitude_angular_velocity_body_subscriptions.call(angular_velocity_body);
+}
+
+void TelemetryImpl::process_highres_imu(const mavlink_highres_imu_t &highres_imu)
+{
+    const Telemetry::IMU imu {
+        highres_imu.time_usec,
+        highres_imu.xacc,
+        highres_imu.yacc,
+        highres_imu.zacc,
+        highres_imu.xgyro,
+        highres_imu.ygyro,
+        highres_imu.zgyro,
+        highres_imu.xmag,
+        highres_imu.ymag,
+        highres_imu.zmag,
+        highres_imu.abs_pressure,
+        highres_imu.temperature
+    };
+    _imu.store(imu);
+
+    _imu_subscriptions.call(imu);
+}
+
+void TelemetryImpl::process_odometry(const mavlink_message_t &message)
+{
+#ifdef MAVLINK_MSG_ID_ODOMETRY
+    mavlink_odometry_t odometry_message;
+    mavlink_msg_odometry_decode(&message, &odometry_message);
+
+    const Telemetry::Odometry odometry {
+        odometry_message.time_usec,
+        odometry_message.frame_id,
+        odometry_message.child_frame_id,
+        odometry_message.x,
+        odometry_message.y,
+        odometry_message.z,
+        Telemetry::Quaternion {
+            odometry_message.q[0],
+            odometry_message.q[1],
+            odometry_message.q[2],
+            odometry_message.q[3]
+        },
+        odometry_message.vx,
+        odometry_message.vy,
+        odometry_message.vz,
+        Telemetry::AngularVelocityBody {
+            odometry_message.rollspeed,
+            odometry_message.pitchspeed,
+            odometry_message.yawspeed
+        }
+    };
+    _odometry.store(odometry);
+
+    _odometry_subscriptions.call(odometry);
+#else
+    UNUSED(message);
+#endif
+}
+
+void TelemetryImpl::process_actuator_control_target(
+    const mavlink_actuator_control_target_t &actuator_control_target_message)
+{
+    Telemetry::ActuatorControlTarget actuator_control_target;
+    actuator_control_target.group = actuator_control_target_message.group_mlx;
+    static_assert(sizeof(actuator_control_target.controls) ==
+                  sizeof(actuator_control_target_message.controls), "Unexpected number of controls");
+    std::memcpy(actuator_control_target.controls, actuator_control_target_message.controls,
+                sizeof(actuator_control_target.controls));
+    _actuator_control_target.store(actuator_control_target);
+
+    _actuator_control_target_subscriptions.call(actuator_control_target);
+}
+
 Telemetry::FlightMode TelemetryImpl::to_flight_mode_from_custom_mode(uint32_t custom_mode)
 {
     px4::px4_custom_mode px4_custom_mode;
@@ -535,6 +782,25 @@ Telemetry::FlightMode TelemetryImpl::to_flight_mode_from_custom_mode(uint32_t cu
     }
 }
 
+void TelemetryImpl::receive_param_changed(const std::string &name,
+                                          MAVLinkParameters::ParamValue value)
+{
+    if (value.is_int32()) {
+        if (name == "CAL_GYRO0_ID") {
+            receive_param_cal_gyro(true, value.get_int32());
+        } else if (name == "CAL_ACC0_ID") {
+            receive_param_cal_accel(true, value.get_int32());
+        } else if (name == "CAL_MAG0_ID") {
+            receive_param_cal_mag(true, value.get_int32());
+        }
+    }
+#ifdef LEVEL_CALIBRATION
+    if (value.is_float() && name == "SENS_BOARD_X_OFF") {
+        receive_param_cal_level(true, value.get_float());
+    }
+#endif
+}
+
 void TelemetryImpl::receive_param_cal_gyro(bool success, int value)
 {
     if (!success) {
@@ -587,301 +853,930 @@ void TelemetryImpl::receive_rc_channels_timeout()
     set_rc_status(rc_ok, 0.0f);
 }
 
+Telemetry::Snapshot TelemetryImpl::get_snapshot() const
+{
+    PositionState position;
+    HomePositionState home_position;
+    Timed<bool> in_air;
+    HeartbeatState heartbeat;
+    Timed<Telemetry::Quaternion> attitude_quaternion;
+    Timed<Telemetry::EulerAngle> camera_attitude_euler_angle;
+    GPSInfoState gps_info;
+    Timed<Telemetry::Battery> battery;
+    Telemetry::Health calibration_health;
+    Timed<Telemetry::RCStatus> rc_status;
+
+    SeqLockReader reader;
+    do {
+        reader.restart();
+        position = reader.load(_position);
+        home_position = reader.load(_home_position);
+        in_air = reader.load(_in_air);
+        heartbeat = reader.load(_heartbeat);
+        attitude_quaternion = reader.load(_attitude_quaternion);
+        camera_attitude_euler_angle = reader.load(_camera_attitude_euler_angle);
+        gps_info = reader.load(_gps_info);
+        battery = reader.load(_battery);
+        calibration_health = reader.load(_calibration_health);
+        rc_status = reader.load(_rc_status);
+    } while (!reader.is_consistent());
+
+    Telemetry::Snapshot snapshot {};
+    snapshot.position = position.position;
+    snapshot.position_time_us = position.time_us;
+    snapshot.ground_speed_ned = position.ground_speed_ned;
+    snapshot.home_position = home_position.home_position;
+    snapshot.home_position_time_us = home_position.time_us;
+    snapshot.in_air = in_air.value;
+    snapshot.in_air_time_us = in_air.time_us;
+    snapshot.armed = heartbeat.armed;
+    snapshot.flight_mode = heartbeat.flight_mode;
+    snapshot.heartbeat_time_us = heartbeat.time_us;
+    snapshot.attitude_quaternion = attitude_quaternion.value;
+    snapshot.attitude_time_us = attitude_quaternion.time_us;
+    snapshot.camera_attitude_euler_angle = camera_attitude_euler_angle.value;
+    snapshot.camera_attitude_time_us = camera_attitude_euler_angle.time_us;
+    snapshot.gps_info = gps_info.gps_info;
+    snapshot.gps_info_time_us = gps_info.time_us;
+    snapshot.battery = battery.value;
+    snapshot.battery_time_us = battery.time_us;
+    snapshot.health = to_health(calibration_health, gps_info, home_position);
+    snapshot.rc_status = rc_status.value;
+    snapshot.rc_status_time_us = rc_status.time_us;
+    return snapshot;
+}
+
 Telemetry::Position TelemetryImpl::get_position() const
 {
-    std::lock_guard<std::mutex> lock(_position_mutex);
-    return _position;
+    return _position.load().position;
 }
 
-void TelemetryImpl::set_position(Telemetry::Position position)
+Telemetry::Position TelemetryImpl::get_home_position() const
 {
-    std::lock_guard<std::mutex> lock(_position_mutex);
-    _position = position;
+    return _home_position.load().home_position;
 }
 
-Telemetry::Position TelemetryImpl::get_home_position() const
+bool TelemetryImpl::in_air() const
 {
-    std::lock_guard<std::mutex> lock(_home_position_mutex);
-    return _home_position;
+    return _in_air.load().value;
 }
 
-void TelemetryImpl::set_home_position(Telemetry::Position home_position)
+bool TelemetryImpl::armed() const
 {
-    std::lock_guard<std::mutex> lock(_home_position_mutex);
-    _home_position = home_position;
+    return _heartbeat.load().armed;
 }
 
-bool TelemetryImpl::in_air() const
+Telemetry::Quaternion TelemetryImpl::get_attitude_quaternion() const
 {
-    return _in_air;
+    return _attitude_quaternion.load().value;
 }
 
-bool TelemetryImpl::armed() const
+Telemetry::EulerAngle TelemetryImpl::get_attitude_euler_angle() const
 {
-    return _armed;
+    uint32_t version;
+    const auto attitude_quaternion = _attitude_quaternion.load(version);
+
+    const auto cached = _attitude_euler_angle_cache.load();
+    if (cached.version == version) {
+        return cached.value;
+    }
+
+    Telemetry::EulerAngle euler = to_euler_angle_from_quaternion(attitude_quaternion.value);
+    _attitude_euler_angle_cache.store({version, euler});
+
+    return euler;
 }
 
-void TelemetryImpl::set_in_air(bool in_air_new)
+Telemetry::Quaternion TelemetryImpl::get_camera_attitude_quaternion() const
 {
-    _in_air = in_air_new;
+    uint32_t version;
+    const auto camera_attitude_euler_angle = _camera_attitude_euler_angle.load(version);
+
+    const auto cached = _camera_attitude_quaternion_cache.load();
+    if (cached.version == version) {
+        return cached.value;
+    }
+
+    Telemetry::Quaternion quaternion
+        = to_quaternion_from_euler_angle(camera_attitude_euler_angle.value);
+    _camera_attitude_quaternion_cache.store({version, quaternion});
+
+    return quaternion;
 }
 
-void TelemetryImpl::set_armed(bool armed_new)
+Telemetry::EulerAngle TelemetryImpl::get_camera_attitude_euler_angle() const
 {
-    _armed = armed_new;
+    return _camera_attitude_euler_angle.load().value;
 }
 
-Telemetry::Quaternion TelemetryImpl::get_attitude_quaternion() const
+Telemetry::GroundSpeedNED TelemetryImpl::get_ground_speed_ned() const
 {
-    std::lock_guard<std::mutex> lock(_attitude_quaternion_mutex);
-    return _attitude_quaternion;
+    return _position.load().ground_speed_ned;
 }
 
-Telemetry::EulerAngle TelemetryImpl::get_attitude_euler_angle() const
+Telemetry::GPSInfo TelemetryImpl::get_gps_info() const
 {
-    std::lock_guard<std::mutex> lock(_attitude_quaternion_mutex);
-    Telemetry::EulerAngle euler = to_euler_angle_from_quaternion(_attitude_quaternion);
+    return _gps_info.load().gps_info;
+}
 
-    return euler;
+Telemetry::Battery TelemetryImpl::get_battery() const
+{
+    return _battery.load().value;
 }
 
-void TelemetryImpl::set_attitude_quaternion(Telemetry::Quaternion quaternion)
+Telemetry::FlightMode TelemetryImpl::get_flight_mode() const
 {
-    std::lock_guard<std::mutex> lock(_attitude_quaternion_mutex);
-    _attitude_quaternion = quaternion;
+    return _heartbeat.load().flight_mode;
 }
 
-Telemetry::Quaternion TelemetryImpl::get_camera_attitude_quaternion() const
+Telemetry::Health TelemetryImpl::get_health() const
 {
-    std::lock_guard<std::mutex> lock(_camera_attitude_euler_angle_mutex);
-    Telemetry::Quaternion quaternion
-        = to_quaternion_from_euler_angle(_camera_attitude_euler_angle);
+    Telemetry::Health calibration_health;
+    GPSInfoState gps_info;
+    HomePositionState home_position;
 
-    return quaternion;
+    SeqLockReader reader;
+    do {
+        reader.restart();
+        calibration_health = reader.load(_calibration_health);
+        gps_info = reader.load(_gps_info);
+        home_position = reader.load(_home_position);
+    } while (!reader.is_consistent());
+
+    return to_health(calibration_health, gps_info, home_position);
 }
 
-Telemetry::EulerAngle TelemetryImpl::get_camera_attitude_euler_angle() const
+Telemetry::Health TelemetryImpl::to_health(const Telemetry::Health &calibration_health,
+                                           const GPSInfoState &gps_info,
+                                           const HomePositionState &home_position)
 {
-    std::lock_guard<std::mutex> lock(_camera_attitude_euler_angle_mutex);
+    Telemetry::Health health = calibration_health;
+    health.global_position_ok = gps_info.position_ok;
+    // Local is not different from global for now until things like flow are in place.
+    health.local_position_ok = gps_info.position_ok;
+    health.home_position_ok = home_position.ok;
+    return health;
+}
 
-    return _camera_attitude_euler_angle;
+bool TelemetryImpl::get_health_all_ok() const
+{
+    return is_health_all_ok(get_health());
 }
 
-void TelemetryImpl::set_camera_attitude_euler_angle(Telemetry::EulerAngle euler_angle)
+bool TelemetryImpl::is_health_all_ok(const Telemetry::Health &health)
 {
-    std::lock_guard<std::mutex> lock(_camera_attitude_euler_angle_mutex);
-    _camera_attitude_euler_angle = euler_angle;
+    return health.gyrometer_calibration_ok &&
+           health.accelerometer_calibration_ok &&
+           health.magnetometer_calibration_ok &&
+           health.level_calibration_ok &&
+           health.local_position_ok &&
+           health.global_position_ok &&
+           health.home_position_ok;
 }
 
-Telemetry::GroundSpeedNED TelemetryImpl::get_ground_speed_ned() const
+void TelemetryImpl::notify_health_if_changed()
 {
-    std::lock_guard<std::mutex> lock(_ground_speed_ned_mutex);
-    return _ground_speed_ned;
+    const Telemetry::Health health = get_health();
+    const bool health_all_ok = is_health_all_ok(health);
+
+    bool health_changed;
+    bool health_all_ok_changed;
+    {
+        std::lock_guard<std::mutex> lock(_health_mutex);
+        const bool resend = _resend_health;
+        _resend_health = false;
+
+        health_changed = resend || !(health == _last_notified_health);
+        health_all_ok_changed = resend || health_all_ok != _last_notified_health_all_ok;
+        _last_notified_health = health;
+        _last_notified_health_all_ok = health_all_ok;
+    }
+
+    if (health_changed) {
+        notify_subscription(_health_subscriptions, health);
+    }
+    if (health_all_ok_changed) {
+        notify_subscription(_health_all_ok_subscriptions, health_all_ok);
+    }
 }
 
-void TelemetryImpl::set_ground_speed_ned(Telemetry::GroundSpeedNED ground_speed_ned)
+void TelemetryImpl::resend_health()
 {
-    std::lock_guard<std::mutex> lock(_ground_speed_ned_mutex);
-    _ground_speed_ned = ground_speed_ned;
+    std::lock_guard<std::mutex> lock(_health_mutex);
+    _resend_health = true;
 }
 
-Telemetry::GPSInfo TelemetryImpl::get_gps_info() const
+Telemetry::RCStatus TelemetryImpl::get_rc_status() const
 {
-    std::lock_guard<std::mutex> lock(_gps_info_mutex);
-    return _gps_info;
+    return _rc_status.load().value;
 }
 
-void TelemetryImpl::set_gps_info(Telemetry::GPSInfo gps_info)
+Telemetry::PositionVelocityNED TelemetryImpl::get_position_velocity_ned() const
 {
-    std::lock_guard<std::mutex> lock(_gps_info_mutex);
-    _gps_info = gps_info;
+    return _position_velocity_ned.load();
 }
 
-Telemetry::Battery TelemetryImpl::get_battery() const
+Telemetry::AngularVelocityBody TelemetryImpl::get_attitude_angular_velocity_body() const
 {
-    std::lock_guard<std::mutex> lock(_battery_mutex);
-    return _battery;
+    return _attitude_angular_velocity_body.load();
 }
 
-void TelemetryImpl::set_battery(Telemetry::Battery battery)
+Telemetry::IMU TelemetryImpl::get_imu() const
 {
-    std::lock_guard<std::mutex> lock(_battery_mutex);
-    _battery = battery;
+    return _imu.load();
 }
 
-Telemetry::FlightMode TelemetryImpl::get_flight_mode() const
+Telemetry::Odometry TelemetryImpl::get_odometry() const
 {
-    std::lock_guard<std::mutex> lock(_flight_mode_mutex);
-    return _flight_mode;
+    return _odometry.load();
 }
 
-void TelemetryImpl::set_flight_mode(Telemetry::FlightMode flight_mode)
+Telemetry::ActuatorControlTarget TelemetryImpl::get_actuator_control_target() const
 {
-    std::lock_guard<std::mutex> lock(_flight_mode_mutex);
-    _flight_mode = flight_mode;
+    return _actuator_control_target.load();
 }
 
-Telemetry::Health TelemetryImpl::get_health() const
+void TelemetryImpl::set_history_capacity(size_t num_samples)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    return _health;
+    _position_history.set_capacity(num_samples);
+    _attitude_quaternion_history.set_capacity(num_samples);
 }
 
-bool TelemetryImpl::get_health_all_ok() const
+void TelemetryImpl::get_position_history(uint64_t since_us,
+                                         std::vector<Telemetry::PositionSample> &samples) const
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    if (_health.gyrometer_calibration_ok &&
-        _health.accelerometer_calibration_ok &&
-        _health.magnetometer_calibration_ok &&
-        _health.level_calibration_ok &&
-        _health.local_position_ok &&
-        _health.global_position_ok &&
-        _health.home_position_ok) {
-        return true;
-    } else {
+    samples.clear();
+    _position_history.for_each_since(since_us, [&samples](uint64_t time_us,
+    const double (&fields)[4]) {
+        samples.push_back(Telemetry::PositionSample {time_us, to_position(fields)});
+    });
+}
+
+void TelemetryImpl::get_attitude_quaternion_history(
+    uint64_t since_us, std::vector<Telemetry::QuaternionSample> &samples) const
+{
+    samples.clear();
+    _attitude_quaternion_history.for_each_since(since_us, [&samples](uint64_t time_us,
+    const double (&fields)[4]) {
+        samples.push_back(Telemetry::QuaternionSample {time_us, to_quaternion(fields)});
+    });
+}
+
+void TelemetryImpl::get_position_history_columns(uint64_t since_us,
+                                                 Telemetry::PositionColumns &columns) const
+{
+    columns.time_us.clear();
+    columns.latitude_deg.clear();
+    columns.longitude_deg.clear();
+    columns.absolute_altitude_m.clear();
+    columns.relative_altitude_m.clear();
+    _position_history.for_each_block_since(since_us, [&columns](const uint64_t *time_us,
+    const double *const *fields, size_t num_samples) {
+        columns.time_us.insert(columns.time_us.end(), time_us, time_us + num_samples);
+        columns.latitude_deg.insert(columns.latitude_deg.end(), fields[0],
+                                    fields[0] + num_samples);
+        columns.longitude_deg.insert(columns.longitude_deg.end(), fields[1],
+                                     fields[1] + num_samples);
+        columns.absolute_altitude_m.insert(columns.absolute_altitude_m.end(), fields[2],
+                                           fields[2] + num_samples);
+        columns.relative_altitude_m.insert(columns.relative_altitude_m.end(), fields[3],
+                                           fields[3] + num_samples);
+    });
+}
+
+void TelemetryImpl::get_attitude_quaternion_history_columns(
+    uint64_t since_us, Telemetry::QuaternionColumns &columns) const
+{
+    columns.time_us.clear();
+    columns.w.clear();
+    columns.x.clear();
+    columns.y.clear();
+    columns.z.clear();
+    _attitude_quaternion_history.for_each_block_since(since_us, [&columns](
+    const uint64_t *time_us, const double *const *fields, size_t num_samples) {
+        columns.time_us.insert(columns.time_us.end(), time_us, time_us + num_samples);
+        columns.w.insert(columns.w.end(), fields[0], fields[0] + num_samples);
+        columns.x.insert(columns.x.end(), fields[1], fields[1] + num_samples);
+        columns.y.insert(columns.y.end(), fields[2], fields[2] + num_samples);
+        columns.z.insert(columns.z.end(), fields[3], fields[3] + num_samples);
+    });
+}
+
+void TelemetryImpl::get_attitude_euler_angle_history(
+    uint64_t since_us, std::vector<Telemetry::EulerAngleSample> &samples) const
+{
+    // Copy out field by field first, so all samples can be converted in one go.
+    std::vector<float> w, x, y, z;
+    samples.clear();
+    _attitude_quaternion_history.for_each_since(since_us, [&](uint64_t time_us,
+    const double (&fields)[4]) {
+        samples.push_back(Telemetry::EulerAngleSample {time_us, {}});
+        w.push_back(float(fields[0]));
+        x.push_back(float(fields[1]));
+        y.push_back(float(fields[2]));
+        z.push_back(float(fields[3]));
+    });
+
+    std::vector<float> roll_deg(samples.size()), pitch_deg(samples.size()),
+        yaw_deg(samples.size());
+    to_euler_angles_from_quaternions(w.data(), x.data(), y.data(), z.data(), samples.size(),
+                                     roll_deg.data(), pitch_deg.data(), yaw_deg.data());
+
+    for (size_t i = 0; i < samples.size(); ++i) {
+        samples[i].euler_angle = Telemetry::EulerAngle {roll_deg[i], pitch_deg[i], yaw_deg[i]};
+    }
+}
+
+bool TelemetryImpl::get_position_at(uint64_t time_us, Telemetry::Position &position) const
+{
+    uint64_t before_time_us, after_time_us;
+    double before[4], after[4];
+    if (!_position_history.get_bracket(time_us, before_time_us, before, after_time_us, after)) {
         return false;
     }
+
+    const double t = get_interpolation_factor(time_us, before_time_us, after_time_us);
+    double fields[4];
+    for (unsigned i = 0; i < 4; ++i) {
+        fields[i] = before[i] + t * (after[i] - before[i]);
+    }
+    position = to_position(fields);
+    return true;
 }
 
-Telemetry::RCStatus TelemetryImpl::get_rc_status() const
+bool TelemetryImpl::get_attitude_quaternion_at(uint64_t time_us,
+                                               Telemetry::Quaternion &quaternion) const
 {
-    std::lock_guard<std::mutex> lock(_rc_status_mutex);
-    return _rc_status;
+    uint64_t before_time_us, after_time_us;
+    double before[4], after[4];
+    if (!_attitude_quaternion_history.get_bracket(time_us, before_time_us, before,
+                                                  after_time_us, after)) {
+        return false;
+    }
+
+    quaternion = interpolate_quaternion(
+                     to_quaternion(before), to_quaternion(after),
+                     get_interpolation_factor(time_us, before_time_us, after_time_us));
+    return true;
 }
 
-void TelemetryImpl::set_health_local_position(bool ok)
+double TelemetryImpl::get_interpolation_factor(uint64_t time_us, uint64_t before_time_us,
+                                               uint64_t after_time_us)
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.local_position_ok = ok;
+    if (after_time_us <= before_time_us) {
+        return 0.0;
+    }
+    return double(time_us - before_time_us) / double(after_time_us - before_time_us);
 }
 
-void TelemetryImpl::set_health_global_position(bool ok)
+Telemetry::Position TelemetryImpl::to_position(const double (&fields)[4])
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.global_position_ok = ok;
+    return Telemetry::Position {fields[0], fields[1], float(fields[2]), float(fields[3])};
 }
 
-void TelemetryImpl::set_health_home_position(bool ok)
+Telemetry::Quaternion TelemetryImpl::to_quaternion(const double (&fields)[4])
 {
-    std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.home_position_ok = ok;
+    return Telemetry::Quaternion {
+        float(fields[0]), float(fields[1]), float(fields[2]), float(fields[3])
+    };
+}
+
+uint64_t TelemetryImpl::now_us()
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                        _parent->get_receive_time().time_since_epoch()).count());
+}
+
+uint64_t TelemetryImpl::sample_time_us(uint32_t time_boot_ms)
+{
+    const uint64_t received_us = now_us();
+    const int64_t remote_ns = int64_t(time_boot_ms) * 1000000;
+
+    Timesync &timesync = _parent->get_timesync();
+    timesync.add_message_time(remote_ns, int64_t(received_us) * 1000);
+
+    int64_t local_ns;
+    if (!timesync.remote_to_local_ns(remote_ns, local_ns) || local_ns < 0) {
+        return received_us;
+    }
+    // It can't have been measured after it arrived, whatever the estimate says.
+    return std::min(uint64_t(local_ns / 1000), received_us);
+}
+
+double TelemetryImpl::get_latency_s() const
+{
+    return _parent->get_timesync().get_latency_s();
+}
+
+void TelemetryImpl::set_position_and_ground_speed_ned(uint32_t time_boot_ms,
+                                                      Telemetry::Position position,
+                                                      Telemetry::GroundSpeedNED ground_speed_ned)
+{
+    const uint64_t time_us = now_us();
+
+    const double position_fields[4] = {
+        position.latitude_deg, position.longitude_deg,
+        double(position.absolute_altitude_m), double(position.relative_altitude_m)
+    };
+    _position_history.add(sample_time_us(time_boot_ms), position_fields);
+
+    _position.store({position, ground_speed_ned, time_us});
+}
+
+void TelemetryImpl::set_home_position(Telemetry::Position home_position)
+{
+    const uint64_t time_us = now_us();
+    _home_position.store({home_position, true, time_us});
+}
+
+void TelemetryImpl::set_in_air(bool in_air_new)
+{
+    const uint64_t time_us = now_us();
+    _in_air.store({in_air_new, time_us});
+}
+
+void TelemetryImpl::set_heartbeat_state(bool armed_new, bool has_flight_mode,
+                                        Telemetry::FlightMode flight_mode)
+{
+    const uint64_t time_us = now_us();
+    _heartbeat.update([&](HeartbeatState &heartbeat) {
+        heartbeat.armed = armed_new;
+        if (has_flight_mode) {
+            heartbeat.flight_mode = flight_mode;
+        }
+        heartbeat.time_us = time_us;
+    });
+}
+
+void TelemetryImpl::set_attitude_quaternion(uint32_t time_boot_ms,
+                                            Telemetry::Quaternion quaternion)
+{
+    const uint64_t time_us = now_us();
+
+    const double quaternion_fields[4] = {
+        double(quaternion.w), double(quaternion.x), double(quaternion.y), double(quaternion.z)
+    };
+    _attitude_quaternion_history.add(sample_time_us(time_boot_ms), quaternion_fields);
+
+    _attitude_quaternion.store({quaternion, time_us});
+}
+
+void TelemetryImpl::set_camera_attitude_euler_angle(Telemetry::EulerAngle euler_angle)
+{
+    const uint64_t time_us = now_us();
+    _camera_attitude_euler_angle.store({euler_angle, time_us});
+}
+
+void TelemetryImpl::set_gps_info(Telemetry::GPSInfo gps_info, bool position_ok)
+{
+    const uint64_t time_us = now_us();
+    _gps_info.store({gps_info, position_ok, time_us});
+}
+
+void TelemetryImpl::set_battery(Telemetry::Battery battery)
+{
+    const uint64_t time_us = now_us();
+    _battery.store({battery, time_us});
 }
 
 void TelemetryImpl::set_health_gyrometer_calibration(bool ok)
 {
     std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.gyrometer_calibration_ok = ok;
+    _calibration_inputs.gyrometer_param_ok = ok;
+    update_calibration_health();
 }
 
 void TelemetryImpl::set_health_accelerometer_calibration(bool ok)
 {
     std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.accelerometer_calibration_ok = ok;
+    _calibration_inputs.accelerometer_param_ok = ok;
+    update_calibration_health();
 }
 
 void TelemetryImpl::set_health_magnetometer_calibration(bool ok)
 {
     std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.magnetometer_calibration_ok = ok;
+    _calibration_inputs.magnetometer_param_ok = ok;
+    update_calibration_health();
 }
 
 void TelemetryImpl::set_health_level_calibration(bool ok)
 {
     std::lock_guard<std::mutex> lock(_health_mutex);
-    _health.level_calibration_ok = ok;
+    _calibration_inputs.level_param_ok = ok;
+    update_calibration_health();
 }
 
-void TelemetryImpl::set_rc_status(bool available, float signal_strength_percent)
+void TelemetryImpl::set_health_sensors(uint32_t sensors_present, uint32_t sensors_health)
 {
-    std::lock_guard<std::mutex> lock(_rc_status_mutex);
-
-    if (available) {
-        _rc_status.available_once = true;
-        _rc_status.signal_strength_percent = signal_strength_percent;
-    } else {
-        _rc_status.signal_strength_percent = 0.0f;
+    std::lock_guard<std::mutex> lock(_health_mutex);
+    // SYS_STATUS comes with every battery update, most of the time nothing changed.
+    if (sensors_present == _calibration_inputs.sensors_present &&
+        sensors_health == _calibration_inputs.sensors_health) {
+        return;
     }
+    _calibration_inputs.sensors_present = sensors_present;
+    _calibration_inputs.sensors_health = sensors_health;
+    update_calibration_health();
+}
+
+void TelemetryImpl::update_calibration_health()
+{
+    const CalibrationInputs &inputs = _calibration_inputs;
 
-    _rc_status.available = available;
+    // A sensor the autopilot doesn't report on counts as healthy, the
+    // calibration params have the final say then.
+    auto sensor_ok = [&inputs](uint32_t sensor) {
+        return (inputs.sensors_present & sensor) == 0 || (inputs.sensors_health & sensor) != 0;
+    };
+
+    const bool gyrometer_ok =
+        inputs.gyrometer_param_ok && sensor_ok(MAV_SYS_STATUS_SENSOR_3D_GYRO);
+    const bool accelerometer_ok =
+        inputs.accelerometer_param_ok && sensor_ok(MAV_SYS_STATUS_SENSOR_3D_ACCEL);
+    const bool magnetometer_ok =
+        inputs.magnetometer_param_ok && sensor_ok(MAV_SYS_STATUS_SENSOR_3D_MAG);
+    const bool level_ok = inputs.level_param_ok;
 
+    _calibration_health.update([&](Telemetry::Health &health) {
+        health.gyrometer_calibration_ok = gyrometer_ok;
+        health.accelerometer_calibration_ok = accelerometer_ok;
+        health.magnetometer_calibration_ok = magnetometer_ok;
+        health.level_calibration_ok = level_ok;
+    });
+}
+
+void TelemetryImpl::set_rc_status(bool available, float signal_strength_percent)
+{
+    const uint64_t time_us = now_us();
+    _rc_status.update([&](Timed<Telemetry::RCStatus> &rc_status) {
+        if (available) {
+            rc_status.value.available_once = true;
+            rc_status.value.signal_strength_percent = signal_strength_percent;
+        } else {
+            rc_status.value.signal_strength_percent = 0.0f;
+        }
+
+        rc_status.value.available = available;
+        rc_status.time_us = time_us;
+    });
 }
 
 void TelemetryImpl::position_async(Telemetry::position_callback_t &callback)
 {
-    _position_subscription = callback;
+    _position_subscriptions.set(callback);
 }
 
 void TelemetryImpl::home_position_async(Telemetry::position_callback_t &callback)
 {
-    _home_position_subscription = callback;
+    _home_position_subscriptions.set(callback);
 }
 
 void TelemetryImpl::in_air_async(Telemetry::in_air_callback_t &callback)
 {
-    _in_air_subscription = callback;
+    _in_air_subscriptions.set(callback);
 }
 
 void TelemetryImpl::armed_async(Telemetry::armed_callback_t &callback)
 {
-    _armed_subscription = callback;
+    _armed_subscriptions.set(callback);
 }
 
 void TelemetryImpl::attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t &callback)
 {
-    _attitude_quaternion_subscription = callback;
+    _attitude_quaternion_subscriptions.set(callback);
 }
 
 void TelemetryImpl::attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t
                                                &callback)
 {
-    _attitude_euler_angle_subscription = callback;
+    _attitude_euler_angle_subscriptions.set(callback);
 }
 
 void TelemetryImpl::camera_attitude_quaternion_async(Telemetry::attitude_quaternion_callback_t
                                                      &callback)
 {
-    _camera_attitude_quaternion_subscription = callback;
+    _camera_attitude_quaternion_subscriptions.set(callback);
 }
 
 void TelemetryImpl::camera_attitude_euler_angle_async(Telemetry::attitude_euler_angle_callback_t
                                                       &callback)
 {
-    _camera_attitude_euler_angle_subscription = callback;
+    _camera_attitude_euler_angle_subscriptions.set(callback);
 }
 
 void TelemetryImpl::ground_speed_ned_async(Telemetry::ground_speed_ned_callback_t &callback)
 {
-    _ground_speed_ned_subscription = callback;
+    _ground_speed_ned_subscriptions.set(callback);
 }
 
 void TelemetryImpl::gps_info_async(Telemetry::gps_info_callback_t &callback)
 {
-    _gps_info_subscription = callback;
+    _gps_info_subscriptions.set(callback);
 }
 
 void TelemetryImpl::battery_async(Telemetry::battery_callback_t &callback)
 {
-    _battery_subscription = callback;
+    _battery_subscriptions.set(callback);
 }
 
 void TelemetryImpl::flight_mode_async(Telemetry::flight_mode_callback_t &callback)
 {
-    _flight_mode_subscription = callback;
+    _flight_mode_subscriptions.set(callback);
 }
 
 void TelemetryImpl::health_async(Telemetry::health_callback_t &callback)
 {
-    _health_subscription = callback;
+    _health_subscriptions.set(callback);
+    resend_health();
 }
 
 void TelemetryImpl::health_all_ok_async(Telemetry::health_all_ok_callback_t &callback)
 {
-    _health_all_ok_subscription = callback;
+    _health_all_ok_subscriptions.set(callback);
+    resend_health();
 }
 
 void TelemetryImpl::rc_status_async(Telemetry::rc_status_callback_t &callback)
 {
-    _rc_status_subscription = callback;
+    _rc_status_subscriptions.set(callback);
+}
+
+void TelemetryImpl::position_velocity_ned_async(
+    Telemetry::position_velocity_ned_callback_t &callback)
+{
+    _position_velocity_ned_subscriptions.set(callback);
+}
+
+void TelemetryImpl::attitude_angular_velocity_body_async(
+    Telemetry::attitude_angular_velocity_body_callback_t &callback)
+{
+    _attitude_angular_velocity_body_subscriptions.set(callback);
+}
+
+void TelemetryImpl::imu_async(Telemetry::imu_callback_t &callback)
+{
+    _imu_subscriptions.set(callback);
+}
+
+void TelemetryImpl::odometry_async(Telemetry::odometry_callback_t &callback)
+{
+    _odometry_subscriptions.set(callback);
+}
+
+void TelemetryImpl::actuator_control_target_async(
+    Telemetry::actuator_control_target_callback_t &callback)
+{
+    _actuator_control_target_subscriptions.set(callback);
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_position(
+    Telemetry::position_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _position_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_GLOBAL_POSITION_INT);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_home_position(
+    Telemetry::position_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _home_position_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_HOME_POSITION);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_in_air(
+    Telemetry::in_air_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _in_air_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_EXTENDED_SYS_STATE);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_armed(
+    Telemetry::armed_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _armed_subscriptions.add(handle, callback);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_attitude_quaternion(
+    Telemetry::attitude_quaternion_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _attitude_quaternion_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_ATTITUDE_QUATERNION);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_attitude_euler_angle(
+    Telemetry::attitude_euler_angle_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _attitude_euler_angle_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_ATTITUDE_QUATERNION);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_camera_attitude_quaternion(
+    Telemetry::attitude_quaternion_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _camera_attitude_quaternion_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_MOUNT_ORIENTATION);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_camera_attitude_euler_angle(
+    Telemetry::attitude_euler_angle_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _camera_attitude_euler_angle_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_MOUNT_ORIENTATION);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_ground_speed_ned(
+    Telemetry::ground_speed_ned_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _ground_speed_ned_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_GLOBAL_POSITION_INT);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_gps_info(
+    Telemetry::gps_info_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _gps_info_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_GPS_RAW_INT);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_battery(
+    Telemetry::battery_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _battery_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_SYS_STATUS);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_flight_mode(
+    Telemetry::flight_mode_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _flight_mode_subscriptions.add(handle, callback);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_health(
+    Telemetry::health_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _health_subscriptions.add(handle, callback);
+    resend_health();
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_health_all_ok(
+    Telemetry::health_all_ok_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _health_all_ok_subscriptions.add(handle, callback);
+    resend_health();
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_rc_status(
+    Telemetry::rc_status_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _rc_status_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_RC_CHANNELS);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_position_velocity_ned(
+    Telemetry::position_velocity_ned_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _position_velocity_ned_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_LOCAL_POSITION_NED);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_attitude_angular_velocity_body(
+    Telemetry::attitude_angular_velocity_body_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _attitude_angular_velocity_body_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_ATTITUDE);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_imu(
+    Telemetry::imu_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _imu_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_HIGHRES_IMU);
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_odometry(
+    Telemetry::odometry_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _odometry_subscriptions.add(handle, callback);
+#ifdef MAVLINK_MSG_ID_ODOMETRY
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_ODOMETRY);
+#endif
+    return handle;
+}
+
+Telemetry::subscription_handle_t TelemetryImpl::subscribe_actuator_control_target(
+    Telemetry::actuator_control_target_callback_t &callback)
+{
+    const auto handle = _next_subscription_handle++;
+    _actuator_control_target_subscriptions.add(handle, callback);
+    add_rate_subscriber(handle, MAVLINK_MSG_ID_ACTUATOR_CONTROL_TARGET);
+    return handle;
+}
+
+bool TelemetryImpl::unsubscribe(Telemetry::subscription_handle_t handle)
+{
+    // Handle 0 belongs to ..._async() and can't be removed this way.
+    if (handle == 0) {
+        return false;
+    }
+
+    const bool found = _position_subscriptions.remove(handle) ||
+                       _home_position_subscriptions.remove(handle) ||
+                       _in_air_subscriptions.remove(handle) ||
+                       _armed_subscriptions.remove(handle) ||
+                       _attitude_quaternion_subscriptions.remove(handle) ||
+                       _attitude_euler_angle_subscriptions.remove(handle) ||
+                       _camera_attitude_quaternion_subscriptions.remove(handle) ||
+                       _camera_attitude_euler_angle_subscriptions.remove(handle) ||
+                       _ground_speed_ned_subscriptions.remove(handle) ||
+                       _gps_info_subscriptions.remove(handle) ||
+                       _battery_subscriptions.remove(handle) ||
+                       _flight_mode_subscriptions.remove(handle) ||
+                       _health_subscriptions.remove(handle) ||
+                       _health_all_ok_subscriptions.remove(handle) ||
+                       _rc_status_subscriptions.remove(handle) ||
+                       _position_velocity_ned_subscriptions.remove(handle) ||
+                       _attitude_angular_velocity_body_subscriptions.remove(handle) ||
+                       _imu_subscriptions.remove(handle) ||
+                       _odometry_subscriptions.remove(handle) ||
+                       _actuator_control_target_subscriptions.remove(handle);
+
+    uint32_t message_id;
+    double rate_hz;
+    if (_message_rates.remove_subscriber(handle, message_id, rate_hz)) {
+        send_negotiated_msg_rate(message_id, rate_hz);
+    }
+
+    return found;
+}
+
+void TelemetryImpl::set_conflate_subscriptions(bool enable)
+{
+    _conflate_subscriptions = enable;
+}
+
+bool TelemetryImpl::set_subscription_deadband(Telemetry::subscription_handle_t handle,
+                                              double deadband)
+{
+    if (handle == 0 || std::isnan(deadband)) {
+        return false;
+    }
+
+    // IMU, odometry and actuator control target change with every message anyway.
+    return set_deadband_filter(_position_subscriptions, handle, deadband) ||
+           set_deadband_filter(_home_position_subscriptions, handle, deadband) ||
+           set_deadband_filter(_in_air_subscriptions, handle, deadband) ||
+           set_deadband_filter(_armed_subscriptions, handle, deadband) ||
+           set_deadband_filter(_attitude_quaternion_subscriptions, handle, deadband) ||
+           set_deadband_filter(_attitude_euler_angle_subscriptions, handle, deadband) ||
+           set_deadband_filter(_camera_attitude_quaternion_subscriptions, handle, deadband) ||
+           set_deadband_filter(_camera_attitude_euler_angle_subscriptions, handle, deadband) ||
+           set_deadband_filter(_ground_speed_ned_subscriptions, handle, deadband) ||
+           set_deadband_filter(_gps_info_subscriptions, handle, deadband) ||
+           set_deadband_filter(_battery_subscriptions, handle, deadband) ||
+           set_deadband_filter(_flight_mode_subscriptions, handle, deadband) ||
+           set_deadband_filter(_health_subscriptions, handle, deadband) ||
+           set_deadband_filter(_health_all_ok_subscriptions, handle, deadband) ||
+           set_deadband_filter(_rc_status_subscriptions, handle, deadband) ||
+           set_deadband_filter(_position_velocity_ned_subscriptions, handle, deadband) ||
+           set_deadband_filter(_attitude_angular_velocity_body_subscriptions, handle, deadband);
 }
 
 } // namespace dronecore
@@ -7,6 +7,11 @@
 #include "system.h"
 #include "mavlink_system.h"
 #include "mavlink_include.h"
+#include "seqlock.h"
+#include "subscriber_list.h"
+#include "deadband.h"
+#include "message_rates.h"
+#include "telemetry_history.h"
 
 // Since not all vehicles support/require level calibration, this
 // is disabled for now.
@@ -37,6 +42,11 @@ public:
     Telemetry::Result set_rate_gps_info(double rate_hz);
     Telemetry::Result set_rate_battery(double rate_hz);
     Telemetry::Result set_rate_rc_status(double rate_hz);
+    Telemetry::Result set_rate_position_velocity_ned(double rate_hz);
+    Telemetry::Result set_rate_attitude_angular_velocity_body(double rate_hz);
+    Telemetry::Result set_rate_imu(double rate_hz);
+    Telemetry::Result set_rate_odometry(double rate_hz);
+    Telemetry::Result set_rate_actuator_control_target(double rate_hz);
 
     void set_rate_position_async(double rate_hz, Telemetry::result_callback_t callback);
     void set_rate_home_position_async(double rate_hz, Telemetry::result_callback_t callback);
@@ -47,6 +57,14 @@ public:
     void set_rate_gps_info_async(double rate_hz, Telemetry::result_callback_t callback);
     void set_rate_battery_async(double rate_hz, Telemetry::result_callback_t callback);
     void set_rate_rc_status_async(double rate_hz, Telemetry::result_callback_t callback);
+    void set_rate_position_velocity_ned_async(double rate_hz,
+                                              Telemetry::result_callback_t callback);
+    void set_rate_attitude_angular_velocity_body_async(double rate_hz,
+                                                       Telemetry::result_callback_t callback);
+    void set_rate_imu_async(double rate_hz, Telemetry::result_callback_t callback);
+    void set_rate_odometry_async(double rate_hz, Telemetry::result_callback_t callback);
+    void set_rate_actuator_control_target_async(double rate_hz,
+                                                Telemetry::result_callback_t callback);
 
     Telemetry::Position get_position() const;
     Telemetry::Position get_home_position() const;
@@ -63,6 +81,27 @@ public:
     Telemetry::Health get_health() const;
     bool get_health_all_ok() const;
     Telemetry::RCStatus get_rc_status() const;
+    Telemetry::Snapshot get_snapshot() const;
+
+    void set_history_capacity(size_t num_samples);
+    void get_position_history(uint64_t since_us,
+                              std::vector<Telemetry::PositionSample> &samples) const;
+    void get_attitude_quaternion_history(uint64_t since_us,
+                                         std::vector<Telemetry::QuaternionSample> &samples) const;
+    void get_attitude_euler_angle_history(uint64_t since_us,
+                                          std::vector<Telemetry::EulerAngleSample> &samples) const;
+    void get_position_history_columns(uint64_t since_us,
+                                      Telemetry::PositionColumns &columns) const;
+    void get_attitude_quaternion_history_columns(uint64_t since_us,
+                                                 Telemetry::QuaternionColumns &columns) const;
+    bool get_position_at(uint64_t time_us, Telemetry::Position &position) const;
+    bool get_attitude_quaternion_at(uint64_t time_us, Telemetry::Quaternion &quaternion) const;
+    double get_latency_s() const;
+    Telemetry::PositionVelocityNED get_position_velocity_ned() const;
+    Telemetry::AngularVelocityBody get_attitude_angular_velocity_body() const;
+    Telemetry::IMU get_imu() const;
+    Telemetry::Odometry get_odometry() const;
+    Telemetry::ActuatorControlTarget get_actuator_control_target() const;
 
     void position_async(Telemetry::position_callback_t &callback);
     void home_position_async(Telemetry::position_callback_t &callback);
@@ -79,36 +118,130 @@ public:
     void health_async(Telemetry::health_callback_t &callback);
     void health_all_ok_async(Telemetry::health_all_ok_callback_t &callback);
     void rc_status_async(Telemetry::rc_status_callback_t &callback);
+    void position_velocity_ned_async(Telemetry::position_velocity_ned_callback_t &callback);
+    void attitude_angular_velocity_body_async(
+        Telemetry::attitude_angular_velocity_body_callback_t &callback);
+    void imu_async(Telemetry::imu_callback_t &callback);
+    void odometry_async(Telemetry::odometry_callback_t &callback);
+    void actuator_control_target_async(Telemetry::actuator_control_target_callback_t &callback);
+
+    Telemetry::subscription_handle_t subscribe_position(Telemetry::position_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_home_position(Telemetry::position_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_in_air(Telemetry::in_air_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_armed(Telemetry::armed_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_attitude_quaternion(Telemetry::attitude_quaternion_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_attitude_euler_angle(Telemetry::attitude_euler_angle_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_camera_attitude_quaternion(Telemetry::attitude_quaternion_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_camera_attitude_euler_angle(Telemetry::attitude_euler_angle_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_ground_speed_ned(Telemetry::ground_speed_ned_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_gps_info(Telemetry::gps_info_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_battery(Telemetry::battery_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_flight_mode(Telemetry::flight_mode_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_health(Telemetry::health_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_health_all_ok(Telemetry::health_all_ok_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_rc_status(Telemetry::rc_status_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_position_velocity_ned(Telemetry::position_velocity_ned_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_attitude_angular_velocity_body(Telemetry::attitude_angular_velocity_body_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_imu(Telemetry::imu_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_odometry(Telemetry::odometry_callback_t &callback);
+    Telemetry::subscription_handle_t subscribe_actuator_control_target(Telemetry::actuator_control_target_callback_t &callback);
+    bool unsubscribe(Telemetry::subscription_handle_t handle);
+    Telemetry::Result set_subscription_rate(Telemetry::subscription_handle_t handle,
+                                            double rate_hz);
+    void set_subscription_rate_async(Telemetry::subscription_handle_t handle, double rate_hz,
+                                     Telemetry::result_callback_t callback);
+
+    void set_conflate_subscriptions(bool enable);
+    bool set_subscription_deadband(Telemetry::subscription_handle_t handle, double deadband);
 
 private:
-    void set_position(Telemetry::Position position);
+    // Used by set_rate_...(), sends the highest rate asked for by anyone.
+    Telemetry::Result request_msg_rate(uint16_t message_id, double rate_hz);
+    void request_msg_rate_async(uint16_t message_id, double rate_hz,
+                                const Telemetry::result_callback_t &callback);
+    void send_negotiated_msg_rate(uint32_t message_id, double rate_hz);
+    // A stopped message is started again for the new subscriber.
+    void add_rate_subscriber(Telemetry::subscription_handle_t handle, uint32_t message_id);
+
+    // Decimates the updates of a subscriber before they are called or queued.
+    bool set_subscriber_max_rate(Telemetry::subscription_handle_t handle, double rate_hz);
+
+    template<typename T>
+    static bool set_deadband_filter(SubscriberList<T> &subscriptions,
+                                    Telemetry::subscription_handle_t handle, double deadband)
+    {
+        return subscriptions.set_filter(handle, (deadband < 0.0) ? nullptr :
+                                        make_deadband_filter<T>(deadband));
+    }
+
+    // Calls the subscription directly or, if conflating, queues it so that only
+    // the latest value is delivered if the subscriber can't keep up.
+    template<typename T>
+    void notify_subscription(const SubscriberList<T> &subscriptions, T value)
+    {
+        if (subscriptions.empty()) {
+            return;
+        }
+
+        if (!_conflate_subscriptions) {
+            subscriptions.call(value);
+            return;
+        }
+
+        // Each subscriber gets its own slot, identified by its address.
+        const auto subscribers = subscriptions.get();
+        for (const auto &subscriber : *subscribers) {
+            // Filtered here already, so nothing is queued for it.
+            if (!subscriber->wants(value)) {
+                continue;
+            }
+            _parent->call_user_callback([subscriber, value]() {
+                subscriber->callback(value);
+            }, subscriber.get(), CallbackExecutor::Policy::COALESCE);
+        }
+    }
+
+    // Values received together are set together, so that a snapshot never
+    // contains parts of different messages.
+    void set_position_and_ground_speed_ned(uint32_t time_boot_ms,
+                                           Telemetry::Position position,
+                                           Telemetry::GroundSpeedNED ground_speed_ned);
     void set_home_position(Telemetry::Position home_position);
     void set_in_air(bool in_air);
-    void set_armed(bool armed);
-    void set_attitude_quaternion(Telemetry::Quaternion quaternion);
+    void set_heartbeat_state(bool armed, bool has_flight_mode, Telemetry::FlightMode flight_mode);
+    void set_attitude_quaternion(uint32_t time_boot_ms, Telemetry::Quaternion quaternion);
     void set_camera_attitude_euler_angle(Telemetry::EulerAngle euler_angle);
-    void set_ground_speed_ned(Telemetry::GroundSpeedNED ground_speed_ned);
-    void set_gps_info(Telemetry::GPSInfo gps_info);
+    void set_gps_info(Telemetry::GPSInfo gps_info, bool position_ok);
     void set_battery(Telemetry::Battery battery);
-    void set_flight_mode(Telemetry::FlightMode flight_mode);
-    void set_health_local_position(bool ok);
-    void set_health_global_position(bool ok);
-    void set_health_home_position(bool ok);
     void set_health_gyrometer_calibration(bool ok);
     void set_health_accelerometer_calibration(bool ok);
     void set_health_magnetometer_calibration(bool ok);
     void set_health_level_calibration(bool ok);
+    void set_health_sensors(uint32_t sensors_present, uint32_t sensors_health);
+    // Needs to be called with _health_mutex locked.
+    void update_calibration_health();
+
+    // Health is only sent to subscribers when it changed, or once after subscribing.
+    void notify_health_if_changed();
+    void resend_health();
+    static bool is_health_all_ok(const Telemetry::Health &health);
     void set_rc_status(bool available, float signal_strength_percent);
 
-    void process_global_position_int(const mavlink_message_t &message);
-    void process_home_position(const mavlink_message_t &message);
-    void process_attitude_quaternion(const mavlink_message_t &message);
-    void process_mount_orientation(const mavlink_message_t &message);
-    void process_gps_raw_int(const mavlink_message_t &message);
-    void process_extended_sys_state(const mavlink_message_t &message);
-    void process_sys_status(const mavlink_message_t &message);
-    void process_heartbeat(const mavlink_message_t &message);
-    void process_rc_channels(const mavlink_message_t &message);
+    void process_global_position_int(const mavlink_global_position_int_t &global_position_int);
+    void process_home_position(const mavlink_home_position_t &home_position);
+    void process_attitude_quaternion(const mavlink_attitude_quaternion_t &attitude_quaternion);
+    void process_mount_orientation(const mavlink_mount_orientation_t &mount_orientation);
+    void process_gps_raw_int(const mavlink_gps_raw_int_t &gps_raw_int);
+    void process_extended_sys_state(const mavlink_extended_sys_state_t &extended_sys_state);
+    void process_sys_status(const mavlink_sys_status_t &sys_status);
+    void process_heartbeat(const mavlink_heartbeat_t &heartbeat);
+    void process_rc_channels(const mavlink_rc_channels_t &rc_channels);
+    void process_local_position_ned(const mavlink_local_position_ned_t &local_position_ned);
+    void process_attitude(const mavlink_attitude_t &attitude);
+    void process_highres_imu(const mavlink_highres_imu_t &highres_imu);
+    void process_odometry(const mavlink_message_t &message);
+    void process_actuator_control_target(
+        const mavlink_actuator_control_target_t &actuator_control_target_message);
 
     void receive_param_cal_gyro(bool success, int value);
     void receive_param_cal_accel(bool success, int value);
@@ -118,6 +251,10 @@ private:
 #endif
 
     void receive_rc_channels_timeout();
+    // Follows the calibration params as they change, e.g. after calibrating
+    // with another ground station.
+    void receive_param_changed(const std::string &name,
+                               MAVLinkParameters::ParamValue value);
 
 
     static Telemetry::Result telemetry_result_from_command_result(
@@ -128,58 +265,131 @@ private:
 
     static Telemetry::FlightMode to_flight_mode_from_custom_mode(uint32_t custom_mode);
 
-    // Make all fields thread-safe using mutexs
-    // The mutexs are mutable so that the lock can get aqcuired in
-    // methods marked const.
-    mutable std::mutex _position_mutex;
-    Telemetry::Position _position;
-
-    mutable std::mutex _home_position_mutex;
-    Telemetry::Position _home_position;
-
-    // If possible, just use atomic instead of a mutex.
-    std::atomic_bool _in_air;
-    std::atomic_bool _armed;
-
-    mutable std::mutex _attitude_quaternion_mutex;
-    Telemetry::Quaternion _attitude_quaternion;
-
-    mutable std::mutex _camera_attitude_euler_angle_mutex;
-    Telemetry::EulerAngle _camera_attitude_euler_angle;
-
-    mutable std::mutex _ground_speed_ned_mutex;
-    Telemetry::GroundSpeedNED _ground_speed_ned;
-
-    mutable std::mutex _gps_info_mutex;
-    Telemetry::GPSInfo _gps_info;
-
-    mutable std::mutex _battery_mutex;
-    Telemetry::Battery _battery;
-
-    mutable std::mutex _flight_mode_mutex;
-    Telemetry::FlightMode _flight_mode;
-
-    mutable std::mutex _health_mutex;
-    Telemetry::Health _health;
-
-    mutable std::mutex _rc_status_mutex;
-    Telemetry::RCStatus _rc_status;
-
-    Telemetry::position_callback_t _position_subscription;
-    Telemetry::position_callback_t _home_position_subscription;
-    Telemetry::in_air_callback_t _in_air_subscription;
-    Telemetry::armed_callback_t _armed_subscription;
-    Telemetry::attitude_quaternion_callback_t _attitude_quaternion_subscription;
-    Telemetry::attitude_euler_angle_callback_t _attitude_euler_angle_subscription;
-    Telemetry::attitude_quaternion_callback_t _camera_attitude_quaternion_subscription;
-    Telemetry::attitude_euler_angle_callback_t _camera_attitude_euler_angle_subscription;
-    Telemetry::ground_speed_ned_callback_t _ground_speed_ned_subscription;
-    Telemetry::gps_info_callback_t _gps_info_subscription;
-    Telemetry::battery_callback_t _battery_subscription;
-    Telemetry::flight_mode_callback_t _flight_mode_subscription;
-    Telemetry::health_callback_t _health_subscription;
-    Telemetry::health_all_ok_callback_t _health_all_ok_subscription;
-    Telemetry::rc_status_callback_t _rc_status_subscription;
+    // When the message being handled arrived, so queueing doesn't count.
+    uint64_t now_us();
+    // When the vehicle measured it if the clocks are synchronized, otherwise now.
+    uint64_t sample_time_us(uint32_t time_boot_ms);
+
+    static double get_interpolation_factor(uint64_t time_us, uint64_t before_time_us,
+                                           uint64_t after_time_us);
+    static Telemetry::Position to_position(const double (&fields)[4]);
+    static Telemetry::Quaternion to_quaternion(const double (&fields)[4]);
+
+    // Each value has its own seqlock, so that readers of one only copy it again
+    // when that one was written, not when anything else came in. Values from
+    // the same message share one, and get_snapshot() checks that none of them was
+    // written while it read them all. The receive thread writes them while
+    // users poll them from their own threads, and neither side ever waits.
+    template <typename T>
+    struct Timed {
+        T value;
+        uint64_t time_us;
+    };
+    struct PositionState {
+        Telemetry::Position position;
+        Telemetry::GroundSpeedNED ground_speed_ned;
+        uint64_t time_us;
+    };
+    struct HomePositionState {
+        Telemetry::Position home_position;
+        bool ok;
+        uint64_t time_us;
+    };
+    struct HeartbeatState {
+        bool armed;
+        Telemetry::FlightMode flight_mode;
+        uint64_t time_us;
+    };
+    struct GPSInfoState {
+        Telemetry::GPSInfo gps_info;
+        bool position_ok;
+        uint64_t time_us;
+    };
+
+    SeqLock<PositionState> _position;
+    SeqLock<HomePositionState> _home_position;
+    SeqLock<Timed<bool>> _in_air;
+    SeqLock<HeartbeatState> _heartbeat;
+    SeqLock<Timed<Telemetry::Quaternion>> _attitude_quaternion;
+    SeqLock<Timed<Telemetry::EulerAngle>> _camera_attitude_euler_angle;
+    SeqLock<GPSInfoState> _gps_info;
+    SeqLock<Timed<Telemetry::Battery>> _battery;
+    // Only the calibration flags, the others come with home position and GPS info.
+    SeqLock<Telemetry::Health> _calibration_health;
+    SeqLock<Timed<Telemetry::RCStatus>> _rc_status;
+
+    static Telemetry::Health to_health(const Telemetry::Health &calibration_health,
+                                       const GPSInfoState &gps_info,
+                                       const HomePositionState &home_position);
+
+    // Values derived from another one are only computed when asked for, and
+    // then kept until it is stored again, identified by the version of its seqlock.
+    // Receive times can repeat, so they don't tell samples apart.
+    template <typename T>
+    struct DerivedValue {
+        uint32_t version;
+        T value;
+    };
+    mutable SeqLock<DerivedValue<Telemetry::EulerAngle>> _attitude_euler_angle_cache;
+    mutable SeqLock<DerivedValue<Telemetry::Quaternion>> _camera_attitude_quaternion_cache;
+
+    // The high-rate streams are not part of the snapshot.
+    SeqLock<Telemetry::PositionVelocityNED> _position_velocity_ned;
+    SeqLock<Telemetry::AngularVelocityBody> _attitude_angular_velocity_body;
+    SeqLock<Telemetry::IMU> _imu;
+    SeqLock<Telemetry::Odometry> _odometry;
+    SeqLock<Telemetry::ActuatorControlTarget> _actuator_control_target;
+
+    // Latitude, longitude, absolute and relative altitude.
+    TelemetryHistory<4> _position_history {};
+    // w, x, y, z
+    TelemetryHistory<4> _attitude_quaternion_history {};
+
+    SubscriberList<Telemetry::Position> _position_subscriptions {};
+    SubscriberList<Telemetry::Position> _home_position_subscriptions {};
+    SubscriberList<bool> _in_air_subscriptions {};
+    SubscriberList<bool> _armed_subscriptions {};
+    SubscriberList<Telemetry::Quaternion> _attitude_quaternion_subscriptions {};
+    SubscriberList<Telemetry::EulerAngle> _attitude_euler_angle_subscriptions {};
+    SubscriberList<Telemetry::Quaternion> _camera_attitude_quaternion_subscriptions {};
+    SubscriberList<Telemetry::EulerAngle> _camera_attitude_euler_angle_subscriptions {};
+    SubscriberList<Telemetry::GroundSpeedNED> _ground_speed_ned_subscriptions {};
+    SubscriberList<Telemetry::GPSInfo> _gps_info_subscriptions {};
+    SubscriberList<Telemetry::Battery> _battery_subscriptions {};
+    SubscriberList<Telemetry::FlightMode> _flight_mode_subscriptions {};
+    SubscriberList<Telemetry::Health> _health_subscriptions {};
+    SubscriberList<bool> _health_all_ok_subscriptions {};
+    SubscriberList<Telemetry::RCStatus> _rc_status_subscriptions {};
+
+    // These are always called directly from the receive path, never conflated.
+    SubscriberList<Telemetry::PositionVelocityNED> _position_velocity_ned_subscriptions {};
+    SubscriberList<Telemetry::AngularVelocityBody> _attitude_angular_velocity_body_subscriptions {};
+    SubscriberList<Telemetry::IMU> _imu_subscriptions {};
+    SubscriberList<Telemetry::Odometry> _odometry_subscriptions {};
+    SubscriberList<Telemetry::ActuatorControlTarget> _actuator_control_target_subscriptions {};
+
+    // Shared by all streams so that unsubscribe() finds the right one, 0 is
+    // used by the single replaceable subscriber of ..._async().
+    std::atomic<Telemetry::subscription_handle_t> _next_subscription_handle {1};
+
+    MessageRates _message_rates {};
+
+    // The calibration health combines the calibration params, which are read
+    // once on enable(), with the sensor health reported in SYS_STATUS.
+    struct CalibrationInputs {
+        bool gyrometer_param_ok {false};
+        bool accelerometer_param_ok {false};
+        bool magnetometer_param_ok {false};
+        bool level_param_ok {false};
+        uint32_t sensors_present {0};
+        uint32_t sensors_health {0};
+    };
+
+    std::mutex _health_mutex {};
+    CalibrationInputs _calibration_inputs {};
+    Telemetry::Health _last_notified_health {};
+    bool _last_notified_health_all_ok {false};
+    bool _resend_health {true};
 
     // The ground speed and position are coupled to the same message, therefore, we just use
     // the faster between the two.
@@ -187,6 +397,9 @@ private:
     double _position_rate_hz;
 
     void *_timeout_cookie = nullptr;
+    std::vector<MAVLinkParameters::param_subscription_handle_t> _param_subscriptions {};
+
+    std::atomic<bool> _conflate_subscriptions {false};
 };
 
 } // namespace dronecore